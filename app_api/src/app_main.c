@@ -46,10 +46,13 @@
 #include "param.h"
 #include "pm.h"
 #include "app_channel.h"
+#include "app_hook.h"
 
 
 #define DEBUG_MODULE "APPAPI"
 
+static void appHook(const state_t *state, const sensorData_t *sensorData, const uint32_t tick) {}
+
 void appMain() {
   // Do not run this app
   ASSERT_FAILED();
@@ -131,5 +134,16 @@ void appMain() {
     appchannelSendPacket("hello", 5);
     appchannelReceivePacket(buffer, APPCHANNEL_MTU, APPCHANNEL_WAIT_FOREVER);
     appchannelHasOverflowOccured();
+    const void* data;
+    appchannelReceivePacketBuffer(&data, APPCHANNEL_WAIT_FOREVER);
+    appchannelReleasePacketBuffer(data);
+    appchannelSendMessage("hello", 5);
+    appchannelReceiveMessage(buffer, APPCHANNEL_MTU, APPCHANNEL_WAIT_FOREVER);
+  }
+
+  // App hooks
+  {
+    int id = appHookRegister(appHook, RATE_100_HZ, 0, 50);
+    appHookIsEnabled(id);
   }
 }
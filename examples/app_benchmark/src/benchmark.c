@@ -0,0 +1,405 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * benchmark.c - App layer application that measures the cost of firmware
+ *   kernels on the target.
+ *
+ * Each registered kernel is run a number of times with the DWT cycle counter
+ * read around every run. Interrupts are disabled during a run and the cost of
+ * an empty run is subtracted. All kernels are measured twice, with the flash
+ * instruction/data caches and prefetch enabled (the normal configuration) and
+ * disabled, the flash wait states are the ones set by the clock
+ * configuration.
+ *
+ * A run is started by setting the bench.run parameter. The results are
+ * printed on the console, one comma separated line per kernel, and can be
+ * read as a table through the memory subsystem (MEM_TYPE_APP).
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "stm32fxxx.h"
+#include "mem.h"
+#include "param.h"
+
+#include "kalman_core.h"
+#include "pptraj.h"
+#include "filter.h"
+#include "crc32.h"
+#include "pulse_processor_v2.h"
+
+#define DEBUG_MODULE "BENCH"
+#include "debug.h"
+
+#define BENCH_VERSION 1
+#define BENCH_NAME_LENGTH 16
+
+typedef struct {
+  const char* name;
+  // Prepares the input of one run, not measured. May be NULL.
+  void (*setup)(void);
+  // The measured kernel
+  void (*run)(void);
+} benchKernel_t;
+
+// Cycles of one kernel in one cache configuration
+typedef struct {
+  uint32_t min;
+  uint32_t mean;
+  uint32_t max;
+} __attribute__((packed)) benchCycles_t;
+
+typedef struct {
+  char name[BENCH_NAME_LENGTH];
+  benchCycles_t cached;
+  benchCycles_t uncached;
+} __attribute__((packed)) benchEntry_t;
+
+
+// Kernels ////////////////////////////////////////////////
+
+static kalmanCoreData_t kalmanData;
+static kalmanCoreWorkspace_t kalmanWorkspace;
+static kalmanCoreData_t kalmanFixture;
+
+static void kalmanSetup(void) {
+  static bool isInit = false;
+  if (!isInit) {
+    kalmanCoreInit(&kalmanFixture, &kalmanWorkspace);
+    // A covariance with all elements populated, so that no update takes a shortcut
+    for (int i = 0; i < KC_STATE_DIM; i++) {
+      for (int j = 0; j < KC_STATE_DIM; j++) {
+        kalmanFixture.P[i][j] = (i == j) ? 1.0f + 0.1f * i : 0.01f * (i + j + 1);
+      }
+    }
+    isInit = true;
+  }
+
+  memcpy(&kalmanData, &kalmanFixture, sizeof(kalmanData));
+  kalmanData.Pm.pData = (float*)kalmanData.P;
+}
+
+static void kalmanScalarUpdateRun(void) {
+  float h[KC_STATE_DIM] = {0};
+  arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+  h[KC_STATE_X] = 0.6f;
+  h[KC_STATE_Y] = -0.3f;
+  h[KC_STATE_Z] = 0.7f;
+  kalmanCoreScalarUpdate(&kalmanData, &H, 0.05f, 0.1f);
+}
+
+static void kalmanStateUpdateRun(void) {
+  kalmanCoreStateUpdate(&kalmanData, KC_STATE_Z, 0.05f, 0.1f);
+}
+
+static void kalmanPredictRun(void) {
+  Axis3f acc = {.x = 0.1f, .y = -0.2f, .z = 1.0f};
+  Axis3f gyro = {.x = 5.0f, .y = -3.0f, .z = 20.0f};
+  kalmanCorePredict(&kalmanData, &acc, &gyro, 0.01f, true);
+}
+
+static void kalmanFinalizeRun(void) {
+  kalmanData.S[KC_STATE_D0] = 0.01f;
+  kalmanData.S[KC_STATE_D1] = -0.02f;
+  kalmanData.S[KC_STATE_D2] = 0.005f;
+  kalmanCoreFinalize(&kalmanData, 0);
+}
+
+static struct poly4d poly;
+static float polyT;
+static volatile struct traj_eval polyResult;
+
+static void poly4dSetup(void) {
+  static bool isInit = false;
+  if (!isInit) {
+    for (int d = 0; d < 4; d++) {
+      for (int i = 0; i < PP_SIZE; i++) {
+        poly.p[d][i] = 0.1f * (d + 1) / (i + 1);
+      }
+    }
+    poly.duration = 2.0f;
+    isInit = true;
+  }
+
+  polyT += 0.01f;
+  if (polyT > poly.duration) {
+    polyT = 0.0f;
+  }
+}
+
+static void poly4dEvalRun(void) {
+  polyResult = poly4d_eval(&poly, polyT);
+}
+
+static lpf2pData lpf;
+static volatile float lpfResult;
+
+static void lpf2pSetup(void) {
+  static bool isInit = false;
+  if (!isInit) {
+    lpf2pInit(&lpf, 1000.0f, 80.0f);
+    isInit = true;
+  }
+}
+
+static void lpf2pApplyRun(void) {
+  lpfResult = lpf2pApply(&lpf, 1.0f);
+}
+
+static uint8_t crcData[256];
+static volatile uint32_t crcResult;
+
+static void crc32Run(void) {
+  crc32Context_t context;
+  crc32ContextInit(&context);
+  crc32Update(&context, crcData, sizeof(crcData));
+  crcResult = crc32Out(&context);
+}
+
+// A synthetic stream of V2 pulses, the sensors take turns and the sweeps move
+static pulseProcessor_t pulseState;
+static pulseProcessorFrame_t pulseFrame;
+
+static void pulseSetup(void) {
+  pulseFrame.sensor = (pulseFrame.sensor + 1) % 4;
+  pulseFrame.timestamp += 1200;
+  pulseFrame.offset = (pulseFrame.offset + 997) % 400000;
+  pulseFrame.beamData = 0;
+  pulseFrame.channel = 0;
+  pulseFrame.slowbit = 0;
+  pulseFrame.channelFound = true;
+}
+
+static void pulseProcessRun(void) {
+  pulseProcessorResult_t angles;
+  int baseStation;
+  int axis;
+  bool calibDataIsDecoded;
+  pulseProcessorV2ProcessPulse(&pulseState, &pulseFrame, &angles, &baseStation, &axis, &calibDataIsDecoded);
+}
+
+static const benchKernel_t kernels[] = {
+  {.name = "kcScalarUpdate", .setup = kalmanSetup, .run = kalmanScalarUpdateRun},
+  {.name = "kcStateUpdate", .setup = kalmanSetup, .run = kalmanStateUpdateRun},
+  {.name = "kcPredict", .setup = kalmanSetup, .run = kalmanPredictRun},
+  {.name = "kcFinalize", .setup = kalmanSetup, .run = kalmanFinalizeRun},
+  {.name = "poly4dEval", .setup = poly4dSetup, .run = poly4dEvalRun},
+  {.name = "lpf2pApply", .setup = lpf2pSetup, .run = lpf2pApplyRun},
+  {.name = "crc32Update256", .setup = 0, .run = crc32Run},
+  {.name = "pulseProcV2", .setup = pulseSetup, .run = pulseProcessRun},
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+
+// Measurement ////////////////////////////////////////////
+
+typedef struct {
+  uint8_t version;
+  uint8_t kernelCount;
+  uint8_t entrySize;
+  uint8_t flashLatency;
+  uint32_t cyclesPerUs;
+  uint32_t iterations;
+  benchEntry_t entries[KERNEL_COUNT];
+} __attribute__((packed)) benchTable_t;
+
+static benchTable_t table;
+
+static uint8_t runRequested = 0;
+static uint16_t iterations = 200;
+
+static void emptyRun(void) {
+}
+
+static void setFlashCache(const bool enabled) {
+  if (enabled) {
+    FLASH->ACR |= FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN;
+  } else {
+    FLASH->ACR &= ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN | FLASH_ACR_PRFTEN);
+    // The caches may only be reset while disabled, no stale lines are left when they are enabled again
+    FLASH->ACR |= FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+    FLASH->ACR &= ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+  }
+}
+
+static uint32_t measureOnce(const benchKernel_t* kernel) {
+  if (kernel->setup) {
+    kernel->setup();
+  }
+
+  __disable_irq();
+  const uint32_t start = DWT->CYCCNT;
+  kernel->run();
+  const uint32_t cycles = DWT->CYCCNT - start;
+  __enable_irq();
+
+  return cycles;
+}
+
+static void measure(const benchKernel_t* kernel, const uint32_t overhead, benchCycles_t* result) {
+  uint32_t min = UINT32_MAX;
+  uint32_t max = 0;
+  uint64_t sum = 0;
+
+  for (int i = 0; i < iterations; i++) {
+    uint32_t cycles = measureOnce(kernel);
+    cycles = (cycles > overhead) ? cycles - overhead : 0;
+
+    if (cycles < min) {
+      min = cycles;
+    }
+    if (cycles > max) {
+      max = cycles;
+    }
+    sum += cycles;
+
+    // Let the rest of the system run now and then
+    if ((i & 0x1f) == 0x1f) {
+      vTaskDelay(1);
+    }
+  }
+
+  result->min = min;
+  result->mean = (uint32_t)(sum / iterations);
+  result->max = max;
+}
+
+static uint32_t measureOverhead(void) {
+  const benchKernel_t empty = {.name = "empty", .setup = 0, .run = emptyRun};
+  uint32_t min = UINT32_MAX;
+  for (int i = 0; i < 32; i++) {
+    const uint32_t cycles = measureOnce(&empty);
+    if (cycles < min) {
+      min = cycles;
+    }
+  }
+  return min;
+}
+
+static void runBenchmark(void) {
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  table.iterations = iterations;
+  table.flashLatency = FLASH->ACR & FLASH_ACR_LATENCY;
+
+  for (int cached = 1; cached >= 0; cached--) {
+    setFlashCache(cached);
+    const uint32_t overhead = measureOverhead();
+
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+      benchEntry_t* entry = &table.entries[k];
+      measure(&kernels[k], overhead, cached ? &entry->cached : &entry->uncached);
+    }
+  }
+  setFlashCache(true);
+
+  DEBUG_PRINT("kernel,iterations,min,mean,max,minNoCache,meanNoCache,maxNoCache (cycles, %lu/us, %u ws)\n",
+    table.cyclesPerUs, table.flashLatency);
+  for (int k = 0; k < KERNEL_COUNT; k++) {
+    const benchEntry_t* entry = &table.entries[k];
+    DEBUG_PRINT("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", entry->name, table.iterations,
+      entry->cached.min, entry->cached.mean, entry->cached.max,
+      entry->uncached.min, entry->uncached.mean, entry->uncached.max);
+  }
+}
+
+
+// Memory handler /////////////////////////////////////////
+
+static uint32_t handleMemGetSize(void) {
+  return sizeof(table);
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest) {
+  if (memAddr + readLen > sizeof(table)) {
+    return false;
+  }
+
+  memcpy(dest, ((uint8_t*)&table) + memAddr, readLen);
+  return true;
+}
+
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_APP,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+
+void appMain()
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  table.version = BENCH_VERSION;
+  table.kernelCount = KERNEL_COUNT;
+  table.entrySize = sizeof(benchEntry_t);
+  table.cyclesPerUs = SystemCoreClock / 1000000;
+  for (int k = 0; k < KERNEL_COUNT; k++) {
+    strncpy(table.entries[k].name, kernels[k].name, BENCH_NAME_LENGTH);
+  }
+  for (int i = 0; i < sizeof(crcData); i++) {
+    crcData[i] = (uint8_t)(i * 31 + 7);
+  }
+
+  memoryRegisterHandler(&memDef);
+
+  DEBUG_PRINT("%d kernels, set bench.run to measure\n", KERNEL_COUNT);
+
+  while(1) {
+    vTaskDelay(M2T(100));
+
+    if (runRequested) {
+      runBenchmark();
+      runRequested = 0;
+    }
+  }
+}
+
+/**
+ * Benchmark of firmware kernels. Do not fly with this app, interrupts are
+ * disabled during each measured run and the flash caches are turned off
+ * during a part of the benchmark.
+ */
+PARAM_GROUP_START(bench)
+/**
+ * @brief Set to nonzero to run the benchmark, reset to 0 when done
+ */
+PARAM_ADD(PARAM_UINT8, run, &runRequested)
+/**
+ * @brief Number of measured runs of each kernel and cache configuration
+ */
+PARAM_ADD(PARAM_UINT16, iterations, &iterations)
+PARAM_GROUP_STOP(bench)
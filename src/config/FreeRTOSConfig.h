@@ -160,14 +160,22 @@ to exclude the API function. */
 
 #define configSUPPORT_STATIC_ALLOCATION 1
 
-// Queue monitoring
-#ifdef DEBUG_QUEUE_MONITOR
-    #undef traceQUEUE_SEND
-    #undef traceQUEUE_SEND_FAILED
-    #define traceQUEUE_SEND(xQueue) qm_traceQUEUE_SEND(xQueue)
-    void qm_traceQUEUE_SEND(void* xQueue);
-    #define traceQUEUE_SEND_FAILED(xQueue) qm_traceQUEUE_SEND_FAILED(xQueue)
-    void qm_traceQUEUE_SEND_FAILED(void* xQueue);
-#endif // DEBUG_QUEUE_MONITOR
+// Queue monitoring, see queuemonitor.h
+#undef traceQUEUE_SEND
+#undef traceQUEUE_SEND_FROM_ISR
+#undef traceQUEUE_SEND_FAILED
+#undef traceQUEUE_SEND_FROM_ISR_FAILED
+#undef traceQUEUE_RECEIVE
+#undef traceQUEUE_RECEIVE_FROM_ISR
+// The events are also sent to the ITM, see trace.h
+#define traceQUEUE_SEND(xQueue) do { qm_traceQUEUE_SEND(xQueue); TRACE_ITM_QUEUE(ITM_QUEUE_SEND, xQueue); } while (0)
+#define traceQUEUE_SEND_FROM_ISR(xQueue) traceQUEUE_SEND(xQueue)
+void qm_traceQUEUE_SEND(void* xQueue);
+#define traceQUEUE_SEND_FAILED(xQueue) do { qm_traceQUEUE_SEND_FAILED(xQueue); TRACE_ITM_QUEUE(ITM_QUEUE_FAILED, xQueue); } while (0)
+#define traceQUEUE_SEND_FROM_ISR_FAILED(xQueue) traceQUEUE_SEND_FAILED(xQueue)
+void qm_traceQUEUE_SEND_FAILED(void* xQueue);
+#define traceQUEUE_RECEIVE(xQueue) do { qm_traceQUEUE_RECEIVE(xQueue); TRACE_ITM_QUEUE(ITM_QUEUE_RECEIVE, xQueue); } while (0)
+#define traceQUEUE_RECEIVE_FROM_ISR(xQueue) traceQUEUE_RECEIVE(xQueue)
+void qm_traceQUEUE_RECEIVE(void* xQueue);
 
 #endif /* FREERTOS_CONFIG_H */
@@ -69,16 +69,21 @@
 // Task priorities. Higher number higher priority
 #define STABILIZER_TASK_PRI     5
 #define SENSORS_TASK_PRI        4
+#define SENSORS_SIM_INJECT_TASK_PRI 4
+#define SENSORS_BARO_TASK_PRI   3
 #define ADC_TASK_PRI            3
 #define FLOW_TASK_PRI           3
 #define MULTIRANGER_TASK_PRI    3
+#define AMG8833_TASK_PRI        1
 #define SYSTEM_TASK_PRI         2
 #define CRTP_TX_TASK_PRI        2
 #define CRTP_RX_TASK_PRI        2
+#define CRTP_BENCH_TASK_PRI     1
 #define EXTRX_TASK_PRI          2
 #define ZRANGER_TASK_PRI        2
 #define ZRANGER2_TASK_PRI       2
 #define LOG_TASK_PRI            1
+#define LOG_HR_TASK_PRI         3
 #define MEM_TASK_PRI            1
 #define PARAM_TASK_PRI          1
 #define PROXIMITY_TASK_PRI      0
@@ -90,20 +95,30 @@
 #define BQ_OSD_TASK_PRI         1
 #define GTGPS_DECK_TASK_PRI     1
 #define LIGHTHOUSE_TASK_PRI     3
+#define LH_STORAGE_WRITER_TASK_PRI 0
+#define WORKER_LOW_TASK_PRI     0
+#define DECK_SCAN_TASK_PRI      2
+#define CONSOLE_TASK_PRI        0
+#define EVENTTRIGGER_TASK_PRI   1
 #define LPS_DECK_TASK_PRI       3
 #define OA_DECK_TASK_PRI        3
 #define UART1_TEST_TASK_PRI     1
 #define UART2_TEST_TASK_PRI     1
 #define KALMAN_TASK_PRI         2
+#define ESTIMATOR_SHADOW_TASK_PRI 1
+#define VIBRATION_TASK_PRI      0
+#define BLACK_BOX_TASK_PRI      0
 #define LEDSEQCMD_TASK_PRI      1
 
 #define SYSLINK_TASK_PRI        3
 #define USBLINK_TASK_PRI        3
+#define RTTLINK_TASK_PRI        3
 #define ACTIVE_MARKER_TASK_PRI  3
 #define AI_DECK_TASK_PRI        3
 #define UART2_TASK_PRI          3
 #define CRTP_SRV_TASK_PRI       0
 #define PLATFORM_SRV_TASK_PRI   0
+#define P2P_TASK_PRI            2
 
 // Not compiled
 #if 0
@@ -119,16 +134,22 @@
 #define PM_TASK_NAME            "PWRMGNT"
 #define CRTP_TX_TASK_NAME       "CRTP-TX"
 #define CRTP_RX_TASK_NAME       "CRTP-RX"
+#define CRTP_BENCH_TX_TASK_NAME "BENCH-TX"
+#define CRTP_BENCH_RX_TASK_NAME "BENCH-RX"
 #define CRTP_RXTX_TASK_NAME     "CRTP-RXTX"
 #define LOG_TASK_NAME           "LOG"
+#define LOG_HR_TASK_NAME        "LOG-HR"
 #define MEM_TASK_NAME           "MEM"
 #define PARAM_TASK_NAME         "PARAM"
 #define SENSORS_TASK_NAME       "SENSORS"
+#define SENSORS_SIM_INJECT_TASK_NAME "SIM-INJECT"
+#define SENSORS_BARO_TASK_NAME  "BARO"
 #define STABILIZER_TASK_NAME    "STABILIZER"
 #define NRF24LINK_TASK_NAME     "NRF24LINK"
 #define ESKYLINK_TASK_NAME      "ESKYLINK"
 #define SYSLINK_TASK_NAME       "SYSLINK"
 #define USBLINK_TASK_NAME       "USBLINK"
+#define RTTLINK_TASK_NAME       "RTTLINK"
 #define PROXIMITY_TASK_NAME     "PROXIMITY"
 #define EXTRX_TASK_NAME         "EXTRX"
 #define UART_RX_TASK_NAME       "UART"
@@ -140,20 +161,30 @@
 #define PCA9685_TASK_NAME       "PCA9685"
 #define CMD_HIGH_LEVEL_TASK_NAME "CMDHL"
 #define MULTIRANGER_TASK_NAME   "MR"
+#define AMG8833_TASK_NAME       "AMG8833"
 #define BQ_OSD_TASK_NAME        "BQ_OSDTASK"
 #define GTGPS_DECK_TASK_NAME    "GTGPS"
 #define LIGHTHOUSE_TASK_NAME    "LH"
+#define LH_STORAGE_WRITER_TASK_NAME "LH-STORAGE"
+#define WORKER_LOW_TASK_NAME    "WORKER-LOW"
+#define DECK_SCAN_TASK_NAME     "DECK-SCAN"
+#define CONSOLE_TASK_NAME       "CONSOLE"
+#define EVENTTRIGGER_TASK_NAME  "EVENTTRIG"
 #define LPS_DECK_TASK_NAME      "LPS"
 #define OA_DECK_TASK_NAME       "OA"
 #define UART1_TEST_TASK_NAME    "UART1TEST"
 #define UART2_TEST_TASK_NAME    "UART2TEST"
 #define KALMAN_TASK_NAME        "KALMAN"
+#define ESTIMATOR_SHADOW_TASK_NAME "EST-SHADOW"
+#define VIBRATION_TASK_NAME     "VIBRATION"
+#define BLACK_BOX_TASK_NAME     "BLACKBOX"
 #define ACTIVE_MARKER_TASK_NAME "ACTIVEMARKER-DECK"
 #define AI_DECK_GAP_TASK_NAME   "AI-DECK-GAP"
 #define AI_DECK_NINA_TASK_NAME  "AI-DECK-NINA"
 #define UART2_TASK_NAME         "UART2"
 #define CRTP_SRV_TASK_NAME      "CRTP-SRV"
 #define PLATFORM_SRV_TASK_NAME  "PLATFORM-SRV"
+#define P2P_TASK_NAME           "P2P"
 
 //Task stack sizes
 #define SYSTEM_TASK_STACKSIZE         (2* configMINIMAL_STACK_SIZE)
@@ -162,16 +193,22 @@
 #define PM_TASK_STACKSIZE             configMINIMAL_STACK_SIZE
 #define CRTP_TX_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
 #define CRTP_RX_TASK_STACKSIZE        (2* configMINIMAL_STACK_SIZE)
+#define CRTP_BENCH_TX_TASK_STACKSIZE  configMINIMAL_STACK_SIZE
+#define CRTP_BENCH_RX_TASK_STACKSIZE  (2* configMINIMAL_STACK_SIZE)
 #define CRTP_RXTX_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define LOG_TASK_STACKSIZE            (2 * configMINIMAL_STACK_SIZE)
+#define LOG_HR_TASK_STACKSIZE         (2 * configMINIMAL_STACK_SIZE)
 #define MEM_TASK_STACKSIZE            (2 * configMINIMAL_STACK_SIZE)
 #define PARAM_TASK_STACKSIZE          configMINIMAL_STACK_SIZE
 #define SENSORS_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
+#define SENSORS_SIM_INJECT_TASK_STACKSIZE (2 * configMINIMAL_STACK_SIZE)
+#define SENSORS_BARO_TASK_STACKSIZE   (2 * configMINIMAL_STACK_SIZE)
 #define STABILIZER_TASK_STACKSIZE     (3 * configMINIMAL_STACK_SIZE)
 #define NRF24LINK_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define ESKYLINK_TASK_STACKSIZE       configMINIMAL_STACK_SIZE
 #define SYSLINK_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
 #define USBLINK_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
+#define RTTLINK_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
 #define PROXIMITY_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define EXTRX_TASK_STACKSIZE          configMINIMAL_STACK_SIZE
 #define UART_RX_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
@@ -180,14 +217,26 @@
 #define FLOW_TASK_STACKSIZE           (2 * configMINIMAL_STACK_SIZE)
 #define USDLOG_TASK_STACKSIZE         (2 * configMINIMAL_STACK_SIZE)
 #define USDWRITE_TASK_STACKSIZE       (3 * configMINIMAL_STACK_SIZE)
+#define LH_STORAGE_WRITER_TASK_STACKSIZE (2 * configMINIMAL_STACK_SIZE)
+#define WORKER_LOW_TASK_STACKSIZE     (2 * configMINIMAL_STACK_SIZE)
+#define DECK_SCAN_TASK_STACKSIZE      (2 * configMINIMAL_STACK_SIZE)
+#define CONSOLE_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
+#define GTGPS_DECK_TASK_STACKSIZE     (2 * configMINIMAL_STACK_SIZE)
+#define EVENTTRIGGER_TASK_STACKSIZE   (2 * configMINIMAL_STACK_SIZE)
 #define PCA9685_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
 #define CMD_HIGH_LEVEL_TASK_STACKSIZE (2 * configMINIMAL_STACK_SIZE)
 #define MULTIRANGER_TASK_STACKSIZE    (2 * configMINIMAL_STACK_SIZE)
+#define AMG8833_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
 #define ACTIVEMARKER_TASK_STACKSIZE   configMINIMAL_STACK_SIZE
 #define AI_DECK_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
+#define AI_DECK_LINK_TASK_STACKSIZE   (2 * configMINIMAL_STACK_SIZE)
 #define UART2_TASK_STACKSIZE          configMINIMAL_STACK_SIZE
 #define CRTP_SRV_TASK_STACKSIZE       configMINIMAL_STACK_SIZE
 #define PLATFORM_SRV_TASK_STACKSIZE   configMINIMAL_STACK_SIZE
+#define P2P_TASK_STACKSIZE            (2 * configMINIMAL_STACK_SIZE)
+#define ESTIMATOR_SHADOW_TASK_STACKSIZE (3 * configMINIMAL_STACK_SIZE)
+#define VIBRATION_TASK_STACKSIZE      (2 * configMINIMAL_STACK_SIZE)
+#define BLACK_BOX_TASK_STACKSIZE      (2 * configMINIMAL_STACK_SIZE)
 
 //The radio channel. From 0 to 125
 #define RADIO_CHANNEL 80
@@ -29,29 +29,57 @@
 
 #define configUSE_TRACE_FACILITY	1
 
+/**
+ * Trace of the scheduler and the stabilizer loop on the ITM stimulus ports, captured through SWO with
+ * tools/trace/enable_trace.cfg and decoded with tools/trace/itmtrace.c or tools/trace/decodeItm.py. The events have
+ * no timestamp of their own, the ITM local timestamps and the DWT exception trace (ISR entry and exit) are enabled
+ * on the host side. Writes to a stimulus port are dropped when the ITM is not enabled.
+ *
+ * Port 1 - task switched in, 32 bits: the first 4 characters of the task name
+ * Port 2 - tick increment, 32 bits: the tick count
+ * Port 3 - queue event, 32 bits: event << 24 | queue number, see queuemonitor.c for the queue number
+ * Port 4 - task switched out, 32 bits: the first 4 characters of the task name
+ * Port 5 - user marker, 16 bits: marker group << 8 | value
+ */
+#define TRACE_PORT_TASK_IN  1
+#define TRACE_PORT_TICK     2
+#define TRACE_PORT_QUEUE    3
+#define TRACE_PORT_TASK_OUT 4
+#define TRACE_PORT_MARKER   5
+
 // ITM useful macros
+#define ITM_PORT32(CH) (((volatile uint32_t*)0xE0000000)[CH])
+#define ITM_PORT16(CH) (*(volatile uint16_t*)&ITM_PORT32(CH))
 #ifndef ITM_NO_OVERFLOW
-#define ITM_SEND(CH, DATA) ((uint32_t*)0xE0000000)[CH] = DATA
+#define ITM_SEND(CH, DATA) ITM_PORT32(CH) = DATA
+#define ITM_SEND16(CH, DATA) ITM_PORT16(CH) = DATA
 #else
-#define ITM_SEND(CH, DATA) while(((uint32_t*)0xE0000000)[CH] == 0);\
-                           ((uint32_t*)0xE0000000)[CH] = DATA
+#define ITM_SEND(CH, DATA) while(ITM_PORT32(CH) == 0);\
+                           ITM_PORT32(CH) = DATA
+#define ITM_SEND16(CH, DATA) while(ITM_PORT32(CH) == 0);\
+                             ITM_PORT16(CH) = DATA
 #endif
 
-// Send 4 first chatacters of task name to ITM port 1
-#define traceTASK_SWITCHED_IN() ITM_SEND(1, *((uint32_t*)pxCurrentTCB->pcTaskName))
+#define traceTASK_SWITCHED_IN() ITM_SEND(TRACE_PORT_TASK_IN, *((uint32_t*)pxCurrentTCB->pcTaskName))
+#define traceTASK_SWITCHED_OUT() ITM_SEND(TRACE_PORT_TASK_OUT, *((uint32_t*)pxCurrentTCB->pcTaskName))
+
+#define traceTASK_INCREMENT_TICK(xTickCount) ITM_SEND(TRACE_PORT_TICK, xTickCount)
+
+// Queue events, the send and receive hooks are shared with the queue monitor in FreeRTOSConfig.h
+#define ITM_QUEUE_SEND 0x01
+#define ITM_QUEUE_FAILED 0x02
+#define ITM_BLOCKING_ON_QUEUE_RECEIVE 0x03
+#define ITM_BLOCKING_ON_QUEUE_SEND 0x04
+#define ITM_QUEUE_RECEIVE 0x05
+
+#define TRACE_ITM_QUEUE(EVENT, xQueue) ITM_SEND(TRACE_PORT_QUEUE, ((EVENT) << 24) | (((xQUEUE *) xQueue)->uxQueueNumber & 0xffffff))
 
-// Systick value on port 2
-#define traceTASK_INCREMENT_TICK(xTickCount) ITM_SEND(2, xTickCount)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(xQueue) TRACE_ITM_QUEUE(ITM_BLOCKING_ON_QUEUE_RECEIVE, xQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(xQueue) TRACE_ITM_QUEUE(ITM_BLOCKING_ON_QUEUE_SEND, xQueue)
 
-// Queue trace on port 3
-#define ITM_QUEUE_SEND 0x0100
-#define ITM_QUEUE_FAILED 0x0200
-#define ITM_BLOCKING_ON_QUEUE_RECEIVE 0x0300
-#define ITM_BLOCKING_ON_QUEUE_SEND 0x0400
+// User markers
+#define TRACE_MARKER_GROUP_STABILIZER 0x01
 
-#define traceQUEUE_SEND(xQueue) ITM_SEND(3, ITM_QUEUE_SEND | ((xQUEUE *) xQueue)->uxQueueNumber)
-#define traceQUEUE_SEND_FAILED(xQueue) ITM_SEND(3, ITM_QUEUE_FAILED | ((xQUEUE *) xQueue)->uxQueueNumber)
-#define traceBLOCKING_ON_QUEUE_RECEIVE(xQueue) ITM_SEND(3, ITM_BLOCKING_ON_QUEUE_RECEIVE | ((xQUEUE *) xQueue)->uxQueueNumber)
-#define traceBLOCKING_ON_QUEUE_SEND(xQueue) ITM_SEND(3, ITM_BLOCKING_ON_QUEUE_SEND | ((xQUEUE *) xQueue)->uxQueueNumber)
+#define TRACE_MARKER(GROUP, VALUE) ITM_SEND16(TRACE_PORT_MARKER, (uint16_t)(((GROUP) << 8) | ((VALUE) & 0xff)))
 
 #endif
@@ -36,6 +36,8 @@
 #include "cfassert.h"
 #include "config.h"
 #include "nvicconf.h"
+#include "usec_time.h"
+#include "log.h"
 
 #define SPI                     SPI1
 #define SPI_CLK                 RCC_APB2Periph_SPI1
@@ -81,11 +83,52 @@
 
 #define DUMMY_BYTE         0xA5
 
+// Short transfers on a fast bus are done by polling, the overhead of setting up the DMA and waiting for the
+// completion interrupts is larger than the transfer itself.
+#define SPI_POLLED_EXCHANGE_MAX_LENGTH 16
+#define SPI_POLLED_EXCHANGE_MAX_PRESCALER SPI_BAUDRATE_12MHZ
+
 static bool isInit = false;
+static bool isConfigured = false;
+static uint16_t configuredBaudRatePrescaler;
 
 static SemaphoreHandle_t txComplete;
 static SemaphoreHandle_t rxComplete;
-static SemaphoreHandle_t spiMutex;
+
+// Bus arbitration. Tasks of the same client are serialized by the client mutex, the clients then compete for the
+// bus. A waiting client blocks on its grant semaphore and the bus is handed over directly to the waiting client with
+// the highest priority when the owner ends its transaction.
+#define SPI_STATS_PERIOD_US 1000000
+
+typedef struct {
+  const uint8_t priority;
+  SemaphoreHandle_t mutex;
+  StaticSemaphore_t mutexBuffer;
+  SemaphoreHandle_t grant;
+  StaticSemaphore_t grantBuffer;
+  bool isWaiting;
+  uint64_t transactionStart;
+
+  // Accumulated during the current statistics period
+  uint32_t busyTime;
+  uint32_t waitTimeMax;
+
+  // Logged, from the previous statistics period
+  uint16_t utilization; // Per mille of the bus time
+  uint16_t waitMax; // us
+} spiClientState_t;
+
+static spiClientState_t clients[SPI_CLIENT_COUNT] = {
+  [spiClientOther] = {.priority = 1},
+  [spiClientLoco] = {.priority = 3},
+  [spiClientFlow] = {.priority = 2},
+  [spiClientUsd] = {.priority = 0},
+};
+
+static bool isBusTaken = false;
+static spiClient_t busOwner;
+static uint64_t statsPeriodStart;
+static uint32_t timeouts;
 
 static void spiDMAInit();
 static void spiConfigureWithSpeed(uint16_t baudRatePrescaler);
@@ -95,11 +138,20 @@ void spiBegin(void)
 {
   GPIO_InitTypeDef GPIO_InitStructure;
 
+  // Several decks share the bus, the arbitration state must not be reset
+  if (isInit) {
+    return;
+  }
+
   // binary semaphores created using xSemaphoreCreateBinary() are created in a state
   // such that the the semaphore must first be 'given' before it can be 'taken'
   txComplete = xSemaphoreCreateBinary();
   rxComplete = xSemaphoreCreateBinary();
-  spiMutex = xSemaphoreCreateMutex();
+
+  for (int i = 0; i < SPI_CLIENT_COUNT; i++) {
+    clients[i].mutex = xSemaphoreCreateMutexStatic(&clients[i].mutexBuffer);
+    clients[i].grant = xSemaphoreCreateBinaryStatic(&clients[i].grantBuffer);
+  }
 
   /*!< Enable the SPI clock */
   SPI_CLK_INIT(SPI_CLK, ENABLE);
@@ -214,6 +266,9 @@ static void spiConfigureWithSpeed(uint16_t baudRatePrescaler)
 
   SPI_InitStructure.SPI_BaudRatePrescaler = baudRatePrescaler;
   SPI_Init(SPI, &SPI_InitStructure);
+
+  configuredBaudRatePrescaler = baudRatePrescaler;
+  isConfigured = true;
 }
 
 bool spiTest(void)
@@ -221,8 +276,28 @@ bool spiTest(void)
   return isInit;
 }
 
+static bool spiExchangePolled(size_t length, const uint8_t * data_tx, uint8_t * data_rx)
+{
+  SPI_Cmd(SPI, ENABLE);
+
+  for (size_t i = 0; i < length; i++) {
+    while (SPI_I2S_GetFlagStatus(SPI, SPI_I2S_FLAG_TXE) == RESET);
+    SPI_I2S_SendData(SPI, data_tx[i]);
+
+    while (SPI_I2S_GetFlagStatus(SPI, SPI_I2S_FLAG_RXNE) == RESET);
+    data_rx[i] = SPI_I2S_ReceiveData(SPI);
+  }
+
+  SPI_Cmd(SPI, DISABLE);
+  return true;
+}
+
 bool spiExchange(size_t length, const uint8_t * data_tx, uint8_t * data_rx)
 {
+  if (length <= SPI_POLLED_EXCHANGE_MAX_LENGTH && configuredBaudRatePrescaler <= SPI_POLLED_EXCHANGE_MAX_PRESCALER) {
+    return spiExchangePolled(length, data_tx, data_rx);
+  }
+
   ASSERT_DMA_SAFE(data_tx);
   ASSERT_DMA_SAFE(data_rx);
 
@@ -263,13 +338,116 @@ bool spiExchange(size_t length, const uint8_t * data_tx, uint8_t * data_rx)
 
 void spiBeginTransaction(uint16_t baudRatePrescaler)
 {
-  xSemaphoreTake(spiMutex, portMAX_DELAY);
-  spiConfigureWithSpeed(baudRatePrescaler);
+  spiBeginClientTransaction(spiClientOther, baudRatePrescaler, portMAX_DELAY);
+}
+
+bool spiBeginClientTransaction(spiClient_t client, uint16_t baudRatePrescaler, uint32_t timeout)
+{
+  spiClientState_t* state = &clients[client];
+  const uint64_t waitStart = usecTimestamp();
+  const TickType_t startTick = xTaskGetTickCount();
+
+  if (xSemaphoreTake(state->mutex, timeout) != pdTRUE) {
+    timeouts++;
+    return false;
+  }
+
+  bool isGranted = false;
+  taskENTER_CRITICAL();
+  if (!isBusTaken) {
+    isBusTaken = true;
+    busOwner = client;
+    isGranted = true;
+  } else {
+    state->isWaiting = true;
+  }
+  taskEXIT_CRITICAL();
+
+  if (!isGranted) {
+    TickType_t remaining = portMAX_DELAY;
+    if (timeout != portMAX_DELAY) {
+      const TickType_t elapsed = xTaskGetTickCount() - startTick;
+      remaining = (elapsed < timeout) ? timeout - elapsed : 0;
+    }
+
+    if (xSemaphoreTake(state->grant, remaining) != pdTRUE) {
+      taskENTER_CRITICAL();
+      // The bus might have been handed over after the timeout
+      isGranted = !state->isWaiting;
+      state->isWaiting = false;
+      taskEXIT_CRITICAL();
+
+      if (isGranted) {
+        xSemaphoreTake(state->grant, 0);
+      } else {
+        timeouts++;
+        xSemaphoreGive(state->mutex);
+        return false;
+      }
+    }
+  }
+
+  state->transactionStart = usecTimestamp();
+  const uint32_t waitTime = state->transactionStart - waitStart;
+  if (waitTime > state->waitTimeMax) {
+    state->waitTimeMax = waitTime;
+  }
+
+  // Reconfiguring the peripheral is only needed when the speed changes
+  if (!isConfigured || baudRatePrescaler != configuredBaudRatePrescaler) {
+    spiConfigureWithSpeed(baudRatePrescaler);
+  }
+
+  return true;
+}
+
+static void updateStats(const uint64_t now)
+{
+  const uint64_t period = now - statsPeriodStart;
+  if (period < SPI_STATS_PERIOD_US) {
+    return;
+  }
+
+  for (int i = 0; i < SPI_CLIENT_COUNT; i++) {
+    spiClientState_t* state = &clients[i];
+    state->utilization = (uint64_t)state->busyTime * 1000 / period;
+    state->waitMax = (state->waitTimeMax > UINT16_MAX) ? UINT16_MAX : state->waitTimeMax;
+    state->busyTime = 0;
+    state->waitTimeMax = 0;
+  }
+
+  statsPeriodStart = now;
 }
 
 void spiEndTransaction()
 {
-  xSemaphoreGive(spiMutex);
+  const spiClient_t client = busOwner;
+  spiClientState_t* state = &clients[client];
+
+  const uint64_t now = usecTimestamp();
+  state->busyTime += now - state->transactionStart;
+  updateStats(now);
+
+  int next = -1;
+  taskENTER_CRITICAL();
+  for (int i = 0; i < SPI_CLIENT_COUNT; i++) {
+    if (clients[i].isWaiting && (next < 0 || clients[i].priority > clients[next].priority)) {
+      next = i;
+    }
+  }
+
+  if (next >= 0) {
+    clients[next].isWaiting = false;
+    busOwner = next;
+  } else {
+    isBusTaken = false;
+  }
+  taskEXIT_CRITICAL();
+
+  if (next >= 0) {
+    xSemaphoreGive(clients[next].grant);
+  }
+  xSemaphoreGive(state->mutex);
 }
 
 void __attribute__((used)) SPI_TX_DMA_IRQHandler(void)
@@ -323,3 +501,20 @@ void __attribute__((used)) SPI_RX_DMA_IRQHandler(void)
     portYIELD();
   }
 }
+
+/**
+ * Deck SPI bus usage per client. Utilization is the per mille of the bus time
+ * a client held the bus and wait max the longest time in us it waited for it,
+ * both over the last second.
+ */
+LOG_GROUP_START(spiBus)
+LOG_ADD(LOG_UINT16, locoUtil, &clients[spiClientLoco].utilization)
+LOG_ADD(LOG_UINT16, locoWait, &clients[spiClientLoco].waitMax)
+LOG_ADD(LOG_UINT16, flowUtil, &clients[spiClientFlow].utilization)
+LOG_ADD(LOG_UINT16, flowWait, &clients[spiClientFlow].waitMax)
+LOG_ADD(LOG_UINT16, usdUtil, &clients[spiClientUsd].utilization)
+LOG_ADD(LOG_UINT16, usdWait, &clients[spiClientUsd].waitMax)
+LOG_ADD(LOG_UINT16, otherUtil, &clients[spiClientOther].utilization)
+LOG_ADD(LOG_UINT16, otherWait, &clients[spiClientOther].waitMax)
+LOG_ADD(LOG_UINT32, timeouts, &timeouts)
+LOG_GROUP_STOP(spiBus)
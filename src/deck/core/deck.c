@@ -38,8 +38,6 @@
   #define DECK_CORE_DBG_PRINT(...)
 #endif
 
-extern void deckInfoInit();
-
 void deckInit()
 {
   deckDriverCount();
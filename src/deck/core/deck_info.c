@@ -34,6 +34,7 @@
 
 #include "ow.h"
 #include "crc32.h"
+#include "storage.h"
 #include "debug.h"
 #include "static_mem.h"
 
@@ -172,6 +173,61 @@ static bool infoDecode(DeckInfo * info)
 
   return true;
 }
+
+// The memory of the decks is cached in storage and only read over one wire
+// when the serial number of the memory has changed
+#define DECK_INFO_CACHE_KEY "deck/info/"
+
+typedef struct {
+  OwSerialNum serial;
+  uint8_t raw[sizeof(deckInfos[0].raw)];
+} __attribute__((packed)) deckInfoCache_t;
+
+_Static_assert(sizeof(deckInfos[0].raw) == OW_MAX_SIZE, "The deck info is the full one wire memory");
+
+static void generateCacheKey(char* key, const int deck)
+{
+  strcpy(key, DECK_INFO_CACHE_KEY);
+  const int len = strlen(key);
+  key[len] = '0' + deck;
+  key[len + 1] = '\0';
+}
+
+static bool readDeckMemory(const int deck, DeckInfo* info)
+{
+  static deckInfoCache_t cache;
+  char key[sizeof(DECK_INFO_CACHE_KEY) + 1];
+  generateCacheKey(key, deck);
+
+  OwSerialNum serial;
+  if (!owGetinfo(deck, &serial)) {
+    return owRead(deck, 0, sizeof(info->raw), info->raw);
+  }
+
+  if (storageFetch(key, &cache, sizeof(cache)) == sizeof(cache) &&
+      memcmp(&cache.serial, &serial, sizeof(serial)) == 0) {
+    memcpy(info->raw, cache.raw, sizeof(info->raw));
+    // Reads of the memory from clients are served from the one wire cache as well
+    owCacheSet(deck, cache.raw);
+    DECK_INFO_DBG_PRINT("Deck %i read from cache\n", deck);
+    return true;
+  }
+
+  if (!owRead(deck, 0, sizeof(info->raw), info->raw)) {
+    return false;
+  }
+
+  // Only cache memories that are valid
+  DeckInfo decoded;
+  memcpy(decoded.raw, info->raw, sizeof(decoded.raw));
+  if (infoDecode(&decoded)) {
+    cache.serial = serial;
+    memcpy(cache.raw, info->raw, sizeof(cache.raw));
+    storageStore(key, &cache, sizeof(cache));
+  }
+
+  return true;
+}
 #endif
 
 static void enumerateDecks(void)
@@ -194,7 +250,7 @@ static void enumerateDecks(void)
   for (int i = 0; i < nDecks; i++)
   {
     DECK_INFO_DBG_PRINT("Enumerating deck %i\n", i);
-    if (owRead(i, 0, sizeof(deckInfos[0].raw), (uint8_t *)&deckInfos[i]))
+    if (readDeckMemory(i, &deckInfos[i]))
     {
       if (infoDecode(&deckInfos[i]))
       {
@@ -0,0 +1,105 @@
+/*
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * aideck_link.h - Framed link between the GAP8 on the AI deck and the STM32
+ *
+ * The GAP8 sends frames on UART1:
+ *
+ *   0xBC 0xAD | channel (1) | length (2, LE) | payload (length) | CRC32 (4, LE)
+ *
+ * The CRC32 (zlib) covers the channel, length and payload. The STM32 sends
+ * frames in the same format on the control channel to pause the GAP8 while
+ * its buffers are full and to resume it.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AIDECK_LINK_MAX_PAYLOAD 256
+
+typedef enum {
+  // Flow control, from the STM32 to the GAP8, payload: aideckLinkControl_t
+  aideckLinkChannelControl = 0,
+  // A CRTP packet to send to the ground, payload: header byte and data
+  aideckLinkChannelCrtp = 1,
+  // Frames for the app layer, read with aideckLinkAppReceive()
+  aideckLinkChannelApp = 2,
+  // Measurements for the state estimator, payload: aideckLinkMeasurement_t
+  aideckLinkChannelEstimator = 3,
+  // Text for the console
+  aideckLinkChannelConsole = 4,
+  aideckLinkChannelCount,
+} aideckLinkChannel_t;
+
+typedef enum {
+  aideckLinkControlPause = 0,
+  aideckLinkControlResume = 1,
+} aideckLinkControl_t;
+
+typedef enum {
+  aideckLinkMeasurementPosition = 0,
+  aideckLinkMeasurementPose = 1,
+} aideckLinkMeasurementType_t;
+
+// Payload of the estimator channel, positions in meters in the global frame
+typedef struct {
+  uint8_t type;       // aideckLinkMeasurementType_t
+  uint16_t ageMs;     // time since the image was captured
+  float x;
+  float y;
+  float z;
+  float stdDevPos;
+  // Only used for aideckLinkMeasurementPose
+  float qx;
+  float qy;
+  float qz;
+  float qw;
+  float stdDevQuat;
+} __attribute__((packed)) aideckLinkMeasurement_t;
+
+/**
+ * Start the link, initializes UART1 and the receiving task
+ */
+void aideckLinkInit(void);
+
+/**
+ * Send a frame to the GAP8
+ *
+ * @param channel The channel of the frame
+ * @param data The payload
+ * @param length Length of the payload, at most AIDECK_LINK_MAX_PAYLOAD
+ * @return true if the frame was sent
+ */
+bool aideckLinkSend(const uint8_t channel, const void* data, const uint16_t length);
+
+/**
+ * Receive a frame that the GAP8 sent on the app channel
+ *
+ * @param buffer Destination of the payload
+ * @param maxLength Size of the buffer, longer payloads are cropped
+ * @param timeoutMs Time to wait for a frame, 0 does not wait
+ * @return The length of the payload, 0 if no frame was received
+ */
+uint16_t aideckLinkAppReceive(void* buffer, const uint16_t maxLength, const uint32_t timeoutMs);
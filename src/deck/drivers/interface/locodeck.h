@@ -117,6 +117,10 @@ typedef struct {
 // Function to be used by the LPS algorithm
 bool lpsGetLppShort(lpsLppShortPacket_t* shortPacket);
 
+// Report that a packet obtained with lpsGetLppShort() was dropped by the LPS algorithm without being sent,
+// used for the delivery statistics
+void lpsLppShortPacketDiscarded();
+
 uint16_t locoDeckGetRangingState();
 void locoDeckSetRangingState(const uint16_t newState);
 
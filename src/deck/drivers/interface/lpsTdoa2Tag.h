@@ -44,6 +44,9 @@ typedef struct {
 
 #define TDOA2_LPP_PACKET_SEND_TIMEOUT (LOCODECK_NR_OF_TDOA2_ANCHORS * 5)
 
+// Number of LPP packets waiting for their destination anchor at the same time
+#define TDOA2_LPP_PENDING_PACKETS 4
+
 #define TDOA2_RECEIVE_TIMEOUT 10000
 
 void lpsTdoa2TagSetOptions(lpsTdoa2AlgoOptions_t* newOptions);
@@ -22,6 +22,9 @@
 
 #define LPS_TWR_SEND_LPP_PAYLOAD 1
 
+// Max number of LPP packets sent back to back before a ranging is done
+#define LPS_TWR_LPP_BATCH_SIZE 4
+
 #ifdef LOCODECK_NR_OF_ANCHORS
 #define LOCODECK_NR_OF_TWR_ANCHORS LOCODECK_NR_OF_ANCHORS
 #else
@@ -30,6 +33,14 @@
 
 extern uwbAlgorithm_t uwbTwrTagAlgorithm;
 
+typedef enum {
+  // Range with all anchors in turn, with a fixed receive timeout
+  lpsTwrScheduleRoundRobin = 0,
+  // Skip anchors that do not respond (but probe them now and then), range more often with anchors where the distance
+  // changes quickly and adapt the receive timeout to the measured response times. Not used with TDMA.
+  lpsTwrScheduleAdaptive = 1,
+} lpsTwrSchedule_t;
+
 typedef struct {
   uint8_t pollRx[5];
   uint8_t answerTx[5];
@@ -55,6 +66,8 @@ typedef struct {
   // TWR-TDMA options
   bool useTdma;
   int tdmaSlot;
+
+  uint8_t schedule; // lpsTwrSchedule_t
 } lpsTwrAlgoOptions_t;
 
 
@@ -62,5 +75,8 @@ void uwbTwrTagSetOptions(lpsTwrAlgoOptions_t* newOptions);
 float lpsTwrTagGetDistance(const uint8_t anchorId);
 
 #define TWR_RECEIVE_TIMEOUT 1000
+// Limits for the receive timeout in the adaptive schedule
+#define TWR_MIN_RECEIVE_TIMEOUT 200
+#define TWR_RECEIVE_TIMEOUT_MARGIN 100
 
 #endif // __LPS_TWR_TAG_H__
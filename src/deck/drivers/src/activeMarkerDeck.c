@@ -28,6 +28,7 @@
 #include "stm32fxxx.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
 #include "system.h"
 #include "deck.h"
@@ -46,8 +47,9 @@
 #define MEM_ADR_BUTTON_SENSOR 0x02
 #define MEM_ADR_VER 0x10
 
-#define DEFAULT_UPDATE_PERIOD_MS 1000
+#define RETRY_UPDATE_PERIOD_MS 1000
 #define POLL_UPDATE_PERIOD_MS 10
+#define UPDATE_TIMEOUT M2T(10)
 
 static bool isInit = false;
 static bool isVerified = false;
@@ -73,6 +75,15 @@ static uint32_t nextPollTime = 0;
 static const uint32_t pollIntervall = M2T(100);
 static bool i2cOk = false;
 
+static TaskHandle_t taskHandle;
+
+// Changed marker state is written to the deck in one transfer, the id and mode messages back to back
+static I2cMessage updateMessages[2];
+static I2cTransfer updateTransfer;
+static SemaphoreHandle_t updateDone;
+static StaticSemaphore_t updateDoneBuffer;
+static bool isUpdateFailed = false;
+
 // defines eventTrigger_activeMarkerModeChanged
 EVENTTRIGGER(activeMarkerModeChanged, uint8, mode)
 
@@ -100,8 +111,9 @@ static void activeMarkerDeckInit(DeckInfo *info) {
     return;
   }
 
+  updateDone = xSemaphoreCreateBinaryStatic(&updateDoneBuffer);
   xTaskCreate(task, "activeMarkerDeck",
-              configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+              configMINIMAL_STACK_SIZE, NULL, 3, &taskHandle);
 
 #ifndef ACTIVE_MARKER_DECK_TEST
   memset(versionString, 0, VERSION_STRING_LEN + 1);
@@ -136,25 +148,54 @@ static bool activeMarkerDeckTest() {
   return isVerified;
 }
 
-static void handleIdUpdate() {
-  bool isDifferent = false;
+static void updateDoneCallback(I2cTransfer *transfer, bool success) {
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  xSemaphoreGiveFromISR(updateDone, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void handleMarkerUpdate() {
+  int messageCount = 0;
+
+  bool isIdChanged = isUpdateFailed;
   for (int led = 0; led < LED_COUNT; led++) {
     if (currentId[led] != requestedId[led]) {
-      isDifferent = true;
+      isIdChanged = true;
       currentId[led] = requestedId[led];
     }
   }
-
-  if (isDifferent) {
-      i2cdevWriteReg8(I2C1_DEV, DECK_I2C_ADDRESS, MEM_ADR_LED, LED_COUNT, currentId);
+  if (isIdChanged) {
+    i2cdrvCreateMessageIntAddr(&updateMessages[messageCount++], DECK_I2C_ADDRESS, false, MEM_ADR_LED, i2cWrite, LED_COUNT, currentId);
   }
-}
 
-static void handleModeUpdate() {
-  if (currentDeckMode != requestedDeckMode) {
+  bool isModeChanged = false;
+  if (deckFwVersion >= version_1_0 && (currentDeckMode != requestedDeckMode || isUpdateFailed)) {
+    isModeChanged = (currentDeckMode != requestedDeckMode);
     currentDeckMode = requestedDeckMode;
-    i2cdevWriteReg8(I2C1_DEV, DECK_I2C_ADDRESS, MEM_ADR_MODE, 1, &currentDeckMode);
+    i2cdrvCreateMessageIntAddr(&updateMessages[messageCount++], DECK_I2C_ADDRESS, false, MEM_ADR_MODE, i2cWrite, 1, &currentDeckMode);
+  }
+
+  if (messageCount == 0) {
+    return;
+  }
+
+  updateTransfer.messages = updateMessages;
+  updateTransfer.nbrOfMessages = messageCount;
+  updateTransfer.priority = i2cPriorityNormal;
+  updateTransfer.callback = updateDoneCallback;
+  updateTransfer.callbackArg = NULL;
+
+  xSemaphoreTake(updateDone, 0);
+  i2cdrvSubmitTransfer(I2C1_DEV, &updateTransfer);
+  if (xSemaphoreTake(updateDone, UPDATE_TIMEOUT) != pdTRUE) {
+    i2cdrvCancelTransfer(I2C1_DEV, &updateTransfer);
+  }
 
+  // A failed update is written again, all of it, after RETRY_UPDATE_PERIOD_MS
+  i2cOk = updateTransfer.isDone && updateTransfer.isSuccess;
+  isUpdateFailed = !i2cOk;
+
+  if (isModeChanged) {
     eventTrigger_activeMarkerModeChanged_payload.mode = currentDeckMode;
     eventTrigger(&eventTrigger_activeMarkerModeChanged);
   }
@@ -182,22 +223,29 @@ static void task(void *param) {
 
   while (1) {
     if (isVerified) {
-      handleIdUpdate();
+      handleMarkerUpdate();
 
       if (deckFwVersion >= version_1_0) {
-        handleModeUpdate();
         handleButtonSensorRead();
       }
     }
 
-    int delay = DEFAULT_UPDATE_PERIOD_MS;
+    // Woken up by changes of the marker parameters
+    TickType_t timeout = portMAX_DELAY;
     if (doPollDeckButtonSensor) {
-      delay = POLL_UPDATE_PERIOD_MS;
+      timeout = M2T(POLL_UPDATE_PERIOD_MS);
+    } else if (isUpdateFailed) {
+      timeout = M2T(RETRY_UPDATE_PERIOD_MS);
     }
 
-    vTaskDelay(M2T(delay));
+    ulTaskNotifyTake(pdTRUE, timeout);
+  }
+}
+
+static void markerParamChanged(void) {
+  if (taskHandle) {
+    xTaskNotifyGive(taskHandle);
   }
-  
 }
 
 static const DeckDriver deck_info = {
@@ -212,12 +260,12 @@ static const DeckDriver deck_info = {
 DECK_DRIVER(deck_info);
 
 PARAM_GROUP_START(activeMarker)
-PARAM_ADD(PARAM_UINT8, front, &requestedId[0])
-PARAM_ADD(PARAM_UINT8, back, &requestedId[1])
-PARAM_ADD(PARAM_UINT8, left, &requestedId[2])
-PARAM_ADD(PARAM_UINT8, right, &requestedId[3])
-PARAM_ADD(PARAM_UINT8, mode, &requestedDeckMode)
-PARAM_ADD(PARAM_UINT8, poll, &doPollDeckButtonSensor)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, front, &requestedId[0], markerParamChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, back, &requestedId[1], markerParamChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, left, &requestedId[2], markerParamChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, right, &requestedId[3], markerParamChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, mode, &requestedDeckMode, markerParamChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, poll, &doPollDeckButtonSensor, markerParamChanged)
 
 #ifdef ACTIVE_MARKER_DECK_TEST
 PARAM_ADD(PARAM_UINT8, canStart, &activeMarkerDeckCanStart)
@@ -46,9 +46,9 @@
 #include "system.h"
 #include "uart1.h"
 #include "uart2.h"
+#include "aideck_link.h"
 
 static bool isInit = false;
-static uint8_t byte;
 
 //Uncomment when NINA printout read is desired from console
 //#define DEBUG_NINA_PRINT
@@ -80,36 +80,14 @@ static void NinaTask(void *param)
 }
 #endif
 
-static void Gap8Task(void *param)
-{
-    systemWaitStart();
-    vTaskDelay(M2T(1000));
-
-    // Pull the reset button to get a clean read out of the data
-    pinMode(DECK_GPIO_IO4, OUTPUT);
-    digitalWrite(DECK_GPIO_IO4, LOW);
-    vTaskDelay(10);
-    digitalWrite(DECK_GPIO_IO4, HIGH);
-    pinMode(DECK_GPIO_IO4, INPUT_PULLUP);
-
-    // Read out the byte the Gap8 sends and immediately send it to the console.
-    while (1)
-    {
-        uart1GetDataWithDefaultTimeout(&byte);
-    }
-}
-
 static void aideckInit(DeckInfo *info)
 {
 
     if (isInit)
         return;
 
-    // Intialize the UART for the GAP8
-    uart1Init(115200);
-    // Initialize task for the GAP8
-    xTaskCreate(Gap8Task, AI_DECK_GAP_TASK_NAME, AI_DECK_TASK_STACKSIZE, NULL,
-                AI_DECK_TASK_PRI, NULL);
+    // Initialize the framed link to the GAP8
+    aideckLinkInit();
 
 #ifdef DEBUG_NINA_PRINT
     // Initialize the UART for the NINA
@@ -141,10 +119,6 @@ static const DeckDriver aideck_deck = {
     .test = aideckTest,
 };
 
-LOG_GROUP_START(aideck)
-LOG_ADD(LOG_UINT8, receivebyte, &byte)
-LOG_GROUP_STOP(aideck)
-
 PARAM_GROUP_START(deck)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, bcAIDeck, &isInit)
 PARAM_GROUP_STOP(deck)
@@ -0,0 +1,423 @@
+/*
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * aideck_link.c - Framed link between the GAP8 on the AI deck and the STM32
+ */
+#define DEBUG_MODULE "AILINK"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "config.h"
+#include "debug.h"
+#include "system.h"
+#include "deck.h"
+#include "uart1.h"
+#include "crc32.h"
+#include "crtp.h"
+#include "console.h"
+#include "estimator.h"
+#include "static_mem.h"
+#include "log.h"
+#include "aideck_link.h"
+
+#ifndef AIDECK_LINK_BAUDRATE
+#define AIDECK_LINK_BAUDRATE 115200
+#endif
+
+#define SYNC0 0xBC
+#define SYNC1 0xAD
+#define HEADER_SIZE 5
+#define CRC_SIZE 4
+
+#define RX_CHUNK_SIZE 64
+#define RX_TIMEOUT M2T(100)
+
+// The control state is sent again at this interval, in case a frame was lost
+#define CONTROL_RESEND_INTERVAL M2T(500)
+
+// Free CRTP packets left for the other ports before the GAP8 is paused
+#define CRTP_TX_RESERVE 4
+
+#define APP_QUEUE_LENGTH 4
+
+// Chunks that are sent with one UART DMA transfer
+#define TX_CHUNK_SIZE 64
+
+typedef enum {
+  stateSync0,
+  stateSync1,
+  stateHeader,
+  statePayload,
+  stateCrc,
+} parserState_t;
+
+typedef struct {
+  uint16_t length;
+  uint8_t data[AIDECK_LINK_MAX_PAYLOAD];
+} appFrame_t;
+
+static struct {
+  parserState_t state;
+  uint16_t index;
+  uint8_t header[HEADER_SIZE];
+  uint16_t length;
+  uint8_t crc[CRC_SIZE];
+} parser;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static appFrame_t rxFrame;
+static uint8_t rxChunk[RX_CHUNK_SIZE];
+static uint8_t lastByte;
+
+STATIC_MEM_QUEUE_ALLOC(aideckAppQueue, APP_QUEUE_LENGTH, sizeof(appFrame_t));
+static xQueueHandle appQueue;
+
+static xSemaphoreHandle txMutex;
+static StaticSemaphore_t txMutexBuffer;
+
+static bool isPaused;
+static TickType_t lastControlSent;
+
+// Statistics
+static uint32_t frameCount;
+static uint32_t crcErrorCount;
+static uint32_t dropCount;
+static uint32_t overrunCount;
+static uint32_t byteCount;
+
+STATIC_MEM_TASK_ALLOC(aideckLinkTask, AI_DECK_LINK_TASK_STACKSIZE);
+static void aideckLinkTask(void *param);
+
+
+void aideckLinkInit(void)
+{
+  uart1Init(AIDECK_LINK_BAUDRATE);
+  uart1InitRxDma();
+
+  appQueue = STATIC_MEM_QUEUE_CREATE(aideckAppQueue);
+  txMutex = xSemaphoreCreateMutexStatic(&txMutexBuffer);
+
+  STATIC_MEM_TASK_CREATE(aideckLinkTask, aideckLinkTask, AI_DECK_GAP_TASK_NAME, NULL, AI_DECK_TASK_PRI);
+}
+
+static void uartSend(const uint8_t* data, uint32_t length)
+{
+#ifdef ENABLE_UART1_DMA
+  // The DMA transfer is done from a buffer of TX_CHUNK_SIZE bytes in the driver
+  while (length > 0) {
+    const uint32_t count = length < TX_CHUNK_SIZE ? length : TX_CHUNK_SIZE;
+    uart1SendDataDmaBlocking(count, (uint8_t*)data);
+    data += count;
+    length -= count;
+  }
+#else
+  uart1SendData(length, (uint8_t*)data);
+#endif
+}
+
+bool aideckLinkSend(const uint8_t channel, const void* data, const uint16_t length)
+{
+  if (length > AIDECK_LINK_MAX_PAYLOAD) {
+    return false;
+  }
+
+  const uint8_t header[HEADER_SIZE] = {SYNC0, SYNC1, channel, length & 0xff, length >> 8};
+
+  crc32Context_t crcContext;
+  crc32ContextInit(&crcContext);
+  crc32Update(&crcContext, &header[2], HEADER_SIZE - 2);
+  crc32Update(&crcContext, data, length);
+  const uint32_t crc = crc32Out(&crcContext);
+  const uint8_t crcBytes[CRC_SIZE] = {crc & 0xff, (crc >> 8) & 0xff, (crc >> 16) & 0xff, crc >> 24};
+
+  xSemaphoreTake(txMutex, portMAX_DELAY);
+  uartSend(header, HEADER_SIZE);
+  uartSend(data, length);
+  uartSend(crcBytes, CRC_SIZE);
+  xSemaphoreGive(txMutex);
+
+  return true;
+}
+
+uint16_t aideckLinkAppReceive(void* buffer, const uint16_t maxLength, const uint32_t timeoutMs)
+{
+  static appFrame_t frame;
+
+  if (xQueueReceive(appQueue, &frame, M2T(timeoutMs)) != pdTRUE) {
+    return 0;
+  }
+
+  const uint16_t length = frame.length < maxLength ? frame.length : maxLength;
+  memcpy(buffer, frame.data, length);
+  return length;
+}
+
+static void handleCrtp(const appFrame_t* frame)
+{
+  CRTPPacket packet;
+
+  if (frame->length < 1 || frame->length > CRTP_MAX_DATA_SIZE + 1) {
+    dropCount++;
+    return;
+  }
+
+  packet.header = frame->data[0];
+  packet.size = frame->length - 1;
+  memcpy(packet.data, &frame->data[1], packet.size);
+
+  if (crtpSendPacket(&packet) != pdTRUE) {
+    dropCount++;
+  }
+}
+
+static void handleEstimator(const appFrame_t* frame)
+{
+  aideckLinkMeasurement_t measurement;
+
+  if (frame->length < sizeof(measurement)) {
+    dropCount++;
+    return;
+  }
+
+  memcpy(&measurement, frame->data, sizeof(measurement));
+  const uint32_t captureTick = xTaskGetTickCount() - M2T(measurement.ageMs);
+
+  switch (measurement.type) {
+    case aideckLinkMeasurementPosition:
+      {
+        positionMeasurement_t position = {
+          .x = measurement.x,
+          .y = measurement.y,
+          .z = measurement.z,
+          .stdDev = measurement.stdDevPos,
+          .source = MeasurementSourceLocationService,
+        };
+        estimatorEnqueuePositionCapturedAt(&position, captureTick);
+      }
+      break;
+    case aideckLinkMeasurementPose:
+      {
+        poseMeasurement_t pose = {
+          .x = measurement.x,
+          .y = measurement.y,
+          .z = measurement.z,
+          .quat.x = measurement.qx,
+          .quat.y = measurement.qy,
+          .quat.z = measurement.qz,
+          .quat.w = measurement.qw,
+          .stdDevPos = measurement.stdDevPos,
+          .stdDevQuat = measurement.stdDevQuat,
+        };
+        estimatorEnqueuePoseCapturedAt(&pose, captureTick);
+      }
+      break;
+    default:
+      dropCount++;
+      break;
+  }
+}
+
+static void handleFrame(const uint8_t channel, const appFrame_t* frame)
+{
+  frameCount++;
+
+  switch (channel) {
+    case aideckLinkChannelCrtp:
+      handleCrtp(frame);
+      break;
+    case aideckLinkChannelApp:
+      if (xQueueSend(appQueue, frame, 0) != pdTRUE) {
+        dropCount++;
+      }
+      break;
+    case aideckLinkChannelEstimator:
+      handleEstimator(frame);
+      break;
+    case aideckLinkChannelConsole:
+      consoleWrite((const char*)frame->data, frame->length);
+      break;
+    default:
+      dropCount++;
+      break;
+  }
+}
+
+static bool isCrcValid(void)
+{
+  crc32Context_t crcContext;
+  crc32ContextInit(&crcContext);
+  crc32Update(&crcContext, &parser.header[2], HEADER_SIZE - 2);
+  crc32Update(&crcContext, rxFrame.data, parser.length);
+  const uint32_t crc = crc32Out(&crcContext);
+
+  const uint32_t received = parser.crc[0] | (parser.crc[1] << 8) | (parser.crc[2] << 16) | ((uint32_t)parser.crc[3] << 24);
+  return crc == received;
+}
+
+static void parse(const uint8_t* data, const uint32_t length)
+{
+  for (uint32_t i = 0; i < length; i++) {
+    const uint8_t byte = data[i];
+
+    switch (parser.state) {
+      case stateSync0:
+        if (byte == SYNC0) {
+          parser.header[0] = byte;
+          parser.state = stateSync1;
+        }
+        break;
+      case stateSync1:
+        if (byte == SYNC1) {
+          parser.header[1] = byte;
+          parser.index = 2;
+          parser.state = stateHeader;
+        } else if (byte != SYNC0) {
+          parser.state = stateSync0;
+        }
+        break;
+      case stateHeader:
+        parser.header[parser.index++] = byte;
+        if (parser.index == HEADER_SIZE) {
+          parser.length = parser.header[3] | (parser.header[4] << 8);
+          parser.index = 0;
+          if (parser.length > AIDECK_LINK_MAX_PAYLOAD) {
+            crcErrorCount++;
+            parser.state = stateSync0;
+          } else {
+            parser.state = parser.length > 0 ? statePayload : stateCrc;
+          }
+        }
+        break;
+      case statePayload:
+        {
+          // Copy as much of the payload as is available in one go
+          uint32_t count = parser.length - parser.index;
+          if (count > length - i) {
+            count = length - i;
+          }
+          memcpy(&rxFrame.data[parser.index], &data[i], count);
+          parser.index += count;
+          i += count - 1;
+          if (parser.index == parser.length) {
+            parser.index = 0;
+            parser.state = stateCrc;
+          }
+        }
+        break;
+      case stateCrc:
+        parser.crc[parser.index++] = byte;
+        if (parser.index == CRC_SIZE) {
+          if (isCrcValid()) {
+            rxFrame.length = parser.length;
+            handleFrame(parser.header[2], &rxFrame);
+          } else {
+            crcErrorCount++;
+          }
+          parser.state = stateSync0;
+        }
+        break;
+    }
+  }
+}
+
+// Pauses the GAP8 while the frames it sends can not be taken care of
+static void updateFlowControl(void)
+{
+  const bool shallPause = uxQueueSpacesAvailable(appQueue) == 0
+      || crtpGetFreeTxQueuePackets() <= CRTP_TX_RESERVE;
+
+  const TickType_t now = xTaskGetTickCount();
+  if (shallPause != isPaused || (now - lastControlSent) >= CONTROL_RESEND_INTERVAL) {
+    const uint8_t control = shallPause ? aideckLinkControlPause : aideckLinkControlResume;
+    aideckLinkSend(aideckLinkChannelControl, &control, sizeof(control));
+    isPaused = shallPause;
+    lastControlSent = now;
+  }
+}
+
+static void aideckLinkTask(void *param)
+{
+  systemWaitStart();
+  vTaskDelay(M2T(1000));
+
+  // Pull the reset button to get a clean start of the GAP8
+  pinMode(DECK_GPIO_IO4, OUTPUT);
+  digitalWrite(DECK_GPIO_IO4, LOW);
+  vTaskDelay(10);
+  digitalWrite(DECK_GPIO_IO4, HIGH);
+  pinMode(DECK_GPIO_IO4, INPUT_PULLUP);
+
+  while (1) {
+    const uint32_t length = uart1GetBytesWithTimeout(rxChunk, sizeof(rxChunk), RX_TIMEOUT);
+    if (length > 0) {
+      byteCount += length;
+      lastByte = rxChunk[length - 1];
+      parse(rxChunk, length);
+    }
+
+    if (uart1DidOverrun()) {
+      overrunCount++;
+    }
+
+    updateFlowControl();
+  }
+}
+
+/**
+ * Statistics of the link to the GAP8 on the AI deck
+ */
+LOG_GROUP_START(aideck)
+/**
+ * @brief The latest byte received from the GAP8
+ */
+LOG_ADD(LOG_UINT8, receivebyte, &lastByte)
+/**
+ * @brief Number of bytes received from the GAP8
+ */
+LOG_ADD(LOG_UINT32, bytes, &byteCount)
+/**
+ * @brief Number of valid frames received
+ */
+LOG_ADD(LOG_UINT32, frames, &frameCount)
+/**
+ * @brief Number of frames with a bad CRC or length
+ */
+LOG_ADD(LOG_UINT32, crcErrors, &crcErrorCount)
+/**
+ * @brief Number of valid frames that could not be delivered
+ */
+LOG_ADD(LOG_UINT32, drops, &dropCount)
+/**
+ * @brief Number of times the UART overran
+ */
+LOG_ADD(LOG_UINT32, overruns, &overrunCount)
+/**
+ * @brief Nonzero while the GAP8 is paused by flow control
+ */
+LOG_ADD(LOG_UINT8, paused, &isPaused)
+LOG_GROUP_STOP(aideck)
@@ -47,6 +47,10 @@
 #define BIGQUAD_BAT_CURR_PIN       DECK_GPIO_SCK
 #define BIGQUAD_BAT_AMP_PER_VOLT   1.0f
 
+// Rate the MSP responses are recomputed at, the OSD can poll faster
+#define BQ_OSD_UPDATE_PERIOD       M2T(100)
+#define BQ_OSD_RX_CHUNK_SIZE       16
+
 #ifdef ENABLE_BQ_DECK
 
 //Hardware configuration
@@ -57,18 +61,33 @@ static MspObject s_MspObject;
 
 static void osdTask(void *param)
 {
+  uint8_t rxData[BQ_OSD_RX_CHUNK_SIZE];
+  TickType_t nextUpdate = xTaskGetTickCount();
+
   while(1)
   {
-    char ch;
-    uart1Getchar(&ch);
-
-    mspProcessByte(&s_MspObject, (uint8_t)ch);
+    const TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(now - nextUpdate) >= 0)
+    {
+      mspUpdate(&s_MspObject);
+      nextUpdate = now + BQ_OSD_UPDATE_PERIOD;
+    }
+
+    const uint32_t count = uart1GetBytesWithTimeout(rxData, sizeof(rxData), nextUpdate - now);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      mspProcessByte(&s_MspObject, rxData[i]);
+    }
   }
 }
 
 static void osdResponseCallback(uint8_t* pBuffer, uint32_t bufferLen)
 {
+#ifdef ENABLE_UART1_DMA
+  uart1SendDataDmaBlocking(bufferLen, pBuffer);
+#else
   uart1SendData(bufferLen, pBuffer);
+#endif
 }
 #endif // BQ_DECK_ENABLE_OSD
 
@@ -89,6 +108,7 @@ static void bigquadInit(DeckInfo *info)
 
 #ifdef BQ_DECK_ENABLE_OSD
   uart1Init(115200);
+  uart1InitRxDma();
   mspInit(&s_MspObject, osdResponseCallback);
   xTaskCreate(osdTask, BQ_OSD_TASK_NAME,
               configMINIMAL_STACK_SIZE, NULL, BQ_OSD_TASK_PRI, NULL);
@@ -36,11 +36,11 @@
 
 #include "stabilizer_types.h"
 #include "estimator.h"
-#include "estimator.h"
 
 #include "cf_math.h"
 
 #include "usec_time.h"
+#include "rateSupervisor.h"
 #include <stdlib.h>
 
 #define AVERAGE_HISTORY_LENGTH 4
@@ -62,6 +62,7 @@ float dpixely_previous = 0;
 
 static uint8_t outlierCount = 0;
 static float stdFlow = 2.0f;
+static uint32_t flowIntegrationTimeUs = 0;
 
 static bool isInit1 = false;
 static bool isInit2 = false;
@@ -80,16 +81,32 @@ static float flowStdFixed = 2.0f;
 
 #define NCS_PIN DECK_GPIO_IO3
 
+#define FLOW_READ_INTERVAL M2T(10)
+// Allowed deviation of the read rate [1/1000]
+#define FLOW_RATE_TOLERANCE 50
+
+static rateSupervisor_t rateSupervisorContext;
+
 
 static void flowdeckTask(void *param)
 {
   systemWaitStart();
 
-  uint64_t lastTime  = usecTimestamp();
+  TickType_t lastWakeTime = xTaskGetTickCount();
+  pmw3901ReadMotion(NCS_PIN, &currentMotion);
+  uint64_t lastReadTime = usecTimestamp();
+  rateSupervisorInitRate(&rateSupervisorContext, T2M(lastWakeTime), 1000 / T2M(FLOW_READ_INTERVAL), FLOW_RATE_TOLERANCE, 1);
+  rateSupervisorRegister(&rateSupervisorContext, "flow");
   while(1) {
-    vTaskDelay(10);
+    vTaskDelayUntil(&lastWakeTime, FLOW_READ_INTERVAL);
 
+    // The sensor clears the accumulated motion when it is read, the pixels were integrated between the two reads
     pmw3901ReadMotion(NCS_PIN, &currentMotion);
+    const uint64_t readTime = usecTimestamp();
+    const uint32_t integrationTimeUs = (uint32_t)(readTime - lastReadTime);
+    lastReadTime = readTime;
+    flowIntegrationTimeUs = integrationTimeUs;
+    rateSupervisorTick(&rateSupervisorContext, T2M(xTaskGetTickCount()), (uint32_t)readTime);
 
     // Flip motion information to comply with sensor mounting
     // (might need to be changed if mounted differently)
@@ -120,7 +137,7 @@ static void flowdeckTask(void *param)
     flowMeasurement_t flowData;
     flowData.stdDevX = stdFlow;    
     flowData.stdDevY = stdFlow;    
-    flowData.dt = 0.01;
+    flowData.dt = integrationTimeUs / 1000000.0f;
 
 #if defined(USE_MA_SMOOTHING)
       // Use MA Smoothing
@@ -151,9 +168,9 @@ static void flowdeckTask(void *param)
       // Push measurements into the estimator if flow is not disabled
       //    and the PMW flow sensor indicates motion detection
       if (!useFlowDisabled && currentMotion.motion == 0xB0) {
-        flowData.dt = (float)(usecTimestamp()-lastTime)/1000000.0f;
-        lastTime = usecTimestamp();
-        estimatorEnqueueFlow(&flowData);
+        // The flow is the average over the integration interval, it is fused at the middle of it
+        const uint32_t captureTick = xTaskGetTickCount() - (uint32_t)M2T(integrationTimeUs / 2000);
+        estimatorEnqueueFlowCapturedAt(&flowData, captureTick);
       }
     } else {
       outlierCount++;
@@ -262,8 +279,14 @@ LOG_ADD(LOG_UINT8, Rawsum, &currentMotion.rawDataSum)
 LOG_ADD(LOG_UINT8, outlierCount, &outlierCount)
 LOG_ADD(LOG_UINT8, squal, &currentMotion.squal)
 LOG_ADD(LOG_FLOAT, std, &stdFlow)
+LOG_ADD(LOG_UINT32, dtUs, &flowIntegrationTimeUs)
 LOG_GROUP_STOP(motion)
 
+/**
+ * Rate of the flow sensor reads, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateFlow, rateSupervisorContext)
+
 PARAM_GROUP_START(motion)
 PARAM_ADD(PARAM_UINT8, disable, &useFlowDisabled)
 PARAM_ADD(PARAM_UINT8, adaptive, &useAdaptiveStd)
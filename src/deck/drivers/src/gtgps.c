@@ -27,7 +27,7 @@
 
 #include <stdint.h>
 #include <string.h>
-#include <stdio.h>
+#include <math.h>
 
 #include "stm32fxxx.h"
 #include "config.h"
@@ -37,238 +37,117 @@
 #include "deck.h"
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
-#include <string.h>
-#include <stdlib.h>
-#include <math.h>
 #include "log.h"
 #include "param.h"
+#include "nmea.h"
+#include "estimator.h"
+#include "static_mem.h"
 
-static bool isInit;
-
-#define LEN_TOKEN 5
-#define MAX_LEN_SENTANCE 100
-char buff[MAX_LEN_SENTANCE];
-uint8_t bi;
-
-typedef bool (*SentanceParser)(char * buff);
-
-typedef struct {
-  const char * token;
-  SentanceParser parser;
-} ParserConfig;
-
-typedef enum {
-  FixNone = 1,
-  Fix2D = 2,
-  Fix3D = 3
-} FixQuality;
-
-typedef enum {
-  NoFix = 1,
-  GPSFix = 2
-} FixType;
-
-typedef enum {FIELD_COORD, FIELD_FLOAT, FIELD_INT} FieldType;
-
-typedef struct {
-  FixQuality fix;
-  uint32_t locks[12];
-  float pdop;
-  float hdop;
-  float vdop;
-} Basic;
-
-typedef struct {
-  uint32_t fixtime;
-  int32_t latitude;
-  int32_t longitude;
-  FixType fixtype;
-  uint32_t nsat;
-  float hdop;
-  float alt;
-  float height;
-} MeasData;
-
-static Basic b;
-static MeasData m;
-
-// Only use on 0-terminated strings!
-static int skip_to_next(char ** sp, const char ch) {
-  int steps=0;
-  while (ch != 0 && (**sp) != ch) {
-    (*sp)++;
-    steps++;
-  }
-  if (ch != 0)
-    (*sp)++;
-  return (ch != 0 ? steps : -1);
-}
+// The update rate of the receiver, 5 or 10 Hz
+#ifndef GTGPS_UPDATE_RATE_HZ
+#define GTGPS_UPDATE_RATE_HZ 10
+#endif
 
-static int32_t parse_coordinate(char ** sp) {
-  int32_t dm;
-  int32_t degree;
-  int32_t minute;
-  int32_t second;
-  int32_t ret;
-  char * i;
-  char * j;
-
-  // Format as DDDMM.SSSS converted by long or lat = DDD + MM / 100 + SSSS/3600
-  // To avoid inaccuracy caused by float representation save this value as
-  // a large number * 10 M
-
-  // 32 18.0489 N = 32 degrees + 18.0489 / 60 = 32.300815 N
-  dm = strtol(*sp, &i, 10);
-  degree = (dm / 100) * 10000000;
-  minute = ((dm % 100) * 10000000) / 60;
-  second = (strtol(i+1, &j, 10) * 1000) / 60;
-  ret = degree + minute + second;
-  skip_to_next(sp, ',');
-  if (**sp == 'S' || **sp == 'W')
-    ret *= -1;
-  return ret;
-}
+#define RX_CHUNK_SIZE 64
+#define RX_TIMEOUT M2T(200)
 
-static float parse_float(char * sp) {
-  float ret = 0;
-  int major = 0;
-  int minor = 0;
-  int deci_nbr = 0;
-  char * i;
-  char * j;
-
-  major = strtol(sp, &i, 10);
-  // Do decimals
-  if (strncmp(i, ".", 1) == 0) {
-    minor = strtol(i+1, &j, 10);
-    deci_nbr = j - i - 1;
-  }
-  ret = (major * pow(10, deci_nbr) + minor) / pow(10, deci_nbr);
-  //printf("%i.%i == %f (%i) (%c)\n", major, minor, ret, deci_nbr, (int) *i);
-  return ret;
-}
+#define EARTH_RADIUS 6371000.0f
+#define DEG_E7_TO_RAD (3.14159265358979f / 180.0f / 10000000.0f)
 
-static void parse_next(char ** sp, FieldType t, void * value) {
-  skip_to_next(sp, ',');
-  //DEBUG_PRINT("[%s]\n", (*sp));
-  switch (t) {
-    case FIELD_INT:
-      *((uint32_t*) value) = strtol(*sp, 0, 10);
-      break;
-    case FIELD_FLOAT:
-      *((float*) value) = parse_float(*sp);
-      break;
-    case FIELD_COORD:
-      *((int32_t*) value) = parse_coordinate(sp);
-  }
-}
-
-static bool gpgsaParser(char * buff) {
-  int i = 0;
-  char * sp = buff;
+static bool isInit;
 
-  // Skip leading A/M
-  skip_to_next(&sp, ',');
+static nmeaParser_t parser;
+static uint8_t rxChunk[RX_CHUNK_SIZE];
 
-  parse_next(&sp, FIELD_INT, &b.fix);
-  for (i = 0; i < 12; i++) {
-    parse_next(&sp, FIELD_INT, &b.locks[i]);
-  }
-  parse_next(&sp, FIELD_FLOAT, &b.pdop);
-  parse_next(&sp, FIELD_FLOAT, &b.hdop);
-  parse_next(&sp, FIELD_FLOAT, &b.vdop);
+// The position of the first 3D fix, the origin of the local frame
+static bool hasOrigin;
+static int32_t originLatitude;
+static int32_t originLongitude;
+static float originAltitude;
+static float originCosLatitude;
 
-  //dbg_print_basic(&b);
-  return false;
-}
+static positionMeasurement_t position;
+static uint32_t fixCount;
 
-static bool gpggaParser(char * buff) {
-  char * sp = buff;
-
-  parse_next(&sp, FIELD_INT, &m.fixtime);
-  parse_next(&sp, FIELD_COORD, &m.latitude);
-  parse_next(&sp, FIELD_COORD, &m.longitude);
-  parse_next(&sp, FIELD_INT, &m.fixtype);
-  parse_next(&sp, FIELD_INT, &m.nsat);
-  parse_next(&sp, FIELD_FLOAT, &m.hdop);
-  parse_next(&sp, FIELD_FLOAT, &m.alt);
-  skip_to_next(&sp, ',');
-  // Unit for altitude (not used yet)
-  parse_next(&sp, FIELD_FLOAT, &m.height);
-  skip_to_next(&sp, ',');
-  // Unit for height (not used yet)
-  skip_to_next(&sp, ',');
-  //consolePutchar('.');
-  //consoleFlush();
-  return false;
-}
+// Parameters
+static uint8_t useEstimator = 1;
+static float uere = 3.0f;
+static uint8_t echo = 0;
 
-static ParserConfig parsers[] = {
-  {.token = "GPGSA", .parser = gpgsaParser},
-  {.token = "GPGGA", .parser = gpggaParser}
-};
-
-static bool verifyChecksum(const char * buff) {
-  uint8_t test_chksum = 0;
-  uint32_t ref_chksum = 0;
-  uint8_t i = 0;
-  while (buff[i] != '*' && i < MAX_LEN_SENTANCE-3) {
-    test_chksum ^= buff[i++];
-  }
-  ref_chksum = strtol(&buff[i+1], 0, 16);
-
-  return (test_chksum == ref_chksum);
-}
+STATIC_MEM_TASK_ALLOC(gtgpsTask, GTGPS_DECK_TASK_STACKSIZE);
 
 static uint8_t baudcmd[] = "$PMTK251,115200*1F\r\n";
 
-// 5 Hz
+#if GTGPS_UPDATE_RATE_HZ == 10
+static uint8_t updaterate[] = "$PMTK220,100*2F\r\n";
+static uint8_t updaterate2[] = "$PMTK300,100,0,0,0,0*2C\r\n";
+#else
 static uint8_t updaterate[] = "$PMTK220,200*2C\r\n";
 static uint8_t updaterate2[] = "$PMTK300,200,0,0,0,0*2F\r\n";
+#endif
 
-// 10 Hz
-//static uint8_t updaterate3[] = "$PMTK220,100*2F\r\n";
-//static uint8_t updaterate4[] = "$PMTK300,100,0,0,0,0*2C\r\n";
+// Converts a fix to the local east, north, up frame and passes it to the estimator
+static void handleFix(const nmeaGga_t* gga, const uint32_t captureTick)
+{
+  if (gga->fixQuality == 0 || parser.gsa.fix != 3) {
+    return;
+  }
+
+  if (!hasOrigin) {
+    originLatitude = gga->latitude;
+    originLongitude = gga->longitude;
+    originAltitude = gga->altitude;
+    originCosLatitude = cosf(originLatitude * DEG_E7_TO_RAD);
+    hasOrigin = true;
+  }
 
+  position.x = (gga->longitude - originLongitude) * DEG_E7_TO_RAD * EARTH_RADIUS * originCosLatitude;
+  position.y = (gga->latitude - originLatitude) * DEG_E7_TO_RAD * EARTH_RADIUS;
+  position.z = gga->altitude - originAltitude;
+  position.stdDev = gga->hdop * uere;
+  position.source = MeasurementSourceGnss;
+  fixCount++;
 
-void gtgpsTask(void *param)
+  if (useEstimator) {
+    estimatorEnqueuePositionCapturedAt(&position, captureTick);
+  }
+}
+
+static void gtgpsTask(void *param)
 {
-  char ch;
-  int j;
+  uint32_t sentenceTick = 0;
 
   uart1SendData(sizeof(baudcmd), baudcmd);
 
   vTaskDelay(500);
   uart1Init(115200);
+  uart1InitRxDma();
   vTaskDelay(500);
 
   uart1SendData(sizeof(updaterate), updaterate);
   uart1SendData(sizeof(updaterate2), updaterate2);
 
-//  uart1SendData(sizeof(updaterate3), updaterate3);
-//  uart1SendData(sizeof(updaterate4), updaterate4);
-
+  nmeaParserInit(&parser);
 
   while(1)
   {
-    uart1Getchar(&ch);
-    consolePutchar(ch);
-
-    if (ch == '$') {
-      bi = 0;
-    } else if (ch == '\n') {
-      buff[bi] = 0; // Terminate with null
-      if (verifyChecksum(buff)) {
-        //DEBUG_PRINT("O");
-        for (j = 0; j < sizeof(parsers)/sizeof(parsers[0]); j++) {
-          if (strncmp(parsers[j].token, buff, LEN_TOKEN) == 0) {
-            parsers[j].parser(&buff[LEN_TOKEN]);
-          }
-        }
+    // The data is received with DMA and parsed in chunks, not one character per wake up
+    const uint32_t length = uart1GetBytesWithTimeout(rxChunk, sizeof(rxChunk), RX_TIMEOUT);
+    const uint32_t now = xTaskGetTickCount();
+
+    if (echo) {
+      consoleWrite((const char*)rxChunk, length);
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+      if (rxChunk[i] == '$') {
+        // The best estimate of when the sentence was sent
+        sentenceTick = now;
+      }
+
+      if (nmeaParse(&parser, rxChunk[i]) == nmeaSentenceGga) {
+        handleFix(&parser.gga, sentenceTick);
       }
-    } else if (bi < MAX_LEN_SENTANCE) {
-      buff[bi++] = ch;
     }
   }
 }
@@ -282,8 +161,7 @@ static void gtgpsInit(DeckInfo *info)
   DEBUG_PRINT("Enabling reading from GlobalTop GPS\n");
   uart1Init(9600);
 
-  xTaskCreate(gtgpsTask, GTGPS_DECK_TASK_NAME,
-              configMINIMAL_STACK_SIZE, NULL, GTGPS_DECK_TASK_PRI, NULL);
+  STATIC_MEM_TASK_CREATE(gtgpsTask, gtgpsTask, GTGPS_DECK_TASK_NAME, NULL, GTGPS_DECK_TASK_PRI);
 
   isInit = true;
 }
@@ -316,11 +194,46 @@ PARAM_GROUP_START(deck)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, bcGTGPS, &isInit)
 PARAM_GROUP_STOP(deck)
 
+PARAM_GROUP_START(gps)
+/**
+ * @brief Nonzero to pass the 3D fixes to the estimator as position measurements
+ */
+PARAM_ADD(PARAM_UINT8, useEst, &useEstimator)
+/**
+ * @brief User equivalent range error, the standard deviation of a fix is HDOP times this value (m)
+ */
+PARAM_ADD(PARAM_FLOAT, uere, &uere)
+/**
+ * @brief Nonzero to copy the NMEA sentences to the console
+ */
+PARAM_ADD(PARAM_UINT8, echo, &echo)
+PARAM_GROUP_STOP(gps)
+
 LOG_GROUP_START(gps)
-LOG_ADD(LOG_INT32, lat, &m.latitude)
-LOG_ADD(LOG_INT32, lon, &m.longitude)
-LOG_ADD(LOG_FLOAT, hMSL, &m.height)
-LOG_ADD(LOG_FLOAT, hAcc, &b.pdop)
-LOG_ADD(LOG_INT32, nsat, &m.nsat)
-LOG_ADD(LOG_INT32, fix, &b.fix)
+LOG_ADD(LOG_INT32, lat, &parser.gga.latitude)
+LOG_ADD(LOG_INT32, lon, &parser.gga.longitude)
+LOG_ADD(LOG_FLOAT, hMSL, &parser.gga.altitude)
+LOG_ADD(LOG_FLOAT, hAcc, &parser.gsa.pdop)
+LOG_ADD(LOG_UINT8, nsat, &parser.gga.nsat)
+LOG_ADD(LOG_UINT8, fix, &parser.gsa.fix)
+/**
+ * @brief Position of the latest fix in the local frame, east of the first fix (m)
+ */
+LOG_ADD(LOG_FLOAT, x, &position.x)
+/**
+ * @brief Position of the latest fix in the local frame, north of the first fix (m)
+ */
+LOG_ADD(LOG_FLOAT, y, &position.y)
+/**
+ * @brief Position of the latest fix in the local frame, above the first fix (m)
+ */
+LOG_ADD(LOG_FLOAT, z, &position.z)
+/**
+ * @brief Number of 3D fixes
+ */
+LOG_ADD(LOG_UINT32, fixes, &fixCount)
+/**
+ * @brief Number of sentences with a bad checksum
+ */
+LOG_ADD(LOG_UINT32, csErr, &parser.checksumErrors)
 LOG_GROUP_STOP(gps)
@@ -99,7 +99,7 @@ static const MemoryHandlerDef_t timingmemDef = {
 
 /*
  * To add a new effect just add it as a static function with the prototype
- * void effect(uint8_t buffer[][3], bool reset)
+ * bool effect(uint8_t buffer[][3], bool reset)
  *
  * Then add it to the effectsFct[] list bellow. It will automatically be
  * activated using the ring.effect parameter.
@@ -108,11 +108,14 @@ static const MemoryHandlerDef_t timingmemDef = {
  * modified in memory as long as reset is not 'true', see the spin effects for
  * and example.
  *
+ * The effect returns true if it changed the buffer. The frame is only sent to
+ * the ring when it did, so static effects cost close to nothing once drawn.
+ *
  * The log subsystem can be used to get the value of any log variable of the
  * system. See tiltEffect for an example.
  */
 
-typedef void (*Ledring12Effect)(uint8_t buffer[][3], bool reset);
+typedef bool (*Ledring12Effect)(uint8_t buffer[][3], bool reset);
 
 /**************** Some useful macros ***************/
 
@@ -138,6 +141,11 @@ typedef void (*Ledring12Effect)(uint8_t buffer[][3], bool reset);
   dest[1] = ((uint16_t)G6 * 259 + 33) >> 6;                                    \
   dest[2] = ((uint16_t)B5 * 527 + 23) >> 6;
 
+#ifndef LEDRING_DEFAULT_FPS
+#define LEDRING_DEFAULT_FPS 20
+#endif
+#define LEDRING_MAX_FPS 50
+
 #ifndef LEDRING_DEFAULT_EFFECT
 #define LEDRING_DEFAULT_EFFECT 6
 #endif
@@ -146,6 +154,8 @@ typedef void (*Ledring12Effect)(uint8_t buffer[][3], bool reset);
 
 static uint32_t effect = LEDRING_DEFAULT_EFFECT;
 static uint32_t neffect;
+static uint8_t fps = LEDRING_DEFAULT_FPS;
+static float framePeriod = 1.0f / LEDRING_DEFAULT_FPS;
 static uint8_t headlightEnable = 0;
 static uint8_t black[][3] = {BLACK, BLACK, BLACK,
                              BLACK, BLACK, BLACK,
@@ -159,9 +169,31 @@ static const uint8_t blue[] = {0x00, 0x00, 0xFF};
 static const uint8_t white[] = WHITE;
 static const uint8_t part_black[] = BLACK;
 
+static bool setColor(uint8_t dest[3], uint8_t red, uint8_t green, uint8_t blue)
+{
+  bool changed = dest[0] != red || dest[1] != green || dest[2] != blue;
+
+  dest[0] = red;
+  dest[1] = green;
+  dest[2] = blue;
+
+  return changed;
+}
+
+static bool fillColor(uint8_t buffer[][3], uint8_t red, uint8_t green, uint8_t blue)
+{
+  bool changed = false;
+
+  for (int i = 0; i < NBR_LEDS; i++) {
+    changed |= setColor(buffer[i], red, green, blue);
+  }
+
+  return changed;
+}
+
 /**************** Black (LEDs OFF) ***************/
 
-static void blackEffect(uint8_t buffer[][3], bool reset)
+static bool blackEffect(uint8_t buffer[][3], bool reset)
 {
   int i;
 
@@ -173,6 +205,8 @@ static void blackEffect(uint8_t buffer[][3], bool reset)
       buffer[i][2] = 0;
     }
   }
+
+  return reset;
 }
 
 /**************** White spin ***************/
@@ -232,7 +266,7 @@ static const uint8_t blueRing[][3] = {{64, 64, 255}, {32,32,64}, {8,8,16},
 //                                      };
 // #endif
 
-static void whiteSpinEffect(uint8_t buffer[][3], bool reset)
+static bool whiteSpinEffect(uint8_t buffer[][3], bool reset)
 {
   int i;
   uint8_t temp[3];
@@ -249,13 +283,14 @@ static void whiteSpinEffect(uint8_t buffer[][3], bool reset)
     COPY_COLOR(buffer[i], buffer[i+1]);
   }
   COPY_COLOR(buffer[(NBR_LEDS-1)], temp);
+
+  return true;
 }
 
 static uint8_t solidRed=20, solidGreen=20, solidBlue=20;
 static float glowstep = 0.05;
-static void solidColorEffect(uint8_t buffer[][3], bool reset)
+static bool solidColorEffect(uint8_t buffer[][3], bool reset)
 {
-  int i;
   static float brightness=0;
 
   if (reset) brightness = 0;
@@ -263,17 +298,13 @@ static void solidColorEffect(uint8_t buffer[][3], bool reset)
   if (brightness<1) brightness += 0.05f;
   else brightness = 1;
 
-  for (i=0; i<NBR_LEDS; i++)
-  {
-    buffer[i][0] = solidRed*brightness;
-    buffer[i][1] = solidGreen*brightness;
-    buffer[i][2] = solidBlue*brightness;
-  }
+  return fillColor(buffer, solidRed*brightness, solidGreen*brightness, solidBlue*brightness);
 }
 
-static void virtualMemEffect(uint8_t buffer[][3], bool reset)
+static bool virtualMemEffect(uint8_t buffer[][3], bool reset)
 {
   int i;
+  bool changed = reset;
 
   if (reset)
   {
@@ -290,13 +321,15 @@ static void virtualMemEffect(uint8_t buffer[][3], bool reset)
     R5 = led[i][0] >> 3;
     G6 = ((led[i][0] & 0x07) << 3) | (led[i][1] >> 5);
     B5 = led[i][1] & 0x1F;
-    buffer[i][0] = ((uint16_t)R5 * 527 + 23 ) >> 6;
-    buffer[i][1] = ((uint16_t)G6 * 259 + 33 ) >> 6;
-    buffer[i][2] = ((uint16_t)B5 * 527 + 23 ) >> 6;
+    changed |= setColor(buffer[i], ((uint16_t)R5 * 527 + 23 ) >> 6,
+                                   ((uint16_t)G6 * 259 + 33 ) >> 6,
+                                   ((uint16_t)B5 * 527 + 23 ) >> 6);
   }
+
+  return changed;
 }
 
-static void boatEffect(uint8_t buffer[][3], bool reset)
+static bool boatEffect(uint8_t buffer[][3], bool reset)
 {
   int i;
 
@@ -326,7 +359,8 @@ static void boatEffect(uint8_t buffer[][3], bool reset)
     COPY_COLOR(buffer[blacks[i]], part_black);
   }
 
-
+  // The pattern is static, it only changes when switching to it
+  return reset;
 }
 
 /**************** Color spin ***************/
@@ -345,7 +379,7 @@ static const uint8_t colorRing[][3] = {{0,0,32}, {0,0,16}, {0,0,8},
                                       };
 #endif
 
-static void colorSpinEffect(uint8_t buffer[][3], bool reset)
+static bool colorSpinEffect(uint8_t buffer[][3], bool reset)
 {
   int i;
   uint8_t temp[3];
@@ -362,9 +396,11 @@ static void colorSpinEffect(uint8_t buffer[][3], bool reset)
     COPY_COLOR(buffer[i], buffer[i+1]);
   }
   COPY_COLOR(buffer[(NBR_LEDS-1)], temp);
+
+  return true;
 }
 
-static void spinEffect2(uint8_t buffer[][3], bool reset)
+static bool spinEffect2(uint8_t buffer[][3], bool reset)
 {
   int i;
   uint8_t temp[3];
@@ -381,9 +417,11 @@ static void spinEffect2(uint8_t buffer[][3], bool reset)
     COPY_COLOR(buffer[i], buffer[i-1]);
   }
   COPY_COLOR(buffer[0], temp);
+
+  return true;
 }
 
-static void doubleSpinEffect(uint8_t buffer[][3], bool reset) {
+static bool doubleSpinEffect(uint8_t buffer[][3], bool reset) {
   static uint8_t sub1[NBR_LEDS][3];
   static uint8_t sub2[NBR_LEDS][3];
   int i;
@@ -402,13 +440,18 @@ static void doubleSpinEffect(uint8_t buffer[][3], bool reset) {
   }
 
   step ++;
+
+  return true;
 }
 
 /**************** Dynamic tilt effect ***************/
 
-static void tiltEffect(uint8_t buffer[][3], bool reset)
+static bool tiltEffect(uint8_t buffer[][3], bool reset)
 {
   static int pitchid, rollid, thrust=-1;
+  uint8_t previous[NBR_LEDS][3];
+
+  memcpy(previous, buffer, sizeof(previous));
 
   // 2014-12-28 chad: Reset LEDs to off to avoid color artifacts
   // when switching from other effects.
@@ -455,18 +498,42 @@ static void tiltEffect(uint8_t buffer[][3], bool reset)
     buffer[9][2] = LIMIT(led_middle + roll);
     buffer[10][2] = LIMIT(led_middle + roll);
   }
+
+  return reset || memcmp(previous, buffer, sizeof(previous)) != 0;
 }
 
 
 /*************** Gravity light effect *******************/
 
-static float gravityLightCalculateAngle(float pitch, float roll);
-static void gravityLightRender(uint8_t buffer[][3], float led_index, int intensity);
+/*
+ * Each LED gets a triangular light spot of the given width (in LEDs) centered
+ * on the direction the ring is tilted towards. Instead of computing the tilt
+ * angle with atan and the distance to every LED, the cosine of the angle
+ * between the tilt and each LED is computed from a table of LED directions
+ * filled at init. The spot then becomes a cosine bump of the same width.
+ */
+#define GRAVITY_LIGHT_WIDTH 5.0f
+
+static float ledSin[NBR_LEDS];
+static float ledCos[NBR_LEDS];
+static float gravityLightEdge;
+
+static void gravityLightInit(void)
+{
+  for (int i = 0; i < NBR_LEDS; i++) {
+    float angle = 2 * (float) M_PI * i / NBR_LEDS;
+    ledSin[i] = sinf(angle);
+    ledCos[i] = cosf(angle);
+  }
+
+  gravityLightEdge = cosf((float) M_PI * GRAVITY_LIGHT_WIDTH / NBR_LEDS);
+}
 
-static void gravityLight(uint8_t buffer[][3], bool reset)
+static bool gravityLight(uint8_t buffer[][3], bool reset)
 {
   static int pitchid, rollid;
   static bool isInitialized = false;
+  bool changed = reset;
 
   if (!isInitialized) {
     pitchid = logGetVarId("stabilizer", "pitch");
@@ -477,40 +544,24 @@ static void gravityLight(uint8_t buffer[][3], bool reset)
   float pitch = logGetFloat(pitchid); // -180 to 180
   float roll = logGetFloat(rollid); // -180 to 180
 
-  float angle = gravityLightCalculateAngle(pitch, roll);
-  float led_index = NBR_LEDS * angle / (2 * (float) M_PI);
-  int intensity = LIMIT(sqrtf(pitch * pitch + roll * roll));
-  gravityLightRender(buffer, led_index, intensity);
-}
-
-static float gravityLightCalculateAngle(float pitch, float roll) {
-  float angle = 0.0;
-
-  if (roll != 0) {
-    angle = atanf(pitch / roll) + (float) M_PI_2;
-
-    if (roll < 0.0f) {
-      angle += (float) M_PI;
-    }
+  float magnitude = sqrtf(pitch * pitch + roll * roll);
+  if (magnitude == 0.0f) {
+    return fillColor(buffer, 0, 0, 0) || reset;
   }
 
-  return angle;
-}
-
-static void gravityLightRender(uint8_t buffer[][3], float led_index, int intensity) {
-  float width = 5;
-  float height = intensity;
+  // Scale so that the projection on a LED direction gives the light intensity
+  float height = LIMIT(magnitude);
+  float scale = height / (magnitude * (1.0f - gravityLightEdge));
+  float offset = height * gravityLightEdge / (1.0f - gravityLightEdge);
 
-  int i;
-  for (i = 0; i < NBR_LEDS; i++) {
-	float distance = fabsf(led_index - i);
-	if (distance > NBR_LEDS / 2) {
-		distance = NBR_LEDS - distance;
-	}
-
-	int col = height - distance * (height / (width / 2));
-	SET_WHITE(buffer[i], LIMIT(col));
+  for (int i = 0; i < NBR_LEDS; i++) {
+    // magnitude * cos(tilt angle - LED angle)
+    float projection = roll * ledSin[i] - pitch * ledCos[i];
+    int col = projection * scale - offset;
+    changed |= setColor(buffer[i], LIMIT(col), LIMIT(col), LIMIT(col));
   }
+
+  return changed;
 }
 
 
@@ -518,11 +569,12 @@ static void gravityLightRender(uint8_t buffer[][3], float led_index, int intensi
 
 #define MAX_RATE 512
 
-static void brightnessEffect(uint8_t buffer[][3], bool reset)
+static bool brightnessEffect(uint8_t buffer[][3], bool reset)
 {
 
   static int gyroYid, gyroZid, gyroXid =- 1;
   static uint8_t brightness = 0;
+  bool changed = reset;
 
   if (gyroXid < 0)
   {
@@ -533,7 +585,6 @@ static void brightnessEffect(uint8_t buffer[][3], bool reset)
   }
   else
   {
-    int i;
     int gyroX = (int)logGetFloat(gyroXid);
     int gyroY = (int)logGetFloat(gyroYid);
     int gyroZ = (int)logGetFloat(gyroZid);
@@ -551,15 +602,12 @@ static void brightnessEffect(uint8_t buffer[][3], bool reset)
     gyroY = DEADBAND(gyroY, 5);
     gyroZ = DEADBAND(gyroZ, 5);
 
-    for (i=0; i < NBR_LEDS; i++)
-    {
-      buffer[i][0] = (uint8_t)(LIMIT(gyroZ));
-      buffer[i][1] = (uint8_t)(LIMIT(gyroY));
-      buffer[i][2] = (uint8_t)(LIMIT(gyroX));
-    }
+    changed |= fillColor(buffer, LIMIT(gyroZ), LIMIT(gyroY), LIMIT(gyroX));
 
     brightness++;
   }
+
+  return changed;
 }
 
 
@@ -580,9 +628,8 @@ static uint8_t test_eff_nbr = 0;
 static uint8_t test_delay_counter = 0;
 static uint8_t headlight_test_counter =0;
 static uint8_t test_front = false;
-static void ledTestEffect(uint8_t buffer[][3], bool reset)
+static bool ledTestEffect(uint8_t buffer[][3], bool reset)
 {
-  int i;
   static float brightness=0;
 
   if (reset) brightness = 0;
@@ -590,12 +637,7 @@ static void ledTestEffect(uint8_t buffer[][3], bool reset)
   if (brightness<1) brightness += 0.05f;
   else brightness = 1;
 
-  for (i=0; i<NBR_LEDS; i++)
-  {
-    buffer[i][0] = test_pat[test_eff_nbr][0];
-    buffer[i][1] = test_pat[test_eff_nbr][1];
-    buffer[i][2] = test_pat[test_eff_nbr][2];
-  }
+  bool changed = fillColor(buffer, test_pat[test_eff_nbr][0], test_pat[test_eff_nbr][1], test_pat[test_eff_nbr][2]);
 
   test_delay_counter++;
   headlight_test_counter++;
@@ -610,6 +652,8 @@ static void ledTestEffect(uint8_t buffer[][3], bool reset)
     test_front = !test_front;
     headlightEnable = test_front;
   }
+
+  return changed;
 }
 
 /**
@@ -618,50 +662,41 @@ static void ledTestEffect(uint8_t buffer[][3], bool reset)
  * Red means empty, blue means full.
  */
 static float emptyCharge = 3.1, fullCharge = 4.2;
-static void batteryChargeEffect(uint8_t buffer[][3], bool reset)
+static bool batteryChargeEffect(uint8_t buffer[][3], bool reset)
 {
-  int i;
-  static int vbatid;
+  static int vbatid = -1;
   float vbat;
 
-  vbatid = logGetVarId("pm", "vbat");
+  if (vbatid < 0) {
+    vbatid = logGetVarId("pm", "vbat");
+  }
   vbat = logGetFloat(vbatid);
 
-  for (i = 0; i < NBR_LEDS; i++) {
-    buffer[i][0] = LIMIT(LINSCALE(emptyCharge, fullCharge, 255, 0, vbat)); // Red (emtpy)
-    buffer[i][1] = 0; // Green
-    buffer[i][2] = LIMIT(LINSCALE(emptyCharge, fullCharge, 0, 255, vbat)); // Blue (charged)
-  }
+  return fillColor(buffer,
+                   LIMIT(LINSCALE(emptyCharge, fullCharge, 255, 0, vbat)), // Red (emtpy)
+                   0, // Green
+                   LIMIT(LINSCALE(emptyCharge, fullCharge, 0, 255, vbat))); // Blue (charged)
 }
 
 /**
  * An effect mimicking a blue light siren
  */
-static void siren(uint8_t buffer[][3], bool reset)
+static bool siren(uint8_t buffer[][3], bool reset)
 {
-  int i;
   static int tic = 0;
-
-  if (reset)
-  {
-    for (i=0; i<NBR_LEDS; i++) {
-      COPY_COLOR(buffer[i], part_black);
-    }
-  }
+  bool changed;
 
   if ((tic < 10) && (tic & 1))
   {
-    for (i=0; i<NBR_LEDS; i++) {
-      COPY_COLOR(buffer[i], blue);
-    }
+    changed = fillColor(buffer, blue[0], blue[1], blue[2]);
   }
   else
   {
-    for (i=0; i<NBR_LEDS; i++) {
-      COPY_COLOR(buffer[i], part_black);
-    }
+    changed = fillColor(buffer, part_black[0], part_black[1], part_black[2]);
   }
   if (++tic >= 20) tic = 0;
+
+  return changed;
 }
 
 /**
@@ -677,7 +712,7 @@ static float currentFadeTime = 0.5;
 LOG_GROUP_START(ring)
 LOG_ADD(LOG_FLOAT, fadeTime, &currentFadeTime)
 LOG_GROUP_STOP(ring)
-static void fadeColorEffect(uint8_t buffer[][3], bool reset)
+static bool fadeColorEffect(uint8_t buffer[][3], bool reset)
 {
   static float currentRed = 255;
   static float currentGreen = 255;
@@ -710,26 +745,16 @@ static void fadeColorEffect(uint8_t buffer[][3], bool reset)
     int green = (alpha * currentGreen) + ((1 - alpha) * targetGreen);
     int blue = (alpha * currentBlue) + ((1 - alpha) * targetBlue);
 
-    for (int i = 0; i < NBR_LEDS; i++)
-    {
-      buffer[i][0] = red;
-      buffer[i][1] = green;
-      buffer[i][2] = blue;
-    }
+    currentFadeTime -= framePeriod;
 
-    currentFadeTime -= 50e-3f;
+    return fillColor(buffer, red, green, blue);
   } else {
     currentFadeTime = 0;
     currentRed = (fadeColor >> 16) & 0x0FF;
     currentGreen = (fadeColor >> 8) & 0x0FF;
     currentBlue = (fadeColor >> 0) & 0x0FF;
 
-    for (int i = 0; i < NBR_LEDS; i++)
-    {
-      buffer[i][0] = currentRed;
-      buffer[i][1] = currentGreen;
-      buffer[i][2] = currentBlue;
-    }
+    return fillColor(buffer, currentRed, currentGreen, currentBlue);
   }
 }
 
@@ -739,30 +764,25 @@ static void fadeColorEffect(uint8_t buffer[][3], bool reset)
  * Red means bad, green means good.
  */
 static float badRssi = 85, goodRssi = 35;
-static void rssiEffect(uint8_t buffer[][3], bool reset)
+static bool rssiEffect(uint8_t buffer[][3], bool reset)
 {
-  int i;
-  static int isConnectedId, rssiId;
+  static int isConnectedId = -1, rssiId;
   float rssi;
   bool isConnected;
 
-  isConnectedId = logGetVarId("radio", "isConnected");
-  isConnected = logGetUint(isConnectedId);
+  if (isConnectedId < 0) {
+    isConnectedId = logGetVarId("radio", "isConnected");
+    rssiId = logGetVarId("radio", "rssi");
+  }
 
-  rssiId = logGetVarId("radio", "rssi");
+  isConnected = logGetUint(isConnectedId);
   rssi = logGetFloat(rssiId);
   uint8_t rssi_scaled = LIMIT(LINSCALE(badRssi, goodRssi, 0, 255, rssi));
 
-  for (i = 0; i < NBR_LEDS; i++) {
-    if (isConnected) {
-      buffer[i][0] = 255 - rssi_scaled; // Red (bad)
-      buffer[i][1] = rssi_scaled; // Green (good)
-      buffer[i][2] = 0; // Blue
-    } else {
-      buffer[i][0] = 100; // Red
-      buffer[i][1] = 100; // Green
-      buffer[i][2] = 100; // Blue
-    }
+  if (isConnected) {
+    return fillColor(buffer, 255 - rssi_scaled, rssi_scaled, 0); // Red (bad), green (good)
+  } else {
+    return fillColor(buffer, 100, 100, 100);
   }
 }
 
@@ -771,15 +791,14 @@ static void rssiEffect(uint8_t buffer[][3], bool reset)
  *
  * Red means 0 angles, green means 16 angles (2 basestations x 4 crazyflie sensors x 2 sweeping directions).
  */
-static void lighthouseEffect(uint8_t buffer[][3], bool reset)
+static bool lighthouseEffect(uint8_t buffer[][3], bool reset)
 {
   uint16_t validAngles = pulseProcessorAnglesQuality();
 
-  for (int i = 0; i < NBR_LEDS; i++) {
-    buffer[i][0] = LIMIT(LINSCALE(0.0f, 255.0f, 100.0f, 0.0f, validAngles)); // Red (small validAngles)
-    buffer[i][1] = LIMIT(LINSCALE(0.0f, 255.0f, 0.0f, 100.0f, validAngles)); // Green (large validAngles)
-    buffer[i][2] = 0;
-  }
+  return fillColor(buffer,
+                   LIMIT(LINSCALE(0.0f, 255.0f, 100.0f, 0.0f, validAngles)), // Red (small validAngles)
+                   LIMIT(LINSCALE(0.0f, 255.0f, 0.0f, 100.0f, validAngles)), // Green (large validAngles)
+                   0);
 }
 
 /**
@@ -788,7 +807,7 @@ static void lighthouseEffect(uint8_t buffer[][3], bool reset)
  * Red means bad, green means good.
  * Blinking means battery was low during flight.
  */
-static void locSrvStatus(uint8_t buffer[][3], bool reset)
+static bool locSrvStatus(uint8_t buffer[][3], bool reset)
 {
   static int locSrvTickId = -1;
   static int pmStateId = -1;
@@ -813,20 +832,21 @@ static void locSrvStatus(uint8_t buffer[][3], bool reset)
     batteryEverLow = true;
   }
 
-  for (int i = 0; i < NBR_LEDS; i++) {
-    if (batteryEverLow && tic < 10) {
-      buffer[i][0] = 0;
-      buffer[i][1] = 0;
-    } else {
-      buffer[i][0] = LIMIT(LINSCALE(0, 30, 0, 100, time_since_last_update)); // Red (large time_since_last_update)
-      buffer[i][1] = LIMIT(LINSCALE(0, 30, 100, 0, time_since_last_update)); // Green (small time_since_last_update)
-    }
-    buffer[i][2] = 0;
+  bool changed;
+  if (batteryEverLow && tic < 10) {
+    changed = fillColor(buffer, 0, 0, 0);
+  } else {
+    changed = fillColor(buffer,
+                        LIMIT(LINSCALE(0, 30, 0, 100, time_since_last_update)), // Red (large time_since_last_update)
+                        LIMIT(LINSCALE(0, 30, 100, 0, time_since_last_update)), // Green (small time_since_last_update)
+                        0);
   }
 
   if (++tic >= 20) {
     tic = 0;
   }
+
+  return changed;
 }
 
 static bool isTimeMemDone(ledtiming current)
@@ -840,7 +860,7 @@ static uint64_t timeEffectTime = 0;
 static uint8_t timeEffectPrevBuffer[NBR_LEDS][3];
 static float timeEffectRotation = 0;
 
-static void timeMemEffect(uint8_t outputBuffer[][3], bool reset)
+static bool timeMemEffect(uint8_t outputBuffer[][3], bool reset)
 {
   // Start timer when going to this
   if (reset) {
@@ -858,7 +878,7 @@ static void timeMemEffect(uint8_t outputBuffer[][3], bool reset)
 
   // Stop when completed
   if (isTimeMemDone(current))
-    return;
+    return reset;
 
   // Get the proper index
   uint64_t time = usecTimestamp() / 1000;
@@ -883,7 +903,7 @@ static void timeMemEffect(uint8_t outputBuffer[][3], bool reset)
     current = ledringtimingsmem.timings[timeEffectI];
 
     if (isTimeMemDone(current))
-      return;
+      return reset;
   }
 
   // Apply the current effect
@@ -924,11 +944,16 @@ static void timeMemEffect(uint8_t outputBuffer[][3], bool reset)
   shift = shift % NBR_LEDS;
 
   // Output current leds
+  bool changed = reset;
   for (int i = 0; i < NBR_LEDS; i++)
-    for (int j = 0; j < 3; j++)
-      outputBuffer[(i+shift) % NBR_LEDS][j] =
-        percentShift * currentBuffer[i][j] +
-        (1-percentShift) * currentBuffer[(i+1) % NBR_LEDS][j];
+    for (int j = 0; j < 3; j++) {
+      uint8_t value = percentShift * currentBuffer[i][j] +
+                      (1-percentShift) * currentBuffer[(i+1) % NBR_LEDS][j];
+      changed |= outputBuffer[(i+shift) % NBR_LEDS][j] != value;
+      outputBuffer[(i+shift) % NBR_LEDS][j] = value;
+    }
+
+  return changed;
 }
 
 /**************** Effect list ***************/
@@ -975,7 +1000,11 @@ static void checkLightSignalTrigger(void)
   }
 }
 
-static void overrideWithLightSignal(uint8_t buffer[][3])
+/**
+ * Overrides the frame while the light signal is active. Returns true if the
+ * frame was overridden, the last overridden frame is black.
+ */
+static bool overrideWithLightSignal(uint8_t buffer[][3])
 {
   uint8_t color;
   uint32_t diffMsec;
@@ -993,7 +1022,10 @@ static void overrideWithLightSignal(uint8_t buffer[][3])
     }
 
     memset(buffer, color, NBR_LEDS * 3);
+    return true;
   }
+
+  return false;
 }
 
 /********** Ring init and switching **********/
@@ -1005,6 +1037,9 @@ void ledring12Worker(void * data)
 {
   static int current_effect = 0;
   static uint8_t buffer[NBR_LEDS][3];
+  // The effects keep their state in buffer, the light signal is drawn on a copy
+  static uint8_t frame[NBR_LEDS][3];
+  static bool isSignalShown = false;
   bool reset = true;
 
   if (/*!pmIsDischarging() ||*/ (effect > neffect)) {
@@ -1019,9 +1054,14 @@ void ledring12Worker(void * data)
   }
   current_effect = effect;
 
-  effectsFct[current_effect](buffer, reset);
-  overrideWithLightSignal(buffer);
-  ws2812Send(buffer, NBR_LEDS);
+  bool isDirty = effectsFct[current_effect](buffer, reset) || reset;
+
+  // Redraw while the signal is shown and once after it, to restore the effect
+  if (isDirty || lightSignal.active || isSignalShown) {
+    memcpy(frame, buffer, sizeof(frame));
+    isSignalShown = overrideWithLightSignal(frame);
+    ws2812Send(frame, NBR_LEDS);
+  }
 }
 
 static void ledring12Timer(xTimerHandle timer)
@@ -1032,6 +1072,20 @@ static void ledring12Timer(xTimerHandle timer)
   checkLightSignalTrigger();
 }
 
+static void fpsChanged(void)
+{
+  if (fps < 1) {
+    fps = 1;
+  } else if (fps > LEDRING_MAX_FPS) {
+    fps = LEDRING_MAX_FPS;
+  }
+  framePeriod = 1.0f / fps;
+
+  if (isInit) {
+    xTimerChangePeriod(timer, M2T(1000 / fps), 0);
+  }
+}
+
 static void ledring12Init(DeckInfo *info)
 {
   if (isInit) {
@@ -1043,6 +1097,7 @@ static void ledring12Init(DeckInfo *info)
   ws2812Init();
 
   neffect = sizeof(effectsFct)/sizeof(effectsFct[0])-1;
+  gravityLightInit();
 
   GPIO_InitStructure.GPIO_Mode = GPIO_Mode_OUT;
   GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
@@ -1055,7 +1110,7 @@ static void ledring12Init(DeckInfo *info)
 
   isInit = true;
 
-  timer = xTimerCreate( "ringTimer", M2T(50),
+  timer = xTimerCreate( "ringTimer", M2T(1000 / fps),
                                      pdTRUE, NULL, ledring12Timer );
   xTimerStart(timer, 100);
 }
@@ -1119,6 +1174,7 @@ PARAM_ADD(PARAM_FLOAT, emptyCharge, &emptyCharge)
 PARAM_ADD(PARAM_FLOAT, fullCharge, &fullCharge)
 PARAM_ADD(PARAM_UINT32, fadeColor, &fadeColor)
 PARAM_ADD(PARAM_FLOAT, fadeTime, &fadeTime)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, fps, &fps, fpsChanged)
 PARAM_GROUP_STOP(ring)
 
 PARAM_GROUP_START(system)
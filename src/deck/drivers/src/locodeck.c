@@ -49,7 +49,10 @@
 #include "nvicconf.h"
 #include "estimator.h"
 #include "statsCnt.h"
+#include "usec_time.h"
+#include "rateSupervisor.h"
 #include "mem.h"
+#include "static_mem.h"
 
 #include "locodeck.h"
 
@@ -132,13 +135,41 @@ static SemaphoreHandle_t algoSemaphore;
 static dwDevice_t dwm_device;
 static dwDevice_t *dwm = &dwm_device;
 
+// Room for a burst of anchor configuration packets, the CRTP client is told when a packet is refused
+#define LPP_SHORT_QUEUE_LENGTH 32
 static QueueHandle_t lppShortQueue;
+STATIC_MEM_QUEUE_ALLOC(lppShortQueue, LPP_SHORT_QUEUE_LENGTH, sizeof(lpsLppShortPacket_t));
+
+// LPP short packet delivery statistics
+static uint32_t lppShortQueued;
+static uint32_t lppShortRefused;
+static uint32_t lppShortSent;
+static uint32_t lppShortDiscarded;
 
 static uint32_t timeout;
 
 static STATS_CNT_RATE_DEFINE(spiWriteCount, 1000);
 static STATS_CNT_RATE_DEFINE(spiReadCount, 1000);
 
+// Histogram of the time from the DW1000 IRQ to the event being handled by the uwb task. Bin n counts latencies
+// below (IRQ_LATENCY_FIRST_BIN_US << n) us, the last bin counts everything above.
+#define IRQ_LATENCY_BIN_COUNT 8
+#define IRQ_LATENCY_FIRST_BIN_US 32
+static volatile uint32_t irqTimestamp;
+static uint32_t irqLatencyHistogram[IRQ_LATENCY_BIN_COUNT];
+static uint32_t irqLatencyMax;
+
+// Time spent handling events in the uwb task, average and max (us) over the last second
+static uint32_t eventTimeSum;
+static uint32_t eventCount;
+static uint32_t eventTimeMax;
+static uint32_t nextEventStatsTime;
+static uint32_t logEventTimeAvg;
+static uint32_t logEventTimeMax;
+static STATS_CNT_RATE_DEFINE(eventRate, 1000);
+// The event rate depends on the ranging mode and the anchors, it is measured but not bounded
+static rateSupervisor_t eventRateSupervisor;
+
 // Memory read/write handling
 #define MEM_LOCO_INFO             0x0000
 #define MEM_LOCO_ANCHOR_BASE      0x1000
@@ -163,6 +194,32 @@ static const MemoryHandlerDef_t memDef = {
 };
 static void buildAnchorMemList(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest, const uint32_t pageBase_address, const uint8_t anchorCount, const uint8_t unsortedAnchorList[]);
 
+// Snapshot of the anchor data served by the memory sub system. It is refreshed when a read finds it older than
+// ANCHOR_MEM_SNAPSHOT_MAX_AGE_MS and the version is incremented when the content changes, clients can poll the
+// version to skip reading unchanged data.
+#define ANCHOR_MEM_SNAPSHOT_MAX_AGE_MS 100
+
+typedef struct {
+  float x;
+  float y;
+  float z;
+  uint8_t hasBeenSet;
+} __attribute__((packed)) anchorMemPosition_t;
+
+typedef struct {
+  uint32_t version;
+  uint32_t updateTick;
+  bool isValid;
+
+  uint8_t idCount;
+  uint8_t idList[MEM_ANCHOR_ID_LIST_LENGTH];
+  uint8_t activeCount;
+  uint8_t activeList[MEM_ANCHOR_ID_LIST_LENGTH];
+  anchorMemPosition_t positions[MEM_ANCHOR_ID_LIST_LENGTH];
+} anchorMemSnapshot_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static anchorMemSnapshot_t anchorMemSnapshot;
+
 static void txCallback(dwDevice_t *dev)
 {
   timeout = algorithm->onEvent(dev, eventPacketSent);
@@ -177,18 +234,89 @@ static void rxTimeoutCallback(dwDevice_t * dev) {
   timeout = algorithm->onEvent(dev, eventReceiveTimeout);
 }
 
+// Updates a snapshot entry and returns true if the value changed
+static bool updateSnapshotEntry(void* entry, const void* value, const size_t size) {
+  if (memcmp(entry, value, size) != 0) {
+    memcpy(entry, value, size);
+    return true;
+  }
+
+  return false;
+}
+
+// Rebuilds the anchor snapshot if it is too old. All data is read from the algorithm in one go, a client reading
+// the full memory map gets all reads served from the same snapshot.
+static void refreshAnchorMemSnapshot() {
+  static uint8_t anchorList[MEM_ANCHOR_ID_LIST_LENGTH];
+
+  if (!isInit) {
+    return;
+  }
+
+  const uint32_t now = xTaskGetTickCount();
+  if (anchorMemSnapshot.isValid && (now - anchorMemSnapshot.updateTick) < M2T(ANCHOR_MEM_SNAPSHOT_MAX_AGE_MS)) {
+    return;
+  }
+
+  bool changed = !anchorMemSnapshot.isValid;
+
+  xSemaphoreTake(algoSemaphore, portMAX_DELAY);
+
+  memset(anchorList, 0, sizeof(anchorList));
+  uint8_t anchorCount = algorithm->getActiveAnchorIdList(anchorList, MEM_ANCHOR_ID_LIST_LENGTH);
+  changed |= updateSnapshotEntry(&anchorMemSnapshot.activeCount, &anchorCount, sizeof(anchorCount));
+  changed |= updateSnapshotEntry(anchorMemSnapshot.activeList, anchorList, sizeof(anchorList));
+
+  memset(anchorList, 0, sizeof(anchorList));
+  anchorCount = algorithm->getAnchorIdList(anchorList, MEM_ANCHOR_ID_LIST_LENGTH);
+  changed |= updateSnapshotEntry(&anchorMemSnapshot.idCount, &anchorCount, sizeof(anchorCount));
+  changed |= updateSnapshotEntry(anchorMemSnapshot.idList, anchorList, sizeof(anchorList));
+
+  // Only anchors in the id list have a position, clear the ones that have been removed
+  static bool isInList[MEM_ANCHOR_ID_LIST_LENGTH];
+  memset(isInList, 0, sizeof(isInList));
+  for (int i = 0; i < anchorCount; i++) {
+    isInList[anchorList[i]] = true;
+  }
+
+  for (int anchorId = 0; anchorId < MEM_ANCHOR_ID_LIST_LENGTH; anchorId++) {
+    anchorMemPosition_t entry;
+    memset(&entry, 0, sizeof(entry));
+
+    if (isInList[anchorId]) {
+      point_t position;
+      memset(&position, 0, sizeof(position));
+      algorithm->getAnchorPosition(anchorId, &position);
+
+      entry.x = position.x;
+      entry.y = position.y;
+      entry.z = position.z;
+      entry.hasBeenSet = (position.timestamp != 0);
+    }
+
+    changed |= updateSnapshotEntry(&anchorMemSnapshot.positions[anchorId], &entry, sizeof(entry));
+  }
+
+  xSemaphoreGive(algoSemaphore);
+
+  if (changed) {
+    anchorMemSnapshot.version++;
+  }
+
+  anchorMemSnapshot.updateTick = now;
+  anchorMemSnapshot.isValid = true;
+}
+
 static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest) {
   bool result = false;
 
-  static uint8_t unsortedAnchorList[MEM_ANCHOR_ID_LIST_LENGTH];
+  refreshAnchorMemSnapshot();
 
   if (memAddr >= MEM_LOCO2_ID_LIST && memAddr < MEM_LOCO2_ACTIVE_LIST) {
-    uint8_t anchorCount = locoDeckGetAnchorIdList(unsortedAnchorList, MEM_ANCHOR_ID_LIST_LENGTH);
-    buildAnchorMemList(memAddr, readLen, dest, MEM_LOCO2_ID_LIST, anchorCount, unsortedAnchorList);
+    buildAnchorMemList(memAddr, readLen, dest, MEM_LOCO2_ID_LIST, anchorMemSnapshot.idCount, anchorMemSnapshot.idList);
     result = true;
   } else if (memAddr >= MEM_LOCO2_ACTIVE_LIST && memAddr < MEM_LOCO2_ANCHOR_BASE) {
-    uint8_t anchorCount = locoDeckGetActiveAnchorIdList(unsortedAnchorList, MEM_ANCHOR_ID_LIST_LENGTH);
-    buildAnchorMemList(memAddr, readLen, dest, MEM_LOCO2_ACTIVE_LIST, anchorCount, unsortedAnchorList);
+    buildAnchorMemList(memAddr, readLen, dest, MEM_LOCO2_ACTIVE_LIST, anchorMemSnapshot.activeCount, anchorMemSnapshot.activeList);
     result = true;
   } else {
     if (memAddr >= MEM_LOCO2_ANCHOR_BASE) {
@@ -196,17 +324,11 @@ static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t
       if ((pageAddress % MEM_LOCO2_ANCHOR_PAGE_SIZE) == 0 && MEM_LOCO2_PAGE_LEN == readLen) {
         uint32_t anchorId = pageAddress / MEM_LOCO2_ANCHOR_PAGE_SIZE;
 
-        point_t position;
-        memset(&position, 0, sizeof(position));
-        locoDeckGetAnchorPosition(anchorId, &position);
-
-        float* destAsFloat = (float*)dest;
-        destAsFloat[0] = position.x;
-        destAsFloat[1] = position.y;
-        destAsFloat[2] = position.z;
-
-        bool hasBeenSet = (position.timestamp != 0);
-        dest[sizeof(float) * 3] = hasBeenSet;
+        if (anchorId < MEM_ANCHOR_ID_LIST_LENGTH) {
+          memcpy(dest, &anchorMemSnapshot.positions[anchorId], MEM_LOCO2_PAGE_LEN);
+        } else {
+          memset(dest, 0, MEM_LOCO2_PAGE_LEN);
+        }
 
         result = true;
       }
@@ -346,44 +468,94 @@ static void handleModeSwitch() {
   }
 }
 
-static void uwbTask(void* parameters) {
-  lppShortQueue = xQueueCreate(10, sizeof(lpsLppShortPacket_t));
+static void updateIrqLatencyHistogram(const uint32_t latency) {
+  int bin = 0;
+  uint32_t binLimit = IRQ_LATENCY_FIRST_BIN_US;
+  while (bin < IRQ_LATENCY_BIN_COUNT - 1 && latency >= binLimit) {
+    bin++;
+    binLimit <<= 1;
+  }
+
+  irqLatencyHistogram[bin]++;
+  if (latency > irqLatencyMax) {
+    irqLatencyMax = latency;
+  }
+}
 
+static void updateEventTimeStats(const uint32_t eventTime) {
+  STATS_CNT_RATE_EVENT(&eventRate);
+  rateSupervisorTick(&eventRateSupervisor, T2M(xTaskGetTickCount()), (uint32_t)usecTimestamp());
+  eventTimeSum += eventTime;
+  eventCount++;
+  if (eventTime > eventTimeMax) {
+    eventTimeMax = eventTime;
+  }
+
+  const uint32_t now = xTaskGetTickCount();
+  if (now > nextEventStatsTime) {
+    logEventTimeAvg = eventTimeSum / eventCount;
+    logEventTimeMax = eventTimeMax;
+
+    eventTimeSum = 0;
+    eventCount = 0;
+    eventTimeMax = 0;
+    nextEventStatsTime = now + M2T(1000);
+  }
+}
+
+static void uwbTask(void* parameters) {
   algoOptions.currentRangingMode = lpsMode_auto;
 
   systemWaitStart();
 
+  rateSupervisorInitRate(&eventRateSupervisor, T2M(xTaskGetTickCount()), 0, 0, 0);
+  rateSupervisorRegister(&eventRateSupervisor, "uwb");
+
   while(1) {
     xSemaphoreTake(algoSemaphore, portMAX_DELAY);
     handleModeSwitch();
     xSemaphoreGive(algoSemaphore);
 
     if (ulTaskNotifyTake(pdTRUE, timeout / portTICK_PERIOD_MS) > 0) {
+      const uint32_t start = (uint32_t)usecTimestamp();
+      updateIrqLatencyHistogram(start - irqTimestamp);
+
       do{
         xSemaphoreTake(algoSemaphore, portMAX_DELAY);
         dwHandleInterrupt(dwm);
         xSemaphoreGive(algoSemaphore);
       } while(digitalRead(GPIO_PIN_IRQ) != 0);
+
+      updateEventTimeStats((uint32_t)usecTimestamp() - start);
     } else {
+      const uint32_t start = (uint32_t)usecTimestamp();
+
       xSemaphoreTake(algoSemaphore, portMAX_DELAY);
       timeout = algorithm->onEvent(dwm, eventTimeout);
       xSemaphoreGive(algoSemaphore);
+
+      updateEventTimeStats((uint32_t)usecTimestamp() - start);
     }
   }
 }
 
-static lpsLppShortPacket_t lppShortPacket;
-
 bool lpsSendLppShort(uint8_t destId, void* data, size_t length)
 {
   bool result = false;
+  lpsLppShortPacket_t lppShortPacket;
 
-  if (isInit)
+  if (isInit && length <= sizeof(lppShortPacket.data))
   {
     lppShortPacket.dest = destId;
     lppShortPacket.length = length;
     memcpy(lppShortPacket.data, data, length);
     result = xQueueSend(lppShortQueue, &lppShortPacket,0) == pdPASS;
+
+    if (result) {
+      lppShortQueued++;
+    } else {
+      lppShortRefused++;
+    }
   }
 
   return result;
@@ -391,7 +563,18 @@ bool lpsSendLppShort(uint8_t destId, void* data, size_t length)
 
 bool lpsGetLppShort(lpsLppShortPacket_t* shortPacket)
 {
-  return xQueueReceive(lppShortQueue, shortPacket, 0) == pdPASS;
+  bool result = xQueueReceive(lppShortQueue, shortPacket, 0) == pdPASS;
+  if (result) {
+    lppShortSent++;
+  }
+
+  return result;
+}
+
+void lpsLppShortPacketDiscarded()
+{
+  lppShortSent--;
+  lppShortDiscarded++;
 }
 
 static uint8_t spiTxBuffer[196];
@@ -402,7 +585,7 @@ static uint16_t spiSpeed = SPI_BAUDRATE_2MHZ;
 static void spiWrite(dwDevice_t* dev, const void *header, size_t headerLength,
                                       const void* data, size_t dataLength)
 {
-  spiBeginTransaction(spiSpeed);
+  spiBeginClientTransaction(spiClientLoco, spiSpeed, portMAX_DELAY);
   digitalWrite(CS_PIN, LOW);
   memcpy(spiTxBuffer, header, headerLength);
   memcpy(spiTxBuffer+headerLength, data, dataLength);
@@ -415,7 +598,7 @@ static void spiWrite(dwDevice_t* dev, const void *header, size_t headerLength,
 static void spiRead(dwDevice_t* dev, const void *header, size_t headerLength,
                                      void* data, size_t dataLength)
 {
-  spiBeginTransaction(spiSpeed);
+  spiBeginClientTransaction(spiClientLoco, spiSpeed, portMAX_DELAY);
   digitalWrite(CS_PIN, LOW);
   memcpy(spiTxBuffer, header, headerLength);
   memset(spiTxBuffer+headerLength, 0, dataLength);
@@ -437,6 +620,8 @@ static void spiRead(dwDevice_t* dev, const void *header, size_t headerLength,
     NVIC_ClearPendingIRQ(EXTI_IRQChannel);
     EXTI_ClearITPendingBit(EXTI_LineN);
 
+    irqTimestamp = (uint32_t)usecTimestamp();
+
     // Unlock interrupt handling task
     vTaskNotifyGiveFromISR(uwbTaskHandle, &xHigherPriorityTaskWoken);
 
@@ -550,6 +735,7 @@ static void dwm1000Init(DeckInfo *info)
   NVIC_Init(&NVIC_InitStructure);
 
   algoSemaphore= xSemaphoreCreateMutex();
+  lppShortQueue = STATIC_MEM_QUEUE_CREATE(lppShortQueue);
 
   xTaskCreate(uwbTask, LPS_DECK_TASK_NAME, 3 * configMINIMAL_STACK_SIZE, NULL,
                     LPS_DECK_TASK_PRI, &uwbTaskHandle);
@@ -606,8 +792,30 @@ LOG_GROUP_START(loco)
 LOG_ADD(LOG_UINT8, mode, &algoOptions.currentRangingMode)
 STATS_CNT_RATE_LOG_ADD(spiWr, &spiWriteCount)
 STATS_CNT_RATE_LOG_ADD(spiRe, &spiReadCount)
+LOG_ADD(LOG_UINT32, irqLat0, &irqLatencyHistogram[0])
+LOG_ADD(LOG_UINT32, irqLat1, &irqLatencyHistogram[1])
+LOG_ADD(LOG_UINT32, irqLat2, &irqLatencyHistogram[2])
+LOG_ADD(LOG_UINT32, irqLat3, &irqLatencyHistogram[3])
+LOG_ADD(LOG_UINT32, irqLat4, &irqLatencyHistogram[4])
+LOG_ADD(LOG_UINT32, irqLat5, &irqLatencyHistogram[5])
+LOG_ADD(LOG_UINT32, irqLat6, &irqLatencyHistogram[6])
+LOG_ADD(LOG_UINT32, irqLat7, &irqLatencyHistogram[7])
+LOG_ADD(LOG_UINT32, irqLatMax, &irqLatencyMax)
+STATS_CNT_RATE_LOG_ADD(evtRate, &eventRate)
+LOG_ADD(LOG_UINT32, evtTimeAvg, &logEventTimeAvg)
+LOG_ADD(LOG_UINT32, evtTimeMax, &logEventTimeMax)
+LOG_ADD(LOG_UINT32, lppQueued, &lppShortQueued)
+LOG_ADD(LOG_UINT32, lppRefused, &lppShortRefused)
+LOG_ADD(LOG_UINT32, lppSent, &lppShortSent)
+LOG_ADD(LOG_UINT32, lppDiscarded, &lppShortDiscarded)
+LOG_ADD(LOG_UINT32, anchorVer, &anchorMemSnapshot.version)
 LOG_GROUP_STOP(loco)
 
+/**
+ * Rate of the handled UWB events, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateUwb, eventRateSupervisor)
+
 PARAM_GROUP_START(loco)
 PARAM_ADD(PARAM_UINT8, mode, &algoOptions.userRequestedMode)
 PARAM_GROUP_STOP(loco)
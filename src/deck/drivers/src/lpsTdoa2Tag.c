@@ -75,9 +75,17 @@ static history_t history[LOCODECK_NR_OF_TDOA2_ANCHORS];
 
 
 // LPP packet handling
-static lpsLppShortPacket_t lppPacket;
-static bool lppPacketToSend;
-static int lppPacketSendTryCounter;
+// A packet can only be sent right after a packet from the destination anchor, a few packets are kept pending
+// so that a packet for one anchor does not block packets for the others.
+typedef struct {
+  lpsLppShortPacket_t packet;
+  bool toSend;
+  int sendTryCounter;
+  uint32_t order;
+} lppPendingPacket_t;
+
+static lppPendingPacket_t lppPending[TDOA2_LPP_PENDING_PACKETS];
+static uint32_t lppPendingOrder;
 
 static void lpsHandleLppShortPacket(const uint8_t srcId, const uint8_t *data, tdoaAnchorContext_t* anchorCtx);
 
@@ -173,6 +181,42 @@ static void sendLppShort(dwDevice_t *dev, lpsLppShortPacket_t *packet)
   dwStartTransmit(dev);
 }
 
+// Returns the oldest pending packet for an anchor, to keep the order of the packets to one anchor
+static lppPendingPacket_t* findLppPacketForAnchor(const uint8_t anchor) {
+  lppPendingPacket_t* result = 0;
+  for (int i = 0; i < TDOA2_LPP_PENDING_PACKETS; i++) {
+    lppPendingPacket_t* lpp = &lppPending[i];
+    if (lpp->toSend && lpp->packet.dest == anchor) {
+      if (!result || (int32_t)(lpp->order - result->order) < 0) {
+        result = lpp;
+      }
+    }
+  }
+
+  return result;
+}
+
+static void updatePendingLppPackets() {
+  for (int i = 0; i < TDOA2_LPP_PENDING_PACKETS; i++) {
+    lppPendingPacket_t* lpp = &lppPending[i];
+
+    // Discard lpp packet if we cannot send it for too long
+    if (lpp->toSend) {
+      if (++lpp->sendTryCounter >= TDOA2_LPP_PACKET_SEND_TIMEOUT) {
+        lpp->toSend = false;
+        lpsLppShortPacketDiscarded();
+      }
+    }
+
+    if (!lpp->toSend) {
+      // Get next lpp packet
+      lpp->toSend = lpsGetLppShort(&lpp->packet);
+      lpp->sendTryCounter = 0;
+      lpp->order = lppPendingOrder++;
+    }
+  }
+}
+
 static bool rxcallback(dwDevice_t *dev) {
   tdoaStats_t* stats = &tdoaEngineState.stats;
   STATS_CNT_RATE_EVENT(&stats->packetsReceived);
@@ -187,9 +231,11 @@ static bool rxcallback(dwDevice_t *dev) {
   if (packet->type == PACKET_TYPE_TDOA2) {
     const uint8_t anchor = rxPacket.sourceAddress & 0xff;
 
-    // Check if we need to send the current LPP packet
-    if (lppPacketToSend && lppPacket.dest == anchor) {
-      sendLppShort(dev, &lppPacket);
+    // Check if we have an LPP packet to send to this anchor
+    lppPendingPacket_t* lpp = findLppPacketForAnchor(anchor);
+    if (lpp) {
+      sendLppShort(dev, &lpp->packet);
+      lpp->toSend = false;
       lppSent = true;
     }
 
@@ -209,7 +255,7 @@ static bool rxcallback(dwDevice_t *dev) {
       tdoaEngineProcessPacket(&tdoaEngineState, &anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T);
       tdoaStorageSetRxTxData(&anchorCtx, rxAn_by_T_in_cl_T, txAn_in_cl_An, seqNr);
 
-      logClockCorrection[anchor] = tdoaStorageGetClockCorrection(&anchorCtx);
+      logClockCorrection[anchor] = clockCorrectionEngineToFloat(tdoaStorageGetClockCorrection(&anchorCtx));
 
       previousAnchor = anchor;
 
@@ -231,21 +277,13 @@ static void setRadioInReceiveMode(dwDevice_t *dev) {
 static uint32_t onEvent(dwDevice_t *dev, uwbEvent_t event) {
   switch(event) {
     case eventPacketReceived:
-      if (rxcallback(dev)) {
-        lppPacketToSend = false;
-      } else {
-        setRadioInReceiveMode(dev);
-
-        // Discard lpp packet if we cannot send it for too long
-        if (++lppPacketSendTryCounter >= TDOA2_LPP_PACKET_SEND_TIMEOUT) {
-          lppPacketToSend = false;
+      {
+        const bool lppSent = rxcallback(dev);
+        if (!lppSent) {
+          setRadioInReceiveMode(dev);
         }
-      }
 
-      if (!lppPacketToSend) {
-        // Get next lpp packet
-        lppPacketToSend = lpsGetLppShort(&lppPacket);
-        lppPacketSendTryCounter = 0;
+        updatePendingLppPackets();
       }
       break;
     case eventTimeout:
@@ -262,6 +300,8 @@ static uint32_t onEvent(dwDevice_t *dev, uwbEvent_t event) {
   }
 
   uint32_t now = xTaskGetTickCount();
+  tdoaStatsUpdate(&tdoaEngineState.stats, T2M(now));
+
   uint16_t rangingState = 0;
   for (int anchor = 0; anchor < LOCODECK_NR_OF_TDOA2_ANCHORS; anchor++) {
     if (now < history[anchor].anchorStatusTimeout) {
@@ -301,7 +341,8 @@ static void Initialize(dwDevice_t *dev) {
 
   previousAnchor = 0;
 
-  lppPacketToSend = false;
+  memset(lppPending, 0, sizeof(lppPending));
+  lppPendingOrder = 0;
 
   locoDeckSetRangingState(0);
   dwSetReceiveWaitTimeout(dev, TDOA2_RECEIVE_TIMEOUT);
@@ -320,7 +361,7 @@ static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
   tdoaAnchorContext_t anchorCtx;
   uint32_t now_ms = T2M(xTaskGetTickCount());
 
-  bool contextFound = tdoaStorageGetAnchorCtx(tdoaEngineState.anchorInfoArray, anchorId, now_ms, &anchorCtx);
+  bool contextFound = tdoaStorageGetAnchorCtx(&tdoaEngineState.anchorStorage, anchorId, now_ms, &anchorCtx);
   if (contextFound) {
     tdoaStorageGetAnchorPosition(&anchorCtx, position);
     return true;
@@ -330,12 +371,12 @@ static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
 }
 
 static uint8_t getAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
-  return tdoaStorageGetListOfAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize);
+  return tdoaStorageGetListOfAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize);
 }
 
 static uint8_t getActiveAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
-  return tdoaStorageGetListOfActiveAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize, now_ms);
+  return tdoaStorageGetListOfActiveAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize, now_ms);
 }
 
 // Loco Posisioning Protocol (LPP) handling
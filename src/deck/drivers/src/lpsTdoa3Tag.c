@@ -51,6 +51,7 @@ The implementation must handle
 #include "tdoaEngineInstance.h"
 #include "tdoaStats.h"
 #include "estimator.h"
+#include "estimator_kalman.h"
 
 #include "libdw1000.h"
 #include "mac.h"
@@ -184,6 +185,12 @@ static void rxcallback(dwDevice_t *dev) {
     tdoaAnchorContext_t anchorCtx;
     uint32_t now_ms = T2M(xTaskGetTickCount());
 
+    if (tdoaEngineState.matchingAlgorithm == TdoaEngineMatchingAlgorithmGeometry) {
+      point_t position;
+      estimatorKalmanGetEstimatedPos(&position);
+      tdoaEngineSetTagPosition(&tdoaEngineState, position.x, position.y, position.z);
+    }
+
     tdoaEngineGetAnchorCtxForPacketProcessing(&tdoaEngineState, anchorId, now_ms, &anchorCtx);
     int rangeDataLength = updateRemoteData(&anchorCtx, packet);
     tdoaEngineProcessPacket(&tdoaEngineState, &anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T);
@@ -271,11 +278,23 @@ static void sendTdoaToEstimatorCallback(tdoaMeasurement_t* tdoaMeasurement) {
   #endif
 }
 
+static void sendTdoaBatchToEstimatorCallback(tdoaBatchMeasurement_t* tdoaBatch) {
+  estimatorEnqueueTDOABatch(tdoaBatch);
+
+  #ifdef LPS_2D_POSITION_HEIGHT
+  heightMeasurement_t heightData;
+  heightData.timestamp = xTaskGetTickCount();
+  heightData.height = LPS_2D_POSITION_HEIGHT;
+  heightData.stdDev = 0.0001;
+  estimatorEnqueueAbsoluteHeight(&heightData);
+  #endif
+}
+
 static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
   tdoaAnchorContext_t anchorCtx;
   uint32_t now_ms = T2M(xTaskGetTickCount());
 
-  bool contextFound = tdoaStorageGetAnchorCtx(tdoaEngineState.anchorInfoArray, anchorId, now_ms, &anchorCtx);
+  bool contextFound = tdoaStorageGetAnchorCtx(&tdoaEngineState.anchorStorage, anchorId, now_ms, &anchorCtx);
   if (contextFound) {
     tdoaStorageGetAnchorPosition(&anchorCtx, position);
     return true;
@@ -285,17 +304,18 @@ static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
 }
 
 static uint8_t getAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
-  return tdoaStorageGetListOfAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize);
+  return tdoaStorageGetListOfAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize);
 }
 
 static uint8_t getActiveAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
-  return tdoaStorageGetListOfActiveAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize, now_ms);
+  return tdoaStorageGetListOfActiveAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize, now_ms);
 }
 
 static void Initialize(dwDevice_t *dev) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
   tdoaEngineInit(&tdoaEngineState, now_ms, sendTdoaToEstimatorCallback, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmRandom);
+  tdoaEngineSetBatchCallback(&tdoaEngineState, sendTdoaBatchToEstimatorCallback);
 
   #ifdef LPS_2D_POSITION_HEIGHT
   DEBUG_PRINT("2D positioning enabled at %f m height\n", LPS_2D_POSITION_HEIGHT);
@@ -35,6 +35,7 @@
 #include "task.h"
 
 #include "log.h"
+#include "param.h"
 #include "crtp_localization_service.h"
 
 #include "stabilizer_types.h"
@@ -68,6 +69,8 @@ static lpsTwrAlgoOptions_t defaultOptions = {
 
    .combinedAnchorPositionOk = false,
 
+   .schedule = lpsTwrScheduleRoundRobin,
+
  #ifdef LPS_TDMA_ENABLE
    .useTdma = true,
    .tdmaSlot = TDMA_SLOT,
@@ -91,6 +94,12 @@ typedef struct {
   float distance[LOCODECK_NR_OF_TWR_ANCHORS];
   float pressures[LOCODECK_NR_OF_TWR_ANCHORS];
   int failedRanging[LOCODECK_NR_OF_TWR_ANCHORS];
+
+  // Adaptive schedule
+  uint8_t roundsSinceAttempt[LOCODECK_NR_OF_TWR_ANCHORS];
+  float distanceChange[LOCODECK_NR_OF_TWR_ANCHORS];
+  uint32_t maxResponseTime; // In DW1000 ticks, during the current statistics period
+  uint16_t receiveTimeout;
 } twrState_t;
 
 static twrState_t state;
@@ -99,6 +108,15 @@ static lpsTwrAlgoOptions_t* options = &defaultOptions;
 // Outlier rejection
 #define RANGING_HISTORY_LENGTH 32
 #define OUTLIER_TH 4
+
+// Adaptive schedule
+// Anchors that do not respond are tried again after this number of rangings
+#define INACTIVE_ANCHOR_PROBE_INTERVAL 16
+// Anchors are prioritized by the change in distance since the previous ranging, in meters
+#define DISTANCE_CHANGE_SCALE 0.05f
+#define DISTANCE_CHANGE_MAX_GAIN 3.0f
+// The DW1000 receive timeout unit is 512 / 499.2 MHz, which is 2^16 DW1000 ticks
+#define TICKS_PER_RECEIVE_TIMEOUT_UNIT_BITS 16
 NO_DMA_CCM_SAFE_ZERO_INIT static struct {
   float32_t history[RANGING_HISTORY_LENGTH];
   size_t ptr;
@@ -127,6 +145,7 @@ static bool ranging_complete = false;
 static bool lpp_transaction = false;
 
 static lpsLppShortPacket_t lppShortPacket;
+static uint8_t lppBatchCount = 0;
 
 // TDMA handling
 static bool tdmaSynchronized;
@@ -233,7 +252,18 @@ static uint32_t rxcallback(dwDevice_t *dev) {
       tprop_ctn = ((tround1*tround2) - (treply1*treply2)) / (tround1 + tround2 + treply1 + treply2);
 
       tprop = tprop_ctn / LOCODECK_TS_FREQ;
+
+      const float previousDistance = state.distance[current_anchor];
       state.distance[current_anchor] = SPEED_OF_LIGHT * tprop;
+      if (previousDistance != 0.0f) {
+        state.distanceChange[current_anchor] = fabsf(state.distance[current_anchor] - previousDistance);
+      }
+
+      const uint32_t responseTime = answer_rx.low32 - poll_tx.low32;
+      if (responseTime > state.maxResponseTime) {
+        state.maxResponseTime = responseTime;
+      }
+
       state.pressures[current_anchor] = report->asl;
 
       // Outliers rejection
@@ -298,9 +328,82 @@ static dwTime_t transmitTimeForSlot(int slot)
   return transmitTime;
 }
 
+static bool isAnchorActive(const int anchor)
+{
+  return state.failedRanging[anchor] < options->rangingFailedThreshold;
+}
+
+// Pick the next anchor for the adaptive schedule. Anchors that have not been tried for a long time and anchors where
+// the distance changes quickly are prioritized, anchors that do not respond are only probed now and then.
+// Ties are resolved in round robin order.
+static uint8_t getNextAnchorAdaptive()
+{
+  int bestAnchor = -1;
+  float bestScore = 0.0f;
+
+  for (int i = 1; i <= LOCODECK_NR_OF_TWR_ANCHORS; i++) {
+    const int anchor = (current_anchor + i) % LOCODECK_NR_OF_TWR_ANCHORS;
+    const uint8_t rounds = state.roundsSinceAttempt[anchor];
+
+    if (isAnchorActive(anchor) || rounds >= INACTIVE_ANCHOR_PROBE_INTERVAL) {
+      const float gain = 1.0f + fminf(state.distanceChange[anchor] / DISTANCE_CHANGE_SCALE, DISTANCE_CHANGE_MAX_GAIN);
+      const float score = (rounds + 1) * gain;
+      if (score > bestScore) {
+        bestScore = score;
+        bestAnchor = anchor;
+      }
+    }
+  }
+
+  if (bestAnchor < 0) {
+    // No anchor is responding, fall back to round robin
+    bestAnchor = (current_anchor + 1) % LOCODECK_NR_OF_TWR_ANCHORS;
+  }
+
+  for (int i = 0; i < LOCODECK_NR_OF_TWR_ANCHORS; i++) {
+    if (i == bestAnchor) {
+      state.roundsSinceAttempt[i] = 0;
+    } else if (state.roundsSinceAttempt[i] < UINT8_MAX) {
+      state.roundsSinceAttempt[i]++;
+    }
+  }
+
+  return bestAnchor;
+}
+
+// Adapt the receive timeout to the slowest response measured during the last statistics period
+static void updateReceiveTimeout(dwDevice_t *dev)
+{
+  uint32_t timeout = TWR_RECEIVE_TIMEOUT;
+  if (state.maxResponseTime > 0) {
+    timeout = ((state.maxResponseTime >> TICKS_PER_RECEIVE_TIMEOUT_UNIT_BITS) * 3) / 2 + TWR_RECEIVE_TIMEOUT_MARGIN;
+    if (timeout < TWR_MIN_RECEIVE_TIMEOUT) {
+      timeout = TWR_MIN_RECEIVE_TIMEOUT;
+    }
+    if (timeout > TWR_RECEIVE_TIMEOUT) {
+      timeout = TWR_RECEIVE_TIMEOUT;
+    }
+  }
+  state.maxResponseTime = 0;
+
+  if (timeout != state.receiveTimeout) {
+    state.receiveTimeout = timeout;
+    dwIdle(dev);
+    dwSetReceiveWaitTimeout(dev, state.receiveTimeout);
+    dwCommitConfiguration(dev);
+  }
+}
+
+static bool useAdaptiveSchedule()
+{
+  return options->schedule == lpsTwrScheduleAdaptive && !options->useTdma;
+}
+
 static void initiateRanging(dwDevice_t *dev)
 {
-  if (!options->useTdma || tdmaSynchronized) {
+  if (useAdaptiveSchedule()) {
+    current_anchor = getNextAnchorAdaptive();
+  } else if (!options->useTdma || tdmaSynchronized) {
     if (options->useTdma) {
       // go to next TDMA frame
       frameStart.full += TDMA_FRAME_LEN;
@@ -410,13 +513,20 @@ static uint32_t twrTagOnEvent(dwDevice_t *dev, uwbEvent_t event)
           failedRanging[i] = 0;
           succededRanging[i] = 0;
         }
+
+        if (useAdaptiveSchedule()) {
+          updateReceiveTimeout(dev);
+        }
       }
 
 
-      if (lpsGetLppShort(&lppShortPacket)) {
+      // Send queued LPP packets in batches, with a ranging in between to keep positioning going
+      if (lppBatchCount < LPS_TWR_LPP_BATCH_SIZE && lpsGetLppShort(&lppShortPacket)) {
+        lppBatchCount++;
         lpp_transaction = true;
         sendLppShort(dev, &lppShortPacket);
       } else {
+        lppBatchCount = 0;
         lpp_transaction = false;
         ranging_complete = false;
         initiateRanging(dev);
@@ -485,14 +595,19 @@ static void twrTagInit(dwDevice_t *dev)
 
   locoDeckSetRangingState(0);
   ranging_complete = false;
+  lppBatchCount = 0;
 
   tdmaSynchronized = false;
 
   memset(state.distance, 0, sizeof(state.distance));
   memset(state.pressures, 0, sizeof(state.pressures));
   memset(state.failedRanging, 0, sizeof(state.failedRanging));
+  memset(state.roundsSinceAttempt, 0, sizeof(state.roundsSinceAttempt));
+  memset(state.distanceChange, 0, sizeof(state.distanceChange));
+  state.maxResponseTime = 0;
+  state.receiveTimeout = TWR_RECEIVE_TIMEOUT;
 
-  dwSetReceiveWaitTimeout(dev, TWR_RECEIVE_TIMEOUT);
+  dwSetReceiveWaitTimeout(dev, state.receiveTimeout);
 
   dwCommitConfiguration(dev);
 
@@ -533,7 +648,7 @@ static uint8_t getActiveAnchorIdList(uint8_t unorderedAnchorList[], const int ma
   uint8_t count = 0;
 
   for (int i = 0; i < LOCODECK_NR_OF_TWR_ANCHORS; i++) {
-    if (state.failedRanging[i] < options->rangingFailedThreshold) {
+    if (isAnchorActive(i)) {
       unorderedAnchorList[count] = i;
       count++;
     }
@@ -616,3 +731,7 @@ LOG_ADD(LOG_FLOAT, pressure6, &state.pressures[6])
 LOG_ADD(LOG_FLOAT, pressure7, &state.pressures[7])
 #endif
 LOG_GROUP_STOP(ranging)
+
+PARAM_GROUP_START(twr)
+PARAM_ADD(PARAM_UINT8, schedule, &defaultOptions.schedule)
+PARAM_GROUP_STOP(twr)
@@ -35,11 +35,14 @@
 #include "vl53l1x.h"
 #include "range.h"
 #include "static_mem.h"
+#include "usec_time.h"
+#include "rateSupervisor.h"
 
 #include "i2cdev.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
 #include <stdlib.h>
 
@@ -82,59 +85,133 @@ static bool mrInitSensor(VL53L1_Dev_t *pdev, uint32_t pca95pin, char *name)
   return status;
 }
 
-static uint16_t mrGetMeasurementAndRestart(VL53L1_Dev_t *dev)
+// VL53L1 registers used to poll the data ready status of all sensors in one transfer
+#define MR_REG_GPIO_HV_MUX_CTRL 0x0030
+#define MR_REG_GPIO_TIO_HV_STATUS 0x0031
+#define MR_GPIO_HV_MUX_POLARITY_BIT 0x10
+
+// Interval between data ready polls. The sensors are ranging continuously and are read as soon as they are ready.
+#define MR_POLL_INTERVAL M2T(10)
+#define MR_POLL_TIMEOUT M2T(10)
+// Allowed deviation of the poll rate [1/1000]
+#define MR_POLL_RATE_TOLERANCE 50
+
+static rateSupervisor_t rateSupervisorContext;
+
+typedef struct {
+  VL53L1_Dev_t *dev;
+  uint32_t pca95pin;
+  char *name;
+  rangeDirection_t direction;
+  bool isInit;
+  uint8_t readyLevel;   // Value of the data ready bit when a measurement is ready
+  uint8_t status;       // GPIO__TIO_HV_STATUS, read by the poll transfer
+} mrSensor_t;
+
+static mrSensor_t sensors[] = {
+  {.dev = &devFront, .pca95pin = MR_PIN_FRONT, .name = "front", .direction = rangeFront},
+  {.dev = &devBack, .pca95pin = MR_PIN_BACK, .name = "back", .direction = rangeBack},
+  {.dev = &devUp, .pca95pin = MR_PIN_UP, .name = "up", .direction = rangeUp},
+  {.dev = &devLeft, .pca95pin = MR_PIN_LEFT, .name = "left", .direction = rangeLeft},
+  {.dev = &devRight, .pca95pin = MR_PIN_RIGHT, .name = "right", .direction = rangeRight},
+};
+#define MR_SENSOR_COUNT ((int)(sizeof(sensors) / sizeof(sensors[0])))
+
+// Poll messages of the sensors that were initialized, in the same order as polledSensors
+static I2cMessage pollMessages[MR_SENSOR_COUNT];
+static mrSensor_t *polledSensors[MR_SENSOR_COUNT];
+static int polledSensorCount;
+static I2cTransfer pollTransfer;
+static SemaphoreHandle_t pollDone;
+static StaticSemaphore_t pollDoneBuffer;
+
+static uint32_t pollCount;
+static uint32_t pollFailCount;
+
+static void mrPollDoneCallback(I2cTransfer *transfer, bool success)
 {
-    VL53L1_Error status = VL53L1_ERROR_NONE;
-    VL53L1_RangingMeasurementData_t rangingData;
-    uint8_t dataReady = 0;
-    uint16_t range;
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  xSemaphoreGiveFromISR(pollDone, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
-    while (dataReady == 0)
-    {
-        status = VL53L1_GetMeasurementDataReady(dev, &dataReady);
-        vTaskDelay(M2T(1));
-    }
+static void mrStartRanging(mrSensor_t *sensor)
+{
+  uint8_t muxCtrl = 0;
+  VL53L1_RdByte(sensor->dev, MR_REG_GPIO_HV_MUX_CTRL, &muxCtrl);
+  sensor->readyLevel = (muxCtrl & MR_GPIO_HV_MUX_POLARITY_BIT) ? 0 : 1;
 
-    status = VL53L1_GetRangingMeasurementData(dev, &rangingData);
-    range = rangingData.RangeMilliMeter;
+  VL53L1_StopMeasurement(sensor->dev);
+  VL53L1_StartMeasurement(sensor->dev);
 
-    VL53L1_StopMeasurement(dev);
-    status = VL53L1_StartMeasurement(dev);
-    status = status;
+  i2cdrvCreateMessageIntAddr(&pollMessages[polledSensorCount], sensor->dev->devAddr, true, MR_REG_GPIO_TIO_HV_STATUS,
+                             i2cRead, 1, &sensor->status);
+  polledSensors[polledSensorCount] = sensor;
+  polledSensorCount++;
+}
+
+// Reads the data ready status of all sensors in one queued transfer, the task is free while it is on the bus
+static bool mrPollDataReady()
+{
+  pollTransfer.messages = pollMessages;
+  pollTransfer.nbrOfMessages = polledSensorCount;
+  pollTransfer.priority = i2cPriorityLow;
+  pollTransfer.callback = mrPollDoneCallback;
+  pollTransfer.callbackArg = NULL;
+
+  xSemaphoreTake(pollDone, 0);
+  i2cdrvSubmitTransfer(I2C1_DEV, &pollTransfer);
+
+  if (xSemaphoreTake(pollDone, MR_POLL_TIMEOUT) != pdTRUE) {
+    i2cdrvCancelTransfer(I2C1_DEV, &pollTransfer);
+    return false;
+  }
 
-    return range;
+  return pollTransfer.isSuccess;
 }
 
 static void mrTask(void *param)
 {
-    VL53L1_Error status = VL53L1_ERROR_NONE;
-
     systemWaitStart();
 
-    // Restart all sensors
-    status = VL53L1_StopMeasurement(&devFront);
-    status = VL53L1_StartMeasurement(&devFront);
-    status = VL53L1_StopMeasurement(&devBack);
-    status = VL53L1_StartMeasurement(&devBack);
-    status = VL53L1_StopMeasurement(&devUp);
-    status = VL53L1_StartMeasurement(&devUp);
-    status = VL53L1_StopMeasurement(&devLeft);
-    status = VL53L1_StartMeasurement(&devLeft);
-    status = VL53L1_StopMeasurement(&devRight);
-    status = VL53L1_StartMeasurement(&devRight);
-    status = status;
+    for (int i = 0; i < MR_SENSOR_COUNT; i++) {
+      if (sensors[i].isInit) {
+        mrStartRanging(&sensors[i]);
+      }
+    }
+
+    if (polledSensorCount == 0) {
+      vTaskDelete(NULL);
+    }
 
     TickType_t lastWakeTime = xTaskGetTickCount();
+    rateSupervisorInitRate(&rateSupervisorContext, T2M(lastWakeTime), 1000 / T2M(MR_POLL_INTERVAL), MR_POLL_RATE_TOLERANCE, 1);
+    rateSupervisorRegister(&rateSupervisorContext, "multiranger");
 
     while (1)
     {
-        vTaskDelayUntil(&lastWakeTime, M2T(100));
-
-        rangeSet(rangeFront, mrGetMeasurementAndRestart(&devFront)/1000.0f);
-        rangeSet(rangeBack, mrGetMeasurementAndRestart(&devBack)/1000.0f);
-        rangeSet(rangeUp, mrGetMeasurementAndRestart(&devUp)/1000.0f);
-        rangeSet(rangeLeft, mrGetMeasurementAndRestart(&devLeft)/1000.0f);
-        rangeSet(rangeRight, mrGetMeasurementAndRestart(&devRight)/1000.0f);
+        vTaskDelayUntil(&lastWakeTime, MR_POLL_INTERVAL);
+        rateSupervisorTick(&rateSupervisorContext, T2M(xTaskGetTickCount()), (uint32_t)usecTimestamp());
+
+        pollCount++;
+        if (!mrPollDataReady()) {
+          pollFailCount++;
+          continue;
+        }
+
+        const uint32_t now = xTaskGetTickCount();
+        for (int i = 0; i < polledSensorCount; i++) {
+          mrSensor_t *sensor = polledSensors[i];
+          if ((sensor->status & 0x01) != sensor->readyLevel) {
+            continue;
+          }
+
+          VL53L1_RangingMeasurementData_t rangingData;
+          if (VL53L1_GetRangingMeasurementData(sensor->dev, &rangingData) == VL53L1_ERROR_NONE) {
+            rangeSetWithTimestamp(sensor->direction, rangingData.RangeMilliMeter / 1000.0f, now);
+          }
+          VL53L1_ClearInterruptAndStartMeasurement(sensor->dev);
+        }
     }
 }
 
@@ -159,6 +236,8 @@ static void mrInit()
                        MR_PIN_FRONT |
                        MR_PIN_BACK);
 
+    pollDone = xSemaphoreCreateBinaryStatic(&pollDoneBuffer);
+
     isInit = true;
 
     xTaskCreate(mrTask, MULTIRANGER_TASK_NAME, MULTIRANGER_TASK_STACKSIZE, NULL,
@@ -174,11 +253,10 @@ static bool mrTest()
 
     isPassed = isInit;
 
-    isPassed &= mrInitSensor(&devFront, MR_PIN_FRONT, "front");
-    isPassed &= mrInitSensor(&devBack, MR_PIN_BACK, "back");
-    isPassed &= mrInitSensor(&devUp, MR_PIN_UP, "up");
-    isPassed &= mrInitSensor(&devLeft, MR_PIN_LEFT, "left");
-    isPassed &= mrInitSensor(&devRight, MR_PIN_RIGHT, "right");
+    for (int i = 0; i < MR_SENSOR_COUNT; i++) {
+      sensors[i].isInit = mrInitSensor(sensors[i].dev, sensors[i].pca95pin, sensors[i].name);
+      isPassed &= sensors[i].isInit;
+    }
 
     isTested = true;
 
@@ -201,3 +279,13 @@ DECK_DRIVER(multiranger_deck);
 PARAM_GROUP_START(deck)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, bcMultiranger, &isInit)
 PARAM_GROUP_STOP(deck)
+
+LOG_GROUP_START(mr)
+LOG_ADD(LOG_UINT32, polls, &pollCount)
+LOG_ADD(LOG_UINT32, pollFails, &pollFailCount)
+LOG_GROUP_STOP(mr)
+
+/**
+ * Rate of the data ready polls of the multiranger, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateMr, rateSupervisorContext)
@@ -33,6 +33,7 @@
 #define DEBUG_MODULE "uSD"
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -58,6 +59,7 @@
 #include "log.h"
 #include "param.h"
 #include "crc32.h"
+#include "columnBlock.h"
 #include "static_mem.h"
 #include "mem.h"
 #include "eventtrigger.h"
@@ -83,7 +85,7 @@
 #define USD_SPI_BAUDRATE_2MHZ   SPI_BAUDRATE_2MHZ
 #define USD_SPI_BAUDRATE_21MHZ  SPI_BAUDRATE_21MHZ
 #define SPI_EXCHANGE            spiExchange
-#define SPI_BEGIN_TRANSACTION   spiBeginTransaction
+#define SPI_BEGIN_TRANSACTION(speed) spiBeginClientTransaction(spiClientUsd, speed, portMAX_DELAY)
 #define SPI_END_TRANSACTION     spiEndTransaction
 #endif
 
@@ -91,12 +93,27 @@
 #define MAX_USD_LOG_EVENTS                (20)
 #define FIXED_FREQUENCY_EVENT_ID          (0xFFFF)
 #define FIXED_FREQUENCY_EVENT_NAME        "fixedFrequency"
+// Payload and log variables of an event, one type character each
+#define MAX_USD_LOG_COLUMNS_PER_EVENT     (2 * MAX_USD_LOG_VARIABLES_PER_EVENT)
+#define MAX_USD_LOG_ROWS_PER_BLOCK        (32)
+
+enum usddeckFileFormat_e {
+  usddeckFileFormat_Events = 0, // one record per sample
+  usddeckFileFormat_Blocks = 1, // column oriented blocks of samples, see columnBlock.h
+};
 
 typedef struct usdLogEventConfig_s {
   uint16_t eventId;
   uint8_t numVars;
   uint16_t numBytes;
   logVarId_t varIds[MAX_USD_LOG_VARIABLES_PER_EVENT];
+
+  // Types and size of a sample, and the samples collected for the next block
+  char format[MAX_USD_LOG_COLUMNS_PER_EVENT + 1];
+  uint8_t* rows;
+  uint16_t rowSize;
+  uint16_t numRows;
+  uint16_t maxRows;
 } usdLogEventConfig_t;
 
 typedef struct usdLogConfig_s {
@@ -105,6 +122,7 @@ typedef struct usdLogConfig_s {
   uint16_t bufferSize;
   bool enableOnStartup;
   enum usddeckLoggingMode_e mode;
+  enum usddeckFileFormat_e fileFormat;
 
   uint32_t numEventConfigs;
   usdLogEventConfig_t eventConfigs[MAX_USD_LOG_EVENTS];
@@ -114,39 +132,57 @@ typedef struct usdLogConfig_s {
 typedef struct usdLogStats_s {
   uint32_t eventsRequested;
   uint32_t eventsWritten;
+  uint32_t eventsDropped;     // samples lost because the log buffer was full
+  uint16_t bufferFill;        // bytes in the log buffer after the last push
+  uint16_t bufferFillMax;
+  uint32_t pushTimeMax;       // worst case time to add a sample [us]
 } usdLogStats_t;
 
 // Ring buffer
+//
+// Single producer, single consumer: the producer only writes writeIndex and
+// the consumer only writes readIndex, so neither side waits for the other.
+// The producers are serialized by logBufferMutex, the write task is the only
+// consumer and pops without taking it. One byte is kept free to tell a full
+// buffer from an empty one.
 typedef struct ringBuffer_s {
-  uint8_t* buffer;        // pointer to buffer
-  uint16_t capacity;      // total capacity of buffer
-  uint16_t size;          // used size of buffer
-  uint8_t* readPtr;       // pointer for read/pop
-  uint8_t* writePtr;      // pointer for write/push
-  uint16_t popSize;       // size for ongoing pop operation
+  uint8_t* buffer;                // pointer to buffer
+  uint16_t capacity;              // total capacity of buffer
+  volatile uint16_t writeIndex;   // position for write/push
+  volatile uint16_t readIndex;    // position for read/pop
+  uint16_t popSize;               // size for ongoing pop operation
 } ringBuffer_t;
 
 void ringBuffer_init(ringBuffer_t* b, uint8_t *buffer, uint16_t capacity)
 {
   b->buffer = buffer;
   b->capacity = capacity;
-  b->size = 0;
-  b->readPtr = buffer;
-  b->writePtr = buffer;
+  b->writeIndex = 0;
+  b->readIndex = 0;
   b->popSize = 0;
 }
 
+// Only when neither side is using the buffer
 void ringBuffer_reset(ringBuffer_t *b)
 {
-  b->size = 0;
-  b->readPtr = b->buffer;
-  b->writePtr = b->buffer;
+  b->writeIndex = 0;
+  b->readIndex = 0;
   b->popSize = 0;
 }
 
+uint16_t ringBuffer_size(const ringBuffer_t* b)
+{
+  const uint16_t writeIndex = b->writeIndex;
+  const uint16_t readIndex = b->readIndex;
+  if (writeIndex >= readIndex) {
+    return writeIndex - readIndex;
+  }
+  return b->capacity - readIndex + writeIndex;
+}
+
 uint16_t ringBuffer_availableSpace(const ringBuffer_t* b)
 {
-  return b->capacity - b->size;
+  return b->capacity - 1 - ringBuffer_size(b);
 }
 
 bool ringBuffer_push(ringBuffer_t* b, const void* data, uint16_t size)
@@ -154,33 +190,38 @@ bool ringBuffer_push(ringBuffer_t* b, const void* data, uint16_t size)
   if (ringBuffer_availableSpace(b) < size) {
     return false;
   }
+
   const uint8_t* dataTyped = (const uint8_t*)data;
-  for (uint16_t i = 0; i < size; ++i) {
-    *(b->writePtr) = dataTyped[i];
-    ++b->writePtr;
-    if (b->writePtr ==  b->buffer + b->capacity) {
-      b->writePtr = b->buffer;
-    }
+  const uint16_t index = b->writeIndex;
+  uint16_t firstPart = b->capacity - index;
+  if (firstPart > size) {
+    firstPart = size;
   }
-  b->size += size;
+  memcpy(&b->buffer[index], dataTyped, firstPart);
+  memcpy(b->buffer, &dataTyped[firstPart], size - firstPart);
+
+  // Publish the data after it is in the buffer
+  __DMB();
+  b->writeIndex = ((uint32_t)index + size) % b->capacity;
   return true;
 }
 
 bool ringBuffer_pop_start(ringBuffer_t* b, const uint8_t** buf, uint16_t* size)
 {
-  if (b->size == 0) {
+  const uint16_t writeIndex = b->writeIndex;
+  const uint16_t readIndex = b->readIndex;
+  if (writeIndex == readIndex) {
     return false;
   }
+  __DMB();
 
-  *buf = b->readPtr;
-  if (b->writePtr > b->readPtr) {
+  *buf = &b->buffer[readIndex];
+  if (writeIndex > readIndex) {
     // writer did not wrap around yet
-    *size = b->writePtr - b->readPtr;
-    b->readPtr = b->writePtr;
+    *size = writeIndex - readIndex;
   } else {
     // wrap around -> read until end of buffer, only
-    *size = b->buffer + b->capacity - b->readPtr;
-    b->readPtr = b->buffer;
+    *size = b->capacity - readIndex;
   }
   b->popSize = *size;
   return true;
@@ -188,7 +229,9 @@ bool ringBuffer_pop_start(ringBuffer_t* b, const uint8_t** buf, uint16_t* size)
 
 void ringBuffer_pop_done(ringBuffer_t *b)
 {
-  b->size -= b->popSize;
+  // Release the space after the data has been used
+  __DMB();
+  b->readIndex = ((uint32_t)b->readIndex + b->popSize) % b->capacity;
   b->popSize = 0;
 }
 
@@ -214,6 +257,8 @@ static usdLogConfig_t usdLogConfig;
 static usdLogStats_t usdLogStats;
 
 static BYTE exchangeBuff[512];
+// Clocked out while receiving, the card expects DI to be held high
+static BYTE idleTxBuff[512];
 static uint16_t spiSpeed;
 
 #ifdef USD_RUN_DISKIO_FUNCTION_TESTS
@@ -226,6 +271,47 @@ static FATFS FatFs;
 static FIL logFile;
 static SemaphoreHandle_t logFileMutex;
 
+// Download session, the log file is kept open for reading between memory
+// reads and read ahead one block at a time. Protected by logFileMutex.
+#define USD_READ_AHEAD_SIZE 512
+// Room for the cluster link map of a file in up to 31 fragments
+#define USD_LINK_MAP_SIZE 64
+// File served by the memory interface, the last log file or one selected by usd.readFile
+#define USD_READ_FILE_LATEST 0xFF
+#define USD_READ_FILE_INDEX 0xFE
+static FIL readFile;
+static bool readFileIsOpen;
+static char readFileName[16];
+static uint8_t readFileSelection = USD_READ_FILE_LATEST;
+static DWORD readFileLinkMap[USD_LINK_MAP_SIZE];
+static uint8_t readAheadBuffer[USD_READ_AHEAD_SIZE];
+static uint32_t readAheadOffset;
+static uint32_t readAheadLength;
+
+// The log file is written in whole sectors, FatFs then writes the data
+// directly to the card, using multi block writes
+#define USD_WRITE_CHUNK_SIZE 2048
+static uint8_t writeChunk[USD_WRITE_CHUNK_SIZE];
+static uint16_t writeChunkLength;
+// Size to allocate for the log file when it is created, the FAT is then not
+// updated while logging. The unused part is released when logging stops.
+static uint16_t preallocateMB = 0;
+static bool isPreallocated;
+
+// A session is split into files when one is larger or older than the limits.
+// Every file is listed in the index file, <file name>.idx
+static uint16_t rotateMB = 0;
+static uint16_t rotateS = 0;
+static uint32_t segmentSize;
+static uint64_t segmentStartTime;
+static char sessionFileName[13];
+static char indexFileName[16];
+// Position in the record (event or block) that is being written
+static uint8_t recordHeader[COLUMN_BLOCK_HEADER_SIZE];
+static uint8_t recordHeaderLength;
+static uint32_t recordBytesLeft;
+static bool recordParseFailed;
+
 static SemaphoreHandle_t logBufferMutex;
 static ringBuffer_t logBuffer;
 static TaskHandle_t xHandleWriteTask;
@@ -276,6 +362,7 @@ static sdSpiContext_t sdSpiContext =
 static void initSpi(void)
 {
   SPI_BEGIN();   /* Enable SPI function */
+  memset(idleTxBuff, 0xFF, sizeof(idleTxBuff));
   spiSpeed = USD_SPI_BAUDRATE_2MHZ;
 
   pinMode(USD_CS_PIN, OUTPUT);
@@ -311,8 +398,7 @@ static void rcvrSpiMulti(BYTE *buff, UINT btr)
 {
   STATS_CNT_RATE_MULTI_EVENT(&spiReadRate, btr);
 
-  memset(exchangeBuff, 0xFFFFFFFF, btr);
-  SPI_EXCHANGE(btr, exchangeBuff, buff);
+  SPI_EXCHANGE(btr, idleTxBuff, buff);
 }
 
 /* Send multiple byte */
@@ -427,6 +513,125 @@ TCHAR* f_gets_without_comments (
   return n ? buff : 0;      /* When no data read (eof or error), return with error. */
 }
 
+/*********** Log format helper functions ***************/
+
+// Type characters as used by the python struct module
+static char logTypeChar(int type)
+{
+  switch (type) {
+    case LOG_UINT8:
+      return 'B';
+    case LOG_INT8:
+      return 'b';
+    case LOG_UINT16:
+      return 'H';
+    case LOG_INT16:
+      return 'h';
+    case LOG_UINT32:
+      return 'I';
+    case LOG_INT32:
+      return 'i';
+    case LOG_FLOAT:
+      return 'f';
+    default:
+      ASSERT(false);
+      return 0;
+  }
+}
+
+static char payloadTypeChar(enum eventtriggerType_e type)
+{
+  switch (type) {
+    case eventtriggerType_uint8:
+      return 'B';
+    case eventtriggerType_int8:
+      return 'b';
+    case eventtriggerType_uint16:
+      return 'H';
+    case eventtriggerType_int16:
+      return 'h';
+    case eventtriggerType_uint32:
+      return 'I';
+    case eventtriggerType_int32:
+      return 'i';
+    case eventtriggerType_float:
+      return 'f';
+    default:
+      ASSERT(false);
+      return 0;
+  }
+}
+
+// Types of the payload followed by the log variables, in the order they are logged
+static bool usddeckSetFormat(usdLogEventConfig_t* cfg)
+{
+  int length = 0;
+  cfg->format[0] = 0;
+
+  if (cfg->eventId != FIXED_FREQUENCY_EVENT_ID) {
+    const eventtrigger *et = eventtriggerGetById(cfg->eventId);
+    if (et->numPayloadVariables + cfg->numVars > MAX_USD_LOG_COLUMNS_PER_EVENT) {
+      return false;
+    }
+    for (int i = 0; i < et->numPayloadVariables; ++i) {
+      cfg->format[length++] = payloadTypeChar(et->payloadDesc[i].type);
+    }
+  }
+  for (int i = 0; i < cfg->numVars; ++i) {
+    cfg->format[length++] = logTypeChar(logGetType(cfg->varIds[i]));
+  }
+  cfg->format[length] = 0;
+  cfg->rowSize = columnBlockRowSize(cfg->format);
+
+  return true;
+}
+
+static uint8_t* blockBuffer;
+
+// Split the log buffer between the events, a block must fit in half of the log
+// buffer to be written while the other half is filled
+static bool usddeckAllocateBlocks(void)
+{
+  uint32_t blockBufferSize = 0;
+  for (int i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+    usdLogEventConfig_t* cfg = &usdLogConfig.eventConfigs[i];
+
+    cfg->maxRows = MAX_USD_LOG_ROWS_PER_BLOCK;
+    while (cfg->maxRows > 1 && columnBlockMaxSize(cfg->format, cfg->maxRows) > usdLogConfig.bufferSize / 2) {
+      --cfg->maxRows;
+    }
+
+    uint32_t maxSize = columnBlockMaxSize(cfg->format, cfg->maxRows);
+    if (maxSize >= usdLogConfig.bufferSize) {
+      DEBUG_PRINT("Log buffer too small for blocks of %d B\n", (int)maxSize);
+      return false;
+    }
+    if (maxSize > blockBufferSize) {
+      blockBufferSize = maxSize;
+    }
+
+    cfg->numRows = 0;
+    cfg->rows = pvPortMalloc(cfg->maxRows * cfg->rowSize);
+    if (!cfg->rows) {
+      return false;
+    }
+  }
+
+  blockBuffer = pvPortMalloc(blockBufferSize);
+  return blockBuffer != 0;
+}
+
+// Encode the collected samples of an event into blockBuffer, returns the size of the block
+static uint32_t usddeckEncodeBlock(usdLogEventConfig_t* cfg)
+{
+  uint32_t length = 0;
+  int result = columnBlockEncode(blockBuffer, columnBlockMaxSize(cfg->format, cfg->maxRows), &length,
+    cfg->eventId, cfg->format, cfg->rows, cfg->numRows);
+  ASSERT(result == 0);
+  cfg->numRows = 0;
+  return length;
+}
+
 
 /*********** Deck driver initialization ***************/
 
@@ -455,23 +660,42 @@ static void usdInit(DeckInfo *info)
   isInit = true;
 }
 
-static void usddeckWriteEventData(const usdLogEventConfig_t* cfg, const uint8_t* payload, uint8_t payloadSize)
+// Add a sample to the block of the event, the block is moved to the log buffer when it is full
+static void usddeckAddBlockRow(usdLogEventConfig_t* cfg, uint64_t ticks, const uint8_t* payload, uint8_t payloadSize)
 {
-  uint64_t ticks = usecTimestamp();
-
-  if (!enableLogging) {
+  if (sizeof(ticks) + payloadSize + cfg->numBytes != cfg->rowSize) {
     return;
   }
 
-  ++usdLogStats.eventsRequested;
-
-  xSemaphoreTake(logBufferMutex, portMAX_DELAY);
-
-  // trigger writing once there is some data
-  if (logBuffer.size > 0 && xHandleWriteTask) {
-    vTaskResume(xHandleWriteTask);
+  uint8_t* row = &cfg->rows[cfg->numRows * cfg->rowSize];
+  memcpy(row, &ticks, sizeof(ticks));
+  row += sizeof(ticks);
+  if (payloadSize) {
+    memcpy(row, payload, payloadSize);
+    row += payloadSize;
   }
+  for (int i = 0; i < cfg->numVars; ++i) {
+    logVarId_t varid = cfg->varIds[i];
+    int size = logVarSize(logGetType(varid));
+    memcpy(row, logGetAddress(varid), size);
+    row += size;
+  }
+  ++cfg->numRows;
+  ++usdLogStats.eventsWritten;
+
+  if (cfg->numRows == cfg->maxRows) {
+    uint16_t numRows = cfg->numRows;
+    uint32_t length = usddeckEncodeBlock(cfg);
+    if (!ringBuffer_push(&logBuffer, blockBuffer, length)) {
+      usdLogStats.eventsWritten -= numRows;
+      usdLogStats.eventsDropped += numRows;
+    }
+  }
+}
 
+// Add a sample as a record to the log buffer
+static void usddeckAddEventRecord(const usdLogEventConfig_t* cfg, uint64_t ticks, const uint8_t* payload, uint8_t payloadSize)
+{
   int dataSize = sizeof(cfg->eventId) + sizeof(ticks) + payloadSize + cfg->numBytes;
 
   // only write if we have enough space
@@ -506,16 +730,53 @@ static void usddeckWriteEventData(const usdLogEventConfig_t* cfg, const uint8_t*
       }
     }
     ++usdLogStats.eventsWritten;
+  } else {
+    ++usdLogStats.eventsDropped;
+  }
+}
+
+static void usddeckWriteEventData(usdLogEventConfig_t* cfg, uint64_t ticks, const uint8_t* payload, uint8_t payloadSize)
+{
+  uint64_t start = usecTimestamp();
+
+  if (!enableLogging) {
+    return;
+  }
+
+  // Only other producers can hold the mutex, the write task does not take it while logging
+  xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+
+  ++usdLogStats.eventsRequested;
+
+  // trigger writing once there is some data
+  if (ringBuffer_size(&logBuffer) > 0 && xHandleWriteTask) {
+    vTaskResume(xHandleWriteTask);
+  }
+
+  if (usdLogConfig.fileFormat == usddeckFileFormat_Blocks) {
+    usddeckAddBlockRow(cfg, ticks, payload, payloadSize);
+  } else {
+    usddeckAddEventRecord(cfg, ticks, payload, payloadSize);
+  }
+
+  usdLogStats.bufferFill = ringBuffer_size(&logBuffer);
+  if (usdLogStats.bufferFill > usdLogStats.bufferFillMax) {
+    usdLogStats.bufferFillMax = usdLogStats.bufferFill;
   }
+
   xSemaphoreGive(logBufferMutex);
+
+  uint32_t pushTime = usecTimestamp() - start;
+  if (pushTime > usdLogStats.pushTimeMax) {
+    usdLogStats.pushTimeMax = pushTime;
+  }
 }
 
-static void usddeckEventtriggerCallback(const eventtrigger *event)
+static void usddeckEventtriggerCallback(const eventtriggerRecord *record)
 {
-  uint16_t eventId = eventtriggerGetId(event);
   for (uint8_t i = 0; i < usdLogConfig.numEventConfigs; ++i) {
-    if (usdLogConfig.eventConfigs[i].eventId == eventId) {
-      usddeckWriteEventData(&usdLogConfig.eventConfigs[i], event->payload, event->payloadSize);
+    if (usdLogConfig.eventConfigs[i].eventId == record->id) {
+      usddeckWriteEventData(&usdLogConfig.eventConfigs[i], record->timestamp, record->payload, record->payloadSize);
       break;
     }
   }
@@ -547,7 +808,7 @@ static void usdLogTask(void* prm)
       TCHAR* line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
       if (!line) break;
       int version = strtol(line, &endptr, 10);
-      if (version != 1) break;
+      if (version != 1 && version != 2) break;
       // buffer size
       line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
       if (!line) break;
@@ -560,15 +821,26 @@ static void usdLogTask(void* prm)
       if (l > sizeof(usdLogConfig.filename) - 3) {
         l = sizeof(usdLogConfig.filename) - 3;
       }
+      usdLogConfig.filename[l] = 0;
+      snprintf(indexFileName, sizeof(indexFileName), "%s.idx", usdLogConfig.filename);
       usdLogConfig.filename[l] = '0';
       usdLogConfig.filename[l+1] = '0';
       usdLogConfig.filename[l+2] = 0;
+      strcpy(readFileName, usdLogConfig.filename);
 
       // enable on startup
       line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
       if (!line) break;
       usdLogConfig.enableOnStartup = strtol(line, &endptr, 10);
 
+      // file format, added in version 2
+      usdLogConfig.fileFormat = usddeckFileFormat_Events;
+      if (version >= 2) {
+        line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
+        if (!line) break;
+        usdLogConfig.fileFormat = strtol(line, &endptr, 10);
+      }
+
       // loop over event triggers "on:<name>"
       usdLogConfig.numEventConfigs = 0;
       usdLogConfig.fixedFrequencyEventIdx = MAX_USD_LOG_EVENTS;
@@ -635,6 +907,10 @@ static void usdLogTask(void* prm)
               continue;
             }
           }
+          if (!usddeckSetFormat(cfg)) {
+            DEBUG_PRINT("Skip event %s (too many variables)\n", eventName);
+            continue;
+          }
           if (usdLogConfig.numEventConfigs < MAX_USD_LOG_EVENTS - 1) {
             ++usdLogConfig.numEventConfigs;
             cfg = &usdLogConfig.eventConfigs[usdLogConfig.numEventConfigs];
@@ -649,6 +925,11 @@ static void usdLogTask(void* prm)
       f_close(&logFile);
 
       eventtriggerRegisterCallback(eventtriggerHandler_USD, &usddeckEventtriggerCallback);
+      for (uint8_t i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+        if (usdLogConfig.eventConfigs[i].eventId != FIXED_FREQUENCY_EVENT_ID) {
+          eventtriggerSubscribe(eventtriggerHandler_USD, usdLogConfig.eventConfigs[i].eventId, true);
+        }
+      }
 
       DEBUG_PRINT("Config read [OK].\n");
       // DEBUG_PRINT("Frequency: %d Hz. Buffer size: %d\n",
@@ -676,6 +957,11 @@ static void usdLogTask(void* prm)
     }
     ringBuffer_init(&logBuffer, logBufferData, usdLogConfig.bufferSize);
 
+    if (usdLogConfig.fileFormat == usddeckFileFormat_Blocks && !usddeckAllocateBlocks()) {
+      DEBUG_PRINT("malloc blocks [FAIL].\n");
+      break;
+    }
+
     /* create queue to hand over pointer to usdLogData */
     // usdLogQueue = xQueueCreate(usdLogConfig.queueSize, sizeof(uint8_t*));
 
@@ -725,7 +1011,7 @@ int usddeckFrequency(void)
 void usddeckTriggerLogging(void)
 {
   if (usdLogConfig.fixedFrequencyEventIdx < MAX_USD_LOG_EVENTS) {
-    usddeckWriteEventData(&usdLogConfig.eventConfigs[usdLogConfig.fixedFrequencyEventIdx], 0, 0);
+    usddeckWriteEventData(&usdLogConfig.eventConfigs[usdLogConfig.fixedFrequencyEventIdx], usecTimestamp(), 0, 0);
   }
 }
 
@@ -735,22 +1021,80 @@ uint32_t usddeckFileSize(void)
   return lastFileSize;
 }
 
+// Must be called with logFileMutex taken
+static void usddeckCloseReadFile(void)
+{
+  if (readFileIsOpen) {
+    f_close(&readFile);
+    readFileIsOpen = false;
+  }
+  readAheadLength = 0;
+}
+
+// Must be called with logFileMutex taken
+static bool usddeckOpenReadFile(void)
+{
+  if (readFileIsOpen) {
+    return true;
+  }
+
+  if (f_open(&readFile, readFileName, FA_READ) != FR_OK) {
+    return false;
+  }
+  readFileIsOpen = true;
+  readAheadLength = 0;
+
+  // Fast seek, fall back to following the cluster chain if the map does not fit
+  readFile.cltbl = readFileLinkMap;
+  readFileLinkMap[0] = USD_LINK_MAP_SIZE;
+  if (f_lseek(&readFile, CREATE_LINKMAP) != FR_OK) {
+    readFile.cltbl = NULL;
+  }
+
+  return true;
+}
+
+// Must be called with logFileMutex taken
+static bool usddeckReadAhead(uint32_t offset)
+{
+  UINT bytesRead;
+
+  readAheadLength = 0;
+  if (f_lseek(&readFile, offset) != FR_OK ||
+      f_read(&readFile, readAheadBuffer, USD_READ_AHEAD_SIZE, &bytesRead) != FR_OK ||
+      bytesRead == 0) {
+    return false;
+  }
+
+  readAheadOffset = offset;
+  readAheadLength = bytesRead;
+  return true;
+}
+
 // Read "length" number of bytes at "offset" into "buffer" of current file
 // Only works if logging is stopped
 bool usddeckRead(uint32_t offset, uint8_t* buffer, uint16_t length)
 {
   bool result = false;
   if (initSuccess && xSemaphoreTake(logFileMutex, 0) == pdTRUE) {
-    if (f_open(&logFile, usdLogConfig.filename, FA_READ) == FR_OK) {
-      if (f_lseek(&logFile, offset) == FR_OK) {
-        UINT bytesRead;
-        FRESULT r = f_read(&logFile, buffer, length, &bytesRead);
-        f_close(&logFile);
-        if (r == FR_OK && bytesRead == length) {
-          result = true;
+    if (usddeckOpenReadFile()) {
+      result = true;
+      while (length > 0) {
+        if (offset < readAheadOffset || offset >= readAheadOffset + readAheadLength) {
+          if (!usddeckReadAhead(offset)) {
+            result = false;
+            break;
+          }
         }
-      } else {
-        f_close(&logFile);
+
+        uint32_t count = readAheadOffset + readAheadLength - offset;
+        if (count > length) {
+          count = length;
+        }
+        memcpy(buffer, &readAheadBuffer[offset - readAheadOffset], count);
+        buffer += count;
+        offset += count;
+        length -= count;
       }
     }
     xSemaphoreGive(logFileMutex);
@@ -758,6 +1102,31 @@ bool usddeckRead(uint32_t offset, uint8_t* buffer, uint16_t length)
   return result;
 }
 
+// Parameter callback for usd.readFile, only applied when logging is stopped
+static void usddeckSelectReadFile(void)
+{
+  if (!initSuccess || xSemaphoreTake(logFileMutex, 0) != pdTRUE) {
+    return;
+  }
+
+  usddeckCloseReadFile();
+  if (readFileSelection == USD_READ_FILE_INDEX) {
+    strcpy(readFileName, indexFileName);
+  } else {
+    strcpy(readFileName, usdLogConfig.filename);
+    if (readFileSelection != USD_READ_FILE_LATEST) {
+      int l = strlen(readFileName);
+      readFileName[l - 2] = '0' + (readFileSelection / 10) % 10;
+      readFileName[l - 1] = '0' + readFileSelection % 10;
+    }
+  }
+
+  FILINFO info;
+  lastFileSize = (f_stat(readFileName, &info) == FR_OK) ? info.fsize : 0;
+
+  xSemaphoreGive(logFileMutex);
+}
+
 static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
   bool result = false;
 
@@ -770,13 +1139,268 @@ static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t
   return result;
 }
 
+static void usdFlushWriteChunk(void)
+{
+  if (writeChunkLength > 0) {
+    UINT bytesWritten;
+    FRESULT status = f_write(&logFile, writeChunk, writeChunkLength, &bytesWritten);
+    ASSERT(status == FR_OK);
+    STATS_CNT_RATE_MULTI_EVENT(&fatWriteRate, bytesWritten);
+    writeChunkLength = 0;
+  }
+}
+
 static void usdWriteData(const void *data, size_t size)
 {
-  UINT bytesWritten;
-  FRESULT status = f_write(&logFile, data, size, &bytesWritten);
-  ASSERT(status == FR_OK);
+  const uint8_t* bytes = data;
+
   crc32Update(&crcContext, data, size);
-  STATS_CNT_RATE_MULTI_EVENT(&fatWriteRate, bytesWritten);
+  segmentSize += size;
+
+  while (size > 0) {
+    size_t count = USD_WRITE_CHUNK_SIZE - writeChunkLength;
+    if (count > size) {
+      count = size;
+    }
+    memcpy(&writeChunk[writeChunkLength], bytes, count);
+    writeChunkLength += count;
+    bytes += count;
+    size -= count;
+
+    if (writeChunkLength == USD_WRITE_CHUNK_SIZE) {
+      usdFlushWriteChunk();
+    }
+  }
+}
+
+// Name of the next file that does not exist yet, the two last characters are
+// a running number
+static void usddeckSelectNextFileName(void)
+{
+  FILINFO fno;
+  uint8_t NUL = 0;
+  while(usdLogConfig.filename[NUL] != '\0') {
+    NUL++;
+  }
+  while (f_stat(usdLogConfig.filename, &fno) == FR_OK) {
+    /* increase file */
+    switch(usdLogConfig.filename[NUL-1]) {
+      case '9':
+        usdLogConfig.filename[NUL-1] = '0';
+        usdLogConfig.filename[NUL-2]++;
+        break;
+      default:
+        usdLogConfig.filename[NUL-1]++;
+    }
+  }
+}
+
+static void usddeckWriteHeader(void)
+{
+  uint8_t magic = 0xBC;
+  usdWriteData(&magic, sizeof(magic));
+
+  // version 3 has the same header as version 2, followed by blocks instead of events
+  uint16_t version = (usdLogConfig.fileFormat == usddeckFileFormat_Blocks) ? 3 : 2;
+  usdWriteData(&version, sizeof(version));
+
+  uint16_t numEventTypes = usdLogConfig.numEventConfigs;
+  usdWriteData(&numEventTypes, sizeof(numEventTypes));
+
+  for (int i = 0; i < numEventTypes; ++i) {
+    usdLogEventConfig_t* cfg = &usdLogConfig.eventConfigs[i];
+    const eventtrigger *et = eventtriggerGetById(cfg->eventId);
+    uint16_t numVariables = cfg->numVars;
+
+    usdWriteData(&cfg->eventId, sizeof(cfg->eventId));
+
+    if (cfg->eventId == FIXED_FREQUENCY_EVENT_ID) {
+      usdWriteData(FIXED_FREQUENCY_EVENT_NAME, strlen(FIXED_FREQUENCY_EVENT_NAME) + 1);
+    } else {
+      usdWriteData(et->name, strlen(et->name) + 1);
+      numVariables += et->numPayloadVariables;
+    }
+    usdWriteData(&numVariables, sizeof(numVariables));
+    if (et) {
+      for (int j = 0; j < et->numPayloadVariables; ++j) {
+        usdWriteData(et->payloadDesc[j].name, strlen(et->payloadDesc[j].name));
+        usdWriteData("(", 1);
+        char typeChar = payloadTypeChar(et->payloadDesc[j].type);
+        usdWriteData(&typeChar, 1);
+        usdWriteData(")", 2);
+      }
+    }
+    for (int j = 0; j < cfg->numVars; ++j) {
+      char *group;
+      char *name;
+      logVarId_t varid = cfg->varIds[j];
+      logGetGroupAndName(varid, &group, &name);
+      usdWriteData(group, strlen(group));
+      usdWriteData(".", 1);
+      usdWriteData(name, strlen(name));
+      usdWriteData("(", 1);
+      char typeChar = logTypeChar(logGetType(varid));
+      usdWriteData(&typeChar, 1);
+      usdWriteData(")", 2);
+    }
+  }
+}
+
+// Create the next file of the session, each file is a complete log with its own header and CRC
+static bool usddeckOpenSegment(void)
+{
+  usddeckSelectNextFileName();
+
+  if (f_open(&logFile, usdLogConfig.filename, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+    DEBUG_PRINT("Failed to open file: %s\n", usdLogConfig.filename);
+    return false;
+  }
+  DEBUG_PRINT("Logging to: %s\n", usdLogConfig.filename);
+
+  writeChunkLength = 0;
+  segmentSize = 0;
+  segmentStartTime = usecTimestamp();
+
+  uint16_t allocateMB = preallocateMB ? preallocateMB : rotateMB;
+  isPreallocated = false;
+  if (allocateMB > 0) {
+    isPreallocated = (f_expand(&logFile, (FSIZE_t)allocateMB * 1024 * 1024, 1) == FR_OK);
+    if (!isPreallocated) {
+      DEBUG_PRINT("No contiguous space for %d MB\n", allocateMB);
+    }
+  }
+
+  // iniatialize crc
+  crc32ContextInit(&crcContext);
+
+  usddeckWriteHeader();
+  return true;
+}
+
+// One line per file: name, first file of the session, time range [ms], size and CRC
+static void usddeckAddIndexEntry(uint32_t crcValue)
+{
+  FIL indexFile;
+  if (f_open(&indexFile, indexFileName, FA_OPEN_APPEND | FA_WRITE) != FR_OK) {
+    DEBUG_PRINT("Failed to open file: %s\n", indexFileName);
+    return;
+  }
+
+  char line[80];
+  int length = 0;
+  if (f_size(&indexFile) == 0) {
+    length = snprintf(line, sizeof(line), "file,session,start_ms,end_ms,size,crc32\n");
+    f_write(&indexFile, line, length, (UINT*)&length);
+  }
+  length = snprintf(line, sizeof(line), "%s,%s,%lu,%lu,%lu,%08lx\n",
+    usdLogConfig.filename,
+    sessionFileName,
+    (unsigned long)(segmentStartTime / 1000),
+    (unsigned long)(usecTimestamp() / 1000),
+    (unsigned long)lastFileSize,
+    (unsigned long)crcValue);
+  f_write(&indexFile, line, length, (UINT*)&length);
+  f_close(&indexFile);
+}
+
+static void usddeckCloseSegment(void)
+{
+  // write CRC
+  uint32_t crcValue = crc32Out(&crcContext);
+  usdWriteData(&crcValue, sizeof(crcValue));
+
+  usdFlushWriteChunk();
+
+  // close file, releasing the preallocated space that was not used
+  if (isPreallocated) {
+    f_truncate(&logFile);
+  }
+  f_close(&logFile);
+
+  // Update file size for fast query
+  FILINFO info;
+  if (f_stat(usdLogConfig.filename, &info) == FR_OK) {
+    lastFileSize = info.fsize;
+  }
+
+  usddeckAddIndexEntry(crcValue);
+}
+
+static bool usddeckSegmentIsFull(void)
+{
+  if (rotateMB > 0 && segmentSize >= (uint32_t)rotateMB * 1024 * 1024) {
+    return true;
+  }
+  if (rotateS > 0 && usecTimestamp() - segmentStartTime >= (uint64_t)rotateS * 1000000) {
+    return true;
+  }
+  return false;
+}
+
+// Size of a record in the log buffer, an event or a block, from its first bytes.
+// Returns 0 for unknown data.
+static uint32_t usddeckRecordSize(const uint8_t* header)
+{
+  if (usdLogConfig.fileFormat == usddeckFileFormat_Blocks) {
+    uint16_t bodySize = header[4] | (header[5] << 8);
+    return COLUMN_BLOCK_HEADER_SIZE + bodySize + COLUMN_BLOCK_CRC_SIZE;
+  }
+
+  uint16_t eventId = header[0] | (header[1] << 8);
+  for (int i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+    if (usdLogConfig.eventConfigs[i].eventId == eventId) {
+      return sizeof(eventId) + usdLogConfig.eventConfigs[i].rowSize;
+    }
+  }
+  return 0;
+}
+
+// Write data from the log buffer. The records are followed so that a new file
+// can be started between two records when the current one is full.
+static bool usdWriteStream(const uint8_t* data, uint16_t size)
+{
+  const uint8_t headerSize = (usdLogConfig.fileFormat == usddeckFileFormat_Blocks) ? COLUMN_BLOCK_HEADER_SIZE : sizeof(uint16_t);
+
+  while (size > 0) {
+    if (recordBytesLeft == 0 && recordHeaderLength == 0 && !recordParseFailed && usddeckSegmentIsFull()) {
+      usddeckCloseSegment();
+      if (!usddeckOpenSegment()) {
+        return false;
+      }
+    }
+
+    uint16_t count = size;
+    if (recordParseFailed) {
+      // Keep writing, but without rotation
+    } else if (recordBytesLeft == 0) {
+      if (count > headerSize - recordHeaderLength) {
+        count = headerSize - recordHeaderLength;
+      }
+      memcpy(&recordHeader[recordHeaderLength], data, count);
+      recordHeaderLength += count;
+      if (recordHeaderLength == headerSize) {
+        uint32_t recordSize = usddeckRecordSize(recordHeader);
+        if (recordSize == 0) {
+          DEBUG_PRINT("Unknown data in log buffer, rotation disabled\n");
+          recordParseFailed = true;
+        } else {
+          recordBytesLeft = recordSize - headerSize;
+        }
+        recordHeaderLength = 0;
+      }
+    } else {
+      if (count > recordBytesLeft) {
+        count = recordBytesLeft;
+      }
+      recordBytesLeft -= count;
+    }
+
+    usdWriteData(data, count);
+    data += count;
+    size -= count;
+  }
+
+  return true;
 }
 
 static void usdWriteTask(void* prm)
@@ -794,193 +1418,86 @@ static void usdWriteTask(void* prm)
       // reset stats
       usdLogStats.eventsRequested = 0;
       usdLogStats.eventsWritten = 0;
+      usdLogStats.eventsDropped = 0;
+      usdLogStats.bufferFill = 0;
+      usdLogStats.bufferFillMax = 0;
+      usdLogStats.pushTimeMax = 0;
 
       // reset the buffer
       xSemaphoreTake(logBufferMutex, portMAX_DELAY);
       ringBuffer_reset(&logBuffer);
+      for (int i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+        usdLogConfig.eventConfigs[i].numRows = 0;
+      }
+      recordHeaderLength = 0;
+      recordBytesLeft = 0;
+      recordParseFailed = false;
       xSemaphoreGive(logBufferMutex);
 
       xSemaphoreTake(logFileMutex, portMAX_DELAY);
+      usddeckCloseReadFile();
       lastFileSize = 0;
-
-      /* look for existing files and use first not existent combination
-       * of two chars */
-      {
-        FILINFO fno;
-        uint8_t NUL = 0;
-        while(usdLogConfig.filename[NUL] != '\0') {
-          NUL++;
-        }
-        while (f_stat(usdLogConfig.filename, &fno) == FR_OK) {
-          /* increase file */
-          switch(usdLogConfig.filename[NUL-1]) {
-            case '9':
-              usdLogConfig.filename[NUL-1] = '0';
-              usdLogConfig.filename[NUL-2]++;
-              break;
-            default:
-              usdLogConfig.filename[NUL-1]++;
-          }
-        }
-      }
+      readFileSelection = USD_READ_FILE_LATEST;
 
       /* try to create file */
-      if (f_open(&logFile, usdLogConfig.filename, FA_CREATE_ALWAYS | FA_WRITE)
-          == FR_OK) {
-
-        DEBUG_PRINT("Logging to: %s\n", usdLogConfig.filename);
-
-        // iniatialize crc
-        crc32ContextInit(&crcContext);
-
-        // write header
-        uint8_t magic = 0xBC;
-        usdWriteData(&magic, sizeof(magic));
-        
-        uint16_t version = 2;
-        usdWriteData(&version, sizeof(version));
-
-        uint16_t numEventTypes = usdLogConfig.numEventConfigs;
-        usdWriteData(&numEventTypes, sizeof(numEventTypes));
+      if (usddeckOpenSegment()) {
+        strcpy(sessionFileName, usdLogConfig.filename);
 
-        for (int i = 0; i < numEventTypes; ++i) {
-          usdLogEventConfig_t* cfg = &usdLogConfig.eventConfigs[i];
-          const eventtrigger *et = eventtriggerGetById(cfg->eventId);
-          uint16_t numVariables = cfg->numVars;
-
-          usdWriteData(&cfg->eventId, sizeof(cfg->eventId));
-
-          if (cfg->eventId == FIXED_FREQUENCY_EVENT_ID) {
-            usdWriteData(FIXED_FREQUENCY_EVENT_NAME, strlen(FIXED_FREQUENCY_EVENT_NAME) + 1);
-          } else {
-            usdWriteData(et->name, strlen(et->name) + 1);
-            numVariables += et->numPayloadVariables;
-          }
-          usdWriteData(&numVariables, sizeof(numVariables));
-          if (et) {
-            for (int j = 0; j < et->numPayloadVariables; ++j) {
-              usdWriteData(et->payloadDesc[j].name, strlen(et->payloadDesc[j].name));
-              usdWriteData("(", 1);
-              char typeChar;
-              switch (et->payloadDesc[j].type)
-              {
-              case eventtriggerType_uint8:
-                typeChar = 'B';
-                break;
-              case eventtriggerType_int8:
-                typeChar = 'b';
-                break;
-              case eventtriggerType_uint16:
-                typeChar = 'H';
-                break;
-              case eventtriggerType_int16:
-                typeChar = 'h';
-                break;
-              case eventtriggerType_uint32:
-                typeChar = 'I';
-                break;
-              case eventtriggerType_int32:
-                typeChar = 'i';
-                break;
-              case eventtriggerType_float:
-                typeChar = 'f';
-                break;
-              default:
-                ASSERT(false);
-              }
-              usdWriteData(&typeChar, 1);
-              usdWriteData(")", 2);
-            }
-          }
-          for (int j = 0; j < cfg->numVars; ++j) {
-            char *group;
-            char *name;
-            logVarId_t varid = cfg->varIds[j];
-            logGetGroupAndName(varid, &group, &name);
-            usdWriteData(group, strlen(group));
-            usdWriteData(".", 1);
-            usdWriteData(name, strlen(name));
-            usdWriteData("(", 1);
-            char typeChar;
-            switch (logGetType(varid)) {
-            case LOG_UINT8:
-              typeChar = 'B';
-              break;
-            case LOG_INT8:
-              typeChar = 'b';
-              break;
-            case LOG_UINT16:
-              typeChar = 'H';
-              break;
-            case LOG_INT16:
-              typeChar = 'h';
-              break;
-            case LOG_UINT32:
-              typeChar = 'I';
-              break;
-            case LOG_INT32:
-              typeChar = 'i';
-              break;
-            case LOG_FLOAT:
-              typeChar = 'f';
-              break;
-            default:
-              ASSERT(false);
-            }
-            usdWriteData(&typeChar, 1);
-            usdWriteData(")", 2);
-          }
-        }
-
-        while (enableLogging) {
+        bool isWriting = true;
+        while (enableLogging && isWriting) {
           /* sleep */
           vTaskSuspend(NULL);
 
-          // check if we have anything to write
-          xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+          // check if we have anything to write, the producers keep
+          // adding data while it is written
           const uint8_t* buf;
           uint16_t size;
           bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
-          xSemaphoreGive(logBufferMutex);
-          
+
           // execute the actual write operation
           if (hasData) {
-            usdWriteData(buf, size);
-
-            xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+            isWriting = usdWriteStream(buf, size);
             ringBuffer_pop_done(&logBuffer);
-            xSemaphoreGive(logBufferMutex);
           }
         }
-        // write everything that's still in the buffer
-        xSemaphoreTake(logBufferMutex, portMAX_DELAY);
-        while (true) {
-          const uint8_t *buf;
-          uint16_t size;
-          bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
-          if (hasData) {
-            usdWriteData(buf, size);
-            ringBuffer_pop_done(&logBuffer);
-          } else {
-            break;
+
+        if (isWriting) {
+          // write everything that's still in the buffer, wait for a producer
+          // that is still adding a sample
+          xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+          while (isWriting) {
+            const uint8_t *buf;
+            uint16_t size;
+            bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
+            if (hasData) {
+              isWriting = usdWriteStream(buf, size);
+              ringBuffer_pop_done(&logBuffer);
+            } else {
+              break;
+            }
           }
+          // and the blocks that are not full yet
+          if (isWriting && usdLogConfig.fileFormat == usddeckFileFormat_Blocks) {
+            for (int i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+              usdLogEventConfig_t* cfg = &usdLogConfig.eventConfigs[i];
+              if (cfg->numRows > 0) {
+                uint32_t length = usddeckEncodeBlock(cfg);
+                usdWriteData(blockBuffer, length);
+              }
+            }
+          }
+          xSemaphoreGive(logBufferMutex);
         }
-        xSemaphoreGive(logBufferMutex);
-
-        // write CRC
-        uint32_t crcValue = crc32Out(&crcContext);
-        usdWriteData(&crcValue, sizeof(crcValue));
 
-        // close file
-        f_close(&logFile);
-
-        // Update file size for fast query
-        FILINFO info;
-        if (f_stat(usdLogConfig.filename, &info) == FR_OK) {
-          lastFileSize = info.fsize;
+        if (isWriting) {
+          usddeckCloseSegment();
+        } else {
+          // the next file could not be created
+          enableLogging = false;
         }
+        strcpy(readFileName, usdLogConfig.filename);
 
-        DEBUG_PRINT("Wrote %ld B to: %s (%ld of %ld events)\n", 
+        DEBUG_PRINT("Wrote %ld B to: %s (%ld of %ld events)\n",
           lastFileSize,
           usdLogConfig.filename,
           usdLogStats.eventsWritten,
@@ -989,7 +1506,6 @@ static void usdWriteTask(void* prm)
         xSemaphoreGive(logFileMutex);
       } else {
         f_mount(NULL, "", 0);
-        DEBUG_PRINT("Failed to open file: %s\n", usdLogConfig.filename);
         break;
       }
     }
@@ -1045,10 +1561,43 @@ PARAM_GROUP_STOP(deck)
 PARAM_GROUP_START(usd)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, canLog, &initSuccess)
 PARAM_ADD(PARAM_UINT8, logging, &enableLogging) /* use to start/stop logging*/
+/**
+ * @brief Contiguous space to allocate for a new log file [MB], 0 to allocate while logging (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, preallocMB, &preallocateMB)
+/**
+ * @brief Start a new log file when the current one reaches this size [MB], 0 to disable (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, rotateMB, &rotateMB)
+/**
+ * @brief Start a new log file when the current one is this old [s], 0 to disable (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, rotateS, &rotateS)
+/**
+ * @brief File read through the memory interface when logging is stopped: 0-99 the log file with this number,
+ * 254 the index file, 255 the last log file (default: 255)
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, readFile, &readFileSelection, usddeckSelectReadFile)
 PARAM_GROUP_STOP(usd)
 
 LOG_GROUP_START(usd)
 STATS_CNT_RATE_LOG_ADD(spiWrBps, &spiWriteRate)
 STATS_CNT_RATE_LOG_ADD(spiReBps, &spiReadRate)
 STATS_CNT_RATE_LOG_ADD(fatWrBps, &fatWriteRate)
+/**
+ * @brief Samples lost because the log buffer was full
+ */
+LOG_ADD(LOG_UINT32, dropped, &usdLogStats.eventsDropped)
+/**
+ * @brief Bytes in the log buffer
+ */
+LOG_ADD(LOG_UINT16, bufFill, &usdLogStats.bufferFill)
+/**
+ * @brief Highest number of bytes in the log buffer since logging started
+ */
+LOG_ADD(LOG_UINT16, bufFillMax, &usdLogStats.bufferFillMax)
+/**
+ * @brief Longest time to add a sample to the log buffer since logging started [us]
+ */
+LOG_ADD(LOG_UINT32, pushMaxUs, &usdLogStats.pushTimeMax)
 LOG_GROUP_STOP(usd)
@@ -53,33 +53,66 @@ static float expCoeff;
 
 #define RANGE_OUTLIER_LIMIT 5000 // the measured range is in [mm]
 
+// Timing budget limits of the medium distance mode [ms]
+#define TIMING_BUDGET_MIN 20
+#define TIMING_BUDGET_MAX 500
+// Idle time between two measurements in autonomous mode, the sensor needs at least 4 ms [ms]
+#define INTER_MEASUREMENT_MARGIN 4
+
 static uint16_t range_last = 0;
 
 static bool isInit;
 
+// Parameters
+static uint16_t timingBudget = 25;
+
+static uint16_t activeTimingBudget;
+static uint32_t measurementTimestamp;
+static uint32_t timeoutCount;
+
 NO_DMA_CCM_SAFE_ZERO_INIT static VL53L1_Dev_t dev;
 
-static uint16_t zRanger2GetMeasurementAndRestart(VL53L1_Dev_t *dev)
+static void zRanger2StartRanging(VL53L1_Dev_t *dev)
 {
-    VL53L1_Error status = VL53L1_ERROR_NONE;
-    VL53L1_RangingMeasurementData_t rangingData;
-    uint8_t dataReady = 0;
-    uint16_t range;
+  uint16_t budget = timingBudget;
+  if (budget < TIMING_BUDGET_MIN) {
+    budget = TIMING_BUDGET_MIN;
+  } else if (budget > TIMING_BUDGET_MAX) {
+    budget = TIMING_BUDGET_MAX;
+  }
 
-    while (dataReady == 0)
-    {
-        status = VL53L1_GetMeasurementDataReady(dev, &dataReady);
-        vTaskDelay(M2T(1));
-    }
+  // The sensor runs continuously in autonomous mode, a new measurement starts every
+  // budget + INTER_MEASUREMENT_MARGIN ms without any I2C traffic
+  VL53L1_StopMeasurement(dev);
+  VL53L1_SetPresetMode(dev, VL53L1_PRESETMODE_AUTONOMOUS);
+  VL53L1_SetDistanceMode(dev, VL53L1_DISTANCEMODE_MEDIUM);
+  VL53L1_SetMeasurementTimingBudgetMicroSeconds(dev, budget * 1000);
+  VL53L1_SetInterMeasurementPeriodMilliSeconds(dev, budget + INTER_MEASUREMENT_MARGIN);
+  VL53L1_StartMeasurement(dev);
+
+  timingBudget = budget;
+  activeTimingBudget = budget;
+}
 
-    status = VL53L1_GetRangingMeasurementData(dev, &rangingData);
-    range = rangingData.RangeMilliMeter;
+// The GPIO1 interrupt of the sensor is not connected on the Z-ranger v2 and Flow v2 decks. The task sleeps until
+// 1 ms before the measurement is expected and polls the data ready flag from there, a few I2C reads per measurement.
+static bool zRanger2WaitForMeasurement(VL53L1_Dev_t *dev, const TickType_t expected)
+{
+  const TickType_t timeout = expected + M2T(activeTimingBudget + INTER_MEASUREMENT_MARGIN);
+  const int32_t sleepTime = (int32_t)(expected - M2T(1) - xTaskGetTickCount());
+  if (sleepTime > 0) {
+    vTaskDelay(sleepTime);
+  }
 
-    VL53L1_StopMeasurement(dev);
-    status = VL53L1_StartMeasurement(dev);
-    status = status;
+  while ((int32_t)(timeout - xTaskGetTickCount()) > 0) {
+    uint8_t dataReady = 0;
+    if (VL53L1_GetMeasurementDataReady(dev, &dataReady) == VL53L1_ERROR_NONE && dataReady) {
+      return true;
+    }
+    vTaskDelay(M2T(1));
+  }
 
-    return range;
+  return false;
 }
 
 void zRanger2Init(DeckInfo* info)
@@ -115,23 +148,34 @@ bool zRanger2Test(void)
 
 void zRanger2Task(void* arg)
 {
-  TickType_t lastWakeTime;
-
   systemWaitStart();
 
-  // Restart sensor
-  VL53L1_StopMeasurement(&dev);
-  VL53L1_SetDistanceMode(&dev, VL53L1_DISTANCEMODE_MEDIUM);
-  VL53L1_SetMeasurementTimingBudgetMicroSeconds(&dev, 25000);
+  zRanger2StartRanging(&dev);
+  TickType_t expected = xTaskGetTickCount() + M2T(activeTimingBudget);
+
+  while (1) {
+    if (timingBudget != activeTimingBudget) {
+      zRanger2StartRanging(&dev);
+      expected = xTaskGetTickCount() + M2T(activeTimingBudget);
+    }
 
-  VL53L1_StartMeasurement(&dev);
+    if (!zRanger2WaitForMeasurement(&dev, expected)) {
+      timeoutCount++;
+      zRanger2StartRanging(&dev);
+      expected = xTaskGetTickCount() + M2T(activeTimingBudget);
+      continue;
+    }
 
-  lastWakeTime = xTaskGetTickCount();
+    const TickType_t readyTime = xTaskGetTickCount();
+    VL53L1_RangingMeasurementData_t rangingData;
+    VL53L1_GetRangingMeasurementData(&dev, &rangingData);
+    VL53L1_ClearInterruptAndStartMeasurement(&dev);
+    expected = readyTime + M2T(activeTimingBudget + INTER_MEASUREMENT_MARGIN);
 
-  while (1) {
-    vTaskDelayUntil(&lastWakeTime, M2T(25));
+    // The range is the average over the timing budget that ended when the data got ready
+    measurementTimestamp = readyTime - M2T(activeTimingBudget / 2);
 
-    range_last = zRanger2GetMeasurementAndRestart(&dev);
+    range_last = rangingData.RangeMilliMeter;
     rangeSet(rangeDown, range_last / 1000.0f);
 
     // check if range is feasible and push into the estimator
@@ -140,7 +184,7 @@ void zRanger2Task(void* arg)
     if (range_last < RANGE_OUTLIER_LIMIT) {
       float distance = (float)range_last * 0.001f; // Scale from [mm] to [m]
       float stdDev = expStdA * (1.0f  + expf( expCoeff * (distance - expPointA)));
-      rangeEnqueueDownRangeInEstimator(distance, stdDev, xTaskGetTickCount());
+      rangeEnqueueDownRangeInEstimator(distance, stdDev, measurementTimestamp);
     }
   }
 }
@@ -160,3 +204,28 @@ DECK_DRIVER(zranger2_deck);
 PARAM_GROUP_START(deck)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, bcZRanger2, &isInit)
 PARAM_GROUP_STOP(deck)
+
+/**
+ * Down facing VL53L1x ranging of the Z-ranger v2 and Flow v2 decks
+ */
+PARAM_GROUP_START(zranger2)
+/**
+ * @brief Timing budget of a measurement, 20 to 500 ms. A longer budget gives less noise at a lower rate, one
+ * measurement every budget + 4 ms (default: 25)
+ */
+PARAM_ADD(PARAM_UINT16, budget, &timingBudget)
+PARAM_GROUP_STOP(zranger2)
+
+/**
+ * Down facing VL53L1x ranging of the Z-ranger v2 and Flow v2 decks
+ */
+LOG_GROUP_START(zranger2)
+/**
+ * @brief Tick of the middle of the timing budget of the latest range, the time the range is sent to the estimator with
+ */
+LOG_ADD(LOG_UINT32, time, &measurementTimestamp)
+/**
+ * @brief Number of measurements that were not ready in time, the sensor is restarted
+ */
+LOG_ADD(LOG_UINT32, timeouts, &timeoutCount)
+LOG_GROUP_STOP(zranger2)
@@ -49,4 +49,27 @@ void analogReadResolution(uint8_t bits);
  */
 float analogReadVoltage(const deckPin_t pin);
 
+/* Number of deck pins that can be scanned continuously */
+#define ANALOG_SCAN_MAX_PINS      4
+/* Number of samples of every pin that are averaged when the voltage is read */
+#define ANALOG_SCAN_OVERSAMPLING  64
+
+/*
+ * Start a continuous scan of deck pins on ADC1 with DMA, the CPU is not involved
+ * in the conversions. A scan that is already running is replaced, a count of
+ * zero stops the scan. Pins read with analogRead() are not affected, they are
+ * converted on ADC2.
+ * @param[in] pins   deck pins to scan, at most ANALOG_SCAN_MAX_PINS.
+ * @param[in] count  number of pins.
+ */
+void analogScanStart(const deckPin_t pins[], uint8_t count);
+
+/*
+ * Read the voltage on a scanned deck pin, averaged over the last
+ * ANALOG_SCAN_OVERSAMPLING samples. Does not wait for a conversion.
+ * @param[in] index  index of the pin in the pins given to analogScanStart().
+ * @return           voltage in volts, 0 if the pin is not scanned
+ */
+float analogScanReadVoltage(uint8_t index);
+
 #endif
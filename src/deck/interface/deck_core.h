@@ -39,6 +39,10 @@
 
 /* Main functions to init and test the decks, called during system initialisation */
 void deckInit(void);
+/* Enumerates the decks, called by deckInit(). It only talks to the decks
+ * over one wire and can run concurrently with the other system
+ * initialisation. */
+void deckInfoInit(void);
 bool deckTest(void);
 
 /***** Driver TOC definitions ******/
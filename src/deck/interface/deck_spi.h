@@ -37,6 +37,18 @@
 #define SPI_BAUDRATE_3MHZ   SPI_BaudRatePrescaler_32    // 2.625MHz
 #define SPI_BAUDRATE_2MHZ   SPI_BaudRatePrescaler_64    // 1.3125MHz
 
+/**
+ * Users of the deck SPI bus. When several clients wait for the bus it is
+ * handed to the one with the highest priority, see deck_spi.c.
+ */
+typedef enum {
+  spiClientOther = 0,
+  spiClientLoco,
+  spiClientFlow,
+  spiClientUsd,
+  SPI_CLIENT_COUNT,
+} spiClient_t;
+
 /**
  * Initialize the SPI.
  */
@@ -44,6 +56,16 @@ void spiBegin(void);
 void spiBeginTransaction(uint16_t baudRatePrescaler);
 void spiEndTransaction();
 
+/**
+ * Take the bus for a client, waiting at most timeout ticks.
+ *
+ * @param client             The client taking the bus, sets the priority and where the statistics are accounted.
+ * @param baudRatePrescaler  The speed to use.
+ * @param timeout            Max time to wait for the bus, in ticks.
+ * @return                   true if the bus was taken, spiEndTransaction() must then be called.
+ */
+bool spiBeginClientTransaction(spiClient_t client, uint16_t baudRatePrescaler, uint32_t timeout);
+
 /* Send the data_tx buffer and receive into the data_rx buffer */
 bool spiExchange(size_t length, const uint8_t *data_tx, uint8_t *data_rx);
 
@@ -26,6 +26,16 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#define CPPM_MAX_CHANNELS  8
+
+/* A complete CPPM frame, decoded in the capture interrupt */
+typedef struct {
+  uint16_t channels[CPPM_MAX_CHANNELS]; // Pulse lengths in us
+  uint8_t count;                        // Number of channels in the frame
+  uint32_t timestamp;                   // Tick of the sync pulse ending the frame
+} cppmFrame_t;
 
 void cppmInit(void);
 
@@ -33,7 +43,13 @@ bool cppmIsAvailible(void);
 
 void cppmClearQueue(void);
 
-int cppmGetTimestamp(uint16_t *timestamp);
+/**
+ * Wait for the next frame. Only the latest frame is kept, a frame that was not
+ * read before the next one ended is dropped.
+ *
+ * @return pdTRUE if a frame was received within the timeout
+ */
+int cppmGetFrame(cppmFrame_t *frame, uint32_t timeout);
 
 float cppmConvert2Float(uint16_t timestamp, float min, float max);
 
@@ -38,6 +38,47 @@ typedef struct _I2cMessage
   uint8_t          *buffer;           //< Pointer to the buffer from where data will be read for transmission, or into which received data will be placed.
 } I2cMessage;
 
+/**
+ * Priority of a transfer. Queued transfers with a higher priority are started
+ * before the ones with a lower priority, a transfer in progress is never
+ * interrupted.
+ */
+typedef enum
+{
+  i2cPriorityLow,
+  i2cPriorityNormal,
+  i2cPriorityHigh,
+  I2C_NBR_OF_PRIORITIES,
+} I2cPriority;
+
+struct _I2cTransfer;
+
+/**
+ * Called from interrupt context when a transfer is done or has failed. Must
+ * only use ISR safe functions.
+ */
+typedef void (*I2cTransferCallback)(struct _I2cTransfer* transfer, bool success);
+
+/**
+ * A chain of messages transferred back to back on the bus, without other
+ * transfers in between. The transfer and the messages and buffers it points
+ * to must stay valid until the transfer is done.
+ */
+typedef struct _I2cTransfer
+{
+  I2cMessage          *messages;      //< Messages to transfer, in order.
+  uint8_t             nbrOfMessages;  //< Number of messages.
+  I2cPriority         priority;       //< Queue priority.
+  I2cTransferCallback callback;       //< Called when done, may be NULL.
+  void                *callbackArg;   //< User data for the callback.
+
+  // Managed by the driver
+  volatile bool       isDone;         //< Set when the transfer is done or has failed.
+  volatile bool       isSuccess;      //< True if all messages were acked.
+  uint8_t             messageIndex;   //< Message currently transferred.
+  struct _I2cTransfer *next;          //< Next transfer in the queue.
+} I2cTransfer;
+
 typedef struct
 {
   I2C_TypeDef*        i2cPort;
@@ -71,8 +112,14 @@ typedef struct
   uint32_t nbrOfretries;                //< Retries done
   SemaphoreHandle_t isBusFreeSemaphore; //< Semaphore to block during transaction.
   StaticSemaphore_t isBusFreeSemaphoreBuffer;
-  SemaphoreHandle_t isBusFreeMutex;     //< Mutex to protect bus
+  SemaphoreHandle_t isBusFreeMutex;     //< Mutex to protect the synchronous transfer
   StaticSemaphore_t isBusFreeMutexBuffer;
+  I2cTransfer syncTransfer;             //< Transfer used by i2cdrvMessageTransfer
+  I2cTransfer *activeTransfer;          //< Transfer on the bus, NULL if the bus is idle
+  TickType_t activeTransferStart;       //< Tick when the active transfer was started
+  bool isRestarting;                    //< True while the bus is restarted after an abort
+  I2cTransfer *queueHead[I2C_NBR_OF_PRIORITIES]; //< Queued transfers, one queue per priority
+  I2cTransfer *queueTail[I2C_NBR_OF_PRIORITIES];
   DMA_InitTypeDef DMAStruct;            //< DMA configuration structure used during transfer setup.
 } I2cDrv;
 
@@ -89,6 +136,7 @@ void i2cdrvInit(I2cDrv* i2c);
  * Send or receive a message over the I2C bus.
  *
  * The message is synchrony by semapthore and uses interrupts to transfer the message.
+ * It is queued with normal priority together with the asynchronous transfers.
  *
  * @param i2c      i2c bus to use.
  * @param message	 An I2cMessage struct containing all the i2c message
@@ -97,6 +145,30 @@ void i2cdrvInit(I2cDrv* i2c);
  */
 bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message);
 
+/**
+ * Queue a transfer on the I2C bus and return without waiting for it.
+ *
+ * The transfer is started when the bus is free and no transfer of the same or
+ * higher priority is queued before it. The callback of the transfer is called
+ * from interrupt context when it is done. A transfer that hangs the bus is
+ * aborted, and the bus restarted, by the next submit or synchronous transfer
+ * once it has timed out. Must not be called from interrupt context.
+ *
+ * @param i2c       i2c bus to use.
+ * @param transfer  The transfer, messages and priority must be filled in.
+ */
+void i2cdrvSubmitTransfer(I2cDrv* i2c, I2cTransfer* transfer);
+
+/**
+ * Cancel a transfer. A queued transfer is removed from the queue, a transfer
+ * in progress is aborted and the bus restarted. The callback is not called.
+ *
+ * @param i2c       i2c bus the transfer was submitted to.
+ * @param transfer  The transfer to cancel.
+ * @return          true if the transfer was done before it was cancelled.
+ */
+bool i2cdrvCancelTransfer(I2cDrv* i2c, I2cTransfer* transfer);
+
 
 /**
  * Create a message to transfer
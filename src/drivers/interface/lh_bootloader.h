@@ -29,6 +29,7 @@
 #define LH_BOOTLOADER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief Address of the firmware in the flash
@@ -74,6 +75,9 @@ bool lhblFlashRead(uint32_t address, uint16_t length, uint8_t *data);
  * This function should be used on memory address that have already been erased.
  * The write operation cannot cross the memory page boundary (256 bytes pages)
  * 
+ * The function returns when the page has been sent, while the flash is still
+ * programming it. Call lhblFlashWaitComplete() before the next write or read.
+ * 
  * @param address Flash address to write the data to
  * @param length Length of the data buffer
  * @param data Data buffer to write
@@ -83,7 +87,16 @@ bool lhblFlashRead(uint32_t address, uint16_t length, uint8_t *data);
 bool lhblFlashWritePage(uint32_t address, uint16_t length, const uint8_t *data);
 
 /**
- * Write FW data to lighthouse spi flash.
+ * @brief Wait for the flash to finish the ongoing program or erase operation
+ * 
+ * @return true in case of success
+ * @return false in case of failure
+ */
+bool lhblFlashWaitComplete(void);
+
+/**
+ * Write FW data to lighthouse spi flash and verify it with a CRC32 of the
+ * flash content.
  * @param data    Data to write
  * @param length  Length of data
  *
@@ -91,6 +104,19 @@ bool lhblFlashWritePage(uint32_t address, uint16_t length, const uint8_t *data);
  */
 bool lhblFlashWriteFW(uint8_t *data, uint32_t length);
 
+/**
+ * @brief Calculate the CRC32 of the content of the lighthouse spi flash
+ * 
+ * The flash is read one page at the time.
+ * 
+ * @param address Flash address of the first byte
+ * @param length Number of bytes
+ * @param crc Pointer to where the CRC32 will be written
+ * @return true in case of success
+ * @return false in case of failure
+ */
+bool lhblFlashCrc32(uint32_t address, uint32_t length, uint32_t *crc);
+
 /**
  * Erase firwmare section in lighthouse spi flash
  *
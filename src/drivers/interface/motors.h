@@ -116,6 +116,20 @@
   #define MOTORS_BL_POLARITY           TIM_OCPolarity_Low
 #endif
 
+// Use the digital DShot600 protocol for brushless motors instead of PWM. The frames of all motors on
+// a timer are sent with one DMA burst per stabilizer tick, see motorsBurstDshot(). Requires a DMA
+// stream for the timer in the motor mapping, otherwise PWM is used.
+//#define ENABLE_DSHOT
+
+#ifdef ENABLE_DSHOT
+  #define MOTORS_DSHOT_BIT_RATE     600000
+  #define MOTORS_DSHOT_BIT_PERIOD   (TIM_CLOCK_HZ / MOTORS_DSHOT_BIT_RATE) // 140 timer ticks, 1.67us
+  #define MOTORS_DSHOT_ONE_HIGH     (MOTORS_DSHOT_BIT_PERIOD * 3 / 4)
+  #define MOTORS_DSHOT_ZERO_HIGH    (MOTORS_DSHOT_BIT_PERIOD * 3 / 8)
+  // Low bit periods after the frame, the line is kept low until the next frame
+  #define MOTORS_DSHOT_IDLE_BITS    2
+#endif
+
 #define NBR_OF_MOTORS 4
 // Motors IDs define
 #define MOTOR_M1  0
@@ -214,6 +228,12 @@ typedef struct
   uint32_t (*getCompare)(TIM_TypeDef* TIMx);
   void (*ocInit)(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
   void (*preloadConfig)(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+  /* DShot, the compare registers of the timer are written in a DMA burst */
+  uint8_t       timChannel;   // Timer channel, 1 to 4
+  DMA_Stream_TypeDef* dmaStream; // NULL if DShot is not supported
+  uint32_t      dmaChannel;
+  uint32_t      dmaFlags;     // All flags of the stream, cleared before a burst
+  uint16_t      dmaSource;    // The timer DMA request that triggers the burst
 } MotorPerifDef;
 
 /**
@@ -252,11 +272,25 @@ bool motorsTest(void);
  */
 void motorsSetRatio(uint32_t id, uint16_t ratio);
 
+/**
+ * Set the PWM ratio of the motor 'id' as is, without the battery voltage
+ * compensation that motorsSetRatio() does for brushed motors. For callers
+ * that compensate the ratio themselves.
+ */
+void motorsSetRatioUncompensated(uint32_t id, uint16_t ratio);
+
 /**
  * Get the PWM ratio of the motor 'id'. Return -1 if wrong ID.
  */
 int motorsGetRatio(uint32_t id);
 
+/**
+ * Send the latest ratios set with motorsSetRatio() to the ESCs, when using
+ * DShot. Call once per stabilizer tick after the ratios of all motors are set.
+ * Does nothing when PWM is used.
+ */
+void motorsBurstDshot(void);
+
 /**
  * FreeRTOS Task to test the Motors driver
  */
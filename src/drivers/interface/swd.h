@@ -27,7 +27,80 @@
 #define __SWD_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// DP registers
+#define SWD_DP_IDCODE    0x00 // Read
+#define SWD_DP_ABORT     0x00 // Write
+#define SWD_DP_CTRLSTAT  0x04
+#define SWD_DP_SELECT    0x08
+#define SWD_DP_RDBUFF    0x0C
+
+// MEM-AP registers
+#define SWD_AP_CSW       0x00
+#define SWD_AP_TAR       0x04
+#define SWD_AP_DRW       0x0C
+#define SWD_AP_IDR       0xFC
+
 void swdInit();
 bool swdTest();
 
+/**
+ * Switches the target to SWD with a line reset, reads the IDCODE, clears the
+ * sticky errors and powers up the debug domain. Overrun detection is enabled,
+ * which is what makes the pipelined writes possible.
+ * @param[out] idcode  The IDCODE of the DP
+ * @return true if the target responded and the debug domain is powered
+ */
+bool swdConnect(uint32_t* idcode);
+
+/**
+ * Reads a DP register.
+ * @return false if the transfer failed, the sticky errors are cleared
+ */
+bool swdDpRead(const uint8_t reg, uint32_t* value);
+
+/**
+ * Writes a DP register. Writes are posted, they are queued and sent with the
+ * next read or swdFlush(). A failed write is reported by the next read or
+ * swdFlush().
+ */
+bool swdDpWrite(const uint8_t reg, const uint32_t value);
+
+/**
+ * Reads a register of an AP, the result is fetched with a read of RDBUFF.
+ * @return false if the transfer failed, the sticky errors are cleared
+ */
+bool swdApRead(const uint8_t ap, const uint8_t reg, uint32_t* value);
+
+/**
+ * Writes a register of an AP. Writes are posted, see swdDpWrite().
+ */
+bool swdApWrite(const uint8_t ap, const uint8_t reg, const uint32_t value);
+
+/**
+ * Sends the queued writes and checks the sticky errors in CTRL/STAT.
+ * @return true if all writes since the last check were done
+ */
+bool swdFlush(void);
+
+/**
+ * Reads words from the memory of the target through the MEM-AP 0, with TAR
+ * auto-increment and pipelined DRW reads.
+ * @param[in] address  Word aligned address
+ * @return true if all words were read
+ */
+bool swdMemRead(const uint32_t address, uint32_t* data, const uint32_t words);
+
+/**
+ * Writes words to the memory of the target through the MEM-AP 0. The DRW
+ * writes are streamed without waiting for the ACKs and checked once at the
+ * end. If the target could not keep up the words are written again, one
+ * transfer at a time, so the memory must tolerate the words being written
+ * twice (RAM and the flash of the nRF51/nRF52 do).
+ * @param[in] address  Word aligned address
+ * @return true if all words were written
+ */
+bool swdMemWrite(const uint32_t address, const uint32_t* data, const uint32_t words);
+
 #endif /* __SWD_H__ */
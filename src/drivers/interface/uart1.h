@@ -44,6 +44,12 @@
 #define UART1_DMA_CH           DMA_Channel_4
 #define UART1_DMA_FLAG_TCIF    DMA_FLAG_TCIF3
 
+#define UART1_RX_DMA_IRQ       DMA1_Stream1_IRQn
+#define UART1_RX_DMA_STREAM    DMA1_Stream1
+#define UART1_RX_DMA_CH        DMA_Channel_4
+#define UART1_RX_DMA_IT_HTIF   DMA_IT_HTIF1
+#define UART1_RX_DMA_IT_TCIF   DMA_IT_TCIF1
+
 #define UART1_GPIO_PERIF       RCC_AHB1Periph_GPIOC
 #define UART1_GPIO_PORT        GPIOC
 #define UART1_GPIO_TX_PIN      GPIO_Pin_10
@@ -74,6 +80,22 @@ void uart1InitWithParity(const uint32_t baudrate, const uart1Parity_t parity);
  */
 bool uart1Test(void);
 
+/**
+ * Receive data with circular DMA instead of one interrupt and queue item
+ * per byte. Call after uart1Init(). Data that is not read within the time it
+ * takes to receive UART1_RX_DMA_BUFFER_SIZE bytes is overwritten.
+ */
+void uart1InitRxDma(void);
+
+/**
+ * Read the data that has been received, waiting for at least one byte.
+ * @param[out] data  Destination of the data
+ * @param[in] maxLength  Size of the destination
+ * @param[in] timeoutTicks The timeout in sys ticks
+ * @return The number of bytes read, 0 if the timeout was reached.
+ */
+uint32_t uart1GetBytesWithTimeout(uint8_t *data, const uint32_t maxLength, const uint32_t timeoutTicks);
+
 /**
  * Read a byte of data from incoming queue with a timeout
  * @param[out] c  Read byte
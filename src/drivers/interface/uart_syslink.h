@@ -43,6 +43,12 @@
 #define UARTSLK_DMA_CH           DMA_Channel_5
 #define UARTSLK_DMA_FLAG_TCIF    DMA_FLAG_TCIF7
 
+#define UARTSLK_RX_DMA_IRQ       DMA2_Stream1_IRQn
+#define UARTSLK_RX_DMA_STREAM    DMA2_Stream1
+#define UARTSLK_RX_DMA_CH        DMA_Channel_5
+#define UARTSLK_RX_DMA_IT_HTIF   DMA_IT_HTIF1
+#define UARTSLK_RX_DMA_IT_TCIF   DMA_IT_TCIF1
+
 #define UARTSLK_GPIO_PERIF       RCC_AHB1Periph_GPIOC
 #define UARTSLK_GPIO_PORT        GPIOC
 #define UARTSLK_GPIO_TX_PIN      GPIO_Pin_6
@@ -108,12 +114,22 @@ void uartslkSendDataIsrBlocking(uint32_t size, uint8_t* data);
 int uartslkPutchar(int ch);
 
 /**
- * Sends raw data using DMA transfer.
+ * Sends raw data using DMA transfer and waits until it has been sent.
  * @param[in] size  Number of bytes to send
  * @param[in] data  Pointer to data
  */
 void uartslkSendDataDmaBlocking(uint32_t size, uint8_t* data);
 
+/**
+ * Queues raw data to be sent using DMA transfer. Data queued while a transfer
+ * is running is sent in the next transfer, back to back.
+ * @param[in] size  Number of bytes to send
+ * @param[in] data  Pointer to data, copied before returning
+ * @param[in] wait  Ticks to wait for room in the queue
+ * @return true if the data was queued, false if there was no room in time
+ */
+bool uartslkEnqueueDataDma(uint32_t size, const uint8_t* data, uint32_t wait);
+
 /**
  * Interrupt service routine handling UART interrupts.
  */
@@ -124,6 +140,11 @@ void uartslkIsr(void);
  */
 void uartslkDmaIsr(void);
 
+/**
+ * Interrupt service routine handling UART RX DMA half and full transfer interrupts.
+ */
+void uartslkRxDmaIsr(void);
+
 void uartslkTxenFlowctrlIsr();
 
 #endif /* UART_SYSLINK_H_ */
@@ -1,7 +1,24 @@
 #ifndef __WS2812_H__
 #define __WS2812_H__
 
+#include <stdint.h>
+
+// Largest number of LEDs in a frame, the frame buffers are sized for it
+#ifndef WS2812_MAX_LEDS
+#ifdef LED_RING_NBR_LEDS
+#define WS2812_MAX_LEDS LED_RING_NBR_LEDS
+#else
+#define WS2812_MAX_LEDS 12
+#endif
+#endif
+
 void ws2812Init(void);
+
+/**
+ * Send a frame of colors to the LEDs. The frame is encoded in the calling task
+ * and sent with one DMA transfer. Frames that are the same as the previous one
+ * are not sent.
+ */
 void ws2812Send(uint8_t (*color)[3], uint16_t len);
 void ws2812DmaIsr(void);
 
@@ -56,13 +56,19 @@
 
 #define CPPM_MIN_PPM_USEC            1150
 #define CPPM_MAX_PPM_USEC            1900
+#define CPPM_MIN_SYNC_USEC           2100
 
-static xQueueHandle captureQueue;
-STATIC_MEM_QUEUE_ALLOC(captureQueue, 64, sizeof(uint16_t));
+// Frames are assembled in the interrupt, the task is only woken per frame
+static xQueueHandle frameQueue;
+STATIC_MEM_QUEUE_ALLOC(frameQueue, 1, sizeof(cppmFrame_t));
+static cppmFrame_t frame;
 static uint16_t prevCapureVal;
 static bool captureFlag;
 static bool isAvailible;
 
+static uint32_t frameCount;
+static uint32_t badFrameCount;
+
 void cppmInit(void)
 {
   TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
@@ -97,7 +103,7 @@ void cppmInit(void)
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
 
-  captureQueue = STATIC_MEM_QUEUE_CREATE(captureQueue);
+  frameQueue = STATIC_MEM_QUEUE_CREATE(frameQueue);
 
   TIM_ITConfig(CPPM_TIMER, TIM_IT_Update | TIM_IT_CC1, ENABLE);
   TIM_Cmd(CPPM_TIMER, ENABLE);
@@ -108,16 +114,16 @@ bool cppmIsAvailible(void)
   return isAvailible;
 }
 
-int cppmGetTimestamp(uint16_t *timestamp)
+int cppmGetFrame(cppmFrame_t *frame, uint32_t timeout)
 {
-  ASSERT(timestamp);
+  ASSERT(frame);
 
-  return xQueueReceive(captureQueue, timestamp, portMAX_DELAY);
+  return xQueueReceive(frameQueue, frame, timeout);
 }
 
 void cppmClearQueue(void)
 {
-  xQueueReset(captureQueue);
+  xQueueReset(frameQueue);
 }
 
 float cppmConvert2Float(uint16_t timestamp, float min, float max)
@@ -169,7 +175,29 @@ void __attribute__((used)) TIM8_TRG_COM_TIM14_IRQHandler()
     capureValDiff = capureVal - prevCapureVal;
     prevCapureVal = capureVal;
 
-    xQueueSendFromISR(captureQueue, &capureValDiff, &xHigherPriorityTaskWoken);
+    if (isAvailible && capureValDiff < CPPM_MIN_SYNC_USEC)
+    {
+      if (frame.count < CPPM_MAX_CHANNELS)
+      {
+        frame.channels[frame.count] = capureValDiff;
+      }
+      frame.count++;
+    }
+    else
+    {
+      // Sync pulse, or the first edge after the signal was lost
+      if (frame.count > 0 && frame.count <= CPPM_MAX_CHANNELS)
+      {
+        frame.timestamp = xTaskGetTickCountFromISR();
+        xQueueOverwriteFromISR(frameQueue, &frame, &xHigherPriorityTaskWoken);
+        frameCount++;
+      }
+      else if (frame.count > 0)
+      {
+        badFrameCount++;
+      }
+      frame.count = 0;
+    }
 
     captureFlag = true;
     TIM_ClearITPendingBit(CPPM_TIMER, TIM_IT_CC1);
@@ -182,4 +210,20 @@ void __attribute__((used)) TIM8_TRG_COM_TIM14_IRQHandler()
     captureFlag = false;
     TIM_ClearITPendingBit(CPPM_TIMER, TIM_IT_Update);
   }
+
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
+
+/**
+ * CPPM frame statistics
+ */
+LOG_GROUP_START(cppm)
+/**
+ * @brief Number of complete frames received
+ */
+LOG_ADD(LOG_UINT32, frames, &frameCount)
+/**
+ * @brief Number of frames dropped for having too many channels
+ */
+LOG_ADD(LOG_UINT32, badFrames, &badFrameCount)
+LOG_GROUP_STOP(cppm)
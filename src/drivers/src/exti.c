@@ -30,6 +30,7 @@
 #include "exti.h"
 #include "nvicconf.h"
 #include "nrf24l01.h"
+#include "isr_profiler.h"
 
 static bool isInit;
 
@@ -91,36 +92,47 @@ bool extiTest(void)
 
 void __attribute__((used)) EXTI0_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti0);
   EXTI_ClearITPendingBit(EXTI_Line0);
   EXTI0_Callback();
+  ISR_PROFILER_EXIT(isrProfilerExti0);
 }
 
 void __attribute__((used)) EXTI1_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti1);
   EXTI_ClearITPendingBit(EXTI_Line1);
   EXTI1_Callback();
+  ISR_PROFILER_EXIT(isrProfilerExti1);
 }
 
 void __attribute__((used)) EXTI2_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti2);
   EXTI_ClearITPendingBit(EXTI_Line2);
   EXTI2_Callback();
+  ISR_PROFILER_EXIT(isrProfilerExti2);
 }
 
 void __attribute__((used)) EXTI3_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti3);
   EXTI_ClearITPendingBit(EXTI_Line3);
   EXTI3_Callback();
+  ISR_PROFILER_EXIT(isrProfilerExti3);
 }
 
 void __attribute__((used)) EXTI4_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti4);
   EXTI_ClearITPendingBit(EXTI_Line4);
   EXTI4_Callback();
+  ISR_PROFILER_EXIT(isrProfilerExti4);
 }
 
 void __attribute__((used)) EXTI9_5_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti9_5);
   if (EXTI_GetITStatus(EXTI_Line5) == SET) {
     EXTI_ClearITPendingBit(EXTI_Line5);
     EXTI5_Callback();
@@ -145,10 +157,12 @@ void __attribute__((used)) EXTI9_5_IRQHandler(void)
     EXTI_ClearITPendingBit(EXTI_Line9);
     EXTI9_Callback();
   }
+  ISR_PROFILER_EXIT(isrProfilerExti9_5);
 }
 
 void __attribute__((used)) EXTI15_10_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerExti15_10);
   if (EXTI_GetITStatus(EXTI_Line10) == SET) {
     EXTI_ClearITPendingBit(EXTI_Line10);
     EXTI10_Callback();
@@ -178,6 +192,7 @@ void __attribute__((used)) EXTI15_10_IRQHandler(void)
     EXTI_ClearITPendingBit(EXTI_Line15);
     EXTI15_Callback();
   }
+  ISR_PROFILER_EXIT(isrProfilerExti15_10);
 }
 
 void __attribute__((weak)) EXTI0_Callback(void) { }
@@ -48,12 +48,27 @@ static const int INT_TIMEOUT = 0;
 static const int INT_ERROR = 0;
 static const int INT_READY = 1;
 
+// The card normally finishes programming a block within a few hundred
+// microseconds. It is first polled in short bursts, which are cheap transfers
+// compared to the 1 ms sleep used while waiting for slow operations.
+#define BUSY_POLL_LENGTH 8
+#define BUSY_POLL_BURSTS 64
+
 static uint8_t powerFlag;
+static BYTE busyPollBuff[BUSY_POLL_LENGTH];
 
 static int waitForCardReady(sdSpiContext_t *context, UINT timeoutMs) {
   BYTE d;
   uint32_t timeout = timeoutMs;
 
+  // The card keeps DO high once it is ready, extra clocks are ignored
+  for (int i = 0; i < BUSY_POLL_BURSTS; i++) {
+    context->rcvrSpiMulti(busyPollBuff, BUSY_POLL_LENGTH);
+    if (busyPollBuff[BUSY_POLL_LENGTH - 1] == 0xFF) {
+      return INT_READY;
+    }
+  }
+
   while ((d = context->xchgSpi(0xFF)) != 0xFF && timeout)
   {
     // Waiting can take a while so release the SPI bus in between
@@ -48,6 +48,7 @@
 #include "config.h"
 #include "nvicconf.h"
 #include "sleepus.h"
+#include "isr_profiler.h"
 
 //DEBUG
 #ifdef I2CDRV_DEBUG_LOG_EVENTS
@@ -120,6 +121,14 @@ static void i2cdrvErrorIsrHandler(I2cDrv* i2c);
  * DMA interrupt service routine
  */
 static void i2cdrvDmaIsrHandler(I2cDrv* i2c);
+/**
+ * Start the next queued transfer if the bus is idle. Interrupts must be masked.
+ */
+static void i2cdrvStartNextTransfer(I2cDrv* i2c);
+/**
+ * Abort the active transfer if it has hanged the bus
+ */
+static void i2cdrvAbortTimedOutTransfer(I2cDrv* i2c);
 
 // Cost definitions of busses
 static const I2cDef sensorBusDef =
@@ -203,20 +212,158 @@ static void i2cdrvStartTransfer(I2cDrv *i2c)
 
   I2C_ITConfig(i2c->def->i2cPort, I2C_IT_BUF, DISABLE);
   I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT, ENABLE);
+  // Writing CR1 before the stop condition of the previous message has been
+  // generated would cancel it.
+  while (i2c->def->i2cPort->CR1 & I2C_CR1_STOP) { ; }
   i2c->def->i2cPort->CR1 = (I2C_CR1_START | I2C_CR1_PE);
 }
 
+static void i2cNotifyClient(I2cDrv* i2c)
+{
+  I2cTransfer* transfer = i2c->activeTransfer;
+  if (transfer == NULL)
+  {
+    // Aborted
+    return;
+  }
+
+  transfer->messages[transfer->messageIndex].status = i2c->txMessage.status;
+  if (i2c->txMessage.status != i2cAck)
+  {
+    transfer->isSuccess = false;
+  }
+  transfer->messageIndex++;
+}
+
 static void i2cTryNextMessage(I2cDrv* i2c)
 {
   i2c->def->i2cPort->CR1 = (I2C_CR1_STOP | I2C_CR1_PE);
   I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
+
+  I2cTransfer* transfer = i2c->activeTransfer;
+  if (transfer == NULL)
+  {
+    return;
+  }
+
+  if (transfer->isSuccess && transfer->messageIndex < transfer->nbrOfMessages)
+  {
+    // Next message in the chain
+    memcpy((char*)&i2c->txMessage, (char*)&transfer->messages[transfer->messageIndex], sizeof(I2cMessage));
+    i2cdrvStartTransfer(i2c);
+    return;
+  }
+
+  i2c->activeTransfer = NULL;
+  transfer->isDone = true;
+  if (transfer->callback)
+  {
+    transfer->callback(transfer, transfer->isSuccess);
+  }
+
+  i2cdrvStartNextTransfer(i2c);
 }
 
-static void i2cNotifyClient(I2cDrv* i2c)
+static void i2cdrvStartNextTransfer(I2cDrv* i2c)
 {
-  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-  xSemaphoreGiveFromISR(i2c->isBusFreeSemaphore, &xHigherPriorityTaskWoken);
-  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+  if (i2c->activeTransfer)
+  {
+    return;
+  }
+
+  for (int prio = I2C_NBR_OF_PRIORITIES - 1; prio >= 0; prio--)
+  {
+    I2cTransfer* transfer = i2c->queueHead[prio];
+    if (transfer)
+    {
+      i2c->queueHead[prio] = transfer->next;
+      if (i2c->queueHead[prio] == NULL)
+      {
+        i2c->queueTail[prio] = NULL;
+      }
+      transfer->next = NULL;
+
+      i2c->activeTransfer = transfer;
+      i2c->activeTransferStart = xTaskGetTickCountFromISR();
+      memcpy((char*)&i2c->txMessage, (char*)&transfer->messages[0], sizeof(I2cMessage));
+      i2cdrvStartTransfer(i2c);
+      return;
+    }
+  }
+}
+
+static bool i2cdrvRemoveQueuedTransfer(I2cDrv* i2c, I2cTransfer* transfer)
+{
+  I2cTransfer** link = &i2c->queueHead[transfer->priority];
+  I2cTransfer* previous = NULL;
+  while (*link)
+  {
+    if (*link == transfer)
+    {
+      *link = transfer->next;
+      if (i2c->queueTail[transfer->priority] == transfer)
+      {
+        i2c->queueTail[transfer->priority] = previous;
+      }
+      transfer->next = NULL;
+      return true;
+    }
+    previous = *link;
+    link = &(*link)->next;
+  }
+  return false;
+}
+
+/**
+ * Take the active transfer off the bus and restart the bus. Must be called
+ * from a task, the bus restart is done with interrupts enabled. The aborted
+ * transfer stays active during the restart to keep other transfers off the bus.
+ */
+static void i2cdrvAbortActiveTransfer(I2cDrv* i2c, I2cTransfer* transfer, bool notify)
+{
+  taskENTER_CRITICAL();
+  bool isAborting = (i2c->activeTransfer == transfer) && !i2c->isRestarting;
+  if (isAborting)
+  {
+    i2c->isRestarting = true;
+    I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR, DISABLE);
+    i2cdrvClearDMA(i2c);
+  }
+  taskEXIT_CRITICAL();
+
+  if (!isAborting)
+  {
+    return;
+  }
+
+  i2cdrvTryToRestartBus(i2c);
+  //TODO: If bus is really hanged... fail safe
+
+  taskENTER_CRITICAL();
+  i2c->activeTransfer = NULL;
+  i2c->isRestarting = false;
+  transfer->isSuccess = false;
+  transfer->isDone = true;
+  if (notify && transfer->callback)
+  {
+    transfer->callback(transfer, false);
+  }
+  i2cdrvStartNextTransfer(i2c);
+  taskEXIT_CRITICAL();
+}
+
+static void i2cdrvAbortTimedOutTransfer(I2cDrv* i2c)
+{
+  taskENTER_CRITICAL();
+  I2cTransfer* transfer = i2c->activeTransfer;
+  bool isTimedOut = transfer &&
+                    (xTaskGetTickCount() - i2c->activeTransferStart) > I2C_MESSAGE_TIMEOUT;
+  taskEXIT_CRITICAL();
+
+  if (isTimedOut)
+  {
+    i2cdrvAbortActiveTransfer(i2c, transfer, true);
+  }
 }
 
 static void i2cdrvTryToRestartBus(I2cDrv* i2c)
@@ -397,34 +544,85 @@ void i2cdrvCreateMessageIntAddr(I2cMessage *message,
   message->nbrOfRetries = I2C_MAX_RETRIES;
 }
 
+static void i2cdrvSyncTransferDone(I2cTransfer* transfer, bool success)
+{
+  I2cDrv* i2c = (I2cDrv*)transfer->callbackArg;
+  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+  xSemaphoreGiveFromISR(i2c->isBusFreeSemaphore, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message)
 {
   bool status = false;
 
-  xSemaphoreTake(i2c->isBusFreeMutex, portMAX_DELAY); // Protect message data
-  // Copy message
-  memcpy((char*)&i2c->txMessage, (char*)message, sizeof(I2cMessage));
-  // We can now start the ISR sending this message.
-  i2cdrvStartTransfer(i2c);
+  xSemaphoreTake(i2c->isBusFreeMutex, portMAX_DELAY); // Protect the sync transfer
+  I2cTransfer* transfer = &i2c->syncTransfer;
+  transfer->messages = message;
+  transfer->nbrOfMessages = 1;
+  transfer->priority = i2cPriorityNormal;
+  transfer->callback = i2cdrvSyncTransferDone;
+  transfer->callbackArg = i2c;
+  i2cdrvSubmitTransfer(i2c, transfer);
+
   // Wait for transaction to be done
   if (xSemaphoreTake(i2c->isBusFreeSemaphore, I2C_MESSAGE_TIMEOUT) == pdTRUE)
   {
-    if (i2c->txMessage.status == i2cAck)
-    {
-      status = true;
-    }
+    status = transfer->isSuccess;
   }
   else
   {
-    i2cdrvClearDMA(i2c);
-    i2cdrvTryToRestartBus(i2c);
-    //TODO: If bus is really hanged... fail safe
+    status = i2cdrvCancelTransfer(i2c, transfer) && transfer->isSuccess;
+    // The transfer might have completed while it was cancelled
+    xSemaphoreTake(i2c->isBusFreeSemaphore, 0);
   }
   xSemaphoreGive(i2c->isBusFreeMutex);
 
   return status;
 }
 
+void i2cdrvSubmitTransfer(I2cDrv* i2c, I2cTransfer* transfer)
+{
+  ASSERT(transfer->nbrOfMessages > 0);
+  ASSERT(transfer->priority < I2C_NBR_OF_PRIORITIES);
+
+  i2cdrvAbortTimedOutTransfer(i2c);
+
+  transfer->isDone = false;
+  transfer->isSuccess = true;
+  transfer->messageIndex = 0;
+  transfer->next = NULL;
+
+  taskENTER_CRITICAL();
+  if (i2c->queueTail[transfer->priority])
+  {
+    i2c->queueTail[transfer->priority]->next = transfer;
+  }
+  else
+  {
+    i2c->queueHead[transfer->priority] = transfer;
+  }
+  i2c->queueTail[transfer->priority] = transfer;
+  i2cdrvStartNextTransfer(i2c);
+  taskEXIT_CRITICAL();
+}
+
+bool i2cdrvCancelTransfer(I2cDrv* i2c, I2cTransfer* transfer)
+{
+  taskENTER_CRITICAL();
+  bool isQueued = i2cdrvRemoveQueuedTransfer(i2c, transfer);
+  bool isActive = (i2c->activeTransfer == transfer);
+  taskEXIT_CRITICAL();
+
+  if (isActive)
+  {
+    i2cdrvAbortActiveTransfer(i2c, transfer, false);
+    return false;
+  }
+
+  return !isQueued && transfer->isDone;
+}
+
 
 static void i2cdrvEventIsrHandler(I2cDrv* i2c)
 {
@@ -630,12 +828,16 @@ static void i2cdrvDmaIsrHandler(I2cDrv* i2c)
 
 void __attribute__((used)) I2C1_ER_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerI2c1Er);
   i2cdrvErrorIsrHandler(&deckBus);
+  ISR_PROFILER_EXIT(isrProfilerI2c1Er);
 }
 
 void __attribute__((used)) I2C1_EV_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerI2c1Ev);
   i2cdrvEventIsrHandler(&deckBus);
+  ISR_PROFILER_EXIT(isrProfilerI2c1Ev);
 }
 
 #ifdef USDDECK_USE_ALT_PINS_AND_SPI
@@ -644,20 +846,28 @@ void __attribute__((used)) DMA1_Stream5_IRQHandler(void)
 void __attribute__((used)) DMA1_Stream0_IRQHandler(void)
 #endif
 {
+  ISR_PROFILER_ENTER(isrProfilerI2c1Dma);
   i2cdrvDmaIsrHandler(&deckBus);
+  ISR_PROFILER_EXIT(isrProfilerI2c1Dma);
 }
 
 void __attribute__((used)) I2C3_ER_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerI2c3Er);
   i2cdrvErrorIsrHandler(&sensorsBus);
+  ISR_PROFILER_EXIT(isrProfilerI2c3Er);
 }
 
 void __attribute__((used)) I2C3_EV_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerI2c3Ev);
   i2cdrvEventIsrHandler(&sensorsBus);
+  ISR_PROFILER_EXIT(isrProfilerI2c3Ev);
 }
 
 void __attribute__((used)) DMA1_Stream2_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerI2c3Dma);
   i2cdrvDmaIsrHandler(&sensorsBus);
+  ISR_PROFILER_EXIT(isrProfilerI2c3Dma);
 }
@@ -33,6 +33,7 @@
 #include "lh_bootloader.h"
 #include "debug.h"
 #include "i2cdev.h"
+#include "crc32.h"
 
 #define LH_I2C_ADDR         0x2F
 #define LH_FW_SIZE          0x020000
@@ -78,19 +79,6 @@ static void lhblHeaderPrepare(uint16_t writeLen, uint16_t readLen, uint8_t* buff
   buff[4] = (uint8_t)((readLen >> 8)  & 0x000000FF);
 }
 
-static bool verify(uint8_t *dataA, uint8_t *dataB, uint16_t length)
-{
-  for (int i = 0; i < length; i++)
-  {
-    if (dataA[i] != dataB[i])
-    {
-      return false;
-    }
-  }
-
-  return true;
-}
-
 bool lhblInit()
 {
   if (isInit)
@@ -135,7 +123,7 @@ static bool lhblFlashEraseBlock64k(uint32_t address)
   return lhExchange(5 + 4, flashWriteBuf, 0, 0);
 }
 
-static bool lhblFlashWaitComplete(void)
+bool lhblFlashWaitComplete(void)
 {
   bool status;
   uint8_t flashStatus;
@@ -227,44 +215,42 @@ bool lhblFlashEraseFirmware(void)
 bool lhblFlashWriteFW(uint8_t *data, uint32_t length)
 {
   bool status = true;
-  int pageCount = 0;
-  int nbrPages = length / LH_FLASH_PAGE_SIZE;
-  int lastPageSize = length % LH_FLASH_PAGE_SIZE;
 
   ASSERT(length <= LH_FW_SIZE);
 
-  for (pageCount = 0; pageCount < nbrPages && status; pageCount++)
+  // The program of a page is started without waiting for it, the flash is busy while the next page is sent
+  for (uint32_t offset = 0; offset < length && status; offset += LH_FLASH_PAGE_SIZE)
   {
-    status = lhblFlashWritePage(LH_FW_ADDR + pageCount * LH_FLASH_PAGE_SIZE,
-                                LH_FLASH_PAGE_SIZE,
-                                &data[pageCount * LH_FLASH_PAGE_SIZE]);
-    lhblFlashWaitComplete();
-
-    lhblFlashRead(LH_FW_ADDR + pageCount * LH_FLASH_PAGE_SIZE,
-                  LH_FLASH_PAGE_SIZE,
-                  flashReadBuf);
-
-    if (verify(&data[pageCount * LH_FLASH_PAGE_SIZE], flashReadBuf, LH_FLASH_PAGE_SIZE) == false)
-    {
-      return false;
-    }
+    uint16_t pageLength = ((length - offset) < LH_FLASH_PAGE_SIZE)?(length - offset):LH_FLASH_PAGE_SIZE;
+
+    status = lhblFlashWaitComplete();
+    status &= lhblFlashWritePage(LH_FW_ADDR + offset, pageLength, &data[offset]);
   }
-  if (lastPageSize && status)
+
+  status &= lhblFlashWaitComplete();
+
+  // One CRC of the written flash instead of comparing every page
+  uint32_t crc = 0;
+  status = status && lhblFlashCrc32(LH_FW_ADDR, length, &crc);
+
+  return status && crc == crc32CalculateBuffer(data, length);
+}
+
+bool lhblFlashCrc32(uint32_t address, uint32_t length, uint32_t *crc)
+{
+  bool status = true;
+  crc32Context_t crcContext;
+  crc32ContextInit(&crcContext);
+
+  for (uint32_t offset = 0; offset < length && status; offset += LH_FLASH_PAGE_SIZE)
   {
-    status = lhblFlashWritePage(LH_FW_ADDR + pageCount * LH_FLASH_PAGE_SIZE,
-                                lastPageSize,
-                                &data[pageCount * LH_FLASH_PAGE_SIZE]);
-    lhblFlashWaitComplete();
-
-    lhblFlashRead(LH_FW_ADDR + pageCount * LH_FLASH_PAGE_SIZE,
-                  lastPageSize,
-                  flashReadBuf);
-
-    if (verify(&data[pageCount * LH_FLASH_PAGE_SIZE], flashReadBuf, lastPageSize) == false)
-    {
-      return false;
-    }
+    uint16_t readLength = ((length - offset) < LH_FLASH_PAGE_SIZE)?(length - offset):LH_FLASH_PAGE_SIZE;
+
+    status = lhblFlashRead(address + offset, readLength, flashReadBuf);
+    crc32Update(&crcContext, flashReadBuf, readLength);
   }
 
+  *crc = crc32Out(&crcContext);
+
   return status;
 }
@@ -35,6 +35,7 @@
 #include "motors.h"
 #include "pm.h"
 #include "debug.h"
+#include "cfassert.h"
 
 //FreeRTOS includes
 #include "task.h"
@@ -42,6 +43,11 @@
 //Logging includes
 #include "log.h"
 
+#ifdef ENABLE_DSHOT
+#include <string.h>
+#include "dshot.h"
+#endif
+
 static uint16_t motorsBLConvBitsTo16(uint16_t bits);
 static uint16_t motorsBLConv16ToBits(uint16_t bits);
 static uint16_t motorsConvBitsTo16(uint16_t bits);
@@ -63,6 +69,26 @@ const uint16_t testsound[NBR_OF_MOTORS] = {A4, A5, F5, D5 };
 
 static bool isInit = false;
 
+#ifdef ENABLE_DSHOT
+#define DSHOT_DMA_SLOTS (DSHOT_FRAME_BITS + MOTORS_DSHOT_IDLE_BITS)
+
+// The frames of the motors on one timer. Each timer DMA request writes CCR1 to CCR4 in a burst, one
+// row per bit. Channels without a motor, and the idle bits after the frame, are 0 (low).
+typedef struct {
+  const MotorPerifDef* perif; // The first motor on the timer, for the timer and DMA settings
+  uint32_t compare[DSHOT_DMA_SLOTS][4];
+} dshotTimer_t;
+
+static bool useDshot = false;
+static dshotTimer_t dshotTimers[NBR_OF_MOTORS];
+static uint8_t dshotTimerCount;
+static uint8_t dshotTimerOfMotor[NBR_OF_MOTORS];
+static uint16_t dshotRatios[NBR_OF_MOTORS];
+
+static bool motorsDshotSupported(const MotorPerifDef** motorMapSelect);
+static void motorsDshotInit(void);
+#endif
+
 /* Private functions */
 
 static uint16_t motorsBLConvBitsTo16(uint16_t bits)
@@ -106,6 +132,18 @@ void motorsInit(const MotorPerifDef** motorMapSelect)
 
   DEBUG_PRINT("Using %s motor driver\n", motorMap[0]->drvType == BRUSHED ? "brushed" : "brushless");
 
+#ifdef ENABLE_DSHOT
+  useDshot = motorsDshotSupported(motorMap);
+  if (useDshot)
+  {
+    DEBUG_PRINT("Using DShot%d\n", MOTORS_DSHOT_BIT_RATE / 1000);
+  }
+  else
+  {
+    DEBUG_PRINT("DShot not supported by the motor mapping, using PWM\n");
+  }
+#endif
+
   for (i = 0; i < NBR_OF_MOTORS; i++)
   {
     //Clock the gpio and the timers
@@ -142,6 +180,14 @@ void motorsInit(const MotorPerifDef** motorMapSelect)
     TIM_TimeBaseStructure.TIM_ClockDivision = 0;
     TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
     TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+#ifdef ENABLE_DSHOT
+    if (useDshot)
+    {
+      // One timer period per bit
+      TIM_TimeBaseStructure.TIM_Period = MOTORS_DSHOT_BIT_PERIOD - 1;
+      TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    }
+#endif
     TIM_TimeBaseInit(motorMap[i]->tim, &TIM_TimeBaseStructure);
 
     // PWM channels configuration (All identical!)
@@ -160,6 +206,13 @@ void motorsInit(const MotorPerifDef** motorMapSelect)
     TIM_CtrlPWMOutputs(motorMap[i]->tim, ENABLE);
   }
 
+#ifdef ENABLE_DSHOT
+  if (useDshot)
+  {
+    motorsDshotInit();
+  }
+#endif
+
   // Start the timers
   for (i = 0; i < NBR_OF_MOTORS; i++)
   {
@@ -180,6 +233,17 @@ void motorsDeInit(const MotorPerifDef** motorMapSelect)
   int i;
   GPIO_InitTypeDef GPIO_InitStructure;
 
+#ifdef ENABLE_DSHOT
+  if (useDshot)
+  {
+    for (i = 0; i < dshotTimerCount; i++)
+    {
+      TIM_DMACmd(dshotTimers[i].perif->tim, dshotTimers[i].perif->dmaSource, DISABLE);
+      DMA_Cmd(dshotTimers[i].perif->dmaStream, DISABLE);
+    }
+  }
+#endif
+
   for (i = 0; i < NBR_OF_MOTORS; i++)
   {
     // Configure default
@@ -239,10 +303,28 @@ void motorsSetRatio(uint32_t id, uint16_t ithrust)
       float percentage = volts / supply_voltage;
       percentage = percentage > 1.0f ? 1.0f : percentage;
       ratio = percentage * UINT16_MAX;
-      motor_ratios[id] = ratio;
+    }
+  #endif
+    motorsSetRatioUncompensated(id, ratio);
+  }
+}
+
+void motorsSetRatioUncompensated(uint32_t id, uint16_t ratio)
+{
+  if (isInit) {
+    ASSERT(id < NBR_OF_MOTORS);
+
+    motor_ratios[id] = ratio;
 
+  #ifdef ENABLE_DSHOT
+    if (useDshot)
+    {
+      // Sent with the next burst
+      dshotRatios[id] = ratio;
+      return;
     }
   #endif
+
     if (motorMap[id]->drvType == BRUSHLESS)
     {
       motorMap[id]->setCompare(motorMap[id]->tim, motorsBLConv16ToBits(ratio));
@@ -259,6 +341,12 @@ int motorsGetRatio(uint32_t id)
   int ratio;
 
   ASSERT(id < NBR_OF_MOTORS);
+#ifdef ENABLE_DSHOT
+  if (useDshot)
+  {
+    return dshotRatios[id];
+  }
+#endif
   if (motorMap[id]->drvType == BRUSHLESS)
   {
     ratio = motorsBLConvBitsTo16(motorMap[id]->getCompare(motorMap[id]->tim));
@@ -271,12 +359,132 @@ int motorsGetRatio(uint32_t id)
   return ratio;
 }
 
+void motorsBurstDshot(void)
+{
+#ifdef ENABLE_DSHOT
+  bool idle[NBR_OF_MOTORS];
+  int i;
+
+  if (!isInit || !useDshot)
+  {
+    return;
+  }
+
+  // A burst takes about 30us, the previous one is done unless this is called at a very high rate
+  for (i = 0; i < dshotTimerCount; i++)
+  {
+    idle[i] = (DMA_GetCmdStatus(dshotTimers[i].perif->dmaStream) == DISABLE);
+  }
+
+  for (i = 0; i < NBR_OF_MOTORS; i++)
+  {
+    dshotTimer_t* timer = &dshotTimers[dshotTimerOfMotor[i]];
+    if (idle[dshotTimerOfMotor[i]])
+    {
+      const uint16_t frame = dshotFrame(dshotThrottleFromRatio(dshotRatios[i]), false);
+      dshotFrameToCompare(frame, &timer->compare[0][motorMap[i]->timChannel - 1], 4, MOTORS_DSHOT_ZERO_HIGH, MOTORS_DSHOT_ONE_HIGH);
+    }
+  }
+
+  // Start the bursts, the first bit is loaded at the next timer request
+  for (i = 0; i < dshotTimerCount; i++)
+  {
+    const MotorPerifDef* perif = dshotTimers[i].perif;
+    if (idle[i])
+    {
+      TIM_DMACmd(perif->tim, perif->dmaSource, DISABLE);
+      DMA_ClearFlag(perif->dmaStream, perif->dmaFlags);
+      DMA_SetCurrDataCounter(perif->dmaStream, DSHOT_DMA_SLOTS * 4);
+      DMA_Cmd(perif->dmaStream, ENABLE);
+      TIM_DMACmd(perif->tim, perif->dmaSource, ENABLE);
+    }
+  }
+#endif
+}
+
+#ifdef ENABLE_DSHOT
+static bool motorsDshotSupported(const MotorPerifDef** motorMapSelect)
+{
+  for (int i = 0; i < NBR_OF_MOTORS; i++)
+  {
+    if (motorMapSelect[i]->drvType != BRUSHLESS || motorMapSelect[i]->dmaStream == 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void motorsDshotInit(void)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+  int i;
+
+  // Group the motors by timer
+  dshotTimerCount = 0;
+  for (i = 0; i < NBR_OF_MOTORS; i++)
+  {
+    int timer = 0;
+    while (timer < dshotTimerCount && dshotTimers[timer].perif->tim != motorMap[i]->tim)
+    {
+      timer++;
+    }
+    if (timer == dshotTimerCount)
+    {
+      dshotTimers[timer].perif = motorMap[i];
+      memset(dshotTimers[timer].compare, 0, sizeof(dshotTimers[timer].compare));
+      dshotTimerCount++;
+    }
+    dshotTimerOfMotor[i] = timer;
+    dshotRatios[i] = 0;
+  }
+
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+
+  for (i = 0; i < dshotTimerCount; i++)
+  {
+    const MotorPerifDef* perif = dshotTimers[i].perif;
+
+    ASSERT_DMA_SAFE(dshotTimers[i].compare);
+    DMA_StructInit(&DMA_InitStructure);
+    DMA_InitStructure.DMA_Channel = perif->dmaChannel;
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&perif->tim->DMAR;
+    DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)dshotTimers[i].compare;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+    DMA_InitStructure.DMA_BufferSize = DSHOT_DMA_SLOTS * 4;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Word;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Word;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+    DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+
+    DMA_Cmd(perif->dmaStream, DISABLE);
+    DMA_DeInit(perif->dmaStream);
+    DMA_Init(perif->dmaStream, &DMA_InitStructure);
+
+    // Each DMA request writes the four compare registers through DMAR
+    TIM_DMAConfig(perif->tim, TIM_DMABase_CCR1, TIM_DMABurstLength_4Transfers);
+  }
+}
+#endif
+
 void motorsBeep(int id, bool enable, uint16_t frequency, uint16_t ratio)
 {
   TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
 
   ASSERT(id < NBR_OF_MOTORS);
 
+#ifdef ENABLE_DSHOT
+  // The timers run at the DShot bit rate
+  if (useDshot)
+  {
+    return;
+  }
+#endif
+
   TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
 
   if (enable)
@@ -25,6 +25,27 @@
  *
  * This code mainly interfacing the PWM peripheral lib of ST.
  */
+
+// DMA used for DShot, one stream per timer. The streams are shared with other drivers that can not be
+// used at the same time: TIM2 with the SPI3 TX (uSD deck), TIM3 with the BMI088 SPI TX (Bolt) and TIM4
+// with the UART2 TX. TIM3 is triggered by the channel 1 compare event since the update request is on
+// the stream of the I2C3 RX (sensors).
+#define TIM2_DSHOT_DMA \
+    .dmaStream     = DMA1_Stream7, \
+    .dmaChannel    = DMA_Channel_3, \
+    .dmaFlags      = DMA_FLAG_TCIF7 | DMA_FLAG_HTIF7 | DMA_FLAG_TEIF7 | DMA_FLAG_DMEIF7 | DMA_FLAG_FEIF7, \
+    .dmaSource     = TIM_DMA_Update
+#define TIM3_DSHOT_DMA \
+    .dmaStream     = DMA1_Stream4, \
+    .dmaChannel    = DMA_Channel_5, \
+    .dmaFlags      = DMA_FLAG_TCIF4 | DMA_FLAG_HTIF4 | DMA_FLAG_TEIF4 | DMA_FLAG_DMEIF4 | DMA_FLAG_FEIF4, \
+    .dmaSource     = TIM_DMA_CC1
+#define TIM4_DSHOT_DMA \
+    .dmaStream     = DMA1_Stream6, \
+    .dmaChannel    = DMA_Channel_2, \
+    .dmaFlags      = DMA_FLAG_TCIF6 | DMA_FLAG_HTIF6 | DMA_FLAG_TEIF6 | DMA_FLAG_DMEIF6 | DMA_FLAG_FEIF6, \
+    .dmaSource     = TIM_DMA_Update
+
 // Connector M1, PA1, TIM2_CH2
 static const MotorPerifDef CONN_M1 =
 {
@@ -133,6 +154,8 @@ static const MotorPerifDef CONN_M1_BL_INV =
     .getCompare    = TIM_GetCapture2,
     .ocInit        = TIM_OC2Init,
     .preloadConfig = TIM_OC2PreloadConfig,
+    .timChannel    = 2,
+    TIM2_DSHOT_DMA,
 };
 
 // Connector M2, PB11, TIM2_CH4, Brushless config, inversed
@@ -155,6 +178,8 @@ static const MotorPerifDef CONN_M2_BL_INV =
     .getCompare    = TIM_GetCapture4,
     .ocInit        = TIM_OC4Init,
     .preloadConfig = TIM_OC4PreloadConfig,
+    .timChannel    = 4,
+    TIM2_DSHOT_DMA,
 };
 
 // Connector M3, PA15, TIM2_CH1, Brushless config, inversed
@@ -177,6 +202,8 @@ static const MotorPerifDef CONN_M3_BL_INV =
     .getCompare    = TIM_GetCapture1,
     .ocInit        = TIM_OC1Init,
     .preloadConfig = TIM_OC1PreloadConfig,
+    .timChannel    = 1,
+    TIM2_DSHOT_DMA,
 };
 
 // Connector M4, PB9, TIM4_CH4, Brushless config, inversed
@@ -199,6 +226,8 @@ static const MotorPerifDef CONN_M4_BL_INV =
     .getCompare    = TIM_GetCapture4,
     .ocInit        = TIM_OC4Init,
     .preloadConfig = TIM_OC4PreloadConfig,
+    .timChannel    = 4,
+    TIM4_DSHOT_DMA,
 };
 
 // Bolt M1, PA1, TIM2_CH2, Brushless config
@@ -224,6 +253,8 @@ static const MotorPerifDef BOLT_M1_BL =
     .getCompare    = TIM_GetCapture2,
     .ocInit        = TIM_OC2Init,
     .preloadConfig = TIM_OC2PreloadConfig,
+    .timChannel    = 2,
+    TIM2_DSHOT_DMA,
 };
 
 // Bolt M2, PB11, TIM2_CH4, Brushless config
@@ -249,6 +280,8 @@ static const MotorPerifDef BOLT_M2_BL =
     .getCompare    = TIM_GetCapture4,
     .ocInit        = TIM_OC4Init,
     .preloadConfig = TIM_OC4PreloadConfig,
+    .timChannel    = 4,
+    TIM2_DSHOT_DMA,
 };
 
 // Bolt M3, PA15, TIM2_CH1, Brushless config
@@ -274,6 +307,8 @@ static const MotorPerifDef BOLT_M3_BL =
     .getCompare    = TIM_GetCapture1,
     .ocInit        = TIM_OC1Init,
     .preloadConfig = TIM_OC1PreloadConfig,
+    .timChannel    = 1,
+    TIM2_DSHOT_DMA,
 };
 
 // Bolt M4, PB9, TIM4_CH4, Brushless config
@@ -299,6 +334,8 @@ static const MotorPerifDef BOLT_M4_BL =
     .getCompare    = TIM_GetCapture4,
     .ocInit        = TIM_OC4Init,
     .preloadConfig = TIM_OC4PreloadConfig,
+    .timChannel    = 4,
+    TIM4_DSHOT_DMA,
 };
 
 // Deck TX2, PA2, TIM2_CH3
@@ -321,6 +358,8 @@ static const MotorPerifDef DECK_TX2_TIM2 =
     .getCompare    = TIM_GetCapture3,
     .ocInit        = TIM_OC3Init,
     .preloadConfig = TIM_OC3PreloadConfig,
+    .timChannel    = 3,
+    TIM2_DSHOT_DMA,
 };
 
 // Deck TX2, PA2, TIM5_CH3
@@ -365,6 +404,8 @@ static const MotorPerifDef DECK_RX2_TIM2 =
     .getCompare    = TIM_GetCapture4,
     .ocInit        = TIM_OC4Init,
     .preloadConfig = TIM_OC4PreloadConfig,
+    .timChannel    = 4,
+    TIM2_DSHOT_DMA,
 };
 
 // Deck RX2, PA3, TIM5_CH4
@@ -409,6 +450,8 @@ static const MotorPerifDef DECK_IO1_TIM4 =
     .getCompare    = TIM_GetCapture3,
     .ocInit        = TIM_OC3Init,
     .preloadConfig = TIM_OC3PreloadConfig,
+    .timChannel    = 3,
+    TIM4_DSHOT_DMA,
 };
 
 // Deck IO2, PB5, TIM3_CH2
@@ -431,6 +474,8 @@ static const MotorPerifDef DECK_IO2 =
     .getCompare    = TIM_GetCapture2,
     .ocInit        = TIM_OC2Init,
     .preloadConfig = TIM_OC2PreloadConfig,
+    .timChannel    = 2,
+    TIM3_DSHOT_DMA,
 };
 
 // Deck IO3, PB4, TIM3_CH1
@@ -453,6 +498,8 @@ static const MotorPerifDef DECK_IO3 =
     .getCompare    = TIM_GetCapture1,
     .ocInit        = TIM_OC1Init,
     .preloadConfig = TIM_OC1PreloadConfig,
+    .timChannel    = 1,
+    TIM3_DSHOT_DMA,
 };
 
 // Deck SCK, PA5, TIM2_CH1
@@ -475,6 +522,8 @@ static const MotorPerifDef DECK_SCK =
     .getCompare    = TIM_GetCapture1,
     .ocInit        = TIM_OC1Init,
     .preloadConfig = TIM_OC1PreloadConfig,
+    .timChannel    = 1,
+    TIM2_DSHOT_DMA,
 };
 
 // Deck MISO, PA6, TIM3_CH1
@@ -497,6 +546,8 @@ static const MotorPerifDef DECK_MISO =
     .getCompare    = TIM_GetCapture1,
     .ocInit        = TIM_OC1Init,
     .preloadConfig = TIM_OC1PreloadConfig,
+    .timChannel    = 1,
+    TIM3_DSHOT_DMA,
 };
 
 // Deck MOSI, PA7, TIM14_CH1
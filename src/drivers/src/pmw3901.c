@@ -44,7 +44,7 @@ static void registerWrite(const deckPin_t csPin, uint8_t reg, uint8_t value)
   // Set MSB to 1 for write
   reg |= 0x80u;
 
-  spiBeginTransaction(SPI_BAUDRATE_2MHZ);
+  spiBeginClientTransaction(spiClientFlow, SPI_BAUDRATE_2MHZ, portMAX_DELAY);
   digitalWrite(csPin, LOW);
 
   sleepus(50);
@@ -68,7 +68,7 @@ static uint8_t registerRead(const deckPin_t csPin, uint8_t reg)
   // Set MSB to 0 for read
   reg &= ~0x80u;
 
-  spiBeginTransaction(SPI_BAUDRATE_2MHZ);
+  spiBeginClientTransaction(spiClientFlow, SPI_BAUDRATE_2MHZ, portMAX_DELAY);
   digitalWrite(csPin, LOW);
 
   sleepus(50);
@@ -221,7 +221,7 @@ void pmw3901ReadMotion(const deckPin_t csPin, motionBurst_t * motion)
 {
   uint8_t address = 0x16;
 
-  spiBeginTransaction(SPI_BAUDRATE_2MHZ);
+  spiBeginClientTransaction(spiClientFlow, SPI_BAUDRATE_2MHZ, portMAX_DELAY);
   digitalWrite(csPin,LOW);
   sleepus(50);
   spiExchange(1, &address, &address);
@@ -22,8 +22,23 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  *
  * swd.c - Low level SWD functionality
+ *
+ * The SWD bit streams are clocked out by the SPI in bi-directional mode on a
+ * single line. The SPI only handles whole bytes, so the transfers are laid out
+ * to change the direction of the line on byte boundaries:
+ *  - A write is sent as one 48 bit stream, the line is open drain and the
+ *    host sends ones (releases the line) during the turnaround and ACK bits,
+ *    the last two bits are idle cycles. With overrun detection enabled the
+ *    target always expects the data phase, so the writes can be streamed
+ *    with DMA without reading the ACKs, and a WAIT or FAULT is seen in the
+ *    sticky flags of CTRL/STAT afterwards.
+ *  - A read sends the request byte (after the queued writes) and receives
+ *    5 bytes, turnaround, ACK, data, parity, turnaround and idle cycles. The
+ *    line is pulled down while receiving, the extra clocks before the SPI
+ *    has stopped are idle cycles.
  */
 #include <stdbool.h>
+#include <string.h>
 
 #include "stm32fxxx.h"
 
@@ -32,6 +47,7 @@
 #include "task.h"
 
 #include "swd.h"
+#include "cfassert.h"
 
 static bool isInit = false;
 
@@ -51,6 +67,67 @@ static bool isInit = false;
 #define SWD_SPI_MISO_SOURCE               GPIO_PinSource15
 #define SWD_SPI_MISO_AF                   GPIO_AF_SPI2
 
+// 328 kHz, limited by the rise time of the open drain line through the pull-up
+#define SWD_SPI_BAUDRATE_PRESCALER        SPI_BaudRatePrescaler_128
+
+// The SPI2 streams are shared with the BMI088 on the Bolt and the TIM3 DShot
+// output, the SWD can not be used at the same time.
+#define SWD_DMA_CLK                       RCC_AHB1Periph_DMA1
+#define SWD_RX_DMA_STREAM                 DMA1_Stream3
+#define SWD_RX_DMA_CHANNEL                DMA_Channel_0
+#define SWD_RX_DMA_FLAGS                  (DMA_FLAG_FEIF3 | DMA_FLAG_DMEIF3 | DMA_FLAG_TEIF3 | DMA_FLAG_HTIF3 | DMA_FLAG_TCIF3)
+#define SWD_RX_DMA_FLAG_TCIF              DMA_FLAG_TCIF3
+#define SWD_TX_DMA_STREAM                 DMA1_Stream4
+#define SWD_TX_DMA_CHANNEL                DMA_Channel_0
+#define SWD_TX_DMA_FLAGS                  (DMA_FLAG_FEIF4 | DMA_FLAG_DMEIF4 | DMA_FLAG_TEIF4 | DMA_FLAG_HTIF4 | DMA_FLAG_TCIF4)
+#define SWD_TX_DMA_FLAG_TCIF              DMA_FLAG_TCIF4
+
+// Streams longer than this sleep while the DMA is running, about 1 ms
+#define SWD_TX_SLEEP_MIN_BYTES            40
+
+#define SWD_TX_BUFFER_SIZE                (64 * SWD_WRITE_BYTES)
+#define SWD_WRITE_BYTES                   6
+#define SWD_READ_BYTES                    5
+
+#define SWD_ACK_OK                        0x1
+#define SWD_ACK_WAIT                      0x2
+#define SWD_ACK_FAULT                     0x4
+#define SWD_WAIT_RETRIES                  10
+
+// CTRL/STAT
+#define CTRLSTAT_ORUNDETECT               (1 << 0)
+#define CTRLSTAT_STICKYORUN               (1 << 1)
+#define CTRLSTAT_STICKYCMP                (1 << 4)
+#define CTRLSTAT_STICKYERR                (1 << 5)
+#define CTRLSTAT_WDATAERR                 (1 << 7)
+#define CTRLSTAT_CDBGPWRUPREQ             (1 << 28)
+#define CTRLSTAT_CDBGPWRUPACK             (1 << 29)
+#define CTRLSTAT_CSYSPWRUPREQ             (1 << 30)
+#define CTRLSTAT_CSYSPWRUPACK             (1u << 31)
+#define CTRLSTAT_ERRORS                   (CTRLSTAT_STICKYORUN | CTRLSTAT_STICKYCMP | CTRLSTAT_STICKYERR | CTRLSTAT_WDATAERR)
+
+// ABORT
+#define ABORT_ORUNERRCLR                  (1 << 4)
+#define ABORT_ALLERRCLR                   0x1E
+
+// MEM-AP CSW, 32 bit accesses with single auto-increment of TAR
+#define CSW_SIZE_ADDRINC_MASK             0x37
+#define CSW_SIZE32_ADDRINC_SINGLE         0x12
+
+// TAR is only guaranteed to auto-increment within a 1 kB block
+#define TAR_AUTOINC_BLOCK                 1024
+
+#define MEM_AP                            0
+#define SELECT_INVALID                    0xFFFFFFFF
+
+static uint8_t txBuffer[SWD_TX_BUFFER_SIZE];
+static uint16_t txLength;
+static uint8_t rxBuffer[SWD_READ_BYTES];
+
+// Cached register values, to not write them again
+static uint32_t selectCache = SELECT_INVALID;
+static uint32_t cswCache;
+static bool isCswValid;
 
 static void initGPIO(void) {
   GPIO_InitTypeDef GPIO_InitStructure;
@@ -70,7 +147,10 @@ static void initGPIO(void) {
   GPIO_InitStructure.GPIO_Pin = SWD_SPI_SCK_PIN;
   GPIO_Init(SWD_SPI_SCK_GPIO_PORT, &GPIO_InitStructure);
 
-  /* In bi-directional mode only MISO is used */
+  /* In bi-directional mode only MISO is used, open drain so that the target
+   * can drive the line during the ACK of a streamed write */
+  GPIO_InitStructure.GPIO_OType = GPIO_OType_OD;
+  GPIO_InitStructure.GPIO_PuPd  = GPIO_PuPd_UP;
   GPIO_InitStructure.GPIO_Pin =  SWD_SPI_MISO_PIN;
   GPIO_Init(SWD_SPI_MISO_GPIO_PORT, &GPIO_InitStructure);
 
@@ -82,123 +162,387 @@ static void initSPI(void) {
 
   initGPIO();
 
-  /* Set up SPI in bi-directional mode */
+  /* Set up SPI in bi-directional mode, SWD is sent LSB first */
   SPI_InitStructure.SPI_Direction = SPI_Direction_1Line_Tx;
   SPI_InitStructure.SPI_Mode = SPI_Mode_Master;
   SPI_InitStructure.SPI_DataSize = SPI_DataSize_8b;
   SPI_InitStructure.SPI_CPOL = SPI_CPOL_High;
   SPI_InitStructure.SPI_CPHA = SPI_CPHA_2Edge;
   SPI_InitStructure.SPI_NSS = SPI_NSS_Soft;
-  SPI_InitStructure.SPI_BaudRatePrescaler = SPI_BaudRatePrescaler_256;
+  SPI_InitStructure.SPI_BaudRatePrescaler = SWD_SPI_BAUDRATE_PRESCALER;
 
-  SPI_InitStructure.SPI_FirstBit = SPI_FirstBit_MSB;
+  SPI_InitStructure.SPI_FirstBit = SPI_FirstBit_LSB;
   SPI_InitStructure.SPI_CRCPolynomial = 7;
   SPI_Init(SWD_SPI, &SPI_InitStructure);
 
   SPI_Cmd(SWD_SPI, ENABLE);
 }
 
-//Initialize the green led pin as output
+static void initDMA(void) {
+  DMA_InitTypeDef DMA_InitStructure;
+
+  ASSERT_DMA_SAFE(txBuffer);
+  ASSERT_DMA_SAFE(rxBuffer);
+
+  RCC_AHB1PeriphClockCmd(SWD_DMA_CLK, ENABLE);
+
+  DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+  DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull;
+  DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)(&(SWD_SPI->DR));
+  DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+
+  DMA_InitStructure.DMA_Channel = SWD_TX_DMA_CHANNEL;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+  DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)txBuffer;
+  DMA_InitStructure.DMA_BufferSize = 0; // set later
+  DMA_Cmd(SWD_TX_DMA_STREAM, DISABLE);
+  DMA_Init(SWD_TX_DMA_STREAM, &DMA_InitStructure);
+
+  DMA_InitStructure.DMA_Channel = SWD_RX_DMA_CHANNEL;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+  DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)rxBuffer;
+  DMA_InitStructure.DMA_BufferSize = SWD_READ_BYTES;
+  DMA_Cmd(SWD_RX_DMA_STREAM, DISABLE);
+  DMA_Init(SWD_RX_DMA_STREAM, &DMA_InitStructure);
+}
+
 void swdInit()
 {
   if(isInit)
     return;
 
   initSPI();
+  initDMA();
 
   isInit = true;
 }
 
-/* Code for debugging and testing, should be removed later */
+bool swdTest(void) {
+  return isInit;
+}
 
-uint8_t tx_data[35];
-uint8_t rx_data[35];
+static void setLinePull(const uint32_t pull) {
+  // The pull-up makes the released line a one, the pull-down makes the clocks
+  // after a read idle cycles
+  const uint32_t shift = SWD_SPI_MISO_SOURCE * 2;
+  SWD_SPI_MISO_GPIO_PORT->PUPDR = (SWD_SPI_MISO_GPIO_PORT->PUPDR & ~(0x3 << shift)) | (pull << shift);
+}
 
-uint32_t counter = 0;
-uint16_t number_of_txd_bytes = 0;
-uint32_t transfer_size = 35;
+static uint8_t parity32(uint32_t value) {
+  value ^= value >> 16;
+  value ^= value >> 8;
+  value ^= value >> 4;
+  value ^= value >> 2;
+  value ^= value >> 1;
+  return value & 1;
+}
 
-uint8_t header = 0xA5;
-uint8_t idx = 0;
+static uint8_t request(const bool isAp, const bool isRead, const uint8_t reg) {
+  const uint8_t a23 = (reg >> 2) & 0x3;
+  const uint8_t parity = (isAp + isRead + (a23 & 1) + (a23 >> 1)) & 1;
 
-bool swdTest(void) {
-  // Start = 1
-  // DP access = 0
-  // Read access = 1
-  // DP reg = 00 (IDCODE)
-  // Parity = odd bits -> 1
-  // Stop = 0
-  // Park = 1 (not 0!)
-
-  // First at least fifty ones, then the sequence below to switch from JTAG to SWD and then at least 50 ones again.
-  // The the SWD is reset and ready to use. Note that once this is done the nRF will only go into simulated off mode since
-  // a debugger is connected.
-  // 111...01111001 11100111...111
-
-  // The command for reading IDCODE is
-  /// 10100101
-
-  // Should read out (and does):0x0BB11477 (according to OpenOCD)
-  //T ACK |------------DATA--------------|P
-  //? 100 111011100010100010001101110100001
-
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-#if 0
-  tx_data[idx++] = 0x9E;
-  tx_data[idx++] = 0xE7;
-#else
-  tx_data[idx++] = 0x79;
-  tx_data[idx++] = 0xE7;
-#endif
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFF;
-  tx_data[idx++] = 0xFC;
-  tx_data[idx++] = header;
-  // Rest is 0x00
-
-  /* As long as the SPI is enabled in bi-di mode the clock is enabled. So
-   * we write data as normal, but when reading there's no need to output any
-   * data to trigger the clock. Direction needs to be set accordingly.
-   */
-
-  while(number_of_txd_bytes < transfer_size)
-  {
-    if (number_of_txd_bytes < idx)
-    {
-      SPI_BiDirectionalLineConfig(SWD_SPI, SPI_Direction_Tx);
-
-      /*!< Loop while DR register in not emplty */
-      while (SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_TXE) == RESET);
-
-      SPI_I2S_SendData(SWD_SPI, tx_data[number_of_txd_bytes]);
-
-      // Make sure that we have sent data in case next loop will be RX, the
-      // mode is switched before we manage to send the data!
-      while (SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_BSY) == SET);
-    }
-    else
-    {
-      SPI_BiDirectionalLineConfig(SWD_SPI, SPI_Direction_Rx);
-      while (SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_RXNE) == RESET);
+  // Start, APnDP, RnW, A[3:2], parity, stop, park
+  return 0x01 | (isAp << 1) | (isRead << 2) | (a23 << 3) | (parity << 5) | 0x80;
+}
+
+// Sends the queued bit stream, the SPI is in TX mode when this returns
+static void sendStream(void) {
+  if (txLength == 0) {
+    return;
+  }
+
+  DMA_ClearFlag(SWD_TX_DMA_STREAM, SWD_TX_DMA_FLAGS);
+  DMA_SetCurrDataCounter(SWD_TX_DMA_STREAM, txLength);
+  SPI_I2S_DMACmd(SWD_SPI, SPI_I2S_DMAReq_Tx, ENABLE);
+  DMA_Cmd(SWD_TX_DMA_STREAM, ENABLE);
 
-      /*!< Return the byte read from the SPI bus */
-      rx_data[number_of_txd_bytes] = (uint8_t) SPI_I2S_ReceiveData(SWD_SPI);
+  const bool isLong = txLength >= SWD_TX_SLEEP_MIN_BYTES;
+  while (DMA_GetFlagStatus(SWD_TX_DMA_STREAM, SWD_TX_DMA_FLAG_TCIF) == RESET) {
+    if (isLong) {
+      vTaskDelay(1);
     }
-    number_of_txd_bytes++;
   }
+
+  // The last bytes are still in the SPI when the DMA is done
+  while (SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_TXE) == RESET);
+  while (SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_BSY) == SET);
+
+  SPI_I2S_DMACmd(SWD_SPI, SPI_I2S_DMAReq_Tx, DISABLE);
+  DMA_Cmd(SWD_TX_DMA_STREAM, DISABLE);
+  txLength = 0;
+}
+
+static void queueBytes(const uint8_t* data, const uint16_t length) {
+  if (txLength + length > SWD_TX_BUFFER_SIZE) {
+    sendStream();
+  }
+  memcpy(&txBuffer[txLength], data, length);
+  txLength += length;
+}
+
+static void queueWrite(const bool isAp, const uint8_t reg, const uint32_t value) {
+  // Request, turnaround + ACK + turnaround released (ones), data, parity and two idle cycles
+  const uint64_t bits = request(isAp, false, reg) | (0x1Full << 8) | ((uint64_t)value << 13) | ((uint64_t)parity32(value) << 45);
+
+  uint8_t stream[SWD_WRITE_BYTES];
+  for (int i = 0; i < SWD_WRITE_BYTES; i++) {
+    stream[i] = bits >> (8 * i);
+  }
+  queueBytes(stream, sizeof(stream));
+}
+
+// Sends the queued writes and the request, then receives the response. Returns the ACK.
+static uint8_t transferRead(const bool isAp, const uint8_t reg, uint32_t* value) {
+  const uint8_t header = request(isAp, true, reg);
+  queueBytes(&header, 1);
+  sendStream();
+
+  setLinePull(GPIO_PuPd_DOWN);
+  SPI_I2S_ReceiveData(SWD_SPI);
+  DMA_ClearFlag(SWD_RX_DMA_STREAM, SWD_RX_DMA_FLAGS);
+  DMA_SetCurrDataCounter(SWD_RX_DMA_STREAM, SWD_READ_BYTES);
+  DMA_Cmd(SWD_RX_DMA_STREAM, ENABLE);
+  SPI_I2S_DMACmd(SWD_SPI, SPI_I2S_DMAReq_Rx, ENABLE);
+
+  // The clock runs as long as the SPI is enabled in RX mode
+  SPI_BiDirectionalLineConfig(SWD_SPI, SPI_Direction_Rx);
+  while (DMA_GetFlagStatus(SWD_RX_DMA_STREAM, SWD_RX_DMA_FLAG_TCIF) == RESET);
   SPI_Cmd(SWD_SPI, DISABLE);
-  return isInit;
+
+  // Drop the byte received while stopping
+  for (int timeout = 1000; SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_RXNE) == RESET && timeout > 0; timeout--);
+  SPI_I2S_ReceiveData(SWD_SPI);
+  SPI_I2S_GetFlagStatus(SWD_SPI, SPI_I2S_FLAG_OVR);
+
+  SPI_I2S_DMACmd(SWD_SPI, SPI_I2S_DMAReq_Rx, DISABLE);
+  DMA_Cmd(SWD_RX_DMA_STREAM, DISABLE);
+  SPI_BiDirectionalLineConfig(SWD_SPI, SPI_Direction_Tx);
+  setLinePull(GPIO_PuPd_UP);
+  SPI_Cmd(SWD_SPI, ENABLE);
+
+  // Turnaround, ACK, data, parity
+  uint64_t bits = 0;
+  for (int i = 0; i < SWD_READ_BYTES; i++) {
+    bits |= (uint64_t)rxBuffer[i] << (8 * i);
+  }
+  const uint8_t ack = (bits >> 1) & 0x7;
+  const uint32_t data = bits >> 4;
+  const uint8_t parity = (bits >> 36) & 1;
+
+  if (ack == SWD_ACK_OK && parity != parity32(data)) {
+    return 0;
+  }
+
+  *value = data;
+  return ack;
+}
+
+// Writes after a WAIT or FAULT were dropped, the cached values may be wrong
+static void clearErrors(void) {
+  queueWrite(false, SWD_DP_ABORT, ABORT_ALLERRCLR);
+  sendStream();
+  selectCache = SELECT_INVALID;
+  isCswValid = false;
+}
+
+static bool readRegister(const bool isAp, const uint8_t reg, uint32_t* value) {
+  uint8_t ack = SWD_ACK_WAIT;
+  for (int retries = 0; ack == SWD_ACK_WAIT && retries < SWD_WAIT_RETRIES; retries++) {
+    ack = transferRead(isAp, reg, value);
+    if (ack == SWD_ACK_WAIT) {
+      // The read was not done, the overrun flag is set since overrun detection is enabled
+      queueWrite(false, SWD_DP_ABORT, ABORT_ORUNERRCLR);
+    }
+  }
+
+  if (ack != SWD_ACK_OK) {
+    clearErrors();
+    return false;
+  }
+
+  return true;
+}
+
+static void selectBank(const uint8_t ap, const uint8_t reg) {
+  const uint32_t value = ((uint32_t)ap << 24) | (reg & 0xF0);
+  if (value != selectCache) {
+    queueWrite(false, SWD_DP_SELECT, value);
+    selectCache = value;
+  }
+}
+
+bool swdConnect(uint32_t* idcode) {
+  // Line reset, JTAG to SWD sequence, line reset and idle cycles
+  static const uint8_t connect[] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x9E, 0xE7,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00,
+  };
+
+  txLength = 0;
+  selectCache = SELECT_INVALID;
+  isCswValid = false;
+  queueBytes(connect, sizeof(connect));
+
+  if (!readRegister(false, SWD_DP_IDCODE, idcode)) {
+    return false;
+  }
+
+  queueWrite(false, SWD_DP_ABORT, ABORT_ALLERRCLR);
+  selectBank(0, 0);
+  queueWrite(false, SWD_DP_CTRLSTAT, CTRLSTAT_CSYSPWRUPREQ | CTRLSTAT_CDBGPWRUPREQ | CTRLSTAT_ORUNDETECT);
+
+  const uint32_t powerUpAck = CTRLSTAT_CSYSPWRUPACK | CTRLSTAT_CDBGPWRUPACK;
+  uint32_t ctrlStat = 0;
+  for (int i = 0; i < 100; i++) {
+    if (!readRegister(false, SWD_DP_CTRLSTAT, &ctrlStat)) {
+      return false;
+    }
+    if ((ctrlStat & powerUpAck) == powerUpAck) {
+      return true;
+    }
+    vTaskDelay(1);
+  }
+
+  return false;
+}
+
+bool swdDpRead(const uint8_t reg, uint32_t* value) {
+  if (reg == SWD_DP_CTRLSTAT) {
+    selectBank(0, 0);
+  }
+  return readRegister(false, reg, value);
+}
+
+bool swdDpWrite(const uint8_t reg, const uint32_t value) {
+  if (reg == SWD_DP_SELECT) {
+    selectCache = value;
+  }
+  queueWrite(false, reg, value);
+  return true;
+}
+
+bool swdApRead(const uint8_t ap, const uint8_t reg, uint32_t* value) {
+  selectBank(ap, reg);
+
+  // The AP read returns the result of the previous AP read
+  uint32_t previous;
+  return readRegister(true, reg, &previous) && readRegister(false, SWD_DP_RDBUFF, value);
+}
+
+bool swdApWrite(const uint8_t ap, const uint8_t reg, const uint32_t value) {
+  selectBank(ap, reg);
+  queueWrite(true, reg, value);
+  return true;
+}
+
+bool swdFlush(void) {
+  uint32_t ctrlStat;
+  selectBank(0, 0);
+  if (!readRegister(false, SWD_DP_CTRLSTAT, &ctrlStat)) {
+    return false;
+  }
+
+  if (ctrlStat & CTRLSTAT_ERRORS) {
+    clearErrors();
+    return false;
+  }
+
+  return true;
+}
+
+static bool setupMemAp(void) {
+  if (!isCswValid) {
+    uint32_t csw;
+    if (!swdApRead(MEM_AP, SWD_AP_CSW, &csw)) {
+      return false;
+    }
+    cswCache = (csw & ~CSW_SIZE_ADDRINC_MASK) | CSW_SIZE32_ADDRINC_SINGLE;
+    swdApWrite(MEM_AP, SWD_AP_CSW, cswCache);
+    isCswValid = true;
+  }
+
+  return true;
 }
 
+// Number of words from the address to the end of the TAR auto-increment block
+static uint32_t wordsInBlock(const uint32_t address, const uint32_t words) {
+  const uint32_t left = (TAR_AUTOINC_BLOCK - (address % TAR_AUTOINC_BLOCK)) / 4;
+  return words < left ? words : left;
+}
+
+bool swdMemRead(const uint32_t address, uint32_t* data, const uint32_t words) {
+  if (!setupMemAp()) {
+    return false;
+  }
+
+  uint32_t done = 0;
+  while (done < words) {
+    const uint32_t count = wordsInBlock(address + done * 4, words - done);
+    swdApWrite(MEM_AP, SWD_AP_TAR, address + done * 4);
+    selectBank(MEM_AP, SWD_AP_DRW);
+
+    // Each DRW read returns the word of the previous one, the last is in RDBUFF
+    uint32_t previous;
+    if (!readRegister(true, SWD_AP_DRW, &previous)) {
+      return false;
+    }
+    for (uint32_t i = 1; i < count; i++) {
+      if (!readRegister(true, SWD_AP_DRW, &data[done + i - 1])) {
+        return false;
+      }
+    }
+    if (!readRegister(false, SWD_DP_RDBUFF, &data[done + count - 1])) {
+      return false;
+    }
+
+    done += count;
+  }
+
+  return true;
+}
+
+static void queueMemWrite(const uint32_t address, const uint32_t* data, const uint32_t words) {
+  uint32_t done = 0;
+  while (done < words) {
+    const uint32_t count = wordsInBlock(address + done * 4, words - done);
+    swdApWrite(MEM_AP, SWD_AP_TAR, address + done * 4);
+    selectBank(MEM_AP, SWD_AP_DRW);
+    for (uint32_t i = 0; i < count; i++) {
+      queueWrite(true, SWD_AP_DRW, data[done + i]);
+    }
+    done += count;
+  }
+}
+
+bool swdMemWrite(const uint32_t address, const uint32_t* data, const uint32_t words) {
+  if (!setupMemAp()) {
+    return false;
+  }
+
+  queueMemWrite(address, data, words);
+  if (swdFlush()) {
+    return true;
+  }
+
+  // The target answered WAIT to some of the writes, write one word at a time
+  if (!setupMemAp()) {
+    return false;
+  }
+  for (uint32_t i = 0; i < words; i++) {
+    queueMemWrite(address + i * 4, &data[i], 1);
+    if (!swdFlush()) {
+      return false;
+    }
+  }
+
+  return true;
+}
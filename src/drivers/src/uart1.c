@@ -54,6 +54,14 @@ STATIC_MEM_QUEUE_ALLOC(uart1queue, 64, sizeof(uint8_t));
 static bool isInit = false;
 static bool hasOverrun = false;
 
+// Receive with circular DMA, the reader takes the data straight from the buffer
+#define UART1_RX_DMA_BUFFER_SIZE 512
+static uint8_t rxDmaBuffer[UART1_RX_DMA_BUFFER_SIZE];
+static uint16_t rxDmaReadIndex;
+static bool isRxDmaEnabled = false;
+static xSemaphoreHandle rxDataAvailable;
+static StaticSemaphore_t rxDataAvailableBuffer;
+
 #ifdef ENABLE_UART1_DMA
 static xSemaphoreHandle uartBusy;
 static StaticSemaphore_t uartBusyBuffer;
@@ -82,6 +90,7 @@ static void uart1DmaInit(void)
   RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
 
   // USART TX DMA Channel Config
+  ASSERT_DMA_SAFE(dmaBuffer);
   DMA_InitStructureShare.DMA_PeripheralBaseAddr = (uint32_t)&UART1_TYPE->DR;
   DMA_InitStructureShare.DMA_Memory0BaseAddr = (uint32_t)dmaBuffer;
   DMA_InitStructureShare.DMA_MemoryInc = DMA_MemoryInc_Enable;
@@ -186,9 +195,117 @@ bool uart1Test(void)
   return isInit;
 }
 
+void uart1InitRxDma(void)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+  NVIC_InitTypeDef NVIC_InitStructure;
+
+  rxDataAvailable = xSemaphoreCreateBinaryStatic(&rxDataAvailableBuffer);
+
+  USART_ITConfig(UART1_TYPE, USART_IT_RXNE, DISABLE);
+
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+
+  ASSERT_DMA_SAFE(rxDmaBuffer);
+  DMA_DeInit(UART1_RX_DMA_STREAM);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&UART1_TYPE->DR;
+  DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)rxDmaBuffer;
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_BufferSize = UART1_RX_DMA_BUFFER_SIZE;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+  DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+  DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull;
+  DMA_InitStructure.DMA_Channel = UART1_RX_DMA_CH;
+  DMA_Init(UART1_RX_DMA_STREAM, &DMA_InitStructure);
+
+  NVIC_InitStructure.NVIC_IRQChannel = UART1_RX_DMA_IRQ;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_MID_PRI;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init(&NVIC_InitStructure);
+
+  rxDmaReadIndex = 0;
+  isRxDmaEnabled = true;
+
+  // Wake up the reader at half and full buffer, and when the line goes idle
+  DMA_ITConfig(UART1_RX_DMA_STREAM, DMA_IT_HT | DMA_IT_TC, ENABLE);
+  USART_DMACmd(UART1_TYPE, USART_DMAReq_Rx, ENABLE);
+  DMA_Cmd(UART1_RX_DMA_STREAM, ENABLE);
+  USART_ITConfig(UART1_TYPE, USART_IT_IDLE, ENABLE);
+}
+
+static uint16_t rxDmaWriteIndex(void)
+{
+  uint16_t writeIndex = UART1_RX_DMA_BUFFER_SIZE - DMA_GetCurrDataCounter(UART1_RX_DMA_STREAM);
+  if (writeIndex == UART1_RX_DMA_BUFFER_SIZE)
+  {
+    writeIndex = 0;
+  }
+  return writeIndex;
+}
+
+uint32_t uart1GetBytesWithTimeout(uint8_t *data, const uint32_t maxLength, const uint32_t timeoutTicks)
+{
+  uint32_t length = 0;
+
+  if (!isRxDmaEnabled)
+  {
+    // One queue item per byte, wait for the first one only
+    if (maxLength > 0 && xQueueReceive(uart1queue, &data[0], timeoutTicks) == pdTRUE)
+    {
+      length = 1;
+      while (length < maxLength && xQueueReceive(uart1queue, &data[length], 0) == pdTRUE)
+      {
+        length++;
+      }
+    }
+    return length;
+  }
+
+  uint16_t writeIndex = rxDmaWriteIndex();
+  while (writeIndex == rxDmaReadIndex)
+  {
+    if (xSemaphoreTake(rxDataAvailable, timeoutTicks) != pdTRUE)
+    {
+      return 0;
+    }
+    writeIndex = rxDmaWriteIndex();
+  }
+
+  while (length < maxLength && rxDmaReadIndex != writeIndex)
+  {
+    // Copy up to the end of the buffer or the write position
+    uint16_t end = (writeIndex > rxDmaReadIndex) ? writeIndex : UART1_RX_DMA_BUFFER_SIZE;
+    uint32_t count = end - rxDmaReadIndex;
+    if (count > maxLength - length)
+    {
+      count = maxLength - length;
+    }
+    memcpy(&data[length], &rxDmaBuffer[rxDmaReadIndex], count);
+    length += count;
+    rxDmaReadIndex = (rxDmaReadIndex + count) % UART1_RX_DMA_BUFFER_SIZE;
+  }
+
+  return length;
+}
+
 bool uart1GetDataWithTimeout(uint8_t *c, const uint32_t timeoutTicks)
 {
-  if (xQueueReceive(uart1queue, c, timeoutTicks) == pdTRUE)
+  if (isRxDmaEnabled)
+  {
+    if (uart1GetBytesWithTimeout(c, 1, timeoutTicks) == 1)
+    {
+      return true;
+    }
+  }
+  else if (xQueueReceive(uart1queue, c, timeoutTicks) == pdTRUE)
   {
     return true;
   }
@@ -253,7 +370,14 @@ int uart1Putchar(int ch)
 
 void uart1Getchar(char * ch)
 {
-  xQueueReceive(uart1queue, ch, portMAX_DELAY);
+  if (isRxDmaEnabled)
+  {
+    uart1GetBytesWithTimeout((uint8_t*)ch, 1, portMAX_DELAY);
+  }
+  else
+  {
+    xQueueReceive(uart1queue, ch, portMAX_DELAY);
+  }
 }
 
 bool uart1DidOverrun()
@@ -279,12 +403,29 @@ void __attribute__((used)) DMA1_Stream3_IRQHandler(void)
 }
 #endif
 
+void __attribute__((used)) DMA1_Stream1_IRQHandler(void)
+{
+  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+  DMA_ClearITPendingBit(UART1_RX_DMA_STREAM, UART1_RX_DMA_IT_HTIF | UART1_RX_DMA_IT_TCIF);
+  xSemaphoreGiveFromISR(rxDataAvailable, &xHigherPriorityTaskWoken);
+
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 void __attribute__((used)) USART3_IRQHandler(void)
 {
   uint8_t rxData;
   portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
-  if (USART_GetITStatus(UART1_TYPE, USART_IT_RXNE))
+  if (isRxDmaEnabled && (UART1_TYPE->SR & USART_FLAG_IDLE))
+  {
+    // The flag is cleared by reading SR followed by DR, the line is idle so
+    // there is no data in DR for the DMA to miss
+    asm volatile ("" : "=m" (UART1_TYPE->DR) : "r" (UART1_TYPE->DR));
+    xSemaphoreGiveFromISR(rxDataAvailable, &xHigherPriorityTaskWoken);
+  }
+  else if (USART_GetITStatus(UART1_TYPE, USART_IT_RXNE))
   {
     rxData = USART_ReceiveData(UART1_TYPE) & 0x00FF;
     xQueueSendFromISR(uart1queue, &rxData, &xHigherPriorityTaskWoken);
@@ -88,6 +88,7 @@ static void uart2DmaInit(void)
   RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
 
   // USART TX DMA Channel Config
+  ASSERT_DMA_SAFE(dmaBuffer);
   DMA_InitStructureShare.DMA_PeripheralBaseAddr = (uint32_t)&UART2_TYPE->DR;
   DMA_InitStructureShare.DMA_Memory0BaseAddr = (uint32_t)dmaBuffer;
   DMA_InitStructureShare.DMA_MemoryInc = DMA_MemoryInc_Enable;
@@ -43,11 +43,18 @@
 #include "config.h"
 #include "queuemonitor.h"
 #include "static_mem.h"
+#include "isr_profiler.h"
 
 
 #define UARTSLK_DATA_TIMEOUT_MS 1000
 #define UARTSLK_DATA_TIMEOUT_TICKS (UARTSLK_DATA_TIMEOUT_MS / portTICK_RATE_MS)
 #define CCR_ENABLE_SET  ((uint32_t)0x00000001)
+// Received bytes are written to a circular buffer by DMA and parsed when the
+// line goes idle or the buffer is half full, instead of one interrupt per byte
+#define UARTSLK_RX_DMA_BUFFER_SIZE 256
+// Frames to send are queued in a ring and sent back to back, a DMA transfer
+// covers all the data queued up to the end of the ring
+#define UARTSLK_TX_RING_SIZE 512
 
 static bool isInit = false;
 
@@ -58,7 +65,13 @@ static StaticSemaphore_t uartBusyBuffer;
 static xQueueHandle syslinkPacketDelivery;
 STATIC_MEM_QUEUE_ALLOC(syslinkPacketDelivery, 8, sizeof(SyslinkPacket));
 
-static uint8_t dmaBuffer[64];
+static xSemaphoreHandle txSpace;
+static StaticSemaphore_t txSpaceBuffer;
+static uint8_t txRing[UARTSLK_TX_RING_SIZE];
+static volatile uint16_t txHead;
+static volatile uint16_t txTail;
+static uint16_t txDmaLength;
+static volatile bool txDmaActive;
 static uint8_t *outDataIsr;
 static uint8_t dataIndexIsr;
 static uint8_t dataSizeIsr;
@@ -68,12 +81,17 @@ static uint32_t initialDMACount;
 static uint32_t remainingDMACount;
 static bool     dmaIsPaused;
 
+static uint8_t rxDmaBuffer[UARTSLK_RX_DMA_BUFFER_SIZE];
+static uint16_t rxDmaReadIndex;
+
 static volatile SyslinkPacket slp = {0};
 static volatile SyslinkRxState rxState = waitForFirstStart;
 static volatile uint8_t dataIndex = 0;
 static volatile uint8_t cksum[2] = {0};
 static void uartslkHandleDataFromISR(uint8_t c, BaseType_t * const pxHigherPriorityTaskWoken);
 
+static void uartslkHandleRxDmaFromISR(BaseType_t * const pxHigherPriorityTaskWoken);
+
 static void uartslkPauseDma();
 static void uartslkResumeDma();
 
@@ -88,8 +106,9 @@ void uartslkDmaInit(void)
   RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
 
   // USART TX DMA Channel Config
+  ASSERT_DMA_SAFE(txRing);
   DMA_InitStructureShare.DMA_PeripheralBaseAddr = (uint32_t)&UARTSLK_TYPE->DR;
-  DMA_InitStructureShare.DMA_Memory0BaseAddr = (uint32_t)dmaBuffer;
+  DMA_InitStructureShare.DMA_Memory0BaseAddr = (uint32_t)txRing;
   DMA_InitStructureShare.DMA_MemoryInc = DMA_MemoryInc_Enable;
   DMA_InitStructureShare.DMA_MemoryBurst = DMA_MemoryBurst_Single;
   DMA_InitStructureShare.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
@@ -113,15 +132,56 @@ void uartslkDmaInit(void)
   isUartDmaInitialized = true;
 }
 
+static void uartslkRxDmaInit(void)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+  NVIC_InitTypeDef NVIC_InitStructure;
+
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+
+  ASSERT_DMA_SAFE(rxDmaBuffer);
+  DMA_DeInit(UARTSLK_RX_DMA_STREAM);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&UARTSLK_TYPE->DR;
+  DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)rxDmaBuffer;
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_BufferSize = UARTSLK_RX_DMA_BUFFER_SIZE;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+  DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull;
+  DMA_InitStructure.DMA_Channel = UARTSLK_RX_DMA_CH;
+  DMA_Init(UARTSLK_RX_DMA_STREAM, &DMA_InitStructure);
+
+  // Same priority as the UART interrupt, the two never preempt each other
+  NVIC_InitStructure.NVIC_IRQChannel = UARTSLK_RX_DMA_IRQ;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_SYSLINK_PRI;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init(&NVIC_InitStructure);
+
+  rxDmaReadIndex = 0;
+  DMA_ITConfig(UARTSLK_RX_DMA_STREAM, DMA_IT_HT | DMA_IT_TC, ENABLE);
+  USART_DMACmd(UARTSLK_TYPE, USART_DMAReq_Rx, ENABLE);
+  DMA_Cmd(UARTSLK_RX_DMA_STREAM, ENABLE);
+}
+
 void uartslkInit(void)
 {
   // initialize the FreeRTOS structures first, to prevent null pointers in interrupts
   waitUntilSendDone = xSemaphoreCreateBinaryStatic(&waitUntilSendDoneBuffer); // initialized as blocking
   uartBusy = xSemaphoreCreateBinaryStatic(&uartBusyBuffer); // initialized as blocking
   xSemaphoreGive(uartBusy); // but we give it because the uart isn't busy at initialization
+  txSpace = xSemaphoreCreateBinaryStatic(&txSpaceBuffer);
 
   syslinkPacketDelivery = STATIC_MEM_QUEUE_CREATE(syslinkPacketDelivery);
   DEBUG_QUEUE_MONITOR_REGISTER(syslinkPacketDelivery);
+  queueMonitorAddQueue(syslinkPacketDelivery, queueMonitorSyslink);
 
   USART_InitTypeDef USART_InitStructure;
   GPIO_InitTypeDef GPIO_InitStructure;
@@ -163,15 +223,16 @@ void uartslkInit(void)
   USART_Init(UARTSLK_TYPE, &USART_InitStructure);
 
   uartslkDmaInit();
+  uartslkRxDmaInit();
 
-  // Configure Rx buffer not empty interrupt
+  // Configure idle line interrupt, received data is moved by DMA
   NVIC_InitStructure.NVIC_IRQChannel = UARTSLK_IRQ;
   NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_SYSLINK_PRI;
   NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
 
-  USART_ITConfig(UARTSLK_TYPE, USART_IT_RXNE, ENABLE);
+  USART_ITConfig(UARTSLK_TYPE, USART_IT_IDLE, ENABLE);
 
   //Setting up TXEN pin (NRF flow control)
   RCC_AHB1PeriphClockCmd(UARTSLK_TXEN_PERIF, ENABLE);
@@ -243,29 +304,89 @@ int uartslkPutchar(int ch)
     return (unsigned char)ch;
 }
 
+/* Starts a transfer of the queued data, up to the end of the ring. Called
+ * with the DMA interrupt masked or from the DMA interrupt. */
+static void uartslkStartTxDma(void)
+{
+  if (txHead == txTail)
+  {
+    txDmaActive = false;
+    return;
+  }
+
+  const uint16_t end = (txHead > txTail) ? txHead : UARTSLK_TX_RING_SIZE;
+  txDmaLength = end - txTail;
+
+  DMA_InitStructureShare.DMA_Memory0BaseAddr = (uint32_t)&txRing[txTail];
+  DMA_InitStructureShare.DMA_BufferSize = txDmaLength;
+  initialDMACount = txDmaLength;
+  // Init new DMA stream
+  DMA_Init(UARTSLK_DMA_STREAM, &DMA_InitStructureShare);
+  // Enable the Transfer Complete interrupt
+  DMA_ITConfig(UARTSLK_DMA_STREAM, DMA_IT_TC, ENABLE);
+  /* Enable USART DMA TX Requests */
+  USART_DMACmd(UARTSLK_TYPE, USART_DMAReq_Tx, ENABLE);
+  /* Clear transfer complete */
+  USART_ClearFlag(UARTSLK_TYPE, USART_FLAG_TC);
+  /* Enable DMA USART TX Stream */
+  DMA_Cmd(UARTSLK_DMA_STREAM, ENABLE);
+  txDmaActive = true;
+}
+
+static uint32_t uartslkTxRingFree(void)
+{
+  return (txTail + UARTSLK_TX_RING_SIZE - txHead - 1) % UARTSLK_TX_RING_SIZE;
+}
+
+bool uartslkEnqueueDataDma(uint32_t size, const uint8_t* data, uint32_t wait)
+{
+  if (!isUartDmaInitialized || size >= UARTSLK_TX_RING_SIZE)
+  {
+    return false;
+  }
+
+  xSemaphoreTake(uartBusy, portMAX_DELAY);
+
+  // The DMA interrupt gives txSpace every time a transfer is done
+  while (uartslkTxRingFree() < size)
+  {
+    if (xSemaphoreTake(txSpace, wait) != pdTRUE)
+    {
+      xSemaphoreGive(uartBusy);
+      return false;
+    }
+  }
+
+  const uint16_t head = txHead;
+  uint32_t first = UARTSLK_TX_RING_SIZE - head;
+  if (first > size)
+  {
+    first = size;
+  }
+  memcpy(&txRing[head], data, first);
+  memcpy(&txRing[0], &data[first], size - first);
+
+  taskENTER_CRITICAL();
+  txHead = (head + size) % UARTSLK_TX_RING_SIZE;
+  if (!txDmaActive)
+  {
+    uartslkStartTxDma();
+  }
+  taskEXIT_CRITICAL();
+
+  xSemaphoreGive(uartBusy);
+
+  return true;
+}
+
 void uartslkSendDataDmaBlocking(uint32_t size, uint8_t* data)
 {
-  if (isUartDmaInitialized)
+  if (uartslkEnqueueDataDma(size, data, portMAX_DELAY))
   {
-    xSemaphoreTake(uartBusy, portMAX_DELAY);
-    // Wait for DMA to be free
-    while(DMA_GetCmdStatus(UARTSLK_DMA_STREAM) != DISABLE);
-    //Copy data in DMA buffer
-    memcpy(dmaBuffer, data, size);
-    DMA_InitStructureShare.DMA_BufferSize = size;
-    initialDMACount = size;
-    // Init new DMA stream
-    DMA_Init(UARTSLK_DMA_STREAM, &DMA_InitStructureShare);
-    // Enable the Transfer Complete interrupt
-    DMA_ITConfig(UARTSLK_DMA_STREAM, DMA_IT_TC, ENABLE);
-    /* Enable USART DMA TX Requests */
-    USART_DMACmd(UARTSLK_TYPE, USART_DMAReq_Tx, ENABLE);
-    /* Clear transfer complete */
-    USART_ClearFlag(UARTSLK_TYPE, USART_FLAG_TC);
-    /* Enable DMA USART TX Stream */
-    DMA_Cmd(UARTSLK_DMA_STREAM, ENABLE);
-    xSemaphoreTake(waitUntilSendDone, portMAX_DELAY);
-    xSemaphoreGive(uartBusy);
+    while (txDmaActive)
+    {
+      xSemaphoreTake(waitUntilSendDone, M2T(1));
+    }
   }
 }
 
@@ -294,7 +415,7 @@ static void uartslkResumeDma()
     // Update DMA counter
     DMA_SetCurrDataCounter(UARTSLK_DMA_STREAM, remainingDMACount);
     // Update memory read address
-    UARTSLK_DMA_STREAM->M0AR = (uint32_t)&dmaBuffer[initialDMACount - remainingDMACount];
+    UARTSLK_DMA_STREAM->M0AR = (uint32_t)&txRing[txTail + initialDMACount - remainingDMACount];
     // Enable the Transfer Complete interrupt
     DMA_ITConfig(UARTSLK_DMA_STREAM, DMA_IT_TC, ENABLE);
     /* Clear transfer complete */
@@ -316,7 +437,16 @@ void uartslkDmaIsr(void)
   DMA_Cmd(UARTSLK_DMA_STREAM, DISABLE);
 
   remainingDMACount = 0;
-  xSemaphoreGiveFromISR(waitUntilSendDone, &xHigherPriorityTaskWoken);
+  txTail = (txTail + txDmaLength) % UARTSLK_TX_RING_SIZE;
+  uartslkStartTxDma();
+
+  xSemaphoreGiveFromISR(txSpace, &xHigherPriorityTaskWoken);
+  if (!txDmaActive)
+  {
+    xSemaphoreGiveFromISR(waitUntilSendDone, &xHigherPriorityTaskWoken);
+  }
+
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
 void uartslkHandleDataFromISR(uint8_t c, BaseType_t * const pxHigherPriorityTaskWoken)
@@ -396,18 +526,42 @@ void uartslkHandleDataFromISR(uint8_t c, BaseType_t * const pxHigherPriorityTask
   }
 }
 
+/* Parses the bytes the DMA has written since the last call */
+static void uartslkHandleRxDmaFromISR(BaseType_t * const pxHigherPriorityTaskWoken)
+{
+  uint16_t writeIndex = UARTSLK_RX_DMA_BUFFER_SIZE - DMA_GetCurrDataCounter(UARTSLK_RX_DMA_STREAM);
+  if (writeIndex == UARTSLK_RX_DMA_BUFFER_SIZE)
+  {
+    writeIndex = 0;
+  }
+
+  while (rxDmaReadIndex != writeIndex)
+  {
+    uartslkHandleDataFromISR(rxDmaBuffer[rxDmaReadIndex], pxHigherPriorityTaskWoken);
+    rxDmaReadIndex = (rxDmaReadIndex + 1) % UARTSLK_RX_DMA_BUFFER_SIZE;
+  }
+}
+
+void uartslkRxDmaIsr(void)
+{
+  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+  DMA_ClearITPendingBit(UARTSLK_RX_DMA_STREAM, UARTSLK_RX_DMA_IT_HTIF | UARTSLK_RX_DMA_IT_TCIF);
+  uartslkHandleRxDmaFromISR(&xHigherPriorityTaskWoken);
+
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 void uartslkIsr(void)
 {
   portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
-  // the following if statement replaces:
-  //   if (USART_GetITStatus(UARTSLK_TYPE, USART_IT_RXNE) == SET)
-  // we do this check as fast as possible to minimize the chance of an overrun,
-  // which occasionally cause problems and cause packet loss at high CPU usage
-  if ((UARTSLK_TYPE->SR & (1<<5)) != 0) // if the RXNE interrupt has occurred
+  if ((UARTSLK_TYPE->SR & USART_FLAG_IDLE) != 0)
   {
-    uint8_t rxDataInterrupt = (uint8_t)(UARTSLK_TYPE->DR & 0xFF);
-    uartslkHandleDataFromISR(rxDataInterrupt, &xHigherPriorityTaskWoken);
+    // The flag is cleared by reading SR followed by DR, the line is idle so
+    // there is no data in DR for the DMA to miss
+    asm volatile ("" : "=m" (UARTSLK_TYPE->DR) : "r" (UARTSLK_TYPE->DR));
+    uartslkHandleRxDmaFromISR(&xHigherPriorityTaskWoken);
   }
   else if (USART_GetITStatus(UARTSLK_TYPE, USART_IT_TXE) == SET)
   {
@@ -458,10 +612,21 @@ void __attribute__((used)) EXTI4_Callback(void)
 
 void __attribute__((used)) USART6_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerUsart6);
   uartslkIsr();
+  ISR_PROFILER_EXIT(isrProfilerUsart6);
 }
 
 void __attribute__((used)) DMA2_Stream7_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerDma2Stream7);
   uartslkDmaIsr();
+  ISR_PROFILER_EXIT(isrProfilerDma2Stream7);
+}
+
+void __attribute__((used)) DMA2_Stream1_IRQHandler(void)
+{
+  ISR_PROFILER_ENTER(isrProfilerDma2Stream1);
+  uartslkRxDmaIsr();
+  ISR_PROFILER_EXIT(isrProfilerDma2Stream1);
 }
@@ -34,6 +34,9 @@
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "isr_profiler.h"
+#include "cfassert.h"
+#include "ws2812.h"
 
 //#define TIM1_CCR1_Address 0x40012C34	// physical memory address of Timer 3 CCR1 register
 
@@ -45,22 +48,32 @@ static NVIC_InitTypeDef NVIC_InitStructure;
 
 static xSemaphoreHandle allLedDone = NULL;
 
-// The minimum is to have 2 leds (1 per half buffer) in the buffer, this
-// consume 42Bytes and will trigger the DMA interrupt at ~2KHz.
-// Putting 2 there will divide by 2 the interrupt frequency but will also
-// double the memory consumption (no free lunch ;-)
-#define LED_PER_HALF 1
-
 #define TIMING_ONE  75
 #define TIMING_ZERO 29
 
-static union {
-    uint16_t buffer[2*LED_PER_HALF*24];
-    struct {
-      uint16_t begin[LED_PER_HALF*24];
-      uint16_t end[LED_PER_HALF*24];
-    } __attribute__((packed));
-} led_dma;
+// The line is kept low for this many LED slots after the data, to latch the colors
+#define RESET_LEDS 2
+
+#define BITS_PER_LED 24
+#define FRAME_LENGTH ((WS2812_MAX_LEDS + RESET_LEDS) * BITS_PER_LED)
+
+// PWM compare values of the 8 bits of a byte, msb first
+#define BIT_TIMING(BYTE, BIT) ((((BYTE) >> (7 - (BIT))) & 1) ? TIMING_ONE : TIMING_ZERO)
+#define BYTE_TIMING(B) {BIT_TIMING(B, 0), BIT_TIMING(B, 1), BIT_TIMING(B, 2), BIT_TIMING(B, 3), \
+                        BIT_TIMING(B, 4), BIT_TIMING(B, 5), BIT_TIMING(B, 6), BIT_TIMING(B, 7)}
+#define BYTE_TIMING4(B) BYTE_TIMING(B), BYTE_TIMING(B + 1), BYTE_TIMING(B + 2), BYTE_TIMING(B + 3)
+#define BYTE_TIMING16(B) BYTE_TIMING4(B), BYTE_TIMING4(B + 4), BYTE_TIMING4(B + 8), BYTE_TIMING4(B + 12)
+#define BYTE_TIMING64(B) BYTE_TIMING16(B), BYTE_TIMING16(B + 16), BYTE_TIMING16(B + 32), BYTE_TIMING16(B + 48)
+static const uint16_t byteTiming[256][8] = {
+  BYTE_TIMING64(0), BYTE_TIMING64(64), BYTE_TIMING64(128), BYTE_TIMING64(192),
+};
+
+// The frames are encoded in one buffer while the other is sent, each frame is
+// sent with one DMA transfer
+static uint16_t frames[2][FRAME_LENGTH];
+static uint8_t backFrame;
+static uint8_t sentColors[WS2812_MAX_LEDS][3];
+static uint16_t sentLength;
 
 void ws2812Init(void)
 {
@@ -113,10 +126,11 @@ void ws2812Init(void)
 	/* DMA1 Channel5 Config TM */
 	DMA_DeInit(DMA1_Stream5);
 
-	ASSERT_DMA_SAFE(led_dma.buffer);
+	ASSERT_DMA_SAFE(frames[0]);
+	ASSERT_DMA_SAFE(frames[1]);
   // USART TX DMA Channel Config
   DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&TIM3->CCR2;
-  DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)led_dma.buffer;    // this is the buffer memory
+  DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)frames[0];    // this is the buffer memory
   DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
   DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
   DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
@@ -125,7 +139,7 @@ void ws2812Init(void)
   DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
   DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
   DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
-  DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
   DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
   DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
   DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull ;
@@ -141,7 +155,6 @@ void ws2812Init(void)
   vSemaphoreCreateBinary(allLedDone);
 
   DMA_ITConfig(DMA1_Stream5, DMA_IT_TC, ENABLE);
-  DMA_ITConfig(DMA1_Stream5, DMA_IT_HT, ENABLE);
 
 	/* TIM3 CC2 DMA Request enable */
 	TIM_DMACmd(TIM3, TIM_DMA_CC2, ENABLE);
@@ -149,104 +162,77 @@ void ws2812Init(void)
 
 }
 
-static void fillLed(uint16_t *buffer, uint8_t *color)
+static void encodeFrame(uint16_t *frame, uint8_t (*color)[3], uint16_t len)
 {
-    int i;
-
-    for(i=0; i<8; i++) // GREEN data
-	{
-	    buffer[i] = ((color[1]<<i) & 0x0080) ? TIMING_ONE:TIMING_ZERO;
-	}
-	for(i=0; i<8; i++) // RED
-	{
-	    buffer[8+i] = ((color[0]<<i) & 0x0080) ? TIMING_ONE:TIMING_ZERO;
-	}
-	for(i=0; i<8; i++) // BLUE
-	{
-	    buffer[16+i] = ((color[2]<<i) & 0x0080) ? TIMING_ONE:TIMING_ZERO;
-	}
-}
+  uint16_t *bits = frame;
 
-static int current_led = 0;
-static int total_led = 0;
-static uint8_t (*color_led)[3] = NULL;
+  for (int i = 0; i < len; i++) {
+    // The LEDs take the colors in green, red, blue order
+    memcpy(bits, byteTiming[color[i][1]], sizeof(byteTiming[0]));
+    memcpy(bits + 8, byteTiming[color[i][0]], sizeof(byteTiming[0]));
+    memcpy(bits + 16, byteTiming[color[i][2]], sizeof(byteTiming[0]));
+    bits += BITS_PER_LED;
+  }
+
+  memset(bits, 0, RESET_LEDS * BITS_PER_LED * sizeof(uint16_t));
+}
 
 void ws2812Send(uint8_t (*color)[3], uint16_t len)
 {
-    int i;
-	if(len<1) return;
-
-	//Wait for previous transfer to be finished
-	xSemaphoreTake(allLedDone, portMAX_DELAY);
-
-	// Set interrupt context ...
-	current_led = 0;
-	total_led = len;
-	color_led = color;
-
-    for(i=0; (i<LED_PER_HALF) && (current_led<total_led+2); i++, current_led++) {
-        if (current_led<total_led)
-            fillLed(led_dma.begin+(24*i), color_led[current_led]);
-        else
-            bzero(led_dma.begin+(24*i), sizeof(led_dma.begin));
-    }
-
-    for(i=0; (i<LED_PER_HALF) && (current_led<total_led+2); i++, current_led++) {
-        if (current_led<total_led)
-            fillLed(led_dma.end+(24*i), color_led[current_led]);
-        else
-            bzero(led_dma.end+(24*i), sizeof(led_dma.end));
-    }
-
-	DMA1_Stream5->NDTR = sizeof(led_dma.buffer) / sizeof(led_dma.buffer[0]); // load number of bytes to be transferred
-	DMA_Cmd(DMA1_Stream5, ENABLE); 			// enable DMA channel 2
-	TIM_Cmd(TIM3, ENABLE);                      // Go!!!
+  if (len < 1) {
+    return;
+  }
+  if (len > WS2812_MAX_LEDS) {
+    len = WS2812_MAX_LEDS;
+  }
+
+  // Only send frames that change the colors
+  if (len == sentLength && memcmp(sentColors, color, len * 3) == 0) {
+    return;
+  }
+
+  // Encode into the buffer that is not being sent
+  uint16_t *frame = frames[backFrame];
+  encodeFrame(frame, color, len);
+
+  //Wait for previous transfer to be finished
+  xSemaphoreTake(allLedDone, portMAX_DELAY);
+
+  memcpy(sentColors, color, len * 3);
+  sentLength = len;
+  backFrame ^= 1;
+
+  DMA1_Stream5->M0AR = (uint32_t)frame;
+  DMA1_Stream5->NDTR = (len + RESET_LEDS) * BITS_PER_LED; // load number of half words to be transferred
+  DMA_Cmd(DMA1_Stream5, ENABLE); 			// enable DMA channel 2
+  TIM_Cmd(TIM3, ENABLE);                      // Go!!!
 }
 
+// Runs once per frame, when the whole frame has been transferred
 void ws2812DmaIsr(void)
 {
-    portBASE_TYPE xHigherPriorityTaskWoken;
-    uint16_t * buffer;
-    int i;
-
-    if (total_led == 0)
-    {
-      TIM_Cmd(TIM3, DISABLE);
-    	DMA_Cmd(DMA1_Stream5, DISABLE);
-    }
-
-    if (DMA_GetITStatus(DMA1_Stream5, DMA_IT_HTIF5))
-    {
-      DMA_ClearITPendingBit(DMA1_Stream5, DMA_IT_HTIF5);
-      buffer = led_dma.begin;
-    }
-
-    if (DMA_GetITStatus(DMA1_Stream5, DMA_IT_TCIF5))
-    {
-      DMA_ClearITPendingBit(DMA1_Stream5, DMA_IT_TCIF5);
-      buffer = led_dma.end;
-    }
-
-    for(i=0; (i<LED_PER_HALF) && (current_led<total_led+2); i++, current_led++) {
-      if (current_led<total_led)
-          fillLed(buffer+(24*i), color_led[current_led]);
-      else
-          bzero(buffer+(24*i), sizeof(led_dma.end));
-    }
-
-    if (current_led >= total_led+2) {
-      xSemaphoreGiveFromISR(allLedDone, &xHigherPriorityTaskWoken);
-
-	    TIM_Cmd(TIM3, DISABLE); 					// disable Timer 3
-	    DMA_Cmd(DMA1_Stream5, DISABLE); 			// disable DMA stream4
-
-	    total_led = 0;
-    }
+  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+  if (DMA_GetITStatus(DMA1_Stream5, DMA_IT_TCIF5))
+  {
+    DMA_ClearITPendingBit(DMA1_Stream5, DMA_IT_TCIF5);
+
+    TIM_Cmd(TIM3, DISABLE); 					// disable Timer 3
+    DMA_Cmd(DMA1_Stream5, DISABLE); 			// disable DMA stream5
+
+    xSemaphoreGiveFromISR(allLedDone, &xHigherPriorityTaskWoken);
+  }
+
+  if (xHigherPriorityTaskWoken) {
+    portYIELD();
+  }
 }
 
 #ifndef USDDECK_USE_ALT_PINS_AND_SPI
 void __attribute__((used)) DMA1_Stream5_IRQHandler(void)
 {
+  ISR_PROFILER_ENTER(isrProfilerWs2812Dma);
   ws2812DmaIsr();
+  ISR_PROFILER_EXIT(isrProfilerWs2812Dma);
 }
 #endif
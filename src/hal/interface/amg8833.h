@@ -85,6 +85,24 @@ typedef struct {
 
 typedef AMG8833_Dev_t *AMG8833_DEV;
 
+// Regions of interest of the frame reduction: the four quadrants and the center 4x4 pixels
+#define AMG88xx_ROI_TOP_LEFT         0
+#define AMG88xx_ROI_TOP_RIGHT        1
+#define AMG88xx_ROI_BOTTOM_LEFT      2
+#define AMG88xx_ROI_BOTTOM_RIGHT     3
+#define AMG88xx_ROI_CENTER           4
+#define AMG88xx_ROI_COUNT            5
+
+// Summary of a frame, pixel i is at row i / 8 (y) and column i % 8 (x)
+typedef struct {
+  float max;                          // Hottest pixel [C]
+  float mean;                         // Mean of all pixels [C]
+  float hotSpotX;                     // Centroid of the hot spot [pixels, 0 - 7]
+  float hotSpotY;
+  float roiMean[AMG88xx_ROI_COUNT];   // Mean of each region of interest [C]
+  uint32_t timestamp;                 // Tick when the frame was read
+} AMG8833_Reduction_t;
+
 // Initiate thermal sensor
 bool begin(AMG8833_Dev_t *dev, I2C_Dev *I2Cx);
 
@@ -103,6 +121,12 @@ void setInterruptLevels_N(AMG8833_Dev_t *dev, float high, float low);
 // This will manually set hysteresis
 void setInterruptLevels_H(AMG8833_Dev_t *dev, float high, float low, float hysteresis);
 
+// Background frame reading
+bool startFrameReading(AMG8833_Dev_t *dev);
+bool readLatestFrame(float *buf);
+bool readLatestReduction(AMG8833_Reduction_t *reduction);
+void reduceFrame(const float *pixels, float band, AMG8833_Reduction_t *reduction);
+
 // Modes
 void setMovingAverageMode(AMG8833_Dev_t *dev, bool mode);
 
@@ -32,6 +32,7 @@
 #define OW_MAX_SIZE        112
 #define OW_READ_SIZE       29
 #define OW_MAX_WRITE_SIZE  26 // Use even numbers because of 16bits segments
+#define OW_MAX_CACHED_MEMS 4  // The content of this many memories is kept in RAM after the first read
 
 typedef struct owCommand_s {
   uint8_t nmem;
@@ -72,5 +73,10 @@ bool owScan(uint8_t *nMem);
 bool owGetinfo(uint8_t selectMem, OwSerialNum *serialNum);
 bool owRead(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data);
 bool owWrite(uint8_t selectMem, uint16_t address, uint8_t length, const uint8_t *data);
+/**
+ * Set the cached content of a memory, OW_MAX_SIZE bytes, when it is known without reading
+ * it over one wire. Later reads of the memory are served from the cache.
+ */
+void owCacheSet(uint8_t selectMem, const uint8_t *data);
 
 #endif //__OW_H__
@@ -78,6 +78,14 @@
 #define PM_BAT_IIR_LPF_ATTENUATION (int)(ADC_SAMPLING_FREQ / (int)(2 * 3.1415f * PM_BAT_WANTED_LPF_CUTOFF_HZ))
 #define PM_BAT_IIR_LPF_ATT_FACTOR  (int)((1<<PM_BAT_IIR_SHIFT) / PM_BAT_IIR_LPF_ATTENUATION)
 
+// Weight of a new sample in the filtered battery voltage, about 1.6 Hz cut-off
+// at the 100 Hz update rate of the battery voltage from the nRF51
+#define PM_BAT_FILTER_ALPHA 0.1f
+
+// Weight of a new sample in the filtered external battery power, about 0.6 Hz
+// cut-off at the 10 Hz update rate of the power management task
+#define PM_EXT_POWER_FILTER_ALPHA 0.3f
+
 typedef enum
 {
   battery,
@@ -94,6 +102,17 @@ typedef enum
   chargeMax,
 } PMChargeStates;
 
+/**
+ * Power drawn from an external battery measured on deck pins
+ */
+typedef struct
+{
+  float voltage;      // Volts, averaged over the ADC oversampling
+  float current;      // Amperes, averaged over the ADC oversampling
+  float power;        // Watts, low pass filtered
+  uint32_t timestamp; // Milliseconds since boot of the last update
+} PMPowerEstimate;
+
 typedef enum
 {
   USBNone,
@@ -118,6 +137,12 @@ void pmSyslinkUpdate(SyslinkPacket *slp);
  */
 float pmGetBatteryVoltage(void);
 
+/**
+ * Returns the low pass filtered battery voltage in volts, for compensation of
+ * the motor thrust. The voltage is updated at about 100 Hz.
+ */
+float pmGetBatteryVoltageFiltered(void);
+
 /**
  * Returns the min battery voltage i volts as a float
  */
@@ -175,4 +200,12 @@ void pmEnableExtBatteryCurrMeasuring(const deckPin_t pin, float ampPerVolt);
  */
 float pmMeasureExtBatteryCurrent(void);
 
+/**
+ * Get the power drawn from the external battery, updated at 10 Hz. The pins are
+ * scanned continuously by the ADC, the measurement does not wait for a conversion.
+ *
+ * @return true if both the voltage and the current are measured
+ */
+bool pmGetExtBatteryPower(PMPowerEstimate *estimate);
+
 #endif /* PM_H_ */
@@ -57,6 +57,15 @@ void radiolinkSetPowerDbm(int8_t powerDbm);
 void radiolinkSyslinkDispatch(SyslinkPacket *slp);
 struct crtpLinkOperations * radiolinkGetLink();
 bool radiolinkSendP2PPacketBroadcast(P2PPacket *p2pp);
+
+/**
+ * Register a callback for the received P2P packets on one port. Port
+ * callbacks and the callback registered with p2pRegisterCB() are called from
+ * the P2P task.
+ *
+ * @return false if all port callback slots are used
+ */
+bool p2pRegisterPortCB(uint8_t port, P2PCallback cb);
 void p2pRegisterCB(P2PCallback cb);
 
 
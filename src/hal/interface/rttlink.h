@@ -0,0 +1,46 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rttlink.h - CRTP link over Segger RTT
+ */
+
+#ifndef __RTTLINK_H__
+#define __RTTLINK_H__
+
+#include <stdbool.h>
+#include "crtp.h"
+
+/**
+ * CRTP link over Segger RTT, for use with a debug probe attached. The link uses up and down buffer
+ * RTTLINK_BUFFER_INDEX, each CRTP packet is sent as one byte holding the length of the header and data, followed by
+ * the header and the data. This is the same framing as a packed mode USB transfer.
+ *
+ * The probe reads the target memory directly, the link is not limited by the radio packet rate.
+ */
+#define RTTLINK_BUFFER_INDEX 1
+
+void rttlinkInit(void);
+bool rttlinkTest(void);
+struct crtpLinkOperations * rttlinkGetLink(void);
+
+#endif // __RTTLINK_H__
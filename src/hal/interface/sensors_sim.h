@@ -0,0 +1,99 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sensors_sim.h - Simulated sensors, samples are provided by a physics model
+ *                 or recorded data instead of real hardware
+ */
+
+#ifndef __SENSORS_SIM_H__
+#define __SENSORS_SIM_H__
+
+#include "sensors.h"
+
+typedef struct {
+  Axis3f acc;               // Gs, body frame, including gravity
+  Axis3f gyro;              // deg/s, bias free
+  Axis3f mag;               // gauss
+  baro_t baro;
+  bool hasMag;
+  bool hasBaro;
+  uint64_t timestamp;       // us, timestamp of the sample in simulation time
+} sensorsSimSample_t;
+
+void sensorsSimInit(void);
+bool sensorsSimTest(void);
+bool sensorsSimAreCalibrated(void);
+bool sensorsSimManufacturingTest(void);
+void sensorsSimAcquire(sensorData_t *sensors, const uint32_t tick);
+void sensorsSimWaitDataReady(void);
+bool sensorsSimReadGyro(Axis3f *gyro);
+bool sensorsSimReadAcc(Axis3f *acc);
+bool sensorsSimReadMag(Axis3f *mag);
+bool sensorsSimReadBaro(baro_t *baro);
+void sensorsSimSetAccMode(accModes accMode);
+void sensorsSimDataAvailableCallback(void);
+
+/**
+ * Feed one IMU sample to the firmware, this is the equivalent of a data ready interrupt from a real IMU. The sample
+ * is enqueued to the estimator and the stabilizer loop is released for one iteration.
+ *
+ * The simulation drives the firmware in lock step: it feeds a sample, lets the firmware tasks run until the
+ * stabilizer is waiting for the next sample and then advances the model. The firmware is paced by the samples only,
+ * which makes it possible to run faster than real time.
+ *
+ * @param sample - the sensor values for this time step
+ */
+void sensorsSimFeed(const sensorsSimSample_t *sample);
+
+/**
+ * @return true if the stabilizer has consumed the last sample and is waiting for the next one
+ */
+bool sensorsSimIsWaitingForData(void);
+
+/**
+ * Host stream injection. Recorded or simulated samples are sent from a host over any CRTP link, for instance the
+ * USB link, and are released to the firmware on the target with the same timing as in the recording. This makes it
+ * possible to run the real firmware on the real MCU with repeatable inputs.
+ *
+ * Each packet starts with a sensorsSimInjectKind_t followed by a little endian uint32 timestamp in us and the
+ * payload of the kind. Baro, mag, TOF and flow samples are released together with the next IMU sample, the stream
+ * must be ordered by timestamp.
+ */
+typedef enum {
+  SENSORS_SIM_INJECT_IMU  = 0,  // acc[3] (Gs), gyro[3] (deg/s) as floats
+  SENSORS_SIM_INJECT_BARO = 1,  // pressure (mbar), temperature (C), asl (m) as floats
+  SENSORS_SIM_INJECT_MAG  = 2,  // mag[3] (gauss) as floats
+  SENSORS_SIM_INJECT_TOF  = 3,  // distance (m), stdDev as floats
+  SENSORS_SIM_INJECT_FLOW = 4,  // dpixelx, dpixely, stdDevX, stdDevY, dt (s) as floats
+  SENSORS_SIM_INJECT_RESET = 5, // no payload, restart the pacing from the next IMU sample
+} sensorsSimInjectKind_t;
+
+/**
+ * Queue an injected sample, called from the CRTP handler that receives the host stream.
+ *
+ * @param data - the packet, starting with the kind
+ * @param size - the size of the packet in bytes
+ */
+void sensorsSimInjectPacket(const uint8_t *data, const uint8_t size);
+
+#endif /* __SENSORS_SIM_H__ */
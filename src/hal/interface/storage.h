@@ -85,3 +85,26 @@ size_t storageFetch(char *key, void* buffer, size_t length);
  * @return true in case of success. false if the key was not found or if an error occured.
  */
 bool storageDelete(char* key);
+
+/**
+ * Called by storageForeach() for each entry.
+ *
+ * @param[key] Null terminated key of the entry
+ * @param[buffer] Buffer holding the data of the entry
+ * @param[length] Length of the data that was read
+ *
+ * @return true to continue with the next entry, false to stop.
+ */
+typedef bool (*storageFunc_t)(const char* key, void* buffer, size_t length);
+
+/**
+ * Calls a function for all entries with a key that starts with a prefix.
+ * The table is read in one pass, which is a lot faster than fetching keys
+ * one by one. The function must not call other storage functions.
+ *
+ * @param[prefix] Null terminated prefix of the keys
+ * @param[buffer] Buffer where the data of each entry is copied
+ * @param[length] Length of the buffer, longer data is truncated
+ * @param[func] Function called for each entry
+ */
+void storageForeach(const char* prefix, void* buffer, size_t length, storageFunc_t func);
@@ -85,6 +85,18 @@ typedef enum
 
 void syslinkInit();
 bool syslinkTest();
+
+/**
+ * Queue a packet to be sent to the nRF51, waits for room in the queue.
+ * Packets are sent in the background and back to back.
+ */
 int syslinkSendPacket(SyslinkPacket *slp);
 
+/**
+ * Queue a packet to be sent to the nRF51 if there is room.
+ *
+ * @return true if the packet was queued, false if the queue was full
+ */
+bool syslinkTrySendPacket(SyslinkPacket *slp);
+
 #endif
@@ -81,5 +81,13 @@ bool usbGetDataBlocking(USBPacket *in);
  */
 bool usbSendData(uint32_t size, uint8_t* data);
 
+/**
+ * Check if the host has enabled the packed CRTP mode, where a USB transfer
+ * carries several CRTP packets, each prefixed by its length.
+ *
+ * @return true in packed mode, false if a transfer is a single CRTP packet
+ */
+bool usbIsPackedMode(void);
+
 
 #endif /* UART_H_ */
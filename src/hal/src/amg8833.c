@@ -24,13 +24,52 @@
  * amg8833.c - Functions for interfacing AMG8833 thermal sensor
  * Reference : https://github.com/adafruit/Adafruit_AMG88xx
  */
+#include <string.h>
+
 #include "amg8833.h"
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "config.h"
+#include "log.h"
+#include "param.h"
+
 const float AMG88xx_TEMP_CONVERSION = 0.25;
 const float AMG88xx_THRM_CONVERSION = 0.0625;
 
+#define AMG88xx_FRAME_BYTES          (AMG88xx_PIXEL_ARRAY_SIZE << 1)
+// The sensor updates the pixels at 10 Hz, it has no data ready interrupt
+#define AMG88xx_FRAME_PERIOD         M2T(100)
+#define AMG88xx_FRAME_TIMEOUT        M2T(20)
+
 static uint8_t mode = 1;
 
+// Background frame reading. The transfer fills one raw frame while the other
+// holds the latest complete frame.
+static AMG8833_Dev_t *frameDev;
+static uint8_t rawFrames[2][AMG88xx_FRAME_BYTES];
+static uint8_t latestFrame;
+static I2cMessage frameMessage;
+static I2cTransfer frameTransfer;
+static SemaphoreHandle_t frameDone;
+static StaticSemaphore_t frameDoneBuffer;
+static AMG8833_Reduction_t latestReduction;
+static uint32_t frameCount;
+static uint32_t frameFailCount;
+
+// Parameters
+static float hotSpotBand = 2.0f;
+
+static void convertPixels(const uint8_t *raw, float *buf, uint8_t size)
+{
+  for (int i = 0; i < size; i++) {
+    uint8_t pos = i << 1;
+    uint16_t recast = ((uint16_t) raw[pos + 1] << 8) | ((uint16_t) raw[pos]);
+    buf[i] = int12ToFloat(recast) * AMG88xx_TEMP_CONVERSION;
+  }
+}
+
 /**************************************************************************
  Setups the I2C interface and thermal camera basic registers
 
@@ -66,17 +105,180 @@ bool begin(AMG8833_Dev_t *dev, I2C_Dev *I2Cx)
 **************************************************************************/
 void readPixels(AMG8833_Dev_t *dev, float *buf, uint8_t size)
 {
-  uint16_t recast;
-  float converted;
   uint8_t bytesToRead = min((uint8_t) (size << 1), (uint8_t) (AMG88xx_PIXEL_ARRAY_SIZE << 1));
   uint8_t rawArray[bytesToRead];
   read(dev, AMG88xx_PIXEL_OFFSET, rawArray, bytesToRead);
+  convertPixels(rawArray, buf, bytesToRead >> 1);
+}
 
-  for (int i = 0; i < size; i++) {
-    uint8_t pos = i << 1;
-    recast = ((uint16_t) rawArray[pos + 1] << 8) | ((uint16_t) rawArray[pos]);
-    converted = int12ToFloat(recast) * AMG88xx_TEMP_CONVERSION;
-    buf[i] = converted;
+static void frameDoneCallback(I2cTransfer *transfer, bool success)
+{
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  xSemaphoreGiveFromISR(frameDone, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void frameTask(void *param)
+{
+  float pixels[AMG88xx_PIXEL_ARRAY_SIZE];
+  TickType_t lastWakeTime = xTaskGetTickCount();
+
+  while (1) {
+    vTaskDelayUntil(&lastWakeTime, AMG88xx_FRAME_PERIOD);
+
+    // The frame is read into the buffer that is not the latest one, the task
+    // is free while the transfer is on the bus
+    const uint8_t fill = latestFrame ^ 1;
+    i2cdrvCreateMessageIntAddr(&frameMessage, frameDev->devAddr, false, AMG88xx_PIXEL_OFFSET,
+                               i2cRead, AMG88xx_FRAME_BYTES, rawFrames[fill]);
+    frameTransfer.messages = &frameMessage;
+    frameTransfer.nbrOfMessages = 1;
+    frameTransfer.priority = i2cPriorityLow;
+    frameTransfer.callback = frameDoneCallback;
+    frameTransfer.callbackArg = NULL;
+
+    xSemaphoreTake(frameDone, 0);
+    i2cdrvSubmitTransfer(frameDev->I2Cx, &frameTransfer);
+
+    if (xSemaphoreTake(frameDone, AMG88xx_FRAME_TIMEOUT) != pdTRUE) {
+      i2cdrvCancelTransfer(frameDev->I2Cx, &frameTransfer);
+      frameFailCount++;
+      continue;
+    }
+    if (!frameTransfer.isSuccess) {
+      frameFailCount++;
+      continue;
+    }
+
+    AMG8833_Reduction_t reduction;
+    reduction.timestamp = xTaskGetTickCount();
+    convertPixels(rawFrames[fill], pixels, AMG88xx_PIXEL_ARRAY_SIZE);
+    reduceFrame(pixels, hotSpotBand, &reduction);
+
+    taskENTER_CRITICAL();
+    latestFrame = fill;
+    latestReduction = reduction;
+    frameCount++;
+    taskEXIT_CRITICAL();
+  }
+}
+
+/**************************************************************************
+ Start reading frames in the background at the 10 Hz frame rate of the
+ sensor. The frames are reduced on-board to the hot spot, max and region of
+ interest means, logged in the amg8833 group.
+
+ @param  dev Thermal camera struct, set up with begin()
+ @returns True if the reading was started
+**************************************************************************/
+bool startFrameReading(AMG8833_Dev_t *dev)
+{
+  if (frameDev) {
+    return false;
+  }
+
+  frameDev = dev;
+  frameDone = xSemaphoreCreateBinaryStatic(&frameDoneBuffer);
+
+  return xTaskCreate(frameTask, AMG8833_TASK_NAME, AMG8833_TASK_STACKSIZE, NULL, AMG8833_TASK_PRI, NULL) == pdPASS;
+}
+
+/**************************************************************************
+ Copy the latest frame read in the background
+
+ @param  buf the array to place the 64 pixels in [C]
+ @returns False if no frame has been read yet
+**************************************************************************/
+bool readLatestFrame(float *buf)
+{
+  uint8_t raw[AMG88xx_FRAME_BYTES];
+
+  taskENTER_CRITICAL();
+  const bool hasFrame = frameCount > 0;
+  memcpy(raw, rawFrames[latestFrame], AMG88xx_FRAME_BYTES);
+  taskEXIT_CRITICAL();
+
+  if (hasFrame) {
+    convertPixels(raw, buf, AMG88xx_PIXEL_ARRAY_SIZE);
+  }
+  return hasFrame;
+}
+
+/**************************************************************************
+ Copy the reduction of the latest frame read in the background
+
+ @param  reduction the struct to place the reduction in
+ @returns False if no frame has been read yet
+**************************************************************************/
+bool readLatestReduction(AMG8833_Reduction_t *reduction)
+{
+  taskENTER_CRITICAL();
+  const bool hasFrame = frameCount > 0;
+  *reduction = latestReduction;
+  taskEXIT_CRITICAL();
+
+  return hasFrame;
+}
+
+/**************************************************************************
+ Reduce a frame to its max, mean, hot spot and region of interest means. The
+ hot spot is the centroid of the pixels within band of the max, weighted
+ by how much hotter than max - band they are.
+
+ @param  pixels the 64 pixels of the frame [C]
+ @param  band temperature band below the max that is part of the hot spot [C]
+ @param  reduction the struct to place the reduction in, the timestamp is not set
+**************************************************************************/
+void reduceFrame(const float *pixels, float band, AMG8833_Reduction_t *reduction)
+{
+  float sum = 0.0f;
+  float roiSum[AMG88xx_ROI_COUNT] = {0};
+  int maxIndex = 0;
+
+  for (int i = 0; i < AMG88xx_PIXEL_ARRAY_SIZE; i++) {
+    const int x = i & 0x07;
+    const int y = i >> 3;
+    const float t = pixels[i];
+
+    sum += t;
+    if (t > pixels[maxIndex]) {
+      maxIndex = i;
+    }
+
+    const int quadrant = (y >= 4 ? 2 : 0) + (x >= 4 ? 1 : 0);
+    roiSum[quadrant] += t;
+    if (x >= 2 && x < 6 && y >= 2 && y < 6) {
+      roiSum[AMG88xx_ROI_CENTER] += t;
+    }
+  }
+
+  const float max = pixels[maxIndex];
+  reduction->max = max;
+  reduction->mean = sum / AMG88xx_PIXEL_ARRAY_SIZE;
+  // All regions are 16 pixels
+  for (int i = 0; i < AMG88xx_ROI_COUNT; i++) {
+    reduction->roiMean[i] = roiSum[i] / 16.0f;
+  }
+
+  const float threshold = max - band;
+  float weightSum = 0.0f;
+  float xSum = 0.0f;
+  float ySum = 0.0f;
+  for (int i = 0; i < AMG88xx_PIXEL_ARRAY_SIZE; i++) {
+    const float weight = pixels[i] - threshold;
+    if (weight > 0.0f) {
+      weightSum += weight;
+      xSum += weight * (i & 0x07);
+      ySum += weight * (i >> 3);
+    }
+  }
+
+  if (weightSum > 0.0f) {
+    reduction->hotSpotX = xSum / weightSum;
+    reduction->hotSpotY = ySum / weightSum;
+  } else {
+    reduction->hotSpotX = maxIndex & 0x07;
+    reduction->hotSpotY = maxIndex >> 3;
   }
 }
 
@@ -300,3 +502,65 @@ uint8_t min(uint8_t a, uint8_t b)
 {
   return (a < b) ? a : b;
 }
+
+/**
+ * Thermal camera frames reduced on-board, updated at 10 Hz once a driver has
+ * called startFrameReading()
+ */
+PARAM_GROUP_START(amg8833)
+/**
+ * @brief Temperature band below the hottest pixel that is part of the hot spot [C] (default: 2.0)
+ */
+PARAM_ADD(PARAM_FLOAT, hotBand, &hotSpotBand)
+PARAM_GROUP_STOP(amg8833)
+
+/**
+ * Thermal camera frames reduced on-board, updated at 10 Hz once a driver has
+ * called startFrameReading()
+ */
+LOG_GROUP_START(amg8833)
+/**
+ * @brief Hottest pixel [C]
+ */
+LOG_ADD(LOG_FLOAT, max, &latestReduction.max)
+/**
+ * @brief Mean of all pixels [C]
+ */
+LOG_ADD(LOG_FLOAT, mean, &latestReduction.mean)
+/**
+ * @brief Column of the hot spot centroid [pixels, 0 - 7]
+ */
+LOG_ADD(LOG_FLOAT, hotX, &latestReduction.hotSpotX)
+/**
+ * @brief Row of the hot spot centroid [pixels, 0 - 7]
+ */
+LOG_ADD(LOG_FLOAT, hotY, &latestReduction.hotSpotY)
+/**
+ * @brief Mean of the top left quadrant [C]
+ */
+LOG_ADD(LOG_FLOAT, roiTL, &latestReduction.roiMean[AMG88xx_ROI_TOP_LEFT])
+/**
+ * @brief Mean of the top right quadrant [C]
+ */
+LOG_ADD(LOG_FLOAT, roiTR, &latestReduction.roiMean[AMG88xx_ROI_TOP_RIGHT])
+/**
+ * @brief Mean of the bottom left quadrant [C]
+ */
+LOG_ADD(LOG_FLOAT, roiBL, &latestReduction.roiMean[AMG88xx_ROI_BOTTOM_LEFT])
+/**
+ * @brief Mean of the bottom right quadrant [C]
+ */
+LOG_ADD(LOG_FLOAT, roiBR, &latestReduction.roiMean[AMG88xx_ROI_BOTTOM_RIGHT])
+/**
+ * @brief Mean of the center 4x4 pixels [C]
+ */
+LOG_ADD(LOG_FLOAT, roiC, &latestReduction.roiMean[AMG88xx_ROI_CENTER])
+/**
+ * @brief Number of frames read
+ */
+LOG_ADD(LOG_UINT32, frames, &frameCount)
+/**
+ * @brief Number of frame reads that failed or timed out
+ */
+LOG_ADD(LOG_UINT32, fails, &frameFailCount)
+LOG_GROUP_STOP(amg8833)
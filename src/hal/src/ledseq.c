@@ -31,7 +31,7 @@
 #include "ledseq.h"
 
 #include "FreeRTOS.h"
-#include "timers.h"
+#include "task.h"
 #include "semphr.h"
 #include "static_mem.h"
 
@@ -170,21 +170,31 @@ ledseqContext_t seq_testFailed = {
 };
 
 struct ledseqCmd_s {
-  enum {run, stop} command;
+  enum {run, stop, wakeup} command;
   ledseqContext_t *sequence;
 };
 
 /* Led sequence handling machine implementation */
-static void runLedseq(xTimerHandle xTimer);
+static void runLedseq(led_t led, TickType_t now);
+static void runDueSteps(void);
 static void updateActive(led_t led);
+static void scheduleStep(led_t led, TickType_t at);
+static void unscheduleStep(led_t led);
+static void wakeupScheduler(void);
 
 NO_DMA_CCM_SAFE_ZERO_INIT static ledseqContext_t* activeSeq[LED_NUM];
 
-NO_DMA_CCM_SAFE_ZERO_INIT static xTimerHandle timer[LED_NUM];
-NO_DMA_CCM_SAFE_ZERO_INIT static StaticTimer_t timerBuffer[LED_NUM];
+/* All LEDs share one scheduler, run by the command task. The LEDs waiting for
+ * their next step are kept sorted by due time, the task blocks on the command
+ * queue until the first one is due.
+ */
+NO_DMA_CCM_SAFE_ZERO_INIT static TickType_t nextStepAt[LED_NUM];
+NO_DMA_CCM_SAFE_ZERO_INIT static led_t pendingLeds[LED_NUM];
+static int pendingCount = 0;
 
 static xSemaphoreHandle ledseqMutex;
 static xQueueHandle ledseqCmdQueue;
+static xTaskHandle ledseqCmdTaskHandle;
 
 static bool isInit = false;
 static bool ledseqEnabled = false;
@@ -214,15 +224,10 @@ void ledseqInit() {
     activeSeq[i] = 0;
   }
 
-  //Init the soft timers that runs the led sequences for each leds
-  for(int i=0; i<LED_NUM; i++) {
-    timer[i] = xTimerCreateStatic("ledseqTimer", M2T(1000), pdFALSE, (void*)i, runLedseq, &timerBuffer[i]);
-  }
-
   ledseqMutex = xSemaphoreCreateMutex();
 
   ledseqCmdQueue = xQueueCreate(10, sizeof(struct ledseqCmd_s));
-  xTaskCreate(lesdeqCmdTask, LEDSEQCMD_TASK_NAME, LEDSEQCMD_TASK_STACKSIZE, NULL, LEDSEQCMD_TASK_PRI, NULL);
+  xTaskCreate(lesdeqCmdTask, LEDSEQCMD_TASK_NAME, LEDSEQCMD_TASK_STACKSIZE, NULL, LEDSEQCMD_TASK_PRI, &ledseqCmdTaskHandle);
 
   isInit = true;
 }
@@ -230,16 +235,30 @@ void ledseqInit() {
 static void lesdeqCmdTask(void* param) {
   struct ledseqCmd_s command;
   while(1) {
-    xQueueReceive(ledseqCmdQueue, &command, portMAX_DELAY);
+    TickType_t timeout = portMAX_DELAY;
 
-    switch(command.command) {
-      case run:
-        ledseqRunBlocking(command.sequence);
-        break;
-      case stop:
-        ledseqStopBlocking(command.sequence);
-        break;
+    xSemaphoreTake(ledseqMutex, portMAX_DELAY);
+    if (pendingCount > 0) {
+      TickType_t untilDue = nextStepAt[pendingLeds[0]] - xTaskGetTickCount();
+      timeout = ((int32_t)untilDue > 0) ? untilDue : 0;
     }
+    xSemaphoreGive(ledseqMutex);
+
+    if (xQueueReceive(ledseqCmdQueue, &command, timeout) == pdTRUE) {
+      switch(command.command) {
+        case run:
+          ledseqRunBlocking(command.sequence);
+          break;
+        case stop:
+          ledseqStopBlocking(command.sequence);
+          break;
+        case wakeup:
+          // Only recomputes the timeout
+          break;
+      }
+    }
+
+    runDueSteps();
   }
 }
 
@@ -277,12 +296,14 @@ void ledseqRunBlocking(ledseqContext_t *context) {
   xSemaphoreTake(ledseqMutex, portMAX_DELAY);
   context->state = 0;  //Reset the seq. to its first step
   updateActive(led);
-  xSemaphoreGive(ledseqMutex);
 
   // Run the first step if the new seq is the active sequence
   if(activeSeq[led] == context) {
-    runLedseq(timer[led]);
+    runLedseq(led, xTaskGetTickCount());
   }
+  xSemaphoreGive(ledseqMutex);
+
+  wakeupScheduler();
 }
 
 void ledseqSetChargeLevel(const float chargeLevel) {
@@ -309,21 +330,25 @@ void ledseqStopBlocking(ledseqContext_t *context) {
   xSemaphoreTake(ledseqMutex, portMAX_DELAY);
   context->state = LEDSEQ_STOP;  //Stop the seq.
   updateActive(led);
-  xSemaphoreGive(ledseqMutex);
 
   //Run the next active sequence (if any...)
-  runLedseq(timer[led]);
+  runLedseq(led, xTaskGetTickCount());
+  xSemaphoreGive(ledseqMutex);
+
+  wakeupScheduler();
 }
 
-/* Center of the led sequence machine. This function is executed by the FreeRTOS
- * timers and runs the sequences
+/* Center of the led sequence machine. Runs the steps of the active sequence of
+ * a LED until a step has to wait, and schedules the next step. Must be called
+ * with the ledseq mutex taken.
  */
-static void runLedseq( xTimerHandle xTimer ) {
+static void runLedseq(led_t led, TickType_t now) {
+  unscheduleStep(led);
+
   if (!ledseqEnabled) {
     return;
   }
 
-  led_t led = (led_t)pvTimerGetTimerID(xTimer);
   ledseqContext_t* context = activeSeq[led];
   if (NO_CONTEXT == context) {
     return;
@@ -337,9 +362,7 @@ static void runLedseq( xTimerHandle xTimer ) {
 
     const ledseqStep_t* step = &context->sequence[context->state];
 
-    xSemaphoreTake(ledseqMutex, portMAX_DELAY);
     context->state++;
-    led_t led = context->led;
 
     switch(step->action) {
       case LEDSEQ_LOOP:
@@ -354,15 +377,23 @@ static void runLedseq( xTimerHandle xTimer ) {
         if (step->action == 0) {
           break;
         }
-        xTimerChangePeriod(xTimer, M2T(step->action), 0);
-        xTimerStart(xTimer, 0);
+        scheduleStep(led, now + M2T(step->action));
         leave = true;
         break;
     }
-    xSemaphoreGive(ledseqMutex);
   }
 }
 
+/* Runs the steps that are due, in due time order */
+static void runDueSteps(void) {
+  xSemaphoreTake(ledseqMutex, portMAX_DELAY);
+  TickType_t now = xTaskGetTickCount();
+  while (pendingCount > 0 && (int32_t)(now - nextStepAt[pendingLeds[0]]) >= 0) {
+    runLedseq(pendingLeds[0], now);
+  }
+  xSemaphoreGive(ledseqMutex);
+}
+
 void ledseqRegisterSequence(ledseqContext_t* context) {
   context->state = LEDSEQ_STOP;
   context->nextContext = NO_CONTEXT;
@@ -390,6 +421,41 @@ void ledseqRegisterSequence(ledseqContext_t* context) {
 
 // Utility functions
 
+static void unscheduleStep(led_t led) {
+  for (int i = 0; i < pendingCount; i++) {
+    if (pendingLeds[i] == led) {
+      pendingCount--;
+      for (; i < pendingCount; i++) {
+        pendingLeds[i] = pendingLeds[i + 1];
+      }
+      return;
+    }
+  }
+}
+
+// The LED must not be pending, see unscheduleStep()
+static void scheduleStep(led_t led, TickType_t at) {
+  int i = pendingCount;
+  while (i > 0 && (int32_t)(at - nextStepAt[pendingLeds[i - 1]]) < 0) {
+    pendingLeds[i] = pendingLeds[i - 1];
+    i--;
+  }
+
+  pendingLeds[i] = led;
+  nextStepAt[led] = at;
+  pendingCount++;
+}
+
+// Makes the command task recompute its timeout after a sequence was started or
+// stopped from another task
+static void wakeupScheduler(void) {
+  if (xTaskGetCurrentTaskHandle() != ledseqCmdTaskHandle) {
+    struct ledseqCmd_s command = { .command = wakeup, .sequence = NO_CONTEXT };
+    // If the queue is full the task is about to wake up anyway
+    xQueueSend(ledseqCmdQueue, &command, 0);
+  }
+}
+
 static void updateActive(led_t led) {
   activeSeq[led] = NO_CONTEXT;
   ledSet(led, false);
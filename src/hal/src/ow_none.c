@@ -66,3 +66,7 @@ bool owWrite(uint8_t selectMem, uint16_t address, uint8_t length, const uint8_t
 {
   return false;
 }
+
+void owCacheSet(uint8_t selectMem, const uint8_t *data)
+{
+}
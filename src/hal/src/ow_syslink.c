@@ -33,6 +33,7 @@
 #include "ow.h"
 #include "assert.h"
 #include "debug.h"
+#include "static_mem.h"
 
 static xSemaphoreHandle waitForReply;
 static xSemaphoreHandle lockCmdBuf;
@@ -40,7 +41,20 @@ static StaticSemaphore_t lockCmdBufBuffer;
 static OwCommand owCmdBuf;
 static bool owDataIsValid;
 
+// Every one wire transfer is a round trip through the nRF. The memories only change through owWrite() while the
+// system is running, so the serial number and the content of a memory are only transferred the first time they are
+// needed. The content is read in full the first time any part of it is read. Protected by lockCmdBuf.
+typedef struct {
+  bool hasSerialNum;
+  bool hasData;
+  OwSerialNum serialNum;
+  uint8_t data[OW_MAX_SIZE];
+} OwMemCache;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static OwMemCache memCache[OW_MAX_CACHED_MEMS];
+
 static bool owSyslinkTransfer(uint8_t type, uint8_t length);
+static bool owReadMem(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data);
 
 #ifdef OW_WRITE_TEST
 static uint8_t bqtestData[] =
@@ -180,6 +194,7 @@ bool owScan(uint8_t *nMem)
   if (owSyslinkTransfer(SYSLINK_OW_SCAN, 0))
   {
     *nMem = owCmdBuf.nmem;
+    memset(memCache, 0, sizeof(memCache));
     status = true;
   }
   else
@@ -199,12 +214,22 @@ bool owGetinfo(uint8_t selectMem, OwSerialNum *serialNum)
   xSemaphoreTake(lockCmdBuf, portMAX_DELAY);
   owCmdBuf.nmem = selectMem;
 
-  if (owSyslinkTransfer(SYSLINK_OW_GETINFO, 1))
+  if (selectMem < OW_MAX_CACHED_MEMS && memCache[selectMem].hasSerialNum)
+  {
+    memcpy(serialNum, &memCache[selectMem].serialNum, sizeof(OwSerialNum));
+    status = true;
+  }
+  else if (owSyslinkTransfer(SYSLINK_OW_GETINFO, 1))
   {
     memcpy(serialNum, owCmdBuf.info.memId, sizeof(OwSerialNum));
     if (owCmdBuf.nmem != 0xFF)
     {
       status = true;
+      if (selectMem < OW_MAX_CACHED_MEMS)
+      {
+        memcpy(&memCache[selectMem].serialNum, serialNum, sizeof(OwSerialNum));
+        memCache[selectMem].hasSerialNum = true;
+      }
     }
   }
   else
@@ -217,16 +242,14 @@ bool owGetinfo(uint8_t selectMem, OwSerialNum *serialNum)
   return status;
 }
 
-bool owRead(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data)
+// Reads the memory over one wire, called with lockCmdBuf taken
+static bool owReadMem(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data)
 {
   bool status = true;
   uint16_t currAddr = address;
   uint16_t endAddr = address + length;
   uint8_t bytesRead = 0;
 
-  ASSERT(length <= OW_MAX_SIZE);
-
-  xSemaphoreTake(lockCmdBuf, portMAX_DELAY);
   owCmdBuf.nmem = selectMem;
 
   while (currAddr < endAddr)
@@ -237,8 +260,8 @@ bool owRead(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data)
       if (owSyslinkTransfer(SYSLINK_OW_READ, 3 + endAddr - currAddr))
       {
         memcpy(data + bytesRead, owCmdBuf.read.data, endAddr - currAddr);
-        currAddr += endAddr - currAddr;
         bytesRead += endAddr - currAddr;
+        currAddr += endAddr - currAddr;
       }
       else
       {
@@ -263,6 +286,39 @@ bool owRead(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data)
     }
   }
 
+  return status;
+}
+
+bool owRead(uint8_t selectMem, uint16_t address, uint8_t length, uint8_t *data)
+{
+  bool status = true;
+
+  ASSERT(length <= OW_MAX_SIZE);
+
+  xSemaphoreTake(lockCmdBuf, portMAX_DELAY);
+
+  if (selectMem < OW_MAX_CACHED_MEMS && address + length <= OW_MAX_SIZE)
+  {
+    OwMemCache *cache = &memCache[selectMem];
+    if (!cache->hasData)
+    {
+      cache->hasData = owReadMem(selectMem, 0, OW_MAX_SIZE, cache->data);
+    }
+
+    if (cache->hasData)
+    {
+      memcpy(data, &cache->data[address], length);
+    }
+    else
+    {
+      status = false;
+    }
+  }
+  else
+  {
+    status = owReadMem(selectMem, address, length, data);
+  }
+
   xSemaphoreGive(lockCmdBuf);
 
   return status;
@@ -316,7 +372,31 @@ bool owWrite(uint8_t selectMem, uint16_t address, uint8_t length, const uint8_t
     }
   }
 
+  if (selectMem < OW_MAX_CACHED_MEMS && address + length <= OW_MAX_SIZE)
+  {
+    if (status)
+    {
+      memcpy(&memCache[selectMem].data[address], data, length);
+    }
+    else
+    {
+      // Parts of the memory may have been written
+      memCache[selectMem].hasData = false;
+    }
+  }
+
   xSemaphoreGive(lockCmdBuf);
 
   return status;
 }
+
+void owCacheSet(uint8_t selectMem, const uint8_t *data)
+{
+  if (selectMem < OW_MAX_CACHED_MEMS)
+  {
+    xSemaphoreTake(lockCmdBuf, portMAX_DELAY);
+    memcpy(memCache[selectMem].data, data, OW_MAX_SIZE);
+    memCache[selectMem].hasData = true;
+    xSemaphoreGive(lockCmdBuf);
+  }
+}
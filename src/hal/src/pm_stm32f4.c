@@ -62,6 +62,7 @@ typedef struct _PmSyslinkInfo
 }  __attribute__((packed)) PmSyslinkInfo;
 
 static float     batteryVoltage;
+static float     batteryVoltageFiltered;
 static uint16_t  batteryVoltageMV;
 static float     batteryVoltageMin = 6.0;
 static float     batteryVoltageMax = 0.0;
@@ -76,6 +77,13 @@ static deckPin_t extBatCurrDeckPin;
 static bool      isExtBatCurrDeckPinSet = false;
 static float     extBatCurrAmpPerVolt;
 
+// Index of the external battery pins in the continuous ADC scan
+static uint8_t   extBatVoltScanIndex;
+static uint8_t   extBatCurrScanIndex;
+
+static PMPowerEstimate extPower;
+static float     extBatteryEnergy;
+
 #ifdef PM_SYSTLINK_INLCUDE_TEMP
 // nRF51 internal temp
 static float    temp;
@@ -90,6 +98,7 @@ static PmSyslinkInfo pmSyslinkInfo;
 static uint8_t batteryLevel;
 
 static void pmSetBatteryVoltage(float voltage);
+static void pmExtBatteryScanStart(void);
 
 const static float bat671723HS25C[10] =
 {
@@ -133,6 +142,14 @@ static void pmSetBatteryVoltage(float voltage)
 {
   batteryVoltage = voltage;
   batteryVoltageMV = (uint16_t)(voltage * 1000);
+  if (batteryVoltageFiltered == 0.0f)
+  {
+    batteryVoltageFiltered = voltage;
+  }
+  else
+  {
+    batteryVoltageFiltered += PM_BAT_FILTER_ALPHA * (voltage - batteryVoltageFiltered);
+  }
   if (batteryVoltageMax < voltage)
   {
     batteryVoltageMax = voltage;
@@ -187,6 +204,11 @@ float pmGetBatteryVoltage(void)
   return batteryVoltage;
 }
 
+float pmGetBatteryVoltageFiltered(void)
+{
+  return batteryVoltageFiltered;
+}
+
 float pmGetBatteryVoltageMin(void)
 {
   return batteryVoltageMin;
@@ -242,11 +264,34 @@ PMStates pmUpdateState()
   return state;
 }
 
+/**
+ * Restarts the continuous ADC scan with the enabled external battery pins
+ */
+static void pmExtBatteryScanStart(void)
+{
+  deckPin_t pins[2];
+  uint8_t count = 0;
+
+  if (isExtBatVoltDeckPinSet)
+  {
+    extBatVoltScanIndex = count;
+    pins[count++] = extBatVoltDeckPin;
+  }
+  if (isExtBatCurrDeckPinSet)
+  {
+    extBatCurrScanIndex = count;
+    pins[count++] = extBatCurrDeckPin;
+  }
+
+  analogScanStart(pins, count);
+}
+
 void pmEnableExtBatteryCurrMeasuring(const deckPin_t pin, float ampPerVolt)
 {
   extBatCurrDeckPin = pin;
   isExtBatCurrDeckPinSet = true;
   extBatCurrAmpPerVolt = ampPerVolt;
+  pmExtBatteryScanStart();
 }
 
 float pmMeasureExtBatteryCurrent(void)
@@ -255,7 +300,7 @@ float pmMeasureExtBatteryCurrent(void)
 
   if (isExtBatCurrDeckPinSet)
   {
-    current = analogReadVoltage(extBatCurrDeckPin) * extBatCurrAmpPerVolt;
+    current = analogScanReadVoltage(extBatCurrScanIndex) * extBatCurrAmpPerVolt;
   }
   else
   {
@@ -270,6 +315,7 @@ void pmEnableExtBatteryVoltMeasuring(const deckPin_t pin, float multiplier)
   extBatVoltDeckPin = pin;
   isExtBatVoltDeckPinSet = true;
   extBatVoltMultiplier = multiplier;
+  pmExtBatteryScanStart();
 }
 
 float pmMeasureExtBatteryVoltage(void)
@@ -278,7 +324,7 @@ float pmMeasureExtBatteryVoltage(void)
 
   if (isExtBatVoltDeckPinSet)
   {
-    voltage = analogReadVoltage(extBatVoltDeckPin) * extBatVoltMultiplier;
+    voltage = analogScanReadVoltage(extBatVoltScanIndex) * extBatVoltMultiplier;
   }
   else
   {
@@ -288,6 +334,41 @@ float pmMeasureExtBatteryVoltage(void)
   return voltage;
 }
 
+bool pmGetExtBatteryPower(PMPowerEstimate *estimate)
+{
+  taskENTER_CRITICAL();
+  *estimate = extPower;
+  taskEXIT_CRITICAL();
+
+  return isExtBatVoltDeckPinSet && isExtBatCurrDeckPinSet;
+}
+
+/**
+ * Updates the external battery power estimate and the consumed energy
+ */
+static void pmUpdateExtBatteryPower(uint32_t tickCount)
+{
+  const float power = extBatteryVoltage * extBatteryCurrent;
+  PMPowerEstimate estimate = extPower;
+
+  if (estimate.timestamp != 0)
+  {
+    extBatteryEnergy += power * (T2M(tickCount) - estimate.timestamp) / 1000.0f;
+    estimate.power += PM_EXT_POWER_FILTER_ALPHA * (power - estimate.power);
+  }
+  else
+  {
+    estimate.power = power;
+  }
+  estimate.voltage = extBatteryVoltage;
+  estimate.current = extBatteryCurrent;
+  estimate.timestamp = T2M(tickCount);
+
+  taskENTER_CRITICAL();
+  extPower = estimate;
+  taskEXIT_CRITICAL();
+}
+
 bool pmIsBatteryLow(void) {
   return (pmState == lowPower);
 }
@@ -327,6 +408,7 @@ void pmTask(void *param)
     extBatteryVoltage = pmMeasureExtBatteryVoltage();
     extBatteryVoltageMV = (uint16_t)(extBatteryVoltage * 1000);
     extBatteryCurrent = pmMeasureExtBatteryCurrent();
+    pmUpdateExtBatteryPower(tickCount);
     batteryLevel = pmBatteryChargeFromVoltage(pmGetBatteryVoltage()) * 10;
 
     if (pmGetBatteryVoltage() > PM_BAT_LOW_VOLTAGE)
@@ -409,10 +491,13 @@ void pmTask(void *param)
 
 LOG_GROUP_START(pm)
 LOG_ADD(LOG_FLOAT, vbat, &batteryVoltage)
+LOG_ADD(LOG_FLOAT, vbatFilt, &batteryVoltageFiltered)
 LOG_ADD(LOG_UINT16, vbatMV, &batteryVoltageMV)
 LOG_ADD(LOG_FLOAT, extVbat, &extBatteryVoltage)
 LOG_ADD(LOG_UINT16, extVbatMV, &extBatteryVoltageMV)
 LOG_ADD(LOG_FLOAT, extCurr, &extBatteryCurrent)
+LOG_ADD(LOG_FLOAT, extPower, &extPower.power)
+LOG_ADD(LOG_FLOAT, extEnergy, &extBatteryEnergy)
 LOG_ADD(LOG_FLOAT, chargeCurrent, &pmSyslinkInfo.chargeCurrent)
 LOG_ADD(LOG_INT8, state, &pmState)
 LOG_ADD(LOG_UINT8, batteryLevel, &batteryLevel)
@@ -44,12 +44,29 @@
 #include "queuemonitor.h"
 #include "static_mem.h"
 #include "cfassert.h"
+#include "statsCnt.h"
+#include "param.h"
+#include "timesync.h"
+#include "usec_time.h"
 
 #define RADIOLINK_TX_QUEUE_SIZE (1)
 #define RADIOLINK_CRTP_QUEUE_SIZE (5)
 #define RADIO_ACTIVITY_TIMEOUT_MS (1000)
+#define RADIO_STATS_INTERVAL_MS (1000)
 
 #define RADIOLINK_P2P_QUEUE_SIZE (5)
+#define RADIOLINK_P2P_TX_QUEUE_SIZE (4)
+#define P2P_PORT_CALLBACKS (4)
+// Packets a peer may send in its TDMA slot
+#define P2P_PACKETS_PER_SLOT (2)
+
+// A client sends a broadcast a few times to make up for lost packets, since
+// there are no acks. Copies of a broadcast that arrive within the window are
+// dropped when radio.bcDedup is set. Consecutive commands with the same content
+// are told apart by the client changing the 2 bit sequence number in the link
+// bits of the header, which clients that do not enable it may not do.
+#define RADIO_BROADCAST_HISTORY (4)
+#define RADIO_BROADCAST_DEDUP_MS (100)
 
 static xQueueHandle  txQueue;
 STATIC_MEM_QUEUE_ALLOC(txQueue, RADIOLINK_TX_QUEUE_SIZE, sizeof(SyslinkPacket));
@@ -57,6 +74,14 @@ STATIC_MEM_QUEUE_ALLOC(txQueue, RADIOLINK_TX_QUEUE_SIZE, sizeof(SyslinkPacket));
 static xQueueHandle crtpPacketDelivery;
 STATIC_MEM_QUEUE_ALLOC(crtpPacketDelivery, RADIOLINK_CRTP_QUEUE_SIZE, sizeof(CRTPPacket));
 
+static xQueueHandle p2pRxQueue;
+STATIC_MEM_QUEUE_ALLOC(p2pRxQueue, RADIOLINK_P2P_QUEUE_SIZE, sizeof(P2PPacket));
+static xQueueHandle p2pTxQueue;
+STATIC_MEM_QUEUE_ALLOC(p2pTxQueue, RADIOLINK_P2P_TX_QUEUE_SIZE, sizeof(P2PPacket));
+
+static void p2pTask(void *param);
+STATIC_MEM_TASK_ALLOC(p2pTask, P2P_TASK_STACKSIZE);
+
 static bool isInit;
 
 static int radiolinkSendCRTPPacket(CRTPPacket *p);
@@ -69,6 +94,49 @@ static bool isConnected;
 static uint32_t lastPacketTick;
 
 static volatile P2PCallback p2p_callback;
+static struct {
+  uint8_t port;
+  P2PCallback callback;
+} p2pPortCallbacks[P2P_PORT_CALLBACKS];
+static uint8_t p2pPortCallbackCount;
+
+// TDMA for P2P broadcasts. The period is divided in slots and a peer sends
+// only in the slot of its id. The slots are based on the local clock, peers
+// that are started at the same time start out aligned.
+static uint8_t p2pSlots = 0; // 0 to send at once
+static uint8_t p2pSlotMs = 5;
+static uint8_t p2pId;
+static uint32_t p2pSlotUsedUntil;
+
+static STATS_CNT_RATE_DEFINE(p2pTxRate, RADIO_STATS_INTERVAL_MS);
+static STATS_CNT_RATE_DEFINE(p2pRxRate, RADIO_STATS_INTERVAL_MS);
+static uint32_t p2pTxDropped;
+static uint32_t p2pRxDropped;
+
+// Link statistics. Every received raw packet is answered with an ack, that
+// carries a queued packet if there is one, otherwise it is empty.
+static STATS_CNT_RATE_DEFINE(rxRate, RADIO_STATS_INTERVAL_MS);
+static STATS_CNT_RATE_DEFINE(rxByteRate, RADIO_STATS_INTERVAL_MS);
+static STATS_CNT_RATE_DEFINE(txRate, RADIO_STATS_INTERVAL_MS);
+static STATS_CNT_RATE_DEFINE(txByteRate, RADIO_STATS_INTERVAL_MS);
+static STATS_CNT_RATE_DEFINE(emptyAckRate, RADIO_STATS_INTERVAL_MS);
+static struct {
+  uint32_t windowStart;
+  uint16_t acks;
+  uint16_t emptyAcks;
+
+  uint8_t emptyAckRatio; // Percent of the acks in the last interval that were empty
+  uint32_t rxDropped;    // Broadcasts dropped since the delivery queue was full
+  uint32_t txTimeouts;   // Times the CRTP tx task had to wait for an ack slot
+  uint32_t rxDuplicates; // Broadcast copies dropped
+} linkStats;
+
+static struct {
+  uint32_t fingerprint;
+  uint32_t tick;
+} broadcastHistory[RADIO_BROADCAST_HISTORY];
+static uint8_t broadcastHistoryNext;
+static uint8_t broadcastDedup = 0;
 
 static bool radiolinkIsConnected(void) {
   return (xTaskGetTickCount() - lastPacketTick) < M2T(RADIO_ACTIVITY_TIMEOUT_MS);
@@ -93,6 +161,13 @@ void radiolinkInit(void)
   DEBUG_QUEUE_MONITOR_REGISTER(crtpPacketDelivery);
 
   ASSERT(crtpPacketDelivery);
+  p2pRxQueue = STATIC_MEM_QUEUE_CREATE(p2pRxQueue);
+  DEBUG_QUEUE_MONITOR_REGISTER(p2pRxQueue);
+  p2pTxQueue = STATIC_MEM_QUEUE_CREATE(p2pTxQueue);
+  DEBUG_QUEUE_MONITOR_REGISTER(p2pTxQueue);
+
+  p2pId = configblockGetRadioAddress() & 0xff;
+  STATIC_MEM_TASK_CREATE(p2pTask, p2pTask, P2P_TASK_NAME, NULL, P2P_TASK_PRI);
 
   syslinkInit();
 
@@ -149,12 +224,55 @@ void radiolinkSetPowerDbm(int8_t powerDbm)
 }
 
 
+static void updateAckRatio(void)
+{
+  linkStats.acks++;
+
+  const uint32_t now = xTaskGetTickCount();
+  if (now - linkStats.windowStart >= M2T(RADIO_STATS_INTERVAL_MS))
+  {
+    linkStats.emptyAckRatio = (100 * linkStats.emptyAcks) / linkStats.acks;
+    linkStats.acks = 0;
+    linkStats.emptyAcks = 0;
+    linkStats.windowStart = now;
+  }
+}
+
+/* Checks if a broadcast, the CRTP size followed by the packet, is a copy of
+ * one received recently and remembers it otherwise. */
+static bool isDuplicateBroadcast(const uint8_t* packet, const uint8_t length)
+{
+  uint32_t fingerprint = 2166136261u;
+  for (int i = 0; i < length; i++)
+  {
+    fingerprint = (fingerprint ^ packet[i]) * 16777619u;
+  }
+
+  const uint32_t now = xTaskGetTickCount();
+  for (int i = 0; i < RADIO_BROADCAST_HISTORY; i++)
+  {
+    if (broadcastHistory[i].fingerprint == fingerprint &&
+        now - broadcastHistory[i].tick < M2T(RADIO_BROADCAST_DEDUP_MS))
+    {
+      return true;
+    }
+  }
+
+  broadcastHistory[broadcastHistoryNext].fingerprint = fingerprint;
+  broadcastHistory[broadcastHistoryNext].tick = now;
+  broadcastHistoryNext = (broadcastHistoryNext + 1) % RADIO_BROADCAST_HISTORY;
+
+  return false;
+}
+
 void radiolinkSyslinkDispatch(SyslinkPacket *slp)
 {
   static SyslinkPacket txPacket;
 
   if (slp->type == SYSLINK_RADIO_RAW || slp->type == SYSLINK_RADIO_RAW_BROADCAST) {
     lastPacketTick = xTaskGetTickCount();
+    STATS_CNT_RATE_EVENT(&rxRate);
+    STATS_CNT_RATE_MULTI_EVENT(&rxByteRate, slp->length);
   }
 
   if (slp->type == SYSLINK_RADIO_RAW)
@@ -168,13 +286,35 @@ void radiolinkSyslinkDispatch(SyslinkPacket *slp)
     {
       ledseqRun(&seq_linkDown);
       syslinkSendPacket(&txPacket);
+      STATS_CNT_RATE_EVENT(&txRate);
+      STATS_CNT_RATE_MULTI_EVENT(&txByteRate, txPacket.length);
     }
+    else
+    {
+      STATS_CNT_RATE_EVENT(&emptyAckRate);
+      linkStats.emptyAcks++;
+    }
+    updateAckRatio();
   } else if (slp->type == SYSLINK_RADIO_RAW_BROADCAST)
   {
+    // All receivers get a broadcast at the same time, used for the swarm time
+    const uint64_t rxTimestamp = usecTimestamp();
     slp->length--; // Decrease to get CRTP size.
-    // broadcasts are best effort, so no need to handle the case where the queue is full
-    xQueueSend(crtpPacketDelivery, &slp->length, 0);
     ledseqRun(&seq_linkUp);
+    if (broadcastDedup && isDuplicateBroadcast(&slp->length, slp->length + 2))
+    {
+      linkStats.rxDuplicates++;
+    }
+    else
+    {
+      timesyncHandleBroadcast((CRTPPacket*)&slp->length, rxTimestamp);
+
+      // broadcasts are best effort, so no need to handle the case where the queue is full
+      if (xQueueSend(crtpPacketDelivery, &slp->length, 0) != pdTRUE)
+      {
+        linkStats.rxDropped++;
+      }
+    }
     // no ack for broadcasts
   } else if (slp->type == SYSLINK_RADIO_RSSI)
   {
@@ -188,8 +328,10 @@ void radiolinkSyslinkDispatch(SyslinkPacket *slp)
     p2pp.rssi = slp->data[1];
     memcpy(&p2pp.data[0], &slp->data[2],slp->length-2);
     p2pp.size=slp->length;
-    if (p2p_callback)
-        p2p_callback(&p2pp);
+    if (xQueueSend(p2pRxQueue, &p2pp, 0) != pdTRUE)
+    {
+      p2pRxDropped++;
+    }
   }
 
   isConnected = radiolinkIsConnected();
@@ -210,6 +352,38 @@ void p2pRegisterCB(P2PCallback cb)
     p2p_callback = cb;
 }
 
+bool p2pRegisterPortCB(uint8_t port, P2PCallback cb)
+{
+  if (p2pPortCallbackCount >= P2P_PORT_CALLBACKS)
+  {
+    return false;
+  }
+
+  p2pPortCallbacks[p2pPortCallbackCount].port = port;
+  p2pPortCallbacks[p2pPortCallbackCount].callback = cb;
+  p2pPortCallbackCount++;
+
+  return true;
+}
+
+static void p2pDeliver(P2PPacket *p)
+{
+  STATS_CNT_RATE_EVENT(&p2pRxRate);
+
+  if (p2p_callback)
+  {
+    p2p_callback(p);
+  }
+
+  for (int i = 0; i < p2pPortCallbackCount; i++)
+  {
+    if (p2pPortCallbacks[i].port == p->port)
+    {
+      p2pPortCallbacks[i].callback(p);
+    }
+  }
+}
+
 static int radiolinkSendCRTPPacket(CRTPPacket *p)
 {
   static SyslinkPacket slp;
@@ -225,25 +399,110 @@ static int radiolinkSendCRTPPacket(CRTPPacket *p)
     return true;
   }
 
+  linkStats.txTimeouts++;
   return false;
 }
 
-bool radiolinkSendP2PPacketBroadcast(P2PPacket *p)
+static bool p2pIsTdmaEnabled(void)
 {
-  static SyslinkPacket slp;
+  return p2pSlots > 0 && p2pSlotMs > 0;
+}
 
-  ASSERT(p->size <= P2P_MAX_DATA_SIZE);
+static bool p2pSendNow(P2PPacket *p)
+{
+  SyslinkPacket slp;
 
   slp.type = SYSLINK_RADIO_P2P_BROADCAST;
   slp.length = p->size + 1;
   memcpy(slp.data, p->raw, p->size + 1);
 
-  syslinkSendPacket(&slp);
+  if (!syslinkTrySendPacket(&slp))
+  {
+    p2pTxDropped++;
+    return false;
+  }
   ledseqRun(&seq_linkDown);
+  STATS_CNT_RATE_EVENT(&p2pTxRate);
 
   return true;
 }
 
+bool radiolinkSendP2PPacketBroadcast(P2PPacket *p)
+{
+  ASSERT(p->size <= P2P_MAX_DATA_SIZE);
+
+  if (!p2pIsTdmaEnabled())
+  {
+    return p2pSendNow(p);
+  }
+
+  // Sent by the P2P task in the slot of this peer
+  if (xQueueSend(p2pTxQueue, p, 0) != pdTRUE)
+  {
+    p2pTxDropped++;
+    return false;
+  }
+
+  return true;
+}
+
+/* Ticks until the slot of this peer starts, 0 while in the slot */
+static uint32_t p2pTicksToSlot(const uint32_t now)
+{
+  const uint32_t period = M2T(p2pSlots * p2pSlotMs);
+  const uint32_t start = M2T((p2pId % p2pSlots) * p2pSlotMs);
+  const uint32_t phase = now % period;
+
+  if (phase >= start && phase < start + M2T(p2pSlotMs))
+  {
+    return 0;
+  }
+
+  return (start + period - phase) % period;
+}
+
+/* Sends the queued broadcasts in the TDMA slot and runs the callbacks of the
+ * received packets, outside of the syslink task. */
+static void p2pTask(void *param)
+{
+  P2PPacket p;
+
+  while (true)
+  {
+    const uint32_t now = xTaskGetTickCount();
+    uint32_t wait = M2T(100);
+
+    if (!p2pIsTdmaEnabled())
+    {
+      // Left over packets from before TDMA was turned off
+      while (xQueueReceive(p2pTxQueue, &p, 0) == pdTRUE)
+      {
+        p2pSendNow(&p);
+      }
+    }
+    else
+    {
+      const uint32_t toSlot = p2pTicksToSlot(now);
+      if (toSlot == 0 && (int32_t)(now - p2pSlotUsedUntil) >= 0)
+      {
+        for (int i = 0; i < P2P_PACKETS_PER_SLOT && xQueueReceive(p2pTxQueue, &p, 0) == pdTRUE; i++)
+        {
+          p2pSendNow(&p);
+        }
+        p2pSlotUsedUntil = now + M2T(p2pSlotMs);
+        continue;
+      }
+
+      wait = (toSlot == 0) ? p2pSlotUsedUntil - now : toSlot;
+    }
+
+    if (xQueueReceive(p2pRxQueue, &p, wait) == pdTRUE)
+    {
+      p2pDeliver(&p);
+    }
+  }
+}
+
 
 struct crtpLinkOperations * radiolinkGetLink()
 {
@@ -259,3 +518,92 @@ LOG_GROUP_START(radio)
 LOG_ADD(LOG_UINT8, rssi, &rssi)
 LOG_ADD(LOG_UINT8, isConnected, &isConnected)
 LOG_GROUP_STOP(radio)
+
+/**
+ * Radio link statistics, to be used by clients to adapt the amount of data
+ * they request to what the link can carry.
+ */
+LOG_GROUP_START(radioStats)
+/**
+ * @brief Packets per second received, unicast and broadcast
+ */
+STATS_CNT_RATE_LOG_ADD(rxRate, &rxRate)
+/**
+ * @brief Bytes per second received, including the CRTP header
+ */
+STATS_CNT_RATE_LOG_ADD(rxBytes, &rxByteRate)
+/**
+ * @brief Packets per second sent in acks
+ */
+STATS_CNT_RATE_LOG_ADD(txRate, &txRate)
+/**
+ * @brief Bytes per second sent in acks, including the CRTP header
+ */
+STATS_CNT_RATE_LOG_ADD(txBytes, &txByteRate)
+/**
+ * @brief Acks per second that were sent without data
+ */
+STATS_CNT_RATE_LOG_ADD(emptyAcks, &emptyAckRate)
+/**
+ * @brief Percent of the acks during the last second that were sent without data.
+ * A low value means that the Crazyflie has more to send than the client polls for.
+ */
+LOG_ADD(LOG_UINT8, emptyAckPct, &linkStats.emptyAckRatio)
+/**
+ * @brief Number of received broadcasts dropped since the delivery queue was full
+ */
+LOG_ADD(LOG_UINT32, rxDropped, &linkStats.rxDropped)
+/**
+ * @brief Number of times a packet could not be handed to the radio within 100 ms
+ * and the CRTP tx task retried, since no packets were received to ack
+ */
+LOG_ADD(LOG_UINT32, txTimeouts, &linkStats.txTimeouts)
+/**
+ * @brief Number of broadcast copies dropped since the same broadcast was received recently
+ */
+LOG_ADD(LOG_UINT32, rxDuplicates, &linkStats.rxDuplicates)
+LOG_GROUP_STOP(radioStats)
+
+LOG_GROUP_START(p2p)
+/**
+ * @brief P2P broadcasts sent per second
+ */
+STATS_CNT_RATE_LOG_ADD(txRate, &p2pTxRate)
+/**
+ * @brief P2P packets received and delivered per second
+ */
+STATS_CNT_RATE_LOG_ADD(rxRate, &p2pRxRate)
+/**
+ * @brief Number of P2P broadcasts dropped since the tx queue was full
+ */
+LOG_ADD(LOG_UINT32, txDropped, &p2pTxDropped)
+/**
+ * @brief Number of received P2P packets dropped since the rx queue was full
+ */
+LOG_ADD(LOG_UINT32, rxDropped, &p2pRxDropped)
+LOG_GROUP_STOP(p2p)
+
+/**
+ * TDMA scheduling of P2P broadcasts
+ */
+PARAM_GROUP_START(p2p)
+/**
+ * @brief Number of TDMA slots, 0 to send broadcasts at once (default: 0)
+ */
+PARAM_ADD(PARAM_UINT8, slots, &p2pSlots)
+/**
+ * @brief Length of a TDMA slot [ms] (default: 5)
+ */
+PARAM_ADD(PARAM_UINT8, slotMs, &p2pSlotMs)
+/**
+ * @brief Id of this peer, it sends in slot id modulo slots (default: the last byte of the radio address)
+ */
+PARAM_ADD(PARAM_UINT8, id, &p2pId)
+PARAM_GROUP_STOP(p2p)
+
+PARAM_GROUP_START(radio)
+/**
+ * @brief If set, copies of a broadcast received within 100 ms are dropped (default: 0)
+ */
+PARAM_ADD(PARAM_UINT8, bcDedup, &broadcastDedup)
+PARAM_GROUP_STOP(radio)
@@ -0,0 +1,217 @@
+/*
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rttlink.c: Segger RTT implementation of the CRTP link
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "config.h"
+#include "rttlink.h"
+#include "crtp.h"
+#include "ledseq.h"
+#include "log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "queuemonitor.h"
+#include "static_mem.h"
+
+#include "SEGGER_RTT.h"
+
+#ifndef RTTLINK_UP_BUFFER_SIZE
+  #define RTTLINK_UP_BUFFER_SIZE 4096
+#endif
+
+#ifndef RTTLINK_DOWN_BUFFER_SIZE
+  #define RTTLINK_DOWN_BUFFER_SIZE 512
+#endif
+
+// The probe can not signal new data, the down buffer is polled at this interval when it is empty
+#define RTTLINK_POLL_INTERVAL_MS 1
+
+static bool isInit = false;
+static xQueueHandle crtpPacketDelivery;
+STATIC_MEM_QUEUE_ALLOC(crtpPacketDelivery, 16, sizeof(CRTPPacket));
+
+static uint8_t upBuffer[RTTLINK_UP_BUFFER_SIZE];
+static uint8_t downBuffer[RTTLINK_DOWN_BUFFER_SIZE];
+static uint8_t sendBuffer[CRTP_MAX_DATA_SIZE + 2];
+
+static uint32_t txBytes = 0;
+static uint32_t rxBytes = 0;
+static uint32_t rxFramingErrors = 0;
+
+static int rttlinkSendPacket(CRTPPacket *p);
+static int rttlinkSetEnable(bool enable);
+static int rttlinkReceivePacket(CRTPPacket *p);
+
+STATIC_MEM_TASK_ALLOC(rttlinkTask, RTTLINK_TASK_STACKSIZE);
+
+static struct crtpLinkOperations rttlinkOp =
+{
+  .setEnable         = rttlinkSetEnable,
+  .sendPacket        = rttlinkSendPacket,
+  .receivePacket     = rttlinkReceivePacket,
+};
+
+static CRTPPacket p;
+
+/* Reassembles CRTP packets from the byte stream in the down buffer. A length of 0 or one that does not fit a CRTP
+ * packet can not be recovered from, the rest of the data in the buffer is dropped. */
+static void rttlinkTask(void *param)
+{
+  static uint8_t readBuffer[64];
+  uint8_t length = 0;
+  uint8_t index = 0;
+
+  while(1)
+  {
+    const unsigned readSize = SEGGER_RTT_Read(RTTLINK_BUFFER_INDEX, readBuffer, sizeof(readBuffer));
+    if (readSize == 0)
+    {
+      vTaskDelay(M2T(RTTLINK_POLL_INTERVAL_MS));
+      continue;
+    }
+
+    rxBytes += readSize;
+
+    for (unsigned i = 0; i < readSize; i++)
+    {
+      const uint8_t byte = readBuffer[i];
+
+      if (length == 0)
+      {
+        if (byte == 0 || byte > CRTP_MAX_DATA_SIZE + 1)
+        {
+          rxFramingErrors++;
+          while (SEGGER_RTT_Read(RTTLINK_BUFFER_INDEX, readBuffer, sizeof(readBuffer)) > 0)
+          {
+          }
+          break;
+        }
+
+        length = byte;
+        index = 0;
+      }
+      else
+      {
+        p.raw[index++] = byte;
+        if (index == length)
+        {
+          p.size = length - 1;
+          xQueueSend(crtpPacketDelivery, &p, portMAX_DELAY);
+          length = 0;
+        }
+      }
+    }
+  }
+}
+
+static int rttlinkReceivePacket(CRTPPacket *p)
+{
+  if (xQueueReceive(crtpPacketDelivery, p, M2T(100)) == pdTRUE)
+  {
+    ledseqRun(&seq_linkUp);
+    return 0;
+  }
+
+  return -1;
+}
+
+static int rttlinkSendPacket(CRTPPacket *p)
+{
+  ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
+
+  sendBuffer[0] = p->size + 1;
+  sendBuffer[1] = p->header;
+  memcpy(&sendBuffer[2], p->data, p->size);
+  const unsigned dataSize = p->size + 2;
+
+  // The up buffer is in skip mode, a packet is written completely or not at all. When the probe does not keep up
+  // the packet is kept and the tx task tries again later.
+  if (SEGGER_RTT_Write(RTTLINK_BUFFER_INDEX, sendBuffer, dataSize) != dataSize)
+  {
+    return false;
+  }
+
+  txBytes += dataSize;
+  ledseqRun(&seq_linkDown);
+
+  return true;
+}
+
+static int rttlinkSetEnable(bool enable)
+{
+  return 0;
+}
+
+/*
+ * Public functions
+ */
+
+void rttlinkInit()
+{
+  if(isInit)
+    return;
+
+  SEGGER_RTT_ConfigUpBuffer(RTTLINK_BUFFER_INDEX, "CRTP", upBuffer, sizeof(upBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+  SEGGER_RTT_ConfigDownBuffer(RTTLINK_BUFFER_INDEX, "CRTP", downBuffer, sizeof(downBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+
+  crtpPacketDelivery = STATIC_MEM_QUEUE_CREATE(crtpPacketDelivery);
+  DEBUG_QUEUE_MONITOR_REGISTER(crtpPacketDelivery);
+
+  STATIC_MEM_TASK_CREATE(rttlinkTask, rttlinkTask, RTTLINK_TASK_NAME, NULL, RTTLINK_TASK_PRI);
+
+  isInit = true;
+}
+
+bool rttlinkTest()
+{
+  return isInit;
+}
+
+struct crtpLinkOperations * rttlinkGetLink()
+{
+  return &rttlinkOp;
+}
+
+/**
+ * CRTP link over Segger RTT
+ */
+LOG_GROUP_START(rttlink)
+/**
+ * @brief Bytes written to the up buffer
+ */
+LOG_ADD(LOG_UINT32, txBytes, &txBytes)
+/**
+ * @brief Bytes read from the down buffer
+ */
+LOG_ADD(LOG_UINT32, rxBytes, &rxBytes)
+/**
+ * @brief Number of invalid lengths in the down stream
+ */
+LOG_ADD(LOG_UINT32, rxErr, &rxFramingErrors)
+LOG_GROUP_STOP(rttlink)
@@ -52,6 +52,9 @@
 #include "bstdr_types.h"
 #include "static_mem.h"
 #include "estimator.h"
+#include "motors.h"
+#include "storage.h"
+#include "worker.h"
 
 #include "sensors_bmi088_common.h"
 
@@ -64,9 +67,26 @@
 #define SENSORS_DELAY_BARO              (SENSORS_READ_RATE_HZ/SENSORS_READ_BARO_HZ)
 #define SENSORS_DELAY_MAG               (SENSORS_READ_RATE_HZ/SENSORS_READ_MAG_HZ)
 
+/* Sample the gyro at twice the sensor task rate and read it in bursts from the
+ * FIFO. The on-chip 230 Hz filter is the anti-alias stage and averaging the
+ * frames of a burst decimates to SENSORS_READ_RATE_HZ. Undefine to go back to
+ * reading the data registers on the 1 kHz data ready interrupt. */
+#define SENSORS_BMI088_GYRO_FIFO
+
 #define SENSORS_BMI088_GYRO_FS_CFG      BMI088_GYRO_RANGE_2000_DPS
 #define SENSORS_BMI088_DEG_PER_LSB_CFG  (2.0f *2000.0f) / 65536.0f
 
+#ifdef SENSORS_BMI088_GYRO_FIFO
+#define SENSORS_BMI088_GYRO_BW_ODR_CFG  BMI088_GYRO_BW_230_ODR_2000_HZ
+// Frames per watermark interrupt, 2 frames at 2 kHz gives 1 kHz interrupts
+#define SENSORS_BMI088_GYRO_FIFO_WM     2
+// Frames read in one burst, 12 bytes fits in a single SPI DMA transaction
+#define SENSORS_BMI088_GYRO_FIFO_BURST  2
+#define SENSORS_BMI088_GYRO_FRAME_SIZE  6
+#else
+#define SENSORS_BMI088_GYRO_BW_ODR_CFG  BMI088_GYRO_BW_116_ODR_1000_HZ
+#endif
+
 #define SENSORS_BMI088_ACCEL_CFG        24
 #define SENSORS_BMI088_ACCEL_FS_CFG     BMI088_ACCEL_RANGE_24G
 #define SENSORS_BMI088_G_PER_LSB_CFG    (2.0f * (float)SENSORS_BMI088_ACCEL_CFG) / 65536.0f
@@ -110,13 +130,27 @@ static xQueueHandle gyroDataQueue;
 STATIC_MEM_QUEUE_ALLOC(gyroDataQueue, 1, sizeof(Axis3f));
 static xQueueHandle magnetometerDataQueue;
 STATIC_MEM_QUEUE_ALLOC(magnetometerDataQueue, 1, sizeof(Axis3f));
-static xQueueHandle barometerDataQueue;
-STATIC_MEM_QUEUE_ALLOC(barometerDataQueue, 1, sizeof(baro_t));
+
+/**
+ * The barometer is read by its own task and the result is published through
+ * a mailbox that is read without locking. The sequence number is odd while
+ * the mailbox is written, a reader that sees an odd or changed sequence number
+ * gives up and gets the sample on the next read instead.
+ */
+typedef struct {
+  uint32_t sequence;
+  baro_t baro;
+} baroMailbox_t;
+
+static volatile baroMailbox_t baroMailbox;
+static uint32_t baroMailboxReadSequence;
 
 static xSemaphoreHandle sensorsDataReady;
 static StaticSemaphore_t sensorsDataReadyBuffer;
 static xSemaphoreHandle dataReady;
 static StaticSemaphore_t dataReadyBuffer;
+static xSemaphoreHandle baroReadStart;
+static StaticSemaphore_t baroReadStartBuffer;
 
 static bool isInit = false;
 static sensorData_t sensorData;
@@ -124,6 +158,10 @@ static volatile uint64_t imuIntTimestamp;
 
 static Axis3i16 gyroRaw;
 static Axis3i16 accelRaw;
+#ifdef SENSORS_BMI088_GYRO_FIFO
+static uint8_t gyroFifoFrames;
+static uint32_t gyroFifoOverruns;
+#endif
 NO_DMA_CCM_SAFE_ZERO_INIT static BiasObj gyroBiasRunning;
 static Axis3f gyroBias;
 #if defined(SENSORS_GYRO_BIAS_CALCULATE_STDDEV) && defined (GYRO_BIAS_LIGHT_WEIGHT)
@@ -135,12 +173,51 @@ static float accScale = 1;
 static bool accScaleFound = false;
 static uint32_t accScaleSumCount = 0;
 
+// The gyro bias and accelerometer scale are stored when they have been measured and are used at the next start up
+// until they have been measured again, if the IMU temperature has not changed too much. This makes the system ready
+// to fly without waiting for the platform to be still, for instance after a battery swap.
+#define SENSORS_CALIB_STORAGE_KEY       "imu/cal"
+#define SENSORS_CALIB_VERSION           1
+#define SENSORS_CALIB_MAX_TEMP_DIFF     5.0f  // Degrees C
+#define SENSORS_CALIB_MAX_SCALE_DIFF    0.1f
+#define SENSORS_CALIB_STORE_BIAS_DIFF   1.0f  // LSB, smaller changes are not stored
+#define SENSORS_CALIB_STORE_SCALE_DIFF  0.001f
+#define SENSORS_CALIB_STORE_TEMP_DIFF   1.0f
+
+typedef struct {
+  uint8_t version;
+  Axis3f gyroBias;
+  float accScale;
+  float temperature;
+} __attribute__((packed)) storedCalibration_t;
+
+static storedCalibration_t storedCalibration;
+static bool isStoredCalibrationLoaded = false;
+static bool isStoredCalibrationUsed = false;
+static bool isCalibrationStored = false;
+
 // Low Pass filtering
 #define GYRO_LPF_CUTOFF_FREQ  80
 #define ACCEL_LPF_CUTOFF_FREQ 30
-static lpf2pData accLpf[3];
-static lpf2pData gyroLpf[3];
-static void applyAxis3fLpf(lpf2pData *data, Axis3f* in);
+static biquad3Data accLpf;
+static biquad3Data gyroLpf;
+
+// Notch filters for motor vibrations on the gyro, applied before the low pass filter. The notches are either at
+// fixed frequencies or track the motor speed estimated from the average motor PWM ratio, with the second notch at the
+// second harmonic.
+#define GYRO_NOTCH_COUNT           2
+#define GYRO_NOTCH_UPDATE_DIVIDER  10 // Update the notches at 100 Hz
+#define GYRO_NOTCH_MIN_FREQ        40.0f
+#define GYRO_NOTCH_MAX_FREQ        (0.45f * SENSORS_READ_RATE_HZ)
+static biquad3Data gyroNotch[GYRO_NOTCH_COUNT];
+static float gyroNotchFreq[GYRO_NOTCH_COUNT]; // Current notch frequencies, 0 when not active
+static float gyroNotchAppliedQ[GYRO_NOTCH_COUNT];
+// Parameters
+static float gyroNotchFixedFreq[GYRO_NOTCH_COUNT];
+static float gyroNotchQ = 3.0f;
+static float gyroNotchFullPwmFreq = 0.0f; // Frequency of the first notch at full motor PWM, 0 to use the fixed frequencies
+static void updateGyroNotch(void);
+static void applyGyroNotch(Axis3f* in);
 
 static bool isBarometerPresent = false;
 static uint8_t baroMeasDelayMin = SENSORS_DELAY_BARO;
@@ -157,6 +234,8 @@ static bool processGyroBiasNoBuffer(int16_t gx, int16_t gy, int16_t gz, Axis3f *
 static bool processGyroBias(int16_t gx, int16_t gy, int16_t gz,  Axis3f *gyroBiasOut);
 #endif
 static bool processAccScale(int16_t ax, int16_t ay, int16_t az);
+static void loadStoredCalibration(void);
+static void storeCalibration(void);
 static void sensorsBiasObjInit(BiasObj* bias);
 static void sensorsCalculateVarianceAndMean(BiasObj* bias, Axis3f* varOut, Axis3f* meanOut);
 static void sensorsCalculateBiasMean(BiasObj* bias, Axis3i32* meanOut);
@@ -165,6 +244,7 @@ static bool sensorsFindBiasValue(BiasObj* bias);
 static void sensorsAccAlignToGravity(Axis3f* in, Axis3f* out);
 
 STATIC_MEM_TASK_ALLOC(sensorsTask, SENSORS_TASK_STACKSIZE);
+STATIC_MEM_TASK_ALLOC(sensorsBaroTask, SENSORS_BARO_TASK_STACKSIZE);
 
 // Communication routines
 
@@ -226,6 +306,77 @@ static uint16_t sensorsGyroGet(Axis3i16* dataOut)
   return bmi088_get_gyro_data((struct bmi088_sensor_data*)dataOut, &bmi088Dev);
 }
 
+#ifdef SENSORS_BMI088_GYRO_FIFO
+static uint16_t sensorsGyroFifoInit(void)
+{
+  uint16_t rslt;
+  uint8_t data;
+
+  // Stream mode, x, y and z in the FIFO
+  data = BMI088_GYRO_STREAM_OP_MODE << BMI088_GYRO_FIFO_MODE_POS;
+  rslt = bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_1_REG, &data, 1, &bmi088Dev);
+  data = SENSORS_BMI088_GYRO_FIFO_WM;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_0_REG, &data, 1, &bmi088Dev);
+
+  // Enable the watermark interrupt and route it to INT3 instead of data ready
+  rslt |= bmi088_get_gyro_regs(BMI088_GYRO_INT_EN_REG, &data, 1, &bmi088Dev);
+  data |= BMI088_GYRO_INT_EN_MASK;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_INT_EN_REG, &data, 1, &bmi088Dev);
+  data = BMI088_GYRO_FIFO_EN_MASK;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_INT_CTRL_REG, &data, 1, &bmi088Dev);
+  data = BMI088_GYRO_INT1_FIFO_MASK;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_INT3_INT4_IO_MAP_REG, &data, 1, &bmi088Dev);
+
+  return rslt;
+}
+
+/*
+ * Drains the gyro FIFO and returns the average of the frames in it. The FIFO
+ * is always emptied, the watermark interrupt is level triggered and would not
+ * produce a new edge if frames were left behind.
+ */
+static uint16_t sensorsGyroFifoGet(Axis3i16* dataOut)
+{
+  uint8_t buffer[SENSORS_BMI088_GYRO_FIFO_BURST * SENSORS_BMI088_GYRO_FRAME_SIZE];
+  int32_t sum[GYRO_NBR_OF_AXES] = {0};
+  uint8_t status = 0;
+  uint16_t rslt;
+
+  rslt = bmi088_get_gyro_regs(BMI088_GYRO_FIFO_STAT_REG, &status, 1, &bmi088Dev);
+  if (status & BMI088_GYRO_FIFO_OVERRUN_MASK)
+  {
+    gyroFifoOverruns++;
+  }
+
+  uint8_t frames = status & BMI088_GYRO_FIFO_COUNTER_MASK;
+  uint8_t remaining = frames;
+  while (rslt == BMI088_OK && remaining > 0)
+  {
+    uint8_t burst = remaining < SENSORS_BMI088_GYRO_FIFO_BURST ? remaining : SENSORS_BMI088_GYRO_FIFO_BURST;
+    rslt = bmi088_get_gyro_regs(BMI088_GYRO_FIFO_DATA_REG, buffer, burst * SENSORS_BMI088_GYRO_FRAME_SIZE, &bmi088Dev);
+    for (int i = 0; i < burst; i++)
+    {
+      const uint8_t* frame = &buffer[i * SENSORS_BMI088_GYRO_FRAME_SIZE];
+      for (int axis = 0; axis < GYRO_NBR_OF_AXES; axis++)
+      {
+        sum[axis] += (int16_t)((frame[2 * axis + 1] << 8) | frame[2 * axis]);
+      }
+    }
+    remaining -= burst;
+  }
+
+  gyroFifoFrames = frames;
+  if (rslt == BMI088_OK && frames > 0)
+  {
+    dataOut->x = sum[0] / frames;
+    dataOut->y = sum[1] / frames;
+    dataOut->z = sum[2] / frames;
+  }
+
+  return rslt;
+}
+#endif
+
 static void sensorsAccelGet(Axis3i16* dataOut)
 {
   bmi088_get_accel_data((struct bmi088_sensor_data*)dataOut, &bmi088Dev);
@@ -257,7 +408,33 @@ bool sensorsBmi088Bmp388ReadMag(Axis3f *mag)
 
 bool sensorsBmi088Bmp388ReadBaro(baro_t *baro)
 {
-  return (pdTRUE == xQueueReceive(barometerDataQueue, baro, 0));
+  const uint32_t sequence = baroMailbox.sequence;
+  if ((sequence & 1) || sequence == baroMailboxReadSequence)
+  {
+    return false;
+  }
+
+  __DMB();
+  baro_t result = baroMailbox.baro;
+  __DMB();
+
+  if (baroMailbox.sequence != sequence)
+  {
+    return false;
+  }
+
+  *baro = result;
+  baroMailboxReadSequence = sequence;
+  return true;
+}
+
+static void publishBaro(const baro_t *baro)
+{
+  baroMailbox.sequence++;
+  __DMB();
+  baroMailbox.baro = *baro;
+  __DMB();
+  baroMailbox.sequence++;
 }
 
 void sensorsBmi088Bmp388Acquire(sensorData_t *sensors, const uint32_t tick)
@@ -279,7 +456,7 @@ static void sensorsTask(void *param)
   systemWaitStart();
 
   Axis3f accScaled;
-  measurement_t measurement;
+  measurement_t measurement = {.captureTick = 0};
   /* wait an additional second the keep bus free
    * this is only required by the z-ranger, since the
    * configuration will be done after system start-up */
@@ -291,27 +468,45 @@ static void sensorsTask(void *param)
       sensorData.interruptTimestamp = imuIntTimestamp;
 
       /* get data from chosen sensors */
+#ifdef SENSORS_BMI088_GYRO_FIFO
+      sensorsGyroFifoGet(&gyroRaw);
+#else
       sensorsGyroGet(&gyroRaw);
+#endif
       sensorsAccelGet(&accelRaw);
 
-      /* calibrate if necessary */
+      /* calibrate if necessary, a stored calibration is used until a new one has been measured */
+      static Axis3f measuredGyroBias;
 #ifdef GYRO_BIAS_LIGHT_WEIGHT
-      gyroBiasFound = processGyroBiasNoBuffer(gyroRaw.x, gyroRaw.y, gyroRaw.z, &gyroBias);
+      bool isGyroBiasMeasured = processGyroBiasNoBuffer(gyroRaw.x, gyroRaw.y, gyroRaw.z, &measuredGyroBias);
 #else
-      gyroBiasFound = processGyroBias(gyroRaw.x, gyroRaw.y, gyroRaw.z, &gyroBias);
+      bool isGyroBiasMeasured = processGyroBias(gyroRaw.x, gyroRaw.y, gyroRaw.z, &measuredGyroBias);
 #endif
-      if (gyroBiasFound)
+      if (isGyroBiasMeasured)
       {
-         processAccScale(accelRaw.x, accelRaw.y, accelRaw.z);
+        gyroBias = measuredGyroBias;
+        gyroBiasFound = true;
+        if (processAccScale(accelRaw.x, accelRaw.y, accelRaw.z) && !isCalibrationStored)
+        {
+          storeCalibration();
+        }
       }
       /* Gyro */
       sensorData.gyro.x =  (gyroRaw.x - gyroBias.x) * SENSORS_BMI088_DEG_PER_LSB_CFG;
       sensorData.gyro.y =  (gyroRaw.y - gyroBias.y) * SENSORS_BMI088_DEG_PER_LSB_CFG;
       sensorData.gyro.z =  (gyroRaw.z - gyroBias.z) * SENSORS_BMI088_DEG_PER_LSB_CFG;
-      applyAxis3fLpf((lpf2pData*)(&gyroLpf), &sensorData.gyro);
+      static uint8_t notchUpdateDelay = GYRO_NOTCH_UPDATE_DIVIDER;
+      if (--notchUpdateDelay == 0)
+      {
+        updateGyroNotch();
+        notchUpdateDelay = GYRO_NOTCH_UPDATE_DIVIDER;
+      }
+      applyGyroNotch(&sensorData.gyro);
+      biquad3Apply(&gyroLpf, sensorData.gyro.axis);
 
       measurement.type = MeasurementTypeGyroscope;
       measurement.data.gyroscope.gyro = sensorData.gyro;
+      measurement.data.gyroscope.timestamp = sensorData.interruptTimestamp;
       estimatorEnqueue(&measurement);
 
       /* Accelerometer */
@@ -319,38 +514,27 @@ static void sensorsTask(void *param)
       accScaled.y = accelRaw.y * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
       accScaled.z = accelRaw.z * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
       sensorsAccAlignToGravity(&accScaled, &sensorData.acc);
-      applyAxis3fLpf((lpf2pData*)(&accLpf), &sensorData.acc);
+      biquad3Apply(&accLpf, sensorData.acc.axis);
 
       measurement.type = MeasurementTypeAcceleration;
       measurement.data.acceleration.acc = sensorData.acc;
+      measurement.data.acceleration.timestamp = sensorData.interruptTimestamp;
       estimatorEnqueue(&measurement);
     }
 
+    xQueueOverwrite(accelerometerDataQueue, &sensorData.acc);
+    xQueueOverwrite(gyroDataQueue, &sensorData.gyro);
+
     if (isBarometerPresent)
     {
       static uint8_t baroMeasDelay = SENSORS_DELAY_BARO;
       if (--baroMeasDelay == 0)
       {
-        uint8_t sensor_comp = BMP3_PRESS | BMP3_TEMP;
-        struct bmp3_data data;
-        baro_t* baro388 = &sensorData.baro;
-        /* Temperature and Pressure data are read and stored in the bmp3_data instance */
-        bmp3_get_sensor_data(sensor_comp, &data, &bmp388Dev);
-        sensorsScaleBaro(baro388, data.pressure, data.temperature);
-
-        measurement.type = MeasurementTypeBarometer;
-        measurement.data.barometer.baro = sensorData.baro;
-        estimatorEnqueue(&measurement);
-
+        /* The IMU sample is done, the baro read fits before the next one */
+        xSemaphoreGive(baroReadStart);
         baroMeasDelay = baroMeasDelayMin;
       }
     }
-    xQueueOverwrite(accelerometerDataQueue, &sensorData.acc);
-    xQueueOverwrite(gyroDataQueue, &sensorData.gyro);
-    if (isBarometerPresent)
-    {
-      xQueueOverwrite(barometerDataQueue, &sensorData.baro);
-    }
 
     xSemaphoreGive(dataReady);
   }
@@ -388,9 +572,9 @@ static void sensorsDeviceInit(void)
     bmi088Dev.gyro_cfg.power = BMI088_GYRO_PM_NORMAL;
     rslt |= bmi088_set_gyro_power_mode(&bmi088Dev);
     /* set bandwidth and range of gyro */
-    bmi088Dev.gyro_cfg.bw = BMI088_GYRO_BW_116_ODR_1000_HZ;
+    bmi088Dev.gyro_cfg.bw = SENSORS_BMI088_GYRO_BW_ODR_CFG;
     bmi088Dev.gyro_cfg.range = SENSORS_BMI088_GYRO_FS_CFG;
-    bmi088Dev.gyro_cfg.odr = BMI088_GYRO_BW_116_ODR_1000_HZ;
+    bmi088Dev.gyro_cfg.odr = SENSORS_BMI088_GYRO_BW_ODR_CFG;
     rslt |= bmi088_set_gyro_meas_conf(&bmi088Dev);
 
     intConfig.gyro_int_channel = BMI088_INT_CHANNEL_3;
@@ -400,6 +584,9 @@ static void sensorsDeviceInit(void)
     intConfig.gyro_int_pin_3_cfg.output_mode = 0;
     /* Setting the interrupt configuration */
     rslt = bmi088_set_gyro_int_config(&intConfig, &bmi088Dev);
+#ifdef SENSORS_BMI088_GYRO_FIFO
+    rslt |= sensorsGyroFifoInit();
+#endif
 
     bmi088Dev.delay_ms(50);
     struct bmi088_sensor_data gyr;
@@ -506,11 +693,10 @@ static void sensorsDeviceInit(void)
   }
 
   // Init second order filer for accelerometer and gyro
-  for (uint8_t i = 0; i < 3; i++)
-  {
-    lpf2pInit(&gyroLpf[i], 1000, GYRO_LPF_CUTOFF_FREQ);
-    lpf2pInit(&accLpf[i],  1000, ACCEL_LPF_CUTOFF_FREQ);
-  }
+  biquad3InitLpf(&gyroLpf, 1000, GYRO_LPF_CUTOFF_FREQ);
+  biquad3InitLpf(&accLpf,  1000, ACCEL_LPF_CUTOFF_FREQ);
+
+  loadStoredCalibration();
 
   cosPitch = cosf(configblockGetCalibPitch() * (float) M_PI / 180);
   sinPitch = sinf(configblockGetCalibPitch() * (float) M_PI / 180);
@@ -520,14 +706,46 @@ static void sensorsDeviceInit(void)
   isInit = true;
 }
 
+/*
+ * Reads the barometer outside of the IMU loop. The sensors task starts a read
+ * right after it is done with an IMU sample, this task runs at a lower
+ * priority and does the bus transaction in the time left until the next one.
+ */
+static void sensorsBaroTask(void *param)
+{
+  systemWaitStart();
+
+  measurement_t measurement = {.captureTick = 0};
+  baro_t baro;
+
+  while (1)
+  {
+    xSemaphoreTake(baroReadStart, portMAX_DELAY);
+
+    uint8_t sensor_comp = BMP3_PRESS | BMP3_TEMP;
+    struct bmp3_data data;
+    /* Temperature and Pressure data are read and stored in the bmp3_data instance */
+    if (bmp3_get_sensor_data(sensor_comp, &data, &bmp388Dev) == BMP3_OK)
+    {
+      sensorsScaleBaro(&baro, data.pressure, data.temperature);
+      publishBaro(&baro);
+
+      measurement.type = MeasurementTypeBarometer;
+      measurement.data.barometer.baro = baro;
+      estimatorEnqueue(&measurement);
+    }
+  }
+}
+
 static void sensorsTaskInit(void)
 {
   accelerometerDataQueue = STATIC_MEM_QUEUE_CREATE(accelerometerDataQueue);
   gyroDataQueue = STATIC_MEM_QUEUE_CREATE(gyroDataQueue);
   magnetometerDataQueue = STATIC_MEM_QUEUE_CREATE(magnetometerDataQueue);
-  barometerDataQueue = STATIC_MEM_QUEUE_CREATE(barometerDataQueue);
+  baroReadStart = xSemaphoreCreateBinaryStatic(&baroReadStartBuffer);
 
   STATIC_MEM_TASK_CREATE(sensorsTask, sensorsTask, SENSORS_TASK_NAME, NULL, SENSORS_TASK_PRI);
+  STATIC_MEM_TASK_CREATE(sensorsBaroTask, sensorsBaroTask, SENSORS_BARO_TASK_NAME, NULL, SENSORS_BARO_TASK_PRI);
 }
 
 static void sensorsInterruptInit(void)
@@ -659,6 +877,82 @@ static bool processAccScale(int16_t ax, int16_t ay, int16_t az)
   return accScaleFound;
 }
 
+static bool isStoredCalibrationValid(const storedCalibration_t* calibration)
+{
+  return calibration->version == SENSORS_CALIB_VERSION &&
+         isfinite(calibration->gyroBias.x) && isfinite(calibration->gyroBias.y) && isfinite(calibration->gyroBias.z) &&
+         fabsf(calibration->accScale - 1.0f) < SENSORS_CALIB_MAX_SCALE_DIFF;
+}
+
+/**
+ * Applies the stored calibration if it was made at about the current IMU temperature
+ */
+static void loadStoredCalibration(void)
+{
+  float temperature;
+  if (bmi088_get_sensor_temperature(&bmi088Dev, &temperature) != BMI088_OK)
+  {
+    return;
+  }
+
+  const size_t fetched = storageFetch(SENSORS_CALIB_STORAGE_KEY, &storedCalibration, sizeof(storedCalibration));
+  if (fetched != sizeof(storedCalibration) || !isStoredCalibrationValid(&storedCalibration))
+  {
+    return;
+  }
+  isStoredCalibrationLoaded = true;
+
+  if (fabsf(temperature - storedCalibration.temperature) < SENSORS_CALIB_MAX_TEMP_DIFF)
+  {
+    gyroBias = storedCalibration.gyroBias;
+    accScale = storedCalibration.accScale;
+    gyroBiasFound = true;
+    isStoredCalibrationUsed = true;
+    DEBUG_PRINT("Using stored IMU calibration\n");
+  }
+}
+
+static void storeCalibrationWorker(void* data)
+{
+  storedCalibration_t* calibration = (storedCalibration_t*)data;
+  if (!storageStore(SENSORS_CALIB_STORAGE_KEY, calibration, sizeof(*calibration)))
+  {
+    DEBUG_PRINT("Failed to store IMU calibration\n");
+  }
+}
+
+/**
+ * Stores a newly measured calibration, unless it is about the same as the stored one. Called from the sensors
+ * task, the storage is written by the worker.
+ */
+static void storeCalibration(void)
+{
+  isCalibrationStored = true;
+
+  float temperature;
+  if (bmi088_get_sensor_temperature(&bmi088Dev, &temperature) != BMI088_OK)
+  {
+    return;
+  }
+
+  if (isStoredCalibrationLoaded &&
+      fabsf(gyroBias.x - storedCalibration.gyroBias.x) < SENSORS_CALIB_STORE_BIAS_DIFF &&
+      fabsf(gyroBias.y - storedCalibration.gyroBias.y) < SENSORS_CALIB_STORE_BIAS_DIFF &&
+      fabsf(gyroBias.z - storedCalibration.gyroBias.z) < SENSORS_CALIB_STORE_BIAS_DIFF &&
+      fabsf(accScale - storedCalibration.accScale) < SENSORS_CALIB_STORE_SCALE_DIFF &&
+      fabsf(temperature - storedCalibration.temperature) < SENSORS_CALIB_STORE_TEMP_DIFF)
+  {
+    return;
+  }
+
+  storedCalibration.version = SENSORS_CALIB_VERSION;
+  storedCalibration.gyroBias = gyroBias;
+  storedCalibration.accScale = accScale;
+  storedCalibration.temperature = temperature;
+  isStoredCalibrationLoaded = true;
+  workerScheduleWithPriority(workerPriorityLow, storeCalibrationWorker, &storedCalibration);
+}
+
 #ifdef GYRO_BIAS_LIGHT_WEIGHT
 
 #define SENSORS_BIAS_SAMPLES       1000
@@ -897,10 +1191,7 @@ void sensorsBmi088Bmp388SetAccMode(accModes accMode)
       {
         DEBUG_PRINT("ACC config [FAIL]\n");
       }
-      for (uint8_t i = 0; i < 3; i++)
-      {
-        lpf2pInit(&accLpf[i],  1000, 500);
-      }
+      biquad3InitLpf(&accLpf,  1000, 500);
       break;
     case ACC_MODE_FLIGHT:
     default:
@@ -912,18 +1203,54 @@ void sensorsBmi088Bmp388SetAccMode(accModes accMode)
       {
         DEBUG_PRINT("ACC config [FAIL]\n");
       }
-      for (uint8_t i = 0; i < 3; i++)
-      {
-        lpf2pInit(&accLpf[i],  1000, ACCEL_LPF_CUTOFF_FREQ);
-      }
+      biquad3InitLpf(&accLpf,  1000, ACCEL_LPF_CUTOFF_FREQ);
       break;
   }
 }
 
-static void applyAxis3fLpf(lpf2pData *data, Axis3f* in)
+static void updateGyroNotch(void)
 {
-  for (uint8_t i = 0; i < 3; i++) {
-    in->axis[i] = lpf2pApply(&data[i], in->axis[i]);
+  float motorFreq = 0.0f;
+  if (gyroNotchFullPwmFreq > 0.0f)
+  {
+    uint32_t ratioSum = 0;
+    for (int i = 0; i < NBR_OF_MOTORS; i++)
+    {
+      ratioSum += motorsGetRatio(i);
+    }
+    motorFreq = gyroNotchFullPwmFreq * ratioSum / (NBR_OF_MOTORS * (float)UINT16_MAX);
+  }
+
+  for (int i = 0; i < GYRO_NOTCH_COUNT; i++)
+  {
+    const float freq = (gyroNotchFullPwmFreq > 0.0f) ? motorFreq * (i + 1) : gyroNotchFixedFreq[i];
+    if (freq < GYRO_NOTCH_MIN_FREQ || freq > GYRO_NOTCH_MAX_FREQ || gyroNotchQ <= 0.0f)
+    {
+      gyroNotchFreq[i] = 0.0f;
+    }
+    else if (gyroNotchFreq[i] == 0.0f)
+    {
+      biquad3InitNotch(&gyroNotch[i], SENSORS_READ_RATE_HZ, freq, gyroNotchQ);
+      gyroNotchFreq[i] = freq;
+      gyroNotchAppliedQ[i] = gyroNotchQ;
+    }
+    else if (fabsf(freq - gyroNotchFreq[i]) > 0.5f || gyroNotchQ != gyroNotchAppliedQ[i])
+    {
+      biquad3SetNotchFreq(&gyroNotch[i], SENSORS_READ_RATE_HZ, freq, gyroNotchQ);
+      gyroNotchFreq[i] = freq;
+      gyroNotchAppliedQ[i] = gyroNotchQ;
+    }
+  }
+}
+
+static void applyGyroNotch(Axis3f* in)
+{
+  for (int i = 0; i < GYRO_NOTCH_COUNT; i++)
+  {
+    if (gyroNotchFreq[i] > 0.0f)
+    {
+      biquad3Apply(&gyroNotch[i], in->axis);
+    }
   }
 }
 
@@ -947,9 +1274,29 @@ LOG_ADD(LOG_INT16, zRaw, &gyroRaw.z)
 LOG_ADD(LOG_FLOAT, xVariance, &gyroBiasRunning.variance.x)
 LOG_ADD(LOG_FLOAT, yVariance, &gyroBiasRunning.variance.y)
 LOG_ADD(LOG_FLOAT, zVariance, &gyroBiasRunning.variance.z)
+LOG_ADD(LOG_FLOAT, notch1, &gyroNotchFreq[0])
+LOG_ADD(LOG_FLOAT, notch2, &gyroNotchFreq[1])
+#ifdef SENSORS_BMI088_GYRO_FIFO
+LOG_ADD(LOG_UINT8, fifoFrames, &gyroFifoFrames)
+LOG_ADD(LOG_UINT32, fifoOverrun, &gyroFifoOverruns)
+#endif
 LOG_GROUP_STOP(gyro)
 #endif
 
 PARAM_GROUP_START(imu_sensors)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, BMP388, &isBarometerPresent)
+PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, storedCalib, &isStoredCalibrationUsed)
 PARAM_GROUP_STOP(imu_sensors)
+
+/**
+ * Notch filters on the gyro for motor vibrations. Set fullPwmHz to the
+ * vibration frequency at full motor PWM to let the notches follow the motor
+ * speed, or use the fixed frequencies f1 and f2. A frequency of 0 disables
+ * the notch.
+ */
+PARAM_GROUP_START(gyroNotch)
+PARAM_ADD(PARAM_FLOAT, f1, &gyroNotchFixedFreq[0])
+PARAM_ADD(PARAM_FLOAT, f2, &gyroNotchFixedFreq[1])
+PARAM_ADD(PARAM_FLOAT, q, &gyroNotchQ)
+PARAM_ADD(PARAM_FLOAT, fullPwmHz, &gyroNotchFullPwmFreq)
+PARAM_GROUP_STOP(gyroNotch)
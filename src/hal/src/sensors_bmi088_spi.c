@@ -301,6 +301,9 @@ static void spiDMAInit(void)
   DMA_InitTypeDef  DMA_InitStructure;
   NVIC_InitTypeDef NVIC_InitStructure;
 
+  ASSERT_DMA_SAFE(spiTxBuffer);
+  ASSERT_DMA_SAFE(spiRxBuffer);
+
   /*!< Enable DMA Clocks */
   BMI088_SPI_DMA_CLK_INIT(BMI088_SPI_DMA_CLK, ENABLE);
 
@@ -485,7 +485,7 @@ sensorsAccelCalibrate(BiasObj* accel, BiasObj* gyro, uint8_t type) {
 
 static void sensorsTask(void *param)
 {
-  measurement_t measurement;
+  measurement_t measurement = {.captureTick = 0};
 
   systemWaitStart();
 
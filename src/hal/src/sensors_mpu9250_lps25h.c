@@ -212,7 +212,7 @@ bool sensorsMpu9250Lps25hAreCalibrated() {
 
 static void sensorsTask(void *param)
 {
-  measurement_t measurement;
+  measurement_t measurement = {.captureTick = 0};
 
   systemWaitStart();
 
@@ -243,11 +243,13 @@ static void sensorsTask(void *param)
 
       measurement.type = MeasurementTypeAcceleration;
       measurement.data.acceleration.acc = sensorData.acc;
+      measurement.data.acceleration.timestamp = sensorData.interruptTimestamp;
       estimatorEnqueue(&measurement);
       xQueueOverwrite(accelerometerDataQueue, &sensorData.acc);
 
       measurement.type = MeasurementTypeGyroscope;
       measurement.data.gyroscope.gyro = sensorData.gyro;
+      measurement.data.gyroscope.timestamp = sensorData.interruptTimestamp;
       estimatorEnqueue(&measurement);
       xQueueOverwrite(gyroDataQueue, &sensorData.gyro);
       if (isMagnetometerPresent)
@@ -0,0 +1,384 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sensors_sim.c - Simulated sensors for software in the loop
+ */
+
+#define DEBUG_MODULE "IMU"
+
+#include "sensors_sim.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "queue.h"
+#include "task.h"
+
+#include "config.h"
+#include "system.h"
+#include "log.h"
+#include "debug.h"
+#include "static_mem.h"
+#include "estimator.h"
+#include "usec_time.h"
+
+static xQueueHandle accelerometerDataQueue;
+STATIC_MEM_QUEUE_ALLOC(accelerometerDataQueue, 1, sizeof(Axis3f));
+static xQueueHandle gyroDataQueue;
+STATIC_MEM_QUEUE_ALLOC(gyroDataQueue, 1, sizeof(Axis3f));
+static xQueueHandle magnetometerDataQueue;
+STATIC_MEM_QUEUE_ALLOC(magnetometerDataQueue, 1, sizeof(Axis3f));
+static xQueueHandle barometerDataQueue;
+STATIC_MEM_QUEUE_ALLOC(barometerDataQueue, 1, sizeof(baro_t));
+
+static xSemaphoreHandle dataReady;
+static StaticSemaphore_t dataReadyBuffer;
+
+static volatile bool isWaitingForData = false;
+static volatile uint64_t lastTimestamp;
+static uint32_t feedCount = 0;
+static bool isInit = false;
+
+// Host stream injection
+#define INJECT_QUEUE_LENGTH 32
+#define INJECT_MAX_SIZE 29
+#define INJECT_HEADER_SIZE (1 + sizeof(uint32_t))
+
+typedef struct {
+  uint8_t size;
+  uint8_t data[INJECT_MAX_SIZE];
+} injectPacket_t;
+
+static xQueueHandle injectQueue;
+STATIC_MEM_QUEUE_ALLOC(injectQueue, INJECT_QUEUE_LENGTH, sizeof(injectPacket_t));
+
+static void injectTask(void *param);
+STATIC_MEM_TASK_ALLOC(injectTask, SENSORS_SIM_INJECT_TASK_STACKSIZE);
+
+static uint32_t injectDropped = 0;
+static uint32_t injectLate = 0;
+static int32_t injectLagUs = 0;
+
+void sensorsSimInit(void)
+{
+  if (isInit)
+  {
+    return;
+  }
+
+  accelerometerDataQueue = STATIC_MEM_QUEUE_CREATE(accelerometerDataQueue);
+  gyroDataQueue = STATIC_MEM_QUEUE_CREATE(gyroDataQueue);
+  magnetometerDataQueue = STATIC_MEM_QUEUE_CREATE(magnetometerDataQueue);
+  barometerDataQueue = STATIC_MEM_QUEUE_CREATE(barometerDataQueue);
+  dataReady = xSemaphoreCreateBinaryStatic(&dataReadyBuffer);
+  injectQueue = STATIC_MEM_QUEUE_CREATE(injectQueue);
+
+  STATIC_MEM_TASK_CREATE(injectTask, injectTask, SENSORS_SIM_INJECT_TASK_NAME, NULL, SENSORS_SIM_INJECT_TASK_PRI);
+
+  DEBUG_PRINT("Simulated sensors, waiting for samples\n");
+
+  isInit = true;
+}
+
+bool sensorsSimTest(void)
+{
+  return isInit;
+}
+
+bool sensorsSimAreCalibrated(void)
+{
+  // The simulation provides bias free samples
+  return true;
+}
+
+bool sensorsSimManufacturingTest(void)
+{
+  return true;
+}
+
+void sensorsSimAcquire(sensorData_t *sensors, const uint32_t tick)
+{
+  sensorsReadGyro(&sensors->gyro);
+  sensorsReadAcc(&sensors->acc);
+  sensorsReadMag(&sensors->mag);
+  sensorsReadBaro(&sensors->baro);
+  sensors->interruptTimestamp = lastTimestamp;
+}
+
+void sensorsSimWaitDataReady(void)
+{
+  isWaitingForData = true;
+  xSemaphoreTake(dataReady, portMAX_DELAY);
+  isWaitingForData = false;
+}
+
+bool sensorsSimReadGyro(Axis3f *gyro)
+{
+  return (pdTRUE == xQueueReceive(gyroDataQueue, gyro, 0));
+}
+
+bool sensorsSimReadAcc(Axis3f *acc)
+{
+  return (pdTRUE == xQueueReceive(accelerometerDataQueue, acc, 0));
+}
+
+bool sensorsSimReadMag(Axis3f *mag)
+{
+  return (pdTRUE == xQueueReceive(magnetometerDataQueue, mag, 0));
+}
+
+bool sensorsSimReadBaro(baro_t *baro)
+{
+  return (pdTRUE == xQueueReceive(barometerDataQueue, baro, 0));
+}
+
+void sensorsSimSetAccMode(accModes accMode)
+{
+  // No filters to configure, the simulation decides the noise
+}
+
+void sensorsSimDataAvailableCallback(void)
+{
+  // There is no data ready interrupt, samples arrive through sensorsSimFeed()
+}
+
+void sensorsSimFeed(const sensorsSimSample_t *sample)
+{
+  measurement_t measurement = {.captureTick = 0};
+
+  lastTimestamp = sample->timestamp;
+
+  measurement.type = MeasurementTypeGyroscope;
+  measurement.data.gyroscope.gyro = sample->gyro;
+  measurement.data.gyroscope.timestamp = sample->timestamp;
+  estimatorEnqueue(&measurement);
+
+  measurement.type = MeasurementTypeAcceleration;
+  measurement.data.acceleration.acc = sample->acc;
+  measurement.data.acceleration.timestamp = sample->timestamp;
+  estimatorEnqueue(&measurement);
+
+  xQueueOverwrite(accelerometerDataQueue, &sample->acc);
+  xQueueOverwrite(gyroDataQueue, &sample->gyro);
+
+  if (sample->hasMag)
+  {
+    xQueueOverwrite(magnetometerDataQueue, &sample->mag);
+  }
+
+  if (sample->hasBaro)
+  {
+    xQueueOverwrite(barometerDataQueue, &sample->baro);
+
+    measurement.type = MeasurementTypeBarometer;
+    measurement.data.barometer.baro = sample->baro;
+    estimatorEnqueue(&measurement);
+  }
+
+  feedCount++;
+  xSemaphoreGive(dataReady);
+}
+
+bool sensorsSimIsWaitingForData(void)
+{
+  return isWaitingForData;
+}
+
+void sensorsSimInjectPacket(const uint8_t *data, const uint8_t size)
+{
+  if (!isInit || size < INJECT_HEADER_SIZE || size > INJECT_MAX_SIZE)
+  {
+    return;
+  }
+
+  injectPacket_t packet = {.size = size};
+  memcpy(packet.data, data, size);
+
+  // The host is expected to keep the stream a few samples ahead of the target, a full queue means it is too far ahead
+  if (pdTRUE != xQueueSend(injectQueue, &packet, 0))
+  {
+    injectDropped++;
+  }
+}
+
+static float injectFloat(const injectPacket_t *packet, const int index)
+{
+  float value = 0.0f;
+  const int offset = INJECT_HEADER_SIZE + index * sizeof(float);
+  if (offset + (int)sizeof(float) <= packet->size)
+  {
+    memcpy(&value, &packet->data[offset], sizeof(float));
+  }
+
+  return value;
+}
+
+/**
+ * Waits until the time of a sample. The time of the first sample after start or a reset is mapped to the current
+ * time, the following samples are released with the same spacing as in the stream. The task sleeps until the tick
+ * of the sample and spins on the microsecond timer for the remainder, which is short when the sample period is a
+ * multiple of the tick.
+ */
+static uint64_t injectWaitUntil(const uint32_t streamTimestamp, bool *isStarted)
+{
+  static uint32_t firstStreamTimestamp;
+  static uint64_t startTime;
+
+  if (!*isStarted)
+  {
+    firstStreamTimestamp = streamTimestamp;
+    startTime = usecTimestamp();
+    *isStarted = true;
+  }
+
+  const uint64_t releaseTime = startTime + (uint32_t)(streamTimestamp - firstStreamTimestamp);
+  const uint64_t now = usecTimestamp();
+  if (now > releaseTime)
+  {
+    injectLate++;
+    injectLagUs = (int32_t)(now - releaseTime);
+    return releaseTime;
+  }
+
+  const uint32_t sleepMs = (uint32_t)(releaseTime - now) / 1000;
+  if (sleepMs > 0)
+  {
+    vTaskDelay(M2T(sleepMs));
+  }
+
+  while (usecTimestamp() < releaseTime)
+  {
+    // Sub tick remainder
+  }
+
+  injectLagUs = (int32_t)(usecTimestamp() - releaseTime);
+  return releaseTime;
+}
+
+static void injectTask(void *param)
+{
+  systemWaitStart();
+
+  injectPacket_t packet;
+  sensorsSimSample_t sample = {};
+  bool hasTof = false;
+  tofMeasurement_t tof = {};
+  bool hasFlow = false;
+  flowMeasurement_t flow = {};
+  bool isStarted = false;
+  uint32_t streamTimestamp;
+
+  while (1)
+  {
+    xQueueReceive(injectQueue, &packet, portMAX_DELAY);
+
+    switch (packet.data[0])
+    {
+      case SENSORS_SIM_INJECT_IMU:
+        for (int i = 0; i < 3; i++)
+        {
+          sample.acc.axis[i] = injectFloat(&packet, i);
+          sample.gyro.axis[i] = injectFloat(&packet, 3 + i);
+        }
+        memcpy(&streamTimestamp, &packet.data[1], sizeof(streamTimestamp));
+        sample.timestamp = injectWaitUntil(streamTimestamp, &isStarted);
+
+        // Deck measurements are enqueued before the IMU sample, as they would have been by the deck drivers
+        if (hasTof)
+        {
+          tof.timestamp = T2M(xTaskGetTickCount());
+          estimatorEnqueueTOF(&tof);
+          hasTof = false;
+        }
+        if (hasFlow)
+        {
+          flow.timestamp = T2M(xTaskGetTickCount());
+          estimatorEnqueueFlowCapturedAt(&flow, 0);
+          hasFlow = false;
+        }
+
+        sensorsSimFeed(&sample);
+        sample.hasBaro = false;
+        sample.hasMag = false;
+        break;
+      case SENSORS_SIM_INJECT_BARO:
+        sample.baro.pressure = injectFloat(&packet, 0);
+        sample.baro.temperature = injectFloat(&packet, 1);
+        sample.baro.asl = injectFloat(&packet, 2);
+        sample.hasBaro = true;
+        break;
+      case SENSORS_SIM_INJECT_MAG:
+        for (int i = 0; i < 3; i++)
+        {
+          sample.mag.axis[i] = injectFloat(&packet, i);
+        }
+        sample.hasMag = true;
+        break;
+      case SENSORS_SIM_INJECT_TOF:
+        tof.distance = injectFloat(&packet, 0);
+        tof.stdDev = injectFloat(&packet, 1);
+        hasTof = true;
+        break;
+      case SENSORS_SIM_INJECT_FLOW:
+        flow.dpixelx = injectFloat(&packet, 0);
+        flow.dpixely = injectFloat(&packet, 1);
+        flow.stdDevX = injectFloat(&packet, 2);
+        flow.stdDevY = injectFloat(&packet, 3);
+        flow.dt = injectFloat(&packet, 4);
+        hasFlow = true;
+        break;
+      case SENSORS_SIM_INJECT_RESET:
+        isStarted = false;
+        hasTof = false;
+        hasFlow = false;
+        sample.hasBaro = false;
+        sample.hasMag = false;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**
+ * Simulated sensors
+ */
+LOG_GROUP_START(simSensors)
+/**
+ * @brief Number of samples fed by the simulation
+ */
+LOG_ADD(LOG_UINT32, feedCount, &feedCount)
+/**
+ * @brief Number of injected packets dropped because the queue was full
+ */
+LOG_ADD(LOG_UINT32, injDrop, &injectDropped)
+/**
+ * @brief Number of injected IMU samples that arrived after their release time
+ */
+LOG_ADD(LOG_UINT32, injLate, &injectLate)
+/**
+ * @brief Release time error of the last injected IMU sample [us]
+ */
+LOG_ADD(LOG_INT32, injLagUs, &injectLagUs)
+LOG_GROUP_STOP(simSensors)
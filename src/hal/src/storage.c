@@ -26,15 +26,22 @@
  *
  */
 
+#include <string.h>
+
 #include "storage.h"
 
 #include "kve/kve.h"
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "timers.h"
 
 #include "i2cdev.h"
 #include "eeprom.h"
+#include "worker.h"
+#include "usec_time.h"
+#include "static_mem.h"
+#include "log.h"
 
 #define TRACE_MEMORY_ACCESS 0
 
@@ -51,15 +58,72 @@
 #define KVE_PARTITION_START (1024)
 #define KVE_PARTITION_LENGTH (7*1024)
 
+// Index of the items in RAM, the memory is scanned if there are more items
+#define KVE_INDEX_SIZE 128
+
+// Read ahead while the table is walked at boot. The check and the index build
+// read a few bytes per item, the cache turns them into long sequential reads.
+#define READ_AHEAD_SIZE 256
+
+// Background compaction, about this many bytes are moved per period
+#define COMPACT_PERIOD M2T(1000)
+#define COMPACT_BUDGET 64
+
 static SemaphoreHandle_t storageMutex;
 
+NO_DMA_CCM_SAFE_ZERO_INIT static kveIndexEntry_t kveIndexEntries[KVE_INDEX_SIZE];
+static kveIndex_t kveIndex = {
+  .entries = kveIndexEntries,
+  .size = KVE_INDEX_SIZE,
+};
+
+static xTimerHandle compactTimer;
+static StaticTimer_t compactTimerBuffer;
+// Set when holes may have been created, cleared when the table is compact
+static bool compactPending = true;
+
+static uint8_t readAheadBuffer[READ_AHEAD_SIZE];
+static size_t readAheadAddress;
+static size_t readAheadLength;
+static bool isReadAheadEnabled = false;
+
+// Result of the table check in storageInit(), the test does not walk the table again
+static bool isCheckedAtInit = false;
+
+// Latency stats [us]
+static uint32_t fetchTime;
+static uint32_t fetchTimeMax;
+static uint32_t storeTime;
+static uint32_t storeTimeMax;
+static uint32_t compactTime;
+static uint32_t compactTimeMax;
+
 static size_t readEeprom(size_t address, void* data, size_t length)
 {
   if (length == 0) {
     return 0;
   }
 
-  bool success = eepromReadBuffer(data, KVE_PARTITION_START + address, length);
+  bool success;
+  if (isReadAheadEnabled && length <= READ_AHEAD_SIZE && address + length <= KVE_PARTITION_LENGTH) {
+    if (address < readAheadAddress || address + length > readAheadAddress + readAheadLength) {
+      size_t fillLength = KVE_PARTITION_LENGTH - address;
+      if (fillLength > READ_AHEAD_SIZE) {
+        fillLength = READ_AHEAD_SIZE;
+      }
+
+      success = eepromReadBuffer(readAheadBuffer, KVE_PARTITION_START + address, fillLength);
+      readAheadAddress = address;
+      readAheadLength = success ? fillLength : 0;
+    }
+
+    success = (readAheadLength > 0);
+    if (success) {
+      memcpy(data, &readAheadBuffer[address - readAheadAddress], length);
+    }
+  } else {
+    success = eepromReadBuffer(data, KVE_PARTITION_START + address, length);
+  }
 
 #if TRACE_MEMORY_ACCESS
   DEBUG_PRINT("R %s @%04x l%d: ", success?" OK ":"FAIL", address, length);
@@ -84,6 +148,9 @@ static size_t writeEeprom(size_t address, const void* data, size_t length)
     return 0;
   }
 
+  // The read ahead data is not updated, it is only used while nothing is written
+  readAheadLength = 0;
+
   bool success = eepromWriteBuffer(data, KVE_PARTITION_START + address, length);
 
 #if TRACE_MEMORY_ACCESS
@@ -113,8 +180,41 @@ static kveMemory_t kve = {
   .read = readEeprom,
   .write = writeEeprom,
   .flush = flushEeprom,
+  .index = &kveIndex,
 };
 
+static uint32_t updateTime(uint64_t start, uint32_t* time, uint32_t* timeMax)
+{
+  *time = (uint32_t)(usecTimestamp() - start);
+  if (*time > *timeMax) {
+    *timeMax = *time;
+  }
+
+  return *time;
+}
+
+static void storageCompact(void* arg)
+{
+  if (!compactPending) {
+    return;
+  }
+
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+
+  const uint64_t start = usecTimestamp();
+  compactPending = kveDefragStep(&kve, COMPACT_BUDGET);
+  updateTime(start, &compactTime, &compactTimeMax);
+
+  xSemaphoreGive(storageMutex);
+}
+
+static void compactTimerCallback(xTimerHandle timer)
+{
+  if (compactPending) {
+    workerScheduleWithPriority(workerPriorityLow, storageCompact, NULL);
+  }
+}
+
 // Public API
 
 static bool isInit = false;
@@ -123,12 +223,25 @@ void storageInit()
 {
   storageMutex = xSemaphoreCreateMutex();
 
+  // Only a healthy table can be walked, otherwise storageTest() formats it
+  isReadAheadEnabled = true;
+  isCheckedAtInit = kveCheck(&kve);
+  if (isCheckedAtInit) {
+    kveIndexBuild(&kve);
+  }
+  isReadAheadEnabled = false;
+  readAheadLength = 0;
+
+  compactTimer = xTimerCreateStatic("storageTimer", COMPACT_PERIOD, pdTRUE, NULL,
+    compactTimerCallback, &compactTimerBuffer);
+  xTimerStart(compactTimer, 100);
+
   isInit = true;
 }
 
 bool storageTest()
 {
-  bool pass = kveCheck(&kve);
+  bool pass = isCheckedAtInit || kveCheck(&kve);
 
   DEBUG_PRINT("Storage check %s.\n", pass?"[OK]":"[FAIL]");
 
@@ -138,6 +251,7 @@ bool storageTest()
     kveFormat(&kve);
 
     pass = kveCheck(&kve);
+    kveIndexBuild(&kve);
     DEBUG_PRINT("Storage check %s.\n", pass?"[OK]":"[FAIL]");
 
     if (pass == false) {
@@ -156,7 +270,11 @@ bool storageStore(char* key, const void* buffer, size_t length)
 
   xSemaphoreTake(storageMutex, portMAX_DELAY);
 
+  const uint64_t start = usecTimestamp();
   bool result = kveStore(&kve, key, buffer, length);
+  updateTime(start, &storeTime, &storeTimeMax);
+  // A replaced item of another size leaves a hole
+  compactPending = true;
 
   xSemaphoreGive(storageMutex);
 
@@ -171,7 +289,9 @@ size_t storageFetch(char *key, void* buffer, size_t length)
 
   xSemaphoreTake(storageMutex, portMAX_DELAY);
 
+  const uint64_t start = usecTimestamp();
   size_t result = kveFetch(&kve, key, buffer, length);
+  updateTime(start, &fetchTime, &fetchTimeMax);
 
   xSemaphoreGive(storageMutex);
 
@@ -187,8 +307,56 @@ bool storageDelete(char* key)
   xSemaphoreTake(storageMutex, portMAX_DELAY);
 
   bool result = kveDelete(&kve, key);
+  compactPending = true;
 
   xSemaphoreGive(storageMutex);
 
   return result;
 }
+
+void storageForeach(const char* prefix, void* buffer, size_t length, storageFunc_t func)
+{
+  if (!isInit) {
+    return;
+  }
+
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+
+  kveForeach(&kve, prefix, buffer, length, func);
+
+  xSemaphoreGive(storageMutex);
+}
+
+/**
+ * Latency of the persistent storage in the EEPROM
+ */
+LOG_GROUP_START(storage)
+/**
+ * @brief Duration of the latest fetch [us]
+ */
+LOG_ADD(LOG_UINT32, fetch, &fetchTime)
+/**
+ * @brief Maximum duration of a fetch since startup [us]
+ */
+LOG_ADD(LOG_UINT32, fetchMax, &fetchTimeMax)
+/**
+ * @brief Duration of the latest store [us]
+ */
+LOG_ADD(LOG_UINT32, store, &storeTime)
+/**
+ * @brief Maximum duration of a store since startup, including defragmentation when the memory is full [us]
+ */
+LOG_ADD(LOG_UINT32, storeMax, &storeTimeMax)
+/**
+ * @brief Duration of the latest background compaction step [us]
+ */
+LOG_ADD(LOG_UINT32, compact, &compactTime)
+/**
+ * @brief Maximum duration of a background compaction step since startup [us]
+ */
+LOG_ADD(LOG_UINT32, compactMax, &compactTimeMax)
+/**
+ * @brief 1 if the index of the items in RAM is used, 0 if the memory is scanned
+ */
+LOG_ADD(LOG_UINT8, indexed, &kveIndex.valid)
+LOG_GROUP_STOP(storage)
@@ -135,11 +135,14 @@ bool syslinkTest()
   return isInit;
 }
 
-int syslinkSendPacket(SyslinkPacket *slp)
+/* Frames a packet and queues it for the UART. Returns false if there was no
+ * room in the UART tx queue within the wait time. */
+static bool syslinkSend(SyslinkPacket *slp, uint32_t wait)
 {
   int i = 0;
   int dataSize;
   uint8_t cksum[2] = {0};
+  bool result = true;
 
   xSemaphoreTake(syslinkAccess, portMAX_DELAY);
 
@@ -170,20 +173,32 @@ int syslinkSendPacket(SyslinkPacket *slp)
     uart2SendDataDmaBlocking(dataSize, sendBuffer);
     break;
   case SYSLINK_PM_GROUP:
-    uartslkSendDataDmaBlocking(dataSize, sendBuffer);
+    result = uartslkEnqueueDataDma(dataSize, sendBuffer, wait);
     break;
   case SYSLINK_OW_GROUP:
-    uartslkSendDataDmaBlocking(dataSize, sendBuffer);
+    result = uartslkEnqueueDataDma(dataSize, sendBuffer, wait);
     break;
   default:
     DEBUG_PRINT("Unknown packet:%X.\n", slp->type);
     break;
   }
   #else
-  uartslkSendDataDmaBlocking(dataSize, sendBuffer);
+  result = uartslkEnqueueDataDma(dataSize, sendBuffer, wait);
   #endif
 
   xSemaphoreGive(syslinkAccess);
 
+  return result;
+}
+
+int syslinkSendPacket(SyslinkPacket *slp)
+{
+  syslinkSend(slp, portMAX_DELAY);
+
   return 0;
 }
+
+bool syslinkTrySendPacket(SyslinkPacket *slp)
+{
+  return syslinkSend(slp, 0);
+}
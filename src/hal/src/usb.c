@@ -37,13 +37,14 @@
 
 #include "config.h"
 #include "usblink.h"
-#include "radiolink.h"
+#include "comm.h"
 #include "usb.h"
 
 #include "usbd_usr.h"
 #include "usb_conf.h"
 #include "usbd_desc.h"
 #include "usb_dcd.h"
+#include "usbd_ioreq.h"
 
 #include "crtp.h"
 #include "static_mem.h"
@@ -59,7 +60,7 @@ static bool rxStopped = true;
 static xQueueHandle usbDataRx;
 STATIC_MEM_QUEUE_ALLOC(usbDataRx, 5, sizeof(USBPacket)); /* Buffer USB packets (max 64 bytes) */
 static xQueueHandle usbDataTx;
-STATIC_MEM_QUEUE_ALLOC(usbDataTx, 1, sizeof(USBPacket)); /* Buffer USB packets (max 64 bytes) */
+STATIC_MEM_QUEUE_ALLOC(usbDataTx, 8, sizeof(USBPacket)); /* Buffer USB packets (max 64 bytes) */
 
 /* Endpoints */
 #define IN_EP                       0x81  /* EP1 for data IN */
@@ -117,6 +118,16 @@ static uint8_t usbd_cf_Setup        (void *pdev , USB_SETUP_REQ  *req);
 
 static USBPacket inPacket;
 static USBPacket outPacket;
+static USBPacket nextOutPacket;
+
+// Vendor request wIndex values sent by the host
+#define USB_CRTP_DISABLE 0x00
+#define USB_CRTP_ENABLE  0x01
+#define USB_CRTP_ENABLE_PACKED 0x02
+// Vendor request to read the protocol version, 2 adds packed mode
+#define USB_REQ_GET_VERSION 0x02
+#define USB_CRTP_PROTOCOL_VERSION 2
+static bool packedMode = false;
 
 /* CDC interface class callbacks structure */
 USBD_Class_cb_TypeDef cf_usb_cb =
@@ -147,10 +158,21 @@ USBD_Usr_cb_TypeDef USR_cb =
 
 int command = 0xFF;
 
+/* USB replaces the default link, or with CRTP_BENCH_LINK it is used next to
+ * it for the ports in crtp.benchPorts */
+static void usbSetCrtpLink(const bool enable)
+{
+#ifdef CRTP_BENCH_LINK
+  crtpSetBenchLink(enable ? usblinkGetLink() : NULL);
+#else
+  crtpSetLink(enable ? usblinkGetLink() : commGetDefaultLink());
+#endif
+}
+
 static void resetUSB(void) {
   portBASE_TYPE xTaskWokenByReceive = pdFALSE;
 
-  crtpSetLink(radiolinkGetLink());
+  usbSetCrtpLink(false);
 
   if (isInit == true) {
     // Empty queue
@@ -162,13 +184,46 @@ static void resetUSB(void) {
 
   rxStopped = true;
   doingTransfer = false;
+  packedMode = false;
+}
+
+/* Takes the next transfer from the tx queue. In packed mode the queued
+ * packets that fit are appended to the same transfer. */
+static bool takeOutPacketFromISR(portBASE_TYPE* xTaskWokenByReceive)
+{
+  if (xQueueReceiveFromISR(usbDataTx, &outPacket, xTaskWokenByReceive) != pdTRUE)
+  {
+    return false;
+  }
+
+  while (packedMode &&
+         xQueuePeekFromISR(usbDataTx, &nextOutPacket) == pdTRUE &&
+         outPacket.size + nextOutPacket.size <= USB_RX_TX_PACKET_SIZE)
+  {
+    xQueueReceiveFromISR(usbDataTx, &nextOutPacket, xTaskWokenByReceive);
+    memcpy(&outPacket.data[outPacket.size], nextOutPacket.data, nextOutPacket.size);
+    outPacket.size += nextOutPacket.size;
+  }
+
+  return true;
 }
 
 static uint8_t usbd_cf_Setup(void *pdev , USB_SETUP_REQ  *req)
 {
+  // The host reads the protocol version to find out if packed mode is
+  // supported. Older firmware handles the request as a CRTP enable and sends
+  // no data, so the host sends it with wIndex set to USB_CRTP_ENABLE.
+  if ((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_VENDOR &&
+      (req->bmRequest & 0x80) && req->bRequest == USB_REQ_GET_VERSION) {
+    static uint8_t version = USB_CRTP_PROTOCOL_VERSION;
+    USBD_CtlSendData(pdev, &version, 1);
+    return USBD_OK;
+  }
+
   command = req->wIndex;
-  if (command == 0x01) {
-    crtpSetLink(usblinkGetLink());
+  if (command == USB_CRTP_ENABLE || command == USB_CRTP_ENABLE_PACKED) {
+    packedMode = (command == USB_CRTP_ENABLE_PACKED);
+    usbSetCrtpLink(true);
 
     if (rxStopped && !xQueueIsQueueFullFromISR(usbDataRx)) {
       DCD_EP_PrepareRx(&USB_OTG_dev,
@@ -178,7 +233,7 @@ static uint8_t usbd_cf_Setup(void *pdev , USB_SETUP_REQ  *req)
       rxStopped = false;
     }
   } else {
-    crtpSetLink(radiolinkGetLink());
+    usbSetCrtpLink(false);
   }
 
   return USBD_OK;
@@ -241,7 +296,7 @@ static uint8_t  usbd_cf_DataIn (void *pdev, uint8_t epnum)
 
   doingTransfer = false;
 
-  if (xQueueReceiveFromISR(usbDataTx, &outPacket, &xTaskWokenByReceive) == pdTRUE)
+  if (takeOutPacketFromISR(&xTaskWokenByReceive))
   {
     doingTransfer = true;
     DCD_EP_Tx (pdev,
@@ -260,7 +315,7 @@ static uint8_t  usbd_cf_SOF (void *pdev)
   portBASE_TYPE xTaskWokenByReceive = pdFALSE;
 
   if (!doingTransfer) {
-    if (xQueueReceiveFromISR(usbDataTx, &outPacket, &xTaskWokenByReceive) == pdTRUE)
+    if (takeOutPacketFromISR(&xTaskWokenByReceive))
     {
       doingTransfer = true;
       DCD_EP_Tx (pdev,
@@ -360,7 +415,7 @@ void USBD_USR_DeviceConfigured(void)
 */
 void USBD_USR_DeviceSuspended(void)
 {
-  /* USB communication suspended (probably USB unplugged). Switch back to radiolink */
+  /* USB communication suspended (probably USB unplugged). Switch back to the default link */
   resetUSB();
 }
 
@@ -445,3 +500,8 @@ bool usbSendData(uint32_t size, uint8_t* data)
   // Dont' block when sending
   return (xQueueSend(usbDataTx, &outStage, M2T(100)) == pdTRUE);
 }
+
+bool usbIsPackedMode(void)
+{
+  return packedMode;
+}
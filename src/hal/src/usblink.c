@@ -67,16 +67,47 @@ static struct crtpLinkOperations usblinkOp =
  */
 static USBPacket usbIn;
 static CRTPPacket p;
+
+/* In packed mode a transfer holds CRTP packets each prefixed with the length
+ * of the header and data. Parsing stops at a length of 0 or one that does not
+ * fit, the rest of the transfer is dropped. */
+static void usblinkUnpack(const USBPacket* usbPacket)
+{
+  uint8_t index = 0;
+
+  while (index < usbPacket->size)
+  {
+    const uint8_t length = usbPacket->data[index];
+    if (length == 0 || length > CRTP_MAX_DATA_SIZE + 1 || index + 1 + length > usbPacket->size)
+    {
+      break;
+    }
+
+    p.size = length - 1;
+    memcpy(&p.raw, &usbPacket->data[index + 1], length);
+    xQueueSend(crtpPacketDelivery, &p, portMAX_DELAY);
+
+    index += 1 + length;
+  }
+}
 static void usblinkTask(void *param)
 {
   while(1)
   {
     // Fetch a USB packet off the queue
     usbGetDataBlocking(&usbIn);
-    p.size = usbIn.size - 1;
-    memcpy(&p.raw, usbIn.data, usbIn.size);
-    // This queuing will copy a CRTP packet size from usbIn
-    xQueueSend(crtpPacketDelivery, &p, portMAX_DELAY);
+
+    if (usbIsPackedMode())
+    {
+      usblinkUnpack(&usbIn);
+    }
+    else
+    {
+      p.size = usbIn.size - 1;
+      memcpy(&p.raw, usbIn.data, usbIn.size);
+      // This queuing will copy a CRTP packet size from usbIn
+      xQueueSend(crtpPacketDelivery, &p, portMAX_DELAY);
+    }
   }
 
 }
@@ -98,13 +129,16 @@ static int usblinkSendPacket(CRTPPacket *p)
 
   ASSERT(p->size < SYSLINK_MTU);
 
-  sendBuffer[0] = p->header;
+  // In packed mode the USB driver appends queued packets to the same transfer
+  const int offset = usbIsPackedMode() ? 1 : 0;
+  sendBuffer[0] = p->size + 1;
+  sendBuffer[offset] = p->header;
 
   if (p->size <= CRTP_MAX_DATA_SIZE)
   {
-    memcpy(&sendBuffer[1], p->data, p->size);
+    memcpy(&sendBuffer[offset + 1], p->data, p->size);
   }
-  dataSize = p->size + 1;
+  dataSize = p->size + 1 + offset;
 
 
   ledseqRun(&seq_linkDown);
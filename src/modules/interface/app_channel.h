@@ -33,6 +33,22 @@
 #define APPCHANNEL_WAIT_FOREVER (-1)
 #define APPCHANNEL_MTU (31)
 
+/**
+ * Number of packets that can be waiting in the receive queue. Can be set
+ * from the app Makefile with APPCHANNEL_RX_QUEUE_LENGTH.
+ */
+#ifndef APPCHANNEL_RX_QUEUE_LENGTH
+#define APPCHANNEL_RX_QUEUE_LENGTH (10)
+#endif
+
+/**
+ * Largest message that can be received with appchannelReceiveMessage(). Can be
+ * set from the app Makefile with APPCHANNEL_MESSAGE_MAX_SIZE.
+ */
+#ifndef APPCHANNEL_MESSAGE_MAX_SIZE
+#define APPCHANNEL_MESSAGE_MAX_SIZE (256)
+#endif
+
 /**
  * Send an app-channel packet
  * 
@@ -81,6 +97,62 @@ size_t appchannelReceivePacket(void* buffer, size_t max_length, int timeout_ms);
  */
 bool appchannelHasOverflowOccured();
 
+/**
+ * Receive an app-channel packet without copying it
+ *
+ * The packet stays in the receive queue buffer and data is set to point to it.
+ * The buffer must be handed back with appchannelReleasePacketBuffer() when the
+ * app is done with it, until then it can not be used to receive new packets.
+ *
+ * @param data Set to point to the packet content, or NULL if no packet has been received
+ * @param timeout_ms Time to wait for a packet in millisecond, see appchannelReceivePacket()
+ * @return 0 if no packet has been received. The data length of the packet received.
+ *
+ * \app_api
+ */
+size_t appchannelReceivePacketBuffer(const void** data, int timeout_ms);
+
+/**
+ * Release a packet buffer received with appchannelReceivePacketBuffer()
+ *
+ * @param data The pointer returned by appchannelReceivePacketBuffer()
+ *
+ * \app_api
+ */
+void appchannelReleasePacketBuffer(const void* data);
+
+/**
+ * Send an app-channel message
+ *
+ * Messages can be longer than APPCHANNEL_MTU, they are split in fragments that
+ * are sent on a separate CRTP channel. Each fragment starts with a header byte
+ * where bit 7 marks the first fragment, bit 6 the last fragment and bits 0-5
+ * are a sequence number.
+ *
+ * This function blocks in the same way as appchannelSendPacket().
+ *
+ * @param data Pointer to the data buffer to be sent
+ * @param length Length of the data buffer to send
+ *
+ * \app_api
+ */
+void appchannelSendMessage(void* data, size_t length);
+
+/**
+ * Receive an app-channel message
+ *
+ * Messages are reassembled from fragments, a message where a fragment has been
+ * lost is dropped. Messages longer than APPCHANNEL_MESSAGE_MAX_SIZE are dropped.
+ *
+ * @param buffer Data buffer where the message content will be copied
+ * @param max_length Maximum length of the data to be received, ie. length of the data buffer
+ * @param timeout_ms Time to wait for a message in millisecond, see appchannelReceivePacket()
+ * @return 0 if no message has been received. The data length of the message received.
+ *
+ * \app_api
+ */
+size_t appchannelReceiveMessage(void* buffer, size_t max_length, int timeout_ms);
+
 
 // Function declared bellow are private to the Crazyflie firmware and
 // should not be called from an app
@@ -94,3 +166,8 @@ void appchannelInit();
  * 
  */
 void appchannelIncomingPacket(CRTPPacket *p);
+
+/**
+ *
+ */
+void appchannelIncomingFragment(CRTPPacket *p);
@@ -0,0 +1,92 @@
+/*
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * LPS node firmware.
+ *
+ * Copyright 2021, Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* app_hook.h: App hooks run in the stabilizer loop */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stabilizer_types.h"
+
+#define APP_HOOK_MAX_COUNT (4)
+
+// A hook that exceeds its budget this many times in a row is disabled
+#define APP_HOOK_OVERRUN_LIMIT (3)
+
+/**
+ * App hook function
+ *
+ * Called from the stabilizer task, after the motors have been updated. The state
+ * and sensor data are the ones used by the controller in the same tick, they are
+ * only valid during the call and must not be modified.
+ *
+ * A hook must not block. It must return within the budget given when it was
+ * registered, see appHookRegister().
+ *
+ * @param state The current state estimate
+ * @param sensorData The current sensor data
+ * @param tick The stabilizer tick
+ */
+typedef void (*appHook_t)(const state_t *state, const sensorData_t *sensorData, const uint32_t tick);
+
+/**
+ * Register a hook that is run in the stabilizer loop
+ *
+ * The hook is run on the ticks where RATE_DO_EXECUTE_WITH_PHASE(rate, phase, tick)
+ * is true, see stabilizer_types.h. The rate must divide RATE_MAIN_LOOP.
+ *
+ * The execution time of every call is measured with the cycle counter. A call
+ * that takes longer than budget_us is an overrun, and the hook is disabled after
+ * APP_HOOK_OVERRUN_LIMIT overruns in a row. The statistics are available in the
+ * appHook log group.
+ *
+ * @param hook The function to call
+ * @param rate Rate in Hz, RATE_MAIN_LOOP to run on every tick
+ * @param phase Tick within the period where the hook is run
+ * @param budget_us The longest time a call is allowed to take, in micro seconds
+ * @return The id of the hook, or -1 if the hook could not be registered
+ *
+ * \app_api
+ */
+int appHookRegister(appHook_t hook, uint16_t rate, uint16_t phase, uint32_t budget_us);
+
+/**
+ * Check if a hook is still enabled
+ *
+ * @param id The id returned by appHookRegister()
+ * @return false if the hook has been disabled for overrunning its budget
+ *
+ * \app_api
+ */
+bool appHookIsEnabled(int id);
+
+
+// Function declared bellow are private to the Crazyflie firmware and
+// should not be called from an app
+
+/**
+ * Run the hooks that are due in this tick, called from the stabilizer loop
+ */
+void appHookRun(const state_t *state, const sensorData_t *sensorData, const uint32_t tick);
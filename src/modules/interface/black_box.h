@@ -0,0 +1,38 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * black_box.h - Crash recorder in the internal flash, readable through the memory subsystem
+ */
+
+#ifndef __BLACK_BOX_H__
+#define __BLACK_BOX_H__
+
+/**
+ * @brief Starts the black box recorder and registers its memory with the memory subsystem
+ *
+ * Called early in the system init, the cause of the reset is read before the
+ * start up tests clear it.
+ */
+void blackBoxInit(void);
+
+#endif // __BLACK_BOX_H__
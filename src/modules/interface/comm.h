@@ -27,7 +27,16 @@
 #ifndef __COMM_H__
 #define __COMM_H__
 
+#include <stdbool.h>
+#include "crtp.h"
+
 void commInit(void);
 bool commTest(void);
 
+/**
+ * The link CRTP uses when no other link has been selected, the radio link or the RTT link if built with
+ * CRTP_OVER_SEGGER_RTT. The USB link falls back to this link when it is disabled.
+ */
+struct crtpLinkOperations * commGetDefaultLink(void);
+
 #endif //__COMM_H__
@@ -46,6 +46,14 @@ uint32_t commanderGetInactivityTime(void);
 void commanderSetSetpoint(setpoint_t *setpoint, int priority);
 int commanderGetActivePriority(void);
 
+/* Set a setpoint that is time stamped with the sender time, in ms, in its
+ * timestamp field. Timed setpoints are buffered and played out on the local
+ * clock a short delay after they are due, interpolating between them, to
+ * absorb the jitter of the radio link. Setting a plain setpoint stops the
+ * play out.
+ */
+void commanderSetTimedSetpoint(setpoint_t *setpoint, int priority);
+
 /* Inform the commander that streaming setpoints are about to stop.
  * Parameter controls the amount of time the last setpoint will remain valid.
  * This gives the PC time to send the next command, e.g. with the high-level
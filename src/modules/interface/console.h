@@ -51,12 +51,21 @@ int consolePutchar(int ch);
  * @param ch character that shall be printed
  * @return The character casted to unsigned int or EOF in case of error
  *
- * @note This version can be called by interrup. In such case the internal
- * buffer is going to be used. If a task currently is printing or if the
- * interrupts prints too much the data will be ignored.
+ * @note This version can be called by interrup. If the console buffer is
+ * full the data will be ignored.
  */
 int consolePutcharFromISR(int ch);
 
+/**
+ * Write characters to the console buffer. The call does not block, the
+ * characters that do not fit in the buffer are dropped.
+ *
+ * @param data Characters that shall be printed
+ * @param len Number of characters
+ * @return The number of characters written, including dropped ones
+ */
+int consoleWrite(const char* data, int len);
+
 /**
  * Put a null-terminated string on the console buffer
  *
@@ -66,7 +75,8 @@ int consolePutcharFromISR(int ch);
 int consolePuts(char *str);
 
 /**
- * Flush the console buffer
+ * Wake up the task that sends the console buffer, does not wait for the
+ * buffer to be sent
  */
 void consoleFlush(void);
 
@@ -76,6 +86,6 @@ void consoleFlush(void);
  * @param FMT String format
  * @patam ... Parameters to print
  */
-#define consolePrintf(FMT, ...) eprintf(consolePutchar, FMT, ## __VA_ARGS__)
+#define consolePrintf(FMT, ...) ebprintf(consoleWrite, FMT, ## __VA_ARGS__)
 
 #endif /*CONSOLE_H_*/
@@ -36,12 +36,41 @@ typedef enum {
   ControllerType_COUNT,
 } ControllerType;
 
+/**
+ * With CONTROLLER_STATIC=1 in the build, only the controller set by CONTROLLER
+ * is built and controller() calls it directly, rather than through the table of
+ * controllers. The controller can then not be changed at runtime.
+ */
+#if defined(CONTROLLER_STATIC_PID)
+  #include "controller_pid.h"
+  #define CONTROLLER_STATIC_TYPE ControllerTypePID
+  #define CONTROLLER_STATIC_UPDATE controllerPid
+#elif defined(CONTROLLER_STATIC_MELLINGER)
+  #include "controller_mellinger.h"
+  #define CONTROLLER_STATIC_TYPE ControllerTypeMellinger
+  #define CONTROLLER_STATIC_UPDATE controllerMellinger
+#elif defined(CONTROLLER_STATIC_INDI)
+  #include "controller_indi.h"
+  #define CONTROLLER_STATIC_TYPE ControllerTypeINDI
+  #define CONTROLLER_STATIC_UPDATE controllerINDI
+#endif
+
 void controllerInit(ControllerType controller);
 bool controllerTest(void);
+#ifdef CONTROLLER_STATIC_UPDATE
+static inline void controller(control_t *control, setpoint_t *setpoint,
+                                         const sensorData_t *sensors,
+                                         const state_t *state,
+                                         const uint32_t tick)
+{
+  CONTROLLER_STATIC_UPDATE(control, setpoint, sensors, state, tick);
+}
+#else
 void controller(control_t *control, setpoint_t *setpoint,
                                          const sensorData_t *sensors,
                                          const state_t *state,
                                          const uint32_t tick);
+#endif
 ControllerType getControllerType(void);
 const char* controllerGetName();
 
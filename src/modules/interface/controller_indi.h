@@ -88,6 +88,7 @@ struct IndiVariables {
   Butterworth2LowPass rate[3];
   struct FloatRates g1;
   float g2;
+  struct FloatRates g1_inv; ///< 1/g1 for p and q, 1/(g1 - g2) for r, updated when g1 or g2 changes
 
   struct ReferenceSystem reference_acceleration;
   struct FloatRates act_dyn;
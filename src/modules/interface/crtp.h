@@ -45,6 +45,7 @@ typedef enum {
   CRTP_PORT_LOCALIZATION     = 0x06,
   CRTP_PORT_SETPOINT_GENERIC = 0x07,
   CRTP_PORT_SETPOINT_HL      = 0x08,
+  CRTP_PORT_EVENTTRIGGER     = 0x0A,
   CRTP_PORT_PLATFORM         = 0x0D,
   CRTP_PORT_LINK             = 0x0F,
 } CRTPPort;
@@ -146,6 +147,31 @@ int crtpReceivePacketWait(CRTPPort taskId, CRTPPacket *p, int wait);
  */
 int crtpGetFreeTxQueuePackets(void);
 
+/**
+ * Get the number of free tx packets in the queue used by a port. Ports of
+ * the same traffic class share a queue.
+ *
+ * @param[in] portId The CRTP port
+ * @return Number of free packets
+ */
+int crtpGetFreeTxQueuePacketsForPort(CRTPPort portId);
+
+/**
+ * Get the average time the packets sent in the latest statistics interval
+ * (500 ms) waited in the tx queues.
+ *
+ * @return Time in ms
+ */
+uint16_t crtpGetTxQueueTime(void);
+
+/**
+ * Limit the bandwidth a port uses while packets of other ports are waiting.
+ *
+ * @param[in] portId The CRTP port
+ * @param[in] bytesPerSecond The budget, including the header, 0 for no limit
+ */
+void crtpSetTxBudget(CRTPPort portId, uint16_t bytesPerSecond);
+
 /**
  * Wait for a packet to arrive for the specified taskID
  *
@@ -171,6 +197,16 @@ struct crtpLinkOperations
 
 void crtpSetLink(struct crtpLinkOperations * lk);
 
+/**
+ * Set the bench link, a link that is active at the same time as the link set
+ * with crtpSetLink(). The ports in the crtp.benchPorts parameter are sent on
+ * the bench link while it is set. Only available in builds with
+ * CRTP_BENCH_LINK.
+ *
+ * @param lk The bench link, NULL to send all ports on the primary link again
+ */
+void crtpSetBenchLink(struct crtpLinkOperations * lk);
+
 /**
  * Check if the connection timeout has been reached, otherwise
  * we will assume that we are connected.
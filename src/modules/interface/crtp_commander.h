@@ -32,6 +32,13 @@
 
 void crtpCommanderInit(void);
 void crtpCommanderRpytDecodeSetpoint(setpoint_t *setpoint, CRTPPacket *pk);
-void crtpCommanderGenericDecodeSetpoint(setpoint_t *setpoint, CRTPPacket *pk);
+
+typedef enum {
+  genericSetpointNone = 0,  // The packet carries no setpoint for this Crazyflie
+  genericSetpointPlain,
+  genericSetpointTimed,     // Time stamped with the sender time in the timestamp field, see commanderSetTimedSetpoint()
+} genericSetpointKind_t;
+
+genericSetpointKind_t crtpCommanderGenericDecodeSetpoint(setpoint_t *setpoint, CRTPPacket *pk);
 
 #endif /* CRTP_COMMANDER_H_ */
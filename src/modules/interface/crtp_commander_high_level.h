@@ -179,6 +179,22 @@ bool crtpCommanderHighLevelIsTrajectoryDefined(uint8_t trajectoryId);
  */
 int crtpCommanderHighLevelStartTrajectory(const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed);
 
+/**
+ * @brief starts executing a specified trajectory at a swarm time, all the
+ * Crazyflies of a swarm start at the same instant regardless of when the
+ * command was received. Cancelled by stop and land.
+ *
+ * @param trajectoryId id of the trajectory (previously defined by define_trajectory)
+ * @param timeScale    time factor; 1.0 = original speed;
+ *                                  >1.0: slower;
+ *                                  <1.0: faster
+ * @param relative     set to True, if trajectory should be shifted to current setpoint
+ * @param reversed     set to True, if trajectory should be executed in reverse
+ * @param startTime    swarm time [us] to start at, see timesync.h
+ * @return zero if the command succeeded, EAGAIN if the swarm time is not known
+ */
+int crtpCommanderHighLevelStartTrajectoryAt(const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed, const uint64_t startTime);
+
 /**
  * @brief Define a trajectory that has previously been uploaded to memory.
  *
@@ -190,6 +206,18 @@ int crtpCommanderHighLevelStartTrajectory(const uint8_t trajectoryId, const floa
  */
 int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crtpCommanderTrajectoryType_t type, const uint32_t offset, const uint8_t nPieces);
 
+/**
+ * @brief Define a streaming trajectory, a ring of pages in the trajectory memory
+ *        that is appended to through the MEM_TYPE_TRAJ_STREAM memory while it
+ *        is flown. The stream is reset, there is one stream at a time.
+ *
+ * @param trajectoryId  The id of the trajectory
+ * @param offset        offset of the ring in the trajectory memory (bytes)
+ * @param piecesPerPage Nr of poly4d pieces in a page
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelDefineStreamTrajectory(const uint8_t trajectoryId, const uint32_t offset, const uint8_t piecesPerPage);
+
 /**
  * @brief Get the size of the allocated trajectory memory
  *
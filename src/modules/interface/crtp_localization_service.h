@@ -50,6 +50,19 @@ struct CrtpExtPose
   float qw;
 } __attribute__((packed));
 
+/**
+ * Sample of an EXT_POSE_TIMESTAMPED packet, up to 2 samples per packet,
+ * oldest first
+ */
+struct CrtpExtPoseTimestamped
+{
+  uint32_t timestamp; // capture time in swarm time, lower 32 bits, in us
+  int16_t x; // in mm
+  int16_t y; // in mm
+  int16_t z; // in mm
+  uint32_t quat; // compressed quaternion, see quatcompress.h
+} __attribute__((packed));
+
 typedef enum
 {
   RANGE_STREAM_FLOAT      = 0,
@@ -63,6 +76,10 @@ typedef enum
   EXT_POSE_PACKED          = 9,
   LH_ANGLE_STREAM          = 10,
   LH_PERSIST_DATA          = 11,
+  LH_ANGLE_STREAM_COMPACT  = 12,
+  SENSOR_INJECT            = 13,
+  TIME_SYNC_BEACON         = 14,
+  EXT_POSE_TIMESTAMPED     = 15,
 } locsrv_t;
 
 // Set up the callback for the CRTP_PORT_LOCALIZATION
@@ -47,11 +47,16 @@ typedef enum {
   MeasurementTypeGyroscope,
   MeasurementTypeAcceleration,
   MeasurementTypeBarometer,
+  MeasurementTypeTDOABatch,
+  MeasurementTypeCount,
 } MeasurementType;
 
 typedef struct
 {
   MeasurementType type;
+  // The tick when the measurement was captured. 0 means that the measurement was captured when enqueued.
+  // Estimators that support it use this to fuse measurements that arrive late at the correct time.
+  uint32_t captureTick;
   union
   {
     tdoaMeasurement_t tdoa;
@@ -66,6 +71,7 @@ typedef struct
     gyroscopeMeasurement_t gyroscope;
     accelerationMeasurement_t acceleration;
     barometerMeasurement_t barometer;
+    tdoaBatchMeasurement_t tdoaBatch;
   } data;
 } measurement_t;
 
@@ -84,14 +90,25 @@ static inline void estimatorEnqueueTDOA(const tdoaMeasurement_t *tdoa)
 {
   measurement_t m;
   m.type = MeasurementTypeTDOA;
+  m.captureTick = 0;
   m.data.tdoa = *tdoa;
   estimatorEnqueue(&m);
 }
 
+static inline void estimatorEnqueueTDOABatch(const tdoaBatchMeasurement_t *tdoaBatch)
+{
+  measurement_t m;
+  m.type = MeasurementTypeTDOABatch;
+  m.captureTick = 0;
+  m.data.tdoaBatch = *tdoaBatch;
+  estimatorEnqueue(&m);
+}
+
 static inline void estimatorEnqueuePosition(const positionMeasurement_t *position)
 {
   measurement_t m;
   m.type = MeasurementTypePosition;
+  m.captureTick = 0;
   m.data.position = *position;
   estimatorEnqueue(&m);
 }
@@ -100,14 +117,44 @@ static inline void estimatorEnqueuePose(const poseMeasurement_t *pose)
 {
   measurement_t m;
   m.type = MeasurementTypePose;
+  m.captureTick = 0;
   m.data.pose = *pose;
   estimatorEnqueue(&m);
 }
 
+// Enqueue measurements that were captured at an earlier point in time
+static inline void estimatorEnqueuePositionCapturedAt(const positionMeasurement_t *position, const uint32_t captureTick)
+{
+  measurement_t m;
+  m.type = MeasurementTypePosition;
+  m.captureTick = captureTick;
+  m.data.position = *position;
+  estimatorEnqueue(&m);
+}
+
+static inline void estimatorEnqueuePoseCapturedAt(const poseMeasurement_t *pose, const uint32_t captureTick)
+{
+  measurement_t m;
+  m.type = MeasurementTypePose;
+  m.captureTick = captureTick;
+  m.data.pose = *pose;
+  estimatorEnqueue(&m);
+}
+
+static inline void estimatorEnqueueFlowCapturedAt(const flowMeasurement_t *flow, const uint32_t captureTick)
+{
+  measurement_t m;
+  m.type = MeasurementTypeFlow;
+  m.captureTick = captureTick;
+  m.data.flow = *flow;
+  estimatorEnqueue(&m);
+}
+
 static inline void estimatorEnqueueDistance(const distanceMeasurement_t *distance)
 {
   measurement_t m;
   m.type = MeasurementTypeDistance;
+  m.captureTick = 0;
   m.data.distance = *distance;
   estimatorEnqueue(&m);
 }
@@ -116,6 +163,7 @@ static inline void estimatorEnqueueTOF(const tofMeasurement_t *tof)
 {
   measurement_t m;
   m.type = MeasurementTypeTOF;
+  m.captureTick = 0;
   m.data.tof = *tof;
   estimatorEnqueue(&m);
 }
@@ -124,6 +172,7 @@ static inline void estimatorEnqueueAbsoluteHeight(const heightMeasurement_t *hei
 {
   measurement_t m;
   m.type = MeasurementTypeAbsoluteHeight;
+  m.captureTick = 0;
   m.data.height = *height;
   estimatorEnqueue(&m);
 }
@@ -132,6 +181,7 @@ static inline void estimatorEnqueueFlow(const flowMeasurement_t *flow)
 {
   measurement_t m;
   m.type = MeasurementTypeFlow;
+  m.captureTick = 0;
   m.data.flow = *flow;
   estimatorEnqueue(&m);
 }
@@ -140,6 +190,7 @@ static inline void estimatorEnqueueYawError(const yawErrorMeasurement_t *yawErro
 {
   measurement_t m;
   m.type = MeasurementTypeYawError;
+  m.captureTick = 0;
   m.data.yawError = *yawError;
   estimatorEnqueue(&m);
 }
@@ -148,9 +199,45 @@ static inline void estimatorEnqueueSweepAngles(const sweepAngleMeasurement_t *sw
 {
   measurement_t m;
   m.type = MeasurementTypeSweepAngle;
+  m.captureTick = 0;
   m.data.sweepAngle = *sweepAngle;
   estimatorEnqueue(&m);
 }
 
-// Helper function for state estimators
-bool estimatorDequeue(measurement_t *measurement);
\ No newline at end of file
+// Helper function for state estimators, estimator is the type of the caller. The current estimator and the shadow
+// estimator each get all measurements.
+bool estimatorDequeue(const StateEstimatorType estimator, measurement_t *measurement);
+
+// IMU samples (MeasurementTypeGyroscope and MeasurementTypeAcceleration) are not queued but summed up, only the
+// sensors task may enqueue them
+typedef struct {
+  Axis3f accSum;
+  uint32_t accCount;
+  Axis3f accLatest;
+  Axis3f gyroSum;
+  uint32_t gyroCount;
+  Axis3f gyroLatest;
+  // usecTimestamp() of gyroLatest, 0 if the sensor driver does not timestamp its samples
+  uint64_t gyroTimestamp;
+} estimatorImuSamples_t;
+
+// Helper function for state estimators, gets the sums of the IMU samples since the previous call by the same estimator.
+// Returns false if there are no new samples, or if the sums were being updated (they are returned next time).
+bool estimatorGetImuSamples(const StateEstimatorType estimator, estimatorImuSamples_t *samples);
+
+// Helper function for state estimators, the time in seconds between two IMU sample timestamps (usecTimestamp()).
+// Returns fallbackDt if a timestamp is unknown or if the difference is not within (0, maxDt], for instance when
+// samples have been lost.
+static inline float estimatorImuDt(const uint64_t timestamp, const uint64_t previousTimestamp, const float fallbackDt, const float maxDt)
+{
+  if (timestamp == 0 || previousTimestamp == 0 || timestamp <= previousTimestamp) {
+    return fallbackDt;
+  }
+
+  const float dt = (timestamp - previousTimestamp) * 1e-6f;
+  if (dt > maxDt) {
+    return fallbackDt;
+  }
+
+  return dt;
+}
\ No newline at end of file
@@ -63,6 +63,12 @@ void estimatorKalman(state_t *state, const uint32_t tick);
 void estimatorKalmanTaskInit();
 bool estimatorKalmanTaskTest();
 
+/**
+ * Time spent in the latest run of the kalman task, in us. The filter work is
+ * done in the task, estimatorKalman() only hands over the state.
+ */
+uint32_t estimatorKalmanGetTaskTimeUs(void);
+
 void estimatorKalmanGetEstimatedPos(point_t* pos);
 
 /**
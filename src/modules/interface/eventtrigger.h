@@ -49,6 +49,12 @@ typedef struct eventtriggerPayloadDesc_s
     const char *name;
 } eventtriggerPayloadDesc;
 
+// Largest payload of an event, the payload is copied when the event is fired
+#define EVENTTRIGGER_MAX_PAYLOAD_SIZE 24
+
+// Events with an id from this value and up can not be subscribed to
+#define EVENTTRIGGER_MAX_EVENTS 64
+
 typedef struct eventtrigger_s
 {
     const char *name;
@@ -135,6 +141,8 @@ EVENTTRIGGER(myEvent, uint8, var1, uint32, var2)
     {                                                                                                           \
         CALL_MACRO_FOR_EACH_PAIR(_EVENTTRIGGER_ENTRY_PACKED, ##__VA_ARGS__)                                     \
     } __attribute__((packed)) eventTrigger_##NAME##_payload;                                                    \
+    _Static_assert(sizeof(eventTrigger_##NAME##_payload) <= EVENTTRIGGER_MAX_PAYLOAD_SIZE,                      \
+                   "Event trigger payload of " #NAME " is too large");                                          \
     static const eventtriggerPayloadDesc __eventTriggerPayloadDesc__##NAME##__[] =                              \
         {                                                                                                       \
             CALL_MACRO_FOR_EACH_PAIR(_EVENTTRIGGER_ENTRY_DESCRIPTION, ##__VA_ARGS__)};                          \
@@ -168,14 +176,27 @@ EVENTTRIGGER(myEvent, uint8, var1, uint32, var2)
 
 /* Functions and associated data structures */
 
-typedef void (*eventtriggerCallback)(const eventtrigger *);
+// A fired event, as recorded when eventTrigger() was called
+typedef struct eventtriggerRecord_s
+{
+    uint64_t timestamp; // us, see usecTimestamp()
+    uint16_t id;
+    uint8_t payloadSize;
+    uint8_t payload[EVENTTRIGGER_MAX_PAYLOAD_SIZE];
+} eventtriggerRecord;
+
+typedef void (*eventtriggerCallback)(const eventtriggerRecord *);
 
 enum eventtriggerHandler_e
 {
     eventtriggerHandler_USD = 0,
+    eventtriggerHandler_Capture,
+    eventtriggerHandler_Crtp,
     eventtriggerHandler_Count
 };
 
+void eventtriggerInit(void);
+
 /** Get the eventtrigger id from a pointer
  * 
  * @param event Pointer to the event
@@ -202,6 +223,10 @@ const eventtrigger* eventtriggerGetByName(const char *name);
  * @param event Pointer to the event with updated payload
  * 
  * event->payload should be filled beforehand with metadata about the event
+ *
+ * The event is only recorded if a handler is subscribed to it. The timestamp and
+ * a copy of the payload are staged without locking, and the callbacks are called
+ * later from the event trigger task. Can be called from any task or interrupt.
  */
 void eventTrigger(const eventtrigger *event);
 
@@ -211,6 +236,15 @@ void eventTrigger(const eventtrigger *event);
  * @param cb function pointer to the callback
  * 
  * The handler allows multiple event handlers to be triggered by the same event.
- * The callback is only called for enabled events.
+ * The callback is only called for events the handler is subscribed to, from the
+ * event trigger task.
  */
 void eventtriggerRegisterCallback(enum eventtriggerHandler_e handler, eventtriggerCallback cb);
+
+/** Subscribe a handler to an event, or unsubscribe it
+ *
+ * @param handler The handler
+ * @param id The id of the event
+ * @param enable true to subscribe, false to unsubscribe
+ */
+void eventtriggerSubscribe(enum eventtriggerHandler_e handler, uint16_t id, bool enable);
@@ -0,0 +1,69 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * isr_profiler.h - Opt-in profiling of interrupt service routines
+ */
+#ifndef __ISR_PROFILER_H__
+#define __ISR_PROFILER_H__
+
+#include <stdint.h>
+
+/**
+ * The profiled interrupt vectors. The profiler is enabled with
+ * CFLAGS += -DISR_PROFILER, otherwise the ISR_PROFILER_ENTER/EXIT macros
+ * compile to nothing.
+ */
+typedef enum {
+  isrProfilerUsart6 = 0,      // Syslink UART
+  isrProfilerDma2Stream7,     // Syslink TX DMA
+  isrProfilerDma2Stream1,     // Syslink RX DMA
+  isrProfilerI2c1Ev,          // Deck I2C event
+  isrProfilerI2c1Er,          // Deck I2C error
+  isrProfilerI2c1Dma,         // Deck I2C DMA
+  isrProfilerI2c3Ev,          // Sensors I2C event
+  isrProfilerI2c3Er,          // Sensors I2C error
+  isrProfilerI2c3Dma,         // Sensors I2C DMA
+  isrProfilerExti0,
+  isrProfilerExti1,
+  isrProfilerExti2,
+  isrProfilerExti3,
+  isrProfilerExti4,
+  isrProfilerExti9_5,
+  isrProfilerExti15_10,
+  isrProfilerWs2812Dma,       // LED ring DMA
+  isrProfilerCount,
+} isrProfilerVector_t;
+
+#ifdef ISR_PROFILER
+  void isrProfilerInit(void);
+  void isrProfilerEnter(const isrProfilerVector_t vector);
+  void isrProfilerExit(const isrProfilerVector_t vector);
+
+  #define ISR_PROFILER_ENTER(vector) isrProfilerEnter(vector)
+  #define ISR_PROFILER_EXIT(vector) isrProfilerExit(vector)
+#else
+  #define ISR_PROFILER_ENTER(vector)
+  #define ISR_PROFILER_EXIT(vector)
+#endif // ISR_PROFILER
+
+#endif // __ISR_PROFILER_H__
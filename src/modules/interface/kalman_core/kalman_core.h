@@ -63,6 +63,43 @@ typedef enum
 } kalmanCoreStateIdx_t;
 
 
+// The number of lighthouse sensors that the rotated sensor positions are cached for
+#define KC_SWEEP_SENSOR_CACHE_SIZE 4
+
+/**
+ * Throttling of redundant scalar updates. The variance of the measurement prediction is estimated from the diagonal
+ * of P along the non-zero elements of H. When it is below minVarianceRatio times the measurement variance, the
+ * measurement adds little information and is considered redundant. Only every keepEvery:th redundant measurement is
+ * fused, a keepEvery of 0 skips them all.
+ */
+typedef struct {
+  float minVarianceRatio;
+  uint8_t keepEvery;
+  uint8_t redundantCount;
+  uint32_t skipped;
+} kalmanCoreUpdateThrottle_t;
+
+// The maximum number of rows in H for a vector update
+#define KC_MAX_VECTOR_UPDATE_DIM 8
+
+/**
+ * Temporaries used by the core functions. The core keeps no state of its own, everything lives in kalmanCoreData_t
+ * and in the workspace it points to, so several filter instances can run side by side. Instances that are never
+ * updated concurrently, for instance from the same task, can share one workspace.
+ */
+typedef struct {
+  __attribute__((aligned(4))) float A[KC_STATE_DIM][KC_STATE_DIM];   // Linearized dynamics
+  __attribute__((aligned(4))) float NN1[KC_STATE_DIM][KC_STATE_DIM];
+  __attribute__((aligned(4))) float NN2[KC_STATE_DIM][KC_STATE_DIM];
+  __attribute__((aligned(4))) float HT[KC_STATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+  __attribute__((aligned(4))) float PHT[KC_STATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+  __attribute__((aligned(4))) float K[KC_STATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+  __attribute__((aligned(4))) float KS[KC_STATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+  __attribute__((aligned(4))) float HPHR[KC_MAX_VECTOR_UPDATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+  __attribute__((aligned(4))) float tmpMM[KC_MAX_VECTOR_UPDATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+  __attribute__((aligned(4))) float HPHRinv[KC_MAX_VECTOR_UPDATE_DIM * KC_MAX_VECTOR_UPDATE_DIM];
+} kalmanCoreWorkspace_t;
+
 // The data used by the kalman core implementation.
 typedef struct {
   /**
@@ -85,6 +122,11 @@ typedef struct {
   // The quad's attitude as a rotation matrix (used by the prediction, updated by the finalization)
   float R[3][3];
 
+  // Lighthouse sensor positions rotated to the global reference frame using R, computed by the first sweep angle
+  // update of the sensor after R was updated. A bit in sweepSensorPosValid is set for each valid sensor.
+  float sweepSensorPos[KC_SWEEP_SENSOR_CACHE_SIZE][3];
+  uint8_t sweepSensorPosValid;
+
   // The covariance matrix
   __attribute__((aligned(4))) float P[KC_STATE_DIM][KC_STATE_DIM];
   arm_matrix_instance_f32 Pm;
@@ -93,10 +135,25 @@ typedef struct {
   bool resetEstimation;
 
   float baroReferenceHeight;
+
+  // Throttling applied to scalar updates, NULL to fuse all measurements
+  kalmanCoreUpdateThrottle_t* updateThrottle;
+
+  // Temporaries for the core functions, set by kalmanCoreInit()
+  kalmanCoreWorkspace_t* workspace;
 } kalmanCoreData_t;
 
+// IMU samples pre-integrated between two predictions, expressed in the body frame at the start of the interval
+typedef struct {
+  float dq[4];   // Rotation from the body frame at the end of the interval (w,x,y,z)
+  Axis3f dv;     // Integrated specific force, m/s
+  Axis3f dp;     // Doubly integrated specific force, m
+  float dt;      // Length of the interval, s
+} kalmanCoreImuDelta_t;
 
-void kalmanCoreInit(kalmanCoreData_t* this);
+
+// Resets the filter, the workspace is used by all later calls on this instance
+void kalmanCoreInit(kalmanCoreData_t* this, kalmanCoreWorkspace_t* workspace);
 
 /*  - Measurement updates based on sensors */
 
@@ -110,16 +167,73 @@ void kalmanCoreUpdateWithBaro(kalmanCoreData_t* this, float baroAsl, bool quadIs
  *  - Predicting the current state forward */
 void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying);
 
+/*  - Same as kalmanCorePredict() but the covariance is pushed forward with full matrix products.
+ *    Slower, used as a reference for the structured implementation */
+void kalmanCorePredictDense(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying);
+
+/*  - IMU pre-integration, the samples between two predictions are integrated on the rotation manifold as they
+ *    arrive and the prediction consumes the result. Rotation during the interval is taken into account, which
+ *    keeps the prediction accurate at low prediction rates. */
+void kalmanCoreImuDeltaReset(kalmanCoreImuDelta_t* delta);
+void kalmanCoreImuDeltaIntegrate(kalmanCoreImuDelta_t* delta, const Axis3f *acc, const Axis3f *gyro, float dt, bool quadIsFlying);
+void kalmanCorePredictWithImuDelta(kalmanCoreData_t* this, const kalmanCoreImuDelta_t* delta, bool quadIsFlying);
+
 void kalmanCoreAddProcessNoise(kalmanCoreData_t* this, float dt);
 
 /*  - Finalization to incorporate attitude error into body attitude */
 void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick);
 
+/*  - Full pass over the covariance matrix that enforces symmetry and bounds. The updates keep P symmetric and
+ *    bounded as they write it, this is a safety net that only needs to run at a low rate. */
+void kalmanCoreCovarianceHealthCheck(kalmanCoreData_t* this);
+
 /*  - Externalization to move the filter's internal state into the external state expected by other modules */
 void kalmanCoreExternalizeState(const kalmanCoreData_t* this, state_t *state, const Axis3f *acc, uint32_t tick);
 
+/*  - Same as kalmanCoreExternalizeState() but only updates the acceleration. The rest of the external state only
+ *    changes when the internal state does, and can be kept from the previous externalization */
+void kalmanCoreExternalizeAcc(const kalmanCoreData_t* this, state_t *state, const Axis3f *acc, uint32_t tick);
+
 void kalmanCoreDecoupleXY(kalmanCoreData_t* this);
 
 void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise);
 
+/**
+ * Scalar update with a Mahalanobis gate, the measurement is only fused if |error| / sqrt(HPH' + R) is smaller than
+ * maxMahalanobisDistance. The innovation variance is the one calculated for the update, the gate is free.
+ *
+ * @param maxMahalanobisDistance - the gate, in standard deviations. 0 disables the gate.
+ * @return true if the measurement was fused, false if it was gated or throttled
+ */
+bool kalmanCoreScalarUpdateGated(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise, float maxMahalanobisDistance);
+
+/**
+ * Scalar update where H is given as a list of its non-zero elements, costs O(N^2) instead of O(N^3).
+ * kalmanCoreScalarUpdate() uses this implementation internally.
+ *
+ * @param hIndex - state indexes of the non-zero elements in H
+ * @param hValue - the values of the non-zero elements in H
+ * @param hCount - the number of non-zero elements
+ */
+void kalmanCoreSparseScalarUpdate(kalmanCoreData_t* this, const uint8_t *hIndex, const float *hValue, int hCount, float error, float stdMeasNoise);
+
+/**
+ * Scalar update of a direct measurement of one state, H is the unit vector of the state. Only the column of P for
+ * the state is read to compute the gain, the cost is O(N) plus the O(N^2) covariance update.
+ *
+ * @param state - the measured state
+ * @param error - the innovation (measured - predicted)
+ */
+void kalmanCoreStateUpdate(kalmanCoreData_t* this, kalmanCoreStateIdx_t state, float error, float stdMeasNoise);
+
+/**
+ * Update with an m-dimensional measurement in one pass, 1 <= m <= KC_MAX_VECTOR_UPDATE_DIM.
+ * The measurement noise is assumed to be uncorrelated between the rows.
+ *
+ * @param Hm - the m x KC_STATE_DIM measurement matrix
+ * @param error - m innovations (measured - predicted)
+ * @param stdMeasNoise - m standard deviations of the measurement noise
+ */
+void kalmanCoreVectorUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *error, const float *stdMeasNoise);
+
 void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, arm_matrix_instance_f32 *Km, arm_matrix_instance_f32 *P_w_m, float error);
\ No newline at end of file
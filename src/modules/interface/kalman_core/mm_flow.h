@@ -29,3 +29,7 @@
 
 // Measurements of flow (dnx, dny)
 void kalmanCoreUpdateWithFlow(kalmanCoreData_t* this, const flowMeasurement_t *flow, const Axis3f *gyro);
+
+// Flow and TOF measurements of the same time step fused in one vector update, equivalent to
+// kalmanCoreUpdateWithFlow() followed by kalmanCoreUpdateWithTof()
+void kalmanCoreUpdateWithFlowAndTof(kalmanCoreData_t* this, const flowMeasurement_t *flow, const Axis3f *gyro, const tofMeasurement_t *tof);
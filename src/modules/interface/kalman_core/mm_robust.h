@@ -0,0 +1,75 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--'  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Helpers for the robust M-estimation updates of mm_tdoa_robust.c and
+ * mm_distance_robust.c.
+ *
+ * Each iteration of a robust update re-weights the prior covariance as
+ * P_w = L * W^-1 * L^T, where L is the Cholesky factor of the covariance of the
+ * previous iteration and W a diagonal weight matrix. The Cholesky factor of P_w
+ * is then simply L * W^-1/2, so P only has to be factorized once per
+ * measurement and the following iterations scale the columns of the factor.
+ * Since the measurement is scalar, P_w is never needed during the iterations,
+ * only P_w * h^T which is computed from the factor.
+ */
+
+#pragma once
+
+#include "kalman_core.h"
+
+/**
+ * @brief Cholesky factorization of a positive definite matrix, P = L * L^T
+ *
+ * @param P The matrix to factorize
+ * @param L The lower triangular factor, the upper triangle is set to 0
+ */
+void kalmanCoreRobustFactorize(float P[KC_STATE_DIM][KC_STATE_DIM], float L[KC_STATE_DIM][KC_STATE_DIM]);
+
+/**
+ * @brief Bounds the elements of a factor and adds a small value to its
+ *        diagonal, so that it can be inverted.
+ */
+void kalmanCoreRobustConditionFactor(float L[KC_STATE_DIM][KC_STATE_DIM]);
+
+/**
+ * @brief Solves L * x = b by forward substitution
+ */
+void kalmanCoreRobustSolveLower(float L[KC_STATE_DIM][KC_STATE_DIM], const float b[KC_STATE_DIM], float x[KC_STATE_DIM]);
+
+/**
+ * @brief Turns the factor L of P into the factor of L * diag(weightsInv) * L^T
+ */
+void kalmanCoreRobustReweightFactor(float L[KC_STATE_DIM][KC_STATE_DIM], const float weightsInv[KC_STATE_DIM]);
+
+/**
+ * @brief Computes y = L * L^T * x
+ */
+void kalmanCoreRobustFactorTimesVector(float L[KC_STATE_DIM][KC_STATE_DIM], const float x[KC_STATE_DIM], float y[KC_STATE_DIM]);
+
+/**
+ * @brief Computes P = L * L^T
+ */
+void kalmanCoreRobustFactorToMatrix(float L[KC_STATE_DIM][KC_STATE_DIM], float P[KC_STATE_DIM][KC_STATE_DIM]);
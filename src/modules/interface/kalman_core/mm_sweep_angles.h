@@ -30,3 +30,10 @@
 
 // Measurement of sweep angles from a Lighthouse base station
 void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *angles, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState);
+
+/**
+ * Fuses the sweep angles of several sensors and sweeps, typically the sweeps of one lighthouse frame, with vector
+ * updates of up to KC_MAX_VECTOR_UPDATE_DIM rows instead of one scalar update per sweep.
+ * Outliers are rejected per sweep. The update throttle of the core is not applied.
+ */
+void kalmanCoreUpdateWithSweepAngleBatch(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweeps[], const int count, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState);
@@ -29,3 +29,9 @@
 
 // Measurements of a UWB Tx/Rx
 void kalmanCoreUpdateWithTDOA(kalmanCoreData_t* this, tdoaMeasurement_t *tdoa);
+
+// TDoA measurements from one packet, fused in one vector update
+void kalmanCoreUpdateWithTDOABatch(kalmanCoreData_t* this, tdoaBatchMeasurement_t *tdoaBatch);
+
+// Get one measurement in a batch as a single TDoA measurement
+void kalmanCoreTdoaBatchGetMeasurement(const tdoaBatchMeasurement_t *tdoaBatch, const int index, tdoaMeasurement_t *tdoa);
@@ -50,6 +50,15 @@ bool lighthouseStoragePersistData(const uint8_t baseStation, const bool geoData,
  */
 void lighthouseStoragePersistCalibDataBackground(const uint8_t baseStation);
 
+/**
+ * @brief Copy the current geometry and calibration data of all base stations to permanent storage, as one item that
+ *        is read at start up. Call after lighthouseStoragePersistData() to keep the boot data in sync.
+ *        Note: persisting data may take a long time.
+ *
+ * @return true if data was stored
+ */
+bool lighthouseStoragePersistBootData();
+
 /**
  * @brief Save system type in storage
  * 
@@ -80,3 +89,24 @@ void lighthouseStorageInitializeCalibDataFromStorage();
  * 
  */
 void lighthouseStorageInitializeSystemTypeFromStorage();
+
+/**
+ * @brief Load geometry and calibration data from the permanent storage, used at start up. The data is read as one
+ *        item if possible, the items of the base stations are only fetched one by one if it is missing.
+ *
+ */
+void lighthouseStorageInitializeDataFromStorage();
+
+/**
+ * @brief Load geometry and calibration data from the permanent storage in the worker task, to run in parallel
+ *        with other start up work. Use lighthouseStorageIsDataInitialized() to find out when it is done.
+ *
+ */
+void lighthouseStorageInitializeDataFromStorageBackground();
+
+/**
+ * @brief Check if the data has been loaded by lighthouseStorageInitializeDataFromStorageBackground()
+ *
+ * @return true when loaded
+ */
+bool lighthouseStorageIsDataInitialized();
@@ -0,0 +1,54 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * lighthouse_storage_writer.h - deferred writes of lighthouse data to permanent storage
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Called from the storage writer task when a write request is done
+ *
+ * @param result  true if all data was stored
+ */
+typedef void (*lighthouseStorageWriterDoneCallback_t)(const bool result);
+
+/**
+ * @brief Initialize the storage writer and start its task. May be called more than once.
+ */
+void lighthouseStorageWriterInit();
+
+/**
+ * @brief Request geometry and calibration data to be written to permanent storage by the low priority storage
+ *        writer task. The function returns immediately. Requests that arrive before the previous ones have
+ *        been written are merged, data for a base station is only written once.
+ *
+ * @param geoDataBsField    A bit field indicating for which base stations to store geometry data
+ * @param calibDataBsField  A bit field indicating for which base stations to store calibration data
+ * @param doneCallback      Called from the writer task when the data has been written, once per request. May be NULL.
+ * @return true if the request was accepted, false if the writer is not initialized or the callback can not be queued
+ */
+bool lighthouseStorageWriterRequest(const uint16_t geoDataBsField, const uint16_t calibDataBsField, lighthouseStorageWriterDoneCallback_t doneCallback);
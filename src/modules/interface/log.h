@@ -34,6 +34,28 @@
 void logInit(void);
 bool logTest(void);
 
+/** Runs the log blocks that are started in phase with the stabilizer loop.
+ *
+ * Called by the stabilizer once per loop, it only wakes up the high rate log
+ * task and returns immediately.
+ *
+ * @param tick The tick of the stabilizer loop
+ */
+void logHighRateTrigger(uint32_t tick);
+
+/** Get the size and the CRC of the TOC, as in the TOC info of the log port
+ *
+ * @param count The number of variables in the TOC
+ * @param crc The CRC of the TOC
+ */
+void logGetTocInfo(uint16_t* count, uint32_t* crc);
+
+/** Get the log profiles that are stored
+ *
+ * @return A mask with bit n set if profile n is stored
+ */
+uint8_t logGetStoredProfiles(void);
+
 /* Public API to access of log variables */
 
 /** Variable identifier.
@@ -53,6 +75,13 @@ typedef uint16_t logVarId_t;
  */
 logVarId_t logGetVarId(char* group, char* name);
 
+/** Get the varId from the id of the variable in the TOC, as used by clients
+ *
+ * @param tocId Id of the variable in the TOC
+ * @return The variable ID or an invalid ID. Use logVarIdIsValid() to check validity.
+ */
+logVarId_t logGetVarIdFromTocId(uint16_t tocId);
+
 /** Check variable ID validity
  * 
  * @param varId variable ID, returned by logGetLogId()
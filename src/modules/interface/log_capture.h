@@ -0,0 +1,59 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * log_capture.h - Burst capture of log variables to RAM
+ */
+
+#ifndef __LOG_CAPTURE_H__
+#define __LOG_CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  logCaptureTriggerCrtp = 0,
+  logCaptureTriggerTumble = 1,
+  logCaptureTriggerEvent = 2,
+  logCaptureTriggerDisarm = 3,
+  logCaptureTriggerCrash = 4,
+} logCaptureTrigger_t;
+
+void logCaptureInit(void);
+bool logCaptureTest(void);
+
+/** Sample the capture variables, called by the stabilizer once per loop.
+ *
+ * @param tick The tick of the stabilizer loop
+ */
+void logCaptureSample(uint32_t tick);
+
+/** Stop the capture, the buffer is frozen after the post trigger samples.
+ *
+ * Can be called from any task, the trigger is handled in the next
+ * logCaptureSample().
+ *
+ * @param source What triggered the capture
+ */
+void logCaptureTrigger(logCaptureTrigger_t source);
+
+#endif /* __LOG_CAPTURE_H__ */
@@ -0,0 +1,75 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * log_pack.h - compiled form of the variables of a log block
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  acqType_memory = 0,
+  acqType_function = 1,
+} acquisitionType_t;
+
+/* Compiled form of the ops of a block, used when running the block.
+ * Memory variables that are logged with their storage type are plain copies,
+ * and copies of variables that are adjacent in memory are merged into one. */
+typedef enum {
+  packCopy = 0,
+  packConvert = 1,
+} packOpType_t;
+
+struct log_pack {
+  void * variable;
+  uint8_t op;
+  uint8_t storageType : 4;
+  uint8_t logType     : 4;
+  uint8_t length; // Number of bytes in the packet
+  uint8_t acquisitionType; // acquisitionType_t
+  float deadband;
+};
+
+/**
+ * @brief Append a variable to the packs of a block.
+ *
+ * A copy of a variable that directly follows the previous copy in memory
+ * extends that pack, if both have the same type and no deadband. The
+ * compressed and on-change encodings step through a pack in units of its
+ * type, a pack can therefore only hold variables of one type.
+ *
+ * @param packs The packs of the block
+ * @param packCount The number of packs of the block
+ * @param variable The address of the variable, or of its getter
+ * @param storageType The type of the variable in memory
+ * @param logType The type of the variable in the packet
+ * @param length The number of bytes of the log type
+ * @param acquisitionType How the variable is read, see acquisitionType_t
+ * @param deadband The minimum change that is sent by an on-change block
+ * @return The number of packs of the block after the append
+ */
+uint8_t logPackAppend(struct log_pack* packs, const uint8_t packCount, void* variable, const uint8_t storageType,
+                      const uint8_t logType, const uint8_t length, const uint8_t acquisitionType, const float deadband);
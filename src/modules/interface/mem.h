@@ -42,6 +42,15 @@ typedef enum {
   MEM_TYPE_LEDMEM   = 0x17,
   MEM_TYPE_APP      = 0x18,
   MEM_TYPE_DECK_MEM = 0x19,
+  MEM_TYPE_CAPTURE  = 0x1A,
+  MEM_TYPE_TRAJ_LZ4 = 0x1B,
+  MEM_TYPE_TRAJ_STREAM = 0x1C,
+  MEM_TYPE_TASK_LOAD = 0x1D,
+  MEM_TYPE_ISR_PROFILE = 0x1E,
+  MEM_TYPE_STATIC_MEM = 0x1F,
+  MEM_TYPE_STATE_SNAPSHOT = 0x20,
+  MEM_TYPE_RATE_HEALTH = 0x21,
+  MEM_TYPE_BLACK_BOX = 0x22,
 } MemoryType_t;
 
 #define MEMORY_SERIAL_LENGTH 8
@@ -66,3 +75,15 @@ void memInit(void);
 bool memTest(void);
 void memoryRegisterHandler(const MemoryHandlerDef_t* handlerDef);
 void memoryRegisterOwHandler(const MemoryOwHandlerDef_t* handlerDef);
+
+/** Get the number of memories and a CRC of the memory map
+ *
+ * The CRC covers the type of each memory in the order of the ids, and the
+ * serial number of the 1-wire memories. A client that cached the map of the
+ * same CRC does not need to read the memory info again. The map is complete
+ * once the system is started.
+ *
+ * @param count The number of memories
+ * @param crc The CRC of the memory map
+ */
+void memGetMapInfo(uint8_t* count, uint32_t* crc);
@@ -35,6 +35,10 @@
 #define MSP_H_
 #include <stdint.h>
 #include <stdbool.h>
+#include "log.h"
+
+// Largest response that is precomputed, header + payload + CRC
+#define MSP_RESPONSE_MAX_SIZE 32
 
 /**
  * Function signature for a response callback to be provided by a client
@@ -55,6 +59,15 @@ typedef struct _MspHeader
   uint8_t command;
 }__attribute__((packed)) MspHeader;
 
+/**
+ * A complete response message, header, payload and CRC, ready to be sent
+ */
+typedef struct
+{
+  uint8_t data[MSP_RESPONSE_MAX_SIZE];
+  uint8_t size;
+} MspResponse;
+
 /**
  * Structure representing an instance of the MSP
  * library. State is contained in this object, so
@@ -67,12 +80,24 @@ typedef struct
   uint8_t requestCrc;
   uint8_t requestState;
 
+  // Responses precomputed by mspInit() and mspUpdate(), a request
+  // is answered by copying one of them to the mspResponse buffer
+  MspResponse status;
+  MspResponse rc;
+  MspResponse attitude;
+  MspResponse boxIds;
+
   // Response context
-  uint8_t mspResponse[256];
+  uint8_t mspResponse[MSP_RESPONSE_MAX_SIZE];
   // Size of the complete response message contained
   // in the mspResponse buffer
   uint16_t mspResponseSize;
 
+  // Stabilizer state the attitude response is computed from
+  logVarId_t rollId;
+  logVarId_t pitchId;
+  logVarId_t yawId;
+
   // The client callback to be invoked
   // when a response message is ready
   MspResponseCallback responseCallback;
@@ -86,6 +111,14 @@ typedef struct
  */
 void mspInit(MspObject* pMspObject, const MspResponseCallback callback);
 
+/**
+ * Recomputes the responses that depend on the state of the Crazyflie. Should
+ * be called at a fixed low rate from the task that processes the requests,
+ * requests are answered with the responses of the last update.
+ * @param[in]   pMspObject      Pointer to the MSP object
+ */
+void mspUpdate(MspObject* pMspObject);
+
 /**
  * Processes the next byte received by the client
  * @param[in]   pMspObject      Pointer to the MSB object
@@ -34,6 +34,13 @@
 void paramInit(void);
 bool paramTest(void);
 
+/** Get the size and the CRC of the TOC, as in the TOC info of the param port
+ *
+ * @param count The number of parameters in the TOC
+ * @param crc The CRC of the TOC
+ */
+void paramGetTocInfo(uint16_t* count, uint32_t* crc);
+
 /* Public API to access param variables */
 
 /** Variable identifier.
@@ -124,11 +131,16 @@ void paramSetInt(paramVarId_t varid, int valuei);
 void paramSetFloat(paramVarId_t varid, float valuef);
 
 
+/* Called after the value of a parameter has been changed, see PARAM_ADD_WITH_CALLBACK() */
+typedef void (*paramCallback_t)(void);
+
 /* Basic parameter structure */
 struct param_s {
   uint8_t type;
+  uint8_t flags;
   char * name;
   void * address;
+  paramCallback_t callback;
 };
 
 #define PARAM_BYTES_MASK 0x03
@@ -153,6 +165,9 @@ struct param_s {
 
 #define PARAM_SYNC 0x02
 
+// Flags
+#define PARAM_PERSISTENT (1<<0)
+
 // User-friendly macros
 #define PARAM_UINT8 (PARAM_1BYTE | PARAM_TYPE_INT | PARAM_UNSIGNED)
 #define PARAM_INT8  (PARAM_1BYTE | PARAM_TYPE_INT | PARAM_SIGNED)
@@ -173,6 +188,16 @@ struct param_s {
    { \
   .type = TYPE, .name = #NAME, .address = (void*)(ADDRESS), },
 
+// The value is stored in the persistent storage when changed, and restored at startup
+#define PARAM_ADD_PERSISTENT(TYPE, NAME, ADDRESS) \
+   { .type = TYPE, .flags = PARAM_PERSISTENT, .name = #NAME, .address = (void*)(ADDRESS), },
+
+// The callback is called after the value has been written from CRTP, in the param task,
+// or by paramSetInt()/paramSetFloat(), in the context of the caller. It should be short,
+// a module that must apply the change in its own task can set a flag for it.
+#define PARAM_ADD_WITH_CALLBACK(TYPE, NAME, ADDRESS, CALLBACK) \
+   { .type = TYPE, .name = #NAME, .address = (void*)(ADDRESS), .callback = (CALLBACK), },
+
 #define PARAM_GROUP_START(NAME)  \
   static const struct param_s __params_##NAME[] __attribute__((section(".param." #NAME), used)) = { \
   PARAM_ADD_GROUP(PARAM_GROUP | PARAM_START, NAME, 0x0)
@@ -188,6 +213,8 @@ struct param_s {
 // Empty defines when running unit tests
 #define PARAM_ADD(TYPE, NAME, ADDRESS)
 #define PARAM_ADD_GROUP(TYPE, NAME, ADDRESS)
+#define PARAM_ADD_PERSISTENT(TYPE, NAME, ADDRESS)
+#define PARAM_ADD_WITH_CALLBACK(TYPE, NAME, ADDRESS, CALLBACK)
 #define PARAM_GROUP_START(NAME)
 #define PARAM_GROUP_STOP(NAME)
 
@@ -11,9 +11,22 @@
 // of other Crazyflies on the same radio "for free". In the future, other
 // methods of peer localization such as peer-to-peer sharing could be added.
 
-// The maximum number of other Crazyflie ID's to track. This constant may be
-// needed for static allocations in other modules, e.g. collision avoidance.
-#define PEER_LOCALIZATION_MAX_NEIGHBORS 10
+// The maximum number of other Crazyflie ID's to track, at most 255. This
+// constant may be needed for static allocations in other modules. When the
+// table is full, a new ID replaces the one that has not been updated for the
+// longest time.
+#ifndef PEER_LOCALIZATION_MAX_NEIGHBORS
+#define PEER_LOCALIZATION_MAX_NEIGHBORS 64
+#endif
+
+#if PEER_LOCALIZATION_MAX_NEIGHBORS > 255
+#error "PEER_LOCALIZATION_MAX_NEIGHBORS must fit in an uint8_t"
+#endif
+
+// Peers that have not been updated for this long are removed from the table.
+#ifndef PEER_LOCALIZATION_STALE_MS
+#define PEER_LOCALIZATION_STALE_MS 10000
+#endif
 
 // Initialize and test the module.
 void peerLocalizationInit();
@@ -33,11 +46,20 @@ bool peerLocalizationTellPosition(int id, positionMeasurement_t const *pos);
 bool peerLocalizationIsIDActive(uint8_t id);
 
 // Returns the position value for the given radio ID, or NULL if none exists.
-// Performs a linear search.
 peerLocalizationOtherPosition_t *peerLocalizationGetPositionByID(uint8_t id);
 
-// Returns the position value based on index, uncorrelated with radio ID. More
-// efficient if iterating over all peers is needed.
+// Returns the number of peers that are tracked. They are stored at the
+// indices 0 to count - 1, in no particular order.
+uint8_t peerLocalizationGetPeerCount(void);
+
+// Returns the position value based on index, uncorrelated with radio ID, or
+// NULL if the index is not below the peer count. More efficient if iterating
+// over all peers is needed. Removing a stale peer moves the last peer into its
+// index.
 peerLocalizationOtherPosition_t *peerLocalizationGetPositionByIdx(uint8_t idx);
 
+// Returns a counter that is incremented on every position update, to detect
+// that the positions have changed.
+uint32_t peerLocalizationGetUpdateCount(void);
+
 #endif // __PEER_LOCALIZATION_H__
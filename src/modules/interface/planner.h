@@ -62,12 +62,18 @@ struct planner
 	bool reversed;					// true, if trajectory should be evaluated in reverse
 
 	union {
-		const struct piecewise_traj* trajectory; // pointer to trajectory
+		struct piecewise_traj* trajectory; // pointer to trajectory
 		struct piecewise_traj_compressed* compressed_trajectory; // pointer to compressed trajectory
 	};
 
 	struct piecewise_traj planned_trajectory; // trajectory for on-board planning
 	struct poly4d pieces[1]; // the on-board planner requires a single piece, only
+
+	// the goal of the last absolute go_to, used to recognize repeated commands
+	bool go_to_valid;
+	struct vec go_to_pos;
+	float go_to_yaw;
+	float go_to_duration;
 };
 
 // initialize the planner
@@ -93,13 +99,15 @@ int plan_takeoff(struct planner *p, struct vec curr_pos, float curr_yaw, float h
 int plan_land(struct planner *p, struct vec curr_pos, float curr_yaw, float hover_height, float hover_yaw, float duration, float t);
 
 // move to a given position, then hover there.
+// an absolute go_to that repeats the one that is being flown does not replan,
+// so that a command that is resent does not restart the motion.
 int plan_go_to(struct planner *p, bool relative, struct vec hover_pos, float hover_yaw, float duration, float t);
 
 // same as above, but with current state provided from outside.
 int plan_go_to_from(struct planner *p, const struct traj_eval *curr_eval, bool relative, struct vec hover_pos, float hover_yaw, float duration, float t);
 
 // start trajectory
-int plan_start_trajectory(struct planner *p, const struct piecewise_traj* trajectory, bool reversed);
+int plan_start_trajectory(struct planner *p, struct piecewise_traj* trajectory, bool reversed);
 
 // start compressed trajectory
 int plan_start_compressed_trajectory(struct planner *p, struct piecewise_traj_compressed* trajectory);
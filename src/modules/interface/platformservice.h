@@ -40,5 +40,7 @@ bool platformserviceTest(void);
 
 void platformserviceSendAppchannelPacket(CRTPPacket *p);
 
+void platformserviceSendAppchannelFragment(CRTPPacket *p);
+
 #endif /* __PLATFORMSERVICE_H__ */
 
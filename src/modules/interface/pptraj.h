@@ -149,6 +149,23 @@ struct piecewise_traj
 	struct vec shift;
 	unsigned char n_pieces;
 	struct poly4d* pieces;
+
+	// mutable part of the data structure, the piece that was evaluated last.
+	// the search for the piece to evaluate continues from there, so evaluation
+	// is O(1) per call when time moves forward. it is reset when the start
+	// time, the pieces, the number of pieces, the timescale or the direction
+	// change.
+	struct {
+		float t_begin;
+		struct poly4d const *pieces;
+		float timescale;
+		unsigned char n_pieces;
+		bool reversed;
+		// index of the piece in evaluation order, n_pieces - 1 - index when reversed
+		unsigned char index;
+		// start time of the piece, relative to t_begin, in scaled time
+		float t_begin_relative;
+	} cursor;
 };
 
 static inline float piecewise_duration(struct piecewise_traj const *pp)
@@ -169,10 +186,10 @@ void piecewise_plan_7th_order_no_jerk(struct piecewise_traj *p, float duration,
 	struct vec p1, float y1, struct vec v1, float dy1, struct vec a1);
 
 struct traj_eval piecewise_eval(
-	struct piecewise_traj const *traj, float t);
+	struct piecewise_traj *traj, float t);
 
 struct traj_eval piecewise_eval_reversed(
-	struct piecewise_traj const *traj, float t);
+	struct piecewise_traj *traj, float t);
 
 
 static inline bool piecewise_is_finished(struct piecewise_traj const *traj, float t)
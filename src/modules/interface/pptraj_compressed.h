@@ -61,6 +61,17 @@ struct piecewise_traj_compressed
 		// poly4d representation of the current piece
 		struct poly4d poly4d;
 	} current_piece;
+
+	// the piece after the current one, decoded ahead of time by
+	// piecewise_compressed_prefetch() so that moving on to it while the
+	// trajectory is evaluated is a copy only
+	struct {
+		// raw representation of the piece, 0 if it has not been decoded
+		const void* data;
+
+		// poly4d representation of the piece
+		struct poly4d poly4d;
+	} next_piece;
 };
 
 // Returns the total duration of a compressed trajectory. The total duration
@@ -83,3 +94,8 @@ struct traj_eval piecewise_compressed_eval(
 // Loads the compressed trajectory at the given pointer
 void piecewise_compressed_load(
 	struct piecewise_traj_compressed *traj, const void* data);
+
+// Decodes the piece after the current one, if it has not been decoded yet.
+// Called outside of the evaluation, for instance from a lower priority task,
+// to keep the cost of piecewise_compressed_eval() small and constant.
+void piecewise_compressed_prefetch(struct piecewise_traj_compressed *traj);
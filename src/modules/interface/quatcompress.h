@@ -80,7 +80,8 @@ static inline void quatdecompress(uint32_t comp, float q[4])
 			sum_squares += q[i] * q[i];
 		}
 	}
-	q[i_largest] = sqrtf(1.0f - sum_squares);
+	// Rounding, or a corrupt packet, can give a sum slightly above 1
+	q[i_largest] = sqrtf(fmaxf(0.0f, 1.0f - sum_squares));
 }
 
 #endif // QUATCOMPRESS_H
@@ -29,15 +29,40 @@
 
 
 #include "FreeRTOS.h"
+#include "queue.h"
 
-#ifdef DEBUG_QUEUE_MONITOR
-  #include "queue.h"
+/**
+ * Kinds of queues that are monitored, queues of the same kind share one set of
+ * statistics.
+ */
+typedef enum {
+  queueMonitorCrtpTx,
+  queueMonitorCrtpRx,
+  queueMonitorEstimator,
+  queueMonitorSyslink,
+  queueMonitorWorker,
+  queueMonitorAppChannel,
+  queueMonitorGroupCount,
+} queueMonitorGroup_t;
 
+/**
+ * Record the high water mark, average occupancy and longest item residency of
+ * a queue, they are available in the queueMon log group. Always enabled, the
+ * queues that are not added only cost a lookup of the queue number.
+ *
+ * @param queue The queue, must not have items waiting in it
+ * @param group The kind of queue
+ */
+void queueMonitorAddQueue(xQueueHandle queue, queueMonitorGroup_t group);
+
+void qm_traceQUEUE_SEND(void* xQueue);
+void qm_traceQUEUE_SEND_FAILED(void* xQueue);
+void qm_traceQUEUE_RECEIVE(void* xQueue);
+
+#ifdef DEBUG_QUEUE_MONITOR
   void queueMonitorInit();
   #define DEBUG_QUEUE_MONITOR_REGISTER(queue) qmRegisterQueue(queue, __FILE__, #queue)
 
-  void qm_traceQUEUE_SEND(void* xQueue);
-  void qm_traceQUEUE_SEND_FAILED(void* xQueue);
   void qmRegisterQueue(xQueueHandle* xQueue, char* fileName, char* queueName);
 #else
   #define DEBUG_QUEUE_MONITOR_REGISTER(queue)
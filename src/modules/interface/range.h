@@ -45,6 +45,23 @@ typedef enum {
  */
 void rangeSet(rangeDirection_t direction, float range_m);
 
+/**
+ * Set the range for a certain direction together with the time it was measured
+ *
+ * @param direction Direction of the range
+ * @param range_m Distance to an object in meter
+ * @param timestamp The time when the range was measured (in sys ticks)
+ */
+void rangeSetWithTimestamp(rangeDirection_t direction, float range_m, uint32_t timestamp);
+
+/**
+ * Get the time when the range for a certain direction was measured
+ *
+ * @param direction Direction of the range
+ * @return The time when the range was measured (in sys ticks), 0 if unknown
+ */
+uint32_t rangeGetTimestamp(rangeDirection_t direction);
+
 /**
  * Get the range for a certain direction
  *
@@ -0,0 +1,54 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * saturation_stats.h - Counters of where the control chain saturates
+ */
+#ifndef __SATURATION_STATS_H__
+#define __SATURATION_STATS_H__
+
+#include <stdint.h>
+
+// Number of bins of the motor command histogram, each covers 1/8 of the motor range
+#define SATURATION_STATS_HIST_BINS 8
+
+/**
+ * Record the motor commands of one power distribution update, before they are
+ * limited to the motor range. Called once per tick of the stabilizer loop.
+ *
+ * @param power  The unlimited motor commands
+ * @param count  Number of motors
+ * @param maxPower  The highest command the motors can deliver
+ */
+void saturationStatsMotors(const float power[], const int count, const float maxPower);
+
+/**
+ * Count an attitude rate PID output that was limited to the int16 range.
+ */
+void saturationStatsRateOutput(void);
+
+/**
+ * Count a PID update where the integral was held at its limit.
+ */
+void saturationStatsIntegrator(void);
+
+#endif //__SATURATION_STATS_H__
@@ -31,6 +31,16 @@ void sensfusion6Init(void);
 bool sensfusion6Test(void);
 
 void sensfusion6UpdateQ(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+#ifdef COMPLEMENTARY_FAST_ATTITUDE
+/**
+ * Reduced cost Mahony update with the integration step fixed to one
+ * COMPLEMENTARY_ATTITUDE_RATE period. Proportional feedback only.
+ *
+ * @param gx, gy, gz  Gyro (deg/s)
+ * @param ax, ay, az  Accelerometer (g)
+ */
+void sensfusion6UpdateQFast(float gx, float gy, float gz, float ax, float ay, float az);
+#endif
 void sensfusion6GetQuaternion(float* qx, float* qy, float* qz, float* qw);
 void sensfusion6GetEulerRPY(float* roll, float* pitch, float* yaw);
 float sensfusion6GetAccZWithoutGravity(const float ax, const float ay, const float az);
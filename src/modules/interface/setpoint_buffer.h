@@ -0,0 +1,84 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * setpoint_buffer.h - Play out of time stamped streaming setpoints
+ */
+#ifndef __SETPOINT_BUFFER_H__
+#define __SETPOINT_BUFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stabilizer_types.h"
+
+#define SETPOINT_BUFFER_SIZE 8
+
+// Setpoints older than this, in sender time, are not extrapolated further
+#define SETPOINT_BUFFER_MAX_EXTRAPOLATION_MS 100
+
+// A gap in the stream of this length restarts the clock synchronisation
+#define SETPOINT_BUFFER_RESYNC_MS 500
+
+typedef struct {
+  uint32_t time; // ms, on the sender's clock
+  setpoint_t setpoint;
+} setpointBufferEntry_t;
+
+typedef struct {
+  // Entries ordered by time, the oldest at index first
+  setpointBufferEntry_t entries[SETPOINT_BUFFER_SIZE];
+  uint8_t first;
+  uint8_t count;
+
+  // The 16 bit sender time, unwrapped
+  uint32_t senderTime;
+
+  // Local time minus sender time of the fastest recent packets, ms
+  int32_t clockOffset;
+  bool isSynced;
+  uint32_t lastPush; // local ms
+
+  // How long after the sender time a setpoint is played, on top of the
+  // fastest transmission, ms. Absorbs the radio jitter.
+  uint16_t playoutDelay;
+} setpointBuffer_t;
+
+void setpointBufferInit(setpointBuffer_t* this, const uint16_t playoutDelay);
+
+/**
+ * Add a setpoint to the buffer.
+ *
+ * @param time  The time the setpoint applies to, ms on the sender's clock
+ * @param now  The local time, ms
+ */
+void setpointBufferPush(setpointBuffer_t* this, const uint16_t time, const setpoint_t* setpoint, const uint32_t now);
+
+/**
+ * Get the setpoint for the local time now, interpolated between the buffered
+ * setpoints or extrapolated from the last one with its velocity. The modes and
+ * other members are taken from the latest setpoint that is played.
+ *
+ * @return false if the buffer is empty
+ */
+bool setpointBufferGet(setpointBuffer_t* this, const uint32_t now, setpoint_t* setpoint);
+
+#endif //__SETPOINT_BUFFER_H__
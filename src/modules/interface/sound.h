@@ -39,6 +39,15 @@
 #define SND_STARTUP     6
 #define SND_CALIB       7
 
+/* End markers of a note list */
+#define SOUND_NOTE_STOP   0xFE
+#define SOUND_NOTE_REPEAT 0xFF
+
+typedef struct {
+  uint16_t tone;      // Frequency in Hz, 0 is a pause
+  uint16_t duration;  // Fraction of a whole note, 4 is a quarter note
+} soundNote_t;
+
 /**
  * Initialize sound sub-system.
  */
@@ -59,5 +68,19 @@ void soundSetEffect(uint32_t effect);
  */
 void soundSetFreq(uint32_t freq);
 
+/**
+ * Queue a melody to be played after the already queued ones, without blocking.
+ * The notes are compiled when queued and can be released once this returns.
+ * The list ends with a SOUND_NOTE_STOP or SOUND_NOTE_REPEAT note, queued
+ * melodies are played once either way. System sounds take precedence over
+ * queued melodies, which take precedence over the sound.effect parameter.
+ *
+ * @param notes The notes, at most SOUND_QUEUE_MAX_NOTES plus the end marker
+ * @param bpm Tempo in beats (quarter notes) per minute
+ * @return true if the melody was queued, false if the queue is full or the
+ *         melody too long
+ */
+bool soundQueueMelody(const soundNote_t * notes, uint32_t bpm);
+
 #endif /* __SOUND_H__ */
 
@@ -86,6 +86,7 @@ typedef struct quaternion_s {
 typedef enum {
   MeasurementSourceLocationService  = 0,
   MeasurementSourceLighthouse       = 1,
+  MeasurementSourceGnss             = 2,
 } measurementSource_t;
 
 typedef struct tdoaMeasurement_s {
@@ -93,8 +94,23 @@ typedef struct tdoaMeasurement_s {
   uint8_t anchorIds[2];
   float distanceDiff;
   float stdDev;
+  float anchorDistanceSq; // Squared distance between the anchors if known by the sender, 0 otherwise
 } tdoaMeasurement_t;
 
+#define TDOA_BATCH_MAX_COUNT 3
+
+/** TDoA measurements from one received packet, all between the sending anchor and other anchors */
+typedef struct tdoaBatchMeasurement_s {
+  vec3d anchorPosition; // Position of the anchor that sent the packet
+  vec3d otherAnchorPositions[TDOA_BATCH_MAX_COUNT];
+  float distanceDiffs[TDOA_BATCH_MAX_COUNT]; // Distance to the anchor minus distance to the other anchor
+  float otherAnchorDistancesSq[TDOA_BATCH_MAX_COUNT]; // Squared distance between the anchor and the other anchor, 0 if not known
+  uint8_t anchorId;
+  uint8_t otherAnchorIds[TDOA_BATCH_MAX_COUNT];
+  uint8_t count;
+  float stdDev;
+} tdoaBatchMeasurement_t;
+
 typedef struct baro_s {
   float pressure;           // mbar
   float temperature;        // degree Celcius
@@ -156,17 +172,55 @@ typedef struct sensorData_s {
   Axis3f accSec;            // Gs
   Axis3f gyroSec;           // deg/s
 #endif
-  uint64_t interruptTimestamp;
+  uint64_t interruptTimestamp; // usecTimestamp() of the IMU data ready interrupt
 } sensorData_t;
 
 typedef struct state_s {
   attitude_t attitude;      // deg (legacy CF2 body coordinate system, where pitch is inverted)
   quaternion_t attitudeQuaternion;
+  uint32_t attitudeQuaternionCompressed; // attitudeQuaternion compressed by the estimator, see quatcompress.h
   point_t position;         // m
   velocity_t velocity;      // m/s
   acc_t acc;                // Gs (but acc.z without considering gravity)
 } state_t;
 
+/* Compact forms of the state and the setpoint, as logged by the stabilizer */
+typedef struct stateCompressed_s {
+  // position - mm
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  // velocity - mm / sec
+  int16_t vx;
+  int16_t vy;
+  int16_t vz;
+  // acceleration - mm / sec^2
+  int16_t ax;
+  int16_t ay;
+  int16_t az;
+  // compressed quaternion, see quatcompress.h
+  int32_t quat;
+  // angular velocity - milliradians / sec
+  int16_t rateRoll;
+  int16_t ratePitch;
+  int16_t rateYaw;
+} stateCompressed_t;
+
+typedef struct setpointCompressed_s {
+  // position - mm
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  // velocity - mm / sec
+  int16_t vx;
+  int16_t vy;
+  int16_t vz;
+  // acceleration - mm / sec^2
+  int16_t ax;
+  int16_t ay;
+  int16_t az;
+} setpointCompressed_t;
+
 typedef struct control_s {
   int16_t roll;
   int16_t pitch;
@@ -267,6 +321,7 @@ typedef struct {
   float measuredSweepAngle;
   float stdDev;
   const lighthouseCalibrationSweep_t* calib;
+  const lighthouseCalibrationModelConstants_t* modelConstants;  // Precomputed constants for the rotor, includes tan(t)
   lighthouseCalibrationMeasurementModel_t calibrationMeasurementModel;
 } sweepAngleMeasurement_t;
 
@@ -274,12 +329,14 @@ typedef struct {
 typedef struct
 {
   Axis3f gyro; // deg/s, for legacy reasons
+  uint64_t timestamp; // usecTimestamp() when the sample was taken, 0 if unknown
 } gyroscopeMeasurement_t;
 
 /** accelerometer measurement */
 typedef struct
 {
   Axis3f acc; // Gs, for legacy reasons
+  uint64_t timestamp; // usecTimestamp() when the sample was taken, 0 if unknown
 } accelerationMeasurement_t;
 
 /** barometer measurement */
@@ -303,4 +360,26 @@ typedef struct
 
 #define RATE_DO_EXECUTE(RATE_HZ, TICK) ((TICK % (RATE_MAIN_LOOP / RATE_HZ)) == 0)
 
+// Sub-rate stages are spread over the ticks of the main loop, rather than all running on the same tick, to keep the
+// worst case tick short. A stage runs on the ticks where TICK % (RATE_MAIN_LOOP / RATE_HZ) == PHASE, the phase is
+// taken modulo the period. The per tick load of the phases below is checked at compile time in stabilizer.c
+#define RATE_DO_EXECUTE_WITH_PHASE(RATE_HZ, PHASE, TICK) \
+  (((TICK) % (RATE_MAIN_LOOP / (RATE_HZ))) == ((PHASE) % (RATE_MAIN_LOOP / (RATE_HZ))))
+
+#ifdef COMPLEMENTARY_FAST_ATTITUDE
+// The fast attitude update is cheap enough to run on every tick, at the full IMU rate
+#define COMPLEMENTARY_ATTITUDE_RATE RATE_MAIN_LOOP
+#else
+#define COMPLEMENTARY_ATTITUDE_RATE RATE_250_HZ
+#endif
+#define COMPLEMENTARY_POSITION_RATE RATE_100_HZ
+
+// The attitude stages run on even ticks. The position estimate and the position controller run together on an odd
+// tick, the attitude controller uses the new position controller output on the next tick.
+#define ATTITUDE_PHASE 0
+#define POSITION_PHASE 1
+#define COMPLEMENTARY_ATTITUDE_PHASE ATTITUDE_PHASE
+#define COMPLEMENTARY_POSITION_PHASE POSITION_PHASE
+#define USD_LOGGING_PHASE 3
+
 #endif
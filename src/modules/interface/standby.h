@@ -0,0 +1,48 @@
+/*
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * standby.h - Reduced rate stabilizer loop while landed
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Called from the stabilizer loop for every sensor sample. While the
+ * Crazyflie has been landed and idle for a while the controller (and the
+ * collision avoidance) only runs for every standby.divider sample and the
+ * motors are kept stopped, the estimator and the logging run on every sample.
+ * The loop leaves standby on the first sample after a setpoint, a high level
+ * command or flight is detected.
+ *
+ * @param tick The stabilizer loop tick
+ * @return true if the controller shall run for this sample
+ */
+bool standbyShallRunLoop(const uint32_t tick);
+
+/**
+ * @return true if the stabilizer loop runs at the reduced rate
+ */
+bool standbyIsActive(void);
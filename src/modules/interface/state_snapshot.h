@@ -0,0 +1,95 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * state_snapshot.h - Full state snapshot readable through the memory subsystem
+ */
+
+#ifndef __STATE_SNAPSHOT_H__
+#define __STATE_SNAPSHOT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stabilizer_types.h"
+
+#define STATE_SNAPSHOT_VERSION 1
+
+typedef enum {
+  stateSnapshotCanFly = 1 << 0,
+  stateSnapshotIsFlying = 1 << 1,
+  stateSnapshotIsTumbled = 1 << 2,
+  stateSnapshotArmed = 1 << 3,
+  stateSnapshotBatteryLow = 1 << 4,
+  stateSnapshotCharging = 1 << 5,
+  stateSnapshotConnected = 1 << 6,
+} stateSnapshotFlags_t;
+
+/**
+ * Layout of the snapshot in MEM_TYPE_STATE_SNAPSHOT. The layout only changes
+ * together with the version, new fields are added at the end.
+ */
+typedef struct {
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t size;          // sizeof(stateSnapshot_t)
+  uint32_t sequence;      // Incremented by 2 for each update
+  uint32_t tick;          // Stabilizer tick of the update
+  uint32_t timestamp;     // usecTimestamp() of the update, lower 32 bits
+  state_t state;
+  setpoint_t setpoint;
+  stateCompressed_t stateCompressed;
+  setpointCompressed_t setpointCompressed;
+  float batteryVoltage;   // V
+  uint32_t flags;         // stateSnapshotFlags_t
+  uint16_t rxRate;        // Radio packets per second
+  uint16_t txRate;
+  uint8_t rssi;           // -dBm
+  uint8_t reserved2[3];
+} stateSnapshot_t;
+
+void stateSnapshotInit(void);
+bool stateSnapshotTest(void);
+
+/** Update the snapshot, called by the stabilizer once per loop.
+ *
+ * The battery and link fields are refreshed at 10 Hz.
+ *
+ * @param state The estimated state
+ * @param setpoint The setpoint of the loop
+ * @param stateCompressed The compressed state
+ * @param setpointCompressed The compressed setpoint
+ * @param tick The tick of the stabilizer loop
+ */
+void stateSnapshotUpdate(const state_t* state, const setpoint_t* setpoint,
+                         const stateCompressed_t* stateCompressed,
+                         const setpointCompressed_t* setpointCompressed, uint32_t tick);
+
+/** Read a consistent copy of the latest snapshot
+ *
+ * @param copy The snapshot is copied here
+ * @return true if the copy is from one loop, false if the stabilizer updated
+ * the snapshot during all the attempts
+ */
+bool stateSnapshotRead(stateSnapshot_t* copy);
+
+#endif /* __STATE_SNAPSHOT_H__ */
@@ -31,6 +31,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include "cfassert.h"
 
 /**
@@ -74,6 +75,40 @@
 #endif
 
 
+/**
+ * @brief Registry of the memory allocated by the STATIC_MEM_*_ALLOC() macros.
+ *
+ * Each allocation adds an entry to the .staticMem section. The entries are
+ * collected by the linker and reported, with the region the memory ended up
+ * in and the peak usage of the task stacks, through the memory subsystem
+ * (MEM_TYPE_STATIC_MEM).
+ */
+typedef enum {
+  staticMemKindQueue = 0,
+  staticMemKindTaskStack = 1,
+  staticMemKindPool = 2,
+} staticMemKind_t;
+
+typedef struct {
+  const char* name;
+  const void* address;
+  uint32_t size;
+  uint8_t kind;
+} staticMemEntry_t;
+
+#if defined(UNIT_TEST_MODE)
+  #define STATIC_MEM_REGISTER(NAME, KIND, ADDRESS, SIZE)
+#else
+  #define STATIC_MEM_REGISTER(NAME, KIND, ADDRESS, SIZE) \
+    static const staticMemEntry_t osSys_ ## NAME ## Entry __attribute__((section(".staticMem." #NAME), used)) = { \
+      .name = #NAME, .address = (ADDRESS), .size = (SIZE), .kind = (KIND), };
+#endif
+
+/**
+ * @brief Registers the memory reporting with the memory subsystem
+ */
+void staticMemInit(void);
+
 /**
  * @brief Creation of queues using static memory.
  *
@@ -121,7 +156,8 @@
   static const int osSys_ ## NAME ## Length = (LENGTH); \
   static const int osSys_ ## NAME ## ItemSize = (ITEM_SIZE); \
   NO_DMA_CCM_SAFE_ZERO_INIT static uint8_t osSys_ ## NAME ## Storage[(LENGTH) * (ITEM_SIZE)]; \
-  NO_DMA_CCM_SAFE_ZERO_INIT static StaticQueue_t osSys_ ## NAME ## Mgm;
+  NO_DMA_CCM_SAFE_ZERO_INIT static StaticQueue_t osSys_ ## NAME ## Mgm; \
+  STATIC_MEM_REGISTER(NAME, staticMemKindQueue, osSys_ ## NAME ## Storage, sizeof(osSys_ ## NAME ## Storage))
 
 /**
  * @brief Creates a queue using static memory
@@ -175,7 +211,8 @@
 #define STATIC_MEM_TASK_ALLOC(NAME, STACK_DEPTH) \
   static const int osSys_ ## NAME ## StackDepth = (STACK_DEPTH); \
   static StackType_t osSys_ ## NAME ## StackBuffer[(STACK_DEPTH)]; \
-  NO_DMA_CCM_SAFE_ZERO_INIT static StaticTask_t osSys_ ## NAME ## TaskBuffer;
+  NO_DMA_CCM_SAFE_ZERO_INIT static StaticTask_t osSys_ ## NAME ## TaskBuffer; \
+  STATIC_MEM_REGISTER(NAME, staticMemKindTaskStack, osSys_ ## NAME ## StackBuffer, sizeof(osSys_ ## NAME ## StackBuffer))
 
 /**
  * @brief Allocate variables and stack for a task using static memory.
@@ -191,7 +228,8 @@
 #define STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(NAME, STACK_DEPTH) \
   static const int osSys_ ## NAME ## StackDepth = (STACK_DEPTH); \
   NO_DMA_CCM_SAFE_ZERO_INIT static StackType_t osSys_ ## NAME ## StackBuffer[(STACK_DEPTH)]; \
-  NO_DMA_CCM_SAFE_ZERO_INIT static StaticTask_t osSys_ ## NAME ## TaskBuffer;
+  NO_DMA_CCM_SAFE_ZERO_INIT static StaticTask_t osSys_ ## NAME ## TaskBuffer; \
+  STATIC_MEM_REGISTER(NAME, staticMemKindTaskStack, osSys_ ## NAME ## StackBuffer, sizeof(osSys_ ## NAME ## StackBuffer))
 
 /**
  * @brief Create a task using static memory
@@ -206,3 +244,44 @@
  * @param PRIORITY The task priority
  */
 #define STATIC_MEM_TASK_CREATE(NAME, FUNCTION, TASK_NAME, PARAMETERS, PRIORITY) xTaskCreateStatic((FUNCTION), (TASK_NAME), osSys_ ## NAME ## StackDepth, (PARAMETERS), (PRIORITY), osSys_ ## NAME ## StackBuffer, &osSys_ ## NAME ## TaskBuffer)
+
+
+/**
+ * @brief Creation of object pools using static memory.
+ *
+ * STATIC_MEM_POOL_ALLOC() and STATIC_MEM_POOL_INIT() are used together to set up
+ * a fixed size pool of objects, see staticPool.h. STATIC_MEM_POOL_ALLOC() defines
+ * the objects and the pool, STATIC_MEM_POOL_INIT() initializes the pool.
+ *
+ * Example:
+ * STATIC_MEM_POOL_ALLOC(myPool, struct my_object, 10);
+ * // ...
+ * void init() {
+ *   STATIC_MEM_POOL_INIT(myPool);
+ *   struct my_object* object = staticPoolAlloc(&myPool);
+ * }
+ */
+
+/**
+ * @brief Allocate the objects and the pool (staticPool_t) using static memory.
+ *
+ * Note: the objects are allocated in CCM RAM, pointers to objects in the pool
+ * can not be used for DMA transfers.
+ *
+ * @param NAME The name of the pool variable, also used as base name for the other variables
+ * @param TYPE The type of the objects in the pool
+ * @param CAPACITY The number of objects in the pool
+ */
+#define STATIC_MEM_POOL_ALLOC(NAME, TYPE, CAPACITY) \
+  NO_DMA_CCM_SAFE_ZERO_INIT static TYPE osSys_ ## NAME ## Objects[(CAPACITY)]; \
+  NO_DMA_CCM_SAFE_ZERO_INIT static uint16_t osSys_ ## NAME ## FreeStack[(CAPACITY)]; \
+  STATIC_MEM_REGISTER(NAME, staticMemKindPool, osSys_ ## NAME ## Objects, sizeof(osSys_ ## NAME ## Objects)) \
+  static staticPool_t NAME
+
+/**
+ * @brief Initialize a pool that was allocated with STATIC_MEM_POOL_ALLOC()
+ *
+ * @param NAME The name of the pool, same name that was used in STATIC_MEM_POOL_ALLOC()
+ */
+#define STATIC_MEM_POOL_INIT(NAME) staticPoolInit(&NAME, osSys_ ## NAME ## Objects, sizeof(osSys_ ## NAME ## Objects[0]), \
+  sizeof(osSys_ ## NAME ## Objects) / sizeof(osSys_ ## NAME ## Objects[0]), osSys_ ## NAME ## FreeStack)
@@ -0,0 +1,80 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * timesync.h - Swarm time, a clock shared by the Crazyflies of a swarm
+ */
+
+#ifndef __TIMESYNC_H__
+#define __TIMESYNC_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "crtp.h"
+
+/**
+ * Add a pair of local and swarm time of the same instant, the local clock is
+ * disciplined to the swarm time with a PI loop that corrects the offset and
+ * the drift of the crystal.
+ *
+ * @param localUs usecTimestamp() of the instant
+ * @param swarmUs The swarm time of the instant, in us
+ */
+void timesyncAddSample(const uint64_t localUs, const uint64_t swarmUs);
+
+/**
+ * Called by the radio link for every broadcast packet, as soon as it is
+ * received. The time sync beacons are used as samples.
+ *
+ * @param pk The broadcast packet
+ * @param rxTimestamp usecTimestamp() of the reception
+ */
+void timesyncHandleBroadcast(const CRTPPacket* pk, const uint64_t rxTimestamp);
+
+/**
+ * @return true if the swarm time is known
+ */
+bool timesyncIsLocked(void);
+
+/**
+ * @return The swarm time in us, or usecTimestamp() if not locked
+ */
+uint64_t timesyncNow(void);
+
+/**
+ * Convert a swarm time to usecTimestamp() time, the identity if not locked.
+ */
+uint64_t timesyncToLocal(const uint64_t swarmUs);
+
+/**
+ * Convert a usecTimestamp() time to swarm time, the identity if not locked.
+ */
+uint64_t timesyncToSwarm(const uint64_t localUs);
+
+/**
+ * The timestamp of the log packets in ms, the swarm time if the timesync.logTime
+ * parameter is set and the swarm time is locked, the system tick otherwise.
+ */
+uint32_t timesyncLogTimestamp(void);
+
+#endif /* __TIMESYNC_H__ */
@@ -27,6 +27,21 @@
 #define __WORKER_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  workerPriorityHigh = 0, // Short jobs, such as log blocks, run by the system task
+  workerPriorityLow,      // Slow jobs, such as EEPROM writes, run by a low priority task
+  workerPriorityCount,
+} workerPriority_t;
+
+typedef struct {
+  void (*function)(void*);
+  uint32_t count;
+  uint32_t totalRun; // us
+  uint32_t maxRun;   // us
+  uint32_t maxWait;  // us, from scheduling to start of execution
+} workerJobStats_t;
 
 void workerInit();
 
@@ -44,6 +59,7 @@ void workerLoop();
  * Schedule a function for execution by the worker loop
  * The function will be executed as soon as possible by the worker loop.
  * Scheduled functions are stacked in a FIFO queue.
+ * Same as workerScheduleWithPriority() with workerPriorityHigh.
  *
  * @param function Function to be executed
  * @param arg      Argument that will be passed to the function when executed
@@ -51,4 +67,27 @@ void workerLoop();
  */
 int workerSchedule(void (*function)(void*), void *arg);
 
+/**
+ * Schedule a function for execution in a priority class
+ * Each class has its own FIFO queue and task, a job that blocks, for instance
+ * on an EEPROM write, should be scheduled as workerPriorityLow so that it does
+ * not delay the high priority jobs. A high priority job that finds that it has
+ * long work to do can hand it over by scheduling it as a low priority job.
+ *
+ * @param priority The priority class
+ * @param function Function to be executed
+ * @param arg      Argument that will be passed to the function when executed
+ * @return         0 in case of success, ENOMEM if the queue is full.
+ */
+int workerScheduleWithPriority(workerPriority_t priority, void (*function)(void*), void *arg);
+
+/**
+ * Get the run time and queue wait statistics of a job type, one per function
+ *
+ * @param index Index of the job type
+ * @param stats Filled with the statistics
+ * @return      true if there is a job type at the index
+ */
+bool workerGetJobStats(int index, workerJobStats_t* stats);
+
 #endif //__WORKER_H
@@ -31,46 +31,157 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "queue.h"
+#include "queuemonitor.h"
+#include "static_mem.h"
+#include "log.h"
 
 #include "crtp.h"
 #include "platformservice.h"
 
+// Header byte of message fragments
+#define FRAGMENT_FIRST 0x80
+#define FRAGMENT_LAST 0x40
+#define FRAGMENT_SEQ_MASK 0x3f
+#define FRAGMENT_PAYLOAD_SIZE (APPCHANNEL_MTU - 1)
+
+typedef struct {
+  uint16_t length;
+  uint8_t data[APPCHANNEL_MESSAGE_MAX_SIZE];
+} message_t;
+
 static SemaphoreHandle_t sendMutex;
 
+// Received packets are stored in a pool and handed out by index, the free
+// queue holds the indexes of the unused buffers
+static CRTPPacket rxPool[APPCHANNEL_RX_QUEUE_LENGTH];
+STATIC_MEM_QUEUE_ALLOC(appchRxQueue, APPCHANNEL_RX_QUEUE_LENGTH, sizeof(uint8_t));
 static xQueueHandle  rxQueue;
+STATIC_MEM_QUEUE_ALLOC(appchFreeQueue, APPCHANNEL_RX_QUEUE_LENGTH, sizeof(uint8_t));
+static xQueueHandle  freeQueue;
+
+STATIC_MEM_QUEUE_ALLOC(appchMessageQueue, 1, sizeof(message_t));
+static xQueueHandle  messageQueue;
+static message_t rxMessage;
+static uint8_t rxMessageSeq;
+static bool rxMessageActive;
 
 static bool overflow;
 
+// Statistics
+static uint32_t txPackets;
+static uint32_t txBytes;
+static uint32_t txCropped;
+static uint32_t rxPackets;
+static uint32_t rxBytes;
+static uint32_t rxDrops;
+static uint32_t rxMessageDrops;
+
+static TickType_t timeoutToTicks(int timeout_ms)
+{
+  if (timeout_ms < 0) {
+    return portMAX_DELAY;
+  } else {
+    return M2T(timeout_ms);
+  }
+}
+
 void appchannelSendPacket(void* data, size_t length)
 {
   static CRTPPacket packet;
 
   xSemaphoreTake(sendMutex, portMAX_DELAY);
 
+  if (length > APPCHANNEL_MTU) {
+    txCropped++;
+  }
+
   packet.size = (length > APPCHANNEL_MTU)?APPCHANNEL_MTU:length;
   memcpy(packet.data, data, packet.size);
 
   // CRTP channel and ports are set in platformservice
   platformserviceSendAppchannelPacket(&packet);
+  txPackets++;
+  txBytes += packet.size;
 
   xSemaphoreGive(sendMutex);
 }
 
-size_t appchannelReceivePacket(void* buffer, size_t max_length, int timeout_ms) {
+void appchannelSendMessage(void* data, size_t length)
+{
   static CRTPPacket packet;
-  int tickToWait = 0;
+  static uint8_t seq;
+  const uint8_t* src = data;
+  uint8_t flags = FRAGMENT_FIRST;
 
-  if (timeout_ms < 0) {
-    tickToWait = portMAX_DELAY;
+  xSemaphoreTake(sendMutex, portMAX_DELAY);
+
+  do {
+    const size_t count = (length > FRAGMENT_PAYLOAD_SIZE)?FRAGMENT_PAYLOAD_SIZE:length;
+    length -= count;
+    if (length == 0) {
+      flags |= FRAGMENT_LAST;
+    }
+
+    packet.data[0] = flags | (seq & FRAGMENT_SEQ_MASK);
+    memcpy(&packet.data[1], src, count);
+    packet.size = count + 1;
+
+    platformserviceSendAppchannelFragment(&packet);
+    txPackets++;
+    txBytes += count;
+
+    src += count;
+    seq++;
+    flags = 0;
+  } while (length > 0);
+
+  xSemaphoreGive(sendMutex);
+}
+
+size_t appchannelReceivePacket(void* buffer, size_t max_length, int timeout_ms) {
+  const void* data;
+  size_t length = appchannelReceivePacketBuffer(&data, timeout_ms);
+
+  if (length > 0) {
+    int lenghtToCopy = (max_length < length)?max_length:length;
+    memcpy(buffer, data, lenghtToCopy);
+    appchannelReleasePacketBuffer(data);
+    return lenghtToCopy;
+  } else {
+    return 0;
+  }
+}
+
+size_t appchannelReceivePacketBuffer(const void** data, int timeout_ms)
+{
+  uint8_t index;
+
+  if (xQueueReceive(rxQueue, &index, timeoutToTicks(timeout_ms)) == pdTRUE) {
+    *data = rxPool[index].data;
+    return rxPool[index].size;
   } else {
-    tickToWait = M2T(timeout_ms);
+    *data = NULL;
+    return 0;
   }
+}
 
-  int result = xQueueReceive(rxQueue, &packet, tickToWait);
+void appchannelReleasePacketBuffer(const void* data)
+{
+  for (uint8_t index = 0; index < APPCHANNEL_RX_QUEUE_LENGTH; index++) {
+    if (data == rxPool[index].data) {
+      xQueueSend(freeQueue, &index, 0);
+      return;
+    }
+  }
+}
 
-  if (result == pdTRUE) {
-    int lenghtToCopy = (max_length < packet.size)?max_length:packet.size;
-    memcpy(buffer, packet.data, lenghtToCopy);
+size_t appchannelReceiveMessage(void* buffer, size_t max_length, int timeout_ms)
+{
+  static message_t message;
+
+  if (xQueueReceive(messageQueue, &message, timeoutToTicks(timeout_ms)) == pdTRUE) {
+    int lenghtToCopy = (max_length < message.length)?max_length:message.length;
+    memcpy(buffer, message.data, lenghtToCopy);
     return lenghtToCopy;
   } else {
     return 0;
@@ -89,16 +200,115 @@ void appchannelInit()
 {
   sendMutex = xSemaphoreCreateMutex();
 
-  rxQueue = xQueueCreate(10, sizeof(CRTPPacket));
+  rxQueue = STATIC_MEM_QUEUE_CREATE(appchRxQueue);
+  queueMonitorAddQueue(rxQueue, queueMonitorAppChannel);
+
+  freeQueue = STATIC_MEM_QUEUE_CREATE(appchFreeQueue);
+  for (uint8_t index = 0; index < APPCHANNEL_RX_QUEUE_LENGTH; index++) {
+    xQueueSend(freeQueue, &index, 0);
+  }
+
+  messageQueue = STATIC_MEM_QUEUE_CREATE(appchMessageQueue);
 
   overflow = false;
 }
 
 void appchannelIncomingPacket(CRTPPacket *p)
 {
-  int res = xQueueSend(rxQueue, p, 0);
+  uint8_t index;
 
-  if (res != pdTRUE) {
+  if (xQueueReceive(freeQueue, &index, 0) != pdTRUE) {
     overflow = true;
+    rxDrops++;
+    return;
+  }
+
+  rxPool[index].size = p->size;
+  memcpy(rxPool[index].data, p->data, p->size);
+  xQueueSend(rxQueue, &index, 0);
+
+  rxPackets++;
+  rxBytes += p->size;
+}
+
+void appchannelIncomingFragment(CRTPPacket *p)
+{
+  if (p->size < 1) {
+    return;
+  }
+
+  const uint8_t header = p->data[0];
+  const uint8_t seq = header & FRAGMENT_SEQ_MASK;
+  const size_t count = p->size - 1;
+
+  rxPackets++;
+  rxBytes += count;
+
+  if (header & FRAGMENT_FIRST) {
+    if (rxMessageActive) {
+      rxMessageDrops++;
+    }
+    rxMessage.length = 0;
+    rxMessageActive = true;
+  } else if (!rxMessageActive || seq != rxMessageSeq) {
+    // A fragment was lost, skip the rest of the message
+    if (rxMessageActive) {
+      rxMessageDrops++;
+    }
+    rxMessageActive = false;
+    return;
+  }
+
+  if (rxMessage.length + count > APPCHANNEL_MESSAGE_MAX_SIZE) {
+    rxMessageDrops++;
+    rxMessageActive = false;
+    return;
+  }
+
+  memcpy(&rxMessage.data[rxMessage.length], &p->data[1], count);
+  rxMessage.length += count;
+  rxMessageSeq = (seq + 1) & FRAGMENT_SEQ_MASK;
+
+  if (header & FRAGMENT_LAST) {
+    if (xQueueSend(messageQueue, &rxMessage, 0) != pdTRUE) {
+      overflow = true;
+      rxMessageDrops++;
+    }
+    rxMessageActive = false;
   }
 }
+
+/**
+ * Throughput and drop counters of the app channel. The counters include both
+ * plain packets and message fragments.
+ */
+LOG_GROUP_START(appch)
+/**
+ * @brief Number of packets sent to the ground
+ */
+LOG_ADD(LOG_UINT32, txPackets, &txPackets)
+/**
+ * @brief Number of payload bytes sent to the ground
+ */
+LOG_ADD(LOG_UINT32, txBytes, &txBytes)
+/**
+ * @brief Number of packets that were cropped to APPCHANNEL_MTU when sent
+ */
+LOG_ADD(LOG_UINT32, txCropped, &txCropped)
+/**
+ * @brief Number of packets received from the ground
+ */
+LOG_ADD(LOG_UINT32, rxPackets, &rxPackets)
+/**
+ * @brief Number of payload bytes received from the ground
+ */
+LOG_ADD(LOG_UINT32, rxBytes, &rxBytes)
+/**
+ * @brief Number of received packets dropped because the receive queue was full
+ */
+LOG_ADD(LOG_UINT32, rxDrops, &rxDrops)
+/**
+ * @brief Number of received messages dropped because of lost fragments or a full queue
+ */
+LOG_ADD(LOG_UINT32, rxMsgDrops, &rxMessageDrops)
+LOG_GROUP_STOP(appch)
@@ -0,0 +1,189 @@
+/*
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * LPS node firmware.
+ *
+ * Copyright 2021, Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Foobar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* app_hook.c: App hooks run in the stabilizer loop */
+
+#include "app_hook.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "log.h"
+#include "stm32f4xx.h"
+
+typedef struct {
+  appHook_t hook;
+  uint16_t rate;
+  uint16_t phase;
+  uint32_t budgetCycles;
+  bool enabled;
+  uint8_t consecutiveOverruns;
+
+  // Statistics
+  uint32_t runs;
+  uint32_t overruns;
+  uint32_t maxCycles;
+} appHookEntry_t;
+
+static appHookEntry_t hooks[APP_HOOK_MAX_COUNT];
+static uint8_t hookCount;
+
+int appHookRegister(appHook_t hook, uint16_t rate, uint16_t phase, uint32_t budget_us)
+{
+  if (hook == 0 || rate == 0 || rate > RATE_MAIN_LOOP || (RATE_MAIN_LOOP % rate) != 0) {
+    return -1;
+  }
+
+  int id = -1;
+
+  taskENTER_CRITICAL();
+  if (hookCount < APP_HOOK_MAX_COUNT) {
+    id = hookCount;
+    hooks[id] = (appHookEntry_t) {
+      .hook = hook,
+      .rate = rate,
+      .phase = phase,
+      .budgetCycles = budget_us * (SystemCoreClock / 1000000),
+      .enabled = true,
+    };
+    // The stabilizer task only sees the entry once it is complete
+    hookCount++;
+  }
+  taskEXIT_CRITICAL();
+
+  return id;
+}
+
+bool appHookIsEnabled(int id)
+{
+  if (id < 0 || id >= hookCount) {
+    return false;
+  }
+
+  return hooks[id].enabled;
+}
+
+void appHookRun(const state_t *state, const sensorData_t *sensorData, const uint32_t tick)
+{
+  for (int i = 0; i < hookCount; i++) {
+    appHookEntry_t* entry = &hooks[i];
+
+    if (!entry->enabled || !RATE_DO_EXECUTE_WITH_PHASE(entry->rate, entry->phase, tick)) {
+      continue;
+    }
+
+    const uint32_t start = DWT->CYCCNT;
+    entry->hook(state, sensorData, tick);
+    const uint32_t cycles = DWT->CYCCNT - start;
+
+    entry->runs++;
+    if (cycles > entry->maxCycles) {
+      entry->maxCycles = cycles;
+    }
+
+    if (cycles > entry->budgetCycles) {
+      entry->overruns++;
+      entry->consecutiveOverruns++;
+      if (entry->consecutiveOverruns >= APP_HOOK_OVERRUN_LIMIT) {
+        entry->enabled = false;
+      }
+    } else {
+      entry->consecutiveOverruns = 0;
+    }
+  }
+}
+
+/**
+ * Statistics of the app hooks run in the stabilizer loop, per hook id
+ */
+LOG_GROUP_START(appHook)
+/**
+ * @brief Number of registered hooks
+ */
+LOG_ADD(LOG_UINT8, count, &hookCount)
+/**
+ * @brief Number of calls of hook 0
+ */
+LOG_ADD(LOG_UINT32, runs0, &hooks[0].runs)
+/**
+ * @brief Number of calls of hook 0 that exceeded the budget
+ */
+LOG_ADD(LOG_UINT32, over0, &hooks[0].overruns)
+/**
+ * @brief Longest call of hook 0, in cycles (168 cycles per us)
+ */
+LOG_ADD(LOG_UINT32, max0, &hooks[0].maxCycles)
+/**
+ * @brief Nonzero while hook 0 is enabled
+ */
+LOG_ADD(LOG_UINT8, en0, &hooks[0].enabled)
+/**
+ * @brief Number of calls of hook 1
+ */
+LOG_ADD(LOG_UINT32, runs1, &hooks[1].runs)
+/**
+ * @brief Number of calls of hook 1 that exceeded the budget
+ */
+LOG_ADD(LOG_UINT32, over1, &hooks[1].overruns)
+/**
+ * @brief Longest call of hook 1, in cycles (168 cycles per us)
+ */
+LOG_ADD(LOG_UINT32, max1, &hooks[1].maxCycles)
+/**
+ * @brief Nonzero while hook 1 is enabled
+ */
+LOG_ADD(LOG_UINT8, en1, &hooks[1].enabled)
+/**
+ * @brief Number of calls of hook 2
+ */
+LOG_ADD(LOG_UINT32, runs2, &hooks[2].runs)
+/**
+ * @brief Number of calls of hook 2 that exceeded the budget
+ */
+LOG_ADD(LOG_UINT32, over2, &hooks[2].overruns)
+/**
+ * @brief Longest call of hook 2, in cycles (168 cycles per us)
+ */
+LOG_ADD(LOG_UINT32, max2, &hooks[2].maxCycles)
+/**
+ * @brief Nonzero while hook 2 is enabled
+ */
+LOG_ADD(LOG_UINT8, en2, &hooks[2].enabled)
+/**
+ * @brief Number of calls of hook 3
+ */
+LOG_ADD(LOG_UINT32, runs3, &hooks[3].runs)
+/**
+ * @brief Number of calls of hook 3 that exceeded the budget
+ */
+LOG_ADD(LOG_UINT32, over3, &hooks[3].overruns)
+/**
+ * @brief Longest call of hook 3, in cycles (168 cycles per us)
+ */
+LOG_ADD(LOG_UINT32, max3, &hooks[3].maxCycles)
+/**
+ * @brief Nonzero while hook 3 is enabled
+ */
+LOG_ADD(LOG_UINT8, en3, &hooks[3].enabled)
+LOG_GROUP_STOP(appHook)
@@ -31,6 +31,8 @@
 #include "pid.h"
 #include "param.h"
 #include "log.h"
+#include "saturation_stats.h"
+#include "static_mem.h"
 
 #define ATTITUDE_LPF_CUTOFF_FREQ      15.0f
 #define ATTITUDE_LPF_ENABLE false
@@ -41,20 +43,32 @@
 static inline int16_t saturateSignedInt16(float in)
 {
   // don't use INT16_MIN, because later we may negate it, which won't work for that value.
-  if (in > INT16_MAX)
+  if (in > INT16_MAX) {
+    saturationStatsRateOutput();
     return INT16_MAX;
-  else if (in < -INT16_MAX)
+  } else if (in < -INT16_MAX) {
+    saturationStatsRateOutput();
     return -INT16_MAX;
-  else
+  } else {
     return (int16_t)in;
+  }
 }
 
-PidObject pidRollRate;
-PidObject pidPitchRate;
-PidObject pidYawRate;
-PidObject pidRoll;
-PidObject pidPitch;
-PidObject pidYaw;
+static inline float countIntegratorLimit(const PidObject* pid, const float output)
+{
+  if (pid->iLimit != 0 && (pid->integ >= pid->iLimit || pid->integ <= -pid->iLimit)) {
+    saturationStatsIntegrator();
+  }
+
+  return output;
+}
+
+NO_DMA_CCM_SAFE_ZERO_INIT PidObject pidRollRate;
+NO_DMA_CCM_SAFE_ZERO_INIT PidObject pidPitchRate;
+NO_DMA_CCM_SAFE_ZERO_INIT PidObject pidYawRate;
+NO_DMA_CCM_SAFE_ZERO_INIT PidObject pidRoll;
+NO_DMA_CCM_SAFE_ZERO_INIT PidObject pidPitch;
+NO_DMA_CCM_SAFE_ZERO_INIT PidObject pidYaw;
 
 static int16_t rollOutput;
 static int16_t pitchOutput;
@@ -103,13 +117,13 @@ void attitudeControllerCorrectRatePID(
        float rollRateDesired, float pitchRateDesired, float yawRateDesired)
 {
   pidSetDesired(&pidRollRate, rollRateDesired);
-  rollOutput = saturateSignedInt16(pidUpdate(&pidRollRate, rollRateActual, true));
+  rollOutput = saturateSignedInt16(countIntegratorLimit(&pidRollRate, pidUpdate(&pidRollRate, rollRateActual, true)));
 
   pidSetDesired(&pidPitchRate, pitchRateDesired);
-  pitchOutput = saturateSignedInt16(pidUpdate(&pidPitchRate, pitchRateActual, true));
+  pitchOutput = saturateSignedInt16(countIntegratorLimit(&pidPitchRate, pidUpdate(&pidPitchRate, pitchRateActual, true)));
 
   pidSetDesired(&pidYawRate, yawRateDesired);
-  yawOutput = saturateSignedInt16(pidUpdate(&pidYawRate, yawRateActual, true));
+  yawOutput = saturateSignedInt16(countIntegratorLimit(&pidYawRate, pidUpdate(&pidYawRate, yawRateActual, true)));
 }
 
 void attitudeControllerCorrectAttitudePID(
@@ -118,11 +132,11 @@ void attitudeControllerCorrectAttitudePID(
        float* rollRateDesired, float* pitchRateDesired, float* yawRateDesired)
 {
   pidSetDesired(&pidRoll, eulerRollDesired);
-  *rollRateDesired = pidUpdate(&pidRoll, eulerRollActual, true);
+  *rollRateDesired = countIntegratorLimit(&pidRoll, pidUpdate(&pidRoll, eulerRollActual, true));
 
   // Update PID for pitch axis
   pidSetDesired(&pidPitch, eulerPitchDesired);
-  *pitchRateDesired = pidUpdate(&pidPitch, eulerPitchActual, true);
+  *pitchRateDesired = countIntegratorLimit(&pidPitch, pidUpdate(&pidPitch, eulerPitchActual, true));
 
   // Update PID for yaw axis
   float yawError;
@@ -132,7 +146,7 @@ void attitudeControllerCorrectAttitudePID(
   else if (yawError < -180.0f)
     yawError += 360.0f;
   pidSetError(&pidYaw, yawError);
-  *yawRateDesired = pidUpdate(&pidYaw, eulerYawActual, false);
+  *yawRateDesired = countIntegratorLimit(&pidYaw, pidUpdate(&pidYaw, eulerYawActual, false));
 }
 
 void attitudeControllerResetRollAttitudePID(void)
@@ -0,0 +1,567 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * black_box.c - Crash recorder in the internal flash, readable through the memory subsystem
+ *
+ * A low priority task appends a 32 byte record with the compressed state of
+ * the state snapshot to a ring of flash sectors (sectors 9 to 11, reserved in
+ * the linker scripts): one record at boot, one when the supervisor flags
+ * change and one every 100 ms while armed or flying and for a few seconds
+ * after. The records survive a crash or a reboot and are read through the
+ * memory subsystem (MEM_TYPE_BLACK_BOX) oldest first.
+ *
+ * The stabilizer is never blocked by the recorder: it only reads the state
+ * snapshot, and at most one record (8 words) is programmed per period. The
+ * CPU stalls for the programming of each word (~16 us). Erasing a sector
+ * stalls the flash for a second or more, the sector after the one that is
+ * written is therefore erased ahead, only when neither armed nor flying,
+ * from a function in RAM that keeps the watchdog alive. If the written sector
+ * fills up in flight before the next one is erased, records are dropped
+ * until the next erase. The sectors are used in turn, they wear evenly.
+ *
+ * The commit word (a CRC of the record) is programmed last, a record that is
+ * cut short by a power loss is recognized and skipped. At boot the sectors
+ * are scanned for the record with the highest sequence number, and the
+ * recording resumes after it.
+ */
+
+#define DEBUG_MODULE "BBOX"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32fxxx.h"
+#include "black_box.h"
+#include "state_snapshot.h"
+#include "mem.h"
+#include "config.h"
+#include "system.h"
+#include "crc32.h"
+#include "usec_time.h"
+#include "debug.h"
+#include "log.h"
+#include "param.h"
+#include "static_mem.h"
+
+#define BLACK_BOX_VERSION 1
+#define BLACK_BOX_PERIOD_MS 100
+// Records are kept at full rate for this long after landing or disarming
+#define BLACK_BOX_TAIL_MS 5000
+// No sector is erased during or shortly after a download
+#define BLACK_BOX_DOWNLOAD_HOLD_MS 5000
+
+#define BLACK_BOX_SECTOR_COUNT 3
+#define BLACK_BOX_SECTOR_SIZE (128 * 1024)
+#define BLACK_BOX_RECORD_WORDS 8
+#define BLACK_BOX_SLOTS (BLACK_BOX_SECTOR_SIZE / (BLACK_BOX_RECORD_WORDS * 4))
+#define BLACK_BOX_ERASED_WORD 0xFFFFFFFF
+
+#define BLACK_BOX_FLASH_ERRORS (FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR)
+#define BLACK_BOX_IWDG_RELOAD 0xAAAA
+
+#define BLACK_BOX_ACTIVE_FLAGS (stateSnapshotArmed | stateSnapshotIsFlying)
+
+typedef enum {
+  blackBoxRecordBoot = 0,
+  blackBoxRecordFlags = 1,
+  blackBoxRecordState = 2,
+  blackBoxRecordNone = 0xFF,
+} blackBoxRecordType_t;
+
+// Reset cause in the flags of the boot record
+enum {
+  blackBoxResetPowerOn = 1 << 0,
+  blackBoxResetPin = 1 << 1,
+  blackBoxResetSoftware = 1 << 2,
+  blackBoxResetWatchdog = 1 << 3,
+  blackBoxResetBrownOut = 1 << 4,
+};
+
+typedef struct {
+  uint32_t sequence;  // Over all records, continues after a reboot
+  uint32_t timestamp; // ms since boot
+  int16_t x;          // mm
+  int16_t y;
+  int16_t z;
+  int16_t vx;         // mm/s
+  int16_t vy;
+  int16_t vz;
+  int32_t quat;       // Compressed quaternion, see quatcompress.h
+  uint16_t vbat;      // mV
+  uint8_t type;       // blackBoxRecordType_t
+  uint8_t flags;      // stateSnapshotFlags_t, the reset cause in boot records
+  uint32_t commit;    // CRC32 of the record up to here, programmed last
+} __attribute__((packed)) blackBoxRecord_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t recordSize;
+  uint16_t periodMs;
+  uint32_t recordCount;
+  uint32_t bootSequence; // Sequence of the first record of this boot
+  uint32_t reserved;
+} __attribute__((packed)) blackBoxHeader_t;
+
+typedef struct {
+  blackBoxHeader_t header;
+  uint8_t sectorCount;
+  uint8_t sectors[BLACK_BOX_SECTOR_COUNT];   // Oldest first
+  uint16_t slotCounts[BLACK_BOX_SECTOR_COUNT];
+} blackBoxLayout_t;
+
+static const uint32_t sectorAddresses[BLACK_BOX_SECTOR_COUNT] = {0x080A0000, 0x080C0000, 0x080E0000};
+static const uint32_t sectorIds[BLACK_BOX_SECTOR_COUNT] = {FLASH_Sector_9, FLASH_Sector_10, FLASH_Sector_11};
+
+static bool isInit = false;
+static bool isBroken = false;
+static uint8_t resetCause;
+
+// The write position, changed by the task and read by the memory subsystem in
+// critical sections
+static uint8_t currentSector;
+static uint16_t slotsUsed[BLACK_BOX_SECTOR_COUNT];
+static bool holdsOlderRecords[BLACK_BOX_SECTOR_COUNT];
+static bool isErased[BLACK_BOX_SECTOR_COUNT];
+static uint32_t nextSequence;
+static uint32_t bootSequence;
+static volatile TickType_t lastReadTick;
+
+static stateSnapshot_t snapshot;
+static blackBoxLayout_t latched;
+
+// Log and parameter variables
+static uint8_t enable = 1;
+static uint32_t recordCount;
+static uint32_t droppedCount;
+static uint16_t errorCount;
+static uint16_t eraseCount;
+static uint16_t writeUs;
+
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_BLACK_BOX,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+static void blackBoxTask(void *param);
+STATIC_MEM_TASK_ALLOC(blackBoxTask, BLACK_BOX_TASK_STACKSIZE);
+
+static uint8_t readResetCause(void)
+{
+  uint8_t cause = 0;
+
+  cause |= RCC_GetFlagStatus(RCC_FLAG_PORRST) ? blackBoxResetPowerOn : 0;
+  cause |= RCC_GetFlagStatus(RCC_FLAG_PINRST) ? blackBoxResetPin : 0;
+  cause |= RCC_GetFlagStatus(RCC_FLAG_SFTRST) ? blackBoxResetSoftware : 0;
+  cause |= RCC_GetFlagStatus(RCC_FLAG_IWDGRST) ? blackBoxResetWatchdog : 0;
+  cause |= RCC_GetFlagStatus(RCC_FLAG_BORRST) ? blackBoxResetBrownOut : 0;
+
+  return cause;
+}
+
+void blackBoxInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  resetCause = readResetCause();
+  memoryRegisterHandler(&memDef);
+  STATIC_MEM_TASK_CREATE(blackBoxTask, blackBoxTask, BLACK_BOX_TASK_NAME, NULL, BLACK_BOX_TASK_PRI);
+
+  isInit = true;
+}
+
+static inline uint32_t slotAddress(const int sector, const int slot)
+{
+  return sectorAddresses[sector] + slot * sizeof(blackBoxRecord_t);
+}
+
+static bool isSlotErased(const uint32_t address)
+{
+  const uint32_t* words = (const uint32_t*)address;
+  for (int i = 0; i < BLACK_BOX_RECORD_WORDS; i++) {
+    if (words[i] != BLACK_BOX_ERASED_WORD) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool isRecordValid(const blackBoxRecord_t* record)
+{
+  return record->commit == crc32CalculateBuffer(record, offsetof(blackBoxRecord_t, commit));
+}
+
+// Finds the sector with the highest sequence number, the recording continues
+// after its last used slot. Slots of records that were cut short are skipped.
+static void scanSectors(void)
+{
+  uint32_t maxSequence[BLACK_BOX_SECTOR_COUNT] = {0};
+  bool hasRecords[BLACK_BOX_SECTOR_COUNT] = {false};
+  int newest = -1;
+
+  for (int sector = 0; sector < BLACK_BOX_SECTOR_COUNT; sector++) {
+    int used = BLACK_BOX_SLOTS;
+    while (used > 0 && isSlotErased(slotAddress(sector, used - 1))) {
+      used--;
+    }
+    slotsUsed[sector] = used;
+    isErased[sector] = (used == 0);
+
+    for (int slot = 0; slot < used; slot++) {
+      const blackBoxRecord_t* record = (const blackBoxRecord_t*)slotAddress(sector, slot);
+      if (isRecordValid(record) && (!hasRecords[sector] || record->sequence > maxSequence[sector])) {
+        maxSequence[sector] = record->sequence;
+        hasRecords[sector] = true;
+      }
+    }
+
+    if (hasRecords[sector] && (newest < 0 || maxSequence[sector] > maxSequence[newest])) {
+      newest = sector;
+    }
+  }
+
+  currentSector = (newest < 0) ? 0 : newest;
+  nextSequence = (newest < 0) ? 0 : maxSequence[newest] + 1;
+  bootSequence = nextSequence;
+  for (int sector = 0; sector < BLACK_BOX_SECTOR_COUNT; sector++) {
+    holdsOlderRecords[sector] = hasRecords[sector] && (sector != currentSector);
+  }
+}
+
+static bool programRecord(const uint32_t address, const blackBoxRecord_t* record)
+{
+  uint32_t words[BLACK_BOX_RECORD_WORDS];
+  memcpy(words, record, sizeof(words));
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(FLASH_FLAG_EOP | BLACK_BOX_FLASH_ERRORS);
+
+  // The commit word is the last one, the record is not valid before it is
+  // programmed
+  bool ok = true;
+  for (int i = 0; i < BLACK_BOX_RECORD_WORDS && ok; i++) {
+    ok = (FLASH_ProgramWord(address + i * sizeof(uint32_t), words[i]) == FLASH_COMPLETE);
+  }
+
+  FLASH_Lock();
+  return ok;
+}
+
+static bool appendRecord(const blackBoxRecordType_t type, const stateSnapshot_t* state)
+{
+  if (slotsUsed[currentSector] == BLACK_BOX_SLOTS) {
+    const int next = (currentSector + 1) % BLACK_BOX_SECTOR_COUNT;
+    if (!isErased[next]) {
+      droppedCount++;
+      return false;
+    }
+
+    taskENTER_CRITICAL();
+    holdsOlderRecords[currentSector] = true;
+    currentSector = next;
+    taskEXIT_CRITICAL();
+  }
+
+  blackBoxRecord_t record = {
+    .sequence = nextSequence,
+    .timestamp = T2M(xTaskGetTickCount()),
+    .x = state->stateCompressed.x,
+    .y = state->stateCompressed.y,
+    .z = state->stateCompressed.z,
+    .vx = state->stateCompressed.vx,
+    .vy = state->stateCompressed.vy,
+    .vz = state->stateCompressed.vz,
+    .quat = state->stateCompressed.quat,
+    .vbat = state->batteryVoltage * 1000.0f,
+    .type = type,
+    .flags = (type == blackBoxRecordBoot) ? resetCause : state->flags,
+  };
+  record.commit = crc32CalculateBuffer(&record, offsetof(blackBoxRecord_t, commit));
+
+  const uint64_t start = usecTimestamp();
+  const bool ok = programRecord(slotAddress(currentSector, slotsUsed[currentSector]), &record);
+  writeUs = usecTimestamp() - start;
+
+  // A slot that failed to program is skipped
+  taskENTER_CRITICAL();
+  slotsUsed[currentSector]++;
+  isErased[currentSector] = false;
+  taskEXIT_CRITICAL();
+
+  nextSequence++;
+  if (ok) {
+    recordCount++;
+  } else {
+    errorCount++;
+  }
+
+  return ok;
+}
+
+// Runs from RAM with the interrupts disabled: the CPU stalls on any access to
+// the flash while the sector is erased, which would starve the watchdog.
+// Nothing in the flash may be called from here.
+static __attribute__((section(".data.blackBoxEraseSector"), noinline, long_call))
+uint32_t eraseSectorFromRam(const uint32_t sectorId)
+{
+  __asm volatile ("cpsid i" ::: "memory");
+
+  while (FLASH->SR & FLASH_FLAG_BSY) {
+  }
+
+  FLASH->CR &= CR_PSIZE_MASK;
+  FLASH->CR |= FLASH_PSIZE_WORD;
+  FLASH->CR &= ~FLASH_CR_SNB;
+  FLASH->CR |= FLASH_CR_SER | sectorId;
+  FLASH->CR |= FLASH_CR_STRT;
+
+  while (FLASH->SR & FLASH_FLAG_BSY) {
+    IWDG->KR = BLACK_BOX_IWDG_RELOAD;
+  }
+
+  FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+
+  __asm volatile ("cpsie i" ::: "memory");
+
+  return FLASH->SR & BLACK_BOX_FLASH_ERRORS;
+}
+
+static bool isSectorErased(const int sector)
+{
+  for (int slot = 0; slot < BLACK_BOX_SLOTS; slot++) {
+    if (!isSlotErased(slotAddress(sector, slot))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Erases the sector after the current one, so that a flight can fill at least
+// a full sector. The erase stops the system for a second or more, it is only
+// done on the ground and not during a download.
+static void eraseAhead(const uint32_t flags)
+{
+  const int next = (currentSector + 1) % BLACK_BOX_SECTOR_COUNT;
+  if (isErased[next] || (flags & BLACK_BOX_ACTIVE_FLAGS)) {
+    return;
+  }
+
+  if (xTaskGetTickCount() - lastReadTick < M2T(BLACK_BOX_DOWNLOAD_HOLD_MS)) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  holdsOlderRecords[next] = false;
+  slotsUsed[next] = 0;
+  taskEXIT_CRITICAL();
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(FLASH_FLAG_EOP | BLACK_BOX_FLASH_ERRORS);
+  const uint32_t errors = eraseSectorFromRam(sectorIds[next]);
+  FLASH_Lock();
+  eraseCount++;
+
+  isErased[next] = (errors == 0) && isSectorErased(next);
+  if (!isErased[next]) {
+    // Erasing over and over would stop the system every period
+    DEBUG_PRINT("Erase of sector %d failed, recording stopped\n", next);
+    errorCount++;
+    isBroken = true;
+  }
+}
+
+static void blackBoxTask(void *param)
+{
+  systemWaitStart();
+
+  scanSectors();
+  DEBUG_PRINT("Recording from sequence %lu in sector %d\n", (unsigned long)nextSequence, currentSector);
+
+  bool isBootRecorded = false;
+  uint8_t recordedFlags = 0;
+  TickType_t lastActiveTick = 0;
+  TickType_t lastWakeTime = xTaskGetTickCount();
+
+  while (true) {
+    vTaskDelayUntil(&lastWakeTime, M2T(BLACK_BOX_PERIOD_MS));
+
+    if (!enable || isBroken || !stateSnapshotRead(&snapshot)) {
+      continue;
+    }
+
+    const TickType_t now = xTaskGetTickCount();
+    const uint8_t flags = snapshot.flags;
+    if (flags & BLACK_BOX_ACTIVE_FLAGS) {
+      lastActiveTick = now;
+    }
+
+    blackBoxRecordType_t type = blackBoxRecordNone;
+    if (!isBootRecorded) {
+      type = blackBoxRecordBoot;
+    } else if (flags != recordedFlags) {
+      type = blackBoxRecordFlags;
+    } else if ((flags & BLACK_BOX_ACTIVE_FLAGS) || now - lastActiveTick < M2T(BLACK_BOX_TAIL_MS)) {
+      type = blackBoxRecordState;
+    }
+
+    // A record that is dropped is retried in the next period
+    if (type != blackBoxRecordNone && appendRecord(type, &snapshot)) {
+      if (type == blackBoxRecordBoot) {
+        isBootRecorded = true;
+      } else {
+        recordedFlags = flags;
+      }
+    }
+
+    eraseAhead(flags);
+  }
+}
+
+// The sectors that hold records, oldest first, are latched at a read from
+// address 0 so that the layout does not change during a download
+static void latchLayout(void)
+{
+  uint32_t total = 0;
+
+  taskENTER_CRITICAL();
+  latched.sectorCount = 0;
+  for (int age = BLACK_BOX_SECTOR_COUNT - 1; age >= 0; age--) {
+    const int sector = (currentSector + BLACK_BOX_SECTOR_COUNT - age) % BLACK_BOX_SECTOR_COUNT;
+    if (age == 0 || holdsOlderRecords[sector]) {
+      latched.sectors[latched.sectorCount] = sector;
+      latched.slotCounts[latched.sectorCount] = slotsUsed[sector];
+      total += slotsUsed[sector];
+      latched.sectorCount++;
+    }
+  }
+  latched.header.bootSequence = bootSequence;
+  taskEXIT_CRITICAL();
+
+  latched.header.version = BLACK_BOX_VERSION;
+  latched.header.recordSize = sizeof(blackBoxRecord_t);
+  latched.header.periodMs = BLACK_BOX_PERIOD_MS;
+  latched.header.recordCount = total;
+}
+
+static uint32_t handleMemGetSize(void)
+{
+  uint32_t total = 0;
+
+  taskENTER_CRITICAL();
+  for (int sector = 0; sector < BLACK_BOX_SECTOR_COUNT; sector++) {
+    if (sector == currentSector || holdsOlderRecords[sector]) {
+      total += slotsUsed[sector];
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  return sizeof(blackBoxHeader_t) + total * sizeof(blackBoxRecord_t);
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest)
+{
+  lastReadTick = xTaskGetTickCount();
+
+  if (memAddr == 0) {
+    latchLayout();
+  }
+
+  const uint32_t size = sizeof(blackBoxHeader_t) + latched.header.recordCount * sizeof(blackBoxRecord_t);
+  if (memAddr > size || readLen > size - memAddr) {
+    return false;
+  }
+
+  uint32_t address = memAddr;
+  uint32_t remaining = readLen;
+  while (remaining > 0) {
+    uint32_t length;
+    if (address < sizeof(blackBoxHeader_t)) {
+      length = sizeof(blackBoxHeader_t) - address;
+      length = (length < remaining) ? length : remaining;
+      memcpy(dest, (const uint8_t*)&latched.header + address, length);
+    } else {
+      uint32_t record = (address - sizeof(blackBoxHeader_t)) / sizeof(blackBoxRecord_t);
+      const uint32_t offset = (address - sizeof(blackBoxHeader_t)) % sizeof(blackBoxRecord_t);
+      int i = 0;
+      while (record >= latched.slotCounts[i]) {
+        record -= latched.slotCounts[i];
+        i++;
+      }
+
+      length = sizeof(blackBoxRecord_t) - offset;
+      length = (length < remaining) ? length : remaining;
+      memcpy(dest, (const uint8_t*)slotAddress(latched.sectors[i], record) + offset, length);
+    }
+
+    address += length;
+    dest += length;
+    remaining -= length;
+  }
+
+  return true;
+}
+
+/**
+ * Crash recorder in the internal flash, see MEM_TYPE_BLACK_BOX.
+ */
+PARAM_GROUP_START(blackBox)
+/**
+ * @brief Nonzero to record and erase ahead (default: 1)
+ */
+PARAM_ADD(PARAM_UINT8, enable, &enable)
+PARAM_GROUP_STOP(blackBox)
+
+/**
+ * Statistics of the crash recorder, since startup.
+ */
+LOG_GROUP_START(blackBox)
+/**
+ * @brief Records written
+ */
+LOG_ADD(LOG_UINT32, records, &recordCount)
+/**
+ * @brief Records dropped because the next sector was not erased in time
+ */
+LOG_ADD(LOG_UINT32, dropped, &droppedCount)
+/**
+ * @brief Failed programs and erases
+ */
+LOG_ADD(LOG_UINT16, errors, &errorCount)
+/**
+ * @brief Sectors erased
+ */
+LOG_ADD(LOG_UINT16, erases, &eraseCount)
+/**
+ * @brief Time to program the latest record, us
+ */
+LOG_ADD(LOG_UINT16, writeUs, &writeUs)
+LOG_GROUP_STOP(blackBox)
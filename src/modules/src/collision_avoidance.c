@@ -94,31 +94,29 @@ static struct vec sidestepGoal(
   );
 }
 
-void collisionAvoidanceUpdateSetpointCore(
+// Part 1: Construct the polytope inequalities in A, b, relative to ourPos.
+// Returns the number of rows. A and B must have room for nOthers + 6 rows.
+static int buildCell(
   collision_avoidance_params_t const *params,
-  collision_avoidance_state_t *collisionState,
+  struct vec ourPos,
   int nOthers,
   float const *otherPositions,
-  float *workspace,
-  setpoint_t *setpoint, sensorData_t const *sensorData, state_t const *state)
+  float A[], float B[])
 {
-  //
-  // Part 1: Construct the polytope inequalities in A, b.
-  //
-
-  int const nRows = nOthers + 6;
-  float *A = workspace;
-  float *B = workspace + 3 * nRows;
-  float *projectionWorkspace = workspace + 4 * nRows;
-
   // Compute the cell in a stretched coordinate system for downwash awareness.
   // See header for details.
   struct vec const radiiInv = veltrecip(params->ellipsoidRadii);
-  struct vec const ourPos = vec2svec(state->position);
 
-  // We could do some optimizations here to reduce the number of rows, like
-  // leave out very far away neighbors. It would help the average case
-  // complexity, but not the worst case - so we skip it for now.
+  // The bounding box polytope faces also enforce max speed in the
+  // infinity-norm, so the cell never extends further than maxDist.
+  float const maxDist = params->horizonSecs * params->maxSpeed;
+
+  // Neighbors whose face lies entirely outside of the maxDist box cannot
+  // change the cell and are left out. A face a^T x <= b with unit a is
+  // redundant if b >= maxDist * |a|_1, the support of the box in direction a.
+  // Rows are only written at or below the index that is read, so the input
+  // may overlap the workspace.
+  int nNeighborRows = 0;
   for (int i = 0; i < nOthers; ++i) {
     struct vec peerPos = vloadf(otherPositions + 3 * i);
     struct vec const toPeerStretched = veltmul(vsub(peerPos, ourPos), radiiInv);
@@ -126,30 +124,41 @@ void collisionAvoidanceUpdateSetpointCore(
     struct vec const a = vdiv(veltmul(toPeerStretched, radiiInv), dist);
     float const b = dist / 2.0f - 1.0f;
     float scale = 1.0f / vmag(a);
-    vstoref(vscl(scale, a), A + 3 * i);
-    B[i] = scale * b;
+    struct vec const aUnit = vscl(scale, a);
+    if (scale * b >= maxDist * vnorm1(aUnit)) {
+      continue;
+    }
+    vstoref(aUnit, A + 3 * nNeighborRows);
+    B[nNeighborRows] = scale * b;
+    ++nNeighborRows;
   }
 
-  // Add the bounding box polytope faces. We also use the box faces to enforce
-  // max speed in the infinity-norm.
-  float const maxDist = params->horizonSecs * params->maxSpeed;
+  int const nRows = nNeighborRows + 6;
 
-  memset(A + 3 * nOthers, 0, 18 * sizeof(float));
+  // Add the bounding box polytope faces.
+  memset(A + 3 * nNeighborRows, 0, 18 * sizeof(float));
 
   for (int dim = 0; dim < 3; ++dim) {
     float boxMax = vindex(params->bboxMax, dim) - vindex(ourPos, dim);
-    A[3 * (nOthers + dim) + dim] = 1.0f;
-    B[nOthers + dim] = fminf(maxDist, boxMax);
+    A[3 * (nNeighborRows + dim) + dim] = 1.0f;
+    B[nNeighborRows + dim] = fminf(maxDist, boxMax);
 
     float boxMin = vindex(params->bboxMin, dim) - vindex(ourPos, dim);
-    A[3 * (nOthers + dim + 3) + dim] = -1.0f;
-    B[nOthers + dim + 3] = -fmaxf(-maxDist, boxMin);
+    A[3 * (nNeighborRows + dim + 3) + dim] = -1.0f;
+    B[nNeighborRows + dim + 3] = -fmaxf(-maxDist, boxMin);
   }
 
-  //
-  // Part 2: Use the constructed polytope to modify the setpoint.
-  //
+  return nRows;
+}
 
+// Part 2: Use the constructed polytope to modify the setpoint.
+static void applyCell(
+  collision_avoidance_params_t const *params,
+  collision_avoidance_state_t *collisionState,
+  float const A[], float const B[], float projectionWorkspace[], int nRows,
+  struct vec ourPos,
+  setpoint_t *setpoint)
+{
   float const inPolytopeTolerance = 10.0f * params->voronoiProjectionTolerance;
 
   struct vec setPos = vec2svec(setpoint->position);
@@ -252,6 +261,23 @@ void collisionAvoidanceUpdateSetpointCore(
   setpoint->velocity = svec2vec(setVel);
 }
 
+void collisionAvoidanceUpdateSetpointCore(
+  collision_avoidance_params_t const *params,
+  collision_avoidance_state_t *collisionState,
+  int nOthers,
+  float const *otherPositions,
+  float *workspace,
+  setpoint_t *setpoint, sensorData_t const *sensorData, state_t const *state)
+{
+  float *A = workspace;
+  float *B = workspace + 3 * (nOthers + 6);
+  float *projectionWorkspace = workspace + 4 * (nOthers + 6);
+  struct vec const ourPos = vec2svec(state->position);
+
+  int const nRows = buildCell(params, ourPos, nOthers, otherPositions, A, B);
+  applyCell(params, collisionState, A, B, projectionWorkspace, nRows, ourPos, setpoint);
+}
+
 
 //
 // Everything below this comment will only be compiled in a firware build made
@@ -265,6 +291,7 @@ void collisionAvoidanceUpdateSetpointCore(
 
 #include "param.h"
 #include "log.h"
+#include "static_mem.h"
 
 
 static uint8_t collisionAvoidanceEnable = 0;
@@ -294,38 +321,152 @@ bool collisionAvoidanceTest()
   return true;
 }
 
+// The peers that feed the Voronoi cell are the nearest ones, in the stretched
+// coordinate system of the collision ellipsoid. With a dense swarm the faces
+// of far away peers are hidden behind the faces of the near ones anyway.
+#define MAX_CELL_NEIGHBORS 16
+
 // Each face of the Voronoi cell is defined by a linear inequality a^T x <= b.
 // The algorithm for projecting a point into a convex polytope requires 3 more
 // floats of working space per face. The six extra faces come from the overall
 // flight area bounding box.
-#define MAX_CELL_ROWS (PEER_LOCALIZATION_MAX_NEIGHBORS + 6)
-static float workspace[7 * MAX_CELL_ROWS];
+#define MAX_CELL_ROWS (MAX_CELL_NEIGHBORS + 6)
+NO_DMA_CCM_SAFE_ZERO_INIT static float workspace[7 * MAX_CELL_ROWS];
+
+// Indices in the peer localization table of the nearest peers, selected when
+// the peer positions change
+static uint8_t neighbors[MAX_CELL_NEIGHBORS];
+static int nNeighbors = 0;
+static uint32_t neighborsUpdateCount = 0;
+static bool neighborsValid = false;
 
 // Latency counter for logging.
 static uint32_t latency = 0;
 
+// The cell is solved at this rate, peer positions arrive at 10-50 Hz. On the
+// ticks in between the setpoint is only checked against the last solved cell.
+// RATE_MAIN_LOOP or 0 solves on every tick.
+static uint16_t solveRate = RATE_100_HZ;
+
+// The last solved cell, in the world frame: A (x - origin) <= B
+NO_DMA_CCM_SAFE_ZERO_INIT static struct {
+  bool valid;
+  struct vec origin;
+  int nRows;
+  float A[3 * MAX_CELL_ROWS];
+  float B[MAX_CELL_ROWS];
+  struct vec setPos; // the last solved setpoint
+  struct vec setVel;
+} cell;
+
+// Checks the setpoint against the last solved cell, the cheap part of the
+// solve. A setpoint that leaves the cell is replaced by the last solved one.
+static void clampToCell(setpoint_t *setpoint, state_t const *state)
+{
+  float const inPolytopeTolerance = 10.0f * params.voronoiProjectionTolerance;
+  struct vec const ourPos = vec2svec(state->position);
+  struct vec setPos = vec2svec(setpoint->position);
+  struct vec setVel = vec2svec(setpoint->velocity);
+
+  if (setpoint->mode.x == modeVelocity) {
+    struct vec const pseudoGoal = vsub(vadd(ourPos, vscl(params.horizonSecs, setVel)), cell.origin);
+    if (!vinpolytope(pseudoGoal, cell.A, cell.B, cell.nRows, inPolytopeTolerance)) {
+      setVel = cell.setVel;
+    }
+  }
+  else if (setpoint->mode.x == modeAbs) {
+    struct vec const setPosRelative = vsub(setPos, cell.origin);
+    if (!vinpolytope(setPosRelative, cell.A, cell.B, cell.nRows, inPolytopeTolerance)) {
+      setPos = cell.setPos;
+      setVel = vzero();
+    }
+    else if (!veq(setVel, vzero())) {
+      float const scale = rayintersectpolytope(setPosRelative, setVel, cell.A, cell.B, cell.nRows, NULL);
+      if (scale < 1.0f) {
+        setVel = vscl(scale, setVel);
+      }
+    }
+  }
+
+  setpoint->position = svec2vec(setPos);
+  setpoint->velocity = svec2vec(setVel);
+}
+
+static bool isPeerUsable(peerLocalizationOtherPosition_t const *otherPos, TickType_t time)
+{
+  if (otherPos == NULL || otherPos->id == 0) {
+    return false;
+  }
+
+  bool doAgeFilter = params.maxPeerLocAgeMillis >= 0;
+  return !(doAgeFilter && (time - otherPos->pos.timestamp > params.maxPeerLocAgeMillis));
+}
+
+// Keeps the MAX_CELL_NEIGHBORS nearest peers, sorted by distance, with an
+// insertion into the short list for each peer.
+static void selectNeighbors(state_t const *state, TickType_t time)
+{
+  struct vec const radiiInv = veltrecip(params.ellipsoidRadii);
+  struct vec const ourPos = vec2svec(state->position);
+  float distances[MAX_CELL_NEIGHBORS];
+
+  nNeighbors = 0;
+  int const nPeers = peerLocalizationGetPeerCount();
+  for (int i = 0; i < nPeers; ++i) {
+    peerLocalizationOtherPosition_t const *otherPos = peerLocalizationGetPositionByIdx(i);
+    if (!isPeerUsable(otherPos, time)) {
+      continue;
+    }
+
+    struct vec const peerPos = mkvec(otherPos->pos.x, otherPos->pos.y, otherPos->pos.z);
+    float const dist = vmag2(veltmul(vsub(peerPos, ourPos), radiiInv));
+    if (nNeighbors == MAX_CELL_NEIGHBORS && dist >= distances[nNeighbors - 1]) {
+      continue;
+    }
+
+    int j = (nNeighbors < MAX_CELL_NEIGHBORS) ? nNeighbors++ : nNeighbors - 1;
+    for (; j > 0 && distances[j - 1] > dist; --j) {
+      distances[j] = distances[j - 1];
+      neighbors[j] = neighbors[j - 1];
+    }
+    distances[j] = dist;
+    neighbors[j] = i;
+  }
+}
+
 void collisionAvoidanceUpdateSetpoint(
   setpoint_t *setpoint, sensorData_t const *sensorData, state_t const *state, uint32_t tick)
 {
   if (!collisionAvoidanceEnable) {
+    cell.valid = false;
+    return;
+  }
+
+  bool const solve = !cell.valid || solveRate == 0 || solveRate >= RATE_MAIN_LOOP
+    || RATE_DO_EXECUTE(solveRate, tick);
+  if (!solve) {
+    clampToCell(setpoint, state);
     return;
   }
 
   TickType_t const time = xTaskGetTickCount();
-  bool doAgeFilter = params.maxPeerLocAgeMillis >= 0;
+
+  // The nearest peers only change when their positions do
+  uint32_t const updateCount = peerLocalizationGetUpdateCount();
+  if (!neighborsValid || updateCount != neighborsUpdateCount) {
+    selectNeighbors(state, time);
+    neighborsUpdateCount = updateCount;
+    neighborsValid = true;
+  }
 
   // Counts the actual number of neighbors after we filter stale measurements.
   int nOthers = 0;
 
-  for (int i = 0; i < PEER_LOCALIZATION_MAX_NEIGHBORS; ++i) {
+  for (int i = 0; i < nNeighbors; ++i) {
 
-    peerLocalizationOtherPosition_t const *otherPos = peerLocalizationGetPositionByIdx(i);
-
-    if (otherPos == NULL || otherPos->id == 0) {
-      continue;
-    }
+    peerLocalizationOtherPosition_t const *otherPos = peerLocalizationGetPositionByIdx(neighbors[i]);
 
-    if (doAgeFilter && (time - otherPos->pos.timestamp > params.maxPeerLocAgeMillis)) {
+    if (!isPeerUsable(otherPos, time)) {
       continue;
     }
 
@@ -335,7 +476,21 @@ void collisionAvoidanceUpdateSetpoint(
     ++nOthers;
   }
 
-  collisionAvoidanceUpdateSetpointCore(&params, &collisionState, nOthers, workspace, workspace, setpoint, sensorData, state);
+  float *A = workspace;
+  float *B = workspace + 3 * (nOthers + 6);
+  float *projectionWorkspace = workspace + 4 * (nOthers + 6);
+  struct vec const ourPos = vec2svec(state->position);
+
+  int const nRows = buildCell(&params, ourPos, nOthers, workspace, A, B);
+  applyCell(&params, &collisionState, A, B, projectionWorkspace, nRows, ourPos, setpoint);
+
+  cell.valid = true;
+  cell.origin = ourPos;
+  cell.nRows = nRows;
+  memcpy(cell.A, A, 3 * nRows * sizeof(float));
+  memcpy(cell.B, B, nRows * sizeof(float));
+  cell.setPos = vec2svec(setpoint->position);
+  cell.setVel = vec2svec(setpoint->velocity);
 
   latency = xTaskGetTickCount() - time;
 }
@@ -347,6 +502,7 @@ LOG_GROUP_STOP(colAv)
 
 PARAM_GROUP_START(colAv)
   PARAM_ADD(PARAM_UINT8, enable, &collisionAvoidanceEnable)
+  PARAM_ADD(PARAM_UINT16, solveRate, &solveRate)
 
   PARAM_ADD(PARAM_FLOAT, ellipsoidX, &params.ellipsoidRadii.x)
   PARAM_ADD(PARAM_FLOAT, ellipsoidY, &params.ellipsoidRadii.y)
@@ -28,6 +28,7 @@
 
 #include "config.h"
 
+#include "comm.h"
 #include "crtp.h"
 #include "console.h"
 #include "crtpservice.h"
@@ -37,6 +38,9 @@
 #include "uart_syslink.h"
 #include "radiolink.h"
 #include "usblink.h"
+#ifdef CRTP_OVER_SEGGER_RTT
+#include "rttlink.h"
+#endif
 #include "platformservice.h"
 #include "syslink.h"
 #include "crtp_localization_service.h"
@@ -50,13 +54,16 @@ void commInit(void)
 
   uartslkInit();
   radiolinkInit();
+#ifdef CRTP_OVER_SEGGER_RTT
+  rttlinkInit();
+#endif
 
   /* These functions are moved to be initialized early so
    * that DEBUG_PRINT can be used early */
   // crtpInit();
   // consoleInit();
 
-  crtpSetLink(radiolinkGetLink());
+  crtpSetLink(commGetDefaultLink());
 
   crtpserviceInit();
   platformserviceInit();
@@ -74,6 +81,15 @@ void commInit(void)
   isInit = true;
 }
 
+struct crtpLinkOperations * commGetDefaultLink(void)
+{
+#ifdef CRTP_OVER_SEGGER_RTT
+  return rttlinkGetLink();
+#else
+  return radiolinkGetLink();
+#endif
+}
+
 bool commTest(void)
 {
   bool pass=isInit;
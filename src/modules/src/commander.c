@@ -32,6 +32,7 @@
 #include "commander.h"
 #include "crtp_commander.h"
 #include "crtp_commander_high_level.h"
+#include "setpoint_buffer.h"
 
 #include "cf_math.h"
 #include "param.h"
@@ -46,6 +47,12 @@ const static int priorityDisable = COMMANDER_PRIORITY_DISABLE;
 static uint32_t lastUpdate;
 static bool enableHighLevel = false;
 
+// Time stamped setpoints, played out instead of the queued setpoint while
+// playBuffered is set
+static setpointBuffer_t timedSetpoints;
+static volatile bool playBuffered;
+static uint16_t bufferDelay = 30;
+
 static QueueHandle_t setpointQueue;
 STATIC_MEM_QUEUE_ALLOC(setpointQueue, 1, sizeof(setpoint_t));
 static QueueHandle_t priorityQueue;
@@ -66,6 +73,8 @@ void commanderInit(void)
   crtpCommanderHighLevelInit();
   lastUpdate = xTaskGetTickCount();
 
+  setpointBufferInit(&timedSetpoints, bufferDelay);
+
   isInit = true;
 }
 
@@ -77,6 +86,7 @@ void commanderSetSetpoint(setpoint_t *setpoint, int priority)
   ASSERT(peekResult == pdTRUE);
 
   if (priority >= currentPriority) {
+    playBuffered = false;
     setpoint->timestamp = xTaskGetTickCount();
     // This is a potential race but without effect on functionality
     xQueueOverwrite(setpointQueue, setpoint);
@@ -87,6 +97,31 @@ void commanderSetSetpoint(setpoint_t *setpoint, int priority)
   }
 }
 
+void commanderSetTimedSetpoint(setpoint_t *setpoint, int priority)
+{
+  int currentPriority;
+
+  const BaseType_t peekResult = xQueuePeek(priorityQueue, &currentPriority, 0);
+  ASSERT(peekResult == pdTRUE);
+
+  if (priority >= currentPriority) {
+    const uint32_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    timedSetpoints.playoutDelay = bufferDelay;
+    setpointBufferPush(&timedSetpoints, (uint16_t)setpoint->timestamp, setpoint, T2M(now));
+    taskEXIT_CRITICAL();
+
+    // The queued setpoint feeds the watchdog, and is used until the first
+    // buffered setpoint is due
+    setpoint->timestamp = now;
+    xQueueOverwrite(setpointQueue, setpoint);
+    xQueueOverwrite(priorityQueue, &priority);
+    playBuffered = true;
+    crtpCommanderHighLevelStop();
+  }
+}
+
 void commanderNotifySetpointsStop(int remainValidMillisecs)
 {
   uint32_t currentTime = xTaskGetTickCount();
@@ -106,6 +141,13 @@ void commanderGetSetpoint(setpoint_t *setpoint, const state_t *state)
   lastUpdate = setpoint->timestamp;
   uint32_t currentTime = xTaskGetTickCount();
 
+  if (playBuffered && (currentTime - setpoint->timestamp) <= COMMANDER_WDT_TIMEOUT_STABILIZE) {
+    taskENTER_CRITICAL();
+    setpointBufferGet(&timedSetpoints, T2M(currentTime), setpoint);
+    taskEXIT_CRITICAL();
+    setpoint->timestamp = lastUpdate;
+  }
+
   if ((currentTime - setpoint->timestamp) > COMMANDER_WDT_TIMEOUT_SHUTDOWN) {
     if (enableHighLevel) {
       crtpCommanderHighLevelGetSetpoint(setpoint, state);
@@ -154,4 +196,5 @@ int commanderGetActivePriority(void)
 
 PARAM_GROUP_START(commander)
 PARAM_ADD(PARAM_UINT8, enHighLevel, &enableHighLevel)
+PARAM_ADD(PARAM_UINT16, bufDelay, &bufferDelay)
 PARAM_GROUP_STOP(commander)
@@ -22,6 +22,11 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  *
  * console.c - Used to send console data to client
+ * console.c - Used to send console data to client
+ *
+ * Text is written to a ring buffer and the call returns immediately, text
+ * that does not fit is dropped. A low priority task sends the buffer in CRTP
+ * packets when there is room in the TX queue.
  */
 
 #include <stdbool.h>
@@ -29,9 +34,13 @@
 
 /*FreeRtos includes*/
 #include "FreeRTOS.h"
-#include "semphr.h"
+#include "task.h"
 
+#include "config.h"
+#include "console.h"
 #include "crtp.h"
+#include "static_mem.h"
+#include "log.h"
 
 #ifdef STM32F40_41xxx
 #include "stm32f4xx.h"
@@ -42,44 +51,45 @@
 #endif
 #endif
 
-static CRTPPacket messageToPrint;
-static bool messageSendingIsPending = false;
-static xSemaphoreHandle synch = NULL;
+// Must be a power of two
+#ifndef CONSOLE_BUFFER_SIZE
+#define CONSOLE_BUFFER_SIZE 512
+#endif
+
+// The buffer is sent at least this often, writers wake the task earlier when
+// a line or a full packet has been written
+#define CONSOLE_FLUSH_PERIOD_MS 20
+
+// Free packets left in the TX queue for the other ports of the traffic class
+#define CONSOLE_TX_RESERVE 2
+#define CONSOLE_TX_BACKOFF_MS 5
+
+static char buffer[CONSOLE_BUFFER_SIZE];
+// Free running indexes, head is written by the writers in a critical section
+// and tail only by the console task
+static volatile uint32_t head;
+static volatile uint32_t tail;
+
+static uint32_t droppedBytes;
+static uint32_t maxFill;
 
 static const char bufferFullMsg[] = "<F>\n";
 static bool isInit;
 
-static void addBufferFullMarker();
+static TaskHandle_t consoleTaskHandle;
+STATIC_MEM_TASK_ALLOC(consoleTask, CONSOLE_TASK_STACKSIZE);
 
+static void consoleTask(void* param);
 
-/**
- * Send the data to the client
- * returns TRUE if successful otherwise FALSE
- */
-static bool consoleSendMessage(void)
-{
-  if (crtpSendPacket(&messageToPrint) == pdTRUE)
-  {
-    messageToPrint.size = 0;
-    messageSendingIsPending = false;
-  }
-  else
-  {
-    return false;
-  }
-
-  return true;
-}
 
 void consoleInit()
 {
   if (isInit)
     return;
 
-  messageToPrint.size = 0;
-  messageToPrint.header = CRTP_HEADER(CRTP_PORT_CONSOLE, 0);
-  vSemaphoreCreateBinary(synch);
-  messageSendingIsPending = false;
+  head = 0;
+  tail = 0;
+  consoleTaskHandle = STATIC_MEM_TASK_CREATE(consoleTask, consoleTask, CONSOLE_TASK_NAME, NULL, CONSOLE_TASK_PRI);
 
   isInit = true;
 }
@@ -89,7 +99,44 @@ bool consoleTest(void)
   return isInit;
 }
 
-int consolePutchar(int ch)
+// Copies as much as fits, returns true if the console task should be woken up
+static bool bufferWrite(const char* data, int len)
+{
+  const uint32_t fill = head - tail;
+  uint32_t count = CONSOLE_BUFFER_SIZE - fill;
+  if ((uint32_t)len < count) {
+    count = len;
+  }
+
+  const uint32_t start = head % CONSOLE_BUFFER_SIZE;
+  const uint32_t firstPart = CONSOLE_BUFFER_SIZE - start;
+  if (count <= firstPart) {
+    memcpy(&buffer[start], data, count);
+  } else {
+    memcpy(&buffer[start], data, firstPart);
+    memcpy(buffer, &data[firstPart], count - firstPart);
+  }
+  head += count;
+
+  droppedBytes += len - count;
+  if (fill + count > maxFill) {
+    maxFill = fill + count;
+  }
+
+  return (count > 0 && data[count - 1] == '\n') || fill + count >= CRTP_MAX_DATA_SIZE;
+}
+
+static int consoleWriteFromISR(const char* data, int len)
+{
+  UBaseType_t savedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+  bufferWrite(data, len);
+  taskEXIT_CRITICAL_FROM_ISR(savedInterruptStatus);
+
+  // The console task picks up the text on its next periodic flush
+  return len;
+}
+
+int consoleWrite(const char* data, int len)
 {
   bool isInInterrupt = (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0;
 
@@ -98,51 +145,33 @@ int consolePutchar(int ch)
   }
 
   if (isInInterrupt) {
-    return consolePutcharFromISR(ch);
+    return consoleWriteFromISR(data, len);
   }
 
-  if (xSemaphoreTake(synch, portMAX_DELAY) == pdTRUE)
-  {
-    // Try to send if we already have a pending message
-    if (messageSendingIsPending) 
-    {
-      consoleSendMessage();
-    }
-
-    if (! messageSendingIsPending) 
-    {
-      if (messageToPrint.size < CRTP_MAX_DATA_SIZE)
-      {
-        messageToPrint.data[messageToPrint.size] = (unsigned char)ch;
-        messageToPrint.size++;
-      }
+  taskENTER_CRITICAL();
+  bool wakeUp = bufferWrite(data, len);
+  taskEXIT_CRITICAL();
 
-      if (ch == '\n' || messageToPrint.size >= CRTP_MAX_DATA_SIZE)
-      {
-        if (crtpGetFreeTxQueuePackets() == 1)
-        {
-          addBufferFullMarker();
-        }
-        messageSendingIsPending = true;
-        consoleSendMessage();
-      }
-    }
-    xSemaphoreGive(synch);
+  if (wakeUp) {
+    xTaskNotifyGive(consoleTaskHandle);
   }
 
+  return len;
+}
+
+int consolePutchar(int ch)
+{
+  const char c = ch;
+  consoleWrite(&c, 1);
+
   return (unsigned char)ch;
 }
 
 int consolePutcharFromISR(int ch) {
-  BaseType_t higherPriorityTaskWoken;
+  const char c = ch;
 
-  if (xSemaphoreTakeFromISR(synch, &higherPriorityTaskWoken) == pdTRUE) {
-    if (messageToPrint.size < CRTP_MAX_DATA_SIZE)
-    {
-      messageToPrint.data[messageToPrint.size] = (unsigned char)ch;
-      messageToPrint.size++;
-    }
-    xSemaphoreGiveFromISR(synch, &higherPriorityTaskWoken);
+  if (isInit) {
+    consoleWriteFromISR(&c, 1);
   }
 
   return ch;
@@ -150,47 +179,72 @@ int consolePutcharFromISR(int ch) {
 
 int consolePuts(char *str)
 {
-  int ret = 0;
-
-  while(*str)
-    ret |= consolePutchar(*str++);
-
-  return ret;
+  return consoleWrite(str, strlen(str));
 }
 
 void consoleFlush(void)
 {
-  if (xSemaphoreTake(synch, portMAX_DELAY) == pdTRUE)
-  {
-    consoleSendMessage();
-    xSemaphoreGive(synch);
+  if (isInit) {
+    xTaskNotifyGive(consoleTaskHandle);
   }
 }
 
-
-static int findMarkerStart()
+static void waitForTxQueue(void)
 {
-  int start = messageToPrint.size;
-  
-  // If last char is new line, rewind one char since the marker contains a new line.
-  if (start > 0 && messageToPrint.data[start - 1] == '\n')
-  {
-    start -= 1;
+  while (crtpGetFreeTxQueuePacketsForPort(CRTP_PORT_CONSOLE) <= CONSOLE_TX_RESERVE) {
+    vTaskDelay(M2T(CONSOLE_TX_BACKOFF_MS));
   }
-
-  return start;
 }
 
-static void addBufferFullMarker()
+static void consoleTask(void* param)
 {
-  // Try to add the marker after the message if it fits in the buffer, otherwise overwrite the end of the message 
-  int endMarker = findMarkerStart() + sizeof(bufferFullMsg);
-  if (endMarker >= (CRTP_MAX_DATA_SIZE)) 
-  {
-    endMarker = CRTP_MAX_DATA_SIZE;
-  }
+  static CRTPPacket messageToPrint;
+  uint32_t reportedDroppedBytes = 0;
+
+  messageToPrint.header = CRTP_HEADER(CRTP_PORT_CONSOLE, 0);
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, M2T(CONSOLE_FLUSH_PERIOD_MS));
+
+    while (head != tail) {
+      waitForTxQueue();
 
-  int startMarker = endMarker - sizeof(bufferFullMsg);
-  memcpy(&messageToPrint.data[startMarker], bufferFullMsg, sizeof(bufferFullMsg));
-  messageToPrint.size = startMarker + sizeof(bufferFullMsg);
+      uint32_t count = head - tail;
+      if (count > CRTP_MAX_DATA_SIZE) {
+        count = CRTP_MAX_DATA_SIZE;
+      }
+
+      for (uint32_t i = 0; i < count; i++) {
+        messageToPrint.data[i] = buffer[(tail + i) % CONSOLE_BUFFER_SIZE];
+      }
+      messageToPrint.size = count;
+      tail += count;
+
+      crtpSendPacketBlock(&messageToPrint);
+    }
+
+    // Mark where text was lost, after the text that made it into the buffer
+    if (droppedBytes != reportedDroppedBytes) {
+      waitForTxQueue();
+
+      memcpy(messageToPrint.data, bufferFullMsg, sizeof(bufferFullMsg) - 1);
+      messageToPrint.size = sizeof(bufferFullMsg) - 1;
+      crtpSendPacketBlock(&messageToPrint);
+      reportedDroppedBytes = droppedBytes;
+    }
+  }
 }
+
+/**
+ * Console buffer statistics
+ */
+LOG_GROUP_START(console)
+/**
+ * @brief Number of bytes that were dropped because the buffer was full
+ */
+LOG_ADD(LOG_UINT32, dropped, &droppedBytes)
+/**
+ * @brief Highest number of bytes that were waiting in the buffer
+ */
+LOG_ADD(LOG_UINT32, maxFill, &maxFill)
+LOG_GROUP_STOP(console)
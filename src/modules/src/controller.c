@@ -3,9 +3,11 @@
 
 #include "cfassert.h"
 #include "controller.h"
+#ifndef CONTROLLER_STATIC_TYPE
 #include "controller_pid.h"
 #include "controller_mellinger.h"
 #include "controller_indi.h"
+#endif
 
 #define DEFAULT_CONTROLLER ControllerTypePID
 static ControllerType currentController = ControllerTypeAny;
@@ -21,9 +23,15 @@ typedef struct {
 
 static ControllerFcns controllerFunctions[] = {
   {.init = 0, .test = 0, .update = 0, .name = "None"}, // Any
-  {.init = controllerPidInit, .test = controllerPidTest, .update = controllerPid, .name = "PID"},
-  {.init = controllerMellingerInit, .test = controllerMellingerTest, .update = controllerMellinger, .name = "Mellinger"},
-  {.init = controllerINDIInit, .test = controllerINDITest, .update = controllerINDI, .name = "INDI"},
+#if defined(CONTROLLER_STATIC_PID) || !defined(CONTROLLER_STATIC_TYPE)
+  [ControllerTypePID] = {.init = controllerPidInit, .test = controllerPidTest, .update = controllerPid, .name = "PID"},
+#endif
+#if defined(CONTROLLER_STATIC_MELLINGER) || !defined(CONTROLLER_STATIC_TYPE)
+  [ControllerTypeMellinger] = {.init = controllerMellingerInit, .test = controllerMellingerTest, .update = controllerMellinger, .name = "Mellinger"},
+#endif
+#if defined(CONTROLLER_STATIC_INDI) || !defined(CONTROLLER_STATIC_TYPE)
+  [ControllerTypeINDI] = {.init = controllerINDIInit, .test = controllerINDITest, .update = controllerINDI, .name = "INDI"},
+#endif
 };
 
 
@@ -34,6 +42,10 @@ void controllerInit(ControllerType controller) {
 
   currentController = controller;
 
+#ifdef CONTROLLER_STATIC_TYPE
+  currentController = CONTROLLER_STATIC_TYPE;
+#endif
+
   if (ControllerTypeAny == currentController) {
     currentController = DEFAULT_CONTROLLER;
   }
@@ -61,9 +73,11 @@ bool controllerTest(void) {
   return controllerFunctions[currentController].test();
 }
 
+#ifndef CONTROLLER_STATIC_UPDATE
 void controller(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick) {
   controllerFunctions[currentController].update(control, setpoint, sensors, state, tick);
 }
+#endif
 
 const char* controllerGetName() {
   return controllerFunctions[currentController].name;
@@ -68,20 +68,55 @@ static inline void float_rates_zero(struct FloatRates *fr) {
 	fr->r = 0.0f;
 }
 
-void indi_init_filters(void)
+// Filter coefficients per axis, only the a and b gains are used
+static Butterworth2LowPass filterCoefficients[3];
+static volatile bool filterCutoffChanged = false;
+
+static void indi_compute_filter_coefficients(void)
 {
 	// tau = 1/(2*pi*Fc)
 	float tau = 1.0f / (2.0f * M_PI_F * indi.filt_cutoff);
 	float tau_r = 1.0f / (2.0f * M_PI_F * indi.filt_cutoff_r);
 	float tau_axis[3] = {tau, tau, tau_r};
 	float sample_time = 1.0f / ATTITUDE_RATE;
+	for (int8_t i = 0; i < 3; i++) {
+		init_butterworth_2_low_pass(&filterCoefficients[i], tau_axis[i], sample_time, 0.0f);
+	}
+}
+
+static inline void set_filter_coefficients(Butterworth2LowPass *filter, const Butterworth2LowPass *coefficients)
+{
+	filter->a[0] = coefficients->a[0];
+	filter->a[1] = coefficients->a[1];
+	filter->b[0] = coefficients->b[0];
+	filter->b[1] = coefficients->b[1];
+}
+
+void indi_init_filters(void)
+{
+	indi_compute_filter_coefficients();
 	// Filtering of gyroscope and actuators
 	for (int8_t i = 0; i < 3; i++) {
-		init_butterworth_2_low_pass(&indi.u[i], tau_axis[i], sample_time, 0.0f);
-		init_butterworth_2_low_pass(&indi.rate[i], tau_axis[i], sample_time, 0.0f);
+		indi.u[i] = filterCoefficients[i];
+		indi.rate[i] = filterCoefficients[i];
 	}
 }
 
+// Called from the param task, the new coefficients are applied by the controller
+// on its next update, keeping the filter states. Unused in unit tests, where the
+// params are compiled out.
+static void __attribute__((unused)) indiFilterCutoffChanged(void)
+{
+	filterCutoffChanged = true;
+}
+
+static void indiEffectivenessChanged(void)
+{
+	indi.g1_inv.p = 1.0f / indi.g1.p;
+	indi.g1_inv.q = 1.0f / indi.g1.q;
+	indi.g1_inv.r = 1.0f / (indi.g1.r - indi.g2);
+}
+
 /**
  * @brief Update butterworth filter for p, q and r of a FloatRates struct
  *
@@ -136,7 +171,9 @@ void controllerINDIInit(void)
 	float_rates_zero(&indi.u_in);
 
 	// Re-initialize filters
+	filterCutoffChanged = false;
 	indi_init_filters();
+	indiEffectivenessChanged();
 
 	attitudeControllerInit(ATTITUDE_UPDATE_DT);
 	positionControllerInit();
@@ -158,7 +195,7 @@ void controllerINDI(control_t *control, setpoint_t *setpoint,
 		const uint32_t tick)
 {
 
-	if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+	if (RATE_DO_EXECUTE_WITH_PHASE(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
 		// Rate-controled YAW is moving YAW angle setpoint
 		if (setpoint->mode.yaw == modeVelocity) {
 			attitudeDesired.yaw += setpoint->attitudeRate.yaw * ATTITUDE_UPDATE_DT;
@@ -171,14 +208,23 @@ void controllerINDI(control_t *control, setpoint_t *setpoint,
 		}
 	}
 
-	if (RATE_DO_EXECUTE(POSITION_RATE, tick) && !outerLoopActive) {
+	if (RATE_DO_EXECUTE_WITH_PHASE(POSITION_RATE, POSITION_PHASE, tick) && !outerLoopActive) {
 		positionController(&actuatorThrust, &attitudeDesired, setpoint, state);
 	}
 
 	/*
 	 * Skipping calls faster than ATTITUDE_RATE
 	 */
-	if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+	if (RATE_DO_EXECUTE_WITH_PHASE(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
+
+		if (filterCutoffChanged) {
+			filterCutoffChanged = false;
+			indi_compute_filter_coefficients();
+			for (int8_t i = 0; i < 3; i++) {
+				set_filter_coefficients(&indi.u[i], &filterCoefficients[i]);
+				set_filter_coefficients(&indi.rate[i], &filterCoefficients[i]);
+			}
+		}
 
 		// Call outer loop INDI (position controller)
 		if (outerLoopActive) {
@@ -299,9 +345,10 @@ void controllerINDI(control_t *control, setpoint_t *setpoint,
 		//G1 is the control effectiveness. In the yaw axis, we need something additional: G2.
 		//It takes care of the angular acceleration caused by the change in rotation rate of the propellers
 		//(they have significant inertia, see the paper mentioned in the header for more explanation)
-		indi.du.p = 1.0f / indi.g1.p * (indi.angular_accel_ref.p - indi.rate_d[0]);
-		indi.du.q = 1.0f / indi.g1.q * (indi.angular_accel_ref.q - indi.rate_d[1]);
-		indi.du.r = 1.0f / (indi.g1.r - indi.g2) * (indi.angular_accel_ref.r - indi.rate_d[2] - indi.g2 * indi.du.r);
+		//The inverses are computed when the parameters change, see indiEffectivenessChanged()
+		indi.du.p = indi.g1_inv.p * (indi.angular_accel_ref.p - indi.rate_d[0]);
+		indi.du.q = indi.g1_inv.q * (indi.angular_accel_ref.q - indi.rate_d[1]);
+		indi.du.r = indi.g1_inv.r * (indi.angular_accel_ref.r - indi.rate_d[2] - indi.g2 * indi.du.r);
 
 
 		/*
@@ -362,10 +409,10 @@ PARAM_ADD(PARAM_FLOAT, bound_ctrl_input, &bound_control_input)
 PARAM_ADD(PARAM_FLOAT, roll_kp, &roll_kp)
 PARAM_ADD(PARAM_FLOAT, pitch_kp, &pitch_kp)
 PARAM_ADD(PARAM_FLOAT, yaw_kp, &yaw_kp)
-PARAM_ADD(PARAM_FLOAT, g1_p, &indi.g1.p)
-PARAM_ADD(PARAM_FLOAT, g1_q, &indi.g1.q)
-PARAM_ADD(PARAM_FLOAT, g1_r, &indi.g1.r)
-PARAM_ADD(PARAM_FLOAT, g2, &indi.g2)
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, g1_p, &indi.g1.p, indiEffectivenessChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, g1_q, &indi.g1.q, indiEffectivenessChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, g1_r, &indi.g1.r, indiEffectivenessChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, g2, &indi.g2, indiEffectivenessChanged)
 PARAM_ADD(PARAM_FLOAT, ref_err_p, &indi.reference_acceleration.err_p)
 PARAM_ADD(PARAM_FLOAT, ref_err_q, &indi.reference_acceleration.err_q)
 PARAM_ADD(PARAM_FLOAT, ref_err_r, &indi.reference_acceleration.err_r)
@@ -375,8 +422,8 @@ PARAM_ADD(PARAM_FLOAT, ref_rate_r, &indi.reference_acceleration.rate_r)
 PARAM_ADD(PARAM_FLOAT, act_dyn_p, &indi.act_dyn.p)
 PARAM_ADD(PARAM_FLOAT, act_dyn_q, &indi.act_dyn.q)
 PARAM_ADD(PARAM_FLOAT, act_dyn_r, &indi.act_dyn.r)
-PARAM_ADD(PARAM_FLOAT, filt_cutoff, &indi.filt_cutoff)
-PARAM_ADD(PARAM_FLOAT, filt_cutoff_r, &indi.filt_cutoff_r)
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, filt_cutoff, &indi.filt_cutoff, indiFilterCutoffChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, filt_cutoff_r, &indi.filt_cutoff_r, indiFilterCutoffChanged)
 PARAM_ADD(PARAM_UINT8, outerLoopActive, &outerLoopActive)
 PARAM_GROUP_STOP(ctrlINDI)
 
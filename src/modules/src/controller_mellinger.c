@@ -40,6 +40,7 @@ We added the following:
 #include "param.h"
 #include "log.h"
 #include "math3d.h"
+#include "fastmath.h"
 #include "position_controller.h"
 #include "controller_mellinger.h"
 #include "physicalConstants.h"
@@ -138,7 +139,7 @@ void controllerMellinger(control_t *control, setpoint_t *setpoint,
   float dt;
   float desiredYaw = 0; //deg
 
-  if (!RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+  if (!RATE_DO_EXECUTE_WITH_PHASE(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
     return;
   }
 
@@ -170,8 +171,8 @@ void controllerMellinger(control_t *control, setpoint_t *setpoint,
     target_thrust.y = g_vehicleMass * setpoint->acceleration.y                       + kp_xy * r_error.y + kd_xy * v_error.y + ki_xy * i_error_y;
     target_thrust.z = g_vehicleMass * (setpoint->acceleration.z + GRAVITY_MAGNITUDE) + kp_z  * r_error.z + kd_z  * v_error.z + ki_z  * i_error_z;
   } else {
-    target_thrust.x = -sinf(radians(setpoint->attitude.pitch));
-    target_thrust.y = -sinf(radians(setpoint->attitude.roll));
+    target_thrust.x = -fastSin(radians(setpoint->attitude.pitch));
+    target_thrust.y = -fastSin(radians(setpoint->attitude.roll));
     // In case of a timeout, the commander tries to level, ie. x/y are disabled, but z will use the previous setting
     // In that case we ignore the last feedforward term for acceleration
     if (setpoint->mode.z == modeAbs) {
@@ -215,8 +216,7 @@ void controllerMellinger(control_t *control, setpoint_t *setpoint,
 
   // [xC_des]
   // x_axis_desired = z_axis_desired x [sin(yaw), cos(yaw), 0]^T
-  x_c_des.x = cosf(radians(desiredYaw));
-  x_c_des.y = sinf(radians(desiredYaw));
+  fastSinCos(radians(desiredYaw), &x_c_des.y, &x_c_des.x);
   x_c_des.z = 0;
   // [yB_des]
   y_axis_desired = vnormalize(vcross(z_axis_desired, x_c_des));
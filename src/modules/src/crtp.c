@@ -26,6 +26,7 @@
 
 #include <stdbool.h>
 #include <errno.h>
+#include <string.h>
 
 /*FreeRtos includes*/
 #include "FreeRTOS.h"
@@ -42,6 +43,7 @@
 #include "static_mem.h"
 
 #include "log.h"
+#include "param.h"
 
 
 static bool isInit;
@@ -55,44 +57,243 @@ static struct crtpLinkOperations nopLink = {
 
 static struct crtpLinkOperations *link = &nopLink;
 
+#ifdef CRTP_BENCH_LINK
+// A second link that is active at the same time as the primary link, on a
+// test bench USB next to the radio. Packets from the ports in benchPorts are
+// sent on the bench link while it is active, the other ports use the primary
+// link. Packets received on either link are handled the same way.
+static struct crtpLinkOperations *benchLink = &nopLink;
+static uint16_t benchPorts = 1 << CRTP_PORT_LOG;
+
+#ifndef CRTP_BENCH_TX_QUEUE_SIZE
+  #define CRTP_BENCH_TX_QUEUE_SIZE 32
+#endif
+#endif
+
+#define CRTP_NBR_OF_PORTS 16
+#define CRTP_RX_QUEUE_SIZE 16
+
+// Outgoing packets are queued per traffic class. The tx task serves the
+// classes in priority order, each class can send up to its weight of packets
+// before the lower classes get their turn, so no class is starved.
+typedef enum {
+  CRTP_TX_CLASS_CONTROL,   // Link, platform, setpoint and localization replies
+  CRTP_TX_CLASS_PARAM_MEM, // Parameters, memory and ports without a class
+  CRTP_TX_CLASS_LOG,
+  CRTP_TX_CLASS_CONSOLE,
+  CRTP_TX_CLASS_COUNT,
+} crtpTxClass_t;
+
+// The queue sizes of the classes with bulk traffic can be set by the build, see tools/make/profiles
+#ifndef CRTP_TX_PARAM_MEM_QUEUE_SIZE
+  #define CRTP_TX_PARAM_MEM_QUEUE_SIZE 40
+#endif
+#ifndef CRTP_TX_LOG_QUEUE_SIZE
+  #define CRTP_TX_LOG_QUEUE_SIZE 48
+#endif
+#define CRTP_TX_CONTROL_QUEUE_SIZE 16
+#define CRTP_TX_CONSOLE_QUEUE_SIZE 16
+
+static const struct {
+  uint8_t queueSize;
+  uint8_t weight;
+} txClasses[CRTP_TX_CLASS_COUNT] = {
+  [CRTP_TX_CLASS_CONTROL]   = {.queueSize = CRTP_TX_CONTROL_QUEUE_SIZE, .weight = 8},
+  [CRTP_TX_CLASS_PARAM_MEM] = {.queueSize = CRTP_TX_PARAM_MEM_QUEUE_SIZE, .weight = 4},
+  [CRTP_TX_CLASS_LOG]       = {.queueSize = CRTP_TX_LOG_QUEUE_SIZE, .weight = 2},
+  [CRTP_TX_CLASS_CONSOLE]   = {.queueSize = CRTP_TX_CONSOLE_QUEUE_SIZE, .weight = 1},
+};
+
+// Byte budgets are accounted in windows of this length
+#define TX_BUDGET_WINDOW 100
+
 #define STATS_INTERVAL 500
+
+// Histogram of the number of packets waiting in the tx queues when a packet
+// is sent, the buckets are 0, 1-3, 4-15 and 16 or more
+#define TX_DEPTH_BUCKETS 4
 static struct {
   uint32_t rxCount;
   uint32_t txCount;
+  uint32_t txClassCount[CRTP_TX_CLASS_COUNT];
+  uint32_t txPortBytes[CRTP_NBR_OF_PORTS];
+  uint32_t txResidencySum; // ms
+  uint32_t txDepthCount[TX_DEPTH_BUCKETS];
 
   uint16_t rxRate;
   uint16_t txRate;
+  uint16_t txClassRate[CRTP_TX_CLASS_COUNT];
+  uint16_t txPortByteRate[CRTP_NBR_OF_PORTS];
+  uint32_t txDropped;
+  uint16_t txResidency;    // Average time in the tx queues, ms
+  uint16_t txResidencyMax;
+  uint16_t txResidencyMaxNext;
+  uint16_t txDepthRate[TX_DEPTH_BUCKETS];
 
   uint32_t nextStatisticsTime;
   uint32_t previousStatisticsTime;
 } stats;
 
-static xQueueHandle  txQueue;
-
-#define CRTP_NBR_OF_PORTS 16
-#define CRTP_TX_QUEUE_SIZE 120
-#define CRTP_RX_QUEUE_SIZE 16
+// Packets are stored in fixed pools and the queues carry buffer indexes, a
+// packet is copied once when it enters the stack and once when it leaves. A
+// buffer has a single owner at a time: the queue it is in, or the task that
+// took it from the free queue or from a packet queue.
+// The bulk classes can not use up the buffers of the control class: the tx
+// pool holds all class queues full, plus the buffer the tx task is sending and
+// one buffer per class for a sender blocked on a full queue
+#ifdef CRTP_BENCH_LINK
+  #define CRTP_TX_BENCH_BUFFERS (CRTP_BENCH_TX_QUEUE_SIZE + 1)
+#else
+  #define CRTP_TX_BENCH_BUFFERS 0
+#endif
+#define CRTP_TX_QUEUED_MAX (CRTP_TX_CONTROL_QUEUE_SIZE + CRTP_TX_PARAM_MEM_QUEUE_SIZE + CRTP_TX_LOG_QUEUE_SIZE + \
+                            CRTP_TX_CONSOLE_QUEUE_SIZE + 1 + CRTP_TX_CLASS_COUNT + CRTP_TX_BENCH_BUFFERS)
+#ifndef CRTP_TX_POOL_SIZE
+  #define CRTP_TX_POOL_SIZE CRTP_TX_QUEUED_MAX
+#endif
+// Every port queue can fill up while its task is slow without starving the
+// other ports: the rx pool holds all port queues full, plus the buffer each
+// rx task (the link and the bench link) is receiving into
+#define CRTP_RX_MAX_TASK_QUEUES 8
+#define CRTP_RX_LINK_COUNT 2
+#ifndef CRTP_RX_POOL_SIZE
+  #define CRTP_RX_POOL_SIZE (CRTP_RX_MAX_TASK_QUEUES * CRTP_RX_QUEUE_SIZE + CRTP_RX_LINK_COUNT)
+#endif
+typedef uint8_t crtpBufferIndex_t;
+_Static_assert(CRTP_TX_POOL_SIZE < 256 && CRTP_RX_POOL_SIZE < 256, "CRTP buffer indexes are 8 bits");
+_Static_assert(CRTP_RX_POOL_SIZE >= CRTP_RX_MAX_TASK_QUEUES * CRTP_RX_QUEUE_SIZE + CRTP_RX_LINK_COUNT,
+               "A full port queue could starve the other ports");
+_Static_assert(CRTP_TX_POOL_SIZE >= CRTP_TX_QUEUED_MAX, "A full class queue could starve the control class");
+
+typedef struct {
+  CRTPPacket* packets;
+  xQueueHandle free; // Indexes of the free buffers
+} crtpPool_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static CRTPPacket txPackets[CRTP_TX_POOL_SIZE];
+NO_DMA_CCM_SAFE_ZERO_INIT static CRTPPacket rxPackets[CRTP_RX_POOL_SIZE];
+static uint32_t txQueuedTick[CRTP_TX_POOL_SIZE];
+static crtpPool_t txPool = {.packets = txPackets};
+static crtpPool_t rxPool = {.packets = rxPackets};
+
+static xQueueHandle txQueues[CRTP_TX_CLASS_COUNT];
+static xSemaphoreHandle txPending;
+static uint8_t txCredits[CRTP_TX_CLASS_COUNT];
+
+// Bytes per second a port may send while other traffic is waiting, 0 for no limit
+static uint16_t txBudget[CRTP_NBR_OF_PORTS];
+static uint16_t txWindowBytes[CRTP_NBR_OF_PORTS];
+static uint32_t txWindowStart;
 
 static void crtpTxTask(void *param);
 static void crtpRxTask(void *param);
+#ifdef CRTP_BENCH_LINK
+static void crtpBenchTxTask(void *param);
+
+static xQueueHandle benchTxQueue;
+static struct {
+  uint32_t rxCount;
+  uint32_t txCount;
+  uint16_t rxRate;
+  uint16_t txRate;
+  uint32_t txDropped;
+} benchStats;
+#endif
 
 static xQueueHandle queues[CRTP_NBR_OF_PORTS];
+static uint8_t taskQueueCount;
 static volatile CrtpCallback callbacks[CRTP_NBR_OF_PORTS];
 static void updateStats();
+static crtpTxClass_t txClassOf(uint8_t port);
+static bool txSelectPacket(CRTPPacket** p);
 
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(crtpTxTask, CRTP_TX_TASK_STACKSIZE);
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(crtpRxTask, CRTP_RX_TASK_STACKSIZE);
+#ifdef CRTP_BENCH_LINK
+STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(crtpBenchTxTask, CRTP_BENCH_TX_TASK_STACKSIZE);
+STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(crtpBenchRxTask, CRTP_BENCH_RX_TASK_STACKSIZE);
+#endif
+
+static void poolInit(crtpPool_t* pool, int size)
+{
+  pool->free = xQueueCreate(size, sizeof(crtpBufferIndex_t));
+  DEBUG_QUEUE_MONITOR_REGISTER(pool->free);
+
+  for (crtpBufferIndex_t i = 0; i < size; i++) {
+    xQueueSend(pool->free, &i, 0);
+  }
+}
+
+static CRTPPacket* poolAlloc(crtpPool_t* pool, TickType_t wait)
+{
+  crtpBufferIndex_t index;
+  if (xQueueReceive(pool->free, &index, wait) != pdTRUE) {
+    return NULL;
+  }
+
+  return &pool->packets[index];
+}
+
+static void poolFree(crtpPool_t* pool, CRTPPacket* p)
+{
+  crtpBufferIndex_t index = p - pool->packets;
+  xQueueSend(pool->free, &index, 0);
+}
+
+/* Moves a buffer to a queue, the buffer is released if the queue is full */
+static int queueBuffer(xQueueHandle queue, crtpPool_t* pool, CRTPPacket* p, TickType_t wait)
+{
+  crtpBufferIndex_t index = p - pool->packets;
+  int result = xQueueSend(queue, &index, wait);
+  if (result != pdTRUE) {
+    poolFree(pool, p);
+  }
+
+  return result;
+}
+
+/* Takes a packet from a queue, copies it and releases the buffer */
+static int receiveBuffer(xQueueHandle queue, crtpPool_t* pool, CRTPPacket* p, TickType_t wait)
+{
+  crtpBufferIndex_t index;
+  if (xQueueReceive(queue, &index, wait) != pdTRUE) {
+    return pdFALSE;
+  }
+
+  CRTPPacket* buffer = &pool->packets[index];
+  memcpy(p, buffer, sizeof(CRTPPacket));
+  poolFree(pool, buffer);
+
+  return pdTRUE;
+}
 
 void crtpInit(void)
 {
   if(isInit)
     return;
 
-  txQueue = xQueueCreate(CRTP_TX_QUEUE_SIZE, sizeof(CRTPPacket));
-  DEBUG_QUEUE_MONITOR_REGISTER(txQueue);
+  poolInit(&txPool, CRTP_TX_POOL_SIZE);
+  poolInit(&rxPool, CRTP_RX_POOL_SIZE);
+
+  for (int i = 0; i < CRTP_TX_CLASS_COUNT; i++) {
+    txQueues[i] = xQueueCreate(txClasses[i].queueSize, sizeof(crtpBufferIndex_t));
+    DEBUG_QUEUE_MONITOR_REGISTER(txQueues[i]);
+    queueMonitorAddQueue(txQueues[i], queueMonitorCrtpTx);
+    txCredits[i] = txClasses[i].weight;
+  }
+  txPending = xSemaphoreCreateBinary();
 
   STATIC_MEM_TASK_CREATE(crtpTxTask, crtpTxTask, CRTP_TX_TASK_NAME, NULL, CRTP_TX_TASK_PRI);
-  STATIC_MEM_TASK_CREATE(crtpRxTask, crtpRxTask, CRTP_RX_TASK_NAME, NULL, CRTP_RX_TASK_PRI);
+  STATIC_MEM_TASK_CREATE(crtpRxTask, crtpRxTask, CRTP_RX_TASK_NAME, &link, CRTP_RX_TASK_PRI);
+
+#ifdef CRTP_BENCH_LINK
+  benchTxQueue = xQueueCreate(CRTP_BENCH_TX_QUEUE_SIZE, sizeof(crtpBufferIndex_t));
+  DEBUG_QUEUE_MONITOR_REGISTER(benchTxQueue);
+  queueMonitorAddQueue(benchTxQueue, queueMonitorCrtpTx);
+
+  STATIC_MEM_TASK_CREATE(crtpBenchTxTask, crtpBenchTxTask, CRTP_BENCH_TX_TASK_NAME, NULL, CRTP_BENCH_TASK_PRI);
+  STATIC_MEM_TASK_CREATE(crtpBenchRxTask, crtpRxTask, CRTP_BENCH_RX_TASK_NAME, &benchLink, CRTP_BENCH_TASK_PRI);
+#endif
 
   isInit = true;
 }
@@ -105,9 +306,12 @@ bool crtpTest(void)
 void crtpInitTaskQueue(CRTPPort portId)
 {
   ASSERT(queues[portId] == NULL);
+  ASSERT(taskQueueCount < CRTP_RX_MAX_TASK_QUEUES);
+  taskQueueCount++;
 
-  queues[portId] = xQueueCreate(CRTP_RX_QUEUE_SIZE, sizeof(CRTPPacket));
+  queues[portId] = xQueueCreate(CRTP_RX_QUEUE_SIZE, sizeof(crtpBufferIndex_t));
   DEBUG_QUEUE_MONITOR_REGISTER(queues[portId]);
+  queueMonitorAddQueue(queues[portId], queueMonitorCrtpRx);
 }
 
 int crtpReceivePacket(CRTPPort portId, CRTPPacket *p)
@@ -115,7 +319,7 @@ int crtpReceivePacket(CRTPPort portId, CRTPPacket *p)
   ASSERT(queues[portId]);
   ASSERT(p);
 
-  return xQueueReceive(queues[portId], p, 0);
+  return receiveBuffer(queues[portId], &rxPool, p, 0);
 }
 
 int crtpReceivePacketBlock(CRTPPort portId, CRTPPacket *p)
@@ -123,7 +327,7 @@ int crtpReceivePacketBlock(CRTPPort portId, CRTPPacket *p)
   ASSERT(queues[portId]);
   ASSERT(p);
 
-  return xQueueReceive(queues[portId], p, portMAX_DELAY);
+  return receiveBuffer(queues[portId], &rxPool, p, portMAX_DELAY);
 }
 
 
@@ -132,33 +336,165 @@ int crtpReceivePacketWait(CRTPPort portId, CRTPPacket *p, int wait)
   ASSERT(queues[portId]);
   ASSERT(p);
 
-  return xQueueReceive(queues[portId], p, M2T(wait));
+  return receiveBuffer(queues[portId], &rxPool, p, M2T(wait));
 }
 
 int crtpGetFreeTxQueuePackets(void)
 {
-  return (CRTP_TX_QUEUE_SIZE - uxQueueMessagesWaiting(txQueue));
+  return uxQueueMessagesWaiting(txPool.free);
+}
+
+#ifdef CRTP_BENCH_LINK
+static bool isRoutedToBench(uint8_t port)
+{
+  return benchLink != &nopLink && (benchPorts & (1 << port));
+}
+#endif
+
+/* The tx queue of the class of the port, or the queue of the bench link */
+static xQueueHandle txQueueOf(uint8_t port)
+{
+#ifdef CRTP_BENCH_LINK
+  if (isRoutedToBench(port)) {
+    return benchTxQueue;
+  }
+#endif
+
+  return txQueues[txClassOf(port)];
+}
+
+int crtpGetFreeTxQueuePacketsForPort(CRTPPort portId)
+{
+  int free = uxQueueSpacesAvailable(txQueueOf(portId));
+  int buffers = uxQueueMessagesWaiting(txPool.free);
+
+  return free < buffers ? free : buffers;
+}
+
+uint16_t crtpGetTxQueueTime(void)
+{
+  return stats.txResidency;
+}
+
+void crtpSetTxBudget(CRTPPort portId, uint16_t bytesPerSecond)
+{
+  ASSERT(portId < CRTP_NBR_OF_PORTS);
+
+  txBudget[portId] = bytesPerSecond;
+}
+
+static crtpTxClass_t txClassOf(uint8_t port)
+{
+  switch (port) {
+    case CRTP_PORT_LINK:
+    case CRTP_PORT_PLATFORM:
+    case CRTP_PORT_SETPOINT:
+    case CRTP_PORT_SETPOINT_GENERIC:
+    case CRTP_PORT_SETPOINT_HL:
+    case CRTP_PORT_LOCALIZATION:
+      return CRTP_TX_CLASS_CONTROL;
+    case CRTP_PORT_LOG:
+      return CRTP_TX_CLASS_LOG;
+    case CRTP_PORT_CONSOLE:
+      return CRTP_TX_CLASS_CONSOLE;
+    default:
+      return CRTP_TX_CLASS_PARAM_MEM;
+  }
+}
+
+static void updateTxQueueStats(const crtpBufferIndex_t index, const uint32_t now)
+{
+  const uint32_t residency = T2M(now - txQueuedTick[index]);
+  stats.txResidencySum += residency;
+  if (residency > stats.txResidencyMaxNext) {
+    stats.txResidencyMaxNext = residency > UINT16_MAX ? UINT16_MAX : residency;
+  }
+
+  uint32_t depth = 0;
+  for (int i = 0; i < CRTP_TX_CLASS_COUNT; i++) {
+    depth += uxQueueMessagesWaiting(txQueues[i]);
+  }
+
+  int bucket = 0;
+  for (uint32_t limit = 1; bucket < TX_DEPTH_BUCKETS - 1 && depth >= limit; limit *= 4) {
+    bucket++;
+  }
+  stats.txDepthCount[bucket]++;
+}
+
+static bool isWithinBudget(const CRTPPacket* p)
+{
+  const uint16_t budget = txBudget[p->port];
+  return budget == 0 || txWindowBytes[p->port] < budget * TX_BUDGET_WINDOW / 1000;
+}
+
+/* Picks the next packet to send. The first pass respects the credits and the
+ * byte budgets, the second pass refills the credits and the last pass ignores
+ * the budgets, so the link is never idle while packets are waiting. */
+static bool txSelectPacket(CRTPPacket** p)
+{
+  const uint32_t now = xTaskGetTickCount();
+  if (now - txWindowStart >= M2T(TX_BUDGET_WINDOW)) {
+    memset(txWindowBytes, 0, sizeof(txWindowBytes));
+    txWindowStart = now;
+  }
+
+  for (int pass = 0; pass < 3; pass++) {
+    if (pass == 1) {
+      for (int i = 0; i < CRTP_TX_CLASS_COUNT; i++) {
+        txCredits[i] = txClasses[i].weight;
+      }
+    }
+
+    for (int i = 0; i < CRTP_TX_CLASS_COUNT; i++) {
+      if (pass < 2 && txCredits[i] == 0) {
+        continue;
+      }
+
+      crtpBufferIndex_t index;
+      if (xQueuePeek(txQueues[i], &index, 0) == pdTRUE && (pass == 2 || isWithinBudget(&txPackets[index]))) {
+        xQueueReceive(txQueues[i], &index, 0);
+        *p = &txPackets[index];
+        updateTxQueueStats(index, now);
+        if (txCredits[i] > 0) {
+          txCredits[i]--;
+        }
+        txWindowBytes[(*p)->port] += (*p)->size + 1;
+        stats.txClassCount[i]++;
+        stats.txPortBytes[(*p)->port] += (*p)->size + 1;
+        return true;
+      }
+    }
+  }
+
+  return false;
 }
 
 void crtpTxTask(void *param)
 {
-  CRTPPacket p;
+  CRTPPacket* p;
 
   while (true)
   {
     if (link != &nopLink)
     {
-      if (xQueueReceive(txQueue, &p, portMAX_DELAY) == pdTRUE)
+      if (txSelectPacket(&p))
       {
         // Keep testing, if the link changes to USB it will go though
-        while (link->sendPacket(&p) == false)
+        while (link->sendPacket(p) == false)
         {
           // Relaxation time
           vTaskDelay(M2T(10));
         }
+        poolFree(&txPool, p);
         stats.txCount++;
         updateStats();
       }
+      else
+      {
+        // The timeout picks up a packet queued while the queues were reset
+        xSemaphoreTake(txPending, M2T(100));
+      }
     }
     else
     {
@@ -167,28 +503,75 @@ void crtpTxTask(void *param)
   }
 }
 
+#ifdef CRTP_BENCH_LINK
+/* Sends the packets routed to the bench link. Packets that are left in the
+ * queue when the bench link goes away are dropped by crtpSetBenchLink(). */
+static void crtpBenchTxTask(void *param)
+{
+  crtpBufferIndex_t index;
+
+  while (true)
+  {
+    if (xQueueReceive(benchTxQueue, &index, M2T(100)) != pdTRUE)
+    {
+      continue;
+    }
+
+    CRTPPacket* p = &txPackets[index];
+    while (benchLink != &nopLink && benchLink->sendPacket(p) == false)
+    {
+      vTaskDelay(M2T(10));
+    }
+    poolFree(&txPool, p);
+    benchStats.txCount++;
+    updateStats();
+  }
+}
+#endif
+
+/* Receives from the link in the link pointer passed as parameter, the
+ * primary link or the bench link */
 void crtpRxTask(void *param)
 {
-  CRTPPacket p;
+  struct crtpLinkOperations ** rxLink = param;
+  CRTPPacket* p = NULL;
 
   while (true)
   {
-    if (link != &nopLink)
+    if (*rxLink != &nopLink)
     {
-      if (!link->receivePacket(&p))
+      // Block, since we should never drop a packet
+      if (p == NULL)
       {
-        if (queues[p.port])
+        p = poolAlloc(&rxPool, portMAX_DELAY);
+      }
+
+      if (!(*rxLink)->receivePacket(p))
+      {
+        const uint8_t port = p->port;
+
+        // Called before the packet is queued, the queue owns it after that
+        if (callbacks[port])
         {
-          // Block, since we should never drop a packet
-          xQueueSend(queues[p.port], &p, portMAX_DELAY);
+          callbacks[port](p);
         }
 
-        if (callbacks[p.port])
+        if (queues[port])
         {
-          callbacks[p.port](&p);
+          queueBuffer(queues[port], &rxPool, p, portMAX_DELAY);
+          p = NULL;
         }
 
-        stats.rxCount++;
+#ifdef CRTP_BENCH_LINK
+        if (rxLink == &benchLink)
+        {
+          benchStats.rxCount++;
+        }
+        else
+#endif
+        {
+          stats.rxCount++;
+        }
         updateStats();
       }
     }
@@ -212,7 +595,25 @@ int crtpSendPacket(CRTPPacket *p)
   ASSERT(p);
   ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
 
-  return xQueueSend(txQueue, p, 0);
+  int result = pdFALSE;
+  CRTPPacket* buffer = poolAlloc(&txPool, 0);
+  if (buffer) {
+    memcpy(buffer, p, sizeof(CRTPPacket));
+    txQueuedTick[buffer - txPackets] = xTaskGetTickCount();
+    result = queueBuffer(txQueueOf(p->port), &txPool, buffer, 0);
+  }
+
+  if (result == pdTRUE) {
+    xSemaphoreGive(txPending);
+#ifdef CRTP_BENCH_LINK
+  } else if (isRoutedToBench(p->port)) {
+    benchStats.txDropped++;
+#endif
+  } else {
+    stats.txDropped++;
+  }
+
+  return result;
 }
 
 int crtpSendPacketBlock(CRTPPacket *p)
@@ -220,12 +621,24 @@ int crtpSendPacketBlock(CRTPPacket *p)
   ASSERT(p);
   ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
 
-  return xQueueSend(txQueue, p, portMAX_DELAY);
+  CRTPPacket* buffer = poolAlloc(&txPool, portMAX_DELAY);
+  memcpy(buffer, p, sizeof(CRTPPacket));
+  txQueuedTick[buffer - txPackets] = xTaskGetTickCount();
+  int result = queueBuffer(txQueueOf(p->port), &txPool, buffer, portMAX_DELAY);
+  xSemaphoreGive(txPending);
+
+  return result;
 }
 
 int crtpReset(void)
 {
-  xQueueReset(txQueue);
+  // Drop the queued packets and give the buffers back to the pool
+  for (int i = 0; i < CRTP_TX_CLASS_COUNT; i++) {
+    crtpBufferIndex_t index;
+    while (xQueueReceive(txQueues[i], &index, 0) == pdTRUE) {
+      poolFree(&txPool, &txPackets[index]);
+    }
+  }
   if (link->reset) {
     link->reset();
   }
@@ -253,6 +666,23 @@ void crtpSetLink(struct crtpLinkOperations * lk)
   link->setEnable(true);
 }
 
+#ifdef CRTP_BENCH_LINK
+void crtpSetBenchLink(struct crtpLinkOperations * lk)
+{
+  benchLink->setEnable(false);
+  benchLink = lk ? lk : &nopLink;
+  benchLink->setEnable(true);
+
+  if (benchLink == &nopLink) {
+    // The routed ports are back on the primary link
+    crtpBufferIndex_t index;
+    while (xQueueReceive(benchTxQueue, &index, 0) == pdTRUE) {
+      poolFree(&txPool, &txPackets[index]);
+    }
+  }
+}
+#endif
+
 static int nopFunc(void)
 {
   return ENETDOWN;
@@ -262,6 +692,11 @@ static void clearStats()
 {
   stats.rxCount = 0;
   stats.txCount = 0;
+  memset(stats.txClassCount, 0, sizeof(stats.txClassCount));
+  memset(stats.txPortBytes, 0, sizeof(stats.txPortBytes));
+  memset(stats.txDepthCount, 0, sizeof(stats.txDepthCount));
+  stats.txResidencySum = 0;
+  stats.txResidencyMaxNext = 0;
 }
 
 static void updateStats()
@@ -271,6 +706,23 @@ static void updateStats()
     float interval = now - stats.previousStatisticsTime;
     stats.rxRate = (uint16_t)(1000.0f * stats.rxCount / interval);
     stats.txRate = (uint16_t)(1000.0f * stats.txCount / interval);
+    for (int i = 0; i < CRTP_TX_CLASS_COUNT; i++) {
+      stats.txClassRate[i] = (uint16_t)(1000.0f * stats.txClassCount[i] / interval);
+    }
+    for (int i = 0; i < CRTP_NBR_OF_PORTS; i++) {
+      stats.txPortByteRate[i] = (uint16_t)(1000.0f * stats.txPortBytes[i] / interval);
+    }
+    for (int i = 0; i < TX_DEPTH_BUCKETS; i++) {
+      stats.txDepthRate[i] = (uint16_t)(1000.0f * stats.txDepthCount[i] / interval);
+    }
+    stats.txResidency = stats.txCount > 0 ? stats.txResidencySum / stats.txCount : 0;
+    stats.txResidencyMax = stats.txResidencyMaxNext;
+#ifdef CRTP_BENCH_LINK
+    benchStats.rxRate = (uint16_t)(1000.0f * benchStats.rxCount / interval);
+    benchStats.txRate = (uint16_t)(1000.0f * benchStats.txCount / interval);
+    benchStats.rxCount = 0;
+    benchStats.txCount = 0;
+#endif
 
     clearStats();
     stats.previousStatisticsTime = now;
@@ -281,4 +733,98 @@ static void updateStats()
 LOG_GROUP_START(crtp)
 LOG_ADD(LOG_UINT16, rxRate, &stats.rxRate)
 LOG_ADD(LOG_UINT16, txRate, &stats.txRate)
+/**
+ * @brief Packets per second sent from the control class: link, platform, setpoint and localization
+ */
+LOG_ADD(LOG_UINT16, txCtlRate, &stats.txClassRate[CRTP_TX_CLASS_CONTROL])
+/**
+ * @brief Packets per second sent from the parameter and memory class
+ */
+LOG_ADD(LOG_UINT16, txPmRate, &stats.txClassRate[CRTP_TX_CLASS_PARAM_MEM])
+/**
+ * @brief Packets per second sent from the log class
+ */
+LOG_ADD(LOG_UINT16, txLogRate, &stats.txClassRate[CRTP_TX_CLASS_LOG])
+/**
+ * @brief Packets per second sent from the console class
+ */
+LOG_ADD(LOG_UINT16, txConRate, &stats.txClassRate[CRTP_TX_CLASS_CONSOLE])
+/**
+ * @brief Bytes per second sent on the log port
+ */
+LOG_ADD(LOG_UINT16, txLogBytes, &stats.txPortByteRate[CRTP_PORT_LOG])
+/**
+ * @brief Bytes per second sent on the memory port
+ */
+LOG_ADD(LOG_UINT16, txMemBytes, &stats.txPortByteRate[CRTP_PORT_MEM])
+/**
+ * @brief Number of packets dropped since boot because a tx queue was full
+ */
+LOG_ADD(LOG_UINT32, txDropped, &stats.txDropped)
+/**
+ * @brief Average time the sent packets waited in the tx queues [ms]
+ */
+LOG_ADD(LOG_UINT16, txQTime, &stats.txResidency)
+/**
+ * @brief Longest time a sent packet waited in the tx queues during the last 0.5 s [ms]
+ */
+LOG_ADD(LOG_UINT16, txQTimeMax, &stats.txResidencyMax)
+/**
+ * @brief Packets per second sent when no other packets were waiting
+ */
+LOG_ADD(LOG_UINT16, txDepth0, &stats.txDepthRate[0])
+/**
+ * @brief Packets per second sent when 1 to 3 packets were waiting
+ */
+LOG_ADD(LOG_UINT16, txDepth1, &stats.txDepthRate[1])
+/**
+ * @brief Packets per second sent when 4 to 15 packets were waiting
+ */
+LOG_ADD(LOG_UINT16, txDepth4, &stats.txDepthRate[2])
+/**
+ * @brief Packets per second sent when 16 or more packets were waiting
+ */
+LOG_ADD(LOG_UINT16, txDepth16, &stats.txDepthRate[3])
 LOG_GROUP_STOP(tdoa)
+
+/**
+ * Byte budgets of the ports that send the most. A port that has used its
+ * budget only sends when no other packets are waiting.
+ */
+PARAM_GROUP_START(crtp)
+/**
+ * @brief Bytes per second the log port may send when other ports are waiting, 0 for no limit (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, logBudget, &txBudget[CRTP_PORT_LOG])
+/**
+ * @brief Bytes per second the memory port may send when other ports are waiting, 0 for no limit (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, memBudget, &txBudget[CRTP_PORT_MEM])
+#ifdef CRTP_BENCH_LINK
+/**
+ * @brief Bit mask of the ports that are sent on the bench link (USB) while it is connected (default: log port)
+ */
+PARAM_ADD(PARAM_UINT16, benchPorts, &benchPorts)
+#endif
+PARAM_GROUP_STOP(crtp)
+
+#ifdef CRTP_BENCH_LINK
+/**
+ * Statistics of the bench link, the link that carries the ports in
+ * crtp.benchPorts at the same time as the primary link
+ */
+LOG_GROUP_START(crtpBench)
+/**
+ * @brief Packets per second received on the bench link
+ */
+LOG_ADD(LOG_UINT16, rxRate, &benchStats.rxRate)
+/**
+ * @brief Packets per second sent on the bench link
+ */
+LOG_ADD(LOG_UINT16, txRate, &benchStats.txRate)
+/**
+ * @brief Number of packets for the bench link dropped since boot because its tx queue was full
+ */
+LOG_ADD(LOG_UINT32, txDropped, &benchStats.txDropped)
+LOG_GROUP_STOP(crtpBench)
+#endif
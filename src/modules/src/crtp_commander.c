@@ -117,8 +117,16 @@ static void commanderCrtpCB(CRTPPacket* pk)
   } else if (pk->port == CRTP_PORT_SETPOINT_GENERIC) {
     switch (pk->channel) {
     case SET_SETPOINT_CHANNEL:
-      crtpCommanderGenericDecodeSetpoint(&setpoint, pk);
-      commanderSetSetpoint(&setpoint, COMMANDER_PRIORITY_CRTP);
+      switch (crtpCommanderGenericDecodeSetpoint(&setpoint, pk)) {
+      case genericSetpointPlain:
+        commanderSetSetpoint(&setpoint, COMMANDER_PRIORITY_CRTP);
+        break;
+      case genericSetpointTimed:
+        commanderSetTimedSetpoint(&setpoint, COMMANDER_PRIORITY_CRTP);
+        break;
+      default:
+        break;
+      }
       break;
     case META_COMMAND_CHANNEL: {
         uint8_t metaCmd = pk->data[0];
@@ -34,6 +34,7 @@
 #include "crtp.h"
 #include "num.h"
 #include "quatcompress.h"
+#include "configblock.h"
 #include "FreeRTOS.h"
 
 /* The generic commander format contains a packet type and data that has to be
@@ -71,6 +72,8 @@ enum packet_type {
   hoverType         = 5,
   fullStateType     = 6,
   positionType      = 7,
+  timedPositionType = 8,
+  packedPositionType = 9,
 };
 
 /* ---===== 2 - Decoding functions =====--- */
@@ -367,6 +370,96 @@ static void positionDecoder(setpoint_t *setpoint, uint8_t type, const void *data
   setpoint->attitude.yaw = values->yaw;
 }
 
+/* timedPositionDecoder
+ * Set the absolute position, velocity and yaw that apply at a time of the
+ * sender's clock. The setpoints are buffered and played out on the local
+ * clock, see setpoint_buffer.h.
+ */
+struct timedPositionPacket_s {
+  uint16_t time;   // Sender time in ms
+  int16_t x;       // Position in mm
+  int16_t y;
+  int16_t z;
+  int16_t vx;      // Velocity in mm/s
+  int16_t vy;
+  int16_t vz;
+  int16_t yaw;     // Orientation in 1/100 degree
+} __attribute__((packed));
+static void timedPositionDecoder(setpoint_t *setpoint, uint8_t type, const void *data, size_t datalen)
+{
+  const struct timedPositionPacket_s *values = data;
+
+  ASSERT(datalen == sizeof(struct timedPositionPacket_s));
+
+  setpoint->timestamp = values->time;
+
+  setpoint->mode.x = modeAbs;
+  setpoint->mode.y = modeAbs;
+  setpoint->mode.z = modeAbs;
+
+  setpoint->position.x = values->x / 1000.0f;
+  setpoint->position.y = values->y / 1000.0f;
+  setpoint->position.z = values->z / 1000.0f;
+  setpoint->velocity.x = values->vx / 1000.0f;
+  setpoint->velocity.y = values->vy / 1000.0f;
+  setpoint->velocity.z = values->vz / 1000.0f;
+
+  setpoint->mode.yaw = modeAbs;
+
+  setpoint->attitude.yaw = values->yaw / 100.0f;
+}
+
+/* packedPositionDecoder
+ * Broadcast the absolute position and velocity of up to three Crazyflies in
+ * one packet. The items are for consecutive ids, starting with the last byte of
+ * the radio address in firstId. A Crazyflie that is not in the packet ignores
+ * it.
+ */
+#define NBR_OF_PACKED_POSITION_ITEMS 3
+#define PACKED_POSITION_VEL_SCALE 25.0f // 1 LSB = 4 cm/s
+
+struct packedPositionItem_s {
+  int16_t x;   // Position in mm
+  int16_t y;
+  int16_t z;
+  int8_t vx;   // Velocity in 4 cm/s
+  int8_t vy;
+  int8_t vz;
+} __attribute__((packed));
+struct packedPositionPacket_s {
+  uint8_t firstId;
+  struct packedPositionItem_s items[NBR_OF_PACKED_POSITION_ITEMS];
+} __attribute__((packed));
+static bool packedPositionDecoder(setpoint_t *setpoint, const void *data, size_t datalen)
+{
+  static int myId = -1;
+  const struct packedPositionPacket_s *values = data;
+
+  if (myId < 0) {
+    myId = configblockGetRadioAddress() & 0xFF;
+  }
+
+  // The packet may be cut after the last used item
+  const uint8_t index = (uint8_t)(myId - values->firstId);
+  if (datalen < 1 || index >= (datalen - 1) / sizeof(struct packedPositionItem_s)) {
+    return false;
+  }
+  const struct packedPositionItem_s *item = &values->items[index];
+
+  setpoint->mode.x = modeAbs;
+  setpoint->mode.y = modeAbs;
+  setpoint->mode.z = modeAbs;
+
+  setpoint->position.x = item->x / 1000.0f;
+  setpoint->position.y = item->y / 1000.0f;
+  setpoint->position.z = item->z / 1000.0f;
+  setpoint->velocity.x = item->vx / PACKED_POSITION_VEL_SCALE;
+  setpoint->velocity.y = item->vy / PACKED_POSITION_VEL_SCALE;
+  setpoint->velocity.z = item->vz / PACKED_POSITION_VEL_SCALE;
+
+  return true;
+}
+
  /* ---===== 3 - packetDecoders array =====--- */
 const static packetDecoder_t packetDecoders[] = {
   [stopType]          = stopDecoder,
@@ -377,10 +470,11 @@ const static packetDecoder_t packetDecoders[] = {
   [hoverType]         = hoverDecoder,
   [fullStateType]     = fullStateDecoder,
   [positionType]      = positionDecoder,
+  [timedPositionType] = timedPositionDecoder,
 };
 
 /* Decoder switch */
-void crtpCommanderGenericDecodeSetpoint(setpoint_t *setpoint, CRTPPacket *pk)
+genericSetpointKind_t crtpCommanderGenericDecodeSetpoint(setpoint_t *setpoint, CRTPPacket *pk)
 {
   static int nTypes = -1;
 
@@ -394,9 +488,23 @@ void crtpCommanderGenericDecodeSetpoint(setpoint_t *setpoint, CRTPPacket *pk)
 
   memset(setpoint, 0, sizeof(setpoint_t));
 
+  // Broadcast packets that do not carry a setpoint for this Crazyflie must
+  // not replace the current setpoint
+  if (type == packedPositionType) {
+    if (packedPositionDecoder(setpoint, ((char*)pk->data)+1, pk->size-1)) {
+      return genericSetpointPlain;
+    }
+    return genericSetpointNone;
+  }
+
   if (type<nTypes && (packetDecoders[type] != NULL)) {
     packetDecoders[type](setpoint, type, ((char*)pk->data)+1, pk->size-1);
   }
+
+  if (type == timedPositionType) {
+    return genericSetpointTimed;
+  }
+  return genericSetpointPlain;
 }
 
 // Params for generic CRTP handlers
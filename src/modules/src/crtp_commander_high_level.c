@@ -55,11 +55,14 @@ such as: take-off, landing, polynomial trajectories.
 #include "param.h"
 #include "static_mem.h"
 #include "mem.h"
+#include "lz4Stream.h"
+#include "timesync.h"
 
 // Local types
 enum TrajectoryLocation_e {
   TRAJECTORY_LOCATION_INVALID = 0,
   TRAJECTORY_LOCATION_MEM     = 1, // for trajectories that are uploaded dynamically
+  TRAJECTORY_LOCATION_STREAM  = 2, // for trajectories that are appended in flight, see MEM_TYPE_TRAJ_STREAM
   // Future features might include trajectories on flash or uSD card
 };
 
@@ -72,30 +75,33 @@ struct trajectoryDescription
     struct {
       uint32_t offset;  // offset in uploaded memory
       uint8_t n_pieces;
-    } __attribute__((packed)) mem; // if trajectoryLocation is TRAJECTORY_LOCATION_MEM
+    } __attribute__((packed)) mem; // if trajectoryLocation is TRAJECTORY_LOCATION_MEM or
+                                   // TRAJECTORY_LOCATION_STREAM (n_pieces is then the pieces per page)
   } trajectoryIdentifier;
 } __attribute__((packed));
 
 // allocate memory to store trajectories
 // 4k allows us to store 31 poly4d pieces
 // other (compressed) formats might be added in the future
+#ifndef TRAJECTORY_MEMORY_SIZE
 #define TRAJECTORY_MEMORY_SIZE 4096
+#endif
 extern uint8_t trajectories_memory[TRAJECTORY_MEMORY_SIZE];
 
 #define ALL_GROUPS 0
 
 // Global variables
-uint8_t trajectories_memory[TRAJECTORY_MEMORY_SIZE];
+NO_DMA_CCM_SAFE_ZERO_INIT uint8_t trajectories_memory[TRAJECTORY_MEMORY_SIZE];
 static struct trajectoryDescription trajectory_descriptions[NUM_TRAJECTORY_DEFINITIONS];
 
 static bool isInit = false;
-static struct planner planner;
+NO_DMA_CCM_SAFE_ZERO_INIT static struct planner planner;
 static uint8_t group_mask;
 static struct vec pos; // last known setpoint (position [m])
 static struct vec vel; // last known setpoint (velocity [m/s])
 static float yaw; // last known setpoint yaw (yaw [rad])
-static struct piecewise_traj trajectory;
-static struct piecewise_traj_compressed  compressed_trajectory;
+NO_DMA_CCM_SAFE_ZERO_INIT static struct piecewise_traj trajectory;
+NO_DMA_CCM_SAFE_ZERO_INIT static struct piecewise_traj_compressed compressed_trajectory;
 
 // makes sure that we don't evaluate the trajectory while it is being changed
 static xSemaphoreHandle lockTraj;
@@ -116,8 +122,61 @@ static const MemoryHandlerDef_t memDef = {
   .write = handleMemWrite,
 };
 
+// Compressed trajectory upload, an LZ4 block decoded into the trajectory memory
+// as it is written. The first 4 bytes of the stream are the destination offset.
+#define TRAJ_LZ4_HEADER_SIZE 4
+static uint32_t handleMemLz4GetSize(void) { return crtpCommanderHighLevelTrajectoryMemSize(); }
+static bool handleMemLz4Read(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+static bool handleMemLz4Write(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+static const MemoryHandlerDef_t memLz4Def = {
+  .type = MEM_TYPE_TRAJ_LZ4,
+  .getSize = handleMemLz4GetSize,
+  .read = handleMemLz4Read,
+  .write = handleMemLz4Write,
+};
+
+static struct {
+  uint32_t received; // Bytes of the compressed stream consumed, including the header
+  uint32_t offset;
+  lz4Stream_t decoder;
+} lz4Upload;
+
+// Streaming trajectory, the pieces live in a ring of pages in the trajectory
+// memory. The client appends pages while the earlier pages are flown, a page
+// is free for the next one as soon as the trajectory has moved past it. Pages
+// are addressed by sequence number, the address of a page in the stream is
+// seq * stride and the page header follows the pieces.
+#define TRAJ_STREAM_PAGES 4
+#define TRAJ_STREAM_HEADER_SIZE 4
+#define TRAJ_STREAM_FLAG_LAST 0x01
+static uint32_t handleMemStreamGetSize(void) { return UINT32_MAX; }
+static bool handleMemStreamRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+static bool handleMemStreamWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+static const MemoryHandlerDef_t memStreamDef = {
+  .type = MEM_TYPE_TRAJ_STREAM,
+  .getSize = handleMemStreamGetSize,
+  .read = handleMemStreamRead,
+  .write = handleMemStreamWrite,
+};
+
+static struct {
+  uint32_t offset;        // start of the ring in the trajectory memory
+  uint8_t piecesPerPage;  // 0 if no stream is defined
+  uint32_t readSeq;       // the page that is flown, the pages before it are free
+  uint32_t readySeq;      // the first page that is not complete
+  uint8_t header[TRAJ_STREAM_PAGES][TRAJ_STREAM_HEADER_SIZE]; // n_pieces, flags, reserved
+  bool complete[TRAJ_STREAM_PAGES];
+  bool active;            // the trajectory is flying the stream
+  bool starved;           // the end of the flown page is reached before the next page is complete
+  uint16_t underruns;
+} stream;
+
 STATIC_MEM_TASK_ALLOC(crtpCommanderHighLevelTask, CMD_HIGH_LEVEL_TASK_STACKSIZE);
 
+// Period of the look ahead decoding of compressed trajectories, pieces that are
+// shorter than this are decoded when they are reached
+#define PREFETCH_PERIOD_MS 10
+
 // CRTP Packet definitions
 
 // trajectory command (first byte of crtp packet)
@@ -133,6 +192,7 @@ enum TrajectoryCommand_e {
   COMMAND_LAND_2                  = 8,
   COMMAND_TAKEOFF_WITH_VELOCITY   = 9,
   COMMAND_LAND_WITH_VELOCITY      = 10,
+  COMMAND_START_TRAJECTORY_AT     = 11,
 };
 
 struct data_set_group_mask {
@@ -220,12 +280,25 @@ struct data_start_trajectory {
   float timescale; // time factor; 1 = original speed; >1: slower; <1: faster
 } __attribute__((packed));
 
+// starts executing a specified trajectory at a given swarm time
+struct data_start_trajectory_at {
+  struct data_start_trajectory start;
+  uint64_t startTime; // us, swarm time (see timesync.h)
+} __attribute__((packed));
+
 // starts executing a specified trajectory
 struct data_define_trajectory {
   uint8_t trajectoryId;
   struct trajectoryDescription description;
 } __attribute__((packed));
 
+// trajectory started at a swarm time, started by crtpCommanderHighLevelGetSetpoint() when the time has come
+static struct {
+  bool isPending;
+  float t; // s, usecTimestamp() time
+  struct data_start_trajectory data;
+} scheduledStart;
+
 // Private functions
 static void crtpCommanderHighLevelTask(void * prm);
 
@@ -239,6 +312,8 @@ static int land_with_velocity(const struct data_land_with_velocity* data);
 static int stop(const struct data_stop* data);
 static int go_to(const struct data_go_to* data);
 static int start_trajectory(const struct data_start_trajectory* data);
+static int start_trajectory_at(const struct data_start_trajectory_at* data);
+static int start_trajectory_locked(const struct data_start_trajectory* data, const float t);
 static int define_trajectory(const struct data_define_trajectory* data);
 
 // Helper functions
@@ -251,6 +326,80 @@ bool isInGroup(uint8_t g) {
   return g == ALL_GROUPS || (g & group_mask) != 0;
 }
 
+static uint32_t streamPageSize(void)
+{
+  return stream.piecesPerPage * sizeof(struct poly4d);
+}
+
+static bool streamIsLastPage(const uint32_t seq)
+{
+  return (stream.header[seq % TRAJ_STREAM_PAGES][1] & TRAJ_STREAM_FLAG_LAST) != 0;
+}
+
+// point the trajectory to the page that is flown
+static void streamLoadPage(const float t_begin)
+{
+  const uint32_t slot = stream.readSeq % TRAJ_STREAM_PAGES;
+  trajectory.t_begin = t_begin;
+  trajectory.n_pieces = stream.header[slot][0];
+  trajectory.pieces = (struct poly4d*)&trajectories_memory[stream.offset + slot * streamPageSize()];
+}
+
+// move the flown trajectory to the next page of the stream when the end of
+// the current page is reached. If the next page is late the trajectory holds
+// the end of the current page, the next page then starts when it arrives.
+// Must be called with lockTraj taken.
+static void streamAdvance(const float t)
+{
+  if (!stream.active) {
+    return;
+  }
+
+  if (planner.state != TRAJECTORY_STATE_FLYING
+      || planner.type != TRAJECTORY_TYPE_PIECEWISE
+      || planner.trajectory != &trajectory) {
+    // an other command has replaced the stream
+    stream.active = false;
+    return;
+  }
+
+  while (piecewise_is_finished(&trajectory, t) && !streamIsLastPage(stream.readSeq)) {
+    if (stream.readySeq <= stream.readSeq + 1) {
+      if (!stream.starved) {
+        stream.starved = true;
+        stream.underruns++;
+      }
+      return;
+    }
+
+    float t_next = trajectory.t_begin + piecewise_duration(&trajectory);
+    if (stream.starved) {
+      t_next = t;
+      stream.starved = false;
+    }
+
+    stream.complete[stream.readSeq % TRAJ_STREAM_PAGES] = false;
+    stream.readSeq++;
+    streamLoadPage(t_next);
+  }
+}
+
+// shift the trajectory to start at the last setpoint, if relative
+static void setTrajectoryShift(const bool relative, const bool reversed)
+{
+  trajectory.shift = vzero();
+  if (relative) {
+    struct traj_eval traj_init;
+    if (reversed) {
+      traj_init = piecewise_eval_reversed(&trajectory, trajectory.t_begin);
+    }
+    else {
+      traj_init = piecewise_eval(&trajectory, trajectory.t_begin);
+    }
+    trajectory.shift = vsub(pos, traj_init.pos);
+  }
+}
+
 void crtpCommanderHighLevelInit(void)
 {
   if (isInit) {
@@ -258,6 +407,8 @@ void crtpCommanderHighLevelInit(void)
   }
 
   memoryRegisterHandler(&memDef);
+  memoryRegisterHandler(&memLz4Def);
+  memoryRegisterHandler(&memStreamDef);
   plan_init(&planner);
 
   //Start the trajectory task
@@ -290,6 +441,12 @@ void crtpCommanderHighLevelGetSetpoint(setpoint_t* setpoint, const state_t *stat
 {
   xSemaphoreTake(lockTraj, portMAX_DELAY);
   float t = usecTimestamp() / 1e6;
+  if (scheduledStart.isPending && t >= scheduledStart.t) {
+    // Started at the scheduled time, not the time of this loop
+    scheduledStart.isPending = false;
+    start_trajectory_locked(&scheduledStart.data, scheduledStart.t);
+  }
+  streamAdvance(t);
   struct traj_eval ev = plan_current_goal(&planner, t);
   if (!is_traj_eval_valid(&ev)) {
     // programming error
@@ -369,6 +526,9 @@ static int handleCommand(const enum TrajectoryCommand_e command, const uint8_t*
     case COMMAND_START_TRAJECTORY:
       ret = start_trajectory((const struct data_start_trajectory*)data);
       break;
+    case COMMAND_START_TRAJECTORY_AT:
+      ret = start_trajectory_at((const struct data_start_trajectory_at*)data);
+      break;
     case COMMAND_DEFINE_TRAJECTORY:
       ret = define_trajectory((const struct data_define_trajectory*)data);
       break;
@@ -386,14 +546,22 @@ void crtpCommanderHighLevelTask(void * prm)
   crtpInitTaskQueue(CRTP_PORT_SETPOINT_HL);
 
   while(1) {
-    crtpReceivePacketBlock(CRTP_PORT_SETPOINT_HL, &p);
+    if (crtpReceivePacketWait(CRTP_PORT_SETPOINT_HL, &p, PREFETCH_PERIOD_MS)) {
+      int ret = handleCommand(p.data[0], &p.data[1]);
 
-    int ret = handleCommand(p.data[0], &p.data[1]);
+      //answer
+      p.data[3] = ret;
+      p.size = 4;
+      crtpSendPacketBlock(&p);
+    }
 
-    //answer
-    p.data[3] = ret;
-    p.size = 4;
-    crtpSendPacketBlock(&p);
+    // decode the next piece of a compressed trajectory here rather than on the
+    // stabilizer tick that reaches it
+    if (planner.type == TRAJECTORY_TYPE_PIECEWISE_COMPRESSED && !plan_is_stopped(&planner)) {
+      xSemaphoreTake(lockTraj, portMAX_DELAY);
+      piecewise_compressed_prefetch(&compressed_trajectory);
+      xSemaphoreGive(lockTraj);
+    }
   }
 }
 
@@ -465,6 +633,7 @@ int land(const struct data_land* data)
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
     float t = usecTimestamp() / 1e6;
+    scheduledStart.isPending = false;
     result = plan_land(&planner, pos, yaw, data->height, 0.0f, data->duration, t);
     xSemaphoreGive(lockTraj);
   }
@@ -483,6 +652,7 @@ int land2(const struct data_land_2* data)
       hover_yaw = yaw;
     }
 
+    scheduledStart.isPending = false;
     result = plan_land(&planner, pos, yaw, data->height, hover_yaw, data->duration, t);
     xSemaphoreGive(lockTraj);
   }
@@ -508,6 +678,7 @@ int land_with_velocity(const struct data_land_with_velocity* data)
 
     float velocity = data->velocity > 0 ? data->velocity : defaultLandingVelocity;
     float duration = fabsf(height - pos.z) / velocity;
+    scheduledStart.isPending = false;
     result = plan_land(&planner, pos, yaw, height, hover_yaw, duration, t);
     xSemaphoreGive(lockTraj);
   }
@@ -519,6 +690,7 @@ int stop(const struct data_stop* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
+    scheduledStart.isPending = false;
     plan_stop(&planner);
     xSemaphoreGive(lockTraj);
   }
@@ -556,59 +728,87 @@ int start_trajectory(const struct data_start_trajectory* data)
 {
   int result = 0;
   if (isInGroup(data->groupMask)) {
-    if (data->trajectoryId < NUM_TRAJECTORY_DEFINITIONS) {
-      struct trajectoryDescription* trajDesc = &trajectory_descriptions[data->trajectoryId];
-      if (   trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
-          && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
-        xSemaphoreTake(lockTraj, portMAX_DELAY);
-        float t = usecTimestamp() / 1e6;
-        trajectory.t_begin = t;
+    xSemaphoreTake(lockTraj, portMAX_DELAY);
+    float t = usecTimestamp() / 1e6;
+    result = start_trajectory_locked(data, t);
+    xSemaphoreGive(lockTraj);
+  }
+  return result;
+}
+
+int start_trajectory_at(const struct data_start_trajectory_at* data)
+{
+  int result = 0;
+  if (isInGroup(data->start.groupMask)) {
+    if (!timesyncIsLocked()) {
+      return EAGAIN;
+    }
+    if (data->start.trajectoryId >= NUM_TRAJECTORY_DEFINITIONS) {
+      return ENOEXEC;
+    }
+
+    // A start time in the past starts the trajectory at once, still aligned with the swarm time
+    xSemaphoreTake(lockTraj, portMAX_DELAY);
+    scheduledStart.data = data->start;
+    scheduledStart.t = timesyncToLocal(data->startTime) / 1e6;
+    scheduledStart.isPending = true;
+    xSemaphoreGive(lockTraj);
+  }
+  return result;
+}
+
+// lockTraj must be taken, t is the start time of the trajectory
+int start_trajectory_locked(const struct data_start_trajectory* data, const float t)
+{
+  int result = 0;
+  if (data->trajectoryId < NUM_TRAJECTORY_DEFINITIONS) {
+    struct trajectoryDescription* trajDesc = &trajectory_descriptions[data->trajectoryId];
+    if (   trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
+        && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+      trajectory.t_begin = t;
+      trajectory.timescale = data->timescale;
+      trajectory.n_pieces = trajDesc->trajectoryIdentifier.mem.n_pieces;
+      trajectory.pieces = (struct poly4d*)&trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset];
+      setTrajectoryShift(data->relative, data->reversed);
+      result = plan_start_trajectory(&planner, &trajectory, data->reversed);
+      stream.active = false;
+    } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_STREAM) {
+      if (data->reversed) {
+        result = ENOEXEC;
+      } else if (stream.readySeq == stream.readSeq) {
+        // the first page has not been uploaded yet
+        result = EAGAIN;
+      } else {
         trajectory.timescale = data->timescale;
-        trajectory.n_pieces = trajDesc->trajectoryIdentifier.mem.n_pieces;
-        trajectory.pieces = (struct poly4d*)&trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset];
+        streamLoadPage(t);
+        setTrajectoryShift(data->relative, false);
+        result = plan_start_trajectory(&planner, &trajectory, false);
+        stream.active = true;
+        stream.starved = false;
+      }
+    } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
+        && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
+
+      if (data->timescale != 1 || data->reversed) {
+        result = ENOEXEC;
+      } else {
+        piecewise_compressed_load(
+          &compressed_trajectory,
+          &trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset]
+        );
+        compressed_trajectory.t_begin = t;
         if (data->relative) {
-          trajectory.shift = vzero();
-          struct traj_eval traj_init;
-          if (data->reversed) {
-            traj_init = piecewise_eval_reversed(&trajectory, trajectory.t_begin);
-          }
-          else {
-            traj_init = piecewise_eval(&trajectory, trajectory.t_begin);
-          }
+          struct traj_eval traj_init = piecewise_compressed_eval(
+            &compressed_trajectory, compressed_trajectory.t_begin
+          );
           struct vec shift_pos = vsub(pos, traj_init.pos);
-          trajectory.shift = shift_pos;
+          compressed_trajectory.shift = shift_pos;
         } else {
-          trajectory.shift = vzero();
+          compressed_trajectory.shift = vzero();
         }
-        result = plan_start_trajectory(&planner, &trajectory, data->reversed);
-        xSemaphoreGive(lockTraj);
-      } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
-          && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
-
-        if (data->timescale != 1 || data->reversed) {
-          result = ENOEXEC;
-        } else {
-          xSemaphoreTake(lockTraj, portMAX_DELAY);
-          float t = usecTimestamp() / 1e6;
-          piecewise_compressed_load(
-            &compressed_trajectory,
-            &trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset]
-          );
-          compressed_trajectory.t_begin = t;
-          if (data->relative) {
-            struct traj_eval traj_init = piecewise_compressed_eval(
-              &compressed_trajectory, compressed_trajectory.t_begin
-            );
-            struct vec shift_pos = vsub(pos, traj_init.pos);
-            compressed_trajectory.shift = shift_pos;
-          } else {
-            compressed_trajectory.shift = vzero();
-          }
-          result = plan_start_compressed_trajectory(&planner, &compressed_trajectory);
-          xSemaphoreGive(lockTraj);
-        }
-
+        result = plan_start_compressed_trajectory(&planner, &compressed_trajectory);
       }
+
     }
   }
   return result;
@@ -619,6 +819,23 @@ int define_trajectory(const struct data_define_trajectory* data)
   if (data->trajectoryId >= NUM_TRAJECTORY_DEFINITIONS) {
     return ENOEXEC;
   }
+
+  if (data->description.trajectoryLocation == TRAJECTORY_LOCATION_STREAM) {
+    const uint32_t offset = data->description.trajectoryIdentifier.mem.offset;
+    const uint8_t piecesPerPage = data->description.trajectoryIdentifier.mem.n_pieces;
+    if (data->description.trajectoryType != CRTP_CHL_TRAJECTORY_TYPE_POLY4D || piecesPerPage == 0
+        || offset + TRAJ_STREAM_PAGES * piecesPerPage * sizeof(struct poly4d) > sizeof(trajectories_memory)) {
+      return ENOEXEC;
+    }
+
+    // start a new stream, there is one stream at a time
+    xSemaphoreTake(lockTraj, portMAX_DELAY);
+    memset(&stream, 0, sizeof(stream));
+    stream.offset = offset;
+    stream.piecesPerPage = piecesPerPage;
+    xSemaphoreGive(lockTraj);
+  }
+
   trajectory_descriptions[data->trajectoryId] = data->description;
   return 0;
 }
@@ -631,6 +848,158 @@ static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const
   return crtpCommanderHighLevelWriteTrajectory(memAddr, writeLen, buffer);
 }
 
+static bool handleMemLz4Read(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
+  // Upload status: received (uint32), decoded (uint32), error (uint8), complete (uint8)
+  uint8_t status[10];
+  memcpy(&status[0], &lz4Upload.received, 4);
+  memcpy(&status[4], &lz4Upload.decoder.length, 4);
+  status[8] = lz4Upload.decoder.error;
+  status[9] = lz4StreamIsComplete(&lz4Upload.decoder);
+
+  if (memAddr + readLen > sizeof(status)) {
+    return false;
+  }
+
+  memcpy(buffer, &status[memAddr], readLen);
+  return true;
+}
+
+static bool handleMemLz4Write(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer) {
+  const uint32_t size = sizeof(trajectories_memory);
+
+  if (memAddr == 0) {
+    lz4Upload.received = 0;
+    lz4StreamInit(&lz4Upload.decoder, trajectories_memory, 0);
+  }
+
+  // The stream must be written in order. Data that has already been consumed,
+  // a retransmission, is skipped and a gap is refused so the client resends it.
+  if (memAddr > lz4Upload.received || lz4Upload.decoder.error != 0) {
+    return false;
+  }
+
+  uint32_t skip = lz4Upload.received - memAddr;
+  if (skip >= writeLen) {
+    return true;
+  }
+
+  const uint8_t* data = &buffer[skip];
+  uint32_t length = writeLen - skip;
+
+  while (length > 0 && lz4Upload.received < TRAJ_LZ4_HEADER_SIZE) {
+    ((uint8_t*)&lz4Upload.offset)[lz4Upload.received] = *data;
+    lz4Upload.received++;
+    data++;
+    length--;
+
+    if (lz4Upload.received == TRAJ_LZ4_HEADER_SIZE) {
+      if (lz4Upload.offset >= size) {
+        lz4Upload.decoder.error = EINVAL;
+        return false;
+      }
+      lz4StreamInit(&lz4Upload.decoder, &trajectories_memory[lz4Upload.offset], size - lz4Upload.offset);
+    }
+  }
+
+  lz4Upload.received += length;
+  return lz4StreamDecode(&lz4Upload.decoder, data, length) == 0;
+}
+
+// write a part of one page of the stream, must be called with lockTraj taken
+static bool streamWritePage(const uint32_t seq, const uint32_t pageAddr, const uint8_t* data, const uint32_t length)
+{
+  if (seq < stream.readSeq) {
+    // already flown, a retransmission
+    return true;
+  }
+
+  if (seq >= stream.readSeq + TRAJ_STREAM_PAGES) {
+    // the slot is not free yet, the client must wait for the flown page to move on
+    return false;
+  }
+
+  const uint32_t slot = seq % TRAJ_STREAM_PAGES;
+  if (stream.complete[slot]) {
+    return true;
+  }
+
+  const uint32_t pageSize = streamPageSize();
+  for (uint32_t i = 0; i < length; i++) {
+    const uint32_t addr = pageAddr + i;
+    if (addr < pageSize) {
+      trajectories_memory[stream.offset + slot * pageSize + addr] = data[i];
+    } else {
+      stream.header[slot][addr - pageSize] = data[i];
+    }
+  }
+
+  // the page is complete when the last byte of the header is written
+  if (pageAddr + length == pageSize + TRAJ_STREAM_HEADER_SIZE) {
+    const uint8_t nPieces = stream.header[slot][0];
+    if (nPieces == 0 || nPieces > stream.piecesPerPage) {
+      return false;
+    }
+
+    stream.complete[slot] = true;
+    while (stream.readySeq < stream.readSeq + TRAJ_STREAM_PAGES && stream.complete[stream.readySeq % TRAJ_STREAM_PAGES]) {
+      stream.readySeq++;
+    }
+  }
+
+  return true;
+}
+
+static bool handleMemStreamRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
+  // Stream status: read seq (uint32), ready seq (uint32), write limit (uint32), underruns (uint16),
+  // pages (uint8), pieces per page (uint8), active (uint8)
+  uint8_t status[17];
+
+  xSemaphoreTake(lockTraj, portMAX_DELAY);
+  const uint32_t writeLimit = stream.readSeq + TRAJ_STREAM_PAGES;
+  memcpy(&status[0], &stream.readSeq, 4);
+  memcpy(&status[4], &stream.readySeq, 4);
+  memcpy(&status[8], &writeLimit, 4);
+  memcpy(&status[12], &stream.underruns, 2);
+  status[14] = TRAJ_STREAM_PAGES;
+  status[15] = stream.piecesPerPage;
+  status[16] = stream.active;
+  xSemaphoreGive(lockTraj);
+
+  if (memAddr + readLen > sizeof(status)) {
+    return false;
+  }
+
+  memcpy(buffer, &status[memAddr], readLen);
+  return true;
+}
+
+static bool handleMemStreamWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer) {
+  bool result = true;
+
+  xSemaphoreTake(lockTraj, portMAX_DELAY);
+  if (stream.piecesPerPage == 0) {
+    result = false;
+  }
+
+  const uint32_t stride = streamPageSize() + TRAJ_STREAM_HEADER_SIZE;
+  uint32_t addr = memAddr;
+  uint32_t done = 0;
+  while (result && done < writeLen) {
+    const uint32_t pageAddr = addr % stride;
+    uint32_t length = stride - pageAddr;
+    if (length > writeLen - done) {
+      length = writeLen - done;
+    }
+
+    result = streamWritePage(addr / stride, pageAddr, &buffer[done], length);
+    addr += length;
+    done += length;
+  }
+  xSemaphoreGive(lockTraj);
+
+  return result;
+}
+
 uint8_t* initCrtpPacket(CRTPPacket* packet, const enum TrajectoryCommand_e command)
 {
   packet->port = CRTP_PORT_SETPOINT_HL;
@@ -768,6 +1137,21 @@ int crtpCommanderHighLevelStartTrajectory(const uint8_t trajectoryId, const floa
   return handleCommand(COMMAND_START_TRAJECTORY, (const uint8_t*)&data);
 }
 
+int crtpCommanderHighLevelStartTrajectoryAt(const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed, const uint64_t startTime)
+{
+  struct data_start_trajectory_at data =
+  {
+    .start.trajectoryId = trajectoryId,
+    .start.timescale = timeScale,
+    .start.relative = relative,
+    .start.reversed = reversed,
+    .start.groupMask = ALL_GROUPS,
+    .startTime = startTime,
+  };
+
+  return handleCommand(COMMAND_START_TRAJECTORY_AT, (const uint8_t*)&data);
+}
+
 int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crtpCommanderTrajectoryType_t type, const uint32_t offset, const uint8_t nPieces)
 {
   struct data_define_trajectory data =
@@ -782,6 +1166,20 @@ int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crt
   return handleCommand(COMMAND_DEFINE_TRAJECTORY, (const uint8_t*)&data);
 }
 
+int crtpCommanderHighLevelDefineStreamTrajectory(const uint8_t trajectoryId, const uint32_t offset, const uint8_t piecesPerPage)
+{
+  struct data_define_trajectory data =
+  {
+    .trajectoryId = trajectoryId,
+    .description.trajectoryLocation = TRAJECTORY_LOCATION_STREAM,
+    .description.trajectoryType = CRTP_CHL_TRAJECTORY_TYPE_POLY4D,
+    .description.trajectoryIdentifier.mem.offset = offset,
+    .description.trajectoryIdentifier.mem.n_pieces = piecesPerPage,
+  };
+
+  return handleCommand(COMMAND_DEFINE_TRAJECTORY, (const uint8_t*)&data);
+}
+
 uint32_t crtpCommanderHighLevelTrajectoryMemSize()
 {
   return sizeof(trajectories_memory);
@@ -812,6 +1210,9 @@ bool crtpCommanderHighLevelReadTrajectory(const uint32_t offset, const uint32_t
 
 bool crtpCommanderHighLevelIsTrajectoryFinished() {
   float t = usecTimestamp() / 1e6;
+  if (stream.active && !streamIsLastPage(stream.readSeq)) {
+    return false;
+  }
   return plan_is_finished(&planner, t);
 }
 
@@ -39,14 +39,20 @@
 #include "configblock.h"
 #include "worker.h"
 #include "lighthouse_storage.h"
+#include "lighthouse_storage_writer.h"
 
 #include "locodeck.h"
 
 #include "estimator.h"
 #include "quatcompress.h"
+#include "timesync.h"
 
 #include "peer_localization.h"
 
+#ifdef SENSOR_INCLUDED_SIM
+#include "sensors_sim.h"
+#endif
+
 #include "num.h"
 
 #define NBR_OF_RANGES_IN_PACKET   5
@@ -84,6 +90,27 @@ typedef struct {
   } __attribute__((packed)) sweeps [NBR_OF_SWEEPS_IN_PACKET];
 } __attribute__((packed)) anglePacket;
 
+// Compact angle stream, one item per sensor and base station with both sweep angles in fixed point
+#define LH_ANGLE_COMPACT_SCALE 10000.0f // 1 LSB = 0.1 mrad
+#define NBR_OF_ANGLE_ITEMS_IN_COMPACT_PACKET 5
+
+typedef struct {
+  uint8_t id; // base station in bits 2..7, sensor in bits 0..1
+  int16_t sweeps[NBR_OF_SWEEPS_IN_PACKET];
+} __attribute__((packed)) angleCompactItem;
+
+typedef struct {
+  uint8_t type;
+  uint8_t seq; // incremented for each sent packet, used to detect lost packets
+  angleCompactItem items[NBR_OF_ANGLE_ITEMS_IN_COMPACT_PACKET];
+} __attribute__((packed)) angleCompactPacket;
+
+typedef enum {
+  lhAngleStreamOff = 0,
+  lhAngleStreamLegacy = 1,
+  lhAngleStreamCompact = 2,
+} lhAngleStreamMode_t;
+
 // up to 4 items per CRTP packet
 typedef struct {
   uint8_t id; // last 8 bit of the Crazyflie address
@@ -111,12 +138,17 @@ static uint8_t rangeIndex;
 static bool enableRangeStreamFloat = false;
 
 static CRTPPacket LhAngle;
-static bool enableLighthouseAngleStream = false;
+static uint8_t enableLighthouseAngleStream = lhAngleStreamOff;
+static CRTPPacket LhAngleCompact;
+static uint8_t lhAngleCompactIndex;
+static uint8_t lhAngleCompactSeq;
 static float extPosStdDev = 0.01;
 static float extQuatStdDev = 4.5e-3;
 static bool isInit = false;
 static uint8_t my_id;
 static uint16_t tickOfLastPacket; // tick when last packet was received
+static uint16_t extPosLatency = 0; // ms from capture in the positioning system until reception
+static uint16_t extPoseAge; // ms from capture until reception of the latest timestamped pose
 
 static void locSrvCrtpCB(CRTPPacket* pk);
 static void extPositionHandler(CRTPPacket* pk);
@@ -132,6 +164,8 @@ void locSrvInit()
   uint64_t address = configblockGetRadioAddress();
   my_id = address & 0xFF;
 
+  lighthouseStorageWriterInit();
+
   crtpRegisterPortCB(CRTP_PORT_LOCALIZATION, locSrvCrtpCB);
   isInit = true;
 }
@@ -154,6 +188,16 @@ static void locSrvCrtpCB(CRTPPacket* pk)
   }
 }
 
+// The capture tick of an external position/pose received now, 0 if the latency is unknown
+static uint32_t extPosCaptureTick()
+{
+  if (extPosLatency == 0) {
+    return 0;
+  }
+
+  return xTaskGetTickCount() - M2T(extPosLatency);
+}
+
 static void updateLogFromExtPos()
 {
   ext_pose.x = ext_pos.x;
@@ -171,7 +215,7 @@ static void extPositionHandler(CRTPPacket* pk) {
   ext_pos.source = MeasurementSourceLocationService;
   updateLogFromExtPos();
 
-  estimatorEnqueuePosition(&ext_pos);
+  estimatorEnqueuePositionCapturedAt(&ext_pos, extPosCaptureTick());
   tickOfLastPacket = xTaskGetTickCount();
 }
 
@@ -188,7 +232,7 @@ static void extPoseHandler(const CRTPPacket* pk) {
   ext_pose.stdDevPos = extPosStdDev;
   ext_pose.stdDevQuat = extQuatStdDev;
 
-  estimatorEnqueuePose(&ext_pose);
+  estimatorEnqueuePoseCapturedAt(&ext_pose, extPosCaptureTick());
   tickOfLastPacket = xTaskGetTickCount();
 }
 
@@ -203,7 +247,7 @@ static void extPosePackedHandler(const CRTPPacket* pk) {
       quatdecompress(item->quat, (float *)&ext_pose.quat.q0);
       ext_pose.stdDevPos = extPosStdDev;
       ext_pose.stdDevQuat = extQuatStdDev;
-      estimatorEnqueuePose(&ext_pose);
+      estimatorEnqueuePoseCapturedAt(&ext_pose, extPosCaptureTick());
       tickOfLastPacket = xTaskGetTickCount();
     } else {
       ext_pos.x = item->x / 1000.0f;
@@ -215,6 +259,42 @@ static void extPosePackedHandler(const CRTPPacket* pk) {
   }
 }
 
+// The capture tick of a sample with a capture time in swarm time. The latency
+// set in extPosLatency is used until the swarm time is locked.
+static uint32_t extPoseTimestampedCaptureTick(const uint32_t timestamp)
+{
+  if (!timesyncIsLocked()) {
+    return extPosCaptureTick();
+  }
+
+  // Only the lower 32 bits are sent, the sample is in the last 71 minutes
+  const uint64_t now = timesyncNow();
+  const uint32_t ageUs = (uint32_t)now - timestamp;
+  if (ageUs > UINT32_MAX / 2) {
+    // From the future, the clocks are slightly off
+    extPoseAge = 0;
+    return xTaskGetTickCount();
+  }
+
+  extPoseAge = (ageUs / 1000 > UINT16_MAX) ? UINT16_MAX : ageUs / 1000;
+  return xTaskGetTickCount() - M2T(ageUs / 1000);
+}
+
+static void extPoseTimestampedHandler(const CRTPPacket* pk) {
+  const uint8_t numItems = (pk->size - 1) / sizeof(struct CrtpExtPoseTimestamped);
+  for (uint8_t i = 0; i < numItems; ++i) {
+    const struct CrtpExtPoseTimestamped* item = (const struct CrtpExtPoseTimestamped*)&pk->data[1 + i * sizeof(struct CrtpExtPoseTimestamped)];
+    ext_pose.x = item->x / 1000.0f;
+    ext_pose.y = item->y / 1000.0f;
+    ext_pose.z = item->z / 1000.0f;
+    quatdecompress(item->quat, (float *)&ext_pose.quat.q0);
+    ext_pose.stdDevPos = extPosStdDev;
+    ext_pose.stdDevQuat = extQuatStdDev;
+    estimatorEnqueuePoseCapturedAt(&ext_pose, extPoseTimestampedCaptureTick(item->timestamp));
+    tickOfLastPacket = xTaskGetTickCount();
+  }
+}
+
 static void lpsShortLppPacketHandler(CRTPPacket* pk) {
   if (pk->size >= 2) {
     bool success = lpsSendLppShort(pk->data[1], &pk->data[2], pk->size-2);
@@ -239,21 +319,7 @@ typedef union {
   uint32_t combinedField;
 } __attribute__((packed)) LhPersistArgs_t;
 
-static void lhPersistDataWorker(void* arg) {
-  LhPersistArgs_t* args = (LhPersistArgs_t*) &arg;
-
-  bool result = true;
-
-  for (int baseStation = 0; baseStation < PULSE_PROCESSOR_N_BASE_STATIONS; baseStation++) {
-    uint16_t mask = 1 << baseStation;
-    bool storeGeo = (args->geoDataBsField & mask) != 0;
-    bool storeCalibration = (args->calibrationDataBsField & mask) != 0;
-    if (! lighthouseStoragePersistData(baseStation, storeGeo, storeCalibration)) {
-      result = false;
-      break;
-    }
-  }
-
+static void lhPersistDataDone(const bool result) {
   CRTPPacket response = {
     .port = CRTP_PORT_LOCALIZATION,
     .channel = GENERIC_TYPE,
@@ -267,7 +333,9 @@ static void lhPersistDataWorker(void* arg) {
 static void lhPersistDataHandler(CRTPPacket* pk) {
   if (pk->size >= (1 + sizeof(LhPersistArgs_t))) {
     LhPersistArgs_t* args = (LhPersistArgs_t*) &pk->data[1];
-    workerSchedule(lhPersistDataWorker, (void*)args->combinedField);
+    if (! lighthouseStorageWriterRequest(args->geoDataBsField, args->calibrationDataBsField, lhPersistDataDone)) {
+      lhPersistDataDone(false);
+    }
   }
 }
 
@@ -292,9 +360,20 @@ static void genericLocHandle(CRTPPacket* pk)
     case EXT_POSE_PACKED:
       extPosePackedHandler(pk);
       break;
+    case EXT_POSE_TIMESTAMPED:
+      extPoseTimestampedHandler(pk);
+      break;
     case LH_PERSIST_DATA:
       lhPersistDataHandler(pk);
       break;
+    case TIME_SYNC_BEACON:
+      // Handled by timesync in the radio link, where the reception time is known
+      break;
+#ifdef SENSOR_INCLUDED_SIM
+    case SENSOR_INJECT:
+      sensorsSimInjectPacket(&pk->data[1], pk->size - 1);
+      break;
+#endif
     default:
       // Nothing here
       break;
@@ -313,7 +392,7 @@ static void extPositionPackedHandler(CRTPPacket* pk)
     ext_pos.source = MeasurementSourceLocationService;
     if (item->id == my_id) {
       updateLogFromExtPos();
-      estimatorEnqueuePosition(&ext_pos);
+      estimatorEnqueuePositionCapturedAt(&ext_pos, extPosCaptureTick());
       tickOfLastPacket = xTaskGetTickCount();
     }
     else {
@@ -347,30 +426,77 @@ void locSrvSendRangeFloat(uint8_t id, float range)
   }
 }
 
-void locSrvSendLighthouseAngle(int basestation, pulseProcessorResult_t* angles)
+static void sendLighthouseAngleLegacy(int basestation, pulseProcessorResult_t* angles)
 {
   anglePacket *ap = (anglePacket *)LhAngle.data;
+  ap->basestation = basestation;
 
-  if (enableLighthouseAngleStream) {
-    ap->basestation = basestation;
+  for(uint8_t its = 0; its < NBR_OF_SWEEPS_IN_PACKET; its++) {
+    float angle_first_sensor =  angles->sensorMeasurementsLh1[0].baseStatonMeasurements[basestation].correctedAngles[its];
+    ap->sweeps[its].sweep = angle_first_sensor;
 
-    for(uint8_t its = 0; its < NBR_OF_SWEEPS_IN_PACKET; its++) {
-      float angle_first_sensor =  angles->sensorMeasurementsLh1[0].baseStatonMeasurements[basestation].correctedAngles[its];
-      ap->sweeps[its].sweep = angle_first_sensor;
+    for(uint8_t itd = 0; itd < NBR_OF_SENSOR_DIFFS_IN_PACKET; itd++) {
+      float angle_other_sensor = angles->sensorMeasurementsLh1[itd + 1].baseStatonMeasurements[basestation].correctedAngles[its];
+      uint16_t angle_diff = single2half(angle_first_sensor - angle_other_sensor);
+      ap->sweeps[its].angleDiffs[itd].angleDiff = angle_diff;
+    }
+  }
+
+  ap->type = LH_ANGLE_STREAM;
+  LhAngle.port = CRTP_PORT_LOCALIZATION;
+  LhAngle.channel = GENERIC_TYPE;
+  LhAngle.size = sizeof(anglePacket);
+  // This is best effort, i.e. the blocking version is not needed
+  crtpSendPacket(&LhAngle);
+}
+
+static int16_t quantizeAngle(const float angle)
+{
+  return (int16_t)constrain(angle * LH_ANGLE_COMPACT_SCALE, INT16_MIN, INT16_MAX);
+}
+
+// Items are collected until the packet is full, only sensors that have seen both sweeps are sent
+static void sendLighthouseAngleCompact(int basestation, pulseProcessorResult_t* angles)
+{
+  angleCompactPacket *ap = (angleCompactPacket *)LhAngleCompact.data;
 
-      for(uint8_t itd = 0; itd < NBR_OF_SENSOR_DIFFS_IN_PACKET; itd++) {
-        float angle_other_sensor = angles->sensorMeasurementsLh1[itd + 1].baseStatonMeasurements[basestation].correctedAngles[its];
-        uint16_t angle_diff = single2half(angle_first_sensor - angle_other_sensor);
-        ap->sweeps[its].angleDiffs[itd].angleDiff = angle_diff;
-      }
+  for (uint8_t sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+    const pulseProcessorBaseStationMeasuremnt_t* measurement = &angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[basestation];
+    if (measurement->validCount != PULSE_PROCESSOR_N_SWEEPS) {
+      continue;
     }
 
-    ap->type = LH_ANGLE_STREAM;
-    LhAngle.port = CRTP_PORT_LOCALIZATION;
-    LhAngle.channel = GENERIC_TYPE;
-    LhAngle.size = sizeof(anglePacket);
-    // This is best effort, i.e. the blocking version is not needed
-    crtpSendPacket(&LhAngle);
+    angleCompactItem* item = &ap->items[lhAngleCompactIndex];
+    item->id = (basestation << 2) | sensor;
+    for (uint8_t its = 0; its < NBR_OF_SWEEPS_IN_PACKET; its++) {
+      item->sweeps[its] = quantizeAngle(measurement->correctedAngles[its]);
+    }
+
+    lhAngleCompactIndex++;
+    if (lhAngleCompactIndex == NBR_OF_ANGLE_ITEMS_IN_COMPACT_PACKET) {
+      ap->type = LH_ANGLE_STREAM_COMPACT;
+      ap->seq = lhAngleCompactSeq++;
+      LhAngleCompact.port = CRTP_PORT_LOCALIZATION;
+      LhAngleCompact.channel = GENERIC_TYPE;
+      LhAngleCompact.size = sizeof(angleCompactPacket);
+      // This is best effort, i.e. the blocking version is not needed
+      crtpSendPacket(&LhAngleCompact);
+      lhAngleCompactIndex = 0;
+    }
+  }
+}
+
+void locSrvSendLighthouseAngle(int basestation, pulseProcessorResult_t* angles)
+{
+  switch (enableLighthouseAngleStream) {
+    case lhAngleStreamLegacy:
+      sendLighthouseAngleLegacy(basestation, angles);
+      break;
+    case lhAngleStreamCompact:
+      sendLighthouseAngleCompact(basestation, angles);
+      break;
+    default:
+      break;
   }
 }
 
@@ -393,11 +519,13 @@ LOG_GROUP_STOP(locSrv)
 
 LOG_GROUP_START(locSrvZ)
   LOG_ADD(LOG_UINT16, tick, &tickOfLastPacket)  // time when data was received last (ms/ticks)
+  LOG_ADD(LOG_UINT16, poseAge, &extPoseAge)  // ms from capture until reception of the latest timestamped pose
 LOG_GROUP_STOP(locSrvZ)
 
 PARAM_GROUP_START(locSrv)
   PARAM_ADD(PARAM_UINT8, enRangeStreamFP32, &enableRangeStreamFloat)
-  PARAM_ADD(PARAM_UINT8, enLhAngleStream, &enableLighthouseAngleStream)
+  PARAM_ADD(PARAM_UINT8, enLhAngleStream, &enableLighthouseAngleStream) // 0: off, 1: float/half angles, 2: compact fixed point
   PARAM_ADD(PARAM_FLOAT, extPosStdDev, &extPosStdDev)
   PARAM_ADD(PARAM_FLOAT, extQuatStdDev, &extQuatStdDev)
+  PARAM_ADD(PARAM_UINT16, extPosLatency, &extPosLatency)
 PARAM_GROUP_STOP(locSrv)
@@ -1,6 +1,10 @@
+#include <math.h>
+
 #include "FreeRTOS.h"
 #include "queue.h"
+#include "task.h"
 #include "static_mem.h"
+#include "queuemonitor.h"
 
 #define DEBUG_MODULE "ESTIMATOR"
 #include "debug.h"
@@ -10,22 +14,157 @@
 #include "estimator_complementary.h"
 #include "estimator_kalman.h"
 #include "log.h"
+#include "param.h"
 #include "statsCnt.h"
 #include "eventtrigger.h"
 #include "quatcompress.h"
+#include "system.h"
+#include "usec_time.h"
+#include "config.h"
+#include "pulse_processor.h"
 
 #define DEFAULT_ESTIMATOR complementaryEstimator
 static StateEstimatorType currentEstimator = anyEstimator;
 
+/**
+ * Shadow estimator. A second estimator, set with the estimator.shadow
+ * parameter, is run on the same inputs as the current estimator in a low
+ * priority task. Its state is never used for control, only the difference to
+ * the state of the current estimator and the time spent in its update are
+ * logged in the estShadow group. The estimators are singletons, the shadow
+ * must therefore be of another type than the current estimator.
+ *
+ * Measurements dequeued by the current estimator are copied to the shadow
+ * queue, which is read by the shadow estimator. IMU samples are read from the
+ * accumulator by both estimators independently.
+ */
+typedef struct {
+  state_t state;
+  uint32_t tick;
+} shadowInput_t;
+
+static uint8_t shadowEstimatorRequested = anyEstimator;
+static volatile StateEstimatorType shadowEstimator = anyEstimator;
+static state_t shadowState;
+
+// Difference between the shadow and the current estimator states
+static float shadowPosError;
+static float shadowVelError;
+static float shadowRollError;
+static float shadowPitchError;
+static float shadowYawError;
+// Time spent in the latest shadow update, in us
+static uint32_t shadowUpdateUs;
+
+STATIC_MEM_QUEUE_ALLOC(shadowInputQueue, 1, sizeof(shadowInput_t));
+static xQueueHandle shadowInputQueue;
+
+static void shadowTask(void* parameters);
+STATIC_MEM_TASK_ALLOC(shadowTask, ESTIMATOR_SHADOW_TASK_STACKSIZE);
+
+
+/**
+ * Measurements are queued in one bounded queue per measurement type, to avoid
+ * that high rate measurements crowd out rare ones. When a queue is full the
+ * new measurement is dropped, unless the type is set to keep the newest
+ * measurements (see the estimator.keepNewest parameter) in which case the
+ * oldest queued measurement is dropped instead. With a queue length of 1 this
+ * coalesces the measurements to the latest one.
+ *
+ * The queues are emptied in the order of measurementPriority.
+ *
+ * Gyroscope and acceleration samples do not use the queues, they are summed
+ * up in the IMU accumulator below and read with estimatorGetImuSamples().
+ */
+typedef struct {
+  measurement_t measurement;
+  uint32_t enqueueTick;
+} queuedMeasurement_t;
+
+// The queues of the measurements that come in bursts can be sized by the build, see tools/make/profiles
+#ifndef ESTIMATOR_TDOA_QUEUE_LENGTH
+  #define ESTIMATOR_TDOA_QUEUE_LENGTH 6
+#endif
+#ifndef ESTIMATOR_SWEEP_ANGLE_QUEUE_LENGTH
+  // A lighthouse frame is enqueued as one burst of up to 2 sweeps per sensor for each base station
+  #define ESTIMATOR_SWEEP_ANGLE_QUEUE_LENGTH (PULSE_PROCESSOR_N_SENSORS * PULSE_PROCESSOR_N_SWEEPS * PULSE_PROCESSOR_N_BASE_STATIONS)
+#endif
+
+#define MEASUREMENT_QUEUE_ALLOC(NAME, LENGTH) STATIC_MEM_QUEUE_ALLOC(NAME, LENGTH, sizeof(queuedMeasurement_t))
+MEASUREMENT_QUEUE_ALLOC(tdoaQueue, ESTIMATOR_TDOA_QUEUE_LENGTH);
+MEASUREMENT_QUEUE_ALLOC(positionQueue, 2);
+MEASUREMENT_QUEUE_ALLOC(poseQueue, 2);
+MEASUREMENT_QUEUE_ALLOC(distanceQueue, 4);
+MEASUREMENT_QUEUE_ALLOC(tofQueue, 1);
+MEASUREMENT_QUEUE_ALLOC(absoluteHeightQueue, 1);
+MEASUREMENT_QUEUE_ALLOC(flowQueue, 2);
+MEASUREMENT_QUEUE_ALLOC(yawErrorQueue, 1);
+MEASUREMENT_QUEUE_ALLOC(sweepAngleQueue, ESTIMATOR_SWEEP_ANGLE_QUEUE_LENGTH);
+MEASUREMENT_QUEUE_ALLOC(barometerQueue, 1);
+MEASUREMENT_QUEUE_ALLOC(tdoaBatchQueue, 3);
+MEASUREMENT_QUEUE_ALLOC(shadowMeasurementQueue, 8);
+
+static xQueueHandle measurementQueues[MeasurementTypeCount];
+static xQueueHandle shadowMeasurementQueue;
+
+static const MeasurementType measurementPriority[MeasurementTypeCount] = {
+  MeasurementTypePose,
+  MeasurementTypePosition,
+  MeasurementTypeYawError,
+  MeasurementTypeAbsoluteHeight,
+  MeasurementTypeBarometer,
+  MeasurementTypeTOF,
+  MeasurementTypeFlow,
+  MeasurementTypeTDOA,
+  MeasurementTypeTDOABatch,
+  MeasurementTypeDistance,
+  MeasurementTypeSweepAngle,
+  // IMU samples are not queued
+  MeasurementTypeGyroscope,
+  MeasurementTypeAcceleration,
+};
+
+/**
+ * The IMU accumulator holds the running sums of all IMU samples. It is
+ * written by the sensors task only and read without locking by the estimator:
+ * the sequence number is odd while the sums are updated, a reader that sees
+ * an odd or changed sequence number gives up and gets the samples on the next
+ * read instead. The sums never reset, the reader takes the difference to the
+ * previous read. They are kept in double to not lose precision over time.
+ */
+typedef struct {
+  uint32_t sequence;
+  double accSum[3];
+  uint32_t accCount;
+  Axis3f accLatest;
+  double gyroSum[3];
+  uint32_t gyroCount;
+  Axis3f gyroLatest;
+  uint64_t gyroTimestamp;
+} imuAccumulator_t;
+
+static volatile imuAccumulator_t imuAccumulator;
+// The sums at the previous read, one per estimator, only used by the readers
+static imuAccumulator_t imuPreviousRead[StateEstimatorTypeCount];
 
-#define MEASUREMENTS_QUEUE_SIZE (20)
-static xQueueHandle measurementsQueue;
-STATIC_MEM_QUEUE_ALLOC(measurementsQueue, MEASUREMENTS_QUEUE_SIZE, sizeof(measurement_t));
+// Bit field, one bit per MeasurementType. A set bit drops the oldest measurement when the queue is full.
+static uint16_t keepNewestMeasurements =
+  (1 << MeasurementTypePosition) |
+  (1 << MeasurementTypePose) |
+  (1 << MeasurementTypeTOF) |
+  (1 << MeasurementTypeAbsoluteHeight) |
+  (1 << MeasurementTypeYawError) |
+  (1 << MeasurementTypeBarometer);
 
 // Statistics
 #define ONE_SECOND 1000
 static STATS_CNT_RATE_DEFINE(measurementAppendedCounter, ONE_SECOND);
 static STATS_CNT_RATE_DEFINE(measurementNotAppendedCounter, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(shadowDroppedCounter, ONE_SECOND);
+static statsCntRateLogger_t appendedCounters[MeasurementTypeCount];
+static statsCntRateLogger_t droppedCounters[MeasurementTypeCount];
+// Ticks from enqueue to dequeue of the latest dequeued measurement, per type
+static uint16_t queueLatency[MeasurementTypeCount];
 
 // events
 EVENTTRIGGER(estTDOA, uint8, idA, uint8, idB, float, distanceDiff)
@@ -40,6 +179,7 @@ EVENTTRIGGER(estSweepAngle, uint8, sensorId, uint8, basestationId, uint8, sweepI
 EVENTTRIGGER(estGyroscope)
 EVENTTRIGGER(estAcceleration)
 EVENTTRIGGER(estBarometer)
+EVENTTRIGGER(estTDOABatch, uint8, idA, uint8, count)
 
 static void initEstimator(const StateEstimatorType estimator);
 static void deinitEstimator(const StateEstimatorType estimator);
@@ -49,6 +189,8 @@ typedef struct {
   void (*deinit)(void);
   bool (*test)(void);
   void (*update)(state_t *state, const uint32_t tick);
+  // Time of the latest run of an estimator that does its work in its own task, NULL if the work is done in update()
+  uint32_t (*taskTimeUs)(void);
   const char* name;
 } EstimatorFcns;
 
@@ -74,12 +216,34 @@ static EstimatorFcns estimatorFunctions[] = {
         .deinit = NOT_IMPLEMENTED,
         .test = estimatorKalmanTest,
         .update = estimatorKalman,
+        .taskTimeUs = estimatorKalmanGetTaskTimeUs,
         .name = "Kalman",
     },
 };
 
 void stateEstimatorInit(StateEstimatorType estimator) {
-  measurementsQueue = STATIC_MEM_QUEUE_CREATE(measurementsQueue);
+  measurementQueues[MeasurementTypeTDOA] = STATIC_MEM_QUEUE_CREATE(tdoaQueue);
+  measurementQueues[MeasurementTypePosition] = STATIC_MEM_QUEUE_CREATE(positionQueue);
+  measurementQueues[MeasurementTypePose] = STATIC_MEM_QUEUE_CREATE(poseQueue);
+  measurementQueues[MeasurementTypeDistance] = STATIC_MEM_QUEUE_CREATE(distanceQueue);
+  measurementQueues[MeasurementTypeTOF] = STATIC_MEM_QUEUE_CREATE(tofQueue);
+  measurementQueues[MeasurementTypeAbsoluteHeight] = STATIC_MEM_QUEUE_CREATE(absoluteHeightQueue);
+  measurementQueues[MeasurementTypeFlow] = STATIC_MEM_QUEUE_CREATE(flowQueue);
+  measurementQueues[MeasurementTypeYawError] = STATIC_MEM_QUEUE_CREATE(yawErrorQueue);
+  measurementQueues[MeasurementTypeSweepAngle] = STATIC_MEM_QUEUE_CREATE(sweepAngleQueue);
+  measurementQueues[MeasurementTypeBarometer] = STATIC_MEM_QUEUE_CREATE(barometerQueue);
+  measurementQueues[MeasurementTypeTDOABatch] = STATIC_MEM_QUEUE_CREATE(tdoaBatchQueue);
+  shadowMeasurementQueue = STATIC_MEM_QUEUE_CREATE(shadowMeasurementQueue);
+
+  for (int i = 0; i < MeasurementTypeCount; i++) {
+    queueMonitorAddQueue(measurementQueues[i], queueMonitorEstimator);
+    STATS_CNT_RATE_INIT(&appendedCounters[i], ONE_SECOND);
+    STATS_CNT_RATE_INIT(&droppedCounters[i], ONE_SECOND);
+  }
+
+  shadowInputQueue = STATIC_MEM_QUEUE_CREATE(shadowInputQueue);
+  STATIC_MEM_TASK_CREATE(shadowTask, shadowTask, ESTIMATOR_SHADOW_TASK_NAME, NULL, ESTIMATOR_SHADOW_TASK_PRI);
+
   stateEstimatorSwitchTo(estimator);
 }
 
@@ -100,6 +264,11 @@ void stateEstimatorSwitchTo(StateEstimatorType estimator) {
     newEstimator = forcedEstimator;
   }
 
+  if (newEstimator == shadowEstimator) {
+    // The shadow becomes the current estimator, it is not run twice
+    shadowEstimator = anyEstimator;
+  }
+
   initEstimator(newEstimator);
   StateEstimatorType previousEstimator = currentEstimator;
   currentEstimator = newEstimator;
@@ -113,6 +282,10 @@ StateEstimatorType getStateEstimator(void) {
 }
 
 static void initEstimator(const StateEstimatorType estimator) {
+  // Skip the IMU samples accumulated since the estimator was last used
+  estimatorImuSamples_t discarded;
+  estimatorGetImuSamples(estimator, &discarded);
+
   if (estimatorFunctions[estimator].init) {
     estimatorFunctions[estimator].init();
   }
@@ -130,6 +303,11 @@ bool stateEstimatorTest(void) {
 
 void stateEstimator(state_t *state, const uint32_t tick) {
   estimatorFunctions[currentEstimator].update(state, tick);
+
+  if (shadowEstimator != anyEstimator || shadowEstimatorRequested != anyEstimator) {
+    shadowInput_t input = {.state = *state, .tick = tick};
+    xQueueOverwrite(shadowInputQueue, &input);
+  }
 }
 
 const char* stateEstimatorGetName() {
@@ -137,27 +315,97 @@ const char* stateEstimatorGetName() {
 }
 
 
+static void accumulateImuSample(const measurement_t *measurement) {
+  imuAccumulator.sequence++;
+  __DMB();
+
+  if (measurement->type == MeasurementTypeGyroscope) {
+    const Axis3f* gyro = &measurement->data.gyroscope.gyro;
+    imuAccumulator.gyroSum[0] += gyro->x;
+    imuAccumulator.gyroSum[1] += gyro->y;
+    imuAccumulator.gyroSum[2] += gyro->z;
+    imuAccumulator.gyroLatest.x = gyro->x;
+    imuAccumulator.gyroLatest.y = gyro->y;
+    imuAccumulator.gyroLatest.z = gyro->z;
+    imuAccumulator.gyroTimestamp = measurement->data.gyroscope.timestamp;
+    imuAccumulator.gyroCount++;
+  } else {
+    const Axis3f* acc = &measurement->data.acceleration.acc;
+    imuAccumulator.accSum[0] += acc->x;
+    imuAccumulator.accSum[1] += acc->y;
+    imuAccumulator.accSum[2] += acc->z;
+    imuAccumulator.accLatest.x = acc->x;
+    imuAccumulator.accLatest.y = acc->y;
+    imuAccumulator.accLatest.z = acc->z;
+    imuAccumulator.accCount++;
+  }
+
+  __DMB();
+  imuAccumulator.sequence++;
+}
+
 void estimatorEnqueue(const measurement_t *measurement) {
-  if (!measurementsQueue) {
+  if (measurement->type >= MeasurementTypeCount) {
+    return;
+  }
+
+  if (measurement->type == MeasurementTypeGyroscope || measurement->type == MeasurementTypeAcceleration) {
+    accumulateImuSample(measurement);
+    STATS_CNT_RATE_EVENT(&appendedCounters[measurement->type]);
+    if (measurement->type == MeasurementTypeGyroscope) {
+      // no payload needed, see gyro.{x,y,z}
+      eventTrigger(&eventTrigger_estGyroscope);
+    } else {
+      // no payload needed, see acc.{x,y,z}
+      eventTrigger(&eventTrigger_estAcceleration);
+    }
+    return;
+  }
+
+  xQueueHandle queue = measurementQueues[measurement->type];
+  if (!queue) {
     return;
   }
 
+  const bool keepNewest = (keepNewestMeasurements & (1 << measurement->type)) != 0;
+  queuedMeasurement_t item;
+  item.measurement = *measurement;
+
   portBASE_TYPE result;
+  bool isDropped = false;
   bool isInInterrupt = (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0;
   if (isInInterrupt) {
     portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-    result = xQueueSendFromISR(measurementsQueue, measurement, &xHigherPriorityTaskWoken);
+    item.enqueueTick = xTaskGetTickCountFromISR();
+    result = xQueueSendFromISR(queue, &item, &xHigherPriorityTaskWoken);
+    if (result != pdTRUE && keepNewest) {
+      queuedMeasurement_t oldest;
+      isDropped = (xQueueReceiveFromISR(queue, &oldest, &xHigherPriorityTaskWoken) == pdTRUE);
+      result = xQueueSendFromISR(queue, &item, &xHigherPriorityTaskWoken);
+    }
     if (xHigherPriorityTaskWoken == pdTRUE) {
       portYIELD();
     }
   } else {
-    result = xQueueSend(measurementsQueue, measurement, 0);
+    item.enqueueTick = xTaskGetTickCount();
+    result = xQueueSend(queue, &item, 0);
+    if (result != pdTRUE && keepNewest) {
+      queuedMeasurement_t oldest;
+      isDropped = (xQueueReceive(queue, &oldest, 0) == pdTRUE);
+      result = xQueueSend(queue, &item, 0);
+    }
   }
 
   if (result == pdTRUE) {
     STATS_CNT_RATE_EVENT(&measurementAppendedCounter);
+    STATS_CNT_RATE_EVENT(&appendedCounters[measurement->type]);
   } else {
     STATS_CNT_RATE_EVENT(&measurementNotAppendedCounter);
+    isDropped = true;
+  }
+
+  if (isDropped) {
+    STATS_CNT_RATE_EVENT(&droppedCounters[measurement->type]);
   }
 
   // events
@@ -206,28 +454,237 @@ void estimatorEnqueue(const measurement_t *measurement) {
       eventTrigger_estSweepAngle_payload.sweepAngle = measurement->data.sweepAngle.measuredSweepAngle;
       eventTrigger(&eventTrigger_estSweepAngle);
       break;
-    case MeasurementTypeGyroscope:
-      // no payload needed, see gyro.{x,y,z}
-      eventTrigger(&eventTrigger_estGyroscope);
-      break;
-    case MeasurementTypeAcceleration:
-      // no payload needed, see acc.{x,y,z}
-      eventTrigger(&eventTrigger_estAcceleration);
-      break;
     case MeasurementTypeBarometer:
       // no payload needed, see baro.asl
       eventTrigger(&eventTrigger_estBarometer);
       break;
+    case MeasurementTypeTDOABatch:
+      eventTrigger_estTDOABatch_payload.idA = measurement->data.tdoaBatch.anchorId;
+      eventTrigger_estTDOABatch_payload.count = measurement->data.tdoaBatch.count;
+      eventTrigger(&eventTrigger_estTDOABatch);
+      break;
     default:
       break;
   }
 }
 
-bool estimatorDequeue(measurement_t *measurement) {
-  return pdTRUE == xQueueReceive(measurementsQueue, measurement, 0);
+bool estimatorDequeue(const StateEstimatorType estimator, measurement_t *measurement) {
+  queuedMeasurement_t item;
+
+  if (estimator != currentEstimator) {
+    if (estimator == shadowEstimator && pdTRUE == xQueueReceive(shadowMeasurementQueue, &item, 0)) {
+      *measurement = item.measurement;
+      return true;
+    }
+    return false;
+  }
+
+  for (int i = 0; i < MeasurementTypeCount; i++) {
+    const MeasurementType type = measurementPriority[i];
+    if (measurementQueues[type] && pdTRUE == xQueueReceive(measurementQueues[type], &item, 0)) {
+      *measurement = item.measurement;
+      queueLatency[type] = xTaskGetTickCount() - item.enqueueTick;
+
+      if (shadowEstimator != anyEstimator && pdTRUE != xQueueSend(shadowMeasurementQueue, &item, 0)) {
+        STATS_CNT_RATE_EVENT(&shadowDroppedCounter);
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool estimatorGetImuSamples(const StateEstimatorType estimator, estimatorImuSamples_t *samples) {
+  imuAccumulator_t current;
+
+  const uint32_t sequence = imuAccumulator.sequence;
+  if (sequence & 1) {
+    return false;
+  }
+  __DMB();
+
+  for (int i = 0; i < 3; i++) {
+    current.accSum[i] = imuAccumulator.accSum[i];
+    current.gyroSum[i] = imuAccumulator.gyroSum[i];
+  }
+  current.accCount = imuAccumulator.accCount;
+  current.gyroCount = imuAccumulator.gyroCount;
+  current.accLatest.x = imuAccumulator.accLatest.x;
+  current.accLatest.y = imuAccumulator.accLatest.y;
+  current.accLatest.z = imuAccumulator.accLatest.z;
+  current.gyroLatest.x = imuAccumulator.gyroLatest.x;
+  current.gyroLatest.y = imuAccumulator.gyroLatest.y;
+  current.gyroLatest.z = imuAccumulator.gyroLatest.z;
+  current.gyroTimestamp = imuAccumulator.gyroTimestamp;
+
+  __DMB();
+  if (imuAccumulator.sequence != sequence) {
+    return false;
+  }
+
+  imuAccumulator_t* previousRead = &imuPreviousRead[estimator];
+  samples->accCount = current.accCount - previousRead->accCount;
+  samples->gyroCount = current.gyroCount - previousRead->gyroCount;
+  for (int i = 0; i < 3; i++) {
+    samples->accSum.axis[i] = (float)(current.accSum[i] - previousRead->accSum[i]);
+    samples->gyroSum.axis[i] = (float)(current.gyroSum[i] - previousRead->gyroSum[i]);
+  }
+  samples->accLatest = current.accLatest;
+  samples->gyroLatest = current.gyroLatest;
+  samples->gyroTimestamp = current.gyroTimestamp;
+
+  *previousRead = current;
+
+  return samples->accCount > 0 || samples->gyroCount > 0;
+}
+
+// Activates the requested shadow estimator, called from the shadow task only
+static void shadowUpdateEstimator(void) {
+  StateEstimatorType requested = shadowEstimatorRequested;
+  if (requested >= StateEstimatorTypeCount || requested == currentEstimator) {
+    requested = anyEstimator;
+  }
+
+  if (requested == shadowEstimator) {
+    return;
+  }
+
+  const StateEstimatorType previous = shadowEstimator;
+  shadowEstimator = anyEstimator;
+  if (previous != anyEstimator && previous != currentEstimator) {
+    deinitEstimator(previous);
+  }
+
+  if (requested != anyEstimator) {
+    xQueueReset(shadowMeasurementQueue);
+    initEstimator(requested);
+    shadowEstimator = requested;
+    DEBUG_PRINT("Shadow %s (%d) estimator\n", estimatorFunctions[requested].name, requested);
+  }
+}
+
+static float wrapAngle(float angle) {
+  while (angle > 180.0f) {
+    angle -= 360.0f;
+  }
+  while (angle < -180.0f) {
+    angle += 360.0f;
+  }
+  return angle;
+}
+
+static void shadowTask(void* parameters) {
+  systemWaitStart();
+
+  while (true) {
+    shadowInput_t input;
+    xQueueReceive(shadowInputQueue, &input, portMAX_DELAY);
+
+    shadowUpdateEstimator();
+    const StateEstimatorType shadow = shadowEstimator;
+    if (shadow == anyEstimator) {
+      continue;
+    }
+
+    const uint64_t start = usecTimestamp();
+    estimatorFunctions[shadow].update(&shadowState, input.tick);
+    if (estimatorFunctions[shadow].taskTimeUs) {
+      // update() only hands over the state, the work is done in the task of the estimator
+      shadowUpdateUs = estimatorFunctions[shadow].taskTimeUs();
+    } else {
+      shadowUpdateUs = (uint32_t)(usecTimestamp() - start);
+    }
+
+    const state_t* primary = &input.state;
+    const float dx = shadowState.position.x - primary->position.x;
+    const float dy = shadowState.position.y - primary->position.y;
+    const float dz = shadowState.position.z - primary->position.z;
+    shadowPosError = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    const float dvx = shadowState.velocity.x - primary->velocity.x;
+    const float dvy = shadowState.velocity.y - primary->velocity.y;
+    const float dvz = shadowState.velocity.z - primary->velocity.z;
+    shadowVelError = sqrtf(dvx * dvx + dvy * dvy + dvz * dvz);
+
+    shadowRollError = wrapAngle(shadowState.attitude.roll - primary->attitude.roll);
+    shadowPitchError = wrapAngle(shadowState.attitude.pitch - primary->attitude.pitch);
+    shadowYawError = wrapAngle(shadowState.attitude.yaw - primary->attitude.yaw);
+  }
 }
 
 LOG_GROUP_START(estimator)
   STATS_CNT_RATE_LOG_ADD(rtApnd, &measurementAppendedCounter)
   STATS_CNT_RATE_LOG_ADD(rtRej, &measurementNotAppendedCounter)
 LOG_GROUP_STOP(estimator)
+
+/**
+ * Per measurement type queue statistics. For each type: Apnd is the rate of
+ * appended measurements, Drop the rate of dropped measurements (rejected or
+ * replaced by a newer one) and Lat the time in ms the latest measurement
+ * spent in the queue.
+ */
+LOG_GROUP_START(estQueue)
+  STATS_CNT_RATE_LOG_ADD(tdoaApnd, &appendedCounters[MeasurementTypeTDOA])
+  STATS_CNT_RATE_LOG_ADD(tdoaDrop, &droppedCounters[MeasurementTypeTDOA])
+  LOG_ADD(LOG_UINT16, tdoaLat, &queueLatency[MeasurementTypeTDOA])
+  STATS_CNT_RATE_LOG_ADD(posApnd, &appendedCounters[MeasurementTypePosition])
+  STATS_CNT_RATE_LOG_ADD(posDrop, &droppedCounters[MeasurementTypePosition])
+  LOG_ADD(LOG_UINT16, posLat, &queueLatency[MeasurementTypePosition])
+  STATS_CNT_RATE_LOG_ADD(poseApnd, &appendedCounters[MeasurementTypePose])
+  STATS_CNT_RATE_LOG_ADD(poseDrop, &droppedCounters[MeasurementTypePose])
+  LOG_ADD(LOG_UINT16, poseLat, &queueLatency[MeasurementTypePose])
+  STATS_CNT_RATE_LOG_ADD(distApnd, &appendedCounters[MeasurementTypeDistance])
+  STATS_CNT_RATE_LOG_ADD(distDrop, &droppedCounters[MeasurementTypeDistance])
+  LOG_ADD(LOG_UINT16, distLat, &queueLatency[MeasurementTypeDistance])
+  STATS_CNT_RATE_LOG_ADD(tofApnd, &appendedCounters[MeasurementTypeTOF])
+  STATS_CNT_RATE_LOG_ADD(tofDrop, &droppedCounters[MeasurementTypeTOF])
+  LOG_ADD(LOG_UINT16, tofLat, &queueLatency[MeasurementTypeTOF])
+  STATS_CNT_RATE_LOG_ADD(heightApnd, &appendedCounters[MeasurementTypeAbsoluteHeight])
+  STATS_CNT_RATE_LOG_ADD(heightDrop, &droppedCounters[MeasurementTypeAbsoluteHeight])
+  LOG_ADD(LOG_UINT16, heightLat, &queueLatency[MeasurementTypeAbsoluteHeight])
+  STATS_CNT_RATE_LOG_ADD(flowApnd, &appendedCounters[MeasurementTypeFlow])
+  STATS_CNT_RATE_LOG_ADD(flowDrop, &droppedCounters[MeasurementTypeFlow])
+  LOG_ADD(LOG_UINT16, flowLat, &queueLatency[MeasurementTypeFlow])
+  STATS_CNT_RATE_LOG_ADD(yawApnd, &appendedCounters[MeasurementTypeYawError])
+  STATS_CNT_RATE_LOG_ADD(yawDrop, &droppedCounters[MeasurementTypeYawError])
+  LOG_ADD(LOG_UINT16, yawLat, &queueLatency[MeasurementTypeYawError])
+  STATS_CNT_RATE_LOG_ADD(sweepApnd, &appendedCounters[MeasurementTypeSweepAngle])
+  STATS_CNT_RATE_LOG_ADD(sweepDrop, &droppedCounters[MeasurementTypeSweepAngle])
+  LOG_ADD(LOG_UINT16, sweepLat, &queueLatency[MeasurementTypeSweepAngle])
+  // IMU samples are not queued, only the rate is logged
+  STATS_CNT_RATE_LOG_ADD(gyroApnd, &appendedCounters[MeasurementTypeGyroscope])
+  STATS_CNT_RATE_LOG_ADD(accApnd, &appendedCounters[MeasurementTypeAcceleration])
+  STATS_CNT_RATE_LOG_ADD(baroApnd, &appendedCounters[MeasurementTypeBarometer])
+  STATS_CNT_RATE_LOG_ADD(baroDrop, &droppedCounters[MeasurementTypeBarometer])
+  LOG_ADD(LOG_UINT16, baroLat, &queueLatency[MeasurementTypeBarometer])
+  STATS_CNT_RATE_LOG_ADD(tdoaBApnd, &appendedCounters[MeasurementTypeTDOABatch])
+  STATS_CNT_RATE_LOG_ADD(tdoaBDrop, &droppedCounters[MeasurementTypeTDOABatch])
+  LOG_ADD(LOG_UINT16, tdoaBLat, &queueLatency[MeasurementTypeTDOABatch])
+LOG_GROUP_STOP(estQueue)
+
+/**
+ * Shadow estimator comparison, see the estimator.shadow parameter. The errors
+ * are the shadow state minus the state of the current estimator: position and
+ * velocity as norms (m, m/s), attitude per axis (degrees). updUs is the time
+ * spent in the latest shadow update, for an estimator that runs in its own
+ * task the latest run of that task, and drop the rate of measurements that
+ * did not fit in the shadow queue.
+ */
+LOG_GROUP_START(estShadow)
+  LOG_ADD(LOG_FLOAT, posErr, &shadowPosError)
+  LOG_ADD(LOG_FLOAT, velErr, &shadowVelError)
+  LOG_ADD(LOG_FLOAT, rollErr, &shadowRollError)
+  LOG_ADD(LOG_FLOAT, pitchErr, &shadowPitchError)
+  LOG_ADD(LOG_FLOAT, yawErr, &shadowYawError)
+  LOG_ADD(LOG_UINT32, updUs, &shadowUpdateUs)
+  STATS_CNT_RATE_LOG_ADD(drop, &shadowDroppedCounter)
+LOG_GROUP_STOP(estShadow)
+
+PARAM_GROUP_START(estimator)
+  PARAM_ADD(PARAM_UINT16, keepNewest, &keepNewestMeasurements)
+  /**
+   * @brief The estimator to run in shadow mode, next to the current estimator, for comparison (0 = off)
+   */
+  PARAM_ADD(PARAM_UINT8, shadow, &shadowEstimatorRequested)
+PARAM_GROUP_STOP(estimator)
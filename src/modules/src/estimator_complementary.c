@@ -37,16 +37,21 @@
 #include "sensors.h"
 #include "stabilizer_types.h"
 #include "static_mem.h"
+#include "quatcompress.h"
 
 static Axis3f gyro;
+static uint64_t gyroTimestamp;
+static uint64_t lastAttitudeUpdateTimestamp;
 static Axis3f acc;
 static baro_t baro;
 static tofMeasurement_t tof;
 
-#define ATTITUDE_UPDATE_RATE RATE_250_HZ
+#define ATTITUDE_UPDATE_RATE COMPLEMENTARY_ATTITUDE_RATE
 #define ATTITUDE_UPDATE_DT 1.0/ATTITUDE_UPDATE_RATE
+// Longest attitude update interval taken from the IMU timestamps
+#define ATTITUDE_UPDATE_MAX_DT 0.1f
 
-#define POS_UPDATE_RATE RATE_100_HZ
+#define POS_UPDATE_RATE COMPLEMENTARY_POSITION_RATE
 #define POS_UPDATE_DT 1.0/POS_UPDATE_RATE
 
     void
@@ -66,17 +71,31 @@ bool estimatorComplementaryTest(void)
 
 void estimatorComplementary(state_t *state, const uint32_t tick)
 {
+  // The complementary filter only uses the latest IMU samples
+  estimatorImuSamples_t imu;
+  if (estimatorGetImuSamples(complementaryEstimator, &imu)) {
+    if (imu.gyroCount > 0) {
+#ifdef COMPLEMENTARY_FAST_ATTITUDE
+      // The fast update runs once per tick, use the mean of the samples since the previous tick
+      const float scale = 1.0f / imu.gyroCount;
+      gyro.x = imu.gyroSum.x * scale;
+      gyro.y = imu.gyroSum.y * scale;
+      gyro.z = imu.gyroSum.z * scale;
+#else
+      gyro = imu.gyroLatest;
+#endif
+      gyroTimestamp = imu.gyroTimestamp;
+    }
+    if (imu.accCount > 0) {
+      acc = imu.accLatest;
+    }
+  }
+
   // Pull the latest sensors values of interest; discard the rest
   measurement_t m;
-  while (estimatorDequeue(&m)) {
+  while (estimatorDequeue(complementaryEstimator, &m)) {
     switch (m.type)
     {
-    case MeasurementTypeGyroscope:
-      gyro = m.data.gyroscope.gyro;
-      break;
-    case MeasurementTypeAcceleration:
-      acc = m.data.acceleration.acc;
-      break;
     case MeasurementTypeBarometer:
       baro = m.data.barometer.baro;
       break;
@@ -89,10 +108,19 @@ void estimatorComplementary(state_t *state, const uint32_t tick)
   }
 
   // Update filter
-  if (RATE_DO_EXECUTE(ATTITUDE_UPDATE_RATE, tick)) {
+  if (RATE_DO_EXECUTE_WITH_PHASE(ATTITUDE_UPDATE_RATE, COMPLEMENTARY_ATTITUDE_PHASE, tick)) {
+#ifdef COMPLEMENTARY_FAST_ATTITUDE
+    const float dt = ATTITUDE_UPDATE_DT;
+    sensfusion6UpdateQFast(gyro.x, gyro.y, gyro.z,
+                           acc.x, acc.y, acc.z);
+#else
+    const float dt = estimatorImuDt(gyroTimestamp, lastAttitudeUpdateTimestamp, ATTITUDE_UPDATE_DT, ATTITUDE_UPDATE_MAX_DT);
+    lastAttitudeUpdateTimestamp = gyroTimestamp;
+
     sensfusion6UpdateQ(gyro.x, gyro.y, gyro.z,
                         acc.x, acc.y, acc.z,
-                        ATTITUDE_UPDATE_DT);
+                        dt);
+#endif
 
     // Save attitude, adjusted for the legacy CF2 body coordinate system
     sensfusion6GetEulerRPY(&state->attitude.roll, &state->attitude.pitch, &state->attitude.yaw);
@@ -104,15 +132,17 @@ void estimatorComplementary(state_t *state, const uint32_t tick)
       &state->attitudeQuaternion.y,
       &state->attitudeQuaternion.z,
       &state->attitudeQuaternion.w);
+    const float q[4] = {state->attitudeQuaternion.x, state->attitudeQuaternion.y, state->attitudeQuaternion.z, state->attitudeQuaternion.w};
+    state->attitudeQuaternionCompressed = quatcompress(q);
 
     state->acc.z = sensfusion6GetAccZWithoutGravity(acc.x,
                                                     acc.y,
                                                     acc.z);
 
-    positionUpdateVelocity(state->acc.z, ATTITUDE_UPDATE_DT);
+    positionUpdateVelocity(state->acc.z, dt);
   }
 
-  if (RATE_DO_EXECUTE(POS_UPDATE_RATE, tick)) {
+  if (RATE_DO_EXECUTE_WITH_PHASE(POS_UPDATE_RATE, COMPLEMENTARY_POSITION_PHASE, tick)) {
     positionEstimate(state, &baro, &tof, POS_UPDATE_DT, tick);
   }
 }
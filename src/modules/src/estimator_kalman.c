@@ -76,6 +76,7 @@
 
 #include "statsCnt.h"
 #include "rateSupervisor.h"
+#include "usec_time.h"
 
 // Measurement models
 #include "mm_distance.h"
@@ -101,16 +102,37 @@
 // Semaphore to signal that we got data from the stabilizer loop to process
 static SemaphoreHandle_t runTaskSemaphore;
 
-// Mutex to protect data that is shared between the task and
-// functions called by the stabilizer loop
-static SemaphoreHandle_t dataMutex;
-static StaticSemaphore_t dataMutexBuffer;
+/**
+ * The state is handed over from the task to the stabilizer loop through a
+ * double buffer, without locking. The task writes to the buffer that is not
+ * published and then publishes it. Each buffer has a sequence number that is
+ * odd while the buffer is being written, the reader uses it to detect torn
+ * reads and retries. Since the stabilizer task has a higher priority than the
+ * kalman task, a read is normally never interrupted by a write, the retries are
+ * a safety net and are counted.
+ */
+typedef struct {
+  state_t state;
+  uint32_t sequence;
+} stateBuffer_t;
+
+static stateBuffer_t stateBuffers[2];
+static uint8_t publishedStateBuffer;
+
+// The latest external state, only the acceleration is updated when the internal state has not changed
+static state_t externalState;
+static bool externalStateValid;
+#define STATE_READ_ATTEMPTS 3
 
 
 /**
  * Tuning parameters
  */
 #define PREDICT_RATE RATE_100_HZ // this is slower than the IMU update rate of 500Hz
+#define PREDICT_RATE_MIN RATE_50_HZ
+#define PREDICT_RATE_MAX RATE_500_HZ
+// Longest prediction interval taken from the IMU timestamps, longer intervals fall back to the tick count
+#define PREDICT_MAX_IMU_DT 0.1f
 // The bounds on the covariance, these shouldn't be hit, but sometimes are... why?
 #define MAX_COVARIANCE (100)
 #define MIN_COVARIANCE (1e-6f)
@@ -120,6 +142,71 @@ static StaticSemaphore_t dataMutexBuffer;
 static bool robustTwr = false;
 static bool robustTdoa = false;
 
+/**
+ * Prediction rate
+ *
+ * The state is predicted at predictRate. When adaptivePredictRate is set,
+ * the rate is raised to PREDICT_RATE_MAX when the IMU shows aggressive motion
+ * and lowered to PREDICT_RATE_MIN when hovering or on the ground, to spend the
+ * cycles on updates instead. The IMU data is accumulated between predictions,
+ * regardless of the rate.
+ */
+static uint16_t predictRate = PREDICT_RATE;
+static bool adaptivePredictRate = false;
+static float aggressiveGyroThreshold = 90.0f; // deg/s
+static float aggressiveAccThreshold = 0.3f;   // G, deviation from 1 G
+#define HOVER_GYRO_THRESHOLD 10.0f            // deg/s
+#define HOVER_ACC_THRESHOLD 0.05f             // G
+#define AGGRESSIVE_HOLD_TIME M2T(500)         // Time to stay at the max rate after aggressive motion
+
+/**
+ * IMU pre-integration
+ *
+ * When imuPreintegration is set, the IMU samples read in each loop of the task
+ * are integrated into imuDelta right away, taking the rotation during the
+ * prediction interval into account. The prediction then consumes the
+ * integrated delta instead of the average of the samples, which keeps it
+ * accurate during fast rotations at low prediction rates.
+ */
+static bool imuPreintegration = true;
+
+/**
+ * Measurement throttling
+ *
+ * When hovering in a dense UWB or Lighthouse system, most measurements add
+ * little information since the covariance along them is already far below
+ * the measurement noise. For the measurement types set in throttleTypes, a
+ * scalar update is considered redundant when the variance of the predicted
+ * measurement, estimated from the diagonal of P, is below
+ * throttleVarianceRatio times the measurement variance. Only every
+ * throttleKeepEvery:th redundant measurement of each type is fused.
+ */
+static uint16_t throttleTypes = 0;
+static float throttleVarianceRatio = 0.05f;
+static uint8_t throttleKeepEvery = 4;
+static kalmanCoreUpdateThrottle_t updateThrottles[MeasurementTypeCount];
+
+/**
+ * The flow deck delivers flow and TOF measurements at the same rate, the flow
+ * and height updates depend on the same z and R entries. When combineFlowAndTof
+ * is set, a TOF measurement is held back until the end of the prediction step
+ * and fused together with a flow measurement of the same step in one vector
+ * update. If there is no such flow measurement it is fused alone.
+ */
+static bool combineFlowAndTof = true;
+static tofMeasurement_t pendingTof;
+static bool hasPendingTof;
+
+/**
+ * The sweeps of a lighthouse frame are enqueued back to back. When batchSweeps
+ * is set, consecutive sweep angles dequeued in the same step are collected and
+ * fused with vector updates of up to KC_MAX_VECTOR_UPDATE_DIM rows. Delayed
+ * and throttled sweeps are fused one by one.
+ */
+static bool batchSweeps = true;
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t pendingSweeps[KC_MAX_VECTOR_UPDATE_DIM];
+static int pendingSweepCount;
+
 /**
  * Quadrocopter State
  *
@@ -132,6 +219,7 @@ static bool robustTdoa = false;
  */
 
 NO_DMA_CCM_SAFE_ZERO_INIT static kalmanCoreData_t coreData;
+NO_DMA_CCM_SAFE_ZERO_INIT static kalmanCoreWorkspace_t coreWorkspace;
 
 /**
  * Internal variables. Note that static declaration results in default initialization (to 0)
@@ -145,12 +233,26 @@ static uint32_t accAccumulatorCount;
 static uint32_t gyroAccumulatorCount;
 static Axis3f accLatest;
 static Axis3f gyroLatest;
+static uint64_t gyroLatestTimestamp; // usecTimestamp() of gyroLatest, 0 if unknown
+static kalmanCoreImuDelta_t imuDelta;
+static uint64_t imuDeltaTimestamp; // usecTimestamp() of the latest integrated gyro sample, 0 if unknown
+static uint32_t imuDeltaTick;      // Tick of the latest integration
 static bool quadIsFlying = false;
 
-static OutlierFilterLhState_t sweepOutlierFilterState;
+// IMU activity during the latest prediction interval
+static float imuGyroNorm;     // deg/s
+static float imuAccDeviation; // G
+static uint16_t activePredictRate;
+static uint32_t aggressiveHoldUntil;
 
-// Data used to enable the task and stabilizer loop to run with minimal locking
-static state_t taskEstimatorState; // The estimator state produced by the task, copied to the stabilzer when needed.
+// CPU time of the latest predict, update and finalize, in us
+static uint16_t predictTimeUs;
+static uint16_t updateTimeUs;
+static uint16_t finalizeTimeUs;
+// Time of the latest run of the task, in us
+static uint32_t taskTimeUs;
+
+static OutlierFilterLhState_t sweepOutlierFilterState;
 
 // Statistics
 #define ONE_SECOND 1000
@@ -160,11 +262,86 @@ static STATS_CNT_RATE_DEFINE(finalizeCounter, ONE_SECOND);
 // static STATS_CNT_RATE_DEFINE(measurementAppendedCounter, ONE_SECOND);
 // static STATS_CNT_RATE_DEFINE(measurementNotAppendedCounter, ONE_SECOND);
 
+static STATS_CNT_RATE_DEFINE(delayedReplayCounter, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(delayedTooOldCounter, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(stateReadRetryCounter, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(stateReadTornCounter, ONE_SECOND);
+
 static rateSupervisor_t rateSupervisorContext;
+// Allowed deviation of the prediction rate [1/1000], one prediction per second up to PREDICT_RATE_MAX
+#define PREDICT_RATE_TOLERANCE 2
+
+/**
+ * Delayed measurements
+ *
+ * Some measurements arrive late, for instance external positions sent over
+ * the radio. To fuse them at the time they were captured, a short history of
+ * the filter is kept. There is one history entry per prediction, holding the
+ * filter state before the prediction together with the IMU data and process
+ * noise steps that were used to move it forward. All measurements fused
+ * within the history window are also logged.
+ *
+ * When a measurement with a capture tick before the latest prediction is
+ * dequeued, the filter is rewound to the entry preceding the capture tick and
+ * the predictions are replayed, re-fusing the logged measurements and the
+ * delayed measurement in time order.
+ *
+ * Memory is bounded by the history and log sizes, and a replay is bounded by
+ * KALMAN_HISTORY_LENGTH predictions and KALMAN_HISTORY_MEASUREMENTS updates.
+ * Measurements that are older than the history are fused at arrival.
+ *
+ * Keeping the history costs a copy of the filter state per prediction, it is
+ * therefore only recorded while a delayed measurement has been received within
+ * the last DELAYED_SOURCE_TIMEOUT. The first delayed measurement is fused at
+ * arrival. Measurements that are captured at most delayThreshold ms before
+ * they are dequeued, for instance flow stamped at the middle of its
+ * integration interval, are not considered delayed and are fused at arrival.
+ */
+#ifndef KALMAN_HISTORY_LENGTH
+  #define KALMAN_HISTORY_LENGTH 4
+#endif
+#ifndef KALMAN_HISTORY_MEASUREMENTS
+  #define KALMAN_HISTORY_MEASUREMENTS 32
+#endif
+#define DELAYED_SOURCE_TIMEOUT M2T(1000)
+#ifndef KALMAN_DELAY_THRESHOLD
+  #define KALMAN_DELAY_THRESHOLD (1000 / PREDICT_RATE) // ms, one prediction period
+#endif
+
+typedef struct {
+  uint32_t tick;              // Tick of the prediction
+  float dt;
+  Axis3f acc;                 // m/s^2
+  Axis3f gyro;                // rad/s
+  kalmanCoreImuDelta_t imuDelta; // Used instead of acc and gyro when dt is not zero
+  bool quadIsFlying;
+  uint16_t processNoiseCount; // Number of process noise steps after the prediction
+  float processNoiseDt;       // Total time of the process noise steps
+  kalmanCoreData_t coreData;  // The filter state before the prediction
+} historyEntry_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static historyEntry_t history[KALMAN_HISTORY_LENGTH];
+static int historyNewest;
+static int historyCount;
+
+// Measurements fused in the history window, the capture tick is always set
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t measurementLog[KALMAN_HISTORY_MEASUREMENTS];
+static int measurementLogNext;
+static int measurementLogCount;
+// The latest capture tick of a measurement that has been evicted from the log
+static uint32_t measurementLogEvictedTick;
+// The latest tick a delayed measurement was received, 0 if none
+static uint32_t delayedSourceTick;
+
+static bool delayCompensation = true;
+static uint16_t delayThreshold = KALMAN_DELAY_THRESHOLD;
 
 #define WARNING_HOLD_BACK_TIME M2T(2000)
 static uint32_t warningBlockTime = 0;
 
+// The updates keep the covariance matrix symmetric and bounded, a full pass over it is only a safety net
+#define COVARIANCE_HEALTH_CHECK_TIME M2T(1000)
+
 #ifdef KALMAN_USE_BARO_UPDATE
 static const bool useBaroUpdate = true;
 #else
@@ -174,6 +351,17 @@ static const bool useBaroUpdate = false;
 static void kalmanTask(void* parameters);
 static bool predictStateForward(uint32_t osTick, float dt);
 static bool updateQueuedMeasurements(const uint32_t tick);
+static void publishState(const uint32_t osTick, const bool stateChanged);
+static uint16_t selectPredictRate(const uint32_t osTick);
+static void supervisePredictRate(const uint32_t osTick);
+static bool fuseMeasurement(const measurement_t *m, const Axis3f* gyro, const uint32_t tick);
+static void fusePendingTof();
+static bool fusePendingSweeps(const uint32_t tick);
+static void historyReset();
+static bool historyIsRecording(const uint32_t tick);
+static void historyAddProcessNoise(float dt);
+static void historyLogMeasurement(const measurement_t *m);
+static bool historyFuseDelayedMeasurement(const measurement_t *m);
 
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(kalmanTask, 3 * configMINIMAL_STACK_SIZE);
 
@@ -183,8 +371,6 @@ STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(kalmanTask, 3 * configMINIMAL_STACK_
 void estimatorKalmanTaskInit() {
   vSemaphoreCreateBinary(runTaskSemaphore);
 
-  dataMutex = xSemaphoreCreateMutexStatic(&dataMutexBuffer);
-
   STATIC_MEM_TASK_CREATE(kalmanTask, kalmanTask, KALMAN_TASK_NAME, NULL, KALMAN_TASK_PRI);
 
   isInit = true;
@@ -198,13 +384,20 @@ static void kalmanTask(void* parameters) {
   systemWaitStart();
 
   uint32_t lastPrediction = xTaskGetTickCount();
+  uint64_t lastPredictionImuTimestamp = 0;
   uint32_t nextPrediction = xTaskGetTickCount();
   uint32_t lastPNUpdate = xTaskGetTickCount();
+  kalmanCoreImuDeltaReset(&imuDelta);
+  imuDeltaTick = xTaskGetTickCount();
+  uint32_t nextCovarianceHealthCheck = xTaskGetTickCount();
 
-  rateSupervisorInit(&rateSupervisorContext, xTaskGetTickCount(), M2T(1000), 99, 101, 1);
+  activePredictRate = PREDICT_RATE;
+  supervisePredictRate(xTaskGetTickCount());
+  rateSupervisorRegister(&rateSupervisorContext, "kalman");
 
   while (true) {
     xSemaphoreTake(runTaskSemaphore, portMAX_DELAY);
+    const uint64_t taskStart = usecTimestamp();
 
     // If the client triggers an estimator reset via parameter update
     if (coreData.resetEstimation) {
@@ -222,17 +415,27 @@ static void kalmanTask(void* parameters) {
   #endif
 
     // Run the system dynamics to predict the state forward.
-    if (osTick >= nextPrediction) { // update at the PREDICT_RATE
-      float dt = T2S(osTick - lastPrediction);
+    if (osTick >= nextPrediction) { // update at the activePredictRate
+      // The IMU sample timestamps are used when available, the tick only has a resolution of 1 ms
+      const uint64_t imuTimestamp = gyroLatestTimestamp;
+      float dt = estimatorImuDt(imuTimestamp, lastPredictionImuTimestamp, T2S(osTick - lastPrediction), PREDICT_MAX_IMU_DT);
+      const uint64_t predictStart = usecTimestamp();
       if (predictStateForward(osTick, dt)) {
+        predictTimeUs = usecTimestamp() - predictStart;
         lastPrediction = osTick;
+        lastPredictionImuTimestamp = imuTimestamp;
         doneUpdate = true;
         STATS_CNT_RATE_EVENT(&predictionCounter);
       }
 
-      nextPrediction = osTick + S2T(1.0f / PREDICT_RATE);
+      const uint16_t rate = selectPredictRate(osTick);
+      if (rate != activePredictRate) {
+        activePredictRate = rate;
+        supervisePredictRate(osTick);
+      }
+      nextPrediction = osTick + S2T(1.0f / activePredictRate);
 
-      if (!rateSupervisorValidate(&rateSupervisorContext, T2M(osTick))) {
+      if (!rateSupervisorTick(&rateSupervisorContext, T2M(osTick), (uint32_t)usecTimestamp())) {
         DEBUG_PRINT("WARNING: Kalman prediction rate low (%lu)\n", rateSupervisorLatestCount(&rateSupervisorContext));
       }
     }
@@ -244,12 +447,15 @@ static void kalmanTask(void* parameters) {
       float dt = T2S(osTick - lastPNUpdate);
       if (dt > 0.0f) {
         kalmanCoreAddProcessNoise(&coreData, dt);
+        historyAddProcessNoise(dt);
         lastPNUpdate = osTick;
       }
     }
 
     {
+      const uint64_t updateStart = usecTimestamp();
       if(updateQueuedMeasurements(osTick)) {
+        updateTimeUs = usecTimestamp() - updateStart;
         doneUpdate = true;
       }
     }
@@ -258,12 +464,18 @@ static void kalmanTask(void* parameters) {
      * If an update has been made, the state is finalized:
      * - the attitude error is moved into the body attitude quaternion,
      * - the body attitude is converted into a rotation matrix for the next prediction, and
-     * - correctness of the covariance matrix is ensured
+     * - correctness of the covariance matrix is ensured, with a full pass over it at a low rate
      */
 
     if (doneUpdate)
     {
+      const uint64_t finalizeStart = usecTimestamp();
       kalmanCoreFinalize(&coreData, osTick);
+      if (osTick >= nextCovarianceHealthCheck) {
+        kalmanCoreCovarianceHealthCheck(&coreData);
+        nextCovarianceHealthCheck = osTick + COVARIANCE_HEALTH_CHECK_TIME;
+      }
+      finalizeTimeUs = usecTimestamp() - finalizeStart;
       STATS_CNT_RATE_EVENT(&finalizeCounter);
       if (! kalmanSupervisorIsStateWithinBounds(&coreData)) {
         coreData.resetEstimation = true;
@@ -277,29 +489,75 @@ static void kalmanTask(void* parameters) {
 
     /**
      * Finally, the internal state is externalized.
-     * This is done every round, since the external state includes some sensor data
+     * This is done every round, since the external state includes some sensor data.
+     * Attitude, position and velocity are only converted when the internal state has changed.
      */
-    xSemaphoreTake(dataMutex, portMAX_DELAY);
-    kalmanCoreExternalizeState(&coreData, &taskEstimatorState, &accLatest, osTick);
-    xSemaphoreGive(dataMutex);
+    publishState(osTick, doneUpdate);
 
     STATS_CNT_RATE_EVENT(&updateCounter);
+    taskTimeUs = (uint32_t)(usecTimestamp() - taskStart);
   }
 }
 
+uint32_t estimatorKalmanGetTaskTimeUs(void)
+{
+  return taskTimeUs;
+}
+
 void estimatorKalman(state_t *state, const uint32_t tick)
 {
   // This function is called from the stabilizer loop. It is important that this call returns
-  // as quickly as possible. The dataMutex must only be locked short periods by the task.
-  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  // as quickly as possible, it never blocks on the task.
+
+  // Copy the latest state, calculated by the task. If all attempts are torn, the previous state is kept.
+  for (int attempt = 0; attempt < STATE_READ_ATTEMPTS; attempt++) {
+    if (attempt > 0) {
+      STATS_CNT_RATE_EVENT(&stateReadRetryCounter);
+    }
+
+    uint8_t index;
+    __atomic_load(&publishedStateBuffer, &index, __ATOMIC_SEQ_CST);
+    stateBuffer_t* buffer = &stateBuffers[index];
 
-  // Copy the latest state, calculated by the task
-  memcpy(state, &taskEstimatorState, sizeof(state_t));
-  xSemaphoreGive(dataMutex);
+    uint32_t sequenceBefore;
+    __atomic_load(&buffer->sequence, &sequenceBefore, __ATOMIC_SEQ_CST);
+    state_t copy;
+    memcpy(&copy, &buffer->state, sizeof(state_t));
+    uint32_t sequenceAfter;
+    __atomic_load(&buffer->sequence, &sequenceAfter, __ATOMIC_SEQ_CST);
+
+    if ((sequenceBefore & 1) == 0 && sequenceBefore == sequenceAfter) {
+      memcpy(state, &copy, sizeof(state_t));
+      break;
+    }
+
+    if (attempt == STATE_READ_ATTEMPTS - 1) {
+      STATS_CNT_RATE_EVENT(&stateReadTornCounter);
+    }
+  }
 
   xSemaphoreGive(runTaskSemaphore);
 }
 
+// Called from the task, writes the state to the unpublished buffer and publishes it
+static void publishState(const uint32_t osTick, const bool stateChanged) {
+  if (stateChanged || !externalStateValid) {
+    kalmanCoreExternalizeState(&coreData, &externalState, &accLatest, osTick);
+    externalStateValid = true;
+  } else {
+    kalmanCoreExternalizeAcc(&coreData, &externalState, &accLatest, osTick);
+  }
+
+  const uint8_t index = 1 - publishedStateBuffer;
+  stateBuffer_t* buffer = &stateBuffers[index];
+
+  __atomic_add_fetch(&buffer->sequence, 1, __ATOMIC_SEQ_CST);
+  memcpy(&buffer->state, &externalState, sizeof(state_t));
+  __atomic_add_fetch(&buffer->sequence, 1, __ATOMIC_SEQ_CST);
+
+  __atomic_store_n(&publishedStateBuffer, index, __ATOMIC_SEQ_CST);
+}
+
 static bool predictStateForward(uint32_t osTick, float dt) {
   if (gyroAccumulatorCount == 0
       || accAccumulatorCount == 0)
@@ -319,6 +577,9 @@ static bool predictStateForward(uint32_t osTick, float dt) {
   accAverage.y = accAccumulator.y * GRAVITY_MAGNITUDE / accAccumulatorCount;
   accAverage.z = accAccumulator.z * GRAVITY_MAGNITUDE / accAccumulatorCount;
 
+  imuGyroNorm = sqrtf(gyroAccumulator.x * gyroAccumulator.x + gyroAccumulator.y * gyroAccumulator.y + gyroAccumulator.z * gyroAccumulator.z) / gyroAccumulatorCount;
+  imuAccDeviation = fabsf(sqrtf(accAccumulator.x * accAccumulator.x + accAccumulator.y * accAccumulator.y + accAccumulator.z * accAccumulator.z) / accAccumulatorCount - 1.0f);
+
   // reset for next call
   accAccumulator = (Axis3f){.axis={0}};
   accAccumulatorCount = 0;
@@ -326,11 +587,94 @@ static bool predictStateForward(uint32_t osTick, float dt) {
   gyroAccumulatorCount = 0;
 
   quadIsFlying = supervisorIsFlying();
-  kalmanCorePredict(&coreData, &accAverage, &gyroAverage, dt, quadIsFlying);
+
+  // Store the state before the prediction to be able to replay it
+  historyEntry_t* entry = NULL;
+  if (historyIsRecording(osTick)) {
+    historyNewest = (historyNewest + 1) % KALMAN_HISTORY_LENGTH;
+    if (historyCount < KALMAN_HISTORY_LENGTH) {
+      historyCount++;
+    }
+    entry = &history[historyNewest];
+    entry->tick = osTick;
+    entry->dt = dt;
+    entry->acc = accAverage;
+    entry->gyro = gyroAverage;
+    entry->quadIsFlying = quadIsFlying;
+    entry->processNoiseCount = 0;
+    entry->processNoiseDt = 0.0f;
+    entry->imuDelta.dt = 0.0f;
+    memcpy(&entry->coreData, &coreData, sizeof(coreData));
+  }
+
+  if (imuPreintegration && imuDelta.dt > 0.0f) {
+    if (entry) {
+      entry->imuDelta = imuDelta;
+    }
+    kalmanCorePredictWithImuDelta(&coreData, &imuDelta, quadIsFlying);
+  } else {
+    kalmanCorePredict(&coreData, &accAverage, &gyroAverage, dt, quadIsFlying);
+  }
+  kalmanCoreImuDeltaReset(&imuDelta);
 
   return true;
 }
 
+static uint16_t selectPredictRate(const uint32_t osTick) {
+  uint16_t rate = predictRate;
+  if (rate == 0 || rate > RATE_MAIN_LOOP) {
+    rate = PREDICT_RATE;
+  }
+
+  if (!adaptivePredictRate) {
+    return rate;
+  }
+
+  if (imuGyroNorm > aggressiveGyroThreshold || imuAccDeviation > aggressiveAccThreshold) {
+    aggressiveHoldUntil = osTick + AGGRESSIVE_HOLD_TIME;
+  }
+
+  if (osTick < aggressiveHoldUntil) {
+    return PREDICT_RATE_MAX;
+  }
+
+  if (!quadIsFlying || (imuGyroNorm < HOVER_GYRO_THRESHOLD && imuAccDeviation < HOVER_ACC_THRESHOLD)) {
+    return PREDICT_RATE_MIN;
+  }
+
+  return rate;
+}
+
+static void supervisePredictRate(const uint32_t osTick) {
+  // The rate supervisor counts predictions per second
+  rateSupervisorInitRate(&rateSupervisorContext, T2M(osTick), activePredictRate, PREDICT_RATE_TOLERANCE, 1);
+}
+
+
+static void preintegrateImuSamples(const estimatorImuSamples_t* imu, const uint32_t tick) {
+  const float dt = estimatorImuDt(imu->gyroTimestamp, imuDeltaTimestamp, T2S(tick - imuDeltaTick), PREDICT_MAX_IMU_DT);
+  imuDeltaTimestamp = imu->gyroTimestamp;
+  imuDeltaTick = tick;
+
+  // gyro is in deg/sec and the accelerometer in Gs, the estimator requires rad/sec and ms^-2
+  const Axis3f gyro = {
+    .x = imu->gyroSum.x * DEG_TO_RAD / imu->gyroCount,
+    .y = imu->gyroSum.y * DEG_TO_RAD / imu->gyroCount,
+    .z = imu->gyroSum.z * DEG_TO_RAD / imu->gyroCount,
+  };
+
+  Axis3f acc = accLatest;
+  if (imu->accCount > 0) {
+    acc.x = imu->accSum.x / imu->accCount;
+    acc.y = imu->accSum.y / imu->accCount;
+    acc.z = imu->accSum.z / imu->accCount;
+  }
+  acc.x *= GRAVITY_MAGNITUDE;
+  acc.y *= GRAVITY_MAGNITUDE;
+  acc.z *= GRAVITY_MAGNITUDE;
+
+  kalmanCoreImuDeltaIntegrate(&imuDelta, &acc, &gyro, fminf(dt, PREDICT_MAX_IMU_DT), quadIsFlying);
+}
 
 static bool updateQueuedMeasurements(const uint32_t tick) {
   bool doneUpdate = false;
@@ -339,86 +683,322 @@ static bool updateQueuedMeasurements(const uint32_t tick) {
    * we therefore consume all measurements since the last loop, rather than accumulating
    */
 
+  // IMU samples are summed up outside of the measurement queues
+  estimatorImuSamples_t imu;
+  if (estimatorGetImuSamples(kalmanEstimator, &imu)) {
+    if (imu.gyroCount > 0) {
+      gyroAccumulator.x += imu.gyroSum.x;
+      gyroAccumulator.y += imu.gyroSum.y;
+      gyroAccumulator.z += imu.gyroSum.z;
+      gyroLatest = imu.gyroLatest;
+      gyroLatestTimestamp = imu.gyroTimestamp;
+      gyroAccumulatorCount += imu.gyroCount;
+    }
+    if (imu.accCount > 0) {
+      accAccumulator.x += imu.accSum.x;
+      accAccumulator.y += imu.accSum.y;
+      accAccumulator.z += imu.accSum.z;
+      accLatest = imu.accLatest;
+      accAccumulatorCount += imu.accCount;
+    }
+
+    if (imuPreintegration && imu.gyroCount > 0) {
+      preintegrateImuSamples(&imu, tick);
+    }
+  }
+
   // Pull the latest sensors values of interest; discard the rest
   measurement_t m;
-  while (estimatorDequeue(&m)) {
-    switch (m.type) {
-      case MeasurementTypeTDOA:
-        if(robustTdoa){
-          // robust KF update with TDOA measurements
-          kalmanCoreRobustUpdateWithTDOA(&coreData, &m.data.tdoa);
-        }else{
-          // standard KF update
-          kalmanCoreUpdateWithTDOA(&coreData, &m.data.tdoa);
-        }
-        doneUpdate = true;
-        break;
-      case MeasurementTypePosition:
-        kalmanCoreUpdateWithPosition(&coreData, &m.data.position);
-        doneUpdate = true;
-        break;
-      case MeasurementTypePose:
-        kalmanCoreUpdateWithPose(&coreData, &m.data.pose);
+  while (estimatorDequeue(kalmanEstimator, &m)) {
+    if (m.captureTick == 0 || m.captureTick > tick) {
+      m.captureTick = tick;
+    }
+    if (tick - m.captureTick > M2T(delayThreshold)) {
+      delayedSourceTick = tick;
+    } else {
+      m.captureTick = tick;
+    }
+
+    const bool isThrottled = throttleTypes & (1 << MeasurementTypeSweepAngle);
+    if (batchSweeps && !isThrottled && m.type == MeasurementTypeSweepAngle && m.captureTick == tick) {
+      memcpy(&pendingSweeps[pendingSweepCount], &m, sizeof(m));
+      pendingSweepCount++;
+      if (pendingSweepCount == KC_MAX_VECTOR_UPDATE_DIM && fusePendingSweeps(tick)) {
         doneUpdate = true;
-        break;
-      case MeasurementTypeDistance:
-        if(robustTwr){
-            // robust KF update with UWB TWR measurements
-            kalmanCoreRobustUpdateWithDistance(&coreData, &m.data.distance);
-        }else{
-            // standard KF update
-            kalmanCoreUpdateWithDistance(&coreData, &m.data.distance);
+      }
+      continue;
+    }
+
+    // Keep the time order, collected sweeps are fused before any other measurement
+    if (fusePendingSweeps(tick)) {
+      doneUpdate = true;
+    }
+
+    if (delayCompensation && historyFuseDelayedMeasurement(&m)) {
+      doneUpdate = true;
+    } else {
+      m.captureTick = tick;
+      if (fuseMeasurement(&m, &gyroLatest, tick)) {
+        if (historyIsRecording(tick)) {
+          historyLogMeasurement(&m);
         }
         doneUpdate = true;
-        break;
-      case MeasurementTypeTOF:
-        kalmanCoreUpdateWithTof(&coreData, &m.data.tof);
-        doneUpdate = true;
-        break;
-      case MeasurementTypeAbsoluteHeight:
-        kalmanCoreUpdateWithAbsoluteHeight(&coreData, &m.data.height);
-        doneUpdate = true;
-        break;
-      case MeasurementTypeFlow:
-        kalmanCoreUpdateWithFlow(&coreData, &m.data.flow, &gyroLatest);
-        doneUpdate = true;
-        break;
-      case MeasurementTypeYawError:
-        kalmanCoreUpdateWithYawError(&coreData, &m.data.yawError);
-        doneUpdate = true;
-        break;
-      case MeasurementTypeSweepAngle:
-        kalmanCoreUpdateWithSweepAngles(&coreData, &m.data.sweepAngle, tick, &sweepOutlierFilterState);
-        doneUpdate = true;
-        break;
-      case MeasurementTypeGyroscope:
-        gyroAccumulator.x += m.data.gyroscope.gyro.x;
-        gyroAccumulator.y += m.data.gyroscope.gyro.y;
-        gyroAccumulator.z += m.data.gyroscope.gyro.z;
-        gyroLatest = m.data.gyroscope.gyro;
-        gyroAccumulatorCount++;
-        break;
-      case MeasurementTypeAcceleration:
-        accAccumulator.x += m.data.acceleration.acc.x;
-        accAccumulator.y += m.data.acceleration.acc.y;
-        accAccumulator.z += m.data.acceleration.acc.z;
-        accLatest = m.data.acceleration.acc;
-        accAccumulatorCount++;
-        break;
-      case MeasurementTypeBarometer:
-        if (useBaroUpdate) {
-          kalmanCoreUpdateWithBaro(&coreData, m.data.barometer.baro.asl, quadIsFlying);
-          doneUpdate = true;
-        }
-        break;
-      default:
-        break;
+      }
     }
   }
 
+  if (fusePendingSweeps(tick)) {
+    doneUpdate = true;
+  }
+  fusePendingTof();
+
   return doneUpdate;
 }
 
+static void selectUpdateThrottle(const MeasurementType type) {
+  coreData.updateThrottle = NULL;
+  if (throttleTypes & (1 << type)) {
+    kalmanCoreUpdateThrottle_t* throttle = &updateThrottles[type];
+    throttle->minVarianceRatio = throttleVarianceRatio;
+    throttle->keepEvery = throttleKeepEvery;
+    coreData.updateThrottle = throttle;
+  }
+}
+
+// Fuses the collected sweep angles in vector updates. Returns true if there were any.
+static bool fusePendingSweeps(const uint32_t tick) {
+  if (pendingSweepCount == 0) {
+    return false;
+  }
+
+  sweepAngleMeasurement_t* sweeps[KC_MAX_VECTOR_UPDATE_DIM];
+  for (int i = 0; i < pendingSweepCount; i++) {
+    sweeps[i] = &pendingSweeps[i].data.sweepAngle;
+  }
+
+  coreData.updateThrottle = NULL;
+  kalmanCoreUpdateWithSweepAngleBatch(&coreData, sweeps, pendingSweepCount, tick, &sweepOutlierFilterState);
+
+  if (historyIsRecording(tick)) {
+    for (int i = 0; i < pendingSweepCount; i++) {
+      historyLogMeasurement(&pendingSweeps[i]);
+    }
+  }
+
+  pendingSweepCount = 0;
+  return true;
+}
+
+// Fuses a held back TOF measurement that was not combined with a flow measurement
+static void fusePendingTof() {
+  if (hasPendingTof) {
+    hasPendingTof = false;
+    selectUpdateThrottle(MeasurementTypeTOF);
+    kalmanCoreUpdateWithTof(&coreData, &pendingTof);
+  }
+}
+
+// Fuse one measurement in the filter. Returns true if the state was updated.
+static bool fuseMeasurement(const measurement_t *m, const Axis3f* gyro, const uint32_t tick) {
+  // The measurement models take non-const pointers, the data is not modified though
+  measurement_t* mm = (measurement_t*)m;
+
+  selectUpdateThrottle(m->type);
+
+  switch (m->type) {
+    case MeasurementTypeTDOA:
+      if(robustTdoa){
+        // robust KF update with TDOA measurements
+        kalmanCoreRobustUpdateWithTDOA(&coreData, &mm->data.tdoa);
+      }else{
+        // standard KF update
+        kalmanCoreUpdateWithTDOA(&coreData, &mm->data.tdoa);
+      }
+      return true;
+    case MeasurementTypeTDOABatch:
+      if(robustTdoa){
+        // the robust update does not support batches, fuse the measurements one by one
+        for (int i = 0; i < m->data.tdoaBatch.count; i++) {
+          tdoaMeasurement_t tdoa;
+          kalmanCoreTdoaBatchGetMeasurement(&m->data.tdoaBatch, i, &tdoa);
+          kalmanCoreRobustUpdateWithTDOA(&coreData, &tdoa);
+        }
+      }else{
+        kalmanCoreUpdateWithTDOABatch(&coreData, &mm->data.tdoaBatch);
+      }
+      return true;
+    case MeasurementTypePosition:
+      kalmanCoreUpdateWithPosition(&coreData, &mm->data.position);
+      return true;
+    case MeasurementTypePose:
+      kalmanCoreUpdateWithPose(&coreData, &mm->data.pose);
+      return true;
+    case MeasurementTypeDistance:
+      if(robustTwr){
+          // robust KF update with UWB TWR measurements
+          kalmanCoreRobustUpdateWithDistance(&coreData, &mm->data.distance);
+      }else{
+          // standard KF update
+          kalmanCoreUpdateWithDistance(&coreData, &mm->data.distance);
+      }
+      return true;
+    case MeasurementTypeTOF:
+      if (combineFlowAndTof) {
+        fusePendingTof();
+        pendingTof = m->data.tof;
+        hasPendingTof = true;
+      } else {
+        kalmanCoreUpdateWithTof(&coreData, &mm->data.tof);
+      }
+      return true;
+    case MeasurementTypeAbsoluteHeight:
+      kalmanCoreUpdateWithAbsoluteHeight(&coreData, &mm->data.height);
+      return true;
+    case MeasurementTypeFlow:
+      if (hasPendingTof) {
+        hasPendingTof = false;
+        kalmanCoreUpdateWithFlowAndTof(&coreData, &mm->data.flow, gyro, &pendingTof);
+      } else {
+        kalmanCoreUpdateWithFlow(&coreData, &mm->data.flow, gyro);
+      }
+      return true;
+    case MeasurementTypeYawError:
+      kalmanCoreUpdateWithYawError(&coreData, &mm->data.yawError);
+      return true;
+    case MeasurementTypeSweepAngle:
+      kalmanCoreUpdateWithSweepAngles(&coreData, &mm->data.sweepAngle, tick, &sweepOutlierFilterState);
+      return true;
+    case MeasurementTypeBarometer:
+      if (useBaroUpdate) {
+        kalmanCoreUpdateWithBaro(&coreData, m->data.barometer.baro.asl, quadIsFlying);
+        return true;
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+static void historyReset() {
+  historyNewest = 0;
+  historyCount = 0;
+  measurementLogNext = 0;
+  measurementLogCount = 0;
+  measurementLogEvictedTick = 0;
+}
+
+// The history is only kept while there is a source of delayed measurements, it is dropped when it goes quiet
+static bool historyIsRecording(const uint32_t tick) {
+  if (!delayCompensation || delayedSourceTick == 0 || tick - delayedSourceTick > DELAYED_SOURCE_TIMEOUT) {
+    if (historyCount > 0 || measurementLogCount > 0) {
+      historyReset();
+    }
+    return false;
+  }
+  return true;
+}
+
+// Process noise is added every loop, keep track of it to be able to replay it
+static void historyAddProcessNoise(float dt) {
+  if (historyCount > 0) {
+    history[historyNewest].processNoiseCount++;
+    history[historyNewest].processNoiseDt += dt;
+  }
+}
+
+static void historyLogMeasurement(const measurement_t *m) {
+  if (measurementLogCount == KALMAN_HISTORY_MEASUREMENTS) {
+    const uint32_t evictedTick = measurementLog[measurementLogNext].captureTick;
+    if (evictedTick > measurementLogEvictedTick) {
+      measurementLogEvictedTick = evictedTick;
+    }
+  } else {
+    measurementLogCount++;
+  }
+
+  memcpy(&measurementLog[measurementLogNext], m, sizeof(measurement_t));
+  measurementLogNext = (measurementLogNext + 1) % KALMAN_HISTORY_MEASUREMENTS;
+}
+
+// Rewind the filter to the capture tick of the measurement and replay, returns false if the measurement
+// is not delayed or too old for the history.
+static bool historyFuseDelayedMeasurement(const measurement_t *m) {
+  if (historyCount == 0 || m->captureTick >= history[historyNewest].tick) {
+    // Not delayed
+    return false;
+  }
+
+  // Find the latest prediction before the capture
+  int start = -1;
+  for (int i = 0; i < historyCount; i++) {
+    const int index = (historyNewest - i + KALMAN_HISTORY_LENGTH) % KALMAN_HISTORY_LENGTH;
+    if (history[index].tick <= m->captureTick) {
+      start = index;
+      break;
+    }
+  }
+
+  // The replay must have access to all measurements fused after the start of the replay, also the
+  // measurement that will be evicted from the log when the delayed measurement is added
+  uint32_t evictedTick = measurementLogEvictedTick;
+  if (measurementLogCount == KALMAN_HISTORY_MEASUREMENTS && measurementLog[measurementLogNext].captureTick > evictedTick) {
+    evictedTick = measurementLog[measurementLogNext].captureTick;
+  }
+
+  if (start < 0 || evictedTick >= history[start].tick) {
+    STATS_CNT_RATE_EVENT(&delayedTooOldCounter);
+    return false;
+  }
+
+  historyLogMeasurement(m);
+
+  // A held back TOF measurement is in the log, the replay fuses it
+  hasPendingTof = false;
+
+  const bool resetEstimation = coreData.resetEstimation;
+  memcpy(&coreData, &history[start].coreData, sizeof(coreData));
+  coreData.resetEstimation = resetEstimation;
+
+  int index = start;
+  while (true) {
+    historyEntry_t* entry = &history[index];
+    const bool isNewest = (index == historyNewest);
+    const int next = (index + 1) % KALMAN_HISTORY_LENGTH;
+    const uint32_t endTick = isNewest ? UINT32_MAX : history[next].tick;
+
+    memcpy(&entry->coreData, &coreData, sizeof(coreData));
+    if (entry->imuDelta.dt > 0.0f) {
+      kalmanCorePredictWithImuDelta(&coreData, &entry->imuDelta, entry->quadIsFlying);
+    } else {
+      kalmanCorePredict(&coreData, &entry->acc, &entry->gyro, entry->dt, entry->quadIsFlying);
+    }
+    for (int i = 0; i < entry->processNoiseCount; i++) {
+      kalmanCoreAddProcessNoise(&coreData, entry->processNoiseDt / entry->processNoiseCount);
+    }
+
+    // The flow model expects deg/s
+    const Axis3f gyro = {.x = entry->gyro.x * RAD_TO_DEG, .y = entry->gyro.y * RAD_TO_DEG, .z = entry->gyro.z * RAD_TO_DEG};
+    for (int i = 0; i < measurementLogCount; i++) {
+      const int logIndex = (measurementLogNext - measurementLogCount + i + KALMAN_HISTORY_MEASUREMENTS) % KALMAN_HISTORY_MEASUREMENTS;
+      const measurement_t* logged = &measurementLog[logIndex];
+      if (logged->captureTick >= entry->tick && logged->captureTick < endTick) {
+        fuseMeasurement(logged, &gyro, logged->captureTick);
+      }
+    }
+    fusePendingTof();
+
+    kalmanCoreFinalize(&coreData, entry->tick);
+
+    if (isNewest) {
+      break;
+    }
+    index = next;
+  }
+
+  STATS_CNT_RATE_EVENT(&delayedReplayCounter);
+  return true;
+}
+
 // Called when this estimator is activated
 void estimatorKalmanInit(void)
 {
@@ -427,9 +1007,16 @@ void estimatorKalmanInit(void)
 
   accAccumulatorCount = 0;
   gyroAccumulatorCount = 0;
+  kalmanCoreImuDeltaReset(&imuDelta);
+  imuDeltaTimestamp = 0;
+  hasPendingTof = false;
+  pendingSweepCount = 0;
   outlierFilterReset(&sweepOutlierFilterState, 0);
 
-  kalmanCoreInit(&coreData);
+  kalmanCoreInit(&coreData, &coreWorkspace);
+  historyReset();
+  delayedSourceTick = 0;
+  externalStateValid = false;
 }
 
 bool estimatorKalmanTest(void)
@@ -474,17 +1061,46 @@ LOG_GROUP_START(kalman)
   LOG_ADD(LOG_FLOAT, q3, &coreData.q[3])
 
   STATS_CNT_RATE_LOG_ADD(rtUpdate, &updateCounter)
+  LOG_ADD(LOG_UINT32, thrTdoa, &updateThrottles[MeasurementTypeTDOA].skipped)
+  LOG_ADD(LOG_UINT32, thrDist, &updateThrottles[MeasurementTypeDistance].skipped)
+  LOG_ADD(LOG_UINT32, thrSweep, &updateThrottles[MeasurementTypeSweepAngle].skipped)
+  LOG_ADD(LOG_UINT32, thrFlow, &updateThrottles[MeasurementTypeFlow].skipped)
   STATS_CNT_RATE_LOG_ADD(rtPred, &predictionCounter)
   STATS_CNT_RATE_LOG_ADD(rtFinal, &finalizeCounter)
+  STATS_CNT_RATE_LOG_ADD(rtDelayed, &delayedReplayCounter)
+  STATS_CNT_RATE_LOG_ADD(rtTooOld, &delayedTooOldCounter)
+  STATS_CNT_RATE_LOG_ADD(rtStRetry, &stateReadRetryCounter)
+  STATS_CNT_RATE_LOG_ADD(rtStTorn, &stateReadTornCounter)
+  LOG_ADD(LOG_UINT16, predRate, &activePredictRate)
+  LOG_ADD(LOG_UINT16, usPred, &predictTimeUs)
+  LOG_ADD(LOG_UINT16, usUpd, &updateTimeUs)
+  LOG_ADD(LOG_UINT16, usFinal, &finalizeTimeUs)
 LOG_GROUP_STOP(kalman)
 
 LOG_GROUP_START(outlierf)
   LOG_ADD(LOG_INT32, lhWin, &sweepOutlierFilterState.openingWindow)
 LOG_GROUP_STOP(outlierf)
 
+/**
+ * Rate of the Kalman prediction, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateKalman, rateSupervisorContext)
+
 PARAM_GROUP_START(kalman)
   PARAM_ADD(PARAM_UINT8, resetEstimation, &coreData.resetEstimation)
   PARAM_ADD(PARAM_UINT8, quadIsFlying, &quadIsFlying)
   PARAM_ADD(PARAM_UINT8, robustTdoa, &robustTdoa)
   PARAM_ADD(PARAM_UINT8, robustTwr, &robustTwr)
+  PARAM_ADD(PARAM_UINT8, delayComp, &delayCompensation)
+  PARAM_ADD(PARAM_UINT16, delayThr, &delayThreshold)
+  PARAM_ADD(PARAM_UINT16, predRate, &predictRate)
+  PARAM_ADD(PARAM_UINT8, predAdapt, &adaptivePredictRate)
+  PARAM_ADD(PARAM_FLOAT, adaptGyro, &aggressiveGyroThreshold)
+  PARAM_ADD(PARAM_FLOAT, adaptAcc, &aggressiveAccThreshold)
+  PARAM_ADD(PARAM_UINT8, imuPreint, &imuPreintegration)
+  PARAM_ADD(PARAM_UINT16, thrTypes, &throttleTypes)
+  PARAM_ADD(PARAM_FLOAT, thrRatio, &throttleVarianceRatio)
+  PARAM_ADD(PARAM_UINT8, thrKeep, &throttleKeepEvery)
+  PARAM_ADD(PARAM_UINT8, flowTof, &combineFlowAndTof)
+  PARAM_ADD(PARAM_UINT8, batchSweeps, &batchSweeps)
 PARAM_GROUP_STOP(kalman)
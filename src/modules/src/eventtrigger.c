@@ -27,14 +27,88 @@
 
 #include "eventtrigger.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "config.h"
 #include "debug.h"
+#include "crtp.h"
+#include "usec_time.h"
+#include "static_mem.h"
+#include "log.h"
+#include "param.h"
+
+/**
+ * Fired events are staged in a lock-free ring of records and dispatched to the
+ * subscribers from the event trigger task. The ring is a bounded multi producer,
+ * single consumer queue: a producer claims a slot by advancing the head with a
+ * compare and swap, copies the payload and publishes the slot by setting its
+ * sequence number. Events can be fired from any task or interrupt, a full ring
+ * drops the event.
+ */
+#define STAGING_LENGTH 64
+#define STAGING_MASK (STAGING_LENGTH - 1)
+#define DISPATCH_PERIOD M2T(5)
+
+// Number of event ids that can be streamed over CRTP at the same time
+#define CRTP_STREAM_COUNT 4
+#define CRTP_STREAM_NONE 0xffff
+
+typedef struct {
+  volatile uint32_t sequence;
+  uint8_t handlers;
+  eventtriggerRecord record;
+} stagingSlot_t;
 
 static eventtriggerCallback callbacks[eventtriggerHandler_Count] = {0};
 
+// Bit mask of the subscribed handlers, per event id
+static uint8_t subscriptions[EVENTTRIGGER_MAX_EVENTS];
+
+NO_DMA_CCM_SAFE_ZERO_INIT static stagingSlot_t staging[STAGING_LENGTH];
+static uint32_t stagingHead;
+static uint32_t stagingTail;
+
+static bool isInit = false;
+
+// Statistics
+static uint32_t stagedCount;
+static uint32_t droppedCount;
+static uint32_t crtpDroppedCount;
+
+static uint16_t crtpStreams[CRTP_STREAM_COUNT] = {
+  [0 ... CRTP_STREAM_COUNT - 1] = CRTP_STREAM_NONE,
+};
+
+STATIC_MEM_TASK_ALLOC(eventtriggerTask, EVENTTRIGGER_TASK_STACKSIZE);
+static void eventtriggerTask(void *param);
+static void crtpEventtriggerCallback(const eventtriggerRecord *record);
+
 /* Symbols set by the linker script */
 extern eventtrigger _eventtrigger_start;
 extern eventtrigger _eventtrigger_stop;
 
+void eventtriggerInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  int numEventtriggers = &_eventtrigger_stop - &_eventtrigger_start;
+  if (numEventtriggers > EVENTTRIGGER_MAX_EVENTS) {
+    DEBUG_PRINT("Only the first %d of %d event triggers can be subscribed to\n", EVENTTRIGGER_MAX_EVENTS, numEventtriggers);
+  }
+
+  for (uint32_t i = 0; i < STAGING_LENGTH; i++) {
+    staging[i].sequence = i;
+  }
+
+  eventtriggerRegisterCallback(eventtriggerHandler_Crtp, crtpEventtriggerCallback);
+
+  STATIC_MEM_TASK_CREATE(eventtriggerTask, eventtriggerTask, EVENTTRIGGER_TASK_NAME, NULL, EVENTTRIGGER_TASK_PRI);
+  isInit = true;
+}
+
 uint16_t eventtriggerGetId(const eventtrigger *event)
 {
     // const eventtrigger* start = &_eventtrigger_start;
@@ -66,14 +140,145 @@ const eventtrigger* eventtriggerGetByName(const char *name)
 
 void eventTrigger(const eventtrigger *event)
 {
-    for (int i = 0; i < eventtriggerHandler_Count; ++i) {
-        if (callbacks[i]) {
-            callbacks[i](event);
+    const uint16_t id = eventtriggerGetId(event);
+    if (id >= EVENTTRIGGER_MAX_EVENTS || subscriptions[id] == 0) {
+        return;
+    }
+
+    // Claim a slot
+    uint32_t pos = __atomic_load_n(&stagingHead, __ATOMIC_RELAXED);
+    stagingSlot_t *slot;
+    while (1) {
+        slot = &staging[pos & STAGING_MASK];
+        const int32_t diff = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&stagingHead, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The ring is full
+            __atomic_fetch_add(&droppedCount, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&stagingHead, __ATOMIC_RELAXED);
         }
     }
+
+    slot->handlers = subscriptions[id];
+    slot->record.timestamp = usecTimestamp();
+    slot->record.id = id;
+    slot->record.payloadSize = event->payloadSize;
+    memcpy(slot->record.payload, event->payload, event->payloadSize);
+
+    // Publish the slot
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
 }
 
 void eventtriggerRegisterCallback(enum eventtriggerHandler_e handler, eventtriggerCallback cb)
 {
     callbacks[handler] = cb;
 }
+
+void eventtriggerSubscribe(enum eventtriggerHandler_e handler, uint16_t id, bool enable)
+{
+    if (id >= EVENTTRIGGER_MAX_EVENTS) {
+        return;
+    }
+
+    if (enable) {
+        __atomic_fetch_or(&subscriptions[id], 1 << handler, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&subscriptions[id], ~(1 << handler), __ATOMIC_RELAXED);
+    }
+}
+
+static void dispatch(const stagingSlot_t *slot)
+{
+    for (int i = 0; i < eventtriggerHandler_Count; ++i) {
+        if ((slot->handlers & (1 << i)) && callbacks[i]) {
+            callbacks[i](&slot->record);
+        }
+    }
+}
+
+static void eventtriggerTask(void *param)
+{
+    TickType_t lastWakeTime = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&lastWakeTime, DISPATCH_PERIOD);
+
+        while (1) {
+            stagingSlot_t *slot = &staging[stagingTail & STAGING_MASK];
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != stagingTail + 1) {
+                // Empty, or the next slot is still being written
+                break;
+            }
+
+            dispatch(slot);
+
+            // Hand the slot back to the producers
+            __atomic_store_n(&slot->sequence, stagingTail + STAGING_LENGTH, __ATOMIC_RELEASE);
+            stagingTail++;
+            stagedCount++;
+        }
+    }
+}
+
+static void crtpEventtriggerCallback(const eventtriggerRecord *record)
+{
+    CRTPPacket packet;
+
+    packet.header = CRTP_HEADER(CRTP_PORT_EVENTTRIGGER, 0);
+    memcpy(&packet.data[0], &record->id, 2);
+    const uint32_t timestamp = record->timestamp;
+    memcpy(&packet.data[2], &timestamp, 4);
+    memcpy(&packet.data[6], record->payload, record->payloadSize);
+    packet.size = 6 + record->payloadSize;
+
+    if (crtpSendPacket(&packet) != pdTRUE) {
+        crtpDroppedCount++;
+    }
+}
+
+static void crtpStreamsChanged(void)
+{
+    for (uint16_t id = 0; id < EVENTTRIGGER_MAX_EVENTS; id++) {
+        bool enable = false;
+        for (int i = 0; i < CRTP_STREAM_COUNT; i++) {
+            enable |= (crtpStreams[i] == id);
+        }
+        eventtriggerSubscribe(eventtriggerHandler_Crtp, id, enable);
+    }
+}
+
+/**
+ * Statistics of the event trigger staging and dispatch
+ */
+LOG_GROUP_START(eventtrig)
+/**
+ * @brief Number of events dispatched to the subscribers
+ */
+LOG_ADD(LOG_UINT32, dispatched, &stagedCount)
+/**
+ * @brief Number of events dropped because the staging ring was full
+ */
+LOG_ADD(LOG_UINT32, dropped, &droppedCount)
+/**
+ * @brief Number of events that could not be streamed because the CRTP queue was full
+ */
+LOG_ADD(LOG_UINT32, crtpDrop, &crtpDroppedCount)
+LOG_GROUP_STOP(eventtrig)
+
+/**
+ * Streaming of events over CRTP
+ */
+PARAM_GROUP_START(eventtrig)
+/**
+ * @brief Ids of the events that are streamed over CRTP (0xffff for none)
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT16, stream0, &crtpStreams[0], crtpStreamsChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT16, stream1, &crtpStreams[1], crtpStreamsChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT16, stream2, &crtpStreams[2], crtpStreamsChanged)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT16, stream3, &crtpStreams[3], crtpStreamsChanged)
+PARAM_GROUP_STOP(eventtrig)
@@ -47,7 +47,10 @@
 #define ENABLE_EXTRX_LOG
 
 
-#define EXTRX_NR_CHANNELS  8
+#define EXTRX_NR_CHANNELS  CPPM_MAX_CHANNELS
+
+// Frames older than this when processed are not used as setpoints
+#define EXTRX_MAX_FRAME_AGE_MS  50
 
 #define EXTRX_CH_TRUST     2
 #define EXTRX_CH_ROLL      0
@@ -64,6 +67,7 @@
 
 static setpoint_t extrxSetpoint;
 static uint16_t ch[EXTRX_NR_CHANNELS];
+static uint32_t staleFrames;
 
 static void extRxTask(void *param);
 static void extRxDecodeCppm(void);
@@ -112,24 +116,21 @@ static void extRxDecodeChannels(void)
 
 static void extRxDecodeCppm(void)
 {
-  uint16_t ppm;
-  static uint8_t currChannel = 0;
+  cppmFrame_t frame;
 
-  if (cppmGetTimestamp(&ppm) == pdTRUE)
+  if (cppmGetFrame(&frame, portMAX_DELAY) == pdTRUE)
   {
-    if (cppmIsAvailible() && ppm < 2100)
+    if (xTaskGetTickCount() - frame.timestamp > M2T(EXTRX_MAX_FRAME_AGE_MS))
     {
-      if (currChannel < EXTRX_NR_CHANNELS)
-      {
-        ch[currChannel] = ppm;
-      }
-      currChannel++;
+      staleFrames++;
+      return;
     }
-    else
+
+    for (int i = 0; i < frame.count; i++)
     {
-      extRxDecodeChannels();
-      currChannel = 0;
+      ch[i] = frame.channels[i];
     }
+    extRxDecodeChannels();
   }
 }
 
@@ -186,5 +187,6 @@ LOG_ADD(LOG_UINT16, thrust, &extrxSetpoint.thrust)
 LOG_ADD(LOG_FLOAT, roll, &extrxSetpoint.attitude.roll)
 LOG_ADD(LOG_FLOAT, pitch, &extrxSetpoint.attitude.pitch)
 LOG_ADD(LOG_FLOAT, yaw, &extrxSetpoint.attitude.yaw)
+LOG_ADD(LOG_UINT32, stale, &staleFrames)
 LOG_GROUP_STOP(extrx)
 #endif
@@ -0,0 +1,180 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * isr_profiler.c - Opt-in profiling of interrupt service routines
+ *
+ * The entry and exit of the profiled ISRs are time stamped with the DWT cycle
+ * counter. The time of an ISR excludes the time of the ISRs that preempted it,
+ * so that the cost of each vector is counted once. The statistics are read
+ * through the memory subsystem (MEM_TYPE_ISR_PROFILE).
+ */
+#include "isr_profiler.h"
+
+#ifdef ISR_PROFILER
+
+#include <string.h>
+
+#include "stm32fxxx.h"
+#include "mem.h"
+#include "log.h"
+
+#define ISR_PROFILER_VERSION 1
+#define ISR_PROFILER_BINS 8
+#define ISR_PROFILER_MAX_NESTING 16
+
+// Durations in cycles. Bin 0 counts the runs shorter than 1 us, bin n the runs
+// from 2^(n-1) us up to 2^n us, the last bin all longer runs.
+typedef struct {
+  uint32_t count;
+  uint32_t cycles;
+  uint32_t maxCycles;
+  uint16_t bins[ISR_PROFILER_BINS];
+  uint8_t maxNesting;
+  uint8_t reserved[3];
+} __attribute__((packed)) isrProfilerEntry_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t vectorCount;
+  uint8_t entrySize;
+  uint8_t reserved;
+  uint32_t cyclesPerUs;
+  isrProfilerEntry_t entries[isrProfilerCount];
+} __attribute__((packed)) isrProfilerTable_t;
+
+static isrProfilerTable_t table;
+
+static uint32_t startCycles[isrProfilerCount];
+
+// The cycles of the ISRs that preempted the ISR at each nesting level
+static uint32_t preemptedCycles[ISR_PROFILER_MAX_NESTING + 1];
+static uint8_t nesting;
+
+// Sum of the cycles of all vectors
+static uint32_t totalCycles;
+
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_ISR_PROFILE,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+void isrProfilerInit(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  table.version = ISR_PROFILER_VERSION;
+  table.vectorCount = isrProfilerCount;
+  table.entrySize = sizeof(isrProfilerEntry_t);
+  table.cyclesPerUs = SystemCoreClock / 1000000;
+
+  memoryRegisterHandler(&memDef);
+}
+
+void isrProfilerEnter(const isrProfilerVector_t vector)
+{
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (nesting < ISR_PROFILER_MAX_NESTING) {
+    nesting++;
+  }
+  preemptedCycles[nesting] = 0;
+
+  isrProfilerEntry_t* entry = &table.entries[vector];
+  if (nesting > entry->maxNesting) {
+    entry->maxNesting = nesting;
+  }
+
+  startCycles[vector] = DWT->CYCCNT;
+
+  __set_PRIMASK(primask);
+}
+
+void isrProfilerExit(const isrProfilerVector_t vector)
+{
+  const uint32_t now = DWT->CYCCNT;
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  const uint32_t elapsed = now - startCycles[vector];
+  const uint32_t cycles = elapsed - preemptedCycles[nesting];
+  if (nesting > 0) {
+    nesting--;
+  }
+  preemptedCycles[nesting] += elapsed;
+
+  isrProfilerEntry_t* entry = &table.entries[vector];
+  entry->count++;
+  entry->cycles += cycles;
+  if (cycles > entry->maxCycles) {
+    entry->maxCycles = cycles;
+  }
+
+  const uint32_t us = table.cyclesPerUs ? cycles / table.cyclesPerUs : 0;
+  int bin = 32 - __CLZ(us);
+  if (bin >= ISR_PROFILER_BINS) {
+    bin = ISR_PROFILER_BINS - 1;
+  }
+  if (entry->bins[bin] < UINT16_MAX) {
+    entry->bins[bin]++;
+  }
+
+  totalCycles += cycles;
+
+  __set_PRIMASK(primask);
+}
+
+static uint32_t handleMemGetSize(void)
+{
+  return sizeof(table);
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest)
+{
+  if (memAddr > sizeof(table) || readLen > sizeof(table) - memAddr) {
+    return false;
+  }
+
+  __disable_irq();
+  memcpy(dest, ((uint8_t*)&table) + memAddr, readLen);
+  __enable_irq();
+
+  return true;
+}
+
+/**
+ * Interrupt profiling, see MEM_TYPE_ISR_PROFILE for the statistics of each vector
+ */
+LOG_GROUP_START(isrProf)
+/**
+ * @brief Cycles spent in the profiled ISRs, wraps around
+ */
+LOG_ADD(LOG_UINT32, cycles, &totalCycles)
+LOG_GROUP_STOP(isrProf)
+
+#endif // ISR_PROFILER
@@ -62,8 +62,10 @@
 
 #include "param.h"
 #include "math3d.h"
+#include "fastmath.h"
 #include "debug.h"
 #include "static_mem.h"
+#include "quatcompress.h"
 
 #include "lighthouse_calibration.h"
 // #define DEBUG_STATE_CHECK
@@ -99,15 +101,7 @@ static void assertStateNotNaN(const kalmanCoreData_t* this) {
     ASSERT(false);
   }
 
-  for(int i=0; i<KC_STATE_DIM; i++) {
-    for(int j=0; j<KC_STATE_DIM; j++)
-    {
-      if (isnan(this->P[i][j]))
-      {
-        ASSERT(false);
-      }
-    }
-  }
+  // The covariance matrix is checked in kalmanCoreCovarianceHealthCheck()
 }
 #else
 static void assertStateNotNaN(const kalmanCoreData_t* this)
@@ -121,6 +115,19 @@ static void assertStateNotNaN(const kalmanCoreData_t* this)
 #define MAX_COVARIANCE (100)
 #define MIN_COVARIANCE (1e-6f)
 
+// Stores a bounded covariance element in both triangles of P. The lower bound only applies to the diagonal.
+// The update kernels compute the upper triangle and store it through this, so that P stays symmetric and
+// bounded without separate passes over the matrix.
+static inline void storeCovariance(kalmanCoreData_t* this, int i, int j, float p)
+{
+  if (isnan(p) || p > MAX_COVARIANCE) {
+    p = MAX_COVARIANCE;
+  } else if (i == j && p < MIN_COVARIANCE) {
+    p = MIN_COVARIANCE;
+  }
+  this->P[i][j] = this->P[j][i] = p;
+}
+
 // Initial variances, uncertain of position, but know we're stationary and roughly flat
 static const float stdDevInitialPosition_xy = 100;
 static const float stdDevInitialPosition_z = 1;
@@ -152,9 +159,10 @@ static float initialYaw = 0.0;
 static float initialQuaternion[4] = {0.0, 0.0, 0.0, 0.0};
 
 
-void kalmanCoreInit(kalmanCoreData_t* this) {
+void kalmanCoreInit(kalmanCoreData_t* this, kalmanCoreWorkspace_t* workspace) {
   // Reset all data to 0 (like upon system reset)
   memset(this, 0, sizeof(kalmanCoreData_t));
+  this->workspace = workspace;
 
   this->S[KC_STATE_X] = initialX;
   this->S[KC_STATE_Y] = initialY;
@@ -204,42 +212,119 @@ void kalmanCoreInit(kalmanCoreData_t* this) {
   this->baroReferenceHeight = 0.0;
 }
 
+static bool sparseScalarUpdate(kalmanCoreData_t* this, const uint8_t *hIndex, const float *hValue, int hCount, float error, float stdMeasNoise, float maxMahalanobisDistance);
+
+// Most H vectors only have a few non-zero elements, collect them and use the sparse implementation
+static int collectNonZero(const arm_matrix_instance_f32 *Hm, uint8_t hIndex[KC_STATE_DIM], float hValue[KC_STATE_DIM])
+{
+  ASSERT(Hm->numRows == 1);
+  ASSERT(Hm->numCols == KC_STATE_DIM);
+
+  int hCount = 0;
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    if (Hm->pData[i] != 0.0f) {
+      hIndex[hCount] = i;
+      hValue[hCount] = Hm->pData[i];
+      hCount++;
+    }
+  }
+
+  return hCount;
+}
+
 void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise)
 {
-  // The Kalman gain as a column vector
-  NO_DMA_CCM_SAFE_ZERO_INIT static float K[KC_STATE_DIM];
-  static arm_matrix_instance_f32 Km = {KC_STATE_DIM, 1, (float *)K};
+  uint8_t hIndex[KC_STATE_DIM];
+  float hValue[KC_STATE_DIM];
+  const int hCount = collectNonZero(Hm, hIndex, hValue);
 
-  // Temporary matrices for the covariance updates
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
+  sparseScalarUpdate(this, hIndex, hValue, hCount, error, stdMeasNoise, 0.0f);
+}
 
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN2m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
+bool kalmanCoreScalarUpdateGated(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise, float maxMahalanobisDistance)
+{
+  uint8_t hIndex[KC_STATE_DIM];
+  float hValue[KC_STATE_DIM];
+  const int hCount = collectNonZero(Hm, hIndex, hValue);
 
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN3d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN3m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN3d};
+  return sparseScalarUpdate(this, hIndex, hValue, hCount, error, stdMeasNoise, maxMahalanobisDistance);
+}
 
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float HTd[KC_STATE_DIM * 1];
-  static arm_matrix_instance_f32 HTm = {KC_STATE_DIM, 1, HTd};
+void kalmanCoreSparseScalarUpdate(kalmanCoreData_t* this, const uint8_t *hIndex, const float *hValue, int hCount, float error, float stdMeasNoise)
+{
+  sparseScalarUpdate(this, hIndex, hValue, hCount, error, stdMeasNoise, 0.0f);
+}
 
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float PHTd[KC_STATE_DIM * 1];
-  static arm_matrix_instance_f32 PHTm = {KC_STATE_DIM, 1, PHTd};
+void kalmanCoreStateUpdate(kalmanCoreData_t* this, kalmanCoreStateIdx_t state, float error, float stdMeasNoise)
+{
+  const uint8_t hIndex[1] = {state};
+  const float hValue[1] = {1.0f};
+  sparseScalarUpdate(this, hIndex, hValue, 1, error, stdMeasNoise, 0.0f);
+}
 
-  ASSERT(Hm->numRows == 1);
-  ASSERT(Hm->numCols == KC_STATE_DIM);
+// Cheap estimate of whether a measurement is redundant, HPH' is approximated with the diagonal of P
+static bool isRedundantMeasurement(const kalmanCoreData_t* this, const uint8_t *hIndex, const float *hValue, int hCount, float R)
+{
+  const kalmanCoreUpdateThrottle_t* throttle = this->updateThrottle;
+  if (throttle == NULL || throttle->minVarianceRatio <= 0.0f) {
+    return false;
+  }
 
-  // ====== INNOVATION COVARIANCE ======
+  float HPH = 0;
+  for (int k=0; k<hCount; k++) {
+    HPH += hValue[k] * hValue[k] * this->P[hIndex[k]][hIndex[k]];
+  }
 
-  mat_trans(Hm, &HTm);
-  mat_mult(&this->Pm, &HTm, &PHTm); // PH'
+  return HPH < throttle->minVarianceRatio * R;
+}
+
+// A maxMahalanobisDistance of 0 disables the gate
+static bool sparseScalarUpdate(kalmanCoreData_t* this, const uint8_t *hIndex, const float *hValue, int hCount, float error, float stdMeasNoise, float maxMahalanobisDistance)
+{
+  // The Kalman gain as a column vector
+  float* K = this->workspace->K;
+
+  float* PHTd = this->workspace->PHT;
+
+  ASSERT(hCount <= KC_STATE_DIM);
+
+  // ====== THROTTLE ======
+  // Subsample measurements that carry little information, before doing the work
   float R = stdMeasNoise*stdMeasNoise;
+  if (isRedundantMeasurement(this, hIndex, hValue, hCount, R)) {
+    kalmanCoreUpdateThrottle_t* throttle = this->updateThrottle;
+    throttle->redundantCount++;
+    if (throttle->keepEvery == 0 || throttle->redundantCount < throttle->keepEvery) {
+      throttle->skipped++;
+      return false;
+    }
+    throttle->redundantCount = 0;
+  }
+
+  // ====== INNOVATION COVARIANCE ======
+
+  // PH' is a weighted sum of the columns of P selected by H
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    float phti = 0;
+    for (int k=0; k<hCount; k++) {
+      ASSERT(hIndex[k] < KC_STATE_DIM);
+      phti += this->P[i][hIndex[k]] * hValue[k];
+    }
+    PHTd[i] = phti;
+  }
+
   float HPHR = R; // HPH' + R
-  for (int i=0; i<KC_STATE_DIM; i++) { // Add the element of HPH' to the above
-    HPHR += Hm->pData[i]*PHTd[i]; // this obviously only works if the update is scalar (as in this function)
+  for (int k=0; k<hCount; k++) { // Add the element of HPH' to the above
+    HPHR += hValue[k]*PHTd[hIndex[k]];
   }
   ASSERT(!isnan(HPHR));
 
+  // ====== GATE ======
+  // Reject the measurement if the innovation is unlikely given its variance, error^2 / (HPH' + R) > gate^2
+  if (maxMahalanobisDistance > 0.0f && error * error > maxMahalanobisDistance * maxMahalanobisDistance * HPHR) {
+    return false;
+  }
+
   // ====== MEASUREMENT UPDATE ======
   // Calculate the Kalman gain and perform the state update
   for (int i=0; i<KC_STATE_DIM; i++) {
@@ -249,25 +334,87 @@ void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm,
   assertStateNotNaN(this);
 
   // ====== COVARIANCE UPDATE ======
-  mat_mult(&Km, Hm, &tmpNN1m); // KH
-  for (int i=0; i<KC_STATE_DIM; i++) { tmpNN1d[KC_STATE_DIM*i+i] -= 1; } // KH - I
-  mat_trans(&tmpNN1m, &tmpNN2m); // (KH - I)'
-  mat_mult(&tmpNN1m, &this->Pm, &tmpNN3m); // (KH - I)*P
-  mat_mult(&tmpNN3m, &tmpNN2m, &this->Pm); // (KH - I)*P*(KH - I)'
-  assertStateNotNaN(this);
-  // add the measurement variance and ensure boundedness and symmetry
+  // Joseph form, expanded into rank-1 terms:
+  // (KH - I)*P*(KH - I)' + KRK' = P - K(PH')' - (PH')K' + K(HPH' + R)K'
+  // P is kept symmetric, so only the upper triangle is read and the result is mirrored and bounded
   // TODO: Why would it hit these bounds? Needs to be investigated.
   for (int i=0; i<KC_STATE_DIM; i++) {
     for (int j=i; j<KC_STATE_DIM; j++) {
-      float v = K[i] * R * K[j];
-      float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i] + v; // add measurement noise
-      if (isnan(p) || p > MAX_COVARIANCE) {
-        this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
-      } else if ( i==j && p < MIN_COVARIANCE ) {
-        this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
-      } else {
-        this->P[i][j] = this->P[j][i] = p;
+      float v = K[i] * HPHR * K[j] - K[i] * PHTd[j] - PHTd[i] * K[j];
+      storeCovariance(this, i, j, this->P[i][j] + v);
+    }
+  }
+
+  assertStateNotNaN(this);
+
+  return true;
+}
+
+void kalmanCoreVectorUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *error, const float *stdMeasNoise)
+{
+  const uint16_t m = Hm->numRows;
+  ASSERT(m > 0 && m <= KC_MAX_VECTOR_UPDATE_DIM);
+  ASSERT(Hm->numCols == KC_STATE_DIM);
+
+  // Temporary matrices, N x m and m x m
+  kalmanCoreWorkspace_t* ws = this->workspace;
+  float* HTd = ws->HT;
+  arm_matrix_instance_f32 HTm = {KC_STATE_DIM, m, HTd};
+
+  float* PHTd = ws->PHT;
+  arm_matrix_instance_f32 PHTm = {KC_STATE_DIM, m, PHTd};
+
+  float* Kd = ws->K;
+  arm_matrix_instance_f32 Km = {KC_STATE_DIM, m, Kd};
+
+  float* KSd = ws->KS;
+  arm_matrix_instance_f32 KSm = {KC_STATE_DIM, m, KSd};
+
+  // Innovation covariance and its inverse
+  float* HPHRd = ws->HPHR;
+  arm_matrix_instance_f32 HPHRm = {m, m, HPHRd};
+
+  float* tmpMMd = ws->tmpMM;
+  arm_matrix_instance_f32 tmpMMm = {m, m, tmpMMd};
+
+  float* HPHRinvd = ws->HPHRinv;
+  arm_matrix_instance_f32 HPHRinvm = {m, m, HPHRinvd};
+
+  // ====== INNOVATION COVARIANCE ======
+  mat_trans(Hm, &HTm);
+  mat_mult(&this->Pm, &HTm, &PHTm); // PH'
+  mat_mult(Hm, &PHTm, &HPHRm); // HPH'
+  for (int i = 0; i < m; i++) {
+    HPHRd[i * m + i] += stdMeasNoise[i] * stdMeasNoise[i]; // HPH' + R
+    ASSERT(!isnan(HPHRd[i * m + i]));
+  }
+
+  // The inversion destroys the source, keep (HPH' + R) for the covariance update
+  memcpy(tmpMMd, HPHRd, m * m * sizeof(float));
+  mat_inv(&tmpMMm, &HPHRinvm);
+
+  // ====== MEASUREMENT UPDATE ======
+  mat_mult(&PHTm, &HPHRinvm, &Km); // kalman gain = (PH' (HPH' + R )^-1)
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int k = 0; k < m; k++) {
+      this->S[i] += Kd[i * m + k] * error[k]; // state update
+    }
+  }
+  assertStateNotNaN(this);
+
+  // ====== COVARIANCE UPDATE ======
+  // Joseph form expanded to avoid N x N intermediates:
+  // (I - KH)P(I - KH)' + KRK' = P - K(PH')' - (PH')K' + K(HPH' + R)K'
+  mat_mult(&Km, &HPHRm, &KSm); // K(HPH' + R)
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = i; j < KC_STATE_DIM; j++) {
+      float d = 0;
+      for (int k = 0; k < m; k++) {
+        d += KSd[i * m + k] * Kd[j * m + k] - Kd[i * m + k] * PHTd[j * m + k] - PHTd[i * m + k] * Kd[j * m + k];
       }
+
+      // P is symmetric, the result is mirrored and bounded
+      storeCovariance(this, i, j, this->P[i][j] + d);
     }
   }
 
@@ -278,8 +425,8 @@ void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm
 {
     // kalman filter update with weighted covariance matrix P_w_m, kalman gain Km, and innovation error 
     // Temporary matrices for the covariance updates 
-    static float tmpNN1d[KC_STATE_DIM][KC_STATE_DIM];
-    static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, (float *)tmpNN1d};
+    float (*tmpNN1d)[KC_STATE_DIM] = this->workspace->NN1;
+    arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, (float *)tmpNN1d};
     for (int i=0; i<KC_STATE_DIM; i++){
         this->S[i] = this->S[i] + Km->pData[i] * error;
     }
@@ -287,23 +434,14 @@ void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm
     mat_mult(Km, Hm, &tmpNN1m);                 // KH,  the Kalman Gain and H are the updated Kalman Gain and H 
     mat_scale(&tmpNN1m, -1.0f, &tmpNN1m);       //  I-KH
     for (int i=0; i<KC_STATE_DIM; i++) { tmpNN1d[i][i] = 1.0f + tmpNN1d[i][i]; } 
-    float Ppo[KC_STATE_DIM][KC_STATE_DIM]={0};
+    float (*Ppo)[KC_STATE_DIM] = this->workspace->NN2;
     arm_matrix_instance_f32 Ppom = {KC_STATE_DIM, KC_STATE_DIM, (float *)Ppo};
     mat_mult(&tmpNN1m, P_w_m, &Ppom);          // Pm = (I-KH)*P_w_m
-    matrixcopy(KC_STATE_DIM, KC_STATE_DIM, this->P, Ppo);
-
-    assertStateNotNaN(this);
 
+    // (I-KH)*P_w_m is only symmetric up to rounding, store its symmetric part bounded
     for (int i=0; i<KC_STATE_DIM; i++) {
         for (int j=i; j<KC_STATE_DIM; j++) {
-        float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i];
-        if (isnan(p) || p > MAX_COVARIANCE) {
-            this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
-        } else if ( i==j && p < MIN_COVARIANCE ) {
-            this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
-        } else {
-            this->P[i][j] = this->P[j][i] = p;
-            }
+            storeCovariance(this, i, j, 0.5f*Ppo[i][j] + 0.5f*Ppo[j][i]);
         }
     }
     assertStateNotNaN(this);
@@ -313,21 +451,76 @@ void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm
 
 void kalmanCoreUpdateWithBaro(kalmanCoreData_t* this, float baroAsl, bool quadIsFlying)
 {
-  float h[KC_STATE_DIM] = {0};
-  arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
-
-  h[KC_STATE_Z] = 1;
-
   if (!quadIsFlying || this->baroReferenceHeight < 1) {
     //TODO: maybe we could track the zero height as a state. Would be especially useful if UWB anchors had barometers.
     this->baroReferenceHeight = baroAsl;
   }
 
   float meas = (baroAsl - this->baroReferenceHeight);
-  kalmanCoreScalarUpdate(this, &H, meas - this->S[KC_STATE_Z], measNoiseBaro);
+  kalmanCoreStateUpdate(this, KC_STATE_Z, meas - this->S[KC_STATE_Z], measNoiseBaro);
 }
 
-void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying)
+/**
+ * The linearized dynamics A is block upper triangular in 3x3 blocks (position, body velocity and attitude error):
+ *
+ *     | I  Apv  Apd |
+ * A = | 0  Avv  Avd |
+ *     | 0   0   Add |
+ *
+ * This table holds the first column of each row that can be non-zero, not counting the identity block for position.
+ */
+static const uint8_t predictFirstCol[KC_STATE_DIM] = {
+  KC_STATE_PX, KC_STATE_PX, KC_STATE_PX,
+  KC_STATE_PX, KC_STATE_PX, KC_STATE_PX,
+  KC_STATE_D0, KC_STATE_D0, KC_STATE_D0,
+};
+
+// P = A P A' using the block structure of A, only the upper triangle is computed and then mirrored and bounded
+static void predictCovarianceStructured(kalmanCoreData_t* this, const float A[KC_STATE_DIM][KC_STATE_DIM])
+{
+  float (*AP)[KC_STATE_DIM] = this->workspace->NN1;
+
+  // A P
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    const int first = predictFirstCol[i];
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = (i < KC_STATE_PX) ? this->P[i][j] : 0.0f;
+      for (int k = first; k < KC_STATE_DIM; k++) {
+        sum += A[i][k] * this->P[k][j];
+      }
+      AP[i][j] = sum;
+    }
+  }
+
+  // (A P) A', the result is symmetric
+  for (int j = 0; j < KC_STATE_DIM; j++) {
+    const int first = predictFirstCol[j];
+    for (int i = 0; i <= j; i++) {
+      float sum = (j < KC_STATE_PX) ? AP[i][j] : 0.0f;
+      for (int k = first; k < KC_STATE_DIM; k++) {
+        sum += AP[i][k] * A[j][k];
+      }
+      storeCovariance(this, i, j, sum);
+    }
+  }
+}
+
+// P = A P A' using full matrix products, kept as a reference implementation
+static void predictCovarianceDense(kalmanCoreData_t* this, float A[KC_STATE_DIM][KC_STATE_DIM])
+{
+  arm_matrix_instance_f32 Am = { KC_STATE_DIM, KC_STATE_DIM, (float *)A };
+
+  // Temporary matrices for the covariance updates
+  arm_matrix_instance_f32 tmpNN1m = { KC_STATE_DIM, KC_STATE_DIM, (float *)this->workspace->NN1 };
+  arm_matrix_instance_f32 tmpNN2m = { KC_STATE_DIM, KC_STATE_DIM, (float *)this->workspace->NN2 };
+
+  mat_mult(&Am, &this->Pm, &tmpNN1m); // A P
+  mat_trans(&Am, &tmpNN2m); // A'
+  mat_mult(&tmpNN1m, &tmpNN2m, &this->Pm); // A P A'
+  kalmanCoreCovarianceHealthCheck(this);
+}
+
+static void predict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying, bool useDenseCovariance)
 {
   /* Here we discretize (euler forward) and linearise the quadrocopter dynamics in order
    * to push the covariance forward.
@@ -351,15 +544,9 @@ void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float
    */
 
   // The linearized update matrix
-  NO_DMA_CCM_SAFE_ZERO_INIT static float A[KC_STATE_DIM][KC_STATE_DIM];
-  static __attribute__((aligned(4))) arm_matrix_instance_f32 Am = { KC_STATE_DIM, KC_STATE_DIM, (float *)A}; // linearized dynamics for covariance update;
-
-  // Temporary matrices for the covariance updates
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
-  static __attribute__((aligned(4))) arm_matrix_instance_f32 tmpNN1m = { KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
-
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
-  static __attribute__((aligned(4))) arm_matrix_instance_f32 tmpNN2m = { KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
+  // The workspace may be shared with other instances, the zero blocks of A are not assumed to be kept
+  float (*A)[KC_STATE_DIM] = this->workspace->A;
+  memset(A, 0, sizeof(this->workspace->A));
 
   float dt2 = dt*dt;
 
@@ -463,9 +650,11 @@ void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float
 
 
   // ====== COVARIANCE UPDATE ======
-  mat_mult(&Am, &this->Pm, &tmpNN1m); // A P
-  mat_trans(&Am, &tmpNN2m); // A'
-  mat_mult(&tmpNN1m, &tmpNN2m, &this->Pm); // A P A'
+  if (useDenseCovariance) {
+    predictCovarianceDense(this, A);
+  } else {
+    predictCovarianceStructured(this, A);
+  }
   // Process noise is added after the return from the prediction step
 
   // ====== PREDICTION STEP ======
@@ -562,6 +751,194 @@ void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float
   assertStateNotNaN(this);
 }
 
+void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying)
+{
+  predict(this, acc, gyro, dt, quadIsFlying, false);
+}
+
+void kalmanCorePredictDense(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying)
+{
+  predict(this, acc, gyro, dt, quadIsFlying, true);
+}
+
+// The rotation matrix of a unit quaternion (w,x,y,z), rotating vectors from the rotated frame to the reference frame
+static void quaternionToRotation(const float q[4], float R[3][3])
+{
+  R[0][0] = q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3];
+  R[0][1] = 2 * q[1] * q[2] - 2 * q[0] * q[3];
+  R[0][2] = 2 * q[1] * q[3] + 2 * q[0] * q[2];
+
+  R[1][0] = 2 * q[1] * q[2] + 2 * q[0] * q[3];
+  R[1][1] = q[0] * q[0] - q[1] * q[1] + q[2] * q[2] - q[3] * q[3];
+  R[1][2] = 2 * q[2] * q[3] - 2 * q[0] * q[1];
+
+  R[2][0] = 2 * q[1] * q[3] - 2 * q[0] * q[2];
+  R[2][1] = 2 * q[2] * q[3] + 2 * q[0] * q[1];
+  R[2][2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+// q = q * r, followed by normalization
+static void quaternionMultiplyNormalized(float q[4], const float r[4])
+{
+  float tmpq0 = r[0]*q[0] - r[1]*q[1] - r[2]*q[2] - r[3]*q[3];
+  float tmpq1 = r[1]*q[0] + r[0]*q[1] + r[3]*q[2] - r[2]*q[3];
+  float tmpq2 = r[2]*q[0] - r[3]*q[1] + r[0]*q[2] + r[1]*q[3];
+  float tmpq3 = r[3]*q[0] + r[2]*q[1] - r[1]*q[2] + r[0]*q[3];
+
+  float norm = arm_sqrt(tmpq0*tmpq0 + tmpq1*tmpq1 + tmpq2*tmpq2 + tmpq3*tmpq3);
+  q[0] = tmpq0/norm; q[1] = tmpq1/norm; q[2] = tmpq2/norm; q[3] = tmpq3/norm;
+}
+
+void kalmanCoreImuDeltaReset(kalmanCoreImuDelta_t* delta)
+{
+  memset(delta, 0, sizeof(kalmanCoreImuDelta_t));
+  delta->dq[0] = 1.0f;
+}
+
+void kalmanCoreImuDeltaIntegrate(kalmanCoreImuDelta_t* delta, const Axis3f *acc, const Axis3f *gyro, float dt, bool quadIsFlying)
+{
+  if (dt <= 0.0f) {
+    return;
+  }
+
+  // When flying, the accelerometer measures thrust, which is only produced in the body's z direction
+  const float ax = quadIsFlying ? 0.0f : acc->x;
+  const float ay = quadIsFlying ? 0.0f : acc->y;
+  const float az = acc->z;
+
+  // The specific force in the body frame at the start of the interval
+  float dR[3][3];
+  quaternionToRotation(delta->dq, dR);
+  const float a0 = dR[0][0] * ax + dR[0][1] * ay + dR[0][2] * az;
+  const float a1 = dR[1][0] * ax + dR[1][1] * ay + dR[1][2] * az;
+  const float a2 = dR[2][0] * ax + dR[2][1] * ay + dR[2][2] * az;
+
+  const float dt2 = dt * dt;
+  delta->dp.x += delta->dv.x * dt + a0 * dt2 / 2.0f;
+  delta->dp.y += delta->dv.y * dt + a1 * dt2 / 2.0f;
+  delta->dp.z += delta->dv.z * dt + a2 * dt2 / 2.0f;
+
+  delta->dv.x += a0 * dt;
+  delta->dv.y += a1 * dt;
+  delta->dv.z += a2 * dt;
+
+  // Rotate by the gyroscope angular velocity integrated over the sample period
+  float dtwx = dt*gyro->x;
+  float dtwy = dt*gyro->y;
+  float dtwz = dt*gyro->z;
+  float angle = arm_sqrt(dtwx*dtwx + dtwy*dtwy + dtwz*dtwz);
+  if (angle > 0.0f) {
+    float ca = arm_cos_f32(angle/2.0f);
+    float sa = arm_sin_f32(angle/2.0f);
+    float dq[4] = {ca , sa*dtwx/angle , sa*dtwy/angle , sa*dtwz/angle};
+    quaternionMultiplyNormalized(delta->dq, dq);
+  }
+
+  delta->dt += dt;
+}
+
+void kalmanCorePredictWithImuDelta(kalmanCoreData_t* this, const kalmanCoreImuDelta_t* delta, bool quadIsFlying)
+{
+  /* The IMU samples are integrated in the body frame at the start of the interval (b0):
+   *
+   *   dR: rotation from the body frame at the end of the interval to b0
+   *   dv: integral of dR(t) * acc(t)
+   *   dp: double integral of dR(t) * acc(t)
+   *
+   * Gravity is constant in the global frame and is added here. With T the length of the interval
+   * and r = R' * e3 the direction of gravity in b0, the state is propagated as:
+   *
+   *   x_new = x + R * (p * T + dp) - g * T^2 / 2 * e3
+   *   p_new = dR' * (p + dv - g * T * r)
+   *   q_new = q * dq
+   *
+   * and the Jacobian of the error state is
+   *
+   *       | I   R*T    -R*[[p*T + dp]] |
+   *   A = | 0   dR'    -g*T*dR'*[[r]]  |
+   *       | 0   0       dR'            |
+   *
+   * which has the same block structure as the Jacobian of the single step prediction.
+   */
+  // The workspace may be shared with other instances, the zero blocks of A are not assumed to be kept
+  float (*A)[KC_STATE_DIM] = this->workspace->A;
+  memset(A, 0, sizeof(this->workspace->A));
+
+  const float T = delta->dt;
+  float dR[3][3];
+  quaternionToRotation(delta->dq, dR);
+
+  // The travel in b0 caused by the velocity and the specific force
+  const float u[3] = {
+    this->S[KC_STATE_PX] * T + delta->dp.x,
+    this->S[KC_STATE_PY] * T + delta->dp.y,
+    this->S[KC_STATE_PZ] * T + delta->dp.z,
+  };
+
+  // Gravity direction in b0
+  const float r[3] = {this->R[2][0], this->R[2][1], this->R[2][2]};
+
+  // ====== DYNAMICS LINEARIZATION ======
+  for (int i = 0; i < 3; i++) {
+    A[KC_STATE_X + i][KC_STATE_X + i] = 1;
+
+    for (int j = 0; j < 3; j++) {
+      // position from body-frame velocity
+      A[KC_STATE_X + i][KC_STATE_PX + j] = this->R[i][j] * T;
+
+      // body-frame velocity and attitude error are rotated to the end of the interval
+      A[KC_STATE_PX + i][KC_STATE_PX + j] = dR[j][i];
+      A[KC_STATE_D0 + i][KC_STATE_D0 + j] = dR[j][i];
+    }
+
+    // position from attitude error, R * (e_k x u) for column k
+    A[KC_STATE_X + i][KC_STATE_D0] = this->R[i][2] * u[1] - this->R[i][1] * u[2];
+    A[KC_STATE_X + i][KC_STATE_D1] = this->R[i][0] * u[2] - this->R[i][2] * u[0];
+    A[KC_STATE_X + i][KC_STATE_D2] = this->R[i][1] * u[0] - this->R[i][0] * u[1];
+
+    // body-frame velocity from attitude error, g * T * dR' * (e_k x r) for column k
+    A[KC_STATE_PX + i][KC_STATE_D0] = GRAVITY_MAGNITUDE * T * (-dR[1][i] * r[2] + dR[2][i] * r[1]);
+    A[KC_STATE_PX + i][KC_STATE_D1] = GRAVITY_MAGNITUDE * T * ( dR[0][i] * r[2] - dR[2][i] * r[0]);
+    A[KC_STATE_PX + i][KC_STATE_D2] = GRAVITY_MAGNITUDE * T * (-dR[0][i] * r[1] + dR[1][i] * r[0]);
+  }
+
+  // ====== COVARIANCE UPDATE ======
+  predictCovarianceStructured(this, A);
+  // Process noise is added after the return from the prediction step
+
+  // ====== PREDICTION STEP ======
+  this->S[KC_STATE_X] += this->R[0][0] * u[0] + this->R[0][1] * u[1] + this->R[0][2] * u[2];
+  this->S[KC_STATE_Y] += this->R[1][0] * u[0] + this->R[1][1] * u[1] + this->R[1][2] * u[2];
+  this->S[KC_STATE_Z] += this->R[2][0] * u[0] + this->R[2][1] * u[1] + this->R[2][2] * u[2] - GRAVITY_MAGNITUDE * T * T / 2.0f;
+
+  const float w[3] = {
+    this->S[KC_STATE_PX] + delta->dv.x - GRAVITY_MAGNITUDE * T * r[0],
+    this->S[KC_STATE_PY] + delta->dv.y - GRAVITY_MAGNITUDE * T * r[1],
+    this->S[KC_STATE_PZ] + delta->dv.z - GRAVITY_MAGNITUDE * T * r[2],
+  };
+  this->S[KC_STATE_PX] = dR[0][0] * w[0] + dR[1][0] * w[1] + dR[2][0] * w[2];
+  this->S[KC_STATE_PY] = dR[0][1] * w[0] + dR[1][1] * w[1] + dR[2][1] * w[2];
+  this->S[KC_STATE_PZ] = dR[0][2] * w[0] + dR[1][2] * w[1] + dR[2][2] * w[2];
+
+  // attitude update
+  float q[4] = {this->q[0], this->q[1], this->q[2], this->q[3]};
+  quaternionMultiplyNormalized(q, delta->dq);
+
+  if (! quadIsFlying) {
+    float keep = 1.0f - ROLLPITCH_ZERO_REVERSION;
+    for (int i = 0; i < 4; i++) {
+      q[i] = keep * q[i] + ROLLPITCH_ZERO_REVERSION * initialQuaternion[i];
+    }
+    const float norm = arm_sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    for (int i = 0; i < 4; i++) {
+      q[i] /= norm;
+    }
+  }
+
+  this->q[0] = q[0]; this->q[1] = q[1]; this->q[2] = q[2]; this->q[3] = q[3];
+  assertStateNotNaN(this);
+}
+
 
 void kalmanCoreAddProcessNoise(kalmanCoreData_t* this, float dt)
 {
@@ -580,17 +957,9 @@ void kalmanCoreAddProcessNoise(kalmanCoreData_t* this, float dt)
     this->P[KC_STATE_D2][KC_STATE_D2] += powf(measNoiseGyro_yaw * dt + procNoiseAtt, 2);
   }
 
+  // Only the diagonal has changed
   for (int i=0; i<KC_STATE_DIM; i++) {
-    for (int j=i; j<KC_STATE_DIM; j++) {
-      float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i];
-      if (isnan(p) || p > MAX_COVARIANCE) {
-        this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
-      } else if ( i==j && p < MIN_COVARIANCE ) {
-        this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
-      } else {
-        this->P[i][j] = this->P[j][i] = p;
-      }
-    }
+    storeCovariance(this, i, i, this->P[i][i]);
   }
 
   assertStateNotNaN(this);
@@ -598,26 +967,46 @@ void kalmanCoreAddProcessNoise(kalmanCoreData_t* this, float dt)
 
 
 
-void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
+// Computes P = A * P * A' where A is the identity except for the attitude block B.
+// Only the attitude rows and columns of P change, they are stored mirrored and bounded.
+static void rotateAttitudeCovariance(kalmanCoreData_t* this, const float B[3][3])
 {
-  // Matrix to rotate the attitude covariances once updated
-  NO_DMA_CCM_SAFE_ZERO_INIT static float A[KC_STATE_DIM][KC_STATE_DIM];
-  static arm_matrix_instance_f32 Am = {KC_STATE_DIM, KC_STATE_DIM, (float *)A};
+  float rows[3][KC_STATE_DIM];
 
-  // Temporary matrices for the covariance updates
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
+  // B * P for the attitude rows
+  for (int a = 0; a < 3; a++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      rows[a][j] = B[a][0] * this->P[KC_STATE_D0][j] + B[a][1] * this->P[KC_STATE_D1][j] + B[a][2] * this->P[KC_STATE_D2][j];
+    }
+  }
+
+  // Outside the attitude block A only applies on one side
+  for (int a = 0; a < 3; a++) {
+    for (int j = 0; j < KC_STATE_D0; j++) {
+      storeCovariance(this, KC_STATE_D0 + a, j, rows[a][j]);
+    }
+  }
 
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN2m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
+  // (B * P) * B' for the attitude block
+  for (int a = 0; a < 3; a++) {
+    for (int b = a; b < 3; b++) {
+      float p = rows[a][KC_STATE_D0] * B[b][0] + rows[a][KC_STATE_D1] * B[b][1] + rows[a][KC_STATE_D2] * B[b][2];
+      storeCovariance(this, KC_STATE_D0 + a, KC_STATE_D0 + b, p);
+    }
+  }
+}
 
+void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
+{
   // Incorporate the attitude error (Kalman filter state) with the attitude
   float v0 = this->S[KC_STATE_D0];
   float v1 = this->S[KC_STATE_D1];
   float v2 = this->S[KC_STATE_D2];
 
-  // Move attitude error into attitude if any of the angle errors are large enough
-  if ((fabsf(v0) > 0.1e-3f || fabsf(v1) > 0.1e-3f || fabsf(v2) > 0.1e-3f) && (fabsf(v0) < 10 && fabsf(v1) < 10 && fabsf(v2) < 10))
+  // Move attitude error into attitude if any of the angle errors are large enough.
+  // Smaller errors are kept in the state and accumulate until they are.
+  bool isErrorLarge = (fabsf(v0) > 0.1e-3f || fabsf(v1) > 0.1e-3f || fabsf(v2) > 0.1e-3f);
+  if (isErrorLarge && (fabsf(v0) < 10 && fabsf(v1) < 10 && fabsf(v2) < 10))
   {
     float angle = arm_sqrt(v0*v0 + v1*v1 + v2*v2);
     float ca = arm_cos_f32(angle / 2.0f);
@@ -652,29 +1041,20 @@ void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
     float d1 = v1/2; // so we use a first order approximation to d0 = tan(|v0|/2)*v0/|v0|
     float d2 = v2/2;
 
-    A[KC_STATE_X][KC_STATE_X] = 1;
-    A[KC_STATE_Y][KC_STATE_Y] = 1;
-    A[KC_STATE_Z][KC_STATE_Z] = 1;
-
-    A[KC_STATE_PX][KC_STATE_PX] = 1;
-    A[KC_STATE_PY][KC_STATE_PY] = 1;
-    A[KC_STATE_PZ][KC_STATE_PZ] = 1;
-
-    A[KC_STATE_D0][KC_STATE_D0] =  1 - d1*d1/2 - d2*d2/2;
-    A[KC_STATE_D0][KC_STATE_D1] =  d2 + d0*d1/2;
-    A[KC_STATE_D0][KC_STATE_D2] = -d1 + d0*d2/2;
+    const float B[3][3] = {
+      { 1 - d1*d1/2 - d2*d2/2,  d2 + d0*d1/2,          -d1 + d0*d2/2},
+      {-d2 + d0*d1/2,           1 - d0*d0/2 - d2*d2/2,  d0 + d1*d2/2},
+      { d1 + d0*d2/2,          -d0 + d1*d2/2,           1 - d0*d0/2 - d1*d1/2},
+    };
 
-    A[KC_STATE_D1][KC_STATE_D0] = -d2 + d0*d1/2;
-    A[KC_STATE_D1][KC_STATE_D1] =  1 - d0*d0/2 - d2*d2/2;
-    A[KC_STATE_D1][KC_STATE_D2] =  d0 + d1*d2/2;
-
-    A[KC_STATE_D2][KC_STATE_D0] =  d1 + d0*d2/2;
-    A[KC_STATE_D2][KC_STATE_D1] = -d0 + d1*d2/2;
-    A[KC_STATE_D2][KC_STATE_D2] = 1 - d0*d0/2 - d1*d1/2;
+    rotateAttitudeCovariance(this, B);
+  }
 
-    mat_trans(&Am, &tmpNN1m); // A'
-    mat_mult(&Am, &this->Pm, &tmpNN2m); // AP
-    mat_mult(&tmpNN2m, &tmpNN1m, &this->Pm); //APA'
+  // reset the attitude error once it has been applied, or if it is unusably large
+  if (isErrorLarge) {
+    this->S[KC_STATE_D0] = 0;
+    this->S[KC_STATE_D1] = 0;
+    this->S[KC_STATE_D2] = 0;
   }
 
   // convert the new attitude to a rotation matrix, such that we can rotate body-frame velocity and acc
@@ -689,27 +1069,22 @@ void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
   this->R[2][0] = 2 * this->q[1] * this->q[3] - 2 * this->q[0] * this->q[2];
   this->R[2][1] = 2 * this->q[2] * this->q[3] + 2 * this->q[0] * this->q[1];
   this->R[2][2] = this->q[0] * this->q[0] - this->q[1] * this->q[1] - this->q[2] * this->q[2] + this->q[3] * this->q[3];
+  this->sweepSensorPosValid = 0;
 
-  // reset the attitude error
-  this->S[KC_STATE_D0] = 0;
-  this->S[KC_STATE_D1] = 0;
-  this->S[KC_STATE_D2] = 0;
+  assertStateNotNaN(this);
+}
 
+void kalmanCoreCovarianceHealthCheck(kalmanCoreData_t* this)
+{
   // enforce symmetry of the covariance matrix, and ensure the values stay bounded
   for (int i=0; i<KC_STATE_DIM; i++) {
     for (int j=i; j<KC_STATE_DIM; j++) {
-      float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i];
-      if (isnan(p) || p > MAX_COVARIANCE) {
-        this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
-      } else if ( i==j && p < MIN_COVARIANCE ) {
-        this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
-      } else {
-        this->P[i][j] = this->P[j][i] = p;
-      }
+#ifdef DEBUG_STATE_CHECK
+      ASSERT(!isnan(this->P[i][j]) && !isnan(this->P[j][i]));
+#endif
+      storeCovariance(this, i, j, 0.5f*this->P[i][j] + 0.5f*this->P[j][i]);
     }
   }
-
-  assertStateNotNaN(this);
 }
 
 void kalmanCoreExternalizeState(const kalmanCoreData_t* this, state_t *state, const Axis3f *acc, uint32_t tick)
@@ -730,20 +1105,12 @@ void kalmanCoreExternalizeState(const kalmanCoreData_t* this, state_t *state, co
       .z = this->R[2][0]*this->S[KC_STATE_PX] + this->R[2][1]*this->S[KC_STATE_PY] + this->R[2][2]*this->S[KC_STATE_PZ]
   };
 
-  // Accelerometer measurements are in the body frame and need to be rotated to world frame.
-  // Furthermore, the legacy code requires acc.z to be acceleration without gravity.
-  // Finally, note that these accelerations are in Gs, and not in m/s^2, hence - 1 for removing gravity
-  state->acc = (acc_t){
-      .timestamp = tick,
-      .x = this->R[0][0]*acc->x + this->R[0][1]*acc->y + this->R[0][2]*acc->z,
-      .y = this->R[1][0]*acc->x + this->R[1][1]*acc->y + this->R[1][2]*acc->z,
-      .z = this->R[2][0]*acc->x + this->R[2][1]*acc->y + this->R[2][2]*acc->z - 1
-  };
+  kalmanCoreExternalizeAcc(this, state, acc, tick);
 
   // convert the new attitude into Euler YPR
-  float yaw = atan2f(2*(this->q[1]*this->q[2]+this->q[0]*this->q[3]) , this->q[0]*this->q[0] + this->q[1]*this->q[1] - this->q[2]*this->q[2] - this->q[3]*this->q[3]);
-  float pitch = asinf(-2*(this->q[1]*this->q[3] - this->q[0]*this->q[2]));
-  float roll = atan2f(2*(this->q[2]*this->q[3]+this->q[0]*this->q[1]) , this->q[0]*this->q[0] - this->q[1]*this->q[1] - this->q[2]*this->q[2] + this->q[3]*this->q[3]);
+  float yaw = fastAtan2(2*(this->q[1]*this->q[2]+this->q[0]*this->q[3]) , this->q[0]*this->q[0] + this->q[1]*this->q[1] - this->q[2]*this->q[2] - this->q[3]*this->q[3]);
+  float pitch = fastAsin(-2*(this->q[1]*this->q[3] - this->q[0]*this->q[2]));
+  float roll = fastAtan2(2*(this->q[2]*this->q[3]+this->q[0]*this->q[1]) , this->q[0]*this->q[0] - this->q[1]*this->q[1] - this->q[2]*this->q[2] + this->q[3]*this->q[3]);
 
   // Save attitude, adjusted for the legacy CF2 body coordinate system
   state->attitude = (attitude_t){
@@ -763,9 +1130,25 @@ void kalmanCoreExternalizeState(const kalmanCoreData_t* this, state_t *state, co
       .z = this->q[3]
   };
 
+  const float q[4] = {this->q[1], this->q[2], this->q[3], this->q[0]};
+  state->attitudeQuaternionCompressed = quatcompress(q);
+
   assertStateNotNaN(this);
 }
 
+void kalmanCoreExternalizeAcc(const kalmanCoreData_t* this, state_t *state, const Axis3f *acc, uint32_t tick)
+{
+  // Accelerometer measurements are in the body frame and need to be rotated to world frame.
+  // Furthermore, the legacy code requires acc.z to be acceleration without gravity.
+  // Finally, note that these accelerations are in Gs, and not in m/s^2, hence - 1 for removing gravity
+  state->acc = (acc_t){
+      .timestamp = tick,
+      .x = this->R[0][0]*acc->x + this->R[0][1]*acc->y + this->R[0][2]*acc->z,
+      .y = this->R[1][0]*acc->x + this->R[1][1]*acc->y + this->R[1][2]*acc->z,
+      .z = this->R[2][0]*acc->x + this->R[2][1]*acc->y + this->R[2][2]*acc->z - 1
+  };
+}
+
 // Reset a state to 0 with max covariance
 // If called often, this decouples the state to the rest of the filter
 static void decoupleState(kalmanCoreData_t* this, kalmanCoreStateIdx_t state)
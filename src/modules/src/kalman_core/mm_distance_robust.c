@@ -22,32 +22,11 @@
  * ============================================================================
  */
 #include "mm_distance_robust.h"
+#include "mm_robust.h"
+#include "static_mem.h"
 #include "test_support.h"
 
 #define MAX_ITER (2) // maximum iteration is set to 2. 
-#define UPPER_BOUND (100)
-#define LOWER_BOUND (-100)
-
-// Cholesky Decomposition for a nxn psd matrix (from scratch)
-// Reference: https://www.geeksforgeeks.org/cholesky-decomposition-matrix-decomposition/
-static void Cholesky_Decomposition(int n, float matrix[n][n],  float lower[n][n]){
-    // Decomposing a matrix into Lower Triangular 
-    for (int i = 0; i < n; i++) { 
-        for (int j = 0; j <= i; j++) { 
-            float sum = 0.0; 
-            if (j == i) // summation for diagnols 
-            { 
-                for (int k = 0; k < j; k++) 
-                    sum += powf(lower[j][k], 2); 
-                lower[j][j] = sqrtf(matrix[j][j] - sum); 
-            } else { 
-                for (int k = 0; k < j; k++) 
-                    sum += (lower[i][k] * lower[j][k]); 
-                lower[i][j] = (matrix[i][j] - sum) / lower[j][j]; 
-            } 
-        } 
-    }
-} 
 
 /* Weight function for GM Robust cost function
  * General guidelines for hyperparameter tuning: 
@@ -80,61 +59,41 @@ void kalmanCoreRobustUpdateWithDistance(kalmanCoreData_t* this, distanceMeasurem
     // innovation term based on x_check
     float error_check = measuredDistance - predictedDistance;    // innovation term based on prior state
     // ---------------------- matrix defination ----------------------------- //
-    static float P_chol[KC_STATE_DIM][KC_STATE_DIM]; 
-    static arm_matrix_instance_f32 Pc_m = {KC_STATE_DIM, KC_STATE_DIM, (float *)P_chol};
-    static float Pc_tran[KC_STATE_DIM][KC_STATE_DIM];        
-    static arm_matrix_instance_f32 Pc_tran_m = {KC_STATE_DIM, KC_STATE_DIM, (float *)Pc_tran};
+    // Lower triangular Cholesky factor of the re-weighted prior covariance
+    NO_DMA_CCM_SAFE_ZERO_INIT static float P_chol[KC_STATE_DIM][KC_STATE_DIM];
 
     float h[KC_STATE_DIM] = {0};
-    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};    
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
     // The Kalman gain as a column vector
-    static float Kw[KC_STATE_DIM];                           
+    NO_DMA_CCM_SAFE_ZERO_INIT static float Kw[KC_STATE_DIM];
     static arm_matrix_instance_f32 Kwm = {KC_STATE_DIM, 1, (float *)Kw};
 
-    static float e_x[KC_STATE_DIM];
-    static arm_matrix_instance_f32 e_x_m = {KC_STATE_DIM, 1, e_x};
-
-    static float Pc_inv[KC_STATE_DIM][KC_STATE_DIM];
-    static arm_matrix_instance_f32 Pc_inv_m = {KC_STATE_DIM, KC_STATE_DIM, (float *)Pc_inv};
+    NO_DMA_CCM_SAFE_ZERO_INIT static float e_x[KC_STATE_DIM];
 
-    // rescale matrix
-    static float wx_inv[KC_STATE_DIM][KC_STATE_DIM];
-    static arm_matrix_instance_f32 wx_invm = {KC_STATE_DIM, KC_STATE_DIM, (float *)wx_inv};
-    // tmp matrix for P_chol inverse
-    static float tmp1[KC_STATE_DIM][KC_STATE_DIM];
-    static arm_matrix_instance_f32 tmp1m = {KC_STATE_DIM, KC_STATE_DIM, (float *)tmp1};
+    // diagonal of the inverse of the weight matrix w_x
+    NO_DMA_CCM_SAFE_ZERO_INIT static float wx_inv[KC_STATE_DIM];
 
-    static float Pc_w_inv[KC_STATE_DIM][KC_STATE_DIM];
-    static arm_matrix_instance_f32 Pc_w_invm = {KC_STATE_DIM, KC_STATE_DIM, (float *)Pc_w_inv};
-
-    static float P_w[KC_STATE_DIM][KC_STATE_DIM];
+    NO_DMA_CCM_SAFE_ZERO_INIT static float P_w[KC_STATE_DIM][KC_STATE_DIM];
     static arm_matrix_instance_f32 P_w_m = {KC_STATE_DIM, KC_STATE_DIM, (float *)P_w};
 
-    static float HTd[KC_STATE_DIM];
-    static arm_matrix_instance_f32 HTm = {KC_STATE_DIM, 1, HTd};
-
-    static float PHTd[KC_STATE_DIM];
-    static arm_matrix_instance_f32 PHTm = {KC_STATE_DIM, 1, PHTd};
+    NO_DMA_CCM_SAFE_ZERO_INIT static float PHTd[KC_STATE_DIM];
     // ------------------- Initialization -----------------------//
     // x prior (error state), set to be zeros. Not used for error state Kalman filter. Provide here for completeness 
     // float xpr[STATE_DIM] = {0.0};                  
 
     // x_err comes from the KF update is the state of error state Kalman filter, set to be zero initially
-    static float x_err[KC_STATE_DIM] = {0.0};          
-    static arm_matrix_instance_f32 x_errm = {KC_STATE_DIM, 1, x_err};
-    static float X_state[KC_STATE_DIM] = {0.0};
-    float P_iter[KC_STATE_DIM][KC_STATE_DIM];
-    matrixcopy(KC_STATE_DIM, KC_STATE_DIM, P_iter,this->P);   // init P_iter as P_prior
+    static float x_err[KC_STATE_DIM] = {0.0};
+    NO_DMA_CCM_SAFE_ZERO_INIT static float X_state[KC_STATE_DIM];
+
+    // cholesky decomposition for the prior covariance matrix, the following
+    // iterations re-weight the factor instead of decomposing P_w again
+    kalmanCoreRobustFactorize(this->P, P_chol);               // P_chol is a lower triangular matrix
 
     float R_iter = d->stdDev * d->stdDev;                     // measurement covariance
     vectorcopy(KC_STATE_DIM, X_state, this->S);               // copy Xpr to X_State and then update in each iterations
 
     // ---------------------- Start iteration ----------------------- //
     for (int iter = 0; iter < MAX_ITER; iter++){
-        // cholesky decomposition for the prior covariance matrix 
-        Cholesky_Decomposition(KC_STATE_DIM, P_iter, P_chol);          // P_chol is a lower triangular matrix
-        mat_trans(&Pc_m, &Pc_tran_m);
-
         // decomposition for measurement covariance (scalar case)
         float R_chol = sqrtf(R_iter);       
         // construct H matrix
@@ -142,7 +101,7 @@ void kalmanCoreRobustUpdateWithDistance(kalmanCoreData_t* this, distanceMeasurem
         float x_iter = X_state[KC_STATE_X],  y_iter = X_state[KC_STATE_Y], z_iter = X_state[KC_STATE_Z];   
         dx = x_iter - d->x;  dy = y_iter - d->y;   dz = z_iter - d->z;
 
-        float predicted_iter = arm_sqrt(powf(dx, 2) + powf(dy, 2) + powf(dz, 2));
+        float predicted_iter = arm_sqrt(dx * dx + dy * dy + dz * dz);
         // innovation term based on x_check
         float error_iter = measuredDistance - predicted_iter; 
 
@@ -167,39 +126,20 @@ void kalmanCoreRobustUpdateWithDistance(kalmanCoreData_t* this, distanceMeasurem
         else{ 
             e_y = error_iter / R_chol;
         }
-        // Make sure P_chol, lower trangular matrix, is numerically stable              
-        for (int col=0; col<KC_STATE_DIM; col++) {
-            for (int row=col; row<KC_STATE_DIM; row++) {
-                if (isnan(P_chol[row][col]) || P_chol[row][col] > UPPER_BOUND) {
-                    P_chol[row][col] = UPPER_BOUND;
-                } else if(row!=col && P_chol[row][col] < LOWER_BOUND){
-                    P_chol[row][col] = LOWER_BOUND;
-                } else if(row==col && P_chol[row][col]<0.0f){
-                    P_chol[row][col] = 0.0f;
-                } 
-            }
-        }
-        // Matrix inversion is numerically sensitive.
-        // Add small values on the diagonal of P_chol to avoid numerical problems.
-        float dummy_value = 1e-9f;
-        for (int k=0; k<KC_STATE_DIM; k++){
-            P_chol[k][k] = P_chol[k][k] + dummy_value;
-        }
-        // keep P_chol
-        matrixcopy(KC_STATE_DIM, KC_STATE_DIM, tmp1, P_chol);
-        mat_inv(&tmp1m, &Pc_inv_m);                            // Pc_inv_m = inv(Pc_m) = inv(P_chol)
-        mat_mult(&Pc_inv_m, &x_errm, &e_x_m);                  // e_x_m = Pc_inv_m.dot(x_errm) 
+        // Make sure P_chol, lower trangular matrix, is numerically stable
+        kalmanCoreRobustConditionFactor(P_chol);
+        kalmanCoreRobustSolveLower(P_chol, x_err, e_x);       // e_x = inv(P_chol).dot(x_err)
 
         // compute w_x, w_y --> weighting matrix
         // Since w_x is diagnal matrix, directly compute the inverse
         for (int state_k = 0; state_k < KC_STATE_DIM; state_k++){
-            GM_state(e_x[state_k], &wx_inv[state_k][state_k]);
-            wx_inv[state_k][state_k] = (float)1.0 / wx_inv[state_k][state_k];
+            GM_state(e_x[state_k], &wx_inv[state_k]);
+            wx_inv[state_k] = (float)1.0 / wx_inv[state_k];
         }
 
-        // rescale covariance matrix P 
-        mat_mult(&Pc_m, &wx_invm, &Pc_w_invm);           // Pc_w_invm = P_chol.dot(linalg.inv(w_x))
-        mat_mult(&Pc_w_invm, &Pc_tran_m, &P_w_m);        // P_w_m = Pc_w_invm.dot(Pc_tran_m) = P_chol.dot(linalg.inv(w_x)).dot(P_chol.T)
+        // rescale covariance matrix P, P_w = P_chol.dot(linalg.inv(w_x)).dot(P_chol.T).
+        // P_chol becomes the Cholesky factor of P_w for the next iteration
+        kalmanCoreRobustReweightFactor(P_chol, wx_inv);
 
         // rescale R matrix                 
         float w_y=0.0;      float R_w = 0.0f;
@@ -212,8 +152,7 @@ void kalmanCoreRobustUpdateWithDistance(kalmanCoreData_t* this, distanceMeasurem
         }
         // ====== INNOVATION COVARIANCE ====== //
 
-        mat_trans(&H, &HTm);
-        mat_mult(&P_w_m, &HTm, &PHTm);        // PHTm = P_w.dot(H.T). The P is the updated P_w 
+        kalmanCoreRobustFactorTimesVector(P_chol, h, PHTd);   // PHTd = P_w.dot(H.T). The P is the updated P_w
 
         float HPHR = R_w;                     // HPH' + R.            The R is the updated R_w 
         for (int i=0; i<KC_STATE_DIM; i++) {  // Add the element of HPH' to the above
@@ -227,14 +166,14 @@ void kalmanCoreRobustUpdateWithDistance(kalmanCoreData_t* this, distanceMeasurem
             x_err[i] = Kw[i] * error_check;           // error state for next iteration
             X_state[i] = this->S[i] + x_err[i];       // convert to nominal state
         }
-        // update P_iter matrix and R matrix for next iteration
-        matrixcopy(KC_STATE_DIM, KC_STATE_DIM, P_iter, P_w);
+        // update R matrix for next iteration
         R_iter = R_w;
     }
 
 
-    // After n iterations, we obtain the rescaled (1) P = P_iter, (2) R = R_iter, (3) Kw.
+    // After n iterations, we obtain the rescaled (1) P = P_chol.dot(P_chol.T), (2) R = R_iter, (3) Kw.
     // Call the kalman update function with weighted P, weighted K, h, and error_check
+    kalmanCoreRobustFactorToMatrix(P_chol, P_w);
     kalmanCoreUpdateWithPKE(this, &H, &Kwm, &P_w_m, error_check);
 
-}  
\ No newline at end of file
+}
\ No newline at end of file
@@ -32,10 +32,9 @@ static float predictedNY;
 static float measuredNX;
 static float measuredNY;
 
-void kalmanCoreUpdateWithFlow(kalmanCoreData_t* this, const flowMeasurement_t *flow, const Axis3f *gyro)
+// Fills the first two rows of H, the errors and the standard deviations for a flow measurement
+static void flowMeasurementRows(kalmanCoreData_t* this, const flowMeasurement_t *flow, const Axis3f *gyro, float h[][KC_STATE_DIM], float error[], float stdDev[])
 {
-  // Inclusion of flow measurements in the EKF done by two scalar updates
-
   // ~~~ Camera constants ~~~
   // The angle of aperture is guessed from the raw data register and thankfully look to be symmetric
   float Npix = 30.0;                      // [pixels] (same in x and y)
@@ -73,8 +72,8 @@ void kalmanCoreUpdateWithFlow(kalmanCoreData_t* this, const flowMeasurement_t *f
   // ~~~ X velocity prediction and update ~~~
   // predics the number of accumulated pixels in the x-direction
   float omegaFactor = 1.25f;
-  float hx[KC_STATE_DIM] = {0};
-  arm_matrix_instance_f32 Hx = {1, KC_STATE_DIM, hx};
+  float* hx = h[0];
+  float* hy = h[1];
   predictedNX = (flow->dt * Npix / thetapix ) * ((dx_g * this->R[2][2] / z_g) - omegaFactor * omegay_b);
   measuredNX = flow->dpixelx;
 
@@ -82,12 +81,7 @@ void kalmanCoreUpdateWithFlow(kalmanCoreData_t* this, const flowMeasurement_t *f
   hx[KC_STATE_Z] = (Npix * flow->dt / thetapix) * ((this->R[2][2] * dx_g) / (-z_g * z_g));
   hx[KC_STATE_PX] = (Npix * flow->dt / thetapix) * (this->R[2][2] / z_g);
 
-  //First update
-  kalmanCoreScalarUpdate(this, &Hx, measuredNX-predictedNX, flow->stdDevX);
-
   // ~~~ Y velocity prediction and update ~~~
-  float hy[KC_STATE_DIM] = {0};
-  arm_matrix_instance_f32 Hy = {1, KC_STATE_DIM, hy};
   predictedNY = (flow->dt * Npix / thetapix ) * ((dy_g * this->R[2][2] / z_g) + omegaFactor * omegax_b);
   measuredNY = flow->dpixely;
 
@@ -95,8 +89,43 @@ void kalmanCoreUpdateWithFlow(kalmanCoreData_t* this, const flowMeasurement_t *f
   hy[KC_STATE_Z] = (Npix * flow->dt / thetapix) * ((this->R[2][2] * dy_g) / (-z_g * z_g));
   hy[KC_STATE_PY] = (Npix * flow->dt / thetapix) * (this->R[2][2] / z_g);
 
-  // Second update
-  kalmanCoreScalarUpdate(this, &Hy, measuredNY-predictedNY, flow->stdDevY);
+  error[0] = measuredNX - predictedNX;
+  error[1] = measuredNY - predictedNY;
+  stdDev[0] = flow->stdDevX;
+  stdDev[1] = flow->stdDevY;
+}
+
+void kalmanCoreUpdateWithFlow(kalmanCoreData_t* this, const flowMeasurement_t *flow, const Axis3f *gyro)
+{
+  // Inclusion of flow measurements in the EKF done by one vector update of the two axes
+  float h[2][KC_STATE_DIM] = {0};
+  arm_matrix_instance_f32 H = {2, KC_STATE_DIM, (float*)h};
+  float error[2];
+  float stdDev[2];
+
+  flowMeasurementRows(this, flow, gyro, h, error, stdDev);
+  kalmanCoreVectorUpdate(this, &H, error, stdDev);
+}
+
+void kalmanCoreUpdateWithFlowAndTof(kalmanCoreData_t* this, const flowMeasurement_t *flow, const Axis3f *gyro, const tofMeasurement_t *tof)
+{
+  // The two flow axes and the distance in one vector update, the rows depend on the same z and R[2][2]
+  float h[3][KC_STATE_DIM] = {0};
+  arm_matrix_instance_f32 H = {2, KC_STATE_DIM, (float*)h};
+  float error[3];
+  float stdDev[3];
+
+  flowMeasurementRows(this, flow, gyro, h, error, stdDev);
+
+  // Same model and reliability condition as kalmanCoreUpdateWithTof()
+  if (this->R[2][2] > 0.1f) {
+    h[2][KC_STATE_Z] = 1 / this->R[2][2];
+    error[2] = tof->distance - this->S[KC_STATE_Z] / this->R[2][2];
+    stdDev[2] = tof->stdDev;
+    H.numRows = 3;
+  }
+
+  kalmanCoreVectorUpdate(this, &H, error, stdDev);
 }
 
 
@@ -29,14 +29,6 @@
 void kalmanCoreUpdateWithPose(kalmanCoreData_t* this, poseMeasurement_t *pose)
 {
   // a direct measurement of states x, y, and z, and orientation
-  // do a scalar update for each state, since this should be faster than updating all together
-  for (int i=0; i<3; i++) {
-    float h[KC_STATE_DIM] = {0};
-    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
-    h[KC_STATE_X+i] = 1;
-    kalmanCoreScalarUpdate(this, &H, pose->pos[i] - this->S[KC_STATE_X+i], pose->stdDevPos);
-  }
-
   // compute orientation error
   struct quat const q_ekf = mkquat(this->q[1], this->q[2], this->q[3], this->q[0]);
   struct quat const q_measured = mkquat(pose->quat.x, pose->quat.y, pose->quat.z, pose->quat.w);
@@ -44,19 +36,22 @@ void kalmanCoreUpdateWithPose(kalmanCoreData_t* this, poseMeasurement_t *pose)
   // small angle approximation, see eq. 141 in http://mars.cs.umn.edu/tr/reports/Trawny05b.pdf
   struct vec const err_quat = vscl(2.0f / q_residual.w, quatimagpart(q_residual));
 
-  // do a scalar update for each state
-  {
-    float h[KC_STATE_DIM] = {0};
-    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
-    h[KC_STATE_D0] = 1;
-    kalmanCoreScalarUpdate(this, &H, err_quat.x, pose->stdDevQuat);
-    h[KC_STATE_D0] = 0;
-
-    h[KC_STATE_D1] = 1;
-    kalmanCoreScalarUpdate(this, &H, err_quat.y, pose->stdDevQuat);
-    h[KC_STATE_D1] = 0;
+  // fuse position and orientation in one vector update
+  float h[6][KC_STATE_DIM] = {0};
+  arm_matrix_instance_f32 H = {6, KC_STATE_DIM, (float*)h};
+  float error[6];
+  float stdDev[6];
+  for (int i=0; i<3; i++) {
+    h[i][KC_STATE_X+i] = 1;
+    error[i] = pose->pos[i] - this->S[KC_STATE_X+i];
+    stdDev[i] = pose->stdDevPos;
 
-    h[KC_STATE_D2] = 1;
-    kalmanCoreScalarUpdate(this, &H, err_quat.z, pose->stdDevQuat);
+    h[3+i][KC_STATE_D0+i] = 1;
+    stdDev[3+i] = pose->stdDevQuat;
   }
+  error[3] = err_quat.x;
+  error[4] = err_quat.y;
+  error[5] = err_quat.z;
+
+  kalmanCoreVectorUpdate(this, &H, error, stdDev);
 }
@@ -27,12 +27,9 @@
 
 void kalmanCoreUpdateWithPosition(kalmanCoreData_t* this, positionMeasurement_t *xyz)
 {
-  // a direct measurement of states x, y, and z
-  // do a scalar update for each state, since this should be faster than updating all together
+  // a direct measurement of states x, y, and z. The noise of the axes is uncorrelated, sequential single state
+  // updates give the same result as one vector update without inverting the innovation covariance
   for (int i=0; i<3; i++) {
-    float h[KC_STATE_DIM] = {0};
-    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
-    h[KC_STATE_X+i] = 1;
-    kalmanCoreScalarUpdate(this, &H, xyz->pos[i] - this->S[KC_STATE_X+i], xyz->stdDev);
+    kalmanCoreStateUpdate(this, KC_STATE_X+i, xyz->pos[i] - this->S[KC_STATE_X+i], xyz->stdDev);
   }
 }
@@ -0,0 +1,130 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--'  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <math.h>
+
+#include "mm_robust.h"
+
+#define UPPER_BOUND (100)
+#define LOWER_BOUND (-100)
+
+void kalmanCoreRobustFactorize(float P[KC_STATE_DIM][KC_STATE_DIM], float L[KC_STATE_DIM][KC_STATE_DIM])
+{
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j <= i; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < j; k++) {
+        sum += L[i][k] * L[j][k];
+      }
+
+      if (j == i) {
+        L[i][i] = sqrtf(P[i][i] - sum);
+      } else {
+        L[i][j] = (P[i][j] - sum) / L[j][j];
+      }
+    }
+
+    for (int j = i + 1; j < KC_STATE_DIM; j++) {
+      L[i][j] = 0.0f;
+    }
+  }
+}
+
+void kalmanCoreRobustConditionFactor(float L[KC_STATE_DIM][KC_STATE_DIM])
+{
+  for (int col = 0; col < KC_STATE_DIM; col++) {
+    for (int row = col; row < KC_STATE_DIM; row++) {
+      if (isnan(L[row][col]) || L[row][col] > UPPER_BOUND) {
+        L[row][col] = UPPER_BOUND;
+      } else if (row != col && L[row][col] < LOWER_BOUND) {
+        L[row][col] = LOWER_BOUND;
+      } else if (row == col && L[row][col] < 0.0f) {
+        L[row][col] = 0.0f;
+      }
+    }
+  }
+
+  // Inversion is numerically sensitive, keep the diagonal away from zero
+  const float dummyValue = 1e-9f;
+  for (int k = 0; k < KC_STATE_DIM; k++) {
+    L[k][k] += dummyValue;
+  }
+}
+
+void kalmanCoreRobustSolveLower(float L[KC_STATE_DIM][KC_STATE_DIM], const float b[KC_STATE_DIM], float x[KC_STATE_DIM])
+{
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    float sum = b[i];
+    for (int k = 0; k < i; k++) {
+      sum -= L[i][k] * x[k];
+    }
+    x[i] = sum / L[i][i];
+  }
+}
+
+void kalmanCoreRobustReweightFactor(float L[KC_STATE_DIM][KC_STATE_DIM], const float weightsInv[KC_STATE_DIM])
+{
+  for (int col = 0; col < KC_STATE_DIM; col++) {
+    const float scale = sqrtf(weightsInv[col]);
+    for (int row = col; row < KC_STATE_DIM; row++) {
+      L[row][col] *= scale;
+    }
+  }
+}
+
+void kalmanCoreRobustFactorTimesVector(float L[KC_STATE_DIM][KC_STATE_DIM], const float x[KC_STATE_DIM], float y[KC_STATE_DIM])
+{
+  float ltx[KC_STATE_DIM];
+
+  for (int col = 0; col < KC_STATE_DIM; col++) {
+    float sum = 0.0f;
+    for (int row = col; row < KC_STATE_DIM; row++) {
+      sum += L[row][col] * x[row];
+    }
+    ltx[col] = sum;
+  }
+
+  for (int row = 0; row < KC_STATE_DIM; row++) {
+    float sum = 0.0f;
+    for (int col = 0; col <= row; col++) {
+      sum += L[row][col] * ltx[col];
+    }
+    y[row] = sum;
+  }
+}
+
+void kalmanCoreRobustFactorToMatrix(float L[KC_STATE_DIM][KC_STATE_DIM], float P[KC_STATE_DIM][KC_STATE_DIM])
+{
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j <= i; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k <= j; k++) {
+        sum += L[i][k] * L[j][k];
+      }
+      P[i][j] = sum;
+      P[j][i] = sum;
+    }
+  }
+}
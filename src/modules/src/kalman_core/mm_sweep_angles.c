@@ -23,18 +23,43 @@
  *
  */
 
+#include <string.h>
+
 #include "mm_sweep_angles.h"
 #include "outlierFilter.h"
 
 
-void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState) {
+static void rotateSensorPos(const kalmanCoreData_t *this, const float* scf, float* s) {
+  for (int i = 0; i < 3; i++) {
+    s[i] = this->R[i][0] * scf[0] + this->R[i][1] * scf[1] + this->R[i][2] * scf[2];
+  }
+}
+
+// Position of a sensor in the global reference frame relative to the CF. The rotation is cached per sensor and
+// only recomputed after the attitude (R) has been updated.
+static const float* rotatedSensorPos(kalmanCoreData_t *this, const sweepAngleMeasurement_t *sweepInfo, vec3d scratch) {
+  const uint8_t sensorId = sweepInfo->sensorId;
+  if (sensorId >= KC_SWEEP_SENSOR_CACHE_SIZE) {
+    rotateSensorPos(this, *sweepInfo->sensorPos, scratch);
+    return scratch;
+  }
+
+  const uint8_t mask = 1 << sensorId;
+  if (!(this->sweepSensorPosValid & mask)) {
+    rotateSensorPos(this, *sweepInfo->sensorPos, this->sweepSensorPos[sensorId]);
+    this->sweepSensorPosValid |= mask;
+  }
+
+  return this->sweepSensorPos[sensorId];
+}
+
+// Computes the innovation and the row of H (KC_STATE_DIM elements, zeroed by the caller) of a sweep angle.
+// Returns false if the sweep is rejected as an outlier or is too close to the singularity of the model.
+static bool sweepAngleRow(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState, float* h, float* error) {
   // Rotate the sensor position from CF reference frame to global reference frame,
-  // using the CF roatation matrix
-  vec3d s;
-  arm_matrix_instance_f32 Rcf_ = {3, 3, (float32_t *)this->R};
-  arm_matrix_instance_f32 scf_ = {3, 1, (float32_t *)*sweepInfo->sensorPos};
-  arm_matrix_instance_f32 s_ = {3, 1, s};
-  mat_mult(&Rcf_, &scf_, &s_);
+  // using the CF roatation matrix. Computed once per sensor until the attitude is updated.
+  vec3d scratch;
+  const float* s = rotatedSensorPos(this, sweepInfo, scratch);
 
   // Get the current state values of the position of the crazyflie (global reference frame) and add the relative sensor pos
   vec3d pcf = {this->S[KC_STATE_X] + s[0], this->S[KC_STATE_Y] + s[1], this->S[KC_STATE_Z] + s[2]};
@@ -42,53 +67,81 @@ void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasureme
   // Calculate the difference between the rotor and the sensor on the CF (global reference frame)
   const vec3d* pr = sweepInfo->rotorPos;
   vec3d stmp = {pcf[0] - (*pr)[0], pcf[1] - (*pr)[1], pcf[2] - (*pr)[2]};
-  arm_matrix_instance_f32 stmp_ = {3, 1, stmp};
 
   // Rotate the difference in position to the rotor reference frame,
   // using the rotor inverse rotation matrix
+  const mat3d* Rr_inv = sweepInfo->rotorRotInv;
   vec3d sr;
-  arm_matrix_instance_f32 Rr_inv_ = {3, 3, (float32_t *)(*sweepInfo->rotorRotInv)};
-  arm_matrix_instance_f32 sr_ = {3, 1, sr};
-  mat_mult(&Rr_inv_, &stmp_, &sr_);
+  for (int i = 0; i < 3; i++) {
+    sr[i] = (*Rr_inv)[i][0] * stmp[0] + (*Rr_inv)[i][1] * stmp[1] + (*Rr_inv)[i][2] * stmp[2];
+  }
 
   // The following computations are in the rotor refernece frame
   const float x = sr[0];
   const float y = sr[1];
   const float z = sr[2];
-  const float t = sweepInfo->t;
-  const float tan_t = tanf(t);
+  const float tan_t = sweepInfo->modelConstants->tanT;
 
   const float r2 = x * x + y * y;
   const float r = arm_sqrt(r2);
 
-  const float predictedSweepAngle = sweepInfo->calibrationMeasurementModel(x, y, z, t, sweepInfo->calib);
+  const float predictedSweepAngle = sweepInfo->calibrationMeasurementModel(x, y, z, sweepInfo->modelConstants, sweepInfo->calib);
   const float measuredSweepAngle = sweepInfo->measuredSweepAngle;
-  const float error = measuredSweepAngle - predictedSweepAngle;
-
-  if (outlierFilterValidateLighthouseSweep(sweepOutlierFilterState, r, error, tick)) {
-    // Calculate H vector (in the rotor reference frame)
-    const float z_tan_t = z * tan_t;
-    const float qNum = r2 - z_tan_t * z_tan_t;
-    // Avoid singularity
-    if (qNum > 0.0001f) {
-      const float q = tan_t / arm_sqrt(qNum);
-      vec3d gr = {(-y - x * z * q) / r2, (x - y * z * q) / r2 , q};
-
-      // gr is in the rotor reference frame, rotate back to the global
-      // reference frame using the rotor rotation matrix
-      vec3d g;
-      arm_matrix_instance_f32 gr_ = {3, 1, gr};
-      arm_matrix_instance_f32 Rr_ = {3, 3, (float32_t *)(*sweepInfo->rotorRot)};
-      arm_matrix_instance_f32 g_ = {3, 1, g};
-      mat_mult(&Rr_, &gr_, &g_);
-
-      float h[KC_STATE_DIM] = {0};
-      h[KC_STATE_X] = g[0];
-      h[KC_STATE_Y] = g[1];
-      h[KC_STATE_Z] = g[2];
-
-      arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
-      kalmanCoreScalarUpdate(this, &H, error, sweepInfo->stdDev);
+  *error = measuredSweepAngle - predictedSweepAngle;
+
+  if (!outlierFilterValidateLighthouseSweep(sweepOutlierFilterState, r, *error, tick)) {
+    return false;
+  }
+
+  // Calculate H vector (in the rotor reference frame)
+  const float z_tan_t = z * tan_t;
+  const float qNum = r2 - z_tan_t * z_tan_t;
+  // Avoid singularity
+  if (qNum <= 0.0001f) {
+    return false;
+  }
+
+  const float q = tan_t / arm_sqrt(qNum);
+  vec3d gr = {(-y - x * z * q) / r2, (x - y * z * q) / r2 , q};
+
+  // gr is in the rotor reference frame, rotate back to the global
+  // reference frame using the rotor rotation matrix
+  const mat3d* Rr = sweepInfo->rotorRot;
+  h[KC_STATE_X] = (*Rr)[0][0] * gr[0] + (*Rr)[0][1] * gr[1] + (*Rr)[0][2] * gr[2];
+  h[KC_STATE_Y] = (*Rr)[1][0] * gr[0] + (*Rr)[1][1] * gr[1] + (*Rr)[1][2] * gr[2];
+  h[KC_STATE_Z] = (*Rr)[2][0] * gr[0] + (*Rr)[2][1] * gr[1] + (*Rr)[2][2] * gr[2];
+
+  return true;
+}
+
+void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState) {
+  float h[KC_STATE_DIM] = {0};
+  float error;
+  if (sweepAngleRow(this, sweepInfo, tick, sweepOutlierFilterState, h, &error)) {
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+    kalmanCoreScalarUpdate(this, &H, error, sweepInfo->stdDev);
+  }
+}
+
+void kalmanCoreUpdateWithSweepAngleBatch(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweeps[], const int count, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState) {
+  float h[KC_MAX_VECTOR_UPDATE_DIM][KC_STATE_DIM] = {0};
+  float error[KC_MAX_VECTOR_UPDATE_DIM];
+  float stdDev[KC_MAX_VECTOR_UPDATE_DIM];
+  int rows = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (sweepAngleRow(this, sweeps[i], tick, sweepOutlierFilterState, h[rows], &error[rows])) {
+      stdDev[rows] = sweeps[i]->stdDev;
+      rows++;
+    }
+
+    // Rows after a full update are linearized around the updated state
+    const bool isLast = (i == count - 1);
+    if (rows == KC_MAX_VECTOR_UPDATE_DIM || (isLast && rows > 0)) {
+      arm_matrix_instance_f32 H = {rows, KC_STATE_DIM, (float*)h};
+      kalmanCoreVectorUpdate(this, &H, error, stdDev);
+      memset(h, 0, sizeof(h));
+      rows = 0;
     }
   }
 }
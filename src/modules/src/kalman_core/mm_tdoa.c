@@ -23,72 +23,144 @@
  *
  */
 
+#include <string.h>
+
 #include "mm_tdoa.h"
 #include "outlierFilter.h"
+#include "param.h"
 #include "test_support.h"
 
 // TODO krri What is this used for? Do we still need it?
 TESTABLE_STATIC uint32_t tdoaCount = 0;
 
-void kalmanCoreUpdateWithTDOA(kalmanCoreData_t* this, tdoaMeasurement_t *tdoa)
+// Max Mahalanobis distance of the innovation for single TDoA measurements, 0 to disable the gate
+TESTABLE_STATIC float tdoaMahalanobisGate = 0.0f;
+
+// Calculate the innovation and the measurement jacobian for one TDoA measurement.
+// Returns true if the measurement is usable and accepted by the outlier filter.
+static bool predictTdoa(const kalmanCoreData_t* this, tdoaMeasurement_t *tdoa, float* error, float h[KC_STATE_DIM])
 {
-  if (tdoaCount >= 100)
-  {
-    /**
-     * Measurement equation:
-     * dR = dT + d1 - d0
-     */
+  /**
+   * Measurement equation:
+   * dR = dT + d1 - d0
+   */
 
-    float measurement = tdoa->distanceDiff;
+  float measurement = tdoa->distanceDiff;
 
-    // predict based on current state
-    float x = this->S[KC_STATE_X];
-    float y = this->S[KC_STATE_Y];
-    float z = this->S[KC_STATE_Z];
+  // predict based on current state
+  float x = this->S[KC_STATE_X];
+  float y = this->S[KC_STATE_Y];
+  float z = this->S[KC_STATE_Z];
 
-    float x1 = tdoa->anchorPositions[1].x, y1 = tdoa->anchorPositions[1].y, z1 = tdoa->anchorPositions[1].z;
-    float x0 = tdoa->anchorPositions[0].x, y0 = tdoa->anchorPositions[0].y, z0 = tdoa->anchorPositions[0].z;
+  float x1 = tdoa->anchorPositions[1].x, y1 = tdoa->anchorPositions[1].y, z1 = tdoa->anchorPositions[1].z;
+  float x0 = tdoa->anchorPositions[0].x, y0 = tdoa->anchorPositions[0].y, z0 = tdoa->anchorPositions[0].z;
 
-    float dx1 = x - x1;
-    float dy1 = y - y1;
-    float dz1 = z - z1;
+  float dx1 = x - x1;
+  float dy1 = y - y1;
+  float dz1 = z - z1;
 
-    float dy0 = y - y0;
-    float dx0 = x - x0;
-    float dz0 = z - z0;
+  float dy0 = y - y0;
+  float dx0 = x - x0;
+  float dz0 = z - z0;
 
-    float d1 = sqrtf(powf(dx1, 2) + powf(dy1, 2) + powf(dz1, 2));
-    float d0 = sqrtf(powf(dx0, 2) + powf(dy0, 2) + powf(dz0, 2));
+  float d1 = sqrtf(powf(dx1, 2) + powf(dy1, 2) + powf(dz1, 2));
+  float d0 = sqrtf(powf(dx0, 2) + powf(dy0, 2) + powf(dz0, 2));
 
-    float predicted = d1 - d0;
-    float error = measurement - predicted;
+  float predicted = d1 - d0;
+  *error = measurement - predicted;
 
+  if ((d0 != 0.0f) && (d1 != 0.0f)) {
+    h[KC_STATE_X] = (dx1 / d1 - dx0 / d0);
+    h[KC_STATE_Y] = (dy1 / d1 - dy0 / d0);
+    h[KC_STATE_Z] = (dz1 / d1 - dz0 / d0);
+
+    vector_t jacobian = {
+      .x = h[KC_STATE_X],
+      .y = h[KC_STATE_Y],
+      .z = h[KC_STATE_Z],
+    };
+
+    point_t estimatedPosition = {
+      .x = this->S[KC_STATE_X],
+      .y = this->S[KC_STATE_Y],
+      .z = this->S[KC_STATE_Z],
+    };
+
+    return outlierFilterValidateTdoaSteps(tdoa, *error, &jacobian, &estimatedPosition);
+  }
+
+  return false;
+}
+
+void kalmanCoreUpdateWithTDOA(kalmanCoreData_t* this, tdoaMeasurement_t *tdoa)
+{
+  if (tdoaCount >= 100)
+  {
+    float error;
     float h[KC_STATE_DIM] = {0};
     arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
 
-    if ((d0 != 0.0f) && (d1 != 0.0f)) {
-      h[KC_STATE_X] = (dx1 / d1 - dx0 / d0);
-      h[KC_STATE_Y] = (dy1 / d1 - dy0 / d0);
-      h[KC_STATE_Z] = (dz1 / d1 - dz0 / d0);
+    bool sampleIsGood = predictTdoa(this, tdoa, &error, h);
+    if (sampleIsGood) {
+      if (tdoaMahalanobisGate > 0.0f) {
+        kalmanCoreScalarUpdateGated(this, &H, error, tdoa->stdDev, tdoaMahalanobisGate);
+      } else {
+        kalmanCoreScalarUpdate(this, &H, error, tdoa->stdDev);
+      }
+    }
+  }
+
+  tdoaCount++;
+}
 
-      vector_t jacobian = {
-        .x = h[KC_STATE_X],
-        .y = h[KC_STATE_Y],
-        .z = h[KC_STATE_Z],
-      };
+void kalmanCoreUpdateWithTDOABatch(kalmanCoreData_t* this, tdoaBatchMeasurement_t *tdoaBatch)
+{
+  if (tdoaCount >= 100)
+  {
+    // All rows are predicted from the same state and fused in one vector update
+    float h[TDOA_BATCH_MAX_COUNT * KC_STATE_DIM] = {0};
+    float errors[TDOA_BATCH_MAX_COUNT];
+    float stdDevs[TDOA_BATCH_MAX_COUNT];
+    int rows = 0;
 
-      point_t estimatedPosition = {
-        .x = this->S[KC_STATE_X],
-        .y = this->S[KC_STATE_Y],
-        .z = this->S[KC_STATE_Z],
-      };
+    for (int i = 0; i < tdoaBatch->count && i < TDOA_BATCH_MAX_COUNT; i++) {
+      tdoaMeasurement_t tdoa;
+      kalmanCoreTdoaBatchGetMeasurement(tdoaBatch, i, &tdoa);
 
-      bool sampleIsGood = outlierFilterValidateTdoaSteps(tdoa, error, &jacobian, &estimatedPosition);
+      bool sampleIsGood = predictTdoa(this, &tdoa, &errors[rows], &h[rows * KC_STATE_DIM]);
       if (sampleIsGood) {
-        kalmanCoreScalarUpdate(this, &H, error, tdoa->stdDev);
+        stdDevs[rows] = tdoa.stdDev;
+        rows++;
+      } else {
+        memset(&h[rows * KC_STATE_DIM], 0, KC_STATE_DIM * sizeof(float));
       }
     }
+
+    if (rows > 0) {
+      arm_matrix_instance_f32 H = {rows, KC_STATE_DIM, h};
+      kalmanCoreVectorUpdate(this, &H, errors, stdDevs);
+    }
   }
 
-  tdoaCount++;
+  tdoaCount += tdoaBatch->count;
 }
+
+void kalmanCoreTdoaBatchGetMeasurement(const tdoaBatchMeasurement_t *tdoaBatch, const int index, tdoaMeasurement_t *tdoa)
+{
+  const float* otherPosition = tdoaBatch->otherAnchorPositions[index];
+  tdoa->anchorPositions[0].x = otherPosition[0];
+  tdoa->anchorPositions[0].y = otherPosition[1];
+  tdoa->anchorPositions[0].z = otherPosition[2];
+  tdoa->anchorPositions[1].x = tdoaBatch->anchorPosition[0];
+  tdoa->anchorPositions[1].y = tdoaBatch->anchorPosition[1];
+  tdoa->anchorPositions[1].z = tdoaBatch->anchorPosition[2];
+  tdoa->anchorIds[0] = tdoaBatch->otherAnchorIds[index];
+  tdoa->anchorIds[1] = tdoaBatch->anchorId;
+  tdoa->distanceDiff = tdoaBatch->distanceDiffs[index];
+  tdoa->stdDev = tdoaBatch->stdDev;
+  tdoa->anchorDistanceSq = tdoaBatch->otherAnchorDistancesSq[index];
+}
+
+PARAM_GROUP_START(kalman)
+  PARAM_ADD(PARAM_FLOAT, tdoaGate, &tdoaMahalanobisGate)
+PARAM_GROUP_STOP(kalman)
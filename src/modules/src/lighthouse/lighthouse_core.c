@@ -37,6 +37,9 @@
 #include "log.h"
 #include "param.h"
 #include "statsCnt.h"
+#include "rateSupervisor.h"
+#include "usec_time.h"
+#include "eventtrigger.h"
 
 #define DEBUG_MODULE "LH"
 #include "debug.h"
@@ -58,6 +61,9 @@
 
 static const uint32_t MAX_WAIT_TIME_FOR_HEALTH_MS = 4000;
 
+// The frame rate depends on the number of base stations and sensors in view, it is measured but not bounded
+static rateSupervisor_t frameRateSupervisor;
+
 static pulseProcessorResult_t angles;
 static lighthouseUartFrame_t frame;
 static lighthouseBsIdentificationData_t bsIdentificationData;
@@ -79,9 +85,16 @@ static STATS_CNT_RATE_DEFINE(serialFrameRate, ONE_SECOND);
 static STATS_CNT_RATE_DEFINE(frameRate, ONE_SECOND);
 static STATS_CNT_RATE_DEFINE(cycleRate, ONE_SECOND);
 
-static STATS_CNT_RATE_DEFINE(bs0Rate, HALF_SECOND);
-static STATS_CNT_RATE_DEFINE(bs1Rate, HALF_SECOND);
-static statsCntRateLogger_t* bsRates[PULSE_PROCESSOR_N_BASE_STATIONS] = {&bs0Rate, &bs1Rate};
+// The rates of the first base stations are logged and must be valid before the deck is initialized,
+// the rest are initialized in lighthouseCoreInit()
+static statsCntRateLogger_t bsRates[PULSE_PROCESSOR_N_BASE_STATIONS] = {
+  [0] = STATS_CNT_RATE_INITIALIZER(bsRates[0], HALF_SECOND),
+  [1] = STATS_CNT_RATE_INITIALIZER(bsRates[1], HALF_SECOND),
+#if PULSE_PROCESSOR_N_BASE_STATIONS >= 4
+  [2] = STATS_CNT_RATE_INITIALIZER(bsRates[2], HALF_SECOND),
+  [3] = STATS_CNT_RATE_INITIALIZER(bsRates[3], HALF_SECOND),
+#endif
+};
 
 
 // A bitmap that indicates which base staions that are received
@@ -132,6 +145,10 @@ static void modifyBit(uint16_t *bitmap, const int index, const bool value) {
 }
 
 void lighthouseCoreInit() {
+  for (int baseStation = 0; baseStation < PULSE_PROCESSOR_N_BASE_STATIONS; baseStation++) {
+    STATS_CNT_RATE_INIT(&bsRates[baseStation], HALF_SECOND);
+  }
+
   lighthouseStorageInitializeSystemTypeFromStorage();
   lighthousePositionEstInit();
 }
@@ -201,13 +218,43 @@ void lighthouseCoreSetSystemType(const lighthouseBaseStationType_t type)
   lighthouseUpdateSystemType();
 }
 
+// Bytes are fetched from the UART in batches and frames are parsed from this buffer
+static uint8_t uartBuffer[UART_FRAME_LENGTH * 16];
+static uint32_t uartBufferLength = 0;
+static uint32_t uartBufferPosition = 0;
+
+static void fillUartBuffer() {
+  uartBufferPosition = 0;
+  do {
+    uartBufferLength = uart1GetBytesWithTimeout(uartBuffer, sizeof(uartBuffer), portMAX_DELAY);
+  } while (uartBufferLength == 0);
+}
+
+static uint8_t getUartByte() {
+  if (uartBufferPosition >= uartBufferLength) {
+    fillUartBuffer();
+  }
+  return uartBuffer[uartBufferPosition++];
+}
+
 TESTABLE_STATIC bool getUartFrameRaw(lighthouseUartFrame_t *frame) {
-  static char data[UART_FRAME_LENGTH];
+  static uint8_t frameData[UART_FRAME_LENGTH];
+  const uint8_t *data;
   int syncCounter = 0;
 
+  if (uartBufferLength - uartBufferPosition >= UART_FRAME_LENGTH) {
+    // The whole frame is buffered, parse it in place
+    data = &uartBuffer[uartBufferPosition];
+    uartBufferPosition += UART_FRAME_LENGTH;
+  } else {
+    for(int i = 0; i < UART_FRAME_LENGTH; i++) {
+      frameData[i] = getUartByte();
+    }
+    data = frameData;
+  }
+
   for(int i = 0; i < UART_FRAME_LENGTH; i++) {
-    uart1Getchar(&data[i]);
-    if ((unsigned char)data[i] == 0xff) {
+    if (data[i] == 0xff) {
       syncCounter += 1;
     }
   }
@@ -237,13 +284,13 @@ TESTABLE_STATIC bool getUartFrameRaw(lighthouseUartFrame_t *frame) {
 }
 
 TESTABLE_STATIC void waitForUartSynchFrame() {
-  char c;
+  uint8_t c;
   int syncCounter = 0;
   bool synchronized = false;
 
   while (!synchronized) {
-    uart1Getchar(&c);
-    if ((unsigned char)c == 0xff) {
+    c = getUartByte();
+    if (c == 0xff) {
       syncCounter += 1;
     } else {
       syncCounter = 0;
@@ -296,18 +343,16 @@ static void usePulseResultSweeps(pulseProcessor_t *appState, pulseProcessorResul
   pulseProcessorProcessed(angles, basestation);
 }
 
-static void convertV2AnglesToV1Angles(pulseProcessorResult_t* angles) {
+static void convertV2AnglesToV1Angles(pulseProcessorResult_t* angles, int basestation) {
   for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
-    for (int bs = 0; bs < PULSE_PROCESSOR_N_BASE_STATIONS; bs++) {
-      pulseProcessorBaseStationMeasuremnt_t* from = &angles->sensorMeasurementsLh2[sensor].baseStatonMeasurements[bs];
-      pulseProcessorBaseStationMeasuremnt_t* to = &angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[bs];
-
-      if (2 == from->validCount) {
-        pulseProcessorV2ConvertToV1Angles(from->correctedAngles[0], from->correctedAngles[1], to->correctedAngles);
-        to->validCount = from->validCount;
-      } else {
-        to->validCount = 0;
-      }
+    pulseProcessorBaseStationMeasuremnt_t* from = &angles->sensorMeasurementsLh2[sensor].baseStatonMeasurements[basestation];
+    pulseProcessorBaseStationMeasuremnt_t* to = &angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[basestation];
+
+    if (2 == from->validCount) {
+      pulseProcessorV2ConvertToV1Angles(from->correctedAngles[0], from->correctedAngles[1], to->correctedAngles);
+      to->validCount = from->validCount;
+    } else {
+      to->validCount = 0;
     }
   }
 }
@@ -321,7 +366,7 @@ static void usePulseResult(pulseProcessor_t *appState, pulseProcessorResult_t* a
     if (hasCalibrationData) {
       if (lighthouseBsTypeV2 == angles->measurementType) {
         // Emulate V1 base stations for now, convert to V1 angles
-        convertV2AnglesToV1Angles(angles);
+        convertV2AnglesToV1Angles(angles, basestation);
       }
 
       // Send measurement to the ground
@@ -374,15 +419,31 @@ static void useCalibrationData(pulseProcessor_t *appState) {
   }
 }
 
+// Raw frames from the deck, for recording of frame streams to replay in the pulse processor benchmark.
+// info: bits 0-1 sensor, bit 2 slowbit, bit 3 channelFound, bits 4-7 channel
+EVENTTRIGGER(lhFrame, uint8, info, uint32, ts, uint16, width, uint32, offset, uint32, beam)
+
+static void logRawFrame(const pulseProcessorFrame_t* data) {
+#ifndef UNIT_TEST_MODE
+  eventTrigger_lhFrame_payload.info = (data->sensor & 0x03) | ((data->slowbit & 0x01) << 2) | (data->channelFound ? 0x08 : 0) | ((data->channel & 0x0f) << 4);
+  eventTrigger_lhFrame_payload.ts = data->timestamp;
+  eventTrigger_lhFrame_payload.width = data->width;
+  eventTrigger_lhFrame_payload.offset = data->offset;
+  eventTrigger_lhFrame_payload.beam = data->beamData;
+  eventTrigger(&eventTrigger_lhFrame);
+#endif
+}
+
 static void processFrame(pulseProcessor_t *appState, pulseProcessorResult_t* angles, const lighthouseUartFrame_t* frame) {
     int basestation;
     int sweepId;
     bool calibDataIsDecoded = false;
 
+    logRawFrame(&frame->data);
     pulseWidth[frame->data.sensor] = frame->data.width;
 
     if (pulseProcessorProcessPulse(appState, &frame->data, angles, &basestation, &sweepId, &calibDataIsDecoded)) {
-        STATS_CNT_RATE_EVENT(bsRates[basestation]);
+        STATS_CNT_RATE_EVENT(&bsRates[basestation]);
         usePulseResult(appState, angles, basestation, sweepId);
     }
 
@@ -442,11 +503,11 @@ void lighthouseCoreTask(void *param) {
   bool isUartFrameValid = false;
 
   uart1Init(230400);
+  uart1InitRxDma();
   systemWaitStart();
 
-  lighthouseStorageVerifySetStorageVersion();
-  lighthouseStorageInitializeGeoDataFromStorage();
-  lighthouseStorageInitializeCalibDataFromStorage();
+  // Read stored data in the worker task while the FPGA boots
+  lighthouseStorageInitializeDataFromStorageBackground();
 
   if (lighthouseDeckFlasherCheckVersionAndBoot() == false) {
     DEBUG_PRINT("FPGA not booted. Lighthouse disabled!\n");
@@ -456,11 +517,18 @@ void lighthouseCoreTask(void *param) {
   }
   deckIsFlashed = true;
 
+  while (! lighthouseStorageIsDataInitialized()) {
+    vTaskDelay(M2T(1));
+  }
+
 
   vTaskDelay(M2T(100));
 
   memset(&bsIdentificationData, 0, sizeof(bsIdentificationData));
 
+  rateSupervisorInitRate(&frameRateSupervisor, T2M(xTaskGetTickCount()), 0, 0, 0);
+  rateSupervisorRegister(&frameRateSupervisor, "lighthouse");
+
   while(1) {
     memset(pulseWidth, 0, sizeof(pulseWidth[0]) * PULSE_PROCESSOR_N_SENSORS);
     waitForUartSynchFrame();
@@ -478,6 +546,7 @@ void lighthouseCoreTask(void *param) {
       // Now we are receiving items
       else if(!frame.isSyncFrame) {
         STATS_CNT_RATE_EVENT(&frameRate);
+        rateSupervisorTick(&frameRateSupervisor, now_ms, (uint32_t)usecTimestamp());
 
         deckHealthCheck(&lighthouseCoreState, &frame, now_ms);
         lighthouseUpdateSystemType();
@@ -548,8 +617,12 @@ STATS_CNT_RATE_LOG_ADD(serRt, &serialFrameRate)
 STATS_CNT_RATE_LOG_ADD(frmRt, &frameRate)
 STATS_CNT_RATE_LOG_ADD(cycleRt, &cycleRate)
 
-STATS_CNT_RATE_LOG_ADD(bs0Rt, &bs0Rate)
-STATS_CNT_RATE_LOG_ADD(bs1Rt, &bs1Rate)
+STATS_CNT_RATE_LOG_ADD(bs0Rt, &bsRates[0])
+STATS_CNT_RATE_LOG_ADD(bs1Rt, &bsRates[1])
+#if PULSE_PROCESSOR_N_BASE_STATIONS >= 4
+STATS_CNT_RATE_LOG_ADD(bs2Rt, &bsRates[2])
+STATS_CNT_RATE_LOG_ADD(bs3Rt, &bsRates[3])
+#endif
 
 LOG_ADD(LOG_UINT16, width0, &pulseWidth[0])
 LOG_ADD(LOG_UINT16, width1, &pulseWidth[1])
@@ -566,6 +639,11 @@ LOG_ADD(LOG_UINT16, bsCalCon, &baseStationCalibConfirmedMap)
 LOG_ADD(LOG_UINT8, status, &systemStatus)
 LOG_GROUP_STOP(lighthouse)
 
+/**
+ * Rate of the processed sensor frames, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateLh, frameRateSupervisor)
+
 PARAM_GROUP_START(lighthouse)
 PARAM_ADD(PARAM_UINT8, method, &estimationMethod)
 PARAM_ADD(PARAM_UINT8, bsCalibReset, &calibStatusReset)
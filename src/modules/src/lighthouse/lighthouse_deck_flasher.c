@@ -37,7 +37,6 @@
 #include "deck_core.h"
 #include "lh_bootloader.h"
 #include "lighthouse_deck_flasher.h"
-#include "crc32.h"
 #include "mem.h"
 
 #include "FreeRTOS.h"
@@ -51,9 +50,20 @@
 // We read the version string in the read buffer and we need one byte for null termination
 #define VERSION_STRING_MAX_LENGTH (READ_BUFFER_LENGTH - 1)
 
+#define FLASH_PAGE_SIZE 256
+
 static bool inBootloaderMode = true;
 static bool hasStarted = false;
 
+// Data written through the memory subsystem arrives in small chunks. It is collected to a full page that is sent to the
+// deck in one transaction, and the flash programs the page while the next one is received here. The wait for the
+// program to finish is done just before the next page is sent.
+static uint8_t pageBuffer[FLASH_PAGE_SIZE];
+static uint32_t pageAddress;
+static uint16_t pageStart;
+static uint16_t pageEnd;
+static bool isProgramming = false;
+
 bool lighthouseDeckFlasherCheckVersionAndBoot() {
   lhblInit();
 
@@ -81,16 +91,9 @@ bool lighthouseDeckFlasherCheckVersionAndBoot() {
   int deckVersion = strtol(&deckBitstream[2], NULL, 10);
 
   // Checking that the bitstream has the right checksum
-  crc32Context_t crcContext;
-  crc32ContextInit(&crcContext);
-
-  for (int i=0; i<=LIGHTHOUSE_BITSTREAM_SIZE; i+=READ_BUFFER_LENGTH) {
-    int length = ((i + READ_BUFFER_LENGTH) < LIGHTHOUSE_BITSTREAM_SIZE)?READ_BUFFER_LENGTH:LIGHTHOUSE_BITSTREAM_SIZE-i;
-    lhblFlashRead(LH_FW_ADDR + i, length, (uint8_t*)deckBitstream);
-    crc32Update(&crcContext, deckBitstream, length);
-  }
+  uint32_t crc = 0;
+  lhblFlashCrc32(LH_FW_ADDR, LIGHTHOUSE_BITSTREAM_SIZE, &crc);
 
-  uint32_t crc = crc32Out(&crcContext);
   bool pass = crc == LIGHTHOUSE_BITSTREAM_CRC;
   DEBUG_PRINT("Bitstream CRC32: %x %s\n", (int)crc, pass?"[PASS]":"[FAIL]");
 
@@ -110,9 +113,38 @@ bool lighthouseDeckFlasherCheckVersionAndBoot() {
   return pass;
 }
 
+static bool flushPage() {
+  bool pass = true;
+
+  if (pageEnd > pageStart) {
+    if (isProgramming) {
+      pass = lhblFlashWaitComplete();
+    }
+
+    pass = pass && lhblFlashWritePage(pageAddress + pageStart, pageEnd - pageStart, &pageBuffer[pageStart]);
+    isProgramming = pass;
+  }
+
+  pageStart = 0;
+  pageEnd = 0;
+
+  return pass;
+}
+
 bool lighthouseDeckFlasherRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer)
 {
   if (inBootloaderMode) {
+    if (flushPage() == false) {
+      return false;
+    }
+
+    if (isProgramming) {
+      isProgramming = false;
+      if (lhblFlashWaitComplete() == false) {
+        return false;
+      }
+    }
+
     return lhblFlashRead(LH_FW_ADDR + memAddr, readLen, buffer);
   } else {
     return false;
@@ -121,8 +153,16 @@ bool lighthouseDeckFlasherRead(const uint32_t memAddr, const uint8_t readLen, ui
 
 bool lighthouseDeckFlasherWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer)
 {
-  bool pass;
+  bool pass = true;
   if (memAddr == 0) {
+    // A new upgrade, data of an earlier one that has not been written is dropped
+    pageStart = 0;
+    pageEnd = 0;
+    if (isProgramming) {
+      isProgramming = false;
+      lhblFlashWaitComplete();
+    }
+
     pass = lhblFlashEraseFirmware();
 
     if (pass == false) {
@@ -132,28 +172,50 @@ bool lighthouseDeckFlasherWrite(const uint32_t memAddr, const uint8_t writeLen,
 
   uint32_t address = LH_FW_ADDR + memAddr;
 
-  // This function can be called with a buffer spanning 2 pages
-  // Try to find the first byte of the second page if this is the case
-  int pageSplit = 0;
-  for (int i=0; i<writeLen; i++) {
-    if (((address + i) & 0x0ff) == 0) {
-      pageSplit = i;
-      break;
+  // The buffer can span 2 pages
+  int index = 0;
+  while (index < writeLen) {
+    const uint32_t page = (address + index) & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+    const uint16_t offset = (address + index) - page;
+
+    // Only data that follows the data already in the page can be added to it
+    if (pageEnd > pageStart && (page != pageAddress || offset != pageEnd)) {
+      pass = flushPage();
+      if (pass == false) {
+        return pass;
+      }
     }
-  }
 
-  // Flashing first page
-  if (pageSplit > 0) {
-    pass = lhblFlashWritePage(address, pageSplit, buffer);
+    if (pageEnd == pageStart) {
+      pageAddress = page;
+      pageStart = offset;
+      pageEnd = offset;
+    }
 
-    if (pass == false) {
-      return pass;
+    int length = writeLen - index;
+    if (length > FLASH_PAGE_SIZE - offset) {
+      length = FLASH_PAGE_SIZE - offset;
+    }
+
+    memcpy(&pageBuffer[offset], &buffer[index], length);
+    pageEnd += length;
+    index += length;
+
+    if (pageEnd == FLASH_PAGE_SIZE) {
+      pass = flushPage();
+      if (pass == false) {
+        return pass;
+      }
     }
   }
 
-  // Flashing second page if necessary
-  if ((writeLen-pageSplit) > 0) {
-    pass = lhblFlashWritePage(address+pageSplit, writeLen-pageSplit, &buffer[pageSplit]);
+  // The last page of the bitstream is not full, write it and let the flash finish before the system is restarted
+  if (memAddr + writeLen >= LIGHTHOUSE_BITSTREAM_SIZE) {
+    pass = flushPage();
+    if (pass && isProgramming) {
+      isProgramming = false;
+      pass = lhblFlashWaitComplete();
+    }
   }
 
   return pass;
@@ -162,6 +224,12 @@ bool lighthouseDeckFlasherWrite(const uint32_t memAddr, const uint8_t writeLen,
 uint8_t lighthouseDeckFlasherPropertiesQuery() {
   uint8_t result = 0;
 
+  // A bitstream of an other size than the required one can end with a partial page, it is written at the latest when
+  // the host reads the deck memory info
+  if (inBootloaderMode) {
+    flushPage();
+  }
+
   if (hasStarted) {
     result |= DECK_MEMORY_MASK_STARTED;
   }
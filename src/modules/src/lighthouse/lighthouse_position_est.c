@@ -43,9 +43,15 @@
 #define ONE_SECOND 1000
 #define HALF_SECOND 500
 static STATS_CNT_RATE_DEFINE(positionRate, ONE_SECOND);
-static STATS_CNT_RATE_DEFINE(estBs0Rate, HALF_SECOND);
-static STATS_CNT_RATE_DEFINE(estBs1Rate, HALF_SECOND);
-static statsCntRateLogger_t* bsEstRates[PULSE_PROCESSOR_N_BASE_STATIONS] = {&estBs0Rate, &estBs1Rate};
+// The rates of the first base stations are logged, the rest are initialized in lighthousePositionEstInit()
+static statsCntRateLogger_t bsEstRates[PULSE_PROCESSOR_N_BASE_STATIONS] = {
+  [0] = STATS_CNT_RATE_INITIALIZER(bsEstRates[0], HALF_SECOND),
+  [1] = STATS_CNT_RATE_INITIALIZER(bsEstRates[1], HALF_SECOND),
+#if PULSE_PROCESSOR_N_BASE_STATIONS >= 4
+  [2] = STATS_CNT_RATE_INITIALIZER(bsEstRates[2], HALF_SECOND),
+  [3] = STATS_CNT_RATE_INITIALIZER(bsEstRates[3], HALF_SECOND),
+#endif
+};
 
 // The light planes in LH2 are tilted +- 30 degrees
 static const float t30 = M_PI / 6;
@@ -78,7 +84,9 @@ static void modifyBit(uint16_t *bitmap, const int index, const bool value) {
 
 void lighthousePositionEstInit() {
   for (int i = 0; i < PULSE_PROCESSOR_N_BASE_STATIONS; i++) {
+    STATS_CNT_RATE_INIT(&bsEstRates[i], HALF_SECOND);
     lighthousePositionGeometryDataUpdated(i);
+    lighthousePositionCalibrationDataWritten(i);
   }
   memoryRegisterHandler(&memDef);
 }
@@ -161,7 +169,15 @@ static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const
 
 void lighthousePositionCalibrationDataWritten(const uint8_t baseStation) {
   if (baseStation < PULSE_PROCESSOR_N_BASE_STATIONS) {
-    modifyBit(&lighthouseCoreState.baseStationCalibValidMap, baseStation, lighthouseCoreState.bsCalibration[baseStation].valid);
+    const lighthouseCalibration_t* calib = &lighthouseCoreState.bsCalibration[baseStation];
+    lighthouseCalibrationModelConstants_t* lh1 = lighthouseCoreState.bsModelConstantsLh1[baseStation];
+    lighthouseCalibrationModelConstants_t* lh2 = lighthouseCoreState.bsModelConstantsLh2[baseStation];
+    lighthouseCalibrationInitModelConstants(&lh1[0], 0, &calib->sweep[0]);
+    lighthouseCalibrationInitModelConstants(&lh1[1], 0, &calib->sweep[1]);
+    lighthouseCalibrationInitModelConstants(&lh2[0], -t30, &calib->sweep[0]);
+    lighthouseCalibrationInitModelConstants(&lh2[1], t30, &calib->sweep[1]);
+
+    modifyBit(&lighthouseCoreState.baseStationCalibValidMap, baseStation, calib->valid);
   }
 }
 
@@ -221,29 +237,54 @@ static vec3d position;
 static vec3d positionLog;
 static float deltaLog;
 
-static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+// Finds the position of one sensor from the rays of all base stations that have geometry data and
+// angles for the sensor. Returns a bitmap of the base stations used, 0 if the position could not be found.
+static uint16_t estimateSensorPositionCrossingBeams(const pulseProcessor_t *state, const pulseProcessorResult_t* angles, const int sensor, vec3d sensorPosition, float* delta) {
+  vec3d origins[PULSE_PROCESSOR_N_BASE_STATIONS];
+  vec3d rays[PULSE_PROCESSOR_N_BASE_STATIONS];
+  uint16_t baseStationsUsed = 0;
+  int rayCount = 0;
+
+  for (int bs = 0; bs < PULSE_PROCESSOR_N_BASE_STATIONS; bs++) {
+    // LH2 angles are converted to LH1 angles, so it is OK to use sensorMeasurementsLh1
+    const pulseProcessorBaseStationMeasuremnt_t* bsMeasurement = &angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[bs];
+    if (state->bsGeometry[bs].valid && bsMeasurement->validCount == PULSE_PROCESSOR_N_SWEEPS) {
+      lighthouseGeometryGetBaseStationPosition(&state->bsGeometry[bs], origins[rayCount]);
+      lighthouseGeometryGetRay(&state->bsGeometry[bs], bsMeasurement->correctedAngles[0], bsMeasurement->correctedAngles[1], rays[rayCount]);
+      baseStationsUsed |= (1 << bs);
+      rayCount++;
+    }
+  }
+
+  if (! lighthouseGeometryGetPositionFromRays((const vec3d*)origins, (const vec3d*)rays, rayCount, sensorPosition, delta)) {
+    return 0;
+  }
+
+  return baseStationsUsed;
+}
+
+// Returns a bitmap of the base stations that were used for all sensors, 0 if no position was estimated
+static uint16_t estimatePositionCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
   memset(&ext_pos, 0, sizeof(ext_pos));
   uint8_t sensorsUsed = 0;
+  uint16_t baseStationsUsedByAll = 0xffff;
   float deltaSum = 0;
   float delta;
 
-  // Average over all sensors with valid data
+  // Average over all sensors with valid data, each sensor position is a least squares fit to the rays of all
+  // visible base stations
   for (size_t sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
-      // LH2 angles are converted to LH1 angles, so it is OK to use sensorMeasurementsLh1
-      pulseProcessorBaseStationMeasuremnt_t* bs0Measurement = &angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[0];
-      pulseProcessorBaseStationMeasuremnt_t* bs1Measurement = &angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[1];
+    const uint16_t baseStationsUsed = estimateSensorPositionCrossingBeams(state, angles, sensor, position, &delta);
+    if (baseStationsUsed) {
+      deltaSum += delta;
 
-      if (bs0Measurement->validCount == PULSE_PROCESSOR_N_SWEEPS && bs1Measurement->validCount == PULSE_PROCESSOR_N_SWEEPS) {
-        lighthouseGeometryGetPositionFromRayIntersection(state->bsGeometry, bs0Measurement->correctedAngles, bs1Measurement->correctedAngles, position, &delta);
+      ext_pos.x += position[0];
+      ext_pos.y += position[1];
+      ext_pos.z += position[2];
+      sensorsUsed++;
+      baseStationsUsedByAll &= baseStationsUsed;
 
-        deltaSum += delta;
-
-        ext_pos.x += position[0];
-        ext_pos.y += position[1];
-        ext_pos.z += position[2];
-        sensorsUsed++;
-
-        STATS_CNT_RATE_EVENT(&positionRate);
+      STATS_CNT_RATE_EVENT(&positionRate);
     }
   }
 
@@ -266,10 +307,13 @@ static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulsePr
       ext_pos.stdDev = 0.01;
       ext_pos.source = MeasurementSourceLighthouse;
       estimatorEnqueuePosition(&ext_pos);
+      return baseStationsUsedByAll;
     }
   } else {
     deltaLog = 0;
   }
+
+  return 0;
 }
 
 static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation) {
@@ -292,10 +336,11 @@ static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulsePro
         sweepInfo.rotorRot = &appState->bsGeometry[baseStation].mat;
         sweepInfo.rotorRotInv = &appState->bsGeoCache[baseStation].baseStationInvertedRotationMatrixes;
         sweepInfo.calib = &bsCalib->sweep[0];
+        sweepInfo.modelConstants = &appState->bsModelConstantsLh1[baseStation][0];
         sweepInfo.sweepId = 0;
 
         estimatorEnqueueSweepAngles(&sweepInfo);
-        STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
+        STATS_CNT_RATE_EVENT(&bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
       }
 
@@ -304,10 +349,11 @@ static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulsePro
         sweepInfo.rotorRot = &appState->bsGeoCache[baseStation].lh1Rotor2RotationMatrixes;
         sweepInfo.rotorRotInv = &appState->bsGeoCache[baseStation].lh1Rotor2InvertedRotationMatrixes;
         sweepInfo.calib = &bsCalib->sweep[1];
+        sweepInfo.modelConstants = &appState->bsModelConstantsLh1[baseStation][1];
         sweepInfo.sweepId = 1;
 
         estimatorEnqueueSweepAngles(&sweepInfo);
-        STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
+        STATS_CNT_RATE_EVENT(&bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
       }
     }
@@ -334,9 +380,10 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
       if (sweepInfo.measuredSweepAngle != 0) {
         sweepInfo.t = -t30;
         sweepInfo.calib = &bsCalib->sweep[0];
+        sweepInfo.modelConstants = &appState->bsModelConstantsLh2[baseStation][0];
         sweepInfo.sweepId = 0;
         estimatorEnqueueSweepAngles(&sweepInfo);
-        STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
+        STATS_CNT_RATE_EVENT(&bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
       }
 
@@ -344,9 +391,10 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
       if (sweepInfo.measuredSweepAngle != 0) {
         sweepInfo.t = t30;
         sweepInfo.calib = &bsCalib->sweep[1];
+        sweepInfo.modelConstants = &appState->bsModelConstantsLh2[baseStation][1];
         sweepInfo.sweepId = 1;
         estimatorEnqueueSweepAngles(&sweepInfo);
-        STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
+        STATS_CNT_RATE_EVENT(&bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
       }
     }
@@ -411,7 +459,8 @@ static bool estimateYawDeltaOneBaseStation(const int bs, const pulseProcessorRes
   }
 }
 
-static void estimateYaw(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+// Estimates the yaw error from the base stations in the baseStations bitmap
+static void estimateYaw(const pulseProcessor_t *state, pulseProcessorResult_t* angles, const uint16_t baseStations) {
   // TODO Most of these calculations should be moved into the estimator instead. It is a
   // bit dirty to get the state from the kalman filer here and calculate the yaw error outside
   // the estimator, but it will do for now.
@@ -429,35 +478,47 @@ static void estimateYaw(const pulseProcessor_t *state, pulseProcessorResult_t* a
   // Normal to the deck: (0, 0, 1), rotated using the rotation matrix
   const vec3d n = {R[0][2], R[1][2], R[2][2]};
 
-  // Calculate yaw delta using only one base station for now
-  float yawDelta;
-  if (estimateYawDeltaOneBaseStation(baseStation, angles, state->bsGeometry, cfPos, n, &RR, &yawDelta)) {
-    yawErrorMeasurement_t yawDeltaMeasurement = {.yawError = yawDelta, .stdDev = 0.01};
+  // Average the yaw delta of the base stations, to push one yaw error measurement
+  float yawDeltaSum = 0.0f;
+  int yawDeltaCount = 0;
+  for (int bs = 0; bs < PULSE_PROCESSOR_N_BASE_STATIONS; bs++) {
+    float yawDelta;
+    if ((baseStations & (1 << bs)) && estimateYawDeltaOneBaseStation(bs, angles, state->bsGeometry, cfPos, n, &RR, &yawDelta)) {
+      yawDeltaSum += yawDelta;
+      yawDeltaCount++;
+    }
+  }
+
+  if (yawDeltaCount > 0) {
+    yawErrorMeasurement_t yawDeltaMeasurement = {.yawError = yawDeltaSum / yawDeltaCount, .stdDev = 0.01};
     estimatorEnqueueYawError(&yawDeltaMeasurement);
   }
 }
 
 void lighthousePositionEstimatePoseCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
-  if (state->bsGeometry[0].valid && state->bsGeometry[1].valid) {
-    estimatePositionCrossingBeams(state, angles, baseStation);
-    estimateYaw(state, angles, baseStation);
-  } else {
-    deltaLog = 0;
+  // Sensors need rays from at least two base stations with geometry data
+  const uint16_t baseStationsUsed = estimatePositionCrossingBeams(state, angles, baseStation);
+  if (baseStationsUsed) {
+    estimateYaw(state, angles, baseStationsUsed);
   }
 }
 
 void lighthousePositionEstimatePoseSweeps(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
   if (state->bsGeometry[baseStation].valid) {
     estimatePositionSweeps(state, angles, baseStation);
-    estimateYaw(state, angles, baseStation);
+    estimateYaw(state, angles, 1 << baseStation);
   }
 }
 
 
 LOG_GROUP_START(lighthouse)
 STATS_CNT_RATE_LOG_ADD(posRt, &positionRate)
-STATS_CNT_RATE_LOG_ADD(estBs0Rt, &estBs0Rate)
-STATS_CNT_RATE_LOG_ADD(estBs1Rt, &estBs1Rate)
+STATS_CNT_RATE_LOG_ADD(estBs0Rt, &bsEstRates[0])
+STATS_CNT_RATE_LOG_ADD(estBs1Rt, &bsEstRates[1])
+#if PULSE_PROCESSOR_N_BASE_STATIONS >= 4
+STATS_CNT_RATE_LOG_ADD(estBs2Rt, &bsEstRates[2])
+STATS_CNT_RATE_LOG_ADD(estBs3Rt, &bsEstRates[3])
+#endif
 
 LOG_ADD(LOG_FLOAT, x, &positionLog[0])
 LOG_ADD(LOG_FLOAT, y, &positionLog[1])
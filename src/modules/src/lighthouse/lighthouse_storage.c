@@ -25,12 +25,16 @@
  * lighthouse_storage.c - persistent storage of lighthouse data
  */
 
+#include <stddef.h>
+#include <string.h>
+
 #include "storage.h"
 #include "lighthouse_storage.h"
 #include "lighthouse_state.h"
 #include "lighthouse_position_est.h"
 #include "lighthouse_core.h"
 #include "worker.h"
+#include "crc32.h"
 
 #include "test_support.h"
 #include "cfassert.h"
@@ -44,20 +48,37 @@
 #define STORAGE_KEY_GEO "lh/sys/0/geo/"
 #define STORAGE_KEY_CALIB "lh/sys/0/cal/"
 #define STORAGE_KEY_SYSTEM_TYPE "lh/sys/0/type"
+#define STORAGE_KEY_BOOT_DATA "lh/sys/0/boot"
 #define KEY_LEN 20
 
+#define BOOT_DATA_VERSION 1
+
+// A copy of the geometry and calibration data of all base stations, read with one fetch at start up
+typedef struct {
+  uint8_t version;
+  uint8_t nrOfBaseStations;
+  baseStationGeometry_t geometry[PULSE_PROCESSOR_N_BASE_STATIONS];
+  lighthouseCalibration_t calibration[PULSE_PROCESSOR_N_BASE_STATIONS];
+  uint32_t crc;
+} bootData_t;
+
 static baseStationGeometry_t geoBuffer;
 static lighthouseCalibration_t calibBuffer;
+static bootData_t bootDataBuffer;
+
+static volatile bool isDataInitialized = false;
 
 
 static void generateStorageKey(char* buf, const char* base, const uint8_t baseStation) {
-  // TOOD make an implementation that supports baseStations with 2 digits
-  ASSERT(baseStation <= 9);
+  ASSERT(baseStation <= 99);
 
-  const int baseLen = strlen(base);
-  memcpy(buf, base, baseLen);
-  buf[baseLen] = '0' + baseStation;
-  buf[baseLen + 1] = '\0';
+  int len = strlen(base);
+  memcpy(buf, base, len);
+  if (baseStation > 9) {
+    buf[len++] = '0' + baseStation / 10;
+  }
+  buf[len++] = '0' + baseStation % 10;
+  buf[len] = '\0';
 }
 
 bool lighthouseStoragePersistData(const uint8_t baseStation, const bool geoData, const bool calibData) {
@@ -86,11 +107,26 @@ static void lhPersistDataWorker(void* arg) {
   if (! lighthouseStoragePersistData(baseStation, storeGeo, storeCalibration)) {
     DEBUG_PRINT("WARNING: Failed to persist calibration data for base station %i\n", baseStation + 1);
   }
+
+  if (! lighthouseStoragePersistBootData()) {
+    DEBUG_PRINT("WARNING: Failed to persist boot data\n");
+  }
+}
+
+bool lighthouseStoragePersistBootData() {
+  memset(&bootDataBuffer, 0, sizeof(bootDataBuffer));
+  bootDataBuffer.version = BOOT_DATA_VERSION;
+  bootDataBuffer.nrOfBaseStations = PULSE_PROCESSOR_N_BASE_STATIONS;
+  memcpy(bootDataBuffer.geometry, lighthouseCoreState.bsGeometry, sizeof(bootDataBuffer.geometry));
+  memcpy(bootDataBuffer.calibration, lighthouseCoreState.bsCalibration, sizeof(bootDataBuffer.calibration));
+  bootDataBuffer.crc = crc32CalculateBuffer(&bootDataBuffer, offsetof(bootData_t, crc));
+
+  return storageStore(STORAGE_KEY_BOOT_DATA, &bootDataBuffer, sizeof(bootDataBuffer));
 }
 
 void lighthouseStoragePersistCalibDataBackground(const uint8_t baseStation) {
   if (baseStation < PULSE_PROCESSOR_N_BASE_STATIONS) {
-    workerSchedule(lhPersistDataWorker, (void*)(uint32_t)baseStation);
+    workerScheduleWithPriority(workerPriorityLow, lhPersistDataWorker, (void*)(uint32_t)baseStation);
   }
 }
 
@@ -153,3 +189,55 @@ void lighthouseStorageInitializeSystemTypeFromStorage() {
     lighthouseCoreSetSystemType(type);
   } 
 }
+
+TESTABLE_STATIC bool lighthouseStorageInitializeFromBootData() {
+  const size_t fetched = storageFetch(STORAGE_KEY_BOOT_DATA, &bootDataBuffer, sizeof(bootDataBuffer));
+  if (fetched != sizeof(bootDataBuffer)) {
+    return false;
+  }
+
+  if (bootDataBuffer.version != BOOT_DATA_VERSION || bootDataBuffer.nrOfBaseStations != PULSE_PROCESSOR_N_BASE_STATIONS) {
+    return false;
+  }
+
+  if (bootDataBuffer.crc != crc32CalculateBuffer(&bootDataBuffer, offsetof(bootData_t, crc))) {
+    return false;
+  }
+
+  for (int baseStation = 0; baseStation < PULSE_PROCESSOR_N_BASE_STATIONS; baseStation++) {
+    if (bootDataBuffer.geometry[baseStation].valid && !lighthouseCoreState.bsGeometry[baseStation].valid) {
+      lighthousePositionSetGeometryData(baseStation, &bootDataBuffer.geometry[baseStation]);
+    }
+    if (bootDataBuffer.calibration[baseStation].valid && !lighthouseCoreState.bsCalibration[baseStation].valid) {
+      lighthouseCoreSetCalibrationData(baseStation, &bootDataBuffer.calibration[baseStation]);
+    }
+  }
+
+  return true;
+}
+
+void lighthouseStorageInitializeDataFromStorage() {
+  if (! lighthouseStorageInitializeFromBootData()) {
+    // No boot data, or data from an older firmware. Fetch the items one by one and create the boot data
+    lighthouseStorageVerifySetStorageVersion();
+    lighthouseStorageInitializeGeoDataFromStorage();
+    lighthouseStorageInitializeCalibDataFromStorage();
+    lighthouseStoragePersistBootData();
+  }
+}
+
+static void lhInitializeDataWorker(void* arg) {
+  lighthouseStorageInitializeDataFromStorage();
+  isDataInitialized = true;
+}
+
+void lighthouseStorageInitializeDataFromStorageBackground() {
+  isDataInitialized = false;
+  if (workerScheduleWithPriority(workerPriorityLow, lhInitializeDataWorker, 0) != 0) {
+    lhInitializeDataWorker(0);
+  }
+}
+
+bool lighthouseStorageIsDataInitialized() {
+  return isDataInitialized;
+}
@@ -0,0 +1,134 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * lighthouse_storage_writer.c - deferred writes of lighthouse data to permanent storage
+ *
+ * Writing to the EEPROM is slow, the writes are done by a low priority task instead of the worker to avoid
+ * delaying log blocks and other work in the worker queue.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "config.h"
+#include "static_mem.h"
+#include "lighthouse_storage_writer.h"
+#include "lighthouse_storage.h"
+#include "pulse_processor.h"
+
+#define DEBUG_MODULE "LH_STORE"
+#include "debug.h"
+
+#define MAX_PENDING_CALLBACKS 4
+
+static bool isInit = false;
+static TaskHandle_t taskHandle;
+
+// Pending requests, protected by a critical section
+static uint16_t pendingGeoDataBsField;
+static uint16_t pendingCalibDataBsField;
+static lighthouseStorageWriterDoneCallback_t pendingCallbacks[MAX_PENDING_CALLBACKS];
+static int pendingCallbackCount;
+
+static void lighthouseStorageWriterTask(void* param);
+STATIC_MEM_TASK_ALLOC(lighthouseStorageWriterTask, LH_STORAGE_WRITER_TASK_STACKSIZE);
+
+void lighthouseStorageWriterInit() {
+  if (isInit) {
+    return;
+  }
+
+  taskHandle = STATIC_MEM_TASK_CREATE(lighthouseStorageWriterTask, lighthouseStorageWriterTask, LH_STORAGE_WRITER_TASK_NAME, NULL, LH_STORAGE_WRITER_TASK_PRI);
+  isInit = true;
+}
+
+bool lighthouseStorageWriterRequest(const uint16_t geoDataBsField, const uint16_t calibDataBsField, lighthouseStorageWriterDoneCallback_t doneCallback) {
+  if (!isInit) {
+    return false;
+  }
+
+  bool result = true;
+
+  taskENTER_CRITICAL();
+  if (doneCallback) {
+    if (pendingCallbackCount < MAX_PENDING_CALLBACKS) {
+      pendingCallbacks[pendingCallbackCount++] = doneCallback;
+    } else {
+      result = false;
+    }
+  }
+
+  if (result) {
+    pendingGeoDataBsField |= geoDataBsField;
+    pendingCalibDataBsField |= calibDataBsField;
+  }
+  taskEXIT_CRITICAL();
+
+  if (result) {
+    xTaskNotifyGive(taskHandle);
+  }
+
+  return result;
+}
+
+static void lighthouseStorageWriterTask(void* param) {
+  lighthouseStorageWriterDoneCallback_t callbacks[MAX_PENDING_CALLBACKS];
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // Take all pending requests, new requests that arrive during the write are handled in the next round
+    taskENTER_CRITICAL();
+    const uint16_t geoDataBsField = pendingGeoDataBsField;
+    const uint16_t calibDataBsField = pendingCalibDataBsField;
+    const int callbackCount = pendingCallbackCount;
+    for (int i = 0; i < callbackCount; i++) {
+      callbacks[i] = pendingCallbacks[i];
+    }
+    pendingGeoDataBsField = 0;
+    pendingCalibDataBsField = 0;
+    pendingCallbackCount = 0;
+    taskEXIT_CRITICAL();
+
+    bool result = true;
+    for (int baseStation = 0; baseStation < PULSE_PROCESSOR_N_BASE_STATIONS; baseStation++) {
+      const uint16_t mask = 1 << baseStation;
+      const bool storeGeo = (geoDataBsField & mask) != 0;
+      const bool storeCalibration = (calibDataBsField & mask) != 0;
+      if (storeGeo || storeCalibration) {
+        if (! lighthouseStoragePersistData(baseStation, storeGeo, storeCalibration)) {
+          DEBUG_PRINT("WARNING: Failed to persist data for base station %i\n", baseStation + 1);
+          result = false;
+        }
+      }
+    }
+
+    if (geoDataBsField || calibDataBsField) {
+      result = lighthouseStoragePersistBootData() && result;
+    }
+
+    for (int i = 0; i < callbackCount; i++) {
+      callbacks[i](result);
+    }
+  }
+}
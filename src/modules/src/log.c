@@ -28,9 +28,11 @@
  * FIXME: See if we can factorise the TOC code */
 
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <math.h>
 
 /* FreeRtos includes */
 #include "FreeRTOS.h"
@@ -41,6 +43,7 @@
 #include "config.h"
 #include "crtp.h"
 #include "log.h"
+#include "log_pack.h"
 #include "crc32.h"
 #include "worker.h"
 #include "num.h"
@@ -49,6 +52,14 @@
 #include "cfassert.h"
 #include "debug.h"
 #include "static_mem.h"
+#include "usec_time.h"
+#include "stabilizer_types.h"
+#include "tocHash.h"
+#include "staticPool.h"
+#include "timesync.h"
+#include "storage.h"
+#include "param.h"
+#include "rateSupervisor.h"
 
 #if 0
 #define LOG_DEBUG(fmt, ...) DEBUG_PRINT("D/log " fmt, ## __VA_ARGS__)
@@ -72,23 +83,37 @@ static const uint8_t typeLength[] = {
 
 #define TYPE_MASK (0x0f)
 
-typedef enum {
-  acqType_memory = 0,
-  acqType_function = 1,
-} acquisitionType_t;
-
 // Maximum log payload length (4 bytes are used for block id and timestamp)
 #define LOG_MAX_LEN 26
 
 /* Log packet parameters storage */
-#define LOG_MAX_OPS 128
-#define LOG_MAX_BLOCKS 16
+#ifndef LOG_MAX_OPS
+  #define LOG_MAX_OPS 128
+#endif
+#ifndef LOG_MAX_BLOCKS
+  #define LOG_MAX_BLOCKS 16
+#endif
+
+/* Blocks with an id from LOG_RESERVED_BLOCK_ID and up are allocated from a
+ * private reserve, they can always be created even if a client has used up
+ * the shared blocks and ops. The reserve is not reported in the TOC info. */
+#ifndef LOG_RESERVED_BLOCKS
+  #define LOG_RESERVED_BLOCKS 2
+#endif
+#ifndef LOG_RESERVED_OPS
+  #define LOG_RESERVED_OPS 16
+#endif
+#define LOG_RESERVED_BLOCK_ID 0xF0
+
+#define LOG_BLOCK_SLOTS (LOG_MAX_BLOCKS + LOG_RESERVED_BLOCKS)
+#define LOG_OPS_SLOTS (LOG_MAX_OPS + LOG_RESERVED_OPS)
 struct log_ops {
   struct log_ops * next;
   uint8_t storageType : 4;
   uint8_t logType     : 4;
   void * variable;
   acquisitionType_t acquisitionType;
+  float deadband; // Minimum change that is sent by an on-change block
 };
 
 struct log_block {
@@ -96,12 +121,71 @@ struct log_block {
   xTimerHandle timer;
   StaticTimer_t timerBuffer;
   struct log_ops * ops;
+  // Set while the block is run, a run is skipped if the previous one is not done
+  uint8_t running;
+  // Compressed encoding, see logCompress()
+  bool compressed;
+  bool needKeyframe;
+  uint8_t sequence;
+  uint8_t samplesSinceKeyframe;
+  uint32_t lastGeneration; // Snapshot that lastValues was encoded with
+  uint8_t lastValues[LOG_MAX_LEN];
+  // Divider of the stabilizer rate, 0 if the block is not run by the high rate scheduler
+  uint8_t highRateDivider;
+  // On-change blocks are only sent when a variable has changed, or after the
+  // keep-alive interval [ms]. 0 if the block is sent every period.
+  uint16_t keepAlive;
+  uint32_t lastSendTime;
+  uint32_t onChangeGeneration; // Snapshot of the latest sent sample
+  // Rate control, see logRateControl(). The requested period [ms] and divider
+  // are kept, the timer and highRateDivider run at the effective rate.
+  uint16_t period;
+  uint8_t requestedDivider;
+  uint8_t priority; // Blocks with a lower priority are slowed down first
+  uint16_t maxPeriod; // The block is not slowed down below this rate [ms]
+  uint16_t effectivePeriod;
+};
+
+/* Layout of the compiled ops of a block in a snapshot */
+struct log_block_layout {
+  int id;
+  uint8_t packStart;
+  uint8_t packCount;
+  uint8_t packetLength;
+};
+
+/* Compiled ops of all blocks. Blocks are run from the published snapshot
+ * without taking the logLock. Changes are compiled into the other snapshot,
+ * once no block is run from it anymore, and then published. */
+struct log_snapshot {
+  uint32_t generation;
+  struct log_block_layout blocks[LOG_BLOCK_SLOTS];
+  struct log_pack packs[LOG_OPS_SLOTS];
 };
 
-NO_DMA_CCM_SAFE_ZERO_INIT static struct log_ops logOps[LOG_MAX_OPS];
-NO_DMA_CCM_SAFE_ZERO_INIT static struct log_block logBlocks[LOG_MAX_BLOCKS];
+STATIC_MEM_POOL_ALLOC(logOpsPool, struct log_ops, LOG_MAX_OPS);
+STATIC_MEM_POOL_ALLOC(logReservedOpsPool, struct log_ops, LOG_RESERVED_OPS);
+// Blocks are kept in one array, the pools hand out the shared and the reserved part of it
+NO_DMA_CCM_SAFE_ZERO_INIT static struct log_block logBlocks[LOG_BLOCK_SLOTS];
+NO_DMA_CCM_SAFE_ZERO_INIT static uint16_t logBlocksFreeStack[LOG_BLOCK_SLOTS];
+static staticPool_t logBlocksPool;
+static staticPool_t logReservedBlocksPool;
+NO_DMA_CCM_SAFE_ZERO_INIT static struct log_snapshot logSnapshots[2];
+static uint32_t snapshotReaders[2];
+static uint8_t publishedSnapshot = 0;
+// Protects the blocks and ops, taken by the TOC and control commands
 static xSemaphoreHandle logLock;
 static StaticSemaphore_t logLockBuffer;
+// Protects the pending aggregated packet
+static xSemaphoreHandle aggregationLock;
+static StaticSemaphore_t aggregationLockBuffer;
+
+// Contention statistics
+static uint32_t lockHoldTime;
+static uint32_t lockHoldTimeMax;
+static uint32_t lockWaitTimeMax;
+static uint32_t snapshotWaits;
+static uint32_t runsSkipped;
 
 struct ops_setting {
     uint8_t logType;
@@ -117,11 +201,17 @@ struct ops_setting_v2 {
 #define TOC_CH      0
 #define CONTROL_CH  1
 #define LOG_CH      2
+#define LOG_AGG_CH  3
 
 #define CMD_GET_ITEM    0 // original version: up to 255 entries
 #define CMD_GET_INFO    1 // original version: up to 255 entries
 #define CMD_GET_ITEM_V2 2 // version 2: up to 16k entries
 #define CMD_GET_INFO_V2 3 // version 2: up to 16k entries
+#define CMD_GET_ITEMS_V2 4 // version 2: all entries from an id, packed
+
+// CMD_GET_ITEMS_V2: the type of an entry is or:ed with this if the group name follows
+#define TOC_ITEMS_NEW_GROUP 0x80
+#define TOC_ITEMS_MAX_PACKETS 32
 
 #define CONTROL_CREATE_BLOCK    0
 #define CONTROL_APPEND_BLOCK    1
@@ -131,12 +221,64 @@ struct ops_setting_v2 {
 #define CONTROL_RESET           5
 #define CONTROL_CREATE_BLOCK_V2 6
 #define CONTROL_APPEND_BLOCK_V2 7
+#define CONTROL_SET_AGGREGATION 8
+#define CONTROL_SET_COMPRESSION 9
+#define CONTROL_START_BLOCK_HIGH_RATE 10
+#define CONTROL_SET_ON_CHANGE   11
+#define CONTROL_SET_DEADBAND    12
+#define CONTROL_SAVE_PROFILE    13
+#define CONTROL_START_PROFILE   14
+#define CONTROL_DELETE_PROFILE  15
+#define CONTROL_SET_RATE_LIMITS 16
+#define CONTROL_GET_RATE        17
+
+// Aggregated packets: 3 bytes timestamp followed by [BLOCK_ID, values] entries
+#define LOG_AGG_HEADER_LEN 3
+
+// Compressed blocks: 1 byte header followed by the values or the deltas
+#define LOG_COMPRESSION_HEADER_LEN 1
+#define LOG_COMPRESSION_KEYFRAME 0x80
+#define LOG_COMPRESSION_SEQUENCE_MASK 0x7F
+// Keyframes are also sent regularly to recover from lost packets
+#define LOG_COMPRESSION_KEYFRAME_INTERVAL 16
 
 #define BLOCK_ID_FREE -1
 
+/* Profiles are blocks stored in the kve storage, that are created again at
+ * boot and started if they are flagged for it, or by CONTROL_START_PROFILE.
+ * Variables are stored by TOC id, a profile saved by a build with another
+ * TOC is not started. */
+#define LOG_PROFILE_PREFIX "log/prf/"
+#define LOG_PROFILE_KEY_LEN 12
+#define LOG_PROFILE_MAX 8
+#define LOG_PROFILE_MAX_VARS LOG_MAX_LEN
+#define LOG_PROFILE_AUTOSTART 0x01
+
+struct log_profile_var {
+  struct ops_setting_v2 setting;
+  float deadband;
+} __attribute__((packed));
+
+struct log_profile {
+  uint32_t tocCrc;
+  uint8_t blockId;
+  uint8_t flags;
+  uint8_t period; // 10 ms units, 0 if the block is not run by a timer
+  uint8_t highRateDivider;
+  uint8_t compressed;
+  uint16_t keepAlive;
+  uint8_t count;
+  struct log_profile_var vars[LOG_PROFILE_MAX_VARS];
+} __attribute__((packed));
+
+static struct log_profile profileBuffer;
+static uint8_t storedProfiles;
+
 //Private functions
 static void logTask(void * prm);
+static void logHighRateTask(void * prm);
 static void logTOCProcess(int command);
+static void logTOCSendItems(uint16_t firstId, uint8_t packetCount);
 static void logControlProcess(void);
 
 void logRunBlock(void * arg);
@@ -156,18 +298,91 @@ static CRTPPacket p;
 
 static bool isInit = false;
 
+// Hash index of the TOC for logGetVarId(), linear lookups are used if the TOC does not fit
+#define LOG_TOC_HASH_SIZE 1024
+NO_DMA_CCM_SAFE_ZERO_INIT static uint16_t logTocHashSlots[LOG_TOC_HASH_SIZE];
+static tocHash_t logTocHash;
+static bool logTocHashed = false;
+
+// Aggregation of the blocks that are due in the same tick, see logAggregate()
+static bool aggregationEnabled = false;
+static bool aggregationFlushScheduled = false;
+static unsigned int aggregationTimestamp;
+static CRTPPacket aggregationPk;
+
+// High rate scheduler, see logHighRateTask()
+#define LOG_HR_JITTER_WINDOW RATE_MAIN_LOOP
+static TaskHandle_t logHighRateTaskHandle;
+static uint8_t highRateBlockCount = 0;
+static uint32_t highRateTick;
+static uint32_t highRateTriggerTime;
+static uint32_t highRateLatency;
+static uint32_t highRateLatencyMax;
+static uint32_t highRateJitterMax;
+static uint32_t highRateMissed;
+
+// Rate control, see logRateControl()
+#define LOG_RATE_CONTROL_PERIOD_MS 100
+#define LOG_RATE_DEFAULT_MAX_PERIOD 1000
+#define LOG_RATE_MAX_THROTTLE 8
+#define LOG_RATE_MIN_FREE_PACKETS 4
+// The crtp queue time is averaged over 500 ms, wait for it to settle after a change
+#define LOG_RATE_HOLD_PERIODS 5
+#define LOG_RATE_RECOVER_PERIODS 10
+static uint8_t rateControlEnable = 1;
+static uint16_t rateControlMaxQueueTime = 50;
+static uint8_t rateThrottle = 0;
+static uint8_t rateHoldPeriods = 0;
+static uint8_t rateClearPeriods = 0;
+static uint32_t rateCongestedCount = 0;
+// Allowed deviation of the rate control period [1/1000]
+#define LOG_RATE_CONTROL_TOLERANCE 100
+static rateSupervisor_t rateSupervisorContext;
+
 /* Log management functions */
 static int logAppendBlock(int id, struct ops_setting * settings, int len);
 static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len);
+static staticPool_t * blocksPoolFor(int id)
+{
+  return (id >= LOG_RESERVED_BLOCK_ID) ? &logReservedBlocksPool : &logBlocksPool;
+}
+
+static staticPool_t * opsPoolFor(int id)
+{
+  return (id >= LOG_RESERVED_BLOCK_ID) ? &logReservedOpsPool : &logOpsPool;
+}
+
 static int logCreateBlock(unsigned char id, struct ops_setting * settings, int len);
 static int logCreateBlockV2(unsigned char id, struct ops_setting_v2 * settings, int len);
 static int logDeleteBlock(int id);
 static int logStartBlock(int id, unsigned int period);
 static int logStopBlock(int id);
+static int logSetCompression(int id, bool enable);
+static int logStartBlockHighRate(int id, uint8_t divider);
+static int logSetOnChange(int id, uint16_t keepAlive);
+static int logSetDeadband(int id, uint8_t firstVariable, const float* deadbands, int len);
+static int logProfileSave(uint8_t profile, int id, uint8_t flags, uint8_t period, uint8_t divider);
+static int logProfileStart(uint8_t profile);
+static int logProfileDelete(uint8_t profile);
+static void logProfileRestore(void);
+static int logSetRateLimits(int id, uint8_t priority, uint16_t maxPeriod);
+static int logGetRate(int id, uint16_t* period, uint8_t* divider);
+static uint16_t logRatePeriod(const struct log_block* block);
+static uint8_t logRateDivider(const struct log_block* block);
+static void logRateControl(void);
 static void logReset();
 static acquisitionType_t acquisitionTypeFromLogType(uint8_t logType);
+static void logCompileBlocks();
+static void logTocHashBuild(void);
+static void logAggregate(const CRTPPacket* pk, unsigned int timestamp, bool withLength);
+static void logCompress(struct log_block* blk, const struct log_snapshot* snapshot,
+                        const struct log_block_layout* layout, CRTPPacket* pk);
+static bool logOnChange(struct log_block* blk, const struct log_snapshot* snapshot,
+                        const struct log_block_layout* layout, const CRTPPacket* pk,
+                        uint32_t timestamp);
 
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(logTask, LOG_TASK_STACKSIZE);
+STATIC_MEM_TASK_ALLOC(logHighRateTask, LOG_HR_TASK_STACKSIZE);
 
 void logInit(void)
 {
@@ -210,6 +425,7 @@ void logInit(void)
 
   // Big lock that protects the log datastructures
   logLock = xSemaphoreCreateMutexStatic(&logLockBuffer);
+  aggregationLock = xSemaphoreCreateMutexStatic(&aggregationLockBuffer);
 
   for (i=0; i<logsLen; i++)
   {
@@ -217,15 +433,31 @@ void logInit(void)
       logsCount++;
   }
 
+  logTocHashBuild();
+
   //Manually free all log blocks
-  for(i=0; i<LOG_MAX_BLOCKS; i++)
+  for(i=0; i<LOG_BLOCK_SLOTS; i++)
     logBlocks[i].id = BLOCK_ID_FREE;
 
+  STATIC_MEM_POOL_INIT(logOpsPool);
+  STATIC_MEM_POOL_INIT(logReservedOpsPool);
+  staticPoolInit(&logBlocksPool, &logBlocks[0], sizeof(struct log_block),
+    LOG_MAX_BLOCKS, &logBlocksFreeStack[0]);
+  staticPoolInit(&logReservedBlocksPool, &logBlocks[LOG_MAX_BLOCKS], sizeof(struct log_block),
+    LOG_RESERVED_BLOCKS, &logBlocksFreeStack[LOG_MAX_BLOCKS]);
+
   //Init data structures and set the log subsystem in a known state
   logReset();
 
+  // Start the stored autostart blocks, like the persisted params are restored
+  // in paramInit(). Their timers schedule on the worker, which is already set up.
+  xSemaphoreTake(logLock, portMAX_DELAY);
+  logProfileRestore();
+  xSemaphoreGive(logLock);
+
   //Start the log task
   STATIC_MEM_TASK_CREATE(logTask, logTask, LOG_TASK_NAME, NULL, LOG_TASK_PRI);
+  logHighRateTaskHandle = STATIC_MEM_TASK_CREATE(logHighRateTask, logHighRateTask, LOG_HR_TASK_NAME, NULL, LOG_HR_TASK_PRI);
 
   isInit = true;
 }
@@ -239,15 +471,46 @@ void logTask(void * prm)
 {
 	crtpInitTaskQueue(CRTP_PORT_LOG);
 
-	while(1) {
-		crtpReceivePacketBlock(CRTP_PORT_LOG, &p);
+	uint32_t nextRateControl = xTaskGetTickCount() + M2T(LOG_RATE_CONTROL_PERIOD_MS);
+	rateSupervisorInitRate(&rateSupervisorContext, T2M(xTaskGetTickCount()), 1000 / LOG_RATE_CONTROL_PERIOD_MS, LOG_RATE_CONTROL_TOLERANCE, 1);
+	rateSupervisorRegister(&rateSupervisorContext, "log");
 
+	while(1) {
+		const int32_t untilRateControl = nextRateControl - xTaskGetTickCount();
+		const int received = crtpReceivePacketWait(CRTP_PORT_LOG, &p, untilRateControl > 0 ? T2M(untilRateControl) : 0);
+
+		// Run at a fixed rate, also while packets are received
+		if ((int32_t)(xTaskGetTickCount() - nextRateControl) >= 0) {
+		  xSemaphoreTake(logLock, portMAX_DELAY);
+		  logRateControl();
+		  xSemaphoreGive(logLock);
+		  rateSupervisorTick(&rateSupervisorContext, T2M(xTaskGetTickCount()), (uint32_t)usecTimestamp());
+
+		  nextRateControl += M2T(LOG_RATE_CONTROL_PERIOD_MS);
+		  if ((int32_t)(xTaskGetTickCount() - nextRateControl) >= 0) {
+		    // Periods that were missed are not caught up
+		    nextRateControl = xTaskGetTickCount() + M2T(LOG_RATE_CONTROL_PERIOD_MS);
+		  }
+		}
+
+		if (!received)
+		  continue;
+
+		const uint32_t waitStart = usecTimestamp();
 		xSemaphoreTake(logLock, portMAX_DELAY);
+		const uint32_t holdStart = usecTimestamp();
 		if (p.channel==TOC_CH)
 		  logTOCProcess(p.data[0]);
 		if (p.channel==CONTROL_CH)
 		  logControlProcess();
 		xSemaphoreGive(logLock);
+
+		const uint32_t waitTime = holdStart - waitStart;
+		lockHoldTime = (uint32_t)usecTimestamp() - holdStart;
+		if (lockHoldTime > lockHoldTimeMax)
+		  lockHoldTimeMax = lockHoldTime;
+		if (waitTime > lockWaitTimeMax)
+		  lockWaitTimeMax = waitTime;
 	}
 }
 
@@ -370,12 +633,79 @@ void logTOCProcess(int command)
       crtpSendPacketBlock(&p);
     }
     break;
+  case CMD_GET_ITEMS_V2:  //Get log variables from an id
+    memcpy(&logId, &p.data[1], 2);
+    logTOCSendItems(logId, p.data[3]);
+    break;
+  }
+}
+
+/* Sends the TOC entries from firstId and on, packed in up to packetCount
+ * packets. Each packet holds the id of its first entry followed by as many
+ * [type, group (if changed), name] entries as fit. A packet without entries
+ * is sent if firstId is out of range. */
+static void logTOCSendItems(uint16_t firstId, uint8_t packetCount)
+{
+  int ptr;
+  const char* group = "";
+  uint16_t n = 0;
+
+  if (packetCount == 0)
+    packetCount = 1;
+  if (packetCount > TOC_ITEMS_MAX_PACKETS)
+    packetCount = TOC_ITEMS_MAX_PACKETS;
+
+  for (ptr=0; ptr<logsLen; ptr++)
+  {
+    if (logs[ptr].type & LOG_GROUP)
+      group = (logs[ptr].type & LOG_START) ? logs[ptr].name : "";
+    else if (n == firstId)
+      break;
+    else
+      n++;
   }
+
+  do
+  {
+    const char* packetGroup = NULL;
+
+    p.header=CRTP_HEADER(CRTP_PORT_LOG, TOC_CH);
+    p.data[0]=CMD_GET_ITEMS_V2;
+    memcpy(&p.data[1], &n, 2);
+    p.size=3;
+
+    for (; ptr<logsLen; ptr++)
+    {
+      if (logs[ptr].type & LOG_GROUP)
+      {
+        group = (logs[ptr].type & LOG_START) ? logs[ptr].name : "";
+        continue;
+      }
+
+      const bool newGroup = (group != packetGroup);
+      const int groupLength = newGroup ? strlen(group) + 1 : 0;
+      const int nameLength = strlen(logs[ptr].name) + 1;
+      if (p.size + 1 + groupLength + nameLength > CRTP_MAX_DATA_SIZE)
+        break;
+
+      p.data[p.size++] = (logs[ptr].type & TYPE_MASK) | (newGroup ? TOC_ITEMS_NEW_GROUP : 0);
+      memcpy(&p.data[p.size], group, groupLength);
+      p.size += groupLength;
+      memcpy(&p.data[p.size], logs[ptr].name, nameLength);
+      p.size += nameLength;
+      packetGroup = group;
+      n++;
+    }
+
+    crtpSendPacketBlock(&p);
+    packetCount--;
+  } while (packetCount > 0 && ptr < logsLen);
 }
 
 void logControlProcess()
 {
   int ret = ENOEXEC;
+  uint8_t replySize = 3;
 
   switch(p.data[0])
   {
@@ -412,11 +742,63 @@ void logControlProcess()
                             (struct ops_setting_v2*)&p.data[2],
                             (p.size-2)/sizeof(struct ops_setting_v2) );
       break;
+    case CONTROL_SET_AGGREGATION:
+      aggregationEnabled = (p.data[1] != 0);
+      ret = 0;
+      break;
+    case CONTROL_SET_COMPRESSION:
+      ret = logSetCompression( p.data[1], p.data[2] != 0 );
+      break;
+    case CONTROL_START_BLOCK_HIGH_RATE:
+      ret = logStartBlockHighRate( p.data[1], p.data[2] );
+      break;
+    case CONTROL_SET_ON_CHANGE:
+    {
+      uint16_t keepAlive;
+      memcpy(&keepAlive, &p.data[2], 2);
+      ret = logSetOnChange( p.data[1], keepAlive );
+      break;
+    }
+    case CONTROL_SET_DEADBAND:
+      ret = logSetDeadband( p.data[1], p.data[2],
+                            (const float*)&p.data[3],
+                            (p.size-3)/sizeof(float) );
+      break;
+    case CONTROL_SAVE_PROFILE:
+      ret = logProfileSave( p.data[1], p.data[2], p.data[3], p.data[4], p.data[5] );
+      break;
+    case CONTROL_START_PROFILE:
+      ret = logProfileStart( p.data[1] );
+      break;
+    case CONTROL_DELETE_PROFILE:
+      ret = logProfileDelete( p.data[1] );
+      break;
+    case CONTROL_SET_RATE_LIMITS:
+    {
+      uint16_t maxPeriod;
+      memcpy(&maxPeriod, &p.data[3], 2);
+      ret = logSetRateLimits( p.data[1], p.data[2], maxPeriod );
+      break;
+    }
+    case CONTROL_GET_RATE:
+    {
+      uint16_t period = 0;
+      uint8_t divider = 0;
+      ret = logGetRate( p.data[1], &period, &divider );
+      memcpy(&p.data[3], &period, 2);
+      p.data[5] = divider;
+      replySize = 6;
+      break;
+    }
   }
 
+  // The blocks may have changed (also on failure), compile them for
+  // logRunBlock(). The logLock is taken by logTask().
+  logCompileBlocks();
+
   //Commands answer
   p.data[2] = ret;
-  p.size = 3;
+  p.size = replySize;
   crtpSendPacketBlock(&p);
 }
 
@@ -424,23 +806,32 @@ static int logCreateBlock(unsigned char id, struct ops_setting * settings, int l
 {
   int i;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (id == logBlocks[i].id) return EEXIST;
+  struct log_block * block;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (logBlocks[i].id == BLOCK_ID_FREE) break;
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (id == logBlocks[i].id) return EEXIST;
 
-  if (i == LOG_MAX_BLOCKS)
+  block = staticPoolAlloc(blocksPoolFor(id));
+  if (!block)
     return ENOMEM;
 
-  logBlocks[i].id = id;
-  logBlocks[i].timer = xTimerCreateStatic("logTimer", M2T(1000), pdTRUE,
-    &logBlocks[i], logBlockTimed, &logBlocks[i].timerBuffer);
-  logBlocks[i].ops = NULL;
-
-  if (logBlocks[i].timer == NULL)
+  block->id = id;
+  block->timer = xTimerCreateStatic("logTimer", M2T(1000), pdTRUE,
+    block, logBlockTimed, &block->timerBuffer);
+  block->ops = NULL;
+  block->compressed = false;
+  block->highRateDivider = 0;
+  block->keepAlive = 0;
+  block->period = 0;
+  block->requestedDivider = 0;
+  block->priority = 0;
+  block->maxPeriod = LOG_RATE_DEFAULT_MAX_PERIOD;
+  block->effectivePeriod = 0;
+
+  if (block->timer == NULL)
   {
-	logBlocks[i].id = BLOCK_ID_FREE;
+	block->id = BLOCK_ID_FREE;
+	staticPoolFree(blocksPoolFor(id), block);
 	return ENOMEM;
   }
 
@@ -453,23 +844,32 @@ static int logCreateBlockV2(unsigned char id, struct ops_setting_v2 * settings,
 {
   int i;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (id == logBlocks[i].id) return EEXIST;
+  struct log_block * block;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (logBlocks[i].id == BLOCK_ID_FREE) break;
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (id == logBlocks[i].id) return EEXIST;
 
-  if (i == LOG_MAX_BLOCKS)
+  block = staticPoolAlloc(blocksPoolFor(id));
+  if (!block)
     return ENOMEM;
 
-  logBlocks[i].id = id;
-  logBlocks[i].timer = xTimerCreateStatic("logTimer", M2T(1000), pdTRUE,
-    &logBlocks[i], logBlockTimed, &logBlocks[i].timerBuffer);
-  logBlocks[i].ops = NULL;
-
-  if (logBlocks[i].timer == NULL)
+  block->id = id;
+  block->timer = xTimerCreateStatic("logTimer", M2T(1000), pdTRUE,
+    block, logBlockTimed, &block->timerBuffer);
+  block->ops = NULL;
+  block->compressed = false;
+  block->highRateDivider = 0;
+  block->keepAlive = 0;
+  block->period = 0;
+  block->requestedDivider = 0;
+  block->priority = 0;
+  block->maxPeriod = LOG_RATE_DEFAULT_MAX_PERIOD;
+  block->effectivePeriod = 0;
+
+  if (block->timer == NULL)
   {
-  logBlocks[i].id = BLOCK_ID_FREE;
+  block->id = BLOCK_ID_FREE;
+  staticPoolFree(blocksPoolFor(id), block);
   return ENOMEM;
   }
 
@@ -479,8 +879,7 @@ static int logCreateBlockV2(unsigned char id, struct ops_setting_v2 * settings,
 }
 
 static int blockCalcLength(struct log_block * block);
-static struct log_ops * opsMalloc();
-static void opsFree(struct log_ops * ops);
+static int blockMaxLength(struct log_block * block);
 static void blockAppendOps(struct log_block * block, struct log_ops * ops);
 static int variableGetIndex(int id);
 
@@ -491,10 +890,10 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
 
   LOG_DEBUG("Appending %d variable to block %d\n", len, id);
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
     if (logBlocks[i].id == id) break;
 
-  if (i >= LOG_MAX_BLOCKS) {
+  if (i >= LOG_BLOCK_SLOTS) {
     LOG_ERROR("Trying to append block id %d that doesn't exist.", id);
     return ENOENT;
   }
@@ -507,12 +906,12 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
     struct log_ops * ops;
     int varId;
 
-    if ((currentLength + typeLength[settings[i].logType & TYPE_MASK])>LOG_MAX_LEN) {
+    if ((currentLength + typeLength[settings[i].logType & TYPE_MASK])>blockMaxLength(block)) {
       LOG_ERROR("Trying to append a full block. Block id %d.\n", id);
       return E2BIG;
     }
 
-    ops = opsMalloc();
+    ops = staticPoolAlloc(opsPoolFor(id));
 
     if(!ops) {
       LOG_ERROR("No more ops memory free!\n");
@@ -525,6 +924,7 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
 
       if (varId<0) {
         LOG_ERROR("Trying to add variable Id %d that does not exists.", settings[i].id);
+        staticPoolFree(opsPoolFor(id), ops);
         return ENOENT;
       }
 
@@ -532,6 +932,7 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
       ops->storageType = logs[varId].type & TYPE_MASK;
       ops->logType     = settings[i].logType & TYPE_MASK;
       ops->acquisitionType = acquisitionTypeFromLogType(logs[varId].type);
+      ops->deadband    = 0;
 
       LOG_DEBUG("Appended variable %d to block %d\n", settings[i].id, id);
     } else {                     //Memory variable
@@ -540,6 +941,7 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
       ops->storageType = (settings[i].logType>>4) & TYPE_MASK;
       ops->logType     = settings[i].logType & TYPE_MASK;
       ops->acquisitionType = acqType_memory;
+      ops->deadband    = 0;
       i += 2;
 
       LOG_DEBUG("Appended var addr 0x%x to block %d\n", (int)ops->variable, id);
@@ -559,10 +961,10 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
 
   LOG_DEBUG("Appending %d variable to block %d\n", len, id);
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
     if (logBlocks[i].id == id) break;
 
-  if (i >= LOG_MAX_BLOCKS) {
+  if (i >= LOG_BLOCK_SLOTS) {
     LOG_ERROR("Trying to append block id %d that doesn't exist.", id);
     return ENOENT;
   }
@@ -575,12 +977,12 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
     struct log_ops * ops;
     int varId;
 
-    if ((currentLength + typeLength[settings[i].logType & TYPE_MASK])>LOG_MAX_LEN) {
+    if ((currentLength + typeLength[settings[i].logType & TYPE_MASK])>blockMaxLength(block)) {
       LOG_ERROR("Trying to append a full block. Block id %d.\n", id);
       return E2BIG;
     }
 
-    ops = opsMalloc();
+    ops = staticPoolAlloc(opsPoolFor(id));
 
     if(!ops) {
       LOG_ERROR("No more ops memory free!\n");
@@ -593,6 +995,7 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
 
       if (varId<0) {
         LOG_ERROR("Trying to add variable Id %d that does not exists.", settings[i].id);
+        staticPoolFree(opsPoolFor(id), ops);
         return ENOENT;
       }
 
@@ -600,6 +1003,7 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
       ops->storageType = logs[varId].type & TYPE_MASK;
       ops->logType     = settings[i].logType & TYPE_MASK;
       ops->acquisitionType = acquisitionTypeFromLogType(logs[varId].type);
+      ops->deadband    = 0;
 
       LOG_DEBUG("Appended variable %d to block %d\n", settings[i].id, id);
     } else {                     //Memory variable
@@ -608,6 +1012,7 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
       ops->storageType = (settings[i].logType>>4) & TYPE_MASK;
       ops->logType     = settings[i].logType & TYPE_MASK;
       ops->acquisitionType = acqType_memory;
+      ops->deadband    = 0;
       i += 2;
 
       LOG_DEBUG("Appended var addr 0x%x to block %d\n", (int)ops->variable, id);
@@ -626,10 +1031,10 @@ static int logDeleteBlock(int id)
   struct log_ops * ops;
   struct log_ops * opsNext;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
     if (logBlocks[i].id == id) break;
 
-  if (i >= LOG_MAX_BLOCKS) {
+  if (i >= LOG_BLOCK_SLOTS) {
     LOG_ERROR("trying to delete block id %d that doesn't exist.", id);
     return ENOENT;
   }
@@ -638,7 +1043,7 @@ static int logDeleteBlock(int id)
   while (ops)
   {
     opsNext = ops->next;
-    opsFree(ops);
+    staticPoolFree(opsPoolFor(id), ops);
     ops = opsNext;
   }
 
@@ -649,6 +1054,7 @@ static int logDeleteBlock(int id)
   }
 
   logBlocks[i].id = BLOCK_ID_FREE;
+  staticPoolFree(blocksPoolFor(id), &logBlocks[i]);
   return 0;
 }
 
@@ -656,10 +1062,10 @@ static int logStartBlock(int id, unsigned int period)
 {
   int i;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
     if (logBlocks[i].id == id) break;
 
-  if (i >= LOG_MAX_BLOCKS) {
+  if (i >= LOG_BLOCK_SLOTS) {
     LOG_ERROR("Trying to start block id %d that doesn't exist.", id);
     return ENOENT;
   }
@@ -668,7 +1074,9 @@ static int logStartBlock(int id, unsigned int period)
 
   if (period>0)
   {
-    xTimerChangePeriod(logBlocks[i].timer, M2T(period), 100);
+    logBlocks[i].period = period > UINT16_MAX ? UINT16_MAX : period;
+    logBlocks[i].effectivePeriod = logRatePeriod(&logBlocks[i]);
+    xTimerChangePeriod(logBlocks[i].timer, M2T(logBlocks[i].effectivePeriod), 100);
     xTimerStart(logBlocks[i].timer, 100);
   } else {
     // single-shoot run
@@ -678,296 +1086,1200 @@ static int logStartBlock(int id, unsigned int period)
   return 0;
 }
 
-static int logStopBlock(int id)
+/* Runs the block in phase with the stabilizer loop, every divider loops,
+ * instead of from a software timer. */
+static int logStartBlockHighRate(int id, uint8_t divider)
 {
   int i;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
     if (logBlocks[i].id == id) break;
 
-  if (i >= LOG_MAX_BLOCKS) {
-    LOG_ERROR("Trying to stop block id %d that doesn't exist.\n", id);
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to start block id %d that doesn't exist.", id);
     return ENOENT;
   }
 
+  if (divider == 0) {
+    return EINVAL;
+  }
+
+  LOG_DEBUG("Starting block %d every %d stabilizer loops\n", id, divider);
+
   xTimerStop(logBlocks[i].timer, portMAX_DELAY);
+  logBlocks[i].period = 0;
+  logBlocks[i].effectivePeriod = 0;
+  logBlocks[i].requestedDivider = divider;
+  logBlocks[i].highRateDivider = logRateDivider(&logBlocks[i]);
 
   return 0;
 }
 
-/* This function is called by the timer subsystem */
-void logBlockTimed(xTimerHandle timer)
+static int logSetCompression(int id, bool enable)
 {
-  workerSchedule(logRunBlock, pvTimerGetTimerID(timer));
-}
+  int i;
 
-/* Appends data to a packet if space is available; returns false on failure. */
-static bool appendToPacket(CRTPPacket * pk, const void * data, size_t n) {
-  if (pk->size <= CRTP_MAX_DATA_SIZE - n)
-  {
-    memcpy(&pk->data[pk->size], data, n);
-    pk->size += n;
-    return true;
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to set compression of block id %d that doesn't exist.", id);
+    return ENOENT;
+  }
+
+  // A keyframe holds the header and all values
+  if (enable && blockCalcLength(&logBlocks[i]) > LOG_MAX_LEN - LOG_COMPRESSION_HEADER_LEN) {
+    LOG_ERROR("Block id %d is too big to be compressed.\n", id);
+    return E2BIG;
   }
-  else return false;
+
+  logBlocks[i].compressed = enable;
+  logBlocks[i].needKeyframe = true;
+
+  return 0;
 }
 
-/* This function is usually called by the worker subsystem */
-void logRunBlock(void * arg)
+/* Only sends the block when a variable has changed more than its deadband
+ * since the latest sent sample, or when keepAlive ms have passed. The block
+ * is still sampled at its period. A keepAlive of 0 sends every sample. */
+static int logSetOnChange(int id, uint16_t keepAlive)
 {
-  struct log_block *blk = arg;
-  struct log_ops *ops = blk->ops;
-  static CRTPPacket pk;
-  unsigned int timestamp;
+  int i;
 
-  xSemaphoreTake(logLock, portMAX_DELAY);
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
 
-  timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to set on-change of block id %d that doesn't exist.", id);
+    return ENOENT;
+  }
 
-  pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
-  pk.size = 4;
-  pk.data[0] = blk->id;
-  pk.data[1] = timestamp&0x0ff;
-  pk.data[2] = (timestamp>>8)&0x0ff;
-  pk.data[3] = (timestamp>>16)&0x0ff;
+  logBlocks[i].keepAlive = keepAlive;
+  // Send the first sample
+  logBlocks[i].onChangeGeneration = 0;
 
-  while (ops)
-  {
-    int valuei = 0;
-    float valuef = 0;
+  return 0;
+}
 
-    // FPU instructions must run on aligned data.
-    // We first copy the data to an (aligned) local variable, before assigning it
-    switch(ops->storageType)
-    {
-      case LOG_UINT8:
-      {
-        uint8_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireUInt8(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_INT8:
-      {
-        int8_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireInt8(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_UINT16:
-      {
-        uint16_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireUInt16(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_INT16:
-      {
-        int16_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireInt16(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_UINT32:
-      {
-        uint32_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireUInt32(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_INT32:
-      {
-        int32_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireInt32(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_FLOAT:
-      {
-        float v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->aquireFloat(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(valuef));
-        }
-        valuei = v;
-        valuef = v;
-        break;
-      }
-    }
+static int logSetDeadband(int id, uint8_t firstVariable, const float* deadbands, int len)
+{
+  int i;
+  struct log_ops * ops;
 
-    if (ops->logType == LOG_FLOAT || ops->logType == LOG_FP16)
-    {
-      if (ops->storageType != LOG_FLOAT)
-      {
-        valuef = valuei;
-      }
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
 
-      // Try to append the next item to the packet.  If we run out of space,
-      // drop this and subsequent items.
-      if (ops->logType == LOG_FLOAT)
-      {
-        if (!appendToPacket(&pk, &valuef, 4)) break;
-      }
-      else
-      {
-        valuei = single2half(valuef);
-        if (!appendToPacket(&pk, &valuei, 2)) break;
-      }
-    }
-    else  //logType is an integer
-    {
-      if (!appendToPacket(&pk, &valuei, typeLength[ops->logType])) break;
-    }
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to set deadband of block id %d that doesn't exist.", id);
+    return ENOENT;
+  }
 
+  ops = logBlocks[i].ops;
+  for (i=0; ops && i<firstVariable; i++)
     ops = ops->next;
-  }
 
-  xSemaphoreGive(logLock);
+  for (i=0; ops && i<len; i++, ops = ops->next)
+    memcpy(&ops->deadband, &deadbands[i], sizeof(float));
 
-  // Check if the connection is still up, oherwise disable
-  // all the logging and flush all the CRTP queues.
-  if (!crtpIsConnected())
-  {
-    logReset();
-    crtpReset();
-  }
-  else
-  {
-    // No need to block here, since logging is not guaranteed
-    crtpSendPacket(&pk);
+  if (i < len) {
+    LOG_ERROR("Trying to set deadband of variables that are not in block id %d.", id);
+    return ENOENT;
   }
+
+  return 0;
 }
 
-static int variableGetIndex(int id)
+static int variableGetId(const struct log_ops * ops)
 {
-  int i;
   int n=0;
 
-  for (i=0; i<logsLen; i++)
+  for (int i=0; i<logsLen; i++)
   {
-    if(!(logs[i].type & LOG_GROUP))
-    {
-      if(n==id)
-        break;
-      n++;
-    }
+    if (logs[i].type & LOG_GROUP)
+      continue;
+
+    if (logs[i].address == ops->variable && (logs[i].type & TYPE_MASK) == ops->storageType)
+      return n;
+    n++;
   }
 
-  if (i>=logsLen)
-    return -1;
+  return -1;
+}
 
-  return i;
+static void logProfileKey(char* key, uint8_t profile)
+{
+  const int length = strlen(LOG_PROFILE_PREFIX);
+
+  memcpy(key, LOG_PROFILE_PREFIX, length);
+  key[length] = '0' + profile;
+  key[length + 1] = '\0';
 }
 
-static struct log_ops * opsMalloc()
+/* Stores the variables and settings of a block as a profile, together with
+ * how it is started: every period * 10 ms, every divider stabilizer loops
+ * or not at all if both are 0. */
+static int logProfileSave(uint8_t profile, int id, uint8_t flags, uint8_t period, uint8_t divider)
 {
   int i;
+  struct log_ops * ops;
+  char key[LOG_PROFILE_KEY_LEN];
 
-  for (i=0;i<LOG_MAX_OPS; i++)
-      if (logOps[i].variable == NULL) break;
+  if (profile >= LOG_PROFILE_MAX)
+    return EINVAL;
 
-  if (i >= LOG_MAX_OPS)
-      return NULL;
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
 
-  return &logOps[i];
-}
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to save block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
 
-static void opsFree(struct log_ops * ops)
-{
-  ops->variable = NULL;
-}
+  profileBuffer.tocCrc = logsCrc;
+  profileBuffer.blockId = id;
+  profileBuffer.flags = flags;
+  profileBuffer.period = period;
+  profileBuffer.highRateDivider = divider;
+  profileBuffer.compressed = logBlocks[i].compressed;
+  profileBuffer.keepAlive = logBlocks[i].keepAlive;
+  profileBuffer.count = 0;
 
-static int blockCalcLength(struct log_block * block)
-{
-  struct log_ops * ops;
-  int len = 0;
+  for (ops = logBlocks[i].ops; ops; ops = ops->next)
+  {
+    // Memory variables are not in the TOC and can not be stored
+    const int varId = variableGetId(ops);
+    if (varId < 0 || profileBuffer.count >= LOG_PROFILE_MAX_VARS)
+      return EINVAL;
+
+    struct log_profile_var* var = &profileBuffer.vars[profileBuffer.count++];
+    var->setting.logType = ops->logType;
+    var->setting.id = varId;
+    var->deadband = ops->deadband;
+  }
 
-  for (ops = block->ops; ops; ops = ops->next)
-    len += typeLength[ops->logType];
+  logProfileKey(key, profile);
+  const size_t length = offsetof(struct log_profile, vars) + profileBuffer.count * sizeof(struct log_profile_var);
+  if (!storageStore(key, &profileBuffer, length)) {
+    LOG_ERROR("Failed to store profile %d\n", profile);
+    return EIO;
+  }
 
-  return len;
+  storedProfiles |= 1 << profile;
+  return 0;
 }
 
-void blockAppendOps(struct log_block * block, struct log_ops * ops)
+/* Creates the block of a profile and starts it. The block is deleted again
+ * if it can not be set up completely. */
+static int logProfileApply(const struct log_profile* profile, size_t length)
 {
-  struct log_ops * o;
+  struct ops_setting_v2 settings[LOG_PROFILE_MAX_VARS];
+  float deadbands[LOG_PROFILE_MAX_VARS];
+  int ret;
 
-  ops->next = NULL;
+  if (length < offsetof(struct log_profile, vars) || profile->count > LOG_PROFILE_MAX_VARS ||
+      length < offsetof(struct log_profile, vars) + profile->count * sizeof(struct log_profile_var))
+    return EINVAL;
 
-  if (block->ops == NULL)
-    block->ops = ops;
-  else
-  {
-    for (o = block->ops; o->next; o = o->next);
+  if (profile->tocCrc != logsCrc) {
+    LOG_ERROR("Profile of block id %d is from another TOC\n", profile->blockId);
+    return ESTALE;
+  }
 
-    o->next = ops;
+  for (int i=0; i<profile->count; i++) {
+    settings[i] = profile->vars[i].setting;
+    deadbands[i] = profile->vars[i].deadband;
   }
+
+  ret = logCreateBlockV2(profile->blockId, settings, profile->count);
+  if (ret == EEXIST)
+    return ret;
+  if (ret == 0 && profile->compressed)
+    ret = logSetCompression(profile->blockId, true);
+  if (ret == 0 && profile->keepAlive)
+    ret = logSetOnChange(profile->blockId, profile->keepAlive);
+  if (ret == 0)
+    ret = logSetDeadband(profile->blockId, 0, deadbands, profile->count);
+  if (ret == 0 && profile->highRateDivider)
+    ret = logStartBlockHighRate(profile->blockId, profile->highRateDivider);
+  else if (ret == 0 && profile->period)
+    ret = logStartBlock(profile->blockId, profile->period * 10);
+
+  if (ret != 0)
+    logDeleteBlock(profile->blockId);
+
+  return ret;
 }
 
-static void logReset(void)
+static int logProfileStart(uint8_t profile)
 {
-  int i;
+  char key[LOG_PROFILE_KEY_LEN];
 
-  if (isInit)
-  {
-    //Stop and delete all started log blocks
-    for(i=0; i<LOG_MAX_BLOCKS; i++)
-      if (logBlocks[i].id != -1)
-      {
-        logStopBlock(logBlocks[i].id);
-        logDeleteBlock(logBlocks[i].id);
-      }
-  }
+  if (profile >= LOG_PROFILE_MAX)
+    return EINVAL;
 
-  //Force free all the log block objects
-  for(i=0; i<LOG_MAX_BLOCKS; i++)
-    logBlocks[i].id = BLOCK_ID_FREE;
+  logProfileKey(key, profile);
+  const size_t length = storageFetch(key, &profileBuffer, sizeof(profileBuffer));
+  if (length == 0)
+    return ENOENT;
 
-  //Force free the log ops
-  for (i=0; i<LOG_MAX_OPS; i++)
-    logOps[i].variable = NULL;
+  return logProfileApply(&profileBuffer, length);
 }
 
-/* Public API to access log TOC from within the copter */
-static logVarId_t invalidVarId = 0xffffu;
+static int logProfileDelete(uint8_t profile)
+{
+  char key[LOG_PROFILE_KEY_LEN];
 
-logVarId_t logGetVarId(char* group, char* name)
+  if (profile >= LOG_PROFILE_MAX)
+    return EINVAL;
+
+  logProfileKey(key, profile);
+  storedProfiles &= ~(1 << profile);
+  return storageDelete(key) ? 0 : ENOENT;
+}
+
+static bool logProfileRestoreOne(const char* key, void* buffer, size_t length)
 {
-  int i;
-  logVarId_t varId = invalidVarId;
-  char * currgroup = "";
+  const struct log_profile* profile = buffer;
+
+  const int index = key[strlen(LOG_PROFILE_PREFIX)] - '0';
+  if (index >= 0 && index < LOG_PROFILE_MAX)
+    storedProfiles |= 1 << index;
+
+  if (length >= offsetof(struct log_profile, vars) && (profile->flags & LOG_PROFILE_AUTOSTART)) {
+    const int ret = logProfileApply(profile, length);
+    if (ret != 0)
+      LOG_ERROR("Failed to start profile %s (%d)\n", key, ret);
+  }
+
+  return true;
+}
+
+/* All profiles are read in one pass over the storage */
+static void logProfileRestore(void)
+{
+  storageForeach(LOG_PROFILE_PREFIX, &profileBuffer, sizeof(profileBuffer), logProfileRestoreOne);
+  logCompileBlocks();
+}
+
+static int logStopBlock(int id)
+{
+  int i;
+
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to stop block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  xTimerStop(logBlocks[i].timer, portMAX_DELAY);
+  logBlocks[i].highRateDivider = 0;
+  logBlocks[i].requestedDivider = 0;
+  logBlocks[i].period = 0;
+  logBlocks[i].effectivePeriod = 0;
+
+  return 0;
+}
+
+/* Number of times the rate of a block is halved at the current throttle
+ * level. A block with priority n is only slowed down from throttle level n+1. */
+static int logRateSteps(const struct log_block* block)
+{
+  const int steps = rateThrottle - block->priority;
+  return steps > 0 ? steps : 0;
+}
+
+static uint16_t logRatePeriod(const struct log_block* block)
+{
+  const uint32_t period = (uint32_t)block->period << logRateSteps(block);
+  const uint32_t limit = block->maxPeriod > block->period ? block->maxPeriod : block->period;
+
+  return period < limit ? period : limit;
+}
+
+static uint8_t logRateDivider(const struct log_block* block)
+{
+  const uint32_t divider = (uint32_t)block->requestedDivider << logRateSteps(block);
+  uint32_t limit = (uint32_t)block->maxPeriod * RATE_MAIN_LOOP / 1000;
+  if (limit > UINT8_MAX)
+    limit = UINT8_MAX;
+  if (limit < block->requestedDivider)
+    limit = block->requestedDivider;
+
+  return divider < limit ? divider : limit;
+}
+
+/* Moves a started block to the rate of the current throttle level */
+static void logRateApply(struct log_block* block)
+{
+  if (block->period != 0 && xTimerIsTimerActive(block->timer)) {
+    const uint16_t period = logRatePeriod(block);
+    if (period != block->effectivePeriod) {
+      block->effectivePeriod = period;
+      xTimerChangePeriod(block->timer, M2T(period), 100);
+    }
+  }
+
+  if (block->requestedDivider != 0)
+    block->highRateDivider = logRateDivider(block);
+}
+
+static int logSetRateLimits(int id, uint8_t priority, uint16_t maxPeriod)
+{
+  int i;
+
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_BLOCK_SLOTS) {
+    LOG_ERROR("Trying to set rate limits of block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  logBlocks[i].priority = priority;
+  logBlocks[i].maxPeriod = maxPeriod;
+  logRateApply(&logBlocks[i]);
+
+  return 0;
+}
+
+/* The rate a block is run at, the period is 0 if the block is not run by its
+ * timer and the divider is 0 if it is not run by the high rate scheduler. */
+static int logGetRate(int id, uint16_t* period, uint8_t* divider)
+{
+  int i;
+
+  for (i=0; i<LOG_BLOCK_SLOTS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_BLOCK_SLOTS) {
+    return ENOENT;
+  }
+
+  *period = logBlocks[i].period != 0 && xTimerIsTimerActive(logBlocks[i].timer) ? logBlocks[i].effectivePeriod : 0;
+  *divider = logBlocks[i].highRateDivider;
+
+  return 0;
+}
+
+/* Scales the rates of the started blocks to the capacity of the link, run
+ * every LOG_RATE_CONTROL_PERIOD_MS. The link is congested when the tx queue
+ * of the log port is close to full or packets wait too long in the queues.
+ * Each throttle level halves the rate of the blocks, down to their
+ * maxPeriod, and the throttle is released one level at a time once the link
+ * has been clear for LOG_RATE_RECOVER_PERIODS. */
+static void logRateControl(void)
+{
+  const bool congested = crtpGetFreeTxQueuePacketsForPort(CRTP_PORT_LOG) < LOG_RATE_MIN_FREE_PACKETS ||
+                         crtpGetTxQueueTime() > rateControlMaxQueueTime;
+  uint8_t throttle = rateThrottle;
+
+  if (rateHoldPeriods > 0)
+    rateHoldPeriods--;
+
+  if (!rateControlEnable) {
+    throttle = 0;
+  } else if (congested) {
+    rateCongestedCount++;
+    rateClearPeriods = 0;
+    if (rateHoldPeriods == 0 && throttle < LOG_RATE_MAX_THROTTLE) {
+      throttle++;
+      rateHoldPeriods = LOG_RATE_HOLD_PERIODS;
+    }
+  } else if (throttle > 0 && ++rateClearPeriods >= LOG_RATE_RECOVER_PERIODS) {
+    throttle--;
+    rateClearPeriods = 0;
+    rateHoldPeriods = LOG_RATE_HOLD_PERIODS;
+  }
+
+  if (throttle != rateThrottle) {
+    rateThrottle = throttle;
+    for (int i = 0; i < LOG_BLOCK_SLOTS; i++)
+      if (logBlocks[i].id != BLOCK_ID_FREE)
+        logRateApply(&logBlocks[i]);
+  }
+}
+
+void logHighRateTrigger(uint32_t tick)
+{
+  if (highRateBlockCount == 0 || !logHighRateTaskHandle)
+    return;
+
+  highRateTick = tick;
+  highRateTriggerTime = (uint32_t)usecTimestamp();
+  xTaskNotifyGive(logHighRateTaskHandle);
+}
+
+/* Runs the blocks that are started with CONTROL_START_BLOCK_HIGH_RATE, woken
+ * up by the stabilizer each loop. The blocks are run directly and do not
+ * queue up behind other work in the worker. The latency from the stabilizer
+ * trigger, the jitter of the period and the number of missed loops are
+ * logged in the logHr group. */
+static void logHighRateTask(void * prm)
+{
+  const uint32_t period = 1000000 / RATE_MAIN_LOOP;
+  uint32_t lastRun = 0;
+  bool hasRun = false;
+  uint32_t jitterMax = 0;
+  uint32_t runs = 0;
+
+  while(1) {
+    const uint32_t notifications = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const uint32_t now = (uint32_t)usecTimestamp();
+    const uint32_t tick = highRateTick;
+
+    highRateMissed += notifications - 1;
+    highRateLatency = now - highRateTriggerTime;
+    if (highRateLatency > highRateLatencyMax) {
+      highRateLatencyMax = highRateLatency;
+    }
+
+    // Only consecutive runs contribute to the jitter
+    if (hasRun && notifications == 1) {
+      const uint32_t interval = now - lastRun;
+      const uint32_t jitter = interval > period ? interval - period : period - interval;
+      if (jitter > jitterMax) {
+        jitterMax = jitter;
+      }
+    }
+    lastRun = now;
+    hasRun = true;
+
+    if (++runs >= LOG_HR_JITTER_WINDOW) {
+      highRateJitterMax = jitterMax;
+      jitterMax = 0;
+      runs = 0;
+    }
+
+    for (int i = 0; i < LOG_BLOCK_SLOTS; i++) {
+      struct log_block * block = &logBlocks[i];
+      if (block->id != BLOCK_ID_FREE && block->highRateDivider != 0 &&
+          (tick % block->highRateDivider) == 0) {
+        logRunBlock(block);
+      }
+    }
+  }
+}
+
+/* This function is called by the timer subsystem */
+void logBlockTimed(xTimerHandle timer)
+{
+  workerSchedule(logRunBlock, pvTimerGetTimerID(timer));
+}
+
+/* Acquires a variable, converts it to the log type and writes it to data */
+static void packConverted(const struct log_pack* pack, unsigned int timestamp, uint8_t* data)
+{
+  int valuei = 0;
+  float valuef = 0;
+
+  // FPU instructions must run on aligned data.
+  // We first copy the data to an (aligned) local variable, before assigning it
+  switch(pack->storageType)
+  {
+    case LOG_UINT8:
+    {
+      uint8_t v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->acquireUInt8(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_INT8:
+    {
+      int8_t v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->acquireInt8(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_UINT16:
+    {
+      uint16_t v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->acquireUInt16(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_INT16:
+    {
+      int16_t v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->acquireInt16(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_UINT32:
+    {
+      uint32_t v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->acquireUInt32(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_INT32:
+    {
+      int32_t v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->acquireInt32(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_FLOAT:
+    {
+      float v;
+      if (pack->acquisitionType == acqType_function) {
+        logByFunction_t* logByFunction = (logByFunction_t*)pack->variable;
+        v = logByFunction->aquireFloat(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, pack->variable, sizeof(valuef));
+      }
+      valuei = v;
+      valuef = v;
+      break;
+    }
+  }
+
+  if (pack->logType == LOG_FLOAT || pack->logType == LOG_FP16)
+  {
+    if (pack->storageType != LOG_FLOAT)
+    {
+      valuef = valuei;
+    }
+
+    if (pack->logType == LOG_FLOAT)
+    {
+      memcpy(data, &valuef, 4);
+    }
+    else
+    {
+      valuei = single2half(valuef);
+      memcpy(data, &valuei, 2);
+    }
+  }
+  else  //logType is an integer
+  {
+    memcpy(data, &valuei, typeLength[pack->logType]);
+  }
+}
+
+/* Takes a reference to the published snapshot, that is not recompiled until
+ * snapshotRelease() is called. */
+static uint8_t snapshotAcquire()
+{
+  while (true)
+  {
+    const uint8_t index = __atomic_load_n(&publishedSnapshot, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&snapshotReaders[index], 1, __ATOMIC_SEQ_CST);
+
+    // The snapshot may have been replaced and taken for compilation in between
+    if (__atomic_load_n(&publishedSnapshot, __ATOMIC_SEQ_CST) == index)
+      return index;
+
+    __atomic_sub_fetch(&snapshotReaders[index], 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+static void snapshotRelease(uint8_t index)
+{
+  __atomic_sub_fetch(&snapshotReaders[index], 1, __ATOMIC_SEQ_CST);
+}
+
+/* This function is usually called by the worker subsystem. It only reads the
+ * published snapshot and never waits for the logLock, control commands do not
+ * stall running blocks. */
+void logRunBlock(void * arg)
+{
+  struct log_block *blk = arg;
+  CRTPPacket pk;
+  unsigned int timestamp;
+
+  // Blocks are run both from the worker and from the high rate task
+  if (__atomic_exchange_n(&blk->running, 1, __ATOMIC_ACQUIRE))
+  {
+    runsSkipped++;
+    return;
+  }
+
+  const uint8_t snapshotIndex = snapshotAcquire();
+  const struct log_snapshot* snapshot = &logSnapshots[snapshotIndex];
+  const struct log_block_layout* layout = &snapshot->blocks[blk - logBlocks];
+
+  // The block may have been deleted after the run was scheduled
+  if (layout->id == BLOCK_ID_FREE)
+  {
+    snapshotRelease(snapshotIndex);
+    __atomic_store_n(&blk->running, 0, __ATOMIC_RELEASE);
+    return;
+  }
+
+  timestamp = timesyncLogTimestamp();
+
+  pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
+  pk.size = 4;
+  pk.data[0] = layout->id;
+  pk.data[1] = timestamp&0x0ff;
+  pk.data[2] = (timestamp>>8)&0x0ff;
+  pk.data[3] = (timestamp>>16)&0x0ff;
+
+  const struct log_pack* pack = &snapshot->packs[layout->packStart];
+  const struct log_pack* packEnd = pack + layout->packCount;
+  uint8_t* data = &pk.data[pk.size];
+  for (; pack < packEnd; pack++)
+  {
+    if (pack->op == packCopy)
+    {
+      memcpy(data, pack->variable, pack->length);
+    }
+    else
+    {
+      packConverted(pack, timestamp, data);
+    }
+    data += pack->length;
+  }
+  pk.size += layout->packetLength;
+
+  bool send = true;
+  if (blk->keepAlive != 0)
+  {
+    send = logOnChange(blk, snapshot, layout, &pk, timestamp);
+  }
+
+  const bool compressed = blk->compressed;
+  if (compressed && send)
+  {
+    logCompress(blk, snapshot, layout, &pk);
+  }
+
+  snapshotRelease(snapshotIndex);
+
+  const bool connected = crtpIsConnected();
+  if (connected && send)
+  {
+    if (aggregationEnabled)
+    {
+      logAggregate(&pk, timestamp, compressed);
+    }
+    else
+    {
+      // No need to block here, since logging is not guaranteed
+      crtpSendPacket(&pk);
+    }
+  }
+
+  __atomic_store_n(&blk->running, 0, __ATOMIC_RELEASE);
+
+  // Check if the connection is still up, oherwise disable
+  // all the logging and flush all the CRTP queues.
+  if (!connected)
+  {
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    logReset();
+    xSemaphoreGive(logLock);
+    crtpReset();
+  }
+}
+
+static float variableValue(const uint8_t* data, uint8_t logType)
+{
+  switch (logType)
+  {
+    case LOG_UINT8:
+      return *data;
+    case LOG_INT8:
+      return (int8_t)*data;
+    case LOG_UINT16:
+    {
+      uint16_t v;
+      memcpy(&v, data, sizeof(v));
+      return v;
+    }
+    case LOG_INT16:
+    {
+      int16_t v;
+      memcpy(&v, data, sizeof(v));
+      return v;
+    }
+    case LOG_UINT32:
+    {
+      uint32_t v;
+      memcpy(&v, data, sizeof(v));
+      return v;
+    }
+    case LOG_INT32:
+    {
+      int32_t v;
+      memcpy(&v, data, sizeof(v));
+      return v;
+    }
+    case LOG_FLOAT:
+    {
+      float v;
+      memcpy(&v, data, sizeof(v));
+      return v;
+    }
+    case LOG_FP16:
+    {
+      uint16_t v;
+      memcpy(&v, data, sizeof(v));
+      return half2single(v);
+    }
+  }
+
+  return 0;
+}
+
+/* Decides if a sample of an on-change block is sent. The values are compared
+ * with the latest sent sample in lastValues, which is kept up to date by
+ * logCompress() for compressed blocks. */
+static bool logOnChange(struct log_block* blk, const struct log_snapshot* snapshot,
+                        const struct log_block_layout* layout, const CRTPPacket* pk,
+                        uint32_t timestamp)
+{
+  const uint8_t* values = &pk->data[4];
+  bool changed = blk->onChangeGeneration != snapshot->generation ||
+                 (timestamp - blk->lastSendTime) >= blk->keepAlive;
+  int offset = 0;
+
+  for (int i = 0; i < layout->packCount && !changed; i++)
+  {
+    const struct log_pack* pack = &snapshot->packs[layout->packStart + i];
+    const uint8_t length = typeLength[pack->logType];
+
+    for (int end = offset + pack->length; offset < end && !changed; offset += length)
+    {
+      if (memcmp(&values[offset], &blk->lastValues[offset], length) == 0)
+        continue;
+
+      const float difference = variableValue(&values[offset], pack->logType) -
+                               variableValue(&blk->lastValues[offset], pack->logType);
+      changed = fabsf(difference) > pack->deadband;
+    }
+  }
+
+  if (changed)
+  {
+    if (!blk->compressed)
+    {
+      memcpy(blk->lastValues, values, layout->packetLength);
+    }
+    blk->onChangeGeneration = snapshot->generation;
+    blk->lastSendTime = timestamp;
+  }
+
+  return changed;
+}
+
+static uint32_t readValue(const uint8_t* data, uint8_t length)
+{
+  uint32_t value = 0;
+  memcpy(&value, data, length);
+  return value;
+}
+
+/* Encodes the values of a block packet, as built by logRunBlock(), in place.
+ * A keyframe holds the values as is. Other samples hold a bit mask of the
+ * variables that are unchanged since the previous sample, followed by the
+ * deltas of the changed variables as zigzag variable length integers. A
+ * keyframe is sent when the deltas would not be shorter. The header byte holds
+ * a 7 bit sequence number, that lets the client detect lost packets and wait
+ * for the next keyframe. */
+static void logCompress(struct log_block* blk, const struct log_snapshot* snapshot,
+                        const struct log_block_layout* layout, CRTPPacket* pk)
+{
+  uint8_t* values = &pk->data[4];
+  uint8_t encoded[LOG_MAX_LEN];
+  uint8_t mask[(LOG_MAX_LEN + 7) / 8] = {0};
+  bool keyframe = blk->needKeyframe || blk->lastGeneration != snapshot->generation ||
+                  blk->samplesSinceKeyframe >= LOG_COMPRESSION_KEYFRAME_INTERVAL;
+
+  if (!keyframe)
+  {
+    // Count the variables to place the deltas after the mask
+    int variableCount = 0;
+    for (int i = 0; i < layout->packCount; i++)
+    {
+      const struct log_pack* pack = &snapshot->packs[layout->packStart + i];
+      variableCount += pack->length / typeLength[pack->logType];
+    }
+
+    const int maskLength = (variableCount + 7) / 8;
+    int encodedLength = maskLength;
+    int variable = 0;
+    int offset = 0;
+
+    for (int i = 0; i < layout->packCount && !keyframe; i++)
+    {
+      const struct log_pack* pack = &snapshot->packs[layout->packStart + i];
+      const uint8_t length = typeLength[pack->logType];
+
+      for (int end = offset + pack->length; offset < end; offset += length, variable++)
+      {
+        const uint32_t current = readValue(&values[offset], length);
+        const uint32_t last = readValue(&blk->lastValues[offset], length);
+
+        if (current == last)
+        {
+          mask[variable / 8] |= 1 << (variable % 8);
+          continue;
+        }
+
+        // Sign extend the delta from the width of the type
+        const int shift = 32 - 8 * length;
+        const int32_t delta = ((int32_t)((current - last) << shift)) >> shift;
+        uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+        do
+        {
+          if (encodedLength >= layout->packetLength)
+          {
+            keyframe = true;
+            break;
+          }
+          encoded[encodedLength++] = (zigzag & 0x7F) | (zigzag > 0x7F ? 0x80 : 0);
+          zigzag >>= 7;
+        } while (zigzag);
+
+        if (keyframe)
+          break;
+      }
+    }
+
+    if (!keyframe && encodedLength < layout->packetLength)
+    {
+      memcpy(blk->lastValues, values, layout->packetLength);
+      memcpy(encoded, mask, maskLength);
+      memcpy(&values[LOG_COMPRESSION_HEADER_LEN], encoded, encodedLength);
+      values[0] = blk->sequence & LOG_COMPRESSION_SEQUENCE_MASK;
+      pk->size = 4 + LOG_COMPRESSION_HEADER_LEN + encodedLength;
+      blk->sequence++;
+      blk->samplesSinceKeyframe++;
+      return;
+    }
+  }
+
+  memcpy(blk->lastValues, values, layout->packetLength);
+  memmove(&values[LOG_COMPRESSION_HEADER_LEN], values, layout->packetLength);
+  values[0] = LOG_COMPRESSION_KEYFRAME | (blk->sequence & LOG_COMPRESSION_SEQUENCE_MASK);
+  pk->size = 4 + LOG_COMPRESSION_HEADER_LEN + layout->packetLength;
+  blk->sequence++;
+  blk->samplesSinceKeyframe = 1;
+  blk->needKeyframe = false;
+  blk->lastGeneration = snapshot->generation;
+}
+
+/* Sends the pending aggregated packet, if any. Must be called with the aggregationLock taken. */
+static void logAggregationSend()
+{
+  if (aggregationPk.size > LOG_AGG_HEADER_LEN)
+  {
+    // No need to block here, since logging is not guaranteed
+    crtpSendPacket(&aggregationPk);
+  }
+  aggregationPk.size = 0;
+}
+
+/* Runs from the worker after the blocks that were due with the first block
+ * of the pending aggregated packet. */
+static void logAggregationFlush(void * arg)
+{
+  xSemaphoreTake(aggregationLock, portMAX_DELAY);
+  aggregationFlushScheduled = false;
+  logAggregationSend();
+  xSemaphoreGive(aggregationLock);
+}
+
+/* Adds a block packet, as built by logRunBlock(), to the pending aggregated
+ * packet. Blocks with the same timestamp are packed together as
+ * [BLOCK_ID, values] entries after a common timestamp, the client knows the
+ * length of the values from the block definition. Compressed blocks vary in
+ * length and get a length byte after the BLOCK_ID. A packet is sent when the
+ * next entry does not fit or the timestamp changes, and at the latest by the
+ * flush scheduled on the worker. */
+static void logAggregate(const CRTPPacket* pk, unsigned int timestamp, bool withLength)
+{
+  xSemaphoreTake(aggregationLock, portMAX_DELAY);
+
+  const uint8_t valuesLength = pk->size - 4;
+  const uint8_t headerLength = withLength ? 2 : 1;
+  const uint8_t entryLength = headerLength + valuesLength;
+
+  if (aggregationPk.size > 0 &&
+      (aggregationTimestamp != timestamp || aggregationPk.size + entryLength > CRTP_MAX_DATA_SIZE))
+  {
+    logAggregationSend();
+  }
+
+  if (aggregationPk.size == 0)
+  {
+    aggregationPk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_AGG_CH);
+    memcpy(aggregationPk.data, &pk->data[1], LOG_AGG_HEADER_LEN);
+    aggregationPk.size = LOG_AGG_HEADER_LEN;
+    aggregationTimestamp = timestamp;
+  }
+
+  aggregationPk.data[aggregationPk.size] = pk->data[0];
+  if (withLength)
+  {
+    aggregationPk.data[aggregationPk.size + 1] = valuesLength;
+  }
+  memcpy(&aggregationPk.data[aggregationPk.size + headerLength], &pk->data[4], valuesLength);
+  aggregationPk.size += entryLength;
+
+  if (!aggregationFlushScheduled)
+  {
+    if (workerSchedule(logAggregationFlush, NULL) == 0)
+    {
+      aggregationFlushScheduled = true;
+    }
+    else
+    {
+      logAggregationSend();
+    }
+  }
+
+  xSemaphoreGive(aggregationLock);
+}
+
+static int variableGetIndex(int id)
+{
+  int i;
+  int n=0;
+
+  for (i=0; i<logsLen; i++)
+  {
+    if(!(logs[i].type & LOG_GROUP))
+    {
+      if(n==id)
+        break;
+      n++;
+    }
+  }
+
+  if (i>=logsLen)
+    return -1;
+
+  return i;
+}
+
+static int blockCalcLength(struct log_block * block)
+{
+  struct log_ops * ops;
+  int len = 0;
+
+  for (ops = block->ops; ops; ops = ops->next)
+    len += typeLength[ops->logType];
+
+  return len;
+}
+
+static int blockMaxLength(struct log_block * block)
+{
+  if (block->compressed)
+    return LOG_MAX_LEN - LOG_COMPRESSION_HEADER_LEN;
+
+  return LOG_MAX_LEN;
+}
+
+void blockAppendOps(struct log_block * block, struct log_ops * ops)
+{
+  struct log_ops * o;
+
+  ops->next = NULL;
+
+  if (block->ops == NULL)
+    block->ops = ops;
+  else
+  {
+    for (o = block->ops; o->next; o = o->next);
+
+    o->next = ops;
+  }
+}
+
+/* Compiles the ops of all blocks into the snapshot that is not published and
+ * publishes it. Must be called with the logLock taken, after any change of the
+ * blocks or ops. */
+static void logCompileBlocks()
+{
+  int packIndex = 0;
+  uint8_t highRateBlocks = 0;
+  const uint8_t snapshotIndex = publishedSnapshot ^ 1;
+  struct log_snapshot * snapshot = &logSnapshots[snapshotIndex];
+
+  // Wait for the blocks that still run from the previous snapshot
+  while (__atomic_load_n(&snapshotReaders[snapshotIndex], __ATOMIC_SEQ_CST) != 0)
+  {
+    snapshotWaits++;
+    vTaskDelay(1);
+  }
+
+  snapshot->generation = logSnapshots[publishedSnapshot].generation + 1;
+
+  for (int i = 0; i < LOG_BLOCK_SLOTS; i++)
+  {
+    struct log_block * block = &logBlocks[i];
+    struct log_block_layout * layout = &snapshot->blocks[i];
+    layout->id = block->id;
+    layout->packStart = packIndex;
+    layout->packCount = 0;
+    layout->packetLength = 0;
+
+    if (block->id == BLOCK_ID_FREE)
+      continue;
+
+    if (block->highRateDivider != 0)
+      highRateBlocks++;
+
+    for (struct log_ops * ops = block->ops; ops; ops = ops->next)
+    {
+      const uint8_t length = typeLength[ops->logType];
+
+      // The length is checked when appending, this should never happen
+      if (layout->packetLength + length > LOG_MAX_LEN)
+        break;
+
+      layout->packCount = logPackAppend(&snapshot->packs[packIndex], layout->packCount, ops->variable,
+                                        ops->storageType, ops->logType, length, ops->acquisitionType,
+                                        ops->deadband);
+      layout->packetLength += length;
+    }
+    packIndex += layout->packCount;
+  }
+
+  __atomic_store_n(&publishedSnapshot, snapshotIndex, __ATOMIC_SEQ_CST);
+  highRateBlockCount = highRateBlocks;
+}
+
+static void logReset(void)
+{
+  int i;
+
+  if (isInit)
+  {
+    //Stop and delete all started log blocks
+    for(i=0; i<LOG_BLOCK_SLOTS; i++)
+      if (logBlocks[i].id != -1)
+      {
+        logStopBlock(logBlocks[i].id);
+        logDeleteBlock(logBlocks[i].id);
+      }
+  }
+
+  //Force free all the log block objects
+  for(i=0; i<LOG_BLOCK_SLOTS; i++)
+  {
+    logBlocks[i].id = BLOCK_ID_FREE;
+    logBlocks[i].highRateDivider = 0;
+    logBlocks[i].requestedDivider = 0;
+    logBlocks[i].period = 0;
+  }
+
+  //Force free the log block objects and ops
+  staticPoolReset(&logBlocksPool);
+  staticPoolReset(&logReservedBlocksPool);
+  staticPoolReset(&logOpsPool);
+  staticPoolReset(&logReservedOpsPool);
+
+  logCompileBlocks();
+
+  //Back to one packet per block, the client has to enable aggregation again
+  aggregationEnabled = false;
+  xSemaphoreTake(aggregationLock, portMAX_DELAY);
+  aggregationPk.size = 0;
+  xSemaphoreGive(aggregationLock);
+}
+
+/* Public API to access log TOC from within the copter */
+static logVarId_t invalidVarId = 0xffffu;
+
+static void logTocHashBuild(void)
+{
+  const char* group = "";
+
+  tocHashInit(&logTocHash, logTocHashSlots, LOG_TOC_HASH_SIZE);
+
+  for (int i = 0; i < logsLen; i++)
+  {
+    if (logs[i].type & LOG_GROUP) {
+      if (logs[i].type & LOG_START) {
+        group = logs[i].name;
+      }
+    } else if (!tocHashInsert(&logTocHash, tocHashName(group, logs[i].name), i)) {
+      DEBUG_PRINT("Log TOC too big for the hash index, using linear lookups\n");
+      return;
+    }
+  }
+
+  logTocHashed = true;
+}
+
+static const char* logGroupOf(int index)
+{
+  for (; index >= 0; index--)
+  {
+    if ((logs[index].type & LOG_GROUP) && (logs[index].type & LOG_START))
+      return logs[index].name;
+  }
+
+  return "";
+}
+
+static bool logTocHashMatch(uint16_t index, const char* group, const char* name)
+{
+  return (!strcmp(name, logs[index].name)) && (!strcmp(group, logGroupOf(index)));
+}
+
+void logGetTocInfo(uint16_t* count, uint32_t* crc)
+{
+  *count = logsCount;
+  *crc = logsCrc;
+}
+
+uint8_t logGetStoredProfiles(void)
+{
+  return storedProfiles;
+}
+
+logVarId_t logGetVarId(char* group, char* name)
+{
+  if (logTocHashed)
+  {
+    const int index = tocHashFind(&logTocHash, group, name, logTocHashMatch);
+    if (index < 0)
+      return invalidVarId;
+
+    return (logVarId_t)index;
+  }
+
+  int i;
+  logVarId_t varId = invalidVarId;
+  char * currgroup = "";
 
   for(i=0; i<logsLen; i++)
   {
@@ -984,6 +2296,16 @@ logVarId_t logGetVarId(char* group, char* name)
   return invalidVarId;
 }
 
+logVarId_t logGetVarIdFromTocId(uint16_t tocId)
+{
+  const int index = variableGetIndex(tocId);
+
+  if (index < 0)
+    return invalidVarId;
+
+  return (logVarId_t)index;
+}
+
 int logGetType(logVarId_t varid)
 {
   return logs[varid].type;
@@ -1076,3 +2398,118 @@ static acquisitionType_t acquisitionTypeFromLogType(uint8_t logType) {
 
   return acqType_memory;
 }
+
+/**
+ * Timing of the high rate log scheduler, that runs log blocks in phase with
+ * the stabilizer loop.
+ */
+LOG_GROUP_START(logHr)
+/**
+ * @brief Latency from the stabilizer trigger to the start of the latest run [us]
+ */
+LOG_ADD(LOG_UINT32, latency, &highRateLatency)
+/**
+ * @brief Maximum latency from the stabilizer trigger since startup [us]
+ */
+LOG_ADD(LOG_UINT32, latMax, &highRateLatencyMax)
+/**
+ * @brief Maximum deviation of the period from the stabilizer period, over the latest second [us]
+ */
+LOG_ADD(LOG_UINT32, jitter, &highRateJitterMax)
+/**
+ * @brief Number of stabilizer loops that the high rate scheduler has missed
+ */
+LOG_ADD(LOG_UINT32, missed, &highRateMissed)
+LOG_GROUP_STOP(logHr)
+
+/**
+ * Rate control of the log blocks, that slows the blocks down when the link
+ * is congested. The effective rate of a block is read with CONTROL_GET_RATE.
+ */
+LOG_GROUP_START(logRate)
+/**
+ * @brief Throttle level, the rate of a block with priority p is halved throttle - p times
+ */
+LOG_ADD(LOG_UINT8, throttle, &rateThrottle)
+/**
+ * @brief Number of control periods (100 ms) the link was congested since startup
+ */
+LOG_ADD(LOG_UINT32, congested, &rateCongestedCount)
+LOG_GROUP_STOP(logRate)
+
+/**
+ * Rate of the log task, that runs the rate control, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateLog, rateSupervisorContext)
+
+/**
+ * Rate control of the log blocks
+ */
+PARAM_GROUP_START(logRate)
+/**
+ * @brief Nonzero to slow the log blocks down when the link is congested (default 1)
+ */
+PARAM_ADD(PARAM_UINT8, enable, &rateControlEnable)
+/**
+ * @brief Average time in the crtp tx queues above which the link is congested [ms] (default 50)
+ */
+PARAM_ADD(PARAM_UINT16, maxQTime, &rateControlMaxQueueTime)
+PARAM_GROUP_STOP(logRate)
+
+/**
+ * Contention in the log subsystem. Running blocks do not take the logLock,
+ * it is only held by TOC and control commands.
+ */
+LOG_GROUP_START(logLock)
+/**
+ * @brief Time the logLock was held by the latest TOC or control command [us]
+ */
+LOG_ADD(LOG_UINT32, hold, &lockHoldTime)
+/**
+ * @brief Maximum time the logLock was held since startup [us]
+ */
+LOG_ADD(LOG_UINT32, holdMax, &lockHoldTimeMax)
+/**
+ * @brief Maximum time a TOC or control command waited for the logLock since startup [us]
+ */
+LOG_ADD(LOG_UINT32, waitMax, &lockWaitTimeMax)
+/**
+ * @brief Number of times a recompilation of the blocks waited for running blocks
+ */
+LOG_ADD(LOG_UINT32, snapWait, &snapshotWaits)
+/**
+ * @brief Number of block runs that were skipped since the previous run of the block was not done
+ */
+LOG_ADD(LOG_UINT32, skipped, &runsSkipped)
+LOG_GROUP_STOP(logLock)
+
+/**
+ * Usage of the shared log block and ops pools, the reserved pools are not
+ * included.
+ */
+LOG_GROUP_START(logPool)
+/**
+ * @brief Number of allocated log ops (variables in blocks)
+ */
+LOG_ADD(LOG_UINT16, opsUsed, &logOpsPool.used)
+/**
+ * @brief Maximum number of allocated log ops since startup
+ */
+LOG_ADD(LOG_UINT16, opsHigh, &logOpsPool.highWater)
+/**
+ * @brief Number of failed log ops allocations since startup
+ */
+LOG_ADD(LOG_UINT32, opsFail, &logOpsPool.failures)
+/**
+ * @brief Number of allocated log blocks
+ */
+LOG_ADD(LOG_UINT16, blkUsed, &logBlocksPool.used)
+/**
+ * @brief Maximum number of allocated log blocks since startup
+ */
+LOG_ADD(LOG_UINT16, blkHigh, &logBlocksPool.highWater)
+/**
+ * @brief Number of failed log block allocations since startup
+ */
+LOG_ADD(LOG_UINT32, blkFail, &logBlocksPool.failures)
+LOG_GROUP_STOP(logPool)
@@ -0,0 +1,363 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * log_capture.c - Burst capture of log variables to RAM
+ *
+ * While armed, the log variables set in the capture.varN parameters are
+ * sampled every stabilizer loop into a ring buffer. A trigger (CRTP through
+ * the capture.trigger parameter, a tumble or crash while flying, an event
+ * trigger or disarming) stops the capture after capture.post more samples.
+ * The frozen buffer is read through the memory subsystem (MEM_TYPE_CAPTURE)
+ * and the capture is started over by setting capture.rearm.
+ *
+ * Memory layout: a logCaptureHeader_t followed by the samples, oldest first.
+ * Each sample is the uint32_t stabilizer tick followed by one float per
+ * variable.
+ */
+
+#include <string.h>
+
+#include "log_capture.h"
+#include "log.h"
+#include "param.h"
+#include "mem.h"
+#include "system.h"
+#include "eventtrigger.h"
+#include "static_mem.h"
+
+#ifndef LOG_CAPTURE_BUFFER_SIZE
+#define LOG_CAPTURE_BUFFER_SIZE 16384
+#endif
+
+#define LOG_CAPTURE_MAX_VARIABLES 8
+#define LOG_CAPTURE_VERSION 1
+#define LOG_CAPTURE_NO_EVENT 0xffff
+#define LOG_CAPTURE_NO_VARIABLE 0xffff
+
+#define LOG_CAPTURE_TRIGGER_SOURCE(SOURCE) (1 << (SOURCE))
+#define LOG_CAPTURE_TRIGGER_ALL 0xff
+
+typedef enum {
+  captureIdle,
+  captureRunning,
+  captureTriggered,
+  captureDone,
+} captureState_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t variableCount;
+  uint16_t sampleCount;
+  uint16_t triggerSample; // Index of the sample taken when the trigger was handled
+  uint8_t triggerSource;  // logCaptureTrigger_t
+  uint8_t sampleSize;     // Bytes per sample
+  uint32_t triggerTick;
+  uint16_t variables[LOG_CAPTURE_MAX_VARIABLES]; // Log variable ids, in the order of the samples
+} __attribute__((packed)) logCaptureHeader_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static uint8_t buffer[LOG_CAPTURE_BUFFER_SIZE];
+
+static bool isInit = false;
+static uint8_t state = captureIdle; // captureState_t
+static logCaptureHeader_t header;
+static logVarId_t variableIds[LOG_CAPTURE_MAX_VARIABLES];
+static uint16_t capacity;
+static uint16_t head;
+static uint16_t samplesAfterTrigger;
+static volatile int8_t pendingTrigger = -1;
+
+// Parameters
+static uint8_t enable = 0;
+static uint8_t rearm = 0;
+static uint8_t trigger = 0;
+static uint8_t triggerSources = LOG_CAPTURE_TRIGGER_ALL;
+static uint16_t postSamples = 100;
+static uint16_t triggerEvent = LOG_CAPTURE_NO_EVENT;
+static uint16_t subscribedEvent = LOG_CAPTURE_NO_EVENT;
+static uint16_t captureVariables[LOG_CAPTURE_MAX_VARIABLES] = {
+  [0 ... LOG_CAPTURE_MAX_VARIABLES - 1] = LOG_CAPTURE_NO_VARIABLE,
+};
+
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_CAPTURE,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+static void captureEventtriggerCallback(const eventtriggerRecord *record)
+{
+  if (record->id == triggerEvent) {
+    logCaptureTrigger(logCaptureTriggerEvent);
+  }
+}
+
+static void triggerEventChanged(void)
+{
+  eventtriggerSubscribe(eventtriggerHandler_Capture, subscribedEvent, false);
+  subscribedEvent = triggerEvent;
+  eventtriggerSubscribe(eventtriggerHandler_Capture, subscribedEvent, true);
+}
+
+void logCaptureInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  memoryRegisterHandler(&memDef);
+  eventtriggerRegisterCallback(eventtriggerHandler_Capture, captureEventtriggerCallback);
+
+  isInit = true;
+}
+
+bool logCaptureTest(void)
+{
+  return isInit;
+}
+
+void logCaptureTrigger(logCaptureTrigger_t source)
+{
+  if (triggerSources & LOG_CAPTURE_TRIGGER_SOURCE(source)) {
+    pendingTrigger = source;
+  }
+}
+
+static void start()
+{
+  memset(&header, 0, sizeof(header));
+  header.version = LOG_CAPTURE_VERSION;
+
+  for (int i = 0; i < LOG_CAPTURE_MAX_VARIABLES; i++) {
+    const logVarId_t varId = logGetVarIdFromTocId(captureVariables[i]);
+    if (logVarIdIsValid(varId)) {
+      variableIds[header.variableCount] = varId;
+      header.variables[header.variableCount] = captureVariables[i];
+      header.variableCount++;
+    }
+  }
+
+  header.sampleSize = sizeof(uint32_t) + header.variableCount * sizeof(float);
+  capacity = sizeof(buffer) / header.sampleSize;
+  head = 0;
+  samplesAfterTrigger = 0;
+  pendingTrigger = -1;
+  state = captureRunning;
+}
+
+static void finish()
+{
+  header.triggerSample = header.sampleCount - 1 - samplesAfterTrigger;
+  state = captureDone;
+}
+
+static void handleTrigger(uint8_t source, uint32_t tick)
+{
+  header.triggerSource = source;
+  header.triggerTick = tick;
+  samplesAfterTrigger = 0;
+  state = captureTriggered;
+}
+
+static void addSample(uint32_t tick)
+{
+  uint8_t* sample = &buffer[head * header.sampleSize];
+  memcpy(sample, &tick, sizeof(tick));
+  for (int i = 0; i < header.variableCount; i++) {
+    const float value = logGetFloat(variableIds[i]);
+    memcpy(&sample[sizeof(tick) + i * sizeof(float)], &value, sizeof(value));
+  }
+
+  head = (head + 1) % capacity;
+  if (header.sampleCount < capacity) {
+    header.sampleCount++;
+  }
+}
+
+void logCaptureSample(uint32_t tick)
+{
+  if (trigger) {
+    trigger = 0;
+    logCaptureTrigger(logCaptureTriggerCrtp);
+  }
+
+  if (state == captureDone) {
+    if (!rearm) {
+      return;
+    }
+    state = captureIdle;
+  }
+  rearm = 0;
+
+  const bool armed = systemIsArmed();
+
+  if (state == captureIdle) {
+    if (!enable || !armed) {
+      return;
+    }
+    start();
+  }
+
+  if (!enable) {
+    state = captureIdle;
+    return;
+  }
+
+  if (!armed) {
+    // No samples while disarmed, keep the capture if it was triggered
+    const bool keep = (state == captureTriggered) ||
+                      (triggerSources & LOG_CAPTURE_TRIGGER_SOURCE(logCaptureTriggerDisarm));
+    if (state == captureRunning && keep) {
+      handleTrigger(logCaptureTriggerDisarm, tick);
+    }
+
+    if (keep && header.sampleCount > 0) {
+      finish();
+    } else {
+      state = captureIdle;
+    }
+    return;
+  }
+
+  const int8_t source = pendingTrigger;
+  if (source >= 0) {
+    pendingTrigger = -1;
+    if (state == captureRunning) {
+      handleTrigger(source, tick);
+    }
+  }
+
+  addSample(tick);
+
+  if (state == captureTriggered) {
+    if (samplesAfterTrigger >= postSamples || samplesAfterTrigger >= capacity - 1) {
+      finish();
+    } else {
+      samplesAfterTrigger++;
+    }
+  }
+}
+
+static uint32_t handleMemGetSize(void)
+{
+  if (state != captureDone) {
+    return 0;
+  }
+
+  return sizeof(header) + header.sampleCount * header.sampleSize;
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest)
+{
+  if (state != captureDone || memAddr + readLen > handleMemGetSize()) {
+    return false;
+  }
+
+  const uint16_t oldest = (head + capacity - header.sampleCount) % capacity;
+  uint32_t address = memAddr;
+  uint8_t remaining = readLen;
+
+  while (remaining > 0) {
+    uint8_t length;
+    if (address < sizeof(header)) {
+      length = sizeof(header) - address;
+      if (length > remaining) {
+        length = remaining;
+      }
+      memcpy(dest, ((uint8_t*)&header) + address, length);
+    } else {
+      const uint32_t sampleAddress = address - sizeof(header);
+      const uint16_t sample = (oldest + sampleAddress / header.sampleSize) % capacity;
+      const uint8_t offset = sampleAddress % header.sampleSize;
+      length = header.sampleSize - offset;
+      if (length > remaining) {
+        length = remaining;
+      }
+      memcpy(dest, &buffer[sample * header.sampleSize + offset], length);
+    }
+
+    dest += length;
+    address += length;
+    remaining -= length;
+  }
+
+  return true;
+}
+
+/**
+ * Burst capture of log variables, sampled every stabilizer loop while armed.
+ * The captured samples are read through the memory subsystem.
+ */
+PARAM_GROUP_START(capture)
+/**
+ * @brief Nonzero to capture while armed
+ */
+PARAM_ADD(PARAM_UINT8, enable, &enable)
+/**
+ * @brief Set to 1 to start a new capture after a trigger, the current capture is discarded
+ */
+PARAM_ADD(PARAM_UINT8, rearm, &rearm)
+/**
+ * @brief Set to 1 to trigger the capture
+ */
+PARAM_ADD(PARAM_UINT8, trigger, &trigger)
+/**
+ * @brief Enabled triggers, a bit per logCaptureTrigger_t: CRTP, tumble, event, disarm
+ */
+PARAM_ADD(PARAM_UINT8, trigSrc, &triggerSources)
+/**
+ * @brief Number of samples to capture after the trigger
+ */
+PARAM_ADD(PARAM_UINT16, post, &postSamples)
+/**
+ * @brief Id of the event trigger that triggers the capture (0xffff for none)
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT16, event, &triggerEvent, triggerEventChanged)
+/**
+ * @brief Ids of the log variables to capture (0xffff for none), read when the capture starts
+ */
+PARAM_ADD(PARAM_UINT16, var0, &captureVariables[0])
+PARAM_ADD(PARAM_UINT16, var1, &captureVariables[1])
+PARAM_ADD(PARAM_UINT16, var2, &captureVariables[2])
+PARAM_ADD(PARAM_UINT16, var3, &captureVariables[3])
+PARAM_ADD(PARAM_UINT16, var4, &captureVariables[4])
+PARAM_ADD(PARAM_UINT16, var5, &captureVariables[5])
+PARAM_ADD(PARAM_UINT16, var6, &captureVariables[6])
+PARAM_ADD(PARAM_UINT16, var7, &captureVariables[7])
+PARAM_GROUP_STOP(capture)
+
+/**
+ * State of the burst capture.
+ */
+LOG_GROUP_START(capture)
+/**
+ * @brief 0: idle, 1: running, 2: triggered, 3: done and ready to be read
+ */
+LOG_ADD(LOG_UINT8, state, &state)
+/**
+ * @brief Number of captured samples
+ */
+LOG_ADD(LOG_UINT16, samples, &header.sampleCount)
+LOG_GROUP_STOP(capture)
@@ -0,0 +1,63 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * log_pack.c - compiled form of the variables of a log block
+ */
+
+#include "log_pack.h"
+#include "log.h"
+
+uint8_t logPackAppend(struct log_pack* packs, const uint8_t packCount, void* variable, const uint8_t storageType,
+                      const uint8_t logType, const uint8_t length, const uint8_t acquisitionType, const float deadband)
+{
+  const bool isCopy = (acquisitionType == acqType_memory) &&
+                      (storageType == logType) &&
+                      (logType != LOG_FP16);
+
+  // The deadband is stored per pack, variables with a deadband are not merged
+  if (isCopy && packCount > 0)
+  {
+    struct log_pack * previous = &packs[packCount - 1];
+    if (previous->op == packCopy &&
+        previous->logType == logType && previous->storageType == storageType &&
+        previous->deadband == 0 && deadband == 0 &&
+        (uint8_t*)previous->variable + previous->length == (uint8_t*)variable)
+    {
+      // Adjacent in memory, extend the previous copy
+      previous->length += length;
+      return packCount;
+    }
+  }
+
+  struct log_pack * pack = &packs[packCount];
+  pack->variable = variable;
+  pack->op = isCopy ? packCopy : packConvert;
+  pack->storageType = storageType;
+  pack->logType = logType;
+  pack->length = length;
+  pack->acquisitionType = acquisitionType;
+  pack->deadband = deadband;
+
+  return packCount + 1;
+}
@@ -45,6 +45,7 @@
 #include "log.h"
 #include "param.h"
 #include "static_mem.h"
+#include "crc32.h"
 
 #if 0
 #define MEM_DEBUG(fmt, ...) DEBUG_PRINT("D/log " fmt, ## __VA_ARGS__)
@@ -61,6 +62,20 @@
 #define MEM_SETTINGS_CH     0
 #define MEM_READ_CH         1
 #define MEM_WRITE_CH        2
+#define MEM_STREAM_CH       3
+
+#define MEM_STREAM_READ     0
+#define MEM_STREAM_STOP     1
+#define MEM_STREAM_GET_WINDOW 2
+
+// Data bytes per read reply
+#define MEM_STREAM_CHUNK    (MEM_MAX_LEN - 6)
+// Read and write requests that a client may have outstanding, they are
+// queued in the CRTP rx queue of the port
+#define MEM_WINDOW          8
+// A stream leaves this many packets free in the CRTP tx queue it shares with
+// the parameter port
+#define MEM_STREAM_TX_RESERVE 16
 
 #define MEM_CMD_GET_NBR     1
 #define MEM_CMD_GET_INFO    2
@@ -74,6 +89,8 @@ static void memTask(void * prm);
 static void memSettingsProcess(CRTPPacket* p);
 static void memWriteProcess(CRTPPacket* p);
 static void memReadProcess(CRTPPacket* p);
+static void memStreamProcess(CRTPPacket* p);
+static void memStreamSendChunk(void);
 static void createNbrResponse(CRTPPacket* p);
 static void createInfoResponse(CRTPPacket* p, uint8_t memId);
 static void createInfoResponseBody(CRTPPacket* p, uint8_t type, uint32_t memSize, const uint8_t data[8]);
@@ -97,7 +114,16 @@ static uint8_t nbrOwMems = 0;
 static const uint8_t NoSerialNr[MEMORY_SERIAL_LENGTH] = {0, 0, 0, 0, 0, 0, 0, 0};
 static CRTPPacket packet;
 
-#define MAX_NR_HANDLERS 20
+// Bulk read that is pushed to the client, one read reply per chunk
+static struct {
+  bool active;
+  uint8_t memId;
+  uint32_t address;
+  uint32_t endAddress;
+  CRTPPacket packet;
+} stream;
+
+#define MAX_NR_HANDLERS 24
 static const MemoryHandlerDef_t* handlers[MAX_NR_HANDLERS];
 static uint8_t nrOfHandlers = 0;
 static const MemoryOwHandlerDef_t* owMemHandler = 0;
@@ -147,6 +173,29 @@ void memoryRegisterOwHandler(const MemoryOwHandlerDef_t* handlerDef){
   nbrOwMems = handlerDef->nrOfMems;
 }
 
+void memGetMapInfo(uint8_t* count, uint32_t* crc) {
+  crc32Context_t context;
+  crc32ContextInit(&context);
+
+  for (int i = 0; i < nrOfHandlers; i++) {
+    const uint8_t type = handlers[i]->type;
+    crc32Update(&context, &type, 1);
+  }
+
+  for (int i = 0; i < nbrOwMems; i++) {
+    const uint8_t type = MEM_TYPE_OW;
+    uint8_t serialNr[MEMORY_SERIAL_LENGTH];
+    if (!owMemHandler->getSerialNr(i, serialNr)) {
+      memcpy(serialNr, NoSerialNr, MEMORY_SERIAL_LENGTH);
+    }
+    crc32Update(&context, &type, 1);
+    crc32Update(&context, serialNr, MEMORY_SERIAL_LENGTH);
+  }
+
+  *count = nbrOwMems + nrOfHandlers;
+  *crc = crc32Out(&context);
+}
+
 static void memTask(void* param) {
 	crtpInitTaskQueue(CRTP_PORT_MEM);
 
@@ -157,7 +206,15 @@ static void memTask(void* param) {
   registrationEnabled = false;
 
 	while(1) {
-		crtpReceivePacketBlock(CRTP_PORT_MEM, &packet);
+		if (stream.active) {
+		  // Keep serving requests between the chunks of a stream
+		  if (!crtpReceivePacket(CRTP_PORT_MEM, &packet)) {
+		    memStreamSendChunk();
+		    continue;
+		  }
+		} else {
+		  crtpReceivePacketBlock(CRTP_PORT_MEM, &packet);
+		}
 
 		switch (packet.channel) {
       case MEM_SETTINGS_CH:
@@ -169,6 +226,9 @@ static void memTask(void* param) {
       case MEM_WRITE_CH:
         memWriteProcess(&packet);
         break;
+      case MEM_STREAM_CH:
+        memStreamProcess(&packet);
+        break;
       default:
         // Do nothing
         break;
@@ -235,6 +295,21 @@ static void createInfoResponseBody(CRTPPacket* p, uint8_t type, uint32_t memSize
 }
 
 
+static bool memRead(const uint8_t memId, const uint32_t memAddr, const uint8_t readLen, uint8_t* startOfData) {
+  bool result = false;
+
+  if (memId < nrOfHandlers) {
+    if (handlers[memId]->read) {
+      result = handlers[memId]->read(memAddr, readLen, startOfData);
+    }
+  } else {
+    uint8_t selectedMem = memId - nrOfHandlers;
+    result = owMemHandler->read(selectedMem, memAddr, readLen, startOfData);
+  }
+
+  return result;
+}
+
 static void memReadProcess(CRTPPacket* p) {
   uint32_t memAddr;
   bool result = false;
@@ -247,14 +322,7 @@ static void memReadProcess(CRTPPacket* p) {
   uint8_t readLen = p->data[5];
   uint8_t* startOfData = &p->data[6];
 
-  if (memId < nrOfHandlers) {
-    if (handlers[memId]->read) {
-      result = handlers[memId]->read(memAddr, readLen, startOfData);
-    }
-  } else {
-    uint8_t selectedMem = memId - nrOfHandlers;
-    result = owMemHandler->read(selectedMem, memAddr, readLen, startOfData);
-  }
+  result = memRead(memId, memAddr, readLen, startOfData);
 
   p->data[5] = result ? STATUS_OK : EIO;
   if (result) {
@@ -295,6 +363,102 @@ static void memWriteProcess(CRTPPacket* p) {
   crtpSendPacketBlock(p);
 }
 
+static void memStreamSendDone(uint8_t status) {
+  CRTPPacket* p = &stream.packet;
+
+  p->header = CRTP_HEADER(CRTP_PORT_MEM, MEM_STREAM_CH);
+  p->data[0] = MEM_STREAM_READ;
+  p->data[1] = stream.memId;
+  memcpy(&p->data[2], &stream.address, 4);
+  p->data[6] = status;
+  p->size = 7;
+  crtpSendPacketBlock(p);
+
+  stream.active = false;
+}
+
+/* Sends the next chunk of the stream as a read reply, the same packet as the
+ * answer to a read request for the address. The client detects missing
+ * chunks from the addresses and reads them again with read requests. */
+static void memStreamSendChunk(void) {
+  CRTPPacket* p = &stream.packet;
+
+  if (crtpGetFreeTxQueuePacketsForPort(CRTP_PORT_MEM) <= MEM_STREAM_TX_RESERVE) {
+    vTaskDelay(1);
+    return;
+  }
+
+  uint32_t length = stream.endAddress - stream.address;
+  if (length > MEM_STREAM_CHUNK) {
+    length = MEM_STREAM_CHUNK;
+  }
+
+  p->header = CRTP_HEADER(CRTP_PORT_MEM, MEM_READ_CH);
+  p->data[0] = stream.memId;
+  memcpy(&p->data[1], &stream.address, 4);
+  if (!memRead(stream.memId, stream.address, length, &p->data[6])) {
+    memStreamSendDone(EIO);
+    return;
+  }
+  p->data[5] = STATUS_OK;
+  p->size = 6 + length;
+  crtpSendPacketBlock(p);
+
+  stream.address += length;
+  if (stream.address >= stream.endAddress) {
+    memStreamSendDone(STATUS_OK);
+  }
+}
+
+static void memStreamProcess(CRTPPacket* p) {
+  p->header = CRTP_HEADER(CRTP_PORT_MEM, MEM_STREAM_CH);
+
+  switch (p->data[0]) {
+    case MEM_STREAM_READ:
+    {
+      uint32_t length;
+      const uint8_t memId = p->data[1];
+
+      if (memId >= nbrOwMems + nrOfHandlers || p->size < 10) {
+        p->data[6] = EINVAL;
+        p->size = 7;
+        crtpSendPacketBlock(p);
+        break;
+      }
+
+      // A new stream replaces the current one
+      stream.memId = memId;
+      memcpy(&stream.address, &p->data[2], 4);
+      memcpy(&length, &p->data[6], 4);
+      stream.endAddress = stream.address + length;
+      stream.active = true;
+
+      if (length == 0) {
+        memStreamSendDone(STATUS_OK);
+      }
+      break;
+    }
+
+    case MEM_STREAM_STOP:
+      if (stream.active) {
+        memStreamSendDone(ECANCELED);
+      }
+      p->size = 1;
+      crtpSendPacketBlock(p);
+      break;
+
+    case MEM_STREAM_GET_WINDOW:
+      p->data[1] = MEM_WINDOW;
+      p->size = 2;
+      crtpSendPacketBlock(p);
+      break;
+
+    default:
+      // Do nothing
+      break;
+  }
+}
+
 /**
  * @brief The memory tester is used to verify the functionality of the memory sub system.
  * It supports "virtual" read and writes that are used by a test script to
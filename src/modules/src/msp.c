@@ -30,10 +30,10 @@
  *  - http://www.multiwii.com/forum/viewtopic.php?f=8&t=1516
  */
 
+#include <string.h>
+
 #include "msp.h"
 #include "debug.h"
-#include "sensfusion6.h"
-#include "commander.h"
 
 // MSP command IDs
 #define MSP_STATUS    101
@@ -93,21 +93,40 @@ typedef struct _MspRc
   uint16_t throttle;  // Range [1000,2000] 
 }__attribute__((packed)) MspRc;
 
+_Static_assert(sizeof(MspHeader) + sizeof(MspStatus) + 1 <= MSP_RESPONSE_MAX_SIZE, "MSP responses must fit MspResponse");
+
 // Helpers
 static uint8_t mspComputeCrc(uint8_t* pBuffer, uint32_t bufferLen);
 static bool mspIsRequestValid(MspObject* pMspObject);
 static void mspProcessRequest(MspObject* pMspObject);
+static void mspPrepareResponse(MspResponse* pResponse, const uint8_t command, const void* pData, const uint8_t size);
+static void mspSendResponse(MspObject* pMspObject, const MspResponse* pResponse);
 
-// Request handlers
-static void mspHandleRequestMspStatus(MspObject* pMspObject);
-static void mspHandleRequestMspRc(MspObject* pMspObject);
-static void mspHandleRequestMspAttitude(MspObject* pMspObject);
-static void mspHandleRequestMspBoxIds(MspObject* pMspObject);
+// Response builders
+static void mspBuildResponseMspStatus(MspObject* pMspObject);
+static void mspBuildResponseMspRc(MspObject* pMspObject);
+static void mspBuildResponseMspAttitude(MspObject* pMspObject);
+static void mspBuildResponseMspBoxIds(MspObject* pMspObject);
 
 void mspInit(MspObject* pMspObject, const MspResponseCallback callback)
 {
   pMspObject->requestState = MSP_REQUEST_STATE_WAIT_FOR_START;
   pMspObject->responseCallback = callback;
+
+  pMspObject->rollId = logGetVarId("stabilizer", "roll");
+  pMspObject->pitchId = logGetVarId("stabilizer", "pitch");
+  pMspObject->yawId = logGetVarId("stabilizer", "yaw");
+
+  // The status, rc and box id responses do not change, they are only built once
+  mspBuildResponseMspStatus(pMspObject);
+  mspBuildResponseMspRc(pMspObject);
+  mspBuildResponseMspBoxIds(pMspObject);
+  mspBuildResponseMspAttitude(pMspObject);
+}
+
+void mspUpdate(MspObject* pMspObject)
+{
+  mspBuildResponseMspAttitude(pMspObject);
 }
 
 void mspProcessByte(MspObject* pMspObject, const uint8_t data)
@@ -232,39 +251,19 @@ void mspProcessRequest(MspObject* pMspObject)
   switch(pMspObject->requestHeader.command)
   {
   case MSP_STATUS:
-    mspHandleRequestMspStatus(pMspObject);
-
-    if(pMspObject->responseCallback)
-    {
-      pMspObject->responseCallback(pMspObject->mspResponse, pMspObject->mspResponseSize);
-    }
+    mspSendResponse(pMspObject, &pMspObject->status);
     break;
 
   case MSP_RC:
-    mspHandleRequestMspRc(pMspObject);
-
-    if(pMspObject->responseCallback)
-    {
-      pMspObject->responseCallback(pMspObject->mspResponse, pMspObject->mspResponseSize);
-    }
+    mspSendResponse(pMspObject, &pMspObject->rc);
     break;
 
   case MSP_ATTITUDE:
-    mspHandleRequestMspAttitude(pMspObject);
-
-    if(pMspObject->responseCallback)
-    {
-      pMspObject->responseCallback(pMspObject->mspResponse, pMspObject->mspResponseSize);
-    }
+    mspSendResponse(pMspObject, &pMspObject->attitude);
     break;
 
   case MSP_BOXIDS:
-    mspHandleRequestMspBoxIds(pMspObject);
-    
-    if(pMspObject->responseCallback)
-    {
-      pMspObject->responseCallback(pMspObject->mspResponse, pMspObject->mspResponseSize);
-    }
+    mspSendResponse(pMspObject, &pMspObject->boxIds);
     break;
 
   default:
@@ -273,110 +272,85 @@ void mspProcessRequest(MspObject* pMspObject)
   }
 }
 
-void mspHandleRequestMspStatus(MspObject* pMspObject)
+void mspSendResponse(MspObject* pMspObject, const MspResponse* pResponse)
+{
+  memcpy(pMspObject->mspResponse, pResponse->data, pResponse->size);
+  pMspObject->mspResponseSize = pResponse->size;
+
+  if(pMspObject->responseCallback)
+  {
+    pMspObject->responseCallback(pMspObject->mspResponse, pMspObject->mspResponseSize);
+  }
+}
+
+void mspPrepareResponse(MspResponse* pResponse, const uint8_t command, const void* pData, const uint8_t size)
 {
-  MspHeader* pHeader = (MspHeader*)pMspObject->mspResponse;
-  MspStatus* pData = (MspStatus*)(pMspObject->mspResponse + sizeof(MspHeader));
-  uint8_t* pCrc = (uint8_t*)(pMspObject->mspResponse + sizeof(MspHeader) + sizeof(*pData));
+  MspHeader* pHeader = (MspHeader*)pResponse->data;
 
   // Header
   pHeader->preamble[0] = MSP_PREAMBLE_0;
   pHeader->preamble[1] = MSP_PREAMBLE_1;
   pHeader->direction = MSP_DIRECTION_OUT;
-  pHeader->size = sizeof(*pData);
-  pHeader->command = MSP_STATUS;
+  pHeader->size = size;
+  pHeader->command = command;
 
   // Data
-  pData->cycleTime = 1000; // TODO: API to query this?
-  pData->i2cErrors = 0; // unused
-  pData->sensors = 0x0001; // no sensors supported yet, but need to report at least one to get the level bars to show
-  pData->flags = 0x00000001; // always report armed (bit zero)
-  pData->currentSet = 0x00;
+  memcpy(pResponse->data + sizeof(MspHeader), pData, size);
 
-  // CRC
-  *pCrc = mspComputeCrc(pMspObject->mspResponse, sizeof(pMspObject->mspResponse));
+  // CRC, over the bytes of the message only
+  pResponse->data[sizeof(MspHeader) + size] = mspComputeCrc(pResponse->data, sizeof(MspHeader) + size);
 
   // Update total response size
-  pMspObject->mspResponseSize = sizeof(MspHeader) + sizeof(*pData) + 1;
+  pResponse->size = sizeof(MspHeader) + size + 1;
 }
 
-void mspHandleRequestMspRc(MspObject* pMspObject)
+void mspBuildResponseMspStatus(MspObject* pMspObject)
 {
-  MspHeader* pHeader = (MspHeader*)pMspObject->mspResponse;
-  MspRc* pData = (MspRc*)(pMspObject->mspResponse + sizeof(MspHeader));
-  uint8_t* pCrc = (uint8_t*)(pMspObject->mspResponse + sizeof(MspHeader) + sizeof(*pData));
-
-  // Header
-  pHeader->preamble[0] = MSP_PREAMBLE_0;
-  pHeader->preamble[1] = MSP_PREAMBLE_1;
-  pHeader->direction = MSP_DIRECTION_OUT;
-  pHeader->size = sizeof(*pData);
-  pHeader->command = MSP_RC;
+  MspStatus data;
 
-  // TODO: get actual data - for now hardcode the midpoint
-  pData->roll = 1500;
-  pData->pitch = 1500;
-  pData->yaw = 1500;
-  pData->throttle = 1500;
-
-  // CRC
-  *pCrc = mspComputeCrc(pMspObject->mspResponse, sizeof(pMspObject->mspResponse));
+  data.cycleTime = 1000; // TODO: API to query this?
+  data.i2cErrors = 0; // unused
+  data.sensors = 0x0001; // no sensors supported yet, but need to report at least one to get the level bars to show
+  data.flags = 0x00000001; // always report armed (bit zero)
+  data.currentSet = 0x00;
 
-  // Update total response size
-  pMspObject->mspResponseSize = sizeof(MspHeader) + sizeof(*pData) + 1;
+  mspPrepareResponse(&pMspObject->status, MSP_STATUS, &data, sizeof(data));
 }
 
-static void mspHandleRequestMspAttitude(MspObject* pMspObject)
+void mspBuildResponseMspRc(MspObject* pMspObject)
 {
-  MspHeader* pHeader = (MspHeader*)pMspObject->mspResponse;
-  MspAttitude* pData = (MspAttitude*)(pMspObject->mspResponse + sizeof(MspHeader));
-  uint8_t* pCrc = (uint8_t*)(pMspObject->mspResponse + sizeof(MspHeader) + sizeof(*pData));
+  MspRc data;
 
-  // Header
-  pHeader->preamble[0] = MSP_PREAMBLE_0;
-  pHeader->preamble[1] = MSP_PREAMBLE_1;
-  pHeader->direction = MSP_DIRECTION_OUT;
-  pHeader->size = sizeof(*pData);
-  pHeader->command = MSP_ATTITUDE;
+  // TODO: get actual data - for now hardcode the midpoint
+  data.roll = 1500;
+  data.pitch = 1500;
+  data.yaw = 1500;
+  data.throttle = 1500;
 
-  // Data
-  float roll;
-  float pitch;
-  float yaw;
-  sensfusion6GetEulerRPY(&roll, &pitch, &yaw); // TODO: handle kalman estimator
+  mspPrepareResponse(&pMspObject->rc, MSP_RC, &data, sizeof(data));
+}
 
-  pData->angX = (int16_t)(roll * 10);
-  pData->angY = (int16_t)(pitch * 10);
-  pData->heading = 0; // TODO: mag support
+void mspBuildResponseMspAttitude(MspObject* pMspObject)
+{
+  MspAttitude data = {0};
 
-  // CRC
-  *pCrc = mspComputeCrc(pMspObject->mspResponse, sizeof(pMspObject->mspResponse));
+  // The state of the stabilizer, valid for all estimators
+  if(logVarIdIsValid(pMspObject->rollId) && logVarIdIsValid(pMspObject->pitchId) && logVarIdIsValid(pMspObject->yawId))
+  {
+    data.angX = (int16_t)(logGetFloat(pMspObject->rollId) * 10);
+    data.angY = (int16_t)(logGetFloat(pMspObject->pitchId) * 10);
+    data.heading = (int16_t)logGetFloat(pMspObject->yawId);
+  }
 
-  // Update total response size
-  pMspObject->mspResponseSize = sizeof(MspHeader) + sizeof(*pData) + 1;
+  mspPrepareResponse(&pMspObject->attitude, MSP_ATTITUDE, &data, sizeof(data));
 }
 
-static void mspHandleRequestMspBoxIds(MspObject* pMspObject)
+void mspBuildResponseMspBoxIds(MspObject* pMspObject)
 {
-  MspHeader* pHeader = (MspHeader*)pMspObject->mspResponse;
-  uint8_t* pData = (uint8_t*)(pMspObject->mspResponse + sizeof(MspHeader));
-  uint8_t* pCrc = (uint8_t*)(pMspObject->mspResponse + sizeof(MspHeader) + sizeof(*pData));
-
-  // Header
-  pHeader->preamble[0] = MSP_PREAMBLE_0;
-  pHeader->preamble[1] = MSP_PREAMBLE_1;
-  pHeader->direction = MSP_DIRECTION_OUT;
-  pHeader->size = sizeof(*pData);
-  pHeader->command = MSP_BOXIDS;
-  
   // TODO: Data - this needs to be properly implemented
-  // For now, we just return byte 0 = 0 which tells 
+  // For now, we just return byte 0 = 0 which tells
   // the client to use box ID 0 for the ARMED box
-  pData[0] = 0x00;
-
-  // CRC
-  *pCrc = mspComputeCrc(pMspObject->mspResponse, sizeof(pMspObject->mspResponse));
+  const uint8_t data = 0x00;
 
-  // Update total response size
-  pMspObject->mspResponseSize = sizeof(MspHeader) + sizeof(*pData) + 1;
+  mspPrepareResponse(&pMspObject->boxIds, MSP_BOXIDS, &data, sizeof(data));
 }
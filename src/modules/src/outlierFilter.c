@@ -39,28 +39,18 @@ static float errorDistance;
 static int filterCloseDelayCounter = 0;
 static int previousFilterIndex = 0;
 
-typedef struct {
-  float acceptanceLevel;
-  int bucket;
-} filterLevel_t;
-
+// The acceptance level of filter level i is (i + 1) * FILTER_LEVEL_STEP
 #define FILTER_LEVELS 5
+#define FILTER_LEVEL_STEP 0.4f
 #define FILTER_NONE FILTER_LEVELS
-filterLevel_t filterLevels[FILTER_LEVELS] = {
-  {.acceptanceLevel = 0.4},
-  {.acceptanceLevel = 0.8},
-  {.acceptanceLevel = 1.2},
-  {.acceptanceLevel = 1.6},
-  {.acceptanceLevel = 2.0},
-};
+static int32_t buckets[FILTER_LEVELS];
 
 
 static bool isDistanceDiffSmallerThanDistanceBetweenAnchors(const tdoaMeasurement_t* tdoa);
 static float distanceSq(const point_t* a, const point_t* b);
 static float sq(float a) {return a * a;}
-static void addToBucket(filterLevel_t* filter);
-static void removeFromBucket(filterLevel_t* filter);
-static int updateBuckets(float errorDistance);
+static int getErrorLevel(float errorDistance);
+static int updateBuckets(int errorLevel);
 
 
 
@@ -72,10 +62,12 @@ bool outlierFilterValidateTdoaSteps(const tdoaMeasurement_t* tdoa, const float e
   bool sampleIsGood = false;
 
   if (isDistanceDiffSmallerThanDistanceBetweenAnchors(tdoa)) {
-    float errorBaseDistance = sqrtf(powf(jacobian->x, 2) + powf(jacobian->y, 2) + powf(jacobian->z, 2));
+    float errorBaseDistance = sqrtf(sq(jacobian->x) + sq(jacobian->y) + sq(jacobian->z));
     errorDistance = fabsf(error / errorBaseDistance);
 
-    int filterIndex = updateBuckets(errorDistance);
+    // Quantize the error once, the buckets and the acceptance test only use the integer level
+    const int errorLevel = getErrorLevel(errorDistance);
+    int filterIndex = updateBuckets(errorLevel);
 
     if (filterIndex > previousFilterIndex) {
       filterCloseDelayCounter = FILTER_CLOSE_DELAY_COUNT;
@@ -92,8 +84,8 @@ bool outlierFilterValidateTdoaSteps(const tdoaMeasurement_t* tdoa, const float e
       acceptanceLevel = 100.0;
       sampleIsGood = true;
     } else {
-      acceptanceLevel = filterLevels[filterIndex].acceptanceLevel;
-      if (errorDistance < acceptanceLevel) {
+      acceptanceLevel = (filterIndex + 1) * FILTER_LEVEL_STEP;
+      if (errorLevel <= filterIndex) {
         sampleIsGood = true;
       }
     }
@@ -147,7 +139,11 @@ bool outlierFilterValidateLighthouseSweep(OutlierFilterLhState_t* this, const fl
 
 
 static bool isDistanceDiffSmallerThanDistanceBetweenAnchors(const tdoaMeasurement_t* tdoa) {
-  float anchorDistanceSq = distanceSq(&tdoa->anchorPositions[0], &tdoa->anchorPositions[1]);
+  // Use the distance cached in the TDoA storage when available
+  float anchorDistanceSq = tdoa->anchorDistanceSq;
+  if (anchorDistanceSq <= 0.0f) {
+    anchorDistanceSq = distanceSq(&tdoa->anchorPositions[0], &tdoa->anchorPositions[1]);
+  }
   float distanceDiffSq = sq(tdoa->distanceDiff);
   return (distanceDiffSq < anchorDistanceSq);
 }
@@ -157,31 +153,31 @@ static float distanceSq(const point_t* a, const point_t* b) {
 }
 
 
-static void addToBucket(filterLevel_t* filter) {
-  if (filter->bucket < MAX_BUCKET_FILL) {
-    filter->bucket++;
+// Returns the index of the first filter level that accepts the error, FILTER_NONE if no level does
+static int getErrorLevel(float errorDistance) {
+  const float level = errorDistance / FILTER_LEVEL_STEP;
+  if (level >= FILTER_LEVELS) {
+    return FILTER_NONE;
   }
-}
 
-static void removeFromBucket(filterLevel_t* filter) {
-  if (filter->bucket > 0) {
-    filter->bucket--;
-  }
+  return (int)level;
 }
 
-static int updateBuckets(float errorDistance) {
+static int updateBuckets(int errorLevel) {
   int filterIndex = FILTER_NONE;
 
   for (int i = FILTER_LEVELS - 1; i >= 0; i--) {
-    filterLevel_t* filter = &filterLevels[i];
-
-    if (errorDistance < filter->acceptanceLevel) {
-      removeFromBucket(filter);
+    if (i >= errorLevel) {
+      if (buckets[i] > 0) {
+        buckets[i]--;
+      }
     } else {
-      addToBucket(filter);
+      if (buckets[i] < MAX_BUCKET_FILL) {
+        buckets[i]++;
+      }
     }
 
-    if (filter->bucket < BUCKET_ACCEPTANCE_LEVEL) {
+    if (buckets[i] < BUCKET_ACCEPTANCE_LEVEL) {
       filterIndex = i;
     }
   }
@@ -190,11 +186,11 @@ static int updateBuckets(float errorDistance) {
 }
 
 LOG_GROUP_START(outlierf)
-  LOG_ADD(LOG_INT32, bucket0, &filterLevels[0].bucket)
-  LOG_ADD(LOG_INT32, bucket1, &filterLevels[1].bucket)
-  LOG_ADD(LOG_INT32, bucket2, &filterLevels[2].bucket)
-  LOG_ADD(LOG_INT32, bucket3, &filterLevels[3].bucket)
-  LOG_ADD(LOG_INT32, bucket4, &filterLevels[4].bucket)
+  LOG_ADD(LOG_INT32, bucket0, &buckets[0])
+  LOG_ADD(LOG_INT32, bucket1, &buckets[1])
+  LOG_ADD(LOG_INT32, bucket2, &buckets[2])
+  LOG_ADD(LOG_INT32, bucket3, &buckets[3])
+  LOG_ADD(LOG_INT32, bucket4, &buckets[4])
   LOG_ADD(LOG_FLOAT, accLev, &acceptanceLevel)
   LOG_ADD(LOG_FLOAT, errD, &errorDistance)
 LOG_GROUP_STOP(outlierf)
@@ -37,6 +37,8 @@
 #include "console.h"
 #include "debug.h"
 #include "static_mem.h"
+#include "tocHash.h"
+#include "storage.h"
 
 #if 0
 #define PARAM_DEBUG(fmt, ...) DEBUG_PRINT("D/param " fmt, ## __VA_ARGS__)
@@ -58,6 +60,16 @@ static const uint8_t typeLength[] = {
 
 #define TOC_CH 0
 #define READ_CH 1
+
+// Hash index of the TOC for paramGetVarId(), linear lookups are used if the TOC does not fit
+#define PARAM_TOC_HASH_SIZE 512
+NO_DMA_CCM_SAFE_ZERO_INIT static uint16_t paramTocHashSlots[PARAM_TOC_HASH_SIZE];
+static tocHash_t paramTocHash;
+static bool paramTocHashed = false;
+
+static void paramTocHashBuild(void);
+static const char* paramGroupOf(int ptr);
+static bool paramTocHashMatch(uint16_t ptr, const char* group, const char* name);
 #define WRITE_CH 2
 #define MISC_CH 3
 
@@ -69,13 +81,40 @@ static const uint8_t typeLength[] = {
 #define CMD_GET_INFO    1 // original version: up to 255 entries
 #define CMD_GET_ITEM_V2 2 // version 2: up to 16k entries
 #define CMD_GET_INFO_V2 3 // version 2: up to 16k entries
+#define CMD_GET_ITEMS_V2 4 // version 2: all entries from an id, packed
+
+// CMD_GET_ITEMS_V2: the type of an entry is or:ed with this if the group name follows
+#define TOC_ITEMS_NEW_GROUP 0x80
+#define TOC_ITEMS_MAX_PACKETS 32
 
 #define MISC_SETBYNAME 0
 #define MISC_VALUE_UPDATED 1
+#define MISC_WRITE_BATCH 2
+#define MISC_READ_BATCH 3
+#define MISC_PERSIST_ALL 4
+#define MISC_PERSIST_CLEAR 5
+#define MISC_READ_GROUP 6
+#define MISC_READ_LIST 7
+
+// MISC_READ_GROUP and MISC_READ_LIST: set in the sequence byte of the last answer
+#define READ_SNAPSHOT_LAST 0x80
+#define READ_SNAPSHOT_HEADER 3
+
+// Values of a batch read or write, copied with the scheduler suspended
+#define PARAM_BATCH_MAX_PARAMS 64
+#define PARAM_BATCH_MAX_BYTES 256
+
+// Persistent parameters are stored with the key "prm/group.name"
+#define PARAM_PERSISTENT_PREFIX "prm/"
+#define PARAM_PERSISTENT_KEY_LEN 40
+#define PARAM_PERSISTENT_MAX 64
+// Changed values are stored at most once per period
+#define PARAM_PERSISTENT_PERIOD_MS 1000
 
 //Private functions
 static void paramTask(void * prm);
 void paramTOCProcess(int command);
+static void paramTOCSendItems(uint16_t firstId, uint8_t packetCount);
 
 
 //These are set by the Linker
@@ -87,6 +126,14 @@ static void paramWriteProcess();
 static void paramReadProcess();
 static int variableGetIndex(int id);
 static char paramWriteByNameProcess(char* group, char* name, int type, void *valptr);
+static void paramWriteBatchProcess();
+static void paramReadBatchProcess();
+static void paramReadGroupProcess();
+static void paramReadListProcess();
+static void paramPersistentInit(void);
+static void paramPersistentRestore(void);
+static void paramPersistentStoreChanged(bool all);
+static void paramPersistentClear(void);
 
 //Pointer to the parameters list and length of it
 static struct param_s * params;
@@ -101,6 +148,18 @@ static CRTPPacket p;
 
 static bool isInit = false;
 
+// Index in params of the persistent parameters, and their stored values
+static uint16_t persistentPtr[PARAM_PERSISTENT_MAX];
+static uint8_t persistentStored[PARAM_PERSISTENT_MAX][8];
+static int persistentCount = 0;
+
+static struct {
+  uint16_t ptr[PARAM_BATCH_MAX_PARAMS];
+  uint8_t values[PARAM_BATCH_MAX_BYTES];
+  int count;
+  int length;
+} batch;
+
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(paramTask, PARAM_TASK_STACKSIZE);
 
 void paramInit(void)
@@ -149,12 +208,14 @@ void paramInit(void)
       paramsCount++;
   }
 
+  paramTocHashBuild();
+
+  paramPersistentInit();
+  paramPersistentRestore();
 
   //Start the param task
   STATIC_MEM_TASK_CREATE(paramTask, paramTask, PARAM_TASK_NAME, NULL, PARAM_TASK_PRI);
 
-  //TODO: Handle stored parameters!
-
   isInit = true;
 }
 
@@ -166,9 +227,19 @@ bool paramTest(void)
 void paramTask(void * prm)
 {
 	crtpInitTaskQueue(CRTP_PORT_PARAM);
+	uint32_t lastPersist = xTaskGetTickCount();
 
 	while(1) {
-		crtpReceivePacketBlock(CRTP_PORT_PARAM, &p);
+		const int received = crtpReceivePacketWait(CRTP_PORT_PARAM, &p, PARAM_PERSISTENT_PERIOD_MS);
+
+		// Written from this task only, to keep EEPROM writes away from other tasks
+		if (xTaskGetTickCount() - lastPersist >= M2T(PARAM_PERSISTENT_PERIOD_MS)) {
+		  paramPersistentStoreChanged(false);
+		  lastPersist = xTaskGetTickCount();
+		}
+
+		if (!received)
+		  continue;
 
 		if (p.channel==TOC_CH)
 		  paramTOCProcess(p.data[0]);
@@ -203,6 +274,24 @@ void paramTask(void * prm)
         p.data[1+strlen(group)+1+strlen(name)+1] = error;
         p.size = 1+strlen(group)+1+strlen(name)+1+1;
         crtpSendPacketBlock(&p);
+      } else if (p.data[0] == MISC_WRITE_BATCH) {
+        paramWriteBatchProcess();
+      } else if (p.data[0] == MISC_READ_BATCH) {
+        paramReadBatchProcess();
+      } else if (p.data[0] == MISC_READ_GROUP) {
+        paramReadGroupProcess();
+      } else if (p.data[0] == MISC_READ_LIST) {
+        paramReadListProcess();
+      } else if (p.data[0] == MISC_PERSIST_ALL) {
+        paramPersistentStoreChanged(true);
+        p.data[1] = 0;
+        p.size = 2;
+        crtpSendPacketBlock(&p);
+      } else if (p.data[0] == MISC_PERSIST_CLEAR) {
+        paramPersistentClear();
+        p.data[1] = 0;
+        p.size = 2;
+        crtpSendPacketBlock(&p);
       }
     }
 	}
@@ -316,9 +405,83 @@ void paramTOCProcess(int command)
       crtpSendPacketBlock(&p);
     }
     break;
+  case CMD_GET_ITEMS_V2:  //Get param variables from an id
+    memcpy(&paramId, &p.data[1], 2);
+    paramTOCSendItems(paramId, p.data[3]);
+    break;
   }
 }
 
+/* Sends the TOC entries from firstId and on, packed in up to packetCount
+ * packets. Each packet holds the id of its first entry followed by as many
+ * [type, group (if changed), name] entries as fit. A packet without entries
+ * is sent if firstId is out of range. */
+static void paramTOCSendItems(uint16_t firstId, uint8_t packetCount)
+{
+  int ptr;
+  const char* group = "";
+  uint16_t n = 0;
+
+  if (packetCount == 0)
+    packetCount = 1;
+  if (packetCount > TOC_ITEMS_MAX_PACKETS)
+    packetCount = TOC_ITEMS_MAX_PACKETS;
+
+  for (ptr=0; ptr<paramsLen; ptr++)
+  {
+    if (params[ptr].type & PARAM_GROUP)
+      group = (params[ptr].type & PARAM_START) ? params[ptr].name : "";
+    else if (n == firstId)
+      break;
+    else
+      n++;
+  }
+
+  do
+  {
+    const char* packetGroup = NULL;
+
+    p.header=CRTP_HEADER(CRTP_PORT_PARAM, TOC_CH);
+    p.data[0]=CMD_GET_ITEMS_V2;
+    memcpy(&p.data[1], &n, 2);
+    p.size=3;
+
+    for (; ptr<paramsLen; ptr++)
+    {
+      if (params[ptr].type & PARAM_GROUP)
+      {
+        group = (params[ptr].type & PARAM_START) ? params[ptr].name : "";
+        continue;
+      }
+
+      const bool newGroup = (group != packetGroup);
+      const int groupLength = newGroup ? strlen(group) + 1 : 0;
+      const int nameLength = strlen(params[ptr].name) + 1;
+      if (p.size + 1 + groupLength + nameLength > CRTP_MAX_DATA_SIZE)
+        break;
+
+      p.data[p.size++] = params[ptr].type | (newGroup ? TOC_ITEMS_NEW_GROUP : 0);
+      memcpy(&p.data[p.size], group, groupLength);
+      p.size += groupLength;
+      memcpy(&p.data[p.size], params[ptr].name, nameLength);
+      p.size += nameLength;
+      packetGroup = group;
+      n++;
+    }
+
+    crtpSendPacketBlock(&p);
+    packetCount--;
+  } while (packetCount > 0 && ptr < paramsLen);
+
+  useV2 = true;
+}
+
+static void paramNotifyChanged(int ptr)
+{
+  if (params[ptr].callback)
+    params[ptr].callback();
+}
+
 static void paramWriteProcess()
 {
   if (useV2) {
@@ -357,6 +520,7 @@ static void paramWriteProcess()
         break;
     }
 
+    paramNotifyChanged(id);
     crtpSendPacketBlock(&p);
   } else {
     int ident = p.data[0];
@@ -394,6 +558,7 @@ static void paramWriteProcess()
         break;
     }
 
+    paramNotifyChanged(id);
     crtpSendPacketBlock(&p);
   }
 }
@@ -446,9 +611,341 @@ static char paramWriteByNameProcess(char* group, char* name, int type, void *val
       break;
   }
 
+  paramNotifyChanged(ptr);
+
+  return 0;
+}
+
+static void paramBatchClear()
+{
+  batch.count = 0;
+  batch.length = 0;
+}
+
+/* Adds a parameter to the batch, with its new value if the batch is written */
+static uint8_t paramBatchAdd(int ptr, const void* value)
+{
+  const int length = 1 << (params[ptr].type & PARAM_BYTES_MASK);
+
+  if (batch.count >= PARAM_BATCH_MAX_PARAMS || batch.length + length > PARAM_BATCH_MAX_BYTES)
+    return E2BIG;
+
+  if (value)
+    memcpy(&batch.values[batch.length], value, length);
+  batch.ptr[batch.count++] = ptr;
+  batch.length += length;
+
   return 0;
 }
 
+/* Copies the values of the batch with the scheduler suspended, so that they
+ * are one consistent set: no task, as the stabilizer loop or an app calling
+ * paramSetFloat(), runs in between. */
+static void paramBatchRead()
+{
+  int offset = 0;
+
+  vTaskSuspendAll();
+  for (int i = 0; i < batch.count; i++)
+  {
+    const int length = 1 << (params[batch.ptr[i]].type & PARAM_BYTES_MASK);
+    memcpy(&batch.values[offset], params[batch.ptr[i]].address, length);
+    offset += length;
+  }
+  xTaskResumeAll();
+}
+
+static void paramBatchWrite()
+{
+  int offset = 0;
+
+  vTaskSuspendAll();
+  for (int i = 0; i < batch.count; i++)
+  {
+    const int length = 1 << (params[batch.ptr[i]].type & PARAM_BYTES_MASK);
+    memcpy(params[batch.ptr[i]].address, &batch.values[offset], length);
+    offset += length;
+  }
+  xTaskResumeAll();
+
+  for (int i = 0; i < batch.count; i++)
+    paramNotifyChanged(batch.ptr[i]);
+}
+
+/* Writes several parameters from one packet, [id (2 bytes), value]... with
+ * the size of the values given by the TOC. All entries are checked before
+ * any is written, and they are written with the scheduler suspended so that
+ * the stabilizer loop sees either none or all of the new values. The answer
+ * holds an error code and the index of the entry that failed. */
+static void paramWriteBatchProcess()
+{
+  int offset = 1;
+  uint8_t error = 0;
+
+  paramBatchClear();
+
+  while (offset < p.size && !error)
+  {
+    uint16_t ident;
+    int id;
+
+    if (offset + 2 > p.size) {
+      error = EINVAL;
+      break;
+    }
+    memcpy(&ident, &p.data[offset], 2);
+    id = variableGetIndex(ident);
+
+    if (id < 0) {
+      error = ENOENT;
+    } else if (params[id].type & PARAM_RONLY) {
+      error = EACCES;
+    } else if (offset + 2 + (1 << (params[id].type & PARAM_BYTES_MASK)) > p.size) {
+      error = EINVAL;
+    } else {
+      error = paramBatchAdd(id, &p.data[offset + 2]);
+      offset += 2 + (1 << (params[id].type & PARAM_BYTES_MASK));
+    }
+  }
+
+  if (!error)
+    paramBatchWrite();
+
+  p.data[1] = error;
+  p.data[2] = batch.count;
+  p.size = 3;
+  crtpSendPacketBlock(&p);
+}
+
+/* Reads several parameters, the request holds the ids (2 bytes each). The
+ * answer holds an error code followed by the values, in the order of the
+ * request, read with the scheduler suspended as one consistent set. */
+static void paramReadBatchProcess()
+{
+  const int count = (p.size - 1) / 2;
+  uint8_t error = 0;
+
+  paramBatchClear();
+
+  for (int i = 0; i < count && !error; i++)
+  {
+    uint16_t ident;
+    memcpy(&ident, &p.data[1 + i * 2], 2);
+    const int id = variableGetIndex(ident);
+    if (id < 0) {
+      error = ENOENT;
+    } else {
+      error = paramBatchAdd(id, NULL);
+      if (2 + batch.length > CRTP_MAX_DATA_SIZE)
+        error = E2BIG;
+    }
+  }
+
+  p.data[1] = error;
+  p.size = 2;
+
+  if (!error)
+  {
+    paramBatchRead();
+    memcpy(&p.data[2], batch.values, batch.length);
+    p.size += batch.length;
+  }
+
+  crtpSendPacketBlock(&p);
+}
+
+/* Sends the values of the batch as a byte stream over as many answers as
+ * needed, [command, error, sequence, values...]. Values may be split between
+ * two answers, the last one has READ_SNAPSHOT_LAST set in the sequence. */
+static void paramReadSnapshotSend(uint8_t error)
+{
+  int offset = 0;
+  uint8_t sequence = 0;
+
+  if (!error)
+    paramBatchRead();
+  else
+    batch.length = 0;
+
+  p.data[1] = error;
+
+  do {
+    int length = batch.length - offset;
+    if (length > CRTP_MAX_DATA_SIZE - READ_SNAPSHOT_HEADER)
+      length = CRTP_MAX_DATA_SIZE - READ_SNAPSHOT_HEADER;
+
+    p.data[2] = sequence++;
+    if (offset + length >= batch.length)
+      p.data[2] |= READ_SNAPSHOT_LAST;
+    memcpy(&p.data[READ_SNAPSHOT_HEADER], &batch.values[offset], length);
+    p.size = READ_SNAPSHOT_HEADER + length;
+    crtpSendPacketBlock(&p);
+
+    offset += length;
+  } while (offset < batch.length);
+}
+
+/* Reads all parameters of a group, named in the request, as one consistent
+ * set. The values are sent in TOC order. */
+static void paramReadGroupProcess()
+{
+  const char* group = (const char*)&p.data[1];
+  bool inGroup = false;
+  uint8_t error = 0;
+
+  paramBatchClear();
+
+  if (p.size < 2 || memchr(group, '\0', p.size - 1) == NULL) {
+    paramReadSnapshotSend(EINVAL);
+    return;
+  }
+
+  // A group may be declared in several files, the whole TOC is searched
+  for (int ptr = 0; ptr < paramsLen && !error; ptr++)
+  {
+    if (params[ptr].type & PARAM_GROUP) {
+      inGroup = (params[ptr].type & PARAM_START) && !strcmp(group, params[ptr].name);
+    } else if (inGroup) {
+      error = paramBatchAdd(ptr, NULL);
+    }
+  }
+
+  if (!error && batch.count == 0)
+    error = ENOENT;
+
+  paramReadSnapshotSend(error);
+}
+
+/* Reads the parameters with the ids (2 bytes each) of the request as one
+ * consistent set, as MISC_READ_BATCH but the values may span several
+ * answers. */
+static void paramReadListProcess()
+{
+  const int count = (p.size - 1) / 2;
+  uint8_t error = 0;
+
+  paramBatchClear();
+
+  for (int i = 0; i < count && !error; i++)
+  {
+    uint16_t ident;
+    memcpy(&ident, &p.data[1 + i * 2], 2);
+    const int id = variableGetIndex(ident);
+    error = id < 0 ? ENOENT : paramBatchAdd(id, NULL);
+  }
+
+  paramReadSnapshotSend(error);
+}
+
+static int paramValueLength(int ptr)
+{
+  return 1 << (params[ptr].type & PARAM_BYTES_MASK);
+}
+
+static void paramPersistentInit(void)
+{
+  persistentCount = 0;
+  for (int i = 0; i < paramsLen; i++)
+  {
+    if ((params[i].type & PARAM_GROUP) || !(params[i].flags & PARAM_PERSISTENT))
+      continue;
+
+    if (persistentCount >= PARAM_PERSISTENT_MAX) {
+      PARAM_ERROR("Too many persistent params\n");
+      break;
+    }
+
+    persistentPtr[persistentCount] = i;
+    memcpy(persistentStored[persistentCount], params[i].address, paramValueLength(i));
+    persistentCount++;
+  }
+}
+
+static void paramPersistentKey(int ptr, char* key)
+{
+  const char* group = paramGroupOf(ptr);
+  int length = strlen(PARAM_PERSISTENT_PREFIX);
+
+  memcpy(key, PARAM_PERSISTENT_PREFIX, length);
+  strncpy(&key[length], group, PARAM_PERSISTENT_KEY_LEN - length - 1);
+  length = strlen(key);
+  key[length++] = '.';
+  strncpy(&key[length], params[ptr].name, PARAM_PERSISTENT_KEY_LEN - length - 1);
+  key[PARAM_PERSISTENT_KEY_LEN - 1] = '\0';
+}
+
+static bool paramPersistentRestoreOne(const char* key, void* buffer, size_t length)
+{
+  char group[PARAM_PERSISTENT_KEY_LEN];
+  char* name;
+
+  strncpy(group, &key[strlen(PARAM_PERSISTENT_PREFIX)], sizeof(group) - 1);
+  group[sizeof(group) - 1] = '\0';
+  name = strchr(group, '.');
+  if (!name)
+    return true;
+  *name++ = '\0';
+
+  for (int i = 0; i < persistentCount; i++)
+  {
+    const int ptr = persistentPtr[i];
+    if (paramTocHashMatch(ptr, group, name) && length == paramValueLength(ptr))
+    {
+      memcpy(params[ptr].address, buffer, length);
+      memcpy(persistentStored[i], buffer, length);
+      break;
+    }
+  }
+
+  return true;
+}
+
+/* All stored values are read in one pass over the storage */
+static void paramPersistentRestore(void)
+{
+  uint8_t buffer[8];
+
+  if (persistentCount == 0)
+    return;
+
+  storageForeach(PARAM_PERSISTENT_PREFIX, buffer, sizeof(buffer), paramPersistentRestoreOne);
+}
+
+static void paramPersistentStoreChanged(bool all)
+{
+  char key[PARAM_PERSISTENT_KEY_LEN];
+
+  for (int i = 0; i < persistentCount; i++)
+  {
+    const int ptr = persistentPtr[i];
+    const int length = paramValueLength(ptr);
+
+    if (!all && memcmp(persistentStored[i], params[ptr].address, length) == 0)
+      continue;
+
+    memcpy(persistentStored[i], params[ptr].address, length);
+    paramPersistentKey(ptr, key);
+    if (!storageStore(key, persistentStored[i], length)) {
+      PARAM_ERROR("Failed to store %s\n", key);
+    }
+  }
+}
+
+/* The current values are kept, the defaults are used after the next restart */
+static void paramPersistentClear(void)
+{
+  char key[PARAM_PERSISTENT_KEY_LEN];
+
+  for (int i = 0; i < persistentCount; i++)
+  {
+    const int ptr = persistentPtr[i];
+
+    memcpy(persistentStored[i], params[ptr].address, paramValueLength(ptr));
+    paramPersistentKey(ptr, key);
+    storageDelete(key);
+  }
+}
+
 static void paramReadProcess()
 {
   if (useV2) {
@@ -548,8 +1045,67 @@ static int variableGetIndex(int id)
 /* Public API to access param TOC from within the copter */
 static paramVarId_t invalidVarId = {0xffffu, 0xffffu};
 
+static void paramTocHashBuild(void)
+{
+  const char* group = "";
+
+  tocHashInit(&paramTocHash, paramTocHashSlots, PARAM_TOC_HASH_SIZE);
+
+  for (int ptr = 0; ptr < paramsLen; ptr++)
+  {
+    if (params[ptr].type & PARAM_GROUP) {
+      if (params[ptr].type & PARAM_START) {
+        group = params[ptr].name;
+      }
+    } else if (!tocHashInsert(&paramTocHash, tocHashName(group, params[ptr].name), ptr)) {
+      DEBUG_PRINT("Param TOC too big for the hash index, using linear lookups\n");
+      return;
+    }
+  }
+
+  paramTocHashed = true;
+}
+
+static const char* paramGroupOf(int ptr)
+{
+  for (; ptr >= 0; ptr--)
+  {
+    if ((params[ptr].type & PARAM_GROUP) && (params[ptr].type & PARAM_START))
+      return params[ptr].name;
+  }
+
+  return "";
+}
+
+static bool paramTocHashMatch(uint16_t ptr, const char* group, const char* name)
+{
+  return (!strcmp(name, params[ptr].name)) && (!strcmp(group, paramGroupOf(ptr)));
+}
+
+void paramGetTocInfo(uint16_t* count, uint32_t* crc)
+{
+  *count = paramsCount;
+  *crc = paramsCrc;
+}
+
 paramVarId_t paramGetVarId(char* group, char* name)
 {
+  if (paramTocHashed)
+  {
+    const int ptr = tocHashFind(&paramTocHash, group, name, paramTocHashMatch);
+    if (ptr < 0)
+      return invalidVarId;
+
+    // The TOC id is the number of variables before, no string compares needed
+    paramVarId_t varId = {.ptr = ptr, .id = 0};
+    for (int i = 0; i < ptr; i++)
+    {
+      if (!(params[i].type & PARAM_GROUP))
+        varId.id++;
+    }
+    return varId;
+  }
+
   int ptr;
   int id = 0;
   paramVarId_t varId = invalidVarId;
@@ -728,6 +1284,8 @@ void paramSetInt(paramVarId_t varid, int valuei)
       break;
   }
 
+  paramNotifyChanged(varid.ptr);
+
 #ifndef SILENT_PARAM_UPDATES
   crtpSendPacketBlock(&pk);
 #endif
@@ -751,6 +1309,8 @@ void paramSetFloat(paramVarId_t varid, float valuef)
       pk.size += 4;
   }
 
+  paramNotifyChanged(varid.ptr);
+
 #ifndef SILENT_PARAM_UPDATES
   crtpSendPacketBlock(&pk);
 #endif
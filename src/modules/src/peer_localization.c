@@ -16,48 +16,114 @@ bool peerLocalizationTest()
   return true;
 }
 
-// array of other's position
+// array of other's position, the peers are kept in the first peer_count entries
 static peerLocalizationOtherPosition_t other_positions[PEER_LOCALIZATION_MAX_NEIGHBORS];
+static uint8_t peer_count;
+
+// index + 1 in other_positions for each radio ID, 0 if the ID is not tracked
+static uint8_t index_by_id[256];
+
+// the entry that is checked for staleness on the next update
+static uint8_t stale_check;
+
+// incremented on every position update
+static uint32_t update_count;
+
+// Removes an entry, the last entry is moved into its place
+static void removePeer(uint8_t idx)
+{
+  index_by_id[other_positions[idx].id] = 0;
+  peer_count--;
+  if (idx != peer_count) {
+    other_positions[idx] = other_positions[peer_count];
+    index_by_id[other_positions[idx].id] = idx + 1;
+  }
+  other_positions[peer_count].id = 0;
+}
+
+// Checks one entry per call for staleness, so that the cost of an update stays
+// constant. All entries are checked once every peer_count updates.
+static void evictStale(TickType_t now)
+{
+  if (peer_count == 0) {
+    return;
+  }
+
+  if (stale_check >= peer_count) {
+    stale_check = 0;
+  }
+
+  if (now - other_positions[stale_check].pos.timestamp > M2T(PEER_LOCALIZATION_STALE_MS)) {
+    removePeer(stale_check);
+  } else {
+    stale_check++;
+  }
+}
 
 bool peerLocalizationTellPosition(int cfid, positionMeasurement_t const *pos)
 {
-  for (uint8_t i = 0; i < PEER_LOCALIZATION_MAX_NEIGHBORS; ++i) {
-    if (other_positions[i].id == 0 || other_positions[i].id == cfid) {
-      other_positions[i].id = cfid;
-      other_positions[i].pos.x = pos->x;
-      other_positions[i].pos.y = pos->y;
-      other_positions[i].pos.z = pos->z;
-      other_positions[i].pos.timestamp = xTaskGetTickCount();
-      return true;
+  if (cfid <= 0 || cfid > UINT8_MAX) {
+    return false;
+  }
+
+  TickType_t const now = xTaskGetTickCount();
+  evictStale(now);
+
+  int idx = index_by_id[cfid] - 1;
+  if (idx < 0) {
+    if (peer_count < PEER_LOCALIZATION_MAX_NEIGHBORS) {
+      idx = peer_count++;
+    } else {
+      // The table is full of fresh peers, replace the one that has not been
+      // heard of for the longest time
+      TickType_t oldest = 0;
+      for (uint8_t i = 0; i < peer_count; ++i) {
+        if (now - other_positions[i].pos.timestamp >= oldest) {
+          oldest = now - other_positions[i].pos.timestamp;
+          idx = i;
+        }
+      }
+      index_by_id[other_positions[idx].id] = 0;
     }
+
+    other_positions[idx].id = cfid;
+    index_by_id[cfid] = idx + 1;
   }
-  return false;
+
+  other_positions[idx].pos.x = pos->x;
+  other_positions[idx].pos.y = pos->y;
+  other_positions[idx].pos.z = pos->z;
+  other_positions[idx].pos.timestamp = now;
+  update_count++;
+  return true;
+}
+
+uint32_t peerLocalizationGetUpdateCount(void)
+{
+  return update_count;
+}
+
+uint8_t peerLocalizationGetPeerCount(void)
+{
+  return peer_count;
 }
 
 bool peerLocalizationIsIDActive(uint8_t cfid)
 {
-  for (uint8_t i = 0; i < PEER_LOCALIZATION_MAX_NEIGHBORS; ++i) {
-    if (other_positions[i].id == cfid) {
-      return true;
-    }
-  }
-  return false;
+  return cfid != 0 && index_by_id[cfid] != 0;
 }
 
 peerLocalizationOtherPosition_t *peerLocalizationGetPositionByID(uint8_t cfid)
 {
-  for (uint8_t i = 0; i < PEER_LOCALIZATION_MAX_NEIGHBORS; ++i) {
-    if (other_positions[i].id == cfid) {
-      return &other_positions[i];
-    }
+  if (!peerLocalizationIsIDActive(cfid)) {
+    return NULL;
   }
-  return NULL;
+  return &other_positions[index_by_id[cfid] - 1];
 }
 
 peerLocalizationOtherPosition_t *peerLocalizationGetPositionByIdx(uint8_t idx)
 {
-  // TODO: should we return NULL if the id == 0?
-  if (idx < PEER_LOCALIZATION_MAX_NEIGHBORS) {
+  if (idx < peer_count) {
     return &other_positions[idx];
   }
   return NULL;
@@ -50,6 +50,18 @@ static void plan_takeoff_or_landing(struct planner *p, struct vec curr_pos, floa
 		hover_pos, hover_yaw, vzero(), 0, vzero());
 }
 
+static bool is_repeated_go_to(struct planner *p, bool relative, struct vec hover_pos, float hover_yaw, float duration)
+{
+	return !relative
+		&& p->go_to_valid
+		&& p->state == TRAJECTORY_STATE_FLYING
+		&& p->type == TRAJECTORY_TYPE_PIECEWISE
+		&& p->trajectory == &p->planned_trajectory
+		&& veq(hover_pos, p->go_to_pos)
+		&& hover_yaw == p->go_to_yaw
+		&& duration == p->go_to_duration;
+}
+
 // ----------------- //
 // public functions. //
 // ----------------- //
@@ -62,11 +74,13 @@ void plan_init(struct planner *p)
 	p->trajectory = NULL;
 	p->compressed_trajectory = NULL;
 	p->planned_trajectory.pieces = p->pieces;
+	p->go_to_valid = false;
 }
 
 void plan_stop(struct planner *p)
 {
 	p->state = TRAJECTORY_STATE_IDLE;
+	p->go_to_valid = false;
 }
 
 bool plan_is_finished(struct planner *p, float t)
@@ -138,6 +152,7 @@ int plan_takeoff(struct planner *p, struct vec curr_pos, float curr_yaw, float h
 	}
 
 	plan_takeoff_or_landing(p, curr_pos, curr_yaw, hover_height, hover_yaw, duration);
+	p->go_to_valid = false;
 	p->reversed = false;
 	p->state = TRAJECTORY_STATE_FLYING;
 	p->type = TRAJECTORY_TYPE_PIECEWISE;
@@ -153,6 +168,7 @@ int plan_land(struct planner *p, struct vec curr_pos, float curr_yaw, float hove
 	}
 
 	plan_takeoff_or_landing(p, curr_pos, curr_yaw, hover_height, hover_yaw, duration);
+	p->go_to_valid = false;
 	p->reversed = false;
 	p->state = TRAJECTORY_STATE_LANDING;
 	p->type = TRAJECTORY_TYPE_PIECEWISE;
@@ -163,6 +179,15 @@ int plan_land(struct planner *p, struct vec curr_pos, float curr_yaw, float hove
 
 int plan_go_to_from(struct planner *p, const struct traj_eval *curr_eval, bool relative, struct vec hover_pos, float hover_yaw, float duration, float t)
 {
+	if (is_repeated_go_to(p, relative, hover_pos, hover_yaw, duration)) {
+		return 0;
+	}
+
+	p->go_to_valid = !relative;
+	p->go_to_pos = hover_pos;
+	p->go_to_yaw = hover_yaw;
+	p->go_to_duration = duration;
+
 	if (relative) {
 		hover_pos = vadd(hover_pos, curr_eval->pos);
 		hover_yaw += curr_eval->yaw;
@@ -182,13 +207,18 @@ int plan_go_to_from(struct planner *p, const struct traj_eval *curr_eval, bool r
 
 int plan_go_to(struct planner *p, bool relative, struct vec hover_pos, float hover_yaw, float duration, float t)
 {
+	if (is_repeated_go_to(p, relative, hover_pos, hover_yaw, duration)) {
+		return 0;
+	}
+
 	struct traj_eval setpoint = plan_current_goal(p, t);
 	return plan_go_to_from(p, &setpoint, relative, hover_pos, hover_yaw, duration, t);
 }
 
-int plan_start_trajectory( struct planner *p, const struct piecewise_traj* trajectory, bool reversed)
+int plan_start_trajectory( struct planner *p, struct piecewise_traj* trajectory, bool reversed)
 {
 	p->reversed = reversed;
+	p->go_to_valid = false;
 	p->state = TRAJECTORY_STATE_FLYING;
 	p->type = TRAJECTORY_TYPE_PIECEWISE;
 	p->trajectory = trajectory;
@@ -199,6 +229,7 @@ int plan_start_trajectory( struct planner *p, const struct piecewise_traj* traje
 int plan_start_compressed_trajectory( struct planner *p, struct piecewise_traj_compressed* trajectory)
 {
 	p->reversed = 0;
+	p->go_to_valid = false;
 	p->state = TRAJECTORY_STATE_FLYING;
 	p->type = TRAJECTORY_TYPE_PIECEWISE_COMPRESSED;
 	p->compressed_trajectory = trajectory;
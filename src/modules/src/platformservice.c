@@ -40,6 +40,9 @@
 #include "platform.h"
 #include "app_channel.h"
 #include "static_mem.h"
+#include "log.h"
+#include "param.h"
+#include "mem.h"
 
 static bool isInit=false;
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(platformSrvTask, PLATFORM_SRV_TASK_STACKSIZE);
@@ -48,6 +51,7 @@ typedef enum {
   platformCommand   = 0x00,
   versionCommand    = 0x01,
   appChannel        = 0x02,
+  appChannelMessage = 0x03,
 } Channel;
 
 typedef enum {
@@ -58,11 +62,33 @@ typedef enum {
   getProtocolVersion = 0x00,
   getFirmwareVersion = 0x01,
   getDeviceTypeName  = 0x02,
+  getCapabilities    = 0x03,
 } VersionCommand;
 
+#define CAPABILITIES_VERSION 1
+
+// Protocol features of this firmware, in the capabilities response
+typedef enum {
+  capabilityLogAggregation = 1 << 0,  // CONTROL_SET_AGGREGATION
+  capabilityLogCompression = 1 << 1,  // CONTROL_SET_COMPRESSION
+  capabilityLogHighRate    = 1 << 2,  // CONTROL_START_BLOCK_HIGH_RATE
+  capabilityLogOnChange    = 1 << 3,  // CONTROL_SET_ON_CHANGE and CONTROL_SET_DEADBAND
+  capabilityLogProfiles    = 1 << 4,  // Persistent log profiles
+  capabilityLogRateControl = 1 << 5,  // CONTROL_SET_RATE_LIMITS and CONTROL_GET_RATE
+  capabilityParamBatch     = 1 << 6,  // MISC_WRITE_BATCH and MISC_READ_BATCH
+  capabilityParamSnapshot  = 1 << 7,  // MISC_READ_GROUP and MISC_READ_LIST
+  capabilityParamPersist   = 1 << 8,  // Persistent parameters
+  capabilityMemStream      = 1 << 9,  // Bulk reads on the memory stream channel
+} Capability;
+
+#define CAPABILITIES (capabilityLogAggregation | capabilityLogCompression | capabilityLogHighRate | \
+                      capabilityLogOnChange | capabilityLogProfiles | capabilityLogRateControl | \
+                      capabilityParamBatch | capabilityParamSnapshot | capabilityParamPersist | capabilityMemStream)
+
 static void platformSrvTask(void*);
 static void platformCommandProcess(uint8_t command, uint8_t *data);
 static void versionCommandProcess(CRTPPacket *p);
+static void capabilitiesProcess(CRTPPacket *p);
 
 void platformserviceInit(void)
 {
@@ -103,6 +129,9 @@ static void platformSrvTask(void* prm)
       case appChannel:
         appchannelIncomingPacket(&p);
         break;
+      case appChannelMessage:
+        appchannelIncomingFragment(&p);
+        break;
       default:
         break;
     }
@@ -132,6 +161,13 @@ void platformserviceSendAppchannelPacket(CRTPPacket *p)
   crtpSendPacketBlock(p);
 }
 
+void platformserviceSendAppchannelFragment(CRTPPacket *p)
+{
+  p->port = CRTP_PORT_PLATFORM;
+  p->channel = appChannelMessage;
+  crtpSendPacketBlock(p);
+}
+
 static void versionCommandProcess(CRTPPacket *p)
 {
   switch (p->data[0]) {
@@ -153,7 +189,40 @@ static void versionCommandProcess(CRTPPacket *p)
       crtpSendPacketBlock(p);
       }
       break;
+    case getCapabilities:
+      capabilitiesProcess(p);
+      crtpSendPacketBlock(p);
+      break;
     default:
       break;
   }
 }
+
+// Everything a client checks at connect in one response, so that it can skip
+// the TOC and memory info downloads it has cached
+static void capabilitiesProcess(CRTPPacket *p)
+{
+  const uint32_t capabilities = CAPABILITIES;
+  uint16_t logCount;
+  uint32_t logCrc;
+  uint16_t paramCount;
+  uint32_t paramCrc;
+  uint8_t memCount;
+  uint32_t memCrc;
+
+  logGetTocInfo(&logCount, &logCrc);
+  paramGetTocInfo(&paramCount, &paramCrc);
+  memGetMapInfo(&memCount, &memCrc);
+
+  p->data[1] = CAPABILITIES_VERSION;
+  p->data[2] = PROTOCOL_VERSION;
+  memcpy(&p->data[3], &capabilities, 4);
+  memcpy(&p->data[7], &logCount, 2);
+  memcpy(&p->data[9], &logCrc, 4);
+  memcpy(&p->data[13], &paramCount, 2);
+  memcpy(&p->data[15], &paramCrc, 4);
+  p->data[19] = logGetStoredProfiles();
+  p->data[20] = memCount;
+  memcpy(&p->data[21], &memCrc, 4);
+  p->size = 25;
+}
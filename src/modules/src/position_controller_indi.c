@@ -27,6 +27,7 @@
 
 #include "position_controller_indi.h"
 #include "math3d.h"
+#include "fastmath.h"
 
 // Position controller gains
 float K_xi_x = 1.0f;
@@ -94,15 +95,20 @@ static inline void filter_thrust(Butterworth2LowPass *filter, float *old_thrust,
 // Computes transformation matrix from body frame (index B) into NED frame (index O)
 void m_ob(struct Angles att, float matrix[3][3]) {
 
-	matrix[0][0] = cosf(att.theta)*cosf(att.psi);
-	matrix[0][1] = sinf(att.phi)*sinf(att.theta)*cosf(att.psi) - cosf(att.phi)*sinf(att.psi); 
-	matrix[0][2] = cosf(att.phi)*sinf(att.theta)*cosf(att.psi) + sinf(att.phi)*sinf(att.psi);
-	matrix[1][0] = cosf(att.theta)*sinf(att.psi);
-	matrix[1][1] = sinf(att.phi)*sinf(att.theta)*sinf(att.psi) + cosf(att.phi)*cosf(att.psi);
-	matrix[1][2] = cosf(att.phi)*sinf(att.theta)*sinf(att.psi) - sinf(att.phi)*cosf(att.psi);
-	matrix[2][0] = -sinf(att.theta);
-	matrix[2][1] = sinf(att.phi)*cosf(att.theta);
-	matrix[2][2] = cosf(att.phi)*cosf(att.theta);
+	float sphi, cphi, stheta, ctheta, spsi, cpsi;
+	fastSinCos(att.phi, &sphi, &cphi);
+	fastSinCos(att.theta, &stheta, &ctheta);
+	fastSinCos(att.psi, &spsi, &cpsi);
+
+	matrix[0][0] = ctheta*cpsi;
+	matrix[0][1] = sphi*stheta*cpsi - cphi*spsi;
+	matrix[0][2] = cphi*stheta*cpsi + sphi*spsi;
+	matrix[1][0] = ctheta*spsi;
+	matrix[1][1] = sphi*stheta*spsi + cphi*cpsi;
+	matrix[1][2] = cphi*stheta*spsi - sphi*cpsi;
+	matrix[2][0] = -stheta;
+	matrix[2][1] = sphi*ctheta;
+	matrix[2][2] = cphi*ctheta;
 }
 
 
@@ -193,15 +199,20 @@ void positionControllerINDI(const sensorData_t *sensors,
 	// Elements of the G matrix (see publication for more information) 
 	// ("-" because T points in neg. z-direction, "*9.81" because T/m=a=g, 
 	// negative psi to account for wrong coordinate frame in the implementation of the inner loop)
-	float g11 = (cosf(att.phi)*sinf(-att.psi) - sinf(att.phi)*sinf(att.theta)*cosf(-att.psi))*(-9.81f);
-	float g12 = (cosf(att.phi)*cosf(-att.theta)*cosf(-att.psi))*(-9.81f);
-	float g13 = (sinf(att.phi)*sinf(-att.psi) + cosf(att.phi)*sinf(att.theta)*cosf(-att.psi));
-	float g21 = (-cosf(att.phi)*cosf(-att.psi) - sinf(att.phi)*sinf(att.theta)*sinf(-att.psi))*(-9.81f);
-	float g22 = (cosf(att.phi)*cosf(att.theta)*sinf(-att.psi))*(-9.81f);
-	float g23 = (-sinf(att.phi)*cosf(-att.psi) + cosf(att.phi)*sinf(att.theta)*sinf(-att.psi));
-	float g31 = (-sinf(att.phi)*cosf(att.theta))*(-9.81f);
-	float g32 = (-cosf(att.phi)*sinf(att.theta))*(-9.81f);
-	float g33 = (cosf(att.phi)*cosf(att.theta));
+	float sphi, cphi, stheta, ctheta, spsi, cpsi;
+	fastSinCos(att.phi, &sphi, &cphi);
+	fastSinCos(att.theta, &stheta, &ctheta);
+	fastSinCos(-att.psi, &spsi, &cpsi);
+
+	float g11 = (cphi*spsi - sphi*stheta*cpsi)*(-9.81f);
+	float g12 = (cphi*ctheta*cpsi)*(-9.81f);
+	float g13 = (sphi*spsi + cphi*stheta*cpsi);
+	float g21 = (-cphi*cpsi - sphi*stheta*spsi)*(-9.81f);
+	float g22 = (cphi*ctheta*spsi)*(-9.81f);
+	float g23 = (-sphi*cpsi + cphi*stheta*spsi);
+	float g31 = (-sphi*ctheta)*(-9.81f);
+	float g32 = (-cphi*stheta)*(-9.81f);
+	float g33 = (cphi*ctheta);
 
 	// Next four blocks of the code are to compute the Moore-Penrose inverse of the G matrix
 	// (G'*G)
@@ -32,6 +32,7 @@
 #include "param.h"
 #include "pid.h"
 #include "num.h"
+#include "fastmath.h"
 #include "position_controller.h"
 
 struct pidInit_s {
@@ -170,8 +171,8 @@ void positionController(float* thrust, attitude_t *attitude, setpoint_t *setpoin
   // this value is below 0.5
   this.pidZ.pid.outputLimit = fmaxf(zVelMax, 0.5f)  * velMaxOverhead;
 
-  float cosyaw = cosf(state->attitude.yaw * (float)M_PI / 180.0f);
-  float sinyaw = sinf(state->attitude.yaw * (float)M_PI / 180.0f);
+  float sinyaw, cosyaw;
+  fastSinCos(state->attitude.yaw * (float)M_PI / 180.0f, &sinyaw, &cosyaw);
   float bodyvx = setpoint->velocity.x;
   float bodyvy = setpoint->velocity.y;
 
@@ -207,8 +208,10 @@ void velocityController(float* thrust, attitude_t *attitude, setpoint_t *setpoin
   float pitchRaw = runPid(state->velocity.y, &this.pidVY, setpoint->velocity.y, DT);
 
   float yawRad = state->attitude.yaw * (float)M_PI / 180;
-  attitude->pitch = -(rollRaw  * cosf(yawRad)) - (pitchRaw * sinf(yawRad));
-  attitude->roll  = -(pitchRaw * cosf(yawRad)) + (rollRaw  * sinf(yawRad));
+  float sinyaw, cosyaw;
+  fastSinCos(yawRad, &sinyaw, &cosyaw);
+  attitude->pitch = -(rollRaw  * cosyaw) - (pitchRaw * sinyaw);
+  attitude->roll  = -(pitchRaw * cosyaw) + (rollRaw  * sinyaw);
 
   attitude->roll  = constrain(attitude->roll,  -rpLimit, rpLimit);
   attitude->pitch = constrain(attitude->pitch, -rpLimit, rpLimit);
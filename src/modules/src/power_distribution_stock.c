@@ -28,11 +28,14 @@
 #include "power_distribution.h"
 
 #include <string.h>
+#include <math.h>
 #include "log.h"
 #include "param.h"
 #include "num.h"
 #include "platform.h"
 #include "motors.h"
+#include "pm.h"
+#include "saturation_stats.h"
 #include "debug.h"
 
 static bool motorSetEnable = false;
@@ -57,6 +60,28 @@ static struct {
 
 static uint32_t idleThrust = DEFAULT_IDLE_THRUST;
 
+// Mixer modes
+#define MIXER_LINEAR      0 // Each motor clipped on its own, legacy behaviour
+#define MIXER_COMPENSATED 1 // Battery compensated, desaturated keeping roll/pitch first
+
+static uint8_t mixer = MIXER_LINEAR;
+
+// Voltage over a CF2 brushed motor needed for a given thrust, sampled at
+// 17 equally spaced thrust values from 0 to 65536 (0 - 60 g per motor).
+// Same measurement as the polynomial used in motorsSetRatio().
+#define THRUST_LUT_SHIFT 12
+#define THRUST_LUT_SIZE ((UINT16_MAX >> THRUST_LUT_SHIFT) + 2)
+
+static const float thrustToVoltsLut[THRUST_LUT_SIZE] = {
+  0.0000f, 0.3212f, 0.6249f, 0.9110f, 1.1796f, 1.4307f, 1.6642f, 1.8801f,
+  2.0785f, 2.2593f, 2.4226f, 2.5684f, 2.6966f, 2.8073f, 2.9004f, 2.9759f,
+  3.0340f,
+};
+
+// Below this the motors can not be compensated anyway, also protects the
+// division when no battery voltage has been received yet
+#define COMPENSATION_MIN_VOLTAGE 2.5f
+
 void powerDistributionInit(void)
 {
   motorsInit(platformConfigGetMotorMapping());
@@ -81,25 +106,145 @@ void powerStop()
   motorsSetRatio(MOTOR_M4, 0);
 }
 
+static float thrustToVolts(const float thrust)
+{
+  const uint32_t t = thrust;
+  const uint32_t i = t >> THRUST_LUT_SHIFT;
+  const float fraction = (t & ((1 << THRUST_LUT_SHIFT) - 1)) * (1.0f / (1 << THRUST_LUT_SHIFT));
+
+  return thrustToVoltsLut[i] + fraction * (thrustToVoltsLut[i + 1] - thrustToVoltsLut[i]);
+}
+
+static float maxThrustForVoltage(const float volts)
+{
+  for (int i = 1; i < THRUST_LUT_SIZE; i++) {
+    if (thrustToVoltsLut[i] > volts) {
+      const float fraction = (volts - thrustToVoltsLut[i - 1]) / (thrustToVoltsLut[i] - thrustToVoltsLut[i - 1]);
+      return (i - 1 + fraction) * (1 << THRUST_LUT_SHIFT);
+    }
+  }
+
+  return UINT16_MAX;
+}
+
+static void powerDistributionCompensated(const control_t *control)
+{
+  const MotorPerifDef** motorMap = platformConfigGetMotorMapping();
+  const bool compensate = (motorMap[0]->drvType == BRUSHED);
+
+  float invVbat = 0.0f;
+  float thrustMax = UINT16_MAX;
+  if (compensate) {
+    const float vbat = fmaxf(pmGetBatteryVoltageFiltered(), COMPENSATION_MIN_VOLTAGE);
+    invVbat = 1.0f / vbat;
+    thrustMax = maxThrustForVoltage(vbat);
+  }
+
+  // Roll/pitch and yaw contribution per motor
+  #ifdef QUAD_FORMATION_X
+    const float r = control->roll / 2.0f;
+    const float p = control->pitch / 2.0f;
+    const float rp[4] = {-r + p, -r - p, r - p, r + p};
+  #else // QUAD_FORMATION_NORMAL
+    const float rp[4] = {control->pitch, -control->roll, -control->pitch, control->roll};
+  #endif
+  const float y[4] = {control->yaw, -control->yaw, control->yaw, -control->yaw};
+
+  float rpMin = rp[0];
+  float rpMax = rp[0];
+  float mixMin = rp[0] + y[0];
+  float mixMax = rp[0] + y[0];
+  for (int i = 1; i < 4; i++) {
+    rpMin = fminf(rpMin, rp[i]);
+    rpMax = fmaxf(rpMax, rp[i]);
+    mixMin = fminf(mixMin, rp[i] + y[i]);
+    mixMax = fmaxf(mixMax, rp[i] + y[i]);
+  }
+
+  // If the motors can not deliver the full differential thrust, give up yaw
+  // first and then scale roll/pitch down, instead of clipping each motor and
+  // losing the attitude authority.
+  float rpScale = 1.0f;
+  float yawScale = 1.0f;
+  const float rpSpread = rpMax - rpMin;
+  const float mixSpread = mixMax - mixMin;
+  if (rpSpread > thrustMax) {
+    rpScale = thrustMax / rpSpread;
+    yawScale = 0.0f;
+  } else if (mixSpread > thrustMax) {
+    yawScale = (thrustMax - rpSpread) / (mixSpread - rpSpread);
+  }
+
+  float demand[4];
+  for (int i = 0; i < 4; i++) {
+    demand[i] = control->thrust + rp[i] + y[i];
+  }
+  saturationStatsMotors(demand, 4, thrustMax);
+
+  float mix[4];
+  float high = 0.0f;
+  float low = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    mix[i] = rpScale * rp[i] + yawScale * y[i];
+    high = (i == 0) ? mix[i] : fmaxf(high, mix[i]);
+    low = (i == 0) ? mix[i] : fminf(low, mix[i]);
+  }
+
+  // Shift the collective thrust to fit all motors in the available range
+  float thrust = control->thrust;
+  if (thrust + high > thrustMax) {
+    thrust = thrustMax - high;
+  }
+  if (thrust + low < 0.0f) {
+    thrust = -low;
+  }
+
+  uint32_t* power[4] = {&motorPower.m1, &motorPower.m2, &motorPower.m3, &motorPower.m4};
+  for (int i = 0; i < 4; i++) {
+    uint32_t motorThrust = limitThrust(thrust + mix[i]);
+    if (motorThrust < idleThrust) {
+      motorThrust = idleThrust;
+    }
+    *power[i] = motorThrust;
+
+    uint16_t ratio = motorThrust;
+    if (compensate) {
+      ratio = limitUint16(thrustToVolts(motorThrust) * invVbat * UINT16_MAX);
+    }
+    motorsSetRatioUncompensated(MOTOR_M1 + i, ratio);
+  }
+}
+
 void powerDistribution(const control_t *control)
 {
+  if (mixer == MIXER_COMPENSATED && !motorSetEnable) {
+    powerDistributionCompensated(control);
+    return;
+  }
+
   #ifdef QUAD_FORMATION_X
     int16_t r = control->roll / 2.0f;
     int16_t p = control->pitch / 2.0f;
-    motorPower.m1 = limitThrust(control->thrust - r + p + control->yaw);
-    motorPower.m2 = limitThrust(control->thrust - r - p - control->yaw);
-    motorPower.m3 =  limitThrust(control->thrust + r - p + control->yaw);
-    motorPower.m4 =  limitThrust(control->thrust + r + p - control->yaw);
+    const float power[4] = {
+      control->thrust - r + p + control->yaw,
+      control->thrust - r - p - control->yaw,
+      control->thrust + r - p + control->yaw,
+      control->thrust + r + p - control->yaw,
+    };
   #else // QUAD_FORMATION_NORMAL
-    motorPower.m1 = limitThrust(control->thrust + control->pitch +
-                               control->yaw);
-    motorPower.m2 = limitThrust(control->thrust - control->roll -
-                               control->yaw);
-    motorPower.m3 =  limitThrust(control->thrust - control->pitch +
-                               control->yaw);
-    motorPower.m4 =  limitThrust(control->thrust + control->roll -
-                               control->yaw);
+    const float power[4] = {
+      control->thrust + control->pitch + control->yaw,
+      control->thrust - control->roll - control->yaw,
+      control->thrust - control->pitch + control->yaw,
+      control->thrust + control->roll - control->yaw,
+    };
   #endif
+  saturationStatsMotors(power, 4, UINT16_MAX);
+
+  motorPower.m1 = limitThrust(power[0]);
+  motorPower.m2 = limitThrust(power[1]);
+  motorPower.m3 = limitThrust(power[2]);
+  motorPower.m4 = limitThrust(power[3]);
 
   if (motorSetEnable)
   {
@@ -140,6 +285,7 @@ PARAM_GROUP_STOP(motorPowerSet)
 
 PARAM_GROUP_START(powerDist)
 PARAM_ADD(PARAM_UINT32, idleThrust, &idleThrust)
+PARAM_ADD(PARAM_UINT8, mixer, &mixer)
 PARAM_GROUP_STOP(powerDist)
 
 LOG_GROUP_START(motor)
@@ -239,11 +239,6 @@ static struct vec polyval_xyz(struct poly4d const *p, float t)
 	return mkvec(polyval(p->p[0], t), polyval(p->p[1], t), polyval(p->p[2], t));
 }
 
-static float polyval_yaw(struct poly4d const *p, float t)
-{
-	return polyval(p->p[3], t);
-}
-
 // compute loose maximum of acceleration -
 // uses L1 norm instead of Euclidean, evaluates polynomial instead of root-finding
 float poly4d_max_accel_approx(struct poly4d const *p)
@@ -289,27 +284,53 @@ bool is_traj_eval_valid(struct traj_eval const *ev)
 	return !visnan(ev->pos);
 }
 
-struct traj_eval poly4d_eval(struct poly4d const *p, float t)
+// evaluate the x, y, z and yaw polynomials and their first three derivatives
+// in a single pass of horner's rule on the original coefficients, with the
+// dimensions interleaved. d[k][dim] is the k-th derivative divided by k!.
+static void poly4d_horner(struct poly4d const *p, float t, float d[4][4])
+{
+	for (int dim = 0; dim < 4; ++dim) {
+		d[0][dim] = p->p[dim][PP_DEGREE];
+		d[1][dim] = 0;
+		d[2][dim] = 0;
+		d[3][dim] = 0;
+	}
+	for (int i = PP_DEGREE - 1; i >= 0; --i) {
+		for (int dim = 0; dim < 4; ++dim) {
+			d[3][dim] = d[3][dim] * t + d[2][dim];
+			d[2][dim] = d[2][dim] * t + d[1][dim];
+			d[1][dim] = d[1][dim] * t + d[0][dim];
+			d[0][dim] = d[0][dim] * t + p->p[dim][i];
+		}
+	}
+}
+
+// evaluate a single polynomial piece with the position shifted by shift, and the
+// k-th derivatives scaled by dscale^k. evaluating p at t / s with dscale = 1 / s
+// is the same as evaluating p stretched in time by s at t, and dscale = -1 / s
+// reflects it in time as well. this avoids copying and transforming the piece.
+static struct traj_eval poly4d_eval_scaled(struct poly4d const *p, float t, float dscale, struct vec shift)
 {
+	float const dscale2 = dscale * dscale;
+	float const dscale3 = dscale2 * dscale;
+
+	float d[4][4];
+	poly4d_horner(p, t, d);
+
 	// flat variables
 	struct traj_eval out;
-	out.pos = polyval_xyz(p, t);
-	out.yaw = polyval_yaw(p, t);
+	out.pos = vadd(mkvec(d[0][0], d[0][1], d[0][2]), shift);
+	out.yaw = d[0][3];
 
 	// 1st derivative
-	struct poly4d* deriv = &poly4d_tmp;
-	*deriv = *p;
-	polyder4d(deriv);
-	out.vel = polyval_xyz(deriv, t);
-	float dyaw = polyval_yaw(deriv, t);
+	out.vel = vscl(dscale, mkvec(d[1][0], d[1][1], d[1][2]));
+	float dyaw = dscale * d[1][3];
 
 	// 2nd derivative
-	polyder4d(deriv);
-	out.acc = polyval_xyz(deriv, t);
+	out.acc = vscl(2 * dscale2, mkvec(d[2][0], d[2][1], d[2][2]));
 
 	// 3rd derivative
-	polyder4d(deriv);
-	struct vec jerk = polyval_xyz(deriv, t);
+	struct vec jerk = vscl(6 * dscale3, mkvec(d[3][0], d[3][1], d[3][2]));
 
 	struct vec thrust = vadd(out.acc, mkvec(0, 0, GRAV));
 	// float thrust_mag = mass * vmag(thrust);
@@ -329,26 +350,67 @@ struct traj_eval poly4d_eval(struct poly4d const *p, float t)
 	return out;
 }
 
+struct traj_eval poly4d_eval(struct poly4d const *p, float t)
+{
+	return poly4d_eval_scaled(p, t, 1.0f, vzero());
+}
+
 //
 // piecewise 4d polynomials
 //
 
+static inline struct poly4d const *piece_at(struct piecewise_traj const *traj, int index, bool reversed)
+{
+	return &traj->pieces[reversed ? traj->n_pieces - 1 - index : index];
+}
+
+// move the cursor to the piece that contains t, relative to t_begin. the
+// search starts from the piece that was evaluated last. returns false if t is
+// after the end of the trajectory, the cursor is then on the last piece.
+static bool piecewise_seek(struct piecewise_traj *traj, float t, bool reversed)
+{
+	if (traj->cursor.t_begin != traj->t_begin
+	    || traj->cursor.pieces != traj->pieces
+	    || traj->cursor.n_pieces != traj->n_pieces
+	    || traj->cursor.timescale != traj->timescale
+	    || traj->cursor.reversed != reversed) {
+		traj->cursor.t_begin = traj->t_begin;
+		traj->cursor.pieces = traj->pieces;
+		traj->cursor.n_pieces = traj->n_pieces;
+		traj->cursor.timescale = traj->timescale;
+		traj->cursor.reversed = reversed;
+		traj->cursor.index = 0;
+		traj->cursor.t_begin_relative = 0;
+	}
+
+	// a time on the boundary of two pieces belongs to the first one
+	while (traj->cursor.index > 0 && t <= traj->cursor.t_begin_relative) {
+		--traj->cursor.index;
+		traj->cursor.t_begin_relative -= piece_at(traj, traj->cursor.index, reversed)->duration * traj->timescale;
+	}
+
+	while (true) {
+		float end = traj->cursor.t_begin_relative + piece_at(traj, traj->cursor.index, reversed)->duration * traj->timescale;
+		if (t <= end) {
+			return true;
+		}
+		if (traj->cursor.index + 1 >= traj->n_pieces) {
+			return false;
+		}
+		traj->cursor.t_begin_relative = end;
+		++traj->cursor.index;
+	}
+}
+
 // piecewise eval
 struct traj_eval piecewise_eval(
-  struct piecewise_traj const *traj, float t)
+  struct piecewise_traj *traj, float t)
 {
-	int cursor = 0;
 	t = t - traj->t_begin;
-	while (cursor < traj->n_pieces) {
-		struct poly4d const *piece = &(traj->pieces[cursor]);
-		if (t <= piece->duration * traj->timescale) {
-			poly4d_tmp = *piece;
-			poly4d_shift(&poly4d_tmp, traj->shift.x, traj->shift.y, traj->shift.z, 0);
-			poly4d_stretchtime(&poly4d_tmp, traj->timescale);
-			return poly4d_eval(&poly4d_tmp, t);
-		}
-		t -= piece->duration * traj->timescale;
-		++cursor;
+	if (piecewise_seek(traj, t, false)) {
+		struct poly4d const *piece = piece_at(traj, traj->cursor.index, false);
+		t -= traj->cursor.t_begin_relative;
+		return poly4d_eval_scaled(piece, t / traj->timescale, 1.0f / traj->timescale, traj->shift);
 	}
 	// if we get here, the trajectory has ended
 	struct poly4d const *end_piece = &(traj->pieces[traj->n_pieces - 1]);
@@ -361,24 +423,14 @@ struct traj_eval piecewise_eval(
 }
 
 struct traj_eval piecewise_eval_reversed(
-  struct piecewise_traj const *traj, float t)
+  struct piecewise_traj *traj, float t)
 {
-	int cursor = traj->n_pieces - 1;
 	t = t - traj->t_begin;
-	while (cursor >= 0) {
-		struct poly4d const *piece = &(traj->pieces[cursor]);
-		if (t <= piece->duration * traj->timescale) {
-			poly4d_tmp = *piece;
-			poly4d_shift(&poly4d_tmp, traj->shift.x, traj->shift.y, traj->shift.z, 0);
-			poly4d_stretchtime(&poly4d_tmp, traj->timescale);
-			for (int i = 0; i < 4; ++i) {
-				polyreflect(poly4d_tmp.p[i]);
-			}
-			t = t - piece->duration * traj->timescale;
-			return poly4d_eval(&poly4d_tmp, t);
-		}
-		t -= piece->duration * traj->timescale;
-		--cursor;
+	if (piecewise_seek(traj, t, true)) {
+		struct poly4d const *piece = piece_at(traj, traj->cursor.index, true);
+		// the piece is evaluated backwards from its end
+		t = piece->duration * traj->timescale - (t - traj->cursor.t_begin_relative);
+		return poly4d_eval_scaled(piece, t / traj->timescale, -1.0f / traj->timescale, traj->shift);
 	}
 	// if we get here, the trajectory has ended
 	struct poly4d const *end_piece = &(traj->pieces[0]);
@@ -71,8 +71,8 @@ static inline float time_relative_to_start_of_current_piece(const struct piecewi
 
 static void piecewise_compressed_advance_playhead(struct piecewise_traj_compressed *traj);
 static void piecewise_compressed_rewind(struct piecewise_traj_compressed *traj);
-static void piecewise_compressed_update_current_poly4d(
-  struct piecewise_traj_compressed *traj, const struct traj_eval *end_of_previous_piece);
+static void decode_piece(
+  struct poly4d* poly4d, compressed_piece_ptr ptr, const struct traj_eval *end_of_previous_piece);
 
 // Calculates the coefficients of a 7D polynomial from the compressed
 // representation starting at the given pointer. Returns a pointer that
@@ -255,22 +255,22 @@ static void piecewise_compressed_rewind(struct piecewise_traj_compressed *traj)
   ptr = next_coordinate(ptr, &value); stopped.yaw = value / STORED_ANGLE_SCALE;
   traj->current_piece.t_begin_relative = 0;
   traj->current_piece.data = ptr;
+  traj->next_piece.data = 0;
 
-  piecewise_compressed_update_current_poly4d(traj, &stopped);
+  decode_piece(&traj->current_piece.poly4d, ptr, &stopped);
 }
 
-static void piecewise_compressed_update_current_poly4d(
-  struct piecewise_traj_compressed *traj, const struct traj_eval *prev_end)
+// Decodes the piece at the given pointer into a poly4d, starting where the
+// previous piece ended
+static void decode_piece(
+  struct poly4d* poly4d, compressed_piece_ptr ptr, const struct traj_eval *prev_end)
 {
-  struct poly4d* poly4d = &traj->current_piece.poly4d;
-  compressed_piece_ptr ptr;
   struct compressed_piece_parsed_header header;
 
   /* First, clear everything in the poly4d */
   bzero(poly4d, sizeof(*poly4d));
 
-  /* Parse the header of the current piece, extract the storage types and the duration */
-  ptr = traj->current_piece.data;
+  /* Parse the header of the piece, extract the storage types and the duration */
   parse_header_of_current_piece(&header, ptr);
   poly4d->duration = header.duration_in_msec / STORED_DURATION_SCALE;
 
@@ -289,10 +289,35 @@ static void piecewise_compressed_update_current_poly4d(
 static void piecewise_compressed_advance_playhead(struct piecewise_traj_compressed *traj)
 {
   float duration = traj->current_piece.poly4d.duration;
-  struct traj_eval end_of_previous_piece = poly4d_eval(&traj->current_piece.poly4d, duration);
+  compressed_piece_ptr next = next_piece(traj->current_piece.data);
+
+  if (next && traj->next_piece.data == next) {
+    traj->current_piece.poly4d = traj->next_piece.poly4d;
+  } else {
+    struct traj_eval end_of_previous_piece = poly4d_eval(&traj->current_piece.poly4d, duration);
+    decode_piece(&traj->current_piece.poly4d, next, &end_of_previous_piece);
+  }
 
   traj->current_piece.t_begin_relative += duration;
-  traj->current_piece.data = next_piece(traj->current_piece.data);
+  traj->current_piece.data = next;
+  traj->next_piece.data = 0;
+}
+
+void piecewise_compressed_prefetch(struct piecewise_traj_compressed *traj)
+{
+  compressed_piece_ptr next;
+
+  if (!traj->current_piece.data) {
+    return;
+  }
 
-  piecewise_compressed_update_current_poly4d(traj, &end_of_previous_piece);
+  next = next_piece(traj->current_piece.data);
+  if (!next || traj->next_piece.data == next) {
+    return;
+  }
+
+  float duration = traj->current_piece.poly4d.duration;
+  struct traj_eval end_of_current_piece = poly4d_eval(&traj->current_piece.poly4d, duration);
+  decode_piece(&traj->next_piece.poly4d, next, &end_of_current_piece);
+  traj->next_piece.data = next;
 }
@@ -28,9 +28,163 @@
 
 #include "queuemonitor.h"
 
+#include <stdbool.h>
+#include "task.h"
+#include "static_mem.h"
+#include "log.h"
+
+/* Statistics of the key queues, always enabled. The queues are identified by
+ * the queue number, bits 8-15 hold the index of the queue record + 1, the low
+ * byte is used by the debug queue monitor. The trace hooks are called in a
+ * critical section, or with interrupts masked in the FromISR functions. */
+
+#define MAX_NR_OF_MONITORED_QUEUES 40
+// Send times of the items in the queues, in ms. A queue only gets residency
+// times if the timestamps for its full length fit.
+#define NR_OF_TIMESTAMPS 384
+
+#define QUEUE_NUMBER_RECORD_SHIFT 8
+#define QUEUE_NUMBER_DEBUG_MASK 0xff
+
+// Weight of a new sample in the average occupancy, 1/16
+#define OCCUPANCY_FILTER_SHIFT 4
+
+typedef struct
+{
+  uint8_t group;
+  uint8_t length;
+  uint16_t timestampStart; // NR_OF_TIMESTAMPS if no residency is recorded
+  uint8_t timestampHead;
+  uint8_t timestampCount;
+} queueRecord_t;
+
+typedef struct
+{
+  uint16_t highWater;    // most items waiting in one queue of the group
+  uint16_t occupancy;    // average items waiting after a send, in 0.01 items
+  uint16_t maxResidency; // longest time an item waited, in ms
+  uint32_t drops;        // sends that failed because the queue was full
+} queueGroupStats_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static queueRecord_t records[MAX_NR_OF_MONITORED_QUEUES];
+NO_DMA_CCM_SAFE_ZERO_INIT static uint16_t timestamps[NR_OF_TIMESTAMPS];
+static uint8_t nrOfRecords;
+static uint16_t nrOfTimestamps;
+static queueGroupStats_t groupStats[queueMonitorGroupCount];
+
+#ifdef DEBUG_QUEUE_MONITOR
+static void debugTraceSend(void* xQueue);
+static void debugTraceSendFailed(void* xQueue);
+#endif
+
+void queueMonitorAddQueue(xQueueHandle queue, queueMonitorGroup_t group)
+{
+  const UBaseType_t length = uxQueueMessagesWaiting(queue) + uxQueueSpacesAvailable(queue);
+
+  taskENTER_CRITICAL();
+  if (nrOfRecords < MAX_NR_OF_MONITORED_QUEUES) {
+    queueRecord_t* record = &records[nrOfRecords];
+    record->group = group;
+    record->length = length;
+    record->timestampStart = NR_OF_TIMESTAMPS;
+    if (length <= UINT8_MAX && nrOfTimestamps + length <= NR_OF_TIMESTAMPS) {
+      record->timestampStart = nrOfTimestamps;
+      nrOfTimestamps += length;
+    }
+
+    nrOfRecords++;
+    const UBaseType_t debugNumber = uxQueueGetQueueNumber(queue) & QUEUE_NUMBER_DEBUG_MASK;
+    vQueueSetQueueNumber(queue, debugNumber | (nrOfRecords << QUEUE_NUMBER_RECORD_SHIFT));
+  }
+  taskEXIT_CRITICAL();
+}
+
+static queueRecord_t* getRecord(void* xQueue)
+{
+  const UBaseType_t index = uxQueueGetQueueNumber(xQueue) >> QUEUE_NUMBER_RECORD_SHIFT;
+  if (index == 0 || index > nrOfRecords) {
+    return 0;
+  }
+
+  return &records[index - 1];
+}
+
+static uint16_t now(void)
+{
+  return T2M(xTaskGetTickCountFromISR());
+}
+
+void qm_traceQUEUE_SEND(void* xQueue)
+{
+#ifdef DEBUG_QUEUE_MONITOR
+  debugTraceSend(xQueue);
+#endif
+
+  queueRecord_t* record = getRecord(xQueue);
+  if (!record) {
+    return;
+  }
+
+  // We get here before the item is added to the queue
+  const uint16_t waiting = uxQueueMessagesWaitingFromISR(xQueue) + 1;
+
+  queueGroupStats_t* stats = &groupStats[record->group];
+  if (waiting > stats->highWater) {
+    stats->highWater = waiting;
+  }
+  stats->occupancy += ((int32_t)waiting * 100 - stats->occupancy) >> OCCUPANCY_FILTER_SHIFT;
+
+  if (record->timestampStart < NR_OF_TIMESTAMPS && record->timestampCount < record->length) {
+    const uint8_t slot = (record->timestampHead + record->timestampCount) % record->length;
+    timestamps[record->timestampStart + slot] = now();
+    record->timestampCount++;
+  }
+}
+
+void qm_traceQUEUE_SEND_FAILED(void* xQueue)
+{
+#ifdef DEBUG_QUEUE_MONITOR
+  debugTraceSendFailed(xQueue);
+#endif
+
+  queueRecord_t* record = getRecord(xQueue);
+  if (record) {
+    groupStats[record->group].drops++;
+  }
+}
+
+void qm_traceQUEUE_RECEIVE(void* xQueue)
+{
+  queueRecord_t* record = getRecord(xQueue);
+  if (!record || record->timestampStart >= NR_OF_TIMESTAMPS) {
+    return;
+  }
+
+  // We get here before the item is removed from the queue. Overwritten items
+  // leave extra timestamps, the oldest ones are dropped. Items that were in the
+  // queue before it was monitored have no timestamp and are skipped.
+  const UBaseType_t waiting = uxQueueMessagesWaitingFromISR(xQueue);
+  while (record->timestampCount > waiting) {
+    record->timestampHead = (record->timestampHead + 1) % record->length;
+    record->timestampCount--;
+  }
+
+  if (record->timestampCount == 0 || record->timestampCount < waiting) {
+    return;
+  }
+
+  const uint16_t residency = now() - timestamps[record->timestampStart + record->timestampHead];
+  record->timestampHead = (record->timestampHead + 1) % record->length;
+  record->timestampCount--;
+
+  queueGroupStats_t* stats = &groupStats[record->group];
+  if (residency > stats->maxResidency) {
+    stats->maxResidency = residency;
+  }
+}
+
 #ifdef DEBUG_QUEUE_MONITOR
 
-#include <stdbool.h>
 #include "timers.h"
 #include "debug.h"
 #include "cfassert.h"
@@ -80,7 +234,7 @@ void queueMonitorInit() {
   initialized = true;
 }
 
-void qm_traceQUEUE_SEND(void* xQueue) {
+static void debugTraceSend(void* xQueue) {
   if(initialized) {
     Data* queueData = getQueueData(xQueue);
 
@@ -89,7 +243,7 @@ void qm_traceQUEUE_SEND(void* xQueue) {
   }
 }
 
-void qm_traceQUEUE_SEND_FAILED(void* xQueue) {
+static void debugTraceSendFailed(void* xQueue) {
   if(initialized) {
     Data* queueData = getQueueData(xQueue);
 
@@ -104,13 +258,13 @@ void qmRegisterQueue(xQueueHandle* xQueue, char* fileName, char* queueName) {
 
   queueData->fileName = fileName;
   queueData->queueName = queueName;
-  vQueueSetQueueNumber(xQueue, nrOfQueues);
+  vQueueSetQueueNumber(xQueue, (uxQueueGetQueueNumber(xQueue) & ~QUEUE_NUMBER_DEBUG_MASK) | nrOfQueues);
 
   nrOfQueues++;
 }
 
 static Data* getQueueData(xQueueHandle* xQueue) {
-  unsigned char number = uxQueueGetQueueNumber(xQueue);
+  unsigned char number = uxQueueGetQueueNumber(xQueue) & QUEUE_NUMBER_DEBUG_MASK;
   ASSERT(number < MAX_NR_OF_QUEUES);
   return &data[number];
 }
@@ -172,3 +326,106 @@ static void timerHandler(xTimerHandle timer) {
 }
 
 #endif // DEBUG_QUEUE_MONITOR
+
+/**
+ * Statistics of the key queues, the maximums are since startup. Queues of the
+ * same kind share one set of statistics.
+ */
+LOG_GROUP_START(queueMon)
+/**
+ * @brief Most items waiting in one of the CRTP TX queues
+ */
+LOG_ADD(LOG_UINT16, crtpTxHw, &groupStats[queueMonitorCrtpTx].highWater)
+/**
+ * @brief Average number of items waiting in the CRTP TX queues after a send, in 0.01 items
+ */
+LOG_ADD(LOG_UINT16, crtpTxOcc, &groupStats[queueMonitorCrtpTx].occupancy)
+/**
+ * @brief Longest time an item waited in the CRTP TX queues [ms]
+ */
+LOG_ADD(LOG_UINT16, crtpTxRes, &groupStats[queueMonitorCrtpTx].maxResidency)
+/**
+ * @brief Number of sends that failed because one of the CRTP TX queues was full
+ */
+LOG_ADD(LOG_UINT32, crtpTxDrop, &groupStats[queueMonitorCrtpTx].drops)
+/**
+ * @brief Most items waiting in one of the CRTP RX port queues
+ */
+LOG_ADD(LOG_UINT16, crtpRxHw, &groupStats[queueMonitorCrtpRx].highWater)
+/**
+ * @brief Average number of items waiting in the CRTP RX port queues after a send, in 0.01 items
+ */
+LOG_ADD(LOG_UINT16, crtpRxOcc, &groupStats[queueMonitorCrtpRx].occupancy)
+/**
+ * @brief Longest time an item waited in the CRTP RX port queues [ms]
+ */
+LOG_ADD(LOG_UINT16, crtpRxRes, &groupStats[queueMonitorCrtpRx].maxResidency)
+/**
+ * @brief Number of sends that failed because one of the CRTP RX port queues was full
+ */
+LOG_ADD(LOG_UINT32, crtpRxDrop, &groupStats[queueMonitorCrtpRx].drops)
+/**
+ * @brief Most items waiting in one of the estimator measurement queues
+ */
+LOG_ADD(LOG_UINT16, estHw, &groupStats[queueMonitorEstimator].highWater)
+/**
+ * @brief Average number of items waiting in the estimator measurement queues after a send, in 0.01 items
+ */
+LOG_ADD(LOG_UINT16, estOcc, &groupStats[queueMonitorEstimator].occupancy)
+/**
+ * @brief Longest time an item waited in the estimator measurement queues [ms]
+ */
+LOG_ADD(LOG_UINT16, estRes, &groupStats[queueMonitorEstimator].maxResidency)
+/**
+ * @brief Number of sends that failed because one of the estimator measurement queues was full
+ */
+LOG_ADD(LOG_UINT32, estDrop, &groupStats[queueMonitorEstimator].drops)
+/**
+ * @brief Most items waiting in one of the syslink packet delivery queue
+ */
+LOG_ADD(LOG_UINT16, slinkHw, &groupStats[queueMonitorSyslink].highWater)
+/**
+ * @brief Average number of items waiting in the syslink packet delivery queue after a send, in 0.01 items
+ */
+LOG_ADD(LOG_UINT16, slinkOcc, &groupStats[queueMonitorSyslink].occupancy)
+/**
+ * @brief Longest time an item waited in the syslink packet delivery queue [ms]
+ */
+LOG_ADD(LOG_UINT16, slinkRes, &groupStats[queueMonitorSyslink].maxResidency)
+/**
+ * @brief Number of sends that failed because one of the syslink packet delivery queue was full
+ */
+LOG_ADD(LOG_UINT32, slinkDrop, &groupStats[queueMonitorSyslink].drops)
+/**
+ * @brief Most items waiting in one of the worker queues
+ */
+LOG_ADD(LOG_UINT16, workerHw, &groupStats[queueMonitorWorker].highWater)
+/**
+ * @brief Average number of items waiting in the worker queues after a send, in 0.01 items
+ */
+LOG_ADD(LOG_UINT16, workerOcc, &groupStats[queueMonitorWorker].occupancy)
+/**
+ * @brief Longest time an item waited in the worker queues [ms]
+ */
+LOG_ADD(LOG_UINT16, workerRes, &groupStats[queueMonitorWorker].maxResidency)
+/**
+ * @brief Number of sends that failed because one of the worker queues was full
+ */
+LOG_ADD(LOG_UINT32, workerDrop, &groupStats[queueMonitorWorker].drops)
+/**
+ * @brief Most items waiting in one of the app channel queue
+ */
+LOG_ADD(LOG_UINT16, appChHw, &groupStats[queueMonitorAppChannel].highWater)
+/**
+ * @brief Average number of items waiting in the app channel queue after a send, in 0.01 items
+ */
+LOG_ADD(LOG_UINT16, appChOcc, &groupStats[queueMonitorAppChannel].occupancy)
+/**
+ * @brief Longest time an item waited in the app channel queue [ms]
+ */
+LOG_ADD(LOG_UINT16, appChRes, &groupStats[queueMonitorAppChannel].maxResidency)
+/**
+ * @brief Number of sends that failed because one of the app channel queue was full
+ */
+LOG_ADD(LOG_UINT32, appChDrop, &groupStats[queueMonitorAppChannel].drops)
+LOG_GROUP_STOP(queueMon)
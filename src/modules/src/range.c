@@ -33,12 +33,19 @@
 #include "estimator.h"
 
 static uint16_t ranges[RANGE_T_END] = {0,};
+static uint32_t timestamps[RANGE_T_END] = {0,};
 
 void rangeSet(rangeDirection_t direction, float range_m)
+{
+  rangeSetWithTimestamp(direction, range_m, 0);
+}
+
+void rangeSetWithTimestamp(rangeDirection_t direction, float range_m, uint32_t timestamp)
 {
   if (direction > (RANGE_T_END-1)) return;
 
   ranges[direction] = range_m * 1000;
+  timestamps[direction] = timestamp;
 }
 
 float rangeGet(rangeDirection_t direction)
@@ -48,6 +55,13 @@ float rangeGet(rangeDirection_t direction)
   return ranges[direction];
 }
 
+uint32_t rangeGetTimestamp(rangeDirection_t direction)
+{
+  if (direction > (RANGE_T_END-1)) return 0;
+
+  return timestamps[direction];
+}
+
 void rangeEnqueueDownRangeInEstimator(float distance, float stdDev, uint32_t timeStamp) {
   tofMeasurement_t tofData;
   tofData.timestamp = timeStamp;
@@ -0,0 +1,180 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rate_health.c - Rate health of the supervised tasks, readable through the memory subsystem
+ *
+ * The tasks attach to the registry of rateSupervisor.h with their expected
+ * rate and tolerance. The measured rate, jitter percentiles and miss counts
+ * of all registered tasks are read as one table (MEM_TYPE_RATE_HEALTH), a
+ * read from address 0 latches a copy of the table so that a table read in
+ * several packets is from one point in time. The rateHealth log group holds
+ * a summary of it.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rate_health.h"
+#include "rateSupervisor.h"
+#include "mem.h"
+#include "log.h"
+#include "static_mem.h"
+
+#define RATE_HEALTH_VERSION 1
+#define RATE_HEALTH_NAME_LENGTH 12
+
+enum {
+  rateHealthOk = 1 << 0,
+  rateHealthMonitorOnly = 1 << 1,
+};
+
+typedef struct {
+  char name[RATE_HEALTH_NAME_LENGTH];
+  uint16_t expectedRate; // Hz, 0 if the rate is only measured
+  uint16_t rate;         // Hz
+  uint16_t jitterP50;    // us
+  uint16_t jitterP95;    // us
+  uint16_t jitterP99;    // us
+  uint32_t missed;
+  uint32_t failures;
+  uint8_t flags;
+  uint8_t reserved;
+} __attribute__((packed)) rateHealthEntry_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t entryCount;
+  uint8_t entrySize;
+  uint8_t reserved;
+  rateHealthEntry_t entries[RATE_SUPERVISOR_MAX_REGISTERED];
+} __attribute__((packed)) rateHealthTable_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static rateHealthTable_t latched;
+
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_RATE_HEALTH,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+void rateHealthInit(void)
+{
+  memoryRegisterHandler(&memDef);
+}
+
+static void fillEntry(const rateSupervisor_t* supervisor, rateHealthEntry_t* entry)
+{
+  const rateSupervisorStats_t* stats = rateSupervisorStats(supervisor);
+
+  memset(entry, 0, sizeof(rateHealthEntry_t));
+  strncpy(entry->name, supervisor->name, sizeof(entry->name));
+  entry->expectedRate = supervisor->expectedCount * 1000 / supervisor->evaluationIntervalMs;
+  entry->rate = stats->rate;
+  entry->jitterP50 = stats->jitterP50;
+  entry->jitterP95 = stats->jitterP95;
+  entry->jitterP99 = stats->jitterP99;
+  entry->missed = stats->missed;
+  entry->failures = stats->failures;
+  entry->flags = (stats->ok ? rateHealthOk : 0) | (supervisor->expectedCount == 0 ? rateHealthMonitorOnly : 0);
+}
+
+// The statistics are updated by the supervised tasks, the scheduler is
+// suspended so that no entry is updated while it is copied
+static void latchTable(void)
+{
+  vTaskSuspendAll();
+  const int count = rateSupervisorRegisteredCount();
+  for (int i = 0; i < count; i++) {
+    fillEntry(rateSupervisorRegistered(i), &latched.entries[i]);
+  }
+  xTaskResumeAll();
+
+  latched.version = RATE_HEALTH_VERSION;
+  latched.entryCount = count;
+  latched.entrySize = sizeof(rateHealthEntry_t);
+}
+
+static uint32_t handleMemGetSize(void)
+{
+  return offsetof(rateHealthTable_t, entries) + rateSupervisorRegisteredCount() * sizeof(rateHealthEntry_t);
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest)
+{
+  if (memAddr == 0) {
+    latchTable();
+  }
+
+  const uint32_t size = offsetof(rateHealthTable_t, entries) + latched.entryCount * sizeof(rateHealthEntry_t);
+  if (memAddr > size || readLen > size - memAddr) {
+    return false;
+  }
+
+  memcpy(dest, ((const uint8_t*)&latched) + memAddr, readLen);
+  return true;
+}
+
+static uint8_t failingCount(uint32_t timestamp, void* data)
+{
+  uint8_t failing = 0;
+  for (int i = 0; i < rateSupervisorRegisteredCount(); i++) {
+    if (!rateSupervisorStats(rateSupervisorRegistered(i))->ok) {
+      failing++;
+    }
+  }
+
+  return failing;
+}
+
+static uint32_t missedTotal(uint32_t timestamp, void* data)
+{
+  uint32_t missed = 0;
+  for (int i = 0; i < rateSupervisorRegisteredCount(); i++) {
+    missed += rateSupervisorStats(rateSupervisorRegistered(i))->missed;
+  }
+
+  return missed;
+}
+
+static logByFunction_t failingLoggerDef = {.acquireUInt8 = failingCount, .data = 0};
+static logByFunction_t missedLoggerDef = {.acquireUInt32 = missedTotal, .data = 0};
+
+/**
+ * Summary of the rate health of the supervised tasks, see MEM_TYPE_RATE_HEALTH
+ * for the rate of each task.
+ */
+LOG_GROUP_START(rateHealth)
+/**
+ * @brief Number of supervised tasks whose rate was out of bounds in their latest evaluation
+ */
+LOG_ADD_BY_FUNCTION(LOG_UINT8, failing, &failingLoggerDef)
+/**
+ * @brief Calls short of the expected rate of all supervised tasks, since startup
+ */
+LOG_ADD_BY_FUNCTION(LOG_UINT32, missed, &missedLoggerDef)
+LOG_GROUP_STOP(rateHealth)
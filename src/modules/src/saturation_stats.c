@@ -0,0 +1,140 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * saturation_stats.c - Counters of where the control chain saturates
+ *
+ * The counters are always on and only cost a few compares per tick. The
+ * histogram shows how much of the motor range the highest motor uses, it is
+ * latched once per second and logged as percent of the ticks per bin, packed
+ * four bins per log variable (bin 0 in the lowest byte of histLo). When the
+ * motors stay saturated for satStats.burstMs the motorSat event is triggered,
+ * to capture the episode with the event logging of the uSD deck.
+ */
+#include "saturation_stats.h"
+
+#include "stabilizer_types.h"
+#include "eventtrigger.h"
+#include "log.h"
+#include "param.h"
+
+// Histogram window, in motor updates
+#define HIST_WINDOW RATE_MAIN_LOOP
+
+static uint32_t motorHighCount;
+static uint32_t motorLowCount;
+static uint32_t rateOutputCount;
+static uint32_t integratorCount;
+static uint32_t burstCount;
+
+static uint16_t histogram[SATURATION_STATS_HIST_BINS];
+static uint16_t histogramUpdates;
+static uint32_t histogramLog[SATURATION_STATS_HIST_BINS / 4];
+
+// Motor updates (ms) of continuous saturation before a burst capture, 0 to disable
+static uint16_t burstMs = 100;
+static uint16_t saturatedUpdates;
+
+EVENTTRIGGER(motorSat, uint16, duration, float, highest, float, lowest)
+
+static void latchHistogram(void)
+{
+  for (int i = 0; i < SATURATION_STATS_HIST_BINS; i++) {
+    const uint32_t percent = (histogram[i] * 100U) / HIST_WINDOW;
+    const int shift = (i % 4) * 8;
+    histogramLog[i / 4] = (histogramLog[i / 4] & ~(0xffU << shift)) | (percent << shift);
+    histogram[i] = 0;
+  }
+  histogramUpdates = 0;
+}
+
+void saturationStatsMotors(const float power[], const int count, const float maxPower)
+{
+  float highest = power[0];
+  float lowest = power[0];
+  for (int i = 1; i < count; i++) {
+    if (power[i] > highest) {
+      highest = power[i];
+    }
+    if (power[i] < lowest) {
+      lowest = power[i];
+    }
+  }
+
+  const bool high = (highest > maxPower);
+  const bool low = (lowest < 0.0f);
+  motorHighCount += high;
+  motorLowCount += low;
+
+  int bin = 0;
+  if (highest > 0.0f) {
+    bin = (int)(highest * (SATURATION_STATS_HIST_BINS / maxPower));
+    if (bin >= SATURATION_STATS_HIST_BINS) {
+      bin = SATURATION_STATS_HIST_BINS - 1;
+    }
+  }
+  histogram[bin]++;
+  histogramUpdates++;
+  if (histogramUpdates >= HIST_WINDOW) {
+    latchHistogram();
+  }
+
+  if (high || low) {
+    if (saturatedUpdates < UINT16_MAX) {
+      saturatedUpdates++;
+    }
+    if (burstMs != 0 && saturatedUpdates == burstMs) {
+      burstCount++;
+      eventTrigger_motorSat_payload.duration = saturatedUpdates;
+      eventTrigger_motorSat_payload.highest = highest;
+      eventTrigger_motorSat_payload.lowest = lowest;
+      eventTrigger(&eventTrigger_motorSat);
+    }
+  } else {
+    saturatedUpdates = 0;
+  }
+}
+
+void saturationStatsRateOutput(void)
+{
+  rateOutputCount++;
+}
+
+void saturationStatsIntegrator(void)
+{
+  integratorCount++;
+}
+
+PARAM_GROUP_START(satStats)
+PARAM_ADD(PARAM_UINT16, burstMs, &burstMs)
+PARAM_GROUP_STOP(satStats)
+
+LOG_GROUP_START(satStats)
+LOG_ADD(LOG_UINT32, motorHigh, &motorHighCount)
+LOG_ADD(LOG_UINT32, motorLow, &motorLowCount)
+LOG_ADD(LOG_UINT32, rateOut, &rateOutputCount)
+LOG_ADD(LOG_UINT32, integ, &integratorCount)
+LOG_ADD(LOG_UINT32, burst, &burstCount)
+LOG_ADD(LOG_UINT16, satMs, &saturatedUpdates)
+LOG_ADD(LOG_UINT32, histLo, &histogramLog[0])
+LOG_ADD(LOG_UINT32, histHi, &histogramLog[1])
+LOG_GROUP_STOP(satStats)
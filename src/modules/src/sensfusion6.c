@@ -29,9 +29,15 @@
 #include "log.h"
 #include "param.h"
 #include "physicalConstants.h"
+#include "fastmath.h"
+#include "stabilizer_types.h"
 
 //#define MADWICK_QUATERNION_IMU
 
+#if defined(COMPLEMENTARY_FAST_ATTITUDE) && defined(MADWICK_QUATERNION_IMU)
+#error "COMPLEMENTARY_FAST_ATTITUDE is only implemented for the Mahony filter"
+#endif
+
 #ifdef MADWICK_QUATERNION_IMU
   #define BETA_DEF     0.01f    // 2 * proportional gain
 #else // MAHONY_QUATERNION_IMU
@@ -70,7 +76,6 @@ static float sensfusion6GetAccZ(const float ax, const float ay, const float az);
 static void estimatedGravityDirection(float* gx, float* gy, float* gz);
 
 // TODO: Make math util file
-static float invSqrt(float x);
 
 void sensfusion6Init()
 {
@@ -96,6 +101,56 @@ void sensfusion6UpdateQ(float gx, float gy, float gz, float ax, float ay, float
   }
 }
 
+#ifdef COMPLEMENTARY_FAST_ATTITUDE
+// Gyro (deg/s) to half the rotation (rad) over one update, and half the update period
+#define FAST_GYRO_SCALE (0.5f * M_PI_F / 180.0f / COMPLEMENTARY_ATTITUDE_RATE)
+#define FAST_HALF_DT (0.5f / COMPLEMENTARY_ATTITUDE_RATE)
+// Keeps the accelerometer norm away from zero, a zero sample then gives no feedback
+#define FAST_ACC_NORM_EPSILON 1e-6f
+
+// The Mahony update below with the constants folded in for the known period and
+// without branches. The integral feedback is left out, the gyro bias is already
+// removed by the sensors task. The quaternion is renormalised with one Newton step
+// around 1, the norm only drifts by the square of the rotation per update.
+void sensfusion6UpdateQFast(float gx, float gy, float gz, float ax, float ay, float az)
+{
+  const float recipNorm = 1.0f / sqrtf(ax * ax + ay * ay + az * az + FAST_ACC_NORM_EPSILON);
+  const float kp = twoKp * FAST_HALF_DT * recipNorm;
+
+  // Estimated direction of gravity
+  const float halfvx = qx * qz - qw * qy;
+  const float halfvy = qw * qx + qy * qz;
+  const float halfvz = qw * qw - 0.5f + qz * qz;
+
+  // Half the rotation over the period, with the proportional feedback on the
+  // cross product between the measured and estimated direction of gravity
+  gx = gx * FAST_GYRO_SCALE + kp * (ay * halfvz - az * halfvy);
+  gy = gy * FAST_GYRO_SCALE + kp * (az * halfvx - ax * halfvz);
+  gz = gz * FAST_GYRO_SCALE + kp * (ax * halfvy - ay * halfvx);
+
+  const float qa = qw;
+  const float qb = qx;
+  const float qc = qy;
+  qw += (-qb * gx - qc * gy - qz * gz);
+  qx += (qa * gx + qc * gz - qz * gy);
+  qy += (qa * gy - qb * gz + qz * gx);
+  qz += (qa * gz + qb * gy - qc * gx);
+
+  const float norm = 1.5f - 0.5f * (qw * qw + qx * qx + qy * qy + qz * qz);
+  qw *= norm;
+  qx *= norm;
+  qy *= norm;
+  qz *= norm;
+
+  estimatedGravityDirection(&gravX, &gravY, &gravZ);
+
+  if (!isCalibrated) {
+    baseZacc = sensfusion6GetAccZ(ax, ay, az);
+    isCalibrated = true;
+  }
+}
+#endif
+
 #ifdef MADWICK_QUATERNION_IMU
 // Implementation of Madgwick's IMU and AHRS algorithms.
 // See: http://www.x-io.co.uk/open-source-ahrs-with-x-imu
@@ -120,7 +175,7 @@ static void sensfusion6UpdateQImpl(float gx, float gy, float gz, float ax, float
   if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)))
   {
     // Normalise accelerometer measurement
-    recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    recipNorm = fastInvSqrt(ax * ax + ay * ay + az * az);
     ax *= recipNorm;
     ay *= recipNorm;
     az *= recipNorm;
@@ -145,7 +200,7 @@ static void sensfusion6UpdateQImpl(float gx, float gy, float gz, float ax, float
     s1 = _4qx * qzqz - _2qz * ax + 4.0f * qwqw * qx - _2qw * ay - _4qx + _8qx * qxqx + _8qx * qyqy + _4qx * az;
     s2 = 4.0f * qwqw * qy + _2qw * ax + _4qy * qzqz - _2qz * ay - _4qy + _8qy * qxqx + _8qy * qyqy + _4qy * az;
     s3 = 4.0f * qxqx * qz - _2qx * ax + 4.0f * qyqy * qz - _2qy * ay;
-    recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
+    recipNorm = fastInvSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
     s0 *= recipNorm;
     s1 *= recipNorm;
     s2 *= recipNorm;
@@ -165,7 +220,7 @@ static void sensfusion6UpdateQImpl(float gx, float gy, float gz, float ax, float
   qz += qDot4 * dt;
 
   // Normalise quaternion
-  recipNorm = invSqrt(qw*qw + qx*qx + qy*qy + qz*qz);
+  recipNorm = fastInvSqrt(qw*qw + qx*qx + qy*qy + qz*qz);
   qw *= recipNorm;
   qx *= recipNorm;
   qy *= recipNorm;
@@ -193,7 +248,7 @@ static void sensfusion6UpdateQImpl(float gx, float gy, float gz, float ax, float
   if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)))
   {
     // Normalise accelerometer measurement
-    recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    recipNorm = fastInvSqrt(ax * ax + ay * ay + az * az);
     ax *= recipNorm;
     ay *= recipNorm;
     az *= recipNorm;
@@ -244,7 +299,7 @@ static void sensfusion6UpdateQImpl(float gx, float gy, float gz, float ax, float
   qz += (qa * gz + qb * gy - qc * gx);
 
   // Normalise quaternion
-  recipNorm = invSqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+  recipNorm = fastInvSqrt(qw * qw + qx * qx + qy * qy + qz * qz);
   qw *= recipNorm;
   qx *= recipNorm;
   qy *= recipNorm;
@@ -269,9 +324,9 @@ void sensfusion6GetEulerRPY(float* roll, float* pitch, float* yaw)
   if (gx>1) gx=1;
   if (gx<-1) gx=-1;
 
-  *yaw = atan2f(2*(qw*qz + qx*qy), qw*qw + qx*qx - qy*qy - qz*qz) * 180 / M_PI_F;
-  *pitch = asinf(gx) * 180 / M_PI_F; //Pitch seems to be inverted
-  *roll = atan2f(gy, gz) * 180 / M_PI_F;
+  *yaw = fastAtan2(2*(qw*qz + qx*qy), qw*qw + qx*qx - qy*qy - qz*qz) * 180 / M_PI_F;
+  *pitch = fastAsin(gx) * 180 / M_PI_F; //Pitch seems to be inverted
+  *roll = fastAtan2(gy, gz) * 180 / M_PI_F;
 }
 
 float sensfusion6GetAccZWithoutGravity(const float ax, const float ay, const float az)
@@ -286,20 +341,6 @@ float sensfusion6GetInvThrustCompensationForTilt()
   return gravZ;
 }
 
-//---------------------------------------------------------------------------------------------------
-// Fast inverse square-root
-// See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
-float invSqrt(float x)
-{
-  float halfx = 0.5f * x;
-  float y = x;
-  long i = *(long*)&y;
-  i = 0x5f3759df - (i>>1);
-  y = *(float*)&i;
-  y = y * (1.5f - (halfx * y * y));
-  return y;
-}
-
 static float sensfusion6GetAccZ(const float ax, const float ay, const float az)
 {
   // return vertical acceleration
@@ -0,0 +1,154 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * setpoint_buffer.c - Play out of time stamped streaming setpoints
+ *
+ * Setpoints that are streamed over the radio arrive with 5-20 ms of jitter.
+ * When the sender stamps them with the time they apply to, and streams them a
+ * few frames ahead, they can be played out on the local clock instead, with
+ * the jitter absorbed by a short delay.
+ *
+ * The sender clock is mapped to the local clock by the offset of the fastest
+ * packets. A packet that is faster than the current offset pulls the offset
+ * down at once, otherwise the offset creeps up by 1 ms per packet to follow
+ * clock drift.
+ */
+#include "setpoint_buffer.h"
+
+#include <string.h>
+
+static setpointBufferEntry_t* entry(setpointBuffer_t* this, const int index)
+{
+  return &this->entries[(this->first + index) % SETPOINT_BUFFER_SIZE];
+}
+
+static float lerp(const float a, const float b, const float f)
+{
+  return a + (b - a) * f;
+}
+
+static float lerpAngle(const float a, const float b, const float f)
+{
+  float diff = b - a;
+  while (diff > 180.0f) {
+    diff -= 360.0f;
+  }
+  while (diff < -180.0f) {
+    diff += 360.0f;
+  }
+  return a + diff * f;
+}
+
+void setpointBufferInit(setpointBuffer_t* this, const uint16_t playoutDelay)
+{
+  memset(this, 0, sizeof(setpointBuffer_t));
+  this->playoutDelay = playoutDelay;
+}
+
+void setpointBufferPush(setpointBuffer_t* this, const uint16_t time, const setpoint_t* setpoint, const uint32_t now)
+{
+  if (!this->isSynced || (now - this->lastPush) > SETPOINT_BUFFER_RESYNC_MS) {
+    this->count = 0;
+    this->senderTime = time;
+    this->clockOffset = (int32_t)(now - time);
+    this->isSynced = true;
+  }
+  this->lastPush = now;
+
+  const int16_t delta = (int16_t)(time - (uint16_t)this->senderTime);
+  if (delta < 0 || (delta == 0 && this->count > 0)) {
+    // Out of order or repeated
+    return;
+  }
+  this->senderTime += delta;
+
+  const int32_t offset = (int32_t)(now - this->senderTime);
+  if (offset < this->clockOffset) {
+    this->clockOffset = offset;
+  } else {
+    this->clockOffset++;
+  }
+
+  if (this->count == SETPOINT_BUFFER_SIZE) {
+    this->first = (this->first + 1) % SETPOINT_BUFFER_SIZE;
+    this->count--;
+  }
+
+  setpointBufferEntry_t* last = entry(this, this->count);
+  last->time = this->senderTime;
+  last->setpoint = *setpoint;
+  this->count++;
+}
+
+bool setpointBufferGet(setpointBuffer_t* this, const uint32_t now, setpoint_t* setpoint)
+{
+  if (this->count == 0) {
+    return false;
+  }
+
+  const uint32_t playTime = now - this->clockOffset - this->playoutDelay;
+
+  // Keep the last entry that is at or before the play time
+  while (this->count >= 2 && (int32_t)(entry(this, 1)->time - playTime) <= 0) {
+    this->first = (this->first + 1) % SETPOINT_BUFFER_SIZE;
+    this->count--;
+  }
+
+  const setpointBufferEntry_t* a = entry(this, 0);
+  const int32_t sinceA = (int32_t)(playTime - a->time);
+
+  if (sinceA <= 0) {
+    // Before the first setpoint
+    *setpoint = a->setpoint;
+  } else if (this->count == 1) {
+    // After the last setpoint, extrapolate with its velocity
+    const int32_t ms = sinceA < SETPOINT_BUFFER_MAX_EXTRAPOLATION_MS ? sinceA : SETPOINT_BUFFER_MAX_EXTRAPOLATION_MS;
+    const float dt = ms / 1000.0f;
+    *setpoint = a->setpoint;
+    if (setpoint->mode.x == modeAbs) {
+      setpoint->position.x += setpoint->velocity.x * dt;
+    }
+    if (setpoint->mode.y == modeAbs) {
+      setpoint->position.y += setpoint->velocity.y * dt;
+    }
+    if (setpoint->mode.z == modeAbs) {
+      setpoint->position.z += setpoint->velocity.z * dt;
+    }
+  } else {
+    const setpointBufferEntry_t* b = entry(this, 1);
+    const float f = (float)sinceA / (float)(b->time - a->time);
+    *setpoint = b->setpoint;
+    setpoint->position.x = lerp(a->setpoint.position.x, b->setpoint.position.x, f);
+    setpoint->position.y = lerp(a->setpoint.position.y, b->setpoint.position.y, f);
+    setpoint->position.z = lerp(a->setpoint.position.z, b->setpoint.position.z, f);
+    setpoint->velocity.x = lerp(a->setpoint.velocity.x, b->setpoint.velocity.x, f);
+    setpoint->velocity.y = lerp(a->setpoint.velocity.y, b->setpoint.velocity.y, f);
+    setpoint->velocity.z = lerp(a->setpoint.velocity.z, b->setpoint.velocity.z, f);
+    setpoint->acceleration.x = lerp(a->setpoint.acceleration.x, b->setpoint.acceleration.x, f);
+    setpoint->acceleration.y = lerp(a->setpoint.acceleration.y, b->setpoint.acceleration.y, f);
+    setpoint->acceleration.z = lerp(a->setpoint.acceleration.z, b->setpoint.acceleration.z, f);
+    setpoint->attitude.yaw = lerpAngle(a->setpoint.attitude.yaw, b->setpoint.attitude.yaw, f);
+  }
+
+  return true;
+}
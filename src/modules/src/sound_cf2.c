@@ -33,8 +33,11 @@
 
 #include "FreeRTOS.h"
 #include "timers.h"
+#include "queue.h"
+#include "static_mem.h"
 
 #include "config.h"
+#include "cfassert.h"
 #include "param.h"
 #include "log.h"
 #include "sound.h"
@@ -152,17 +155,29 @@
 #define S  16 // 1/16
 #define ES 6
 /* End markers */
-#define STOP {0xFE, 0}
-#define REPEAT {0xFF, 0}
+#define STOP {SOUND_NOTE_STOP, 0}
+#define REPEAT {SOUND_NOTE_REPEAT, 0}
 
 #define MAX_NOTE_LENGTH 80
 
+/* The sound timer period */
+#define SOUND_TICK_MS 10
+#define SOUND_TICKS_PER_WHOLE_MINUTE (4 * 60 * 1000 / SOUND_TICK_MS)
+
+/* Room for the compiled built in melodies */
+#define SOUND_EVENT_POOL_SIZE 256
+
+#ifndef SOUND_QUEUE_LENGTH
+#define SOUND_QUEUE_LENGTH 4
+#endif
+
+#ifndef SOUND_QUEUE_MAX_NOTES
+#define SOUND_QUEUE_MAX_NOTES 32
+#endif
+
 static bool isInit=false;
 
-typedef const struct {
-  uint16_t tone;
-  uint16_t duration;
-} Note;
+typedef const soundNote_t Note;
 
 typedef const struct {
   uint32_t bpm;
@@ -203,10 +218,85 @@ static Melody valkyries = {.bpm = 140, .delay = 1, .notes = {{Gb3, Q}, {B3, Q},
     {D4, E}, {Gb4, H},
     REPEAT}};
 
-typedef void (*BuzzerEffect)(uint32_t timer, uint32_t * mi, Melody * melody);
+/*
+ * Melodies are compiled into a list of events at init, or when queued, so that
+ * the timer callback only counts ticks. An event plays a tone for all its ticks
+ * but the last one, which is silent.
+ */
+typedef struct {
+  uint16_t tone;
+  uint8_t ticks;
+} SoundEvent;
+
+typedef struct {
+  const SoundEvent * events;
+  uint16_t length;
+  bool repeat;
+} CompiledMelody;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static SoundEvent eventPool[SOUND_EVENT_POOL_SIZE];
+static int eventPoolUsed = 0;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static SoundEvent queuedEvents[SOUND_QUEUE_LENGTH][SOUND_QUEUE_MAX_NOTES];
+NO_DMA_CCM_SAFE_ZERO_INIT static CompiledMelody queuedMelodies[SOUND_QUEUE_LENGTH];
+static xQueueHandle playQueue;
+STATIC_MEM_QUEUE_ALLOC(soundPlayQueue, SOUND_QUEUE_LENGTH, sizeof(uint8_t));
+static xQueueHandle freeQueue;
+STATIC_MEM_QUEUE_ALLOC(soundFreeQueue, SOUND_QUEUE_LENGTH, sizeof(uint8_t));
+
+/**
+ * Compiles the notes into events. Returns the number of events, or -1 if the
+ * notes are not terminated within maxEvents notes.
+ */
+static int compileMelody(const soundNote_t * notes, uint32_t bpm, SoundEvent * events, int maxEvents, CompiledMelody * melody)
+{
+  int i;
+
+  for (i = 0; notes[i].tone != SOUND_NOTE_STOP && notes[i].tone != SOUND_NOTE_REPEAT; i++) {
+    if (i >= maxEvents) {
+      return -1;
+    }
+
+    uint32_t ticks = 1;
+    if (bpm * notes[i].duration != 0) {
+      ticks = SOUND_TICKS_PER_WHOLE_MINUTE / (bpm * notes[i].duration);
+    }
+    events[i].tone = notes[i].tone;
+    events[i].ticks = (ticks < 1) ? 1 : (ticks > UINT8_MAX) ? UINT8_MAX : ticks;
+  }
 
-static void off(uint32_t counter, uint32_t * mi, Melody * m) {
-  buzzerOff();
+  melody->events = events;
+  melody->length = i;
+  melody->repeat = (notes[i].tone == SOUND_NOTE_REPEAT);
+
+  return i;
+}
+
+typedef void (*BuzzerEffect)(uint32_t timer, uint32_t * mi, const CompiledMelody * melody);
+
+/* The buzzer is only touched when the tone changes */
+static uint32_t currentTone = 0;
+
+static void toneOff(void)
+{
+  if (currentTone != 0) {
+    buzzerOff();
+    currentTone = 0;
+  }
+}
+
+static void toneOn(uint32_t freq)
+{
+  if (freq == 0) {
+    toneOff();
+  } else if (freq != currentTone) {
+    buzzerOn(freq);
+    currentTone = freq;
+  }
+}
+
+static void off(uint32_t counter, uint32_t * mi, const CompiledMelody * m) {
+  toneOff();
 }
 
 static void turnCurrentEffectOff() {
@@ -218,44 +308,51 @@ static void turnCurrentEffectOff() {
 }
 
 static uint32_t mcounter = 0;
-static void melodyplayer(uint32_t counter, uint32_t * mi, Melody * m) {
-  uint16_t tone = m->notes[(*mi)].tone;
-  uint16_t duration = m->notes[(*mi)].duration;
 
+/**
+ * Plays one tick of a melody. Returns false on the tick of the end marker, the
+ * melody then starts over on the next call.
+ */
+static bool playMelodyTick(uint32_t * mi, const CompiledMelody * m) {
   if (mcounter == 0) {
-    if (tone == 0xFE) {
-      // Turn off buzzer since we're at the end
+    if ((*mi) >= m->length) {
       (*mi) = 0;
-      turnCurrentEffectOff();
-    } else if (tone == 0xFF) {
-      // Loop the melody
-      (*mi) = 0;
-    } else {
-      // Play current note
-      buzzerOn(tone);
-      mcounter = (100 * 4 * 60) / (m->bpm * duration) - 1;
-      (*mi)++;
+      return false;
     }
+
+    // Play current note
+    toneOn(m->events[(*mi)].tone);
+    mcounter = m->events[(*mi)].ticks - 1;
+    (*mi)++;
   } else {
     if (mcounter == 1) {
-        buzzerOff();
+      toneOff();
     }
     mcounter--;
   }
+
+  return true;
+}
+
+static void melodyplayer(uint32_t counter, uint32_t * mi, const CompiledMelody * m) {
+  if (!playMelodyTick(mi, m) && !m->repeat) {
+    // Turn off buzzer since we're at the end
+    turnCurrentEffectOff();
+  }
 }
 
 static uint8_t static_ratio = 0;
 static uint16_t static_freq = 4000;
-static void bypass(uint32_t counter, uint32_t * mi, Melody * melody)
+static void bypass(uint32_t counter, uint32_t * mi, const CompiledMelody * melody)
 {
-  buzzerOn(static_freq);
+  toneOn(static_freq);
 }
 
 static uint16_t siren_start = 2000;
 static uint16_t siren_freq = 2000;
 static uint16_t siren_stop = 4000;
 static int16_t siren_step = 40;
-static void siren(uint32_t counter, uint32_t * mi, Melody * melody)
+static void siren(uint32_t counter, uint32_t * mi, const CompiledMelody * melody)
 {
   siren_freq += siren_step;
   if (siren_freq > siren_stop) {
@@ -266,19 +363,21 @@ static void siren(uint32_t counter, uint32_t * mi, Melody * melody)
     siren_step *= -1;
     siren_freq = siren_start;
   }
-  buzzerOn(siren_freq);
+  toneOn(siren_freq);
 }
 
-static int pitchid;
+static int pitchid = -1;
 static int rollid;
 static int pitch;
 static int roll;
 static int tilt_freq;
 static int tilt_ratio;
-static void tilt(uint32_t counter, uint32_t * mi, Melody * melody)
+static void tilt(uint32_t counter, uint32_t * mi, const CompiledMelody * melody)
 {
-  pitchid = logGetVarId("stabilizer", "pitch");
-  rollid = logGetVarId("stabilizer", "roll");
+  if (pitchid < 0) {
+    pitchid = logGetVarId("stabilizer", "pitch");
+    rollid = logGetVarId("stabilizer", "roll");
+  }
 
   pitch = logGetInt(pitchid);
   roll = logGetInt(rollid);
@@ -289,28 +388,29 @@ static void tilt(uint32_t counter, uint32_t * mi, Melody * melody)
     tilt_freq = 3000 - 50 * pitch;
   }
 
-  buzzerOn(tilt_freq);
+  toneOn(tilt_freq);
 }
 
 typedef struct {
   BuzzerEffect call;
   uint32_t mi;
-  Melody * melody;
+  Melody * source;
+  CompiledMelody melody;
 } EffectCall;
 
 static EffectCall effects[] = {
     [SND_OFF] = {.call = &off},
-    [FACTORY_TEST] = {.call = &melodyplayer, .melody = &factory_test},
-    [SND_USB_CONN] = {.call = &melodyplayer, .melody = &usb_connect},
-    [SND_USB_DISC] = {.call = &melodyplayer, .melody = &usb_disconnect},
-    [SND_BAT_FULL] = {.call = &melodyplayer, .melody = &chg_done},
-    [SND_BAT_LOW] = {.call = &melodyplayer, .melody = &lowbatt},
-    [SND_STARTUP] = {.call = &melodyplayer, .melody = &startup},
-    [SND_CALIB] = {.call = &melodyplayer, .melody = &calibrated},
-    {.call = &melodyplayer, .melody = &range_slow},
-    {.call = &melodyplayer, .melody = &range_fast},
-    {.call = &melodyplayer, .melody = &starwars},
-    {.call = &melodyplayer, .melody = &valkyries},
+    [FACTORY_TEST] = {.call = &melodyplayer, .source = &factory_test},
+    [SND_USB_CONN] = {.call = &melodyplayer, .source = &usb_connect},
+    [SND_USB_DISC] = {.call = &melodyplayer, .source = &usb_disconnect},
+    [SND_BAT_FULL] = {.call = &melodyplayer, .source = &chg_done},
+    [SND_BAT_LOW] = {.call = &melodyplayer, .source = &lowbatt},
+    [SND_STARTUP] = {.call = &melodyplayer, .source = &startup},
+    [SND_CALIB] = {.call = &melodyplayer, .source = &calibrated},
+    {.call = &melodyplayer, .source = &range_slow},
+    {.call = &melodyplayer, .source = &range_fast},
+    {.call = &melodyplayer, .source = &starwars},
+    {.call = &melodyplayer, .source = &valkyries},
     {.call = &bypass},
     {.call = &siren},
     {.call = &tilt}
@@ -320,6 +420,31 @@ static xTimerHandle timer;
 static StaticTimer_t timerBuffer;
 static uint32_t counter = 0;
 
+static bool isQueuedPlaying = false;
+static uint8_t queuedSlot;
+static uint32_t queuedMi = 0;
+
+// Plays the queued melodies one after the other, returns false if there is none
+static bool playQueuedTick(void)
+{
+  if (!isQueuedPlaying) {
+    if (xQueueReceive(playQueue, &queuedSlot, 0) != pdTRUE) {
+      return false;
+    }
+    isQueuedPlaying = true;
+    queuedMi = 0;
+    mcounter = 0;
+  }
+
+  if (!playMelodyTick(&queuedMi, &queuedMelodies[queuedSlot])) {
+    // Queued melodies are played once
+    isQueuedPlaying = false;
+    xQueueSend(freeQueue, &queuedSlot, 0);
+  }
+
+  return true;
+}
+
 static void soundTimer(xTimerHandle timer)
 {
   int effect;
@@ -327,12 +452,14 @@ static void soundTimer(xTimerHandle timer)
 
   if (sys_effect != 0) {
     effect = sys_effect;
+  } else if (playQueuedTick()) {
+    return;
   } else {
     effect = user_effect;
   }
 
   if (effects[effect].call != 0) {
-    effects[effect].call(counter * 10, &effects[effect].mi, effects[effect].melody);
+    effects[effect].call(counter * SOUND_TICK_MS, &effects[effect].mi, &effects[effect].melody);
   }
 }
 
@@ -344,7 +471,23 @@ void soundInit(void)
 
   neffect = sizeof(effects) / sizeof(effects[0]) - 1;
 
-  timer = xTimerCreateStatic("SoundTimer", M2T(10), pdTRUE, NULL, soundTimer, &timerBuffer);
+  for (int i = 0; i <= neffect; i++) {
+    if (effects[i].source != 0) {
+      int length = compileMelody(effects[i].source->notes, effects[i].source->bpm,
+                                 &eventPool[eventPoolUsed], SOUND_EVENT_POOL_SIZE - eventPoolUsed,
+                                 &effects[i].melody);
+      ASSERT(length >= 0);
+      eventPoolUsed += length;
+    }
+  }
+
+  playQueue = STATIC_MEM_QUEUE_CREATE(soundPlayQueue);
+  freeQueue = STATIC_MEM_QUEUE_CREATE(soundFreeQueue);
+  for (uint8_t slot = 0; slot < SOUND_QUEUE_LENGTH; slot++) {
+    xQueueSend(freeQueue, &slot, 0);
+  }
+
+  timer = xTimerCreateStatic("SoundTimer", M2T(SOUND_TICK_MS), pdTRUE, NULL, soundTimer, &timerBuffer);
   xTimerStart(timer, 100);
 
   isInit = true;
@@ -364,6 +507,23 @@ void soundSetFreq(uint32_t freq) {
 
 }
 
+bool soundQueueMelody(const soundNote_t * notes, uint32_t bpm)
+{
+  uint8_t slot;
+
+  if (!isInit || xQueueReceive(freeQueue, &slot, 0) != pdTRUE) {
+    return false;
+  }
+
+  if (compileMelody(notes, bpm, queuedEvents[slot], SOUND_QUEUE_MAX_NOTES, &queuedMelodies[slot]) < 0) {
+    xQueueSend(freeQueue, &slot, 0);
+    return false;
+  }
+
+  xQueueSend(playQueue, &slot, 0);
+  return true;
+}
+
 PARAM_GROUP_START(sound)
 PARAM_ADD(PARAM_UINT8, effect, &user_effect)
 PARAM_ADD(PARAM_UINT32 | PARAM_RONLY, neffect, &neffect)
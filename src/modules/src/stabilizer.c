@@ -26,6 +26,7 @@
 #define DEBUG_MODULE "STAB"
 
 #include <math.h>
+#include <string.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -47,13 +48,20 @@
 #include "collision_avoidance.h"
 #include "health.h"
 #include "supervisor.h"
+#include "standby.h"
 
 #include "estimator.h"
 #include "usddeck.h"
-#include "quatcompress.h"
 #include "statsCnt.h"
 #include "static_mem.h"
 #include "rateSupervisor.h"
+#include "stageProfiler.h"
+#include "eventtrigger.h"
+#include "log_capture.h"
+#include "state_snapshot.h"
+#include "vibration.h"
+#include "app_hook.h"
+#include "stm32f4xx.h"
 
 static bool isInit;
 static bool emergencyStop = false;
@@ -71,46 +79,175 @@ static control_t control;
 
 static StateEstimatorType estimatorType;
 static ControllerType controllerType;
+// Set by the param callbacks, the switch is done in the stabilizer loop
+static bool estimatorTypeChanged = false;
+#ifndef CONTROLLER_STATIC_UPDATE
+static bool controllerTypeChanged = false;
+#endif
 
 static STATS_CNT_RATE_DEFINE(stabilizerRate, 500);
 static rateSupervisor_t rateSupervisorContext;
+// Allowed deviation of the loop rate [1/1000]
+#define STABILIZER_RATE_TOLERANCE 3
 static bool rateWarningDisplayed = false;
 
-static struct {
-  // position - mm
-  int16_t x;
-  int16_t y;
-  int16_t z;
-  // velocity - mm / sec
-  int16_t vx;
-  int16_t vy;
-  int16_t vz;
-  // acceleration - mm / sec^2
-  int16_t ax;
-  int16_t ay;
-  int16_t az;
-  // compressed quaternion, see quatcompress.h
-  int32_t quat;
-  // angular velocity - milliradians / sec
-  int16_t rateRoll;
-  int16_t ratePitch;
-  int16_t rateYaw;
-} stateCompressed;
-
-static struct {
-  // position - mm
-  int16_t x;
-  int16_t y;
-  int16_t z;
-  // velocity - mm / sec
-  int16_t vx;
-  int16_t vy;
-  int16_t vz;
-  // acceleration - mm / sec^2
-  int16_t ax;
-  int16_t ay;
-  int16_t az;
-} setpointCompressed;
+/**
+ * Profiling of the stages of the stabilizer loop, using the DWT cycle counter.
+ * The statistics are published once per second to the prof* log groups.
+ * The histogram bins of a stage double from PROFILER_BIN_WIDTH_US, which puts
+ * the edges of the top bins at 512 us and at the 1 ms period of the loop.
+ */
+#define PROFILER_BIN_WIDTH_US 64
+#define PROFILER_WINDOW_SIZE RATE_MAIN_LOOP
+typedef enum {
+  stageSensors,
+  stageEstimator,
+  stageCommander,
+  stageCollisionAvoidance,
+  stageController,
+  stagePowerDistribution,
+  stageAppHooks,
+  stageUsdLogging,
+  stageLoop,
+  stageCount,
+} stabilizerStage_t;
+#define TRACE_MARKER_STABILIZER_LOOP_START 0xff
+static stageProfiler_t stageProfilers[stageCount];
+static uint32_t stageStart;
+// Cycles of each stage in the current loop
+static uint32_t stageCycles[stageCount];
+
+/**
+ * Deadline supervision. A loop that takes longer than the budget (1 ms) is an
+ * overrun, and it is attributed to the stage that took the longest time in that
+ * loop. On an overrun, the actions set in degradePolicy are applied for
+ * DEGRADE_HOLD_LOOPS loops to shed load and keep the loop on time:
+ * - DEGRADE_SKIP_COMPRESS skips the compression of state and setpoint for logging
+ * - DEGRADE_DECIMATE_COLLISION_AVOIDANCE runs collision avoidance every other loop, the
+ *   loops in between reuse the setpoint of the previous loop
+ * - DEGRADE_SKIP_USD_LOGGING skips the synchronous uSD log trigger
+ */
+#define DEGRADE_SKIP_COMPRESS (1 << 0)
+#define DEGRADE_DECIMATE_COLLISION_AVOIDANCE (1 << 1)
+#define DEGRADE_SKIP_USD_LOGGING (1 << 2)
+#define DEGRADE_HOLD_LOOPS RATE_MAIN_LOOP
+static uint8_t degradePolicy = DEGRADE_SKIP_COMPRESS | DEGRADE_DECIMATE_COLLISION_AVOIDANCE | DEGRADE_SKIP_USD_LOGGING;
+static uint32_t stageOverruns[stageCount];
+static setpoint_t avoidedSetpoint;
+static uint32_t degradeUntilTick;
+static uint32_t degradeCount;
+static bool isDegraded;
+
+/**
+ * Per tick load of the sub-rate stages. The budgets are the declared worst case
+ * times of the stages, in us, and can be checked against the prof* logs. The sum
+ * of the stages that run on the same tick must fit in the sub-rate budget of a
+ * tick, for all ticks of the schedule (20 ticks is the least common multiple of
+ * the stage periods). The uSD log trigger only gives a semaphore and is left out.
+ */
+#define SUBRATE_BUDGET_US 300
+#define ATTITUDE_STAGE_US 150
+#define POSITION_STAGE_US 150
+#ifdef COMPLEMENTARY_FAST_ATTITUDE
+#define COMPLEMENTARY_ATTITUDE_STAGE_US 20
+#else
+#define COMPLEMENTARY_ATTITUDE_STAGE_US 60
+#endif
+#define COMPLEMENTARY_POSITION_STAGE_US 40
+#define SUBRATE_LOAD_US(TICK) ( \
+  RATE_DO_EXECUTE_WITH_PHASE(ATTITUDE_RATE, ATTITUDE_PHASE, TICK) * ATTITUDE_STAGE_US + \
+  RATE_DO_EXECUTE_WITH_PHASE(POSITION_RATE, POSITION_PHASE, TICK) * POSITION_STAGE_US + \
+  RATE_DO_EXECUTE_WITH_PHASE(COMPLEMENTARY_ATTITUDE_RATE, COMPLEMENTARY_ATTITUDE_PHASE, TICK) * COMPLEMENTARY_ATTITUDE_STAGE_US + \
+  RATE_DO_EXECUTE_WITH_PHASE(COMPLEMENTARY_POSITION_RATE, COMPLEMENTARY_POSITION_PHASE, TICK) * COMPLEMENTARY_POSITION_STAGE_US)
+#define SUBRATE_LOAD_CHECK(TICK) \
+  _Static_assert(SUBRATE_LOAD_US(TICK) <= SUBRATE_BUDGET_US, "Sub-rate stages exceed the tick budget on tick " #TICK)
+SUBRATE_LOAD_CHECK(0);  SUBRATE_LOAD_CHECK(1);  SUBRATE_LOAD_CHECK(2);  SUBRATE_LOAD_CHECK(3);
+SUBRATE_LOAD_CHECK(4);  SUBRATE_LOAD_CHECK(5);  SUBRATE_LOAD_CHECK(6);  SUBRATE_LOAD_CHECK(7);
+SUBRATE_LOAD_CHECK(8);  SUBRATE_LOAD_CHECK(9);  SUBRATE_LOAD_CHECK(10); SUBRATE_LOAD_CHECK(11);
+SUBRATE_LOAD_CHECK(12); SUBRATE_LOAD_CHECK(13); SUBRATE_LOAD_CHECK(14); SUBRATE_LOAD_CHECK(15);
+SUBRATE_LOAD_CHECK(16); SUBRATE_LOAD_CHECK(17); SUBRATE_LOAD_CHECK(18); SUBRATE_LOAD_CHECK(19);
+
+/**
+ * Worst case execution time annotations of the stages, in us, 0 for a stage
+ * without annotation. A stage that takes longer than its annotation is counted
+ * in the wcet log group, which checks the annotations against the DWT
+ * measurements in flight. The controller stage runs the sub-rate controllers
+ * and is bounded by the sub-rate budget above. The annotations can be tuned
+ * with the wcet parameters.
+ */
+static uint16_t stageWcetUs[stageLoop] = {
+  [stageController] = SUBRATE_BUDGET_US,
+};
+// Number of times each stage exceeded its annotation, the total in stageLoop
+static uint32_t stageWcetExceeded[stageCount];
+static uint32_t cyclesPerUs;
+
+EVENTTRIGGER(stabOverrun, uint8, stage, uint32, cycles)
+
+/**
+ * Triggered once per profiler window, when the statistics of the stages have been published. The events have no
+ * payload, they are used to log the performance counters once per window, see tools/usdlog/config_perf.txt. The
+ * log variables of an event are limited, the counters are split over two events.
+ */
+EVENTTRIGGER(perfStage)
+EVENTTRIGGER(perfSys)
+
+static void profilerInit() {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  cyclesPerUs = SystemCoreClock / 1000000;
+
+  for (int i = 0; i < stageCount; i++) {
+    stageProfilerInit(&stageProfilers[i], PROFILER_BIN_WIDTH_US * cyclesPerUs, PROFILER_WINDOW_SIZE);
+  }
+}
+
+// Ends the current stage and starts the next one. The end of each stage is also marked in the ITM trace.
+static inline void profilerStageDone(const stabilizerStage_t stage) {
+  TRACE_MARKER(TRACE_MARKER_GROUP_STABILIZER, stage);
+  const uint32_t now = DWT->CYCCNT;
+  stageCycles[stage] = now - stageStart;
+  stageProfilerAdd(&stageProfilers[stage], stageCycles[stage]);
+  if (stageWcetUs[stage] && stageCycles[stage] > stageWcetUs[stage] * cyclesPerUs) {
+    stageWcetExceeded[stage]++;
+    stageWcetExceeded[stageLoop]++;
+  }
+  stageStart = now;
+}
+
+static void checkDeadline(const uint32_t loopCycles, const uint32_t tick) {
+  if (loopCycles <= SystemCoreClock / RATE_MAIN_LOOP) {
+    isDegraded = (tick < degradeUntilTick);
+    return;
+  }
+
+  stabilizerStage_t slowest = stageSensors;
+  for (int i = 0; i < stageLoop; i++) {
+    if (stageCycles[i] > stageCycles[slowest]) {
+      slowest = i;
+    }
+  }
+  stageOverruns[slowest]++;
+  stageOverruns[stageLoop]++;
+
+  if (!isDegraded) {
+    degradeCount++;
+  }
+  isDegraded = true;
+  degradeUntilTick = tick + DEGRADE_HOLD_LOOPS;
+
+  eventTrigger_stabOverrun_payload.stage = slowest;
+  eventTrigger_stabOverrun_payload.cycles = loopCycles;
+  eventTrigger(&eventTrigger_stabOverrun);
+}
+
+static inline bool shallDegrade(const uint8_t action) {
+  return isDegraded && (degradePolicy & action);
+}
+
+static stateCompressed_t stateCompressed;
+static setpointCompressed_t setpointCompressed;
 
 STATIC_MEM_TASK_ALLOC(stabilizerTask, STABILIZER_TASK_STACKSIZE);
 
@@ -136,12 +273,8 @@ static void compressState()
   stateCompressed.ay = state.acc.y * 9.81f * 1000.0f;
   stateCompressed.az = (state.acc.z + 1) * 9.81f * 1000.0f;
 
-  float const q[4] = {
-    state.attitudeQuaternion.x,
-    state.attitudeQuaternion.y,
-    state.attitudeQuaternion.z,
-    state.attitudeQuaternion.w};
-  stateCompressed.quat = quatcompress(q);
+  // compressed once per estimator update by the estimator
+  stateCompressed.quat = state.attitudeQuaternionCompressed;
 
   float const deg2millirad = ((float)M_PI * 1000.0f) / 180.0f;
   stateCompressed.rateRoll = sensorData.gyro.x * deg2millirad;
@@ -174,6 +307,9 @@ void stabilizerInit(StateEstimatorType estimator)
   controllerInit(ControllerTypeAny);
   powerDistributionInit();
   collisionAvoidanceInit();
+  logCaptureInit();
+  stateSnapshotInit();
+  vibrationInit();
   estimatorType = getStateEstimator();
   controllerType = getControllerType();
 
@@ -191,6 +327,9 @@ bool stabilizerTest(void)
   pass &= controllerTest();
   pass &= powerDistributionTest();
   pass &= collisionAvoidanceTest();
+  pass &= logCaptureTest();
+  pass &= stateSnapshotTest();
+  pass &= vibrationTest();
 
   return pass;
 }
@@ -230,40 +369,78 @@ static void stabilizerTask(void* param)
   // Initialize tick to something else then 0
   tick = 1;
 
-  rateSupervisorInit(&rateSupervisorContext, xTaskGetTickCount(), M2T(1000), 997, 1003, 1);
+  rateSupervisorInitRate(&rateSupervisorContext, xTaskGetTickCount(), RATE_MAIN_LOOP, STABILIZER_RATE_TOLERANCE, 1);
+  rateSupervisorRegister(&rateSupervisorContext, "stabilizer");
+  profilerInit();
 
   DEBUG_PRINT("Ready to fly.\n");
 
   while(1) {
     // The sensor should unlock at 1kHz
     sensorsWaitDataReady();
-    
+    const uint32_t loopStart = DWT->CYCCNT;
+    TRACE_MARKER(TRACE_MARKER_GROUP_STABILIZER, TRACE_MARKER_STABILIZER_LOOP_START);
+    stageStart = loopStart;
+    memset(stageCycles, 0, sizeof(stageCycles));
+
     // update sensorData struct (for logging variables)
     sensorsAcquire(&sensorData, tick);
+    vibrationAddSample(&sensorData);
+    profilerStageDone(stageSensors);
 
     if (healthShallWeRunTest()) {
       healthRunTests(&sensorData);
+      motorsBurstDshot();
     } else {
+      // Landed and idle, the controller only runs at a reduced rate. The
+      // estimator and the logging keep running on their own phases.
+      const bool runControl = standbyShallRunLoop(tick);
+
       // allow to update estimator dynamically
-      if (getStateEstimator() != estimatorType) {
-        stateEstimatorSwitchTo(estimatorType);
+      if (estimatorTypeChanged) {
+        estimatorTypeChanged = false;
+        if (getStateEstimator() != estimatorType) {
+          stateEstimatorSwitchTo(estimatorType);
+        }
         estimatorType = getStateEstimator();
       }
+#ifndef CONTROLLER_STATIC_UPDATE
       // allow to update controller dynamically
-      if (getControllerType() != controllerType) {
-        controllerInit(controllerType);
+      if (controllerTypeChanged) {
+        controllerTypeChanged = false;
+        if (getControllerType() != controllerType) {
+          controllerInit(controllerType);
+        }
         controllerType = getControllerType();
       }
+#endif
 
+      stageStart = DWT->CYCCNT;
       stateEstimator(&state, tick);
-      compressState();
+      if (!shallDegrade(DEGRADE_SKIP_COMPRESS)) {
+        compressState();
+      }
+      profilerStageDone(stageEstimator);
 
       commanderGetSetpoint(&setpoint, &state);
-      compressSetpoint();
-
-      collisionAvoidanceUpdateSetpoint(&setpoint, &sensorData, &state, tick);
-
-      controller(&control, &setpoint, &sensorData, &state, tick);
+      if (!shallDegrade(DEGRADE_SKIP_COMPRESS)) {
+        compressSetpoint();
+      }
+      profilerStageDone(stageCommander);
+
+      if (runControl) {
+        if (!shallDegrade(DEGRADE_DECIMATE_COLLISION_AVOIDANCE) || (tick % 2) == 0) {
+          collisionAvoidanceUpdateSetpoint(&setpoint, &sensorData, &state, tick);
+          avoidedSetpoint = setpoint;
+        } else {
+          // Reuse the setpoint from the previous loop, it has passed collision avoidance
+          setpoint = avoidedSetpoint;
+        }
+        profilerStageDone(stageCollisionAvoidance);
+
+        controller(&control, &setpoint, &sensorData, &state, tick);
+        profilerStageDone(stageController);
+      }
 
       checkEmergencyStopTimeout();
 
@@ -274,24 +451,46 @@ static void stabilizerTask(void* param)
       supervisorUpdate(&sensorData);
 
       checkStops = systemIsArmed();
-      if (emergencyStop || (systemIsArmed() == false)) {
+      stageStart = DWT->CYCCNT;
+      if (!runControl || emergencyStop || (systemIsArmed() == false)) {
+        // In standby the motors are kept stopped between the reduced rate loops
         powerStop();
       } else {
         powerDistribution(&control);
       }
+      motorsBurstDshot();
+      profilerStageDone(stagePowerDistribution);
+
+      // Run the app hooks after the motors are updated, to not delay the output
+      appHookRun(&state, &sensorData, tick);
+      profilerStageDone(stageAppHooks);
 
       // Log data to uSD card if configured
       if (   usddeckLoggingEnabled()
           && usddeckLoggingMode() == usddeckLoggingMode_SynchronousStabilizer
-          && RATE_DO_EXECUTE(usddeckFrequency(), tick)) {
+          && RATE_DO_EXECUTE_WITH_PHASE(usddeckFrequency(), USD_LOGGING_PHASE, tick)
+          && !shallDegrade(DEGRADE_SKIP_USD_LOGGING)) {
         usddeckTriggerLogging();
       }
+      profilerStageDone(stageUsdLogging);
+
+      // Run the log blocks that are started in phase with the stabilizer loop
+      logHighRateTrigger(tick);
+      logCaptureSample(tick);
+      stateSnapshotUpdate(&state, &setpoint, &stateCompressed, &setpointCompressed, tick);
     }
     calcSensorToOutputLatency(&sensorData);
+    const uint32_t loopCycles = DWT->CYCCNT - loopStart;
+    stageProfilerAdd(&stageProfilers[stageLoop], loopCycles);
+    if (stageProfilers[stageLoop].count == 0) {
+      eventTrigger(&eventTrigger_perfStage);
+      eventTrigger(&eventTrigger_perfSys);
+    }
+    checkDeadline(loopCycles, tick);
     tick++;
     STATS_CNT_RATE_EVENT(&stabilizerRate);
 
-    if (!rateSupervisorValidate(&rateSupervisorContext, xTaskGetTickCount())) {
+    if (!rateSupervisorTick(&rateSupervisorContext, xTaskGetTickCount(), (uint32_t)usecTimestamp())) {
       if (!rateWarningDisplayed) {
         DEBUG_PRINT("WARNING: stabilizer loop rate is off (%lu)\n", rateSupervisorLatestCount(&rateSupervisorContext));
         rateWarningDisplayed = true;
@@ -316,12 +515,44 @@ void stabilizerSetEmergencyStopTimeout(int timeout)
   emergencyStopTimeout = timeout;
 }
 
+static void estimatorTypeChangedCallback(void)
+{
+  estimatorTypeChanged = true;
+}
+
+#ifndef CONTROLLER_STATIC_UPDATE
+static void controllerTypeChangedCallback(void)
+{
+  controllerTypeChanged = true;
+}
+#endif
+
 PARAM_GROUP_START(stabilizer)
-PARAM_ADD(PARAM_UINT8, estimator, &estimatorType)
-PARAM_ADD(PARAM_UINT8, controller, &controllerType)
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, estimator, &estimatorType, estimatorTypeChangedCallback)
+#ifdef CONTROLLER_STATIC_UPDATE
+PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, controller, &controllerType)
+#else
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, controller, &controllerType, controllerTypeChangedCallback)
+#endif
 PARAM_ADD(PARAM_UINT8, stop, &emergencyStop)
+PARAM_ADD(PARAM_UINT8, degrade, &degradePolicy)
 PARAM_GROUP_STOP(stabilizer)
 
+/**
+ * Worst case execution time annotations of the stages of the stabilizer
+ * loop, in us, 0 disables the check of a stage. See the wcet log group.
+ */
+PARAM_GROUP_START(wcet)
+PARAM_ADD(PARAM_UINT16, sens, &stageWcetUs[stageSensors])
+PARAM_ADD(PARAM_UINT16, est, &stageWcetUs[stageEstimator])
+PARAM_ADD(PARAM_UINT16, cmd, &stageWcetUs[stageCommander])
+PARAM_ADD(PARAM_UINT16, colAv, &stageWcetUs[stageCollisionAvoidance])
+PARAM_ADD(PARAM_UINT16, ctrl, &stageWcetUs[stageController])
+PARAM_ADD(PARAM_UINT16, pwr, &stageWcetUs[stagePowerDistribution])
+PARAM_ADD(PARAM_UINT16, app, &stageWcetUs[stageAppHooks])
+PARAM_ADD(PARAM_UINT16, usd, &stageWcetUs[stageUsdLogging])
+PARAM_GROUP_STOP(wcet)
+
 LOG_GROUP_START(ctrltarget)
 LOG_ADD(LOG_FLOAT, x, &setpoint.position.x)
 LOG_ADD(LOG_FLOAT, y, &setpoint.position.y)
@@ -450,3 +681,85 @@ LOG_ADD(LOG_INT16, rateRoll, &stateCompressed.rateRoll)   // angular velocity -
 LOG_ADD(LOG_INT16, ratePitch, &stateCompressed.ratePitch)
 LOG_ADD(LOG_INT16, rateYaw, &stateCompressed.rateYaw)
 LOG_GROUP_STOP(stateEstimateZ)
+
+/**
+ * Execution time of the stages of the stabilizer loop, in cycles of the core
+ * clock. min, max and mean are over the latest second, h0 to h5 is a
+ * histogram where h0 counts the runs below 64 us and the bin widths double
+ * from there, h5 counts the runs of 1024 us and longer.
+ */
+LOG_GROUP_START(profSens)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageSensors])
+LOG_GROUP_STOP(profSens)
+
+LOG_GROUP_START(profEst)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageEstimator])
+LOG_GROUP_STOP(profEst)
+
+LOG_GROUP_START(profCmd)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageCommander])
+LOG_GROUP_STOP(profCmd)
+
+LOG_GROUP_START(profColAv)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageCollisionAvoidance])
+LOG_GROUP_STOP(profColAv)
+
+LOG_GROUP_START(profCtrl)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageController])
+LOG_GROUP_STOP(profCtrl)
+
+LOG_GROUP_START(profPwr)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stagePowerDistribution])
+LOG_GROUP_STOP(profPwr)
+
+LOG_GROUP_START(profApp)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageAppHooks])
+LOG_GROUP_STOP(profApp)
+
+LOG_GROUP_START(profUsd)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageUsdLogging])
+LOG_GROUP_STOP(profUsd)
+
+LOG_GROUP_START(profLoop)
+STAGE_PROFILER_LOG_ADD(&stageProfilers[stageLoop])
+LOG_GROUP_STOP(profLoop)
+
+/**
+ * Overruns of the 1 ms loop budget, attributed to the slowest stage of the
+ * loop. loop is the total number of overruns, degradeCnt the number of times
+ * the degrade mode was entered and degraded is set while in degrade mode.
+ */
+LOG_GROUP_START(overrun)
+LOG_ADD(LOG_UINT32, sens, &stageOverruns[stageSensors])
+LOG_ADD(LOG_UINT32, est, &stageOverruns[stageEstimator])
+LOG_ADD(LOG_UINT32, cmd, &stageOverruns[stageCommander])
+LOG_ADD(LOG_UINT32, colAv, &stageOverruns[stageCollisionAvoidance])
+LOG_ADD(LOG_UINT32, ctrl, &stageOverruns[stageController])
+LOG_ADD(LOG_UINT32, pwr, &stageOverruns[stagePowerDistribution])
+LOG_ADD(LOG_UINT32, app, &stageOverruns[stageAppHooks])
+LOG_ADD(LOG_UINT32, usd, &stageOverruns[stageUsdLogging])
+LOG_ADD(LOG_UINT32, loop, &stageOverruns[stageLoop])
+LOG_ADD(LOG_UINT32, degradeCnt, &degradeCount)
+LOG_ADD(LOG_UINT8, degraded, &isDegraded)
+LOG_GROUP_STOP(overrun)
+
+/**
+ * Number of times a stage took longer than its worst case execution time
+ * annotation (the wcet parameters), total is the sum of all stages.
+ */
+LOG_GROUP_START(wcet)
+LOG_ADD(LOG_UINT32, sens, &stageWcetExceeded[stageSensors])
+LOG_ADD(LOG_UINT32, est, &stageWcetExceeded[stageEstimator])
+LOG_ADD(LOG_UINT32, cmd, &stageWcetExceeded[stageCommander])
+LOG_ADD(LOG_UINT32, colAv, &stageWcetExceeded[stageCollisionAvoidance])
+LOG_ADD(LOG_UINT32, ctrl, &stageWcetExceeded[stageController])
+LOG_ADD(LOG_UINT32, pwr, &stageWcetExceeded[stagePowerDistribution])
+LOG_ADD(LOG_UINT32, app, &stageWcetExceeded[stageAppHooks])
+LOG_ADD(LOG_UINT32, usd, &stageWcetExceeded[stageUsdLogging])
+LOG_ADD(LOG_UINT32, total, &stageWcetExceeded[stageLoop])
+LOG_GROUP_STOP(wcet)
+
+/**
+ * Rate of the stabilizer loop, see MEM_TYPE_RATE_HEALTH
+ */
+RATE_SUPERVISOR_LOG_GROUP(rateStab, rateSupervisorContext)
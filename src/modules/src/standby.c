@@ -0,0 +1,113 @@
+/*
+*    ||          ____  _ __
+* +------+      / __ )(_) /_______________ _____  ___
+* | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+* +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+*  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+*
+* Crazyflie control firmware
+*
+* Copyright (C) 2021 Bitcraze AB
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, in version 3.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*
+* standby.c - Reduced rate stabilizer loop while landed
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "log.h"
+#include "param.h"
+#include "commander.h"
+#include "crtp_commander_high_level.h"
+#include "supervisor.h"
+#include "standby.h"
+
+static uint8_t enable = 1;
+// Time the Crazyflie must be idle before entering standby
+static uint16_t enterDelayMs = 5000;
+// The controller runs for every divider sample in standby, 10 gives 100 Hz
+static uint8_t divider = 10;
+
+static bool isActive;
+static TickType_t idleSince;
+static uint32_t wakeUpCount;
+
+static bool isIdle(void)
+{
+  return enable
+      && !supervisorIsFlying()
+      && commanderGetActivePriority() == COMMANDER_PRIORITY_DISABLE
+      && crtpCommanderHighLevelIsStopped();
+}
+
+bool standbyShallRunLoop(const uint32_t tick)
+{
+  const TickType_t now = xTaskGetTickCount();
+
+  if (!isIdle()) {
+    idleSince = now;
+    if (isActive) {
+      isActive = false;
+      wakeUpCount++;
+    }
+    return true;
+  }
+
+  if (!isActive) {
+    isActive = (now - idleSince) >= M2T(enterDelayMs);
+  }
+
+  return !isActive || divider <= 1 || (tick % divider) == 0;
+}
+
+bool standbyIsActive(void)
+{
+  return isActive;
+}
+
+/**
+ * While the Crazyflie is landed and no setpoints or high level commands have
+ * been received for a while, the stabilizer loop only runs the controller at a
+ * reduced rate, to save power while parked. The estimator and the logging run
+ * at their normal rates.
+ */
+PARAM_GROUP_START(standby)
+/**
+ * @brief Nonzero to enter standby when idle (default: 1)
+ */
+PARAM_ADD(PARAM_UINT8, enable, &enable)
+/**
+ * @brief Time landed and idle before entering standby [ms] (default: 5000)
+ */
+PARAM_ADD(PARAM_UINT16, delay, &enterDelayMs)
+/**
+ * @brief The controller runs for one of this many sensor samples in standby (default: 10)
+ */
+PARAM_ADD(PARAM_UINT8, divider, &divider)
+PARAM_GROUP_STOP(standby)
+
+LOG_GROUP_START(standby)
+/**
+ * @brief Nonzero when the stabilizer loop runs at the reduced rate
+ */
+LOG_ADD(LOG_UINT8, active, &isActive)
+/**
+ * @brief Number of times standby has been left
+ */
+LOG_ADD(LOG_UINT32, wakeUps, &wakeUpCount)
+LOG_GROUP_STOP(standby)
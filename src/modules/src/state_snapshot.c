@@ -0,0 +1,185 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * state_snapshot.c - Full state snapshot readable through the memory subsystem
+ *
+ * The stabilizer updates a stateSnapshot_t once per loop. It is read through
+ * the memory subsystem (MEM_TYPE_STATE_SNAPSHOT) without any log block or
+ * TOC download. A read from address 0 latches a consistent copy of the
+ * snapshot, the following reads of the same snapshot are served from the
+ * copy, so a snapshot that is read in several packets is from one loop.
+ *
+ * The snapshot is written with a seqlock: the sequence is odd while it is
+ * updated, a reader retries if the sequence changed during the copy.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "state_snapshot.h"
+#include "mem.h"
+#include "log.h"
+#include "pm.h"
+#include "supervisor.h"
+#include "system.h"
+#include "usec_time.h"
+
+#define STATE_SNAPSHOT_LINK_RATE_HZ 10
+#define STATE_SNAPSHOT_READ_RETRIES 4
+
+static bool isInit = false;
+static stateSnapshot_t snapshot;
+static stateSnapshot_t latched;
+
+static logVarId_t rssiId;
+static logVarId_t isConnectedId;
+static logVarId_t rxRateId;
+static logVarId_t txRateId;
+
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_STATE_SNAPSHOT,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+void stateSnapshotInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  snapshot.version = STATE_SNAPSHOT_VERSION;
+  snapshot.size = sizeof(stateSnapshot_t);
+
+  rssiId = logGetVarId("radio", "rssi");
+  isConnectedId = logGetVarId("radio", "isConnected");
+  rxRateId = logGetVarId("radioStats", "rxRate");
+  txRateId = logGetVarId("radioStats", "txRate");
+
+  memoryRegisterHandler(&memDef);
+
+  isInit = true;
+}
+
+bool stateSnapshotTest(void)
+{
+  return isInit;
+}
+
+static uint32_t readFlags(void)
+{
+  uint32_t flags = 0;
+
+  flags |= supervisorCanFly() ? stateSnapshotCanFly : 0;
+  flags |= supervisorIsFlying() ? stateSnapshotIsFlying : 0;
+  flags |= supervisorIsTumbled() ? stateSnapshotIsTumbled : 0;
+  flags |= systemIsArmed() ? stateSnapshotArmed : 0;
+  flags |= pmIsBatteryLow() ? stateSnapshotBatteryLow : 0;
+  flags |= pmIsCharging() ? stateSnapshotCharging : 0;
+
+  return flags;
+}
+
+void stateSnapshotUpdate(const state_t* state, const setpoint_t* setpoint,
+                         const stateCompressed_t* stateCompressed,
+                         const setpointCompressed_t* setpointCompressed, uint32_t tick)
+{
+  // Gathered before the sequence is incremented to keep the update short,
+  // the battery and the link do not change much between loops
+  uint32_t flags = (snapshot.flags & stateSnapshotConnected) | readFlags();
+  const bool updateLink = RATE_DO_EXECUTE(STATE_SNAPSHOT_LINK_RATE_HZ, tick);
+  float batteryVoltage = snapshot.batteryVoltage;
+  uint16_t rxRate = snapshot.rxRate;
+  uint16_t txRate = snapshot.txRate;
+  uint8_t rssi = snapshot.rssi;
+  if (updateLink) {
+    batteryVoltage = pmGetBatteryVoltage();
+    rxRate = logGetFloat(rxRateId);
+    txRate = logGetFloat(txRateId);
+    rssi = logGetUint(rssiId);
+    flags &= ~stateSnapshotConnected;
+    flags |= logGetUint(isConnectedId) ? stateSnapshotConnected : 0;
+  }
+
+  snapshot.sequence++;
+  __DMB();
+
+  snapshot.tick = tick;
+  snapshot.timestamp = (uint32_t)usecTimestamp();
+  snapshot.state = *state;
+  snapshot.setpoint = *setpoint;
+  snapshot.stateCompressed = *stateCompressed;
+  snapshot.setpointCompressed = *setpointCompressed;
+  snapshot.batteryVoltage = batteryVoltage;
+  snapshot.flags = flags;
+  snapshot.rxRate = rxRate;
+  snapshot.txRate = txRate;
+  snapshot.rssi = rssi;
+
+  __DMB();
+  snapshot.sequence++;
+}
+
+// The stabilizer has a higher priority than the readers, a copy is only
+// torn if the stabilizer runs in the middle of it
+bool stateSnapshotRead(stateSnapshot_t* copy)
+{
+  for (int i = 0; i < STATE_SNAPSHOT_READ_RETRIES; i++) {
+    const uint32_t sequence = snapshot.sequence;
+    if (sequence & 1) {
+      continue;
+    }
+    __DMB();
+
+    memcpy(copy, &snapshot, sizeof(stateSnapshot_t));
+
+    __DMB();
+    if (snapshot.sequence == sequence) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static uint32_t handleMemGetSize(void)
+{
+  return sizeof(stateSnapshot_t);
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest)
+{
+  if (memAddr > sizeof(latched) || readLen > sizeof(latched) - memAddr) {
+    return false;
+  }
+
+  if (memAddr == 0 && !stateSnapshotRead(&latched)) {
+    return false;
+  }
+
+  memcpy(dest, (const uint8_t*)&latched + memAddr, readLen);
+  return true;
+}
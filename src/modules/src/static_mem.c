@@ -1,12 +1,14 @@
 /**
- * ,---------,       ____  _ __
- * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
- * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
- * | / ,--'  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
- *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
  *
  * Crazyflie control firmware
  *
+ * Copyright (C) 2021 Bitcraze AB
+ *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation, in version 3.
@@ -19,47 +21,131 @@
  * You should have received a copy of the GNU General Public License
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  *
- * @file static_mem.c
- * @brief Support for OS objects that use static memory, such as
- * queues, tasks and semaphores
- *
- * @copyright Copyright (c) 2019 Bitcraze AB
+ * static_mem.c - Reporting of the memory allocated by the static_mem.h macros
  */
+#include <string.h>
 
-#include <FreeRTOS.h>
+#include "FreeRTOS.h"
 #include "static_mem.h"
+#include "mem.h"
 
-/**
- * @brief configSUPPORT_STATIC_ALLOCATION is set to 1, so the application must provide an
- * implementation of vApplicationGetIdleTaskMemory() to provide the memory that is
- * used by the Idle task.
- */
-void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer,
-                                    StackType_t **ppxIdleTaskStackBuffer,
-                                    uint32_t *pulIdleTaskStackSize )
+#define STATIC_MEM_REPORT_VERSION 1
+#define STATIC_MEM_NAME_LENGTH 20
+
+#define CCM_START 0x10000000
+#define CCM_END   0x10010000
+
+// FreeRTOS fills the task stacks with this value when they are created
+#define STACK_FILL_BYTE 0xa5
+
+typedef enum {
+  staticMemRegionRam = 0,
+  staticMemRegionCcm = 1,
+} staticMemRegion_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t entrySize;
+  uint16_t entryCount;
+} __attribute__((packed)) staticMemReportHeader_t;
+
+typedef struct {
+  char name[STATIC_MEM_NAME_LENGTH];
+  uint32_t size;
+  uint32_t used; // peak usage for task stacks, the size otherwise
+  uint8_t kind;
+  uint8_t region;
+  uint8_t reserved[2];
+} __attribute__((packed)) staticMemReportEntry_t;
+
+extern const staticMemEntry_t _staticMem_start;
+extern const staticMemEntry_t _staticMem_stop;
+
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_STATIC_MEM,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
+void staticMemInit(void)
 {
-  NO_DMA_CCM_SAFE_ZERO_INIT static StaticTask_t xIdleTaskTCB;
-  NO_DMA_CCM_SAFE_ZERO_INIT static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+  memoryRegisterHandler(&memDef);
+}
 
-  *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
-  *ppxIdleTaskStackBuffer = uxIdleTaskStack;
-  *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+static int entryCount(void)
+{
+  return &_staticMem_stop - &_staticMem_start;
 }
-/*———————————————————–*/
 
-/**
- * @brief configSUPPORT_STATIC_ALLOCATION and configUSE_TIMERS are both set to 1, so the
- * application must provide an implementation of vApplicationGetTimerTaskMemory()
- * to provide the memory that is used by the Timer service task.
- */
-void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer,
-                                     StackType_t **ppxTimerTaskStackBuffer,
-                                     uint32_t *pulTimerTaskStackSize )
+// The stack grows downwards, the bytes at the bottom of the stack that still
+// hold the fill value have never been used
+static uint32_t stackUsed(const staticMemEntry_t* entry)
 {
-  NO_DMA_CCM_SAFE_ZERO_INIT static StaticTask_t xTimerTaskTCB;
-  NO_DMA_CCM_SAFE_ZERO_INIT static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+  const uint8_t* stack = entry->address;
+  uint32_t unused = 0;
+  while (unused < entry->size && stack[unused] == STACK_FILL_BYTE) {
+    unused++;
+  }
+
+  return entry->size - unused;
+}
+
+static void fillReportEntry(const staticMemEntry_t* entry, staticMemReportEntry_t* report)
+{
+  memset(report, 0, sizeof(staticMemReportEntry_t));
+  strncpy(report->name, entry->name, sizeof(report->name));
+  report->size = entry->size;
+  report->kind = entry->kind;
+
+  const uint32_t address = (uint32_t)entry->address;
+  report->region = (address >= CCM_START && address < CCM_END) ? staticMemRegionCcm : staticMemRegionRam;
+
+  if (entry->kind == staticMemKindTaskStack) {
+    report->used = stackUsed(entry);
+  } else {
+    report->used = entry->size;
+  }
+}
+
+static uint32_t handleMemGetSize(void)
+{
+  return sizeof(staticMemReportHeader_t) + entryCount() * sizeof(staticMemReportEntry_t);
+}
+
+// The report is built one entry at a time as it is read
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest)
+{
+  const uint32_t size = handleMemGetSize();
+  if (memAddr > size || readLen > size - memAddr) {
+    return false;
+  }
+
+  const staticMemReportHeader_t header = {
+    .version = STATIC_MEM_REPORT_VERSION,
+    .entrySize = sizeof(staticMemReportEntry_t),
+    .entryCount = entryCount(),
+  };
+
+  staticMemReportEntry_t entry;
+  int entryIndex = -1;
+
+  for (uint32_t i = 0; i < readLen; i++) {
+    const uint32_t address = memAddr + i;
+    if (address < sizeof(header)) {
+      dest[i] = ((const uint8_t*)&header)[address];
+    } else {
+      const uint32_t offset = address - sizeof(header);
+      const int index = offset / sizeof(staticMemReportEntry_t);
+      if (index != entryIndex) {
+        fillReportEntry(&_staticMem_start + index, &entry);
+        entryIndex = index;
+      }
+      dest[i] = ((const uint8_t*)&entry)[offset % sizeof(staticMemReportEntry_t)];
+    }
+  }
 
-  *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
-  *ppxTimerTaskStackBuffer = uxTimerTaskStack;
-  *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+  return true;
 }
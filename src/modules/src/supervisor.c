@@ -29,21 +29,49 @@
 #include <stdlib.h>
 
 #include "log.h"
+#include "param.h"
 #include "motors.h"
 #include "pm.h"
 #include "stabilizer.h"
 #include "supervisor.h"
+#include "log_capture.h"
+#include "windowStats.h"
 
 /* Minimum summed motor PWM that means we are flying */
 #define SUPERVISOR_FLIGHT_THRESHOLD 1000
 
-/* Number of times in a row we need to see a condition before acting upon it */
-#define SUPERVISOR_HYSTERESIS_THRESHOLD 30
+/* Mean acc z (g) over a window that means we are upside down */
+#define SUPERVISOR_TUMBLE_ACC_Z -0.5f
+
+/* Mean rotation rate (deg/s) over a window below which a tumble is confirmed, flips rotate much faster */
+#define SUPERVISOR_TUMBLE_MAX_RATE 300.0f
+
+/* Mean acc magnitude (g) over a window that means we are in free fall */
+#define SUPERVISOR_FREEFALL_ACC 0.3f
 
 static bool canFly;
 static bool isFlying;
 static bool isTumbled;
 
+// Tumble and crash detection, on windows of the latest WINDOW_STATS_SIZE sensor samples
+static windowStats_t accZWindow;
+static windowStats_t accWindow;
+static windowStats_t gyroWindow;
+static uint32_t updateCount;
+
+// A crash is an impact within crashMs after a free fall
+static float impactAcc = 4.0f;
+static uint16_t crashMs = 200;
+static bool isFreeFalling;
+static uint32_t freeFallUpdate;
+static bool hasFreeFallen;
+static bool isCrashed;
+
+// Supervisor updates (ms) from the first upside down sample to the tumble detection. A crash is
+// detected on the impact sample itself.
+static uint32_t tumbleOnsetUpdate;
+static uint16_t detectionLatency;
+
 bool supervisorCanFly()
 {
   return canFly;
@@ -86,39 +114,70 @@ static bool isFlyingCheck()
 }
 
 //
-// We say we are tumbled when the accelerometer reports negative values.
+// We say we are tumbled when the mean of the accelerometer z over a window is
+// negative, and we are not rotating fast as in a flip.
 //
 // Once a tumbled situation is identified, we can use this for instance to cut
 // the thrust to the motors, avoiding the Crazyflie from running propellers at
-// significant thrust when accidentally crashing into walls or the ground.
+// significant thrust when accidentally crashing into walls or the ground. The
+// mean over the window filters the noise that reset the old per sample
+// hysteresis, so the detection is both faster and more robust.
 //
 static bool isTumbledCheck(const sensorData_t *data)
 {
-  const float tolerance = -0.5;
-  static uint32_t hysteresis = 0;
-  //
-  // We need a SUPERVISOR_HYSTERESIS_THRESHOLD amount of readings that indicate
-  // that we are tumbled before we act on it. This is to reduce false positives.
-  //
-  if (data->acc.z <= tolerance) {
-    hysteresis++;
-    if (hysteresis > SUPERVISOR_HYSTERESIS_THRESHOLD) {
-      return true;
-    }
-  } else {
-    hysteresis = 0;
+  if (data->acc.z > SUPERVISOR_TUMBLE_ACC_Z) {
+    tumbleOnsetUpdate = updateCount;
+  }
+
+  return windowStatsIsFull(&accZWindow) &&
+         windowStatsMean(&accZWindow) <= SUPERVISOR_TUMBLE_ACC_Z &&
+         windowStatsMean(&gyroWindow) < SUPERVISOR_TUMBLE_MAX_RATE;
+}
+
+//
+// We say we have crashed when the acceleration exceeds impactAcc shortly after
+// a free fall, that is with a mean acceleration magnitude close to zero over a
+// window.
+//
+static bool isCrashedCheck(const float accMagnitude)
+{
+  isFreeFalling = windowStatsIsFull(&accWindow) && windowStatsMean(&accWindow) < SUPERVISOR_FREEFALL_ACC;
+  if (isFreeFalling) {
+    freeFallUpdate = updateCount;
+    hasFreeFallen = true;
   }
 
-  return false;
+  return hasFreeFallen &&
+         accMagnitude > impactAcc &&
+         (updateCount - freeFallUpdate) <= crashMs;
 }
 
 void supervisorUpdate(const sensorData_t *data)
 {
+  updateCount++;
+
+  const float accMagnitude = sqrtf(data->acc.x * data->acc.x + data->acc.y * data->acc.y + data->acc.z * data->acc.z);
+  const float gyroMagnitude = sqrtf(data->gyro.x * data->gyro.x + data->gyro.y * data->gyro.y + data->gyro.z * data->gyro.z);
+  windowStatsAdd(&accZWindow, data->acc.z);
+  windowStatsAdd(&accWindow, accMagnitude);
+  windowStatsAdd(&gyroWindow, gyroMagnitude);
+
   isFlying = isFlyingCheck();
 
+  const bool wasTumbled = isTumbled;
   isTumbled = isTumbledCheck(data);
+  if (isTumbled && !wasTumbled) {
+    detectionLatency = updateCount - tumbleOnsetUpdate;
+  }
   if (isTumbled && isFlying) {
     stabilizerSetEmergencyStop();
+    logCaptureTrigger(logCaptureTriggerTumble);
+  }
+
+  isCrashed = isCrashedCheck(accMagnitude);
+  if (isCrashed && isFlying) {
+    stabilizerSetEmergencyStop();
+    logCaptureTrigger(logCaptureTriggerCrash);
   }
 
   canFly = canFlyCheck();
@@ -129,3 +188,14 @@ LOG_ADD(LOG_UINT8, canfly, &canFly)
 LOG_ADD(LOG_UINT8, isFlying, &isFlying)
 LOG_ADD(LOG_UINT8, isTumbled, &isTumbled)
 LOG_GROUP_STOP(sys)
+
+LOG_GROUP_START(supervisor)
+LOG_ADD(LOG_UINT8, freeFall, &isFreeFalling)
+LOG_ADD(LOG_UINT8, crashed, &isCrashed)
+LOG_ADD(LOG_UINT16, latency, &detectionLatency)
+LOG_GROUP_STOP(supervisor)
+
+PARAM_GROUP_START(supervisor)
+PARAM_ADD(PARAM_FLOAT, impactAcc, &impactAcc)
+PARAM_ADD(PARAM_UINT16, crashMs, &crashMs)
+PARAM_GROUP_STOP(supervisor)
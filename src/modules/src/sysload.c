@@ -22,16 +22,27 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  *
  * sysload.c - System load monitor
+ *
+ * The load and stack usage of all tasks can be dumped to the console with the
+ * system.taskDump parameter. With system.loadMon set, a table with the load and
+ * stack usage of all tasks is updated every second instead, it is read through
+ * the memory subsystem (MEM_TYPE_TASK_LOAD) and summarized in the sysload log
+ * group.
  */
 
 #define DEBUG_MODULE "SYSLOAD"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 #include "FreeRTOS.h"
+#include "task.h"
 #include "timers.h"
 #include "debug.h"
 #include "cfassert.h"
 #include "param.h"
+#include "log.h"
+#include "mem.h"
 #include "static_mem.h"
 
 #include "sysload.h"
@@ -42,6 +53,7 @@ static void timerHandler(xTimerHandle timer);
 
 static bool initialized = false;
 static uint8_t triggerDump = 0;
+static uint8_t enableMonitor = 0;
 
 typedef struct {
   uint32_t ulRunTimeCounter;
@@ -53,14 +65,56 @@ NO_DMA_CCM_SAFE_ZERO_INIT static taskData_t previousSnapshot[TASK_MAX_COUNT];
 static int taskTopIndex = 0;
 static uint32_t previousTotalRunTime = 0;
 
+// Kept off the timer task stack
+NO_DMA_CCM_SAFE_ZERO_INIT static TaskStatus_t taskStats[TASK_MAX_COUNT];
+
+#define TASK_LOAD_VERSION 1
+
+typedef struct {
+  uint8_t taskNumber;
+  char name[configMAX_TASK_NAME_LEN];
+  uint16_t load;      // 0.01 % of the total run time
+  uint16_t stackLeft; // words left at peak stack usage
+  uint8_t priority;
+} __attribute__((packed)) taskLoadEntry_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t taskCount;
+  uint8_t entrySize;
+  uint8_t reserved;
+  uint32_t updateCount;
+  taskLoadEntry_t entries[TASK_MAX_COUNT];
+} __attribute__((packed)) taskLoadTable_t;
+
+// Protected by a critical section, as it is written by the timer task and read by the mem task
+NO_DMA_CCM_SAFE_ZERO_INIT static taskLoadTable_t taskLoadTable;
+
+static uint16_t totalLoad;     // 0.01 %, all but the idle task
+static uint16_t minStackLeft;  // words
+static uint8_t minStackTask;   // task number of the task with the least stack left
+
 static StaticTimer_t timerBuffer;
 
+static uint32_t handleMemGetSize(void);
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_TASK_LOAD,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = 0, // Write not supported
+};
+
 void sysLoadInit() {
   ASSERT(!initialized);
 
   xTimerHandle timer = xTimerCreateStatic( "sysLoadMonitorTimer", TIMER_PERIOD, pdTRUE, NULL, timerHandler, &timerBuffer);
   xTimerStart(timer, 100);
 
+  taskLoadTable.version = TASK_LOAD_VERSION;
+  taskLoadTable.entrySize = sizeof(taskLoadEntry_t);
+  memoryRegisterHandler(&memDef);
+
   initialized = true;
 }
 
@@ -83,32 +137,75 @@ static taskData_t* getPreviousTaskData(uint32_t xTaskNumber) {
   return result;
 }
 
+static void updateTable(const uint32_t taskCount, const float f) {
+  const TaskHandle_t idleTask = xTaskGetIdleTaskHandle();
+  uint16_t load = 0;
+  uint16_t stackLeft = UINT16_MAX;
+  uint8_t stackTask = 0;
+
+  for (uint32_t i = 0; i < taskCount; i++) {
+    TaskStatus_t* stats = &taskStats[i];
+    taskData_t* previousTaskData = getPreviousTaskData(stats->xTaskNumber);
+
+    taskLoadEntry_t entry = {
+      .taskNumber = stats->xTaskNumber,
+      .load = f * 100.0f * (stats->ulRunTimeCounter - previousTaskData->ulRunTimeCounter),
+      .stackLeft = stats->usStackHighWaterMark,
+      .priority = stats->uxCurrentPriority,
+    };
+    strncpy(entry.name, stats->pcTaskName, sizeof(entry.name));
+
+    if (stats->xHandle != idleTask) {
+      load += entry.load;
+    }
+    if (entry.stackLeft < stackLeft) {
+      stackLeft = entry.stackLeft;
+      stackTask = entry.taskNumber;
+    }
+
+    taskENTER_CRITICAL();
+    taskLoadTable.entries[i] = entry;
+    taskEXIT_CRITICAL();
+
+    previousTaskData->ulRunTimeCounter = stats->ulRunTimeCounter;
+  }
+
+  taskENTER_CRITICAL();
+  taskLoadTable.taskCount = taskCount;
+  taskLoadTable.updateCount++;
+  taskEXIT_CRITICAL();
+
+  totalLoad = load;
+  minStackLeft = stackLeft;
+  minStackTask = stackTask;
+}
+
+static void dumpTasks(const uint32_t taskCount) {
+  // Dumps the the CPU load and stack usage for all tasks
+  // CPU usage is since last update in % compared to total time spent in tasks. Note that time spent in interrupts will be included in measured time.
+  // Stack usage is displayed as nr of unused words at peak stack usage.
+
+  DEBUG_PRINT("Task dump\n");
+  DEBUG_PRINT("Load\tStack left\tName\n");
+  for (uint32_t i = 0; i < taskCount; i++) {
+    const taskLoadEntry_t* entry = &taskLoadTable.entries[i];
+    DEBUG_PRINT("%.2f \t%u \t%s\n", (double)(entry->load / 100.0f), entry->stackLeft, taskStats[i].pcTaskName);
+  }
+}
+
 static void timerHandler(xTimerHandle timer) {
-  if (triggerDump != 0) {
+  if (triggerDump != 0 || enableMonitor != 0) {
     uint32_t totalRunTime;
 
-    TaskStatus_t taskStats[TASK_MAX_COUNT];
     uint32_t taskCount = uxTaskGetSystemState(taskStats, TASK_MAX_COUNT, &totalRunTime);
     ASSERT(taskCount < TASK_MAX_COUNT);
 
     uint32_t totalDelta = totalRunTime - previousTotalRunTime;
     float f = 100.0 / totalDelta;
 
-    // Dumps the the CPU load and stack usage for all tasks
-    // CPU usage is since last dump in % compared to total time spent in tasks. Note that time spent in interrupts will be included in measured time.
-    // Stack usage is displayed as nr of unused bytes at peak stack usage.
-
-    DEBUG_PRINT("Task dump\n");
-    DEBUG_PRINT("Load\tStack left\tName\n");
-    for (uint32_t i = 0; i < taskCount; i++) {
-      TaskStatus_t* stats = &taskStats[i];
-      taskData_t* previousTaskData = getPreviousTaskData(stats->xTaskNumber);
-
-      uint32_t taskRunTime = stats->ulRunTimeCounter;
-      float load = f * (taskRunTime - previousTaskData->ulRunTimeCounter);
-      DEBUG_PRINT("%.2f \t%u \t%s\n", (double)load, stats->usStackHighWaterMark, stats->pcTaskName);
-
-      previousTaskData->ulRunTimeCounter = taskRunTime;
+    updateTable(taskCount, f);
+    if (triggerDump != 0) {
+      dumpTasks(taskCount);
     }
 
     previousTotalRunTime = totalRunTime;
@@ -117,7 +214,47 @@ static void timerHandler(xTimerHandle timer) {
   }
 }
 
+static uint32_t handleMemGetSize(void) {
+  return offsetof(taskLoadTable_t, entries) + taskLoadTable.taskCount * sizeof(taskLoadEntry_t);
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* dest) {
+  bool result = false;
+
+  taskENTER_CRITICAL();
+  const uint32_t size = handleMemGetSize();
+  if (memAddr <= size && readLen <= size - memAddr) {
+    memcpy(dest, ((uint8_t*)&taskLoadTable) + memAddr, readLen);
+    result = true;
+  }
+  taskEXIT_CRITICAL();
+
+  return result;
+}
+
 
 PARAM_GROUP_START(system)
 PARAM_ADD(PARAM_UINT8, taskDump, &triggerDump)
+/**
+ * @brief Set to nonzero to update the task load table every second, see MEM_TYPE_TASK_LOAD
+ */
+PARAM_ADD(PARAM_UINT8, loadMon, &enableMonitor)
 PARAM_GROUP_STOP(system)
+
+/**
+ * Summary of the task load table, updated every second while system.loadMon is set
+ */
+LOG_GROUP_START(sysload)
+/**
+ * @brief Load of all tasks but the idle task, including the time spent in interrupts [0.01 %]
+ */
+LOG_ADD(LOG_UINT16, load, &totalLoad)
+/**
+ * @brief The least stack left of all tasks at peak usage [words]
+ */
+LOG_ADD(LOG_UINT16, minStack, &minStackLeft)
+/**
+ * @brief Task number of the task with the least stack left
+ */
+LOG_ADD(LOG_UINT8, minStackTask, &minStackTask)
+LOG_GROUP_STOP(sysload)
@@ -59,6 +59,7 @@
 #include "proximity.h"
 #include "watchdog.h"
 #include "queuemonitor.h"
+#include "isr_profiler.h"
 #include "buzzer.h"
 #include "sound.h"
 #include "sysload.h"
@@ -67,9 +68,13 @@
 #include "extrx.h"
 #include "app.h"
 #include "static_mem.h"
+#include "rate_health.h"
+#include "black_box.h"
+#include "eventtrigger.h"
 #include "peer_localization.h"
 #include "cfassert.h"
 #include "i2cdev.h"
+#include "sensors.h"
 
 #ifndef START_DISARMED
 #define ARM_INIT true
@@ -92,6 +97,28 @@ static StaticSemaphore_t canStartMutexBuffer;
 /* Private functions */
 static void systemTask(void *arg);
 
+// Boot time of the initialisation stages, in ms
+typedef enum {
+  bootStageSystem = 0,
+  bootStageComm,
+  bootStageDeckScan,
+  bootStageSensors,
+  bootStageDeck,
+  bootStageStabilizer,
+  bootStageMem,
+  bootStageCount,
+} bootStage_t;
+
+static uint16_t bootTime[bootStageCount];
+static uint16_t bootReadyTime; // ms from start of the scheduler until the self test has passed
+
+// The decks are enumerated over one wire by a short lived task while the
+// system task initialises the modules that do not depend on the decks
+static void deckScanTask(void *arg);
+STATIC_MEM_TASK_ALLOC(deckScanTask, DECK_SCAN_TASK_STACKSIZE);
+static SemaphoreHandle_t deckScanDone;
+static StaticSemaphore_t deckScanDoneBuffer;
+
 /* Public functions */
 void systemLaunch(void)
 {
@@ -131,11 +158,15 @@ void systemInit(void)
   configblockInit();
   storageInit();
   workerInit();
+  staticMemInit();
+  rateHealthInit();
+  blackBoxInit();
   adcInit();
   ledseqInit();
   pmInit();
   buzzerInit();
   peerLocalizationInit();
+  eventtriggerInit();
 
 #ifdef APP_ENABLED
   appInit();
@@ -157,6 +188,21 @@ bool systemTest()
 
 /* Private functions implementation */
 
+static void bootStageDone(const bootStage_t stage, const uint32_t startTick)
+{
+  bootTime[stage] = T2M(xTaskGetTickCount() - startTick);
+}
+
+static void deckScanTask(void *arg)
+{
+  const uint32_t start = xTaskGetTickCount();
+  deckInfoInit();
+  bootStageDone(bootStageDeckScan, start);
+
+  xSemaphoreGive(deckScanDone);
+  vTaskDelete(NULL);
+}
+
 void systemTask(void *arg)
 {
   bool pass = true;
@@ -168,6 +214,10 @@ void systemTask(void *arg)
   queueMonitorInit();
 #endif
 
+#ifdef ISR_PROFILER
+  isrProfilerInit();
+#endif
+
 #ifdef ENABLE_UART1
   uart1Init(9600);
 #endif
@@ -180,21 +230,45 @@ void systemTask(void *arg)
   i2cdevInit(I2C1_DEV);
 
   //Init the high-levels modules
+  uint32_t start = xTaskGetTickCount();
   systemInit();
+  bootStageDone(bootStageSystem, start);
+
+  start = xTaskGetTickCount();
   commInit();
+  bootStageDone(bootStageComm, start);
+
+  // One wire enumeration goes over syslink, start it as soon as syslink is up
+  deckScanDone = xSemaphoreCreateBinaryStatic(&deckScanDoneBuffer);
+  STATIC_MEM_TASK_CREATE(deckScanTask, deckScanTask, DECK_SCAN_TASK_NAME, NULL, DECK_SCAN_TASK_PRI);
+
   commanderInit();
 
   StateEstimatorType estimator = anyEstimator;
   estimatorKalmanTaskInit();
+
+  // The sensors are on their own bus and do not depend on the decks
+  start = xTaskGetTickCount();
+  sensorsInit();
+  bootStageDone(bootStageSensors, start);
+
+  xSemaphoreTake(deckScanDone, portMAX_DELAY);
+  start = xTaskGetTickCount();
   deckInit();
+  bootStageDone(bootStageDeck, start);
+
   estimator = deckGetRequiredEstimator();
+  start = xTaskGetTickCount();
   stabilizerInit(estimator);
+  bootStageDone(bootStageStabilizer, start);
   if (deckGetRequiredLowInterferenceRadioMode() && platformConfigPhysicalLayoutAntennasAreClose())
   {
     platformSetLowInterferenceRadioMode();
   }
   soundInit();
+  start = xTaskGetTickCount();
   memInit();
+  bootStageDone(bootStageMem, start);
 
 #ifdef PROXIMITY_ENABLED
   proximityInit();
@@ -218,6 +292,10 @@ void systemTask(void *arg)
   //Start the firmware
   if(pass)
   {
+    bootReadyTime = T2M(xTaskGetTickCount());
+    DEBUG_PRINT("Boot done in %d ms (system %d, comm %d, deck scan %d, sensors %d, decks %d, stabilizer %d, mem %d)\n",
+                bootReadyTime, bootTime[bootStageSystem], bootTime[bootStageComm], bootTime[bootStageDeckScan],
+                bootTime[bootStageSensors], bootTime[bootStageDeck], bootTime[bootStageStabilizer], bootTime[bootStageMem]);
     selftestPassed = 1;
     systemStart();
     soundSetEffect(SND_STARTUP);
@@ -325,3 +403,27 @@ PARAM_GROUP_STOP(sytem)
 LOG_GROUP_START(sys)
 LOG_ADD(LOG_INT8, armed, &armed)
 LOG_GROUP_STOP(sys)
+
+/**
+ * Time spent in the stages of the boot [ms]. The deck scan runs concurrently
+ * with the initialisation of the sensors.
+ */
+LOG_GROUP_START(boot)
+/**
+ * @brief From start of the scheduler until the self test has passed
+ */
+LOG_ADD(LOG_UINT16, ready, &bootReadyTime)
+LOG_ADD(LOG_UINT16, system, &bootTime[bootStageSystem])
+LOG_ADD(LOG_UINT16, comm, &bootTime[bootStageComm])
+/**
+ * @brief One wire enumeration of the decks
+ */
+LOG_ADD(LOG_UINT16, deckScan, &bootTime[bootStageDeckScan])
+LOG_ADD(LOG_UINT16, sensors, &bootTime[bootStageSensors])
+/**
+ * @brief Initialisation of the deck drivers
+ */
+LOG_ADD(LOG_UINT16, deck, &bootTime[bootStageDeck])
+LOG_ADD(LOG_UINT16, stabilizer, &bootTime[bootStageStabilizer])
+LOG_ADD(LOG_UINT16, mem, &bootTime[bootStageMem])
+LOG_GROUP_STOP(boot)
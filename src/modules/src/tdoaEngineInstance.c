@@ -46,6 +46,42 @@ LOG_ADD(LOG_UINT16, tof, &tdoaEngineState.stats.tof)
 LOG_ADD(LOG_FLOAT, tdoa, &tdoaEngineState.stats.tdoa)
 LOG_GROUP_STOP(tdoaEngine)
 
+// Per anchor statistics, see tdoaStats.h for the packing
+LOG_GROUP_START(tdoaAnchor)
+LOG_ADD(LOG_UINT32, a0, &tdoaEngineState.stats.anchorLogA[0])
+LOG_ADD(LOG_UINT32, a1, &tdoaEngineState.stats.anchorLogA[1])
+LOG_ADD(LOG_UINT32, a2, &tdoaEngineState.stats.anchorLogA[2])
+LOG_ADD(LOG_UINT32, a3, &tdoaEngineState.stats.anchorLogA[3])
+LOG_ADD(LOG_UINT32, a4, &tdoaEngineState.stats.anchorLogA[4])
+LOG_ADD(LOG_UINT32, a5, &tdoaEngineState.stats.anchorLogA[5])
+LOG_ADD(LOG_UINT32, a6, &tdoaEngineState.stats.anchorLogA[6])
+LOG_ADD(LOG_UINT32, a7, &tdoaEngineState.stats.anchorLogA[7])
+LOG_ADD(LOG_UINT32, a8, &tdoaEngineState.stats.anchorLogA[8])
+LOG_ADD(LOG_UINT32, a9, &tdoaEngineState.stats.anchorLogA[9])
+LOG_ADD(LOG_UINT32, a10, &tdoaEngineState.stats.anchorLogA[10])
+LOG_ADD(LOG_UINT32, a11, &tdoaEngineState.stats.anchorLogA[11])
+LOG_ADD(LOG_UINT32, a12, &tdoaEngineState.stats.anchorLogA[12])
+LOG_ADD(LOG_UINT32, a13, &tdoaEngineState.stats.anchorLogA[13])
+LOG_ADD(LOG_UINT32, a14, &tdoaEngineState.stats.anchorLogA[14])
+LOG_ADD(LOG_UINT32, a15, &tdoaEngineState.stats.anchorLogA[15])
+LOG_ADD(LOG_UINT32, b0, &tdoaEngineState.stats.anchorLogB[0])
+LOG_ADD(LOG_UINT32, b1, &tdoaEngineState.stats.anchorLogB[1])
+LOG_ADD(LOG_UINT32, b2, &tdoaEngineState.stats.anchorLogB[2])
+LOG_ADD(LOG_UINT32, b3, &tdoaEngineState.stats.anchorLogB[3])
+LOG_ADD(LOG_UINT32, b4, &tdoaEngineState.stats.anchorLogB[4])
+LOG_ADD(LOG_UINT32, b5, &tdoaEngineState.stats.anchorLogB[5])
+LOG_ADD(LOG_UINT32, b6, &tdoaEngineState.stats.anchorLogB[6])
+LOG_ADD(LOG_UINT32, b7, &tdoaEngineState.stats.anchorLogB[7])
+LOG_ADD(LOG_UINT32, b8, &tdoaEngineState.stats.anchorLogB[8])
+LOG_ADD(LOG_UINT32, b9, &tdoaEngineState.stats.anchorLogB[9])
+LOG_ADD(LOG_UINT32, b10, &tdoaEngineState.stats.anchorLogB[10])
+LOG_ADD(LOG_UINT32, b11, &tdoaEngineState.stats.anchorLogB[11])
+LOG_ADD(LOG_UINT32, b12, &tdoaEngineState.stats.anchorLogB[12])
+LOG_ADD(LOG_UINT32, b13, &tdoaEngineState.stats.anchorLogB[13])
+LOG_ADD(LOG_UINT32, b14, &tdoaEngineState.stats.anchorLogB[14])
+LOG_ADD(LOG_UINT32, b15, &tdoaEngineState.stats.anchorLogB[15])
+LOG_GROUP_STOP(tdoaAnchor)
+
 
 PARAM_GROUP_START(tdoaEngine)
 PARAM_ADD(PARAM_UINT8, logId, &tdoaEngineState.stats.newAnchorId)
@@ -54,5 +90,9 @@ PARAM_ADD(PARAM_UINT8, logOthrId, &tdoaEngineState.stats.newRemoteAnchorId)
 // This variable should not be exposed as a parameter since it is changed from inside the CF FW.
 // It only happens when the LPS system mode is changed to TDoA2 or TDoA3 though, and as this is
 // not a frequent action, we chose to expose it anyway.
+// 1: random, 2: youngest, 3: best geometry based on the estimated position
 PARAM_ADD(PARAM_UINT8, matchAlgo, &tdoaEngineState.matchingAlgorithm)
+
+// Send all TDoA measurements from a packet as one batch (max TDOA_BATCH_MAX_COUNT), only supported by TDoA3
+PARAM_ADD(PARAM_UINT8, batch, &tdoaEngineState.useBatch)
 PARAM_GROUP_STOP(tdoaEngine)
@@ -0,0 +1,259 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * timesync.c - Swarm time, a clock shared by the Crazyflies of a swarm
+ *
+ * A radio broadcast is received by all the Crazyflies of a swarm at the same
+ * instant. The time sync beacon, a broadcast with the swarm time of the
+ * sender, gives each Crazyflie a pair of local and swarm time of that
+ * instant. The beacons are timestamped by the radio link as soon as the
+ * packet is received from the nRF, and the local clock is disciplined to the
+ * swarm time with a PI loop on the offset and the drift. The jitter of the
+ * sender (USB) is the same in all Crazyflies since they receive the same
+ * packets, only the reception jitter adds to the skew between them.
+ *
+ * Beacons that are far off, for instance a repeated broadcast received when
+ * the first one was lost, are dropped as outliers. A number of outliers in a
+ * row is taken as a jump of the swarm time and the clock is set again.
+ */
+
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "timesync.h"
+#include "crtp_localization_service.h"
+#include "usec_time.h"
+#include "log.h"
+#include "param.h"
+
+// Samples before the swarm time is used
+#define TIMESYNC_LOCK_SAMPLES 5
+// Samples further off than this are outliers
+#define TIMESYNC_OUTLIER_US 2000
+// Outliers in a row that set the clock again
+#define TIMESYNC_MAX_OUTLIERS 3
+
+// The generic channel of the localization port, GENERIC_TYPE in crtp_localization_service.c
+#define LOCSRV_GENERIC_CHANNEL 1
+
+#define TIMESYNC_KP 0.2f
+#define TIMESYNC_KI 0.05f
+#define TIMESYNC_MAX_DRIFT 500e-6f
+
+typedef struct {
+  uint8_t type; // TIME_SYNC_BEACON
+  uint64_t swarmTime; // us
+} __attribute__((packed)) timeSyncBeacon_t;
+
+// swarm = swarmRef + (local - localRef) * (1 + drift)
+typedef struct {
+  uint64_t localRef;
+  uint64_t swarmRef;
+  float drift;
+} clockModel_t;
+
+static clockModel_t model;
+static volatile bool isLocked = false;
+static uint32_t goodSamples;
+static uint8_t outliersInRow;
+
+// Log
+static int32_t lastError;
+static float driftPpm;
+static uint32_t sampleCount;
+static uint32_t outlierCount;
+
+// Parameters
+static uint8_t useForLogTime = 0;
+
+static clockModel_t getModel(void)
+{
+  taskENTER_CRITICAL();
+  const clockModel_t copy = model;
+  taskEXIT_CRITICAL();
+  return copy;
+}
+
+static void setModel(const clockModel_t* newModel)
+{
+  taskENTER_CRITICAL();
+  model = *newModel;
+  taskEXIT_CRITICAL();
+}
+
+static uint64_t toSwarm(const clockModel_t* m, const uint64_t localUs)
+{
+  const int64_t delta = (int64_t)(localUs - m->localRef);
+  return m->swarmRef + delta + (int64_t)(delta * m->drift);
+}
+
+static uint64_t toLocal(const clockModel_t* m, const uint64_t swarmUs)
+{
+  const int64_t delta = (int64_t)(swarmUs - m->swarmRef);
+  return m->localRef + delta - (int64_t)(delta * m->drift / (1.0f + m->drift));
+}
+
+void timesyncAddSample(const uint64_t localUs, const uint64_t swarmUs)
+{
+  clockModel_t m = getModel();
+  sampleCount++;
+
+  const int64_t error = (int64_t)(swarmUs - toSwarm(&m, localUs));
+  const bool isStarted = goodSamples > 0;
+
+  if (isStarted && llabs(error) > TIMESYNC_OUTLIER_US && outliersInRow < TIMESYNC_MAX_OUTLIERS) {
+    outliersInRow++;
+    outlierCount++;
+    return;
+  }
+
+  if (!isStarted || llabs(error) > TIMESYNC_OUTLIER_US) {
+    // Set the clock, the drift is kept since it is a property of the crystal
+    isLocked = false;
+    m.localRef = localUs;
+    m.swarmRef = swarmUs;
+    setModel(&m);
+    goodSamples = 1;
+    outliersInRow = 0;
+    lastError = 0;
+    return;
+  }
+
+  const float dt = (localUs - m.localRef) / 1e6f;
+  if (dt <= 0.0f) {
+    return;
+  }
+
+  m.swarmRef = toSwarm(&m, localUs) + (int64_t)(TIMESYNC_KP * error);
+  m.localRef = localUs;
+  m.drift += TIMESYNC_KI * (error / 1e6f) / dt;
+  if (m.drift > TIMESYNC_MAX_DRIFT) {
+    m.drift = TIMESYNC_MAX_DRIFT;
+  } else if (m.drift < -TIMESYNC_MAX_DRIFT) {
+    m.drift = -TIMESYNC_MAX_DRIFT;
+  }
+  setModel(&m);
+
+  outliersInRow = 0;
+  lastError = (int32_t)error;
+  driftPpm = m.drift * 1e6f;
+  goodSamples++;
+  if (goodSamples >= TIMESYNC_LOCK_SAMPLES) {
+    isLocked = true;
+  }
+}
+
+void timesyncHandleBroadcast(const CRTPPacket* pk, const uint64_t rxTimestamp)
+{
+  const timeSyncBeacon_t* beacon = (const timeSyncBeacon_t*)pk->data;
+
+  if (pk->port == CRTP_PORT_LOCALIZATION && pk->channel == LOCSRV_GENERIC_CHANNEL &&
+      pk->size >= sizeof(timeSyncBeacon_t) && beacon->type == TIME_SYNC_BEACON) {
+    timesyncAddSample(rxTimestamp, beacon->swarmTime);
+  }
+}
+
+bool timesyncIsLocked(void)
+{
+  return isLocked;
+}
+
+uint64_t timesyncNow(void)
+{
+  return timesyncToSwarm(usecTimestamp());
+}
+
+uint64_t timesyncToLocal(const uint64_t swarmUs)
+{
+  if (!isLocked) {
+    return swarmUs;
+  }
+
+  const clockModel_t m = getModel();
+  return toLocal(&m, swarmUs);
+}
+
+uint64_t timesyncToSwarm(const uint64_t localUs)
+{
+  if (!isLocked) {
+    return localUs;
+  }
+
+  const clockModel_t m = getModel();
+  return toSwarm(&m, localUs);
+}
+
+uint32_t timesyncLogTimestamp(void)
+{
+  if (useForLogTime && isLocked) {
+    return (uint32_t)(timesyncNow() / 1000);
+  }
+
+  return ((long long)xTaskGetTickCount()) / portTICK_RATE_MS;
+}
+
+static uint32_t swarmTimeLogger(uint32_t timestamp, void* ignored)
+{
+  return (uint32_t)(timesyncNow() / 1000);
+}
+static logByFunction_t swarmTimeLoggerDef = {.acquireUInt32 = swarmTimeLogger, .data = 0};
+
+/**
+ * Swarm time, synchronized with the time sync beacons broadcasted on the
+ * generic localization channel
+ */
+PARAM_GROUP_START(timesync)
+/**
+ * @brief Nonzero to use the swarm time as timestamp of the log packets, when locked
+ */
+PARAM_ADD(PARAM_UINT8, logTime, &useForLogTime)
+PARAM_GROUP_STOP(timesync)
+
+LOG_GROUP_START(timesync)
+/**
+ * @brief Nonzero when the swarm time is known
+ */
+LOG_ADD(LOG_UINT8, locked, &isLocked)
+/**
+ * @brief Swarm time [ms]
+ */
+LOG_ADD_BY_FUNCTION(LOG_UINT32, time, &swarmTimeLoggerDef)
+/**
+ * @brief Error of the last beacon before the correction [us]
+ */
+LOG_ADD(LOG_INT32, error, &lastError)
+/**
+ * @brief Estimated drift of the local clock [ppm]
+ */
+LOG_ADD(LOG_FLOAT, drift, &driftPpm)
+/**
+ * @brief Number of beacons received
+ */
+LOG_ADD(LOG_UINT32, samples, &sampleCount)
+/**
+ * @brief Number of beacons dropped as outliers
+ */
+LOG_ADD(LOG_UINT32, outliers, &outlierCount)
+LOG_GROUP_STOP(timesync)
@@ -0,0 +1,264 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * vibration.c - On-board vibration spectrum of the IMU
+ *
+ * The stabilizer copies the gyro (or acc) sample of every loop to one of two
+ * windows of SPECTRUM_SIZE samples. When a window is full the buffers are
+ * swapped and a low priority task computes the spectrum of each axis: the
+ * energy in a few frequency bands and the largest peaks. The results are
+ * logged in the vibration group, the peak frequencies are the ones to set the
+ * gyro notch filters to. A window that fills up before the previous one is
+ * analyzed is dropped.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "vibration.h"
+#include "spectrum.h"
+#include "config.h"
+#include "log.h"
+#include "param.h"
+#include "static_mem.h"
+
+#define VIBRATION_SAMPLE_RATE ((float)RATE_MAIN_LOOP)
+
+typedef enum {
+  vibrationSourceGyro = 0,
+  vibrationSourceAcc = 1,
+} vibrationSource_t;
+
+// Bands of interest of the frame, motor and propeller vibrations (Hz). Frequencies below the first band (drift and
+// flight maneuvers) are ignored.
+static const float bandEdges[SPECTRUM_BAND_COUNT + 1] = {20.0f, 80.0f, 160.0f, 320.0f, VIBRATION_SAMPLE_RATE / 2.0f};
+
+NO_DMA_CCM_SAFE_ZERO_INIT static Axis3f windows[2][SPECTRUM_SIZE];
+NO_DMA_CCM_SAFE_ZERO_INIT static spectrum_t spectrum;
+
+static bool isInit = false;
+static TaskHandle_t taskHandle;
+static uint8_t fillWindow;
+static uint16_t sampleCount;
+static volatile uint8_t readyWindow;
+static volatile bool isAnalyzing;
+
+static spectrumResult_t results[3];
+static uint32_t windowCount;
+static uint32_t droppedWindows;
+
+// Parameters
+static uint8_t enable = 1;
+static uint8_t source = vibrationSourceGyro;
+
+static void vibrationTask(void *param);
+STATIC_MEM_TASK_ALLOC(vibrationTask, VIBRATION_TASK_STACKSIZE);
+
+void vibrationInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  spectrumInit(&spectrum, VIBRATION_SAMPLE_RATE, bandEdges);
+  taskHandle = STATIC_MEM_TASK_CREATE(vibrationTask, vibrationTask, VIBRATION_TASK_NAME, NULL, VIBRATION_TASK_PRI);
+
+  isInit = true;
+}
+
+bool vibrationTest(void)
+{
+  return isInit;
+}
+
+void vibrationAddSample(const sensorData_t *sensorData)
+{
+  if (!enable) {
+    sampleCount = 0;
+    return;
+  }
+
+  windows[fillWindow][sampleCount] = (source == vibrationSourceAcc) ? sensorData->acc : sensorData->gyro;
+  sampleCount++;
+
+  if (sampleCount == SPECTRUM_SIZE) {
+    sampleCount = 0;
+    if (isAnalyzing) {
+      // The task is still busy with the other window, this one is overwritten
+      droppedWindows++;
+      return;
+    }
+
+    readyWindow = fillWindow;
+    fillWindow ^= 1;
+    isAnalyzing = true;
+    xTaskNotifyGive(taskHandle);
+  }
+}
+
+static void vibrationTask(void *param)
+{
+  spectrumResult_t result;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    const float *window = (const float *)windows[readyWindow];
+    for (int axis = 0; axis < 3; axis++) {
+      spectrumAnalyze(&spectrum, &window[axis], 3, &result);
+      memcpy(&results[axis], &result, sizeof(result));
+    }
+    windowCount++;
+
+    isAnalyzing = false;
+  }
+}
+
+/**
+ * Tuning of the on-board vibration spectrum.
+ */
+PARAM_GROUP_START(vibration)
+/**
+ * @brief Nonzero to compute the spectrum (default: 1)
+ */
+PARAM_ADD(PARAM_UINT8, enable, &enable)
+/**
+ * @brief 0: gyro (deg/s), 1: accelerometer (Gs) (default: 0)
+ */
+PARAM_ADD(PARAM_UINT8, source, &source)
+PARAM_GROUP_STOP(vibration)
+
+/**
+ * Spectrum of the last window of SPECTRUM_SIZE IMU samples (256 ms). The band
+ * energies are the mean square of the signal in the bands 20-80, 80-160,
+ * 160-320 and 320-500 Hz, in (deg/s)^2 or Gs^2 depending on vibration.source.
+ * The peaks are the two largest spectral peaks above 20 Hz, largest first.
+ */
+LOG_GROUP_START(vibration)
+/**
+ * @brief Energy of the X axis in band 0 (20-80 Hz)
+ */
+LOG_ADD(LOG_FLOAT, xBand0, &results[0].bandEnergy[0])
+/**
+ * @brief Energy of the X axis in band 1 (80-160 Hz)
+ */
+LOG_ADD(LOG_FLOAT, xBand1, &results[0].bandEnergy[1])
+/**
+ * @brief Energy of the X axis in band 2 (160-320 Hz)
+ */
+LOG_ADD(LOG_FLOAT, xBand2, &results[0].bandEnergy[2])
+/**
+ * @brief Energy of the X axis in band 3 (320-500 Hz)
+ */
+LOG_ADD(LOG_FLOAT, xBand3, &results[0].bandEnergy[3])
+/**
+ * @brief Energy of the Y axis in band 0 (20-80 Hz)
+ */
+LOG_ADD(LOG_FLOAT, yBand0, &results[1].bandEnergy[0])
+/**
+ * @brief Energy of the Y axis in band 1 (80-160 Hz)
+ */
+LOG_ADD(LOG_FLOAT, yBand1, &results[1].bandEnergy[1])
+/**
+ * @brief Energy of the Y axis in band 2 (160-320 Hz)
+ */
+LOG_ADD(LOG_FLOAT, yBand2, &results[1].bandEnergy[2])
+/**
+ * @brief Energy of the Y axis in band 3 (320-500 Hz)
+ */
+LOG_ADD(LOG_FLOAT, yBand3, &results[1].bandEnergy[3])
+/**
+ * @brief Energy of the Z axis in band 0 (20-80 Hz)
+ */
+LOG_ADD(LOG_FLOAT, zBand0, &results[2].bandEnergy[0])
+/**
+ * @brief Energy of the Z axis in band 1 (80-160 Hz)
+ */
+LOG_ADD(LOG_FLOAT, zBand1, &results[2].bandEnergy[1])
+/**
+ * @brief Energy of the Z axis in band 2 (160-320 Hz)
+ */
+LOG_ADD(LOG_FLOAT, zBand2, &results[2].bandEnergy[2])
+/**
+ * @brief Energy of the Z axis in band 3 (320-500 Hz)
+ */
+LOG_ADD(LOG_FLOAT, zBand3, &results[2].bandEnergy[3])
+/**
+ * @brief Frequency of the largest peak of the X axis [Hz]
+ */
+LOG_ADD(LOG_FLOAT, xPeak0, &results[0].peaks[0].frequency)
+/**
+ * @brief Amplitude of the largest peak of the X axis
+ */
+LOG_ADD(LOG_FLOAT, xAmp0, &results[0].peaks[0].amplitude)
+/**
+ * @brief Frequency of the second largest peak of the X axis [Hz]
+ */
+LOG_ADD(LOG_FLOAT, xPeak1, &results[0].peaks[1].frequency)
+/**
+ * @brief Amplitude of the second largest peak of the X axis
+ */
+LOG_ADD(LOG_FLOAT, xAmp1, &results[0].peaks[1].amplitude)
+/**
+ * @brief Frequency of the largest peak of the Y axis [Hz]
+ */
+LOG_ADD(LOG_FLOAT, yPeak0, &results[1].peaks[0].frequency)
+/**
+ * @brief Amplitude of the largest peak of the Y axis
+ */
+LOG_ADD(LOG_FLOAT, yAmp0, &results[1].peaks[0].amplitude)
+/**
+ * @brief Frequency of the second largest peak of the Y axis [Hz]
+ */
+LOG_ADD(LOG_FLOAT, yPeak1, &results[1].peaks[1].frequency)
+/**
+ * @brief Amplitude of the second largest peak of the Y axis
+ */
+LOG_ADD(LOG_FLOAT, yAmp1, &results[1].peaks[1].amplitude)
+/**
+ * @brief Frequency of the largest peak of the Z axis [Hz]
+ */
+LOG_ADD(LOG_FLOAT, zPeak0, &results[2].peaks[0].frequency)
+/**
+ * @brief Amplitude of the largest peak of the Z axis
+ */
+LOG_ADD(LOG_FLOAT, zAmp0, &results[2].peaks[0].amplitude)
+/**
+ * @brief Frequency of the second largest peak of the Z axis [Hz]
+ */
+LOG_ADD(LOG_FLOAT, zPeak1, &results[2].peaks[1].frequency)
+/**
+ * @brief Amplitude of the second largest peak of the Z axis
+ */
+LOG_ADD(LOG_FLOAT, zAmp1, &results[2].peaks[1].amplitude)
+/**
+ * @brief Number of analyzed windows
+ */
+LOG_ADD(LOG_UINT32, windows, &windowCount)
+/**
+ * @brief Number of windows dropped because the task was busy
+ */
+LOG_ADD(LOG_UINT32, dropped, &droppedWindows)
+LOG_GROUP_STOP(vibration)
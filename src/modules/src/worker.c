@@ -33,17 +33,45 @@
 #include "queuemonitor.h"
 #include "static_mem.h"
 
+#include "config.h"
 #include "console.h"
+#include "log.h"
+#include "usec_time.h"
 
-#define WORKER_QUEUE_LENGTH 5
+#ifndef WORKER_QUEUE_LENGTH
+  #define WORKER_QUEUE_LENGTH 8
+#endif
+
+#ifndef WORKER_LOW_QUEUE_LENGTH
+  #define WORKER_LOW_QUEUE_LENGTH 4
+#endif
+
+#define WORKER_STATS_JOB_TYPES 12
 
 struct worker_work {
   void (*function)(void*);
   void* arg;
+  uint32_t scheduled; // us
+};
+
+struct worker_class_stats {
+  uint32_t drops;
+  uint32_t maxWait; // us
+  uint32_t maxRun;  // us
 };
 
 static xQueueHandle workerQueue;
 STATIC_MEM_QUEUE_ALLOC(workerQueue, WORKER_QUEUE_LENGTH, sizeof(struct worker_work));
+static xQueueHandle workerLowQueue;
+STATIC_MEM_QUEUE_ALLOC(workerLowQueue, WORKER_LOW_QUEUE_LENGTH, sizeof(struct worker_work));
+
+static void workerLowTask(void* param);
+STATIC_MEM_TASK_ALLOC(workerLowTask, WORKER_LOW_TASK_STACKSIZE);
+
+// Statistics, protected by a critical section as the two classes are run by
+// different tasks
+static workerJobStats_t jobStats[WORKER_STATS_JOB_TYPES];
+static struct worker_class_stats classStats[workerPriorityCount];
 
 void workerInit()
 {
@@ -52,11 +80,58 @@ void workerInit()
 
   workerQueue = STATIC_MEM_QUEUE_CREATE(workerQueue);
   DEBUG_QUEUE_MONITOR_REGISTER(workerQueue);
+  queueMonitorAddQueue(workerQueue, queueMonitorWorker);
+  workerLowQueue = STATIC_MEM_QUEUE_CREATE(workerLowQueue);
+  DEBUG_QUEUE_MONITOR_REGISTER(workerLowQueue);
+  queueMonitorAddQueue(workerLowQueue, queueMonitorWorker);
+
+  STATIC_MEM_TASK_CREATE(workerLowTask, workerLowTask, WORKER_LOW_TASK_NAME, NULL, WORKER_LOW_TASK_PRI);
 }
 
 bool workerTest()
 {
-  return (workerQueue != NULL);
+  return (workerQueue != NULL) && (workerLowQueue != NULL);
+}
+
+static void updateStats(const workerPriority_t priority, const struct worker_work* work, const uint32_t wait, const uint32_t run)
+{
+  taskENTER_CRITICAL();
+  struct worker_class_stats* class = &classStats[priority];
+  if (wait > class->maxWait)
+    class->maxWait = wait;
+  if (run > class->maxRun)
+    class->maxRun = run;
+
+  for (int i = 0; i < WORKER_STATS_JOB_TYPES; i++)
+  {
+    workerJobStats_t* stats = &jobStats[i];
+    if (stats->function == NULL)
+      stats->function = work->function;
+
+    if (stats->function == work->function)
+    {
+      stats->count++;
+      stats->totalRun += run;
+      if (run > stats->maxRun)
+        stats->maxRun = run;
+      if (wait > stats->maxWait)
+        stats->maxWait = wait;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL();
+}
+
+static void runWork(const workerPriority_t priority, const struct worker_work* work)
+{
+  if (!work->function)
+    return;
+
+  const uint32_t start = usecTimestamp();
+  work->function(work->arg);
+  const uint32_t end = usecTimestamp();
+
+  updateStats(priority, work, start - work->scheduled, end - start);
 }
 
 void workerLoop()
@@ -69,23 +144,88 @@ void workerLoop()
   while (1)
   {
     xQueueReceive(workerQueue, &work, portMAX_DELAY);
+    runWork(workerPriorityHigh, &work);
+  }
+}
 
-    if (work.function)
-      work.function(work.arg);
+static void workerLowTask(void* param)
+{
+  struct worker_work work;
+
+  while (1)
+  {
+    xQueueReceive(workerLowQueue, &work, portMAX_DELAY);
+    runWork(workerPriorityLow, &work);
   }
 }
 
-int workerSchedule(void (*function)(void*), void *arg)
+int workerScheduleWithPriority(const workerPriority_t priority, void (*function)(void*), void *arg)
 {
   struct worker_work work;
 
   if (!function)
     return ENOEXEC;
 
+  if (priority >= workerPriorityCount)
+    return EINVAL;
+
   work.function = function;
   work.arg = arg;
-  if (xQueueSend(workerQueue, &work, 0) == pdFALSE)
+  work.scheduled = usecTimestamp();
+
+  xQueueHandle queue = (priority == workerPriorityHigh) ? workerQueue : workerLowQueue;
+  if (xQueueSend(queue, &work, 0) == pdFALSE)
+  {
+    classStats[priority].drops++;
     return ENOMEM;
+  }
 
   return 0;
 }
+
+int workerSchedule(void (*function)(void*), void *arg)
+{
+  return workerScheduleWithPriority(workerPriorityHigh, function, arg);
+}
+
+bool workerGetJobStats(const int index, workerJobStats_t* stats)
+{
+  if (index < 0 || index >= WORKER_STATS_JOB_TYPES)
+    return false;
+
+  taskENTER_CRITICAL();
+  *stats = jobStats[index];
+  taskEXIT_CRITICAL();
+
+  return stats->function != NULL;
+}
+
+/**
+ * Worker statistics. Times are in us, the maximums are since startup.
+ */
+LOG_GROUP_START(worker)
+/**
+ * @brief Number of high priority jobs that were dropped because the queue was full
+ */
+LOG_ADD(LOG_UINT32, hiDrop, &classStats[workerPriorityHigh].drops)
+/**
+ * @brief Longest time a high priority job waited in the queue
+ */
+LOG_ADD(LOG_UINT32, hiMaxWait, &classStats[workerPriorityHigh].maxWait)
+/**
+ * @brief Longest run time of a high priority job
+ */
+LOG_ADD(LOG_UINT32, hiMaxRun, &classStats[workerPriorityHigh].maxRun)
+/**
+ * @brief Number of low priority jobs that were dropped because the queue was full
+ */
+LOG_ADD(LOG_UINT32, loDrop, &classStats[workerPriorityLow].drops)
+/**
+ * @brief Longest time a low priority job waited in the queue
+ */
+LOG_ADD(LOG_UINT32, loMaxWait, &classStats[workerPriorityLow].maxWait)
+/**
+ * @brief Longest run time of a low priority job
+ */
+LOG_ADD(LOG_UINT32, loMaxRun, &classStats[workerPriorityLow].maxRun)
+LOG_GROUP_STOP(worker)
@@ -99,6 +99,46 @@ static inline float clip1(float a) {
   return a;
 }
 
+/**
+ * @brief Fast approximation of atan2f() using a polynomial, max error 2e-6 rad compared to atan2()
+ */
+static inline float fastAtan2f(const float y, const float x) {
+  const float absX = fabsf(x);
+  const float absY = fabsf(y);
+  const float maxXY = MAX(absX, absY);
+  if (maxXY == 0.0f) {
+    return 0.0f;
+  }
+
+  const float a = MIN(absX, absY) / maxXY;
+  const float s = a * a;
+  float result = (((((-0.0117212f * s + 0.05265332f) * s - 0.11643287f) * s + 0.19354346f) * s - 0.33262347f) * s + 0.99997726f) * a;
+
+  if (absY > absX) {
+    result = (PI / 2.0f) - result;
+  }
+  if (x < 0.0f) {
+    result = PI - result;
+  }
+  if (y < 0.0f) {
+    result = -result;
+  }
+
+  return result;
+}
+
+/**
+ * @brief Fast approximation of asinf() using a polynomial, max error 3e-7 rad compared to asin().
+ *        The argument must be in the range [-1, 1], see clip1().
+ */
+static inline float fastAsinf(const float x) {
+  const float a = fabsf(x);
+  const float p = ((((((-0.0012624911f * a + 0.0066700901f) * a - 0.0170881256f) * a + 0.0308918810f) * a - 0.0501743046f) * a + 0.0889789874f) * a - 0.2145988016f) * a + 1.5707963050f;
+  const float result = (PI / 2.0f) - arm_sqrt(1.0f - a) * p;
+
+  return (x < 0.0f) ? -result : result;
+}
+
 static inline void mat_scale(const arm_matrix_instance_f32 * pSrcA, float32_t scale, arm_matrix_instance_f32 * pDst)
 { ASSERT(ARM_MATH_SUCCESS == arm_mat_scale_f32(pSrcA, scale, pDst)); }
 
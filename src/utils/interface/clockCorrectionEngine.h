@@ -32,13 +32,33 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Clock corrections are stored in fixed point with CLOCK_CORRECTION_FRACTION_BITS fractional bits, to avoid double
+// precision arithmetic (which is emulated in software on the Cortex-M4) when handling UWB packets.
+typedef int64_t clockCorrection_t;
+
+#define CLOCK_CORRECTION_FRACTION_BITS 44
+#define CLOCK_CORRECTION_ONE ((clockCorrection_t)1 << CLOCK_CORRECTION_FRACTION_BITS)
+#define CLOCK_CORRECTION_INVALID ((clockCorrection_t)-1)
+
+// Converts a constant to fixed point, intended for compile time constants
+#define CLOCK_CORRECTION_FIXED(value) ((clockCorrection_t)((value) * CLOCK_CORRECTION_ONE + 0.5))
+
 typedef struct {
-  double clockCorrection;
+  clockCorrection_t clockCorrection;
   unsigned int clockCorrectionBucket;
 } clockCorrectionStorage_t;
 
 double clockCorrectionEngineGet(const clockCorrectionStorage_t* storage);
+clockCorrection_t clockCorrectionEngineGetFixed(const clockCorrectionStorage_t* storage);
+float clockCorrectionEngineToFloat(const clockCorrection_t clockCorrection);
+clockCorrection_t clockCorrectionEngineFromDouble(const double clockCorrection);
+
 double clockCorrectionEngineCalculate(const uint64_t new_t_in_cl_reference, const uint64_t old_t_in_cl_reference, const uint64_t new_t_in_cl_x, const uint64_t old_t_in_cl_x, const uint64_t mask);
+clockCorrection_t clockCorrectionEngineCalculateFixed(const uint64_t new_t_in_cl_reference, const uint64_t old_t_in_cl_reference, const uint64_t new_t_in_cl_x, const uint64_t old_t_in_cl_x, const uint64_t mask);
+
 bool clockCorrectionEngineUpdate(clockCorrectionStorage_t* storage, const double clockCorrectionCandidate);
+bool clockCorrectionEngineUpdateFixed(clockCorrectionStorage_t* storage, const clockCorrection_t clockCorrectionCandidate);
+
+int64_t clockCorrectionEngineApply(const clockCorrection_t clockCorrection, const int64_t ticks);
 
 #endif /* clockCorrectionEngine_h */
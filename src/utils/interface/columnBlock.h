@@ -0,0 +1,99 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * columnBlock.h - column oriented, delta encoded blocks of log samples
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Event id, number of samples and body size, all uint16
+#define COLUMN_BLOCK_HEADER_SIZE 6
+// CRC32 of the header and the body
+#define COLUMN_BLOCK_CRC_SIZE 4
+
+/**
+ * @brief The fixed part of a block
+ */
+typedef struct {
+  uint16_t eventId;
+  uint16_t numRows;
+  uint16_t bodySize;
+} columnBlockHeader_t;
+
+/**
+ * @brief Size of one sample when stored as a row: a uint64 timestamp followed
+ * by the packed values described by format.
+ *
+ * @param format One type character per value, using the python struct
+ * characters B, b, H, h, I, i and f
+ * @return The row size in bytes, or 0 if the format contains an unknown type
+ */
+uint16_t columnBlockRowSize(const char* format);
+
+/**
+ * @brief Upper bound for the size of an encoded block, header and CRC included
+ */
+uint32_t columnBlockMaxSize(const char* format, uint16_t numRows);
+
+/**
+ * @brief Encode samples into a block
+ *
+ * Values are stored column by column. The timestamps and the integer columns
+ * are stored as zigzag encoded varint deltas to the previous sample, floats
+ * are stored as they are.
+ *
+ * @param output Destination of the block
+ * @param capacity Size of the destination
+ * @param length Set to the size of the block
+ * @param eventId Id of the event the samples belong to
+ * @param format The types of the values, see columnBlockRowSize()
+ * @param rows The samples, stored as rows
+ * @param numRows Number of samples
+ * @return 0 on success, ENOSPC if the block does not fit in the output or
+ * EINVAL if the format is invalid
+ */
+int columnBlockEncode(uint8_t* output, uint32_t capacity, uint32_t* length, uint16_t eventId, const char* format, const uint8_t* rows, uint16_t numRows);
+
+/**
+ * @brief Read the header of the block at the start of input
+ *
+ * @return 0 on success, EINVAL if input is shorter than the block or the CRC
+ * does not match
+ */
+int columnBlockParseHeader(const uint8_t* input, uint32_t length, columnBlockHeader_t* header);
+
+/**
+ * @brief Decode a block into rows, the layout used by columnBlockEncode()
+ *
+ * @param input The block, checked with columnBlockParseHeader()
+ * @param header The parsed header
+ * @param format The types of the values of the event
+ * @param rows Destination of the samples
+ * @param maxRows Number of rows that fit in the destination
+ * @return 0 on success, ENOSPC if the block holds more than maxRows samples or
+ * EINVAL if the body does not match the format
+ */
+int columnBlockDecode(const uint8_t* input, const columnBlockHeader_t* header, const char* format, uint8_t* rows, uint16_t maxRows);
@@ -0,0 +1,71 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dshot.h - Encoding of DShot frames for digital ESCs
+ *
+ * A DShot frame is 16 bits sent MSB first: an 11 bit value, a telemetry
+ * request bit and a 4 bit checksum. Values 1 to 47 are commands, 48 to 2047
+ * throttle and 0 stops the motor. Each bit is a pulse of constant period where
+ * a one is high for 3/4 of the period and a zero for 3/8 of it.
+ */
+
+#ifndef __DSHOT_H__
+#define __DSHOT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DSHOT_FRAME_BITS 16
+#define DSHOT_THROTTLE_MIN 48
+#define DSHOT_THROTTLE_MAX 2047
+
+/**
+ * Convert a motor ratio to a DShot throttle value. 0 stops the motor, other
+ * ratios are scaled to the throttle range 48 to 2047.
+ *
+ * @param ratio  Motor ratio, 0 to 0xFFFF
+ * @return The DShot throttle value
+ */
+uint16_t dshotThrottleFromRatio(const uint16_t ratio);
+
+/**
+ * Build a DShot frame with the checksum.
+ *
+ * @param value  The throttle value or command, 11 bits
+ * @param telemetryRequest  Set the telemetry request bit
+ * @return The 16 bit frame
+ */
+uint16_t dshotFrame(const uint16_t value, const bool telemetryRequest);
+
+/**
+ * Convert a frame to the timer compare values of its 16 bits, MSB first.
+ *
+ * @param frame  The frame
+ * @param compare  Array to write the compare values to, DSHOT_FRAME_BITS * stride long
+ * @param stride  Distance between the compare values of two bits, to interleave the frames of several channels
+ * @param zeroHigh  Compare value of a zero bit
+ * @param oneHigh  Compare value of a one bit
+ */
+void dshotFrameToCompare(const uint16_t frame, uint32_t* compare, const int stride, const uint32_t zeroHigh, const uint32_t oneHigh);
+
+#endif // __DSHOT_H__
@@ -22,6 +22,11 @@
  */
 typedef int (*putc_t)(int c);
 
+/**
+ * Write function pointer definition, writes len characters from data
+ */
+typedef int (*putb_t)(const char* data, int len);
+
 /**
  * Light printf implementation
  * @param[in] putcf Putchar function to be used by Printf
@@ -41,4 +46,25 @@ int eprintf(putc_t putcf, const char * fmt, ...)
  */
 int evprintf(putc_t putcf, const char * fmt, va_list ap);
 
+/**
+ * Light printf implementation that formats into a small buffer on the stack
+ * and writes it in chunks, for outputs where every write has a cost
+ * @param[in] putbf Write function to be used by Printf
+ * @param[in] fmt Format string
+ * @param[in] ... Parameters to print
+ * @return the number of character printed
+ */
+int ebprintf(putb_t putbf, const char * fmt, ...)
+    __attribute__ (( format(printf, 2, 3) ));
+
+/**
+ * Light printf implementation that formats into a small buffer on the stack
+ * and writes it in chunks, for outputs where every write has a cost
+ * @param[in] putbf Write function to be used by Printf
+ * @param[in] fmt Format string
+ * @param[in] ap Parameters to print
+ * @return the number of character printed
+ */
+int evbprintf(putb_t putbf, const char * fmt, va_list ap);
+
 #endif //__EPRINTF_H__
@@ -0,0 +1,99 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * fastmath.h - Fast single precision math functions for the control loops
+ *
+ * Replacements for the libm functions used every tick by the controllers and
+ * estimators. They are polynomial approximations without branches on special
+ * values (NaN and infinity are not handled). The error bounds below are the
+ * absolute errors measured against the double precision libm functions, and
+ * are checked by test_fastmath.c.
+ *
+ * sqrtf() is not included, with -fno-math-errno it compiles to the FPU square
+ * root instruction, which is both fast and exact.
+ */
+
+#ifndef __FASTMATH_H__
+#define __FASTMATH_H__
+
+/**
+ * Sine and cosine of an angle, computed together.
+ * Error < 3e-7 for |x| <= 100 rad, growing slowly with |x| after that.
+ *
+ * @param x  Angle (rad)
+ * @param s  Sine of x
+ * @param c  Cosine of x
+ */
+void fastSinCos(float x, float *s, float *c);
+
+/**
+ * Sine of an angle, same error as fastSinCos().
+ */
+float fastSin(float x);
+
+/**
+ * Cosine of an angle, same error as fastSinCos().
+ */
+float fastCos(float x);
+
+/**
+ * Four-quadrant arc tangent of y/x. Error < 4e-7 rad.
+ * Returns 0 when both x and y are 0.
+ *
+ * @return Angle in the range [-pi, pi] (rad)
+ */
+float fastAtan2(float y, float x);
+
+/**
+ * Arc sine. The argument is clamped to [-1, 1]. Error < 5e-7 rad.
+ *
+ * @return Angle in the range [-pi/2, pi/2] (rad)
+ */
+float fastAsin(float x);
+
+/**
+ * Reciprocal square root. This is 1/sqrtf(x) with the FPU square root and
+ * divide, which is as fast as the bit manipulation approximation and exact.
+ * Returns 0 for x <= 0, normalizing a zero vector gives a zero vector.
+ */
+float fastInvSqrt(float x);
+
+/**
+ * Convert a quaternion to roll, pitch, yaw Euler angles (Tait-Bryan, yaw then
+ * pitch then roll), using fastAtan2() and fastAsin().
+ *
+ * @param q  Quaternion as (x, y, z, w)
+ * @param rpy  Roll, pitch and yaw (rad)
+ */
+void fastQuatToRpy(const float q[4], float rpy[3]);
+
+/**
+ * Convert roll, pitch, yaw Euler angles (Tait-Bryan, yaw then pitch then
+ * roll) to a quaternion, using fastSinCos().
+ *
+ * @param rpy  Roll, pitch and yaw (rad)
+ * @param q  Quaternion as (x, y, z, w)
+ */
+void fastRpyToQuat(const float rpy[3], float q[4]);
+
+#endif // __FASTMATH_H__
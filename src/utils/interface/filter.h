@@ -47,6 +47,45 @@ void lpf2pSetCutoffFreq(lpf2pData* lpfData, float sample_freq, float cutoff_freq
 float lpf2pApply(lpf2pData* lpfData, float sample);
 float lpf2pReset(lpf2pData* lpfData, float sample);
 
+/**
+ * A biquad filter for the three axes of a vector. The coefficients are shared
+ * by the axes and the state is kept per axis, so the three axes are filtered
+ * in one pass without reloading the coefficients.
+ */
+typedef struct {
+  float a1;
+  float a2;
+  float b0;
+  float b1;
+  float b2;
+  float delay_element_1[3];
+  float delay_element_2[3];
+} biquad3Data;
+
+/**
+ * Initialize as a second order Butterworth low pass filter, the same filter
+ * as lpf2p
+ */
+void biquad3InitLpf(biquad3Data* data, float sample_freq, float cutoff_freq);
+
+/**
+ * Initialize as a notch filter
+ *
+ * @param center_freq The frequency to remove
+ * @param q Quality factor, the -3 dB bandwidth is center_freq / q
+ */
+void biquad3InitNotch(biquad3Data* data, float sample_freq, float center_freq, float q);
+
+/**
+ * Move the notch of a notch filter without resetting its state
+ */
+void biquad3SetNotchFreq(biquad3Data* data, float sample_freq, float center_freq, float q);
+
+/**
+ * Filter the three values in place
+ */
+void biquad3Apply(biquad3Data* data, float values[3]);
+
 /** Second order low pass filter structure.
  *
  * using biquad filter with bilinear z transform
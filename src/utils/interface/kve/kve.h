@@ -35,6 +35,22 @@
 
 void kveDefrag(kveMemory_t *kve);
 
+/**
+ * Moves one item into the first hole of the table, repeated until about
+ * budget bytes have been moved. Used to compact the memory in small steps
+ * instead of one long kveDefrag() when the memory is full.
+ *
+ * @return true if there may be more to compact, false if the table is compact.
+ */
+bool kveDefragStep(kveMemory_t *kve, size_t budget);
+
+/**
+ * Builds the index of the items, if the memory has one. Must be called
+ * before the other functions are used, and after the memory has been
+ * changed by other means.
+ */
+void kveIndexBuild(kveMemory_t *kve);
+
 bool kveStore(kveMemory_t *kve, char* key, const void* buffer, size_t length);
 
 size_t kveFetch(kveMemory_t *kve, const char* key, void* buffer, size_t bufferLength);
@@ -44,3 +60,16 @@ bool kveDelete(kveMemory_t *kve, char* key);
 void kveFormat(kveMemory_t *kve);
 
 bool kveCheck(kveMemory_t *kve);
+
+/**
+ * Called by kveForeach() for each item. The buffer holds the start of the
+ * item data, length is the number of bytes that were read.
+ * Return false to stop the iteration.
+ */
+typedef bool (*kveFunc_t)(const char* key, void* buffer, size_t length);
+
+/**
+ * Calls func for each item with a key that starts with prefix, walking the
+ * table once. Up to bufferLength bytes of the data are read into buffer.
+ */
+void kveForeach(kveMemory_t *kve, const char* prefix, void* buffer, size_t bufferLength, kveFunc_t func);
@@ -29,10 +29,31 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint16_t hash;
+    uint16_t address;
+} kveIndexEntry_t;
+
+/**
+ * RAM index of the items in the table, a hash of the key and the address of
+ * each item. Keys are found without scanning the memory, the hash only has
+ * to be confirmed by reading the key of the item. If the index is not valid,
+ * for example when there are more items than entries, the memory is scanned.
+ */
+typedef struct {
+    kveIndexEntry_t* entries;
+    uint16_t size;
+    uint16_t count;
+    bool valid;
+} kveIndex_t;
 
 typedef struct {
     size_t memorySize;
     size_t (*read)(size_t address, void* data, size_t length);
     size_t (*write)(size_t address, const void* data, size_t length);
     void (*flush)(void);
+    kveIndex_t* index; // Optional, NULL if the memory is not indexed
 } kveMemory_t;
@@ -108,4 +108,13 @@ size_t kveStorageGetBufferLength(kveItemHeader_t header);
 
 size_t kveStorageGetKey(kveMemory_t *kve, size_t address, kveItemHeader_t header, char* key, size_t maxLength);
 
-size_t kveStorageGetBuffer(kveMemory_t *kve, size_t address, kveItemHeader_t header, void* buffer, size_t maxLength);
\ No newline at end of file
+size_t kveStorageGetBuffer(kveMemory_t *kve, size_t address, kveItemHeader_t header, void* buffer, size_t maxLength);
+
+/** Hash of a key, as used in the index */
+uint16_t kveStorageKeyHash(const char* key, size_t length);
+
+/** Add or update the index entry of the item at address */
+void kveStorageIndexSet(kveMemory_t *kve, size_t address, uint16_t hash);
+
+/** Remove the index entry of the item at address, if any */
+void kveStorageIndexRemove(kveMemory_t *kve, size_t address);
\ No newline at end of file
@@ -45,6 +45,31 @@ void lighthouseCalibrationApplyV1(const lighthouseCalibration_t* calib, const fl
  */
 void lighthouseCalibrationApplyV2(const lighthouseCalibration_t* calib, const float* rawAngles, float* correctedAngles);
 
+// Max number of angle pairs in one call to the batch functions
+#define LIGHTHOUSE_CALIBRATION_MAX_BATCH 8
+
+/**
+ * @brief Apply basestation calibration to a batch of angle pairs for LH 1, typically all sensors of a frame.
+ *        Uses the fast approximations of the batch measurement model.
+ *
+ * @param calib Calibration object to use
+ * @param rawAngles Angle pairs measured
+ * @param correctedAngles Angle pairs after applying calibration
+ * @param count The number of angle pairs, max LIGHTHOUSE_CALIBRATION_MAX_BATCH
+ */
+void lighthouseCalibrationApplyV1Batch(const lighthouseCalibration_t* calib, const float rawAngles[][2], float correctedAngles[][2], const int count);
+
+/**
+ * @brief Apply basestation calibration to a batch of angle pairs for LH 2, typically all sensors of a frame.
+ *        Uses the fast approximations of the batch measurement model.
+ *
+ * @param calib Calibration object to use
+ * @param rawAngles Angle pairs measured
+ * @param correctedAngles Angle pairs after applying calibration
+ * @param count The number of angle pairs, max LIGHTHOUSE_CALIBRATION_MAX_BATCH
+ */
+void lighthouseCalibrationApplyV2Batch(const lighthouseCalibration_t* calib, const float rawAngles[][2], float correctedAngles[][2], const int count);
+
 /**
  * @brief Apply no basestation calibration to the two received angles, that is copy the raw angles
  *
@@ -53,37 +78,80 @@ void lighthouseCalibrationApplyV2(const lighthouseCalibration_t* calib, const fl
  */
 void lighthouseCalibrationApplyNothing(const float rawAngles[2], float correctedAngles[2]);
 
+/**
+ * @brief Constants of the measurement model for one rotor, derived from the tilt of the light plane and the calibration
+ * data. Only changes when the calibration data changes and is computed by lighthouseCalibrationInitModelConstants().
+ */
+typedef struct {
+  float tanT;     // tan(t), t is the tilt of the light plane
+  float tanTilt;  // tan(t - calib->tilt), the tilt of the light plane including the calibrated tilt
+} lighthouseCalibrationModelConstants_t;
+
+/**
+ * @brief Compute the measurement model constants for a rotor
+ * @param constants The constants to initialize
+ * @param t Tilt of the light plane in radians, 0 for lighthouse 1 rotors
+ * @param calib Calibration data for the rotor
+ */
+void lighthouseCalibrationInitModelConstants(lighthouseCalibrationModelConstants_t* constants, const float t, const lighthouseCalibrationSweep_t* calib);
+
 /**
  * @brief Generic function pointer type for a calibration measurement model.
  *        Predict the measured sweep angle based on a position for a lighthouse rotor. The position is relative to the rotor reference frame.
  * @param x meters
  * @param y meters
  * @param z meters
- * @param t Tilt of the light plane in radians
+ * @param constants Measurement model constants for the rotor
  * @param calib Calibration data for the rotor
  * @return float The predicted uncompensated sweep angle of the rotor
  *
  */
-typedef float (*lighthouseCalibrationMeasurementModel_t)(const float x, const float y, const float z, const float t, const lighthouseCalibrationSweep_t* calib);
+typedef float (*lighthouseCalibrationMeasurementModel_t)(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib);
 
 /**
  * @brief Predict the measured sweep angle based on a position for a lighthouse 1 rotor. The position is relative to the rotor reference frame.
  * @param x meters
  * @param y meters
  * @param z meters
- * @param t Tilt of the light plane in radians - not used in LH1, will always use 0
+ * @param constants Measurement model constants for the rotor, initialized with t = 0
  * @param calib Calibration data for the rotor
  * @return float The predicted uncompensated sweep angle of the rotor
  */
-float lighthouseCalibrationMeasurementModelLh1(const float x, const float y, const float z, const float t, const lighthouseCalibrationSweep_t* calib);
+float lighthouseCalibrationMeasurementModelLh1(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib);
 
 /**
  * @brief Predict the measured sweep angle based on a position for a lighthouse 2 rotor. The position is relative to the rotor reference frame.
  * @param x meters
  * @param y meters
  * @param z meters
- * @param t Tilt of the light plane in radians
+ * @param constants Measurement model constants for the rotor
  * @param calib Calibration data for the rotor
  * @return float The predicted uncompensated sweep angle of the rotor
  */
-float lighthouseCalibrationMeasurementModelLh2(const float x, const float y, const float z, const float t, const lighthouseCalibrationSweep_t* calib);
+float lighthouseCalibrationMeasurementModelLh2(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib);
+
+/**
+ * @brief Batch version of lighthouseCalibrationMeasurementModelLh1(), for instance for all sensors of a frame. Uses
+ *        polynomial approximations of the trigonometric functions, the error compared to the scalar version is below 1e-5 rad.
+ * @param x Array of x coordinates (meters)
+ * @param y Array of y coordinates (meters)
+ * @param z Array of z coordinates (meters)
+ * @param count The number of positions
+ * @param constants Measurement model constants for the rotor, initialized with t = 0
+ * @param calib Calibration data for the rotor
+ * @param predicted Array for the count predicted uncompensated sweep angles
+ */
+void lighthouseCalibrationMeasurementModelLh1Batch(const float* x, const float* y, const float* z, const int count, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib, float* predicted);
+
+/**
+ * @brief Batch version of lighthouseCalibrationMeasurementModelLh2(), for instance for all sensors of a frame. Uses
+ *        polynomial approximations of the trigonometric functions, the error compared to the scalar version is below 1e-5 rad.
+ * @param x Array of x coordinates (meters)
+ * @param y Array of y coordinates (meters)
+ * @param z Array of z coordinates (meters)
+ * @param count The number of positions
+ * @param constants Measurement model constants for the rotor
+ * @param calib Calibration data for the rotor
+ * @param predicted Array for the count predicted uncompensated sweep angles
+ */
+void lighthouseCalibrationMeasurementModelLh2Batch(const float* x, const float* y, const float* z, const int count, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib, float* predicted);
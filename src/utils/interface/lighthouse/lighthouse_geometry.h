@@ -27,6 +27,19 @@ typedef struct {
  */
 bool lighthouseGeometryGetPositionFromRayIntersection(const baseStationGeometry_t baseStations[2], float angles1[2], float angles2[2], vec3d position, float *position_delta);
 
+/**
+ * @brief Find the point closest to a number of rays, in the least squares sense. The rays may come from any number
+ * of base stations. No memory is allocated, the work is a 3x3 system regardless of the number of rays.
+ *
+ * @param origins - the points the rays originate from
+ * @param rays - normalized vectors in the direction of the rays
+ * @param count - the number of rays, at least 2
+ * @param position - (output) the point that minimizes the sum of the squared distances to the rays
+ * @param position_delta - (output) the RMS distance from the position to the rays
+ * @return true if the position could be calculated, false if there are too few rays or they are parallel
+ */
+bool lighthouseGeometryGetPositionFromRays(const vec3d origins[], const vec3d rays[], const int count, vec3d position, float *position_delta);
+
 /**
  * @brief Get the base station position from the base station geometry in world reference frame. This position can be seen as the
  * point where the lazers originate from.
@@ -36,11 +36,30 @@
 #include "lighthouse_calibration.h"
 #include "lighthouse_geometry.h"
 
+// The maximum number of base stations that can be used in the system. LH1 systems are limited to 2 base stations,
+// LH2 systems can use up to 16 channels. Base station state is statically allocated, set the size
+// in config.mk with CFLAGS += -DLIGHTHOUSE_MAX_N_BS=<n>
+#ifndef LIGHTHOUSE_MAX_N_BS
+#define LIGHTHOUSE_MAX_N_BS 4
+#endif
+
+#if LIGHTHOUSE_MAX_N_BS < 2
+#error "At least 2 base stations must be supported"
+#endif
+
+#if LIGHTHOUSE_MAX_N_BS > 16
+#error "Maximum 16 base stations are supported, base station bitmaps are 16 bits"
+#endif
+
 #define PULSE_PROCESSOR_N_SWEEPS 2
-#define PULSE_PROCESSOR_N_BASE_STATIONS 2
+#define PULSE_PROCESSOR_N_BASE_STATIONS LIGHTHOUSE_MAX_N_BS
+#define PULSE_PROCESSOR_V1_N_BASE_STATIONS 2
 #define PULSE_PROCESSOR_N_SENSORS 4
 #define PULSE_PROCRSSOR_N_CONCURRENT_BLOCKS 2
 #define PULSE_PROCESSOR_N_WORKSPACE (PULSE_PROCESSOR_N_SENSORS * PULSE_PROCRSSOR_N_CONCURRENT_BLOCKS)
+#if PULSE_PROCESSOR_N_WORKSPACE > 16
+#error "Maximum 16 workspace slots are supported, workspace bit masks are 16 bits"
+#endif
 
 #define PULSE_PROCESSOR_HISTORY_LENGTH 8
 #define PULSE_PROCESSOR_TIMESTAMP_BITWIDTH 24
@@ -164,10 +183,17 @@ typedef struct {
 /**
  * @brief Raw pulse data from the sensors. Data for pulses that are close in time and probably
  * comes from the same sweep. May contain pulse data from multiple base stations.
+ * Only the fields used when decoding blocks are stored, one array per field. Slots with a channel and
+ * slots with an offset are tracked in bit masks, bit n for slot n.
  *
  */
 typedef struct {
-    pulseProcessorFrame_t slots[PULSE_PROCESSOR_N_WORKSPACE];
+    uint32_t timestamp[PULSE_PROCESSOR_N_WORKSPACE];
+    uint32_t offset[PULSE_PROCESSOR_N_WORKSPACE];
+    uint8_t sensor[PULSE_PROCESSOR_N_WORKSPACE];
+    uint8_t channel[PULSE_PROCESSOR_N_WORKSPACE]; // Valid if the bit in channelFoundMask is set
+    uint16_t channelFoundMask;
+    uint16_t offsetMask;
     int slotsUsed;
     uint32_t latestTimestamp;
 } pulseProcessorV2PulseWorkspace_t;
@@ -203,6 +229,9 @@ typedef struct {
 
   // Timestamp of the rotor zero position for the latest processed slowbit
   uint32_t ootxTimestamps[PULSE_PROCESSOR_N_BASE_STATIONS];
+
+  // The base station to check for stale angles next, one base station is checked per frame
+  uint8_t staleCheckBaseStation;
 } pulseProcessorV2_t;
 
 typedef struct pulseProcessor_s {
@@ -223,6 +252,10 @@ typedef struct pulseProcessor_s {
   baseStationGeometry_t bsGeometry[PULSE_PROCESSOR_N_BASE_STATIONS];
   baseStationGeometryCache_t bsGeoCache[PULSE_PROCESSOR_N_BASE_STATIONS];
 
+  // Measurement model constants for each rotor, updated when the calibration data is written
+  lighthouseCalibrationModelConstants_t bsModelConstantsLh1[PULSE_PROCESSOR_N_BASE_STATIONS][PULSE_PROCESSOR_N_SWEEPS];
+  lighthouseCalibrationModelConstants_t bsModelConstantsLh2[PULSE_PROCESSOR_N_BASE_STATIONS][PULSE_PROCESSOR_N_SWEEPS];
+
   // Health check data
   uint32_t healthFirstSensorTs;
   uint8_t healthSensorBitField;
@@ -0,0 +1,75 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * lz4Stream.h - incremental decoder for the LZ4 block format
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief State of an LZ4 block that is decoded while it is received.
+ *
+ * The input can be split at any byte. Matches are copied from the output that
+ * has already been decoded, so no other history buffer is needed.
+ */
+typedef struct {
+  uint8_t* output;
+  uint32_t capacity;
+  uint32_t length;   // Number of bytes decoded
+
+  uint8_t state;
+  uint32_t literals; // Literals left to copy in the current sequence
+  uint32_t matchLength;
+  uint16_t matchOffset;
+  int error;
+} lz4Stream_t;
+
+/**
+ * @brief Start decoding a new block
+ *
+ * @param stream The decoder state
+ * @param output Destination of the decoded data
+ * @param capacity Size of the destination
+ */
+void lz4StreamInit(lz4Stream_t* stream, uint8_t* output, uint32_t capacity);
+
+/**
+ * @brief Decode the next part of the block
+ *
+ * @param stream The decoder state
+ * @param input Compressed data
+ * @param length Number of bytes in input
+ * @return 0 on success, ENOSPC if the output is full or EINVAL if the data is
+ * corrupt. The error is kept until the decoder is initialized again.
+ */
+int lz4StreamDecode(lz4Stream_t* stream, const uint8_t* input, uint32_t length);
+
+/**
+ * @brief Check if the data decoded so far ends at a sequence boundary, that
+ * is, if it can be a complete block.
+ */
+bool lz4StreamIsComplete(const lz4Stream_t* stream);
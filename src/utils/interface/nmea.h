@@ -0,0 +1,101 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ * nmea.h - Incremental NMEA 0183 parser
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NMEA_MAX_FIELD_LENGTH 16
+
+typedef enum {
+  nmeaSentenceNone = 0,
+  nmeaSentenceGga,
+  nmeaSentenceGsa,
+} nmeaSentence_t;
+
+// Data of a GGA sentence, the fix
+typedef struct {
+  uint32_t fixTime;       // UTC time of the fix, hhmmss
+  int32_t latitude;       // 1e-7 degrees, positive north
+  int32_t longitude;      // 1e-7 degrees, positive east
+  uint8_t fixQuality;     // 0 = no fix, 1 = GPS, 2 = DGPS...
+  uint8_t nsat;           // Number of satellites in use
+  float hdop;
+  float altitude;         // Above mean sea level, m
+  float geoidSeparation;  // m
+} nmeaGga_t;
+
+// Data of a GSA sentence, the DOP and active satellites
+typedef struct {
+  uint8_t fix;            // 1 = no fix, 2 = 2D, 3 = 3D
+  uint8_t nsat;           // Number of satellites used in the fix
+  float pdop;
+  float hdop;
+  float vdop;
+} nmeaGsa_t;
+
+/**
+ * @brief Parser state. The checksum is computed and the fields are converted
+ * as the characters arrive, no sentence buffer is kept.
+ */
+typedef struct {
+  uint8_t state;
+  uint8_t checksum;
+  uint8_t receivedChecksum;
+  uint8_t checksumDigits;
+  nmeaSentence_t sentence;
+  uint8_t field;
+
+  // The value of the current field
+  char text[NMEA_MAX_FIELD_LENGTH];
+  uint8_t textLength;
+
+  // Values of the sentence being parsed, copied to the results when the
+  // checksum is verified
+  union {
+    nmeaGga_t gga;
+    nmeaGsa_t gsa;
+  } pending;
+
+  nmeaGga_t gga;
+  nmeaGsa_t gsa;
+
+  uint32_t checksumErrors;
+} nmeaParser_t;
+
+void nmeaParserInit(nmeaParser_t* parser);
+
+/**
+ * @brief Feed one character to the parser.
+ *
+ * @return The type of the sentence that was completed by this character, with a
+ * valid checksum. The result is in parser->gga or parser->gsa. nmeaSentenceNone
+ * otherwise, or for unsupported sentences.
+ */
+nmeaSentence_t nmeaParse(nmeaParser_t* parser, const char ch);
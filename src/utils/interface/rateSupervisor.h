@@ -30,6 +30,26 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Jitter histogram, bucket n holds deviations below 2^n us
+#define RATE_SUPERVISOR_JITTER_BUCKETS 16
+// Supervisors that can be registered, see rateSupervisorRegister()
+#define RATE_SUPERVISOR_MAX_REGISTERED 16
+
+/**
+ * Statistics of a supervisor, updated at every evaluation. The jitter is the
+ * deviation of the time between two calls from the expected period, given as
+ * the upper bound of its histogram bucket, that is within a factor 2.
+ */
+typedef struct {
+    uint16_t rate;      // Calls per second in the latest evaluation interval
+    uint16_t jitterP50; // us
+    uint16_t jitterP95; // us
+    uint16_t jitterP99; // us
+    uint32_t missed;    // Calls short of the expected count, since startup
+    uint32_t failures;  // Evaluations out of bounds, since startup
+    bool ok;            // The latest evaluation was within bounds
+} rateSupervisorStats_t;
+
 typedef struct {
     uint32_t count;
     uint32_t expectedMin;
@@ -38,10 +58,20 @@ typedef struct {
     uint32_t evaluationIntervalMs;
     uint32_t latestCount;
     uint8_t skip;
+
+    // Statistics, see rateSupervisorTick()
+    const char* name;
+    uint32_t expectedCount;
+    uint32_t expectedPeriodUs;
+    uint32_t previousTimeUs;
+    bool hasPreviousTime;
+    uint16_t jitterHistogram[RATE_SUPERVISOR_JITTER_BUCKETS];
+    rateSupervisorStats_t stats;
 } rateSupervisor_t;
 
 /**
- * @brief Initialize a rateSupervisor_t struct for rate measurements
+ * @brief Initialize a rateSupervisor_t struct for rate measurements. The statistics since startup are kept, a
+ * supervisor can be initialized again when the expected rate changes.
  *
  * @param context The struct to initialize
  * @param osTimeMs The current os time in ms
@@ -52,6 +82,17 @@ typedef struct {
  */
 void rateSupervisorInit(rateSupervisor_t* context, const uint32_t osTimeMs, const uint32_t evaluationIntervalMs, const uint32_t minCount, const uint32_t maxCount, const uint8_t skip);
 
+/**
+ * @brief Initialize a rateSupervisor_t struct that is evaluated every second, from the expected rate and tolerance
+ *
+ * @param context The struct to initialize
+ * @param osTimeMs The current os time in ms
+ * @param expectedRate The expected rate in Hz, 0 to only measure the rate of an event driven process
+ * @param tolerancePermille Allowed deviation from the expected rate, in 1/1000 of the rate
+ * @param skip The number of inital evaluations to ignore failures for
+ */
+void rateSupervisorInitRate(rateSupervisor_t* context, const uint32_t osTimeMs, const uint16_t expectedRate, const uint16_t tolerancePermille, const uint8_t skip);
+
 /**
  * @brief Validate the rate for a process. This function should be called from the process for which the rate
  * is to be supervised. When the function is called a counter is increased, and if the evaluation period
@@ -64,6 +105,17 @@ void rateSupervisorInit(rateSupervisor_t* context, const uint32_t osTimeMs, cons
  */
 bool rateSupervisorValidate(rateSupervisor_t* context, const uint32_t osTimeMs);
 
+/**
+ * @brief Validate the rate as rateSupervisorValidate(), and measure the jitter of the period
+ *
+ * @param context A rateSupervisor_t
+ * @param osTimeMs The current os time in ms
+ * @param timeUs A time stamp in us, for the jitter
+ * @return true if the measured rate is within bounds, or we have not yet reached the next evaluation time
+ * @return false if the measured rate is too low or high
+ */
+bool rateSupervisorTick(rateSupervisor_t* context, const uint32_t osTimeMs, const uint32_t timeUs);
+
 /**
  * @brief Get the latest count. Useful to display the count after a failed validation.
  *
@@ -71,3 +123,46 @@ bool rateSupervisorValidate(rateSupervisor_t* context, const uint32_t osTimeMs);
  * @return uint32_t The count at the latest evaluation time
  */
 uint32_t rateSupervisorLatestCount(rateSupervisor_t* context);
+
+/**
+ * @brief Get the statistics of a supervisor
+ *
+ * @param context A rateSupervisor_t
+ * @return The statistics at the latest evaluation time
+ */
+const rateSupervisorStats_t* rateSupervisorStats(const rateSupervisor_t* context);
+
+/**
+ * @brief Add a supervisor to the registry of supervised processes, that is read as a whole by the rate health
+ * report. A supervisor is registered once, before or after it is initialized.
+ *
+ * @param context A rateSupervisor_t
+ * @param name Name of the process, the string is not copied
+ * @return true if the supervisor was registered, false if the registry is full
+ */
+bool rateSupervisorRegister(rateSupervisor_t* context, const char* name);
+
+/**
+ * @brief Number of registered supervisors
+ */
+int rateSupervisorRegisteredCount(void);
+
+/**
+ * @brief Get a registered supervisor
+ *
+ * @param index Index in the registry, in the order of registration
+ * @return The supervisor, or 0 if the index is out of range
+ */
+const rateSupervisor_t* rateSupervisorRegistered(const int index);
+
+/**
+ * Log group with the statistics of a supervisor, to be used in a file that includes log.h.
+ */
+#define RATE_SUPERVISOR_LOG_GROUP(NAME, CONTEXT) \
+  LOG_GROUP_START(NAME) \
+  LOG_ADD(LOG_UINT16, rate, &(CONTEXT).stats.rate) \
+  LOG_ADD(LOG_UINT16, jitP50, &(CONTEXT).stats.jitterP50) \
+  LOG_ADD(LOG_UINT16, jitP95, &(CONTEXT).stats.jitterP95) \
+  LOG_ADD(LOG_UINT16, jitP99, &(CONTEXT).stats.jitterP99) \
+  LOG_ADD(LOG_UINT32, missed, &(CONTEXT).stats.missed) \
+  LOG_GROUP_STOP(NAME)
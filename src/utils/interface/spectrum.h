@@ -0,0 +1,81 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * spectrum.h - band energies and spectral peaks of a window of samples
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "arm_math.h"
+
+// Number of samples in a window, a power of 2 supported by arm_rfft_fast_f32()
+#define SPECTRUM_SIZE 256
+#define SPECTRUM_BAND_COUNT 4
+#define SPECTRUM_PEAK_COUNT 2
+
+typedef struct {
+  float frequency; // Hz
+  float amplitude; // Amplitude of the sinusoid, in the unit of the samples
+} spectrumPeak_t;
+
+typedef struct {
+  // Mean square of the signal in each band, in the unit of the samples squared
+  float bandEnergy[SPECTRUM_BAND_COUNT];
+  // The largest local maxima of the spectrum above the first band edge, largest first. Zero if there is none.
+  spectrumPeak_t peaks[SPECTRUM_PEAK_COUNT];
+} spectrumResult_t;
+
+typedef struct {
+  arm_rfft_fast_instance_f32 fft;
+  float window[SPECTRUM_SIZE];
+  float windowSquareSum;
+  float sampleRate;
+  float bandEdges[SPECTRUM_BAND_COUNT + 1];
+
+  // Work buffers
+  float input[SPECTRUM_SIZE];
+  float output[SPECTRUM_SIZE];
+} spectrum_t;
+
+/**
+ * @brief Initialize the FFT and the Hann window
+ *
+ * @param spectrum The spectrum to initialize
+ * @param sampleRate Sample rate (Hz)
+ * @param bandEdges Frequencies (Hz) of the band edges in increasing order, band i is [bandEdges[i], bandEdges[i + 1])
+ */
+void spectrumInit(spectrum_t* spectrum, const float sampleRate, const float bandEdges[SPECTRUM_BAND_COUNT + 1]);
+
+/**
+ * @brief Analyze SPECTRUM_SIZE samples. The mean of the samples is removed and the Hann window is applied before
+ * the FFT. Peak frequencies are interpolated between the bins, the amplitude is the one of the largest bin.
+ *
+ * @param spectrum An initialized spectrum
+ * @param samples The first sample
+ * @param stride Distance between the samples in floats, 3 to analyze one axis of an array of Axis3f
+ * @param result The band energies and peaks
+ */
+void spectrumAnalyze(spectrum_t* spectrum, const float* samples, const int stride, spectrumResult_t* result);
@@ -0,0 +1,96 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * stageProfiler.h - utility for profiling the execution time of code stages
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "log.h"
+
+#define STAGE_PROFILER_HISTOGRAM_BINS 6
+
+/**
+ * @brief Execution time statistics for one stage, in cycles.
+ *
+ * Samples are collected over a window of samples. At the end of each window
+ * the statistics are published to the latest* members and the histogram,
+ * which are the ones to read or log, and the collection starts over.
+ *
+ * Histogram bin 0 counts samples below binWidth, bin i counts samples in
+ * [binWidth * 2^(i-1), binWidth * 2^i) and the last bin counts everything
+ * above.
+ */
+typedef struct {
+    uint32_t binWidth;
+    uint32_t windowSize;
+
+    // Collection in progress
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint16_t bins[STAGE_PROFILER_HISTOGRAM_BINS];
+
+    // Published at the end of each window
+    uint32_t latestMin;
+    uint32_t latestMax;
+    uint32_t latestMean;
+    uint16_t histogram[STAGE_PROFILER_HISTOGRAM_BINS];
+} stageProfiler_t;
+
+/**
+ * @brief Initialize a stageProfiler_t struct.
+ *
+ * @param profiler The profiler to initialize
+ * @param binWidth The width of the first histogram bin, in cycles
+ * @param windowSize The number of samples in a window
+ */
+void stageProfilerInit(stageProfiler_t* profiler, const uint32_t binWidth, const uint32_t windowSize);
+
+/**
+ * @brief Add one sample to a profiler.
+ *
+ * @param profiler The profiler
+ * @param cycles The execution time of the stage
+ */
+void stageProfilerAdd(stageProfiler_t* profiler, const uint32_t cycles);
+
+/**
+ * @brief Macro to add the published statistics of a stageProfiler_t to the log. Used in a
+ * LOG_GROUP_START() - LOG_GROUP_STOP() block, preferably one group per stage.
+ *
+ * @param PROFILER A pointer to a stageProfiler_t
+ */
+#define STAGE_PROFILER_LOG_ADD(PROFILER) \
+  LOG_ADD(LOG_UINT32, min, &(PROFILER)->latestMin) \
+  LOG_ADD(LOG_UINT32, max, &(PROFILER)->latestMax) \
+  LOG_ADD(LOG_UINT32, mean, &(PROFILER)->latestMean) \
+  LOG_ADD(LOG_UINT16, h0, &(PROFILER)->histogram[0]) \
+  LOG_ADD(LOG_UINT16, h1, &(PROFILER)->histogram[1]) \
+  LOG_ADD(LOG_UINT16, h2, &(PROFILER)->histogram[2]) \
+  LOG_ADD(LOG_UINT16, h3, &(PROFILER)->histogram[3]) \
+  LOG_ADD(LOG_UINT16, h4, &(PROFILER)->histogram[4]) \
+  LOG_ADD(LOG_UINT16, h5, &(PROFILER)->histogram[5])
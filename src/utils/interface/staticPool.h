@@ -0,0 +1,78 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * staticPool.h - fixed size object pool in static memory
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Pool of fixed size objects with O(1) allocation and release.
+ *
+ * The free objects are kept as a stack of indexes. The storage is allocated
+ * with STATIC_MEM_POOL_ALLOC() in static_mem.h.
+ */
+typedef struct {
+  uint8_t* objects;
+  uint16_t* freeStack;
+  uint16_t objectSize;
+  uint16_t capacity;
+  uint16_t freeCount;
+
+  // Statistics
+  uint16_t used;
+  uint16_t highWater; // Maximum number of objects in use at the same time
+  uint32_t failures;  // Number of allocations that failed because the pool was empty
+} staticPool_t;
+
+/**
+ * @brief Initialize a pool, all objects are free
+ *
+ * @param pool The pool
+ * @param objects Storage for capacity objects
+ * @param objectSize Size of an object
+ * @param capacity Number of objects
+ * @param freeStack Storage for capacity indexes
+ */
+void staticPoolInit(staticPool_t* pool, void* objects, uint16_t objectSize, uint16_t capacity, uint16_t* freeStack);
+
+/**
+ * @brief Release all objects, the high water mark and failure count are kept
+ */
+void staticPoolReset(staticPool_t* pool);
+
+/**
+ * @brief Allocate an object
+ *
+ * @return The object, or NULL if the pool is empty
+ */
+void* staticPoolAlloc(staticPool_t* pool);
+
+/**
+ * @brief Release an object allocated from the pool
+ */
+void staticPoolFree(staticPool_t* pool, void* object);
@@ -80,7 +80,15 @@ typedef struct {
  */
 #define STATS_CNT_RATE_INIT(LOGGER, INTERVAL_MS) statsCntRateLoggerInit(LOGGER, INTERVAL_MS)
 
-#define STATS_CNT_RATE_DEFINE(NAME, INTERVAL_MS) statsCntRateLogger_t NAME = {.logByFunction = {.data = &NAME, .aquireFloat = statsCntRateLogHandler}, .rateCounter = {.intervalMs = (INTERVAL_MS), .count = 0, .latestCount = 0, .latestAveragingMs = 0, .latestRate = 0}}
+/**
+ * @brief Static initializer for a statsCntRateLogger_t, for instance for elements in an array of loggers
+ *
+ * @param NAME The statsCntRateLogger_t to initialize
+ * @param INTERVAL_MS The interval (in ms) between calculations of the rate
+ */
+#define STATS_CNT_RATE_INITIALIZER(NAME, INTERVAL_MS) {.logByFunction = {.data = &(NAME), .aquireFloat = statsCntRateLogHandler}, .rateCounter = {.intervalMs = (INTERVAL_MS), .count = 0, .latestCount = 0, .latestAveragingMs = 0, .latestRate = 0}}
+
+#define STATS_CNT_RATE_DEFINE(NAME, INTERVAL_MS) statsCntRateLogger_t NAME = STATS_CNT_RATE_INITIALIZER(NAME, INTERVAL_MS)
 
 /**
  * @brief Macro to add an event to a statsCntRateLogger_t, that is to increase the internal counter
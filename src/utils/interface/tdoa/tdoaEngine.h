@@ -5,21 +5,26 @@
 #include "tdoaStats.h"
 
 typedef void (*tdoaEngineSendTdoaToEstimator)(tdoaMeasurement_t* tdoaMeasurement);
+typedef void (*tdoaEngineSendTdoaBatchToEstimator)(tdoaBatchMeasurement_t* tdoaBatch);
 
 typedef enum {
   TdoaEngineMatchingAlgorithmNone = 0,
   TdoaEngineMatchingAlgorithmRandom,
   TdoaEngineMatchingAlgorithmYoungest,
+  TdoaEngineMatchingAlgorithmGeometry,
 } tdoaEngineMatchingAlgorithm_t;
 
 typedef struct {
   // State
-  tdaoAnchorInfoArray_t anchorInfoArray;
+  tdoaAnchorStorage_t anchorStorage;
   tdoaStats_t stats;
 
   // Configuration
   tdoaEngineSendTdoaToEstimator sendTdoaToEstimator;
+  tdoaEngineSendTdoaBatchToEstimator sendTdoaBatchToEstimator;
+  bool useBatch; // Send one batch of measurements per packet, if there is a batch callback
   double locodeckTsFreq;
+  float distancePerTick; // SPEED_OF_LIGHT / locodeckTsFreq
   tdoaEngineMatchingAlgorithm_t matchingAlgorithm;
 
   // Matching algorithm data
@@ -27,11 +32,18 @@ typedef struct {
     uint8_t seqNr[REMOTE_ANCHOR_DATA_COUNT];
     uint8_t id[REMOTE_ANCHOR_DATA_COUNT];
     uint8_t offset;
+
+    // Tag position used by the geometry matching algorithm
+    vec3d tagPosition;
+    bool hasTagPosition;
   } matching;
 } tdoaEngineState_t;
 
 void tdoaEngineInit(tdoaEngineState_t* state, const uint32_t now_ms, tdoaEngineSendTdoaToEstimator sendTdoaToEstimator, const double locodeckTsFreq, const tdoaEngineMatchingAlgorithm_t matchingAlgorithm);
 
+void tdoaEngineSetBatchCallback(tdoaEngineState_t* engineState, tdoaEngineSendTdoaBatchToEstimator sendTdoaBatchToEstimator);
+void tdoaEngineSetTagPosition(tdoaEngineState_t* engineState, const float x, const float y, const float z);
+
 void tdoaEngineGetAnchorCtxForPacketProcessing(tdoaEngineState_t* engineState, const uint8_t anchorId, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
 void tdoaEngineProcessPacket(tdoaEngineState_t* engineState, tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T);
 void tdoaEngineProcessPacketFiltered(tdoaEngineState_t* engineState, tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, const bool doExcludeId, const uint8_t excludedId);
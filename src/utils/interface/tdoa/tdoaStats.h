@@ -2,7 +2,31 @@
 #define __LPS_TDOA_STATS_H__
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include "statsCnt.h"
+#include "clockCorrectionEngine.h"
+
+// The number of anchors to keep statistics for, the least recently seen anchor is replaced when a new one shows up
+#define TDOA_STATS_ANCHOR_COUNT 16
+
+// Statistics for one anchor
+typedef struct {
+  uint8_t id;
+  bool isUsed;
+  uint32_t lastSeen_ms;
+
+  // Counters for the current statistics interval
+  uint16_t packetCount;
+  uint16_t tdoaFoundCount;
+
+  // Filtered absolute change of the clock correction between packets
+  clockCorrection_t previousClockCorrection;
+  float clockCorrectionChange;
+
+  // Filtered absolute difference (in ns) between the rx interval in the tag and the tx interval in the anchor,
+  // corrected for the clock difference
+  float rxJitter_ns;
+} tdoaAnchorStats_t;
 
 typedef struct {
   statsCntRateLogger_t packetsReceived;
@@ -31,9 +55,26 @@ typedef struct {
 
   uint8_t newAnchorId; // Used to change anchor to log, set as param
   uint8_t newRemoteAnchorId; // Used to change remote anchor to log, set as param
+
+  tdoaAnchorStats_t anchors[TDOA_STATS_ANCHOR_COUNT];
+
+  // Per anchor statistics packed for logging, updated every statistics interval
+  // anchorLogA: bits 0-7 anchor id, 8-15 packet rate (packets/s), 16-23 percentage of packets that gave a TDoA
+  //             measurement, 24-31 time since last seen (100 ms)
+  // anchorLogB: bits 0-15 rx jitter (ns), 16-31 clock correction change per packet (ppb)
+  // An unused entry is 0.
+  uint32_t anchorLogA[TDOA_STATS_ANCHOR_COUNT];
+  uint32_t anchorLogB[TDOA_STATS_ANCHOR_COUNT];
 } tdoaStats_t;
 
 void tdoaStatsInit(tdoaStats_t* tdoaStats, uint32_t now_ms);
 void tdoaStatsUpdate(tdoaStats_t* tdoaStats, uint32_t now_ms);
 
+// Per anchor statistics
+tdoaAnchorStats_t* tdoaStatsGetAnchorStats(tdoaStats_t* tdoaStats, const uint8_t anchorId, const uint32_t now_ms);
+void tdoaStatsAnchorPacketReceived(tdoaAnchorStats_t* anchorStats, const uint32_t now_ms);
+void tdoaStatsAnchorClockCorrection(tdoaAnchorStats_t* anchorStats, const clockCorrection_t clockCorrection);
+void tdoaStatsAnchorRxResidual(tdoaAnchorStats_t* anchorStats, const float residual_ns);
+void tdoaStatsAnchorTdoaFound(tdoaAnchorStats_t* anchorStats);
+
 #endif // __LPS_TDOA_STATS_H__
@@ -4,10 +4,30 @@
 #include "stabilizer_types.h"
 #include "clockCorrectionEngine.h"
 
+// The number of anchors to keep data for, can be increased for large systems. Each anchor uses about 1 kb.
+#ifndef ANCHOR_STORAGE_COUNT
 #define ANCHOR_STORAGE_COUNT 16
+#endif
+
+// Remote data and tof entries are hashed on the anchor id, the counts must be powers of 2
 #define REMOTE_ANCHOR_DATA_COUNT 16
 #define TOF_PER_ANCHOR_COUNT 16
 
+#define TDOA_STORAGE_ANCHOR_ID_COUNT 256
+
+// Cached distances to other anchors, direct mapped on the anchor id, must be a power of 2
+#define ANCHOR_DISTANCE_CACHE_COUNT 8
+
+#if ANCHOR_STORAGE_COUNT >= TDOA_STORAGE_ANCHOR_ID_COUNT
+  #error "ANCHOR_STORAGE_COUNT must be less than 256"
+#endif
+#if (REMOTE_ANCHOR_DATA_COUNT & (REMOTE_ANCHOR_DATA_COUNT - 1)) != 0 || (TOF_PER_ANCHOR_COUNT & (TOF_PER_ANCHOR_COUNT - 1)) != 0
+  #error "REMOTE_ANCHOR_DATA_COUNT and TOF_PER_ANCHOR_COUNT must be powers of 2"
+#endif
+#if (ANCHOR_DISTANCE_CACHE_COUNT & (ANCHOR_DISTANCE_CACHE_COUNT - 1)) != 0
+  #error "ANCHOR_DISTANCE_CACHE_COUNT must be a power of 2"
+#endif
+
 
 typedef struct {
   uint8_t id; // Id of remote remote anchor
@@ -22,6 +42,21 @@ typedef struct {
   uint32_t endOfLife; // Time stamp when the tof data is outdated, local system time in ms
 } tdoaTimeOfFlight_t;
 
+// Direction from an anchor to the tag, used when matching anchors based on geometry
+typedef struct {
+  bool isValid;
+  vec3d tagPosition; // The tag position that the direction was calculated for
+  vec3d unitVector; // Unit vector from the anchor to the tag
+} tdoaGeometryCache_t;
+
+// Squared distance to another anchor. The entry is valid as long as the position versions of both anchors match.
+typedef struct {
+  uint8_t id; // Id of the other anchor
+  uint16_t positionVersion;
+  uint16_t otherPositionVersion;
+  float distanceSq;
+} tdoaAnchorDistanceCache_t;
+
 typedef struct {
   bool isInitialized;
   uint32_t lastUpdateTime; // The time when this anchor was updated the last time
@@ -34,12 +69,20 @@ typedef struct {
   clockCorrectionStorage_t clockCorrectionStorage;
 
   point_t position; // The coordinates of the anchor
+  uint16_t positionVersion; // Unique for each position, 0 means no position
+  tdoaGeometryCache_t geometryCache;
+  tdoaAnchorDistanceCache_t distanceCache[ANCHOR_DISTANCE_CACHE_COUNT];
 
   tdoaTimeOfFlight_t tof[TOF_PER_ANCHOR_COUNT];
   tdoaRemoteAnchorData_t remoteAnchorData[REMOTE_ANCHOR_DATA_COUNT];
 } tdoaAnchorInfo_t;
 
-typedef tdoaAnchorInfo_t tdaoAnchorInfoArray_t[ANCHOR_STORAGE_COUNT];
+typedef struct {
+  tdoaAnchorInfo_t anchorInfo[ANCHOR_STORAGE_COUNT];
+
+  // Index from anchor id to slot in anchorInfo, slot + 1 is stored. 0 means that the anchor is not in storage.
+  uint8_t slotPlusOne[TDOA_STORAGE_ANCHOR_ID_COUNT];
+} tdoaAnchorStorage_t;
 
 
 // The anchor context is used to pass information about an anchor as well as
@@ -51,12 +94,12 @@ typedef struct {
 } tdoaAnchorContext_t;
 
 
-void tdoaStorageInitialize(tdoaAnchorInfo_t anchorStorage[]);
+void tdoaStorageInitialize(tdoaAnchorStorage_t* anchorStorage);
 
-bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
-bool tdoaStorageGetAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
-uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize);
-uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms);
+bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
+bool tdoaStorageGetAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
+uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize);
+uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms);
 
 uint8_t tdoaStorageGetId(const tdoaAnchorContext_t* anchorCtx);
 int64_t tdoaStorageGetRxTime(const tdoaAnchorContext_t* anchorCtx);
@@ -64,10 +107,12 @@ int64_t tdoaStorageGetTxTime(const tdoaAnchorContext_t* anchorCtx);
 uint8_t tdoaStorageGetSeqNr(const tdoaAnchorContext_t* anchorCtx);
 uint32_t tdoaStorageGetLastUpdateTime(const tdoaAnchorContext_t* anchorCtx);
 clockCorrectionStorage_t* tdoaStorageGetClockCorrectionStorage(const tdoaAnchorContext_t* anchorCtx);
+tdoaGeometryCache_t* tdoaStorageGetGeometryCache(const tdoaAnchorContext_t* anchorCtx);
+float tdoaStorageGetAnchorDistanceSq(const tdoaAnchorContext_t* anchorCtx, const tdoaAnchorContext_t* otherAnchorCtx);
 bool tdoaStorageGetAnchorPosition(const tdoaAnchorContext_t* anchorCtx, point_t* position);
 void tdoaStorageSetAnchorPosition(tdoaAnchorContext_t* anchorCtx, const float x, const float y, const float z);
 void tdoaStorageSetRxTxData(tdoaAnchorContext_t* anchorCtx, int64_t rxTime, int64_t txTime, uint8_t seqNr);
-double tdoaStorageGetClockCorrection(const tdoaAnchorContext_t* anchorCtx);
+clockCorrection_t tdoaStorageGetClockCorrection(const tdoaAnchorContext_t* anchorCtx);
 int64_t tdoaStorageGetRemoteRxTime(const tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor);
 bool tdoaStorageGetRemoteRxTimeSeqNr(const tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, int64_t* rxTime, uint8_t* seqNr);
 void tdoaStorageSetRemoteRxTime(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, const int64_t remoteRxTime, const uint8_t remoteSeqNr);
@@ -76,6 +121,6 @@ int64_t tdoaStorageGetTimeOfFlight(const tdoaAnchorContext_t* anchorCtx, const u
 void tdoaStorageSetTimeOfFlight(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, const int64_t tof);
 
 // Mainly for test
-bool tdoaStorageIsAnchorInStorage(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor);
+bool tdoaStorageIsAnchorInStorage(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor);
 
 #endif // __TDOA_STORAGE_H__
@@ -0,0 +1,90 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * tocHash.h - hash index for name lookups in the log and param TOCs
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Open addressing hash table of indexes into a TOC, keyed on the
+ * group and name of the entries.
+ *
+ * The table only holds indexes, the caller verifies a candidate against the
+ * TOC entry itself, see tocHashFind(). Slots hold the index + 1, so a zero
+ * initialized slot array is empty.
+ */
+typedef struct {
+  uint16_t* slots;
+  uint16_t size; // Number of slots, a power of two
+  uint16_t count;
+} tocHash_t;
+
+/**
+ * @brief Verifies that a TOC entry matches the looked up group and name.
+ *
+ * @param index Index of the TOC entry
+ * @param group Group to look up
+ * @param name Name to look up
+ * @return true if the entry is the one looked up
+ */
+typedef bool (*tocHashMatch_t)(uint16_t index, const char* group, const char* name);
+
+/**
+ * @brief Hash of a group and name
+ */
+uint32_t tocHashName(const char* group, const char* name);
+
+/**
+ * @brief Initialize an empty table
+ *
+ * @param table The table
+ * @param slots Storage for the slots
+ * @param size Number of slots, must be a power of two
+ */
+void tocHashInit(tocHash_t* table, uint16_t* slots, uint16_t size);
+
+/**
+ * @brief Add a TOC entry to the table
+ *
+ * @param table The table
+ * @param hash Hash of the group and name of the entry, from tocHashName()
+ * @param index Index of the entry
+ * @return false if the table is full
+ */
+bool tocHashInsert(tocHash_t* table, uint32_t hash, uint16_t index);
+
+/**
+ * @brief Look up a TOC entry
+ *
+ * @param table The table
+ * @param group Group to look up
+ * @param name Name to look up
+ * @param match Verifies the candidate entries
+ * @return The index of the entry, or -1 if not found
+ */
+int tocHashFind(const tocHash_t* table, const char* group, const char* name, tocHashMatch_t match);
@@ -0,0 +1,76 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * windowStats.h - running mean and variance over a window of samples
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of samples in a window
+#define WINDOW_STATS_SIZE 16
+
+// A zero initialized windowStats_t is an empty window
+typedef struct {
+  float samples[WINDOW_STATS_SIZE];
+  float sum;
+  float sumSquares;
+  uint8_t index;
+  uint8_t count;
+} windowStats_t;
+
+/**
+ * @brief Initialize an empty window
+ *
+ * @param window The window to initialize
+ */
+void windowStatsInit(windowStats_t* window);
+
+/**
+ * @brief Add a sample to the window, replacing the oldest one when the window is full. The sums are updated
+ * incrementally, and recomputed from the samples once per window to keep rounding errors from building up.
+ *
+ * @param window A windowStats_t
+ * @param value The new sample
+ */
+void windowStatsAdd(windowStats_t* window, const float value);
+
+/**
+ * @brief Check if the window holds WINDOW_STATS_SIZE samples
+ */
+static inline bool windowStatsIsFull(const windowStats_t* window) {
+  return window->count == WINDOW_STATS_SIZE;
+}
+
+/**
+ * @brief Mean of the samples in the window, 0 if empty
+ */
+float windowStatsMean(const windowStats_t* window);
+
+/**
+ * @brief Population variance of the samples in the window, 0 if empty
+ */
+float windowStatsVariance(const windowStats_t* window);
@@ -8,6 +8,19 @@
 #define CLOCK_CORRECTION_FILTER 0.1
 #define CLOCK_CORRECTION_BUCKET_MAX 4
 
+#define CLOCK_CORRECTION_SPEC_MIN_FIXED CLOCK_CORRECTION_FIXED(CLOCK_CORRECTION_SPEC_MIN)
+#define CLOCK_CORRECTION_SPEC_MAX_FIXED CLOCK_CORRECTION_FIXED(CLOCK_CORRECTION_SPEC_MAX)
+#define CLOCK_CORRECTION_ACCEPTED_NOISE_FIXED CLOCK_CORRECTION_FIXED(CLOCK_CORRECTION_ACCEPTED_NOISE)
+
+// The gain of the low pass filter, (1 - CLOCK_CORRECTION_FILTER), with CLOCK_CORRECTION_FILTER_GAIN_BITS fractional bits
+#define CLOCK_CORRECTION_FILTER_GAIN_BITS 24
+#define CLOCK_CORRECTION_FILTER_GAIN ((int64_t)((1.0 - CLOCK_CORRECTION_FILTER) * (1 << CLOCK_CORRECTION_FILTER_GAIN_BITS) + 0.5))
+
+// The fractional part of the clock correction is calculated in two steps to keep the shifted remainder within 64 bits.
+// Requires tick counts that fit in 64 - CLOCK_CORRECTION_DIVISION_STEP_BITS bits, the 40 bit DW1000 timestamps do.
+#define CLOCK_CORRECTION_DIVISION_STEP_BITS (CLOCK_CORRECTION_FRACTION_BITS / 2)
+#define CLOCK_CORRECTION_MAX_INTEGER_PART ((uint64_t)1 << (63 - CLOCK_CORRECTION_FRACTION_BITS))
+
 /**
  Logging all the clock correction information requires scaling the values repeatedly, which is computer intense. Thus, the logging functionality is enabled at compile time with the CLOCK_CORRECTION_ENABLE_LOGGING flag.
  */
@@ -26,13 +39,45 @@ static float scaleValueForLogging(double value) {
 }
 #endif
 
+/**
+ Converts a fixed point clock correction to a double. Not intended for the packet handling path, use the fixed point functions there.
+ */
+static double toDouble(const clockCorrection_t clockCorrection) {
+  return (double)clockCorrection / (double)CLOCK_CORRECTION_ONE;
+}
+
 /**
  Obtains the clock correction from a clockCorrectionStorage_t object. This is the recommended public API to obtain the clock correction, instead of getting it directly from the storage object.
  */
 double clockCorrectionEngineGet(const clockCorrectionStorage_t* storage) {
+  return toDouble(storage->clockCorrection);
+}
+
+/**
+ Obtains the clock correction from a clockCorrectionStorage_t object, in fixed point format.
+ */
+clockCorrection_t clockCorrectionEngineGetFixed(const clockCorrectionStorage_t* storage) {
   return storage->clockCorrection;
 }
 
+/**
+ Converts a fixed point clock correction to a float, for logging.
+ */
+float clockCorrectionEngineToFloat(const clockCorrection_t clockCorrection) {
+  return (float)clockCorrection * (1.0f / (float)CLOCK_CORRECTION_ONE);
+}
+
+/**
+ Converts a clock correction to fixed point format.
+ */
+clockCorrection_t clockCorrectionEngineFromDouble(const double clockCorrection) {
+  if (clockCorrection < 0.0) {
+    return (clockCorrection_t)(clockCorrection * CLOCK_CORRECTION_ONE - 0.5);
+  }
+
+  return (clockCorrection_t)(clockCorrection * CLOCK_CORRECTION_ONE + 0.5);
+}
+
 /**
  Truncates a timestamp to the number of bits of the mask. This truncation ensures that the value returned is a valid time event, even if the time counter wrapped around.
  */
@@ -69,41 +114,72 @@ static bool emptyClockCorrectionBucket(clockCorrectionStorage_t* storage) {
  @param new_t_in_cl_x The newest time of occurrence for an event (t), measured by clock x
  @param old_t_in_cl_x The previous time of occurrence for an event (t), measured by clock x
  @param mask A mask as long as the number of bits used to represent the timestamps. Used to calculate a valid timestamp, even if wrapped arounds of the time counter happened at some point
- @return The necessary clock correction to apply to timestamps measured by clock x, in order to obtain their value like if the measurement was done by the reference clock. Or -1 if it was not possible to perform the computation. Example: timestamp_in_cl_reference = clockCorrection * timestamp_in_cl_x
+ @return The necessary clock correction to apply to timestamps measured by clock x, in order to obtain their value like if the measurement was done by the reference clock, in fixed point format. Or CLOCK_CORRECTION_INVALID if it was not possible to perform the computation. Example: timestamp_in_cl_reference = clockCorrectionEngineApply(clockCorrection, timestamp_in_cl_x)
  */
-double clockCorrectionEngineCalculate(const uint64_t new_t_in_cl_reference, const uint64_t old_t_in_cl_reference, const uint64_t new_t_in_cl_x, const uint64_t old_t_in_cl_x, const uint64_t mask) {
+clockCorrection_t clockCorrectionEngineCalculateFixed(const uint64_t new_t_in_cl_reference, const uint64_t old_t_in_cl_reference, const uint64_t new_t_in_cl_x, const uint64_t old_t_in_cl_x, const uint64_t mask) {
   const uint64_t tickCount_in_cl_reference = truncateTimeStamp(new_t_in_cl_reference - old_t_in_cl_reference, mask);
   const uint64_t tickCount_in_cl_x = truncateTimeStamp(new_t_in_cl_x - old_t_in_cl_x, mask);
 
   if (tickCount_in_cl_x == 0) {
+    return CLOCK_CORRECTION_INVALID;
+  }
+
+  const uint64_t integerPart = tickCount_in_cl_reference / tickCount_in_cl_x;
+  if (integerPart >= CLOCK_CORRECTION_MAX_INTEGER_PART) {
+    // Far out of the specs, saturate
+    return INT64_MAX;
+  }
+
+  uint64_t result = integerPart;
+  uint64_t remainder = tickCount_in_cl_reference % tickCount_in_cl_x;
+  for (int i = 0; i < CLOCK_CORRECTION_FRACTION_BITS / CLOCK_CORRECTION_DIVISION_STEP_BITS; i++) {
+    remainder <<= CLOCK_CORRECTION_DIVISION_STEP_BITS;
+    result = (result << CLOCK_CORRECTION_DIVISION_STEP_BITS) | (remainder / tickCount_in_cl_x);
+    remainder = remainder % tickCount_in_cl_x;
+  }
+
+  // Round to nearest
+  if (remainder >= tickCount_in_cl_x - remainder) {
+    result++;
+  }
+
+  return (clockCorrection_t)result;
+}
+
+/**
+ Same as clockCorrectionEngineCalculateFixed() but the clock correction is returned as a double.
+ */
+double clockCorrectionEngineCalculate(const uint64_t new_t_in_cl_reference, const uint64_t old_t_in_cl_reference, const uint64_t new_t_in_cl_x, const uint64_t old_t_in_cl_x, const uint64_t mask) {
+  const clockCorrection_t clockCorrection = clockCorrectionEngineCalculateFixed(new_t_in_cl_reference, old_t_in_cl_reference, new_t_in_cl_x, old_t_in_cl_x, mask);
+  if (clockCorrection == CLOCK_CORRECTION_INVALID) {
     return -1;
   }
 
-  return (double)tickCount_in_cl_reference / (double)tickCount_in_cl_x;
+  return toDouble(clockCorrection);
 }
 
 /**
  Updates the clock correction only if the provided value follows certain conditions. This is used to discard wrong clock correction measurements.
  @return True if the provided clock correction sample ir reliable, false otherwise. A sample is reliable when it is in the accepted noise level (which means that we already have two or more samples that are similar) and has been LP filtered.
  */
-bool clockCorrectionEngineUpdate(clockCorrectionStorage_t* storage, const double clockCorrectionCandidate) {
+bool clockCorrectionEngineUpdateFixed(clockCorrectionStorage_t* storage, const clockCorrection_t clockCorrectionCandidate) {
   bool sampleIsReliable = false;
 
-  const double currentClockCorrection = storage->clockCorrection;
-  const double difference = clockCorrectionCandidate - currentClockCorrection;
+  const clockCorrection_t currentClockCorrection = storage->clockCorrection;
+  const int64_t difference = clockCorrectionCandidate - currentClockCorrection;
 
 #ifdef CLOCK_CORRECTION_ENABLE_LOGGING
-  logMinAcceptedNoiseLimit = scaleValueForLogging(currentClockCorrection - CLOCK_CORRECTION_ACCEPTED_NOISE);
-  logMaxAcceptedNoiseLimit = scaleValueForLogging(currentClockCorrection + CLOCK_CORRECTION_ACCEPTED_NOISE);
+  logMinAcceptedNoiseLimit = scaleValueForLogging(toDouble(currentClockCorrection) - CLOCK_CORRECTION_ACCEPTED_NOISE);
+  logMaxAcceptedNoiseLimit = scaleValueForLogging(toDouble(currentClockCorrection) + CLOCK_CORRECTION_ACCEPTED_NOISE);
   logMinSpecLimit = scaleValueForLogging(CLOCK_CORRECTION_SPEC_MIN);
   logMaxSpecLimit = scaleValueForLogging(CLOCK_CORRECTION_SPEC_MAX);
-  logClockCorrection = scaleValueForLogging(currentClockCorrection);
-  logClockCorrectionCandidate = scaleValueForLogging(clockCorrectionCandidate);
+  logClockCorrection = scaleValueForLogging(toDouble(currentClockCorrection));
+  logClockCorrectionCandidate = scaleValueForLogging(toDouble(clockCorrectionCandidate));
 #endif
 
-  if (-CLOCK_CORRECTION_ACCEPTED_NOISE < difference && difference < CLOCK_CORRECTION_ACCEPTED_NOISE) {
-    // Simple low pass filter
-    const double newClockCorrection = currentClockCorrection * CLOCK_CORRECTION_FILTER + clockCorrectionCandidate * (1.0 - CLOCK_CORRECTION_FILTER);
+  if (-CLOCK_CORRECTION_ACCEPTED_NOISE_FIXED < difference && difference < CLOCK_CORRECTION_ACCEPTED_NOISE_FIXED) {
+    // Simple low pass filter, currentClockCorrection * CLOCK_CORRECTION_FILTER + clockCorrectionCandidate * (1.0 - CLOCK_CORRECTION_FILTER)
+    const clockCorrection_t newClockCorrection = currentClockCorrection + (difference * CLOCK_CORRECTION_FILTER_GAIN) / (1 << CLOCK_CORRECTION_FILTER_GAIN_BITS);
 
     sampleIsReliable = true;
     fillClockCorrectionBucket(storage);
@@ -111,7 +187,7 @@ bool clockCorrectionEngineUpdate(clockCorrectionStorage_t* storage, const double
   } else {
     const bool shouldAcceptANewClockReference = emptyClockCorrectionBucket(storage);
     if (shouldAcceptANewClockReference) {
-      if (CLOCK_CORRECTION_SPEC_MIN < clockCorrectionCandidate && clockCorrectionCandidate < CLOCK_CORRECTION_SPEC_MAX) {
+      if (CLOCK_CORRECTION_SPEC_MIN_FIXED < clockCorrectionCandidate && clockCorrectionCandidate < CLOCK_CORRECTION_SPEC_MAX_FIXED) {
         // We do not fill the bucket and accept the clock correction sample as reliable: a sample is reliable when it is in the accepted noise level (which means that we already have two or more samples that are similar) and has been LP filtered. See: https://github.com/bitcraze/crazyflie-firmware/pull/328
         storage->clockCorrection = clockCorrectionCandidate;
       }
@@ -121,6 +197,52 @@ bool clockCorrectionEngineUpdate(clockCorrectionStorage_t* storage, const double
   return sampleIsReliable;
 }
 
+/**
+ Same as clockCorrectionEngineUpdateFixed() but the candidate is provided as a double.
+ */
+bool clockCorrectionEngineUpdate(clockCorrectionStorage_t* storage, const double clockCorrectionCandidate) {
+  return clockCorrectionEngineUpdateFixed(storage, clockCorrectionEngineFromDouble(clockCorrectionCandidate));
+}
+
+/**
+ Applies a clock correction to a number of ticks, using integer arithmetic only.
+
+ @param clockCorrection The clock correction in fixed point format
+ @param ticks The number of ticks to correct
+ @return ticks * clockCorrection, rounded to the nearest tick
+ */
+int64_t clockCorrectionEngineApply(const clockCorrection_t clockCorrection, const int64_t ticks) {
+  const bool isNegative = (ticks < 0) != (clockCorrection < 0);
+  const uint64_t a = (ticks < 0) ? -(uint64_t)ticks : (uint64_t)ticks;
+  const uint64_t b = (clockCorrection < 0) ? -(uint64_t)clockCorrection : (uint64_t)clockCorrection;
+
+  // 64 x 64 -> 128 bit multiplication from 32 bit parts
+  const uint64_t aLow = a & 0xffffffff;
+  const uint64_t aHigh = a >> 32;
+  const uint64_t bLow = b & 0xffffffff;
+  const uint64_t bHigh = b >> 32;
+
+  const uint64_t lowLow = aLow * bLow;
+  const uint64_t lowHigh = aLow * bHigh;
+  const uint64_t highLow = aHigh * bLow;
+  const uint64_t highHigh = aHigh * bHigh;
+
+  const uint64_t middle = (lowLow >> 32) + (lowHigh & 0xffffffff) + (highLow & 0xffffffff);
+  uint64_t productLow = (lowLow & 0xffffffff) | (middle << 32);
+  uint64_t productHigh = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+
+  // Round to nearest
+  const uint64_t half = (uint64_t)1 << (CLOCK_CORRECTION_FRACTION_BITS - 1);
+  productLow += half;
+  if (productLow < half) {
+    productHigh++;
+  }
+
+  const uint64_t result = (productHigh << (64 - CLOCK_CORRECTION_FRACTION_BITS)) | (productLow >> CLOCK_CORRECTION_FRACTION_BITS);
+
+  return isNegative ? -(int64_t)result : (int64_t)result;
+}
+
 #ifdef CLOCK_CORRECTION_ENABLE_LOGGING
 LOG_GROUP_START(CkCorrection)
 LOG_ADD(LOG_FLOAT, minNoise, &logMinAcceptedNoiseLimit)
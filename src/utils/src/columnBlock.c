@@ -0,0 +1,271 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * columnBlock.c - column oriented, delta encoded blocks of log samples
+ *
+ * A block is laid out as (all little endian):
+ *   uint16 eventId, uint16 numRows, uint16 bodySize
+ *   body: the timestamp column followed by one column per value
+ *   uint32 CRC32 of the header and the body
+ *
+ * Timestamps and integers are stored as the difference to the previous sample
+ * of the column (the first one to 0), zigzag encoded and written as a varint
+ * of 7 bits per byte, least significant first. Float columns are numRows raw
+ * 4 byte values.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "columnBlock.h"
+#include "crc32.h"
+
+#define TIMESTAMP_SIZE 8
+#define VARINT_MAX_SIZE 10
+
+static int valueSize(char type) {
+  switch (type) {
+    case 'B':
+    case 'b':
+      return 1;
+    case 'H':
+    case 'h':
+      return 2;
+    case 'I':
+    case 'i':
+    case 'f':
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+static int64_t readInteger(const uint8_t* data, char type) {
+  switch (type) {
+    case 'B':
+      return data[0];
+    case 'b':
+      return (int8_t)data[0];
+    case 'H':
+      return (uint16_t)(data[0] | (data[1] << 8));
+    case 'h':
+      return (int16_t)(data[0] | (data[1] << 8));
+    case 'I':
+      return (uint32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+    default:
+      return (int32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+  }
+}
+
+static uint64_t readTimestamp(const uint8_t* data) {
+  uint64_t value = 0;
+  for (int i = TIMESTAMP_SIZE - 1; i >= 0; i--) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+static void writeLittleEndian(uint8_t* data, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    data[i] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+static uint32_t writeVarint(uint8_t* output, int64_t delta) {
+  uint64_t value = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+  uint32_t length = 0;
+  while (value >= 0x80) {
+    output[length++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  output[length++] = value;
+  return length;
+}
+
+// Returns the number of bytes used, or 0 if the varint does not end before end
+static uint32_t readVarint(const uint8_t* input, const uint8_t* end, int64_t* delta) {
+  uint64_t value = 0;
+  uint32_t length = 0;
+  while (input + length < end && length < VARINT_MAX_SIZE) {
+    uint8_t byte = input[length];
+    value |= (uint64_t)(byte & 0x7f) << (7 * length);
+    length++;
+    if ((byte & 0x80) == 0) {
+      *delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+      return length;
+    }
+  }
+  return 0;
+}
+
+uint16_t columnBlockRowSize(const char* format) {
+  uint16_t size = TIMESTAMP_SIZE;
+  for (const char* type = format; *type; type++) {
+    int bytes = valueSize(*type);
+    if (bytes == 0) {
+      return 0;
+    }
+    size += bytes;
+  }
+  return size;
+}
+
+uint32_t columnBlockMaxSize(const char* format, uint16_t numRows) {
+  // A delta of a 32 bit value needs at most 33 bits, that is 5 varint bytes
+  uint32_t rowSize = VARINT_MAX_SIZE + 5 * strlen(format);
+  return COLUMN_BLOCK_HEADER_SIZE + numRows * rowSize + COLUMN_BLOCK_CRC_SIZE;
+}
+
+int columnBlockEncode(uint8_t* output, uint32_t capacity, uint32_t* length, uint16_t eventId, const char* format, const uint8_t* rows, uint16_t numRows) {
+  const uint16_t rowSize = columnBlockRowSize(format);
+  if (rowSize == 0) {
+    return EINVAL;
+  }
+
+  // Check the worst case up front, the exact size is only known afterwards
+  const uint32_t maxSize = columnBlockMaxSize(format, numRows);
+  if (maxSize > capacity || maxSize - COLUMN_BLOCK_HEADER_SIZE - COLUMN_BLOCK_CRC_SIZE > UINT16_MAX) {
+    return ENOSPC;
+  }
+
+  uint32_t index = COLUMN_BLOCK_HEADER_SIZE;
+
+  int64_t previous = 0;
+  for (int row = 0; row < numRows; row++) {
+    int64_t timestamp = readTimestamp(&rows[row * rowSize]);
+    index += writeVarint(&output[index], timestamp - previous);
+    previous = timestamp;
+  }
+
+  uint16_t offset = TIMESTAMP_SIZE;
+  for (const char* type = format; *type; type++) {
+    if (*type == 'f') {
+      for (int row = 0; row < numRows; row++) {
+        memcpy(&output[index], &rows[row * rowSize + offset], 4);
+        index += 4;
+      }
+    } else {
+      previous = 0;
+      for (int row = 0; row < numRows; row++) {
+        int64_t value = readInteger(&rows[row * rowSize + offset], *type);
+        index += writeVarint(&output[index], value - previous);
+        previous = value;
+      }
+    }
+    offset += valueSize(*type);
+  }
+
+  const uint16_t bodySize = index - COLUMN_BLOCK_HEADER_SIZE;
+  writeLittleEndian(&output[0], eventId, 2);
+  writeLittleEndian(&output[2], numRows, 2);
+  writeLittleEndian(&output[4], bodySize, 2);
+
+  uint32_t crc = crc32CalculateBuffer(output, index);
+  writeLittleEndian(&output[index], crc, COLUMN_BLOCK_CRC_SIZE);
+  index += COLUMN_BLOCK_CRC_SIZE;
+
+  *length = index;
+  return 0;
+}
+
+int columnBlockParseHeader(const uint8_t* input, uint32_t length, columnBlockHeader_t* header) {
+  if (length < COLUMN_BLOCK_HEADER_SIZE + COLUMN_BLOCK_CRC_SIZE) {
+    return EINVAL;
+  }
+
+  header->eventId = input[0] | (input[1] << 8);
+  header->numRows = input[2] | (input[3] << 8);
+  header->bodySize = input[4] | (input[5] << 8);
+
+  const uint32_t crcIndex = COLUMN_BLOCK_HEADER_SIZE + header->bodySize;
+  if (crcIndex + COLUMN_BLOCK_CRC_SIZE > length) {
+    return EINVAL;
+  }
+
+  uint32_t crc = (uint32_t)readInteger(&input[crcIndex], 'I');
+  if (crc != crc32CalculateBuffer(input, crcIndex)) {
+    return EINVAL;
+  }
+
+  return 0;
+}
+
+int columnBlockDecode(const uint8_t* input, const columnBlockHeader_t* header, const char* format, uint8_t* rows, uint16_t maxRows) {
+  const uint16_t rowSize = columnBlockRowSize(format);
+  if (rowSize == 0) {
+    return EINVAL;
+  }
+  if (header->numRows > maxRows) {
+    return ENOSPC;
+  }
+
+  const uint8_t* data = &input[COLUMN_BLOCK_HEADER_SIZE];
+  const uint8_t* end = data + header->bodySize;
+
+  int64_t value = 0;
+  for (int row = 0; row < header->numRows; row++) {
+    int64_t delta;
+    uint32_t used = readVarint(data, end, &delta);
+    if (used == 0) {
+      return EINVAL;
+    }
+    data += used;
+    value += delta;
+    writeLittleEndian(&rows[row * rowSize], value, TIMESTAMP_SIZE);
+  }
+
+  uint16_t offset = TIMESTAMP_SIZE;
+  for (const char* type = format; *type; type++) {
+    const int size = valueSize(*type);
+    if (*type == 'f') {
+      if (end - data < 4 * header->numRows) {
+        return EINVAL;
+      }
+      for (int row = 0; row < header->numRows; row++) {
+        memcpy(&rows[row * rowSize + offset], data, 4);
+        data += 4;
+      }
+    } else {
+      value = 0;
+      for (int row = 0; row < header->numRows; row++) {
+        int64_t delta;
+        uint32_t used = readVarint(data, end, &delta);
+        if (used == 0) {
+          return EINVAL;
+        }
+        data += used;
+        value += delta;
+        writeLittleEndian(&rows[row * rowSize + offset], value, size);
+      }
+    }
+    offset += size;
+  }
+
+  if (data != end) {
+    return EINVAL;
+  }
+
+  return 0;
+}
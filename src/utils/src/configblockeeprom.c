@@ -128,48 +128,47 @@ int configblockInit(void)
   // the first read needs to be discarded
   eepromTestConnection();
 
-  if (eepromTestConnection())
+  // The whole block is read in one transfer, a failing read means that the
+  // EEPROM is not connected
+  if (eepromReadBuffer((uint8_t *)&configblock, 0, sizeof(configblock)))
   {
-    if (eepromReadBuffer((uint8_t *)&configblock, 0, sizeof(configblock)))
+    //Verify the config block
+    if (configblockCheckMagic(&configblock))
     {
-      //Verify the config block
-      if (configblockCheckMagic(&configblock))
+      if (configblockCheckVersion(&configblock))
       {
-        if (configblockCheckVersion(&configblock))
+        if (configblockCheckChecksum(&configblock))
         {
-          if (configblockCheckChecksum(&configblock))
-          {
-            // Everything is fine
-            DEBUG_PRINT("v%d, verification [OK]\n", configblock.version);
-            cb_ok = true;
-          }
-          else
-          {
-            DEBUG_PRINT("Verification [FAIL]\n");
-            cb_ok = false;
-          }
+          // Everything is fine
+          DEBUG_PRINT("v%d, verification [OK]\n", configblock.version);
+          cb_ok = true;
+        }
+        else
+        {
+          DEBUG_PRINT("Verification [FAIL]\n");
+          cb_ok = false;
         }
-        else // configblockCheckVersion
+      }
+      else // configblockCheckVersion
+      {
+        // Check data integrity of old version data
+        if (configblock.version <= VERSION &&
+            configblockCheckDataIntegrity((uint8_t *)&configblock, configblock.version))
         {
-          // Check data integrity of old version data
-          if (configblock.version <= VERSION &&
-              configblockCheckDataIntegrity((uint8_t *)&configblock, configblock.version))
+          // Not the same version, try to upgrade
+          if (configblockCopyToNewVersion(&configblock, &configblockDefault))
           {
-            // Not the same version, try to upgrade
-            if (configblockCopyToNewVersion(&configblock, &configblockDefault))
+            // Write updated config block to eeprom
+            if (configblockWrite(&configblock))
             {
-              // Write updated config block to eeprom
-              if (configblockWrite(&configblock))
-              {
-                cb_ok = true;
-              }
+              cb_ok = true;
             }
           }
-          else
-          {
-            // Can't copy old version due to bad data.
-            cb_ok = false;
-          }
+        }
+        else
+        {
+          // Can't copy old version due to bad data.
+          cb_ok = false;
         }
       }
     }
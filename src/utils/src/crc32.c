@@ -71,6 +71,7 @@
 #include "crc32.h"
 
 #include <stdbool.h>
+#include <string.h>
 
 #include "static_mem.h"
 
@@ -83,11 +84,15 @@
 // Internal functions
 static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
               uint32_t remainder, uint32_t* crcTable);
-static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
-              uint32_t remainder, uint32_t* crcTable);
+static uint32_t crcBySlice4(const uint8_t* message, uint32_t bytesToProcess,
+              uint32_t remainder, uint32_t crcTables[][256]);
 static void crcTableInit(uint32_t* crcTable);
+static void crcSliceTablesInit(uint32_t crcTables[][256]);
 
-NO_DMA_CCM_SAFE_ZERO_INIT static uint32_t crcTable[256];
+// Tables for slicing-by-4, crcTables[0] is the byte-wise table. The tables are in CCM, the zero wait state RAM, as
+// the lookups are random and miss the flash cache.
+#define SLICES 4
+NO_DMA_CCM_SAFE_ZERO_INIT static uint32_t crcTables[SLICES][256];
 static bool crcTableInitialized = false;
 
 // *** Public API ***
@@ -96,8 +101,9 @@ void crc32ContextInit(crc32Context_t *context)
 {
   // Lazy static ...
   if (crcTableInitialized == false) {
-    // initialize crcTable
-    crcTableInit(crcTable);
+    // initialize crcTables
+    crcTableInit(crcTables[0]);
+    crcSliceTablesInit(crcTables);
     crcTableInitialized = true;
   }
 
@@ -106,7 +112,7 @@ void crc32ContextInit(crc32Context_t *context)
 
 void crc32Update(crc32Context_t *context, const void* data, size_t size)
 {
-  context->remainder = crcByByte(data, size, context->remainder, crcTable);
+  context->remainder = crcBySlice4(data, size, context->remainder, crcTables);
 }
 
 uint32_t crc32Out(const crc32Context_t *context)
@@ -161,6 +167,39 @@ static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
   return remainder;
 }
 
+// *** Slicing-by-4 ***
+
+/* Four bytes per step, one lookup per byte in four tables. crcTables[k][i] is
+ * the remainder of byte i followed by k zero bytes. The words are read in
+ * little endian order, the byte order of the message. */
+static uint32_t crcBySlice4(const uint8_t* message, uint32_t bytesToProcess,
+              uint32_t remainder, uint32_t crcTables[][256])
+{
+  while (bytesToProcess >= 4) {
+    uint32_t word;
+    memcpy(&word, message, sizeof(word));
+    remainder ^= word;
+    remainder = crcTables[3][remainder & 0xff] ^
+                crcTables[2][(remainder >> 8) & 0xff] ^
+                crcTables[1][(remainder >> 16) & 0xff] ^
+                crcTables[0][remainder >> 24];
+    message += 4;
+    bytesToProcess -= 4;
+  }
+
+  return crcByByte(message, bytesToProcess, remainder, crcTables[0]);
+}
+
+static void crcSliceTablesInit(uint32_t crcTables[][256])
+{
+  for (int i = 0; i < 256; i++) {
+    for (int k = 1; k < SLICES; k++) {
+      const uint32_t previous = crcTables[k - 1][i];
+      crcTables[k][i] = (previous >> 8) ^ crcTables[0][previous & 0xff];
+    }
+  }
+}
+
 /* creates a lookup-table which is necessary for the crcByByte function */
 static void crcTableInit(uint32_t* crcTable)
 {
@@ -0,0 +1,48 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dshot.c - Encoding of DShot frames for digital ESCs
+ */
+
+#include "dshot.h"
+
+uint16_t dshotThrottleFromRatio(const uint16_t ratio) {
+  if (ratio == 0) {
+    return 0;
+  }
+
+  return DSHOT_THROTTLE_MIN + ((uint32_t)ratio * (DSHOT_THROTTLE_MAX - DSHOT_THROTTLE_MIN) + UINT16_MAX / 2) / UINT16_MAX;
+}
+
+uint16_t dshotFrame(const uint16_t value, const bool telemetryRequest) {
+  const uint16_t data = ((value & 0x07ff) << 1) | (telemetryRequest ? 1 : 0);
+  const uint16_t checksum = (data ^ (data >> 4) ^ (data >> 8)) & 0x0f;
+  return (data << 4) | checksum;
+}
+
+void dshotFrameToCompare(const uint16_t frame, uint32_t* compare, const int stride, const uint32_t zeroHigh, const uint32_t oneHigh) {
+  for (int i = 0; i < DSHOT_FRAME_BITS; i++) {
+    const bool one = frame & (0x8000 >> i);
+    compare[i * stride] = one ? oneHigh : zeroHigh;
+  }
+}
@@ -30,9 +30,37 @@
 #include <stdbool.h>
 #include <ctype.h>
 
+// Characters are collected in chunks of this size when printing to a putb_t
+#define EPRINTF_CHUNK_SIZE 32
+
+typedef struct
+{
+  putc_t putcf;
+  putb_t putbf;
+  int pos;
+  char chunk[EPRINTF_CHUNK_SIZE];
+} eprintfOutput_t;
+
 static const char digit[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 
                              'A', 'B', 'C', 'D', 'E', 'F'};
 
+static void put(eprintfOutput_t* out, char c)
+{
+  if (out->putbf)
+  {
+    out->chunk[out->pos++] = c;
+    if (out->pos == EPRINTF_CHUNK_SIZE)
+    {
+      out->putbf(out->chunk, out->pos);
+      out->pos = 0;
+    }
+  }
+  else
+  {
+    out->putcf(c);
+  }
+}
+
 static int getIntLen (long int value)
 {
   int l = 1;
@@ -57,13 +85,13 @@ int power(int a, int b)
   return x;
 }
 
-static int itoa10Unsigned(putc_t putcf, unsigned long long int num)
+static int itoa10Unsigned(eprintfOutput_t* out, unsigned long long int num)
 {
   int len = 0;
 
   if (num == 0)
   {
-    putcf('0');
+    put(out, '0');
     return 1;
   }
 
@@ -76,7 +104,7 @@ static int itoa10Unsigned(putc_t putcf, unsigned long long int num)
 
   do
   {
-    putcf(digit[(num / i) % 10L]);
+    put(out, digit[(num / i) % 10L]);
     len++;
   }
   while (i /= 10L);
@@ -84,13 +112,13 @@ static int itoa10Unsigned(putc_t putcf, unsigned long long int num)
   return len;
 }
 
-static int itoa10(putc_t putcf, long long int num, int precision)
+static int itoa10(eprintfOutput_t* out, long long int num, int precision)
 {
   int len = 0;
 
   if (num == 0)
   {
-    putcf('0');
+    put(out, '0');
     return 1;
   }
 
@@ -98,7 +126,7 @@ static int itoa10(putc_t putcf, long long int num, int precision)
   if (num < 0)
   {
     n = -num;
-    putcf('-');
+    put(out, '-');
     len++;
   }
 
@@ -108,16 +136,16 @@ static int itoa10(putc_t putcf, long long int num, int precision)
     int fillWithZero = precision - numLenght;
     while (fillWithZero > 0)
     {
-      putcf('0');
+      put(out, '0');
       len++;
       fillWithZero--;
     }
   }
 
-  return itoa10Unsigned(putcf, n) + len;
+  return itoa10Unsigned(out, n) + len;
 }
 
-static int itoa16(putc_t putcf, uint64_t num, int width, char padChar)
+static int itoa16(eprintfOutput_t* out, uint64_t num, int width, char padChar)
 {
   int len = 0;
   bool foundFirst = false;
@@ -137,11 +165,11 @@ static int itoa16(putc_t putcf, uint64_t num, int width, char padChar)
     {
       if (foundFirst)
       {
-        putcf(digit[val]);
+        put(out, digit[val]);
       }
       else
       {
-        putcf(padChar);
+        put(out, padChar);
       }
 
       len++;
@@ -151,7 +179,7 @@ static int itoa16(putc_t putcf, uint64_t num, int width, char padChar)
   return len;
 }
 
-static int handleLongLong(putc_t putcf, const char** fmt, unsigned long long int val, int width, char padChar)
+static int handleLongLong(eprintfOutput_t* out, const char** fmt, unsigned long long int val, int width, char padChar)
 {
   int len = 0;
 
@@ -159,14 +187,14 @@ static int handleLongLong(putc_t putcf, const char** fmt, unsigned long long int
   {
     case 'i':
     case 'd':
-      len = itoa10(putcf, (long long int)val, 0);
+      len = itoa10(out, (long long int)val, 0);
       break;
     case 'u':
-      len = itoa10Unsigned(putcf, val);
+      len = itoa10Unsigned(out, val);
       break;
     case 'x':
     case 'X':
-      len = itoa16(putcf, val, width, padChar);
+      len = itoa16(out, val, width, padChar);
       break;
     default:
       // Nothing here
@@ -176,7 +204,7 @@ static int handleLongLong(putc_t putcf, const char** fmt, unsigned long long int
   return len;
 }
 
-static int handleLong(putc_t putcf, const char** fmt, unsigned long int val, int width, char padChar)
+static int handleLong(eprintfOutput_t* out, const char** fmt, unsigned long int val, int width, char padChar)
 {
   int len = 0;
 
@@ -184,14 +212,14 @@ static int handleLong(putc_t putcf, const char** fmt, unsigned long int val, int
   {
     case 'i':
     case 'd':
-      len = itoa10(putcf, (long int)val, 0);
+      len = itoa10(out, (long int)val, 0);
       break;
     case 'u':
-      len = itoa10Unsigned(putcf, val);
+      len = itoa10Unsigned(out, val);
       break;
     case 'x':
     case 'X':
-      len = itoa16(putcf, val, width, padChar);
+      len = itoa16(out, val, width, padChar);
       break;
     default:
       // Nothing here
@@ -201,7 +229,7 @@ static int handleLong(putc_t putcf, const char** fmt, unsigned long int val, int
   return len;
 }
 
-int evprintf(putc_t putcf, const char * fmt, va_list ap)
+static int format(eprintfOutput_t* out, const char * fmt, va_list ap)
 {
   int len=0;
   float num;
@@ -248,22 +276,22 @@ int evprintf(putc_t putcf, const char * fmt, va_list ap)
       {
         case 'i':
         case 'd':
-          len += itoa10(putcf, va_arg(ap, int), 0);
+          len += itoa10(out, va_arg(ap, int), 0);
           break;
         case 'u':
-          len += itoa10Unsigned(putcf, va_arg(ap, unsigned int));
+          len += itoa10Unsigned(out, va_arg(ap, unsigned int));
           break;
         case 'x':
         case 'X':
-          len += itoa16(putcf, va_arg(ap, unsigned int), width, padChar);
+          len += itoa16(out, va_arg(ap, unsigned int), width, padChar);
           break;
         case 'l':
           // Look ahead for ll
           if (*fmt == 'l') {
             fmt++;
-            len += handleLongLong(putcf, &fmt, va_arg(ap, unsigned long long int), width, padChar);
+            len += handleLongLong(out, &fmt, va_arg(ap, unsigned long long int), width, padChar);
           } else {
-            len += handleLong(putcf, &fmt, va_arg(ap, unsigned long int), width, padChar);
+            len += handleLong(out, &fmt, va_arg(ap, unsigned long int), width, padChar);
           }
 
           break;
@@ -271,24 +299,24 @@ int evprintf(putc_t putcf, const char * fmt, va_list ap)
           num = va_arg(ap, double);
           if(num<0)
           {
-            putcf('-');
+            put(out, '-');
             num = -num;
             len++;
           }
-          len += itoa10(putcf, (int)num, 0);
-          putcf('.'); len++;
-          len += itoa10(putcf, (num - (int)num) * power(10,precision), precision);
+          len += itoa10(out, (int)num, 0);
+          put(out, '.'); len++;
+          len += itoa10(out, (num - (int)num) * power(10,precision), precision);
           break;
         case 's':
           str = va_arg(ap, char* );
           while(*str)
           {
-            putcf(*str++);
+            put(out, *str++);
             len++;
           }
           break;
         case 'c':
-          putcf((char)va_arg(ap, int));
+          put(out, (char)va_arg(ap, int));
           len++;
           break;
         default:
@@ -297,7 +325,7 @@ int evprintf(putc_t putcf, const char * fmt, va_list ap)
     }
     else
     {
-      putcf(*fmt++);
+      put(out, *fmt++);
       len++;
     }
   }
@@ -305,6 +333,12 @@ int evprintf(putc_t putcf, const char * fmt, va_list ap)
   return len;
 }
 
+int evprintf(putc_t putcf, const char * fmt, va_list ap)
+{
+  eprintfOutput_t out = {.putcf = putcf};
+  return format(&out, fmt, ap);
+}
+
 int eprintf(putc_t putcf, const char * fmt, ...)
 {
   va_list ap;
@@ -316,3 +350,28 @@ int eprintf(putc_t putcf, const char * fmt, ...)
 
   return len;
 }
+
+int evbprintf(putb_t putbf, const char * fmt, va_list ap)
+{
+  eprintfOutput_t out = {.putbf = putbf};
+  int len = format(&out, fmt, ap);
+
+  if (out.pos > 0)
+  {
+    putbf(out.chunk, out.pos);
+  }
+
+  return len;
+}
+
+int ebprintf(putb_t putbf, const char * fmt, ...)
+{
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = evbprintf(putbf, fmt, ap);
+  va_end(ap);
+
+  return len;
+}
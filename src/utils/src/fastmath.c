@@ -0,0 +1,179 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * fastmath.c - Fast single precision math functions for the control loops
+ */
+
+#include <math.h>
+
+#include "fastmath.h"
+
+#define PI_F 3.14159265358979f
+#define PI_2_F 1.57079632679490f
+#define PI_6_F 0.52359877559830f
+#define SQRT3_F 1.73205080756888f
+#define TAN_PI_12_F 0.26794919243112f
+
+// pi/2 split in two parts for the argument reduction (Cody-Waite), the high
+// part has trailing zero bits so that k * PIO2_HI is exact for moderate k
+#define PIO2_HI 1.5707397460937500f
+#define PIO2_LO 5.6580701146558e-5f
+#define TWO_OVER_PI 0.63661977236758f
+
+// Taylor polynomials on [-pi/4, pi/4], truncation error < 2e-9 (sin) and < 3e-8 (cos)
+static inline float sinPoly(const float r, const float r2)
+{
+  return r + r * r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f + r2 * (-1.0f / 5040.0f + r2 * (1.0f / 362880.0f))));
+}
+
+static inline float cosPoly(const float r2)
+{
+  return 1.0f + r2 * (-0.5f + r2 * (1.0f / 24.0f + r2 * (-1.0f / 720.0f + r2 * (1.0f / 40320.0f))));
+}
+
+void fastSinCos(float x, float *s, float *c)
+{
+  // Reduce to r in [-pi/4, pi/4], x = k * pi/2 + r
+  const float k = roundf(x * TWO_OVER_PI);
+  const float r = (x - k * PIO2_HI) - k * PIO2_LO;
+  const float r2 = r * r;
+
+  const float sr = sinPoly(r, r2);
+  const float cr = cosPoly(r2);
+
+  switch ((int)k & 3) {
+    case 0:
+      *s = sr;
+      *c = cr;
+      break;
+    case 1:
+      *s = cr;
+      *c = -sr;
+      break;
+    case 2:
+      *s = -sr;
+      *c = -cr;
+      break;
+    default:
+      *s = -cr;
+      *c = sr;
+      break;
+  }
+}
+
+float fastSin(float x)
+{
+  float s, c;
+  fastSinCos(x, &s, &c);
+  return s;
+}
+
+float fastCos(float x)
+{
+  float s, c;
+  fastSinCos(x, &s, &c);
+  return c;
+}
+
+// Arc tangent for a in [0, 1]
+static float atanUnit(float a)
+{
+  // Reduce to |t| <= tan(pi/12) with atan(a) = pi/6 + atan((sqrt(3) * a - 1) / (sqrt(3) + a))
+  float offset = 0.0f;
+  if (a > TAN_PI_12_F) {
+    a = (SQRT3_F * a - 1.0f) / (SQRT3_F + a);
+    offset = PI_6_F;
+  }
+
+  // Taylor polynomial, truncation error < 5e-8
+  const float a2 = a * a;
+  return offset + a + a * a2 * (-1.0f / 3.0f + a2 * (1.0f / 5.0f + a2 * (-1.0f / 7.0f + a2 * (1.0f / 9.0f))));
+}
+
+float fastAtan2(float y, float x)
+{
+  const float ax = fabsf(x);
+  const float ay = fabsf(y);
+
+  if (ax == 0.0f && ay == 0.0f) {
+    return 0.0f;
+  }
+
+  float angle;
+  if (ay <= ax) {
+    angle = atanUnit(ay / ax);
+  } else {
+    angle = PI_2_F - atanUnit(ax / ay);
+  }
+
+  if (x < 0.0f) {
+    angle = PI_F - angle;
+  }
+
+  return copysignf(angle, y);
+}
+
+float fastAsin(float x)
+{
+  if (x > 1.0f) {
+    x = 1.0f;
+  } else if (x < -1.0f) {
+    x = -1.0f;
+  }
+
+  return fastAtan2(x, sqrtf((1.0f - x) * (1.0f + x)));
+}
+
+float fastInvSqrt(float x)
+{
+  if (x <= 0.0f) {
+    return 0.0f;
+  }
+
+  return 1.0f / sqrtf(x);
+}
+
+void fastQuatToRpy(const float q[4], float rpy[3])
+{
+  const float qx = q[0];
+  const float qy = q[1];
+  const float qz = q[2];
+  const float qw = q[3];
+
+  rpy[0] = fastAtan2(2.0f * (qw * qx + qy * qz), 1.0f - 2.0f * (qx * qx + qy * qy));
+  rpy[1] = fastAsin(2.0f * (qw * qy - qx * qz));
+  rpy[2] = fastAtan2(2.0f * (qw * qz + qx * qy), 1.0f - 2.0f * (qy * qy + qz * qz));
+}
+
+void fastRpyToQuat(const float rpy[3], float q[4])
+{
+  float sr, cr, sp, cp, sy, cy;
+  fastSinCos(rpy[0] * 0.5f, &sr, &cr);
+  fastSinCos(rpy[1] * 0.5f, &sp, &cp);
+  fastSinCos(rpy[2] * 0.5f, &sy, &cy);
+
+  q[0] = sr * cp * cy - cr * sp * sy;
+  q[1] = cr * sp * cy + sr * cp * sy;
+  q[2] = cr * cp * sy - sr * sp * cy;
+  q[3] = cr * cp * cy + sr * sp * sy;
+}
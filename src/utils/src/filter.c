@@ -107,3 +107,73 @@ float lpf2pReset(lpf2pData* lpfData, float sample)
   lpfData->delay_element_2 = dval;
   return lpf2pApply(lpfData, sample);
 }
+
+/**
+ * Three axis biquad
+ */
+static void biquad3ResetState(biquad3Data* data)
+{
+  for (int i = 0; i < 3; i++) {
+    data->delay_element_1[i] = 0.0f;
+    data->delay_element_2[i] = 0.0f;
+  }
+}
+
+void biquad3InitLpf(biquad3Data* data, float sample_freq, float cutoff_freq)
+{
+  lpf2pData lpfData;
+  lpf2pSetCutoffFreq(&lpfData, sample_freq, cutoff_freq);
+
+  data->a1 = lpfData.a1;
+  data->a2 = lpfData.a2;
+  data->b0 = lpfData.b0;
+  data->b1 = lpfData.b1;
+  data->b2 = lpfData.b2;
+  biquad3ResetState(data);
+}
+
+void biquad3InitNotch(biquad3Data* data, float sample_freq, float center_freq, float q)
+{
+  biquad3SetNotchFreq(data, sample_freq, center_freq, q);
+  biquad3ResetState(data);
+}
+
+void biquad3SetNotchFreq(biquad3Data* data, float sample_freq, float center_freq, float q)
+{
+  float omega = 2.0f * M_PI_F * center_freq / sample_freq;
+  float cs = cosf(omega);
+  float alpha = sinf(omega) / (2.0f * q);
+  float a0 = 1.0f + alpha;
+
+  data->b0 = 1.0f / a0;
+  data->b1 = -2.0f * cs / a0;
+  data->b2 = data->b0;
+  data->a1 = data->b1;
+  data->a2 = (1.0f - alpha) / a0;
+}
+
+void biquad3Apply(biquad3Data* data, float values[3])
+{
+  const float a1 = data->a1;
+  const float a2 = data->a2;
+  const float b0 = data->b0;
+  const float b1 = data->b1;
+  const float b2 = data->b2;
+
+  for (int i = 0; i < 3; i++) {
+    const float sample = values[i];
+    const float delay_element_1 = data->delay_element_1[i];
+    const float delay_element_2 = data->delay_element_2[i];
+
+    float delay_element_0 = sample - delay_element_1 * a1 - delay_element_2 * a2;
+    if (!isfinite(delay_element_0)) {
+      // don't allow bad values to propigate via the filter
+      delay_element_0 = sample;
+    }
+
+    values[i] = delay_element_0 * b0 + delay_element_1 * b1 + delay_element_2 * b2;
+
+    data->delay_element_2[i] = delay_element_1;
+    data->delay_element_1[i] = delay_element_0;
+  }
+}
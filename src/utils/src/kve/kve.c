@@ -89,6 +89,68 @@ void kveDefrag(kveMemory_t *kve) {
     }
 }
 
+bool kveDefragStep(kveMemory_t *kve, size_t budget) {
+    size_t moved = 0;
+
+    while (moved < budget) {
+        size_t holeAddress = kveStorageFindHole(kve, FIRST_ITEM_ADDRESS);
+        if (KVE_STORAGE_IS_VALID(holeAddress) == false) {
+            return false;
+        }
+
+        size_t itemAddress = kveStorageFindNextItem(kve, holeAddress);
+        if (KVE_STORAGE_IS_VALID(itemAddress) == false) {
+            // Only holes left at the end, crop them
+            kveStorageWriteEnd(kve, holeAddress);
+            return false;
+        }
+
+        // Move one item down, the holes in between are merged after it
+        kveItemHeader_t header = kveStorageGetItemInfo(kve, itemAddress);
+        kveStorageMoveMemory(kve, itemAddress, holeAddress, header.full_length);
+        kveStorageWriteHole(kve, holeAddress + header.full_length, itemAddress - holeAddress);
+
+        moved += header.full_length;
+    }
+
+    return true;
+}
+
+void kveIndexBuild(kveMemory_t *kve) {
+    kveIndex_t* index = kve->index;
+    char key[255];
+
+    if (!index) {
+        return;
+    }
+
+    index->count = 0;
+    index->valid = true;
+
+    uint8_t version;
+    kve->read(VERSION_ADDRESS, &version, 1);
+    if (version != KVE_VERSION) {
+        index->valid = false;
+        return;
+    }
+
+    for (size_t itemAddress = FIRST_ITEM_ADDRESS; KVE_STORAGE_IS_VALID(itemAddress) && index->valid;
+         itemAddress = kveStorageFindNextItem(kve, itemAddress)) {
+        kveItemHeader_t header = kveStorageGetItemInfo(kve, itemAddress);
+
+        if (header.full_length == 0xffffu) {
+            break;
+        }
+
+        if (header.key_length == 0) {
+            continue;
+        }
+
+        size_t keyLength = kveStorageGetKey(kve, itemAddress, header, key, sizeof(key));
+        kveStorageIndexSet(kve, itemAddress, kveStorageKeyHash(key, keyLength));
+    }
+}
+
 bool kveStore(kveMemory_t *kve, char* key, const void* buffer, size_t length) {
     size_t itemAddress;
 
@@ -143,6 +205,11 @@ void kveFormat(kveMemory_t *kve) {
     uint8_t version = KVE_VERSION;
     kve->write(VERSION_ADDRESS, &version, 1);
     kveStorageWriteEnd(kve, FIRST_ITEM_ADDRESS);
+
+    if (kve->index) {
+        kve->index->count = 0;
+        kve->index->valid = true;
+    }
 }
 
 bool kveCheck(kveMemory_t *kve) {
@@ -164,3 +231,40 @@ bool kveCheck(kveMemory_t *kve) {
 
     return true;
 }
+
+void kveForeach(kveMemory_t *kve, const char* prefix, void* buffer, size_t bufferLength, kveFunc_t func) {
+    const size_t prefixLength = strlen(prefix);
+    char key[256];
+
+    // Nothing to iterate over in an unformatted table
+    uint8_t version;
+    kve->read(VERSION_ADDRESS, &version, 1);
+    if (version != KVE_VERSION) {
+        return;
+    }
+
+    for (size_t itemAddress = FIRST_ITEM_ADDRESS; KVE_STORAGE_IS_VALID(itemAddress);
+         itemAddress = kveStorageFindNextItem(kve, itemAddress)) {
+        kveItemHeader_t header = kveStorageGetItemInfo(kve, itemAddress);
+
+        if (header.full_length == 0xffffu) {
+            // End of the table
+            break;
+        }
+
+        if (header.key_length < prefixLength) {
+            // Holes and other keys
+            continue;
+        }
+
+        size_t keyLength = kveStorageGetKey(kve, itemAddress, header, key, sizeof(key) - 1);
+        key[keyLength] = '\0';
+
+        if (strncmp(key, prefix, prefixLength) == 0) {
+            size_t length = kveStorageGetBuffer(kve, itemAddress, header, buffer, bufferLength);
+            if (!func(key, buffer, length)) {
+                break;
+            }
+        }
+    }
+}
@@ -42,6 +42,75 @@ static size_t min(size_t a, size_t b)
 
 #define END_TAG (0xffffu)
 
+uint16_t kveStorageKeyHash(const char* key, size_t length)
+{
+  // 32 bit FNV-1a, folded to 16 bits
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)key[i];
+    hash *= 16777619u;
+  }
+
+  return (hash >> 16) ^ (hash & 0xffffu);
+}
+
+void kveStorageIndexSet(kveMemory_t *kve, size_t address, uint16_t hash)
+{
+  kveIndex_t* index = kve->index;
+  if (!index || !index->valid) {
+    return;
+  }
+
+  for (int i = 0; i < index->count; i++) {
+    if (index->entries[i].address == address) {
+      index->entries[i].hash = hash;
+      return;
+    }
+  }
+
+  if (index->count >= index->size) {
+    // Fall back to scanning the memory
+    index->valid = false;
+    return;
+  }
+
+  index->entries[index->count].hash = hash;
+  index->entries[index->count].address = address;
+  index->count++;
+}
+
+void kveStorageIndexRemove(kveMemory_t *kve, size_t address)
+{
+  kveIndex_t* index = kve->index;
+  if (!index || !index->valid) {
+    return;
+  }
+
+  for (int i = 0; i < index->count; i++) {
+    if (index->entries[i].address == address) {
+      index->count--;
+      index->entries[i] = index->entries[index->count];
+      return;
+    }
+  }
+}
+
+static void indexMove(kveMemory_t *kve, size_t sourceAddress, size_t destinationAddress, size_t length)
+{
+  kveIndex_t* index = kve->index;
+  if (!index || !index->valid) {
+    return;
+  }
+
+  for (int i = 0; i < index->count; i++) {
+    const size_t address = index->entries[i].address;
+    if (address >= sourceAddress && address < sourceAddress + length) {
+      index->entries[i].address = address - sourceAddress + destinationAddress;
+    }
+  }
+}
+
 int kveStorageWriteItem(kveMemory_t *kve, size_t address, const char* key, const void* buffer, size_t length)
 {
   kveItemHeader_t header;
@@ -55,6 +124,8 @@ int kveStorageWriteItem(kveMemory_t *kve, size_t address, const char* key, const
 
   kve->flush();
 
+  kveStorageIndexSet(kve, address, kveStorageKeyHash(key, header.key_length));
+
   return header.full_length;
 }
 
@@ -66,6 +137,8 @@ uint16_t kveStorageWriteHole(kveMemory_t *kve, size_t address, size_t full_lengt
   kve->write(address, &header, sizeof(header));
   kve->flush();
 
+  kveStorageIndexRemove(kve, address);
+
   return full_length;   
 }
 
@@ -95,15 +168,38 @@ void kveStorageMoveMemory(kveMemory_t *kve, size_t sourceAddress, size_t destina
     }
 
     kve->flush();
+
+    indexMove(kve, sourceAddress - length, destinationAddress - length, length);
 }
 
 size_t kveStorageFindItemByKey(kveMemory_t *kve, size_t address, const char * key) {
-    char searchBuffer[255];
+    char searchBuffer[3 + 255];
     size_t currentAddress = address;
     uint16_t length;
     uint8_t keyLength;
     uint8_t searchedKeyLength = strlen(key);
 
+    if (kve->index && kve->index->valid) {
+        const uint16_t hash = kveStorageKeyHash(key, searchedKeyLength);
+        const kveIndex_t* index = kve->index;
+
+        // Confirm the hash by reading the key, there may be collisions
+        for (int i = 0; i < index->count; i++) {
+            if (index->entries[i].hash != hash || index->entries[i].address < address) {
+                continue;
+            }
+
+            currentAddress = index->entries[i].address;
+            kve->read(currentAddress, searchBuffer, 3 + searchedKeyLength);
+            keyLength = searchBuffer[2];
+            if (keyLength == searchedKeyLength && !memcmp(key, &searchBuffer[3], keyLength)) {
+                return currentAddress;
+            }
+        }
+
+        return SIZE_MAX;
+    }
+
 
     while (currentAddress < (kve->memorySize - 3)) {
         kve->read(currentAddress, searchBuffer, 3);
@@ -65,10 +65,13 @@ static void idealToDistortedV1(const lighthouseCalibration_t* calib, const float
   const float x = 1.0f;
   const float y = tanf(ax);
   const float z = tanf(ay);
-  const float tIgnore = 0.0f;
 
-  distorted[0] = lighthouseCalibrationMeasurementModelLh1(x, y, z, tIgnore, &calib->sweep[0]);
-  distorted[1] = lighthouseCalibrationMeasurementModelLh1(x, z, -y, tIgnore, &calib->sweep[1]);
+  lighthouseCalibrationModelConstants_t constants[2];
+  lighthouseCalibrationInitModelConstants(&constants[0], 0.0f, &calib->sweep[0]);
+  lighthouseCalibrationInitModelConstants(&constants[1], 0.0f, &calib->sweep[1]);
+
+  distorted[0] = lighthouseCalibrationMeasurementModelLh1(x, y, z, &constants[0], &calib->sweep[0]);
+  distorted[1] = lighthouseCalibrationMeasurementModelLh1(x, z, -y, &constants[1], &calib->sweep[1]);
 }
 
 static void idealToDistortedV2(const lighthouseCalibration_t* calib, const float* ideal, float* distorted) {
@@ -82,8 +85,12 @@ static void idealToDistortedV2(const lighthouseCalibration_t* calib, const float
   const float y = tanf((a2 + a1) / 2.0f);
   const float z = sinf(a2 - a1) / (tan30 * (cosf(a2) + cosf(a1)));
 
-  distorted[0] = lighthouseCalibrationMeasurementModelLh2(x, y, z, -t30, &calib->sweep[0]);
-  distorted[1] = lighthouseCalibrationMeasurementModelLh2(x, y, z, t30, &calib->sweep[1]);
+  lighthouseCalibrationModelConstants_t constants[2];
+  lighthouseCalibrationInitModelConstants(&constants[0], -t30, &calib->sweep[0]);
+  lighthouseCalibrationInitModelConstants(&constants[1], t30, &calib->sweep[1]);
+
+  distorted[0] = lighthouseCalibrationMeasurementModelLh2(x, y, z, &constants[0], &calib->sweep[0]);
+  distorted[1] = lighthouseCalibrationMeasurementModelLh2(x, y, z, &constants[1], &calib->sweep[1]);
 }
 
 typedef void (* idealToDistortedFcn_t)(const lighthouseCalibration_t* calib, const float* ideal, float* distorted);
@@ -120,31 +127,173 @@ void lighthouseCalibrationApplyV2(const lighthouseCalibration_t* calib, const fl
   return lighthouseCalibrationApply(calib, rawAngles, correctedAngles, idealToDistortedV2);
 }
 
+static void idealToDistortedV1Batch(const lighthouseCalibration_t* calib, const lighthouseCalibrationModelConstants_t constants[2], const float ideal[][2], float distorted[][2], const int count) {
+  float x[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float y[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float z[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float minusY[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float predicted0[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float predicted1[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+
+  for (int i = 0; i < count; i++) {
+    const float ax = ideal[i][0];
+    const float ay = ideal[i][1];
+
+    x[i] = 1.0f;
+    y[i] = arm_sin_f32(ax) / arm_cos_f32(ax);
+    z[i] = arm_sin_f32(ay) / arm_cos_f32(ay);
+    minusY[i] = -y[i];
+  }
+
+  lighthouseCalibrationMeasurementModelLh1Batch(x, y, z, count, &constants[0], &calib->sweep[0], predicted0);
+  lighthouseCalibrationMeasurementModelLh1Batch(x, z, minusY, count, &constants[1], &calib->sweep[1], predicted1);
+
+  for (int i = 0; i < count; i++) {
+    distorted[i][0] = predicted0[i];
+    distorted[i][1] = predicted1[i];
+  }
+}
+
+static void idealToDistortedV2Batch(const lighthouseCalibration_t* calib, const lighthouseCalibrationModelConstants_t constants[2], const float ideal[][2], float distorted[][2], const int count) {
+  const float tan30 = 0.5773502691896258;
+
+  float x[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float y[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float z[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float predicted0[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+  float predicted1[LIGHTHOUSE_CALIBRATION_MAX_BATCH];
+
+  for (int i = 0; i < count; i++) {
+    const float a1 = ideal[i][0];
+    const float a2 = ideal[i][1];
+    const float aMean = (a2 + a1) / 2.0f;
+
+    x[i] = 1.0f;
+    y[i] = arm_sin_f32(aMean) / arm_cos_f32(aMean);
+    z[i] = arm_sin_f32(a2 - a1) / (tan30 * (arm_cos_f32(a2) + arm_cos_f32(a1)));
+  }
+
+  lighthouseCalibrationMeasurementModelLh2Batch(x, y, z, count, &constants[0], &calib->sweep[0], predicted0);
+  lighthouseCalibrationMeasurementModelLh2Batch(x, y, z, count, &constants[1], &calib->sweep[1], predicted1);
+
+  for (int i = 0; i < count; i++) {
+    distorted[i][0] = predicted0[i];
+    distorted[i][1] = predicted1[i];
+  }
+}
+
+typedef void (* idealToDistortedBatchFcn_t)(const lighthouseCalibration_t* calib, const lighthouseCalibrationModelConstants_t constants[2], const float ideal[][2], float distorted[][2], const int count);
+
+static void lighthouseCalibrationApplyBatch(const lighthouseCalibration_t* calib, const lighthouseCalibrationModelConstants_t constants[2], const float rawAngles[][2], float correctedAngles[][2], const int count, idealToDistortedBatchFcn_t idealToDistorted) {
+  const float max_delta = 0.0005f;
+
+  ASSERT(count <= LIGHTHOUSE_CALIBRATION_MAX_BATCH);
+
+  // Use distorted angle as a starting point
+  for (int i = 0; i < count; i++) {
+    correctedAngles[i][0] = rawAngles[i][0];
+    correctedAngles[i][1] = rawAngles[i][1];
+  }
+
+  // Iterate until all angle pairs have converged
+  for (int iteration = 0; iteration < 5; iteration++) {
+    float currentDistortedAngles[LIGHTHOUSE_CALIBRATION_MAX_BATCH][2];
+    idealToDistorted(calib, constants, (const float (*)[2])correctedAngles, currentDistortedAngles, count);
+
+    bool isConverged = true;
+    for (int i = 0; i < count; i++) {
+      const float delta0 = rawAngles[i][0] - currentDistortedAngles[i][0];
+      const float delta1 = rawAngles[i][1] - currentDistortedAngles[i][1];
+
+      correctedAngles[i][0] += delta0;
+      correctedAngles[i][1] += delta1;
+
+      if (fabsf(delta0) >= max_delta || fabsf(delta1) >= max_delta) {
+        isConverged = false;
+      }
+    }
+
+    if (isConverged) {
+      break;
+    }
+  }
+}
+
+void lighthouseCalibrationApplyV1Batch(const lighthouseCalibration_t* calib, const float rawAngles[][2], float correctedAngles[][2], const int count) {
+  lighthouseCalibrationModelConstants_t constants[2];
+  lighthouseCalibrationInitModelConstants(&constants[0], 0.0f, &calib->sweep[0]);
+  lighthouseCalibrationInitModelConstants(&constants[1], 0.0f, &calib->sweep[1]);
+
+  lighthouseCalibrationApplyBatch(calib, constants, rawAngles, correctedAngles, count, idealToDistortedV1Batch);
+}
+
+void lighthouseCalibrationApplyV2Batch(const lighthouseCalibration_t* calib, const float rawAngles[][2], float correctedAngles[][2], const int count) {
+  const float t30 = M_PI_F / 6.0f;
+
+  lighthouseCalibrationModelConstants_t constants[2];
+  lighthouseCalibrationInitModelConstants(&constants[0], -t30, &calib->sweep[0]);
+  lighthouseCalibrationInitModelConstants(&constants[1], t30, &calib->sweep[1]);
+
+  lighthouseCalibrationApplyBatch(calib, constants, rawAngles, correctedAngles, count, idealToDistortedV2Batch);
+}
+
 void lighthouseCalibrationApplyNothing(const float rawAngles[2], float correctedAngles[2]) {
   correctedAngles[0] = rawAngles[0];
   correctedAngles[1] = rawAngles[1];
 }
 
-float lighthouseCalibrationMeasurementModelLh1(const float x, const float y, const float z, const float t, const lighthouseCalibrationSweep_t* calib) {
+void lighthouseCalibrationInitModelConstants(lighthouseCalibrationModelConstants_t* constants, const float t, const lighthouseCalibrationSweep_t* calib) {
+  constants->tanT = tanf(t);
+  constants->tanTilt = tanf(t - calib->tilt);
+}
+
+float lighthouseCalibrationMeasurementModelLh1(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib) {
   const float ax = atan2f(y, x);
   const float ay = atan2f(z, x);
   const float r = arm_sqrt(x * x + y * y);
 
-  const float compTilt = asinf(clip1(z * tanf(calib->tilt) / r));
+  // t is 0 in LH1, tanTilt = tan(-tilt)
+  const float compTilt = asinf(clip1(-z * constants->tanTilt / r));
   const float compGib = -calib->gibmag * arm_sin_f32(ax + calib->gibphase);
   const float compCurve = calib->curve * ay * ay;
 
   return ax - (compTilt + calib->phase + compGib + compCurve);
 }
 
-float lighthouseCalibrationMeasurementModelLh2(const float x, const float y, const float z, const float t, const lighthouseCalibrationSweep_t* calib) {
+float lighthouseCalibrationMeasurementModelLh2(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib) {
   const float ax = atan2f(y, x);
   // const float ay = atan2f(z, x);
   const float r = arm_sqrt(x * x + y * y);
 
-  const float base = ax + asinf(clip1(z * tanf(t - calib->tilt) / r));
+  const float base = ax + asinf(clip1(z * constants->tanTilt / r));
   const float compGib = -calib->gibmag * arm_cos_f32(ax + calib->gibphase);
   // TODO krri Figure out how to use curve and ogee calibration parameters
 
   return base - (calib->phase + compGib);
 }
+
+void lighthouseCalibrationMeasurementModelLh1Batch(const float* x, const float* y, const float* z, const int count, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib, float* predicted) {
+  for (int i = 0; i < count; i++) {
+    const float ax = fastAtan2f(y[i], x[i]);
+    const float ay = fastAtan2f(z[i], x[i]);
+    const float r = arm_sqrt(x[i] * x[i] + y[i] * y[i]);
+
+    const float compTilt = fastAsinf(clip1(-z[i] * constants->tanTilt / r));
+    const float compGib = -calib->gibmag * arm_sin_f32(ax + calib->gibphase);
+    const float compCurve = calib->curve * ay * ay;
+
+    predicted[i] = ax - (compTilt + calib->phase + compGib + compCurve);
+  }
+}
+
+void lighthouseCalibrationMeasurementModelLh2Batch(const float* x, const float* y, const float* z, const int count, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib, float* predicted) {
+  for (int i = 0; i < count; i++) {
+    const float ax = fastAtan2f(y[i], x[i]);
+    const float r = arm_sqrt(x[i] * x[i] + y[i] * y[i]);
+
+    const float base = ax + fastAsinf(clip1(z[i] * constants->tanTilt / r));
+    const float compGib = -calib->gibmag * arm_cos_f32(ax + calib->gibphase);
+
+    predicted[i] = base - (calib->phase + compGib);
+  }
+}
@@ -115,6 +115,69 @@ bool lighthouseGeometryGetPositionFromRayIntersection(const baseStationGeometry_
     return intersect_lines(origin1, ray1, origin2, ray2, position, position_delta);
 }
 
+// The squared distance from a point p to a ray through o with direction d is |(I - d d^T)(p - o)|^2, the sum over all
+// rays is minimized by solving A p = b with A = sum(I - d d^T) and b = sum((I - d d^T) o)
+bool lighthouseGeometryGetPositionFromRays(const vec3d origins[], const vec3d rays[], const int count, vec3d position, float *position_delta) {
+    if (count < 2) {
+        return false;
+    }
+
+    // A is symmetric, only the upper triangle is accumulated
+    float a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    vec3d b = {0};
+    for (int i = 0; i < count; i++) {
+        const float* d = rays[i];
+        const float* o = origins[i];
+
+        const float p00 = 1.0f - d[0] * d[0];
+        const float p01 = -d[0] * d[1];
+        const float p02 = -d[0] * d[2];
+        const float p11 = 1.0f - d[1] * d[1];
+        const float p12 = -d[1] * d[2];
+        const float p22 = 1.0f - d[2] * d[2];
+
+        a00 += p00; a01 += p01; a02 += p02;
+        a11 += p11; a12 += p12;
+        a22 += p22;
+
+        b[0] += p00 * o[0] + p01 * o[1] + p02 * o[2];
+        b[1] += p01 * o[0] + p11 * o[1] + p12 * o[2];
+        b[2] += p02 * o[0] + p12 * o[1] + p22 * o[2];
+    }
+
+    // Solve with the adjugate, A is singular if all rays are parallel
+    const float c00 = a11 * a22 - a12 * a12;
+    const float c01 = a02 * a12 - a01 * a22;
+    const float c02 = a01 * a12 - a02 * a11;
+    const float c11 = a00 * a22 - a02 * a02;
+    const float c12 = a01 * a02 - a00 * a12;
+    const float c22 = a00 * a11 - a01 * a01;
+
+    const float det = a00 * c00 + a01 * c01 + a02 * c02;
+    if (fabsf(det) < 1e-5f) {
+        return false;
+    }
+
+    const float invDet = 1.0f / det;
+    position[0] = (c00 * b[0] + c01 * b[1] + c02 * b[2]) * invDet;
+    position[1] = (c01 * b[0] + c11 * b[1] + c12 * b[2]) * invDet;
+    position[2] = (c02 * b[0] + c12 * b[1] + c22 * b[2]) * invDet;
+
+    float squareSum = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const float* d = rays[i];
+        const vec3d w = {position[0] - origins[i][0], position[1] - origins[i][1], position[2] - origins[i][2]};
+        const float t = vec_dot(w, d);
+
+        // Component of w perpendicular to the ray
+        const vec3d e = {w[0] - t * d[0], w[1] - t * d[1], w[2] - t * d[2]};
+        squareSum += vec_dot(e, e);
+    }
+    arm_sqrt_f32(squareSum / count, position_delta);
+
+    return true;
+}
+
 void lighthouseGeometryGetBaseStationPosition(const baseStationGeometry_t* bs, vec3d baseStationPos) {
     // TODO: Make geometry adjustments within base station.
     vec3d rotated_origin_delta = {};
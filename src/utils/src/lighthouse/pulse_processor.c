@@ -49,15 +49,30 @@ bool pulseProcessorApplyCalibration(pulseProcessor_t *state, pulseProcessorResul
     sensorMeasurements = angles->sensorMeasurementsLh2;
   }
 
-  for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
-    pulseProcessorBaseStationMeasuremnt_t* bsMeasurement = &sensorMeasurements[sensor].baseStatonMeasurements[baseStation];
-    if (doApplyCalibration) {
-      if (lighthouseBsTypeV2 == angles->measurementType) {
-        lighthouseCalibrationApplyV2(calibrationData, bsMeasurement->angles, bsMeasurement->correctedAngles);
-      } else {
-        lighthouseCalibrationApplyV1(calibrationData, bsMeasurement->angles, bsMeasurement->correctedAngles);
-      }
+  if (doApplyCalibration) {
+    // Calibrate all sensors in one batch
+    float rawAngles[PULSE_PROCESSOR_N_SENSORS][PULSE_PROCESSOR_N_SWEEPS];
+    float correctedAngles[PULSE_PROCESSOR_N_SENSORS][PULSE_PROCESSOR_N_SWEEPS];
+    for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+      const pulseProcessorBaseStationMeasuremnt_t* bsMeasurement = &sensorMeasurements[sensor].baseStatonMeasurements[baseStation];
+      rawAngles[sensor][0] = bsMeasurement->angles[0];
+      rawAngles[sensor][1] = bsMeasurement->angles[1];
+    }
+
+    if (lighthouseBsTypeV2 == angles->measurementType) {
+      lighthouseCalibrationApplyV2Batch(calibrationData, (const float (*)[2])rawAngles, correctedAngles, PULSE_PROCESSOR_N_SENSORS);
     } else {
+      lighthouseCalibrationApplyV1Batch(calibrationData, (const float (*)[2])rawAngles, correctedAngles, PULSE_PROCESSOR_N_SENSORS);
+    }
+
+    for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+      pulseProcessorBaseStationMeasuremnt_t* bsMeasurement = &sensorMeasurements[sensor].baseStatonMeasurements[baseStation];
+      bsMeasurement->correctedAngles[0] = correctedAngles[sensor][0];
+      bsMeasurement->correctedAngles[1] = correctedAngles[sensor][1];
+    }
+  } else {
+    for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+      pulseProcessorBaseStationMeasuremnt_t* bsMeasurement = &sensorMeasurements[sensor].baseStatonMeasurements[baseStation];
       lighthouseCalibrationApplyNothing(bsMeasurement->angles, bsMeasurement->correctedAngles);
     }
   }
@@ -493,6 +493,10 @@ TESTABLE_STATIC bool getSystemSyncTime(const uint32_t syncTimes[], size_t nSyncT
 
 uint32_t anglesMask = (1 << (PULSE_PROCESSOR_N_SWEEPS * PULSE_PROCESSOR_N_SENSORS)) - 1;
 void pulseProcessorV1ProcessValidAngles(pulseProcessorResult_t* angles, int basestation) {
+  if (basestation >= PULSE_PROCESSOR_V1_N_BASE_STATIONS) {
+    return;
+  }
+
   validAngles &= ~(anglesMask << (basestation*PULSE_PROCESSOR_N_SWEEPS*PULSE_PROCESSOR_N_SENSORS));
   for(int sensor=0; sensor!=PULSE_PROCESSOR_N_SENSORS; sensor++) {
     if(angles->sensorMeasurementsLh1[sensor].baseStatonMeasurements[basestation].validCount != 0) {
@@ -503,5 +507,5 @@ void pulseProcessorV1ProcessValidAngles(pulseProcessorResult_t* angles, int base
 }
 
 uint8_t pulseProcessorV1AnglesQuality() {
-  return __builtin_popcount(validAngles)*1.0/(PULSE_PROCESSOR_N_SWEEPS*PULSE_PROCESSOR_N_SENSORS*PULSE_PROCESSOR_N_BASE_STATIONS)*255;
+  return __builtin_popcount(validAngles)*1.0/(PULSE_PROCESSOR_N_SWEEPS*PULSE_PROCESSOR_N_SENSORS*PULSE_PROCESSOR_V1_N_BASE_STATIONS)*255;
 }
@@ -38,8 +38,6 @@ static const uint32_t MAX_TICKS_SENSOR_TO_SENSOR = 10000;
 static const uint32_t MAX_TICKS_BETWEEN_SWEEP_STARTS_TWO_BLOCKS = 10;
 static const uint32_t MIN_TICKS_BETWEEN_SLOW_BITS = (887000 / 2) * 8 / 10; // 80 of one revolution
 
-static const uint8_t NO_CHANNEL = 0xff;
-static const int NO_SENSOR = -1;
 static const uint32_t NO_OFFSET = 0;
 
 #define V2_N_CHANNELS 16
@@ -56,23 +54,26 @@ static inline uint32_t cyclePeriodToMicroseconds(uint32_t cyclePeriod) {
     return cyclePeriod / 24;
 }
 
-// Reset angles after fixed period to avoid using stale data
-static void clearStaleAnglesAfterTimeout(pulseProcessorResult_t *angles) {
-    uint64_t timestamp = usecTimestamp();
-    for (int bs = 0; bs < PULSE_PROCESSOR_N_BASE_STATIONS; ++bs) {
-        uint64_t elapsed_us = timestamp - angles->lastUsecTimestamp[bs];
-        if (elapsed_us > cyclePeriodToMicroseconds(CYCLE_PERIODS[bs])) {
-            pulseProcessorClear(angles, bs);
-        }
+// Reset angles after fixed period to avoid using stale data. Only one base station is checked per call to keep the
+// cost per frame independent of the number of base stations, frames arrive much faster than the cycle periods.
+static void clearStaleAnglesAfterTimeout(pulseProcessorV2_t *stateV2, pulseProcessorResult_t *angles) {
+    const int bs = stateV2->staleCheckBaseStation;
+    stateV2->staleCheckBaseStation = (bs + 1) % PULSE_PROCESSOR_N_BASE_STATIONS;
+
+    uint64_t elapsed_us = usecTimestamp() - angles->lastUsecTimestamp[bs];
+    if (elapsed_us > cyclePeriodToMicroseconds(CYCLE_PERIODS[bs])) {
+        pulseProcessorClear(angles, bs);
     }
 }
 
-TESTABLE_STATIC bool processWorkspaceBlock(const pulseProcessorFrame_t slots[], pulseProcessorV2SweepBlock_t* block) {
+TESTABLE_STATIC bool processWorkspaceBlock(const pulseProcessorV2PulseWorkspace_t* pulseWorkspace, const int blockIndex, pulseProcessorV2SweepBlock_t* block) {
+    const int base = blockIndex * PULSE_PROCESSOR_N_SENSORS;
+    const uint16_t blockSlots = (1 << PULSE_PROCESSOR_N_SENSORS) - 1;
+
     // Check we have data for all sensors
     uint8_t sensorMask = 0;
-    for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
-        const pulseProcessorFrame_t* frame = &slots[i];
-        sensorMask |= (1 << frame->sensor);
+    for (int i = base; i < base + PULSE_PROCESSOR_N_SENSORS; i++) {
+        sensorMask |= (1 << pulseWorkspace->sensor[i]);
     }
 
     if (sensorMask != 0xf) {
@@ -81,62 +82,50 @@ TESTABLE_STATIC bool processWorkspaceBlock(const pulseProcessorFrame_t slots[],
     }
 
     // Channel - should all be the same or not set
-    block->channel = NO_CHANNEL;
-    for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
-        const pulseProcessorFrame_t* frame = &slots[i];
-
-        if (frame->channelFound) {
-            if (block->channel == NO_CHANNEL) {
-                block->channel = frame->channel;
-            }
-
-            if (block->channel != frame->channel) {
-                // Multiple channels in the block - discard
-                return false;
-            }
-        }
-    }
-
-    if (block->channel == NO_CHANNEL) {
+    uint16_t channelSlots = (pulseWorkspace->channelFoundMask >> base) & blockSlots;
+    if (channelSlots == 0) {
         // Channel is missing - discard
         return false;
     }
 
-    // Offset - should be offset on one and only one sensor
-    int indexWithOffset = NO_SENSOR;
-    for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
-        const pulseProcessorFrame_t* frame = &slots[i];
-
-        if (frame->offset != NO_OFFSET) {
-            if (indexWithOffset == NO_SENSOR) {
-                indexWithOffset = i;
-            } else {
-                // Duplicate offsets - discard
-                return false;
-            }
+    block->channel = pulseWorkspace->channel[base + __builtin_ctz(channelSlots)];
+    while (channelSlots) {
+        const int i = base + __builtin_ctz(channelSlots);
+        if (block->channel != pulseWorkspace->channel[i]) {
+            // Multiple channels in the block - discard
+            return false;
         }
+        channelSlots &= channelSlots - 1;
     }
 
-    if (indexWithOffset == NO_SENSOR) {
+    // Offset - should be offset on one and only one sensor
+    const uint16_t offsetSlots = (pulseWorkspace->offsetMask >> base) & blockSlots;
+    if (offsetSlots == 0) {
         // No offset found - discard
         return false;
     }
 
+    if (offsetSlots & (offsetSlots - 1)) {
+        // Duplicate offsets - discard
+        return false;
+    }
+
     // Calculate offsets for all sensors
-    const pulseProcessorFrame_t* baseSensor = &slots[indexWithOffset];
-    for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
-        const pulseProcessorFrame_t* frame = &slots[i];
-        uint8_t sensor = frame->sensor;
+    const int indexWithOffset = base + __builtin_ctz(offsetSlots);
+    const uint32_t baseTimestamp = pulseWorkspace->timestamp[indexWithOffset];
+    const uint32_t baseOffset = pulseWorkspace->offset[indexWithOffset];
+    for (int i = base; i < base + PULSE_PROCESSOR_N_SENSORS; i++) {
+        uint8_t sensor = pulseWorkspace->sensor[i];
 
         if (i == indexWithOffset) {
-            block->offset[sensor] = frame->offset;
+            block->offset[sensor] = baseOffset;
         } else {
-            uint32_t timestamp_delta = TS_DIFF(baseSensor->timestamp, frame->timestamp);
-            block->offset[sensor] = TS_DIFF(baseSensor->offset, timestamp_delta);
+            uint32_t timestamp_delta = TS_DIFF(baseTimestamp, pulseWorkspace->timestamp[i]);
+            block->offset[sensor] = TS_DIFF(baseOffset, timestamp_delta);
         }
     }
 
-    block->timestamp0 = TS_DIFF(baseSensor->timestamp, baseSensor->offset);
+    block->timestamp0 = TS_DIFF(baseTimestamp, baseOffset);
 
     return true;
 }
@@ -150,18 +139,20 @@ TESTABLE_STATIC bool processWorkspaceBlock(const pulseProcessorFrame_t slots[],
  */
 TESTABLE_STATIC void augmentFramesInWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace) {
     const int slotsUsed = pulseWorkspace->slotsUsed;
+    uint16_t channelFoundMask = pulseWorkspace->channelFoundMask;
 
     for (int i = 0; i < slotsUsed - 1; i++) {
-        pulseProcessorFrame_t* previousFrame = &pulseWorkspace->slots[i];
-        const pulseProcessorFrame_t* frame = &pulseWorkspace->slots[i + 1];
-        if (! previousFrame->channelFound) {
-            if (frame->channelFound) {
-                previousFrame->channel = frame->channel;
-                previousFrame->channelFound = frame->channelFound;
+        const uint16_t previousSlot = 1 << i;
+        if (! (channelFoundMask & previousSlot)) {
+            if (channelFoundMask & (previousSlot << 1)) {
+                pulseWorkspace->channel[i] = pulseWorkspace->channel[i + 1];
+                channelFoundMask |= previousSlot;
                 i++;
             }
         }
     }
+
+    pulseWorkspace->channelFoundMask = channelFoundMask;
 }
 
 static int processWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace, pulseProcessorV2BlockWorkspace_t* blockWorkspace) {
@@ -187,8 +178,7 @@ static int processWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace, pu
     // Process one block at a time in the workspace
     int blocksInWorkspace = slotsUsed / PULSE_PROCESSOR_N_SENSORS;
     for (int blockIndex = 0; blockIndex < blocksInWorkspace; blockIndex++) {
-        int blockBaseIndex = blockIndex * PULSE_PROCESSOR_N_SENSORS;
-        if (! processWorkspaceBlock(&pulseWorkspace->slots[blockBaseIndex], &blockWorkspace->blocks[blockIndex])) {
+        if (! processWorkspaceBlock(pulseWorkspace, blockIndex, &blockWorkspace->blocks[blockIndex])) {
             // If one block is bad, reject the full workspace
             return 0;
         }
@@ -199,8 +189,19 @@ static int processWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace, pu
 
 TESTABLE_STATIC bool storePulse(const pulseProcessorFrame_t* frameData, pulseProcessorV2PulseWorkspace_t* pulseWorkspace) {
     bool result = false;
-    if (pulseWorkspace->slotsUsed < PULSE_PROCESSOR_N_WORKSPACE) {
-        memcpy(&pulseWorkspace->slots[pulseWorkspace->slotsUsed], frameData, sizeof(pulseProcessorFrame_t));
+    const int slot = pulseWorkspace->slotsUsed;
+    if (slot < PULSE_PROCESSOR_N_WORKSPACE) {
+        pulseWorkspace->timestamp[slot] = frameData->timestamp;
+        pulseWorkspace->offset[slot] = frameData->offset;
+        pulseWorkspace->sensor[slot] = frameData->sensor;
+        pulseWorkspace->channel[slot] = frameData->channel;
+        if (frameData->channelFound) {
+            pulseWorkspace->channelFoundMask |= (1 << slot);
+        }
+        if (frameData->offset != NO_OFFSET) {
+            pulseWorkspace->offsetMask |= (1 << slot);
+        }
+
         pulseWorkspace->slotsUsed += 1;
         result = true;
     }
@@ -210,6 +211,8 @@ TESTABLE_STATIC bool storePulse(const pulseProcessorFrame_t* frameData, pulsePro
 
 TESTABLE_STATIC void clearWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace) {
     pulseWorkspace->slotsUsed = 0;
+    pulseWorkspace->channelFoundMask = 0;
+    pulseWorkspace->offsetMask = 0;
 }
 
 static bool processFrame(const pulseProcessorFrame_t* frameData, pulseProcessorV2PulseWorkspace_t* pulseWorkspace, pulseProcessorV2BlockWorkspace_t* blockWorkspace) {
@@ -292,7 +295,7 @@ TESTABLE_STATIC bool handleCalibrationData(pulseProcessor_t *state, const pulseP
 bool handleAngles(pulseProcessor_t *state, const pulseProcessorFrame_t* frameData, pulseProcessorResult_t* angles, int *baseStation, int *axis) {
     bool anglesMeasured = false;
 
-    clearStaleAnglesAfterTimeout(angles);
+    clearStaleAnglesAfterTimeout(&state->v2, angles);
 
     int nrOfBlocks = processFrame(frameData, &state->v2.pulseWorkspace, &state->v2.blockWorkspace);
     for (int i = 0; i < nrOfBlocks; i++) {
@@ -0,0 +1,157 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * lz4Stream.c - incremental decoder for the LZ4 block format
+ *
+ * A block is a list of sequences. A sequence starts with a token, the high
+ * nibble is the number of literals and the low nibble the match length minus
+ * 4. The value 15 in a nibble means that more length bytes follow, up to and
+ * including the first byte that is not 255. The literals come next, followed
+ * by a little endian 16 bit match offset. The last sequence has only literals.
+ */
+
+#include <errno.h>
+
+#include "lz4Stream.h"
+
+#define MIN_MATCH 4
+#define LENGTH_EXTENDED 15
+
+enum {
+  STATE_TOKEN,
+  STATE_LITERAL_LENGTH,
+  STATE_LITERALS,
+  STATE_OFFSET_LOW,
+  STATE_OFFSET_HIGH,
+  STATE_MATCH_LENGTH,
+};
+
+void lz4StreamInit(lz4Stream_t* stream, uint8_t* output, uint32_t capacity) {
+  stream->output = output;
+  stream->capacity = capacity;
+  stream->length = 0;
+  stream->state = STATE_TOKEN;
+  stream->literals = 0;
+  stream->matchLength = 0;
+  stream->matchOffset = 0;
+  stream->error = 0;
+}
+
+static int copyMatch(lz4Stream_t* stream) {
+  if (stream->matchOffset == 0 || stream->matchOffset > stream->length) {
+    return EINVAL;
+  }
+
+  if (stream->matchLength > stream->capacity - stream->length) {
+    return ENOSPC;
+  }
+
+  // Byte by byte, the match may overlap the bytes it produces
+  const uint8_t* from = &stream->output[stream->length - stream->matchOffset];
+  uint8_t* to = &stream->output[stream->length];
+  for (uint32_t i = 0; i < stream->matchLength; i++) {
+    to[i] = from[i];
+  }
+  stream->length += stream->matchLength;
+  stream->state = STATE_TOKEN;
+
+  return 0;
+}
+
+int lz4StreamDecode(lz4Stream_t* stream, const uint8_t* input, uint32_t length) {
+  const uint8_t* end = input + length;
+
+  while (stream->error == 0 && input < end) {
+    switch (stream->state) {
+      case STATE_TOKEN:
+        {
+          const uint8_t token = *input++;
+          stream->literals = token >> 4;
+          stream->matchLength = (token & 0x0f) + MIN_MATCH;
+          if (stream->literals == LENGTH_EXTENDED) {
+            stream->state = STATE_LITERAL_LENGTH;
+          } else if (stream->literals > 0) {
+            stream->state = STATE_LITERALS;
+          } else {
+            stream->state = STATE_OFFSET_LOW;
+          }
+        }
+        break;
+      case STATE_LITERAL_LENGTH:
+        stream->literals += *input;
+        if (*input++ != 255) {
+          stream->state = STATE_LITERALS;
+        }
+        break;
+      case STATE_LITERALS:
+        {
+          uint32_t count = end - input;
+          if (count > stream->literals) {
+            count = stream->literals;
+          }
+          if (count > stream->capacity - stream->length) {
+            stream->error = ENOSPC;
+            break;
+          }
+          for (uint32_t i = 0; i < count; i++) {
+            stream->output[stream->length + i] = input[i];
+          }
+          input += count;
+          stream->length += count;
+          stream->literals -= count;
+          if (stream->literals == 0) {
+            stream->state = STATE_OFFSET_LOW;
+          }
+        }
+        break;
+      case STATE_OFFSET_LOW:
+        stream->matchOffset = *input++;
+        stream->state = STATE_OFFSET_HIGH;
+        break;
+      case STATE_OFFSET_HIGH:
+        stream->matchOffset |= (uint16_t)(*input++) << 8;
+        if (stream->matchLength == LENGTH_EXTENDED + MIN_MATCH) {
+          stream->state = STATE_MATCH_LENGTH;
+        } else {
+          stream->error = copyMatch(stream);
+        }
+        break;
+      case STATE_MATCH_LENGTH:
+        stream->matchLength += *input;
+        if (*input++ != 255) {
+          stream->error = copyMatch(stream);
+        }
+        break;
+      default:
+        stream->error = EINVAL;
+        break;
+    }
+  }
+
+  return stream->error;
+}
+
+bool lz4StreamIsComplete(const lz4Stream_t* stream) {
+  return stream->error == 0 && stream->state == STATE_OFFSET_LOW;
+}
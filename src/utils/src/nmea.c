@@ -0,0 +1,240 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ * nmea.c - Incremental NMEA 0183 parser
+ */
+
+#include <string.h>
+
+#include "nmea.h"
+
+enum {
+  stateIdle,
+  stateData,
+  stateChecksum,
+};
+
+static int hexValue(const char ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  } else if (ch >= 'A' && ch <= 'F') {
+    return ch - 'A' + 10;
+  } else if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  }
+  return -1;
+}
+
+// Converts the field text to an integer mantissa and the number of decimals
+static uint8_t fieldToFixed(const nmeaParser_t* parser, uint64_t* mantissa) {
+  uint64_t value = 0;
+  uint8_t decimals = 0;
+  bool isFraction = false;
+
+  for (int i = 0; i < parser->textLength; i++) {
+    const char ch = parser->text[i];
+    if (ch == '.') {
+      isFraction = true;
+    } else if (ch >= '0' && ch <= '9') {
+      value = value * 10 + (ch - '0');
+      if (isFraction) {
+        decimals++;
+      }
+    }
+  }
+
+  *mantissa = value;
+  return decimals;
+}
+
+static uint32_t fieldToInt(const nmeaParser_t* parser) {
+  uint64_t mantissa;
+  uint8_t decimals = fieldToFixed(parser, &mantissa);
+  while (decimals-- > 0) {
+    mantissa /= 10;
+  }
+  return mantissa;
+}
+
+static float fieldToFloat(const nmeaParser_t* parser) {
+  uint64_t mantissa;
+  uint8_t decimals = fieldToFixed(parser, &mantissa);
+  float value = mantissa;
+  while (decimals-- > 0) {
+    value /= 10.0f;
+  }
+
+  if (parser->textLength > 0 && parser->text[0] == '-') {
+    value = -value;
+  }
+  return value;
+}
+
+// Converts ddmm.mmmm or dddmm.mmmm to 1e-7 degrees
+static int32_t fieldToCoordinate(const nmeaParser_t* parser) {
+  uint64_t mantissa;
+  uint8_t decimals = fieldToFixed(parser, &mantissa);
+
+  uint64_t scale = 1;
+  while (decimals-- > 0) {
+    scale *= 10;
+  }
+
+  const uint32_t degrees = mantissa / (100 * scale);
+  const uint64_t minutes = mantissa - degrees * 100 * scale;
+  return degrees * 10000000 + (int32_t)((minutes * 10000000) / (60 * scale));
+}
+
+static nmeaSentence_t sentenceType(const nmeaParser_t* parser) {
+  // The talker id (GP, GN, GL...) is ignored
+  if (parser->textLength != 5) {
+    return nmeaSentenceNone;
+  }
+
+  const char* type = &parser->text[2];
+  if (strncmp(type, "GGA", 3) == 0) {
+    return nmeaSentenceGga;
+  } else if (strncmp(type, "GSA", 3) == 0) {
+    return nmeaSentenceGsa;
+  }
+  return nmeaSentenceNone;
+}
+
+static void ggaField(nmeaParser_t* parser) {
+  nmeaGga_t* gga = &parser->pending.gga;
+
+  switch (parser->field) {
+    case 1: gga->fixTime = fieldToInt(parser); break;
+    case 2: gga->latitude = fieldToCoordinate(parser); break;
+    case 3: if (parser->textLength > 0 && parser->text[0] == 'S') { gga->latitude = -gga->latitude; } break;
+    case 4: gga->longitude = fieldToCoordinate(parser); break;
+    case 5: if (parser->textLength > 0 && parser->text[0] == 'W') { gga->longitude = -gga->longitude; } break;
+    case 6: gga->fixQuality = fieldToInt(parser); break;
+    case 7: gga->nsat = fieldToInt(parser); break;
+    case 8: gga->hdop = fieldToFloat(parser); break;
+    case 9: gga->altitude = fieldToFloat(parser); break;
+    case 11: gga->geoidSeparation = fieldToFloat(parser); break;
+    default: break;
+  }
+}
+
+static void gsaField(nmeaParser_t* parser) {
+  nmeaGsa_t* gsa = &parser->pending.gsa;
+
+  switch (parser->field) {
+    case 2: gsa->fix = fieldToInt(parser); break;
+    case 15: gsa->pdop = fieldToFloat(parser); break;
+    case 16: gsa->hdop = fieldToFloat(parser); break;
+    case 17: gsa->vdop = fieldToFloat(parser); break;
+    default:
+      // Fields 3 to 14 are the ids of the satellites used in the fix
+      if (parser->field >= 3 && parser->field <= 14 && parser->textLength > 0) {
+        gsa->nsat++;
+      }
+      break;
+  }
+}
+
+static void endOfField(nmeaParser_t* parser) {
+  if (parser->field == 0) {
+    parser->sentence = sentenceType(parser);
+    memset(&parser->pending, 0, sizeof(parser->pending));
+  } else if (parser->sentence == nmeaSentenceGga) {
+    ggaField(parser);
+  } else if (parser->sentence == nmeaSentenceGsa) {
+    gsaField(parser);
+  }
+
+  parser->field++;
+  parser->textLength = 0;
+}
+
+void nmeaParserInit(nmeaParser_t* parser) {
+  memset(parser, 0, sizeof(*parser));
+  parser->state = stateIdle;
+}
+
+nmeaSentence_t nmeaParse(nmeaParser_t* parser, const char ch) {
+  if (ch == '$') {
+    parser->state = stateData;
+    parser->checksum = 0;
+    parser->field = 0;
+    parser->textLength = 0;
+    parser->sentence = nmeaSentenceNone;
+    return nmeaSentenceNone;
+  }
+
+  switch (parser->state) {
+    case stateData:
+      if (ch == '*') {
+        endOfField(parser);
+        parser->receivedChecksum = 0;
+        parser->checksumDigits = 0;
+        parser->state = stateChecksum;
+      } else if (ch == '\r' || ch == '\n') {
+        // No checksum
+        parser->state = stateIdle;
+      } else {
+        parser->checksum ^= ch;
+        if (ch == ',') {
+          endOfField(parser);
+        } else if (parser->textLength < NMEA_MAX_FIELD_LENGTH) {
+          parser->text[parser->textLength++] = ch;
+        }
+      }
+      break;
+    case stateChecksum:
+      {
+        const int value = hexValue(ch);
+        if (value < 0) {
+          parser->checksumErrors++;
+          parser->state = stateIdle;
+          break;
+        }
+
+        parser->receivedChecksum = (parser->receivedChecksum << 4) | value;
+        parser->checksumDigits++;
+        if (parser->checksumDigits == 2) {
+          parser->state = stateIdle;
+          if (parser->receivedChecksum != parser->checksum) {
+            parser->checksumErrors++;
+            return nmeaSentenceNone;
+          }
+
+          if (parser->sentence == nmeaSentenceGga) {
+            parser->gga = parser->pending.gga;
+          } else if (parser->sentence == nmeaSentenceGsa) {
+            parser->gsa = parser->pending.gsa;
+          }
+          return parser->sentence;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  return nmeaSentenceNone;
+}
@@ -27,6 +27,17 @@
 
 #include "rateSupervisor.h"
 
+#include <stddef.h>
+#include <string.h>
+
+static rateSupervisor_t* registry[RATE_SUPERVISOR_MAX_REGISTERED];
+static int registryCount = 0;
+
+static void setExpectedCount(rateSupervisor_t* context, const uint32_t expectedCount) {
+    context->expectedCount = expectedCount;
+    context->expectedPeriodUs = expectedCount > 0 ? context->evaluationIntervalMs * 1000 / expectedCount : 0;
+}
+
 void rateSupervisorInit(rateSupervisor_t* context, const uint32_t osTimeMs, const uint32_t evaluationIntervalMs, const uint32_t minCount, const uint32_t maxCount, const uint8_t skip) {
     context->count = 0;
     context->evaluationIntervalMs = evaluationIntervalMs;
@@ -35,6 +46,65 @@ void rateSupervisorInit(rateSupervisor_t* context, const uint32_t osTimeMs, cons
     context->nextEvaluationTimeMs = osTimeMs + evaluationIntervalMs;
     context->latestCount = 0;
     context->skip = skip;
+
+    setExpectedCount(context, (minCount + maxCount) / 2);
+    context->hasPreviousTime = false;
+    memset(context->jitterHistogram, 0, sizeof(context->jitterHistogram));
+}
+
+void rateSupervisorInitRate(rateSupervisor_t* context, const uint32_t osTimeMs, const uint16_t expectedRate, const uint16_t tolerancePermille, const uint8_t skip) {
+    if (expectedRate == 0) {
+        rateSupervisorInit(context, osTimeMs, 1000, 0, UINT32_MAX, skip);
+        setExpectedCount(context, 0);
+        return;
+    }
+
+    const uint32_t tolerance = ((uint32_t)expectedRate * tolerancePermille + 999) / 1000;
+    const uint32_t minCount = tolerance < expectedRate ? expectedRate - tolerance : 0;
+    rateSupervisorInit(context, osTimeMs, 1000, minCount, expectedRate + tolerance, skip);
+    setExpectedCount(context, expectedRate);
+}
+
+static uint16_t jitterPercentile(const rateSupervisor_t* context, const uint32_t total, const uint32_t percent) {
+    const uint32_t threshold = (total * percent + 99) / 100;
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i < RATE_SUPERVISOR_JITTER_BUCKETS - 1; i++) {
+        sum += context->jitterHistogram[i];
+        if (sum >= threshold) {
+            break;
+        }
+    }
+
+    // The last bucket holds all longer deviations
+    return i < RATE_SUPERVISOR_JITTER_BUCKETS - 1 ? (1u << i) - 1 : UINT16_MAX;
+}
+
+static void updateStats(rateSupervisor_t* context, const bool ok, const bool warmingUp) {
+    rateSupervisorStats_t* stats = &context->stats;
+
+    stats->rate = context->count * 1000 / context->evaluationIntervalMs;
+    stats->ok = ok;
+    if (!warmingUp) {
+        if (!ok) {
+            stats->failures++;
+        }
+        if (context->count < context->expectedCount) {
+            stats->missed += context->expectedCount - context->count;
+        }
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < RATE_SUPERVISOR_JITTER_BUCKETS; i++) {
+        total += context->jitterHistogram[i];
+    }
+    if (total > 0) {
+        stats->jitterP50 = jitterPercentile(context, total, 50);
+        stats->jitterP95 = jitterPercentile(context, total, 95);
+        stats->jitterP99 = jitterPercentile(context, total, 99);
+    }
+    memset(context->jitterHistogram, 0, sizeof(context->jitterHistogram));
 }
 
 bool rateSupervisorValidate(rateSupervisor_t* context, const uint32_t osTimeMs) {
@@ -47,6 +117,8 @@ bool rateSupervisorValidate(rateSupervisor_t* context, const uint32_t osTimeMs)
             result = false;
         }
 
+        updateStats(context, result, context->skip > 0);
+
         context->latestCount = context->count;
         context->count = 0;
         context->nextEvaluationTimeMs = osTimeMs + context->evaluationIntervalMs;
@@ -60,6 +132,64 @@ bool rateSupervisorValidate(rateSupervisor_t* context, const uint32_t osTimeMs)
     return result;
 }
 
+bool rateSupervisorTick(rateSupervisor_t* context, const uint32_t osTimeMs, const uint32_t timeUs) {
+    // Event driven processes, without an expected rate, use the mean period of the latest interval
+    uint32_t periodUs = context->expectedPeriodUs;
+    if (periodUs == 0 && context->latestCount > 0) {
+        periodUs = context->evaluationIntervalMs * 1000 / context->latestCount;
+    }
+
+    if (context->hasPreviousTime && periodUs > 0) {
+        const uint32_t interval = timeUs - context->previousTimeUs;
+        const uint32_t deviation = interval > periodUs ? interval - periodUs : periodUs - interval;
+
+        int bucket = 0;
+        while (bucket < RATE_SUPERVISOR_JITTER_BUCKETS - 1 && (deviation >> bucket) != 0) {
+            bucket++;
+        }
+        if (context->jitterHistogram[bucket] < UINT16_MAX) {
+            context->jitterHistogram[bucket]++;
+        }
+    }
+    context->previousTimeUs = timeUs;
+    context->hasPreviousTime = true;
+
+    return rateSupervisorValidate(context, osTimeMs);
+}
+
 uint32_t rateSupervisorLatestCount(rateSupervisor_t* context) {
     return context->latestCount;
 }
+
+const rateSupervisorStats_t* rateSupervisorStats(const rateSupervisor_t* context) {
+    return &context->stats;
+}
+
+bool rateSupervisorRegister(rateSupervisor_t* context, const char* name) {
+    context->name = name;
+
+    for (int i = 0; i < registryCount; i++) {
+        if (registry[i] == context) {
+            return true;
+        }
+    }
+
+    if (registryCount >= RATE_SUPERVISOR_MAX_REGISTERED) {
+        return false;
+    }
+
+    registry[registryCount++] = context;
+    return true;
+}
+
+int rateSupervisorRegisteredCount(void) {
+    return registryCount;
+}
+
+const rateSupervisor_t* rateSupervisorRegistered(const int index) {
+    if (index < 0 || index >= registryCount) {
+        return NULL;
+    }
+
+    return registry[index];
+}
@@ -0,0 +1,149 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * spectrum.c - band energies and spectral peaks of a window of samples
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "spectrum.h"
+
+// One sided power spectrum, SPECTRUM_SIZE / 2 + 1 bins from DC to Nyquist
+#define SPECTRUM_BINS (SPECTRUM_SIZE / 2 + 1)
+
+static float power(const float* output, const int bin) {
+  // Packed output of arm_rfft_fast_f32(): DC and Nyquist are real and stored first
+  if (bin == 0) {
+    return output[0] * output[0];
+  }
+  if (bin == SPECTRUM_SIZE / 2) {
+    return output[1] * output[1];
+  }
+  const float re = output[2 * bin];
+  const float im = output[2 * bin + 1];
+  return re * re + im * im;
+}
+
+void spectrumInit(spectrum_t* spectrum, const float sampleRate, const float bandEdges[SPECTRUM_BAND_COUNT + 1]) {
+  memset(spectrum, 0, sizeof(spectrum_t));
+
+  // arm_rfft_fast_init_f32() references the twiddle tables of all FFT sizes, setting up the instance for the one
+  // size in use lets the linker drop the others (tens of kB of flash)
+  spectrum->fft.Sint = arm_cfft_sR_f32_len128;
+  spectrum->fft.fftLenRFFT = SPECTRUM_SIZE;
+  spectrum->fft.pTwiddleRFFT = (float32_t*)twiddleCoef_rfft_256;
+
+  spectrum->windowSquareSum = 0.0f;
+  for (int i = 0; i < SPECTRUM_SIZE; i++) {
+    const float w = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / SPECTRUM_SIZE);
+    spectrum->window[i] = w;
+    spectrum->windowSquareSum += w * w;
+  }
+
+  spectrum->sampleRate = sampleRate;
+  for (int i = 0; i < SPECTRUM_BAND_COUNT + 1; i++) {
+    spectrum->bandEdges[i] = bandEdges[i];
+  }
+}
+
+void spectrumAnalyze(spectrum_t* spectrum, const float* samples, const int stride, spectrumResult_t* result) {
+  float mean = 0.0f;
+  for (int i = 0; i < SPECTRUM_SIZE; i++) {
+    mean += samples[i * stride];
+  }
+  mean /= SPECTRUM_SIZE;
+
+  for (int i = 0; i < SPECTRUM_SIZE; i++) {
+    spectrum->input[i] = (samples[i * stride] - mean) * spectrum->window[i];
+  }
+
+  // The input buffer is used as scratch memory by the FFT
+  arm_rfft_fast_f32(&spectrum->fft, spectrum->input, spectrum->output, 0);
+  const float* output = spectrum->output;
+
+  memset(result, 0, sizeof(spectrumResult_t));
+  const float binWidth = spectrum->sampleRate / SPECTRUM_SIZE;
+
+  // Parseval: the mean square of the windowed signal is the sum of the power over all bins / (N * sum(w^2)). The
+  // bins between DC and Nyquist are counted twice in the one sided spectrum.
+  const float energyScale = 1.0f / (SPECTRUM_SIZE * spectrum->windowSquareSum);
+  int band = 0;
+  for (int bin = 0; bin < SPECTRUM_BINS; bin++) {
+    const float frequency = bin * binWidth;
+    while (band < SPECTRUM_BAND_COUNT && frequency >= spectrum->bandEdges[band + 1]) {
+      band++;
+    }
+    if (band == SPECTRUM_BAND_COUNT) {
+      break;
+    }
+    if (frequency >= spectrum->bandEdges[band]) {
+      const float twoSided = (bin == 0 || bin == SPECTRUM_SIZE / 2) ? 1.0f : 2.0f;
+      result->bandEnergy[band] += twoSided * power(output, bin) * energyScale;
+    }
+  }
+
+  // Largest local maxima, sorted by insertion
+  int peakBins[SPECTRUM_PEAK_COUNT] = {0};
+  float peakPowers[SPECTRUM_PEAK_COUNT] = {0};
+  int firstBin = (int)ceilf(spectrum->bandEdges[0] / binWidth);
+  if (firstBin < 1) {
+    firstBin = 1;
+  }
+  for (int bin = firstBin; bin < SPECTRUM_BINS - 1; bin++) {
+    const float p = power(output, bin);
+    if (p > power(output, bin - 1) && p >= power(output, bin + 1) && p > peakPowers[SPECTRUM_PEAK_COUNT - 1]) {
+      int i = SPECTRUM_PEAK_COUNT - 1;
+      while (i > 0 && p > peakPowers[i - 1]) {
+        peakPowers[i] = peakPowers[i - 1];
+        peakBins[i] = peakBins[i - 1];
+        i--;
+      }
+      peakPowers[i] = p;
+      peakBins[i] = bin;
+    }
+  }
+
+  // The amplitude of a sinusoid in the center of a bin is 2 * |X| / sum(w), sum(w) = N / 2 for the Hann window
+  const float amplitudeScale = 4.0f / SPECTRUM_SIZE;
+  for (int i = 0; i < SPECTRUM_PEAK_COUNT; i++) {
+    const int bin = peakBins[i];
+    if (bin == 0) {
+      continue;
+    }
+
+    // Parabolic interpolation of the magnitude around the peak
+    const float left = sqrtf(power(output, bin - 1));
+    const float center = sqrtf(peakPowers[i]);
+    const float right = sqrtf(power(output, bin + 1));
+    const float denominator = left - 2.0f * center + right;
+    float offset = 0.0f;
+    if (denominator < 0.0f) {
+      offset = 0.5f * (left - right) / denominator;
+    }
+
+    result->peaks[i].frequency = (bin + offset) * binWidth;
+    result->peaks[i].amplitude = center * amplitudeScale;
+  }
+}
@@ -0,0 +1,71 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * stageProfiler.c - utility for profiling the execution time of code stages
+ */
+
+#include <string.h>
+#include "stageProfiler.h"
+
+static void startWindow(stageProfiler_t* profiler) {
+    profiler->count = 0;
+    profiler->min = UINT32_MAX;
+    profiler->max = 0;
+    profiler->sum = 0;
+    memset(profiler->bins, 0, sizeof(profiler->bins));
+}
+
+void stageProfilerInit(stageProfiler_t* profiler, const uint32_t binWidth, const uint32_t windowSize) {
+    memset(profiler, 0, sizeof(stageProfiler_t));
+    profiler->binWidth = binWidth;
+    profiler->windowSize = windowSize;
+    startWindow(profiler);
+}
+
+void stageProfilerAdd(stageProfiler_t* profiler, const uint32_t cycles) {
+    if (cycles < profiler->min) {
+        profiler->min = cycles;
+    }
+    if (cycles > profiler->max) {
+        profiler->max = cycles;
+    }
+    profiler->sum += cycles;
+    profiler->count++;
+
+    int bin = 0;
+    uint32_t limit = profiler->binWidth;
+    while (bin < STAGE_PROFILER_HISTOGRAM_BINS - 1 && cycles >= limit) {
+        bin++;
+        limit *= 2;
+    }
+    profiler->bins[bin]++;
+
+    if (profiler->count >= profiler->windowSize) {
+        profiler->latestMin = profiler->min;
+        profiler->latestMax = profiler->max;
+        profiler->latestMean = profiler->sum / profiler->count;
+        memcpy(profiler->histogram, profiler->bins, sizeof(profiler->histogram));
+        startWindow(profiler);
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * staticPool.c - fixed size object pool in static memory
+ */
+
+#include "staticPool.h"
+#include "cfassert.h"
+
+void staticPoolInit(staticPool_t* pool, void* objects, uint16_t objectSize, uint16_t capacity, uint16_t* freeStack) {
+  pool->objects = objects;
+  pool->freeStack = freeStack;
+  pool->objectSize = objectSize;
+  pool->capacity = capacity;
+  pool->used = 0;
+  pool->highWater = 0;
+  pool->failures = 0;
+
+  staticPoolReset(pool);
+}
+
+void staticPoolReset(staticPool_t* pool) {
+  // Lowest index on top, objects are handed out in order after a reset
+  for (uint16_t i = 0; i < pool->capacity; i++) {
+    pool->freeStack[i] = pool->capacity - 1 - i;
+  }
+  pool->freeCount = pool->capacity;
+  pool->used = 0;
+}
+
+void* staticPoolAlloc(staticPool_t* pool) {
+  if (pool->freeCount == 0) {
+    pool->failures++;
+    return NULL;
+  }
+
+  pool->freeCount--;
+  const uint16_t index = pool->freeStack[pool->freeCount];
+
+  pool->used++;
+  if (pool->used > pool->highWater) {
+    pool->highWater = pool->used;
+  }
+
+  return pool->objects + (size_t)index * pool->objectSize;
+}
+
+void staticPoolFree(staticPool_t* pool, void* object) {
+  const size_t offset = (uint8_t*)object - pool->objects;
+  ASSERT(offset % pool->objectSize == 0);
+  ASSERT(offset / pool->objectSize < pool->capacity);
+  ASSERT(pool->freeCount < pool->capacity);
+
+  pool->freeStack[pool->freeCount] = offset / pool->objectSize;
+  pool->freeCount++;
+  pool->used--;
+}
@@ -44,6 +44,7 @@ The implementation must handle
 */
 
 #include <string.h>
+#include <math.h>
 
 #define DEBUG_MODULE "TDOA_ENGINE"
 #include "debug.h"
@@ -55,22 +56,40 @@ The implementation must handle
 
 #define MEASUREMENT_NOISE_STD 0.15f
 
+// The direction from an anchor to the tag is recalculated when the tag has moved this far (m)
+#define GEOMETRY_CACHE_MAX_MOVE 0.1f
+
 void tdoaEngineInit(tdoaEngineState_t* engineState, const uint32_t now_ms, tdoaEngineSendTdoaToEstimator sendTdoaToEstimator, const double locodeckTsFreq, const tdoaEngineMatchingAlgorithm_t matchingAlgorithm) {
-  tdoaStorageInitialize(engineState->anchorInfoArray);
+  tdoaStorageInitialize(&engineState->anchorStorage);
   tdoaStatsInit(&engineState->stats, now_ms);
   engineState->sendTdoaToEstimator = sendTdoaToEstimator;
+  engineState->sendTdoaBatchToEstimator = 0;
   engineState->locodeckTsFreq = locodeckTsFreq;
+  engineState->distancePerTick = SPEED_OF_LIGHT / locodeckTsFreq;
   engineState->matchingAlgorithm = matchingAlgorithm;
 
   engineState->matching.offset = 0;
+  engineState->matching.hasTagPosition = false;
+}
+
+void tdoaEngineSetBatchCallback(tdoaEngineState_t* engineState, tdoaEngineSendTdoaBatchToEstimator sendTdoaBatchToEstimator) {
+  engineState->sendTdoaBatchToEstimator = sendTdoaBatchToEstimator;
 }
 
-static void enqueueTDOA(const tdoaAnchorContext_t* anchorACtx, const tdoaAnchorContext_t* anchorBCtx, double distanceDiff, tdoaEngineState_t* engineState) {
+void tdoaEngineSetTagPosition(tdoaEngineState_t* engineState, const float x, const float y, const float z) {
+  engineState->matching.tagPosition[0] = x;
+  engineState->matching.tagPosition[1] = y;
+  engineState->matching.tagPosition[2] = z;
+  engineState->matching.hasTagPosition = true;
+}
+
+static void enqueueTDOA(const tdoaAnchorContext_t* anchorACtx, const tdoaAnchorContext_t* anchorBCtx, float distanceDiff, tdoaEngineState_t* engineState) {
   tdoaStats_t* stats = &engineState->stats;
 
   tdoaMeasurement_t tdoa = {
     .stdDev = MEASUREMENT_NOISE_STD,
-    .distanceDiff = distanceDiff
+    .distanceDiff = distanceDiff,
+    .anchorDistanceSq = tdoaStorageGetAnchorDistanceSq(anchorACtx, anchorBCtx),
   };
 
   if (tdoaStorageGetAnchorPosition(anchorACtx, &tdoa.anchorPositions[0]) && tdoaStorageGetAnchorPosition(anchorBCtx, &tdoa.anchorPositions[1])) {
@@ -98,12 +117,12 @@ static bool updateClockCorrection(tdoaAnchorContext_t* anchorCtx, const int64_t
   const int64_t latest_txAn_in_cl_An = tdoaStorageGetTxTime(anchorCtx);
 
   if (latest_rxAn_by_T_in_cl_T != 0 && latest_txAn_in_cl_An != 0) {
-    double clockCorrectionCandidate = clockCorrectionEngineCalculate(rxAn_by_T_in_cl_T, latest_rxAn_by_T_in_cl_T, txAn_in_cl_An, latest_txAn_in_cl_An, TDOA_ENGINE_TRUNCATE_TO_ANCHOR_TS_BITMAP);
-    sampleIsReliable = clockCorrectionEngineUpdate(tdoaStorageGetClockCorrectionStorage(anchorCtx), clockCorrectionCandidate);
+    const clockCorrection_t clockCorrectionCandidate = clockCorrectionEngineCalculateFixed(rxAn_by_T_in_cl_T, latest_rxAn_by_T_in_cl_T, txAn_in_cl_An, latest_txAn_in_cl_An, TDOA_ENGINE_TRUNCATE_TO_ANCHOR_TS_BITMAP);
+    sampleIsReliable = clockCorrectionEngineUpdateFixed(tdoaStorageGetClockCorrectionStorage(anchorCtx), clockCorrectionCandidate);
 
     if (sampleIsReliable){
       if (tdoaStorageGetId(anchorCtx) == stats->anchorId) {
-        stats->clockCorrection = tdoaStorageGetClockCorrection(anchorCtx);
+        stats->clockCorrection = clockCorrectionEngineToFloat(tdoaStorageGetClockCorrection(anchorCtx));
         STATS_CNT_RATE_EVENT(&stats->clockCorrectionCount);
       }
     }
@@ -117,19 +136,19 @@ static int64_t calcTDoA(const tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnc
 
   const int64_t tof_Ar_to_An_in_cl_An = tdoaStorageGetTimeOfFlight(anchorCtx, otherAnchorId);
   const int64_t rxAr_by_An_in_cl_An = tdoaStorageGetRemoteRxTime(anchorCtx, otherAnchorId);
-  const double clockCorrection = tdoaStorageGetClockCorrection(anchorCtx);
+  const clockCorrection_t clockCorrection = tdoaStorageGetClockCorrection(anchorCtx);
 
   const int64_t rxAr_by_T_in_cl_T = tdoaStorageGetRxTime(otherAnchorCtx);
 
   const int64_t delta_txAr_to_txAn_in_cl_An = (tof_Ar_to_An_in_cl_An + tdoaEngineTruncateToAnchorTimeStamp(txAn_in_cl_An - rxAr_by_An_in_cl_An));
-  const int64_t timeDiffOfArrival_in_cl_T =  tdoaEngineTruncateToAnchorTimeStamp(rxAn_by_T_in_cl_T - rxAr_by_T_in_cl_T) - delta_txAr_to_txAn_in_cl_An  * clockCorrection;
+  const int64_t timeDiffOfArrival_in_cl_T =  tdoaEngineTruncateToAnchorTimeStamp(rxAn_by_T_in_cl_T - rxAr_by_T_in_cl_T) - clockCorrectionEngineApply(clockCorrection, delta_txAr_to_txAn_in_cl_An);
 
   return timeDiffOfArrival_in_cl_T;
 }
 
-static double calcDistanceDiff(const tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, const double locodeckTsFreq) {
+static float calcDistanceDiff(const tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, const float distancePerTick) {
   const int64_t tdoa = calcTDoA(otherAnchorCtx, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T);
-  return SPEED_OF_LIGHT * tdoa / locodeckTsFreq;
+  return distancePerTick * (float)tdoa;
 }
 
 static bool matchRandomAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnchorContext_t* anchorCtx, const bool doExcludeId, const uint8_t excludedId) {
@@ -146,7 +165,7 @@ static bool matchRandomAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext_
     uint8_t index = i % remoteCount;
     const uint8_t candidateAnchorId = engineState->matching.id[index];
     if (!doExcludeId || (excludedId != candidateAnchorId)) {
-      if (tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, candidateAnchorId, now_ms, otherAnchorCtx)) {
+      if (tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, candidateAnchorId, now_ms, otherAnchorCtx)) {
         if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(otherAnchorCtx) && tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId)) {
           return true;
         }
@@ -170,7 +189,7 @@ static bool matchYoungestAnchor(tdoaEngineState_t* engineState, tdoaAnchorContex
       const uint8_t candidateAnchorId = engineState->matching.id[index];
       if (!doExcludeId || (excludedId != candidateAnchorId)) {
         if (tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId)) {
-          if (tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, candidateAnchorId, now_ms, otherAnchorCtx)) {
+          if (tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, candidateAnchorId, now_ms, otherAnchorCtx)) {
             uint32_t updateTime = otherAnchorCtx->anchorInfo->lastUpdateTime;
             if (updateTime > youmgestUpdateTime) {
               if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(otherAnchorCtx)) {
@@ -184,7 +203,7 @@ static bool matchYoungestAnchor(tdoaEngineState_t* engineState, tdoaAnchorContex
     }
 
     if (bestId >= 0) {
-      tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, bestId, now_ms, otherAnchorCtx);
+      tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, bestId, now_ms, otherAnchorCtx);
       return true;
     }
 
@@ -192,10 +211,97 @@ static bool matchYoungestAnchor(tdoaEngineState_t* engineState, tdoaAnchorContex
     return false;
 }
 
+// Get the unit vector from an anchor to the tag. The vector is cached in the anchor storage and only recalculated
+// when the tag has moved more than GEOMETRY_CACHE_MAX_MOVE or the anchor position has changed.
+static bool getUnitVectorToTag(const tdoaEngineState_t* engineState, const tdoaAnchorContext_t* anchorCtx, vec3d unitVector) {
+  tdoaGeometryCache_t* cache = tdoaStorageGetGeometryCache(anchorCtx);
+  const float* tagPosition = engineState->matching.tagPosition;
+
+  if (cache->isValid) {
+    const float dx = tagPosition[0] - cache->tagPosition[0];
+    const float dy = tagPosition[1] - cache->tagPosition[1];
+    const float dz = tagPosition[2] - cache->tagPosition[2];
+    if ((dx * dx + dy * dy + dz * dz) < (GEOMETRY_CACHE_MAX_MOVE * GEOMETRY_CACHE_MAX_MOVE)) {
+      memcpy(unitVector, cache->unitVector, sizeof(vec3d));
+      return true;
+    }
+  }
+
+  point_t anchorPosition;
+  if (! tdoaStorageGetAnchorPosition(anchorCtx, &anchorPosition)) {
+    return false;
+  }
+
+  const float dx = tagPosition[0] - anchorPosition.x;
+  const float dy = tagPosition[1] - anchorPosition.y;
+  const float dz = tagPosition[2] - anchorPosition.z;
+  const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+  if (distance < GEOMETRY_CACHE_MAX_MOVE) {
+    return false;
+  }
+
+  cache->unitVector[0] = dx / distance;
+  cache->unitVector[1] = dy / distance;
+  cache->unitVector[2] = dz / distance;
+  memcpy(cache->tagPosition, tagPosition, sizeof(vec3d));
+  cache->isValid = true;
+
+  memcpy(unitVector, cache->unitVector, sizeof(vec3d));
+  return true;
+}
+
+// Pick the anchor that gives the most information in a TDoA measurement together with the anchor in anchorCtx.
+// The gradient of the measured distance difference with respect to the tag position is the difference of the unit
+// vectors from the two anchors to the tag, a long gradient means a small geometric dilution of precision.
+static bool matchGeometryAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnchorContext_t* anchorCtx, const bool doExcludeId, const uint8_t excludedId) {
+  vec3d unitVector;
+  if (! engineState->matching.hasTagPosition || ! getUnitVectorToTag(engineState, anchorCtx, unitVector)) {
+    return matchRandomAnchor(engineState, otherAnchorCtx, anchorCtx, doExcludeId, excludedId);
+  }
+
+  int remoteCount = 0;
+  tdoaStorageGetRemoteSeqNrList(anchorCtx, &remoteCount, engineState->matching.seqNr, engineState->matching.id);
+
+  uint32_t now_ms = anchorCtx->currentTime_ms;
+  float bestScore = -1.0f;
+  int bestId = -1;
+
+  for (int index = 0; index < remoteCount; index++) {
+    const uint8_t candidateAnchorId = engineState->matching.id[index];
+    if (!doExcludeId || (excludedId != candidateAnchorId)) {
+      if (tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId)) {
+        if (tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, candidateAnchorId, now_ms, otherAnchorCtx)) {
+          if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(otherAnchorCtx)) {
+            vec3d otherUnitVector;
+            if (getUnitVectorToTag(engineState, otherAnchorCtx, otherUnitVector)) {
+              const float gx = unitVector[0] - otherUnitVector[0];
+              const float gy = unitVector[1] - otherUnitVector[1];
+              const float gz = unitVector[2] - otherUnitVector[2];
+              const float score = gx * gx + gy * gy + gz * gz;
+              if (score > bestScore) {
+                bestScore = score;
+                bestId = candidateAnchorId;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (bestId >= 0) {
+    tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, bestId, now_ms, otherAnchorCtx);
+    return true;
+  }
+
+  otherAnchorCtx->anchorInfo = 0;
+  return false;
+}
+
 static bool findSuitableAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnchorContext_t* anchorCtx, const bool doExcludeId, const uint8_t excludedId) {
   bool result = false;
 
-  if (tdoaStorageGetClockCorrection(anchorCtx) > 0.0) {
+  if (tdoaStorageGetClockCorrection(anchorCtx) > 0) {
     switch(engineState->matchingAlgorithm) {
       case TdoaEngineMatchingAlgorithmRandom:
         result = matchRandomAnchor(engineState, otherAnchorCtx, anchorCtx, doExcludeId, excludedId);
@@ -205,6 +311,10 @@ static bool findSuitableAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext
         result = matchYoungestAnchor(engineState, otherAnchorCtx, anchorCtx, doExcludeId, excludedId);
         break;
 
+      case TdoaEngineMatchingAlgorithmGeometry:
+        result = matchGeometryAnchor(engineState, otherAnchorCtx, anchorCtx, doExcludeId, excludedId);
+        break;
+
       default:
         // Do nothing
         break;
@@ -214,8 +324,79 @@ static bool findSuitableAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext
   return result;
 }
 
+// Calculate TDoA measurements against all suitable remote anchors and send them as one batch. The candidates are
+// tried in the order of the remote anchor list, starting at an offset that changes for each call.
+// Returns true if at least one measurement was sent.
+static bool processPacketBatch(tdoaEngineState_t* engineState, const tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, const bool doExcludeId, const uint8_t excludedId) {
+  tdoaStats_t* stats = &engineState->stats;
+
+  if (tdoaStorageGetClockCorrection(anchorCtx) <= 0) {
+    return false;
+  }
+
+  point_t anchorPosition;
+  if (! tdoaStorageGetAnchorPosition(anchorCtx, &anchorPosition)) {
+    return false;
+  }
+
+  tdoaBatchMeasurement_t batch = {
+    .anchorPosition = {anchorPosition.x, anchorPosition.y, anchorPosition.z},
+    .anchorId = tdoaStorageGetId(anchorCtx),
+    .count = 0,
+    .stdDev = MEASUREMENT_NOISE_STD,
+  };
+
+  engineState->matching.offset++;
+  int remoteCount = 0;
+  tdoaStorageGetRemoteSeqNrList(anchorCtx, &remoteCount, engineState->matching.seqNr, engineState->matching.id);
+
+  uint32_t now_ms = anchorCtx->currentTime_ms;
+  for (int i = engineState->matching.offset; i < (remoteCount + engineState->matching.offset) && batch.count < TDOA_BATCH_MAX_COUNT; i++) {
+    uint8_t index = i % remoteCount;
+    const uint8_t candidateAnchorId = engineState->matching.id[index];
+    if (doExcludeId && (excludedId == candidateAnchorId)) {
+      continue;
+    }
+
+    tdoaAnchorContext_t otherAnchorCtx;
+    if (tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, candidateAnchorId, now_ms, &otherAnchorCtx)) {
+      point_t otherPosition;
+      if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(&otherAnchorCtx) &&
+          tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId) &&
+          tdoaStorageGetAnchorPosition(&otherAnchorCtx, &otherPosition)) {
+        const float distanceDiff = calcDistanceDiff(&otherAnchorCtx, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, engineState->distancePerTick);
+
+        const int item = batch.count;
+        batch.otherAnchorPositions[item][0] = otherPosition.x;
+        batch.otherAnchorPositions[item][1] = otherPosition.y;
+        batch.otherAnchorPositions[item][2] = otherPosition.z;
+        batch.otherAnchorIds[item] = candidateAnchorId;
+        batch.distanceDiffs[item] = distanceDiff;
+        batch.otherAnchorDistancesSq[item] = tdoaStorageGetAnchorDistanceSq(anchorCtx, &otherAnchorCtx);
+        batch.count++;
+
+        STATS_CNT_RATE_EVENT(&stats->packetsToEstimator);
+        if (candidateAnchorId == stats->anchorId && batch.anchorId == stats->remoteAnchorId) {
+          stats->tdoa = distanceDiff;
+        }
+        if (batch.anchorId == stats->anchorId && candidateAnchorId == stats->remoteAnchorId) {
+          stats->tdoa = -distanceDiff;
+        }
+      }
+    }
+  }
+
+  if (batch.count > 0) {
+    STATS_CNT_RATE_EVENT(&stats->suitableDataFound);
+    engineState->sendTdoaBatchToEstimator(&batch);
+    return true;
+  }
+
+  return false;
+}
+
 void tdoaEngineGetAnchorCtxForPacketProcessing(tdoaEngineState_t* engineState, const uint8_t anchorId, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
-  if (tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, anchorId, currentTime_ms, anchorCtx)) {
+  if (tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, anchorId, currentTime_ms, anchorCtx)) {
     STATS_CNT_RATE_EVENT(&engineState->stats.contextHitCount);
   } else {
     STATS_CNT_RATE_EVENT(&engineState->stats.contextMissCount);
@@ -226,15 +407,43 @@ void tdoaEngineProcessPacket(tdoaEngineState_t* engineState, tdoaAnchorContext_t
   tdoaEngineProcessPacketFiltered(engineState, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, false, 0);
 }
 
+// The difference between the time from the previous packet to this one, measured by the tag, and the same time
+// measured by the anchor and converted to the tag clock. Ideally 0, the spread is the rx timestamp jitter.
+static void updateRxResidualStats(const tdoaEngineState_t* engineState, const tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, tdoaAnchorStats_t* anchorStats) {
+  const int64_t latest_rxAn_by_T_in_cl_T = tdoaStorageGetRxTime(anchorCtx);
+  const int64_t latest_txAn_in_cl_An = tdoaStorageGetTxTime(anchorCtx);
+  const clockCorrection_t clockCorrection = tdoaStorageGetClockCorrection(anchorCtx);
+
+  if (latest_rxAn_by_T_in_cl_T != 0 && latest_txAn_in_cl_An != 0 && clockCorrection > 0) {
+    const int64_t rxInterval = tdoaEngineTruncateToAnchorTimeStamp(rxAn_by_T_in_cl_T - latest_rxAn_by_T_in_cl_T);
+    const int64_t txInterval = tdoaEngineTruncateToAnchorTimeStamp(txAn_in_cl_An - latest_txAn_in_cl_An);
+    const int64_t residual = rxInterval - clockCorrectionEngineApply(clockCorrection, txInterval);
+    tdoaStatsAnchorRxResidual(anchorStats, (float)(residual * 1e9 / engineState->locodeckTsFreq));
+  }
+}
+
 void tdoaEngineProcessPacketFiltered(tdoaEngineState_t* engineState, tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, const bool doExcludeId, const uint8_t excludedId) {
+  tdoaAnchorStats_t* anchorStats = tdoaStatsGetAnchorStats(&engineState->stats, tdoaStorageGetId(anchorCtx), anchorCtx->currentTime_ms);
+  tdoaStatsAnchorPacketReceived(anchorStats, anchorCtx->currentTime_ms);
+  updateRxResidualStats(engineState, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, anchorStats);
+
   bool timeIsGood = updateClockCorrection(anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, &engineState->stats);
   if (timeIsGood) {
     STATS_CNT_RATE_EVENT(&engineState->stats.timeIsGood);
+    tdoaStatsAnchorClockCorrection(anchorStats, tdoaStorageGetClockCorrection(anchorCtx));
+
+    if (engineState->useBatch && engineState->sendTdoaBatchToEstimator) {
+      if (processPacketBatch(engineState, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, doExcludeId, excludedId)) {
+        tdoaStatsAnchorTdoaFound(anchorStats);
+      }
+      return;
+    }
 
     tdoaAnchorContext_t otherAnchorCtx;
     if (findSuitableAnchor(engineState, &otherAnchorCtx, anchorCtx, doExcludeId, excludedId)) {
       STATS_CNT_RATE_EVENT(&engineState->stats.suitableDataFound);
-      double tdoaDistDiff = calcDistanceDiff(&otherAnchorCtx, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, engineState->locodeckTsFreq);
+      tdoaStatsAnchorTdoaFound(anchorStats);
+      float tdoaDistDiff = calcDistanceDiff(&otherAnchorCtx, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, engineState->distancePerTick);
       enqueueTDOA(&otherAnchorCtx, anchorCtx, tdoaDistDiff, engineState);
     }
   }
@@ -28,11 +28,57 @@ Log statistics for the tdoa engine
 */
 
 #include <string.h>
+#include <math.h>
 
 #include "tdoaStats.h"
 
 #define STATS_INTERVAL 500
 
+// Filter coefficient for the per anchor clock correction change and rx jitter
+#define ANCHOR_STATS_FILTER_ALPHA 0.05f
+
+static uint32_t saturate(const float value, const uint32_t max) {
+  if (value <= 0.0f) {
+    return 0;
+  }
+  if (value >= max) {
+    return max;
+  }
+  return (uint32_t)value;
+}
+
+static void updateAnchorLog(tdoaStats_t* tdoaStats, const uint32_t now_ms, const uint32_t interval_ms) {
+  for (int i = 0; i < TDOA_STATS_ANCHOR_COUNT; i++) {
+    tdoaAnchorStats_t* anchorStats = &tdoaStats->anchors[i];
+
+    if (!anchorStats->isUsed) {
+      tdoaStats->anchorLogA[i] = 0;
+      tdoaStats->anchorLogB[i] = 0;
+      continue;
+    }
+
+    uint32_t packetRate = 0;
+    if (interval_ms > 0) {
+      packetRate = saturate(anchorStats->packetCount * 1000.0f / interval_ms, 0xff);
+    }
+
+    uint32_t acceptance = 0;
+    if (anchorStats->packetCount > 0) {
+      acceptance = saturate(anchorStats->tdoaFoundCount * 100.0f / anchorStats->packetCount, 100);
+    }
+
+    const uint32_t age = saturate((now_ms - anchorStats->lastSeen_ms) / 100.0f, 0xff);
+    const uint32_t jitter = saturate(anchorStats->rxJitter_ns, 0xffff);
+    const uint32_t clockCorrectionChange = saturate(anchorStats->clockCorrectionChange * 1e9f, 0xffff);
+
+    tdoaStats->anchorLogA[i] = anchorStats->id | (packetRate << 8) | (acceptance << 16) | (age << 24);
+    tdoaStats->anchorLogB[i] = jitter | (clockCorrectionChange << 16);
+
+    anchorStats->packetCount = 0;
+    anchorStats->tdoaFoundCount = 0;
+  }
+}
+
 
 void tdoaStatsInit(tdoaStats_t* tdoaStats, uint32_t now_ms) {
   memset(tdoaStats, 0, sizeof(tdoaStats_t));
@@ -69,7 +115,58 @@ void tdoaStatsUpdate(tdoaStats_t* tdoaStats, uint32_t now_ms) {
       tdoaStats->tdoa = 0;
     }
 
+    updateAnchorLog(tdoaStats, now_ms, now_ms - tdoaStats->previousStatisticsTime);
+
     tdoaStats->previousStatisticsTime = now_ms;
     tdoaStats->nextStatisticsTime = now_ms + STATS_INTERVAL;
   }
 }
+
+tdoaAnchorStats_t* tdoaStatsGetAnchorStats(tdoaStats_t* tdoaStats, const uint8_t anchorId, const uint32_t now_ms) {
+  tdoaAnchorStats_t* oldest = &tdoaStats->anchors[0];
+
+  for (int i = 0; i < TDOA_STATS_ANCHOR_COUNT; i++) {
+    tdoaAnchorStats_t* anchorStats = &tdoaStats->anchors[i];
+    if (anchorStats->isUsed && anchorStats->id == anchorId) {
+      return anchorStats;
+    }
+
+    if (!anchorStats->isUsed) {
+      if (oldest->isUsed) {
+        oldest = anchorStats;
+      }
+    } else if (oldest->isUsed && (now_ms - anchorStats->lastSeen_ms) > (now_ms - oldest->lastSeen_ms)) {
+      oldest = anchorStats;
+    }
+  }
+
+  memset(oldest, 0, sizeof(tdoaAnchorStats_t));
+  oldest->id = anchorId;
+  oldest->isUsed = true;
+  oldest->lastSeen_ms = now_ms;
+
+  return oldest;
+}
+
+void tdoaStatsAnchorPacketReceived(tdoaAnchorStats_t* anchorStats, const uint32_t now_ms) {
+  anchorStats->lastSeen_ms = now_ms;
+  anchorStats->packetCount++;
+}
+
+void tdoaStatsAnchorClockCorrection(tdoaAnchorStats_t* anchorStats, const clockCorrection_t clockCorrection) {
+  if (anchorStats->previousClockCorrection > 0) {
+    const clockCorrection_t change = clockCorrection - anchorStats->previousClockCorrection;
+    const float absChange = fabsf((float)change / (float)CLOCK_CORRECTION_ONE);
+    anchorStats->clockCorrectionChange += ANCHOR_STATS_FILTER_ALPHA * (absChange - anchorStats->clockCorrectionChange);
+  }
+
+  anchorStats->previousClockCorrection = clockCorrection;
+}
+
+void tdoaStatsAnchorRxResidual(tdoaAnchorStats_t* anchorStats, const float residual_ns) {
+  anchorStats->rxJitter_ns += ANCHOR_STATS_FILTER_ALPHA * (fabsf(residual_ns) - anchorStats->rxJitter_ns);
+}
+
+void tdoaStatsAnchorTdoaFound(tdoaAnchorStats_t* anchorStats) {
+  anchorStats->tdoaFoundCount++;
+}
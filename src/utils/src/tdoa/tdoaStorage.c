@@ -42,37 +42,45 @@ Data storage encapsulation for the TDoA engine
 #define ANCHOR_ACTIVE_VALIDITY_PERIOD (2 * 1000)
 
 
-static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorInfo_t anchorStorage[], const uint8_t slot, const uint8_t anchor);
+static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorStorage_t* anchorStorage, const uint8_t slot, const uint8_t anchor);
+static int findRemoteAnchorDataIndex(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor);
+static int findRemoteAnchorDataIndexForUpdate(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor);
+static int findTofIndex(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor);
+static int findTofIndexForUpdate(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor);
 
-void tdoaStorageInitialize(tdoaAnchorInfo_t anchorStorage[]) {
-  memset(anchorStorage, 0, sizeof(tdoaAnchorInfo_t) * ANCHOR_STORAGE_COUNT);
+static uint16_t latestPositionVersion = 0;
+
+void tdoaStorageInitialize(tdoaAnchorStorage_t* anchorStorage) {
+  memset(anchorStorage, 0, sizeof(tdoaAnchorStorage_t));
 }
 
-bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
+bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
   anchorCtx->currentTime_ms = currentTime_ms;
+
+  const uint8_t slotPlusOne = anchorStorage->slotPlusOne[anchor];
+  if (slotPlusOne) {
+    anchorCtx->anchorInfo = &anchorStorage->anchorInfo[slotPlusOne - 1];
+    return true;
+  }
+
+  // The anchor was not found in storage, use a free slot or replace the least recently updated anchor
   uint32_t oldestUpdateTime = currentTime_ms;
   int firstUninitializedSlot = -1;
   int oldestSlot = 0;
 
   for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
-    if (anchorStorage[i].isInitialized) {
-      if (anchor == anchorStorage[i].id) {
-        anchorCtx->anchorInfo = &anchorStorage[i];
-        return true;
-      }
-
-      if (anchorStorage[i].lastUpdateTime < oldestUpdateTime) {
-        oldestUpdateTime = anchorStorage[i].lastUpdateTime;
+    const tdoaAnchorInfo_t* anchorInfo = &anchorStorage->anchorInfo[i];
+    if (anchorInfo->isInitialized) {
+      if (anchorInfo->lastUpdateTime < oldestUpdateTime) {
+        oldestUpdateTime = anchorInfo->lastUpdateTime;
         oldestSlot = i;
       }
     } else {
-      if (firstUninitializedSlot == -1) {
-        firstUninitializedSlot = i;
-      }
+      firstUninitializedSlot = i;
+      break;
     }
   }
 
-  // The anchor was not found in storage
   tdoaAnchorInfo_t* newAnchorInfo = 0;
   if (firstUninitializedSlot != -1) {
     newAnchorInfo = initializeSlot(anchorStorage, firstUninitializedSlot, anchor);
@@ -84,28 +92,25 @@ bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8
   return false;
 }
 
-bool tdoaStorageGetAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
+bool tdoaStorageGetAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
   anchorCtx->currentTime_ms = currentTime_ms;
 
-  for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
-    if (anchorStorage[i].isInitialized) {
-      if (anchor == anchorStorage[i].id) {
-        anchorCtx->anchorInfo = &anchorStorage[i];
-        return true;
-      }
-    }
+  const uint8_t slotPlusOne = anchorStorage->slotPlusOne[anchor];
+  if (slotPlusOne) {
+    anchorCtx->anchorInfo = &anchorStorage->anchorInfo[slotPlusOne - 1];
+    return true;
   }
 
   anchorCtx->anchorInfo = 0;
   return false;
 }
 
-uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize) {
+uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize) {
   int count = 0;
 
   for (int i = 0; i < ANCHOR_STORAGE_COUNT && count < maxListSize; i++) {
-    if (anchorStorage[i].isInitialized) {
-      unorderedAnchorList[count] = anchorStorage[i].id;
+    if (anchorStorage->anchorInfo[i].isInitialized) {
+      unorderedAnchorList[count] = anchorStorage->anchorInfo[i].id;
       count++;
     }
   }
@@ -113,13 +118,14 @@ uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t
   return count;
 }
 
-uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms) {
+uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms) {
   int count = 0;
 
   const uint32_t expiryTime = currentTime_ms - ANCHOR_ACTIVE_VALIDITY_PERIOD;
   for (int i = 0; i < ANCHOR_STORAGE_COUNT && count < maxListSize; i++) {
-    if (anchorStorage[i].isInitialized && anchorStorage[i].lastUpdateTime > expiryTime) {
-      unorderedAnchorList[count] = anchorStorage[i].id;
+    const tdoaAnchorInfo_t* anchorInfo = &anchorStorage->anchorInfo[i];
+    if (anchorInfo->isInitialized && anchorInfo->lastUpdateTime > expiryTime) {
+      unorderedAnchorList[count] = anchorInfo->id;
       count++;
     }
   }
@@ -151,6 +157,35 @@ clockCorrectionStorage_t* tdoaStorageGetClockCorrectionStorage(const tdoaAnchorC
   return &anchorCtx->anchorInfo->clockCorrectionStorage;
 }
 
+tdoaGeometryCache_t* tdoaStorageGetGeometryCache(const tdoaAnchorContext_t* anchorCtx) {
+  return &anchorCtx->anchorInfo->geometryCache;
+}
+
+// Returns the squared distance between two anchors, from the cache if the positions have not changed.
+// Returns 0 if the position of one of the anchors is not known.
+float tdoaStorageGetAnchorDistanceSq(const tdoaAnchorContext_t* anchorCtx, const tdoaAnchorContext_t* otherAnchorCtx) {
+  tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
+  const tdoaAnchorInfo_t* otherAnchorInfo = otherAnchorCtx->anchorInfo;
+
+  if (anchorInfo->positionVersion == 0 || otherAnchorInfo->positionVersion == 0) {
+    return 0.0f;
+  }
+
+  tdoaAnchorDistanceCache_t* entry = &anchorInfo->distanceCache[otherAnchorInfo->id & (ANCHOR_DISTANCE_CACHE_COUNT - 1)];
+  if (entry->id != otherAnchorInfo->id || entry->positionVersion != anchorInfo->positionVersion || entry->otherPositionVersion != otherAnchorInfo->positionVersion) {
+    const float dx = anchorInfo->position.x - otherAnchorInfo->position.x;
+    const float dy = anchorInfo->position.y - otherAnchorInfo->position.y;
+    const float dz = anchorInfo->position.z - otherAnchorInfo->position.z;
+
+    entry->id = otherAnchorInfo->id;
+    entry->positionVersion = anchorInfo->positionVersion;
+    entry->otherPositionVersion = otherAnchorInfo->positionVersion;
+    entry->distanceSq = dx * dx + dy * dy + dz * dz;
+  }
+
+  return entry->distanceSq;
+}
+
 bool tdoaStorageGetAnchorPosition(const tdoaAnchorContext_t* anchorCtx, point_t* position) {
   uint32_t now = anchorCtx->currentTime_ms;
 
@@ -171,6 +206,18 @@ void tdoaStorageSetAnchorPosition(tdoaAnchorContext_t* anchorCtx, const float x,
   uint32_t now = anchorCtx->currentTime_ms;
   tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
 
+  if (anchorInfo->positionVersion == 0 || x != anchorInfo->position.x || y != anchorInfo->position.y || z != anchorInfo->position.z) {
+    anchorInfo->geometryCache.isValid = false;
+
+    // Versions are unique across anchors to make sure that cached distances are not reused if an anchor is
+    // removed from the storage and added again
+    latestPositionVersion++;
+    if (latestPositionVersion == 0) {
+      latestPositionVersion = 1;
+    }
+    anchorInfo->positionVersion = latestPositionVersion;
+  }
+
   anchorInfo->position.timestamp = now;
   anchorInfo->position.x = x;
   anchorInfo->position.y = y;
@@ -187,8 +234,8 @@ void tdoaStorageSetRxTxData(tdoaAnchorContext_t* anchorCtx, int64_t rxTime, int6
   anchorInfo->lastUpdateTime = now;
 }
 
-double tdoaStorageGetClockCorrection(const tdoaAnchorContext_t* anchorCtx) {
-  return clockCorrectionEngineGet(&anchorCtx->anchorInfo->clockCorrectionStorage);
+clockCorrection_t tdoaStorageGetClockCorrection(const tdoaAnchorContext_t* anchorCtx) {
+  return clockCorrectionEngineGetFixed(&anchorCtx->anchorInfo->clockCorrectionStorage);
 }
 
 int64_t tdoaStorageGetRemoteRxTime(const tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor) {
@@ -205,41 +252,25 @@ int64_t tdoaStorageGetRemoteRxTime(const tdoaAnchorContext_t* anchorCtx, const u
 
 bool tdoaStorageGetRemoteRxTimeSeqNr(const tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, int64_t* rxTime, uint8_t* seqNr) {
   const tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
-  bool result = false;
 
-  for (int i = 0; i < REMOTE_ANCHOR_DATA_COUNT; i++) {
-    if (remoteAnchor == anchorInfo->remoteAnchorData[i].id) {
-      uint32_t now = anchorCtx->currentTime_ms;
-      if (anchorInfo->remoteAnchorData[i].endOfLife > now) {
-        *rxTime = anchorInfo->remoteAnchorData[i].rxTime;
-        *seqNr = anchorInfo->remoteAnchorData[i].seqNr;
-        result = true;
-      }
-      break;
+  const int index = findRemoteAnchorDataIndex(anchorInfo, remoteAnchor);
+  if (index >= 0) {
+    uint32_t now = anchorCtx->currentTime_ms;
+    if (anchorInfo->remoteAnchorData[index].endOfLife > now) {
+      *rxTime = anchorInfo->remoteAnchorData[index].rxTime;
+      *seqNr = anchorInfo->remoteAnchorData[index].seqNr;
+      return true;
     }
   }
 
-  return result;
+  return false;
 }
 
 void tdoaStorageSetRemoteRxTime(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, const int64_t remoteRxTime, const uint8_t remoteSeqNr) {
   tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
-
-  int indexToUpdate = 0;
   uint32_t now = anchorCtx->currentTime_ms;
-  uint32_t oldestTime = 0xFFFFFFFF;
 
-  for (int i = 0; i < REMOTE_ANCHOR_DATA_COUNT; i++) {
-    if (remoteAnchor == anchorInfo->remoteAnchorData[i].id) {
-      indexToUpdate = i;
-      break;
-    }
-
-    if (anchorInfo->remoteAnchorData[i].endOfLife < oldestTime) {
-      oldestTime = anchorInfo->remoteAnchorData[i].endOfLife;
-      indexToUpdate = i;
-    }
-  }
+  const int indexToUpdate = findRemoteAnchorDataIndexForUpdate(anchorInfo, remoteAnchor);
 
   anchorInfo->remoteAnchorData[indexToUpdate].id = remoteAnchor;
   anchorInfo->remoteAnchorData[indexToUpdate].rxTime = remoteRxTime;
@@ -267,13 +298,11 @@ void tdoaStorageGetRemoteSeqNrList(const tdoaAnchorContext_t* anchorCtx, int* re
 int64_t tdoaStorageGetTimeOfFlight(const tdoaAnchorContext_t* anchorCtx, const uint8_t otherAnchor) {
   const tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
 
-  for (int i = 0; i < TOF_PER_ANCHOR_COUNT; i++) {
-    if (otherAnchor == anchorInfo->tof[i].id) {
-      uint32_t now = anchorCtx->currentTime_ms;
-      if (anchorInfo->tof[i].endOfLife > now) {
-        return anchorInfo->tof[i].tof;
-      }
-      break;
+  const int index = findTofIndex(anchorInfo, otherAnchor);
+  if (index >= 0) {
+    uint32_t now = anchorCtx->currentTime_ms;
+    if (anchorInfo->tof[index].endOfLife > now) {
+      return anchorInfo->tof[index].tof;
     }
   }
 
@@ -282,44 +311,105 @@ int64_t tdoaStorageGetTimeOfFlight(const tdoaAnchorContext_t* anchorCtx, const u
 
 void tdoaStorageSetTimeOfFlight(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, const int64_t tof) {
   tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
-
-  int indexToUpdate = 0;
   uint32_t now = anchorCtx->currentTime_ms;
-  uint32_t oldestTime = 0xFFFFFFFF;
 
-  for (int i = 0; i < TOF_PER_ANCHOR_COUNT; i++) {
-    if (remoteAnchor == anchorInfo->tof[i].id) {
-      indexToUpdate = i;
+  const int indexToUpdate = findTofIndexForUpdate(anchorInfo, remoteAnchor);
+
+  anchorInfo->tof[indexToUpdate].id = remoteAnchor;
+  anchorInfo->tof[indexToUpdate].tof = tof;
+  anchorInfo->tof[indexToUpdate].endOfLife = now + TOF_VALIDITY_PERIOD;
+}
+
+bool tdoaStorageIsAnchorInStorage(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor) {
+  return anchorStorage->slotPlusOne[anchor] != 0;
+}
+
+static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorStorage_t* anchorStorage, const uint8_t slot, const uint8_t anchor) {
+  tdoaAnchorInfo_t* anchorInfo = &anchorStorage->anchorInfo[slot];
+
+  if (anchorInfo->isInitialized) {
+    anchorStorage->slotPlusOne[anchorInfo->id] = 0;
+  }
+
+  memset(anchorInfo, 0, sizeof(tdoaAnchorInfo_t));
+  anchorInfo->id = anchor;
+  anchorInfo->isInitialized = true;
+  anchorStorage->slotPlusOne[anchor] = slot + 1;
+
+  return anchorInfo;
+}
+
+// Remote data and tof entries are stored in open addressing hash tables, the anchor id is the hash. Entries are
+// never removed, only replaced, an entry that never has been used (endOfLife == 0) ends a probe sequence.
+
+static int findRemoteAnchorDataIndex(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor) {
+  for (int i = 0; i < REMOTE_ANCHOR_DATA_COUNT; i++) {
+    const int index = (remoteAnchor + i) & (REMOTE_ANCHOR_DATA_COUNT - 1);
+    const tdoaRemoteAnchorData_t* data = &anchorInfo->remoteAnchorData[index];
+    if (data->endOfLife == 0) {
       break;
     }
+    if (remoteAnchor == data->id) {
+      return index;
+    }
+  }
+
+  return -1;
+}
 
-    if (anchorInfo->tof[i].endOfLife < oldestTime) {
-      oldestTime = anchorInfo->tof[i].endOfLife;
-      indexToUpdate = i;
+// Returns the index of the entry for the remote anchor, or the entry to replace if the remote anchor is not in the table
+static int findRemoteAnchorDataIndexForUpdate(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor) {
+  int oldestIndex = 0;
+  uint32_t oldestTime = 0xFFFFFFFF;
+
+  for (int i = 0; i < REMOTE_ANCHOR_DATA_COUNT; i++) {
+    const int index = (remoteAnchor + i) & (REMOTE_ANCHOR_DATA_COUNT - 1);
+    const tdoaRemoteAnchorData_t* data = &anchorInfo->remoteAnchorData[index];
+    if (data->endOfLife == 0 || remoteAnchor == data->id) {
+      return index;
+    }
+
+    if (data->endOfLife < oldestTime) {
+      oldestTime = data->endOfLife;
+      oldestIndex = index;
     }
   }
 
-  anchorInfo->tof[indexToUpdate].id = remoteAnchor;
-  anchorInfo->tof[indexToUpdate].tof = tof;
-  anchorInfo->tof[indexToUpdate].endOfLife = now + TOF_VALIDITY_PERIOD;
+  return oldestIndex;
 }
 
-bool tdoaStorageIsAnchorInStorage(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor) {
-  for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
-    if (anchorStorage[i].isInitialized) {
-      if (anchor == anchorStorage[i].id) {
-        return true;
-      }
+static int findTofIndex(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor) {
+  for (int i = 0; i < TOF_PER_ANCHOR_COUNT; i++) {
+    const int index = (remoteAnchor + i) & (TOF_PER_ANCHOR_COUNT - 1);
+    const tdoaTimeOfFlight_t* tof = &anchorInfo->tof[index];
+    if (tof->endOfLife == 0) {
+      break;
+    }
+    if (remoteAnchor == tof->id) {
+      return index;
     }
   }
 
-  return false;
+  return -1;
 }
 
-static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorInfo_t anchorStorage[], const uint8_t slot, const uint8_t anchor) {
-  memset(&anchorStorage[slot], 0, sizeof(tdoaAnchorInfo_t));
-  anchorStorage[slot].id = anchor;
-  anchorStorage[slot].isInitialized = true;
+// Returns the index of the entry for the remote anchor, or the entry to replace if the remote anchor is not in the table
+static int findTofIndexForUpdate(const tdoaAnchorInfo_t* anchorInfo, const uint8_t remoteAnchor) {
+  int oldestIndex = 0;
+  uint32_t oldestTime = 0xFFFFFFFF;
+
+  for (int i = 0; i < TOF_PER_ANCHOR_COUNT; i++) {
+    const int index = (remoteAnchor + i) & (TOF_PER_ANCHOR_COUNT - 1);
+    const tdoaTimeOfFlight_t* tof = &anchorInfo->tof[index];
+    if (tof->endOfLife == 0 || remoteAnchor == tof->id) {
+      return index;
+    }
+
+    if (tof->endOfLife < oldestTime) {
+      oldestTime = tof->endOfLife;
+      oldestIndex = index;
+    }
+  }
 
-  return &anchorStorage[slot];
+  return oldestIndex;
 }
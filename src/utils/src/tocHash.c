@@ -0,0 +1,88 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * tocHash.c - hash index for name lookups in the log and param TOCs
+ */
+
+#include "tocHash.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint32_t hashString(uint32_t hash, const char* string) {
+  for (; *string; string++) {
+    hash = (hash ^ (uint8_t)*string) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+uint32_t tocHashName(const char* group, const char* name) {
+  uint32_t hash = hashString(FNV_OFFSET_BASIS, group);
+  hash = (hash ^ '.') * FNV_PRIME;
+  return hashString(hash, name);
+}
+
+void tocHashInit(tocHash_t* table, uint16_t* slots, uint16_t size) {
+  table->slots = slots;
+  table->size = size;
+  table->count = 0;
+
+  for (int i = 0; i < size; i++) {
+    slots[i] = 0;
+  }
+}
+
+bool tocHashInsert(tocHash_t* table, uint32_t hash, uint16_t index) {
+  // Keep one slot free to terminate the probing in tocHashFind()
+  if (table->count + 1 >= table->size) {
+    return false;
+  }
+
+  const uint16_t mask = table->size - 1;
+  uint16_t slot = hash & mask;
+  while (table->slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  table->slots[slot] = index + 1;
+  table->count++;
+
+  return true;
+}
+
+int tocHashFind(const tocHash_t* table, const char* group, const char* name, tocHashMatch_t match) {
+  const uint16_t mask = table->size - 1;
+  uint16_t slot = tocHashName(group, name) & mask;
+
+  while (table->slots[slot] != 0) {
+    const uint16_t index = table->slots[slot] - 1;
+    if (match(index, group, name)) {
+      return index;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  return -1;
+}
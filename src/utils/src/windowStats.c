@@ -0,0 +1,88 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * windowStats.c - running mean and variance over a window of samples
+ */
+
+#include "windowStats.h"
+
+void windowStatsInit(windowStats_t* window) {
+  for (int i = 0; i < WINDOW_STATS_SIZE; i++) {
+    window->samples[i] = 0.0f;
+  }
+  window->sum = 0.0f;
+  window->sumSquares = 0.0f;
+  window->index = 0;
+  window->count = 0;
+}
+
+void windowStatsAdd(windowStats_t* window, const float value) {
+  const float oldest = window->samples[window->index];
+  if (window->count < WINDOW_STATS_SIZE) {
+    window->count++;
+  } else {
+    window->sum -= oldest;
+    window->sumSquares -= oldest * oldest;
+  }
+
+  window->samples[window->index] = value;
+  window->sum += value;
+  window->sumSquares += value * value;
+
+  window->index++;
+  if (window->index == WINDOW_STATS_SIZE) {
+    window->index = 0;
+
+    float sum = 0.0f;
+    float sumSquares = 0.0f;
+    for (int i = 0; i < WINDOW_STATS_SIZE; i++) {
+      sum += window->samples[i];
+      sumSquares += window->samples[i] * window->samples[i];
+    }
+    window->sum = sum;
+    window->sumSquares = sumSquares;
+  }
+}
+
+float windowStatsMean(const windowStats_t* window) {
+  if (window->count == 0) {
+    return 0.0f;
+  }
+
+  return window->sum / window->count;
+}
+
+float windowStatsVariance(const windowStats_t* window) {
+  if (window->count == 0) {
+    return 0.0f;
+  }
+
+  const float mean = window->sum / window->count;
+  const float variance = window->sumSquares / window->count - mean * mean;
+  if (variance < 0.0f) {
+    return 0.0f;
+  }
+
+  return variance;
+}
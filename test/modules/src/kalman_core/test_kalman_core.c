@@ -0,0 +1,568 @@
+// File under test kalman_core.c
+#include "kalman_core.h"
+
+#include <string.h>
+#include "unity.h"
+
+#include "mock_cfassert.h"
+#include "fastmath.h"
+#include "quatcompress.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+static kalmanCoreData_t actual;
+static kalmanCoreData_t expected;
+static kalmanCoreWorkspace_t workspace;
+
+static void fixtureSetStateWithCorrelations(kalmanCoreData_t* this);
+static void assertCovarianceIsEqual(const kalmanCoreData_t* expected, const kalmanCoreData_t* actual);
+static void denseAttitudeResetCovariance(kalmanCoreData_t* this, const float v[3]);
+
+void setUp(void) {
+  kalmanCoreInit(&expected, &workspace);
+  fixtureSetStateWithCorrelations(&expected);
+
+  memcpy(&actual, &expected, sizeof(actual));
+  actual.Pm.pData = (float*)actual.P;
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatStructuredPredictMatchesDensePredictWhenFlying() {
+  // Fixture
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.5f, .y = -1.2f, .z = 0.7f};
+  float dt = 0.01f;
+
+  // Test
+  kalmanCorePredictDense(&expected, &acc, &gyro, dt, true);
+  kalmanCorePredict(&actual, &acc, &gyro, dt, true);
+
+  // Assert
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatStructuredPredictMatchesDensePredictWhenNotFlying() {
+  // Fixture
+  Axis3f acc = {.x = -0.1f, .y = 0.4f, .z = 9.7f};
+  Axis3f gyro = {.x = -0.3f, .y = 0.2f, .z = -2.1f};
+  float dt = 0.02f;
+
+  // Test
+  kalmanCorePredictDense(&expected, &acc, &gyro, dt, false);
+  kalmanCorePredict(&actual, &acc, &gyro, dt, false);
+
+  // Assert
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatStructuredPredictProducesSymmetricCovariance() {
+  // Fixture
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.5f, .y = -1.2f, .z = 0.7f};
+
+  // Test
+  for (int i = 0; i < 10; i++) {
+    kalmanCorePredict(&actual, &acc, &gyro, 0.01f, true);
+  }
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_EQUAL_FLOAT(actual.P[i][j], actual.P[j][i]);
+    }
+  }
+}
+
+void testThatStructuredPredictUpdatesStateAsDensePredict() {
+  // Fixture
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.5f, .y = -1.2f, .z = 0.7f};
+  float dt = 0.01f;
+
+  // Test
+  kalmanCorePredictDense(&expected, &acc, &gyro, dt, true);
+  kalmanCorePredict(&actual, &acc, &gyro, dt, true);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.S, actual.S, KC_STATE_DIM);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.q, actual.q, 4);
+}
+
+void testThatVectorUpdateMatchesSequentialScalarUpdates() {
+  // Fixture
+  const float h[3][KC_STATE_DIM] = {
+    {[KC_STATE_X] = 1.0f, [KC_STATE_PX] = 0.2f},
+    {[KC_STATE_Y] = 1.0f, [KC_STATE_D2] = -0.5f},
+    {[KC_STATE_Z] = 0.8f, [KC_STATE_PZ] = 0.1f, [KC_STATE_D0] = 0.3f},
+  };
+  const float measurement[3] = {1.2f, -0.3f, 0.4f};
+  const float stdDev[3] = {0.1f, 0.2f, 0.05f};
+
+  float error[3];
+  for (int row = 0; row < 3; row++) {
+    error[row] = measurement[row];
+    for (int i = 0; i < KC_STATE_DIM; i++) {
+      error[row] -= h[row][i] * actual.S[i];
+    }
+  }
+  arm_matrix_instance_f32 Hm = {3, KC_STATE_DIM, (float*)h};
+
+  // Test
+  kalmanCoreVectorUpdate(&actual, &Hm, error, stdDev);
+
+  // Assert
+  for (int row = 0; row < 3; row++) {
+    float hRow[KC_STATE_DIM];
+    memcpy(hRow, h[row], sizeof(hRow));
+    arm_matrix_instance_f32 Hrow = {1, KC_STATE_DIM, hRow};
+
+    float e = measurement[row];
+    for (int i = 0; i < KC_STATE_DIM; i++) {
+      e -= hRow[i] * expected.S[i];
+    }
+    kalmanCoreScalarUpdate(&expected, &Hrow, e, stdDev[row]);
+  }
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[i], actual.S[i]);
+  }
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatInstancesSharingAWorkspaceDoNotInterfere() {
+  // Fixture
+  static kalmanCoreWorkspace_t otherWorkspace;
+  static kalmanCoreData_t other;
+  kalmanCoreInit(&other, &workspace);
+  expected.workspace = &otherWorkspace;
+
+  Axis3f acc = {.x = 0.2f, .y = 0.1f, .z = 9.6f};
+  Axis3f gyro = {.x = 0.4f, .y = -0.6f, .z = 1.3f};
+  Axis3f otherAcc = {.x = -1.5f, .y = 2.0f, .z = 8.1f};
+  Axis3f otherGyro = {.x = -2.2f, .y = 0.9f, .z = -0.4f};
+  const uint8_t hIndex[] = {KC_STATE_Y, KC_STATE_PZ};
+  const float hValue[] = {1.0f, 0.3f};
+
+  // Test
+  kalmanCorePredict(&expected, &acc, &gyro, 0.01f, true);
+  kalmanCoreSparseScalarUpdate(&expected, hIndex, hValue, 2, 0.2f, 0.1f);
+
+  kalmanCorePredict(&actual, &acc, &gyro, 0.01f, true);
+  kalmanCorePredict(&other, &otherAcc, &otherGyro, 0.02f, false);
+  kalmanCoreSparseScalarUpdate(&other, hIndex, hValue, 2, -0.7f, 0.05f);
+  kalmanCoreSparseScalarUpdate(&actual, hIndex, hValue, 2, 0.2f, 0.1f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.S, actual.S, KC_STATE_DIM);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY((float*)expected.P, (float*)actual.P, KC_STATE_DIM * KC_STATE_DIM);
+}
+
+void testThatScalarUpdateOfUncorrelatedStateGivesExpectedVariance() {
+  // Fixture
+  kalmanCoreInit(&actual, &workspace);
+  const float variance = actual.P[KC_STATE_Z][KC_STATE_Z];
+  const float stdDev = 0.5f;
+  const float error = 0.3f;
+
+  const uint8_t hIndex[] = {KC_STATE_Z};
+  const float hValue[] = {1.0f};
+
+  const float expectedVariance = variance * stdDev * stdDev / (variance + stdDev * stdDev);
+  const float expectedZ = actual.S[KC_STATE_Z] + error * variance / (variance + stdDev * stdDev);
+
+  // Test
+  kalmanCoreSparseScalarUpdate(&actual, hIndex, hValue, 1, error, stdDev);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedVariance, actual.P[KC_STATE_Z][KC_STATE_Z]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedZ, actual.S[KC_STATE_Z]);
+}
+
+void testThatSparseScalarUpdateMatchesOneRowVectorUpdate() {
+  // Fixture
+  const uint8_t hIndex[] = {KC_STATE_X, KC_STATE_PY, KC_STATE_D1};
+  const float hValue[] = {0.7f, -1.1f, 0.4f};
+  const float error = -0.25f;
+  const float stdDev = 0.15f;
+
+  float h[KC_STATE_DIM] = {0};
+  for (int k = 0; k < 3; k++) {
+    h[hIndex[k]] = hValue[k];
+  }
+  arm_matrix_instance_f32 Hm = {1, KC_STATE_DIM, h};
+
+  // Test
+  kalmanCoreVectorUpdate(&expected, &Hm, &error, &stdDev);
+  kalmanCoreSparseScalarUpdate(&actual, hIndex, hValue, 3, error, stdDev);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[i], actual.S[i]);
+  }
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatSequentialStateUpdatesMatchVectorUpdateOfPosition() {
+  // Fixture
+  float h[3][KC_STATE_DIM] = {0};
+  arm_matrix_instance_f32 Hm = {3, KC_STATE_DIM, (float*)h};
+  const float error[3] = {0.12f, -0.3f, 0.05f};
+  const float stdDev[3] = {0.01f, 0.01f, 0.01f};
+  float measured[3];
+  for (int i = 0; i < 3; i++) {
+    h[i][KC_STATE_X + i] = 1.0f;
+    measured[i] = actual.S[KC_STATE_X + i] + error[i];
+  }
+
+  // Test
+  kalmanCoreVectorUpdate(&expected, &Hm, error, stdDev);
+  for (int i = 0; i < 3; i++) {
+    // The innovation of each axis is taken relative to the state updated by the previous axes
+    kalmanCoreStateUpdate(&actual, KC_STATE_X + i, measured[i] - actual.S[KC_STATE_X + i], stdDev[i]);
+  }
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[i], actual.S[i]);
+  }
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatGatedScalarUpdateRejectsErrorOutsideTheGate() {
+  // Fixture
+  kalmanCoreInit(&actual, &workspace);
+  kalmanCoreInit(&expected, &workspace);
+  const float variance = actual.P[KC_STATE_Z][KC_STATE_Z];
+  const float stdDev = 0.5f;
+  const float gate = 3.0f;
+  const float error = 1.1f * gate * sqrtf(variance + stdDev * stdDev);
+
+  float h[KC_STATE_DIM] = {0};
+  h[KC_STATE_Z] = 1.0f;
+  arm_matrix_instance_f32 Hm = {1, KC_STATE_DIM, h};
+
+  // Test
+  bool actualFused = kalmanCoreScalarUpdateGated(&actual, &Hm, error, stdDev, gate);
+
+  // Assert
+  TEST_ASSERT_FALSE(actualFused);
+  TEST_ASSERT_EQUAL_FLOAT(expected.S[KC_STATE_Z], actual.S[KC_STATE_Z]);
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatGatedScalarUpdateMatchesScalarUpdateInsideTheGate() {
+  // Fixture
+  const float stdDev = 0.5f;
+  const float error = 0.2f;
+
+  float h[KC_STATE_DIM] = {0};
+  h[KC_STATE_X] = 0.6f;
+  h[KC_STATE_Y] = -0.8f;
+  arm_matrix_instance_f32 Hm = {1, KC_STATE_DIM, h};
+
+  // Test
+  kalmanCoreScalarUpdate(&expected, &Hm, error, stdDev);
+  bool actualFused = kalmanCoreScalarUpdateGated(&actual, &Hm, error, stdDev, 3.0f);
+
+  // Assert
+  TEST_ASSERT_TRUE(actualFused);
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected.S[i], actual.S[i]);
+  }
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatFinalizeRotatesCovarianceAsDenseAttitudeReset() {
+  // Fixture
+  const float v[3] = {0.05f, -0.02f, 0.03f};
+  for (int i = 0; i < 3; i++) {
+    actual.S[KC_STATE_D0 + i] = v[i];
+  }
+  denseAttitudeResetCovariance(&expected, v);
+
+  // Test
+  kalmanCoreFinalize(&actual, 0);
+
+  // Assert
+  assertCovarianceIsEqual(&expected, &actual);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actual.S[KC_STATE_D0]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actual.S[KC_STATE_D1]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actual.S[KC_STATE_D2]);
+}
+
+void testThatFinalizeKeepsSmallAttitudeErrorUntilItIsLargeEnough() {
+  // Fixture
+  const float smallError = 0.06e-3f;
+  actual.S[KC_STATE_D0] = smallError;
+
+  // Test
+  kalmanCoreFinalize(&actual, 0);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(smallError, actual.S[KC_STATE_D0]);
+  TEST_ASSERT_EQUAL_FLOAT(expected.q[0], actual.q[0]);
+  assertCovarianceIsEqual(&expected, &actual);
+
+  // Test
+  actual.S[KC_STATE_D0] += smallError;
+  kalmanCoreFinalize(&actual, 0);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actual.S[KC_STATE_D0]);
+  TEST_ASSERT_FALSE(expected.q[1] == actual.q[1]);
+}
+
+void testThatCovarianceHealthCheckRestoresSymmetryAndBounds() {
+  // Fixture
+  actual.P[KC_STATE_X][KC_STATE_Y] += 0.2f;
+  actual.P[KC_STATE_PX][KC_STATE_PX] = 1e-9f;
+  actual.P[KC_STATE_D0][KC_STATE_Z] = 1000.0f;
+
+  expected.P[KC_STATE_X][KC_STATE_Y] += 0.1f;
+  expected.P[KC_STATE_Y][KC_STATE_X] += 0.1f;
+  expected.P[KC_STATE_PX][KC_STATE_PX] = 1e-6f;
+  expected.P[KC_STATE_D0][KC_STATE_Z] = 100.0f;
+  expected.P[KC_STATE_Z][KC_STATE_D0] = 100.0f;
+
+  // Test
+  kalmanCoreCovarianceHealthCheck(&actual);
+
+  // Assert
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatImuDeltaIsEmptyAfterReset() {
+  // Fixture
+  kalmanCoreImuDelta_t delta;
+  memset(&delta, 0xff, sizeof(delta));
+
+  // Test
+  kalmanCoreImuDeltaReset(&delta);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, delta.dq[0]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, delta.dq[1]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, delta.dq[2]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, delta.dq[3]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, delta.dv.z);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, delta.dp.z);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, delta.dt);
+}
+
+void testThatPredictWithImuDeltaFollowsFastRotation() {
+  // Fixture
+  Axis3f acc = {.x = 0.0f, .y = 0.0f, .z = 11.0f};
+  Axis3f gyro = {.x = 1.5f, .y = -0.8f, .z = 4.0f};
+  const float dt = 0.001f;
+  const int samples = 100;
+
+  // The reference is predicted in steps that are much shorter than the IMU sample period
+  const int referenceSteps = 10;
+
+  kalmanCoreImuDelta_t delta;
+  kalmanCoreImuDeltaReset(&delta);
+
+  // Test
+  for (int i = 0; i < samples; i++) {
+    for (int j = 0; j < referenceSteps; j++) {
+      kalmanCorePredict(&expected, &acc, &gyro, dt / referenceSteps, true);
+      kalmanCoreFinalize(&expected, 0);
+    }
+    kalmanCoreImuDeltaIntegrate(&delta, &acc, &gyro, dt, true);
+  }
+  kalmanCorePredictWithImuDelta(&actual, &delta, true);
+  kalmanCoreFinalize(&actual, 0);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, samples * dt, delta.dt);
+  for (int i = 0; i < KC_STATE_D0; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, expected.S[i], actual.S[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected.q[i], actual.q[i]);
+  }
+}
+
+void testThatPredictWithImuDeltaOfOneSampleMatchesPredict() {
+  // Fixture
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.5f};
+  Axis3f gyro = {.x = 0.1f, .y = 0.2f, .z = -0.3f};
+  const float dt = 0.002f;
+
+  kalmanCoreImuDelta_t delta;
+  kalmanCoreImuDeltaReset(&delta);
+  kalmanCoreImuDeltaIntegrate(&delta, &acc, &gyro, dt, false);
+
+  // Test
+  kalmanCorePredict(&expected, &acc, &gyro, dt, false);
+  kalmanCorePredictWithImuDelta(&actual, &delta, false);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[i], actual.S[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected.q[i], actual.q[i]);
+  }
+  for (int i = 0; i < KC_STATE_D0; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected.P[i][j], actual.P[i][j]);
+    }
+  }
+}
+
+void testThatThrottleSkipsRedundantMeasurementsAndKeepsEveryNth() {
+  // Fixture
+  kalmanCoreUpdateThrottle_t throttle = {.minVarianceRatio = 0.5f, .keepEvery = 3};
+  actual.updateThrottle = &throttle;
+
+  float h[KC_STATE_DIM] = {0};
+  h[KC_STATE_X] = 1.0f;
+  arm_matrix_instance_f32 Hm = {1, KC_STATE_DIM, h};
+
+  // The variance of X in the fixture is 1, a measurement with a standard deviation of 2 is redundant
+  const float stdDev = 2.0f;
+
+  // Test
+  bool fused[6];
+  for (int i = 0; i < 6; i++) {
+    fused[i] = kalmanCoreScalarUpdateGated(&actual, &Hm, 0.1f, stdDev, 0.0f);
+  }
+
+  // Assert
+  TEST_ASSERT_FALSE(fused[0]);
+  TEST_ASSERT_FALSE(fused[1]);
+  TEST_ASSERT_TRUE(fused[2]);
+  TEST_ASSERT_FALSE(fused[3]);
+  TEST_ASSERT_FALSE(fused[4]);
+  TEST_ASSERT_TRUE(fused[5]);
+  TEST_ASSERT_EQUAL_UINT32(4, throttle.skipped);
+}
+
+void testThatThrottleFusesInformativeMeasurements() {
+  // Fixture
+  kalmanCoreUpdateThrottle_t throttle = {.minVarianceRatio = 0.5f, .keepEvery = 0};
+  actual.updateThrottle = &throttle;
+
+  float h[KC_STATE_DIM] = {0};
+  h[KC_STATE_X] = 1.0f;
+  arm_matrix_instance_f32 Hm = {1, KC_STATE_DIM, h};
+  const float stdDev = 0.5f;
+
+  // Test
+  kalmanCoreScalarUpdate(&expected, &Hm, 0.1f, stdDev);
+  bool actualFused = kalmanCoreScalarUpdateGated(&actual, &Hm, 0.1f, stdDev, 0.0f);
+
+  // Assert
+  TEST_ASSERT_TRUE(actualFused);
+  TEST_ASSERT_EQUAL_UINT32(0, throttle.skipped);
+  assertCovarianceIsEqual(&expected, &actual);
+}
+
+void testThatExternalizedStateHoldsTheCompressedQuaternion() {
+  // Fixture
+  const Axis3f acc = {.x = 0.0f, .y = 0.0f, .z = 1.0f};
+  state_t state;
+  const float q[4] = {actual.q[1], actual.q[2], actual.q[3], actual.q[0]};
+
+  // Test
+  kalmanCoreExternalizeState(&actual, &state, &acc, 0);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(quatcompress(q), state.attitudeQuaternionCompressed);
+}
+
+void testThatExternalizeAccOnlyUpdatesTheAcceleration() {
+  // Fixture
+  const Axis3f acc = {.x = 0.0f, .y = 0.0f, .z = 1.0f};
+  const Axis3f newAcc = {.x = 0.5f, .y = -0.2f, .z = 1.1f};
+  state_t expectedState;
+  state_t actualState;
+  kalmanCoreExternalizeState(&actual, &actualState, &acc, 0);
+
+  // Test
+  kalmanCoreExternalizeAcc(&actual, &actualState, &newAcc, 1);
+
+  // Assert
+  kalmanCoreExternalizeState(&actual, &expectedState, &newAcc, 1);
+  TEST_ASSERT_EQUAL_FLOAT(expectedState.acc.x, actualState.acc.x);
+  TEST_ASSERT_EQUAL_FLOAT(expectedState.acc.y, actualState.acc.y);
+  TEST_ASSERT_EQUAL_FLOAT(expectedState.acc.z, actualState.acc.z);
+  TEST_ASSERT_EQUAL_FLOAT(expectedState.attitude.yaw, actualState.attitude.yaw);
+  TEST_ASSERT_EQUAL_UINT32(0, actualState.position.timestamp);
+}
+
+// Helpers ////////////////////////////////////////////////////////
+
+static void fixtureSetStateWithCorrelations(kalmanCoreData_t* this) {
+  this->S[KC_STATE_PX] = 1.2f;
+  this->S[KC_STATE_PY] = -0.4f;
+  this->S[KC_STATE_PZ] = 0.3f;
+
+  // A rotation around a tilted axis
+  const float q[4] = {0.9f, 0.1f, -0.3f, 0.2f};
+  const float norm = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  for (int i = 0; i < 4; i++) {
+    this->q[i] = q[i] / norm;
+  }
+  kalmanCoreFinalize(this, 0);
+
+  // Symmetric, diagonally dominant covariance with all elements populated
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      this->P[i][j] = (i == j) ? 1.0f + 0.1f * i : 0.01f * (i + j + 1);
+    }
+  }
+}
+
+static void assertCovarianceIsEqual(const kalmanCoreData_t* expected, const kalmanCoreData_t* actual) {
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected->P[i][j], actual->P[i][j]);
+    }
+  }
+}
+
+// The full A * P * A' attitude reset, as a reference for the structured one
+static void denseAttitudeResetCovariance(kalmanCoreData_t* this, const float v[3]) {
+  const float d0 = v[0] / 2;
+  const float d1 = v[1] / 2;
+  const float d2 = v[2] / 2;
+
+  float A[KC_STATE_DIM][KC_STATE_DIM] = {0};
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    A[i][i] = 1;
+  }
+  A[KC_STATE_D0][KC_STATE_D0] =  1 - d1*d1/2 - d2*d2/2;
+  A[KC_STATE_D0][KC_STATE_D1] =  d2 + d0*d1/2;
+  A[KC_STATE_D0][KC_STATE_D2] = -d1 + d0*d2/2;
+  A[KC_STATE_D1][KC_STATE_D0] = -d2 + d0*d1/2;
+  A[KC_STATE_D1][KC_STATE_D1] =  1 - d0*d0/2 - d2*d2/2;
+  A[KC_STATE_D1][KC_STATE_D2] =  d0 + d1*d2/2;
+  A[KC_STATE_D2][KC_STATE_D0] =  d1 + d0*d2/2;
+  A[KC_STATE_D2][KC_STATE_D1] = -d0 + d1*d2/2;
+  A[KC_STATE_D2][KC_STATE_D2] =  1 - d0*d0/2 - d1*d1/2;
+
+  float AP[KC_STATE_DIM][KC_STATE_DIM] = {0};
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        AP[i][j] += A[i][k] * this->P[k][j];
+      }
+    }
+  }
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = 0;
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        sum += AP[i][k] * A[j][k];
+      }
+      this->P[i][j] = sum;
+    }
+  }
+}
@@ -0,0 +1,317 @@
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 199309L
+
+// File under test kalman_core.c
+#include "kalman_core.h"
+#include "mm_position.h"
+#include "mm_pose.h"
+#include "mm_tof.h"
+#include "mm_absolute_height.h"
+#include "mm_yaw_error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+#include "mock_cfassert.h"
+#include "fastmath.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+// Replay benchmark of the kalman core. Not part of the normal unit test run, run it with
+//   make unit FILES=test/modules/src/kalman_core/test_kalman_core_replay.c
+// @IGNORE_IF_NOT KALMAN_REPLAY_BENCHMARK
+//
+// The stream to replay is read from the file in the KALMAN_REPLAY_FILE environment variable, a file
+// created from a uSD log with tools/usdlog/kalman_replay_export.py. If not set, a synthetic stream
+// (circular flight with position and ToF measurements) is used.
+//
+// The benchmark reports the time per call for each measurement model and the position error versus
+// the reference in the stream. The RMS error must be below KALMAN_REPLAY_MAX_RMS (meters, default 0.1)
+// for the test to pass, which makes it possible to gate changes of the estimator in CI.
+//
+// File format, one record per line, t is the time in ms:
+//   acc t x y z                 Acceleration (G)
+//   gyro t x y z                Angular rate (deg/s)
+//   pos t x y z stdDev          Position (m)
+//   pose t x y z qx qy qz qw stdDevPos stdDevQuat
+//   tof t distance stdDev       Distance to the floor (m)
+//   height t height stdDev      Absolute height (m)
+//   yaw t yawError stdDev       Yaw error (rad)
+//   baro t asl                  Barometer (m)
+//   ref t x y z                 Reference position (m), used for the accuracy, not fused
+
+#define PREDICT_INTERVAL_MS 10
+
+typedef enum {
+  modelPredict,
+  modelProcessNoise,
+  modelFinalize,
+  modelPosition,
+  modelPose,
+  modelTof,
+  modelHeight,
+  modelYawError,
+  modelBaro,
+  modelCount,
+} model_t;
+
+static const char* modelNames[modelCount] = {
+  "predict",
+  "process noise",
+  "finalize",
+  "position",
+  "pose",
+  "tof",
+  "abs height",
+  "yaw error",
+  "baro",
+};
+
+typedef struct {
+  char type[8];
+  float t;
+  float v[9];
+} record_t;
+
+static kalmanCoreData_t coreData;
+static kalmanCoreWorkspace_t coreWorkspace;
+static uint64_t modelTimeNs[modelCount];
+static uint32_t modelCalls[modelCount];
+
+static Axis3f accAccumulator;
+static Axis3f gyroAccumulator;
+static uint32_t accCount;
+static uint32_t gyroCount;
+static float lastPredictionMs;
+static float lastProcessNoiseMs;
+
+static double errorSquareSum;
+static float errorMax;
+static uint32_t errorCount;
+
+static uint32_t randomState;
+
+static void replayRecord(const record_t* record);
+static void replayFile(FILE* file);
+static void replaySynthetic();
+static float noise(float stdDev);
+
+void setUp(void) {
+  kalmanCoreInit(&coreData, &coreWorkspace);
+
+  memset(modelTimeNs, 0, sizeof(modelTimeNs));
+  memset(modelCalls, 0, sizeof(modelCalls));
+  accAccumulator = (Axis3f){.axis = {0}};
+  gyroAccumulator = (Axis3f){.axis = {0}};
+  accCount = 0;
+  gyroCount = 0;
+  lastPredictionMs = -1.0f;
+  lastProcessNoiseMs = -1.0f;
+
+  errorSquareSum = 0.0;
+  errorMax = 0.0f;
+  errorCount = 0;
+
+  randomState = 12345;
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testReplay() {
+  // Fixture
+  const char* fileName = getenv("KALMAN_REPLAY_FILE");
+  const char* maxRmsStr = getenv("KALMAN_REPLAY_MAX_RMS");
+  const float maxRms = maxRmsStr ? strtof(maxRmsStr, 0) : 0.1f;
+
+  // Test
+  if (fileName) {
+    FILE* file = fopen(fileName, "r");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, "Can not open replay file");
+    replayFile(file);
+    fclose(file);
+  } else {
+    replaySynthetic();
+  }
+
+  // Assert
+  printf("\nKalman replay of %s\n", fileName ? fileName : "synthetic stream");
+  printf("%-14s %10s %12s\n", "model", "calls", "ns/call");
+  for (int i = 0; i < modelCount; i++) {
+    if (modelCalls[i] > 0) {
+      printf("%-14s %10u %12.0f\n", modelNames[i], modelCalls[i], (double)modelTimeNs[i] / modelCalls[i]);
+    }
+  }
+
+  TEST_ASSERT_TRUE_MESSAGE(errorCount > 0, "No reference positions in the stream");
+  const float rms = sqrtf(errorSquareSum / errorCount);
+  printf("Position error versus reference: rms %.4f m, max %.4f m (%u samples)\n", (double)rms, (double)errorMax, errorCount);
+
+  TEST_ASSERT_TRUE_MESSAGE(rms < maxRms, "RMS position error too large");
+}
+
+// Helpers ------------------------------------------------------------------
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define TIMED(MODEL, CALL) do { \
+  const uint64_t start = nowNs(); \
+  CALL; \
+  modelTimeNs[MODEL] += nowNs() - start; \
+  modelCalls[MODEL]++; \
+} while(0)
+
+// Mimics the kalman task: the IMU data is accumulated and the state is predicted at 100 Hz,
+// process noise is added once per ms and the state is finalized after each update.
+static void advanceTo(const float t) {
+  if (lastPredictionMs < 0.0f) {
+    lastPredictionMs = t;
+    lastProcessNoiseMs = t;
+  }
+
+  if (t - lastPredictionMs >= PREDICT_INTERVAL_MS && accCount > 0 && gyroCount > 0) {
+    const float dt = (t - lastPredictionMs) / 1000.0f;
+    Axis3f acc = {.x = accAccumulator.x * 9.81f / accCount, .y = accAccumulator.y * 9.81f / accCount, .z = accAccumulator.z * 9.81f / accCount};
+    Axis3f gyro = {.x = gyroAccumulator.x * PI / 180.0f / gyroCount, .y = gyroAccumulator.y * PI / 180.0f / gyroCount, .z = gyroAccumulator.z * PI / 180.0f / gyroCount};
+    accAccumulator = (Axis3f){.axis = {0}};
+    gyroAccumulator = (Axis3f){.axis = {0}};
+    accCount = 0;
+    gyroCount = 0;
+
+    TIMED(modelPredict, kalmanCorePredict(&coreData, &acc, &gyro, dt, true));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, t));
+    lastPredictionMs = t;
+  }
+
+  if (t - lastProcessNoiseMs >= 1.0f) {
+    TIMED(modelProcessNoise, kalmanCoreAddProcessNoise(&coreData, (t - lastProcessNoiseMs) / 1000.0f));
+    lastProcessNoiseMs = t;
+  }
+}
+
+static void replayRecord(const record_t* r) {
+  advanceTo(r->t);
+
+  if (strcmp(r->type, "acc") == 0) {
+    accAccumulator.x += r->v[0];
+    accAccumulator.y += r->v[1];
+    accAccumulator.z += r->v[2];
+    accCount++;
+  } else if (strcmp(r->type, "gyro") == 0) {
+    gyroAccumulator.x += r->v[0];
+    gyroAccumulator.y += r->v[1];
+    gyroAccumulator.z += r->v[2];
+    gyroCount++;
+  } else if (strcmp(r->type, "pos") == 0) {
+    positionMeasurement_t m = {.x = r->v[0], .y = r->v[1], .z = r->v[2], .stdDev = r->v[3]};
+    TIMED(modelPosition, kalmanCoreUpdateWithPosition(&coreData, &m));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, r->t));
+  } else if (strcmp(r->type, "pose") == 0) {
+    poseMeasurement_t m = {.x = r->v[0], .y = r->v[1], .z = r->v[2],
+      .quat = {.x = r->v[3], .y = r->v[4], .z = r->v[5], .w = r->v[6]}, .stdDevPos = r->v[7], .stdDevQuat = r->v[8]};
+    TIMED(modelPose, kalmanCoreUpdateWithPose(&coreData, &m));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, r->t));
+  } else if (strcmp(r->type, "tof") == 0) {
+    tofMeasurement_t m = {.timestamp = r->t, .distance = r->v[0], .stdDev = r->v[1]};
+    TIMED(modelTof, kalmanCoreUpdateWithTof(&coreData, &m));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, r->t));
+  } else if (strcmp(r->type, "height") == 0) {
+    heightMeasurement_t m = {.timestamp = r->t, .height = r->v[0], .stdDev = r->v[1]};
+    TIMED(modelHeight, kalmanCoreUpdateWithAbsoluteHeight(&coreData, &m));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, r->t));
+  } else if (strcmp(r->type, "yaw") == 0) {
+    yawErrorMeasurement_t m = {.timestamp = r->t, .yawError = r->v[0], .stdDev = r->v[1]};
+    TIMED(modelYawError, kalmanCoreUpdateWithYawError(&coreData, &m));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, r->t));
+  } else if (strcmp(r->type, "baro") == 0) {
+    TIMED(modelBaro, kalmanCoreUpdateWithBaro(&coreData, r->v[0], true));
+    TIMED(modelFinalize, kalmanCoreFinalize(&coreData, r->t));
+  } else if (strcmp(r->type, "ref") == 0) {
+    const float dx = coreData.S[KC_STATE_X] - r->v[0];
+    const float dy = coreData.S[KC_STATE_Y] - r->v[1];
+    const float dz = coreData.S[KC_STATE_Z] - r->v[2];
+    const float error = sqrtf(dx * dx + dy * dy + dz * dz);
+    errorSquareSum += error * error;
+    if (error > errorMax) {
+      errorMax = error;
+    }
+    errorCount++;
+  }
+}
+
+static void replayFile(FILE* file) {
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    record_t record;
+    memset(&record, 0, sizeof(record));
+    const int count = sscanf(line, "%7s %f %f %f %f %f %f %f %f %f %f", record.type, &record.t,
+      &record.v[0], &record.v[1], &record.v[2], &record.v[3], &record.v[4], &record.v[5], &record.v[6], &record.v[7], &record.v[8]);
+    if (count >= 3) {
+      replayRecord(&record);
+    }
+  }
+}
+
+// Circular flight at 1 m height, radius 0.5 m, period 5 s, level attitude. IMU at 500 Hz,
+// position at 100 Hz and ToF at 20 Hz, with noise.
+static void replaySynthetic() {
+  const float radius = 0.5f;
+  const float height = 1.0f;
+  const float omega = 2.0f * PI / 5.0f;
+
+  // Start at rest in the initial state of the filter
+  coreData.S[KC_STATE_Z] = height;
+
+  for (int ms = 0; ms < 20000; ms += 2) {
+    const float t = ms;
+    const float s = t / 1000.0f;
+    // Speed up smoothly during the first 5 seconds to avoid a step in velocity
+    const float ramp = s < 5.0f ? s / 5.0f : 1.0f;
+    const float angle = omega * (s < 5.0f ? s * s / 10.0f : s - 2.5f);
+    const float x = radius * cosf(angle) - radius;
+    const float y = radius * sinf(angle);
+
+    const float w = omega * ramp;
+    const float wDot = s < 5.0f ? omega / 5.0f : 0.0f;
+    const float ax = -radius * (w * w * cosf(angle) + wDot * sinf(angle));
+    const float ay = -radius * (w * w * sinf(angle) - wDot * cosf(angle));
+
+    record_t acc = {.type = "acc", .t = t, .v = {ax / 9.81f + noise(0.01f), ay / 9.81f + noise(0.01f), 1.0f + noise(0.01f)}};
+    replayRecord(&acc);
+    record_t gyro = {.type = "gyro", .t = t, .v = {noise(0.1f), noise(0.1f), noise(0.1f)}};
+    replayRecord(&gyro);
+
+    if (ms % 10 == 0) {
+      record_t pos = {.type = "pos", .t = t, .v = {x + noise(0.005f), y + noise(0.005f), height + noise(0.005f), 0.01f}};
+      replayRecord(&pos);
+      record_t ref = {.type = "ref", .t = t, .v = {x, y, height}};
+      replayRecord(&ref);
+    }
+
+    if (ms % 25 == 0) {
+      record_t tof = {.type = "tof", .t = t, .v = {height + noise(0.01f), 0.02f}};
+      replayRecord(&tof);
+    }
+  }
+}
+
+// Deterministic, uniform noise with the given standard deviation
+static float noise(float stdDev) {
+  randomState = randomState * 1103515245u + 12345u;
+  const float uniform = ((randomState >> 8) & 0xffff) / 65535.0f - 0.5f;
+  return uniform * stdDev * 3.4641f;
+}
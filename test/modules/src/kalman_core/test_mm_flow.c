@@ -0,0 +1,94 @@
+// File under test mm_flow.c
+#include "mm_flow.h"
+#include "mm_tof.h"
+#include "kalman_core.h"
+
+#include <string.h>
+#include "unity.h"
+
+#include "mock_cfassert.h"
+#include "fastmath.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+static kalmanCoreData_t actual;
+static kalmanCoreData_t expected;
+static kalmanCoreWorkspace_t workspace;
+
+static flowMeasurement_t flow;
+static tofMeasurement_t tof;
+static Axis3f gyro;
+
+static void fixtureSetTiltedState(kalmanCoreData_t* this, float r22);
+static void assertFilterIsEqual(const kalmanCoreData_t* expected, const kalmanCoreData_t* actual);
+
+void setUp(void) {
+  kalmanCoreInit(&expected, &workspace);
+  fixtureSetTiltedState(&expected, 0.95f);
+
+  memcpy(&actual, &expected, sizeof(actual));
+  actual.Pm.pData = (float*)actual.P;
+
+  flow = (flowMeasurement_t){.dpixelx = 3.0f, .dpixely = -2.0f, .stdDevX = 0.25f, .stdDevY = 0.25f, .dt = 0.01f};
+  tof = (tofMeasurement_t){.distance = 0.62f, .stdDev = 0.0025f};
+  gyro = (Axis3f){.x = 12.0f, .y = -7.0f, .z = 3.0f};
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatFlowAndTofUpdateMatchesSeparateUpdates() {
+  // Fixture
+  // Fixture done in setUp()
+
+  // Test
+  kalmanCoreUpdateWithFlow(&expected, &flow, &gyro);
+  kalmanCoreUpdateWithTof(&expected, &tof);
+
+  kalmanCoreUpdateWithFlowAndTof(&actual, &flow, &gyro, &tof);
+
+  // Assert
+  assertFilterIsEqual(&expected, &actual);
+}
+
+void testThatFlowAndTofUpdateSkipsTofWhenUpsideDown() {
+  // Fixture
+  fixtureSetTiltedState(&expected, -0.5f);
+  memcpy(&actual, &expected, sizeof(actual));
+  actual.Pm.pData = (float*)actual.P;
+
+  // Test
+  kalmanCoreUpdateWithFlow(&expected, &flow, &gyro);
+  kalmanCoreUpdateWithTof(&expected, &tof);
+
+  kalmanCoreUpdateWithFlowAndTof(&actual, &flow, &gyro, &tof);
+
+  // Assert
+  assertFilterIsEqual(&expected, &actual);
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void fixtureSetTiltedState(kalmanCoreData_t* this, float r22) {
+  this->S[KC_STATE_Z] = 0.6f;
+  this->S[KC_STATE_PX] = 0.3f;
+  this->S[KC_STATE_PY] = -0.2f;
+  this->R[2][2] = r22;
+
+  this->P[KC_STATE_Z][KC_STATE_Z] = 0.04f;
+  this->P[KC_STATE_PX][KC_STATE_PX] = 0.02f;
+  this->P[KC_STATE_PY][KC_STATE_PY] = 0.03f;
+  this->P[KC_STATE_Z][KC_STATE_PX] = this->P[KC_STATE_PX][KC_STATE_Z] = 0.005f;
+  this->P[KC_STATE_Z][KC_STATE_PY] = this->P[KC_STATE_PY][KC_STATE_Z] = -0.004f;
+}
+
+static void assertFilterIsEqual(const kalmanCoreData_t* expected, const kalmanCoreData_t* actual) {
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected->S[i], actual->S[i]);
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->P[i][j], actual->P[i][j]);
+    }
+  }
+}
@@ -0,0 +1,152 @@
+// File under test mm_robust.c
+#include "mm_robust.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+static float P[KC_STATE_DIM][KC_STATE_DIM];
+static float L[KC_STATE_DIM][KC_STATE_DIM];
+
+void setUp(void) {
+  // A positive definite matrix, A * A^T + I with a fixed pseudo random A
+  float A[KC_STATE_DIM][KC_STATE_DIM];
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      A[i][j] = (float)((i * 7 + j * 13) % 11) / 11.0f - 0.5f;
+    }
+  }
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = (i == j) ? 1.0f : 0.0f;
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        sum += A[i][k] * A[j][k];
+      }
+      P[i][j] = sum;
+    }
+  }
+
+  memset(L, 0, sizeof(L));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatFactorReproducesTheMatrix() {
+  // Fixture
+  float actual[KC_STATE_DIM][KC_STATE_DIM];
+
+  // Test
+  kalmanCoreRobustFactorize(P, L);
+  kalmanCoreRobustFactorToMatrix(L, actual);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, P[i][j], actual[i][j]);
+    }
+    for (int j = i + 1; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_EQUAL_FLOAT(0.0f, L[i][j]);
+    }
+  }
+}
+
+void testThatReweightedFactorIsTheFactorOfTheReweightedMatrix() {
+  // Fixture
+  float weightsInv[KC_STATE_DIM];
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    weightsInv[i] = 1.0f + i * 0.5f;
+  }
+
+  kalmanCoreRobustFactorize(P, L);
+
+  float reweighted[KC_STATE_DIM][KC_STATE_DIM];
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        sum += L[i][k] * weightsInv[k] * L[j][k];
+      }
+      reweighted[i][j] = sum;
+    }
+  }
+
+  float expected[KC_STATE_DIM][KC_STATE_DIM];
+  kalmanCoreRobustFactorize(reweighted, expected);
+
+  // Test
+  kalmanCoreRobustReweightFactor(L, weightsInv);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected[i][j], L[i][j]);
+    }
+  }
+}
+
+void testThatFactorTimesVectorIsTheMatrixTimesVector() {
+  // Fixture
+  const float x[KC_STATE_DIM] = {1.0f, -2.0f, 0.5f, 0.0f, 3.0f, -1.0f, 0.25f, 2.0f, -0.5f};
+  float expected[KC_STATE_DIM];
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    expected[i] = 0.0f;
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      expected[i] += P[i][j] * x[j];
+    }
+  }
+
+  kalmanCoreRobustFactorize(P, L);
+
+  // Test
+  float actual[KC_STATE_DIM];
+  kalmanCoreRobustFactorTimesVector(L, x, actual);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected[i], actual[i]);
+  }
+}
+
+void testThatSolveLowerInvertsTheFactor() {
+  // Fixture
+  const float expected[KC_STATE_DIM] = {1.0f, -2.0f, 0.5f, 0.0f, 3.0f, -1.0f, 0.25f, 2.0f, -0.5f};
+  kalmanCoreRobustFactorize(P, L);
+
+  float b[KC_STATE_DIM];
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    b[i] = 0.0f;
+    for (int j = 0; j <= i; j++) {
+      b[i] += L[i][j] * expected[j];
+    }
+  }
+
+  // Test
+  float actual[KC_STATE_DIM];
+  kalmanCoreRobustSolveLower(L, b, actual);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected[i], actual[i]);
+  }
+}
+
+void testThatConditioningBoundsTheFactor() {
+  // Fixture
+  L[0][0] = -1.0f;
+  L[1][0] = 1000.0f;
+  L[2][1] = -1000.0f;
+  L[3][3] = NAN;
+
+  // Test
+  kalmanCoreRobustConditionFactor(L);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, L[0][0]);
+  TEST_ASSERT_EQUAL_FLOAT(100.0f, L[1][0]);
+  TEST_ASSERT_EQUAL_FLOAT(-100.0f, L[2][1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 100.0f, L[3][3]);
+  TEST_ASSERT_TRUE(L[4][4] > 0.0f);
+}
@@ -0,0 +1,184 @@
+// File under test mm_sweep_angles.c
+#include "mm_sweep_angles.h"
+
+#include <string.h>
+#include "unity.h"
+
+#include "mock_kalman_core.h"
+#include "mock_outlierFilter.h"
+
+static kalmanCoreData_t this;
+static sweepAngleMeasurement_t sweepInfo;
+static OutlierFilterLhState_t outlierFilterState;
+
+static const vec3d sensorPos = {0.1, 0.0, 0.0};
+static const vec3d rotorPos = {-1.0, 0.0, 0.0};
+static const mat3d identity = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+static const lighthouseCalibrationSweep_t calib = {0};
+static lighthouseCalibrationModelConstants_t modelConstants;
+
+static float actualError;
+static int scalarUpdateCallCount;
+static int vectorUpdateRows[4];
+static int vectorUpdateCallCount;
+// Sweeps for which the outlier filter rejects, indexed by call number
+static bool isOutlier[4];
+
+static float mockMeasurementModel(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib);
+static void mockKalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise, int cmock_num_calls);
+static void mockKalmanCoreVectorUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *error, const float *stdMeasNoise, int cmock_num_calls);
+static bool mockOutlierFilterValidateLighthouseSweep(OutlierFilterLhState_t* this, const float distanceToBs, const float angleError, const uint32_t nowMs, int cmock_num_calls);
+
+void setUp(void) {
+  memset(&this, 0, sizeof(this));
+  memcpy(this.R, identity, sizeof(this.R));
+
+  memset(&modelConstants, 0, sizeof(modelConstants));
+
+  memset(&sweepInfo, 0, sizeof(sweepInfo));
+  sweepInfo.sensorPos = &sensorPos;
+  sweepInfo.rotorPos = &rotorPos;
+  sweepInfo.rotorRot = &identity;
+  sweepInfo.rotorRotInv = &identity;
+  sweepInfo.sensorId = 1;
+  sweepInfo.measuredSweepAngle = 0.0;
+  sweepInfo.stdDev = 0.1;
+  sweepInfo.calib = &calib;
+  sweepInfo.modelConstants = &modelConstants;
+  sweepInfo.calibrationMeasurementModel = mockMeasurementModel;
+
+  actualError = 0.0;
+  scalarUpdateCallCount = 0;
+  memset(vectorUpdateRows, 0, sizeof(vectorUpdateRows));
+  vectorUpdateCallCount = 0;
+  memset(isOutlier, 0, sizeof(isOutlier));
+
+  outlierFilterValidateLighthouseSweep_StubWithCallback(mockOutlierFilterValidateLighthouseSweep);
+  kalmanCoreScalarUpdate_StubWithCallback(mockKalmanCoreScalarUpdate);
+  kalmanCoreVectorUpdate_StubWithCallback(mockKalmanCoreVectorUpdate);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatSensorPositionIsRotatedWithTheAttitude() {
+  // Fixture
+  // Rotate 180 degrees around the z-axis
+  const mat3d R = {{-1, 0, 0}, {0, -1, 0}, {0, 0, 1}};
+  memcpy(this.R, R, sizeof(this.R));
+
+  // The sensor is at x = -0.1 and 0.9 m from the rotor
+  const float expected = -0.9;
+
+  // Test
+  kalmanCoreUpdateWithSweepAngles(&this, &sweepInfo, 0, &outlierFilterState);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, scalarUpdateCallCount);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected, actualError);
+}
+
+void testThatRotatedSensorPositionIsReusedUntilTheAttitudeIsUpdated() {
+  // Fixture
+  const mat3d R = {{-1, 0, 0}, {0, -1, 0}, {0, 0, 1}};
+  kalmanCoreUpdateWithSweepAngles(&this, &sweepInfo, 0, &outlierFilterState);
+  memcpy(this.R, R, sizeof(this.R));
+
+  // Test
+  kalmanCoreUpdateWithSweepAngles(&this, &sweepInfo, 0, &outlierFilterState);
+  const float actualBeforeFinalize = actualError;
+
+  // Finalization of the attitude invalidates the cached positions
+  this.sweepSensorPosValid = 0;
+  kalmanCoreUpdateWithSweepAngles(&this, &sweepInfo, 0, &outlierFilterState);
+  const float actualAfterFinalize = actualError;
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.1, actualBeforeFinalize);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -0.9, actualAfterFinalize);
+}
+
+void testThatSensorPositionsAreCachedPerSensor() {
+  // Fixture
+  const vec3d otherSensorPos = {0.0, 0.0, 0.0};
+  kalmanCoreUpdateWithSweepAngles(&this, &sweepInfo, 0, &outlierFilterState);
+
+  sweepInfo.sensorId = 2;
+  sweepInfo.sensorPos = &otherSensorPos;
+
+  // Test
+  kalmanCoreUpdateWithSweepAngles(&this, &sweepInfo, 0, &outlierFilterState);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.0, actualError);
+}
+
+void testThatSweepBatchIsFusedInVectorUpdatesOfAtMostTheMaxDimension() {
+  // Fixture
+  sweepAngleMeasurement_t* sweeps[KC_MAX_VECTOR_UPDATE_DIM + 2];
+  for (int i = 0; i < KC_MAX_VECTOR_UPDATE_DIM + 2; i++) {
+    sweeps[i] = &sweepInfo;
+  }
+
+  // Test
+  kalmanCoreUpdateWithSweepAngleBatch(&this, sweeps, KC_MAX_VECTOR_UPDATE_DIM + 2, 0, &outlierFilterState);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, scalarUpdateCallCount);
+  TEST_ASSERT_EQUAL_INT(2, vectorUpdateCallCount);
+  TEST_ASSERT_EQUAL_INT(KC_MAX_VECTOR_UPDATE_DIM, vectorUpdateRows[0]);
+  TEST_ASSERT_EQUAL_INT(2, vectorUpdateRows[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.1, actualError);
+}
+
+void testThatOutliersAreLeftOutOfTheSweepBatch() {
+  // Fixture
+  sweepAngleMeasurement_t* sweeps[] = {&sweepInfo, &sweepInfo, &sweepInfo};
+  isOutlier[1] = true;
+
+  // Test
+  kalmanCoreUpdateWithSweepAngleBatch(&this, sweeps, 3, 0, &outlierFilterState);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, vectorUpdateCallCount);
+  TEST_ASSERT_EQUAL_INT(2, vectorUpdateRows[0]);
+}
+
+void testThatNoUpdateIsDoneWhenAllSweepsInTheBatchAreOutliers() {
+  // Fixture
+  sweepAngleMeasurement_t* sweeps[] = {&sweepInfo, &sweepInfo};
+  isOutlier[0] = true;
+  isOutlier[1] = true;
+
+  // Test
+  kalmanCoreUpdateWithSweepAngleBatch(&this, sweeps, 2, 0, &outlierFilterState);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, vectorUpdateCallCount);
+}
+
+// Test support ----------------------------------------------------------------------------------------------------
+
+// Predict the sweep angle as the x coordinate in the rotor frame, to easily verify the position of the sensor
+static float mockMeasurementModel(const float x, const float y, const float z, const lighthouseCalibrationModelConstants_t* constants, const lighthouseCalibrationSweep_t* calib) {
+  return x;
+}
+
+static void mockKalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise, int cmock_num_calls) {
+  actualError = error;
+  scalarUpdateCallCount++;
+}
+
+static void mockKalmanCoreVectorUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *error, const float *stdMeasNoise, int cmock_num_calls) {
+  actualError = error[Hm->numRows - 1];
+  vectorUpdateRows[vectorUpdateCallCount] = Hm->numRows;
+  vectorUpdateCallCount++;
+}
+
+static bool mockOutlierFilterValidateLighthouseSweep(OutlierFilterLhState_t* this, const float distanceToBs, const float angleError, const uint32_t nowMs, int cmock_num_calls) {
+  if (cmock_num_calls < 4) {
+    return !isOutlier[cmock_num_calls];
+  }
+  return true;
+}
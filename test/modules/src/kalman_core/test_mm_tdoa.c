@@ -13,6 +13,7 @@ static float expectedHm[KC_STATE_DIM];
 
 // Instrumented in code under test
 extern uint32_t tdoaCount;
+extern float tdoaMahalanobisGate;
 
 void setUp(void) {
   memset(&this, 0, sizeof(this));
@@ -20,6 +21,7 @@ void setUp(void) {
 
   // Make sure we pass the tdoaCount counter
   tdoaCount = 100;
+  tdoaMahalanobisGate = 0.0f;
 
   initKalmanCoreScalarUpdateExpectationsSingleCall();
 }
@@ -107,3 +109,125 @@ void testThatScalarUpdateIsNotCalledWhenTheOutlierFilterIsBlocking() {
   // Assert
   assertScalarUpdateWasNotCalled();
 }
+
+static float actualGate;
+static int gatedUpdateCallCount;
+
+static bool mockKalmanCoreScalarUpdateGated(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise, float maxMahalanobisDistance, int cmock_num_calls) {
+  gatedUpdateCallCount++;
+  actualGate = maxMahalanobisDistance;
+  return true;
+}
+
+void testThatGatedScalarUpdateIsUsedWhenTheGateIsSet() {
+  // Fixture
+  tdoaMeasurement_t measurement = {
+    .anchorPositions = {
+      {.x = -1.0, .y = 0.0, .z = 0.0},
+      {.x = 1.0, .y = 0.0, .z = 0.0},
+    },
+    .distanceDiff = 0.1,
+    .stdDev = 0.123,
+  };
+
+  tdoaMahalanobisGate = 3.0f;
+  gatedUpdateCallCount = 0;
+  kalmanCoreScalarUpdateGated_StubWithCallback(mockKalmanCoreScalarUpdateGated);
+  outlierFilterValidateTdoaSteps_IgnoreAndReturn(true);
+
+  // Test
+  kalmanCoreUpdateWithTDOA(&this, &measurement);
+
+  // Assert
+  assertScalarUpdateWasNotCalled();
+  TEST_ASSERT_EQUAL_INT(1, gatedUpdateCallCount);
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, actualGate);
+}
+
+static int vectorUpdateCallCount;
+static int actualRows;
+static float actualBatchHm[TDOA_BATCH_MAX_COUNT][KC_STATE_DIM];
+static float actualBatchErrors[TDOA_BATCH_MAX_COUNT];
+
+static void mockKalmanCoreVectorUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *error, const float *stdMeasNoise, int cmock_num_calls) {
+  vectorUpdateCallCount++;
+  actualRows = Hm->numRows;
+  memcpy(actualBatchHm, Hm->pData, Hm->numRows * KC_STATE_DIM * sizeof(float));
+  memcpy(actualBatchErrors, error, Hm->numRows * sizeof(float));
+}
+
+static bool mockOutlierFilterRejectingSecond(const tdoaMeasurement_t* tdoa, const float error, const vector_t* jacobian, const point_t* estPos, int cmock_num_calls) {
+  return cmock_num_calls != 1;
+}
+
+void testThatBatchIsFusedInOneVectorUpdate() {
+  // Fixture
+  vectorUpdateCallCount = 0;
+  kalmanCoreVectorUpdate_StubWithCallback(mockKalmanCoreVectorUpdate);
+  outlierFilterValidateTdoaSteps_IgnoreAndReturn(true);
+
+  tdoaBatchMeasurement_t batch = {
+    .anchorPosition = {1.0, 0.0, 0.0},
+    .otherAnchorPositions = {{-1.0, 0.0, 0.0}, {0.0, 2.0, 0.0}},
+    .distanceDiffs = {0.0, 0.5},
+    .count = 2,
+    .stdDev = 0.123,
+  };
+
+  // Test
+  kalmanCoreUpdateWithTDOABatch(&this, &batch);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, vectorUpdateCallCount);
+  TEST_ASSERT_EQUAL_INT(2, actualRows);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -2.0, actualBatchHm[0][KC_STATE_X]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.0, actualBatchHm[1][KC_STATE_X]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.0, actualBatchHm[1][KC_STATE_Y]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, actualBatchErrors[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.5, actualBatchErrors[1]);
+}
+
+void testThatRowsRejectedByTheOutlierFilterAreRemovedFromTheBatch() {
+  // Fixture
+  vectorUpdateCallCount = 0;
+  kalmanCoreVectorUpdate_StubWithCallback(mockKalmanCoreVectorUpdate);
+  outlierFilterValidateTdoaSteps_StubWithCallback(mockOutlierFilterRejectingSecond);
+
+  tdoaBatchMeasurement_t batch = {
+    .anchorPosition = {1.0, 0.0, 0.0},
+    .otherAnchorPositions = {{-1.0, 0.0, 0.0}, {0.0, 2.0, 0.0}, {0.0, 0.0, 3.0}},
+    .distanceDiffs = {0.0, 0.5, 0.25},
+    .count = 3,
+    .stdDev = 0.123,
+  };
+
+  // Test
+  kalmanCoreUpdateWithTDOABatch(&this, &batch);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, vectorUpdateCallCount);
+  TEST_ASSERT_EQUAL_INT(2, actualRows);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -2.0, actualBatchHm[0][KC_STATE_X]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.0, actualBatchHm[1][KC_STATE_Z]);
+}
+
+void testThatNoVectorUpdateIsDoneWhenAllRowsAreRejected() {
+  // Fixture
+  vectorUpdateCallCount = 0;
+  kalmanCoreVectorUpdate_StubWithCallback(mockKalmanCoreVectorUpdate);
+  outlierFilterValidateTdoaSteps_IgnoreAndReturn(false);
+
+  tdoaBatchMeasurement_t batch = {
+    .anchorPosition = {1.0, 0.0, 0.0},
+    .otherAnchorPositions = {{-1.0, 0.0, 0.0}},
+    .distanceDiffs = {0.0},
+    .count = 1,
+    .stdDev = 0.123,
+  };
+
+  // Test
+  kalmanCoreUpdateWithTDOABatch(&this, &batch);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, vectorUpdateCallCount);
+}
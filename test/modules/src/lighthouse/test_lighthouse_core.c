@@ -11,6 +11,8 @@
 #include "mock_lighthouse_calibration.h"
 #include "mock_uart1.h"
 #include "mock_statsCnt.h"
+#include "mock_rateSupervisor.h"
+#include "mock_usec_time.h"
 #include "mock_cfassert.h"
 #include "mock_crtp_localization_service.h"
 #include "mock_lighthouse_storage.h"
@@ -248,13 +250,15 @@ void testThatSlowBitIsDecodedInUartFrame() {
 
 // Test support ----------------------------------------------------------------------------------------------------
 
-static void uart1ReadCallback(char* ch, int cmock_num_calls) {
+static uint32_t uart1ReadCallback(uint8_t* data, const uint32_t maxLength, const uint32_t timeoutTicks, int cmock_num_calls) {
     if (uart1BytesRead >= uart1SequenceLength) {
         TEST_FAIL_MESSAGE("Too many bytes read from uart1");
     }
 
-    *ch = uart1Sequence[uart1BytesRead];
+    // One byte per call to be able to count how many bytes the code under test consumes
+    data[0] = uart1Sequence[uart1BytesRead];
     uart1BytesRead++;
+    return 1;
 }
 
 static void uart1SetSequence(char* sequence, int length) {
@@ -262,5 +266,5 @@ static void uart1SetSequence(char* sequence, int length) {
     uart1Sequence = sequence;
     uart1SequenceLength = length;
 
-    uart1Getchar_StubWithCallback(uart1ReadCallback);
+    uart1GetBytesWithTimeout_StubWithCallback(uart1ReadCallback);
 }
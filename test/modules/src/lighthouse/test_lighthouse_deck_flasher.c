@@ -4,14 +4,49 @@
 #include "unity.h"
 #include "mock_system.h"
 #include "mock_lh_bootloader.h"
-#include "mock_crc32.h"
+#include "lighthouse.h" // @NO_MODULE
 
 #include "freertosMocks.h"
 
 #include <stdbool.h>
+#include <string.h>
+
+#define PAGE_SIZE 256
+#define MAX_EVENTS 16
+
+// Flash operations in the order they are called, 'E' erase, 'P' page program, 'C' wait for completion, 'R' read
+static char events[MAX_EVENTS + 1];
+static int eventCount;
+
+static uint32_t writtenAddress[MAX_EVENTS];
+static uint16_t writtenLength[MAX_EVENTS];
+static uint8_t writtenData[MAX_EVENTS][PAGE_SIZE];
+static int writtenCount;
+
+static uint8_t data[2 * PAGE_SIZE];
+
+static void addEvent(char event);
+static bool mockEraseFirmware(int cmock_num_calls);
+static bool mockWritePage(uint32_t address, uint16_t length, const uint8_t *buffer, int cmock_num_calls);
+static bool mockWaitComplete(int cmock_num_calls);
+static bool mockRead(uint32_t address, uint16_t length, uint8_t *buffer, int cmock_num_calls);
+static void startUpgrade();
 
 void setUp(void) {
-  // Empty
+  lhblFlashEraseFirmware_StubWithCallback(mockEraseFirmware);
+  lhblFlashWritePage_StubWithCallback(mockWritePage);
+  lhblFlashWaitComplete_StubWithCallback(mockWaitComplete);
+  lhblFlashRead_StubWithCallback(mockRead);
+
+  for (int i = 0; i < (int)sizeof(data); i++) {
+    data[i] = i;
+  }
+
+  // Drops the state of the previous test
+  startUpgrade();
+  memset(events, 0, sizeof(events));
+  eventCount = 0;
+  writtenCount = 0;
 }
 
 void tearDown(void) {
@@ -21,28 +56,147 @@ void tearDown(void) {
 
 void testThaEraseFwIsCalledWhenWritingTheFirstBlock() {
   // Fixture
-  lhblFlashEraseFirmware_ExpectAndReturn(true);
-  uint8_t buffer[] = {1, 2, 3, 4};
-  lhblFlashWritePage_ExpectWithArrayAndReturn(LH_FW_ADDR + 0, 4, buffer, 4, true);
 
   // Test
-  bool actual = lighthouseDeckFlasherWrite(0, 4, buffer);
+  bool actual = lighthouseDeckFlasherWrite(0, 4, data);
 
   // Actual
   TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_STRING("E", events);
 }
 
+void testThatDataIsCollectedToAFullPageBeforeItIsWritten() {
+  // Fixture
+  lighthouseDeckFlasherWrite(0, 200, data);
+
+  // Test
+  bool actual = lighthouseDeckFlasherWrite(200, 56, &data[200]);
+
+  // Actual
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_STRING("EP", events);
+  TEST_ASSERT_EQUAL_UINT32(LH_FW_ADDR, writtenAddress[0]);
+  TEST_ASSERT_EQUAL_UINT16(PAGE_SIZE, writtenLength[0]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(data, writtenData[0], PAGE_SIZE);
+}
 
 void testThaEraseFwSplitsWriteBetweenTwoPages() {
   // Fixture
-  uint8_t buffer[] = {1, 2, 3, 4};
-  lhblFlashWritePage_ExpectWithArrayAndReturn(LH_FW_ADDR + 254, 2, buffer, 2, true);
-  lhblFlashWritePage_ExpectWithArrayAndReturn(LH_FW_ADDR + 256, 2, &buffer[2], 2, true);
+  lighthouseDeckFlasherWrite(0, 254, data);
+
+  // Test
+  bool actual = lighthouseDeckFlasherWrite(254, 4, &data[254]);
+
+  // Actual
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_STRING("EP", events);
+  TEST_ASSERT_EQUAL_UINT32(LH_FW_ADDR, writtenAddress[0]);
+  TEST_ASSERT_EQUAL_UINT16(PAGE_SIZE, writtenLength[0]);
+}
+
+void testThatTheProgramOfAPageIsWaitedForBeforeTheNextPageIsWritten() {
+  // Fixture
+  lighthouseDeckFlasherWrite(0, 200, data);
+
+  // Test
+  lighthouseDeckFlasherWrite(200, 200, &data[200]);
+  lighthouseDeckFlasherWrite(400, 112, &data[400]);
+
+  // Actual
+  TEST_ASSERT_EQUAL_STRING("EPCP", events);
+  TEST_ASSERT_EQUAL_UINT32(LH_FW_ADDR + PAGE_SIZE, writtenAddress[1]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(&data[PAGE_SIZE], writtenData[1], PAGE_SIZE);
+}
+
+void testThatAPartialPageIsWrittenWhenTheDataIsNotContiguous() {
+  // Fixture
+  lighthouseDeckFlasherWrite(0, 10, data);
+
+  // Test
+  lighthouseDeckFlasherWrite(20, 10, &data[20]);
+
+  // Actual
+  TEST_ASSERT_EQUAL_STRING("EP", events);
+  TEST_ASSERT_EQUAL_UINT32(LH_FW_ADDR, writtenAddress[0]);
+  TEST_ASSERT_EQUAL_UINT16(10, writtenLength[0]);
+}
+
+void testThatAPartialPageIsWrittenAndCompletedBeforeARead() {
+  // Fixture
+  lighthouseDeckFlasherWrite(0, 10, data);
+  uint8_t buffer[10];
 
+  // Test
+  lighthouseDeckFlasherRead(0, 10, buffer);
+
+  // Actual
+  TEST_ASSERT_EQUAL_STRING("EPCR", events);
+  TEST_ASSERT_EQUAL_UINT16(10, writtenLength[0]);
+}
+
+void testThatTheLastPageOfTheBitstreamIsWrittenAndCompleted() {
+  // Fixture
+  const uint32_t lastPage = LIGHTHOUSE_BITSTREAM_SIZE & ~(PAGE_SIZE - 1);
+  const uint16_t lastPageSize = LIGHTHOUSE_BITSTREAM_SIZE - lastPage;
 
   // Test
-  bool actual = lighthouseDeckFlasherWrite(254, 4, buffer);
+  bool actual = lighthouseDeckFlasherWrite(lastPage, lastPageSize, data);
 
   // Actual
   TEST_ASSERT_TRUE(actual);
-}
\ No newline at end of file
+  TEST_ASSERT_EQUAL_STRING("PC", events);
+  TEST_ASSERT_EQUAL_UINT32(LH_FW_ADDR + lastPage, writtenAddress[0]);
+  TEST_ASSERT_EQUAL_UINT16(lastPageSize, writtenLength[0]);
+}
+
+void testThatDataOfAnEarlierUpgradeIsDroppedWhenANewOneStarts() {
+  // Fixture
+  lighthouseDeckFlasherWrite(0, 10, data);
+
+  // Test
+  lighthouseDeckFlasherWrite(0, 20, data);
+  lighthouseDeckFlasherWrite(PAGE_SIZE, 10, data);
+
+  // Actual
+  TEST_ASSERT_EQUAL_STRING("EEP", events);
+  TEST_ASSERT_EQUAL_UINT16(20, writtenLength[0]);
+}
+
+// Helpers ------------------------------------------------
+
+static void addEvent(char event) {
+  TEST_ASSERT_TRUE(eventCount < MAX_EVENTS);
+  events[eventCount++] = event;
+}
+
+static bool mockEraseFirmware(int cmock_num_calls) {
+  addEvent('E');
+  return true;
+}
+
+static bool mockWritePage(uint32_t address, uint16_t length, const uint8_t *buffer, int cmock_num_calls) {
+  addEvent('P');
+
+  TEST_ASSERT_TRUE(length <= PAGE_SIZE);
+  writtenAddress[writtenCount] = address;
+  writtenLength[writtenCount] = length;
+  memcpy(writtenData[writtenCount], buffer, length);
+  writtenCount++;
+
+  return true;
+}
+
+static bool mockWaitComplete(int cmock_num_calls) {
+  addEvent('C');
+  return true;
+}
+
+static bool mockRead(uint32_t address, uint16_t length, uint8_t *buffer, int cmock_num_calls) {
+  addEvent('R');
+  return true;
+}
+
+static void startUpgrade() {
+  eventCount = 0;
+  lighthouseDeckFlasherWrite(0, 0, data);
+}
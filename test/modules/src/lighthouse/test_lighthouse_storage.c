@@ -11,7 +11,10 @@
 #include "mock_pulse_processor.h"
 #include "mock_worker.h"
 
+#include "crc32.h"
+
 #include <stdbool.h>
+#include <string.h>
 
 // Functions under test
 void lighthouseStorageInitializeGeoDataFromStorage();
@@ -19,8 +22,17 @@ void lighthouseStorageInitializeCalibDataFromStorage();
 
 pulseProcessor_t lighthouseCoreState;
 
+static char bootData[2048];
+static size_t bootDataSize;
+static int bootDataStoreCount;
+
+static bool mockStorageStoreBootData(char* key, const void* buffer, size_t length, int cmock_num_calls);
+static size_t mockStorageFetchBootData(char *key, void* buffer, size_t length, int cmock_num_calls);
+static void setUpBootData();
+
 void setUp(void) {
-  // Empty
+  bootDataSize = 0;
+  bootDataStoreCount = 0;
 }
 
 void tearDown(void) {
@@ -135,3 +147,85 @@ void testInitializationOfCalibIsDoneFromStorage() {
   // Actual
   // Verified in mocks
 }
+
+void testThatDataIsInitializedFromBootData() {
+  // Fixture
+  setUpBootData();
+
+  lighthousePositionSetGeometryData_Expect(1, 0);
+  lighthousePositionSetGeometryData_IgnoreArg_geometry();
+  lighthouseCoreSetCalibrationData_Expect(2, 0);
+  lighthouseCoreSetCalibrationData_IgnoreArg_calibration();
+
+  // Test
+  lighthouseStorageInitializeDataFromStorage();
+
+  // Actual
+  // Verified in mocks, no items are fetched one by one
+  TEST_ASSERT_EQUAL_INT(0, bootDataStoreCount);
+}
+
+void testThatItemsAreFetchedOneByOneWhenBootDataIsCorrupt() {
+  // Fixture
+  setUpBootData();
+  bootData[10] ^= 0x01;
+
+  // Test
+  lighthouseStorageInitializeDataFromStorage();
+
+  // Actual
+  // Verified in mocks, no data is set from the corrupt boot data
+  // The boot data is recreated from the items
+  TEST_ASSERT_EQUAL_INT(1, bootDataStoreCount);
+}
+
+void testThatItemsAreFetchedOneByOneWhenBootDataIsMissing() {
+  // Fixture
+  memset(&lighthouseCoreState, 0, sizeof(lighthouseCoreState));
+  storageFetch_StubWithCallback(mockStorageFetchBootData);
+  storageStore_StubWithCallback(mockStorageStoreBootData);
+
+  // Test
+  lighthouseStorageInitializeDataFromStorage();
+
+  // Actual
+  // Verified in mocks
+  TEST_ASSERT_EQUAL_INT(1, bootDataStoreCount);
+}
+
+// Helpers ------------------------------------------------
+
+// Boot data with geometry for base station 1 and calibration for base station 2, and an empty state
+static void setUpBootData() {
+  memset(&lighthouseCoreState, 0, sizeof(lighthouseCoreState));
+  lighthouseCoreState.bsGeometry[1].valid = true;
+  lighthouseCoreState.bsCalibration[2].valid = true;
+
+  storageStore_StubWithCallback(mockStorageStoreBootData);
+  lighthouseStoragePersistBootData();
+  bootDataStoreCount = 0;
+
+  memset(&lighthouseCoreState, 0, sizeof(lighthouseCoreState));
+  storageFetch_StubWithCallback(mockStorageFetchBootData);
+}
+
+static bool mockStorageStoreBootData(char* key, const void* buffer, size_t length, int cmock_num_calls) {
+  if (strcmp(key, "lh/sys/0/boot") == 0) {
+    TEST_ASSERT_TRUE(length <= sizeof(bootData));
+    memcpy(bootData, buffer, length);
+    bootDataSize = length;
+    bootDataStoreCount++;
+  }
+
+  return true;
+}
+
+static size_t mockStorageFetchBootData(char *key, void* buffer, size_t length, int cmock_num_calls) {
+  if (strcmp(key, "lh/sys/0/boot") == 0 && bootDataSize == length) {
+    memcpy(buffer, bootData, length);
+    return length;
+  }
+
+  // All other items are missing
+  return 0;
+}
@@ -0,0 +1,410 @@
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 199309L
+
+// Files under test
+#include "controller_pid.h"
+#include "controller_mellinger.h"
+#include "controller_indi.h"
+#include "position_controller_indi.h"
+#include "pid.h"
+#include "filter.h"
+#include "num.h"
+#include "fastmath.h"
+#include "math3d.h"
+// @MODULE "attitude_pid_controller.c"
+// @MODULE "position_controller_pid.c"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+#include "mock_sensfusion6.h"
+#include "mock_saturation_stats.h"
+
+// Benchmark and regression test of the controllers. Not part of the normal unit test run, run it with
+//   make bench
+// or
+//   make unit FILES=test/modules/src/test_controller_benchmark.c
+// @IGNORE_IF_NOT CONTROLLER_BENCHMARK
+//
+// controllerPid(), controllerMellinger() and controllerINDI() are run over the same trace of setpoints,
+// states and gyro data, one call per stabilizer tick (1 kHz). The trace is read from the file in the
+// CONTROLLER_BENCHMARK_FILE environment variable, a file created from a uSD log with
+// tools/usdlog/controller_trace_export.py. If not set, a synthetic trace (circular flight) is used.
+//
+// The benchmark reports the time per call for each controller, and the largest difference of the
+// outputs versus a golden reference, sampled every GOLDEN_INTERVAL ticks. The golden reference is read
+// from CONTROLLER_BENCHMARK_GOLDEN, which defaults to controller_benchmark_golden.txt (next to this file)
+// for the synthetic trace. The test fails if any output differs more than CONTROLLER_BENCHMARK_MAX_DELTA
+// (in command units, default 2) from the reference. Set CONTROLLER_BENCHMARK_UPDATE_GOLDEN=1 to write the
+// reference instead, after an intended change of a controller.
+//
+// Trace format, one record per line, angles in degrees. A record is used for all ticks until the
+// tick of the next record:
+//   tick  spX spY spZ  spVx spVy spVz  spAx spAy spAz  spYaw
+//         x y z  vx vy vz  ax ay az  roll pitch yaw  qx qy qz qw  gyroX gyroY gyroZ
+
+#define DEFAULT_GOLDEN_FILE "test/modules/src/controller_benchmark_golden.txt"
+#define GOLDEN_INTERVAL 100
+#define MAX_GOLDEN_SAMPLES 10000
+#define SYNTHETIC_TICKS 10000
+#define MAX_TRACE_RECORDS 200000
+
+typedef enum {
+  controllerPidIdx,
+  controllerMellingerIdx,
+  controllerIndiIdx,
+  controllerCount,
+} controllerIdx_t;
+
+static const char* controllerNames[controllerCount] = {
+  "pid",
+  "mellinger",
+  "indi",
+};
+
+typedef struct {
+  uint32_t tick;
+  setpoint_t setpoint;
+  state_t state;
+  sensorData_t sensors;
+} record_t;
+
+typedef struct {
+  uint32_t tick;
+  float roll;
+  float pitch;
+  float yaw;
+  float thrust;
+} output_t;
+
+static record_t* trace;
+static uint32_t traceLength;
+
+static output_t outputs[controllerCount][MAX_GOLDEN_SAMPLES];
+static uint32_t outputCount[controllerCount];
+static uint64_t timeNs[controllerCount];
+static uint32_t calls[controllerCount];
+
+static uint32_t randomState;
+
+static void loadFile(FILE* file);
+static void createSynthetic();
+static void run(const controllerIdx_t controller);
+static void writeGolden(const char* fileName);
+static float compareWithGolden(FILE* file, const controllerIdx_t controller);
+static float noise(float stdDev);
+
+void setUp(void) {
+  trace = calloc(MAX_TRACE_RECORDS, sizeof(record_t));
+  traceLength = 0;
+
+  memset(outputCount, 0, sizeof(outputCount));
+  memset(timeNs, 0, sizeof(timeNs));
+  memset(calls, 0, sizeof(calls));
+
+  randomState = 12345;
+
+  sensfusion6GetInvThrustCompensationForTilt_IgnoreAndReturn(1.0f);
+  saturationStatsRateOutput_Ignore();
+  saturationStatsIntegrator_Ignore();
+}
+
+void tearDown(void) {
+  free(trace);
+}
+
+void testControllers() {
+  // Fixture
+  const char* fileName = getenv("CONTROLLER_BENCHMARK_FILE");
+  const char* goldenName = getenv("CONTROLLER_BENCHMARK_GOLDEN");
+  const char* maxDeltaStr = getenv("CONTROLLER_BENCHMARK_MAX_DELTA");
+  const float maxDelta = maxDeltaStr ? strtof(maxDeltaStr, 0) : 2.0f;
+  const bool updateGolden = getenv("CONTROLLER_BENCHMARK_UPDATE_GOLDEN") != 0;
+
+  if (fileName) {
+    FILE* file = fopen(fileName, "r");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, "Can not open trace file");
+    loadFile(file);
+    fclose(file);
+  } else {
+    createSynthetic();
+    if (!goldenName) {
+      goldenName = DEFAULT_GOLDEN_FILE;
+    }
+  }
+  TEST_ASSERT_TRUE_MESSAGE(traceLength > 0, "Empty trace");
+
+  // Test
+  for (int i = 0; i < controllerCount; i++) {
+    run(i);
+  }
+
+  // Assert
+  printf("\nController benchmark on %s, %u ticks\n", fileName ? fileName : "synthetic trace", trace[traceLength - 1].tick - trace[0].tick + 1);
+  for (int i = 0; i < controllerCount; i++) {
+    printf("%-10s %10u calls %10.0f ns/call\n", controllerNames[i], calls[i], (double)timeNs[i] / calls[i]);
+  }
+
+  if (updateGolden) {
+    TEST_ASSERT_NOT_NULL_MESSAGE(goldenName, "No golden reference file given");
+    writeGolden(goldenName);
+    printf("Wrote golden reference to %s\n", goldenName);
+    return;
+  }
+
+  if (!goldenName) {
+    printf("No golden reference, outputs not compared\n");
+    return;
+  }
+
+  FILE* golden = fopen(goldenName, "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(golden, "Can not open golden reference file");
+  bool pass = true;
+  for (int i = 0; i < controllerCount; i++) {
+    const float delta = compareWithGolden(golden, i);
+    printf("%-10s max delta versus golden reference %.3f\n", controllerNames[i], (double)delta);
+    pass &= (delta <= maxDelta);
+  }
+  fclose(golden);
+
+  TEST_ASSERT_TRUE_MESSAGE(pass, "Controller output differs from the golden reference");
+}
+
+// Helpers ------------------------------------------------------------------
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void initController(const controllerIdx_t controller) {
+  switch (controller) {
+    case controllerPidIdx:
+      controllerPidInit();
+      break;
+    case controllerMellingerIdx:
+      controllerMellingerInit();
+      break;
+    case controllerIndiIdx:
+      controllerINDIInit();
+      break;
+    default:
+      break;
+  }
+}
+
+static void callController(const controllerIdx_t controller, control_t* control, setpoint_t* setpoint, const record_t* record, const uint32_t tick) {
+  switch (controller) {
+    case controllerPidIdx:
+      controllerPid(control, setpoint, &record->sensors, &record->state, tick);
+      break;
+    case controllerMellingerIdx:
+      controllerMellinger(control, setpoint, &record->sensors, &record->state, tick);
+      break;
+    case controllerIndiIdx:
+      controllerINDI(control, setpoint, &record->sensors, &record->state, tick);
+      break;
+    default:
+      break;
+  }
+}
+
+// Mimics the stabilizer loop: the controller is called once per tick with the latest setpoint and state
+static void run(const controllerIdx_t controller) {
+  initController(controller);
+
+  control_t control;
+  memset(&control, 0, sizeof(control));
+
+  uint32_t index = 0;
+  for (uint32_t tick = trace[0].tick; tick <= trace[traceLength - 1].tick; tick++) {
+    while (index + 1 < traceLength && trace[index + 1].tick <= tick) {
+      index++;
+    }
+
+    // The controllers may modify the setpoint
+    setpoint_t setpoint = trace[index].setpoint;
+
+    const uint64_t start = nowNs();
+    callController(controller, &control, &setpoint, &trace[index], tick);
+    timeNs[controller] += nowNs() - start;
+    calls[controller]++;
+
+    if (tick % GOLDEN_INTERVAL == 0 && outputCount[controller] < MAX_GOLDEN_SAMPLES) {
+      outputs[controller][outputCount[controller]++] = (output_t){.tick = tick,
+        .roll = control.roll, .pitch = control.pitch, .yaw = control.yaw, .thrust = control.thrust};
+    }
+  }
+}
+
+static void writeGolden(const char* fileName) {
+  FILE* file = fopen(fileName, "w");
+  TEST_ASSERT_NOT_NULL_MESSAGE(file, "Can not write golden reference file");
+
+  fprintf(file, "# Golden reference for test_controller_benchmark.c\n");
+  fprintf(file, "# controller tick roll pitch yaw thrust\n");
+  for (int c = 0; c < controllerCount; c++) {
+    for (uint32_t i = 0; i < outputCount[c]; i++) {
+      const output_t* o = &outputs[c][i];
+      fprintf(file, "%s %u %.0f %.0f %.0f %.2f\n", controllerNames[c], o->tick, (double)o->roll, (double)o->pitch, (double)o->yaw, (double)o->thrust);
+    }
+  }
+
+  fclose(file);
+}
+
+// Returns the largest difference of any output versus the golden reference for one controller, or
+// infinity if the reference does not match the trace
+static float compareWithGolden(FILE* file, const controllerIdx_t controller) {
+  float maxDelta = 0.0f;
+  uint32_t matched = 0;
+
+  rewind(file);
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    char name[16];
+    output_t ref;
+    if (line[0] == '#' || sscanf(line, "%15s %u %f %f %f %f", name, &ref.tick, &ref.roll, &ref.pitch, &ref.yaw, &ref.thrust) != 6) {
+      continue;
+    }
+    if (strcmp(name, controllerNames[controller]) != 0) {
+      continue;
+    }
+
+    if (matched >= outputCount[controller] || outputs[controller][matched].tick != ref.tick) {
+      return INFINITY;
+    }
+
+    const output_t* o = &outputs[controller][matched];
+    maxDelta = fmaxf(maxDelta, fabsf(o->roll - ref.roll));
+    maxDelta = fmaxf(maxDelta, fabsf(o->pitch - ref.pitch));
+    maxDelta = fmaxf(maxDelta, fabsf(o->yaw - ref.yaw));
+    maxDelta = fmaxf(maxDelta, fabsf(o->thrust - ref.thrust));
+    matched++;
+  }
+
+  if (matched != outputCount[controller]) {
+    return INFINITY;
+  }
+
+  return maxDelta;
+}
+
+static void setPositionMode(setpoint_t* setpoint) {
+  setpoint->mode.x = modeAbs;
+  setpoint->mode.y = modeAbs;
+  setpoint->mode.z = modeAbs;
+  setpoint->mode.roll = modeDisable;
+  setpoint->mode.pitch = modeDisable;
+  setpoint->mode.yaw = modeAbs;
+  setpoint->mode.quat = modeDisable;
+}
+
+static void loadFile(FILE* file) {
+  char line[512];
+  while (fgets(line, sizeof(line), file) && traceLength < MAX_TRACE_RECORDS) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    record_t* r = &trace[traceLength];
+    memset(r, 0, sizeof(*r));
+    const int count = sscanf(line, "%u %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f",
+      &r->tick,
+      &r->setpoint.position.x, &r->setpoint.position.y, &r->setpoint.position.z,
+      &r->setpoint.velocity.x, &r->setpoint.velocity.y, &r->setpoint.velocity.z,
+      &r->setpoint.acceleration.x, &r->setpoint.acceleration.y, &r->setpoint.acceleration.z,
+      &r->setpoint.attitude.yaw,
+      &r->state.position.x, &r->state.position.y, &r->state.position.z,
+      &r->state.velocity.x, &r->state.velocity.y, &r->state.velocity.z,
+      &r->state.acc.x, &r->state.acc.y, &r->state.acc.z,
+      &r->state.attitude.roll, &r->state.attitude.pitch, &r->state.attitude.yaw,
+      &r->state.attitudeQuaternion.x, &r->state.attitudeQuaternion.y, &r->state.attitudeQuaternion.z, &r->state.attitudeQuaternion.w,
+      &r->sensors.gyro.x, &r->sensors.gyro.y, &r->sensors.gyro.z);
+    if (count != 30) {
+      continue;
+    }
+
+    // Ticks must increase
+    if (traceLength > 0 && r->tick <= trace[traceLength - 1].tick) {
+      continue;
+    }
+
+    setPositionMode(&r->setpoint);
+    r->sensors.acc.z = 1.0f;
+    traceLength++;
+  }
+}
+
+// Circular flight at 1 m height, radius 0.5 m, period 4 s, with a yaw setpoint that changes in steps.
+// The state follows the setpoint with a lag, the attitude is the tilt needed for the acceleration.
+static void createSynthetic() {
+  const float radius = 0.5f;
+  const float height = 1.0f;
+  const float omega = 2.0f * M_PI_F / 4.0f;
+  const float lag = 0.1f;
+
+  float previousRpy[3] = {0};
+
+  for (uint32_t tick = 1; tick <= SYNTHETIC_TICKS; tick++) {
+    record_t* r = &trace[traceLength++];
+    const float t = tick / 1000.0f;
+
+    // Take off during the first second
+    const float z = t < 1.0f ? height * t : height;
+    const float angle = omega * t;
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+
+    r->tick = tick;
+    setPositionMode(&r->setpoint);
+    r->setpoint.position = (point_t){.x = radius * c, .y = radius * s, .z = z};
+    r->setpoint.velocity = (velocity_t){.x = -radius * omega * s, .y = radius * omega * c, .z = t < 1.0f ? height : 0.0f};
+    r->setpoint.acceleration = (acc_t){.x = -radius * omega * omega * c, .y = -radius * omega * omega * s, .z = 0.0f};
+    r->setpoint.attitude.yaw = (tick / 2500) % 2 ? 30.0f : 0.0f;
+
+    const float tl = t - lag;
+    const float cl = cosf(omega * tl);
+    const float sl = sinf(omega * tl);
+    const float ax = -radius * omega * omega * cl;
+    const float ay = -radius * omega * omega * sl;
+    r->state.position = (point_t){.x = radius * cl + noise(0.002f), .y = radius * sl + noise(0.002f), .z = (tl < 1.0f ? height * fmaxf(tl, 0.0f) : height) + noise(0.002f)};
+    r->state.velocity = (velocity_t){.x = -radius * omega * sl + noise(0.01f), .y = radius * omega * cl + noise(0.01f), .z = noise(0.01f)};
+    r->state.acc = (acc_t){.x = ax / 9.81f + noise(0.01f), .y = ay / 9.81f + noise(0.01f), .z = noise(0.01f)};
+
+    // Tilt towards the acceleration, the yaw follows the setpoint with a rate limit
+    const float yawSetpoint = radians(r->setpoint.attitude.yaw);
+    float rpy[3] = {
+      atan2f(-ay, 9.81f),
+      atan2f(ax, 9.81f),
+      previousRpy[2] + constrain(yawSetpoint - previousRpy[2], -0.001f, 0.001f),
+    };
+    float q[4];
+    fastRpyToQuat(rpy, q);
+
+    r->state.attitude = (attitude_t){.roll = degrees(rpy[0]), .pitch = -degrees(rpy[1]), .yaw = degrees(rpy[2])};
+    r->state.attitudeQuaternion = (quaternion_t){.x = q[0], .y = q[1], .z = q[2], .w = q[3]};
+
+    if (tick == 1) {
+      memcpy(previousRpy, rpy, sizeof(previousRpy));
+    }
+    r->sensors.gyro = (Axis3f){.x = degrees(rpy[0] - previousRpy[0]) * 1000.0f + noise(0.5f),
+      .y = degrees(rpy[1] - previousRpy[1]) * 1000.0f + noise(0.5f),
+      .z = degrees(rpy[2] - previousRpy[2]) * 1000.0f + noise(0.5f)};
+    r->sensors.acc.z = 1.0f;
+
+    memcpy(previousRpy, rpy, sizeof(previousRpy));
+  }
+}
+
+// Deterministic, uniform noise with the given standard deviation
+static float noise(float stdDev) {
+  randomState = randomState * 1103515245u + 12345u;
+  const float uniform = ((randomState >> 8) & 0xffff) / 65535.0f - 0.5f;
+  return uniform * stdDev * 3.4641f;
+}
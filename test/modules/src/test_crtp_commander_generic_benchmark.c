@@ -0,0 +1,392 @@
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 199309L
+
+// File under test crtp_commander_generic.c
+#include "crtp_commander.h" // @NO_MODULE
+// @MODULE "crtp_commander_generic.c"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+#include "mock_cfassert.h"
+#include "mock_configblock.h"
+
+// Benchmark and fuzz test of the generic setpoint decoder, the parser of the setpoint packets from the radio. Not
+// part of the normal unit test run, run it with
+//   make bench
+// or
+//   make unit FILES=test/modules/src/test_crtp_commander_generic_benchmark.c
+// @IGNORE_IF_NOT CRTP_BENCHMARK
+//
+// The benchmark reports decoded packets/s for each packet type. The fuzz test mutates packets from a corpus and keeps
+// the mutations that give a new combination of type, size, setpoint kind, modes and failed asserts, to reach the
+// decoders with inputs that random packets rarely hit. The random seed can be set in the CRTP_BENCHMARK_SEED
+// environment variable.
+//
+// A failed assert reboots the Crazyflie, the decoders assert on packets of the wrong size for the type. Packets of the
+// right size must never assert.
+
+#define BENCH_PACKETS 1000
+#define BENCH_ROUNDS 1000
+#define FUZZ_ITERATIONS 500000
+
+#define CORPUS_SIZE 4096
+#define FEATURE_BITS (1 << 16)
+
+// Packet types, see crtp_commander_generic.c
+#define TYPE_STOP 0
+#define TYPE_CPPM_EMU 3
+#define TYPE_FULL_STATE 6
+#define TYPE_TIMED_POSITION 8
+#define TYPE_PACKED_POSITION 9
+#define TYPE_COUNT 10
+
+#define RADIO_ADDRESS 0xE7E7E7E701ull
+#define MY_ID 0x01
+
+// Data size (not including the type byte) of a correctly sized packet of each type. 0 means any size.
+static const uint8_t TYPE_SIZES[TYPE_COUNT] = {0, 16, 16, 9, 16, 16, 28, 16, 16, 28};
+static const char* TYPE_NAMES[TYPE_COUNT] = {
+  "stop", "velocityWorld", "zDistance", "cppmEmu", "altHold",
+  "hover", "fullState", "position", "timedPosition", "packedPosition",
+};
+
+typedef struct {
+  uint8_t size;
+  uint8_t data[CRTP_MAX_DATA_SIZE];
+} fuzzInput_t;
+
+static fuzzInput_t corpus[CORPUS_SIZE];
+static int corpusCount;
+static uint8_t features[FEATURE_BITS / 8];
+static int featureCount;
+
+static uint32_t assertCount;
+static uint32_t randomState;
+static uint32_t seed;
+
+static setpoint_t setpoint;
+
+static genericSetpointKind_t decode(const uint8_t* data, const uint8_t size);
+static void randomPacket(const int type, CRTPPacket* pk);
+static void mutate(fuzzInput_t* input);
+static bool addFeature(const uint8_t* data, const uint8_t size, const genericSetpointKind_t kind, const bool asserted);
+static bool isIntegerPacketFinite(const int type);
+static uint64_t nowNs();
+static uint32_t random32();
+static void mockAssertFail(char *exp, char *file, int line, int cmock_num_calls);
+
+void setUp(void) {
+  memset(corpus, 0, sizeof(corpus));
+  corpusCount = 0;
+  memset(features, 0, sizeof(features));
+  featureCount = 0;
+
+  assertCount = 0;
+
+  const char* seedString = getenv("CRTP_BENCHMARK_SEED");
+  seed = seedString ? strtoul(seedString, 0, 0) : 4711;
+  if (seed == 0) {
+    seed = 4711;
+  }
+  randomState = seed;
+
+  assertFail_StubWithCallback(mockAssertFail);
+  configblockGetRadioAddress_IgnoreAndReturn(RADIO_ADDRESS);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testBenchmark() {
+  // Fixture
+  static CRTPPacket packets[BENCH_PACKETS];
+  printf("\nGeneric setpoint decoder benchmark, %d packets per type\n", BENCH_PACKETS * BENCH_ROUNDS);
+
+  for (int type = 0; type < TYPE_COUNT; type++) {
+    for (int i = 0; i < BENCH_PACKETS; i++) {
+      randomPacket(type, &packets[i]);
+    }
+
+    // Test
+    uint32_t setpointCount = 0;
+    const uint64_t start = nowNs();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+      for (int i = 0; i < BENCH_PACKETS; i++) {
+        if (crtpCommanderGenericDecodeSetpoint(&setpoint, &packets[i]) != genericSetpointNone) {
+          setpointCount++;
+        }
+      }
+    }
+    const uint64_t elapsed = nowNs() - start;
+
+    // Assert
+    const double count = (double)BENCH_PACKETS * BENCH_ROUNDS;
+    printf("%-16s %12.0f packets/s %8.1f ns/packet %10u setpoints\n",
+      TYPE_NAMES[type], count / (elapsed / 1e9), elapsed / count, setpointCount);
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, assertCount, TYPE_NAMES[type]);
+    TEST_ASSERT_TRUE(setpointCount > 0);
+  }
+}
+
+void testCorrectlySizedPacketsAreDecodedWithoutAssert() {
+  // Fixture
+  CRTPPacket pk;
+
+  for (int i = 0; i < FUZZ_ITERATIONS / 10; i++) {
+    const int type = random32() % TYPE_COUNT;
+    randomPacket(type, &pk);
+
+    // Test
+    const genericSetpointKind_t kind = crtpCommanderGenericDecodeSetpoint(&setpoint, &pk);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, assertCount, TYPE_NAMES[type]);
+    if (type == TYPE_TIMED_POSITION) {
+      TEST_ASSERT_EQUAL(genericSetpointTimed, kind);
+    } else if (type != TYPE_PACKED_POSITION) {
+      TEST_ASSERT_EQUAL(genericSetpointPlain, kind);
+    }
+
+    TEST_ASSERT_TRUE_MESSAGE(isIntegerPacketFinite(type), TYPE_NAMES[type]);
+  }
+}
+
+void testUnknownTypesLeaveTheSetpointZero() {
+  // Fixture
+  setpoint_t zero;
+  memset(&zero, 0, sizeof(zero));
+
+  for (int type = TYPE_COUNT; type <= 0xff; type++) {
+    uint8_t data[CRTP_MAX_DATA_SIZE];
+    data[0] = type;
+    for (int i = 1; i < CRTP_MAX_DATA_SIZE; i++) {
+      data[i] = random32();
+    }
+    memset(&setpoint, 0xff, sizeof(setpoint));
+
+    // Test
+    const genericSetpointKind_t kind = decode(data, 1 + random32() % CRTP_MAX_DATA_SIZE);
+
+    // Assert
+    TEST_ASSERT_EQUAL(genericSetpointPlain, kind);
+    TEST_ASSERT_EQUAL_MEMORY(&zero, &setpoint, sizeof(setpoint));
+  }
+}
+
+void testFuzzedPacketsAreHandled() {
+  // Fixture
+  // Seed the corpus with one correctly sized packet of each type
+  for (int type = 0; type < TYPE_COUNT; type++) {
+    CRTPPacket pk;
+    randomPacket(type, &pk);
+    corpus[corpusCount].size = pk.size;
+    memcpy(corpus[corpusCount].data, pk.data, pk.size);
+    corpusCount++;
+  }
+
+  uint32_t assertingInputs = 0;
+  const uint64_t start = nowNs();
+
+  // Test
+  for (int i = 0; i < FUZZ_ITERATIONS; i++) {
+    fuzzInput_t input = corpus[random32() % corpusCount];
+    mutate(&input);
+
+    const uint32_t assertsBefore = assertCount;
+    const genericSetpointKind_t kind = decode(input.data, input.size);
+    const bool asserted = assertCount != assertsBefore;
+
+    // Assert
+    TEST_ASSERT_TRUE(kind == genericSetpointNone || kind == genericSetpointPlain || kind == genericSetpointTimed);
+    if (input.data[0] != TYPE_PACKED_POSITION) {
+      TEST_ASSERT_TRUE(kind != genericSetpointNone);
+    }
+    if (!asserted && input.data[0] < TYPE_COUNT) {
+      TEST_ASSERT_TRUE_MESSAGE(isIntegerPacketFinite(input.data[0]), TYPE_NAMES[input.data[0]]);
+    }
+
+    if (asserted) {
+      assertingInputs++;
+    }
+
+    if (addFeature(input.data, input.size, kind, asserted) && corpusCount < CORPUS_SIZE) {
+      corpus[corpusCount++] = input;
+    }
+  }
+
+  const uint64_t elapsed = nowNs() - start;
+  printf("\nGeneric setpoint decoder fuzz test, seed %u\n", seed);
+  printf("%d inputs, %.0f inputs/s, %d features, %d corpus entries, %u inputs that assert\n",
+    FUZZ_ITERATIONS, FUZZ_ITERATIONS / (elapsed / 1e9), featureCount, corpusCount, assertingInputs);
+}
+
+// Helpers ------------------------------------------------------------------
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void mockAssertFail(char *exp, char *file, int line, int cmock_num_calls) {
+  assertCount++;
+}
+
+// The decoders read the full packet struct regardless of the size, as on the Crazyflie the data buffer of the packet
+// is always CRTP_MAX_DATA_SIZE long
+static genericSetpointKind_t decode(const uint8_t* data, const uint8_t size) {
+  CRTPPacket pk;
+  memset(&pk, 0, sizeof(pk));
+  pk.size = size;
+  memcpy(pk.data, data, size);
+  return crtpCommanderGenericDecodeSetpoint(&setpoint, &pk);
+}
+
+// A packet of the right size for the type. The floats are in a realistic range, a random bit pattern is often NaN and
+// the decoders pass floats through as they are.
+static void randomPacket(const int type, CRTPPacket* pk) {
+  memset(pk, 0, sizeof(*pk));
+  pk->data[0] = type;
+
+  uint8_t size = TYPE_SIZES[type];
+  switch (type) {
+    case TYPE_STOP:
+      size = random32() % CRTP_MAX_DATA_SIZE;
+      for (int i = 0; i < size; i++) {
+        pk->data[1 + i] = random32();
+      }
+      break;
+    case TYPE_CPPM_EMU:
+      {
+        const uint8_t auxChannels = random32() % 11;
+        size = 9 + 2 * auxChannels;
+        pk->data[1] = auxChannels | (random32() & 0xf0);
+        for (int i = 0; i < 4 + auxChannels; i++) {
+          const uint16_t channel = 1000 + random32() % 1001;
+          memcpy(&pk->data[2 + 2 * i], &channel, sizeof(channel));
+        }
+      }
+      break;
+    case TYPE_FULL_STATE:
+    case TYPE_TIMED_POSITION:
+      for (int i = 0; i < size; i++) {
+        pk->data[1 + i] = random32();
+      }
+      break;
+    case TYPE_PACKED_POSITION:
+      for (int i = 0; i < size; i++) {
+        pk->data[1 + i] = random32();
+      }
+      // Mostly for this Crazyflie, sometimes for others
+      pk->data[1] = MY_ID - random32() % 5;
+      break;
+    default:
+      for (int i = 0; i < size / 4; i++) {
+        const float value = ((float)(random32() % 20001) - 10000.0f) / 1000.0f;
+        memcpy(&pk->data[1 + 4 * i], &value, sizeof(value));
+      }
+      break;
+  }
+
+  pk->size = 1 + size;
+}
+
+static void mutate(fuzzInput_t* input) {
+  const int mutations = 1 + random32() % 4;
+  for (int i = 0; i < mutations; i++) {
+    switch (random32() % 6) {
+      case 0:
+        {
+          const uint32_t bit = random32() % (input->size * 8);
+          input->data[bit / 8] ^= 1 << (bit % 8);
+        }
+        break;
+      case 1:
+        input->data[random32() % input->size] = random32();
+        break;
+      case 2:
+        // Interesting values
+        {
+          const uint8_t values[] = {0x00, 0x01, 0x7f, 0x80, 0xff, MY_ID, TYPE_COUNT};
+          input->data[random32() % input->size] = values[random32() % sizeof(values)];
+        }
+        break;
+      case 3:
+        input->size = 1 + random32() % CRTP_MAX_DATA_SIZE;
+        break;
+      case 4:
+        input->data[0] = random32() % (TYPE_COUNT + 2);
+        break;
+      case 5:
+        // Splice with another corpus entry
+        {
+          const fuzzInput_t* other = &corpus[random32() % corpusCount];
+          const uint8_t from = 1 + random32() % (CRTP_MAX_DATA_SIZE - 1);
+          memcpy(&input->data[from], &other->data[from], CRTP_MAX_DATA_SIZE - from);
+        }
+        break;
+    }
+  }
+}
+
+// Features of the decoded packet, a new combination makes the input interesting to mutate further
+static bool addFeature(const uint8_t* data, const uint8_t size, const genericSetpointKind_t kind, const bool asserted) {
+  uint32_t hash = 2166136261u;
+  const uint32_t values[] = {
+    data[0] < TYPE_COUNT ? data[0] : TYPE_COUNT, size, kind, asserted,
+    setpoint.mode.x, setpoint.mode.y, setpoint.mode.z,
+    setpoint.mode.roll, setpoint.mode.pitch, setpoint.mode.yaw, setpoint.mode.quat,
+    setpoint.velocity_body, setpoint.thrust > 0.0f,
+  };
+  for (int i = 0; i < (int)(sizeof(values) / sizeof(values[0])); i++) {
+    hash = (hash ^ values[i]) * 16777619u;
+  }
+
+  const uint32_t bit = hash % FEATURE_BITS;
+  if (features[bit / 8] & (1 << (bit % 8))) {
+    return false;
+  }
+
+  features[bit / 8] |= 1 << (bit % 8);
+  featureCount++;
+  return true;
+}
+
+// The packet types with integer fields always give a finite setpoint
+static bool isIntegerPacketFinite(const int type) {
+  if (type != TYPE_CPPM_EMU && type != TYPE_FULL_STATE && type != TYPE_TIMED_POSITION && type != TYPE_PACKED_POSITION) {
+    return true;
+  }
+
+  const float values[] = {
+    setpoint.attitude.roll, setpoint.attitude.pitch, setpoint.attitude.yaw,
+    setpoint.attitudeRate.roll, setpoint.attitudeRate.pitch, setpoint.attitudeRate.yaw,
+    setpoint.attitudeQuaternion.x, setpoint.attitudeQuaternion.y,
+    setpoint.attitudeQuaternion.z, setpoint.attitudeQuaternion.w,
+    setpoint.thrust,
+    setpoint.position.x, setpoint.position.y, setpoint.position.z,
+    setpoint.velocity.x, setpoint.velocity.y, setpoint.velocity.z,
+    setpoint.acceleration.x, setpoint.acceleration.y, setpoint.acceleration.z,
+  };
+  for (int i = 0; i < (int)(sizeof(values) / sizeof(values[0])); i++) {
+    if (!isfinite(values[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static uint32_t random32() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
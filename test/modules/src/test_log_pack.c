@@ -0,0 +1,96 @@
+// File under test log_pack.c
+#include "log_pack.h"
+
+#include <string.h>
+#include "unity.h"
+#include "log.h" // @NO_MODULE
+
+static struct log_pack packs[8];
+
+static struct {
+  uint8_t a;
+  uint8_t b;
+  float c;
+  float d;
+} __attribute__((packed)) variables;
+
+static uint8_t appendCopy(const uint8_t packCount, void* variable, const uint8_t logType, const uint8_t length);
+
+void setUp(void) {
+  memset(packs, 0, sizeof(packs));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAdjacentVariablesOfTheSameTypeAreMerged() {
+  // Fixture
+  uint8_t packCount = appendCopy(0, &variables.c, LOG_FLOAT, 4);
+
+  // Test
+  packCount = appendCopy(packCount, &variables.d, LOG_FLOAT, 4);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(1, packCount);
+  TEST_ASSERT_EQUAL_UINT8(packCopy, packs[0].op);
+  TEST_ASSERT_EQUAL_UINT8(8, packs[0].length);
+}
+
+void testThatAdjacentVariablesOfDifferentTypesAreNotMerged() {
+  // Fixture
+  uint8_t packCount = appendCopy(0, &variables.a, LOG_UINT8, 1);
+  packCount = appendCopy(packCount, &variables.b, LOG_UINT8, 1);
+
+  // Test
+  packCount = appendCopy(packCount, &variables.c, LOG_FLOAT, 4);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(2, packCount);
+  TEST_ASSERT_EQUAL_UINT8(LOG_UINT8, packs[0].logType);
+  TEST_ASSERT_EQUAL_UINT8(2, packs[0].length);
+  TEST_ASSERT_EQUAL_UINT8(LOG_FLOAT, packs[1].logType);
+  TEST_ASSERT_EQUAL_UINT8(4, packs[1].length);
+}
+
+void testThatVariablesWithADeadbandAreNotMerged() {
+  // Fixture
+  uint8_t packCount = appendCopy(0, &variables.c, LOG_FLOAT, 4);
+
+  // Test
+  packCount = logPackAppend(packs, packCount, &variables.d, LOG_FLOAT, LOG_FLOAT, 4, acqType_memory, 0.1f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(2, packCount);
+  TEST_ASSERT_EQUAL_FLOAT(0.1f, packs[1].deadband);
+}
+
+void testThatVariablesThatAreNotAdjacentAreNotMerged() {
+  // Fixture
+  uint8_t packCount = appendCopy(0, &variables.a, LOG_UINT8, 1);
+
+  // Test
+  packCount = appendCopy(packCount, &variables.c, LOG_UINT8, 1);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(2, packCount);
+}
+
+void testThatConvertedVariablesAreNotMerged() {
+  // Fixture
+  uint8_t packCount = logPackAppend(packs, 0, &variables.c, LOG_FLOAT, LOG_FP16, 2, acqType_memory, 0.0f);
+
+  // Test
+  packCount = logPackAppend(packs, packCount, &variables.d, LOG_FLOAT, LOG_FP16, 2, acqType_memory, 0.0f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(2, packCount);
+  TEST_ASSERT_EQUAL_UINT8(packConvert, packs[0].op);
+  TEST_ASSERT_EQUAL_UINT8(packConvert, packs[1].op);
+}
+
+// Test support ----------------------------------------------------------------------------------------------------
+
+static uint8_t appendCopy(const uint8_t packCount, void* variable, const uint8_t logType, const uint8_t length) {
+  return logPackAppend(packs, packCount, variable, logType, logType, length, acqType_memory, 0.0f);
+}
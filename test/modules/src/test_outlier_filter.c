@@ -23,6 +23,7 @@ void setUp(void) {
   tdoa.anchorPositions[1].z = 1.0;
 
   tdoa.distanceDiff = 0.0;
+  tdoa.anchorDistanceSq = 0.0;
 }
 
 void tearDown(void) {
@@ -69,6 +70,35 @@ void testThatSamplesAreRejectedWhenTdoaIsGreaterButNegativeThanDistanceBetweenAn
 }
 
 
+void testThatDistanceBetweenAnchorsFromTheStorageIsUsedWhenKnown() {
+  // Fixture
+  tdoa.distanceDiff = 1.0;
+  tdoa.anchorDistanceSq = 0.5;
+  bool expected = false;
+
+  // Test
+  bool actual = outlierFilterValidateTdoaSimple(&tdoa);
+
+  // Assert
+  TEST_ASSERT_EQUAL(expected, actual);
+}
+
+
+void testThatStepsFilterAcceptsSmallErrors() {
+  // Fixture
+  tdoa.distanceDiff = 1.0;
+  const vector_t jacobian = {.x = 1.0, .y = 0.0, .z = 0.0};
+  const point_t estPos = {.x = 3.0, .y = 1.0, .z = 1.0};
+  bool expected = true;
+
+  // Test
+  bool actual = outlierFilterValidateTdoaSteps(&tdoa, 0.1, &jacobian, &estPos);
+
+  // Assert
+  TEST_ASSERT_EQUAL(expected, actual);
+}
+
+
 // Lighthouse filter tests ----------------------------------------------------------
 
 #define LH_DISTANCE 4
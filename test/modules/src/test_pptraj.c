@@ -275,6 +275,35 @@ void testFigure8Evaluation(void) {
   // Assert
 }
 
+void testPieceEvaluationMatchesDerivativePolynomials(void) {
+  // Fixture
+  const int n_pieces = sizeof(figure8_pieces) / sizeof(figure8_pieces[0]);
+
+  // Test
+  // Assert
+  for (int i = 0; i < n_pieces; ++i) {
+    struct poly4d const *piece = &figure8_pieces[i];
+    struct poly4d vel = *piece;
+    polyder4d(&vel);
+    struct poly4d acc = vel;
+    polyder4d(&acc);
+
+    for (float t = 0; t <= piece->duration; t += 0.05f) {
+      struct traj_eval actual = poly4d_eval(piece, t);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(piece->p[0], t), actual.pos.x);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(piece->p[1], t), actual.pos.y);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(piece->p[2], t), actual.pos.z);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(piece->p[3], t), actual.yaw);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(vel.p[0], t), actual.vel.x);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(vel.p[1], t), actual.vel.y);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(vel.p[2], t), actual.vel.z);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(acc.p[0], t), actual.acc.x);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(acc.p[1], t), actual.acc.y);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, polyval(acc.p[2], t), actual.acc.z);
+    }
+  }
+}
+
 void testCompressedFigure8Evaluation(void) {
   // Fixture
   struct piecewise_traj_compressed traj;
@@ -308,6 +337,30 @@ void testCompressedFigure8Evaluation(void) {
   // Assert
 }
 
+void testCompressedPrefetchDoesNotChangeTheEvaluation(void) {
+  // Fixture
+  struct piecewise_traj_compressed expected_traj, actual_traj;
+  float duration, t;
+
+  piecewise_compressed_load(&expected_traj, figure8_compressed_pieces);
+  piecewise_compressed_load(&actual_traj, figure8_compressed_pieces);
+  expected_traj.t_begin = actual_traj.t_begin = 2;
+
+  // Test
+  // Assert
+  duration = piecewise_compressed_duration(&expected_traj);
+  for (t = expected_traj.t_begin; t < expected_traj.t_begin + duration + 0.5; t += 0.01) {
+    piecewise_compressed_prefetch(&actual_traj);
+
+    struct traj_eval expected = piecewise_compressed_eval(&expected_traj, t);
+    struct traj_eval actual = piecewise_compressed_eval(&actual_traj, t);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pos.x, actual.pos.x);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pos.y, actual.pos.y);
+    TEST_ASSERT_EQUAL_FLOAT(expected.vel.z, actual.vel.z);
+    TEST_ASSERT_EQUAL_FLOAT(expected.yaw, actual.yaw);
+  }
+}
+
 void testCompressedFrameEvaluation(void) {
   // Fixture
   struct piecewise_traj_compressed traj;
@@ -431,3 +484,44 @@ void testCompressedFigure8RandomOrderQueries(void) {
   printf("Maximum difference = %.4f\n", maxdiff);
 #endif
 }
+
+void testPiecewiseEvaluationDoesNotDependOnTheQueryOrder(void) {
+  // Fixture
+  struct piecewise_traj forward, reversed, random;
+  float duration, t;
+  int i;
+
+  memset(&forward, 0, sizeof(forward));
+  forward.t_begin = 2;
+  forward.timescale = 1.5;
+  forward.shift = mkvec(-1, 2, 3);
+  forward.n_pieces = sizeof(figure8_pieces) / sizeof(figure8_pieces[0]);
+  forward.pieces = figure8_pieces;
+  reversed = forward;
+  random = forward;
+
+  duration = piecewise_duration(&forward);
+
+  // Test
+  // Assert
+  for (t = forward.t_begin - 0.5; t < forward.t_begin + duration + 0.5; t += 0.01) {
+    float t_random = forward.t_begin + (rand() / (float)RAND_MAX) * (duration + 1) - 0.5;
+    piecewise_eval(&random, t_random);
+
+    struct traj_eval expected = piecewise_eval(&forward, t);
+    struct traj_eval actual = piecewise_eval(&random, t);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.pos.x, actual.pos.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.pos.y, actual.pos.y);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.vel.z, actual.vel.z);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.yaw, actual.yaw);
+
+    piecewise_eval_reversed(&random, t_random);
+
+    expected = piecewise_eval_reversed(&reversed, t);
+    actual = piecewise_eval_reversed(&random, t);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.pos.x, actual.pos.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.pos.y, actual.pos.y);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.vel.z, actual.vel.z);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.yaw, actual.yaw);
+  }
+}
@@ -0,0 +1,233 @@
+#include "kve/kve.h"
+#include "kve/kve_storage.h"
+
+#include "unity.h"
+#include <string.h>
+
+#define TEST_MEMORY_SIZE 200
+#define MAX_FOUND 4
+
+static char memory[TEST_MEMORY_SIZE];
+
+static size_t kvememoryRead(size_t address, void* data, size_t length) {
+    if(address + length > TEST_MEMORY_SIZE) {
+        return 0;
+    }
+    memcpy(data, &memory[address], length);
+
+    return length;
+}
+
+static size_t kvememoryWrite(size_t address, const void* data, size_t length) {
+    if(address + length > TEST_MEMORY_SIZE) {
+        return 0;
+    }
+    memcpy(&memory[address], data, length);
+
+    return length;
+}
+
+static void kvememoryFlush() {
+}
+
+static kveMemory_t kveMemory = {
+    .memorySize = TEST_MEMORY_SIZE,
+    .read = kvememoryRead,
+    .write = kvememoryWrite,
+    .flush = kvememoryFlush,
+};
+
+#define INDEX_SIZE 4
+static kveIndexEntry_t indexEntries[INDEX_SIZE];
+static kveIndex_t index = {
+    .entries = indexEntries,
+    .size = INDEX_SIZE,
+};
+
+static kveMemory_t kveIndexedMemory = {
+    .memorySize = TEST_MEMORY_SIZE,
+    .read = kvememoryRead,
+    .write = kvememoryWrite,
+    .flush = kvememoryFlush,
+    .index = &index,
+};
+
+static char foundKeys[MAX_FOUND][16];
+static char foundData[MAX_FOUND][16];
+static int foundCount;
+static int stopAfter;
+
+static bool collect(const char* key, void* buffer, size_t length) {
+    strcpy(foundKeys[foundCount], key);
+    memcpy(foundData[foundCount], buffer, length);
+    foundData[foundCount][length] = '\0';
+    foundCount++;
+
+    return foundCount != stopAfter;
+}
+
+void setUp(void) {
+    memset(memory, 'a', TEST_MEMORY_SIZE);
+    memset(foundKeys, 0, sizeof(foundKeys));
+    memset(foundData, 0, sizeof(foundData));
+    foundCount = 0;
+    stopAfter = 0;
+
+    kveFormat(&kveMemory);
+    index.count = 0;
+    index.valid = false;
+}
+
+void testThatForeachFindsAllItemsWithThePrefix() {
+  // Fixture
+  char buffer[8];
+
+  kveStore(&kveMemory, "prm/a", "one", 3);
+  kveStore(&kveMemory, "other", "two", 3);
+  kveStore(&kveMemory, "prm/b", "three", 5);
+
+  // Test
+  kveForeach(&kveMemory, "prm/", buffer, sizeof(buffer), collect);
+
+  // Assert
+  TEST_ASSERT_EQUAL(2, foundCount);
+  TEST_ASSERT_EQUAL_STRING("prm/a", foundKeys[0]);
+  TEST_ASSERT_EQUAL_STRING("one", foundData[0]);
+  TEST_ASSERT_EQUAL_STRING("prm/b", foundKeys[1]);
+  TEST_ASSERT_EQUAL_STRING("three", foundData[1]);
+}
+
+void testThatForeachSkipsDeletedItems() {
+  // Fixture
+  char buffer[8];
+
+  kveStore(&kveMemory, "prm/a", "one", 3);
+  kveStore(&kveMemory, "prm/b", "two", 3);
+  kveDelete(&kveMemory, "prm/a");
+
+  // Test
+  kveForeach(&kveMemory, "prm/", buffer, sizeof(buffer), collect);
+
+  // Assert
+  TEST_ASSERT_EQUAL(1, foundCount);
+  TEST_ASSERT_EQUAL_STRING("prm/b", foundKeys[0]);
+}
+
+void testThatForeachTruncatesTheData() {
+  // Fixture
+  char buffer[2];
+
+  kveStore(&kveMemory, "prm/a", "three", 5);
+
+  // Test
+  kveForeach(&kveMemory, "prm/", buffer, sizeof(buffer), collect);
+
+  // Assert
+  TEST_ASSERT_EQUAL(1, foundCount);
+  TEST_ASSERT_EQUAL_STRING("th", foundData[0]);
+}
+
+void testThatForeachStopsWhenTheFunctionReturnsFalse() {
+  // Fixture
+  char buffer[8];
+  stopAfter = 1;
+
+  kveStore(&kveMemory, "prm/a", "one", 3);
+  kveStore(&kveMemory, "prm/b", "two", 3);
+
+  // Test
+  kveForeach(&kveMemory, "prm/", buffer, sizeof(buffer), collect);
+
+  // Assert
+  TEST_ASSERT_EQUAL(1, foundCount);
+}
+
+void testThatForeachDoesNothingOnAnUnformattedMemory() {
+  // Fixture
+  char buffer[8];
+  memset(memory, 'a', TEST_MEMORY_SIZE);
+
+  // Test
+  kveForeach(&kveMemory, "", buffer, sizeof(buffer), collect);
+
+  // Assert
+  TEST_ASSERT_EQUAL(0, foundCount);
+}
+
+void testThatTheIndexIsBuiltFromTheMemory() {
+  // Fixture
+  char buffer[8];
+
+  kveStore(&kveMemory, "a", "one", 3);
+  kveStore(&kveMemory, "b", "two", 3);
+  kveDelete(&kveMemory, "a");
+  kveStore(&kveMemory, "c", "three", 5);
+
+  // Test
+  kveIndexBuild(&kveIndexedMemory);
+
+  // Assert
+  TEST_ASSERT_TRUE(index.valid);
+  TEST_ASSERT_EQUAL(2, index.count);
+  TEST_ASSERT_EQUAL(3, kveFetch(&kveIndexedMemory, "b", buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_MEMORY("two", buffer, 3);
+  TEST_ASSERT_EQUAL(0, kveFetch(&kveIndexedMemory, "a", buffer, sizeof(buffer)));
+}
+
+void testThatTheIndexFollowsStoresAndDeletes() {
+  // Fixture
+  char buffer[8];
+  kveFormat(&kveIndexedMemory);
+
+  // Test
+  kveStore(&kveIndexedMemory, "a", "one", 3);
+  kveStore(&kveIndexedMemory, "b", "two", 3);
+  kveStore(&kveIndexedMemory, "a", "three", 5);
+  kveDelete(&kveIndexedMemory, "b");
+
+  // Assert
+  TEST_ASSERT_EQUAL(1, index.count);
+  TEST_ASSERT_EQUAL(5, kveFetch(&kveIndexedMemory, "a", buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_MEMORY("three", buffer, 5);
+  TEST_ASSERT_EQUAL(0, kveFetch(&kveIndexedMemory, "b", buffer, sizeof(buffer)));
+}
+
+void testThatTheIndexFallsBackToScanningWhenFull() {
+  // Fixture
+  char buffer[8];
+  kveFormat(&kveIndexedMemory);
+
+  // Test
+  kveStore(&kveIndexedMemory, "a", "1", 1);
+  kveStore(&kveIndexedMemory, "b", "2", 1);
+  kveStore(&kveIndexedMemory, "c", "3", 1);
+  kveStore(&kveIndexedMemory, "d", "4", 1);
+  kveStore(&kveIndexedMemory, "e", "5", 1);
+
+  // Assert
+  TEST_ASSERT_FALSE(index.valid);
+  TEST_ASSERT_EQUAL(1, kveFetch(&kveIndexedMemory, "e", buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_MEMORY("5", buffer, 1);
+}
+
+void testThatDefragStepMovesItemsIntoHoles() {
+  // Fixture
+  char buffer[8];
+  kveFormat(&kveIndexedMemory);
+  kveStore(&kveIndexedMemory, "a", "one", 3);
+  kveStore(&kveIndexedMemory, "b", "two", 3);
+  kveStore(&kveIndexedMemory, "c", "three", 5);
+  kveDelete(&kveIndexedMemory, "a");
+
+  // Test
+  while (kveDefragStep(&kveIndexedMemory, 1)) {
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL(1 + 7 + 9, kveStorageFindEnd(&kveIndexedMemory, 1));
+  TEST_ASSERT_EQUAL(3, kveFetch(&kveIndexedMemory, "b", buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_MEMORY("two", buffer, 3);
+  TEST_ASSERT_EQUAL(5, kveFetch(&kveIndexedMemory, "c", buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_MEMORY("three", buffer, 5);
+  TEST_ASSERT_TRUE(kveCheck(&kveIndexedMemory));
+}
@@ -0,0 +1,121 @@
+// File under test lighthouse_calibration.c
+#include "lighthouse_calibration.h"
+
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+#define N_POSITIONS 4
+
+static lighthouseCalibration_t calib;
+static const float x[N_POSITIONS] = {1.0, 2.0, 0.5, 3.0};
+static const float y[N_POSITIONS] = {0.1, -0.7, 0.3, 1.2};
+static const float z[N_POSITIONS] = {-0.2, 0.4, 0.05, -0.9};
+
+static const float maxModelError = 1e-5;
+
+void setUp(void) {
+  memset(&calib, 0, sizeof(calib));
+  calib.sweep[0].phase = 0.01;
+  calib.sweep[0].tilt = -0.05;
+  calib.sweep[0].curve = 0.002;
+  calib.sweep[0].gibmag = 0.003;
+  calib.sweep[0].gibphase = 1.2;
+  calib.sweep[1].phase = -0.02;
+  calib.sweep[1].tilt = 0.04;
+  calib.sweep[1].curve = -0.001;
+  calib.sweep[1].gibmag = 0.004;
+  calib.sweep[1].gibphase = -0.7;
+  calib.valid = true;
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatBatchModelLh1MatchesScalarModel() {
+  // Fixture
+  lighthouseCalibrationModelConstants_t constants;
+  lighthouseCalibrationInitModelConstants(&constants, 0.0, &calib.sweep[0]);
+
+  float actual[N_POSITIONS];
+
+  // Test
+  lighthouseCalibrationMeasurementModelLh1Batch(x, y, z, N_POSITIONS, &constants, &calib.sweep[0], actual);
+
+  // Assert
+  for (int i = 0; i < N_POSITIONS; i++) {
+    const float expected = lighthouseCalibrationMeasurementModelLh1(x[i], y[i], z[i], &constants, &calib.sweep[0]);
+    TEST_ASSERT_FLOAT_WITHIN(maxModelError, expected, actual[i]);
+  }
+}
+
+void testThatBatchModelLh2MatchesScalarModel() {
+  // Fixture
+  lighthouseCalibrationModelConstants_t constants;
+  const float t30 = 0.5235987756;
+  lighthouseCalibrationInitModelConstants(&constants, t30, &calib.sweep[1]);
+
+  float actual[N_POSITIONS];
+
+  // Test
+  lighthouseCalibrationMeasurementModelLh2Batch(x, y, z, N_POSITIONS, &constants, &calib.sweep[1], actual);
+
+  // Assert
+  for (int i = 0; i < N_POSITIONS; i++) {
+    const float expected = lighthouseCalibrationMeasurementModelLh2(x[i], y[i], z[i], &constants, &calib.sweep[1]);
+    TEST_ASSERT_FLOAT_WITHIN(maxModelError, expected, actual[i]);
+  }
+}
+
+void testThatBatchCalibrationV1MatchesScalarCalibration() {
+  // Fixture
+  const float rawAngles[N_POSITIONS][2] = {{0.1, -0.2}, {-0.5, 0.3}, {0.8, 0.6}, {-0.05, -0.7}};
+  float actual[N_POSITIONS][2];
+
+  // Test
+  lighthouseCalibrationApplyV1Batch(&calib, rawAngles, actual, N_POSITIONS);
+
+  // Assert
+  for (int i = 0; i < N_POSITIONS; i++) {
+    float expected[2];
+    lighthouseCalibrationApplyV1(&calib, rawAngles[i], expected);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005, expected[0], actual[i][0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005, expected[1], actual[i][1]);
+  }
+}
+
+void testThatBatchCalibrationV2MatchesScalarCalibration() {
+  // Fixture
+  const float rawAngles[N_POSITIONS][2] = {{0.1, 0.3}, {-0.5, -0.2}, {0.8, 1.1}, {-0.3, 0.1}};
+  float actual[N_POSITIONS][2];
+
+  // Test
+  lighthouseCalibrationApplyV2Batch(&calib, rawAngles, actual, N_POSITIONS);
+
+  // Assert
+  for (int i = 0; i < N_POSITIONS; i++) {
+    float expected[2];
+    lighthouseCalibrationApplyV2(&calib, rawAngles[i], expected);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005, expected[0], actual[i][0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005, expected[1], actual[i][1]);
+  }
+}
+
+void testThatBatchOfOneIsCalibrated() {
+  // Fixture
+  const float rawAngles[1][2] = {{0.2, 0.4}};
+  float actual[1][2];
+  float expected[2];
+  lighthouseCalibrationApplyV2(&calib, rawAngles[0], expected);
+
+  // Test
+  lighthouseCalibrationApplyV2Batch(&calib, rawAngles, actual, 1);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.0005, expected[0], actual[0][0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005, expected[1], actual[0][1]);
+}
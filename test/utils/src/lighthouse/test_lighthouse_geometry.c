@@ -98,6 +98,79 @@ void testThatRayIsCalculatedFromNonRotatedBaseStationWithVerticalSweepAngle() {
   TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, actual, vec3d_size);
 }
 
+void testThatPositionIsFoundFromRaysFromThreeBaseStations() {
+  // Fixture
+  const vec3d origins[] = {{2, 0, 1}, {0, 2, 1}, {0, 0, 3}};
+  const vec3d rays[] = {{-1, 0, 0}, {0, -1, 0}, {0, 0, -1}};
+
+  vec3d actual;
+  float actualDelta;
+
+  vec3d expected = {0, 0, 1};
+
+  // Test
+  bool actualFound = lighthouseGeometryGetPositionFromRays(origins, rays, 3, actual, &actualDelta);
+
+  // Assert
+  TEST_ASSERT_TRUE(actualFound);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected[0], actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected[1], actual[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected[2], actual[2]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, actualDelta);
+}
+
+void testThatPositionFromTwoSkewRaysIsInTheMiddle() {
+  // Fixture
+  // The rays pass 0.1 m apart, above and below the point (0, 0, 1)
+  const vec3d origins[] = {{2, 0, 1.05}, {0, 2, 0.95}};
+  const vec3d rays[] = {{-1, 0, 0}, {0, -1, 0}};
+
+  vec3d actual;
+  float actualDelta;
+
+  vec3d expected = {0, 0, 1};
+
+  // Test
+  bool actualFound = lighthouseGeometryGetPositionFromRays(origins, rays, 2, actual, &actualDelta);
+
+  // Assert
+  TEST_ASSERT_TRUE(actualFound);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected[0], actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected[1], actual[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, expected[2], actual[2]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.05, actualDelta);
+}
+
+void testThatNoPositionIsFoundFromParallelRays() {
+  // Fixture
+  const vec3d origins[] = {{2, 0, 1}, {2, 1, 1}};
+  const vec3d rays[] = {{-1, 0, 0}, {-1, 0, 0}};
+
+  vec3d actual;
+  float actualDelta;
+
+  // Test
+  bool actualFound = lighthouseGeometryGetPositionFromRays(origins, rays, 2, actual, &actualDelta);
+
+  // Assert
+  TEST_ASSERT_FALSE(actualFound);
+}
+
+void testThatNoPositionIsFoundFromOneRay() {
+  // Fixture
+  const vec3d origins[] = {{2, 0, 1}};
+  const vec3d rays[] = {{-1, 0, 0}};
+
+  vec3d actual;
+  float actualDelta;
+
+  // Test
+  bool actualFound = lighthouseGeometryGetPositionFromRays(origins, rays, 1, actual, &actualDelta);
+
+  // Assert
+  TEST_ASSERT_FALSE(actualFound);
+}
+
 void testThatIntersectionPointIsFoundForLinePerpendicularToPlane() {
   // Fixture
   vec3d linePoint = {1, 1, 2};
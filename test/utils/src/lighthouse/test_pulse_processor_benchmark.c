@@ -0,0 +1,346 @@
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 199309L
+
+// File under test pulse_processor_v2.c
+#include "pulse_processor_v2.h"
+#include "pulse_processor_v1.h"
+#include "pulse_processor.h"
+#include "ootx_decoder.h"
+#include "lighthouse_calibration.h"
+#include "physicalConstants.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+#include "mock_usec_time.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+// Benchmark and fuzz test of the lighthouse pulse processing. Not part of the normal unit test run, run it with
+//   make unit FILES=test/utils/src/lighthouse/test_pulse_processor_benchmark.c
+// @IGNORE_IF_NOT LIGHTHOUSE_BENCHMARK
+//
+// A frame stream is read from the file in the LIGHTHOUSE_BENCHMARK_FILE environment variable, see
+// tools/usdlog/lighthouse_frames_export.py. Without a file, a synthetic LH2 stream is used.
+//
+// File format, one frame per line, lines starting with # are ignored:
+// type <1|2>
+// <sensor> <timestamp> <width> <offset> <beamData> <channel> <slowbit> <channelFound>
+
+#define TICKS_PER_US 24
+#define TS_MASK 0x00ffffff
+
+#define SYNTHETIC_ROTATIONS 2000
+#define FUZZ_ITERATIONS 200000
+
+// Cycle periods of the LH2 channels, in 24 MHz ticks
+static const uint32_t CYCLE_PERIODS[] = {
+  959000 / 2, 957000 / 2, 953000 / 2, 949000 / 2,
+  947000 / 2, 943000 / 2, 941000 / 2, 939000 / 2,
+  937000 / 2, 929000 / 2, 919000 / 2, 911000 / 2,
+  907000 / 2, 901000 / 2, 893000 / 2, 887000 / 2
+};
+
+static pulseProcessor_t state;
+static pulseProcessorResult_t angles;
+static pulseProcessorProcessPulse_t processPulse;
+
+static uint64_t simulatedUsec;
+static uint32_t latestTimestamp;
+
+static uint32_t frameCount;
+static uint32_t angleCount;
+static uint64_t totalNs;
+static uint64_t worstNs;
+
+static uint32_t randomState;
+static bool isMutatingSyntheticFrames;
+
+static void processFrame(const pulseProcessorFrame_t* frame);
+static void processFile(FILE* file);
+static void processSynthetic();
+static void decodeRawFrame(const uint8_t data[], pulseProcessorFrame_t* frame);
+static uint32_t random32();
+static uint64_t mockUsecTimestamp(int cmock_num_calls);
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+  memset(&angles, 0, sizeof(angles));
+  processPulse = pulseProcessorV2ProcessPulse;
+
+  simulatedUsec = 0;
+  latestTimestamp = 0;
+
+  frameCount = 0;
+  angleCount = 0;
+  totalNs = 0;
+  worstNs = 0;
+
+  randomState = 4711;
+  isMutatingSyntheticFrames = false;
+
+  usecTimestamp_StubWithCallback(mockUsecTimestamp);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testBenchmark() {
+  // Fixture
+  const char* fileName = getenv("LIGHTHOUSE_BENCHMARK_FILE");
+
+  // Test
+  if (fileName) {
+    FILE* file = fopen(fileName, "r");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, "Can not open frame stream file");
+    processFile(file);
+    fclose(file);
+  } else {
+    processSynthetic();
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE_MESSAGE(frameCount > 0, "No frames in the stream");
+  const double seconds = totalNs / 1e9;
+  printf("\nLighthouse pulse processor benchmark of %s\n", fileName ? fileName : "synthetic stream");
+  printf("%u frames, %u angle sets\n", frameCount, angleCount);
+  printf("%.0f frames/s, %.0f angle sets/s, %.0f ns/frame average, %llu ns/frame worst case\n",
+    frameCount / seconds, angleCount / seconds, (double)totalNs / frameCount, (unsigned long long)worstNs);
+
+  TEST_ASSERT_TRUE_MESSAGE(angleCount > 0, "No angles decoded from the stream");
+}
+
+void testFuzzedFramesAreHandled() {
+  // Fixture
+  uint8_t data[12];
+
+  // Test
+  for (int i = 0; i < FUZZ_ITERATIONS; i++) {
+    for (int j = 0; j < (int)sizeof(data); j++) {
+      data[j] = random32();
+    }
+
+    pulseProcessorFrame_t frame;
+    decodeRawFrame(data, &frame);
+
+    int baseStation = -1;
+    int axis = -1;
+    bool calibDataIsDecoded = false;
+    simulatedUsec += random32() % 100;
+    if (processPulse(&state, &frame, &angles, &baseStation, &axis, &calibDataIsDecoded)) {
+      // Assert
+      TEST_ASSERT_TRUE(baseStation >= 0 && baseStation < PULSE_PROCESSOR_N_BASE_STATIONS);
+      TEST_ASSERT_TRUE(axis == sweepIdFirst || axis == sweepIdSecond);
+      pulseProcessorApplyCalibration(&state, &angles, baseStation);
+      pulseProcessorProcessed(&angles, baseStation);
+    }
+  }
+}
+
+void testFuzzedSyntheticStreamIsHandled() {
+  // Fixture
+  // Flip one bit in roughly every tenth frame of the synthetic stream
+  isMutatingSyntheticFrames = true;
+
+  // Test
+  processSynthetic();
+
+  // Assert
+  // No crash is the test, processFrame() checks the base station
+  TEST_ASSERT_TRUE(frameCount > 0);
+}
+
+// Helpers ------------------------------------------------------------------
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t mockUsecTimestamp(int cmock_num_calls) {
+  return simulatedUsec;
+}
+
+// Advance the simulated time with the (wrapping) 24 bit timestamp of the deck
+static void advanceTime(const uint32_t timestamp) {
+  const uint32_t delta = (timestamp - latestTimestamp) & TS_MASK;
+  // Ignore frames arriving slightly out of order
+  if (delta < TS_MASK / 2) {
+    simulatedUsec += delta / TICKS_PER_US;
+    latestTimestamp = timestamp;
+  }
+}
+
+// Mimics the lighthouse core task: process the frame and apply calibration when angles are measured
+static void processFrame(const pulseProcessorFrame_t* frame) {
+  advanceTime(frame->timestamp);
+
+  int baseStation;
+  int axis;
+  bool calibDataIsDecoded;
+
+  const uint64_t start = nowNs();
+  const bool anglesMeasured = processPulse(&state, frame, &angles, &baseStation, &axis, &calibDataIsDecoded);
+  if (anglesMeasured) {
+    TEST_ASSERT_TRUE(baseStation >= 0 && baseStation < PULSE_PROCESSOR_N_BASE_STATIONS);
+    pulseProcessorApplyCalibration(&state, &angles, baseStation);
+    pulseProcessorProcessed(&angles, baseStation);
+  }
+  const uint64_t elapsed = nowNs() - start;
+
+  totalNs += elapsed;
+  if (elapsed > worstNs) {
+    worstNs = elapsed;
+  }
+  frameCount++;
+  if (anglesMeasured) {
+    angleCount++;
+  }
+}
+
+static void processFile(FILE* file) {
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    int type;
+    if (sscanf(line, "type %d", &type) == 1) {
+      processPulse = (type == lighthouseBsTypeV1) ? pulseProcessorV1ProcessPulse : pulseProcessorV2ProcessPulse;
+      continue;
+    }
+
+    unsigned int sensor, timestamp, width, offset, beamData, channel, slowbit, channelFound;
+    const int count = sscanf(line, "%u %u %u %u %u %u %u %u", &sensor, &timestamp, &width, &offset, &beamData, &channel, &slowbit, &channelFound);
+    if (count == 8) {
+      pulseProcessorFrame_t frame = {
+        .sensor = sensor & 0x03,
+        .timestamp = timestamp & TS_MASK,
+        .width = width,
+        .offset = offset,
+        .beamData = beamData,
+        .channel = channel & 0x0f,
+        .slowbit = slowbit & 0x01,
+        .channelFound = channelFound != 0,
+      };
+      processFrame(&frame);
+    }
+  }
+}
+
+// Flips a random bit in the raw data of some of the frames
+static void mutate(pulseProcessorFrame_t* frame) {
+  if (random32() % 10 == 0) {
+    uint8_t data[12];
+    memset(data, 0, sizeof(data));
+    data[0] = (frame->sensor & 0x03) | (frame->slowbit << 2) | ((frame->channel & 0x0f) << 3) | (frame->channelFound ? 0 : 0x80);
+    memcpy(&data[1], &frame->width, 2);
+    const uint32_t offset = frame->offset / 4;
+    memcpy(&data[3], &offset, 3);
+    memcpy(&data[6], &frame->beamData, 3);
+    memcpy(&data[9], &frame->timestamp, 3);
+
+    const uint32_t bit = random32() % (sizeof(data) * 8);
+    data[bit / 8] ^= 1 << (bit % 8);
+    decodeRawFrame(data, frame);
+  }
+}
+
+// Offset for a sweep, relative to the rotor zero position. The first sweep starts at -60 degrees and the second at
+// +60 degrees, the sensors are hit about 50 ticks apart.
+static uint32_t sweepOffset(const uint8_t channel, const int sweep, const float azimuth, const int sensorIndex) {
+  const float sweepAngle = (sweep == sweepIdFirst) ? -M_PI_F / 3.0f : M_PI_F / 3.0f;
+  const float angle = azimuth + sweepAngle + sensorIndex * 0.0007f;
+  return (uint32_t)((angle + M_PI_F) * CYCLE_PERIODS[channel] / (2.0f * M_PI_F));
+}
+
+static void emitSweep(const uint8_t channel, const int sweep, const uint32_t timestamp0, const float azimuth) {
+  const uint8_t sensorOrder[PULSE_PROCESSOR_N_SENSORS] = {3, 1, 0, 2};
+  const int sensorWithOffset = random32() % PULSE_PROCESSOR_N_SENSORS;
+
+  for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
+    const uint32_t offset = sweepOffset(channel, sweep, azimuth, i);
+
+    pulseProcessorFrame_t frame = {
+      .sensor = sensorOrder[i],
+      .timestamp = (timestamp0 + offset) & TS_MASK,
+      .offset = (i == sensorWithOffset) ? offset : 0,
+      .beamData = random32() & 0x1ffff,
+      .channel = channel,
+      .slowbit = 0,
+      .channelFound = true,
+    };
+    if (isMutatingSyntheticFrames) {
+      mutate(&frame);
+    }
+    processFrame(&frame);
+  }
+}
+
+// All base stations on consecutive channels, each rotor sweeping the sensors twice per rotation. The sweeps of all
+// base stations are merged in time order.
+static void processSynthetic() {
+  uint64_t timestamp0[PULSE_PROCESSOR_N_BASE_STATIONS];
+  int sweep[PULSE_PROCESSOR_N_BASE_STATIONS];
+  for (int bs = 0; bs < PULSE_PROCESSOR_N_BASE_STATIONS; bs++) {
+    timestamp0[bs] = bs * 37000;
+    sweep[bs] = sweepIdFirst;
+  }
+
+  const uint64_t end = (uint64_t)SYNTHETIC_ROTATIONS * CYCLE_PERIODS[0];
+  while (true) {
+    // Find the sweep that comes next in time
+    int bs = -1;
+    uint64_t sweepStart = 0;
+    for (int i = 0; i < PULSE_PROCESSOR_N_BASE_STATIONS; i++) {
+      const float azimuth = 0.1f * i;
+      const uint64_t start = timestamp0[i] + sweepOffset(i, sweep[i], azimuth, 0);
+      if (bs < 0 || start < sweepStart) {
+        bs = i;
+        sweepStart = start;
+      }
+    }
+
+    if (sweepStart > end) {
+      break;
+    }
+
+    emitSweep(bs, sweep[bs], timestamp0[bs] & TS_MASK, 0.1f * bs);
+
+    if (sweep[bs] == sweepIdFirst) {
+      sweep[bs] = sweepIdSecond;
+    } else {
+      sweep[bs] = sweepIdFirst;
+      timestamp0[bs] += CYCLE_PERIODS[bs];
+    }
+  }
+}
+
+// Same bit layout as the UART frames from the lighthouse deck
+static void decodeRawFrame(const uint8_t data[], pulseProcessorFrame_t* frame) {
+  memset(frame, 0, sizeof(*frame));
+  frame->sensor = data[0] & 0x03;
+  frame->channelFound = (data[0] & 0x80) == 0;
+  frame->channel = (data[0] >> 3) & 0x0f;
+  frame->slowbit = (data[0] >> 2) & 0x01;
+  memcpy(&frame->width, &data[1], 2);
+  memcpy(&frame->offset, &data[3], 3);
+  memcpy(&frame->beamData, &data[6], 3);
+  memcpy(&frame->timestamp, &data[9], 3);
+  frame->offset *= 4;
+}
+
+static uint32_t random32() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
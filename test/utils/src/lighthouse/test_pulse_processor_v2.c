@@ -15,7 +15,7 @@
 void clearWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace);
 bool storePulse(const pulseProcessorFrame_t* frameData, pulseProcessorV2PulseWorkspace_t* pulseWorkspace);
 void augmentFramesInWorkspace(pulseProcessorV2PulseWorkspace_t* pulseWorkspace);
-bool processWorkspaceBlock(const pulseProcessorFrame_t slots[], pulseProcessorV2SweepBlock_t* block);
+bool processWorkspaceBlock(const pulseProcessorV2PulseWorkspace_t* pulseWorkspace, const int blockIndex, pulseProcessorV2SweepBlock_t* block);
 bool isBlockPairGood(const pulseProcessorV2SweepBlock_t* latest, const pulseProcessorV2SweepBlock_t* storage);
 bool handleCalibrationData(pulseProcessor_t *state, const pulseProcessorFrame_t* frameData);
 
@@ -25,12 +25,15 @@ static void setChannel(uint8_t channel);
 static void setOffsetBase(uint32_t ts_base);
 static void setUpOkBlocks(pulseProcessorV2SweepBlock_t* newBlock, pulseProcessorV2SweepBlock_t* storageBlock);
 static void addFrameToWs(uint8_t sensor, uint32_t timestamp, uint32_t offset, bool channelFound, uint8_t channel);
+static void storeFrames();
+static void setFrame(pulseProcessorFrame_t* frame, uint8_t sensor, uint32_t timestamp, uint32_t offset, bool channelFound, uint8_t channel);
 static void setUpOotxDecoderProcessBitCallCounter();
 static void setUpSlowbitFrame();
 static void clearSlowbitState();
 
 static pulseProcessor_t state;
 static pulseProcessorV2PulseWorkspace_t ws;
+static pulseProcessorFrame_t frames[PULSE_PROCESSOR_N_SENSORS];
 static pulseProcessorV2SweepBlock_t block;
 
 static pulseProcessorFrame_t slowbitFrame;
@@ -89,7 +92,7 @@ void testThatAPulseIsStoredInTheWorkspace() {
     // Assert
     TEST_ASSERT_TRUE(actual);
     TEST_ASSERT_EQUAL_INT(1, ws.slotsUsed);
-    TEST_ASSERT_EQUAL_UINT8(expected, ws.slots[0].channel);
+    TEST_ASSERT_EQUAL_UINT8(expected, ws.channel[0]);
 }
 
 void testThatAPulseIsRejectedWhenWorkspaceIsFull() {
@@ -110,6 +113,31 @@ void testThatAPulseIsRejectedWhenWorkspaceIsFull() {
     TEST_ASSERT_FALSE(actual);
 }
 
+void testThatChannelsAndOffsetsAreTrackedInTheWorkspace() {
+    // Fixture
+    clearWorkspace(&ws);
+
+    // Test
+    addFrameToWs(0, A_TS, NO_OFFSET, true, 1);
+    addFrameToWs(1, A_TS, AN_OFFSET, false, 0);
+    addFrameToWs(2, A_TS, AN_OFFSET, true, 1);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT16(0x05, ws.channelFoundMask);
+    TEST_ASSERT_EQUAL_UINT16(0x06, ws.offsetMask);
+}
+
+void testThatWorkspaceMasksAreCleared() {
+    // Fixture
+
+    // Test
+    clearWorkspace(&ws);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT16(0, ws.channelFoundMask);
+    TEST_ASSERT_EQUAL_UINT16(0, ws.offsetMask);
+}
+
 void testThatCleanFramesAreAugmented() {
     // Fixture
     uint8_t expectedChan1 = 2;
@@ -131,11 +159,11 @@ void testThatCleanFramesAreAugmented() {
     augmentFramesInWorkspace(&ws);
 
     // Assert
-    TEST_ASSERT_EQUAL_UINT8(expectedChan1, ws.slots[0].channel);
-    TEST_ASSERT_TRUE(ws.slots[0].channelFound);
+    TEST_ASSERT_EQUAL_UINT8(expectedChan1, ws.channel[0]);
+    TEST_ASSERT_TRUE(ws.channelFoundMask & (1 << 0));
 
-    TEST_ASSERT_EQUAL_UINT8(expectedChan2, ws.slots[4].channel);
-    TEST_ASSERT_TRUE(ws.slots[4].channelFound);
+    TEST_ASSERT_EQUAL_UINT8(expectedChan2, ws.channel[4]);
+    TEST_ASSERT_TRUE(ws.channelFoundMask & (1 << 4));
 }
 
 void testThatUnCleanFramesAreAugmented() {
@@ -159,18 +187,19 @@ void testThatUnCleanFramesAreAugmented() {
     augmentFramesInWorkspace(&ws);
 
     // Assert
-    TEST_ASSERT_EQUAL_UINT8(expectedChan1, ws.slots[1].channel);
-    TEST_ASSERT_FALSE(ws.slots[3].channelFound);
-    TEST_ASSERT_EQUAL_UINT8(expectedChan2, ws.slots[4].channel);
-    TEST_ASSERT_FALSE(ws.slots[7].channelFound);
+    TEST_ASSERT_EQUAL_UINT8(expectedChan1, ws.channel[1]);
+    TEST_ASSERT_FALSE(ws.channelFoundMask & (1 << 3));
+    TEST_ASSERT_EQUAL_UINT8(expectedChan2, ws.channel[4]);
+    TEST_ASSERT_FALSE(ws.channelFoundMask & (1 << 7));
 }
 
 void testThatProcessBlockRejectsMissingSensors() {
     // Fixture
-    ws.slots[2].sensor = SWEEP_SENS_0;
+    frames[2].sensor = SWEEP_SENS_0;
+    storeFrames();
 
     // Test
-    bool actual = processWorkspaceBlock(&ws.slots[0], &block);
+    bool actual = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_FALSE(actual);
@@ -180,9 +209,10 @@ void testThatProcessBlockFindsChannel() {
     // Fixture
     uint8_t expected = 3;
     setChannel(expected);
+    storeFrames();
 
     // Test
-    bool ok = processWorkspaceBlock(&ws.slots[0], &block);
+    bool ok = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     uint8_t actual = block.channel;
@@ -194,11 +224,12 @@ void testThatProcessBlockFindsChannelWhenSomeChannelsAreMissing() {
     // Fixture
     uint8_t expected = 3;
     setChannel(expected);
-    ws.slots[2].channelFound = false;
-    ws.slots[3].channelFound = false;
+    frames[2].channelFound = false;
+    frames[3].channelFound = false;
+    storeFrames();
 
     // Test
-    bool ok = processWorkspaceBlock(&ws.slots[0], &block);
+    bool ok = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     uint8_t actual = block.channel;
@@ -208,13 +239,14 @@ void testThatProcessBlockFindsChannelWhenSomeChannelsAreMissing() {
 
 void testThatProcessBlockRejectsAllChannelsMissing() {
     // Fixture
-    ws.slots[0].channelFound = false;
-    ws.slots[1].channelFound = false;
-    ws.slots[2].channelFound = false;
-    ws.slots[3].channelFound = false;
+    frames[0].channelFound = false;
+    frames[1].channelFound = false;
+    frames[2].channelFound = false;
+    frames[3].channelFound = false;
+    storeFrames();
 
     // Test
-    bool actual = processWorkspaceBlock(&ws.slots[0], &block);
+    bool actual = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_FALSE(actual);
@@ -225,10 +257,11 @@ void testThatProcessBlockRejectsMultipleChannels() {
     uint8_t channel = 3;
 
     setChannel(channel);
-    ws.slots[0].channel = channel + 1;
+    frames[0].channel = channel + 1;
+    storeFrames();
 
     // Test
-    bool actual = processWorkspaceBlock(&ws.slots[0], &block);
+    bool actual = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_FALSE(actual);
@@ -236,10 +269,11 @@ void testThatProcessBlockRejectsMultipleChannels() {
 
 void testThatProcessBlockRejectsMisissingOffset() {
     // Fixture
-    ws.slots[1].offset = NO_OFFSET;
+    frames[1].offset = NO_OFFSET;
+    storeFrames();
 
     // Test
-    bool actual = processWorkspaceBlock(&ws.slots[0], &block);
+    bool actual = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_FALSE(actual);
@@ -247,10 +281,11 @@ void testThatProcessBlockRejectsMisissingOffset() {
 
 void testThatProcessBlockRejectsMultipleOffsets() {
     // Fixture
-    ws.slots[0].offset = OFFSET_BASE;
+    frames[0].offset = OFFSET_BASE;
+    storeFrames();
 
     // Test
-    bool actual = processWorkspaceBlock(&ws.slots[0], &block);
+    bool actual = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_FALSE(actual);
@@ -259,9 +294,10 @@ void testThatProcessBlockRejectsMultipleOffsets() {
 void testThatProcessBlockSetsOffsets() {
     // Fixture
     setOffsetBase(TIMESTAMP_BASE);
+    storeFrames();
 
     // Test
-    bool ok = processWorkspaceBlock(&ws.slots[0], &block);
+    bool ok = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_EQUAL_UINT32(OFFSET_BASE + TIMESTAMP_STEP, block.offset[SWEEP_SENS_0]);
@@ -275,9 +311,10 @@ void testThatProcessBlockSetsOffsets() {
 void testThatProcessBlockSetsOffsetsWhenTimeStampWraps() {
     // Fixture
     setOffsetBase(0x00ffff00);
+    storeFrames();
 
     // Test
-    bool ok = processWorkspaceBlock(&ws.slots[0], &block);
+    bool ok = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     TEST_ASSERT_EQUAL_UINT32(OFFSET_BASE + TIMESTAMP_STEP, block.offset[SWEEP_SENS_0]);
@@ -293,9 +330,10 @@ void testThatProcessBlockSetsTimestampToStartOfRotation() {
     // Fixture
     setOffsetBase(TIMESTAMP_BASE);
     uint32_t expected = TIMESTAMP_BASE - OFFSET_BASE;
+    storeFrames();
 
     // Test
-    bool ok = processWorkspaceBlock(&ws.slots[0], &block);
+    bool ok = processWorkspaceBlock(&ws, 0, &block);
 
     // Assert
     uint32_t actual = block.timestamp0;
@@ -303,6 +341,28 @@ void testThatProcessBlockSetsTimestampToStartOfRotation() {
     TEST_ASSERT_TRUE(ok);
 }
 
+void testThatProcessBlockUsesTheSlotsOfTheBlock() {
+    // Fixture
+    uint8_t expected = 5;
+    clearWorkspace(&ws);
+    addFrameToWs(SWEEP_SENS_0, TIMESTAMP_STEP * 0, NO_OFFSET, true, 3);
+    addFrameToWs(SWEEP_SENS_0, TIMESTAMP_STEP * 1, NO_OFFSET, true, 3);
+    addFrameToWs(SWEEP_SENS_0, TIMESTAMP_STEP * 2, NO_OFFSET, true, 3);
+    addFrameToWs(SWEEP_SENS_0, TIMESTAMP_STEP * 3, NO_OFFSET, true, 3);
+    for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
+        frames[i].channel = expected;
+        storePulse(&frames[i], &ws);
+    }
+
+    // Test
+    bool ok = processWorkspaceBlock(&ws, 1, &block);
+
+    // Assert
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL_UINT8(expected, block.channel);
+    TEST_ASSERT_EQUAL_UINT32(OFFSET_BASE, block.offset[SWEEP_SENS_1]);
+}
+
 void testThatProcessBlockPairAcceptBlocks() {
     // Fixture
     pulseProcessorV2SweepBlock_t newBlock;
@@ -489,42 +549,54 @@ void testThatNonFullSlowbitMessageIsNotReported() {
 
 static void addFrameToWs(uint8_t sensor, uint32_t timestamp, uint32_t offset, bool channelFound, uint8_t channel) {
     pulseProcessorFrame_t frame;
-
-    frame.sensor = sensor;
-    frame.timestamp = timestamp;
-    frame.offset = offset;
-    frame.channelFound = channelFound;
-    frame.channel = channel;
-
+    setFrame(&frame, sensor, timestamp, offset, channelFound, channel);
     storePulse(&frame, &ws);
 }
 
+static void setFrame(pulseProcessorFrame_t* frame, uint8_t sensor, uint32_t timestamp, uint32_t offset, bool channelFound, uint8_t channel) {
+    memset(frame, 0, sizeof(pulseProcessorFrame_t));
+    frame->sensor = sensor;
+    frame->timestamp = timestamp;
+    frame->offset = offset;
+    frame->channelFound = channelFound;
+    frame->channel = channel;
+}
+
 static void addDefaultFrames() {
-    addFrameToWs(SWEEP_SENS_0, TIMESTAMP_STEP * 0, NO_OFFSET, true, 3);
-    addFrameToWs(SWEEP_SENS_1, TIMESTAMP_STEP * 1, OFFSET_BASE, true, 3);
-    addFrameToWs(SWEEP_SENS_2, TIMESTAMP_STEP * 2, NO_OFFSET, true, 3);
-    addFrameToWs(SWEEP_SENS_3, TIMESTAMP_STEP * 3, NO_OFFSET, true, 3);
+    setFrame(&frames[0], SWEEP_SENS_0, TIMESTAMP_STEP * 0, NO_OFFSET, true, 3);
+    setFrame(&frames[1], SWEEP_SENS_1, TIMESTAMP_STEP * 1, OFFSET_BASE, true, 3);
+    setFrame(&frames[2], SWEEP_SENS_2, TIMESTAMP_STEP * 2, NO_OFFSET, true, 3);
+    setFrame(&frames[3], SWEEP_SENS_3, TIMESTAMP_STEP * 3, NO_OFFSET, true, 3);
+    storeFrames();
+}
+
+// Store the (possibly modified) default frames in an empty workspace
+static void storeFrames() {
+    clearWorkspace(&ws);
+    for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
+        storePulse(&frames[i], &ws);
+    }
 }
 
 static void setChannel(uint8_t channel) {
     for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
-        ws.slots[i].channel = channel;
-        ws.slots[i].channelFound = true;
+        frames[i].channel = channel;
+        frames[i].channelFound = true;
     }
 }
 
 static void setOffsetBase(uint32_t ts_base) {
-    ws.slots[0].timestamp = ts_base + TIMESTAMP_STEP * 1;
-    ws.slots[0].offset = NO_OFFSET;
+    frames[0].timestamp = ts_base + TIMESTAMP_STEP * 1;
+    frames[0].offset = NO_OFFSET;
 
-    ws.slots[1].timestamp = ts_base;
-    ws.slots[1].offset = OFFSET_BASE;
+    frames[1].timestamp = ts_base;
+    frames[1].offset = OFFSET_BASE;
 
-    ws.slots[2].timestamp = ts_base - TIMESTAMP_STEP * 1;
-    ws.slots[2].offset = NO_OFFSET;
+    frames[2].timestamp = ts_base - TIMESTAMP_STEP * 1;
+    frames[2].offset = NO_OFFSET;
 
-    ws.slots[3].timestamp = ts_base + TIMESTAMP_STEP * 2;
-    ws.slots[3].offset = NO_OFFSET;
+    frames[3].timestamp = ts_base + TIMESTAMP_STEP * 2;
+    frames[3].offset = NO_OFFSET;
 }
 
 static void setUpOkBlocks(pulseProcessorV2SweepBlock_t* newBlock, pulseProcessorV2SweepBlock_t* storageBlock) {
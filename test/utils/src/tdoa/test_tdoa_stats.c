@@ -0,0 +1,120 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2018 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * TestTdoaStats.c - Unit tests for tdoa statistics
+ */
+
+// File under test
+#include "tdoaStats.h"
+
+#include "unity.h"
+
+#include <string.h>
+#include "statsCnt.h"
+
+
+static tdoaStats_t stats;
+
+void setUp(void) {
+  tdoaStatsInit(&stats, 0);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatTheSameAnchorStatsIsReturnedForAnAnchor() {
+  // Fixture
+  tdoaAnchorStats_t* expected = tdoaStatsGetAnchorStats(&stats, 17, 100);
+
+  // Test
+  tdoaAnchorStats_t* actual = tdoaStatsGetAnchorStats(&stats, 17, 200);
+
+  // Assert
+  TEST_ASSERT_EQUAL_PTR(expected, actual);
+  TEST_ASSERT_EQUAL_UINT8(17, actual->id);
+}
+
+void testThatTheLeastRecentlySeenAnchorIsReplacedWhenFull() {
+  // Fixture
+  for (int i = 0; i < TDOA_STATS_ANCHOR_COUNT; i++) {
+    tdoaAnchorStats_t* anchorStats = tdoaStatsGetAnchorStats(&stats, i, 100);
+    tdoaStatsAnchorPacketReceived(anchorStats, 100 + i);
+  }
+
+  tdoaAnchorStats_t* expected = tdoaStatsGetAnchorStats(&stats, 0, 200);
+
+  // Test
+  tdoaAnchorStats_t* actual = tdoaStatsGetAnchorStats(&stats, 100, 200);
+
+  // Assert
+  TEST_ASSERT_EQUAL_PTR(expected, actual);
+  TEST_ASSERT_EQUAL_UINT8(100, actual->id);
+}
+
+void testThatAnchorStatsArePackedForLogging() {
+  // Fixture
+  tdoaAnchorStats_t* anchorStats = tdoaStatsGetAnchorStats(&stats, 7, 0);
+  for (int i = 0; i < 50; i++) {
+    tdoaStatsAnchorPacketReceived(anchorStats, 300);
+  }
+  for (int i = 0; i < 25; i++) {
+    tdoaStatsAnchorTdoaFound(anchorStats);
+  }
+  anchorStats->rxJitter_ns = 1234.0f;
+  anchorStats->clockCorrectionChange = 0.0000000565f;
+
+  // Test
+  tdoaStatsUpdate(&stats, 501);
+
+  // Assert
+  // 50 packets in 501 ms is 99.8 packets/s, the last packet was received 201 ms ago
+  const uint32_t expectedA = 7 | (99 << 8) | (50 << 16) | (2 << 24);
+  const uint32_t expectedB = 1234 | (56 << 16);
+  TEST_ASSERT_EQUAL_UINT32(expectedA, stats.anchorLogA[0]);
+  TEST_ASSERT_EQUAL_UINT32(expectedB, stats.anchorLogB[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.anchorLogA[1]);
+}
+
+void testThatClockCorrectionChangeIsFiltered() {
+  // Fixture
+  tdoaAnchorStats_t* anchorStats = tdoaStatsGetAnchorStats(&stats, 7, 0);
+  tdoaStatsAnchorClockCorrection(anchorStats, CLOCK_CORRECTION_ONE);
+
+  // Test
+  tdoaStatsAnchorClockCorrection(anchorStats, CLOCK_CORRECTION_ONE + CLOCK_CORRECTION_ONE / 1000);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.0000001f, 0.05f * 0.001f, anchorStats->clockCorrectionChange);
+}
+
+void testThatRxJitterIsFilteredOnTheAbsoluteResidual() {
+  // Fixture
+  tdoaAnchorStats_t* anchorStats = tdoaStatsGetAnchorStats(&stats, 7, 0);
+
+  // Test
+  tdoaStatsAnchorRxResidual(anchorStats, -100.0f);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 5.0f, anchorStats->rxJitter_ns);
+}
@@ -38,12 +38,12 @@
 #define ANCHOR_POSITION_VALIDITY_PERIOD (2 * 1000)
 
 
-static tdaoAnchorInfoArray_t storage;
+static tdoaAnchorStorage_t storage;
 static void fixtureSetRemoteRxTime(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t remoteRxTime, const uint8_t seqNr);
 static void fixtureSetTof(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t tof);
 
 void setUp(void) {
-  tdoaStorageInitialize(storage);
+  tdoaStorageInitialize(&storage);
 }
 
 void testThatCurrentTimeIsSetInContextForGet() {
@@ -53,7 +53,7 @@ void testThatCurrentTimeIsSetInContextForGet() {
 
   // Test
   tdoaAnchorContext_t result;
-  tdoaStorageGetAnchorCtx(storage, anchor, expectedTime, &result);
+  tdoaStorageGetAnchorCtx(&storage, anchor, expectedTime, &result);
 
   // Assert
   TEST_ASSERT_EQUAL_UINT8(expectedTime, result.currentTime_ms);
@@ -67,7 +67,7 @@ void testThatCurrentTimeIsSetInContextForGetCreate() {
 
   // Test
   tdoaAnchorContext_t result;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, expectedTime, &result);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, expectedTime, &result);
 
   // Assert
   TEST_ASSERT_EQUAL_UINT8(expectedTime, result.currentTime_ms);
@@ -81,7 +81,7 @@ void testThatNoAnchorIsReturnedWhenItDoesNotExistInStorage() {
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did not exist
@@ -97,7 +97,7 @@ void testThatANewAnchorContextIsReturnedWhenItDoesNotExistInStorage() {
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did not exist
@@ -113,11 +113,11 @@ void testThatTheSameAnchorContextIsReturnedWhenItAlreadyExistsInStorageForGet()
 
   // Make sure the anchor exists
   tdoaAnchorContext_t firstContext;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &firstContext);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &firstContext);
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did exist
@@ -133,11 +133,11 @@ void testThatTheSameAnchorContextIsReturnedWhenItAlreadyExistsInStorageForGetCre
 
   // Make sure the anchor exists
   tdoaAnchorContext_t firstContext;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &firstContext);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &firstContext);
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did exist
@@ -160,7 +160,7 @@ void testThatTheOldestAnchorContextIsReplacedWhenStorageIsFull() {
   // time for one slot to be oldest
   tdoaAnchorContext_t context;
   for (int id = 0; id < ANCHOR_STORAGE_COUNT; id++) {
-    tdoaStorageGetCreateAnchorCtx(storage, id, currentTime, &context);
+    tdoaStorageGetCreateAnchorCtx(&storage, id, currentTime, &context);
 
     uint32_t updateTime = baseAnchorTime + id;
     if (id == oldestAnchor) {
@@ -173,12 +173,12 @@ void testThatTheOldestAnchorContextIsReplacedWhenStorageIsFull() {
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetCreateAnchorCtx(storage, newAnchor, currentTime, &result);
+  bool actual = tdoaStorageGetCreateAnchorCtx(&storage, newAnchor, currentTime, &result);
 
   // Assert
   TEST_ASSERT_FALSE(actual);
-  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(storage, newAnchor));
-  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(storage, oldestAnchor));
+  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(&storage, newAnchor));
+  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(&storage, oldestAnchor));
 }
 
 
@@ -193,14 +193,14 @@ void testThatAListOfAnchorIdsIsReturned() {
 
   uint8_t expectedCount = 3;
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId1, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId2, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId1, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId2, currentTime, &context);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(storage, unorderedAnchorList, 10);
+  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(&storage, unorderedAnchorList, 10);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -220,14 +220,14 @@ void testThatAListOfAnchorIdsIsReturnedButNotMoreThanTheListLength() {
 
   uint8_t expectedCount = 2;
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId1, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId2, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId1, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId2, currentTime, &context);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(storage, unorderedAnchorList, expectedCount);
+  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(&storage, unorderedAnchorList, expectedCount);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -251,19 +251,19 @@ void testThatAListOfActiveAnchorIdsIsReturned() {
 
   uint8_t expectedCount = 2;
 
-  tdoaStorageGetCreateAnchorCtx(storage, otherId, oldTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, otherId, oldTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, recentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, recentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId1, recentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId1, recentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(storage, unorderedAnchorList, 10, currentTime);
+  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(&storage, unorderedAnchorList, 10, currentTime);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -283,16 +283,16 @@ void testThatAListOfActiveAnchorIdsIsReturnedButNotMoreThanTheListLength() {
 
   uint8_t expectedCount = 1;
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, currentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
-  tdoaStorageGetCreateAnchorCtx(storage, otherId, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, otherId, currentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(storage, unorderedAnchorList, expectedCount, currentTime);
+  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(&storage, unorderedAnchorList, expectedCount, currentTime);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -308,12 +308,12 @@ void testThatAnchorPositionIsSetAndGet() {
   uint32_t expectedTime = 1234;
 
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, expectedTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, expectedTime, &context);
 
   tdoaStorageSetAnchorPosition(&context, expectedX, expectedY, expectedZ);
 
   uint32_t now = 2345;
-  tdoaStorageGetAnchorCtx(storage, 0, now, &context);
+  tdoaStorageGetAnchorCtx(&storage, 0, now, &context);
   point_t actual;
 
   // Test
@@ -336,7 +336,7 @@ void testThatAnchorPositionIsNotReturnedWhenTooOld() {
   uint32_t now = 1234;
 
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, now, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, now, &context);
 
   tdoaStorageSetAnchorPosition(&context, x, y, z);
 
@@ -359,7 +359,7 @@ void testThatRxTxDataIsSet() {
   uint8_t expectedSeqNr = 17;
 
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, expectedUpdateTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, expectedUpdateTime, &context);
 
   // Test
   tdoaStorageSetRxTxData(&context, expectedRxTime, expectedTxTime, expectedSeqNr);
@@ -375,24 +375,24 @@ void testThatRxTxDataIsSet() {
 void testThatClockCorrectionIsReturned() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
-  double expected = 123.456;
+  clockCorrection_t expected = CLOCK_CORRECTION_ONE + 123456;
   clockCorrectionStorage_t* clockCorrectionStorage = tdoaStorageGetClockCorrectionStorage(&context);
-  clockCorrectionEngineGet_ExpectAndReturn(clockCorrectionStorage, expected);
+  clockCorrectionEngineGetFixed_ExpectAndReturn(clockCorrectionStorage, expected);
 
   // Test
-  double actual = tdoaStorageGetClockCorrection(&context);
+  clockCorrection_t actual = tdoaStorageGetClockCorrection(&context);
 
   // Assert
-  TEST_ASSERT_EQUAL_DOUBLE(expected, actual);
+  TEST_ASSERT_EQUAL_INT64(expected, actual);
 }
 
 
 void testThatRemoteRxTimeIsReturned() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t seqNr = 13;
   const uint8_t remoteAnchor = 17;
@@ -419,7 +419,7 @@ void testThatRemoteRxTimeIsNotReturnedWhenOutdated() {
   const uint8_t remoteAnchor = 17;
   fixtureSetRemoteRxTime(&context, anchor, storageTime, remoteAnchor, 4711, seqNr);
 
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, expiryTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, expiryTime, &context);
   const int64_t expectedRemoteRxTime = 0;
 
   // Test
@@ -433,7 +433,7 @@ void testThatRemoteRxTimeIsNotReturnedWhenOutdated() {
 void testThatRemoteRxTimeIsNotReturnedForUnknownRemoteAnchor() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
   const uint8_t unkownRemoteAnchor = 17;
   const int64_t expectedRemoteRxTime = 0;
 
@@ -448,7 +448,7 @@ void testThatRemoteRxTimeIsNotReturnedForUnknownRemoteAnchor() {
 void testThatRemoteRxTimeIsOverwrittenWhenSetWithTheSameRemoteId() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t seqNr = 13;
   const uint8_t remoteAnchor = 17;
@@ -510,7 +510,7 @@ void testThatRemoteRxTimeReplacesTheOldestEntryWhenStorageIsFull() {
 void testThatRemoteRxTimeAndSequenceNumberIsReturned() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t remoteAnchor = 17;
   const uint8_t expectedRemoteSeqNr = 13;
@@ -531,7 +531,7 @@ void testThatRemoteRxTimeAndSequenceNumberIsReturned() {
 void testThatRemoteRxTimeAndSequenceNumberIsNotReturnedWhenNotInList() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t remoteAnchor = 17;
 
@@ -568,7 +568,7 @@ void testThatAListOfSequenceNumbersAndIdsOfRemoteAnchorsIsReturned() {
   fixtureSetRemoteRxTime(&context, anchor, activeStorageTime, activeRemoteAnchor1, someRemoteRxTime, activeSeqNr1);
 
   const uint32_t currentTime = oldStorageTime + REMOTE_DATA_VALIDITY_PERIOD;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &context);
 
   int actualRemoteCount;
   uint8_t actualSequenceNumbers[REMOTE_ANCHOR_DATA_COUNT];
@@ -580,11 +580,15 @@ void testThatAListOfSequenceNumbersAndIdsOfRemoteAnchorsIsReturned() {
   // Assert
   TEST_ASSERT_EQUAL_INT32(2, actualRemoteCount);
 
-  TEST_ASSERT_EQUAL_INT8(actualIds[0], activeRemoteAnchor0);
-  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[0], activeSeqNr0);
+  // The list is ordered by position in the hash table
+  const int index0 = (actualIds[0] == activeRemoteAnchor0) ? 0 : 1;
+  const int index1 = 1 - index0;
+
+  TEST_ASSERT_EQUAL_INT8(actualIds[index0], activeRemoteAnchor0);
+  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[index0], activeSeqNr0);
 
-  TEST_ASSERT_EQUAL_INT8(actualIds[1], activeRemoteAnchor1);
-  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[1], activeSeqNr1);
+  TEST_ASSERT_EQUAL_INT8(actualIds[index1], activeRemoteAnchor1);
+  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[index1], activeSeqNr1);
 }
 
 
@@ -596,7 +600,7 @@ void testThatNoTimeOfFlightIsReturnedWhenRemoteAnchorIsNotInStorage() {
   const uint8_t remoteAnchor = 17;
   const uint64_t expected = 0;
 
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, storageTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, storageTime, &context);
 
   // Test
   int64_t actual = tdoaStorageGetTimeOfFlight(&context, remoteAnchor);
@@ -683,14 +687,166 @@ void testThatTofReplacesTheOldestEntryWhenStorageIsFull() {
 }
 
 
+void testThatAnchorsWithIdsAboveTheStorageCountAreFound() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  const uint32_t currentTime = 1234;
+  const uint8_t anchors[] = {200, 3, 255, 42};
+
+  for (int i = 0; i < 4; i++) {
+    tdoaStorageGetCreateAnchorCtx(&storage, anchors[i], currentTime, &context);
+  }
+
+  // Test
+  // Assert
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(tdoaStorageGetAnchorCtx(&storage, anchors[i], currentTime, &context));
+    TEST_ASSERT_EQUAL_UINT8(anchors[i], tdoaStorageGetId(&context));
+  }
+  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(&storage, 0));
+}
+
+void testThatAReplacedAnchorIsNotFound() {
+  // Fixture
+  const uint32_t currentTime = 2000;
+  tdoaAnchorContext_t context;
+  for (int id = 0; id < ANCHOR_STORAGE_COUNT; id++) {
+    tdoaStorageGetCreateAnchorCtx(&storage, id, currentTime, &context);
+    context.currentTime_ms = 1000 + id;
+    tdoaStorageSetRxTxData(&context, 0, 0, 0);
+  }
+
+  const uint8_t newAnchor = 100;
+  const uint8_t oldestAnchor = 0;
+
+  // Test
+  tdoaStorageGetCreateAnchorCtx(&storage, newAnchor, currentTime, &context);
+
+  // Assert
+  TEST_ASSERT_FALSE(tdoaStorageGetAnchorCtx(&storage, oldestAnchor, currentTime, &context));
+  TEST_ASSERT_TRUE(tdoaStorageGetAnchorCtx(&storage, newAnchor, currentTime, &context));
+  TEST_ASSERT_EQUAL_UINT8(newAnchor, tdoaStorageGetId(&context));
+}
+
+void testThatRemoteRxTimesForRemoteAnchorsWithTheSameHashAreStoredSeparately() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  const uint8_t anchor = 5;
+  const uint32_t storageTime = 1117;
+  const uint8_t remoteAnchor0 = 1;
+  const uint8_t remoteAnchor1 = remoteAnchor0 + REMOTE_ANCHOR_DATA_COUNT;
+  const uint8_t remoteAnchor2 = remoteAnchor0 + 2 * REMOTE_ANCHOR_DATA_COUNT;
+
+  fixtureSetRemoteRxTime(&context, anchor, storageTime, remoteAnchor0, 100, 1);
+  fixtureSetRemoteRxTime(&context, anchor, storageTime, remoteAnchor1, 200, 2);
+  fixtureSetRemoteRxTime(&context, anchor, storageTime, remoteAnchor2, 300, 3);
+
+  // Test
+  fixtureSetRemoteRxTime(&context, anchor, storageTime, remoteAnchor1, 250, 4);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT64(100, tdoaStorageGetRemoteRxTime(&context, remoteAnchor0));
+  TEST_ASSERT_EQUAL_INT64(250, tdoaStorageGetRemoteRxTime(&context, remoteAnchor1));
+  TEST_ASSERT_EQUAL_INT64(300, tdoaStorageGetRemoteRxTime(&context, remoteAnchor2));
+
+  int actualRemoteCount;
+  uint8_t actualSequenceNumbers[REMOTE_ANCHOR_DATA_COUNT];
+  uint8_t actualIds[REMOTE_ANCHOR_DATA_COUNT];
+  tdoaStorageGetRemoteSeqNrList(&context, &actualRemoteCount, actualSequenceNumbers, actualIds);
+  TEST_ASSERT_EQUAL_INT32(3, actualRemoteCount);
+}
+
+void testThatTofForRemoteAnchorsWithTheSameHashAreStoredSeparately() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  const uint8_t anchor = 5;
+  const uint32_t storageTime = 1117;
+  const uint8_t remoteAnchor0 = 7;
+  const uint8_t remoteAnchor1 = remoteAnchor0 + TOF_PER_ANCHOR_COUNT;
+
+  fixtureSetTof(&context, anchor, storageTime, remoteAnchor0, 100);
+  fixtureSetTof(&context, anchor, storageTime, remoteAnchor1, 200);
+
+  // Test
+  const int64_t actual0 = tdoaStorageGetTimeOfFlight(&context, remoteAnchor0);
+  const int64_t actual1 = tdoaStorageGetTimeOfFlight(&context, remoteAnchor1);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT64(100, actual0);
+  TEST_ASSERT_EQUAL_INT64(200, actual1);
+}
+
+void testThatGeometryCacheIsInvalidatedWhenAnchorPositionChanges() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  tdoaStorageGetCreateAnchorCtx(&storage, 3, 1234, &context);
+  tdoaStorageSetAnchorPosition(&context, 1.0, 2.0, 3.0);
+  tdoaStorageGetGeometryCache(&context)->isValid = true;
+
+  // Test
+  tdoaStorageSetAnchorPosition(&context, 1.0, 2.5, 3.0);
+
+  // Assert
+  TEST_ASSERT_FALSE(tdoaStorageGetGeometryCache(&context)->isValid);
+}
+
+void testThatGeometryCacheIsKeptWhenAnchorPositionIsUnchanged() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  tdoaStorageGetCreateAnchorCtx(&storage, 3, 1234, &context);
+  tdoaStorageSetAnchorPosition(&context, 1.0, 2.0, 3.0);
+  tdoaStorageGetGeometryCache(&context)->isValid = true;
+
+  // Test
+  context.currentTime_ms = 2345;
+  tdoaStorageSetAnchorPosition(&context, 1.0, 2.0, 3.0);
+
+  // Assert
+  TEST_ASSERT_TRUE(tdoaStorageGetGeometryCache(&context)->isValid);
+}
+
+void testThatAnchorDistanceIsCalculatedAndUpdatedWhenThePositionChanges() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  tdoaAnchorContext_t otherContext;
+  tdoaStorageGetCreateAnchorCtx(&storage, 3, 1234, &context);
+  tdoaStorageSetAnchorPosition(&context, 1.0, 2.0, 3.0);
+  tdoaStorageGetCreateAnchorCtx(&storage, 4, 1234, &otherContext);
+  tdoaStorageSetAnchorPosition(&otherContext, 1.0, 2.0, 5.0);
+  const float actualBefore = tdoaStorageGetAnchorDistanceSq(&context, &otherContext);
+
+  // Test
+  tdoaStorageSetAnchorPosition(&otherContext, 4.0, 2.0, 3.0);
+  const float actualAfter = tdoaStorageGetAnchorDistanceSq(&context, &otherContext);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(4.0, actualBefore);
+  TEST_ASSERT_EQUAL_FLOAT(9.0, actualAfter);
+}
+
+void testThatAnchorDistanceIsZeroWhenThePositionIsNotKnown() {
+  // Fixture
+  tdoaAnchorContext_t context;
+  tdoaAnchorContext_t otherContext;
+  tdoaStorageGetCreateAnchorCtx(&storage, 3, 1234, &context);
+  tdoaStorageSetAnchorPosition(&context, 1.0, 2.0, 3.0);
+  tdoaStorageGetCreateAnchorCtx(&storage, 4, 1234, &otherContext);
+
+  // Test
+  const float actual = tdoaStorageGetAnchorDistanceSq(&context, &otherContext);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(0.0, actual);
+}
+
 // Helpers ///////////////
 
 static void fixtureSetRemoteRxTime(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t remoteRxTime, const uint8_t seqNr) {
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, storageTime, context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, storageTime, context);
   tdoaStorageSetRemoteRxTime(context, remoteAnchor, remoteRxTime, seqNr);
 }
 
 static void fixtureSetTof(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t tof) {
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, storageTime, context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, storageTime, context);
   tdoaStorageSetTimeOfFlight(context, remoteAnchor, tof);
 }
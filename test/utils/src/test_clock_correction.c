@@ -10,6 +10,9 @@
 #define CLOCK_CORRECTION_FILTER 0.1
 #define CLOCK_CORRECTION_BUCKET_MAX 4
 
+// The smallest step of the fixed point clock correction
+#define CLOCK_CORRECTION_RESOLUTION (1.0 / CLOCK_CORRECTION_ONE)
+
 void setUp(void) {
 }
 
@@ -20,7 +23,7 @@ void testGetClockCorrection() {
   // Fixture
   const double clockCorrection = 12345.6789;
   clockCorrectionStorage_t clockCorrectionStorage = {
-    .clockCorrection = clockCorrection,
+    .clockCorrection = clockCorrectionEngineFromDouble(clockCorrection),
     .clockCorrectionBucket = 0
   };
 
@@ -98,7 +101,7 @@ void testUpdateClockCorrectionWithSampleInTheOuterLimitOfTheSpecs() {
   const double clockCorrectionCandidate = CLOCK_CORRECTION_SPEC_MAX; // First value out of the specs
 
   clockCorrectionStorage_t clockCorrectionStorage = {
-    .clockCorrection = clockCorrection,
+    .clockCorrection = clockCorrectionEngineFromDouble(clockCorrection),
     .clockCorrectionBucket = clockCorrectionBucket
   };
 
@@ -109,7 +112,7 @@ void testUpdateClockCorrectionWithSampleInTheOuterLimitOfTheSpecs() {
   const double expectedClockCorrection = clockCorrection;
   const unsigned int expectedClockCorrectionBucket = clockCorrectionBucket - 1;
   TEST_ASSERT_FALSE(sampleIsReliable);
-  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionStorage.clockCorrection);
+  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionEngineGet(&clockCorrectionStorage));
   TEST_ASSERT_EQUAL_UINT(expectedClockCorrectionBucket, clockCorrectionStorage.clockCorrectionBucket);
 }
 
@@ -117,10 +120,10 @@ void testUpdateClockCorrectionWithSampleInTheInnerLimitOfTheSpecsWithEmptyBucket
   // Fixture
   const double clockCorrection = 1;
   const unsigned int clockCorrectionBucket = 0;
-  const double clockCorrectionCandidate = nextafter(CLOCK_CORRECTION_SPEC_MAX, 1); // First value in the specs
+  const double clockCorrectionCandidate = CLOCK_CORRECTION_SPEC_MAX - CLOCK_CORRECTION_RESOLUTION; // First value in the specs
 
   clockCorrectionStorage_t clockCorrectionStorage = {
-    .clockCorrection = clockCorrection,
+    .clockCorrection = clockCorrectionEngineFromDouble(clockCorrection),
     .clockCorrectionBucket = clockCorrectionBucket
   };
 
@@ -131,7 +134,7 @@ void testUpdateClockCorrectionWithSampleInTheInnerLimitOfTheSpecsWithEmptyBucket
   const double expectedClockCorrection = clockCorrectionCandidate;
   const unsigned int expectedClockCorrectionBucket = clockCorrectionBucket;
   TEST_ASSERT_FALSE(sampleIsReliable);
-  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionStorage.clockCorrection);
+  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionEngineGet(&clockCorrectionStorage));
   TEST_ASSERT_EQUAL_UINT(expectedClockCorrectionBucket, clockCorrectionStorage.clockCorrectionBucket);
 }
 
@@ -142,7 +145,7 @@ void testUpdateClockCorrectionWithSampleInTheOuterLimitOfTheAcceptableNoiseWithE
   const double clockCorrectionCandidate = clockCorrection + CLOCK_CORRECTION_ACCEPTED_NOISE; // First value out of acceptable noise
 
   clockCorrectionStorage_t clockCorrectionStorage = {
-    .clockCorrection = clockCorrection,
+    .clockCorrection = clockCorrectionEngineFromDouble(clockCorrection),
     .clockCorrectionBucket = clockCorrectionBucket
   };
 
@@ -153,7 +156,7 @@ void testUpdateClockCorrectionWithSampleInTheOuterLimitOfTheAcceptableNoiseWithE
   const double expectedClockCorrection = clockCorrectionCandidate;
   const unsigned int expectedClockCorrectionBucket = clockCorrectionBucket;
   TEST_ASSERT_FALSE(sampleIsReliable);
-  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionStorage.clockCorrection);
+  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionEngineGet(&clockCorrectionStorage));
   TEST_ASSERT_EQUAL_UINT(expectedClockCorrectionBucket, clockCorrectionStorage.clockCorrectionBucket);
 }
 
@@ -164,7 +167,7 @@ void testUpdateClockCorrectionWithSampleInTheOuterLimitOfTheAcceptableNoiseWithN
   const double clockCorrectionCandidate = clockCorrection + CLOCK_CORRECTION_ACCEPTED_NOISE; // First value out of acceptable noise
 
   clockCorrectionStorage_t clockCorrectionStorage = {
-    .clockCorrection = clockCorrection,
+    .clockCorrection = clockCorrectionEngineFromDouble(clockCorrection),
     .clockCorrectionBucket = clockCorrectionBucket
   };
 
@@ -175,7 +178,7 @@ void testUpdateClockCorrectionWithSampleInTheOuterLimitOfTheAcceptableNoiseWithN
   const double expectedClockCorrection = clockCorrection;
   const unsigned int expectedClockCorrectionBucket = clockCorrectionBucket - 1;
   TEST_ASSERT_FALSE(sampleIsReliable);
-  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionStorage.clockCorrection);
+  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionEngineGet(&clockCorrectionStorage));
   TEST_ASSERT_EQUAL_UINT(expectedClockCorrectionBucket, clockCorrectionStorage.clockCorrectionBucket);
 }
 
@@ -183,10 +186,10 @@ void testUpdateClockCorrectionWithSampleInTheInnerLimitOfTheAcceptableNoise() {
   // Fixture
   const double clockCorrection = 1.0 + 10e-6; // A value inside the clock specs
   const unsigned int clockCorrectionBucket = 2;
-  const double clockCorrectionCandidate = nextafter(clockCorrection + CLOCK_CORRECTION_ACCEPTED_NOISE, 1); // First value in the acceptable noise
+  const double clockCorrectionCandidate = clockCorrection + CLOCK_CORRECTION_ACCEPTED_NOISE - CLOCK_CORRECTION_RESOLUTION; // First value in the acceptable noise
 
   clockCorrectionStorage_t clockCorrectionStorage = {
-    .clockCorrection = clockCorrection,
+    .clockCorrection = clockCorrectionEngineFromDouble(clockCorrection),
     .clockCorrectionBucket = clockCorrectionBucket
   };
 
@@ -197,6 +200,69 @@ void testUpdateClockCorrectionWithSampleInTheInnerLimitOfTheAcceptableNoise() {
   const double expectedClockCorrection = clockCorrection * CLOCK_CORRECTION_FILTER + clockCorrectionCandidate * (1.0 - CLOCK_CORRECTION_FILTER);
   const unsigned int expectedClockCorrectionBucket = clockCorrectionBucket + 1;
   TEST_ASSERT_TRUE(sampleIsReliable);
-  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionStorage.clockCorrection);
+  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, clockCorrectionEngineGet(&clockCorrectionStorage));
   TEST_ASSERT_EQUAL_UINT(expectedClockCorrectionBucket, clockCorrectionStorage.clockCorrectionBucket);
 }
+
+void testCalculateFixedClockCorrectionIsRoundedToNearest() {
+  // Fixture
+  const uint64_t mask = 0xFFFFFFFFFF; // 40 bits
+
+  // 2 / 3 ticks
+  const uint64_t old_t_in_cl_x = 0;
+  const uint64_t new_t_in_cl_x = 3;
+  const uint64_t old_t_in_cl_reference = 0;
+  const uint64_t new_t_in_cl_reference = 2;
+
+  // Test
+  const clockCorrection_t result = clockCorrectionEngineCalculateFixed(new_t_in_cl_reference, old_t_in_cl_reference, new_t_in_cl_x, old_t_in_cl_x, mask);
+
+  // Assert
+  // 2^44 * 2 / 3 = 11728124029610.67
+  const clockCorrection_t expectedClockCorrection = 11728124029611;
+  TEST_ASSERT_EQUAL_INT64(expectedClockCorrection, result);
+}
+
+void testCalculateFixedClockCorrectionWithMaxTimestamps() {
+  // Fixture
+  const uint64_t mask = 0xFFFFFFFFFF; // 40 bits
+
+  const uint64_t old_t_in_cl_x = 0;
+  const uint64_t new_t_in_cl_x = mask;
+  const uint64_t old_t_in_cl_reference = 1;
+  const uint64_t new_t_in_cl_reference = mask;
+
+  // Test
+  const double result = clockCorrectionEngineCalculate(new_t_in_cl_reference, old_t_in_cl_reference, new_t_in_cl_x, old_t_in_cl_x, mask);
+
+  // Assert
+  const double expectedClockCorrection = (double)(mask - 1) / (double)mask;
+  TEST_ASSERT_EQUAL_DOUBLE(expectedClockCorrection, result);
+}
+
+void testApplyClockCorrection() {
+  // Fixture
+  const clockCorrection_t clockCorrection = clockCorrectionEngineFromDouble(1.0 + 10e-6);
+  const int64_t ticks = 0xFFFFFFFFFF;
+
+  // Test
+  const int64_t result = clockCorrectionEngineApply(clockCorrection, ticks);
+
+  // Assert
+  // 1099511627775 * 1.00001 = 1099522622891.27775
+  const int64_t expected = 1099522622891;
+  TEST_ASSERT_EQUAL_INT64(expected, result);
+}
+
+void testApplyClockCorrectionToNegativeTicks() {
+  // Fixture
+  const clockCorrection_t clockCorrection = clockCorrectionEngineFromDouble(0.5);
+  const int64_t ticks = -1001;
+
+  // Test
+  const int64_t result = clockCorrectionEngineApply(clockCorrection, ticks);
+
+  // Assert
+  const int64_t expected = -501;
+  TEST_ASSERT_EQUAL_INT64(expected, result);
+}
@@ -0,0 +1,166 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * test_columnBlock.c - unit tests for the column oriented log blocks
+ */
+
+// File under test
+#include "columnBlock.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "unity.h"
+
+typedef struct {
+  uint64_t timestamp;
+  uint8_t u8;
+  int16_t i16;
+  int32_t i32;
+  float f;
+} __attribute__((packed)) row_t;
+
+static const char format[] = "Bhif";
+
+#define NUM_ROWS 10
+static row_t rows[NUM_ROWS];
+static row_t decoded[NUM_ROWS];
+static uint8_t block[512];
+
+void setUp(void) {
+  for (int i = 0; i < NUM_ROWS; i++) {
+    rows[i].timestamp = 1000000 + i * 1000;
+    rows[i].u8 = 250 + i;
+    rows[i].i16 = -3 * i;
+    rows[i].i32 = (i % 2) ? INT32_MIN : INT32_MAX;
+    rows[i].f = 0.5f * i;
+  }
+  memset(decoded, 0, sizeof(decoded));
+}
+
+void tearDown(void) {}
+
+void testThatRowSizeIncludesTimestamp() {
+  // Fixture
+  // Test
+  uint16_t actual = columnBlockRowSize(format);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(sizeof(row_t), actual);
+}
+
+void testThatUnknownTypeIsRejected() {
+  // Fixture
+  uint32_t length;
+
+  // Test
+  int actual = columnBlockEncode(block, sizeof(block), &length, 1, "Bq", (uint8_t*)rows, NUM_ROWS);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(EINVAL, actual);
+}
+
+void testThatBlockCanBeDecoded() {
+  // Fixture
+  uint32_t length;
+  columnBlockHeader_t header;
+  TEST_ASSERT_EQUAL_INT(0, columnBlockEncode(block, sizeof(block), &length, 7, format, (uint8_t*)rows, NUM_ROWS));
+
+  // Test
+  int actualHeader = columnBlockParseHeader(block, length, &header);
+  int actualDecode = columnBlockDecode(block, &header, format, (uint8_t*)decoded, NUM_ROWS);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, actualHeader);
+  TEST_ASSERT_EQUAL_INT(0, actualDecode);
+  TEST_ASSERT_EQUAL_UINT16(7, header.eventId);
+  TEST_ASSERT_EQUAL_UINT16(NUM_ROWS, header.numRows);
+  TEST_ASSERT_EQUAL_UINT32(length, COLUMN_BLOCK_HEADER_SIZE + header.bodySize + COLUMN_BLOCK_CRC_SIZE);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(rows, decoded, sizeof(rows));
+}
+
+void testThatSlowlyChangingValuesAreSmallerThanRows() {
+  // Fixture
+  uint32_t length;
+  for (int i = 0; i < NUM_ROWS; i++) {
+    rows[i].i32 = 100000 + i;
+  }
+
+  // Test
+  columnBlockEncode(block, sizeof(block), &length, 7, format, (uint8_t*)rows, NUM_ROWS);
+
+  // Assert
+  TEST_ASSERT_TRUE(length < sizeof(rows) * 3 / 5);
+}
+
+void testThatCorruptBlockIsDetected() {
+  // Fixture
+  uint32_t length;
+  columnBlockHeader_t header;
+  columnBlockEncode(block, sizeof(block), &length, 7, format, (uint8_t*)rows, NUM_ROWS);
+  block[COLUMN_BLOCK_HEADER_SIZE + 3] ^= 0x01;
+
+  // Test
+  int actual = columnBlockParseHeader(block, length, &header);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(EINVAL, actual);
+}
+
+void testThatTruncatedBlockIsDetected() {
+  // Fixture
+  uint32_t length;
+  columnBlockHeader_t header;
+  columnBlockEncode(block, sizeof(block), &length, 7, format, (uint8_t*)rows, NUM_ROWS);
+
+  // Test
+  int actual = columnBlockParseHeader(block, length - 1, &header);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(EINVAL, actual);
+}
+
+void testThatTooSmallOutputIsReported() {
+  // Fixture
+  uint32_t length;
+
+  // Test
+  int actual = columnBlockEncode(block, columnBlockMaxSize(format, NUM_ROWS) - 1, &length, 7, format, (uint8_t*)rows, NUM_ROWS);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(ENOSPC, actual);
+}
+
+void testThatTooManyRowsForDestinationIsReported() {
+  // Fixture
+  uint32_t length;
+  columnBlockHeader_t header;
+  columnBlockEncode(block, sizeof(block), &length, 7, format, (uint8_t*)rows, NUM_ROWS);
+  columnBlockParseHeader(block, length, &header);
+
+  // Test
+  int actual = columnBlockDecode(block, &header, format, (uint8_t*)decoded, NUM_ROWS - 1);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(ENOSPC, actual);
+}
@@ -0,0 +1,112 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * test_crc32.c - unit tests for the CRC32 checksum
+ */
+
+// File under test
+#include "crc32.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+static uint8_t buffer[256];
+
+// Bit-wise CRC32 (zlib), the reference
+static uint32_t referenceCrc32(const uint8_t* data, size_t size) {
+  uint32_t remainder = 0xffffffff;
+  for (size_t i = 0; i < size; i++) {
+    remainder ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      remainder = (remainder & 1) ? (remainder >> 1) ^ 0xEDB88320 : (remainder >> 1);
+    }
+  }
+  return remainder ^ 0xffffffff;
+}
+
+void setUp(void) {
+  for (int i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = i * 7 + 3;
+  }
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testCheckValue() {
+  // Fixture
+  const char* data = "123456789";
+
+  // Test
+  const uint32_t actual = crc32CalculateBuffer(data, strlen(data));
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, actual);
+}
+
+void testEmptyBuffer() {
+  // Fixture
+  // Test
+  const uint32_t actual = crc32CalculateBuffer(buffer, 0);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX32(0, actual);
+}
+
+void testAllSizesAndAlignmentsMatchTheReference() {
+  // Fixture
+  for (int offset = 0; offset < 4; offset++) {
+    for (int size = 0; size < 64; size++) {
+      const uint32_t expected = referenceCrc32(&buffer[offset], size);
+
+      // Test
+      const uint32_t actual = crc32CalculateBuffer(&buffer[offset], size);
+
+      // Assert
+      TEST_ASSERT_EQUAL_HEX32(expected, actual);
+    }
+  }
+}
+
+void testUpdateInChunksMatchesOneCall() {
+  // Fixture
+  const uint32_t expected = crc32CalculateBuffer(buffer, sizeof(buffer));
+  const size_t chunks[] = {1, 3, 4, 7, 13, 28, 64, 136};
+
+  crc32Context_t context;
+  crc32ContextInit(&context);
+
+  // Test
+  size_t offset = 0;
+  for (int i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+    crc32Update(&context, &buffer[offset], chunks[i]);
+    offset += chunks[i];
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL(sizeof(buffer), offset);
+  TEST_ASSERT_EQUAL_HEX32(expected, crc32Out(&context));
+}
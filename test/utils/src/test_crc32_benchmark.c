@@ -0,0 +1,97 @@
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 199309L
+
+// File under test crc32.c
+#include "crc32.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+// Benchmark of the CRC32 checksum against the byte-wise table implementation it replaced. Not part of the normal unit
+// test run, run it with
+//   make bench
+// or
+//   make unit FILES=test/utils/src/test_crc32_benchmark.c
+// @IGNORE_IF_NOT CRC32_BENCHMARK
+//
+// The block sizes are the sizes written by the uSD log task (512 bytes), the small writes of the event based logging
+// and a lighthouse deck bitstream chunk.
+
+#define BENCH_BYTES (64 * 1024 * 1024)
+
+static uint8_t data[4096 + 4];
+static uint32_t byteTable[256];
+
+static uint32_t byteWiseCrc32(const uint8_t* message, size_t size);
+static uint64_t nowNs();
+
+void setUp(void) {
+  for (int i = 0; i < sizeof(data); i++) {
+    data[i] = i * 31 + 7;
+  }
+
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t remainder = i;
+    for (int bit = 0; bit < 8; bit++) {
+      remainder = (remainder & 1) ? (remainder >> 1) ^ 0xEDB88320 : (remainder >> 1);
+    }
+    byteTable[i] = remainder;
+  }
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testBenchmark() {
+  // Fixture
+  const size_t blockSizes[] = {12, 64, 512, 4096};
+  printf("\nCRC32 benchmark, %d MB per block size\n", BENCH_BYTES / (1024 * 1024));
+  printf("%6s %14s %14s %8s\n", "block", "byte-wise MB/s", "current MB/s", "speedup");
+
+  for (int i = 0; i < sizeof(blockSizes) / sizeof(blockSizes[0]); i++) {
+    const size_t blockSize = blockSizes[i];
+    const int blocks = BENCH_BYTES / blockSize;
+    // Unaligned, as the uSD log data is
+    const uint8_t* block = &data[1];
+
+    // Test
+    volatile uint32_t sink = 0;
+    uint64_t start = nowNs();
+    for (int j = 0; j < blocks; j++) {
+      sink ^= byteWiseCrc32(block, blockSize);
+    }
+    const uint64_t byteWiseNs = nowNs() - start;
+
+    start = nowNs();
+    for (int j = 0; j < blocks; j++) {
+      sink ^= crc32CalculateBuffer(block, blockSize);
+    }
+    const uint64_t currentNs = nowNs() - start;
+
+    // Assert
+    printf("%6zu %14.0f %14.0f %7.2fx\n", blockSize, BENCH_BYTES / (byteWiseNs / 1e3), BENCH_BYTES / (currentNs / 1e3),
+      (double)byteWiseNs / currentNs);
+
+    TEST_ASSERT_EQUAL_HEX32(byteWiseCrc32(block, blockSize), crc32CalculateBuffer(block, blockSize));
+  }
+}
+
+// Helpers ------------------------------------------------------------------
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The byte-wise table implementation of crc32.c before slicing-by-4
+static uint32_t byteWiseCrc32(const uint8_t* message, size_t size) {
+  uint32_t remainder = 0xffffffff;
+  for (size_t i = 0; i < size; i++) {
+    remainder = byteTable[(message[i] ^ remainder) & 0xff] ^ (remainder >> 8);
+  }
+  return remainder ^ 0xffffffff;
+}
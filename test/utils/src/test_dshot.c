@@ -0,0 +1,79 @@
+// File under test dshot.c
+#include "dshot.h"
+
+#include <string.h>
+#include "unity.h"
+
+void setUp(void) {
+  // Empty
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatZeroRatioStopsTheMotor() {
+  // Fixture
+  // Test
+  const uint16_t actual = dshotThrottleFromRatio(0);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(0, actual);
+}
+
+void testThatRatiosAreScaledToTheThrottleRange() {
+  // Fixture
+  // Test
+  const uint16_t actualMin = dshotThrottleFromRatio(1);
+  const uint16_t actualHalf = dshotThrottleFromRatio(0x8000);
+  const uint16_t actualMax = dshotThrottleFromRatio(0xFFFF);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(DSHOT_THROTTLE_MIN, actualMin);
+  TEST_ASSERT_EQUAL_UINT16(1048, actualHalf);
+  TEST_ASSERT_EQUAL_UINT16(DSHOT_THROTTLE_MAX, actualMax);
+}
+
+void testThatFrameHasChecksum() {
+  // Fixture
+  // Value 1046 without telemetry request is 0x82c, checksum 0x8 ^ 0x2 ^ 0xc = 0x6
+  const uint16_t expected = 0x82c6;
+
+  // Test
+  const uint16_t actual = dshotFrame(1046, false);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX16(expected, actual);
+}
+
+void testThatFrameHasTelemetryRequestBit() {
+  // Fixture
+  // Value 1046 with telemetry request is 0x82d, checksum 0x8 ^ 0x2 ^ 0xd = 0x7
+  const uint16_t expected = 0x82d7;
+
+  // Test
+  const uint16_t actual = dshotFrame(1046, true);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX16(expected, actual);
+}
+
+void testThatFrameIsConvertedToInterleavedCompareValuesMsbFirst() {
+  // Fixture
+  uint32_t compare[DSHOT_FRAME_BITS * 2];
+  memset(compare, 0, sizeof(compare));
+
+  // Test
+  dshotFrameToCompare(0xa001, compare, 2, 5, 10);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(10, compare[0]);
+  TEST_ASSERT_EQUAL_UINT32(5, compare[2]);
+  TEST_ASSERT_EQUAL_UINT32(10, compare[4]);
+  TEST_ASSERT_EQUAL_UINT32(5, compare[6]);
+  TEST_ASSERT_EQUAL_UINT32(5, compare[28]);
+  TEST_ASSERT_EQUAL_UINT32(10, compare[30]);
+  // The other channel is not touched
+  TEST_ASSERT_EQUAL_UINT32(0, compare[1]);
+  TEST_ASSERT_EQUAL_UINT32(0, compare[31]);
+}
@@ -31,12 +31,15 @@
 #include <string.h>
 
 static int putcMock(int c);
+static int putbMock(const char* data, int len);
 static void verifyStdio(char* format, ...);
 static void verify(char* expected, char* format, ...);
 static char actual[100];
+static int putbCalls;
 
 static void reset() {
   memset(actual, 0, sizeof(actual));
+  putbCalls = 0;
 }
 
 void setUp(void) {
@@ -254,6 +257,31 @@ void testThatAllIntTypesArePrinted() {
   verify("FFFFFFFFFFFFFFFF", "%llX", (uint64_t)0xFFFFFFFFFFFFFFFF);
 }
 
+void testThatBufferedTextIsPrintedInOneWrite() {
+  // Fixture
+  char* expected = "Value 42\n";
+
+  // Test
+  int actualLen = ebprintf(putbMock, "Value %i\n", 42);
+
+  // Assert
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+  TEST_ASSERT_EQUAL_INT(strlen(expected), actualLen);
+  TEST_ASSERT_EQUAL_INT(1, putbCalls);
+}
+
+void testThatLongBufferedTextIsPrintedInChunks() {
+  // Fixture
+  char* expected = "A text that is longer than one chunk, 12345 and FF";
+
+  // Test
+  ebprintf(putbMock, "A text that is longer than one chunk, %i and %X", 12345, 0xff);
+
+  // Assert
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+  TEST_ASSERT_EQUAL_INT(2, putbCalls);
+}
+
 //////////////////////////////
 
 static int putcMock(int c) {
@@ -263,6 +291,13 @@ static int putcMock(int c) {
   return 1;
 }
 
+static int putbMock(const char* data, int len) {
+  size_t start = strlen(actual);
+  memcpy(&actual[start], data, len);
+  putbCalls++;
+  return len;
+}
+
 static void verifyStdio(char* format, ...) {
   // Fixture
   reset();
@@ -0,0 +1,150 @@
+// File under test fastmath.c
+#include "fastmath.h"
+
+#include <math.h>
+#include "unity.h"
+
+#define PI 3.14159265358979
+
+void setUp(void) {
+  // Empty
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatSinCosIsWithinErrorBound() {
+  // Fixture
+  double maxSinError = 0.0;
+  double maxCosError = 0.0;
+
+  // Test
+  for (int i = -200000; i <= 200000; i++) {
+    const float x = i * 0.0005f;
+    float s, c;
+    fastSinCos(x, &s, &c);
+    maxSinError = fmax(maxSinError, fabs(s - sin(x)));
+    maxCosError = fmax(maxCosError, fabs(c - cos(x)));
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(maxSinError < 3e-7);
+  TEST_ASSERT_TRUE(maxCosError < 3e-7);
+}
+
+void testThatSinCosIsExactOnQuadrants() {
+  // Fixture
+  float s, c;
+
+  // Test
+  fastSinCos((float)(PI / 2.0), &s, &c);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-7f, 1.0f, s);
+  TEST_ASSERT_FLOAT_WITHIN(1e-7f, 0.0f, c);
+  TEST_ASSERT_FLOAT_WITHIN(1e-7f, 0.0f, fastSin(0.0f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-7f, -1.0f, fastCos((float)PI));
+}
+
+void testThatAtan2IsWithinErrorBoundInAllQuadrants() {
+  // Fixture
+  double maxError = 0.0;
+
+  // Test
+  for (int i = -300; i <= 300; i++) {
+    for (int j = -300; j <= 300; j++) {
+      const float y = i * 0.0137f;
+      const float x = j * 0.0091f;
+      if (x == 0.0f && y == 0.0f) {
+        continue;
+      }
+      maxError = fmax(maxError, fabs(fastAtan2(y, x) - atan2(y, x)));
+    }
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(maxError < 4e-7);
+}
+
+void testThatAtan2OfOriginIsZero() {
+  // Fixture
+  // Test
+  const float actual = fastAtan2(0.0f, 0.0f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actual);
+}
+
+void testThatAsinIsWithinErrorBound() {
+  // Fixture
+  double maxError = 0.0;
+
+  // Test
+  for (int i = -100000; i <= 100000; i++) {
+    const float x = i * 0.00001f;
+    maxError = fmax(maxError, fabs(fastAsin(x) - asin(x)));
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(maxError < 5e-7);
+}
+
+void testThatAsinClampsTheArgument() {
+  // Fixture
+  // Test
+  const float actual = fastAsin(1.0001f);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, (float)(PI / 2.0), actual);
+}
+
+void testThatInvSqrtOfZeroIsZero() {
+  // Fixture
+  // Test
+  const float actual = fastInvSqrt(0.0f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actual);
+}
+
+void testThatInvSqrtIsExact() {
+  // Fixture
+  // Test
+  const float actual = fastInvSqrt(4.0f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, actual);
+}
+
+void testThatQuaternionToRpyAndBackIsIdentity() {
+  // Fixture
+  const float rpy[3] = {0.3f, -0.7f, 2.5f};
+  float q[4];
+  float actual[3];
+
+  // Test
+  fastRpyToQuat(rpy, q);
+  fastQuatToRpy(q, actual);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, rpy[0], actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, rpy[1], actual[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, rpy[2], actual[2]);
+}
+
+void testThatRpyToQuaternionMatchesYawRotation() {
+  // Fixture
+  const float rpy[3] = {0.0f, 0.0f, (float)(PI / 2.0)};
+  float actual[4];
+
+  // Test
+  fastRpyToQuat(rpy, actual);
+
+  // Assert
+  const float expected = (float)sqrt(0.5);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, actual[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected, actual[2]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected, actual[3]);
+}
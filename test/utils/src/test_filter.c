@@ -0,0 +1,105 @@
+// File under test filter.c
+#include "filter.h"
+
+#include "unity.h"
+
+#include <math.h>
+#include "physicalConstants.h"
+
+#define SAMPLE_FREQ 1000.0f
+
+static float sine(float freq, int sample) {
+  return sinf(2.0f * M_PI_F * freq * sample / SAMPLE_FREQ);
+}
+
+void setUp(void) {
+  // Empty
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatBiquad3LpfIsTheSameAsLpf2pOnEachAxis() {
+  // Fixture
+  lpf2pData lpf[3];
+  biquad3Data biquad;
+  for (int i = 0; i < 3; i++) {
+    lpf2pInit(&lpf[i], SAMPLE_FREQ, 80.0f);
+  }
+  biquad3InitLpf(&biquad, SAMPLE_FREQ, 80.0f);
+
+  float expected[3];
+  float actual[3];
+
+  // Test
+  for (int sample = 0; sample < 100; sample++) {
+    for (int i = 0; i < 3; i++) {
+      const float value = sine(10.0f * (i + 1), sample) + i;
+      expected[i] = lpf2pApply(&lpf[i], value);
+      actual[i] = value;
+    }
+    biquad3Apply(&biquad, actual);
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, actual, 3);
+}
+
+void testThatBiquad3NotchRemovesTheCenterFrequency() {
+  // Fixture
+  biquad3Data notch;
+  biquad3InitNotch(&notch, SAMPLE_FREQ, 200.0f, 3.0f);
+
+  float maxOutput = 0.0f;
+
+  // Test
+  for (int sample = 0; sample < 1000; sample++) {
+    float values[3] = {sine(200.0f, sample), 0.0f, 0.0f};
+    biquad3Apply(&notch, values);
+
+    // Skip the transient
+    if (sample > 500) {
+      maxOutput = fmaxf(maxOutput, fabsf(values[0]));
+    }
+  }
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, maxOutput);
+}
+
+void testThatBiquad3NotchPassesLowFrequencies() {
+  // Fixture
+  biquad3Data notch;
+  biquad3InitNotch(&notch, SAMPLE_FREQ, 200.0f, 3.0f);
+
+  float values[3];
+
+  // Test
+  for (int sample = 0; sample < 200; sample++) {
+    values[0] = 1.0f;
+    values[1] = -2.0f;
+    values[2] = 3.0f;
+    biquad3Apply(&notch, values);
+  }
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, values[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -2.0f, values[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 3.0f, values[2]);
+}
+
+void testThatMovingTheNotchKeepsTheState() {
+  // Fixture
+  biquad3Data notch;
+  biquad3InitNotch(&notch, SAMPLE_FREQ, 200.0f, 3.0f);
+  float values[3] = {1.0f, 1.0f, 1.0f};
+  biquad3Apply(&notch, values);
+  const float expected = notch.delay_element_1[0];
+
+  // Test
+  biquad3SetNotchFreq(&notch, SAMPLE_FREQ, 250.0f, 3.0f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(expected, notch.delay_element_1[0]);
+}
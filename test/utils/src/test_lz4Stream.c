@@ -0,0 +1,136 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * test_lz4Stream.c - unit tests for the incremental LZ4 block decoder
+ */
+
+// File under test
+#include "lz4Stream.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "unity.h"
+
+static lz4Stream_t stream;
+static uint8_t output[64];
+
+// "abcabcabcabcX": 3 literals, a 9 byte match at offset 3, then the last literal
+static const uint8_t block[] = {0x35, 'a', 'b', 'c', 0x03, 0x00, 0x10, 'X'};
+static const char expected[] = "abcabcabcabcX";
+
+void setUp(void) {
+  memset(output, 0, sizeof(output));
+  lz4StreamInit(&stream, output, sizeof(output));
+}
+
+void tearDown(void) {}
+
+void testThatABlockIsDecoded() {
+  // Fixture
+  // Test
+  int actual = lz4StreamDecode(&stream, block, sizeof(block));
+
+  // Assert
+  TEST_ASSERT_EQUAL(0, actual);
+  TEST_ASSERT_EQUAL(strlen(expected), stream.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, output, strlen(expected));
+  TEST_ASSERT_TRUE(lz4StreamIsComplete(&stream));
+}
+
+void testThatABlockIsDecodedOneByteAtATime() {
+  // Fixture
+  // Test
+  for (uint32_t i = 0; i < sizeof(block); i++) {
+    TEST_ASSERT_EQUAL(0, lz4StreamDecode(&stream, &block[i], 1));
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL(strlen(expected), stream.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, output, strlen(expected));
+}
+
+void testThatAPartialSequenceIsNotComplete() {
+  // Fixture
+  // Test
+  lz4StreamDecode(&stream, block, 5);
+
+  // Assert
+  TEST_ASSERT_FALSE(lz4StreamIsComplete(&stream));
+}
+
+void testThatExtendedLengthsAreDecoded() {
+  // Fixture
+  // 15 + 1 literals, a 19 + 2 byte run at offset 1
+  uint8_t input[3 + 16 + 2] = {0xff, 0x01};
+  memset(&input[2], 'z', 16);
+  input[18] = 0x01;
+  input[19] = 0x00;
+  input[20] = 0x02;
+
+  // Test
+  int actual = lz4StreamDecode(&stream, input, sizeof(input));
+
+  // Assert
+  TEST_ASSERT_EQUAL(0, actual);
+  TEST_ASSERT_EQUAL(16 + 21, stream.length);
+  for (int i = 0; i < 16 + 21; i++) {
+    TEST_ASSERT_EQUAL_UINT8('z', output[i]);
+  }
+}
+
+void testThatAnOffsetBeforeTheOutputIsRejected() {
+  // Fixture
+  const uint8_t input[] = {0x10, 'a', 0x02, 0x00};
+
+  // Test
+  int actual = lz4StreamDecode(&stream, input, sizeof(input));
+
+  // Assert
+  TEST_ASSERT_EQUAL(EINVAL, actual);
+}
+
+void testThatOutputOverflowIsRejected() {
+  // Fixture
+  lz4StreamInit(&stream, output, 8);
+
+  // Test
+  int actual = lz4StreamDecode(&stream, block, sizeof(block));
+
+  // Assert
+  TEST_ASSERT_EQUAL(ENOSPC, actual);
+  TEST_ASSERT_LESS_OR_EQUAL(8, stream.length);
+}
+
+void testThatTheErrorIsKept() {
+  // Fixture
+  const uint8_t input[] = {0x10, 'a', 0x02, 0x00};
+  lz4StreamDecode(&stream, input, sizeof(input));
+
+  // Test
+  int actual = lz4StreamDecode(&stream, block, sizeof(block));
+
+  // Assert
+  TEST_ASSERT_EQUAL(EINVAL, actual);
+  TEST_ASSERT_EQUAL(1, stream.length);
+}
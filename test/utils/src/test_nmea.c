@@ -0,0 +1,139 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ * test_nmea.c - unit tests for the incremental NMEA parser
+ */
+
+// File under test
+#include "nmea.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+static nmeaParser_t sut;
+
+void setUp(void) {
+  nmeaParserInit(&sut);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+static nmeaSentence_t feed(const char* text) {
+  nmeaSentence_t result = nmeaSentenceNone;
+  for (size_t i = 0; i < strlen(text); i++) {
+    nmeaSentence_t sentence = nmeaParse(&sut, text[i]);
+    if (sentence != nmeaSentenceNone) {
+      result = sentence;
+    }
+  }
+  return result;
+}
+
+void testThatGgaSentenceIsParsed() {
+  // Fixture
+  const char* text = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+  // Test
+  nmeaSentence_t actual = feed(text);
+
+  // Assert
+  TEST_ASSERT_EQUAL(nmeaSentenceGga, actual);
+  TEST_ASSERT_EQUAL_UINT32(123519, sut.gga.fixTime);
+  TEST_ASSERT_INT32_WITHIN(1, 481173000, sut.gga.latitude);
+  TEST_ASSERT_INT32_WITHIN(1, 115166666, sut.gga.longitude);
+  TEST_ASSERT_EQUAL_UINT8(1, sut.gga.fixQuality);
+  TEST_ASSERT_EQUAL_UINT8(8, sut.gga.nsat);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.9f, sut.gga.hdop);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 545.4f, sut.gga.altitude);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 46.9f, sut.gga.geoidSeparation);
+}
+
+void testThatSouthAndWestGiveNegativeCoordinates() {
+  // Fixture
+  const char* text = "$GNGGA,000001,3318.0489,S,07033.1234,W,1,05,1.2,10.0,M,0.0,M,,*5A\r\n";
+
+  // Test
+  nmeaSentence_t actual = feed(text);
+
+  // Assert
+  TEST_ASSERT_EQUAL(nmeaSentenceGga, actual);
+  TEST_ASSERT_INT32_WITHIN(1, -333008150, sut.gga.latitude);
+  TEST_ASSERT_INT32_WITHIN(1, -705520566, sut.gga.longitude);
+}
+
+void testThatGsaSentenceIsParsed() {
+  // Fixture
+  const char* text = "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n";
+
+  // Test
+  nmeaSentence_t actual = feed(text);
+
+  // Assert
+  TEST_ASSERT_EQUAL(nmeaSentenceGsa, actual);
+  TEST_ASSERT_EQUAL_UINT8(3, sut.gsa.fix);
+  TEST_ASSERT_EQUAL_UINT8(5, sut.gsa.nsat);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.5f, sut.gsa.pdop);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.3f, sut.gsa.hdop);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.1f, sut.gsa.vdop);
+}
+
+void testThatSentenceWithBadChecksumIsRejected() {
+  // Fixture
+  const char* text = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*48\r\n";
+
+  // Test
+  nmeaSentence_t actual = feed(text);
+
+  // Assert
+  TEST_ASSERT_EQUAL(nmeaSentenceNone, actual);
+  TEST_ASSERT_EQUAL_UINT32(1, sut.checksumErrors);
+  TEST_ASSERT_EQUAL_UINT32(0, sut.gga.fixTime);
+}
+
+void testThatUnsupportedSentenceIsIgnored() {
+  // Fixture
+  const char* text = "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n";
+
+  // Test
+  nmeaSentence_t actual = feed(text);
+
+  // Assert
+  TEST_ASSERT_EQUAL(nmeaSentenceNone, actual);
+  TEST_ASSERT_EQUAL_UINT32(0, sut.checksumErrors);
+}
+
+void testThatParsingRestartsOnNewSentenceStart() {
+  // Fixture
+  const char* text = "$GPGGA,1235$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n";
+
+  // Test
+  nmeaSentence_t actual = feed(text);
+
+  // Assert
+  TEST_ASSERT_EQUAL(nmeaSentenceGsa, actual);
+}
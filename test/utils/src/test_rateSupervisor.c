@@ -30,6 +30,8 @@
 
 #include "unity.h"
 
+#include <string.h>
+
 
 static rateSupervisor_t context;
 
@@ -39,6 +41,8 @@ static uint32_t minCount = 2;
 static uint32_t maxCount = 4;
 
 void setUp(void) {
+    // The statistics are kept by rateSupervisorInit()
+    memset(&context, 0, sizeof(context));
     rateSupervisorInit(&context, startTime, evaluationIntervall, minCount, maxCount, 0);
 }
 
@@ -143,3 +147,113 @@ void testThatValidationFailesAfterSkip() {
     // Assert
     TEST_ASSERT_FALSE(actual);
 }
+
+void testThatInitRateSetsBoundsFromTolerance() {
+    // Fixture
+    // Test
+    rateSupervisorInitRate(&context, startTime, 1000, 3, 0);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT32(997, context.expectedMin);
+    TEST_ASSERT_EQUAL_UINT32(1003, context.expectedMax);
+    TEST_ASSERT_EQUAL_UINT32(1000, context.evaluationIntervalMs);
+}
+
+void testThatInitRateWithoutRateNeverFails() {
+    // Fixture
+    rateSupervisorInitRate(&context, startTime, 0, 0, 0);
+
+    // Test
+    bool actual = rateSupervisorValidate(&context, startTime + 1200);
+
+    // Assert
+    TEST_ASSERT_TRUE(actual);
+    TEST_ASSERT_EQUAL_UINT32(0, rateSupervisorStats(&context)->missed);
+}
+
+void testThatMissedCallsAreCounted() {
+    // Fixture
+    rateSupervisorInitRate(&context, startTime, 10, 100, 0);
+    for (int i = 0; i < 6; i++) {
+        rateSupervisorValidate(&context, startTime + i * 100);
+    }
+
+    // Test
+    rateSupervisorValidate(&context, startTime + 1200);
+
+    // Assert
+    const rateSupervisorStats_t* stats = rateSupervisorStats(&context);
+    TEST_ASSERT_EQUAL_UINT32(3, stats->missed);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->failures);
+    TEST_ASSERT_FALSE(stats->ok);
+    TEST_ASSERT_EQUAL_UINT16(7, stats->rate);
+}
+
+void testThatMissedCallsAreNotCountedWhileSkipping() {
+    // Fixture
+    rateSupervisorInitRate(&context, startTime, 10, 100, 1);
+
+    // Test
+    rateSupervisorValidate(&context, startTime + 1200);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT32(0, rateSupervisorStats(&context)->missed);
+    TEST_ASSERT_EQUAL_UINT32(0, rateSupervisorStats(&context)->failures);
+}
+
+void testThatStatisticsAreKeptWhenInitializedAgain() {
+    // Fixture
+    rateSupervisorInitRate(&context, startTime, 10, 100, 0);
+    rateSupervisorValidate(&context, startTime + 1200);
+
+    // Test
+    rateSupervisorInitRate(&context, startTime + 1200, 20, 100, 0);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT32(9, rateSupervisorStats(&context)->missed);
+}
+
+void testThatJitterPercentilesAreMeasured() {
+    // Fixture
+    rateSupervisorInitRate(&context, startTime, 100, 100, 0);
+    uint32_t timeUs = 0;
+    for (int i = 0; i < 100; i++) {
+        // Every 10th period is 100 us late
+        timeUs += (i % 10 == 9) ? 10100 : 10000;
+        rateSupervisorTick(&context, startTime + i * 10, timeUs);
+    }
+
+    // Test
+    rateSupervisorTick(&context, startTime + 1200, timeUs + 10000);
+
+    // Assert
+    const rateSupervisorStats_t* stats = rateSupervisorStats(&context);
+    TEST_ASSERT_EQUAL_UINT16(0, stats->jitterP50);
+    TEST_ASSERT_EQUAL_UINT16(127, stats->jitterP95);
+    TEST_ASSERT_EQUAL_UINT16(127, stats->jitterP99);
+}
+
+void testThatASupervisorIsRegisteredOnce() {
+    // Fixture
+    const int before = rateSupervisorRegisteredCount();
+
+    // Test
+    bool actual1 = rateSupervisorRegister(&context, "first");
+    bool actual2 = rateSupervisorRegister(&context, "second");
+
+    // Assert
+    TEST_ASSERT_TRUE(actual1);
+    TEST_ASSERT_TRUE(actual2);
+    TEST_ASSERT_EQUAL_INT(before + 1, rateSupervisorRegisteredCount());
+    TEST_ASSERT_EQUAL_PTR(&context, rateSupervisorRegistered(before));
+    TEST_ASSERT_EQUAL_STRING("second", rateSupervisorRegistered(before)->name);
+}
+
+void testThatAnIndexOutOfRangeGivesNoSupervisor() {
+    // Fixture
+    // Test
+    const rateSupervisor_t* actual = rateSupervisorRegistered(RATE_SUPERVISOR_MAX_REGISTERED);
+
+    // Assert
+    TEST_ASSERT_NULL(actual);
+}
@@ -0,0 +1,124 @@
+// File under test spectrum.c
+#include "spectrum.h"
+
+#include "unity.h"
+
+#include <math.h>
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+#define SAMPLE_RATE 1000.0f
+#define BIN_WIDTH (SAMPLE_RATE / SPECTRUM_SIZE)
+
+static const float bandEdges[SPECTRUM_BAND_COUNT + 1] = {20.0f, 80.0f, 160.0f, 320.0f, 500.0f};
+
+static spectrum_t spectrum;
+static spectrumResult_t result;
+static float samples[SPECTRUM_SIZE * 3];
+
+static void addSine(float* destination, int stride, float frequency, float amplitude);
+
+void setUp(void) {
+  spectrumInit(&spectrum, SAMPLE_RATE, bandEdges);
+  for (int i = 0; i < SPECTRUM_SIZE * 3; i++) {
+    samples[i] = 0.0f;
+  }
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAConstantSignalHasNoEnergyAndNoPeaks() {
+  // Fixture
+  for (int i = 0; i < SPECTRUM_SIZE; i++) {
+    samples[i] = 9.81f;
+  }
+
+  // Test
+  spectrumAnalyze(&spectrum, samples, 1, &result);
+
+  // Assert
+  for (int i = 0; i < SPECTRUM_BAND_COUNT; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, result.bandEnergy[i]);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.0f, result.peaks[0].amplitude);
+}
+
+void testThatTheEnergyOfASineIsInItsBand() {
+  // Fixture
+  addSine(samples, 1, 200.0f, 2.0f);
+
+  // Test
+  spectrumAnalyze(&spectrum, samples, 1, &result);
+
+  // Assert
+  // The mean square of a sine is amplitude^2 / 2
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 2.0f, result.bandEnergy[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, result.bandEnergy[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, result.bandEnergy[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, result.bandEnergy[3]);
+}
+
+void testThatThePeakOfASineBetweenTwoBinsIsInterpolated() {
+  // Fixture
+  const float frequency = 30.5f * BIN_WIDTH;
+  addSine(samples, 1, frequency, 1.0f);
+
+  // Test
+  spectrumAnalyze(&spectrum, samples, 1, &result);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.2f * BIN_WIDTH, frequency, result.peaks[0].frequency);
+  // The Hann window loses at most 1.42 dB between two bins
+  TEST_ASSERT_FLOAT_WITHIN(0.16f, 1.0f, result.peaks[0].amplitude);
+}
+
+void testThatThePeaksAreSortedByAmplitude() {
+  // Fixture
+  addSine(samples, 1, 50.0f * BIN_WIDTH, 0.5f);
+  addSine(samples, 1, 90.0f * BIN_WIDTH, 1.5f);
+
+  // Test
+  spectrumAnalyze(&spectrum, samples, 1, &result);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 90.0f * BIN_WIDTH, result.peaks[0].frequency);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.5f, result.peaks[0].amplitude);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 50.0f * BIN_WIDTH, result.peaks[1].frequency);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f, result.peaks[1].amplitude);
+}
+
+void testThatPeaksBelowTheFirstBandAreIgnored() {
+  // Fixture
+  addSine(samples, 1, 2.0f * BIN_WIDTH, 3.0f);
+  addSine(samples, 1, 40.0f * BIN_WIDTH, 1.0f);
+
+  // Test
+  spectrumAnalyze(&spectrum, samples, 1, &result);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 40.0f * BIN_WIDTH, result.peaks[0].frequency);
+}
+
+void testThatOneAxisOfInterleavedSamplesIsAnalyzed() {
+  // Fixture
+  addSine(&samples[0], 3, 100.0f * BIN_WIDTH, 1.0f);
+  addSine(&samples[1], 3, 20.0f * BIN_WIDTH, 1.0f);
+
+  // Test
+  spectrumAnalyze(&spectrum, &samples[1], 3, &result);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 20.0f * BIN_WIDTH, result.peaks[0].frequency);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, result.peaks[1].amplitude);
+}
+
+// Helpers ------------------------------------------------
+
+static void addSine(float* destination, int stride, float frequency, float amplitude) {
+  for (int i = 0; i < SPECTRUM_SIZE; i++) {
+    destination[i * stride] += amplitude * sinf(2.0f * (float)M_PI * frequency * i / SAMPLE_RATE);
+  }
+}
@@ -0,0 +1,106 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * test_stageProfiler.c - unit tests for the stage profiler
+ */
+
+// File under test
+#include "stageProfiler.h"
+
+#include "unity.h"
+
+static stageProfiler_t sut;
+
+void setUp(void) {
+  stageProfilerInit(&sut, 100, 4);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatNothingIsPublishedBeforeWindowIsFull() {
+  // Fixture
+  // Test
+  stageProfilerAdd(&sut, 50);
+  stageProfilerAdd(&sut, 60);
+  stageProfilerAdd(&sut, 70);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(0, sut.latestMin);
+  TEST_ASSERT_EQUAL_UINT32(0, sut.latestMax);
+  TEST_ASSERT_EQUAL_UINT32(0, sut.latestMean);
+}
+
+void testThatMinMaxAndMeanArePublishedWhenWindowIsFull() {
+  // Fixture
+  // Test
+  stageProfilerAdd(&sut, 50);
+  stageProfilerAdd(&sut, 150);
+  stageProfilerAdd(&sut, 20);
+  stageProfilerAdd(&sut, 180);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(20, sut.latestMin);
+  TEST_ASSERT_EQUAL_UINT32(180, sut.latestMax);
+  TEST_ASSERT_EQUAL_UINT32(100, sut.latestMean);
+}
+
+void testThatSamplesAreSortedIntoDoublingBins() {
+  // Fixture
+  // Test
+  stageProfilerAdd(&sut, 99);
+  stageProfilerAdd(&sut, 100);
+  stageProfilerAdd(&sut, 399);
+  stageProfilerAdd(&sut, 1000000);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(1, sut.histogram[0]);
+  TEST_ASSERT_EQUAL_UINT16(1, sut.histogram[1]);
+  TEST_ASSERT_EQUAL_UINT16(1, sut.histogram[2]);
+  TEST_ASSERT_EQUAL_UINT16(0, sut.histogram[3]);
+  TEST_ASSERT_EQUAL_UINT16(0, sut.histogram[4]);
+  TEST_ASSERT_EQUAL_UINT16(1, sut.histogram[5]);
+}
+
+void testThatNewWindowStartsFromScratch() {
+  // Fixture
+  stageProfilerAdd(&sut, 1000);
+  stageProfilerAdd(&sut, 1000);
+  stageProfilerAdd(&sut, 1000);
+  stageProfilerAdd(&sut, 1000);
+
+  // Test
+  stageProfilerAdd(&sut, 10);
+  stageProfilerAdd(&sut, 10);
+  stageProfilerAdd(&sut, 10);
+  stageProfilerAdd(&sut, 30);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(10, sut.latestMin);
+  TEST_ASSERT_EQUAL_UINT32(30, sut.latestMax);
+  TEST_ASSERT_EQUAL_UINT32(15, sut.latestMean);
+  TEST_ASSERT_EQUAL_UINT16(4, sut.histogram[0]);
+  TEST_ASSERT_EQUAL_UINT16(0, sut.histogram[4]);
+}
@@ -0,0 +1,119 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * test_staticPool.c - unit tests for the static pool allocator
+ */
+
+// File under test
+#include "staticPool.h"
+
+#include "unity.h"
+#include "mock_cfassert.h"
+
+#define CAPACITY 4
+
+typedef struct {
+  uint32_t a;
+  uint8_t b;
+} object_t;
+
+static object_t objects[CAPACITY];
+static uint16_t freeStack[CAPACITY];
+static staticPool_t sut;
+
+void setUp(void) {
+  staticPoolInit(&sut, objects, sizeof(object_t), CAPACITY, freeStack);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatObjectsAreAllocatedInOrderFromAFreshPool() {
+  // Fixture
+  // Test
+  // Assert
+  for (int i = 0; i < CAPACITY; i++) {
+    TEST_ASSERT_EQUAL_PTR(&objects[i], staticPoolAlloc(&sut));
+  }
+}
+
+void testThatAllocFailsWhenThePoolIsEmpty() {
+  // Fixture
+  for (int i = 0; i < CAPACITY; i++) {
+    staticPoolAlloc(&sut);
+  }
+
+  // Test
+  void* actual = staticPoolAlloc(&sut);
+
+  // Assert
+  TEST_ASSERT_NULL(actual);
+  TEST_ASSERT_EQUAL_UINT32(1, sut.failures);
+}
+
+void testThatAFreedObjectIsReused() {
+  // Fixture
+  staticPoolAlloc(&sut);
+  object_t* object = staticPoolAlloc(&sut);
+  staticPoolAlloc(&sut);
+  staticPoolFree(&sut, object);
+
+  // Test
+  void* actual = staticPoolAlloc(&sut);
+
+  // Assert
+  TEST_ASSERT_EQUAL_PTR(object, actual);
+}
+
+void testThatTheHighWaterMarkIsKeptWhenObjectsAreFreed() {
+  // Fixture
+  object_t* object1 = staticPoolAlloc(&sut);
+  object_t* object2 = staticPoolAlloc(&sut);
+  object_t* object3 = staticPoolAlloc(&sut);
+
+  // Test
+  staticPoolFree(&sut, object2);
+  staticPoolFree(&sut, object1);
+  staticPoolFree(&sut, object3);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(0, sut.used);
+  TEST_ASSERT_EQUAL_UINT16(3, sut.highWater);
+}
+
+void testThatResetFreesAllObjects() {
+  // Fixture
+  for (int i = 0; i < CAPACITY; i++) {
+    staticPoolAlloc(&sut);
+  }
+
+  // Test
+  staticPoolReset(&sut);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(0, sut.used);
+  TEST_ASSERT_EQUAL_UINT16(CAPACITY, sut.highWater);
+  TEST_ASSERT_EQUAL_PTR(&objects[0], staticPoolAlloc(&sut));
+}
@@ -0,0 +1,141 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * test_tocHash.c - unit tests for the TOC hash index
+ */
+
+// File under test
+#include "tocHash.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+#define SLOTS 8
+
+typedef struct {
+  const char* group;
+  const char* name;
+} entry_t;
+
+static const entry_t toc[] = {
+  {"stabilizer", "roll"},
+  {"stabilizer", "pitch"},
+  {"stabilizer", "yaw"},
+  {"kalman", "roll"},
+  {"kalman", "stateX"},
+  {"kalman", "stateX"},
+};
+
+static uint16_t slots[SLOTS];
+static tocHash_t sut;
+
+static bool match(uint16_t index, const char* group, const char* name) {
+  return (strcmp(toc[index].group, group) == 0) && (strcmp(toc[index].name, name) == 0);
+}
+
+static void insertEntries(int count) {
+  for (int i = 0; i < count; i++) {
+    TEST_ASSERT_TRUE(tocHashInsert(&sut, tocHashName(toc[i].group, toc[i].name), i));
+  }
+}
+
+void setUp(void) {
+  memset(slots, 0xff, sizeof(slots));
+  tocHashInit(&sut, slots, SLOTS);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAllEntriesAreFound() {
+  // Fixture
+  insertEntries(5);
+
+  // Test
+  // Assert
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL_INT(i, tocHashFind(&sut, toc[i].group, toc[i].name, match));
+  }
+}
+
+void testThatAMissingEntryIsNotFound() {
+  // Fixture
+  insertEntries(5);
+
+  // Test
+  int actual = tocHashFind(&sut, "stabilizer", "thrust", match);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, actual);
+}
+
+void testThatTheGroupIsPartOfTheKey() {
+  // Fixture
+  insertEntries(5);
+
+  // Test
+  int actual = tocHashFind(&sut, "kalman", "pitch", match);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, actual);
+}
+
+void testThatTheFirstOfDuplicatedEntriesIsFound() {
+  // Fixture
+  insertEntries(6);
+
+  // Test
+  int actual = tocHashFind(&sut, "kalman", "stateX", match);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(4, actual);
+}
+
+void testThatInsertFailsWhenFull() {
+  // Fixture
+  for (int i = 0; i < SLOTS - 1; i++) {
+    TEST_ASSERT_TRUE(tocHashInsert(&sut, i, i));
+  }
+
+  // Test
+  bool actual = tocHashInsert(&sut, 0, SLOTS);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatFindTerminatesInAFullTable() {
+  // Fixture
+  for (int i = 0; i < SLOTS - 1; i++) {
+    TEST_ASSERT_TRUE(tocHashInsert(&sut, 0, i % 6));
+  }
+
+  // Test
+  int actual = tocHashFind(&sut, "stabilizer", "thrust", match);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, actual);
+}
@@ -0,0 +1,102 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * test_windowStats.c - unit tests for window statistics
+ */
+
+// File under test
+#include "windowStats.h"
+
+#include "unity.h"
+
+
+static windowStats_t window;
+
+void setUp(void) {
+  windowStatsInit(&window);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAnEmptyWindowHasZeroMeanAndVariance() {
+  // Fixture
+  // Test
+  float actualMean = windowStatsMean(&window);
+  float actualVariance = windowStatsVariance(&window);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actualMean);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, actualVariance);
+  TEST_ASSERT_FALSE(windowStatsIsFull(&window));
+}
+
+void testThatMeanAndVarianceAreComputedOnAPartialWindow() {
+  // Fixture
+  windowStatsAdd(&window, 1.0f);
+  windowStatsAdd(&window, 3.0f);
+
+  // Test
+  float actualMean = windowStatsMean(&window);
+  float actualVariance = windowStatsVariance(&window);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, actualMean);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, actualVariance);
+}
+
+void testThatTheOldestSamplesAreDroppedWhenTheWindowIsFull() {
+  // Fixture
+  for (int i = 0; i < WINDOW_STATS_SIZE; i++) {
+    windowStatsAdd(&window, 100.0f);
+  }
+
+  // Test
+  for (int i = 0; i < WINDOW_STATS_SIZE / 2; i++) {
+    windowStatsAdd(&window, 2.0f);
+    windowStatsAdd(&window, 4.0f);
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(windowStatsIsFull(&window));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 3.0f, windowStatsMean(&window));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, windowStatsVariance(&window));
+}
+
+void testThatRoundingErrorsDoNotBuildUp() {
+  // Fixture
+  for (int i = 0; i < 100000; i++) {
+    windowStatsAdd(&window, (i % 7) * 1000.0f + 0.1f);
+  }
+
+  // Test
+  for (int i = 0; i < WINDOW_STATS_SIZE; i++) {
+    windowStatsAdd(&window, 1.0f);
+  }
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(0.00001f, 1.0f, windowStatsMean(&window));
+  TEST_ASSERT_FLOAT_WITHIN(0.00001f, 0.0f, windowStatsVariance(&window));
+}
@@ -0,0 +1,6 @@
+# Performance profile for lighthouse systems with up to 8 base stations
+
+PROFILE_HELP_lighthouse-8bs = Lighthouse systems with up to 8 base stations
+
+# The sweep angle queue of the estimator is sized after the number of base stations
+LIGHTHOUSE_MAX_N_BS ?= 8
@@ -0,0 +1,8 @@
+# Performance profile for a single Crazyflie used for research: much telemetry over a dedicated radio
+
+PROFILE_HELP_research = Single Crazyflie research, more log blocks and tx buffers
+
+LOG_MAX_BLOCKS ?= 24
+LOG_MAX_OPS ?= 256
+CRTP_TX_LOG_QUEUE_SIZE ?= 72
+CRTP_TX_PARAM_MEM_QUEUE_SIZE ?= 40
@@ -0,0 +1,13 @@
+# Performance profile for swarms: many Crazyflies sharing the radio bandwidth, flying uploaded trajectories with
+# little telemetry per Crazyflie
+
+PROFILE_HELP_swarm = Swarms, fewer log blocks and tx buffers, more trajectory memory
+
+# Little logging per Crazyflie, the radio is shared
+LOG_MAX_BLOCKS ?= 8
+LOG_MAX_OPS ?= 64
+CRTP_TX_LOG_QUEUE_SIZE ?= 24
+CRTP_TX_PARAM_MEM_QUEUE_SIZE ?= 24
+
+# Room for the trajectories of a show
+TRAJECTORY_MEMORY_SIZE ?= 8192
@@ -1,6 +1,8 @@
 #!/usr/bin/env python
 
 import argparse
+import os
+import re
 import subprocess
 
 # Calls the size progeam and prints pretty memory usage
@@ -17,6 +19,66 @@ def check_output(*args):
         return result
 
 
+def parse_map(map_file):
+    """Sums the size of the RAM and CCM input sections per object file in a GNU ld map file.
+    Returns a dictionary of {output section: {object file: size}}.
+    """
+    usage = {'.data': {}, '.bss': {}, '.ccmdata': {}, '.ccmbss': {}}
+    output_section = None
+    input_section = None
+    in_memory_map = False
+
+    with open(map_file) as f:
+        for line in f:
+            if line.startswith('Linker script and memory map'):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+
+            # Output sections start in the first column
+            match = re.match(r'^(\.\S+)', line)
+            if match:
+                output_section = match.group(1) if match.group(1) in usage else None
+                input_section = None
+                continue
+
+            if output_section is None:
+                continue
+
+            # Input sections are indented by one space, long names are followed
+            # by the address, size and object file on the next line
+            match = re.match(r'^ (\.\S+|COMMON)(\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+))?', line)
+            if match:
+                input_section = match.group(1)
+                if match.group(2) is None:
+                    continue
+                size, obj = match.group(3), match.group(4)
+            else:
+                match = re.match(r'^\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+)', line)
+                if not match or input_section is None:
+                    continue
+                size, obj = match.group(1), match.group(2)
+                input_section = None
+
+            obj = os.path.basename(obj)
+            usage[output_section][obj] = usage[output_section].get(obj, 0) + int(size, 16)
+
+    return usage
+
+
+def print_top_users(usage, sections, title, count):
+    totals = {}
+    for section in sections:
+        for obj, size in usage[section].items():
+            totals[obj] = totals.get(obj, 0) + size
+
+    print("")
+    print(title)
+    for obj, size in sorted(totals.items(), key=lambda item: item[1], reverse=True)[:count]:
+        print("  {:7d} {}".format(size, obj))
+
+
 if __name__ == "__main__":
 
     parser = argparse.ArgumentParser()
@@ -25,6 +87,8 @@ if __name__ == "__main__":
     parser.add_argument("flash_size_k", help="size of the flash, in k bytes", type=int)
     parser.add_argument("ram_size_k", help="size of the RAM, in k bytes", type=int)
     parser.add_argument("ccm_size_k", help="size of the CCM, in k bytes", type=int)
+    parser.add_argument("--map", help="map file to list the largest RAM and CCM users from")
+    parser.add_argument("--top", help="number of object files to list", type=int, default=10)
     args = parser.parse_args()
 
     output = check_output([args.size_app, '-A', args.source])
@@ -52,3 +116,10 @@ if __name__ == "__main__":
     print("Flash | {:7d}/{:<7d} ({:2.0f}%), {:7d} free | text: {}, data: {}, ccmdata: {}".format(flash_used, flash_available, flash_fill, flash_free, sizes['.text'], sizes['.data'], sizes['.ccmdata']))
     print("RAM   | {:7d}/{:<7d} ({:2.0f}%), {:7d} free | bss: {}, data: {}".format(ram_used, ram_available, ram_fill, ram_free, sizes['.bss'], sizes['.data']))
     print("CCM   | {:7d}/{:<7d} ({:2.0f}%), {:7d} free | ccmbss: {}, ccmdata: {}".format(ccm_used, ccm_available, ccm_fill, ccm_free, sizes['.ccmbss'], sizes['.ccmdata']))
+
+    if args.map:
+        usage = parse_map(args.map)
+        # Data that is not used by DMA can be moved to CCM, the largest RAM
+        # users are the first candidates
+        print_top_users(usage, ['.bss', '.data'], "Largest RAM users (bss + data):", args.top)
+        print_top_users(usage, ['.ccmbss', '.ccmdata'], "Largest CCM users (ccmbss + ccmdata):", args.top)
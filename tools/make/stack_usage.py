@@ -0,0 +1,242 @@
+#!/usr/bin/env python
+
+import argparse
+import csv
+import os
+import re
+import sys
+
+# Worst case stack usage of the tasks, from the call graph and stack usage files of gcc
+# (-fstack-usage -fcallgraph-info=su), built with make STACK_USAGE=1
+
+# Frame pushed on the task stack by the context switch on the Cortex-M4F with the FPU in use: the exception frame
+# with the FPU registers (26 words), r4-r11 and lr (9 words) and s16-s31 (16 words). Interrupts run on the main stack.
+CONTEXT_SWITCH_BYTES = 51 * 4
+
+STACK_WORD_BYTES = 4
+
+INDIRECT_CALL = '__indirect_call'
+
+
+class Function:
+    def __init__(self, name, unit, size, qualifier):
+        self.name = name
+        self.unit = unit
+        self.size = size
+        self.qualifier = qualifier
+        self.callees = []
+
+
+class CallGraph:
+    def __init__(self):
+        # {name: [Function]}, static functions with the same name may be defined in several units
+        self.functions = {}
+
+    def add(self, function):
+        self.functions.setdefault(function.name, []).append(function)
+
+    def lookup(self, name, unit=None):
+        candidates = self.functions.get(name, [])
+        for function in candidates:
+            if function.unit == unit:
+                return function
+        return candidates[0] if candidates else None
+
+
+def parse_callgraph_info(files):
+    """Parses the VCG files of -fcallgraph-info=su, one per compilation unit."""
+    graph = CallGraph()
+    edges = []
+
+    node_re = re.compile(r'node:\s*{\s*title:\s*"([^"]+)"\s*label:\s*"([^"]*)"')
+    edge_re = re.compile(r'edge:\s*{\s*sourcename:\s*"([^"]+)"\s*targetname:\s*"([^"]+)"')
+    size_re = re.compile(r'\\n(\d+) bytes \(([^)]+)\)')
+
+    for file_name in files:
+        unit = os.path.splitext(file_name)[0]
+        with open(file_name) as f:
+            for line in f:
+                match = node_re.search(line)
+                if match:
+                    name, label = match.groups()
+                    size = size_re.search(label)
+                    # Nodes without a size are declarations of functions defined in other units
+                    if size:
+                        graph.add(Function(name, unit, int(size.group(1)), size.group(2)))
+                    continue
+
+                match = edge_re.search(line)
+                if match:
+                    edges.append((unit, match.group(1), match.group(2)))
+
+    for unit, source, target in edges:
+        caller = graph.lookup(source, unit)
+        if caller:
+            caller.callees.append(target)
+
+    return graph
+
+
+def worst_case(graph, function, cache, path):
+    """Returns (bytes, notes) of the deepest call chain from the function. The notes tell why the number may be too
+    low: recursion, indirect calls, dynamic stack allocation or calls to functions without stack information."""
+    key = (function.name, function.unit)
+    if key in cache:
+        return cache[key]
+
+    notes = set()
+    if function.qualifier != 'static':
+        notes.add('dynamic')
+
+    deepest = 0
+    path.add(key)
+    for callee_name in function.callees:
+        if callee_name == INDIRECT_CALL:
+            notes.add('indirect')
+            continue
+
+        callee = graph.lookup(callee_name, function.unit)
+        if callee is None:
+            notes.add('unknown:' + callee_name)
+            continue
+
+        if (callee.name, callee.unit) in path:
+            notes.add('recursion')
+            continue
+
+        size, callee_notes = worst_case(graph, callee, cache, path)
+        deepest = max(deepest, size)
+        notes |= callee_notes
+    path.discard(key)
+
+    cache[key] = (function.size + deepest, notes)
+    return cache[key]
+
+
+def parse_defines(files):
+    defines = {}
+    define_re = re.compile(r'^\s*#\s*define\s+(\w+)\s+(.+?)\s*(//.*)?$')
+    for file_name in files:
+        if not os.path.exists(file_name):
+            continue
+        with open(file_name) as f:
+            for line in f:
+                match = define_re.match(line)
+                if match and match.group(1) not in defines:
+                    defines[match.group(1)] = match.group(2)
+    return defines
+
+
+def evaluate(expression, defines, depth=0):
+    """Evaluates a stack depth expression with the macros in defines, None if it can not be evaluated."""
+    if depth > 10:
+        return None
+
+    expression = re.sub(r'\(\s*(unsigned\s+)?(short|int|long|uint16_t|uint32_t)\s*\)', '', expression)
+    tokens = re.findall(r'[A-Za-z_]\w*', expression)
+    for token in tokens:
+        if token not in defines:
+            return None
+        value = evaluate(defines[token], defines, depth + 1)
+        if value is None:
+            return None
+        expression = re.sub(r'\b' + token + r'\b', str(value), expression)
+
+    if not re.match(r'^[\d\s()+\-*/]+$', expression):
+        return None
+    return int(eval(expression.replace('/', '//')))
+
+
+def find_tasks(src_dir, config_files):
+    """Finds the tasks allocated with STATIC_MEM_TASK_ALLOC*() and created with STATIC_MEM_TASK_CREATE().
+    Returns a list of (task name, entry function, source file, stack depth in words)."""
+    alloc_re = re.compile(r'STATIC_MEM_TASK_ALLOC\w*\(\s*(\w+)\s*,\s*(.+)\)\s*;')
+    create_re = re.compile(r'STATIC_MEM_TASK_CREATE\(\s*(\w+)\s*,\s*(\w+)\s*,')
+
+    tasks = []
+    for root, dirs, files in os.walk(src_dir):
+        for file_name in sorted(files):
+            if not file_name.endswith('.c'):
+                continue
+            path = os.path.join(root, file_name)
+            with open(path) as f:
+                source = f.read()
+
+            allocs = alloc_re.findall(source)
+            if not allocs:
+                continue
+            entries = dict(create_re.findall(source))
+            defines = parse_defines([path] + config_files)
+            for name, depth in allocs:
+                tasks.append((name, entries.get(name, name), path, evaluate(depth, defines)))
+
+    return tasks
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Worst case stack usage of the tasks')
+    parser.add_argument('bin_dir', help='build directory with the .ci files, built with make STACK_USAGE=1')
+    parser.add_argument('--src', default='src', help='source directory to find the tasks in')
+    parser.add_argument('--context', type=int, default=CONTEXT_SWITCH_BYTES,
+                        help='bytes added for the context switch frame (default %(default)s)')
+    parser.add_argument('--csv', help='write the report to a CSV file')
+    parser.add_argument('-v', '--verbose', action='store_true', help='list the called functions without stack info')
+    args = parser.parse_args()
+
+    ci_files = []
+    for root, dirs, files in os.walk(args.bin_dir):
+        ci_files += [os.path.join(root, f) for f in files if f.endswith('.ci')]
+    if not ci_files:
+        sys.exit('No .ci files in {}, build with make STACK_USAGE=1 (gcc 10 or later)'.format(args.bin_dir))
+
+    graph = parse_callgraph_info(ci_files)
+    config_files = [os.path.join(args.src, 'config', 'config.h'), os.path.join(args.src, 'config', 'FreeRTOSConfig.h')]
+
+    rows = []
+    cache = {}
+    for name, entry, path, depth in find_tasks(args.src, config_files):
+        function = graph.lookup(entry, None)
+        for candidate in graph.functions.get(entry, []):
+            if os.path.basename(candidate.unit) == os.path.splitext(os.path.basename(path))[0]:
+                function = candidate
+        if function is None:
+            # Not built in this configuration
+            continue
+
+        used, notes = worst_case(graph, function, cache, set())
+        used += args.context
+        allocated = depth * STACK_WORD_BYTES if depth is not None else None
+        unknown = sorted(note.split(':', 1)[1] for note in notes if note.startswith('unknown:'))
+        notes = sorted(note for note in notes if not note.startswith('unknown:'))
+        if unknown:
+            notes.append('unknown:' + (','.join(unknown) if args.verbose else str(len(unknown))))
+        rows.append({
+            'task': name,
+            'entry': entry,
+            'used': used,
+            'allocated': allocated,
+            'margin': allocated - used if allocated is not None else None,
+            'notes': ' '.join(notes),
+        })
+
+    rows.sort(key=lambda row: row['margin'] if row['margin'] is not None else -sys.maxsize)
+
+    print('{:28} {:>9} {:>9} {:>9}  {}'.format('Task', 'Used', 'Allocated', 'Margin', 'Notes'))
+    for row in rows:
+        allocated = row['allocated'] if row['allocated'] is not None else '?'
+        margin = row['margin'] if row['margin'] is not None else '?'
+        print('{:28} {:>9} {:>9} {:>9}  {}'.format(row['task'], row['used'], allocated, margin, row['notes']))
+    print()
+    print('Bytes, including {} bytes for the context switch. The used stack is a lower bound for tasks with notes:'
+          .format(args.context))
+    print('indirect calls, recursion, dynamic allocation (alloca, VLA) or calls to functions without stack info.')
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=['task', 'entry', 'used', 'allocated', 'margin', 'notes'])
+            writer.writeheader()
+            writer.writerows(rows)
+
+
+if __name__ == '__main__':
+    main()
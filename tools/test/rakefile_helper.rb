@@ -196,6 +196,18 @@ module RakefileHelpers
     run_tests(test_files, defines, output_style)
   end
 
+  # Run the benchmarks, the test files that are only built when a *_BENCHMARK define is given
+  def parse_and_run_benchmarks(args)
+    defines = find_defines_in_args(args)
+    output_style = find_output_style_in_args(args)
+
+    set_environment_vars($cfg['env'])
+
+    test_files = get_unit_test_files().select {|file| annotation_benchmark_file?(file)}
+
+    run_tests(test_files, defines, output_style)
+  end
+
   def run_tests(test_files, defines, output_style)
     report 'Running system tests...'
 
@@ -422,4 +434,8 @@ module RakefileHelpers
       ENV[key] = val
     end
   end
+
+  def annotation_benchmark_file?(file)
+    File.foreach(file).any? {|line| line =~ /@IGNORE_IF_NOT\s+\w+_BENCHMARK\b/}
+  end
 end
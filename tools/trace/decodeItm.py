@@ -32,13 +32,14 @@ if len(sys.argv) < 2:
 
 trace = open(sys.argv[1], "rb")
 
-# OS messages
-OS_MASK = 0xFF00
+# OS messages, see src/config/trace.h
+OS_SHIFT = 24
 OS_MESSAGES = {
-    0x0100: "ITM_QUEUE_SEND",
-    0x0200: "QUEUE_FAILED",
-    0x0300: "BLOCKING_ON_QUEUE_RECEIVE",
-    0x0400: "BLOCKING_ON_QUEUE_SEND"
+    0x01: "ITM_QUEUE_SEND",
+    0x02: "QUEUE_FAILED",
+    0x03: "BLOCKING_ON_QUEUE_RECEIVE",
+    0x04: "BLOCKING_ON_QUEUE_SEND",
+    0x05: "QUEUE_RECEIVE",
 }
 
 # Decoding...
@@ -93,7 +94,11 @@ try:
                 if a == 2:
                     info = "\t# Systick: 0x{:04x}".format(data)
                 if a == 3:
-                    info = "\t\t# OS {} {}".format(OS_MESSAGES[data&OS_MASK], data & (~OS_MASK))
+                    info = "\t\t# OS {} {}".format(OS_MESSAGES.get(data >> OS_SHIFT, "?"), data & 0xffffff)
+                if a == 4:
+                    info = "\t# Task out: " + struct.pack("<L", data).decode('utf8')
+                if a == 5:
+                    info = "\t# Marker {} {}".format(data >> 8, data & 0xff)
                 print("ITM {} {} {}".format(a, data_str, info))
             else:                # DWT/HW
                 if a == 1:
@@ -0,0 +1,415 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * itmtrace.c - converts an ITM/SWO trace to a Chrome trace and a per task summary
+ *
+ * A faster alternative to decodeItm.py for long captures. Build with
+ *
+ *   gcc -O2 -o itmtrace itmtrace.c
+ *
+ * and run as "itmtrace trace.out [trace.json] [core clock in Hz]". The trace is captured with enable_trace.cfg, the
+ * events are described in src/config/trace.h. The JSON file can be opened in chrome://tracing or Perfetto, it has one
+ * row per task, one for the interrupts and one for the stages of the stabilizer loop. The time spent in each task and
+ * interrupt is printed on stdout.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stimulus ports, see src/config/trace.h
+#define PORT_TASK_IN  1
+#define PORT_TICK     2
+#define PORT_QUEUE    3
+#define PORT_TASK_OUT 4
+#define PORT_MARKER   5
+
+#define MARKER_GROUP_STABILIZER 0x01
+#define MARKER_STABILIZER_LOOP_START 0xff
+
+// Hardware source of the DWT exception trace
+#define DWT_EXCEPTION_TRACE 1
+
+#define MAX_TASKS 64
+#define MAX_INTERRUPTS 256
+#define MAX_PENDING 256
+#define MAX_NESTING 16
+
+#define TID_INTERRUPTS 1
+#define TID_STAGES 2
+#define TID_FIRST_TASK 10
+
+// Matches stabilizerStage_t in stabilizer.c
+static const char* stageNames[] = {
+  "sensors", "estimator", "commander", "collisionAvoidance", "controller", "powerDistribution", "appHooks",
+  "usdLogging",
+};
+#define STAGE_COUNT (sizeof(stageNames) / sizeof(stageNames[0]))
+
+static const char* queueEventNames[] = {
+  "?", "send", "sendFailed", "blockOnReceive", "blockOnSend", "receive",
+};
+
+typedef struct {
+  char name[5];
+  uint64_t totalCycles;
+  uint64_t maxCycles;
+  uint32_t count;
+} timeStats_t;
+
+typedef struct {
+  uint8_t port;
+  uint8_t isHardware;
+  uint32_t data;
+} itmEvent_t;
+
+static timeStats_t tasks[MAX_TASKS];
+static int numTasks;
+static timeStats_t interrupts[MAX_INTERRUPTS];
+
+// Decoder state
+static itmEvent_t pending[MAX_PENDING];
+static int numPending;
+static uint64_t now;
+static uint64_t firstTime;
+static bool hasFirstTime;
+static uint32_t overflows;
+static uint32_t lostEvents;
+
+static int currentTask = -1;
+static uint64_t currentTaskStart;
+static uint16_t interruptStack[MAX_NESTING];
+static uint64_t interruptStart[MAX_NESTING];
+static int interruptDepth;
+static bool hasStageStart;
+static uint64_t stageStart;
+
+static FILE* json;
+static bool isFirstJsonEvent = true;
+static double cyclesPerUs = 168.0;
+
+static double toUs(uint64_t cycles) {
+  return (cycles - firstTime) / cyclesPerUs;
+}
+
+static void jsonEvent(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+static void jsonEvent(const char* format, ...) {
+  if (!json) {
+    return;
+  }
+
+  fputs(isFirstJsonEvent ? "\n" : ",\n", json);
+  isFirstJsonEvent = false;
+
+  va_list args;
+  va_start(args, format);
+  vfprintf(json, format, args);
+  va_end(args);
+}
+
+static void jsonSlice(const char* name, int tid, uint64_t start, uint64_t end) {
+  jsonEvent("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+    name, tid, toUs(start), (end - start) / cyclesPerUs);
+}
+
+static void jsonThreadName(int tid, const char* name) {
+  jsonEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, name);
+}
+
+static void addTime(timeStats_t* stats, uint64_t cycles) {
+  stats->totalCycles += cycles;
+  stats->count++;
+  if (cycles > stats->maxCycles) {
+    stats->maxCycles = cycles;
+  }
+}
+
+// The task name is the first 4 characters of the FreeRTOS task name, up to the first invalid character
+static int findTask(uint32_t data) {
+  char name[5] = {0};
+  for (int i = 0; i < 4; i++) {
+    const char c = (data >> (8 * i)) & 0xff;
+    if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+      break;
+    }
+    name[i] = c;
+  }
+
+  for (int i = 0; i < numTasks; i++) {
+    if (strcmp(tasks[i].name, name) == 0) {
+      return i;
+    }
+  }
+
+  if (numTasks == MAX_TASKS) {
+    return -1;
+  }
+
+  strcpy(tasks[numTasks].name, name);
+  jsonThreadName(TID_FIRST_TASK + numTasks, name);
+  return numTasks++;
+}
+
+static void endTask(uint64_t time) {
+  if (currentTask >= 0) {
+    addTime(&tasks[currentTask], time - currentTaskStart);
+    jsonSlice(tasks[currentTask].name, TID_FIRST_TASK + currentTask, currentTaskStart, time);
+    currentTask = -1;
+  }
+}
+
+static void interruptName(uint16_t exception, char* name, size_t size) {
+  switch (exception) {
+    case 11: snprintf(name, size, "SVCall"); break;
+    case 14: snprintf(name, size, "PendSV"); break;
+    case 15: snprintf(name, size, "SysTick"); break;
+    default:
+      if (exception >= 16) {
+        snprintf(name, size, "IRQ %d", exception - 16);
+      } else {
+        snprintf(name, size, "Exception %d", exception);
+      }
+      break;
+  }
+}
+
+static void handleException(uint32_t data, uint64_t time) {
+  const uint16_t exception = data & 0x1ff;
+  const int function = (data >> 12) & 0x3;
+
+  if (function == 1) {
+    // Entry
+    if (interruptDepth < MAX_NESTING) {
+      interruptStack[interruptDepth] = exception;
+      interruptStart[interruptDepth] = time;
+    }
+    interruptDepth++;
+  } else if (function == 2) {
+    // Exit
+    if (interruptDepth > 0) {
+      interruptDepth--;
+      if (interruptDepth < MAX_NESTING && interruptStack[interruptDepth] == exception) {
+        char name[32];
+        interruptName(exception, name, sizeof(name));
+        addTime(&interrupts[exception % MAX_INTERRUPTS], time - interruptStart[interruptDepth]);
+        jsonSlice(name, TID_INTERRUPTS, interruptStart[interruptDepth], time);
+      }
+    }
+  } else if (function == 3 && exception == 0) {
+    // Returned to thread mode, anything still open was lost
+    interruptDepth = 0;
+  }
+}
+
+static void handleEvent(const itmEvent_t* event, uint64_t time) {
+  if (event->isHardware) {
+    if (event->port == DWT_EXCEPTION_TRACE) {
+      handleException(event->data, time);
+    }
+    return;
+  }
+
+  switch (event->port) {
+    case PORT_TASK_IN: {
+      endTask(time);
+      currentTask = findTask(event->data);
+      currentTaskStart = time;
+      break;
+    }
+    case PORT_TASK_OUT:
+      endTask(time);
+      break;
+    case PORT_QUEUE: {
+      const uint8_t queueEvent = event->data >> 24;
+      const char* name = queueEvent < sizeof(queueEventNames) / sizeof(queueEventNames[0]) ? queueEventNames[queueEvent] : "?";
+      const int tid = currentTask >= 0 ? TID_FIRST_TASK + currentTask : TID_INTERRUPTS;
+      jsonEvent("{\"name\":\"%s 0x%04x\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+        name, event->data & 0xffffff, tid, toUs(time));
+      break;
+    }
+    case PORT_MARKER: {
+      const uint8_t group = event->data >> 8;
+      const uint8_t value = event->data & 0xff;
+      if (group == MARKER_GROUP_STABILIZER) {
+        if (value != MARKER_STABILIZER_LOOP_START && hasStageStart && value < STAGE_COUNT) {
+          jsonSlice(stageNames[value], TID_STAGES, stageStart, time);
+        }
+        stageStart = time;
+        hasStageStart = true;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+// The events before a local timestamp happened at the time of the timestamp
+static void flushPending() {
+  if (!hasFirstTime) {
+    firstTime = now;
+    hasFirstTime = true;
+  }
+
+  for (int i = 0; i < numPending; i++) {
+    handleEvent(&pending[i], now);
+  }
+  numPending = 0;
+}
+
+static void addPending(uint8_t port, uint8_t isHardware, uint32_t data) {
+  if (numPending == MAX_PENDING) {
+    lostEvents++;
+    return;
+  }
+
+  pending[numPending].port = port;
+  pending[numPending].isHardware = isHardware;
+  pending[numPending].data = data;
+  numPending++;
+}
+
+static int readByte(FILE* file) {
+  return fgetc(file);
+}
+
+// Skips the payload of a packet where bit 7 of each byte is the continuation bit, returns the 7 bit groups
+static uint64_t readContinued(FILE* file, int header) {
+  uint64_t value = 0;
+  int shift = 0;
+  int b = header;
+  while ((b & 0x80) != 0) {
+    b = readByte(file);
+    if (b == EOF) {
+      break;
+    }
+    if (shift < 64) {
+      value |= (uint64_t)(b & 0x7f) << shift;
+    }
+    shift += 7;
+  }
+  return value;
+}
+
+static void decode(FILE* file) {
+  int b;
+  while ((b = readByte(file)) != EOF) {
+    if (b == 0x00 || b == 0x80) {
+      // Synchronization
+    } else if (b == 0x70) {
+      overflows++;
+    } else if ((b & 0x0f) == 0x00) {
+      // Local timestamp, the delta is in the header or in the payload
+      if (b & 0x80) {
+        now += readContinued(file, b);
+      } else {
+        now += (b >> 4) & 0x07;
+      }
+      flushPending();
+    } else if ((b & 0x0b) == 0x08) {
+      // Extension
+      readContinued(file, b);
+    } else if ((b & 0xdf) == 0x94) {
+      // Global timestamp
+      readContinued(file, b);
+    } else if ((b & 0x03) != 0) {
+      // Source packet
+      const int size = (b & 0x03) == 3 ? 4 : (b & 0x03);
+      uint32_t data = 0;
+      for (int i = 0; i < size; i++) {
+        const int d = readByte(file);
+        if (d == EOF) {
+          return;
+        }
+        data |= (uint32_t)d << (8 * i);
+      }
+      addPending(b >> 3, (b & 0x04) != 0, data);
+    }
+  }
+}
+
+static void printStats(const char* name, const timeStats_t* stats, uint64_t duration) {
+  printf("%-12s %10.1f %6.2f %8u %10.1f\n", name, stats->totalCycles / cyclesPerUs,
+    duration ? 100.0 * stats->totalCycles / duration : 0.0, stats->count, stats->maxCycles / cyclesPerUs);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <raw trace> [<json file>] [<core clock in Hz>]\n", argv[0]);
+    return 1;
+  }
+
+  FILE* file = fopen(argv[1], "rb");
+  if (!file) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  if (argc > 2) {
+    json = fopen(argv[2], "w");
+    if (!json) {
+      perror(argv[2]);
+      fclose(file);
+      return 1;
+    }
+    fputs("{\"traceEvents\":[", json);
+  }
+
+  if (argc > 3) {
+    cyclesPerUs = atof(argv[3]) / 1e6;
+  }
+
+  jsonThreadName(TID_INTERRUPTS, "Interrupts");
+  jsonThreadName(TID_STAGES, "Stabilizer stages");
+
+  decode(file);
+  flushPending();
+  endTask(now);
+  fclose(file);
+
+  if (json) {
+    fputs("\n],\"displayTimeUnit\":\"ns\"}\n", json);
+    fclose(json);
+  }
+
+  const uint64_t duration = now - firstTime;
+  printf("Duration %.1f us, %u overflows, %u events lost\n\n", duration / cyclesPerUs, overflows, lostEvents);
+  printf("%-12s %10s %6s %8s %10s\n", "Name", "Total us", "%", "Count", "Max us");
+  for (int i = 0; i < numTasks; i++) {
+    printStats(tasks[i].name, &tasks[i], duration);
+  }
+  for (int i = 0; i < MAX_INTERRUPTS; i++) {
+    if (interrupts[i].count > 0) {
+      char name[32];
+      interruptName(i, name, sizeof(name));
+      printStats(name, &interrupts[i], duration);
+    }
+  }
+
+  return 0;
+}
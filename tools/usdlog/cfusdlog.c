@@ -0,0 +1,325 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * cfusdlog.c - converts uSD deck log files to one CSV file per event
+ *
+ * A faster alternative to cfusdlog.py for large numbers of logs. Build with
+ *
+ *   gcc -O2 -I../../src/utils/interface -o cfusdlog cfusdlog.c ../../src/utils/src/columnBlock.c
+ *
+ * and run as "cfusdlog log00 log01 ...". The events of log00 are written to
+ * log00_<event name>.csv. Supports the file versions 1 and 2 (one record per
+ * sample) and 3 (column oriented blocks).
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "columnBlock.h"
+#include "crc32.h"
+
+#define MAX_EVENTS 64
+#define MAX_VARIABLES 256
+#define MAX_NAME 64
+#define MAX_ROWS 65535
+
+typedef struct {
+  uint16_t id;
+  char name[MAX_NAME];
+  int numVariables;
+  char names[MAX_VARIABLES][MAX_NAME];
+  char format[MAX_VARIABLES + 1];
+  uint16_t rowSize;
+  FILE* csv;
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static int numEvents;
+static uint8_t rows[MAX_ROWS * 8];
+
+// The firmware uses the same CRC32 as zlib
+uint32_t crc32CalculateBuffer(const void* buffer, size_t size) {
+  static uint32_t table[256];
+  if (table[1] == 0) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+  }
+
+  const uint8_t* data = buffer;
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+static uint32_t readUint(const uint8_t* data, int size) {
+  uint32_t value = 0;
+  for (int i = size - 1; i >= 0; i--) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+static event_t* findEvent(uint16_t id) {
+  for (int i = 0; i < numEvents; i++) {
+    if (events[i].id == id) {
+      return &events[i];
+    }
+  }
+  return 0;
+}
+
+// Copies a NUL terminated string, returns the number of bytes used or 0 on error
+static size_t readName(const uint8_t* data, size_t length, char* name) {
+  size_t i = 0;
+  while (i < length && data[i] != 0) {
+    if (i < MAX_NAME - 1) {
+      name[i] = data[i];
+    }
+    i++;
+  }
+  if (i == length) {
+    return 0;
+  }
+  name[i < MAX_NAME - 1 ? i : MAX_NAME - 1] = 0;
+  return i + 1;
+}
+
+static void writeRow(event_t* event, const uint8_t* row, double timestampScale, int timestampSize) {
+  uint64_t timestamp = 0;
+  for (int i = timestampSize - 1; i >= 0; i--) {
+    timestamp = (timestamp << 8) | row[i];
+  }
+  fprintf(event->csv, "%.3f", timestamp * timestampScale);
+
+  const uint8_t* value = row + timestampSize;
+  for (const char* type = event->format; *type; type++) {
+    switch (*type) {
+      case 'B': fprintf(event->csv, ",%u", (unsigned)value[0]); value += 1; break;
+      case 'b': fprintf(event->csv, ",%d", (int8_t)value[0]); value += 1; break;
+      case 'H': fprintf(event->csv, ",%u", (unsigned)readUint(value, 2)); value += 2; break;
+      case 'h': fprintf(event->csv, ",%d", (int16_t)readUint(value, 2)); value += 2; break;
+      case 'I': fprintf(event->csv, ",%u", readUint(value, 4)); value += 4; break;
+      case 'i': fprintf(event->csv, ",%d", (int32_t)readUint(value, 4)); value += 4; break;
+      default: {
+        float f;
+        memcpy(&f, value, sizeof(f));
+        fprintf(event->csv, ",%.9g", f);
+        value += 4;
+      }
+    }
+  }
+  fprintf(event->csv, "\n");
+}
+
+static int openCsvFiles(const char* filename) {
+  for (int i = 0; i < numEvents; i++) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s_%s.csv", filename, events[i].name);
+    events[i].csv = fopen(path, "w");
+    if (!events[i].csv) {
+      perror(path);
+      return EIO;
+    }
+    fprintf(events[i].csv, "timestamp");
+    for (int j = 0; j < events[i].numVariables; j++) {
+      fprintf(events[i].csv, ",%s", events[i].names[j]);
+    }
+    fprintf(events[i].csv, "\n");
+  }
+  return 0;
+}
+
+static void closeCsvFiles(void) {
+  for (int i = 0; i < numEvents; i++) {
+    if (events[i].csv) {
+      fclose(events[i].csv);
+      events[i].csv = 0;
+    }
+  }
+}
+
+// Timestamps are in ms in version 1 and in us in later versions, the CSV files use ms
+static int decodeRecords(const uint8_t* data, size_t length, uint16_t version) {
+  const int timestampSize = (version == 1) ? 4 : 8;
+  const double timestampScale = (version == 1) ? 1.0 : 0.001;
+  size_t index = 0;
+
+  while (index + 2 + timestampSize <= length) {
+    event_t* event = findEvent(readUint(&data[index], 2));
+    if (!event) {
+      return EINVAL;
+    }
+    index += 2;
+    const size_t recordSize = timestampSize + event->rowSize - 8;
+    if (index + recordSize > length) {
+      return EINVAL;
+    }
+    writeRow(event, &data[index], timestampScale, timestampSize);
+    index += recordSize;
+  }
+
+  return (index == length) ? 0 : EINVAL;
+}
+
+static int decodeBlocks(const uint8_t* data, size_t length) {
+  size_t index = 0;
+  int badBlocks = 0;
+
+  while (index < length) {
+    columnBlockHeader_t header;
+    if (columnBlockParseHeader(&data[index], length - index, &header) != 0) {
+      return EINVAL;
+    }
+    event_t* event = findEvent(header.eventId);
+    if (!event || columnBlockDecode(&data[index], &header, event->format, rows, sizeof(rows) / event->rowSize) != 0) {
+      badBlocks++;
+    } else {
+      for (int i = 0; i < header.numRows; i++) {
+        writeRow(event, &rows[i * event->rowSize], 0.001, 8);
+      }
+    }
+    index += COLUMN_BLOCK_HEADER_SIZE + header.bodySize + COLUMN_BLOCK_CRC_SIZE;
+  }
+
+  if (badBlocks) {
+    fprintf(stderr, "%d blocks could not be decoded\n", badBlocks);
+  }
+  return 0;
+}
+
+static int decodeFile(const char* filename) {
+  FILE* file = fopen(filename, "rb");
+  if (!file) {
+    perror(filename);
+    return EIO;
+  }
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t* data = malloc(length > 0 ? length : 1);
+  if (!data || fread(data, 1, length, file) != (size_t)length) {
+    fclose(file);
+    free(data);
+    return EIO;
+  }
+  fclose(file);
+
+  int result = EINVAL;
+  if (length < 9 || data[0] != 0xBC) {
+    fprintf(stderr, "%s: unsupported format\n", filename);
+    goto out;
+  }
+
+  if (crc32CalculateBuffer(data, length - 4) != readUint(&data[length - 4], 4)) {
+    fprintf(stderr, "%s: WARNING: CRC does not match\n", filename);
+  }
+
+  const uint16_t version = readUint(&data[1], 2);
+  if (version < 1 || version > 3) {
+    fprintf(stderr, "%s: unsupported version %d\n", filename, version);
+    goto out;
+  }
+
+  // Header with the event and variable definitions
+  numEvents = readUint(&data[3], 2);
+  if (numEvents > MAX_EVENTS) {
+    goto badHeader;
+  }
+  size_t index = 5;
+  const size_t end = length - 4;
+  for (int i = 0; i < numEvents; i++) {
+    event_t* event = &events[i];
+    if (index + 2 > end) goto badHeader;
+    event->id = readUint(&data[index], 2);
+    index += 2;
+    size_t used = readName(&data[index], end - index, event->name);
+    if (!used || index + used + 2 > end) goto badHeader;
+    index += used;
+    event->numVariables = readUint(&data[index], 2);
+    index += 2;
+    if (event->numVariables > MAX_VARIABLES) goto badHeader;
+
+    // Variables are stored as "name(t)"
+    for (int j = 0; j < event->numVariables; j++) {
+      char* name = event->names[j];
+      used = readName(&data[index], end - index, name);
+      size_t nameLength = strlen(name);
+      if (!used || nameLength < 3) goto badHeader;
+      index += used;
+      event->format[j] = name[nameLength - 2];
+      name[nameLength - 3] = 0;
+    }
+    event->format[event->numVariables] = 0;
+    event->rowSize = columnBlockRowSize(event->format);
+    if (event->rowSize == 0) goto badHeader;
+  }
+
+  result = openCsvFiles(filename);
+  if (result == 0) {
+    if (version == 3) {
+      result = decodeBlocks(&data[index], end - index);
+    } else {
+      result = decodeRecords(&data[index], end - index, version);
+    }
+    if (result != 0) {
+      fprintf(stderr, "%s: corrupt data\n", filename);
+    }
+  }
+  closeCsvFiles();
+
+out:
+  free(data);
+  return result;
+
+badHeader:
+  fprintf(stderr, "%s: corrupt header\n", filename);
+  free(data);
+  return EINVAL;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <log file> [<log file> ...]\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    if (decodeFile(argv[i]) != 0) {
+      failed++;
+    }
+  }
+
+  return failed ? 1 : 0;
+}
@@ -14,6 +14,51 @@ def _get_name(data, idx):
         endIdx = endIdx + 1
     return data[idx:endIdx].decode("utf-8"), endIdx + 1
 
+# decode count zigzag varints starting at idx, returns the values and the index after them
+def _decode_varints(data, idx, count):
+    if count == 0:
+        return np.zeros(0, dtype=np.int64), idx
+    region = np.frombuffer(data, dtype=np.uint8, count=min(len(data) - idx, 10 * count), offset=idx)
+    ends = np.flatnonzero(region < 0x80)
+    if len(ends) < count:
+        raise ValueError("Truncated block")
+    ends = ends[:count]
+    starts = np.concatenate(([0], ends[:-1] + 1))
+    used = region[:ends[-1] + 1].astype(np.uint64)
+    # position of each byte within its varint
+    shift = np.arange(len(used)) - np.repeat(starts, ends - starts + 1)
+    parts = (used & np.uint64(0x7f)) << (np.uint64(7) * shift.astype(np.uint64))
+    values = np.add.reduceat(parts, starts)
+    # zigzag decode
+    values = (values >> np.uint64(1)).astype(np.int64) ^ -(values & np.uint64(1)).astype(np.int64)
+    return values, idx + ends[-1] + 1
+
+# decode a column oriented block (version 3), see columnBlock.c in the firmware
+def _decode_block(data, idx, event_by_id, result):
+    event_id, num_rows, body_size = struct.unpack('<HHH', data[idx:idx+6])
+    block_end = idx + 6 + body_size
+    expected_crc, = struct.unpack('<I', data[block_end:block_end+4])
+    if crc32(data[idx:block_end]) != expected_crc:
+        print("WARNING: Skipping block with invalid CRC!")
+        return block_end + 4
+
+    event = event_by_id[event_id]
+    columns = result[event['name']]
+    pos = idx + 6
+
+    deltas, pos = _decode_varints(data, pos, num_rows)
+    columns["timestamp"].append(np.cumsum(deltas) / 1000.0)
+
+    for var_name, var_type in zip(event['variables'], event['fmtStr'][1:]):
+        if var_type == 'f':
+            columns[var_name].append(np.frombuffer(data, dtype='<f4', count=num_rows, offset=pos))
+            pos += 4 * num_rows
+        else:
+            deltas, pos = _decode_varints(data, pos, num_rows)
+            columns[var_name].append(np.cumsum(deltas).astype(np.dtype(var_type)))
+
+    return block_end + 4
+
 def decode(filename):
     # read file as binary
     with open(filename, 'rb') as f:
@@ -32,7 +77,7 @@ def decode(filename):
 
     # check version
     version, num_event_types = struct.unpack('HH', data[1:5])
-    if version != 1 and version != 2:
+    if version != 1 and version != 2 and version != 3:
         print("Unsupported version!", version)
         return
 
@@ -65,7 +110,18 @@ def decode(filename):
             'variables': variables,
             }
 
-    while idx < len(data) - 4:
+    if version == 3:
+        for event_name in result.keys():
+            for var_name in result[event_name]:
+                result[event_name][var_name] = []
+        while idx < len(data) - 4:
+            idx = _decode_block(data, idx, event_by_id, result)
+        for event_name in result.keys():
+            for var_name in result[event_name]:
+                result[event_name][var_name] = np.concatenate(result[event_name][var_name]) \
+                    if result[event_name][var_name] else np.zeros(0)
+
+    while version != 3 and idx < len(data) - 4:
         if version == 1:
             event_id, timestamp, = struct.unpack('<HI', data[idx:idx+6])
             idx += 6
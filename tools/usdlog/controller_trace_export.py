@@ -0,0 +1,59 @@
+# -*- coding: utf-8 -*-
+"""
+Export a uSD log to a trace for the controller benchmark in
+test/modules/src/test_controller_benchmark.c
+
+The log should be recorded with the fixed frequency configuration in
+config_controller.txt. The yaw setpoint is not logged (ctrltarget.yaw is the
+yaw rate), it is set with --yaw.
+"""
+import argparse
+import cfusdlog
+
+SETPOINT_COLUMNS = ['ctrltarget.x', 'ctrltarget.y', 'ctrltarget.z',
+                    'ctrltarget.vx', 'ctrltarget.vy', 'ctrltarget.vz',
+                    'ctrltarget.ax', 'ctrltarget.ay', 'ctrltarget.az']
+
+STATE_COLUMNS = ['stateEstimate.x', 'stateEstimate.y', 'stateEstimate.z',
+                 'stateEstimate.vx', 'stateEstimate.vy', 'stateEstimate.vz',
+                 'stateEstimate.ax', 'stateEstimate.ay', 'stateEstimate.az',
+                 'stateEstimate.roll', 'stateEstimate.pitch', 'stateEstimate.yaw',
+                 'stateEstimate.qx', 'stateEstimate.qy', 'stateEstimate.qz', 'stateEstimate.qw',
+                 'gyro.x', 'gyro.y', 'gyro.z']
+
+
+def export(logData, yaw):
+    if 'fixedFrequency' not in logData:
+        raise Exception("No fixedFrequency data in the log")
+
+    data = logData['fixedFrequency']
+    missing = [c for c in SETPOINT_COLUMNS + STATE_COLUMNS if c not in data]
+    if missing:
+        raise Exception("Missing log variables {}".format(missing))
+
+    # The stabilizer runs at 1 kHz, the timestamp in ms is used as the tick
+    lines = []
+    for i, t in enumerate(data['timestamp']):
+        setpoint = [data[c][i] for c in SETPOINT_COLUMNS] + [yaw]
+        state = [data[c][i] for c in STATE_COLUMNS]
+        lines.append(' '.join([str(int(t))] + [str(v) for v in setpoint + state]))
+
+    return lines
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("filename", help="uSD log file")
+    parser.add_argument("output", help="trace file to write")
+    parser.add_argument("--yaw", type=float, default=0.0, help="yaw setpoint (deg)")
+    args = parser.parse_args()
+
+    logData = cfusdlog.decode(args.filename)
+    lines = export(logData, args.yaw)
+
+    with open(args.output, 'w') as f:
+        f.write("# Controller trace exported from {}\n".format(args.filename))
+        for line in lines:
+            f.write(line + "\n")
+
+    print("Wrote {} records to {}".format(len(lines), args.output))
@@ -0,0 +1,83 @@
+# -*- coding: utf-8 -*-
+"""
+Export a uSD log to a measurement stream for the kalman replay benchmark in
+test/modules/src/kalman_core/test_kalman_core_replay.c
+
+The log should be recorded with the event based configuration in
+config_kalman.txt, and a fixed frequency log of stateEstimate.x/y/z (or any
+other position given with --ref) that is used as the reference for the
+accuracy.
+"""
+import argparse
+import cfusdlog
+
+POS_STD_DEV = 0.01
+POSE_QUAT_STD_DEV = 4.5e-3
+TOF_STD_DEV = 0.02
+
+
+def _records(logData, eventName, fmt, columns):
+    if eventName not in logData:
+        return []
+
+    event = logData[eventName]
+    if not all(c in event for c in columns):
+        print("Skipping {}, missing some of {}".format(eventName, columns))
+        return []
+
+    result = []
+    for i, t in enumerate(event['timestamp']):
+        values = [event[c][i] for c in columns]
+        result.append((t, fmt.format(t, *values)))
+    return result
+
+
+def export(logData, refPrefix):
+    records = []
+    records += _records(logData, 'estAcceleration', 'acc {} {} {} {}', ['acc.x', 'acc.y', 'acc.z'])
+    records += _records(logData, 'estGyroscope', 'gyro {} {} {} {}', ['gyro.x', 'gyro.y', 'gyro.z'])
+    records += _records(logData, 'estBarometer', 'baro {} {}', ['baro.asl'])
+    records += _records(logData, 'estTOF', 'tof {} {} ' + str(TOF_STD_DEV), ['range.zrange'])
+    records += _records(logData, 'estYawError', 'yaw {} {} 0.01', ['yawError'])
+
+    # The position can come from the location service or lighthouse
+    for prefix in ['locSrv', 'lighthouse']:
+        columns = [prefix + '.x', prefix + '.y', prefix + '.z']
+        if 'estPosition' in logData and all(c in logData['estPosition'] for c in columns):
+            records += _records(logData, 'estPosition', 'pos {} {} {} {} ' + str(POS_STD_DEV), columns)
+            break
+
+    records += _records(logData, 'estPose', 'pose {} {} {} {} {} {} {} {} ' + str(POS_STD_DEV) + ' ' + str(POSE_QUAT_STD_DEV),
+                        ['locSrv.x', 'locSrv.y', 'locSrv.z', 'locSrv.qx', 'locSrv.qy', 'locSrv.qz', 'locSrv.qw'])
+
+    records += _records(logData, 'fixedFrequency', 'ref {} {} {} {}',
+                        [refPrefix + '.x', refPrefix + '.y', refPrefix + '.z'])
+
+    # The uSD log stores range.zrange in mm
+    lines = []
+    for t, line in sorted(records, key=lambda r: r[0]):
+        if line.startswith('tof'):
+            parts = line.split(' ')
+            parts[2] = str(float(parts[2]) / 1000.0)
+            line = ' '.join(parts)
+        lines.append(line)
+
+    return lines
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("filename", help="uSD log file")
+    parser.add_argument("output", help="measurement stream file to write")
+    parser.add_argument("--ref", default="stateEstimate", help="log group of the reference position")
+    args = parser.parse_args()
+
+    logData = cfusdlog.decode(args.filename)
+    lines = export(logData, args.ref)
+
+    with open(args.output, 'w') as f:
+        f.write("# Kalman replay stream exported from {}\n".format(args.filename))
+        for line in lines:
+            f.write(line + "\n")
+
+    print("Wrote {} records to {}".format(len(lines), args.output))
@@ -0,0 +1,50 @@
+# -*- coding: utf-8 -*-
+"""
+Export the raw Lighthouse deck frames in a uSD log to a frame stream for the
+pulse processor benchmark in
+test/utils/src/lighthouse/test_pulse_processor_benchmark.c
+
+The log should be recorded with the lhFrame event enabled, see
+config_lighthouse.txt.
+"""
+import argparse
+import cfusdlog
+
+
+def export(logData):
+    if 'lhFrame' not in logData:
+        return []
+
+    event = logData['lhFrame']
+    lines = []
+    for i in range(len(event['timestamp'])):
+        info = int(event['info'][i])
+        sensor = info & 0x03
+        slowbit = (info >> 2) & 0x01
+        channelFound = (info >> 3) & 0x01
+        channel = (info >> 4) & 0x0f
+        lines.append('{} {} {} {} {} {} {} {}'.format(
+            sensor, int(event['ts'][i]), int(event['width'][i]), int(event['offset'][i]),
+            int(event['beam'][i]), channel, slowbit, channelFound))
+
+    return lines
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("filename", help="uSD log file")
+    parser.add_argument("output", help="frame stream file to write")
+    parser.add_argument("--type", type=int, default=2, choices=[1, 2], help="base station type (1 or 2)")
+    args = parser.parse_args()
+
+    logData = cfusdlog.decode(args.filename)
+    lines = export(logData)
+
+    with open(args.output, 'w') as f:
+        f.write("# Lighthouse frame stream exported from {}\n".format(args.filename))
+        f.write("# sensor timestamp width offset beamData channel slowbit channelFound\n")
+        f.write("type {}\n".format(args.type))
+        for line in lines:
+            f.write(line + "\n")
+
+    print("Wrote {} frames to {}".format(len(lines), args.output))
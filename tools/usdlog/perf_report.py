@@ -0,0 +1,102 @@
+# -*- coding: utf-8 -*-
+"""
+Performance summary of uSD logs recorded with config_perf.txt
+
+The firmware triggers the perfStage and perfSys events once per profiler
+window (1 s), each record holds the performance counters of that window. For
+each flight (log file) the percentiles of the counters over the windows are
+printed, counters that only increase (drops, overruns) are reported as the
+increase during the flight. The CPU load in sysload.load is only updated when
+the system.loadMon parameter is set.
+
+With --csv one row per flight is appended to a CSV file, to compare flights
+and firmware versions over time.
+"""
+import argparse
+import csv
+import os
+import numpy as np
+import cfusdlog
+
+EVENTS = ['perfStage', 'perfSys']
+
+PERCENTILES = [50, 95, 99, 100]
+
+# Stage timings are logged in cycles
+CYCLES_PER_US = 168.0
+
+CUMULATIVE = {'overrun.loop', 'overrun.degradeCnt', 'wcet.total', 'queueMon.estDrop', 'queueMon.crtpTxDrop', 'crtp.txDropped'}
+
+
+def summarize(logData):
+    summary = {}
+    for event in EVENTS:
+        if event not in logData:
+            continue
+
+        data = logData[event]
+        for name, values in data.items():
+            if name == 'timestamp' or len(values) == 0:
+                continue
+
+            if name in CUMULATIVE:
+                summary[name + '.inc'] = float(values[-1] - values[0])
+                continue
+
+            values = values.astype(float)
+            if name.startswith('prof'):
+                values = values / CYCLES_PER_US
+                name = name + '.us'
+
+            for p, v in zip(PERCENTILES, np.percentile(values, PERCENTILES)):
+                summary['{}.p{}'.format(name, p)] = v
+
+    return summary
+
+
+def windows(logData):
+    if 'perfStage' not in logData:
+        return 0
+    return len(logData['perfStage']['timestamp'])
+
+
+def print_summary(filename, logData, summary):
+    print('{}: {} windows'.format(filename, windows(logData)))
+    for name in sorted(summary):
+        print('  {:32} {:12.2f}'.format(name, summary[name]))
+
+
+def append_csv(csvFile, filename, logData, summary):
+    row = {'file': os.path.basename(filename), 'windows': windows(logData)}
+    row.update(summary)
+
+    # The columns of an existing file are kept, the file is comparable over time
+    exists = os.path.exists(csvFile)
+    fieldnames = ['file', 'windows'] + sorted(summary)
+    if exists:
+        with open(csvFile, newline='') as f:
+            fieldnames = next(csv.reader(f), fieldnames)
+
+    with open(csvFile, 'a', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=fieldnames, restval='', extrasaction='ignore')
+        if not exists:
+            writer.writeheader()
+        writer.writerow(row)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("filenames", nargs='+', help="uSD log files, one per flight")
+    parser.add_argument("--csv", help="CSV file to append one row per flight to")
+    args = parser.parse_args()
+
+    for filename in args.filenames:
+        logData = cfusdlog.decode(filename)
+        if not any(event in logData for event in EVENTS):
+            print('{}: no performance events, was the log recorded with config_perf.txt?'.format(filename))
+            continue
+
+        summary = summarize(logData)
+        print_summary(filename, logData, summary)
+        if args.csv:
+            append_csv(args.csv, filename, logData, summary)